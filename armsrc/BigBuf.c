@@ -21,6 +21,9 @@
 #include "dbprint.h"
 #include "pm3_cmd.h"
 #include "util.h" // nbytes
+#include "parity.h" // oddparity8
+#include "usb_cdc.h" // trace streaming
+#include "proxmark3_arm.h" // WDT_HIT
 
 #define BIGBUF_ALIGN_BYTES (4)
 #define BIGBUF_ALIGN_MASK  (0xFFFF + 1 - BIGBUF_ALIGN_BYTES)
@@ -47,6 +50,30 @@ static uint32_t s_bigbuf_hi = 0;
 // pointer to the emulator memory.
 static uint8_t *s_emulator_memory = NULL;
 
+// Allocation statistics, shown by `hw status`. Peaks are in bytes of BigBuf below s_bigbuf_size
+#define BIGBUF_STAT_TAGS    12
+typedef struct {
+    const char *tag;
+    uint32_t count;         // allocations, or uses of the arena
+    uint32_t peak;          // biggest allocation, or most memory taken inside the arena
+} bigbuf_tag_stat_t;
+static bigbuf_tag_stat_t s_tag_stats[BIGBUF_STAT_TAGS];
+static uint32_t s_bigbuf_peak = 0;
+static uint32_t s_bigbuf_failed = 0;
+static uint32_t s_trace_peak = 0;
+
+// Scoped arenas, BigBuf_arena_end() gives back everything allocated since BigBuf_arena_begin()
+#define BIGBUF_ARENA_DEPTH  4
+typedef struct {
+    const char *tag;
+    uint32_t mark;          // s_bigbuf_hi when the arena began
+    uint32_t low;           // lowest s_bigbuf_hi inside the arena
+} bigbuf_arena_t;
+static bigbuf_arena_t s_arenas[BIGBUF_ARENA_DEPTH];
+static uint8_t s_arena_depth = 0;
+
+static uint8_t *BigBuf_malloc_tag(uint16_t chunksize, const char *tag);
+
 //=============================================================================
 // The ToSend buffer.
 // A buffer where we can queue things up to be sent through the FPGA, for
@@ -75,6 +102,30 @@ static dmabuf8_t s_dma_8 = {
 // trace related variables
 static uint32_t s_trace_len = 0;
 static bool s_tracing = true;
+static bool s_trace_compact = false;
+static bool s_trace_compact_next = false;
+static uint32_t s_trace_prev_ts = 0;    // compact records store the timestamp delta
+
+// Ring trace, see tracelog_ring_hdr_t. The header is kept up to date in BigBuf
+static bool s_trace_ring = false;
+static bool s_trace_ring_next = false;
+static tracelog_ring_hdr_t s_ring;
+
+// Streamed trace. The trace area is split in two halves, LogTrace fills one
+// while the other one is pushed to the USB between frames.
+typedef struct {
+    bool active;
+    uint32_t half;          // size of each half
+    uint8_t cur;            // half LogTrace writes to
+    uint32_t fill[2];       // bytes logged in each half
+    uint32_t sent;          // bytes of the other half already in the USB FIFO
+    uint8_t packet;         // bytes in the USB FIFO, not yet requested
+    uint32_t dropped;       // records lost while both halves were full
+} trace_stream_t;
+static trace_stream_t s_stream;
+
+// where a stream goes instead of the USB, see trace_stream_set_sink
+static trace_sink_t s_stream_sink = NULL;
 
 // compute the available size for BigBuf
 void BigBuf_initialize(void) {
@@ -96,7 +147,10 @@ uint32_t BigBuf_get_size(void) {
 uint8_t *BigBuf_get_EM_addr(void) {
     // not yet allocated
     if (s_emulator_memory == NULL) {
-        s_emulator_memory = BigBuf_calloc(CARD_MEMORY_SIZE);
+        s_emulator_memory = BigBuf_malloc_tag(CARD_MEMORY_SIZE, "emulator");
+        if (s_emulator_memory != NULL) {
+            memset(s_emulator_memory, 0x00, CARD_MEMORY_SIZE);
+        }
     }
     return s_emulator_memory;
 }
@@ -133,20 +187,102 @@ void BigBuf_Clear_keep_EM(void) {
     memset(BigBuf, 0, s_bigbuf_hi);
 }
 
-// allocate a chunk of memory from BigBuf. We allocate high memory first. The unallocated memory
-// at the beginning of BigBuf is always for traces/samples
-uint8_t *BigBuf_malloc(uint16_t chunksize) {
+static void BigBuf_stat(const char *tag, uint32_t value) {
+    for (uint8_t i = 0; i < BIGBUF_STAT_TAGS; i++) {
+        bigbuf_tag_stat_t *st = &s_tag_stats[i];
+        if (st->tag == NULL) {
+            st->tag = tag;
+        }
+        if (st->tag == tag) {
+            st->count++;
+            if (value > st->peak) {
+                st->peak = value;
+            }
+            return;
+        }
+    }
+}
+
+static uint8_t *BigBuf_malloc_tag(uint16_t chunksize, const char *tag) {
     chunksize = (chunksize + BIGBUF_ALIGN_BYTES - 1) & BIGBUF_ALIGN_MASK; // round up to next multiple of 4
 
     if (s_bigbuf_hi - s_trace_len < chunksize || chunksize == 0) {
         // no memory left or chunksize too large
+        s_bigbuf_failed++;
         return NULL;
     }
 
     s_bigbuf_hi -= chunksize;  // aligned to 4 Byte boundary
+
+    if (s_bigbuf_size - s_bigbuf_hi > s_bigbuf_peak) {
+        s_bigbuf_peak = s_bigbuf_size - s_bigbuf_hi;
+    }
+    if (s_arena_depth && s_bigbuf_hi < s_arenas[s_arena_depth - 1].low) {
+        s_arenas[s_arena_depth - 1].low = s_bigbuf_hi;
+    }
+    if (tag != NULL) {
+        BigBuf_stat(tag, chunksize);
+    }
     return (uint8_t *)BigBuf + s_bigbuf_hi;
 }
 
+// allocate a chunk of memory from BigBuf. We allocate high memory first. The unallocated memory
+// at the beginning of BigBuf is always for traces/samples
+uint8_t *BigBuf_malloc(uint16_t chunksize) {
+    return BigBuf_malloc_tag(chunksize, NULL);
+}
+
+// forget the long lived buffers that were in memory given back, they are allocated again on next use
+static void BigBuf_drop_released(void) {
+    uint8_t *hi = (uint8_t *)BigBuf + s_bigbuf_hi;
+    if (s_emulator_memory != NULL && s_emulator_memory < hi) {
+        s_emulator_memory = NULL;
+    }
+    if (s_toSend.buf != NULL && s_toSend.buf < hi) {
+        s_toSend.buf = NULL;
+    }
+    if (s_dma_16.buf != NULL && (uint8_t *)s_dma_16.buf < hi) {
+        s_dma_16.buf = NULL;
+    }
+    if (s_dma_8.buf != NULL && s_dma_8.buf < hi) {
+        s_dma_8.buf = NULL;
+    }
+}
+
+// Start a scope for temporary buffers, the tag names it in the statistics. Returns the
+// handle for BigBuf_arena_end(), arenas nest up to BIGBUF_ARENA_DEPTH deep
+int BigBuf_arena_begin(const char *tag) {
+    if (s_arena_depth == BIGBUF_ARENA_DEPTH) {
+        return -1;
+    }
+    bigbuf_arena_t *a = &s_arenas[s_arena_depth];
+    a->tag = tag;
+    a->mark = s_bigbuf_hi;
+    a->low = s_bigbuf_hi;
+    return s_arena_depth++;
+}
+
+// Give back everything allocated since the arena began, ends the arenas nested in it as well
+void BigBuf_arena_end(int arena) {
+    if (arena < 0 || arena >= s_arena_depth) {
+        return;
+    }
+
+    while (s_arena_depth > arena) {
+        bigbuf_arena_t *a = &s_arenas[--s_arena_depth];
+        BigBuf_stat(a->tag, a->mark - a->low);
+        if (s_arena_depth && a->low < s_arenas[s_arena_depth - 1].low) {
+            s_arenas[s_arena_depth - 1].low = a->low;
+        }
+    }
+
+    // a BigBuf_free() in between already gave back more
+    if (s_bigbuf_hi < s_arenas[arena].mark) {
+        s_bigbuf_hi = s_arenas[arena].mark;
+        BigBuf_drop_released();
+    }
+}
+
 // allocate a chunk of memory from BigBuf, and returns a pointer to it.
 // sets the memory to zero
 uint8_t *BigBuf_calloc(uint16_t chunksize) {
@@ -160,6 +296,10 @@ uint8_t *BigBuf_calloc(uint16_t chunksize) {
 // free ALL allocated chunks. The whole BigBuf is available for traces or samples again.
 void BigBuf_free(void) {
     s_bigbuf_hi = s_bigbuf_size;
+    // open arenas have nothing left to give back
+    for (uint8_t i = 0; i < s_arena_depth; i++) {
+        s_arenas[i].mark = s_bigbuf_hi;
+    }
     s_emulator_memory = NULL;
     // shouldn't this empty BigBuf also?
     s_toSend.buf = NULL;
@@ -174,9 +314,14 @@ void BigBuf_free_keep_EM(void) {
     else
         s_bigbuf_hi = s_bigbuf_size;
 
-    s_toSend.buf = NULL;
-    s_dma_16.buf = NULL;
-    s_dma_8.buf = NULL;
+    for (uint8_t i = 0; i < s_arena_depth; i++) {
+        if (s_arenas[i].mark < s_bigbuf_hi) {
+            s_arenas[i].mark = s_bigbuf_hi;
+        }
+    }
+
+    // buffers allocated before the emulator memory stay
+    BigBuf_drop_released();
 }
 
 void BigBuf_print_status(void) {
@@ -186,6 +331,16 @@ void BigBuf_print_status(void) {
     DbpString(_CYAN_("Tracing"));
     Dbprintf("  tracing ................ %d", s_tracing);
     Dbprintf("  traceLen ............... %d", s_trace_len);
+    Dbprintf("  streamed dropped ....... %d", s_stream.dropped);
+    Dbprintf("  ring overwritten ....... %d", s_ring.overwritten);
+    Dbprintf("  peak traceLen .......... %d", MAX(s_trace_peak, s_trace_len));
+    DbpString(_CYAN_("Allocations"));
+    Dbprintf("  peak allocated ......... %d", s_bigbuf_peak);
+    Dbprintf("  failed ................. %d", s_bigbuf_failed);
+    Dbprintf("  open arenas ............ %d", s_arena_depth);
+    for (uint8_t i = 0; i < BIGBUF_STAT_TAGS && s_tag_stats[i].tag; i++) {
+        Dbprintf("  %-22s %u x, peak %u bytes", s_tag_stats[i].tag, s_tag_stats[i].count, s_tag_stats[i].peak);
+    }
 
     if (g_dbglevel >= DBG_DEBUG) {
         DbpString(_CYAN_("Sending buffers"));
@@ -214,7 +369,13 @@ uint16_t BigBuf_max_traceLen(void) {
 }
 
 void clear_trace(void) {
+    if (s_trace_len > s_trace_peak) {
+        s_trace_peak = s_trace_len;
+    }
     s_trace_len = 0;
+    s_trace_compact = s_trace_compact_next;
+    s_trace_ring = s_trace_ring_next;
+    memset(&s_ring, 0, sizeof(s_ring));
 }
 
 void set_tracelen(uint32_t value) {
@@ -225,6 +386,16 @@ void set_tracing(bool enable) {
     s_tracing = enable;
 }
 
+// compact records, see TRACELOG_COMPACT_MAGIC. Takes effect with the next cleared trace
+void set_tracing_compact(bool enable) {
+    s_trace_compact_next = enable;
+}
+
+// overwrite the oldest records when full, see tracelog_ring_hdr_t. Takes effect with the next cleared trace
+void set_tracing_ring(bool enable) {
+    s_trace_ring_next = enable;
+}
+
 bool get_tracing(void) {
     return s_tracing;
 }
@@ -237,6 +408,298 @@ uint32_t BigBuf_get_traceLen(void) {
     return s_trace_len;
 }
 
+// room for a record in the half LogTrace writes to, swaps halves when it is full and the other one is sent
+static uint8_t *RAMFUNC trace_stream_reserve(uint32_t len) {
+    uint8_t c = s_stream.cur;
+    if (s_stream.fill[c] + len > s_stream.half) {
+        if (s_stream.fill[c ^ 1] || len > s_stream.half) {
+            return NULL;
+        }
+        c ^= 1;
+        s_stream.cur = c;
+        s_stream.sent = 0;
+    }
+    uint8_t *p = BigBuf_get_addr() + (c * s_stream.half) + s_stream.fill[c];
+    s_stream.fill[c] += len;
+    return p;
+}
+
+/**
+  Streams the trace to the host instead of stopping when BigBuf is full.
+  Call after the sniff allocated its buffers, the rest of BigBuf becomes the two halves.
+  Between start and stop nothing else may be sent over USB, no Dbprintf / reply_ng.
+  The host sees the plain records between two markers, see TRACELOG_STREAM_MAGIC.
+  With a sink set, full halves are handed to it instead and there are no markers.
+**/
+int trace_stream_start(void) {
+    if (s_stream_sink == NULL) {
+        int res = async_usb_write_start();
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+    }
+    memset(&s_stream, 0, sizeof(s_stream));
+    s_stream.half = (BigBuf_max_traceLen() / 2) & BIGBUF_ALIGN_MASK;
+    // the whole area is taken, nothing can be allocated on top of it
+    s_trace_len = 2 * s_stream.half;
+    s_tracing = true;
+    s_stream.active = true;
+
+    if (s_stream_sink != NULL) {
+        return PM3_SUCCESS;
+    }
+
+    tracelog_hdr_t *start = (tracelog_hdr_t *)trace_stream_reserve(TRACELOG_HDR_LEN);
+    if (start != NULL) {
+        memset(start, 0, TRACELOG_HDR_LEN);
+        start->timestamp = TRACELOG_STREAM_MAGIC;
+    }
+    return PM3_SUCCESS;
+}
+
+bool trace_stream_active(void) {
+    return s_stream.active;
+}
+
+/**
+  Streams to sink instead of the USB, e.g. to flash in standalone mode. Set it before the
+  sniff starts and reset it to NULL after. The sink gets a whole half at a time, the records
+  of one half never straddle two calls.
+**/
+void trace_stream_set_sink(trace_sink_t sink) {
+    s_stream_sink = sink;
+}
+
+// records lost while both halves were full, kept after trace_stream_stop
+uint32_t trace_stream_dropped(void) {
+    return s_stream.dropped;
+}
+
+// hands the half over to the sink, blocks until it is written. The sink reports its own errors
+static void trace_stream_sink_half(uint8_t half) {
+    if (s_stream.fill[half] == 0) {
+        return;
+    }
+    s_stream_sink(BigBuf_get_addr() + (half * s_stream.half), s_stream.fill[half]);
+    s_stream.fill[half] = 0;
+}
+
+/**
+  Pushes at most one USB packet of the pending half, never waits.
+  Call it whenever the sniff loop has nothing to decode.
+**/
+void RAMFUNC trace_stream_poll(void) {
+    if (s_stream.active == false) {
+        return;
+    }
+
+    // only full halves, a sink writes best in large blocks
+    if (s_stream_sink != NULL) {
+        trace_stream_sink_half(s_stream.cur ^ 1);
+        return;
+    }
+
+    // the last packet is still waiting for the USB
+    if (s_stream.packet == AT91C_USB_EP_IN_SIZE) {
+        if (async_usb_write_requestWrite() == false) {
+            return;
+        }
+        s_stream.packet = 0;
+    }
+
+    uint8_t p = s_stream.cur ^ 1;
+    if (s_stream.fill[p] == 0) {
+        // nothing pending, hand over what was logged so far
+        if (s_stream.fill[s_stream.cur] == 0) {
+            return;
+        }
+        s_stream.cur = p;
+        s_stream.sent = 0;
+        p ^= 1;
+    }
+
+    const uint8_t *src = BigBuf_get_addr() + (p * s_stream.half);
+    while (s_stream.packet < AT91C_USB_EP_IN_SIZE && s_stream.sent < s_stream.fill[p]) {
+        async_usb_write_pushByte(src[s_stream.sent++]);
+        s_stream.packet++;
+    }
+    if (s_stream.sent == s_stream.fill[p]) {
+        s_stream.fill[p] = 0;
+        s_stream.sent = 0;
+    }
+
+    if (s_stream.packet == AT91C_USB_EP_IN_SIZE && async_usb_write_requestWrite()) {
+        s_stream.packet = 0;
+    }
+}
+
+// sends all pending records and the end marker
+static int trace_stream_drain(void) {
+    while (s_stream.fill[0] || s_stream.fill[1] || s_stream.packet == AT91C_USB_EP_IN_SIZE) {
+        WDT_HIT();
+        if (usb_check() == false) {
+            return PM3_EIO;
+        }
+        trace_stream_poll();
+    }
+    return PM3_SUCCESS;
+}
+
+int trace_stream_stop(void) {
+    if (s_stream.active == false) {
+        return PM3_SUCCESS;
+    }
+
+    if (s_stream_sink != NULL) {
+        trace_stream_sink_half(s_stream.cur ^ 1);
+        trace_stream_sink_half(s_stream.cur);
+        s_stream.active = false;
+        clear_trace();
+        return PM3_SUCCESS;
+    }
+
+    int res = trace_stream_drain();
+    if (res == PM3_SUCCESS) {
+        tracelog_hdr_t *end = (tracelog_hdr_t *)trace_stream_reserve(TRACELOG_HDR_LEN);
+        if (end != NULL) {
+            memset(end, 0, TRACELOG_HDR_LEN);
+            end->timestamp = s_stream.dropped;
+        }
+        res = trace_stream_drain();
+    }
+    if (res == PM3_SUCCESS) {
+        res = async_usb_write_stop();
+    }
+
+    s_stream.active = false;
+    clear_trace();
+    return res;
+}
+
+// room for a record in the ring trace, the oldest records make way
+static uint8_t *RAMFUNC trace_ring_reserve(uint32_t len) {
+    const uint32_t start = sizeof(tracelog_ring_hdr_t);
+    const uint32_t max_trace_len = BigBuf_max_traceLen();
+    if (max_trace_len < start || len > max_trace_len - start) {
+        return NULL;
+    }
+
+    uint8_t *trace = BigBuf_get_addr();
+    if (s_ring.end == 0) {
+        s_ring.magic = TRACELOG_RING_MAGIC;
+        s_ring.first = start;
+        s_ring.end = start;
+    }
+
+    for (;;) {
+        if (s_ring.wrap == 0) {
+            if (s_ring.end + len <= max_trace_len) {
+                break;
+            }
+            s_ring.wrap = s_ring.end;
+            s_ring.end = start;
+        }
+
+        while (s_ring.first < s_ring.wrap && s_ring.first < s_ring.end + len) {
+            const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(trace + s_ring.first);
+            s_ring.first += TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+            s_ring.overwritten++;
+        }
+        if (s_ring.first < s_ring.wrap) {
+            break;
+        }
+
+        // all of the older part is gone, the rest is in order again
+        s_ring.first = start;
+        s_ring.wrap = 0;
+    }
+
+    uint8_t *p = trace + s_ring.end;
+    s_ring.end += len;
+    s_trace_len = (s_ring.wrap) ? s_ring.wrap : s_ring.end;
+    memcpy(trace, &s_ring, sizeof(s_ring));
+    return p;
+}
+
+static uint8_t RAMFUNC trace_put_varint(uint8_t *p, uint32_t v) {
+    uint8_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+    return n;
+}
+
+// parity bytes that can be left out, TRACELOG_COMPACT_PAR_KEEP if they have to be stored
+static uint8_t RAMFUNC trace_parity_mode(const uint8_t *data, uint16_t len, const uint8_t *parity) {
+    if (parity == NULL) {
+        return TRACELOG_COMPACT_PAR_ZERO;
+    }
+
+    const uint16_t num_paritybytes = (len - 1) / 8 + 1;
+    bool zero = true;
+    for (uint16_t i = 0; i < num_paritybytes && zero; i++) {
+        zero = (parity[i] == 0);
+    }
+    if (zero) {
+        return TRACELOG_COMPACT_PAR_ZERO;
+    }
+
+    uint8_t expect = 0;
+    for (uint16_t i = 0; i < len; i++) {
+        expect |= oddparity8(data[i]) << (7 - (i & 7));
+        if ((i & 7) == 7 || i == len - 1) {
+            if (parity[i >> 3] != expect) {
+                return TRACELOG_COMPACT_PAR_KEEP;
+            }
+            expect = 0;
+        }
+    }
+    return TRACELOG_COMPACT_PAR_ODD;
+}
+
+static bool RAMFUNC LogTraceCompact(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_start, uint32_t duration, const uint8_t *parity, bool reader2tag) {
+
+    const uint8_t par = trace_parity_mode(btBytes, iLen, parity);
+    const uint16_t num_paritybytes = (par == TRACELOG_COMPACT_PAR_KEEP) ? (iLen - 1) / 8 + 1 : 0;
+
+    // a new trace starts with the marker and an absolute timestamp
+    const uint32_t marker_len = (s_trace_len == 0) ? TRACELOG_HDR_LEN : 0;
+    if (marker_len) {
+        s_trace_prev_ts = 0;
+    }
+
+    uint8_t hdr[3 * 5];
+    uint8_t n = trace_put_varint(hdr, ((uint32_t)iLen << 3) | (par << 1) | (reader2tag ? 0 : 1));
+    n += trace_put_varint(hdr + n, timestamp_start - s_trace_prev_ts);
+    n += trace_put_varint(hdr + n, duration);
+
+    // Disable tracing and return when trace is full
+    const uint32_t max_trace_len = BigBuf_max_traceLen();
+    const uint32_t trace_entry_len = marker_len + n + iLen + num_paritybytes;
+    if (s_trace_len >= max_trace_len || trace_entry_len >= max_trace_len - s_trace_len) {
+        s_tracing = false;
+        return false;
+    }
+
+    uint8_t *p = BigBuf_get_addr() + s_trace_len;
+    if (marker_len) {
+        memset(p, 0, TRACELOG_HDR_LEN);
+        ((tracelog_hdr_t *)p)->timestamp = TRACELOG_COMPACT_MAGIC;
+        p += TRACELOG_HDR_LEN;
+    }
+    memcpy(p, hdr, n);
+    memcpy(p + n, btBytes, iLen);
+    if (num_paritybytes) {
+        memcpy(p + n + iLen, parity, num_paritybytes);
+    }
+
+    s_trace_len += trace_entry_len;
+    s_trace_prev_ts = timestamp_start;
+    return true;
+}
+
 /**
   This is a function to store traces. All protocols can use this generic tracer-function.
   The traces produced by calling this function can be fetched on the client-side
@@ -253,17 +716,6 @@ bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_
         return false;
     }
 
-    // number of valid paritybytes in *parity
-    const uint16_t num_paritybytes = (iLen - 1) / 8 + 1;
-
-    // Disable tracing and return when trace is full
-    const uint32_t max_trace_len = BigBuf_max_traceLen();
-    const uint32_t trace_entry_len = TRACELOG_HDR_LEN + iLen + num_paritybytes;
-    if (s_trace_len >= max_trace_len || trace_entry_len >= max_trace_len - s_trace_len) {
-        s_tracing = false;
-        return false;
-    }
-
     uint32_t duration;
     if (timestamp_end > timestamp_start) {
         duration = timestamp_end - timestamp_start;
@@ -280,7 +732,38 @@ bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_
         duration = 0xFFFF;
     }
 
-    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(BigBuf_get_addr() + s_trace_len);
+    if (s_trace_compact && s_stream.active == false && s_trace_ring == false) {
+        return LogTraceCompact(btBytes, iLen, timestamp_start, duration, parity, reader2tag);
+    }
+
+    // number of valid paritybytes in *parity
+    const uint16_t num_paritybytes = (iLen - 1) / 8 + 1;
+
+    const uint32_t trace_entry_len = TRACELOG_HDR_LEN + iLen + num_paritybytes;
+    tracelog_hdr_t *hdr;
+    if (s_stream.active) {
+        hdr = (tracelog_hdr_t *)trace_stream_reserve(trace_entry_len);
+        if (hdr == NULL) {
+            // the host is behind, lose this record but keep sniffing
+            s_stream.dropped++;
+            return true;
+        }
+    } else if (s_trace_ring) {
+        hdr = (tracelog_hdr_t *)trace_ring_reserve(trace_entry_len);
+        if (hdr == NULL) {
+            return false;
+        }
+    } else {
+        // Disable tracing and return when trace is full
+        const uint32_t max_trace_len = BigBuf_max_traceLen();
+        if (s_trace_len >= max_trace_len || trace_entry_len >= max_trace_len - s_trace_len) {
+            s_tracing = false;
+            return false;
+        }
+        hdr = (tracelog_hdr_t *)(BigBuf_get_addr() + s_trace_len);
+        s_trace_len += trace_entry_len;
+    }
+
     hdr->timestamp = timestamp_start;
     hdr->duration = duration & 0xFFFF;
     hdr->data_len = iLen;
@@ -292,7 +775,6 @@ bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_
         memset(&hdr->frame[iLen], 0x00, num_paritybytes);
     }
 
-    s_trace_len += trace_entry_len;
     return true;
 }
 
@@ -354,7 +836,7 @@ int emlGet(uint8_t *out, uint32_t offset, uint32_t length) {
 tosend_t *get_tosend(void) {
 
     if (s_toSend.buf == NULL) {
-        s_toSend.buf = BigBuf_malloc(TOSEND_BUFFER_SIZE);
+        s_toSend.buf = BigBuf_malloc_tag(TOSEND_BUFFER_SIZE, "tosend");
     }
     return &s_toSend;
 }
@@ -389,15 +871,41 @@ void tosend_stuffbit(int b) {
 
 dmabuf16_t *get_dma16(void) {
     if (s_dma_16.buf == NULL) {
-        s_dma_16.buf = (uint16_t *)BigBuf_malloc(DMA_BUFFER_SIZE * sizeof(uint16_t));
+        s_dma_16.buf = (uint16_t *)BigBuf_malloc_tag(DMA_BUFFER_SIZE * sizeof(uint16_t), "dma16");
+        s_dma_16.size = DMA_BUFFER_SIZE;
     }
 
     return &s_dma_16;
 }
 
+// a DMA ring of at least size samples (a power of 2), DMA_BUFFER_SIZE ones if there is no room for it
+dmabuf16_t *get_dma16_sized(uint16_t size) {
+    if (s_dma_16.buf == NULL || s_dma_16.size < size) {
+        uint16_t *buf = (uint16_t *)BigBuf_malloc_tag(size * sizeof(uint16_t), "dma16");
+        if (buf != NULL) {
+            s_dma_16.buf = buf;
+            s_dma_16.size = size;
+        }
+    }
+    return get_dma16();
+}
+
 dmabuf8_t *get_dma8(void) {
-    if (s_dma_8.buf == NULL)
-        s_dma_8.buf = BigBuf_malloc(DMA_BUFFER_SIZE);
+    if (s_dma_8.buf == NULL) {
+        s_dma_8.buf = BigBuf_malloc_tag(DMA_BUFFER_SIZE, "dma8");
+        s_dma_8.size = DMA_BUFFER_SIZE;
+    }
 
     return &s_dma_8;
 }
+
+dmabuf8_t *get_dma8_sized(uint16_t size) {
+    if (s_dma_8.buf == NULL || s_dma_8.size < size) {
+        uint8_t *buf = BigBuf_malloc_tag(size, "dma8");
+        if (buf != NULL) {
+            s_dma_8.buf = buf;
+            s_dma_8.size = size;
+        }
+    }
+    return get_dma8();
+}
@@ -33,6 +33,12 @@
 //#define DMA_BUFFER_SIZE         (512 + 256)
 #define DMA_BUFFER_SIZE         512
 
+// DMA ring of the HF sniffers, in samples. Decoding and tracing may fall behind the FPGA
+// by this much before samples are lost. A power of 2
+#ifndef DMA_SNIFF_BUFFER_SIZE
+#define DMA_SNIFF_BUFFER_SIZE   2048
+#endif
+
 // 8 data bits and 1 parity bit per payload byte, 1 correction bit, 1 SOC bit, 2 EOC bits
 #define TOSEND_BUFFER_SIZE (9 * MAX_FRAME_SIZE + 1 + 1 + 2)
 
@@ -51,12 +57,26 @@ uint8_t *BigBuf_malloc(uint16_t);
 uint8_t *BigBuf_calloc(uint16_t);
 void BigBuf_free(void);
 void BigBuf_free_keep_EM(void);
+int BigBuf_arena_begin(const char *tag);
+void BigBuf_arena_end(int arena);
 void BigBuf_print_status(void);
 uint32_t BigBuf_get_traceLen(void);
 void clear_trace(void);
 void set_tracing(bool enable);
 void set_tracelen(uint32_t value);
 bool get_tracing(void);
+void set_tracing_compact(bool enable);
+void set_tracing_ring(bool enable);
+
+// takes a block of plain trace records, returns PM3_SUCCESS once it is stored
+typedef int (*trace_sink_t)(const uint8_t *data, uint32_t len);
+
+int trace_stream_start(void);
+bool trace_stream_active(void);
+void trace_stream_set_sink(trace_sink_t sink);
+void RAMFUNC trace_stream_poll(void);
+int trace_stream_stop(void);
+uint32_t trace_stream_dropped(void);
 
 bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_start, uint32_t timestamp_end, const uint8_t *parity, bool reader2tag);
 bool RAMFUNC LogTraceBits(const uint8_t *btBytes, uint16_t bitLen, uint32_t timestamp_start, uint32_t timestamp_end, bool reader2tag);
@@ -86,5 +106,7 @@ typedef struct {
 } dmabuf16_t;
 
 dmabuf8_t *get_dma8(void);
+dmabuf8_t *get_dma8_sized(uint16_t size);
 dmabuf16_t *get_dma16(void);
+dmabuf16_t *get_dma16_sized(uint16_t size);
 #endif /* __BIGBUF_H */
@@ -27,8 +27,13 @@
  * This will be stored in the normal trace buffer (ie: in RAM -- will be lost
  * at power-off).
  *
- * Short-pressing the button again will stop sniffing, and at _this_ point
- * append trace data from RAM to a file in flash (hf_14asniff.trace) and unmount.
+ * With flash, the trace buffer is split in two halves. While one fills, the
+ * other one is LZ4 compressed and appended to a file in flash
+ * (hf_14asniff_lz4.trace), between frames so RF handling isn't held up.
+ * Sessions are only limited by the space left in flash.
+ *
+ * Short-pressing the button again will stop sniffing, append what is left
+ * and unmount.
  *
  * Once the data is saved, standalone mode will exit.
  *
@@ -40,11 +45,12 @@
  *
  * To retrieve trace data from flash:
  *
- * 1. mem spiffs dump -s hf_14asniff.trace -d hf_14asniff.trace
+ * 1. mem spiffs dump -s hf_14asniff_lz4.trace -d hf_14asniff.trace
  *    Copies trace data file from flash to your PC.
  *
  * 2. trace load -f hf_14asniff.trace
- *    Loads trace data from a file into PC-side buffers.
+ *    Loads trace data from a file into PC-side buffers, the LZ4 chunks are
+ *    decompressed.
  *
  * 3. For ISO14a: trace list -t 14a -1
  *    For MIFARE Classic: trace list -t mf -1
@@ -55,15 +61,19 @@
  * the lab connected to PM3 client before taking it into the field.
  *
  * To delete the trace data from flash:
- *    mem spiffs remove -f hf_14asniff.trace
+ *    mem spiffs remove -f hf_14asniff_lz4.trace
  *
  * Caveats / notes:
  * - Trace buffer will be cleared on starting stand-alone mode. Data in flash
  *   will remain unless explicitly deleted.
- * - This module will terminate if the trace buffer is full (and save data to
- *   flash).
+ * - Without flash, this module will terminate if the trace buffer is full.
+ *   With flash, frames are dropped only while both halves wait for the flash.
  * - Like normal sniffing mode, timestamps overflow after 5 min 16 sec.
  *   However, the trace buffer is sequential, so will be in the correct order.
+ * - Without flash, frames are stored in the compact trace format (varint
+ *   lengths and time deltas, parity left out when it is the odd parity of the
+ *   data), which holds roughly twice as many short frames. `trace load`
+ *   expands it. The flash log is in chunks, see TRACELOG_LZ4_MAGIC.
  */
 
 #include "standalone.h" // standalone definitions
@@ -75,8 +85,93 @@
 #include "dbprint.h"
 #include "ticks.h"
 #include "BigBuf.h"
+#include "lz4.h"
+
+#define HF_14ASNIFF_LOGFILE "hf_14asniff_lz4.trace"
+
+#ifdef WITH_FLASH
+// one compressed chunk, header included, one append to flash
+#define HF_14ASNIFF_CHUNK_SIZE  2048
+// keeps rawlen of a chunk within 16 bits
+#define HF_14ASNIFF_RAW_MAX     0x8000
+
+static uint8_t s_chunk[HF_14ASNIFF_CHUNK_SIZE];
+static uint32_t s_raw_written;
+static uint32_t s_flash_written;
+static uint32_t s_lost;
+
+// end of the last whole record in the first len bytes
+static uint32_t hf_14asniff_record_end(const uint8_t *data, uint32_t len) {
+    uint32_t pos = 0;
+    while (pos + TRACELOG_HDR_LEN <= len) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(data + pos);
+        uint32_t n = TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (pos + n > len) {
+            break;
+        }
+        pos += n;
+    }
+    return pos;
+}
+
+// trace sink, compresses a half of the trace buffer in chunks ending on a record and appends them
+static int hf_14asniff_flash_sink(const uint8_t *data, uint32_t len) {
+    LED_D_ON();
+
+    tracelog_lz4_chunk_t *chunk = (tracelog_lz4_chunk_t *)s_chunk;
+    char *out = (char *)s_chunk + sizeof(tracelog_lz4_chunk_t);
+    const int out_max = sizeof(s_chunk) - sizeof(tracelog_lz4_chunk_t);
+
+    int res = PM3_SUCCESS;
+    uint32_t offset = 0;
+    while (offset < len) {
+        WDT_HIT();
+        int left = MIN(len - offset, HF_14ASNIFF_RAW_MAX);
+        int srclen = left;
+        int clen = LZ4_compress_destSize((const char *)data + offset, out, &srclen, out_max);
+
+        if (srclen < left || left < (int)(len - offset)) {
+            int aligned = hf_14asniff_record_end(data + offset, srclen);
+            if (aligned == 0) {
+                clen = 0;
+            } else if (aligned != srclen) {
+                srclen = aligned;
+                clen = LZ4_compress_default((const char *)data + offset, out, srclen, out_max);
+            }
+        }
+        if (clen <= 0) {
+            res = PM3_ESOFT;
+            break;
+        }
+
+        chunk->magic = TRACELOG_LZ4_MAGIC;
+        chunk->clen = clen;
+        chunk->rawlen = srclen;
+
+        uint32_t size = sizeof(tracelog_lz4_chunk_t) + clen;
+        if (exists_in_spiffs(HF_14ASNIFF_LOGFILE)) {
+            res = rdv40_spiffs_append(HF_14ASNIFF_LOGFILE, s_chunk, size, RDV40_SPIFFS_SAFETY_LAZY);
+        } else {
+            res = rdv40_spiffs_write(HF_14ASNIFF_LOGFILE, s_chunk, size, RDV40_SPIFFS_SAFETY_LAZY);
+        }
+        if (res != SPIFFS_OK) {
+            res = PM3_EFLASH;
+            break;
+        }
+
+        offset += srclen;
+        s_raw_written += srclen;
+        s_flash_written += size;
+    }
+
+    if (res != PM3_SUCCESS) {
+        s_lost += len - offset;
+    }
 
-#define HF_14ASNIFF_LOGFILE "hf_14asniff.trace"
+    LED_D_OFF();
+    return res;
+}
+#endif
 
 static void DownloadTraceInstructions(void) {
     Dbprintf("");
@@ -99,34 +194,42 @@ void RunMod(void) {
     rdv40_spiffs_lazy_mount();
 #endif
 
+#ifndef WITH_FLASH
+    set_tracing_compact(true);
     SniffIso14443a(0);
+    set_tracing_compact(false);
 
     Dbprintf("Stopped sniffing");
     SpinDelay(200);
 
-    uint32_t trace_len = BigBuf_get_traceLen();
-#ifndef WITH_FLASH
     // Keep stuff in BigBuf for USB/BT dumping
+    uint32_t trace_len = BigBuf_get_traceLen();
     if (trace_len > 0)
         Dbprintf("[!] Trace length (bytes) = %u", trace_len);
 #else
-    // Write stuff to spiffs logfile
-    if (trace_len > 0) {
-        Dbprintf("[!] Trace length (bytes) = %u", trace_len);
+    s_raw_written = 0;
+    s_flash_written = 0;
+    s_lost = 0;
 
-        uint8_t *trace_buffer = BigBuf_get_addr();
-        if (!exists_in_spiffs(HF_14ASNIFF_LOGFILE)) {
-            rdv40_spiffs_write(
-                HF_14ASNIFF_LOGFILE, trace_buffer, trace_len, RDV40_SPIFFS_SAFETY_SAFE);
-            Dbprintf("[!] Wrote trace to "HF_14ASNIFF_LOGFILE);
-        } else {
-            rdv40_spiffs_append(
-                HF_14ASNIFF_LOGFILE, trace_buffer, trace_len, RDV40_SPIFFS_SAFETY_SAFE);
-            Dbprintf("[!] Appended trace to "HF_14ASNIFF_LOGFILE);
-        }
+    // the trace goes to flash in the gaps between frames
+    trace_stream_set_sink(hf_14asniff_flash_sink);
+    SniffIso14443a(0x04);
+    trace_stream_set_sink(NULL);
+
+    Dbprintf("Stopped sniffing");
+
+    if (s_raw_written > 0) {
+        Dbprintf("[!] Trace length (bytes) = %u, " _YELLOW_("%u") " in flash", s_raw_written, s_flash_written);
+        Dbprintf("[!] Appended trace to "HF_14ASNIFF_LOGFILE);
     } else {
         Dbprintf("[!] Trace buffer is empty, nothing to write!");
     }
+    if (trace_stream_dropped()) {
+        Dbprintf("[!] " _RED_("%u") " frames dropped while writing to flash", trace_stream_dropped());
+    }
+    if (s_lost) {
+        Dbprintf("[!] " _RED_("%u") " trace bytes not written, flash full?", s_lost);
+    }
 
     LED_D_ON();
     rdv40_spiffs_lazy_unmount();
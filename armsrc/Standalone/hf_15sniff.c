@@ -103,7 +103,7 @@ void RunMod(void) {
     rdv40_spiffs_lazy_mount();
 #endif
 
-    SniffIso15693(0, NULL, false);
+    SniffIso15693(0, NULL, false, false);
 
     Dbprintf("Stopped sniffing");
     SpinDelay(200);
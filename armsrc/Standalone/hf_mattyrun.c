@@ -32,6 +32,7 @@
 #include "mifarecmd.h"
 #include "mifaresim.h"  // mifare1ksim
 #include "mifareutil.h"
+#include "profiler.h"  // prof_start, see `hw profile`
 #include "proxmark3_arm.h"
 #include "spiffs.h"
 #include "standalone.h" // standalone definitions
@@ -157,6 +158,9 @@ static int saMifareChkKeys(uint8_t const blockNo, uint8_t const keyType, bool co
 
     set_tracing(false);
 
+    int prof_select = prof_slot("select");
+    int prof_auth = prof_slot("auth");
+
     for (uint16_t i = 0; i < keyCount; ++i) {
 
         uint64_t mfKey = mfKeys[i];
@@ -195,7 +199,11 @@ static int saMifareChkKeys(uint8_t const blockNo, uint8_t const keyType, bool co
             }
             // No need for anticollision. Since we sucessfully selected the card before,
             // we can directly select the card again
-            if (iso14443a_fast_select_card(mattyrun_uid, cascade_levels) == 0) {
+            prof_start(prof_select);
+            int selres = iso14443a_fast_select_card(mattyrun_uid, cascade_levels);
+            prof_stop(prof_select);
+            if (selres == 0) {
+                prof_count(prof_select, 1);
                 --i; // try same key once again
                 --selectRetries;
                 if (selectRetries > 0) {
@@ -209,7 +217,9 @@ static int saMifareChkKeys(uint8_t const blockNo, uint8_t const keyType, bool co
 
         selectRetries = 16;
 
+        prof_start(prof_auth);
         authres = mifare_classic_auth(pcs, mattyrun_cuid, blockNo, keyType, mfKey, AUTH_FIRST);
+        prof_stop(prof_auth);
         if (authres) {
             uint8_t dummy_answer = 0;
             ReaderTransmit(&dummy_answer, 1, NULL);
@@ -100,6 +100,7 @@
  * - This module will terminate if the trace buffer is full (and save data to flash).
  * - Like normal sniffing mode, timestamps overflow after 5 min 16 sec.
  *   However, the trace buffer is sequential, so will be in the correct order.
+ * - Traces are stored in the compact format, `trace load` expands them.
  *
  * Mostly this is based on existing code, i.e. the hf_1*sniff modules and dankarmulti.
  * I find it handy to have multiprotocol sniffing on the go, and prefer separate trace
@@ -330,6 +331,7 @@ void RunMod(void) {
         }
     }
 
+    set_tracing_compact(true);
     switch (sniff_protocol) {
         case HF_UNISNIFF_PROTO_14A:
             SniffIso14443a(0);
@@ -338,17 +340,19 @@ void RunMod(void) {
             SniffIso14443b();
             break;
         case HF_UNISNIFF_PROTO_15:
-            SniffIso15693(0, NULL, false);
+            SniffIso15693(0, NULL, false, false);
             break;
         case HF_UNISNIFF_PROTO_ICLASS:
-            SniffIso15693(0, NULL, true);
+            SniffIso15693(0, NULL, true, false);
             break;
         default:
             Dbprintf("No protocol selected, exiting...");
+            set_tracing_compact(false);
             BigBuf_free();
             LEDsoff();
             return;
     }
+    set_tracing_compact(false);
 
     Dbprintf("Stopped sniffing");
     SpinDelay(200);
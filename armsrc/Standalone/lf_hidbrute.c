@@ -38,6 +38,7 @@
 #include "dbprint.h"
 #include "ticks.h"
 #include "lfops.h"
+#include "profiler.h"
 
 #define OPTS 3
 
@@ -171,6 +172,8 @@ void RunMod(void) {
 
                 Dbprintf("[=] HID brute - starting decrementing card number");
 
+                int prof_sim = prof_slot("sim");
+
                 while (cardnum > 0) {
 
                     // Needed for exiting from proxbrute when button is pressed
@@ -194,7 +197,9 @@ void RunMod(void) {
                     // Print actual code to brute
                     Dbprintf("[=] TAG ID: %x%08x (%d) - FC: %u - Card: %u", high[selected], low[selected], (low[selected] >> 1) & 0xFFFF, fc, cardnum);
 
+                    prof_start(prof_sim);
                     CmdHIDsimTAGEx(0, high[selected], low[selected], 0, 1, 50000);
+                    prof_stop(prof_sim);
                 }
 
                 cardnum = original_cardnum;
@@ -222,7 +227,9 @@ void RunMod(void) {
                     // Print actual code to brute
                     Dbprintf("[=] TAG ID: %x%08x (%d) - FC: %u - Card: %u", high[selected], low[selected], (low[selected] >> 1) & 0xFFFF, fc, cardnum);
 
+                    prof_start(prof_sim);
                     CmdHIDsimTAGEx(0, high[selected], low[selected], 0, 1, 50000);
+                    prof_stop(prof_sim);
                 }
 
                 DbpString("[=] done bruteforcing");
@@ -51,6 +51,9 @@
 #include "hfsnoop.h"
 #include "lfops.h"
 #include "lfsampling.h"
+#include "profiler.h"
+#include "rftiming.h"
+#include "presence.h"
 #include "lfzx.h"
 #include "mifarecmd.h"
 #include "mifaredesfire.h"
@@ -62,11 +65,13 @@
 #include "ticks.h"
 #include "commonutil.h"
 #include "crc16.h"
+#include "crc32.h"
 #include "protocols.h"
 #include "mifareutil.h"
 #include "sam_picopass.h"
 #include "sam_seos.h"
 #include "sam_mfc.h"
+#include "lz4.h"
 
 #ifdef WITH_LCD
 #include "LCD_disabled.h"
@@ -252,6 +257,36 @@ static uint32_t MeasureAntennaTuningLfData(void) {
     return (MAX_ADC_LF_VOLTAGE * (SumAdc(ADC_CHAN_LF, 32) >> 1)) >> 14;
 }
 
+// Measures at a fixed rate and pushes 'per_packet' measurements at a time, without
+// waiting for the client to ask.  Ends with an empty PM3_EOPABORTED reply.
+static void MeasureAntennaTuningLfStream(uint8_t per_packet) {
+
+    lf_tune_stream_t pkt = {0};
+    pkt.count = MAX(1, MIN(per_packet, LF_TUNE_STREAM_MAX));
+
+    StartCountUS();
+    uint32_t next = GetCountUS();
+
+    for (;;) {
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            break;
+        }
+
+        for (uint8_t i = 0; i < pkt.count; i++) {
+            while ((int32_t)(GetCountUS() - next) < 0) {}
+            next += LF_TUNE_STREAM_INTERVAL_US;
+            pkt.mv[i] = MeasureAntennaTuningLfData();
+        }
+
+        reply_ng(CMD_MEASURE_ANTENNA_TUNING_LF, PM3_SUCCESS, (uint8_t *)&pkt, sizeof(pkt) - sizeof(pkt.mv) + (pkt.count * sizeof(uint32_t)));
+        pkt.seq++;
+    }
+
+    reply_ng(CMD_MEASURE_ANTENNA_TUNING_LF, PM3_EOPABORTED, NULL, 0);
+}
+
 void print_stack_usage(void) {
     for (uint32_t *p = _stack_start; ; ++p) {
         if (*p != 0xdeadbeef) {
@@ -517,6 +552,7 @@ static void SendCapabilities(void) {
     capabilities.via_fpc = g_reply_via_fpc;
     capabilities.via_usb = g_reply_via_usb;
     capabilities.bigbuf_size = BigBuf_get_size();
+    capabilities.jumbo_size = PM3_CMD_DATA_SIZE_JUMBO;
     capabilities.baudrate = 0; // no real baudrate for USB-CDC
 #ifdef WITH_FPC_USART
     if (g_reply_via_fpc)
@@ -843,6 +879,94 @@ void ListenReaderField(uint8_t limit) {
         }
     }
 }
+// Send a memory area to the client as independent LZ4 blocks, one per frame.
+// Each block covers a multiple of PM3_CMD_DATA_SIZE bytes so the client can keep
+// tracking chunks for retransmits. Areas which don't compress are sent raw with raw_cmd.
+static void send_lz4_download(uint16_t raw_cmd, const uint8_t *mem, uint32_t numofbytes, uint32_t raw_arg2) {
+    char out[PM3_CMD_DATA_SIZE];
+    uint32_t offset = 0;
+
+    while (offset < numofbytes) {
+        int left = numofbytes - offset;
+        int srclen = left;
+        int clen = LZ4_compress_destSize((const char *)mem + offset, out, &srclen, sizeof(out));
+
+        if (srclen < left) {
+            int aligned = srclen - (srclen % PM3_CMD_DATA_SIZE);
+            if (aligned == 0) {
+                clen = 0;
+            } else if (aligned != srclen) {
+                srclen = aligned;
+                clen = LZ4_compress_default((const char *)mem + offset, out, srclen, sizeof(out));
+            }
+        }
+
+        if (clen > 0 && clen < srclen) {
+            reply_old(CMD_DOWNLOADED_LZ4, offset, clen, srclen, out, clen);
+            offset += srclen;
+        } else {
+            uint32_t len = MIN((uint32_t)left, PM3_CMD_DATA_SIZE);
+            reply_old(raw_cmd, offset, len, raw_arg2, mem + offset, len);
+            offset += len;
+        }
+    }
+}
+
+static void PacketReceived(PacketCommandNG *packet);
+
+// Runs the NG sub-commands packed in a CMD_BATCH payload, their replies are sent back packed in CMD_BATCH frames
+static void RunBatch(const PacketCommandNG *packet) {
+    // static, PacketReceived is re-entered from here
+    static PacketCommandNG sub;
+
+    if (packet->length < sizeof(batch_hdr_t)) {
+        reply_ng(CMD_BATCH, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    uint8_t flags = packet->data.asBytes[0];
+    uint16_t pos = sizeof(batch_hdr_t);
+    uint8_t executed = 0;
+    int8_t status = PM3_SUCCESS;
+
+    batch_capture_begin();
+
+    while (pos < packet->length) {
+        batch_cmd_t entry;
+        if (packet->length - pos < sizeof(batch_cmd_t)) {
+            status = PM3_EINVARG;
+            break;
+        }
+        memcpy(&entry, packet->data.asBytes + pos, sizeof(batch_cmd_t));
+        pos += sizeof(batch_cmd_t);
+
+        // no nesting
+        if (entry.cmd == CMD_BATCH || entry.len > packet->length - pos) {
+            status = PM3_EINVARG;
+            break;
+        }
+
+        memset(&sub, 0, sizeof(sub));
+        sub.magic = COMMANDNG_PREAMBLE_MAGIC;
+        sub.crc = COMMANDNG_POSTAMBLE_MAGIC;
+        sub.cmd = entry.cmd;
+        sub.length = entry.len;
+        sub.ng = true;
+        memcpy(sub.data.asBytes, packet->data.asBytes + pos, entry.len);
+        pos += entry.len;
+
+        batch_capture_next(executed);
+        PacketReceived(&sub);
+        executed++;
+
+        if ((flags & BATCH_FLAG_STOP_ON_ERROR) && batch_capture_status() != PM3_SUCCESS) {
+            break;
+        }
+    }
+
+    batch_capture_end(executed, status);
+}
+
 static void PacketReceived(PacketCommandNG *packet) {
     /*
     if (packet->ng) {
@@ -855,6 +979,10 @@ static void PacketReceived(PacketCommandNG *packet) {
     switch (packet->cmd) {
         case CMD_BREAK_LOOP:
             break;
+        case CMD_BATCH: {
+            RunBatch(packet);
+            break;
+        }
         case CMD_QUIT_SESSION: {
             g_reply_via_fpc = false;
             g_reply_via_usb = false;
@@ -981,6 +1109,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             CmdHIDsimTAG(payload->hi2, payload->hi, payload->lo, payload->longFMT, 1);
             break;
         }
+        case CMD_LF_HID_BRUTE: {
+            CmdHIDBrute((lf_hid_brute_t *)packet->data.asBytes, true);
+            break;
+        }
         case CMD_LF_FSK_SIMULATE: {
             lf_fsksim_t *payload = (lf_fsksim_t *)packet->data.asBytes;
             CmdFSKsimTAG(payload->fchigh, payload->fclow, payload->separator, payload->clock, packet->length - sizeof(lf_fsksim_t), payload->data, true);
@@ -1051,12 +1183,17 @@ static void PacketReceived(PacketCommandNG *packet) {
         case CMD_LF_SIMULATE: {
             LED_A_ON();
             struct p {
-                uint16_t len;
+                uint32_t len;
                 uint16_t gap;
+                bool packed;    // one bit per sample in bigbuf
             } PACKED;
             struct p *payload = (struct p *)packet->data.asBytes;
             // length, start gap, led control
-            SimulateTagLowFrequency(payload->len, payload->gap, true);
+            if (payload->packed) {
+                SimulateTagLowFrequencyPacked(payload->len, payload->gap, true);
+            } else {
+                SimulateTagLowFrequency(payload->len, payload->gap, true);
+            }
             reply_ng(CMD_LF_SIMULATE, PM3_EOPABORTED, NULL, 0);
             LED_A_OFF();
             break;
@@ -1103,6 +1240,26 @@ static void PacketReceived(PacketCommandNG *packet) {
             T55xx_ChkPwds(packet->data.asBytes[0] & 0xff, true);
             break;
         }
+        case CMD_LF_T55XX_BRUTE: {
+            T55xx_BrutePwds(packet->data.asBytes, true);
+            break;
+        }
+        case CMD_LF_T55XX_CLONE: {
+            T55xx_CloneVerify(packet->data.asBytes, true);
+            break;
+        }
+        case CMD_LF_T55XX_CLONE_QUEUE: {
+            T55xx_CloneQueue(packet->data.asBytes, true);
+            break;
+        }
+        case CMD_LF_T55XX_PROBE: {
+            T55xxProbe((t55xx_probe_t *)packet->data.asBytes, true);
+            break;
+        }
+        case CMD_LF_T55XX_DUMP: {
+            T55xxDump((t55xx_dump_t *)packet->data.asBytes, true);
+            break;
+        }
         case CMD_LF_PCF7931_READ: {
             ReadPCF7931(true);
             break;
@@ -1128,12 +1285,7 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
         case CMD_LF_EM4X_BF: {
-            struct p {
-                uint32_t start_pwd;
-                uint32_t n;
-            } PACKED;
-            struct p *payload = (struct p *) packet->data.asBytes;
-            EM4xBruteforce(payload->start_pwd, payload->n, true);
+            EM4xBruteforce(packet->data.asBytes, true);
             break;
         }
         case CMD_LF_EM4X_READWORD: {
@@ -1173,6 +1325,12 @@ static void PacketReceived(PacketCommandNG *packet) {
             reply_ng(CMD_LF_AWID_WATCH, res, NULL, 0);
             break;
         }
+        case CMD_LF_WATCH: {
+            lf_watch_t *payload = (lf_watch_t *)packet->data.asBytes;
+            int res = lf_watch(payload->protocols, payload->holdoff, true);
+            reply_ng(CMD_LF_WATCH, res, NULL, 0);
+            break;
+        }
         case CMD_LF_VIKING_CLONE: {
             struct p {
                 bool Q5;
@@ -1191,6 +1349,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             Cotag(payload->mode, true);
             break;
         }
+        case CMD_LF_INDALA_READ: {
+            IndalaRead((lf_indala_read_t *)packet->data.asBytes, true);
+            break;
+        }
 #endif
 
 #ifdef WITH_HITAG
@@ -1392,7 +1554,7 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
         case CMD_HF_ISO15693_SNIFF: {
-            SniffIso15693(0, NULL, false);
+            SniffIso15693(0, NULL, false, false);
             reply_ng(CMD_HF_ISO15693_SNIFF, PM3_SUCCESS, NULL, 0);
             break;
         }
@@ -1409,6 +1571,21 @@ static void PacketReceived(PacketCommandNG *packet) {
             BruteforceIso15693Afi(payload->flags);
             break;
         }
+        case CMD_HF_ISO15693_INVENTORY: {
+            iso15_inventory_t *payload = (iso15_inventory_t *)packet->data.asBytes;
+            InventoryIso15693(payload);
+            break;
+        }
+        case CMD_HF_ISO15693_READ_BLOCKS: {
+            iso15_blocks_t *payload = (iso15_blocks_t *)packet->data.asBytes;
+            ReadBlocksIso15693(payload);
+            break;
+        }
+        case CMD_HF_ISO15693_WRITE_BLOCKS: {
+            iso15_blocks_t *payload = (iso15_blocks_t *)packet->data.asBytes;
+            WriteBlocksIso15693(payload);
+            break;
+        }
         case CMD_HF_ISO15693_READER: {
             ReaderIso15693(NULL);
             break;
@@ -1535,6 +1712,11 @@ static void PacketReceived(PacketCommandNG *packet) {
             DisablePrivacySlixIso15693(payload->pwd);
             break;
         }
+        case CMD_HF_ISO15693_SLIX_BRUTE: {
+            iso15_slix_brute_t *payload = (iso15_slix_brute_t *) packet->data.asBytes;
+            BruteforceSlixPassword(payload);
+            break;
+        }
         case CMD_HF_ISO15693_SLIX_ENABLE_PRIVACY: {
             struct p {
                 uint8_t pwd[4];
@@ -1589,6 +1771,11 @@ static void PacketReceived(PacketCommandNG *packet) {
             LegicRfWriter(payload->offset, payload->len, payload->iv, payload->data);
             break;
         }
+        case CMD_HF_LEGIC_WRITER_EML: {
+            legic_packet_t *payload = (legic_packet_t *) packet->data.asBytes;
+            LegicRfWriterEml(payload->offset, payload->len, payload->iv);
+            break;
+        }
         case CMD_HF_LEGIC_READER: {
             legic_packet_t *payload = (legic_packet_t *) packet->data.asBytes;
             LegicRfReader(payload->offset, payload->len, payload->iv);
@@ -1620,6 +1807,11 @@ static void PacketReceived(PacketCommandNG *packet) {
             read_14b_st_block(payload->blockno);
             break;
         }
+        case CMD_HF_ISO14443B_DUMP: {
+            iso14b_dump_t *payload = (iso14b_dump_t *) packet->data.asBytes;
+            iso14443b_dump(payload);
+            break;
+        }
         case CMD_HF_ISO14443B_SNIFF: {
             SniffIso14443b();
             reply_ng(CMD_HF_ISO14443B_SNIFF, PM3_SUCCESS, NULL, 0);
@@ -1645,6 +1837,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             felica_sendraw(packet);
             break;
         }
+        case CMD_HF_FELICA_READ_SERVICES: {
+            felica_read_services((felica_read_services_t *) packet->data.asBytes);
+            break;
+        }
         case CMD_HF_FELICALITE_SIMULATE: {
             struct p {
                 uint8_t uid[8];
@@ -1727,6 +1923,22 @@ static void PacketReceived(PacketCommandNG *packet) {
             ReaderIso14443a(packet);
             break;
         }
+        case CMD_HF_TOPAZ_READER: {
+            TopazReader((hf_tagstream_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_ISO14443A_APDU_BATCH: {
+            ReaderIso14443aApduBatch(packet->data.asBytes, packet->length);
+            break;
+        }
+        case CMD_HF_ISO14443A_CUIDS: {
+            ReaderIso14443aCollectUIDs((iso14a_cuids_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_ISO14443A_RAW_FRAMES: {
+            ReaderIso14443aRawFrames(packet->data.asBytes, packet->length);
+            break;
+        }
 #ifdef WITH_SMARTCARD
         case CMD_HF_ISO14443A_EMV_SIMULATE: {
             struct p {
@@ -1751,11 +1963,29 @@ static void PacketReceived(PacketCommandNG *packet) {
                 uint8_t rats[20];
                 bool ulc_p1;
                 bool ulc_p2;
+                uint8_t rotate_after;
+                uint8_t uid_step;
+                uint16_t uid_count;
+                uint8_t uids[];
             } PACKED;
             struct p *payload = (struct p *) packet->data.asBytes;
-            SimulateIso14443aTag(payload->tagtype, payload->flags, payload->uid,
-                                 payload->exitAfter, payload->rats, sizeof(payload->rats),
-                                 payload->ulc_p1, payload->ulc_p2);  // ## Simulate iso14443a tag - pass tag type & UID
+
+            // rotating identities, UID list or counting up from the UID
+            iso14a_sim_rotate_t rotate = {0};
+            if (packet->length >= sizeof(struct p) && payload->uid_count > 1) {
+                rotate.count = payload->uid_count;
+                rotate.step = payload->uid_step;
+                rotate.after = payload->rotate_after;
+                if (packet->length > sizeof(struct p)) {
+                    uint8_t uidlen = IS_FLAG_UID_IN_DATA(payload->flags, 10) ? 10 : IS_FLAG_UID_IN_DATA(payload->flags, 7) ? 7 : 4;
+                    rotate.uids = payload->uids;
+                    rotate.count = MIN(rotate.count, (packet->length - sizeof(struct p)) / uidlen);
+                }
+            }
+
+            SimulateIso14443aTagEx(payload->tagtype, payload->flags, payload->uid,
+                                   payload->exitAfter, payload->rats, sizeof(payload->rats),
+                                   payload->ulc_p1, payload->ulc_p2, &rotate);  // ## Simulate iso14443a tag - pass tag type & UID
             break;
         }
         case CMD_HF_ISO14443A_SIM_AID: {
@@ -1849,6 +2079,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareUReadCard(packet->oldarg[0], packet->oldarg[1], packet->oldarg[2], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MIFAREU_WRITE_PAGES: {
+            MifareUWritePages((mfu_write_pages_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_MIFAREU_CHKKEYS: {
+            MifareUChkKeys((mfu_chk_keys_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFAREUC_SETPWD: {
             MifareUSetPwd(packet->oldarg[0], packet->data.asBytes);
             break;
@@ -1988,6 +2226,14 @@ static void PacketReceived(PacketCommandNG *packet) {
                 payload->blockwidth = MIFARE_BLOCK_SIZE;
             }
 
+            if (packet->jumbo) {
+                if ((payload->blockcnt * payload->blockwidth) > (packet->length - sizeof(struct p))) {
+                    break;
+                }
+                emlSetMem_xt(packet->jumbo + sizeof(struct p), payload->blockno, payload->blockcnt, payload->blockwidth);
+                break;
+            }
+
             emlSetMem_xt(payload->data, payload->blockno, payload->blockcnt, payload->blockwidth);
             break;
         }
@@ -2018,11 +2264,33 @@ static void PacketReceived(PacketCommandNG *packet) {
             BigBuf_free_keep_EM();
             break;
         }
+        case CMD_HF_MIFARE_EML_CRC: {
+            // same bitstream as CMD_HF_MIFARE_EML_MEMSET, so the memory checked is the memory written to
+            FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+            struct p {
+                uint16_t offset;
+                uint16_t len;
+            } PACKED;
+            struct p *payload = (struct p *) packet->data.asBytes;
+            uint8_t *mem = BigBuf_get_EM_addr();
+            if (mem == NULL || (uint32_t)payload->offset + payload->len > CARD_MEMORY_SIZE) {
+                reply_ng(CMD_HF_MIFARE_EML_CRC, PM3_EOUTOFBOUND, NULL, 0);
+                break;
+            }
+            uint8_t crc[4] = {0};
+            crc32_ex(mem + payload->offset, payload->len, crc);
+            reply_ng(CMD_HF_MIFARE_EML_CRC, PM3_SUCCESS, crc, sizeof(crc));
+            break;
+        }
         case CMD_HF_MIFARE_EML_LOAD: {
             mfc_eload_t *payload = (mfc_eload_t *) packet->data.asBytes;
             MifareECardLoadExt(payload->sectorcnt, payload->keytype, payload->key);
             break;
         }
+        case CMD_HF_MIFARE_DUMP: {
+            MifareDumpCard((mf_dump_req_t *) packet->data.asBytes);
+            break;
+        }
         // Gen1a / 1b - "magic Chinese" card
         case CMD_HF_MIFARE_CSETBL: {
             MifareCSetBlock(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
@@ -2077,6 +2345,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareG4WriteBlk(payload->blockno, payload->pwd, payload->data, payload->workFlags);
             break;
         }
+        case CMD_HF_MIFARE_G4_WRITE_BLOCKS: {
+            MifareG4WriteBlocks((mfg4_write_blocks_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_G4_GDM_WRBL: {
             struct p {
                 uint8_t blockno;
@@ -2130,6 +2402,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareSendCommand(packet->data.asBytes);
             break;
         }
+        case CMD_HF_DESFIRE_CHK: {
+            MifareDesfireChk(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_NACK_DETECT: {
             DetectNACKbug();
             break;
@@ -2180,6 +2456,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             ReadThinFilm();
             break;
         }
+        case CMD_HF_THINFILM_READER: {
+            ThinfilmReader((hf_tagstream_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_HF_THINFILM_SIMULATE: {
             SimulateThinFilm(packet->data.asBytes, packet->length);
             break;
@@ -2194,7 +2474,9 @@ static void PacketReceived(PacketCommandNG *packet) {
                 uint8_t jam_search_string[];
             } PACKED;
             struct p *payload = (struct p *) packet->data.asBytes;
-            SniffIClass(payload->jam_search_len, payload->jam_search_string);
+            // the client sends a two byte search string, a flags byte may follow
+            bool stream = (packet->length > 3) && (packet->data.asBytes[3] & 0x01);
+            SniffIClass(payload->jam_search_len, payload->jam_search_string, stream);
             reply_ng(CMD_HF_ICLASS_SNIFF, PM3_SUCCESS, NULL, 0);
             break;
         }
@@ -2228,9 +2510,34 @@ static void PacketReceived(PacketCommandNG *packet) {
                 uint8_t data[];
             } PACKED;
             struct p *payload = (struct p *) packet->data.asBytes;
+            if (packet->jumbo) {
+                if (payload->len > (packet->length - sizeof(struct p))) {
+                    break;
+                }
+                emlSet(packet->jumbo + sizeof(struct p), payload->offset, payload->len);
+                break;
+            }
             emlSet(payload->data, payload->offset, payload->len);
             break;
         }
+        case CMD_HF_ICLASS_EML_CRC: {
+            // same bitstream as CMD_HF_ICLASS_EML_MEMSET, so the memory checked is the memory written to
+            FpgaDownloadAndGo(FPGA_BITSTREAM_HF_15);
+            struct p {
+                uint16_t offset;
+                uint16_t len;
+            } PACKED;
+            struct p *payload = (struct p *) packet->data.asBytes;
+            uint8_t *mem = BigBuf_get_EM_addr();
+            if (mem == NULL || (uint32_t)payload->offset + payload->len > CARD_MEMORY_SIZE) {
+                reply_ng(CMD_HF_ICLASS_EML_CRC, PM3_EOUTOFBOUND, NULL, 0);
+                break;
+            }
+            uint8_t crc[4] = {0};
+            crc32_ex(mem + payload->offset, payload->len, crc);
+            reply_ng(CMD_HF_ICLASS_EML_CRC, PM3_SUCCESS, crc, sizeof(crc));
+            break;
+        }
         case CMD_HF_ICLASS_WRITEBL: {
             iClass_WriteBlock(packet->data.asBytes);
             break;
@@ -2272,9 +2579,16 @@ static void PacketReceived(PacketCommandNG *packet) {
                 uint32_t triggersToSkip;
                 uint8_t skipMode;
                 uint8_t skipRatio;
+                uint8_t stream;
             } PACKED;
             struct p *payload = (struct p *) packet->data.asBytes;
 
+            // the samples go straight to the host, there is no reply
+            if (payload->stream) {
+                HfSniffStream(payload->samplesToSkip, payload->triggersToSkip, payload->skipMode, payload->skipRatio);
+                break;
+            }
+
             uint16_t len = 0;
             int res = HfSniff(payload->samplesToSkip, payload->triggersToSkip, &len, payload->skipMode, payload->skipRatio);
 
@@ -2543,6 +2857,9 @@ static void PacketReceived(PacketCommandNG *packet) {
                     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
                     reply_ng(CMD_MEASURE_ANTENNA_TUNING_LF, PM3_SUCCESS, NULL, 0);
                     break;
+                case 4: // stream, data[1] is measurements per packet
+                    MeasureAntennaTuningLfStream(packet->data.asBytes[1]);
+                    break;
                 default:
                     reply_ng(CMD_MEASURE_ANTENNA_TUNING_LF, PM3_EINVARG, NULL, 0);
                     break;
@@ -2573,6 +2890,13 @@ static void PacketReceived(PacketCommandNG *packet) {
             // arg2 = BigBuf tracelen
             //Dbprintf("transfer to client parameters: %" PRIu32 " | %" PRIu32 " | %" PRIu32, startidx, numofbytes, packet->oldarg[2]);
 
+            if (packet->oldarg[2] & DOWNLOAD_FLAG_LZ4) {
+                send_lz4_download(CMD_DOWNLOADED_BIGBUF, &mem[startidx], numofbytes, BigBuf_get_traceLen());
+                reply_mix(CMD_ACK, 1, 0, BigBuf_get_traceLen(), NULL, 0);
+                LED_B_OFF();
+                break;
+            }
+
             for (size_t offset = 0; offset < numofbytes; offset += PM3_CMD_DATA_SIZE) {
                 size_t len = MIN((numofbytes - offset), PM3_CMD_DATA_SIZE);
                 int result = reply_old(CMD_DOWNLOADED_BIGBUF, offset, len, BigBuf_get_traceLen(), &mem[startidx + offset], len);
@@ -2613,10 +2937,17 @@ static void PacketReceived(PacketCommandNG *packet) {
             }
             // ensure len bytes copied won't go past end of bigbuf
             uint16_t len = MIN(BigBuf_get_size() - payload->offset, sizeof(payload->data));
+            const uint8_t *src = payload->data;
+
+            // jumbo frame, payload is bigger than what fits in packet->data
+            if (packet->jumbo) {
+                len = MIN(BigBuf_get_size() - payload->offset, packet->length - 3);
+                src = packet->jumbo + 3;
+            }
 
             uint8_t *mem = BigBuf_get_addr();
 
-            memcpy(mem + payload->offset, &payload->data, len);
+            memcpy(mem + payload->offset, src, len);
             reply_ng(CMD_LF_UPLOAD_SIM_SAMPLES, PM3_SUCCESS, NULL, 0);
             break;
         }
@@ -2629,7 +2960,14 @@ static void PacketReceived(PacketCommandNG *packet) {
 
             // arg0 = startindex
             // arg1 = length bytes to transfer
-            // arg2 = RFU
+            // arg2 = flags
+
+            if (packet->oldarg[2] & DOWNLOAD_FLAG_LZ4) {
+                send_lz4_download(CMD_DOWNLOADED_EML_BIGBUF, mem + startidx, numofbytes, 0);
+                reply_mix(CMD_ACK, 1, 0, 0, 0, 0);
+                LED_B_OFF();
+                break;
+            }
 
             for (size_t i = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE) {
                 size_t len = MIN((numofbytes - i), PM3_CMD_DATA_SIZE);
@@ -2731,27 +3069,34 @@ static void PacketReceived(PacketCommandNG *packet) {
 
             uint32_t size = packet->oldarg[1];
 
-            uint8_t *buff = BigBuf_calloc(size);
-            if (buff == NULL) {
-                if (g_dbglevel >= DBG_DEBUG) Dbprintf("Failed to allocate memory");
-                // Trigger a finish downloading signal with an PM3_EMALLOC
-                reply_ng(CMD_SPIFFS_DOWNLOAD, PM3_EMALLOC, NULL, 0);
-            } else {
-                rdv40_spiffs_read_as_filetype((char *)filename, (uint8_t *)buff, size, RDV40_SPIFFS_SAFETY_SAFE);
-                // arg0 = filename
-                // arg1 = size
-                // arg2 = RFU
-
-                for (size_t i = 0; i < size; i += PM3_CMD_DATA_SIZE) {
-                    size_t len = MIN((size - i), PM3_CMD_DATA_SIZE);
-                    int result = reply_old(CMD_SPIFFS_DOWNLOADED, i, len, 0, buff + i, len);
-                    if (result != PM3_SUCCESS)
-                        Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
+            // read and sent one chunk at a time, files do not need to fit in BigBuf
+            uint8_t buff[PM3_CMD_DATA_SIZE];
+            rdv40_spiffs_reader_t reader;
+            if (rdv40_spiffs_reader_open(&reader, (char *)filename) != SPIFFS_OK) {
+                if (g_dbglevel >= DBG_DEBUG) Dbprintf("Failed to open file");
+                reply_ng(CMD_SPIFFS_DOWNLOAD, PM3_EFILE, NULL, 0);
+                LED_B_OFF();
+                break;
+            }
+
+            // arg0 = offset
+            // arg1 = len
+            // arg2 = RFU
+            size = MIN(size, reader.size);
+            for (size_t i = 0; i < size; i += PM3_CMD_DATA_SIZE) {
+                size_t len = MIN((size - i), PM3_CMD_DATA_SIZE);
+                if (rdv40_spiffs_reader_next(&reader, buff, len) != (int32_t)len) {
+                    Dbprintf("spiffs read failed ::  | bytes between %d - %d (%d)", i, i + len, len);
+                    break;
                 }
-                // Trigger a finish downloading signal with an ACK frame
-                reply_ng(CMD_SPIFFS_DOWNLOAD, PM3_SUCCESS, NULL, 0);
-                BigBuf_free();
+                int result = reply_old(CMD_SPIFFS_DOWNLOADED, i, len, 0, buff, len);
+                if (result != PM3_SUCCESS)
+                    Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
             }
+            rdv40_spiffs_reader_close(&reader);
+
+            // Trigger a finish downloading signal with an ACK frame
+            reply_ng(CMD_SPIFFS_DOWNLOAD, PM3_SUCCESS, NULL, 0);
             LED_B_OFF();
             break;
         }
@@ -2936,7 +3281,8 @@ static void PacketReceived(PacketCommandNG *packet) {
         case CMD_FLASHMEM_DOWNLOAD: {
 
             LED_B_ON();
-            uint8_t *mem = BigBuf_calloc(PM3_CMD_DATA_SIZE);
+            // two buffers, the next chunk is read from flash while the current one goes out over usb
+            uint8_t *mem[2] = { BigBuf_calloc(PM3_CMD_DATA_SIZE), BigBuf_calloc(PM3_CMD_DATA_SIZE) };
             uint32_t startidx = packet->oldarg[0];
             uint32_t numofbytes = packet->oldarg[1];
             // arg0 = startindex
@@ -2947,14 +3293,23 @@ static void PacketReceived(PacketCommandNG *packet) {
                 break;
             }
 
-            for (size_t i = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE) {
+            Flash_CheckBusy(BUSY_TIMEOUT);
+            if (numofbytes) {
+                Flash_ReadDataStart(startidx, mem[0], MIN(numofbytes, PM3_CMD_DATA_SIZE));
+            }
+
+            for (size_t i = 0, n = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE, n ^= 1) {
                 size_t len = MIN((numofbytes - i), PM3_CMD_DATA_SIZE);
-                Flash_CheckBusy(BUSY_TIMEOUT);
-                bool isok = Flash_ReadDataCont(startidx + i, mem, len);
+                bool isok = (Flash_ReadDataWait() == len);
                 if (isok == false)
                     Dbprintf("reading flash memory failed ::  | bytes between %d - %d", i, len);
 
-                isok = reply_old(CMD_FLASHMEM_DOWNLOADED, i, len, 0, mem, len);
+                size_t next = i + PM3_CMD_DATA_SIZE;
+                if (next < numofbytes) {
+                    Flash_ReadDataStart(startidx + next, mem[n ^ 1], MIN((numofbytes - next), PM3_CMD_DATA_SIZE));
+                }
+
+                isok = reply_old(CMD_FLASHMEM_DOWNLOADED, i, len, 0, mem[n], len);
                 if (isok != 0)
                     Dbprintf("transfer to client failed ::  | bytes between %d - %d", i, len);
             }
@@ -3037,6 +3392,24 @@ static void PacketReceived(PacketCommandNG *packet) {
                 SendStatus(CONN_SPEED_TEST_MIN_TIME_DEFAULT);
             break;
         }
+        case CMD_PROFILE: {
+            // arg: reset the counters after sending them
+            prof_send(packet->length == 1 && packet->data.asBytes[0]);
+            break;
+        }
+        case CMD_RF_TIMING: {
+            if (packet->length != sizeof(rft_request_t)) {
+                reply_ng(CMD_RF_TIMING, PM3_EINVARG, NULL, 0);
+                break;
+            }
+            rft_send((rft_request_t *)packet->data.asBytes);
+            break;
+        }
+        case CMD_POLL: {
+            poll_params_t *payload = (poll_params_t *) packet->data.asBytes;
+            PresencePoll(payload, true);
+            break;
+        }
         case CMD_TIA: {
 
             while ((AT91C_BASE_PMC->PMC_MCFR & AT91C_CKGR_MAINRDY) == 0);       // Wait for MAINF value to become available...
@@ -72,10 +72,27 @@ int reply_old(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const v
     return PM3_SUCCESS;
 }
 
+// Replies collected while running a CMD_BATCH
+static struct {
+    bool active;
+    uint8_t index;
+    int8_t status;
+    uint16_t len;
+    uint8_t buf[PM3_CMD_DATA_SIZE];
+} batch_capture;
+
+static int batch_capture_flush(bool final, uint8_t executed, int8_t status);
+static int batch_capture_add(uint16_t cmd, int8_t status, const uint8_t *data, size_t len, bool ng);
+
 static int reply_ng_internal(uint16_t cmd, int8_t status, uint8_t reason, const uint8_t *data, size_t len, bool ng) {
     PacketResponseNGRaw txBufferNG;
     size_t txBufferNGLen;
 
+    // debug prints and WTX are not part of the batch results, they go out straight away
+    if (batch_capture.active && cmd != CMD_DEBUG_PRINT_STRING && cmd != CMD_DEBUG_PRINT_INTEGERS && cmd != CMD_DEBUG_PRINT_BYTES && cmd != CMD_WTX) {
+        return batch_capture_add(cmd, status, data, len, ng);
+    }
+
     // Compose the outgoing command frame
     txBufferNG.pre.magic = RESPONSENG_PREAMBLE_MAGIC;
     txBufferNG.pre.cmd = cmd;
@@ -161,9 +178,133 @@ int reply_reason(uint16_t cmd, int8_t status, int8_t reason, const uint8_t *data
     return reply_ng_internal(cmd, status, reason, data, len, true);
 }
 
+static int batch_capture_flush(bool final, uint8_t executed, int8_t status) {
+    batch_reply_hdr_t *hdr = (batch_reply_hdr_t *)batch_capture.buf;
+    hdr->final = final;
+    hdr->executed = executed;
+
+    bool active = batch_capture.active;
+    batch_capture.active = false;
+    int res = reply_ng_internal(CMD_BATCH, status, PM3_REASON_UNKNOWN, batch_capture.buf, batch_capture.len, true);
+    batch_capture.active = active;
+
+    batch_capture.len = sizeof(batch_reply_hdr_t);
+    return res;
+}
+
+static int batch_capture_add(uint16_t cmd, int8_t status, const uint8_t *data, size_t len, bool ng) {
+    if (len > BATCH_REPLY_DATA_MAX) {
+        len = BATCH_REPLY_DATA_MAX;
+        status = PM3_EOVFLOW;
+    }
+
+    int res = PM3_SUCCESS;
+    if (batch_capture.len + sizeof(batch_reply_t) + len > sizeof(batch_capture.buf)) {
+        res = batch_capture_flush(false, 0, PM3_SUCCESS);
+    }
+
+    batch_reply_t entry = {
+        .index = batch_capture.index,
+        .cmd = cmd,
+        .status = status,
+        .ng = ng,
+        .len = len,
+    };
+    memcpy(batch_capture.buf + batch_capture.len, &entry, sizeof(batch_reply_t));
+    batch_capture.len += sizeof(batch_reply_t);
+    if (data && len) {
+        memcpy(batch_capture.buf + batch_capture.len, data, len);
+        batch_capture.len += len;
+    }
+
+    if (status != PM3_SUCCESS) {
+        batch_capture.status = status;
+    }
+    return res;
+}
+
+void batch_capture_begin(void) {
+    batch_capture.active = true;
+    batch_capture.index = 0;
+    batch_capture.status = PM3_SUCCESS;
+    batch_capture.len = sizeof(batch_reply_hdr_t);
+    // empty frame right away, lets the client tell an old firmware from a long batch
+    batch_capture_flush(false, 0, PM3_SUCCESS);
+}
+
+void batch_capture_next(uint8_t index) {
+    batch_capture.index = index;
+    batch_capture.status = PM3_SUCCESS;
+}
+
+int8_t batch_capture_status(void) {
+    return batch_capture.status;
+}
+
+int batch_capture_end(uint8_t executed, int8_t status) {
+    int res = batch_capture_flush(true, executed, status);
+    batch_capture.active = false;
+    return res;
+}
+
+// Commands allowed to use jumbo frames, they must read their payload from rx->jumbo
+static bool is_jumbo_cmd(uint16_t cmd) {
+    switch (cmd) {
+        case CMD_HF_MIFARE_EML_MEMSET:
+        case CMD_HF_ICLASS_EML_MEMSET:
+        case CMD_LF_UPLOAD_SIM_SAMPLES:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Jumbo frames are received here, preamble included for the CRC check
+static struct {
+    PacketCommandNGPreamble pre;
+    uint8_t data[PM3_CMD_DATA_SIZE_JUMBO];
+} PACKED jumbo_raw;
+
+static int receive_jumbo(PacketCommandNG *rx, const PacketCommandNGPreamble *pre, uint32_t read_ng(uint8_t *data, size_t len)) {
+
+    uint16_t length = pre->length;
+
+    memcpy(&jumbo_raw.pre, pre, sizeof(PacketCommandNGPreamble));
+
+    size_t bytes = read_ng(jumbo_raw.data, length);
+    if (bytes != length) {
+        return PM3_EIO;
+    }
+
+    PacketCommandNGPostamble post;
+    bytes = read_ng((uint8_t *)&post, sizeof(PacketCommandNGPostamble));
+    if (bytes != sizeof(PacketCommandNGPostamble)) {
+        return PM3_EIO;
+    }
+
+    rx->crc = post.crc;
+    if (rx->crc != COMMANDNG_POSTAMBLE_MAGIC) {
+        uint8_t first, second;
+        compute_crc(CRC_14443_A, (uint8_t *)&jumbo_raw, sizeof(PacketCommandNGPreamble) + length, &first, &second);
+        if ((first << 8) + second != rx->crc) {
+            return PM3_EIO;
+        }
+    }
+
+    // commands parse their header from rx->data as usual
+    memcpy(rx->data.asBytes, jumbo_raw.data, PM3_CMD_DATA_SIZE);
+    rx->length = length;
+    rx->jumbo = jumbo_raw.data;
+
+    g_reply_via_usb = true;
+    g_reply_via_fpc = false;
+    return PM3_SUCCESS;
+}
+
 static int receive_ng_internal(PacketCommandNG *rx, uint32_t read_ng(uint8_t *data, size_t len), bool usb, bool fpc) {
 
     PacketCommandNGRaw rx_raw;
+    rx->jumbo = NULL;
     size_t bytes = read_ng((uint8_t *)&rx_raw.pre, sizeof(PacketCommandNGPreamble));
 
     if (bytes == 0) {
@@ -182,6 +323,9 @@ static int receive_ng_internal(PacketCommandNG *rx, uint32_t read_ng(uint8_t *da
 
     if (rx->magic == COMMANDNG_PREAMBLE_MAGIC) { // New style NG command
         if (length > PM3_CMD_DATA_SIZE) {
+            if (usb && rx->ng && (length <= PM3_CMD_DATA_SIZE_JUMBO) && is_jumbo_cmd(rx->cmd)) {
+                return receive_jumbo(rx, &rx_raw.pre, read_ng);
+            }
             return PM3_EOVFLOW;
         }
 
@@ -33,5 +33,11 @@ int reply_mix(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const v
 int reply_reason(uint16_t cmd, int8_t status, int8_t reason, const uint8_t *data, size_t len);
 int receive_ng(PacketCommandNG *rx);
 
+// CMD_BATCH support, NG replies sent between begin and end are packed into CMD_BATCH frames
+void batch_capture_begin(void);
+void batch_capture_next(uint8_t index);
+int8_t batch_capture_status(void);
+int batch_capture_end(uint8_t executed, int8_t status);
+
 #endif // _PROXMARK_CMD_H_
 
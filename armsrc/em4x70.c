@@ -1108,6 +1108,14 @@ static int set_byte(uint8_t *target, uint16_t value) {
     return c;
 }
 
+static void send_brute_progress(uint16_t cmd, int status, uint8_t address, uint32_t next_key) {
+    em4x70_brute_progress_t progress = {
+        .block = address,
+        .next_key = { (next_key >> 8) & 0xFF, next_key & 0xFF },
+    };
+    reply_ng(cmd, status, (uint8_t *)&progress, sizeof(progress));
+}
+
 static int bruteforce(const uint8_t address, const uint8_t *rnd, const uint8_t *frnd, uint16_t start_key, uint8_t *response) {
 
     uint8_t auth_resp[3] = {0};
@@ -1158,6 +1166,11 @@ static int bruteforce(const uint8_t address, const uint8_t *rnd, const uint8_t *
             DPRINTF_ALWAYS(("Trying: %04X", k));
         }
 
+        // Let the client keep track of where to resume from
+        if ((k % EM4X70_BRUTE_PROGRESS_INTERVAL) == 0) {
+            send_brute_progress(CMD_LF_EM4X70_BRUTE_PROGRESS, PM3_SUCCESS, address, k);
+        }
+
         // Due to performance reason, we only try it once. Therefore you need a very stable RFID communcation.
         if (authenticate(temp_rnd, frnd, auth_resp) == PM3_SUCCESS) {
             DPRINTF_INFO(("Authentication success with rnd: %02X%02X%02X%02X%02X%02X%02X", temp_rnd[0], temp_rnd[1], temp_rnd[2], temp_rnd[3], temp_rnd[4], temp_rnd[5], temp_rnd[6]));
@@ -1168,6 +1181,8 @@ static int bruteforce(const uint8_t address, const uint8_t *rnd, const uint8_t *
 
         if (BUTTON_PRESS() || data_available()) {
             DPRINTF_ALWAYS(("EM4x70 Bruteforce Interrupted at key %04X", k));
+            response[0] = ((k + 1) >> 8) & 0xFF;
+            response[1] = (k + 1) & 0xFF;
             return PM3_EOPABORTED;
         }
     }
@@ -1577,7 +1592,12 @@ void em4x70_brute(const em4x70_data_t *etd, bool ledcontrol) {
 
     StopTicks();
     lf_finalize(ledcontrol);
-    reply_ng(CMD_LF_EM4X70_BRUTE, status, response, sizeof(response));
+    if (status == PM3_EOPABORTED) {
+        // where to resume from
+        send_brute_progress(CMD_LF_EM4X70_BRUTE, status, etd->address, (response[0] << 8) | response[1]);
+    } else {
+        reply_ng(CMD_LF_EM4X70_BRUTE, status, response, sizeof(response));
+    }
 }
 
 void em4x70_write_pin(const em4x70_data_t *etd, bool ledcontrol) {
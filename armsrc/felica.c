@@ -617,6 +617,238 @@ void felica_sendraw(const PacketCommandNG *c) {
     return;
 }
 
+// Builds a Read Without Encryption frame from the service list, starting at block *bi of service *si.
+// Services of known size share a frame, a service of unknown size gets one of its own.
+// On return *si / *bi point past the last block list element.
+static uint16_t BuildRwe(const uint8_t *idm, const felica_service_read_t *services, uint8_t count,
+                         uint8_t *si, uint16_t *bi, uint8_t max_blocks, uint8_t *nblocks) {
+
+    uint16_t codes[FELICA_RDBLK_MAX_SERVICES];
+    struct {
+        uint8_t svc;
+        uint16_t block;
+    } elem[FELICA_RDBLK_MAX_BLOCKS];
+
+    uint8_t ns = 0, nb = 0;
+    uint8_t s = *si;
+    uint16_t b = *bi;
+
+    while (nb < max_blocks && s < count && ns < FELICA_RDBLK_MAX_SERVICES) {
+
+        bool known = (services[s].count != 0);
+        if (known == false && nb) {
+            break;
+        }
+
+        uint16_t limit = (known) ? services[s].count : FELICA_READ_UNKNOWN_BLOCKS;
+        if (b < limit) {
+            codes[ns] = services[s].code;
+            while (nb < max_blocks && b < limit) {
+                elem[nb].svc = ns;
+                elem[nb].block = b++;
+                nb++;
+            }
+            ns++;
+        }
+
+        if (known == false || b < limit) {
+            break;
+        }
+        s++;
+        b = 0;
+    }
+
+    *si = s;
+    *bi = b;
+    *nblocks = nb;
+    if (nb == 0) {
+        return 0;
+    }
+
+    uint16_t c = 0;
+    frameSpace[c++] = 0xb2;
+    frameSpace[c++] = 0x4d;
+    c++; // set length later
+    frameSpace[c++] = FELICA_RDBLK_REQ;
+    memcpy(frameSpace + c, idm, 8);
+    c += 8;
+
+    frameSpace[c++] = ns;
+    for (uint8_t i = 0; i < ns; i++) {
+        frameSpace[c++] = codes[i] & 0xFF;
+        frameSpace[c++] = codes[i] >> 8;
+    }
+
+    frameSpace[c++] = nb;
+    for (uint8_t i = 0; i < nb; i++) {
+        if (elem[i].block >= 256) {
+            frameSpace[c++] = elem[i].svc;
+            frameSpace[c++] = elem[i].block & 0xFF; // 3-byte element, block number little endian
+            frameSpace[c++] = elem[i].block >> 8;
+        } else {
+            frameSpace[c++] = 0x80 | elem[i].svc;
+            frameSpace[c++] = elem[i].block;
+        }
+    }
+
+    frameSpace[2] = c - 2;
+    AddCrc(frameSpace + 2, c - 2);
+    return c + 2;
+}
+
+// Sends the frame in frameSpace, the block data is left in FelicaFrame
+static int felica_rwe_exchange(uint16_t len, uint8_t nblocks) {
+
+    TransmitFor18092_AsReader(frameSpace, len, NULL, 1, 0);
+
+    if (WaitForFelicaReply(1024) == false) {
+        return PM3_ETIMEOUT;
+    }
+
+    const uint8_t *fb = FelicaFrame.framebytes;
+    if (fb[3] != FELICA_RDBLK_ACK) {
+        return PM3_EWRONGANSWER;
+    }
+
+    if (FelicaFrame.crc_ok == false) {
+        return PM3_ECRC;
+    }
+
+    // status flag 1 / 2,  the card refused the block list
+    if (fb[12] != 0 || fb[13] != 0) {
+        return PM3_ESOFT;
+    }
+
+    if (fb[14] != nblocks || FelicaFrame.len < 15 + (nblocks * FELICA_BLOCK_SIZE)) {
+        return PM3_ELENGTH;
+    }
+    return PM3_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Read Without Encryption over a list of services in one field session.
+// Block list elements of several services are packed into each frame, up to
+// max_blocks. When the card refuses a frame the batch is halved until a single
+// block is left. A refused single block ends a service of unknown size, and is
+// skipped for the others, then the largest frame seen to work is used again.
+// Blocks are streamed to the client as felica_block_t, the final reply carries
+// felica_read_services_resp_t.
+//-----------------------------------------------------------------------------
+void felica_read_services(const felica_read_services_t *p) {
+
+    clear_trace();
+    set_tracing(true);
+
+    iso18092_setup(FPGA_HF_ISO18092_FLAG_READER | FPGA_HF_ISO18092_FLAG_NOMOD);
+
+    felica_read_services_resp_t resp = {0};
+    resp.count = MIN(p->count, FELICA_READ_MAX_SERVICES);
+    resp.max_blocks = MAX(1, MIN(p->max_blocks, FELICA_RDBLK_MAX_BLOCKS));
+
+    felica_card_select_t card;
+    if (felica_select_card(&card)) {
+        reply_ng(CMD_HF_FELICA_READ_SERVICES, PM3_ECARDEXCHANGE, NULL, 0);
+        felica_reset_frame_mode();
+        return;
+    }
+
+    felica_block_t *out = (felica_block_t *)BigBuf_calloc(PM3_CMD_DATA_SIZE);
+    const uint8_t out_max = PM3_CMD_DATA_SIZE / sizeof(felica_block_t);
+    uint8_t out_n = 0;
+
+    int res = PM3_SUCCESS;
+    uint8_t si = 0;
+    uint16_t bi = 0;
+    uint8_t fails = 0;
+    uint8_t good = 0;
+
+    while (si < resp.count) {
+
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        uint8_t next_si = si;
+        uint16_t next_bi = bi;
+        uint8_t nb = 0;
+        uint16_t len = BuildRwe(card.IDm, p->services, resp.count, &next_si, &next_bi, resp.max_blocks, &nb);
+        if (nb == 0) {
+            break;
+        }
+
+        res = felica_rwe_exchange(len, nb);
+
+        if (res == PM3_ETIMEOUT || res == PM3_ECRC || res == PM3_EWRONGANSWER) {
+            // a bad frame, try again before giving up on the card
+            if (++fails > 3) {
+                break;
+            }
+            continue;
+        }
+        fails = 0;
+
+        if (res != PM3_SUCCESS) {
+
+            if (nb > 1) {
+                resp.max_blocks = nb / 2;
+                continue;
+            }
+
+            // a single refused block, it says nothing about the frame size the card takes
+            if (p->services[si].count == 0) {
+                resp.blocks[si] = bi;
+                next_si = si + 1;
+                next_bi = 0;
+            }
+            si = next_si;
+            bi = next_bi;
+            resp.max_blocks = (good) ? good : MAX(1, MIN(p->max_blocks, FELICA_RDBLK_MAX_BLOCKS));
+            res = PM3_SUCCESS;
+            continue;
+        }
+
+        good = MAX(good, nb);
+
+        // collect the blocks in the order they were requested
+        const uint8_t *data = FelicaFrame.framebytes + 15;
+        uint8_t s = si;
+        uint16_t b = bi;
+        for (uint8_t i = 0; i < nb; i++) {
+
+            uint16_t limit = (p->services[s].count) ? p->services[s].count : FELICA_READ_UNKNOWN_BLOCKS;
+            if (b >= limit) {
+                s++;
+                b = 0;
+            }
+
+            out[out_n].code = p->services[s].code;
+            out[out_n].block = b;
+            memcpy(out[out_n].data, data + (i * FELICA_BLOCK_SIZE), FELICA_BLOCK_SIZE);
+            resp.blocks[s] = b + 1;
+
+            if (++out_n == out_max) {
+                reply_ng(CMD_HF_FELICA_READ_SERVICES, PM3_SUCCESS, (uint8_t *)out, out_n * sizeof(felica_block_t));
+                out_n = 0;
+            }
+            b++;
+        }
+
+        si = next_si;
+        bi = next_bi;
+    }
+
+    if (out_n) {
+        reply_ng(CMD_HF_FELICA_READ_SERVICES, PM3_SUCCESS, (uint8_t *)out, out_n * sizeof(felica_block_t));
+    }
+
+    reply_ng(CMD_HF_FELICA_READ_SERVICES, res, (uint8_t *)&resp, sizeof(resp));
+
+    felica_reset_frame_mode();
+}
+
 void felica_sniff(uint32_t samplesToSkip, uint32_t triggersToSkip) {
 
     clear_trace();
@@ -20,8 +20,10 @@
 
 #include "common.h"
 #include "cmd.h"
+#include "iso18.h"
 
 void felica_sendraw(const PacketCommandNG *c);
+void felica_read_services(const felica_read_services_t *p);
 void felica_sniff(uint32_t samplesToSkip, uint32_t triggersToSkip);
 void felica_sim_lite(const uint8_t *uid);
 void felica_dump_lite_s(void);
@@ -239,21 +239,82 @@ static int bitstream_target_to_index(FPGA_config bitstream_target) {
     return bitstream_index_map[bitstream_target];
 }
 
+//----------------------------------------------------------------------------
+// Skip n bytes of the combined stream. Already inflated bytes are stepped over
+// a whole ring buffer at a time, only a refill goes through the byte reader.
+//----------------------------------------------------------------------------
+static int skip_fpga_combined_stream(lz4_streamp_t compressed_fpga_stream, uint8_t *output_buffer, uint32_t n) {
+    while (n) {
+        uint32_t avail = (output_buffer + FPGA_RING_BUFFER_BYTES) - fpga_image_ptr;
+        if (avail == 0) {
+            int res = get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
+            if (res < 0) {
+                return res;
+            }
+            n--;
+            continue;
+        }
+
+        uint32_t step = MIN(avail, n);
+        fpga_image_ptr += step;
+        uncompressed_bytes_cnt += step;
+        n -= step;
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// Move the combined stream to the next byte belonging to bitstream_target
+//----------------------------------------------------------------------------
+static int seek_fpga_stream(int bitstream_target, lz4_streamp_t compressed_fpga_stream, uint8_t *output_buffer) {
+    uint32_t stride = FPGA_INTERLEAVE_SIZE * g_fpga_bitstream_num;
+    uint32_t start = bitstream_target_to_index(bitstream_target) * FPGA_INTERLEAVE_SIZE;
+    uint32_t pos = uncompressed_bytes_cnt % stride;
+
+    // skip undesired data belonging to other bitstream_targets
+    if (pos < start) {
+        return skip_fpga_combined_stream(compressed_fpga_stream, output_buffer, start - pos);
+    }
+    if (pos >= start + FPGA_INTERLEAVE_SIZE) {
+        return skip_fpga_combined_stream(compressed_fpga_stream, output_buffer, stride - pos + start);
+    }
+    return 0;
+}
+
 //----------------------------------------------------------------------------
 // Undo the interleaving of several FPGA config files. FPGA config files
 // are combined into one big file:
 // 288 bytes from FPGA file 1, followed by 288 bytes from FGPA file 2, etc.
 //----------------------------------------------------------------------------
 static int get_from_fpga_stream(int bitstream_target, lz4_streamp_t compressed_fpga_stream, uint8_t *output_buffer) {
-    int bitstream_index = bitstream_target_to_index(bitstream_target);
-    while ((uncompressed_bytes_cnt / FPGA_INTERLEAVE_SIZE) % g_fpga_bitstream_num != bitstream_index) {
-        // skip undesired data belonging to other bitstream_targets
-        get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
+    int res = seek_fpga_stream(bitstream_target, compressed_fpga_stream, output_buffer);
+    if (res < 0) {
+        return res;
     }
 
     return get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
 }
 
+//----------------------------------------------------------------------------
+// Skip n bytes of bitstream_target, one interleave chunk at a time
+//----------------------------------------------------------------------------
+static int skip_fpga_stream(int bitstream_target, lz4_streamp_t compressed_fpga_stream, uint8_t *output_buffer, uint32_t n) {
+    while (n) {
+        int res = seek_fpga_stream(bitstream_target, compressed_fpga_stream, output_buffer);
+        if (res < 0) {
+            return res;
+        }
+
+        uint32_t step = MIN(FPGA_INTERLEAVE_SIZE - (uncompressed_bytes_cnt % FPGA_INTERLEAVE_SIZE), n);
+        res = skip_fpga_combined_stream(compressed_fpga_stream, output_buffer, step);
+        if (res < 0) {
+            return res;
+        }
+        n -= step;
+    }
+    return 0;
+}
+
 //----------------------------------------------------------------------------
 // Initialize decompression of the respective (HF or LF) FPGA stream
 //----------------------------------------------------------------------------
@@ -298,12 +359,18 @@ static void DownloadFPGA_byte(uint8_t w) {
 static void DownloadFPGA(int bitstream_target, int FpgaImageLen, lz4_streamp_t compressed_fpga_stream, uint8_t *output_buffer) {
     int i = 0;
 #if !defined XC3
+    // only a cold FPGA needs time for its supplies to settle
+    bool powered = (AT91C_BASE_PIOA->PIO_PSR & GPIO_FPGA_ON) && (AT91C_BASE_PIOA->PIO_ODSR & GPIO_FPGA_ON);
     AT91C_BASE_PIOA->PIO_OER = GPIO_FPGA_ON;
     AT91C_BASE_PIOA->PIO_PER = GPIO_FPGA_ON;
     HIGH(GPIO_FPGA_ON);  // ensure everything is powered on
+#else
+    bool powered = (downloaded_bitstream != FPGA_BITSTREAM_UNKNOWN);
 #endif
 
-    SpinDelay(50);
+    if (powered == false) {
+        SpinDelay(50);
+    }
 
     LED_D_ON();
 
@@ -347,19 +414,19 @@ static void DownloadFPGA(int bitstream_target, int FpgaImageLen, lz4_streamp_t c
     HIGH(GPIO_MOSI);
 #endif
 
-    // enter FPGA configuration mode
+    // enter FPGA configuration mode, PROGRAM only has to be held low for a fraction of a microsecond
     LOW(GPIO_FPGA_NPROGRAM);
-    SpinDelay(50);
+    SpinDelayUs(100);
     HIGH(GPIO_FPGA_NPROGRAM);
 
-    i = 100000;
-    // wait for FPGA ready to accept data signal
-    while ((i) && (!(AT91C_BASE_PIOA->PIO_PDSR & GPIO_FPGA_NINIT))) {
-        i--;
+    // wait for FPGA ready to accept data signal, INIT goes high once the configuration memory is cleared
+    // (at most 50ms, ticks aren't running yet on the first load at boot)
+    for (i = 0; (i < 500) && !(AT91C_BASE_PIOA->PIO_PDSR & GPIO_FPGA_NINIT); i++) {
+        SpinDelayUs(100);
     }
 
     // crude error indicator, leave both red LEDs on and return
-    if (i == 0) {
+    if (!(AT91C_BASE_PIOA->PIO_PDSR & GPIO_FPGA_NINIT)) {
         LED_C_ON();
         LED_D_ON();
         return;
@@ -516,20 +583,45 @@ void FpgaDownloadAndGo(int bitstream_target) {
 
     bool verbose = (g_dbglevel > 3);
 
-    // make sure that we have enough memory to decompress
-    BigBuf_free();
-    BigBuf_Clear_ext(verbose);
+    // Decompress in a scratch arena below what is allocated, so the trace, samples and
+    // emulator memory survive switching between the LF and HF images.
+    int arena = BigBuf_arena_begin("fpga load");
+    uint8_t *output_buffer = (arena < 0) ? NULL : BigBuf_malloc(FPGA_RING_BUFFER_BYTES);
+
+    if (output_buffer == NULL) {
+        // make sure that we have enough memory to decompress, first by dropping allocations
+        // and only if the trace is in the way as well by clearing all of BigBuf
+        BigBuf_arena_end(arena);
+        BigBuf_free();
+        if (BigBuf_get_hi() - BigBuf_get_traceLen() < FPGA_RING_BUFFER_BYTES) {
+            BigBuf_Clear_ext(verbose);
+        }
+        arena = BigBuf_arena_begin("fpga load");
+        output_buffer = BigBuf_malloc(FPGA_RING_BUFFER_BYTES);
+    }
 
     lz4_stream_t compressed_fpga_stream;
     LZ4_streamDecode_t lz4StreamDecode_body = {{ 0 }};
     compressed_fpga_stream.lz4StreamDecode = &lz4StreamDecode_body;
-    uint8_t *output_buffer = BigBuf_malloc(FPGA_RING_BUFFER_BYTES);
 
-    if (!reset_fpga_stream(bitstream_target, &compressed_fpga_stream, output_buffer))
+    if (!reset_fpga_stream(bitstream_target, &compressed_fpga_stream, output_buffer)) {
+        BigBuf_arena_end(arena);
         return;
+    }
+
+    // fpga_compress indexed the bitstream body at build time, go straight there.
+    // Images built without the index still get their header sections parsed.
+    const FPGA_VERSION_INFORMATION *info = &g_fpga_version_information[bitstream_target_to_index(bitstream_target)];
+    uint32_t bitstream_length = 0;
+    bool found;
+    if (info->bitstream_length && info->bitstream_offset >= FPGA_BITSTREAM_FIXED_HEADER_SIZE) {
+        bitstream_length = MIN(info->bitstream_length, 300 * 1024);
+        found = (skip_fpga_stream(bitstream_target, &compressed_fpga_stream, output_buffer, info->bitstream_offset - FPGA_BITSTREAM_FIXED_HEADER_SIZE) == 0);
+    } else {
+        found = bitparse_find_section(bitstream_target, 'e', &bitstream_length, &compressed_fpga_stream, output_buffer);
+    }
 
-    uint32_t bitstream_length;
-    if (bitparse_find_section(bitstream_target, 'e', &bitstream_length, &compressed_fpga_stream, output_buffer)) {
+    if (found) {
         DownloadFPGA(bitstream_target, bitstream_length, &compressed_fpga_stream, output_buffer);
         downloaded_bitstream = bitstream_target;
     }
@@ -543,9 +635,8 @@ void FpgaDownloadAndGo(int bitstream_target) {
     // turn off antenna
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
 
-    // free eventually allocated BigBuf memory
-    BigBuf_free();
-    BigBuf_Clear_ext(false);
+    // give back the decompression buffer only
+    BigBuf_arena_end(arena);
 }
 
 //-----------------------------------------------------------------------------
@@ -622,7 +713,7 @@ void SetAdcMuxFor(uint32_t whichGpio) {
 
 void Fpga_print_status(void) {
     DbpString(_CYAN_("Current FPGA image"));
-    Dbprintf("  mode.................... %s", g_fpga_version_information[bitstream_target_to_index(downloaded_bitstream)]);
+    Dbprintf("  mode.................... %s", g_fpga_version_information[bitstream_target_to_index(downloaded_bitstream)].versionString);
 }
 
 int FpgaGetCurrent(void) {
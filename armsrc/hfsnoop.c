@@ -25,6 +25,7 @@
 #include "fpga.h"
 #include "appmain.h"
 #include "cmd.h"
+#include "usb_cdc.h"
 
 static void RAMFUNC optimizedSniff(uint16_t *dest, uint16_t dsize) {
     while (dsize > 0) {
@@ -85,12 +86,7 @@ static void RAMFUNC skipSniff(uint8_t *dest, uint16_t dsize, uint8_t skipMode, u
     }
 }
 
-int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len, uint8_t skipMode, uint8_t skipRatio) {
-    BigBuf_free();
-    BigBuf_Clear_ext(false);
-
-    Dbprintf("Skipping first %d sample pairs, Skipping %d triggers", samplesToSkip, triggersToSkip);
-
+static void hf_sniff_setup(void) {
     LED_D_ON();
 
     FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
@@ -105,12 +101,21 @@ int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len, uint
 
     FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_SNIFF);
     SpinDelay(100);
+}
 
-    *len = BigBuf_max_traceLen();
-    uint8_t *mem = BigBuf_malloc(*len);
+static void hf_sniff_off(void) {
+    //Resetting Frame mode (First set in fpgaloader.c)
+    AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(8) | AT91C_SSC_MSBF | SSC_FRAME_MODE_WORDS_PER_TRANSFER(0);
+    LED_D_OFF();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+}
 
+// Waits for the trigger, then skips samples. Returns true when the button was pressed,
+// a USB command stops the waiting too and sets cancelled.
+static bool hf_sniff_trigger(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *r, bool *cancelled) {
     uint32_t trigger_cnt = 0;
-    uint16_t r = 0, interval = 0;
+    uint16_t interval = 0;
+    *cancelled = false;
 
     bool pressed = false;
     while (pressed == false) {
@@ -118,8 +123,10 @@ int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len, uint
 
         // cancel w usb command.
         if (interval == 2000) {
-            if (data_available())
+            if (data_available()) {
+                *cancelled = true;
                 break;
+            }
 
             interval = 0;
         } else {
@@ -128,12 +135,12 @@ int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len, uint
 
         // check if trigger is reached
         if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
-            r = (uint16_t)AT91C_BASE_SSC->SSC_RHR;
+            *r = (uint16_t)AT91C_BASE_SSC->SSC_RHR;
 
-            r = MAX(r & 0xFF, r >> 8);
+            *r = MAX(*r & 0xFF, *r >> 8);
 
             // 180 (0xB4) arbitrary value to see if a strong RF field is near.
-            if (r > 180) {
+            if (*r > 180) {
 
                 if (++trigger_cnt > triggersToSkip) {
                     break;
@@ -153,6 +160,26 @@ int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len, uint
                 samplesToSkip--;
             }
         }
+    }
+    return pressed;
+}
+
+int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len, uint8_t skipMode, uint8_t skipRatio) {
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+
+    Dbprintf("Skipping first %d sample pairs, Skipping %d triggers", samplesToSkip, triggersToSkip);
+
+    hf_sniff_setup();
+
+    *len = BigBuf_max_traceLen();
+    uint8_t *mem = BigBuf_malloc(*len);
+
+    uint16_t r = 0;
+    bool cancelled;
+    bool pressed = hf_sniff_trigger(samplesToSkip, triggersToSkip, &r, &cancelled);
+
+    if (pressed == false) {
 
         if (skipMode == 0)
             optimizedSniff((uint16_t *)mem, *len);
@@ -165,14 +192,155 @@ int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len, uint
         }
     }
 
-    //Resetting Frame mode (First set in fpgaloader.c)
-    AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(8) | AT91C_SSC_MSBF | SSC_FRAME_MODE_WORDS_PER_TRANSFER(0);
-    LED_D_OFF();
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    hf_sniff_off();
     BigBuf_free();
     return (pressed) ? PM3_EOPABORTED : PM3_SUCCESS;
 }
 
+typedef struct {
+    uint8_t fill;           // bytes in the current USB packet
+    bool blocked;           // the packet is full, the USB didn't take it yet
+    uint32_t drop_since;    // samples dropped since the last packet
+    uint32_t samples;
+    uint32_t dropped;
+} hf_stream_t;
+
+static void RAMFUNC hf_stream_push(hf_stream_t *s, uint8_t v) {
+    if (s->blocked) {
+        s->drop_since++;
+        s->dropped++;
+        return;
+    }
+
+    if (s->fill == 0) {
+        uint32_t d = MIN(s->drop_since, 0xFFFFFF);
+        async_usb_write_pushByte(HF_STREAM_MAGIC_DATA);
+        async_usb_write_pushByte(d & 0xFF);
+        async_usb_write_pushByte((d >> 8) & 0xFF);
+        async_usb_write_pushByte((d >> 16) & 0xFF);
+        s->drop_since = 0;
+        s->fill = HF_STREAM_HDR_LEN;
+    }
+
+    async_usb_write_pushByte(v);
+    s->samples++;
+    if (++s->fill == HF_STREAM_PACKET_LEN) {
+        s->fill = 0;
+        s->blocked = (async_usb_write_requestWrite() == false);
+    }
+}
+
+static void hf_stream_push_u32(uint32_t v) {
+    for (uint8_t i = 0; i < 4; i++) {
+        async_usb_write_pushByte((v >> (8 * i)) & 0xFF);
+    }
+}
+
+// pads the last packet and sends the end packet, see HF_STREAM_MAGIC_END
+static int hf_stream_finish(hf_stream_t *s) {
+    if (s->fill) {
+        while (s->fill < HF_STREAM_PACKET_LEN) {
+            async_usb_write_pushByte(0);
+            s->fill++;
+        }
+        s->fill = 0;
+        s->blocked = true;
+    }
+
+    while (s->blocked) {
+        if (usb_check() == false) {
+            return PM3_EIO;
+        }
+        s->blocked = (async_usb_write_requestWrite() == false);
+    }
+
+    async_usb_write_pushByte(HF_STREAM_MAGIC_END);
+    async_usb_write_pushByte(0);
+    async_usb_write_pushByte(0);
+    async_usb_write_pushByte(0);
+    hf_stream_push_u32(s->samples);
+    hf_stream_push_u32(s->dropped);
+    return async_usb_write_stop();
+}
+
+/**
+ * Like HfSniff, but the samples go straight to the host until the button is pressed or
+ * the host sends a command. Samples arriving while the USB is busy are dropped and counted.
+ * Nothing else may be sent over USB meanwhile, so there is no reply at the end.
+**/
+int HfSniffStream(uint32_t samplesToSkip, uint32_t triggersToSkip, uint8_t skipMode, uint8_t skipRatio) {
+    int res = async_usb_write_start();
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    hf_sniff_setup();
+
+    uint16_t r = 0;
+    bool cancelled;
+    bool pressed = hf_sniff_trigger(samplesToSkip, triggersToSkip, &r, &cancelled);
+
+    hf_stream_t s = {0};
+    uint32_t accum = (skipMode == HF_SNOOP_SKIP_MIN) ? 0xFFFFFFFF : 0;
+    uint8_t ratioindx = 0;
+    uint16_t checked = 0;
+
+    while (pressed == false && cancelled == false) {
+
+        if (++checked == 4000) {
+            checked = 0;
+            WDT_HIT();
+            pressed = BUTTON_PRESS();
+            cancelled = data_available();
+        }
+
+        if (s.blocked) {
+            s.blocked = (async_usb_write_requestWrite() == false);
+        }
+
+        if ((AT91C_BASE_SSC->SSC_SR & AT91C_SSC_RXRDY) == 0) {
+            continue;
+        }
+
+        uint16_t val = (uint16_t)(AT91C_BASE_SSC->SSC_RHR);
+
+        // same reductions as skipSniff()
+        switch (skipMode) {
+            case HF_SNOOP_SKIP_NONE:
+                hf_stream_push(&s, val & 0xFF);
+                hf_stream_push(&s, val >> 8);
+                continue;
+            case HF_SNOOP_SKIP_MAX:
+                accum = MAX(accum, MAX(val & 0xFF, val >> 8));
+                break;
+            case HF_SNOOP_SKIP_MIN:
+                accum = MIN(accum, MIN(val & 0xFF, val >> 8));
+                break;
+            case HF_SNOOP_SKIP_AVG:
+                accum += (val & 0xFF) + (val & 0xFF);
+                break;
+            default: // HF_SNOOP_SKIP_DROP and the rest
+                if (ratioindx == 0) {
+                    accum = val & 0xFF;
+                }
+                break;
+        }
+
+        if (++ratioindx >= skipRatio) {
+            if (skipMode == HF_SNOOP_SKIP_AVG && skipRatio > 0) {
+                accum /= (skipRatio * 2);
+            }
+            hf_stream_push(&s, MIN(accum, 0xFF));
+            accum = (skipMode == HF_SNOOP_SKIP_MIN) ? 0xFFFFFFFF : 0;
+            ratioindx = 0;
+        }
+    }
+
+    res = hf_stream_finish(&s);
+    hf_sniff_off();
+    return (res == PM3_SUCCESS && pressed) ? PM3_EOPABORTED : res;
+}
+
 void HfPlotDownload(void) {
 
     tosend_t *ts = get_tosend();
@@ -26,5 +26,6 @@
 #define HF_SNOOP_SKIP_AVG  (4)
 
 int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len, uint8_t skipMode, uint8_t skipRatio);
+int HfSniffStream(uint32_t samplesToSkip, uint32_t triggersToSkip, uint8_t skipMode, uint8_t skipRatio);
 void HfPlotDownload(void);
 #endif
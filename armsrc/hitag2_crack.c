@@ -273,6 +273,15 @@ typedef struct {
     uint8_t e_ext_cmd[2080];
 } PACKED lf_hitag_crack2_t;
 
+// hitag2crack_send_keystream lets the client start on the key with the keystream so far,
+// while we keep extending it
+static void hitag2crack_send_keystream(lf_hitag_crack_keystream_t *ks, const uint8_t *keybits, int kslen) {
+    ks->bits = kslen;
+    memset(ks->data, 0, sizeof(ks->data));
+    binarray2hex(keybits, kslen, ks->data);
+    reply_ng(CMD_LF_HITAG2_CRACK_KEYSTREAM, PM3_SUCCESS, (uint8_t *)ks, sizeof(lf_hitag_crack_keystream_t) - sizeof(ks->data) + ((kslen + 7) / 8));
+}
+
 // hitag2_crack implements the first crack algorithm described in the paper,
 // Gone In 360 Seconds by Verdult, Garcia and Balasch.
 // response is a multi-line text response containing the 8 pages of the cracked tag
@@ -341,6 +350,7 @@ void ht2_crack2(uint8_t *nrar_hex) {
 
     uint8_t *e_response = BigBuf_calloc(32);
     lf_hitag_crack2_t *c2 = (lf_hitag_crack2_t *)BigBuf_calloc(sizeof(lf_hitag_crack2_t));
+    lf_hitag_crack_keystream_t *ks = (lf_hitag_crack_keystream_t *)BigBuf_calloc(sizeof(lf_hitag_crack_keystream_t));
 
     g_logging = false;
     LEDsoff();
@@ -359,6 +369,7 @@ void ht2_crack2(uint8_t *nrar_hex) {
 
     hex2binarray_n((char *)c2->uid, (char *)uid_hex, 4);
     hex2binarray_n((char *)c2->nrar, (char *)nrar_hex, 8);
+    memcpy(ks->uid, uid_hex, sizeof(ks->uid));
 
     DbpString("looking for encrypted command");
 
@@ -384,7 +395,8 @@ void ht2_crack2(uint8_t *nrar_hex) {
     int kslen = 40;
     int res = PM3_SUCCESS;
 
-    while (kslen < 2048 && BUTTON_PRESS() == false) {
+    // the client stops us once it has the key
+    while (kslen < 2048 && BUTTON_PRESS() == false && data_available() == false) {
 
         hitag2crack_xor(c2->e_ext_cmd,      read_p0_cmd, c2->keybits, 10);
         hitag2crack_xor(c2->e_ext_cmd + 10, read_p0_cmd, c2->keybits + 10, 10);
@@ -392,6 +404,7 @@ void ht2_crack2(uint8_t *nrar_hex) {
         hitag2crack_xor(c2->e_ext_cmd + 30, read_p0_cmd, c2->keybits + 30, 10);
 
         Dbprintf("Recovered " _YELLOW_("%4i") " bits of keystream", kslen);
+        hitag2crack_send_keystream(ks, c2->keybits, kslen);
 
         // Get UID
         if (ht2_read_uid(NULL, true, false, true) != PM3_SUCCESS) {
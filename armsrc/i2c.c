@@ -187,19 +187,22 @@ static bool WaitSCL_L(void) {
     return WaitSCL_L_delay(5000);
 }
 
-// Wait max 1800ms or until SCL goes LOW.
+// Wait max 1200ms or until SCL goes LOW.
 // It timeout reading response from card
 // Which ever comes first
+// SCL is sampled every I2C_DELAY_1CLK (3.07us) instead of every 1ms,
+// a fast answering card no longer costs up to a millisecond per APDU.
 static bool WaitSCL_L_timeout(void) {
-    volatile uint32_t delay = 1200;
-    while (delay--) {
+    uint32_t start = GetTicks();
+    // 1.5 ticks / us
+    while (GetTicksDelta(start) < (1200 * 1500)) {
         // exit on SCL LOW
         if (SCL_read == false)
             return true;
 
-        WaitMS(1);
+        I2C_DELAY_1CLK;
     }
-    return (delay == 0);
+    return false;
 }
 
 static bool I2C_Start(void) {
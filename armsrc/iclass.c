@@ -70,8 +70,8 @@ uint8_t get_pagemap(const picopass_hdr_t *hdr) {
 // a `sniffer' for iClass communication
 // Both sides of communication!
 //=============================================================================
-void SniffIClass(uint8_t jam_search_len, uint8_t *jam_search_string) {
-    SniffIso15693(jam_search_len, jam_search_string, true);
+void SniffIClass(uint8_t jam_search_len, uint8_t *jam_search_string, bool stream) {
+    SniffIso15693(jam_search_len, jam_search_string, true, stream);
 }
 
 static void rotateCSN(const uint8_t *original_csn, uint8_t *rotated_csn) {
@@ -177,6 +177,11 @@ void iclass_simulate(uint8_t sim_type, uint8_t num_csns, bool send_reply, uint8_
         int i = 0;
         for (; i < num_csns && i * EPURSE_MAC_SIZE + 8 < PM3_CMD_DATA_SIZE; i++) {
 
+            // the client can stop the capture between CSNs, ie when it already has the key
+            if (send_reply && data_available()) {
+                break;
+            }
+
             memcpy(emulator, datain + (i * 8), 8);
 
             if (do_iclass_simulation(ICLASS_SIM_MODE_EXIT_AFTER_MAC, mac_responses + i * EPURSE_MAC_SIZE)) {
@@ -189,6 +194,13 @@ void iclass_simulate(uint8_t sim_type, uint8_t num_csns, bool send_reply, uint8_
                     reply_old(CMD_ACK, CMD_HF_ICLASS_SIMULATE, i, 0, mac_responses, i * EPURSE_MAC_SIZE);
                 goto out;
             }
+
+            // let the client start on this MAC while the next CSN is simulated
+            if (send_reply) {
+                iclass_sim_mac_t mac = { .csn_index = i };
+                memcpy(mac.epurse_nr_mac, mac_responses + i * EPURSE_MAC_SIZE, sizeof(mac.epurse_nr_mac));
+                reply_ng(CMD_HF_ICLASS_SIMULATE, PM3_SUCCESS, (uint8_t *)&mac, sizeof(mac));
+            }
         }
         if (dataoutlen)
             *dataoutlen = i * EPURSE_MAC_SIZE;
@@ -1532,7 +1544,12 @@ bool authenticate_iclass_tag(iclass_auth_req_t *payload, picopass_hdr_t *hdr, ui
 * - data in contains of diversified keys, mac
 * - key loop only test one type of authtication key. Ie two calls needed
 *   to cover debit and credit key. (AA1/AA2)
+* - with keep_field the card stays selected after a chunk without hit, the next
+*   chunk (resume) goes on with a READCHECK instead of a new field and select.
 */
+// e-purse of the card selected by the previous chunk
+static uint8_t chk_epurse[8];
+
 void iClass_Authentication_fast(iclass_chk_t *p) {
     // sanitation
     if (p == NULL) {
@@ -1555,16 +1572,29 @@ void iClass_Authentication_fast(iclass_chk_t *p) {
 
     LED_A_ON();
 
-    // fresh start
-    switch_off();
-    SpinDelay(20);
-    Iso15693InitReader();
-
     bool isOK = false;
-
+    bool selected = false;
     uint32_t start_time = 0, eof_time = 0;
-    if (select_iclass_tag(&hdr, p->use_credit_key, &eof_time, shallow_mod) == false)
-        goto out;
+    uint8_t i = 0;
+
+    // the card waits for a CHECK since the last chunk, a READCHECK tells it is still the same one
+    if (p->resume) {
+        if (iclass_send_cmd_with_retries(readcheck_cc, sizeof(readcheck_cc), resp, sizeof(resp), 8, 2, &start_time, ICLASS_READER_TIMEOUT_OTHERS, &eof_time, shallow_mod)) {
+            selected = (memcmp(resp, chk_epurse, sizeof(chk_epurse)) == 0);
+        }
+    }
+
+    if (selected == false) {
+        // fresh start
+        switch_off();
+        SpinDelay(20);
+        Iso15693InitReader();
+
+        if (select_iclass_tag(&hdr, p->use_credit_key, &eof_time, shallow_mod) == false)
+            goto out;
+
+        memcpy(chk_epurse, hdr.epurse, sizeof(chk_epurse));
+    }
 
     start_time = eof_time + DELAY_ICLASS_VICC_TO_VCD_READER;
 
@@ -1572,7 +1602,6 @@ void iClass_Authentication_fast(iclass_chk_t *p) {
     uint16_t checked = 0;
 
     // Keychunk loop
-    uint8_t i = 0;
     for (i = 0; i < p->count; i++) {
 
         // Allow button press / usb cmd to interrupt device
@@ -1606,7 +1635,11 @@ void iClass_Authentication_fast(iclass_chk_t *p) {
 out:
     // send keyindex.
     reply_ng(CMD_HF_ICLASS_CHKKEYS, (isOK) ? PM3_SUCCESS : PM3_ESOFT, (uint8_t *)&i, sizeof(i));
-    switch_off();
+
+    // a complete chunk without hit leaves the card ready for the next one
+    if (isOK || p->keep_field == false || i < p->count) {
+        switch_off();
+    }
 }
 
 // Tries to read block.
@@ -1687,30 +1720,27 @@ out:
     switch_off();
 }
 
-// Dump command seems to dump a block related portion of card memory.
-// I suppose it will need to do an authentatication to AA1,  read its blocks by calling this.
-// then authenticate AA2, and read those blocks by calling this.
-// By the looks at it only 2K cards is supported,  or first page dumps on larger cards.
+static void iclass_dump_flush(iclass_dump_chunk_t *out) {
+    if (out->count) {
+        reply_ng(CMD_HF_ICLASS_DUMP, PM3_SUCCESS, (uint8_t *)out, offsetof(iclass_dump_chunk_t, data) + (out->count * PICOPASS_BLOCK_SIZE));
+    }
+    out->start_block += out->count;
+    out->count = 0;
+    out->readmask = 0;
+}
+
+// Dumps a block range of card memory, authenticated to AA1 or AA2 when asked.
+// Blocks are read four at a time with READ4 and streamed to the client as they come in.
+// A group READ4 fails on is re-read block by block, and when those single reads work
+// READ4 is given up for the rest of the dump. A group where nothing can be read
+// means the card left the field, the dump ends there and the client keeps what it got.
 // turn off afterwards
 void iClass_Dump(uint8_t *msg) {
 
-    BigBuf_free();
-
     iclass_dump_req_t *cmd = (iclass_dump_req_t *)msg;
     iclass_auth_req_t *req = &cmd->req;
     bool shallow_mod = req->shallow_mod;
 
-    uint8_t *dataout = BigBuf_calloc(ICLASS_16KS_SIZE);
-    if (dataout == NULL) {
-        DbpString("Failed to allocate memory");
-        if (req->send_reply) {
-            reply_ng(CMD_HF_ICLASS_DUMP, PM3_EMALLOC, NULL, 0);
-        }
-        switch_off();
-        return;
-    }
-    memset(dataout, 0xFF, ICLASS_16KS_SIZE);
-
     Iso15693InitReader();
 
     // select tag.
@@ -1743,49 +1773,106 @@ void iClass_Dump(uint8_t *msg) {
 
     start_time = eof_time + DELAY_ICLASS_VICC_TO_VCD_READER;
 
-    bool dumpsuccess = true;
+    iclass_dump_chunk_t out = { .done = false, .start_block = cmd->start_block };
+    int retval = PM3_SUCCESS;
+    bool use_read4 = true;
 
     // main read loop
-    uint16_t i;
-    for (i = cmd->start_block; i <= cmd->end_block; i++) {
+    uint16_t i = cmd->start_block;
+    while (i <= cmd->end_block) {
 
-        uint8_t resp[10];
-        uint8_t c[] = {ICLASS_CMD_READ_OR_IDENTIFY, i, 0x00, 0x00};
-        AddCrc(c + 1, 1);
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            retval = PM3_EOPABORTED;
+            break;
+        }
 
-        res = iclass_send_cmd_with_retries(c, sizeof(c), resp, sizeof(resp), 10, 3, &start_time, ICLASS_READER_TIMEOUT_OTHERS, &eof_time, shallow_mod);
-        if (res) {
-            memcpy(dataout + (8 * i), resp, 8);
-        } else {
-            Dbprintf("failed to read block %u ( 0x%02x)", i, i);
-            dumpsuccess = false;
+        // a group never straddles two replies
+        uint8_t n = MIN(4, cmd->end_block - i + 1);
+        n = MIN(n, ICLASS_DUMP_CHUNK_BLOCKS - out.count);
+
+        uint8_t *dst = out.data + (out.count * PICOPASS_BLOCK_SIZE);
+        uint8_t got = 0;
+        bool read4_failed = false;
+
+        if (use_read4 && n == 4) {
+            uint8_t resp[(4 * PICOPASS_BLOCK_SIZE) + 2];
+            uint8_t c[] = {ICLASS_CMD_READ4, i, 0x00, 0x00};
+            AddCrc(c + 1, 1);
+
+            res = iclass_send_cmd_with_retries(c, sizeof(c), resp, sizeof(resp), sizeof(resp), 2, &start_time, ICLASS_READER_TIMEOUT_OTHERS, &eof_time, shallow_mod);
+            if (res && check_crc(CRC_ICLASS, resp, sizeof(resp))) {
+                memcpy(dst, resp, 4 * PICOPASS_BLOCK_SIZE);
+                out.readmask |= (0x0F << out.count);
+                got = 4;
+            } else {
+                read4_failed = true;
+            }
+            start_time = eof_time + DELAY_ICLASS_VICC_TO_VCD_READER;
+        }
+
+        if (got == 0) {
+            for (uint8_t b = 0; b < n; b++) {
+
+                uint8_t resp[10];
+                uint8_t c[] = {ICLASS_CMD_READ_OR_IDENTIFY, i + b, 0x00, 0x00};
+                AddCrc(c + 1, 1);
+
+                res = iclass_send_cmd_with_retries(c, sizeof(c), resp, sizeof(resp), 10, 3, &start_time, ICLASS_READER_TIMEOUT_OTHERS, &eof_time, shallow_mod);
+                if (res) {
+                    memcpy(dst + (b * PICOPASS_BLOCK_SIZE), resp, PICOPASS_BLOCK_SIZE);
+                    out.readmask |= (1 << (out.count + b));
+                    got++;
+                } else {
+                    Dbprintf("failed to read block %u ( 0x%02x)", i + b, i + b);
+                    retval = PM3_EPARTIAL;
+                }
+                start_time = eof_time + DELAY_ICLASS_VICC_TO_VCD_READER;
+            }
+
+            // the card answers single reads, it is READ4 that does not work
+            if (read4_failed && got == n) {
+                use_read4 = false;
+            }
+        }
+
+        out.count += n;
+        i += n;
+
+        if (got == 0) {
+            DbpString("card lost, dump ends here");
+            retval = PM3_EPARTIAL;
+            break;
+        }
+
+        if (out.count == ICLASS_DUMP_CHUNK_BLOCKS) {
+            iclass_dump_flush(&out);
         }
     }
 
     switch_off();
 
+    if (i <= cmd->end_block) {
+        retval = (retval == PM3_EOPABORTED) ? PM3_EOPABORTED : PM3_EPARTIAL;
+    }
+
+    if (req->send_reply == false) {
+        return;
+    }
+
+    iclass_dump_flush(&out);
+
+    iclass_dump_chunk_t done = { .done = true, .start_block = out.start_block };
+
     // copy diversified key back.
     if (req->do_auth) {
         if (req->use_credit_key)
-            memcpy(dataout + (8 * 4), hdr.key_c, 8);
+            memcpy(done.div_key, hdr.key_c, sizeof(done.div_key));
         else
-            memcpy(dataout + (8 * 3), hdr.key_d, 8);
-    }
-
-    if (req->send_reply) {
-        struct p {
-            bool isOK;
-            uint16_t block_cnt;
-            uint32_t bb_offset;
-        } PACKED response;
-
-        response.isOK = dumpsuccess;
-        response.block_cnt = i - cmd->start_block;
-        response.bb_offset = dataout - BigBuf_get_addr();
-        reply_ng(CMD_HF_ICLASS_DUMP, PM3_SUCCESS, (uint8_t *)&response, sizeof(response));
+            memcpy(done.div_key, hdr.key_d, sizeof(done.div_key));
     }
 
-    BigBuf_free();
+    reply_ng(CMD_HF_ICLASS_DUMP, retval, (uint8_t *)&done, offsetof(iclass_dump_chunk_t, data));
 }
 
 static bool iclass_writeblock_ext(uint8_t blockno, uint8_t *data, uint8_t *mac, bool use_mac, bool shallow_mod) {
@@ -46,7 +46,7 @@
 
 #define AddCrc(data, len) compute_crc(CRC_ICLASS, (data), (len), (data)+(len), (data)+(len)+1)
 
-void SniffIClass(uint8_t jam_search_len, uint8_t *jam_search_string);
+void SniffIClass(uint8_t jam_search_len, uint8_t *jam_search_string, bool stream);
 void ReaderIClass(uint8_t flags);
 
 void iClass_WriteBlock(uint8_t *msg);
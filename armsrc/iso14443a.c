@@ -37,10 +37,13 @@
 #include "generator.h"
 #include "desfire_crypto.h"  // UL-C authentication helpers
 #include "mifare.h"  // for iso14a_polling_frame_t structure
+#include "rftiming.h"
 
 #define MAX_ISO14A_TIMEOUT 524288
 // this timeout is in MS
 static uint32_t iso14a_timeout;
+// answer window learned from the tag in the field, see iso14a_adaptive_timeout()
+static bool iso14a_adaptive = false;
 
 static uint8_t colpos = 0;
 
@@ -171,7 +174,7 @@ Default HF 14a config is set to:
     magsafe = 0 (disabled)
     polling_loop_annotation = {{0}, 0, 0, 0} (disabled)
 */
-static hf14a_config_t hf14aconfig = { 0, 0, 0, 0, 0, 0, {{0}, 0, 0, 0} };
+static hf14a_config_t hf14aconfig = { 0, 0, 0, 0, 0, 0, 0, {{0}, 0, 0, 0} };
 
 static iso14a_polling_parameters_t hf14a_polling_parameters = {
     .frames = { {{ ISO14443A_CMD_WUPA }, 1, 7, 0 }},
@@ -218,6 +221,9 @@ void printHf14aConfig(void) {
     Dbprintf("  [m] Magsafe polling............ %s",
              (hf14aconfig.magsafe == 1) ? _GREEN_("enabled") : _YELLOW_("disabled")
             );
+    Dbprintf("  [t] Adaptive chk timeouts...... %s",
+             (hf14aconfig.adaptive == 1) ? _GREEN_("enabled") : _YELLOW_("disabled")
+            );
     Dbprintf("  [p] Polling loop annotation.... %s %*D",
              (hf14aconfig.polling_loop_annotation.frame_length <= 0) ? _YELLOW_("disabled") : _GREEN_("enabled"),
              hf14aconfig.polling_loop_annotation.frame_length,
@@ -259,6 +265,10 @@ void setHf14aConfig(const hf14a_config_t *hc) {
         hf14aconfig.magsafe = hc->magsafe;
     }
 
+    if ((hc->adaptive >= 0) && (hc->adaptive <= 1)) {
+        hf14aconfig.adaptive = hc->adaptive;
+    }
+
     if (hc->polling_loop_annotation.frame_length >= 0) {
         memcpy(&hf14aconfig.polling_loop_annotation, &hc->polling_loop_annotation, sizeof(iso14a_polling_frame_t));
     }
@@ -307,6 +317,16 @@ uint32_t iso14a_get_timeout(void) {
     return iso14a_timeout - (DELAY_AIR2ARM_AS_READER + DELAY_ARM2AIR_AS_READER) / 128 - 2;
 }
 
+// Key check loops mostly wait for answers which never come. When enabled with
+// `hf 14a config --adapt on`, the answer window shrinks to what the tag in the field
+// needed during its first exchanges, see rft_learned_window_fc(). iso14443a_setup() turns it off again.
+void iso14a_adaptive_timeout(bool enable) {
+    iso14a_adaptive = enable && (hf14aconfig.adaptive == 1);
+    if (iso14a_adaptive) {
+        rft_learn_start(RFT_14A);
+    }
+}
+
 //-----------------------------------------------------------------------------
 // Generate the parity value for a byte sequence
 //-----------------------------------------------------------------------------
@@ -802,6 +822,7 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     // param:
     // bit 0 - trigger from first card answer
     // bit 1 - trigger from first reader 7-bit request
+    // bit 2 - stream the trace to the host, see trace_stream_start
     iso14443a_setup(FPGA_HF_ISO14443A_SNIFFER);
 
     // Allocate memory from BigBuf for some buffers
@@ -820,6 +841,7 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
 
     uint8_t previous_data = 0;
     int maxDataLen = 0, dataLen;
+    uint32_t overruns = 0;
     bool TagIsActive = false;
     bool ReaderIsActive = false;
 
@@ -834,11 +856,11 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     }
 
     // The DMA buffer, used to stream samples from the FPGA
-    dmabuf8_t *dma = get_dma8();
+    dmabuf8_t *dma = get_dma8_sized(DMA_SNIFF_BUFFER_SIZE);
     uint8_t *data = dma->buf;
 
     // Setup and start DMA.
-    if (FpgaSetupSscDma((uint8_t *) dma->buf, DMA_BUFFER_SIZE) == false) {
+    if (FpgaSetupSscDma((uint8_t *) dma->buf, dma->size) == false) {
         if (g_dbglevel > 1) Dbprintf("FpgaSetupSscDma failed. Exiting");
         return;
     }
@@ -849,6 +871,10 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     // triggered == false -- to wait first for card
     bool triggered = !(param & 0x03);
 
+    // nothing may be printed while streaming
+    bool stream = (param & 0x04) && (trace_stream_start() == PM3_SUCCESS);
+    uint16_t idle = 0;
+
     uint32_t rx_samples = 0;
 
     // loop and listen
@@ -857,35 +883,56 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
         LED_A_ON();
 
         register int readBufDataP = data - dma->buf;
-        register int dmaBufDataP = DMA_BUFFER_SIZE - AT91C_BASE_PDC_SSC->PDC_RCR;
+        register int dmaBufDataP = dma->size - AT91C_BASE_PDC_SSC->PDC_RCR;
         if (readBufDataP <= dmaBufDataP) {
             dataLen = dmaBufDataP - readBufDataP;
         } else {
-            dataLen = DMA_BUFFER_SIZE - readBufDataP + dmaBufDataP;
+            dataLen = dma->size - readBufDataP + dmaBufDataP;
         }
 
-        // test for length of buffer
         if (dataLen > maxDataLen) {
             maxDataLen = dataLen;
-            if (dataLen > (9 * DMA_BUFFER_SIZE / 10)) {
-                Dbprintf("[!] blew circular buffer! | datalen %u", dataLen);
-                break;
-            }
+        }
+
+        // about to be overwritten by the DMA. Drop what is pending, an even number of samples
+        // to keep the decoder input pairs aligned, and resync on the next frame
+        if (dataLen > (9 * dma->size / 10)) {
+            int skip = dataLen & ~1;
+            data = dma->buf + ((readBufDataP + skip) & (dma->size - 1));
+            rx_samples += skip;
+            dataLen -= skip;
+            overruns++;
+            Uart14aReset();
+            Demod14aReset();
+            TagIsActive = false;
+            ReaderIsActive = false;
         }
         if (dataLen < 1) {
+            if (stream) {
+                // between frames only, a flash sink blocks for a while
+                if (TagIsActive == false && ReaderIsActive == false) {
+                    trace_stream_poll();
+                }
+                // the client stops a stream with CMD_BREAK_LOOP
+                if (++idle == 0 && data_available_fast()) {
+                    break;
+                }
+            }
             continue;
         }
 
         // primary buffer was stopped( <-- we lost data!
         if (AT91C_BASE_PDC_SSC->PDC_RCR == 0) {
             AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) dma->buf;
-            AT91C_BASE_PDC_SSC->PDC_RCR = DMA_BUFFER_SIZE;
-            Dbprintf("[-] RxEmpty ERROR | data length %d", dataLen); // temporary
+            AT91C_BASE_PDC_SSC->PDC_RCR = dma->size;
+            if (stream == false) {
+                Dbprintf("[-] RxEmpty ERROR | data length %d", dataLen); // temporary
+            }
         }
         // secondary buffer sets as primary, secondary buffer was stopped
         if (AT91C_BASE_PDC_SSC->PDC_RNCR == 0) {
             AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t) dma->buf;
-            AT91C_BASE_PDC_SSC->PDC_RNCR = DMA_BUFFER_SIZE;
+            AT91C_BASE_PDC_SSC->PDC_RNCR = dma->size;
         }
 
         LED_A_OFF();
@@ -960,15 +1007,25 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
         previous_data = *data;
         rx_samples++;
         data++;
-        if (data == dma->buf + DMA_BUFFER_SIZE) {
+        if (data == dma->buf + dma->size) {
             data = dma->buf;
         }
     } // end main loop
 
     FpgaDisableTracing();
 
+    if (stream) {
+        trace_stream_stop();
+        switch_off();
+        return;
+    }
+
     if (g_dbglevel >= DBG_ERROR) {
         Dbprintf("trace len = " _YELLOW_("%d"), BigBuf_get_traceLen());
+        Dbprintf("DMA max fill = %d of %u samples", maxDataLen, dma->size);
+        if (overruns) {
+            Dbprintf("DMA overruns = " _RED_("%u") ", frames in between are lost", overruns);
+        }
     }
     switch_off();
 }
@@ -1573,6 +1630,74 @@ bool SimulateIso14443aInit(uint8_t tagType, uint16_t flags, uint8_t *data,
     return true;
 }
 
+// Anticollision answers (UID CLn + BCC) of one UID, 5 bytes per cascade level
+static void sim_uid_cascades(const uint8_t *uid, uint8_t uidlen, uint8_t *out) {
+    uint8_t cascades = (uidlen == 10) ? 3 : (uidlen == 7) ? 2 : 1;
+    for (uint8_t c = 0; c < cascades; c++) {
+        uint8_t *r = out + (c * 5);
+        if (c == cascades - 1) {
+            memcpy(r, uid + (c * 3), 4);
+        } else {
+            r[0] = MIFARE_SELECT_CT;
+            memcpy(r + 1, uid + (c * 3), 3);
+        }
+        r[4] = r[0] ^ r[1] ^ r[2] ^ r[3];
+    }
+}
+
+// Precomputes the anticollision responses of all identities of a rotating simulation.
+// Returns cascades * count responses, identity after identity, or NULL when BigBuf is too small.
+static tag_response_info_t *sim_rotate_prepare(const iso14a_sim_rotate_t *rotate, const uint8_t *uid, uint8_t uidlen) {
+
+    uint8_t cascades = (uidlen == 10) ? 3 : (uidlen == 7) ? 2 : 1;
+    uint32_t n = rotate->count * cascades;
+    // 5 bytes, every bit costs one byte, plus parity, start, stop and correction bits
+    uint32_t modsize = n * ((5 * 9) + 3);
+
+    uint32_t total = (n * sizeof(tag_response_info_t)) + (n * 5) + modsize;
+    if (total > UINT16_MAX) {
+        return NULL;
+    }
+
+    tag_response_info_t *resp = (tag_response_info_t *)BigBuf_calloc(n * sizeof(tag_response_info_t));
+    uint8_t *data = BigBuf_calloc(n * 5);
+    uint8_t *mod = BigBuf_calloc(modsize);
+    if (resp == NULL || data == NULL || mod == NULL) {
+        return NULL;
+    }
+
+    size_t mod_free = modsize;
+    uint8_t cur[10];
+    memcpy(cur, uid, uidlen);
+
+    for (uint16_t i = 0; i < rotate->count; i++) {
+
+        if (rotate->uids) {
+            memcpy(cur, rotate->uids + (i * uidlen), uidlen);
+        } else if (i) {
+            // count up, big endian over the whole UID
+            uint16_t carry = rotate->step;
+            for (int b = uidlen - 1; b >= 0 && carry; b--) {
+                carry += cur[b];
+                cur[b] = carry & 0xFF;
+                carry >>= 8;
+            }
+        }
+
+        sim_uid_cascades(cur, uidlen, data + (i * cascades * 5));
+
+        for (uint8_t c = 0; c < cascades; c++) {
+            tag_response_info_t *r = &resp[(i * cascades) + c];
+            r->response = data + (((i * cascades) + c) * 5);
+            r->response_n = 5;
+            if (prepare_allocated_tag_modulation(r, &mod, &mod_free) == false) {
+                return NULL;
+            }
+        }
+    }
+    return resp;
+}
+
 //-----------------------------------------------------------------------------
 // Main loop of simulated tag: receive commands from reader, decide what
 // response to send, and send it.
@@ -1580,6 +1705,14 @@ bool SimulateIso14443aInit(uint8_t tagType, uint16_t flags, uint8_t *data,
 //-----------------------------------------------------------------------------
 void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *useruid, uint8_t exitAfterNReads,
                           uint8_t *ats, size_t ats_len, bool ulc_part1, bool ulc_part2) {
+    SimulateIso14443aTagEx(tagType, flags, useruid, exitAfterNReads, ats, ats_len, ulc_part1, ulc_part2, NULL);
+}
+
+// With `rotate`, the simulated UID changes to the next identity of the list, or the next
+// generated UID, after every `rotate->after` completed activations.
+void SimulateIso14443aTagEx(uint8_t tagType, uint16_t flags, uint8_t *useruid, uint8_t exitAfterNReads,
+                            uint8_t *ats, size_t ats_len, bool ulc_part1, bool ulc_part2,
+                            const iso14a_sim_rotate_t *rotate) {
 
 #define ATTACK_KEY_COUNT 16
 #define ULC_TAG_NONCE       "\x01\x02\x03\x04\x05\x06\x07\x08"
@@ -1642,6 +1775,37 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *useruid, uin
         return;
     }
 
+    // Rotating identities, only the anticollision answers and the cuid change
+    uint8_t rot_uidlen = IS_FLAG_UID_IN_DATA(flags, 10) ? 10 : IS_FLAG_UID_IN_DATA(flags, 7) ? 7 : IS_FLAG_UID_IN_DATA(flags, 4) ? 4 : 0;
+    uint8_t rot_cascades = (rot_uidlen == 10) ? 3 : (rot_uidlen == 7) ? 2 : 1;
+    tag_response_info_t *rot_responses = NULL;
+    tag_response_info_t rot_saved[3];
+    uint16_t rot_index = 0;
+    uint8_t rot_activations = 0;
+    bool rot_selected = false;
+
+    if (rotate != NULL && rotate->count > 1) {
+        if (rot_uidlen == 0) {
+            if (g_dbglevel >= DBG_ERROR) Dbprintf("UID rotation needs the UID in the command");
+            BigBuf_free_keep_EM();
+            reply_ng(CMD_HF_MIFARE_SIMULATE, PM3_EINVARG, NULL, 0);
+            return;
+        }
+
+        rot_responses = sim_rotate_prepare(rotate, useruid, rot_uidlen);
+        if (rot_responses == NULL) {
+            if (g_dbglevel >= DBG_ERROR) Dbprintf("Not enough memory for " _YELLOW_("%u") " identities", rotate->count);
+            BigBuf_free_keep_EM();
+            reply_ng(CMD_HF_MIFARE_SIMULATE, PM3_EMALLOC, NULL, 0);
+            return;
+        }
+
+        // the responses table is static, it is restored on exit
+        memcpy(rot_saved, &responses[RESP_INDEX_UIDC1], sizeof(rot_saved));
+        memcpy(&responses[RESP_INDEX_UIDC1], rot_responses, rot_cascades * sizeof(tag_response_info_t));
+        cuid = bytes_to_num(rot_responses[rot_cascades - 1].response, 4);
+    }
+
     mfu_dump_t *mfu_em_dump = NULL;
     if (tagType == 2 || tagType == 7) {
         mfu_em_dump = (mfu_dump_t *)BigBuf_get_EM_addr();
@@ -1688,7 +1852,10 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *useruid, uin
 
     bool odd_reply = true;
 
+    // the ring setting only applies to this trace
+    set_tracing_ring((flags & FLAG_TRACE_RING) == FLAG_TRACE_RING);
     clear_trace();
+    set_tracing_ring(false);
     set_tracing(true);
     LED_A_ON();
 
@@ -1790,13 +1957,28 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *useruid, uin
             order = ORDER_NONE; // back to work state
             p_response = NULL;
 
-        } else if (receivedCmd[0] == ISO14443A_CMD_REQA && len == 1) { // Received a REQUEST, but in HALTED, skip
-            odd_reply = !odd_reply;
-            if (odd_reply) {
+        } else if ((receivedCmd[0] == ISO14443A_CMD_REQA || receivedCmd[0] == ISO14443A_CMD_WUPA) && len == 1) {
+
+            // a new activation after a completed select, i.e. a field reset or HALT + WUPA.
+            // Switching identity is only a copy of the precomputed responses, in time for the ATQA
+            if (rot_responses && rot_selected) {
+                rot_selected = false;
+                if (++rot_activations >= rotate->after) {
+                    rot_activations = 0;
+                    rot_index = (rot_index + 1) % rotate->count;
+                    memcpy(&responses[RESP_INDEX_UIDC1], &rot_responses[rot_index * rot_cascades], rot_cascades * sizeof(tag_response_info_t));
+                    cuid = bytes_to_num(rot_responses[(rot_index * rot_cascades) + rot_cascades - 1].response, 4);
+                }
+            }
+
+            if (receivedCmd[0] == ISO14443A_CMD_REQA) { // Received a REQUEST, but in HALTED, skip
+                odd_reply = !odd_reply;
+                if (odd_reply) {
+                    p_response = &responses[RESP_INDEX_ATQA];
+                }
+            } else { // Received a WAKEUP
                 p_response = &responses[RESP_INDEX_ATQA];
             }
-        } else if (receivedCmd[0] == ISO14443A_CMD_WUPA && len == 1) { // Received a WAKEUP
-            p_response = &responses[RESP_INDEX_ATQA];
         } else if (receivedCmd[1] == 0x20 && receivedCmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT && len == 2) {    // Received request for UID (cascade 1)
             p_response = &responses[RESP_INDEX_UIDC1];
         } else if (receivedCmd[1] == 0x20 && receivedCmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 && len == 2) {  // Received request for UID (cascade 2)
@@ -1805,10 +1987,13 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *useruid, uin
             p_response = &responses[RESP_INDEX_UIDC3];
         } else if (receivedCmd[1] == 0x70 && receivedCmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT && len == 9) {    // Received a SELECT (cascade 1)
             p_response = &responses[RESP_INDEX_SAKC1];
+            rot_selected = (rot_cascades == 1);
         } else if (receivedCmd[1] == 0x70 && receivedCmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 && len == 9) {  // Received a SELECT (cascade 2)
             p_response = &responses[RESP_INDEX_SAKC2];
+            rot_selected = (rot_cascades == 2);
         } else if (receivedCmd[1] == 0x70 && receivedCmd[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_3 && len == 9) {  // Received a SELECT (cascade 3)
             p_response = &responses[RESP_INDEX_SAKC3];
+            rot_selected = (rot_cascades == 3);
         } else if (receivedCmd[0] == ISO14443A_CMD_PPS) {
             p_response = &responses[RESP_INDEX_PPS];
         } else if (receivedCmd[0] == ISO14443A_CMD_READBLOCK && len == 4) {    // Received a (plain) READ
@@ -2244,6 +2429,10 @@ jump:
 
     switch_off();
 
+    if (rot_responses) {
+        memcpy(&responses[RESP_INDEX_UIDC1], rot_saved, sizeof(rot_saved));
+    }
+
     set_tracing(false);
     BigBuf_free_keep_EM();
 
@@ -2424,6 +2613,14 @@ static void CodeIso14443aAsReaderPar(const uint8_t *cmd, uint16_t len, const uin
 // Stop when button is pressed (return 1) or field was gone (return 2)
 // Or return 0 when command is captured
 //-----------------------------------------------------------------------------
+// Work EmGetCmd does while no frame is coming in. Every call has to be short, a
+// few microseconds at most, or the start of the next frame is missed
+static em_idle_work_t s_em_idle_work = NULL;
+
+void EmSetIdleWork(em_idle_work_t work) {
+    s_em_idle_work = work;
+}
+
 int EmGetCmd(uint8_t *received, uint16_t received_max_len, uint16_t *len, uint8_t *par) {
     *len = 0;
 
@@ -2519,6 +2716,8 @@ int EmGetCmd(uint8_t *received, uint16_t received_max_len, uint16_t *len, uint8_
                 *len = Uart.len;
                 return 0;
             }
+        } else if (s_em_idle_work != NULL && Uart.state == STATE_14A_UNSYNCD) {
+            s_em_idle_work();
         }
     }
 }
@@ -2751,6 +2950,12 @@ static int GetIso14443aAnswerFromTag(uint8_t *receivedResponse, uint16_t rec_max
 
     volatile uint32_t c = 0;
     uint32_t timeout = iso14a_get_timeout();
+    if (iso14a_adaptive) {
+        uint32_t window_fc = rft_learned_window_fc(RFT_14A);
+        if (window_fc) {
+            timeout = MIN(timeout, window_fc / 128 + (DELAY_AIR2ARM_AS_READER + DELAY_ARM2AIR_AS_READER) / 128 + 2);
+        }
+    }
     uint32_t receive_timer = GetTickCount();
     for (;;) {
         WDT_HIT();
@@ -2759,8 +2964,10 @@ static int GetIso14443aAnswerFromTag(uint8_t *receivedResponse, uint16_t rec_max
             b = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
             if (ManchesterDecoding(b, offset, 0)) {
                 NextTransferTime = MAX(NextTransferTime, Demod.endTime - (DELAY_AIR2ARM_AS_READER + DELAY_ARM2AIR_AS_READER) / 16 + FRAME_DELAY_TIME_PICC_TO_PCD);
+                rft_answer(RFT_14A, Demod.startTime * 16 - DELAY_AIR2ARM_AS_READER, Demod.endTime * 16 - DELAY_AIR2ARM_AS_READER);
                 return true;
             } else if (c++ > timeout && Demod.state == DEMOD_14A_UNSYNCD) {
+                rft_timeout(RFT_14A);
                 return false;
             }
         }
@@ -2770,6 +2977,7 @@ static int GetIso14443aAnswerFromTag(uint8_t *receivedResponse, uint16_t rec_max
             break;
         }
     }
+    rft_timeout(RFT_14A);
     return false;
 }
 
@@ -2780,7 +2988,10 @@ void ReaderTransmitBitsPar(const uint8_t *frame, uint16_t bits, uint8_t *par, ui
     TransmitFor14443a(ts->buf, ts->max, timing);
     if (g_trigger) LED_A_ON();
 
-    LogTrace(frame, nbytes(bits), (LastTimeProxToAirStart << 4) + DELAY_ARM2AIR_AS_READER, ((LastTimeProxToAirStart + LastProxToAirDuration) << 4) + DELAY_ARM2AIR_AS_READER, par, true);
+    uint32_t start_fc = (LastTimeProxToAirStart << 4) + DELAY_ARM2AIR_AS_READER;
+    uint32_t end_fc = ((LastTimeProxToAirStart + LastProxToAirDuration) << 4) + DELAY_ARM2AIR_AS_READER;
+    rft_frame(RFT_14A, start_fc, end_fc);
+    LogTrace(frame, nbytes(bits), start_fc, end_fc, par, true);
 }
 
 void ReaderTransmitPar(const uint8_t *frame, uint16_t len, uint8_t *par, uint32_t *timing) {
@@ -2816,6 +3027,94 @@ uint16_t ReaderReceive(uint8_t *receivedAnswer, uint16_t answer_maxlen, uint8_t
 }
 
 
+// Topaz frames go out without parity, the first byte as 7 bits
+static uint16_t topaz_exchange(const uint8_t *cmd, uint8_t len, uint8_t *resp, uint16_t resp_max) {
+    ReaderTransmitBitsPar(&cmd[0], 7, NULL, NULL);
+    for (uint8_t i = 1; i < len; i++) {
+        ReaderTransmitBitsPar(&cmd[i], 8, NULL, NULL);
+    }
+    uint8_t par[MAX_PARITY_SIZE] = {0};
+    return ReaderReceive(resp, resp_max, par);
+}
+
+// Keeps the field on and reports every Topaz / Jewel tag once, with the time it was first seen.
+// WUPA, RID and RALL per round, the UID comes from block 0.
+void TopazReader(const hf_tagstream_t *p) {
+
+    clear_trace();
+    set_tracing(false);
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    BigBuf_free();
+    seen_tag_t *seen = (seen_tag_t *)BigBuf_calloc(SEEN_TAGS_MAX * sizeof(seen_tag_t));
+    uint8_t *resp = BigBuf_calloc(MAX_FRAME_SIZE);
+    if (seen == NULL || resp == NULL) {
+        reply_ng(CMD_HF_TOPAZ_READER, PM3_EMALLOC, NULL, 0);
+        hf_field_off();
+        return;
+    }
+
+    int res = PM3_SUCCESS;
+    uint32_t t0 = GetTickCount();
+
+    for (;;) {
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        uint32_t now = GetTickCountDelta(t0);
+        if (p->duration && now > p->duration) {
+            break;
+        }
+
+        uint8_t wupa[] = { TOPAZ_WUPA };
+        if (topaz_exchange(wupa, sizeof(wupa), resp, MAX_FRAME_SIZE) != 2) {
+            continue;
+        }
+
+        // ATQA 0C 00
+        if (resp[0] != 0x0C || resp[1] != 0x00) {
+            continue;
+        }
+
+        uint8_t rid[9] = { TOPAZ_RID, 0, 0, 0, 0, 0, 0 };
+        AddCrc14B(rid, 7);
+        if (topaz_exchange(rid, sizeof(rid), resp, MAX_FRAME_SIZE) != 8 || check_crc(CRC_14443_B, resp, 8) == false) {
+            continue;
+        }
+
+        hf_tagstream_entry_t e = {0};
+        e.data[0] = resp[0];
+        e.data[1] = resp[1];
+
+        uint8_t rall[9] = { TOPAZ_RALL, 0, 0 };
+        memcpy(rall + 3, resp + 2, 4);
+        AddCrc14B(rall, 7);
+        if (topaz_exchange(rall, sizeof(rall), resp, MAX_FRAME_SIZE) != 124 || check_crc(CRC_14443_B, resp, 124) == false) {
+            continue;
+        }
+
+        // HR0 HR1 UID0..UID6
+        memcpy(e.data + 2, resp + 2, 7);
+        e.len = 9;
+        e.ms = now;
+
+        if (seen_tag_is_new(seen, e.data, e.len, now, p->holdoff) == false) {
+            continue;
+        }
+
+        reply_ng(CMD_HF_TOPAZ_READER, PM3_SUCCESS, (uint8_t *)&e, sizeof(e));
+    }
+
+    reply_ng(CMD_HF_TOPAZ_READER, res, NULL, 0);
+    hf_field_off();
+    BigBuf_free();
+}
+
 // This function misstreats the ISO 14443a anticollision procedure.
 // by fooling the reader there is a collision and forceing the reader to
 // increase the uid bytes.   The might be an overflow, DoS will occur.
@@ -3315,6 +3614,7 @@ void iso14443a_setup(uint8_t fpga_minor_mode) {
     Uart14aReset();
     NextTransferTime = 2 * DELAY_ARM2AIR_AS_READER;
     iso14a_set_timeout(1060); // 106 * 10ms default
+    iso14a_adaptive = false;
 
     g_hf_field_active = true;
 }
@@ -3443,6 +3743,272 @@ int iso14_apdu(uint8_t *cmd, uint16_t cmd_len, bool send_chaining, void *data, u
     return len;
 }
 
+// Sends one APDU, in chained I-blocks when it doesn't fit the card frame, and collects the
+// chained response blocks. WTX is answered by iso14_apdu.
+// Returns the response length, status word included, or a PM3 error
+static int iso14_apdu_exchange(const uint8_t *apdu, uint16_t len, uint16_t frame_len, uint8_t *resp, uint16_t resp_max) {
+    uint8_t frame[MAX_FRAME_SIZE];
+    uint8_t pcb = 0;
+    int res = 0;
+
+    // PCB + CRC = 3 bytes
+    uint16_t chunk_max = (frame_len > 3) ? frame_len - 3 : len;
+    uint16_t pos = 0;
+
+    while (pos < len) {
+        uint16_t chunk = MIN(chunk_max, len - pos);
+        bool more = ((pos + chunk) < len);
+
+        res = iso14_apdu((uint8_t *)apdu + pos, chunk, more, frame, sizeof(frame), &pcb);
+        if (res == 0) {
+            return PM3_ETIMEOUT;
+        }
+        if (res < 0) {
+            return (res == -3) ? PM3_EOPABORTED : PM3_ECRC;
+        }
+        pos += chunk;
+
+        // every block but the last one must be acknowledged with R(ACK)
+        if (more && ((pcb & 0xF2) != 0xA2)) {
+            return PM3_ECARDEXCHANGE;
+        }
+    }
+
+    uint16_t rlen = 0;
+    for (;;) {
+        // I-block, PCB is already cut, CRC is still there
+        if (((pcb & 0xC0) != 0x00) || (res < 2)) {
+            return PM3_ECARDEXCHANGE;
+        }
+
+        uint16_t dlen = res - 2;
+        if (rlen + dlen > resp_max) {
+            return PM3_EOVFLOW;
+        }
+        memcpy(resp + rlen, frame, dlen);
+        rlen += dlen;
+
+        if ((pcb & 0x10) == 0) {
+            break;
+        }
+
+        // chained response, R(ACK) asks for the next block
+        res = iso14_apdu(NULL, 0, false, frame, sizeof(frame), &pcb);
+        if (res == 0) {
+            return PM3_ETIMEOUT;
+        }
+        if (res < 0) {
+            return (res == -3) ? PM3_EOPABORTED : PM3_ECRC;
+        }
+    }
+    return rlen;
+}
+
+// Runs the APDUs of a CMD_HF_ISO14443A_APDU_BATCH payload on the selected card, see pm3_cmd.h
+void ReaderIso14443aApduBatch(const uint8_t *data, uint16_t datalen) {
+    uint8_t out[PM3_CMD_DATA_SIZE];
+    uint8_t resp[APDU_BATCH_REPLY_DATA_MAX];
+    uint16_t outlen = sizeof(batch_reply_hdr_t);
+    uint8_t executed = 0;
+    int8_t status = PM3_SUCCESS;
+
+    if (datalen < sizeof(apdu_batch_hdr_t)) {
+        reply_ng(CMD_HF_ISO14443A_APDU_BATCH, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    apdu_batch_hdr_t hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+    uint16_t pos = sizeof(hdr);
+
+    FpgaDisableTracing();
+
+    while (pos < datalen) {
+        apdu_batch_cmd_t cmd;
+        if (datalen - pos < sizeof(cmd)) {
+            status = PM3_EINVARG;
+            break;
+        }
+        memcpy(&cmd, data + pos, sizeof(cmd));
+        pos += sizeof(cmd);
+
+        if ((cmd.len == 0) || (cmd.len > datalen - pos)) {
+            status = PM3_EINVARG;
+            break;
+        }
+
+        int res = iso14_apdu_exchange(data + pos, cmd.len, hdr.frame_len, resp, sizeof(resp));
+        pos += cmd.len;
+
+        apdu_batch_reply_t entry = {
+            .index = executed,
+            .status = (res < 0) ? res : PM3_SUCCESS,
+            .len = (res < 0) ? 0 : res,
+        };
+
+        if (outlen + sizeof(entry) + entry.len > sizeof(out)) {
+            batch_reply_hdr_t *rhdr = (batch_reply_hdr_t *)out;
+            rhdr->final = false;
+            rhdr->executed = 0;
+            reply_ng(CMD_HF_ISO14443A_APDU_BATCH, PM3_SUCCESS, out, outlen);
+            outlen = sizeof(batch_reply_hdr_t);
+        }
+
+        memcpy(out + outlen, &entry, sizeof(entry));
+        outlen += sizeof(entry);
+        memcpy(out + outlen, resp, entry.len);
+        outlen += entry.len;
+        executed++;
+
+        // the card is in an unknown state after a failed exchange
+        if (res < 0) {
+            status = res;
+            break;
+        }
+
+        if ((hdr.flags & APDU_BATCH_FLAG_STOP_ON_SW) && cmd.sw_mask) {
+            uint16_t sw = (res >= 2) ? ((resp[res - 2] << 8) | resp[res - 1]) : 0;
+            if ((res < 2) || ((sw & cmd.sw_mask) != (cmd.sw & cmd.sw_mask))) {
+                break;
+            }
+        }
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+    }
+
+    batch_reply_hdr_t *rhdr = (batch_reply_hdr_t *)out;
+    rhdr->final = true;
+    rhdr->executed = executed;
+    reply_ng(CMD_HF_ISO14443A_APDU_BATCH, status, out, outlen);
+}
+
+// 'hf 14a cuids', UIDs of random UID cards. The device loops over field reset and anticollision,
+// so the rate only depends on the RF timing, and sends the UIDs in full frames.
+void ReaderIso14443aCollectUIDs(const iso14a_cuids_t *p) {
+
+    uint8_t *out = BigBuf_calloc(PM3_CMD_DATA_SIZE);
+    if (out == NULL) {
+        reply_ng(CMD_HF_ISO14443A_CUIDS, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    iso14a_cuids_resp_t *hdr = (iso14a_cuids_resp_t *)out;
+    uint16_t outlen = sizeof(iso14a_cuids_resp_t);
+    uint8_t reset_ms = MAX(p->reset_ms, 1);
+    int status = PM3_SUCCESS;
+
+    LED_A_ON();
+    set_tracing(false);
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    while ((p->count == 0) || (hdr->collected < p->count)) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+        WDT_HIT();
+
+        // a new UID needs a power cycle of the card
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        SpinDelay(reset_ms);
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_ISO14443A | FPGA_HF_ISO14443A_READER_LISTEN);
+        SpinDelay(reset_ms);
+
+        iso14a_card_select_t card;
+        if (iso14443a_select_cardEx(NULL, &card, NULL, true, 0, true, NULL, false) == 0 || card.uidlen > 10) {
+            hdr->failed++;
+            continue;
+        }
+
+        if (outlen + 1 + card.uidlen > PM3_CMD_DATA_SIZE) {
+            hdr->final = false;
+            reply_ng(CMD_HF_ISO14443A_CUIDS, PM3_SUCCESS, out, outlen);
+            outlen = sizeof(iso14a_cuids_resp_t);
+        }
+
+        out[outlen++] = card.uidlen;
+        memcpy(out + outlen, card.uid, card.uidlen);
+        outlen += card.uidlen;
+        hdr->collected++;
+    }
+
+    hf_field_off();
+
+    hdr->final = true;
+    reply_ng(CMD_HF_ISO14443A_CUIDS, status, out, outlen);
+    BigBuf_free();
+    LEDsoff();
+}
+
+// Streams the data of a CMD_HF_ISO14443A_RAW_FRAMES payload to the selected card, see pm3_cmd.h.
+// Retries are handled here, so the client only waits once per USB packet instead of once per frame.
+void ReaderIso14443aRawFrames(const uint8_t *data, uint16_t datalen) {
+    iso14a_raw_frames_resp_t resp = {0};
+
+    iso14a_raw_frames_t hdr;
+    if (datalen < sizeof(hdr)) {
+        reply_ng(CMD_HF_ISO14443A_RAW_FRAMES, PM3_EINVARG, NULL, 0);
+        return;
+    }
+    memcpy(&hdr, data, sizeof(hdr));
+    data += sizeof(hdr);
+    datalen -= sizeof(hdr);
+
+    if (hdr.prefix_len > sizeof(hdr.prefix) || hdr.chunk == 0) {
+        reply_ng(CMD_HF_ISO14443A_RAW_FRAMES, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    uint8_t frame[sizeof(hdr.prefix) + 0xFF + 2];
+    uint8_t answer[MAX_FRAME_SIZE] = {0};
+    uint8_t par[MAX_PARITY_SIZE] = {0};
+    int status = PM3_SUCCESS;
+
+    memcpy(frame, hdr.prefix, hdr.prefix_len);
+
+    for (uint16_t pos = 0; pos < datalen; pos += hdr.chunk) {
+        uint8_t n = MIN(hdr.chunk, datalen - pos);
+        memcpy(frame + hdr.prefix_len, data + pos, n);
+        uint16_t len = hdr.prefix_len + n;
+        AddCrc14A(frame, len);
+        len += 2;
+
+        uint8_t tries = 0;
+        for (;;) {
+            WDT_HIT();
+            ReaderTransmit(frame, len, NULL);
+            uint16_t alen = ReaderReceive(answer, sizeof(answer), par);
+            if (hdr.retries == 0 || (alen >= 2 && memcmp(answer, hdr.expect, 2) == 0)) {
+                break;
+            }
+            if (++tries > hdr.retries) {
+                status = PM3_ERFTRANS;
+                break;
+            }
+            resp.retried++;
+        }
+        if (status != PM3_SUCCESS) {
+            break;
+        }
+        resp.sent++;
+
+        if (hdr.delay_ms) {
+            SpinDelay(hdr.delay_ms);
+        }
+
+        if (BUTTON_PRESS()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+    }
+
+    reply_ng(CMD_HF_ISO14443A_RAW_FRAMES, status, (uint8_t *)&resp, sizeof(resp));
+}
+
 //-----------------------------------------------------------------------------
 // Read an ISO 14443a tag. Send out commands and store answers.
 //-----------------------------------------------------------------------------
@@ -3692,6 +4258,7 @@ static int32_t dist_nt(uint32_t nt1, uint32_t nt2) {
 #define PRNG_SEQUENCE_LENGTH    (1 << 16)
 #define MAX_UNEXPECTED_RANDOM   (4)        // maximum number of unexpected (i.e. real) random numbers when trying to sync. Then give up.
 #define MAX_SYNC_TRIES          (32)
+#define ABORT_CHECK_INTERVAL    (100)      // auth requests between checks for button / client. The client stops a run once it has candidates
 
 //-----------------------------------------------------------------------------
 // Recover several bits of the cypher stream. This implements (first stages of)
@@ -3734,6 +4301,9 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
 
     // static variables here, is re-used in the next call
     static int32_t sync_cycles = 0;
+    // the PRNG period found on the last card, a restart on the same card starts from there
+    static int32_t learned_sync_cycles = 0;
+    static uint32_t learned_cuid = 0;
     static uint32_t nt_attacked = 0;
     static uint8_t mf_nr_ar3 = 0;
     static uint8_t par_low = 0;
@@ -3765,7 +4335,7 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
         WDT_HIT();
 
         // Test if the action was cancelled
-        if (checkbtn_cnt == 1000) {
+        if (checkbtn_cnt == ABORT_CHECK_INTERVAL) {
             if (BUTTON_PRESS() || data_available()) {
                 isOK = 5;
                 return_status = PM3_EOPABORTED;
@@ -3796,6 +4366,10 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
                     break;
             }
             have_uid = true;
+
+            if (first_try && learned_sync_cycles && cuid == learned_cuid) {
+                sync_cycles = learned_sync_cycles;
+            }
         } else { // no need for anticollision. We can directly select the card
             if (!iso14443a_fast_select_card(uid, cascade_levels)) {
                 if (g_dbglevel >= DBG_INFO)    Dbprintf("Mifare: Can't select card (UID)");
@@ -3853,6 +4427,8 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
             // if no distance between,  then we are in sync.
             if (nt_distance == 0) {
                 nt_attacked = nt;
+                learned_sync_cycles = sync_cycles;
+                learned_cuid = cuid;
             } else {
                 if (nt_distance == -99999) { // invalid nonce received
                     unexpected_random++;
@@ -3910,6 +4486,12 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
             if (catch_up_cycles == last_catch_up) {
                 consecutive_resyncs++;
             } else {
+                // drifting the same way again, the period is off. Move half way instead of
+                // waiting for four identical misses, slow PRNG cards rarely miss identically
+                if (last_catch_up && ((last_catch_up < 0) == (catch_up_cycles < 0))) {
+                    sync_cycles += catch_up_cycles / 2;
+                    learned_sync_cycles = sync_cycles;
+                }
                 last_catch_up = catch_up_cycles;
                 consecutive_resyncs = 0;
             }
@@ -3920,6 +4502,7 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
                 }
             } else {
                 sync_cycles += catch_up_cycles;
+                learned_sync_cycles = sync_cycles;
 
                 if (g_dbglevel >= DBG_EXTENDED) {
                     Dbprintf("Lost sync in cycle %d for the fourth time consecutively (nt_distance = %d). Adjusting sync_cycles to %d.\n", i, catch_up_cycles, sync_cycles);
@@ -4321,7 +4904,10 @@ void SimulateIso14443aTagAID(uint8_t tagType, uint16_t flags, uint8_t *uid,
     int sentCount = 0;
     bool odd_reply = true;
 
+    // the ring setting only applies to this trace
+    set_tracing_ring((flags & FLAG_TRACE_RING) == FLAG_TRACE_RING);
     clear_trace();
+    set_tracing_ring(false);
     set_tracing(true);
     LED_A_ON();
 
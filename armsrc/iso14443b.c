@@ -185,6 +185,10 @@
 # define ISO14B_BLOCK_SIZE  4
 #endif
 
+#ifndef ISO14B_CTS_BLOCK_SIZE
+# define ISO14B_CTS_BLOCK_SIZE  2
+#endif
+
 // 4sample
 #define SEND4STUFFBIT(x) tosend_stuffbit(!(x));tosend_stuffbit(!(x));tosend_stuffbit(!(x));tosend_stuffbit(!(x));
 
@@ -2366,6 +2370,126 @@ out:
     switch_off();
 }
 
+static int read_14b_cts_block(uint8_t blocknr, uint8_t *block) {
+
+    uint8_t cmd[] = {ASK_READ | (blocknr & 0x0F), 0x00, 0x00};
+    AddCrc14B(cmd, 1);
+
+    uint8_t r_block[4] = {0};
+
+    uint32_t start_time = 0;
+    uint32_t eof_time = 0;
+    CodeAndTransmit14443bAsReader(cmd, sizeof(cmd), &start_time, &eof_time, true);
+
+    eof_time += DELAY_ISO14443B_PCD_TO_PICC_READER;
+    uint16_t retlen = 0;
+    if (Get14443bAnswerFromTag(r_block, sizeof(r_block), s_iso14b_timeout, &eof_time, &retlen) != PM3_SUCCESS) {
+        return PM3_ECARDEXCHANGE;
+    }
+
+    if (retlen != 4) {
+        return PM3_EWRONGANSWER;
+    }
+    if (check_crc(CRC_14443_B, r_block, retlen) == false) {
+        return PM3_ECRC;
+    }
+
+    if (block) {
+        memcpy(block, r_block, ISO14B_CTS_BLOCK_SIZE);
+    }
+
+    return PM3_SUCCESS;
+}
+
+/**
+* Reads the requested blocks of a SRx / ST25TB or ASK CTS tag in one field session.
+* The dump stays in BigBuf, the client downloads it in one go.
+*/
+void iso14443b_dump(const iso14b_dump_t *p) {
+    iso14443b_setup();
+
+    clear_trace();
+    set_tracing(true);
+
+    iso14b_dump_resp_t resp = {0};
+    resp.block_size = (p->type == ISO14B_CT) ? ISO14B_CTS_BLOCK_SIZE : ISO14B_BLOCK_SIZE;
+
+    uint8_t count = MIN(p->count, ISO14B_DUMP_MAX_BLOCKS);
+    bool sysblock = (p->type == ISO14B_SR) && (p->flags & ISO14B_DUMP_SYSBLOCK);
+    uint16_t len = (count + (sysblock ? 1 : 0)) * resp.block_size;
+
+    uint8_t *data = BigBuf_calloc(len);
+    if (data == NULL) {
+        reply_ng(CMD_HF_ISO14443B_DUMP, PM3_EMALLOC, (uint8_t *)&resp, sizeof(resp));
+        goto out;
+    }
+
+    int res;
+    if (p->type == ISO14B_CT) {
+        res = iso14443b_select_cts_card(&resp.cts);
+    } else {
+        res = iso14443b_select_srx_card(&resp.card);
+    }
+
+    if (res != PM3_SUCCESS) {
+        reply_ng(CMD_HF_ISO14443B_DUMP, res, (uint8_t *)&resp, sizeof(resp));
+        goto out;
+    }
+
+    bool all = true;
+    for (uint8_t i = 0; i < sizeof(p->bitmap); i++) {
+        if (p->bitmap[i]) {
+            all = false;
+            break;
+        }
+    }
+
+    for (uint16_t i = 0; i < count + (sysblock ? 1 : 0); i++) {
+
+        bool is_sys = (i == count);
+        if (is_sys == false && all == false && (p->bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+            continue;
+        }
+
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        uint8_t *blk = data + (i * resp.block_size);
+        for (uint8_t retry = 0; retry < 3; retry++) {
+            if (p->type == ISO14B_CT) {
+                res = read_14b_cts_block(i, blk);
+            } else {
+                res = read_14b_srx_block(is_sys ? 0xFF : i, blk);
+            }
+            if (res == PM3_SUCCESS) {
+                break;
+            }
+        }
+
+        // a block the tag won't give us after three tries means it left the field
+        if (res != PM3_SUCCESS) {
+            break;
+        }
+
+        if (is_sys) {
+            resp.flags |= ISO14B_DUMP_SYSBLOCK;
+        } else {
+            resp.bitmap[i >> 3] |= (1 << (i & 7));
+        }
+    }
+
+    resp.offset = data - BigBuf_get_addr();
+    resp.len = len;
+    reply_ng(CMD_HF_ISO14443B_DUMP, res, (uint8_t *)&resp, sizeof(resp));
+
+out:
+    set_tracing(false);
+    BigBuf_free_keep_EM();
+    switch_off();
+}
+
 //=============================================================================
 // Finally, the `sniffer' combines elements from both the reader and
 // simulated tag, to show both sides of the conversation.
@@ -2419,10 +2543,10 @@ void SniffIso14443b(void) {
     StartCountSspClk();
 
     // The DMA buffer, used to stream samples from the FPGA
-    dmabuf16_t *dma = get_dma16();
+    dmabuf16_t *dma = get_dma16_sized(DMA_SNIFF_BUFFER_SIZE);
 
     // Setup and start DMA.
-    if (!FpgaSetupSscDma((uint8_t *) dma->buf, DMA_BUFFER_SIZE)) {
+    if (!FpgaSetupSscDma((uint8_t *) dma->buf, dma->size)) {
         if (g_dbglevel > DBG_ERROR) DbpString("FpgaSetupSscDma failed. Exiting");
         switch_off();
         return;
@@ -2438,14 +2562,36 @@ void SniffIso14443b(void) {
 
     // Count of samples received so far, so that we can include timing
     int samples = 0;
+    int max_behind_by = 0;
+    uint32_t overruns = 0;
 
     uint16_t *upTo = dma->buf;
 
     for (;;) {
 
-        volatile int behind_by = ((uint16_t *)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (DMA_BUFFER_SIZE - 1);
+        volatile int behind_by = ((uint16_t *)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (dma->size - 1);
         if (behind_by < 1) continue;
 
+        if (behind_by > max_behind_by) {
+            max_behind_by = behind_by;
+        }
+
+        // about to be overwritten by the DMA. Drop what is pending, at most up to the end
+        // of the buffer so the wrap below still rearms the DMA, and resync on the next frame
+        if (behind_by > (9 * dma->size / 10)) {
+            int skip = MIN(behind_by, (dma->buf + dma->size) - upTo) - 1;
+            if (skip > 0) {
+                upTo += skip;
+                samples += skip;
+                overruns++;
+                Uart14bReset();
+                Demod14bReset();
+                tag_is_active = false;
+                reader_is_active = false;
+                expect_tag_answer = false;
+            }
+        }
+
         samples++;
         if (samples == 1) {
             // DMA has transferred the very first data
@@ -2457,7 +2603,7 @@ void SniffIso14443b(void) {
         upTo++;
 
         // we have read all of the DMA buffer content.
-        if (upTo >= dma->buf + DMA_BUFFER_SIZE) {
+        if (upTo >= dma->buf + dma->size) {
 
             // start reading the circular buffer from the beginning again
             upTo = dma->buf;
@@ -2468,12 +2614,12 @@ void SniffIso14443b(void) {
                 // primary buffer was stopped
                 if (AT91C_BASE_PDC_SSC->PDC_RCR == 0) {
                     AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) dma->buf;
-                    AT91C_BASE_PDC_SSC->PDC_RCR = DMA_BUFFER_SIZE;
+                    AT91C_BASE_PDC_SSC->PDC_RCR = dma->size;
                 }
                 // secondary buffer sets as primary, secondary buffer was stopped
                 if (AT91C_BASE_PDC_SSC->PDC_RNCR == 0) {
                     AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t) dma->buf;
-                    AT91C_BASE_PDC_SSC->PDC_RNCR = DMA_BUFFER_SIZE;
+                    AT91C_BASE_PDC_SSC->PDC_RNCR = dma->size;
                 }
 
                 WDT_HIT();
@@ -2557,6 +2703,8 @@ void SniffIso14443b(void) {
     Dbprintf("  DecodeReader byteCnt...%d", Uart.byteCnt);
     Dbprintf("  DecodeReader posCount..%d", Uart.posCnt);
     Dbprintf("  Trace length..........." _YELLOW_("%d"), BigBuf_get_traceLen());
+    Dbprintf("  DMA max fill...........%d / %u", max_behind_by, dma->size);
+    Dbprintf("  DMA overruns...........%u", overruns);
     DbpString("");
 }
 
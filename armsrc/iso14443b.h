@@ -46,6 +46,7 @@ int iso14443b_select_card(iso14b_card_select_t *card);
 void SimulateIso14443bTag(const uint8_t *pupi);
 void read_14b_st_block(uint8_t blocknr);
 int read_14b_srx_block(uint8_t blocknr, uint8_t *block);
+void iso14443b_dump(const iso14b_dump_t *p);
 int iso14443b_select_srx_card(iso14b_card_select_t *card);
 void SniffIso14443b(void);
 void SendRawCommand14443B(iso14b_raw_cmd_t *p);
@@ -73,6 +73,7 @@
 #include "ticks.h"
 #include "BigBuf.h"
 #include "crc16.h"
+#include "rftiming.h"
 
 // Delays in SSP_CLK ticks.
 // SSP_CLK runs at 13,56MHz / 32 = 423.75kHz when simulating a tag
@@ -332,6 +333,7 @@ void TransmitTo15693Tag(const uint8_t *cmd, int len, uint32_t *start_time, bool
     LED_B_OFF();
 
     *start_time = *start_time + DELAY_ARM_TO_TAG;
+    rft_frame(RFT_15, *start_time * 4, (*start_time + 32 * (8 * len - 4)) * 4);
     FpgaDisableTracing();
 }
 
@@ -1113,10 +1115,15 @@ int GetIso15693AnswerFromTag(uint8_t *response, uint16_t max_len, uint16_t timeo
     }
 
     if (ret != PM3_SUCCESS) {
+        if (ret == PM3_ETIMEOUT) {
+            rft_timeout(RFT_15);
+        }
         *resp_len = 0;
         return ret;
     }
 
+    rft_answer(RFT_15, sof_time * 4, *eof_time * 4);
+
     if (fsk) {
         LogTrace_ISO15693(dtf->output, dtf->len, (sof_time * 4), (*eof_time * 4), NULL, false);
         *resp_len = dtf->len;
@@ -1628,7 +1635,7 @@ void AcquireRawAdcSamplesIso15693(void) {
     LEDsoff();
 }
 
-void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool iclass) {
+void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool iclass, bool stream) {
 
     LEDsoff();
     LED_A_ON();
@@ -1664,10 +1671,10 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
     StartCountSspClk();
 
     // The DMA buffer, used to stream samples from the FPGA
-    dmabuf16_t *dma = get_dma16();
+    dmabuf16_t *dma = get_dma16_sized(DMA_SNIFF_BUFFER_SIZE);
 
     // Setup and start DMA.
-    if (FpgaSetupSscDma((uint8_t *) dma->buf, DMA_BUFFER_SIZE) == false) {
+    if (FpgaSetupSscDma((uint8_t *) dma->buf, dma->size) == false) {
         if (g_dbglevel > DBG_ERROR) DbpString("FpgaSetupSscDma failed. Exiting");
         switch_off();
         return;
@@ -1682,13 +1689,44 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
 
     // Count of samples received so far, so that we can include timing
     int samples = 0;
+    int max_behind_by = 0;
+    uint32_t overruns = 0;
 
     const uint16_t *upTo = dma->buf;
 
+    // nothing may be printed while streaming
+    stream = stream && (trace_stream_start() == PM3_SUCCESS);
+
     for (;;) {
 
-        volatile int behind_by = ((uint16_t *)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (DMA_BUFFER_SIZE - 1);
-        if (behind_by < 1) continue;
+        volatile int behind_by = ((uint16_t *)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (dma->size - 1);
+        if (behind_by < 1) {
+            if (stream) {
+                trace_stream_poll();
+            }
+            continue;
+        }
+
+        if (behind_by > max_behind_by) {
+            max_behind_by = behind_by;
+        }
+
+        // about to be overwritten by the DMA. Drop what is pending, at most up to the end
+        // of the buffer so the wrap below still rearms the DMA, and resync on the next frame
+        if (behind_by > (9 * dma->size / 10)) {
+            int skip = MIN(behind_by, (dma->buf + dma->size) - upTo) - 1;
+            if (skip > 0) {
+                upTo += skip;
+                samples += skip;
+                overruns++;
+                DecodeReaderReset(&dreader);
+                DecodeTagReset(&dtag);
+                DecodeTagFSKReset(&dtagfsk);
+                tag_is_active = false;
+                reader_is_active = false;
+                expect_tag_answer = false;
+            }
+        }
 
         samples++;
         if (samples == 1) {
@@ -1701,7 +1739,7 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
         sniffdata = *upTo++;
 
         // we have read all of the DMA buffer content
-        if (upTo >= dma->buf + DMA_BUFFER_SIZE) {
+        if (upTo >= dma->buf + dma->size) {
 
             // start reading the circular buffer from the beginning
             upTo = dma->buf;
@@ -1712,18 +1750,22 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
                 // primary buffer was stopped
                 if (AT91C_BASE_PDC_SSC->PDC_RCR == 0) {
                     AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) dma->buf;
-                    AT91C_BASE_PDC_SSC->PDC_RCR = DMA_BUFFER_SIZE;
+                    AT91C_BASE_PDC_SSC->PDC_RCR = dma->size;
                 }
                 // secondary buffer sets as primary, secondary buffer was stopped
                 if (AT91C_BASE_PDC_SSC->PDC_RNCR == 0) {
                     AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t) dma->buf;
-                    AT91C_BASE_PDC_SSC->PDC_RNCR = DMA_BUFFER_SIZE;
+                    AT91C_BASE_PDC_SSC->PDC_RNCR = dma->size;
                 }
 
                 WDT_HIT();
                 if (BUTTON_PRESS()) {
                     break;
                 }
+                // the client stops a stream with CMD_BREAK_LOOP
+                if (stream && data_available_fast()) {
+                    break;
+                }
             }
         }
 
@@ -1834,6 +1876,11 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
     FpgaDisableTracing();
     switch_off();
 
+    if (stream) {
+        trace_stream_stop();
+        return;
+    }
+
     DbpString("");
     if (g_dbglevel > DBG_ERROR) {
         DbpString(_CYAN_("Sniff statistics"));
@@ -1847,6 +1894,10 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
         Dbprintf("DecodeReader State..... %d", dreader.state);
         Dbprintf("DecodeReader byteCnt... %d", dreader.byteCount);
         Dbprintf("DecodeReader posCount.. %d", dreader.posCount);
+        Dbprintf("DMA max fill........... %d / %u", max_behind_by, dma->size);
+    }
+    if (overruns) {
+        Dbprintf("DMA overruns........... " _RED_("%u"), overruns);
     }
     Dbprintf("Trace length........... " _YELLOW_("%d"), BigBuf_get_traceLen());
 }
@@ -2096,6 +2147,26 @@ void ReaderIso15693(iso15_card_select_t *p_card) {
     BigBuf_free();
 }
 
+// Single slot inventory with the reader field already up.
+// true and the UID, MSB first, when a tag answered
+bool Iso15693Identify(uint8_t *uid) {
+    uint8_t cmd[5] = {0};
+    BuildIdentifyRequest(cmd);
+
+    uint8_t answer[32] = {0};
+    uint32_t eof_time = 0;
+    uint16_t recvlen = 0;
+    int res = SendDataTag(cmd, sizeof(cmd), false, true, answer, sizeof(answer), 0, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+    if (res != PM3_SUCCESS || recvlen < 12) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < ISO15693_UID_LENGTH; i++) {
+        uid[i] = answer[9 - i];
+    }
+    return true;
+}
+
 // When SIM: initialize the Proxmark3 as ISO15693 tag
 void Iso15693InitTag(void) {
 
@@ -2599,80 +2670,367 @@ void SimTagIso15693(const uint8_t *uid, uint8_t block_size) {
 
 // Since there is no standardized way of reading the AFI out of a tag, we will brute force it
 // (some manufactures offer a way to read the AFI, though)
-void BruteforceIso15693Afi(uint32_t flags) {
+// Inventory with 16 slot anticollision (ISO15693-3 annex D).
+// A slot with a garbled answer had more than one tag in it and is queried again with the mask
+// extended by that slot number. Found tags are put to quiet and the root round repeated until
+// it finds nothing new, which also catches collisions the decoder could not tell from silence.
+#define ISO15_INV_MAX_TAGS   128
+#define ISO15_INV_MAX_MASKS  64
 
-    clear_trace();
+typedef struct {
+    uint8_t uid[8];     // LSB first, as on air
+    uint8_t dsfid;
+} iso15_inv_uid_t;
 
-    Iso15693InitReader();
+typedef struct {
+    uint8_t len;        // in bits
+    uint64_t value;
+} iso15_inv_mask_t;
 
-    bool speed = ((flags & ISO15_HIGH_SPEED) == ISO15_HIGH_SPEED);
+static void iso15_inv_uid_msb(const uint8_t *uid_lsb, uint8_t *uid) {
+    for (uint8_t i = 0; i < 8; i++) {
+        uid[i] = uid_lsb[7 - i];
+    }
+}
 
-    // first without AFI
-    // Tags should respond without AFI and with AFI=0 even when AFI is active
-    uint8_t data[7] = {0};
-    uint8_t recv[ISO15693_MAX_RESPONSE_LENGTH] = {0};
+static uint8_t iso15_build_addressed(uint8_t *cmd, uint8_t code, const uint8_t *uid_lsb) {
+    cmd[0] = ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_ADDRESS;
+    cmd[1] = code;
+    memcpy(cmd + 2, uid_lsb, 8);
+    return 10;
+}
 
-    data[0] = (ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_INVENTORY | ISO15_REQINV_SLOT1);
-    data[1] = ISO15693_INVENTORY;
-    data[2] = 0; // AFI
-    AddCrc15(data, 3);
+// one 16 slot round, new UIDs are appended to tags, collided slots pushed as longer masks
+static void iso15_inventory_round(const iso15_inventory_t *params, const iso15_inv_mask_t *mask,
+                                  iso15_inv_uid_t *tags, uint16_t *count,
+                                  iso15_inv_mask_t *masks, uint8_t *nmasks, uint32_t *start_time) {
+
+    uint8_t cmd[14] = {0};
+    uint8_t len = 0;
+    cmd[len++] = ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_INVENTORY | ISO15_REQINV_SLOT16;
+    cmd[len++] = ISO15693_INVENTORY;
+    if (params->flags & ISO15_INVENTORY_AFI) {
+        cmd[0] |= ISO15_REQINV_AFI;
+        cmd[len++] = params->afi;
+    }
+    cmd[len++] = mask->len;
+    for (uint8_t i = 0; i < (mask->len + 7) / 8; i++) {
+        cmd[len++] = (mask->value >> (i * 8)) & 0xFF;
+    }
+    AddCrc15(cmd, len);
+    len += 2;
 
-    int datalen = 5;
+    bool fast = ((params->flags & ISO15_INVENTORY_SLOW) == 0);
+    uint8_t recv[32] = {0};
     uint32_t eof_time = 0;
-    uint16_t recvlen = 0;
-    int res = SendDataTag(data, datalen, true, speed, recv, sizeof(recv), 0, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
-    if (res != PM3_SUCCESS) {
-        DbpString("Failed to select card");
-        reply_ng(CMD_HF_ISO15693_FINDAFI, res, NULL, 0);
-        switch_off();
+
+    for (uint8_t slot = 0; slot < 16; slot++) {
+
+        uint16_t recvlen = 0;
+        int res;
+        if (slot == 0) {
+            res = SendDataTag(cmd, len, false, fast, recv, sizeof(recv), *start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+        } else {
+            res = SendDataTagEOF(recv, sizeof(recv), *start_time, ISO15693_READER_TIMEOUT, &eof_time, false, true, &recvlen);
+        }
+        *start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+
+        if (res == PM3_SUCCESS && recvlen == 12 && CheckCrc15(recv, 12)) {
+
+            bool known = false;
+            for (uint16_t i = 0; i < *count; i++) {
+                if (memcmp(tags[i].uid, recv + 2, 8) == 0) {
+                    known = true;
+                    break;
+                }
+            }
+
+            if (known == false && *count < ISO15_INV_MAX_TAGS) {
+                memcpy(tags[*count].uid, recv + 2, 8);
+                tags[*count].dsfid = recv[1];
+                (*count)++;
+            }
+
+        } else if ((res == PM3_SUCCESS && recvlen > 0) || res == PM3_EOVFLOW) {
+            // collision, all UIDs ending in mask + slot answer again in their own round
+            if (mask->len < 60 && *nmasks < ISO15_INV_MAX_MASKS) {
+                masks[*nmasks].len = mask->len + 4;
+                masks[*nmasks].value = mask->value | ((uint64_t)slot << mask->len);
+                (*nmasks)++;
+            }
+        }
+    }
+}
+
+// all UIDs one root round and the mask rounds below it can tell apart
+static int iso15_inventory_collect(const iso15_inventory_t *params, iso15_inv_uid_t *tags, uint16_t *count,
+                                   iso15_inv_mask_t *masks, uint32_t *start_time) {
+    uint8_t nmasks = 1;
+    masks[0].len = 0;
+    masks[0].value = 0;
+
+    while (nmasks) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            return PM3_EOPABORTED;
+        }
+        iso15_inv_mask_t mask = masks[--nmasks];
+        iso15_inventory_round(params, &mask, tags, count, masks, &nmasks, start_time);
+    }
+    return PM3_SUCCESS;
+}
+
+// reads blocks of one tag and streams them in chunks, returns false if the operation was aborted
+static bool iso15_inventory_read(const iso15_inventory_t *params, iso15_inventory_tag_t *out, const uint8_t *uid_lsb, uint8_t *recv, uint32_t *start_time) {
+
+    uint8_t cmd[16] = {0};
+    uint16_t max_chunk = PM3_CMD_DATA_SIZE - sizeof(iso15_inventory_tag_t);
+    uint16_t nblocks = (out->block_count) ? out->block_count : 256;
+    uint8_t per_read = MAX(params->blocks_per_read, 1);
+
+    out->first_block = 0;
+    out->len = 0;
+
+    uint16_t block = 0;
+    while (block < nblocks) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            return false;
+        }
+
+        // a chunk has to fit one reply, an unknown block size is learnt from a single block read
+        uint8_t n = 1;
+        if (out->block_size) {
+            per_read = MAX(MIN(per_read, max_chunk / out->block_size), 1);
+            n = MIN(per_read, nblocks - block);
+        }
+        uint8_t len = iso15_build_addressed(cmd, (n > 1) ? ISO15693_READ_MULTI_BLOCK : ISO15693_READBLOCK, uid_lsb);
+        cmd[len++] = block & 0xFF;
+        if (n > 1) {
+            cmd[len++] = n - 1;
+        }
+        AddCrc15(cmd, len);
+        len += 2;
+
+        uint32_t eof_time = 0;
+        uint16_t recvlen = 0;
+        int res = SendDataTag(cmd, len, false, true, recv, ISO15693_MAX_RESPONSE_LENGTH, *start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+        *start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+
+        bool ok = (res == PM3_SUCCESS && recvlen > 3 && CheckCrc15(recv, recvlen) && (recv[0] & ISO15_RES_ERROR) == 0);
+        if (ok == false) {
+            if (n > 1) {
+                // not every tag takes that many blocks in one go
+                per_read = n / 2;
+                continue;
+            }
+            // without system info the end of memory is the first block that can't be read
+            break;
+        }
+
+        uint16_t got = recvlen - 3;
+        if (got > max_chunk) {
+            break;
+        }
+        if (out->block_size == 0) {
+            out->block_size = got / n;
+        }
+
+        if (out->len + got > max_chunk) {
+            reply_ng(CMD_HF_ISO15693_INVENTORY, PM3_SUCCESS, (uint8_t *)out, sizeof(iso15_inventory_tag_t) + out->len);
+            out->first_block = block;
+            out->len = 0;
+        }
+        memcpy(out->data + out->len, recv + 1, got);
+        out->len += got;
+        block += n;
+    }
+
+    if (out->block_count == 0) {
+        out->block_count = block;
+    }
+    if (out->len) {
+        reply_ng(CMD_HF_ISO15693_INVENTORY, PM3_SUCCESS, (uint8_t *)out, sizeof(iso15_inventory_tag_t) + out->len);
+    }
+    return true;
+}
+
+void InventoryIso15693(const iso15_inventory_t *params) {
+
+    LED_A_ON();
+    clear_trace();
+    BigBuf_free();
+
+    iso15_inv_uid_t *tags = (iso15_inv_uid_t *)BigBuf_malloc(ISO15_INV_MAX_TAGS * sizeof(iso15_inv_uid_t));
+    iso15_inv_mask_t *masks = (iso15_inv_mask_t *)BigBuf_malloc(ISO15_INV_MAX_MASKS * sizeof(iso15_inv_mask_t));
+    uint8_t *out_buf = BigBuf_malloc(PM3_CMD_DATA_SIZE);
+    uint8_t *recv_buf = BigBuf_malloc(ISO15693_MAX_RESPONSE_LENGTH);
+    if (tags == NULL || masks == NULL || out_buf == NULL || recv_buf == NULL) {
+        reply_ng(CMD_HF_ISO15693_INVENTORY, PM3_EMALLOC, NULL, 0);
+        LED_A_OFF();
         return;
     }
 
-    uint32_t start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
-    WDT_HIT();
+    Iso15693InitReader();
+
+    uint32_t start_time = GetCountSspClk();
+    uint16_t count = 0;
+    uint16_t quieted = 0;
+    int res = PM3_SUCCESS;
+
+    // root rounds until one finds nothing new
+    for (;;) {
+
+        uint16_t before = count;
+        res = iso15_inventory_collect(params, tags, &count, masks, &start_time);
+
+        if (res != PM3_SUCCESS || count == before || count == ISO15_INV_MAX_TAGS) {
+            break;
+        }
+
+        // found tags stay quiet in the next round, addressed commands still reach them
+        for (; quieted < count; quieted++) {
+            uint8_t cmd[12];
+            uint8_t len = iso15_build_addressed(cmd, ISO15693_STAYQUIET, tags[quieted].uid);
+            AddCrc15(cmd, len);
+            uint32_t eof_time = 0;
+            uint16_t recvlen = 0;
+            SendDataTag(cmd, len + 2, false, true, NULL, 0, start_time, 0, &eof_time, &recvlen);
+            start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+        }
+    }
+
+    iso15_inventory_tag_t *out = (iso15_inventory_tag_t *)out_buf;
+
+    for (uint16_t t = 0; t < count && res == PM3_SUCCESS; t++) {
+
+        memset(out, 0, sizeof(iso15_inventory_tag_t));
+        iso15_inv_uid_msb(tags[t].uid, out->uid);
+        out->dsfid = tags[t].dsfid;
+
+        // GET SYSTEM INFO gives AFI, IC reference and the memory layout when the tag has them
+        uint8_t cmd[12];
+        uint8_t len = iso15_build_addressed(cmd, ISO15693_GET_SYSTEM_INFO, tags[t].uid);
+        AddCrc15(cmd, len);
+        uint8_t recv[32] = {0};
+        uint32_t eof_time = 0;
+        uint16_t recvlen = 0;
+        int r = SendDataTag(cmd, len + 2, false, true, recv, sizeof(recv), start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+        start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+
+        if (r == PM3_SUCCESS && recvlen >= 12 && CheckCrc15(recv, recvlen) && (recv[0] & ISO15_RES_ERROR) == 0) {
+            uint8_t info = recv[1];
+            uint8_t i = 10;
+            if (info & 0x01) {
+                out->dsfid = recv[i++];
+            }
+            if (info & 0x02) {
+                out->afi = recv[i++];
+            }
+            if ((info & 0x04) && i + 2 <= recvlen - 2) {
+                out->block_count = recv[i] + 1;
+                out->block_size = (recv[i + 1] & 0x1F) + 1;
+                i += 2;
+            }
+            if ((info & 0x08) && i < recvlen - 2) {
+                out->ic = recv[i];
+            }
+        }
+
+        reply_ng(CMD_HF_ISO15693_INVENTORY, PM3_SUCCESS, (uint8_t *)out, sizeof(iso15_inventory_tag_t));
+
+        if (params->flags & ISO15_INVENTORY_READ) {
+            if (iso15_inventory_read(params, out, tags[t].uid, recv_buf, &start_time) == false) {
+                res = PM3_EOPABORTED;
+            }
+        }
+    }
+
+    switch_off();
+    BigBuf_free();
+    reply_ng(CMD_HF_ISO15693_INVENTORY, res, NULL, 0);
+    LED_A_OFF();
+}
+
+// lists the tags answering for every AFI value
+void BruteforceIso15693Afi(uint32_t flags) {
 
-    if (recvlen >= 12) {
-        Dbprintf("NoAFI UID = %s", iso15693_sprintUID(NULL, recv + 2));
+    LED_A_ON();
+    clear_trace();
+
+    int arena = BigBuf_arena_begin("15 findafi");
+    iso15_inv_uid_t *tags = (iso15_inv_uid_t *)BigBuf_malloc(ISO15_INV_MAX_TAGS * sizeof(iso15_inv_uid_t));
+    iso15_inv_mask_t *masks = (iso15_inv_mask_t *)BigBuf_malloc(ISO15_INV_MAX_MASKS * sizeof(iso15_inv_mask_t));
+    if (tags == NULL || masks == NULL) {
+        BigBuf_arena_end(arena);
+        reply_ng(CMD_HF_ISO15693_FINDAFI, PM3_EMALLOC, NULL, 0);
+        LED_A_OFF();
+        return;
     }
 
-    // now with AFI
-    data[0] |= ISO15_REQINV_AFI;
-    data[2] = 0; // AFI
+    Iso15693InitReader();
+
+    bool speed = ((flags & ISO15_HIGH_SPEED) == ISO15_HIGH_SPEED);
+
+    iso15_inventory_t inv = {
+        .flags = ISO15_INVENTORY_AFI | (speed ? 0 : ISO15_INVENTORY_SLOW),
+    };
+
+    // Tags should respond with AFI=0 even when AFI is active
+    uint8_t data[6] = {0};
+    data[0] = (ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_INVENTORY | ISO15_REQINV_SLOT1 | ISO15_REQINV_AFI);
+    data[1] = ISO15693_INVENTORY;
     data[3] = 0; // mask length
 
-    // 4 + 2crc
-    datalen = 6;
+    uint8_t recv[32] = {0};
+    uint32_t start_time = GetCountSspClk();
+    int res = PM3_SUCCESS;
 
-    bool aborted = false;
     for (uint16_t i = 0; i < 256; i++) {
 
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        // a one slot probe first, an AFI nobody answers costs one slot instead of sixteen
         data[2] = i & 0xFF;
         AddCrc15(data, 4);
 
-        recvlen = 0;
-        res = SendDataTag(data, datalen, false, speed, recv, sizeof(recv), start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+        uint32_t eof_time = 0;
+        uint16_t recvlen = 0;
+        int r = SendDataTag(data, sizeof(data), false, speed, recv, sizeof(recv), start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
         start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
 
-        WDT_HIT();
+        if (recvlen == 0 && r != PM3_EOVFLOW) {
+            continue;
+        }
 
-        if (recvlen >= 12) {
-            Dbprintf("AFI = %i  UID = %s", i, iso15693_sprintUID(NULL, recv + 2));
+        // any answer, even a garbled one, means tags with this AFI: list them all with 16 slots
+        inv.afi = i & 0xFF;
+        uint16_t count = 0;
+        res = iso15_inventory_collect(&inv, tags, &count, masks, &start_time);
+
+        for (uint16_t t = 0; t < count; t++) {
+            iso15_inventory_tag_t out = {
+                .dsfid = tags[t].dsfid,
+                .afi = inv.afi,
+            };
+            iso15_inv_uid_msb(tags[t].uid, out.uid);
+            reply_ng(CMD_HF_ISO15693_FINDAFI, PM3_SUCCESS, (uint8_t *)&out, sizeof(out));
         }
 
-        aborted = (BUTTON_PRESS() || data_available());
-        if (aborted) {
+        if (res != PM3_SUCCESS) {
             break;
         }
     }
 
-    DbpString("AFI Bruteforcing done.");
     switch_off();
-
-    if (aborted) {
-        reply_ng(CMD_HF_ISO15693_FINDAFI, PM3_EOPABORTED, NULL, 0);
-    } else {
-        reply_ng(CMD_HF_ISO15693_FINDAFI, PM3_SUCCESS, NULL, 0);
-    }
+    BigBuf_arena_end(arena);
+    reply_ng(CMD_HF_ISO15693_FINDAFI, res, NULL, 0);
+    LED_A_OFF();
 }
 
 // Allows to directly send commands to the tag via the client
@@ -2761,6 +3119,236 @@ void SendRawCommand15693(iso15_raw_cmd_t *packet) {
     LED_A_OFF();
 }
 
+// Block loops for hf 15 dump / restore.
+// READ / WRITE MULTIPLE BLOCKS are used when the tag takes them, the number of blocks per
+// command is halved when a tag refuses, down to single block commands.
+#define ISO15_BLOCKS_MAX_READ   32
+#define ISO15_BLOCKS_MAX_WRITE  128  // bytes per WRITE MULTIPLE BLOCKS
+
+static uint8_t iso15_blocks_build(uint8_t *cmd, const iso15_blocks_t *p, uint8_t code_single, uint8_t code_multi, uint8_t block, uint8_t n) {
+    uint8_t len = 0;
+    cmd[len++] = p->req_flags;
+    cmd[len++] = (n > 1) ? code_multi : code_single;
+    if (p->req_flags & ISO15_REQ_ADDRESS) {
+        memcpy(cmd + len, p->uid, ISO15693_UID_LENGTH);
+        len += ISO15693_UID_LENGTH;
+    }
+    cmd[len++] = block;
+    if (n > 1) {
+        cmd[len++] = n - 1;
+    }
+    return len;
+}
+
+// a write with the OPTION flag gets its answer only after an extra EOF
+static int iso15_blocks_exchange(const uint8_t *cmd, uint16_t len, bool write, bool fast, uint8_t *recv, uint16_t max_len, uint32_t *start_time, uint16_t *recvlen) {
+    uint32_t eof_time = 0;
+    int res = SendDataTag(cmd, len, false, fast, recv, max_len, *start_time, write ? ISO15693_READER_TIMEOUT_WRITE : ISO15693_READER_TIMEOUT, &eof_time, recvlen);
+    if (res != PM3_ETEAROFF && write && (cmd[0] & ISO15_REQ_OPTION)) {
+        *start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+        bool fsk = ((cmd[0] & ISO15_REQ_SUBCARRIER_TWO) == ISO15_REQ_SUBCARRIER_TWO);
+        bool recv_speed = ((cmd[0] & ISO15_REQ_DATARATE_HIGH) == ISO15_REQ_DATARATE_HIGH);
+        res = SendDataTagEOF(recv, max_len, *start_time, ISO15693_READER_TIMEOUT, &eof_time, fsk, recv_speed, recvlen);
+    }
+    *start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+    return res;
+}
+
+static void iso15_blocks_start(const iso15_blocks_t *p, uint32_t *start_time) {
+    LED_A_ON();
+    if (p->flags & ISO15_CONNECT) {
+        Iso15693InitReader();
+    }
+    *start_time = GetCountSspClk();
+}
+
+void ReadBlocksIso15693(const iso15_blocks_t *p) {
+
+    uint32_t start_time = 0;
+    iso15_blocks_start(p, &start_time);
+
+    bool fast = ((p->flags & ISO15_HIGH_SPEED) == ISO15_HIGH_SPEED);
+    uint8_t lock = (p->req_flags & ISO15_REQ_OPTION) ? 1 : 0;
+    uint16_t per_block = p->block_size + 1;
+
+    int arena = BigBuf_arena_begin("15 read");
+    uint8_t *recv = BigBuf_malloc(ISO15693_MAX_RESPONSE_LENGTH);
+    uint8_t *out_buf = BigBuf_malloc(PM3_CMD_DATA_SIZE);
+    iso15_blocks_resp_t *out = (iso15_blocks_resp_t *)out_buf;
+    uint16_t max_blocks = (PM3_CMD_DATA_SIZE - sizeof(iso15_blocks_resp_t)) / per_block;
+
+    uint8_t per = (p->blocks_per_cmd) ? p->blocks_per_cmd : ISO15_BLOCKS_MAX_READ;
+    per = MIN(per, max_blocks);
+    per = MAX(per, 1);
+
+    memset(out, 0, sizeof(iso15_blocks_resp_t));
+    out->first_block = p->first_block;
+    out->block_size = p->block_size;
+
+    int res = PM3_SUCCESS;
+    uint8_t tries = 0;
+    uint16_t block = p->first_block;
+    uint16_t end = MIN(p->first_block + p->count, 256);
+
+    while (block < end) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        uint8_t n = MIN(per, end - block);
+        uint8_t cmd[16] = {0};
+        uint8_t len = iso15_blocks_build(cmd, p, ISO15693_READBLOCK, ISO15693_READ_MULTI_BLOCK, block, n);
+        AddCrc15(cmd, len);
+        len += 2;
+
+        uint16_t recvlen = 0;
+        res = iso15_blocks_exchange(cmd, len, false, fast, recv, ISO15693_MAX_RESPONSE_LENGTH, &start_time, &recvlen);
+        if (res == PM3_ETEAROFF) {
+            break;
+        }
+
+        bool crc_ok = (recvlen >= 3 && CheckCrc15(recv, recvlen));
+        bool tag_error = (crc_ok && (recv[0] & ISO15_RES_ERROR));
+        bool ok = (crc_ok && tag_error == false && recvlen == 3 + n * (p->block_size + lock));
+
+        if (ok == false) {
+            if (n > 1) {
+                per = n / 2;
+                continue;
+            }
+            if (tag_error) {
+                // error 0x0F / 0x10 is where the memory ends on tags without system info
+                out->error = recv[1];
+                res = PM3_SUCCESS;
+                break;
+            }
+            if (++tries > p->retries) {
+                res = (recvlen) ? PM3_ECRC : PM3_ETIMEOUT;
+                break;
+            }
+            continue;
+        }
+        tries = 0;
+        res = PM3_SUCCESS;
+
+        if (out->count + n > max_blocks) {
+            out->blocks_per_cmd = per;
+            reply_ng(CMD_HF_ISO15693_READ_BLOCKS, PM3_SUCCESS, out_buf, sizeof(iso15_blocks_resp_t) + out->count * per_block);
+            out->first_block = block;
+            out->count = 0;
+        }
+
+        const uint8_t *d = recv + 1;
+        for (uint8_t i = 0; i < n; i++) {
+            uint8_t *o = out->data + (out->count * per_block);
+            o[0] = (lock) ? *d++ : 0;
+            memcpy(o + 1, d, p->block_size);
+            d += p->block_size;
+            out->count++;
+        }
+        block += n;
+    }
+
+    out->blocks_per_cmd = per;
+    if (out->count) {
+        reply_ng(CMD_HF_ISO15693_READ_BLOCKS, PM3_SUCCESS, out_buf, sizeof(iso15_blocks_resp_t) + out->count * per_block);
+    }
+
+    // final reply, no data
+    out->first_block = block;
+    out->count = 0;
+    reply_ng(CMD_HF_ISO15693_READ_BLOCKS, res, out_buf, sizeof(iso15_blocks_resp_t));
+
+    BigBuf_arena_end(arena);
+    LED_A_OFF();
+}
+
+void WriteBlocksIso15693(const iso15_blocks_t *p) {
+
+    uint32_t start_time = 0;
+    iso15_blocks_start(p, &start_time);
+
+    bool fast = ((p->flags & ISO15_HIGH_SPEED) == ISO15_HIGH_SPEED);
+
+    uint8_t max_multi = MAX(ISO15_BLOCKS_MAX_WRITE / MAX(p->block_size, 1), 1);
+    uint8_t per = (p->blocks_per_cmd) ? p->blocks_per_cmd : max_multi;
+    per = MIN(per, max_multi);
+
+    iso15_blocks_resp_t out = {
+        .first_block = p->first_block,
+        .block_size = p->block_size,
+    };
+
+    int arena = BigBuf_arena_begin("15 write");
+    uint8_t *cmd = BigBuf_malloc(16 + ISO15_BLOCKS_MAX_WRITE);
+    uint8_t recv[32] = {0};
+
+    int res = PM3_SUCCESS;
+    uint8_t tries = 0;
+    uint16_t done = 0;
+
+    while (done < p->count) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        uint8_t n = MIN(per, p->count - done);
+        uint16_t len = iso15_blocks_build(cmd, p, ISO15693_WRITEBLOCK, ISO15693_WRITE_MULTI_BLOCK, p->first_block + done, n);
+        memcpy(cmd + len, p->data + (done * p->block_size), n * p->block_size);
+        len += n * p->block_size;
+        AddCrc15(cmd, len);
+        len += 2;
+
+        uint16_t recvlen = 0;
+        res = iso15_blocks_exchange(cmd, len, true, fast, recv, sizeof(recv), &start_time, &recvlen);
+        if (res == PM3_ETEAROFF) {
+            break;
+        }
+
+        bool crc_ok = (recvlen >= 3 && CheckCrc15(recv, recvlen));
+        bool tag_error = (crc_ok && (recv[0] & ISO15_RES_ERROR));
+
+        if (crc_ok && tag_error == false) {
+            done += n;
+            tries = 0;
+            res = PM3_SUCCESS;
+            continue;
+        }
+
+        if (n > 1) {
+            // most tags don't implement WRITE MULTIPLE BLOCKS at all
+            per = 1;
+            continue;
+        }
+
+        if (tag_error) {
+            out.error = recv[1];
+            if (recv[1] == 0x0F || recv[1] == 0x10) {
+                res = PM3_EOUTOFBOUND;
+                break;
+            }
+        }
+
+        if (++tries > p->retries) {
+            res = (tag_error) ? PM3_EWRONGANSWER : (recvlen) ? PM3_ECRC : PM3_ETIMEOUT;
+            break;
+        }
+    }
+
+    out.count = done;
+    out.blocks_per_cmd = per;
+    reply_ng(CMD_HF_ISO15693_WRITE_BLOCKS, res, (uint8_t *)&out, sizeof(out));
+
+    BigBuf_arena_end(arena);
+    LED_A_OFF();
+}
+
 /*
 SLIx functions from official master forks.
 
@@ -3327,6 +3915,110 @@ void DisablePrivacySlixIso15693(const uint8_t *password) {
     switch_off();
 }
 
+// Password search on a SLIX tag, all GET RANDOM / SET PASSWORD exchanges stay on the device.
+// Both requests are unaddressed so a tag in privacy mode answers too. Some tags ignore further
+// SET PASSWORD after a wrong one until they lose power, reset_ms cycles the field for those.
+static void slix_brute_reply(uint8_t done, int status, uint32_t tried, const uint8_t *pwd) {
+    iso15_slix_brute_resp_t r = { .done = done, .tried = tried };
+    memcpy(r.current, pwd, sizeof(r.current));
+    reply_ng(CMD_HF_ISO15693_SLIX_BRUTE, status, (uint8_t *)&r, sizeof(r));
+}
+
+static void slix_brute_field_reset(uint8_t ms, uint32_t *start_time) {
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    SpinDelay(ms);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER);
+    SpinDelay(ms);
+    *start_time = GetCountSspClk();
+}
+
+void BruteforceSlixPassword(const iso15_slix_brute_t *p) {
+
+    LED_A_ON();
+    Iso15693InitReader();
+    set_tracing(false);
+
+    // 0x04, == NXP from manufacture id list.
+    uint8_t c_rnd[] = { ISO15_REQ_DATARATE_HIGH, ISO15693_GET_RANDOM_NUMBER, 0x04, 0x00, 0x00 };
+    AddCrc15(c_rnd, 3);
+    uint8_t c_pwd[] = { ISO15_REQ_DATARATE_HIGH, ISO15693_SET_PASSWORD, 0x04, p->pass_id, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+    uint8_t recv[16] = {0};
+    uint8_t pwd[4] = {0};
+    uint32_t start_time = GetCountSspClk();
+    uint32_t eof_time = 0;
+    uint32_t tried = 0;
+    uint32_t last_report = GetTickCount();
+    int res = PM3_ENODATA;
+
+    // range 0 - FFFFFFFF has one more candidate than fits the counter, so count down what is left
+    uint32_t left = (p->count) ? p->count - 1 : p->end - p->start;
+    uint32_t idx = 0;
+
+    for (;;) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        if (p->count) {
+            memcpy(pwd, p->data + (idx * 4), 4);
+        } else {
+            uint32_t v = p->start + idx;
+            pwd[0] = (v >> 24) & 0xFF;
+            pwd[1] = (v >> 16) & 0xFF;
+            pwd[2] = (v >> 8) & 0xFF;
+            pwd[3] = v & 0xFF;
+        }
+
+        uint16_t recvlen = 0;
+        SendDataTag(c_rnd, sizeof(c_rnd), false, true, recv, sizeof(recv), start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+        start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+        if (recvlen != 5 || CheckCrc15(recv, 5) == false) {
+            // one more chance after a field reset before calling the tag gone
+            slix_brute_field_reset(MAX(p->reset_ms, 5), &start_time);
+            SendDataTag(c_rnd, sizeof(c_rnd), false, true, recv, sizeof(recv), start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+            start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+            if (recvlen != 5 || CheckCrc15(recv, 5) == false) {
+                res = PM3_ETIMEOUT;
+                break;
+            }
+        }
+
+        init_password_15693_Slix(&c_pwd[4], pwd, &recv[1]);
+        AddCrc15(c_pwd, 8);
+        SendDataTag(c_pwd, sizeof(c_pwd), false, true, recv, sizeof(recv), start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+        start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+        tried++;
+
+        if (recvlen == 3 && CheckCrc15(recv, 3) && (recv[0] & ISO15_RES_ERROR) == 0) {
+            res = PM3_SUCCESS;
+            break;
+        }
+
+        if (left == 0) {
+            break;
+        }
+        left--;
+        idx++;
+
+        if (p->reset_ms) {
+            slix_brute_field_reset(p->reset_ms, &start_time);
+        }
+
+        if (GetTickCount() - last_report > 1000) {
+            slix_brute_reply(0, PM3_SUCCESS, tried, pwd);
+            last_report = GetTickCount();
+        }
+    }
+
+    switch_off();
+    slix_brute_reply(1, res, tried, pwd);
+    LED_A_OFF();
+}
+
 void EnablePrivacySlixIso15693(const uint8_t *password) {
     LED_D_ON();
     Iso15693InitReader();
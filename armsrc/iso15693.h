@@ -46,11 +46,15 @@ int GetIso15693AnswerFromTag(uint8_t *response, uint16_t max_len, uint16_t timeo
 //void RecordRawAdcSamplesIso15693(void);
 void AcquireRawAdcSamplesIso15693(void);
 void ReaderIso15693(iso15_card_select_t *p_card); // ISO15693 reader
+bool Iso15693Identify(uint8_t *uid);
 void SimTagIso15693(const uint8_t *uid, uint8_t block_size); // simulate an ISO15693 tag
 void BruteforceIso15693Afi(uint32_t flags); // find an AFI of a tag
-void SendRawCommand15693(iso15_raw_cmd_t *packet); // send arbitrary commands from CLI
+void InventoryIso15693(const iso15_inventory_t *params); // find all tags in the field and read them
+void SendRawCommand15693(iso15_raw_cmd_t *packet);
+void ReadBlocksIso15693(const iso15_blocks_t *packet);
+void WriteBlocksIso15693(const iso15_blocks_t *packet); // send arbitrary commands from CLI
 
-void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool iclass);
+void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool iclass, bool stream);
 
 int SendDataTag(const uint8_t *send, int sendlen, bool init, bool speed_fast, uint8_t *recv,
                 uint16_t max_recv_len, uint32_t start_time, uint16_t timeout, uint32_t *eof_time, uint16_t *resp_len);
@@ -62,6 +66,7 @@ void SetTag15693Uid_v2(const uint8_t *uid);
 
 void WritePasswordSlixIso15693(const uint8_t *old_password, const uint8_t *new_password, uint8_t pwd_id);
 void DisablePrivacySlixIso15693(const uint8_t *password);
+void BruteforceSlixPassword(const iso15_slix_brute_t *packet);
 void EnablePrivacySlixIso15693(const uint8_t *password);
 void DisableEAS_AFISlixIso15693(const uint8_t *password, bool usepwd);
 void EnableEAS_AFISlixIso15693(const uint8_t *password, bool usepwd);
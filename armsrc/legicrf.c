@@ -66,6 +66,9 @@ static uint32_t last_frame_end; /* ts of last bit of previews rx or tx frame */
 
 static uint32_t input_threshold = 8; /* heuristically determined, lower values */
 /* lead to detecting false ack during write */
+static uint32_t rx_threshold = 8;    /* input_threshold, raised above the noise floor at session start */
+
+#define LEGIC_RETRIES         3 /* a byte with a crc error or a missing write ack is tried again */
 
 //-----------------------------------------------------------------------------
 // I/O interface abstraction (FPGA -> ARM)
@@ -107,7 +110,7 @@ static uint16_t rx_frame_from_fpga(void) {
 // has a delay loop that aligns rx_bit calls to the TAG tx timeslots.
 //
 // Note: inlining this function would fail with -Os
-static bool rx_bit(void) {
+static int32_t rx_power(void) {
     int32_t sum_cq = 0;
     int32_t sum_ci = 0;
 
@@ -128,8 +131,27 @@ static bool rx_bit(void) {
     // calculate power
     int32_t power = (MAX(ABS(sum_ci), ABS(sum_cq)) + (MIN(ABS(sum_ci), ABS(sum_cq)) >> 1));
 
-    // compare average (power / 8) to threshold
-    return ((power >> 3) > input_threshold);
+    // average (power / 8)
+    return (power >> 3);
+}
+
+static bool rx_bit(void) {
+    return (rx_power() > rx_threshold);
+}
+
+// Samples the subcarrier while the card is charging and silent. The peak noise
+// level plus a margin becomes the threshold for this session, never lower than
+// the configured one.
+static void calibrate_threshold(void) {
+    int32_t peak = 0;
+    for (uint8_t i = 0; i < 8; ++i) {
+        peak = MAX(peak, rx_power());
+    }
+    rx_threshold = MAX(input_threshold, (uint32_t)(peak + (peak >> 1)));
+
+    if (g_dbglevel >= DBG_DEBUG) {
+        Dbprintf("noise peak %d, threshold %u", peak, rx_threshold);
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -284,7 +306,7 @@ static int init_card(uint8_t cardtype, legic_card_select_t *p_card) {
     return PM3_SUCCESS;
 }
 
-static void init_reader(void) {
+static void init_reader(bool clear_mem) {
     // configure FPGA
     FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
     FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_SUBCARRIER_212_KHZ | FPGA_HF_READER_MODE_RECEIVE_IQ);
@@ -301,7 +323,7 @@ static void init_reader(void) {
 
     // reserve a cardmem, meaning we can use the tracelog function in bigbuff easier.
     legic_mem = BigBuf_get_EM_addr();
-    if (legic_mem) {
+    if (legic_mem && clear_mem) {
         memset(legic_mem, 0x00, LEGIC_CARD_MEMSIZE);
     }
 
@@ -326,8 +348,9 @@ static uint32_t setup_phase(uint8_t iv) {
     // init coordination timestamp
     last_frame_end = GET_TICKS;
 
-    // Switch on carrier and let the card charge for 5ms.
+    // Switch on carrier and let the card charge for 5ms. Measure the noise floor meanwhile
     last_frame_end += 7500;
+    calibrate_threshold();
     while (GET_TICKS < last_frame_end) { };
 
     legic_prng_init(0);
@@ -376,18 +399,33 @@ static int16_t read_byte(uint16_t index, uint8_t cmd_sz) {
     uint8_t byte = BYTEx(frame, 0);
     uint8_t crc = BYTEx(frame, 1);
 
+    legic_prng_forward(1);
+
     // check received against calculated crc
     uint8_t calc_crc = calc_crc4(cmd, cmd_sz, byte);
     if (calc_crc != crc) {
-        Dbprintf("!!! crc mismatch: %x != %x !!!",  calc_crc, crc);
+        if (g_dbglevel >= DBG_EXTENDED) {
+            Dbprintf("!!! crc mismatch: %x != %x !!!",  calc_crc, crc);
+        }
         return -1;
     }
 
-    legic_prng_forward(1);
-
     return byte;
 }
 
+// The prng keeps running on time, a byte with a crc error can simply be asked for again
+static int16_t read_byte_retry(uint16_t index, uint8_t cmd_sz, uint16_t *retries) {
+    for (uint8_t i = 0; i < LEGIC_RETRIES; ++i) {
+        int16_t byte = read_byte(index, cmd_sz);
+        if (byte != -1) {
+            return byte;
+        }
+        (*retries)++;
+    }
+    Dbprintf("!!! crc mismatch at %u !!!", index);
+    return -1;
+}
+
 // Transmit write command, wait until (3.6ms) the tag sends back an unencrypted
 // ACK ('1' bit) and forward the prng time based.
 static bool write_byte(uint16_t index, uint8_t byte, uint8_t addr_sz) {
@@ -407,6 +445,16 @@ static bool write_byte(uint16_t index, uint8_t byte, uint8_t addr_sz) {
     return rx_ack();
 }
 
+static bool write_byte_retry(uint16_t index, uint8_t byte, uint8_t addr_sz, uint16_t *retries) {
+    for (uint8_t i = 0; i < LEGIC_RETRIES; ++i) {
+        if (write_byte(index, byte, addr_sz)) {
+            return true;
+        }
+        (*retries)++;
+    }
+    return false;
+}
+
 //-----------------------------------------------------------------------------
 // Command Line Interface
 //
@@ -418,7 +466,7 @@ legic_card_select_t *getLegicCardInfo(void) {
 
 void LegicRfInfo(void) {
     // configure ARM and FPGA
-    init_reader();
+    init_reader(true);
 
     // establish shared secret and detect card type
     uint8_t card_type = setup_phase(0x01);
@@ -428,8 +476,9 @@ void LegicRfInfo(void) {
     }
 
     // read UID
+    uint16_t retries = 0;
     for (uint8_t i = 0; i < sizeof(card.uid); ++i) {
-        int16_t byte = read_byte(i, card.cmdsize);
+        int16_t byte = read_byte_retry(i, card.cmdsize, &retries);
         if (byte == -1) {
             reply_ng(CMD_HF_LEGIC_INFO, PM3_EFAILED, NULL, 0);
             goto OUT;
@@ -438,7 +487,7 @@ void LegicRfInfo(void) {
     }
 
     // read MCC and check against UID
-    int16_t mcc = read_byte(4, card.cmdsize);
+    int16_t mcc = read_byte_retry(4, card.cmdsize, &retries);
     int16_t calc_mcc = CRC8Legic(card.uid, 4);
     if (mcc != calc_mcc) {
         reply_ng(CMD_HF_LEGIC_INFO, PM3_ESOFT, NULL, 0);
@@ -458,7 +507,7 @@ int LegicRfReaderEx(uint16_t offset, uint16_t len, uint8_t iv) {
     int res = PM3_SUCCESS;
 
     // configure ARM and FPGA
-    init_reader();
+    init_reader(true);
 
     // establish shared secret and detect card type
     uint8_t card_type = setup_phase(iv);
@@ -472,8 +521,9 @@ int LegicRfReaderEx(uint16_t offset, uint16_t len, uint8_t iv) {
         len = card.cardsize - offset;
     }
 
+    uint16_t retries = 0;
     for (uint16_t i = 0; i < len; ++i) {
-        int16_t byte = read_byte(offset + i, card.cmdsize);
+        int16_t byte = read_byte_retry(offset + i, card.cmdsize, &retries);
         if (byte == -1) {
             res = PM3_EOVFLOW;
             goto OUT;
@@ -493,7 +543,7 @@ OUT:
 
 void LegicRfReader(uint16_t offset, uint16_t len, uint8_t iv) {
     // configure ARM and FPGA
-    init_reader();
+    init_reader(true);
 
     // establish shared secret and detect card type
     uint8_t card_type = setup_phase(iv);
@@ -507,8 +557,9 @@ void LegicRfReader(uint16_t offset, uint16_t len, uint8_t iv) {
         len = card.cardsize - offset;
     }
 
+    uint16_t retries = 0;
     for (uint16_t i = 0; i < len; ++i) {
-        int16_t byte = read_byte(offset + i, card.cmdsize);
+        int16_t byte = read_byte_retry(offset + i, card.cmdsize, &retries);
         if (byte == -1) {
             reply_ng(CMD_HF_LEGIC_READER, PM3_EFAILED, NULL, 0);
             goto OUT;
@@ -520,6 +571,10 @@ void LegicRfReader(uint16_t offset, uint16_t len, uint8_t iv) {
         }
     }
 
+    if (g_dbglevel >= DBG_DEBUG) {
+        Dbprintf("%u bytes read, %u retries", len, retries);
+    }
+
     // OK
     reply_ng(CMD_HF_LEGIC_READER, PM3_SUCCESS, (uint8_t *)&len, sizeof(len));
 
@@ -528,20 +583,18 @@ OUT:
     StopTicks();
 }
 
-void LegicRfWriter(uint16_t offset, uint16_t len, uint8_t iv, const uint8_t *data) {
-    // configure ARM and FPGA
-    init_reader();
+static void legic_write(uint16_t cmd, uint16_t offset, uint16_t len, uint8_t iv, const uint8_t *data) {
 
     // uid is not writeable
     if (offset <= WRITE_LOWERLIMIT) {
-        reply_ng(CMD_HF_LEGIC_WRITER, PM3_EINVARG, NULL, 0);
+        reply_ng(cmd, PM3_EINVARG, NULL, 0);
         goto OUT;
     }
 
     // establish shared secret and detect card type
     uint8_t card_type = setup_phase(iv);
     if (init_card(card_type, &card) != PM3_SUCCESS) {
-        reply_ng(CMD_HF_LEGIC_WRITER, PM3_EINIT, NULL, 0);
+        reply_ng(cmd, PM3_EINIT, NULL, 0);
         goto OUT;
     }
 
@@ -551,22 +604,48 @@ void LegicRfWriter(uint16_t offset, uint16_t len, uint8_t iv, const uint8_t *dat
     }
 
     // write in reverse order, only then is DCF (decremental field) writable
+    uint16_t retries = 0;
     while (len-- > 0 && BUTTON_PRESS() == false) {
-        if (write_byte(len + offset, data[len], card.addrsize) == false) {
+        if (write_byte_retry(len + offset, data[len], card.addrsize, &retries) == false) {
             Dbprintf("operation failed | %02X | %02X | %02X", len + offset, len, data[len]);
-            reply_ng(CMD_HF_LEGIC_WRITER, PM3_EFAILED, NULL, 0);
+            reply_ng(cmd, PM3_EFAILED, NULL, 0);
             goto OUT;
         }
     }
 
+    if (g_dbglevel >= DBG_DEBUG) {
+        Dbprintf("write done, %u retries", retries);
+    }
+
     // OK
-    reply_ng(CMD_HF_LEGIC_WRITER, PM3_SUCCESS, (uint8_t *)&len, sizeof(len));
+    reply_ng(cmd, PM3_SUCCESS, (uint8_t *)&len, sizeof(len));
 
 OUT:
     switch_off();
     StopTicks();
 }
 
+void LegicRfWriter(uint16_t offset, uint16_t len, uint8_t iv, const uint8_t *data) {
+    // configure ARM and FPGA
+    init_reader(true);
+    legic_write(CMD_HF_LEGIC_WRITER, offset, len, iv, data);
+}
+
+// Writes offset .. offset + len from emulator memory in one field session,
+// used to restore a whole card that doesn't fit in one packet
+void LegicRfWriterEml(uint16_t offset, uint16_t len, uint8_t iv) {
+    // configure ARM and FPGA, keep the emulator memory
+    init_reader(false);
+
+    if (legic_mem == NULL || offset + len > LEGIC_CARD_MEMSIZE) {
+        reply_ng(CMD_HF_LEGIC_WRITER_EML, PM3_EINVARG, NULL, 0);
+        switch_off();
+        StopTicks();
+        return;
+    }
+    legic_write(CMD_HF_LEGIC_WRITER_EML, offset, len, iv, legic_mem + offset);
+}
+
 void LegicRfSetThreshold(uint32_t threshold) {
     input_threshold = threshold;
 }
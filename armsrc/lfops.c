@@ -39,6 +39,7 @@
 #include "flashmem.h" // persistence on flash
 #include "spiffs.h"   // spiffs
 #include "appmain.h"  // print stack
+#include "bruteforce.h"
 
 /*
 Notes about EM4xxx timings.
@@ -825,7 +826,8 @@ void WriteTItag(uint32_t idhi, uint32_t idlo, uint16_t crc, bool ledcontrol) {
 
 // note:   a call to FpgaDownloadAndGo(FPGA_BITSTREAM_LF) must be done before, but
 //  this may destroy the bigbuf so be sure this is called before calling SimulateTagLowFrequencyEx
-void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles) {
+// packed, the buffer holds one bit per sample, msb first, instead of one byte
+static void simulate_lf(int period, int gap, bool ledcontrol, int numcycles, bool packed) {
 
     // start us timer
     StartTicks();
@@ -880,7 +882,8 @@ void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycl
 
         if (ledcontrol) LED_D_OFF();
 
-        if (buf[i])
+        uint8_t sample = (packed) ? (buf[i >> 3] & (0x80 >> (i & 7))) : buf[i];
+        if (sample)
             OPEN_COIL();
         else
             SHORT_COIL();
@@ -913,10 +916,18 @@ OUT:
     if (ledcontrol) LED_D_OFF();
 }
 
+void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles) {
+    simulate_lf(period, gap, ledcontrol, numcycles, false);
+}
+
 void SimulateTagLowFrequency(int period, int gap, bool ledcontrol) {
     SimulateTagLowFrequencyEx(period, gap, ledcontrol, -1);
 }
 
+void SimulateTagLowFrequencyPacked(int period, int gap, bool ledcontrol) {
+    simulate_lf(period, gap, ledcontrol, -1, true);
+}
+
 
 #define DEBUG_FRAME_CONTENTS 1
 void SimulateTagLowFrequencyBidir(int divisor, int max_bitlen) {
@@ -1017,6 +1028,105 @@ void CmdHIDsimTAG(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool
     reply_ng(CMD_LF_HID_SIMULATE, PM3_EOPABORTED, NULL, 0);
 }
 
+static void hid_brute_flip(uint32_t *out, uint8_t pos) {
+    // out is hi2, hi, lo
+    out[2 - (pos / 32)] ^= (1u << (pos % 32));
+}
+
+static void hid_brute_pack(const lf_hid_brute_t *p, uint32_t fc, uint32_t cn, uint32_t *out) {
+    memcpy(out, p->base, sizeof(p->base));
+
+    for (uint8_t i = 0; i < p->fc_bits + p->cn_bits; i++) {
+        uint32_t v = (i < p->fc_bits) ? (fc >> i) : (cn >> (i - p->fc_bits));
+        if ((v & 1) == 0) {
+            continue;
+        }
+
+        const lf_hid_brute_col_t *c = &p->cols[i];
+        if (c->pos != 0xFF) {
+            hid_brute_flip(out, c->pos);
+        }
+        for (uint8_t j = 0; j < p->npar; j++) {
+            if (c->par & (1 << j)) {
+                hid_brute_flip(out, p->par[j]);
+            }
+        }
+    }
+}
+
+// Bruteforces a HID reader without the client in the loop. Every candidate is packed from the
+// format description and simulated for dwell ms, stepping up, down or both ways from start.
+void CmdHIDBrute(const lf_hid_brute_t *p, bool ledcontrol) {
+
+    lf_hid_brute_resp_t resp = {
+        .up = p->start,
+        .down = p->start,
+    };
+
+    // 125 kHz, one sample per carrier cycle
+    int numcycles = p->dwell * 125;
+
+    bool fin_up = (p->direction == 2) || (p->start > p->max);
+    bool fin_down = (p->direction == 1) || (p->start < p->min);
+    uint32_t up = p->start;
+    uint32_t down = p->start;
+    // both ways, start is only simulated once
+    if (p->direction == 0 && down > p->min) {
+        down--;
+    } else if (p->direction == 0) {
+        fin_down = true;
+    }
+
+    int res = PM3_SUCCESS;
+    while (fin_up == false || fin_down == false) {
+
+        for (uint8_t dir = 0; dir < 2; dir++) {
+
+            if ((dir == 0 && fin_up) || (dir == 1 && fin_down)) {
+                continue;
+            }
+
+            uint32_t v = (dir == 0) ? up : down;
+            uint32_t fc = (p->field == 0) ? v : p->fixed;
+            uint32_t cn = (p->field == 0) ? p->fixed : v;
+
+            uint32_t m[3];
+            hid_brute_pack(p, fc, cn, m);
+            CmdHIDsimTAGEx(m[0], m[1], m[2], p->longFMT, ledcontrol, numcycles);
+            resp.tried++;
+
+            if (dir == 0) {
+                resp.up = up;
+                if (up >= p->max) {
+                    fin_up = true;
+                } else {
+                    up++;
+                }
+            } else {
+                resp.down = down;
+                if (down <= p->min) {
+                    fin_down = true;
+                } else {
+                    down--;
+                }
+            }
+
+            // the sim returns early on button press or client abort
+            if (BUTTON_PRESS() || data_available()) {
+                res = PM3_EOPABORTED;
+                goto out;
+            }
+
+            reply_ng(CMD_LF_HID_BRUTE_PROGRESS, PM3_SUCCESS, (uint8_t *)&resp, sizeof(resp));
+        }
+    }
+
+out:
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    if (ledcontrol) LEDsoff();
+    reply_ng(CMD_LF_HID_BRUTE, res, (uint8_t *)&resp, sizeof(resp));
+}
+
 // prepare a waveform pattern in the buffer based on the ID given then
 // simulate a FSK tag until the button is pressed
 // arg1 contains fcHigh and fcLow, arg2 contains STT marker and clock
@@ -1272,245 +1382,232 @@ void CmdNRZsimTAG(uint8_t invert, uint8_t separator, uint8_t clk, uint16_t size,
     reply_ng(CMD_LF_NRZ_SIMULATE, PM3_EOPABORTED, NULL, 0);
 }
 
-// loop to get raw HID waveform then FSK demodulate the TAG ID from it
-int lf_hid_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol) {
+// samples per acquisition, EM410x needs the most
+#define LF_WATCH_SAMPLES    16385
+#define LF_WATCH_BUF        ((LF_WATCH_SAMPLES + 3) & ~3)
+
+// FSK demodulate the HID TAG ID
+static bool lf_watch_hid(uint8_t *dest, lf_watch_entry_t *e) {
 
-    size_t size;
     uint32_t hi2 = 0, hi = 0, lo = 0;
     int dummyIdx = 0;
-    // Configure to go in 125kHz listen mode
-    LFSetupFPGAForADC(LF_DIVISOR_125, true);
-
-    uint8_t *dest = BigBuf_get_addr();
-    BigBuf_Clear_keep_EM();
-    clear_trace();
-    set_tracing(false);
-
-    //clear read buffer
-    BigBuf_Clear_keep_EM();
-
-    int res = PM3_SUCCESS;
-    for (;;) {
 
-        WDT_HIT();
+    // 50 * 128 * 2 - big enough to catch 2 sequences of largest format
+    size_t size = 12800;
 
-        if (data_available() || BUTTON_PRESS()) {
-            res = PM3_EOPABORTED;
-            break;
-        }
+    int idx = HIDdemodFSK(dest, &size, &hi2, &hi, &lo, &dummyIdx);
+    if (idx <= 0 || lo == 0 || (size != 96 && size != 192)) {
+        return false;
+    }
 
-        DoAcquisition_default(-1, false, ledcontrol);
+    e->raw[0] = hi2;
+    e->raw[1] = hi;
+    e->raw[2] = lo;
 
-        // FSK demodulator
-        // 50 * 128 * 2 - big enough to catch 2 sequences of largest format
-        size = MIN(12800, BigBuf_max_traceLen());
+    // extra large HID tags 88/192 bits are left to the client
+    if (hi2 != 0) {
+        return true;
+    }
 
-        int idx = HIDdemodFSK(dest, &size, &hi2, &hi, &lo, &dummyIdx);
-        if (idx < 0) continue;
+    // standard HID tags 44/96 bits
+    uint8_t bitlen = 37;
+    uint32_t fac = ((hi & 0xF) << 12) | (lo >> 20);
+    uint32_t cardnum = (lo >> 1) & 0x7FFFF;
 
-        if (idx > 0 && lo > 0 && (size == 96 || size == 192)) {
-            // go over previously decoded manchester data and decode into usable tag ID
-            if (hi2 != 0) { //extra large HID tags  88/192 bits
-                Dbprintf("TAG ID: " _GREEN_("%x%08x%08x") " (%d)",
-                         hi2,
-                         hi,
-                         lo,
-                         (lo >> 1) & 0xFFFF
-                        );
-            } else {  //standard HID tags 44/96 bits
-                uint8_t bitlen = 0;
-                uint32_t fac = 0;
-                uint32_t cardnum = 0;
-
-                if (((hi >> 5) & 1) == 1) { //if bit 38 is set then < 37 bit format is used
-                    uint32_t lo2 = 0;
-                    lo2 = (((hi & 31) << 12) | (lo >> 20)); //get bits 21-37 to check for format len bit
-                    uint8_t idx3 = 1;
-                    while (lo2 > 1) { //find last bit set to 1 (format len bit)
-                        lo2 >>= 1;
-                        idx3++;
-                    }
-                    bitlen = idx3 + 19;
-                    fac = 0;
-                    cardnum = 0;
-                    if (bitlen == 26) {
-                        cardnum = (lo >> 1) & 0xFFFF;
-                        fac = (lo >> 17) & 0xFF;
-                    }
-                    if (bitlen == 37) {
-                        cardnum = (lo >> 1) & 0x7FFFF;
-                        fac = ((hi & 0xF) << 12) | (lo >> 20);
-                    }
-                    if (bitlen == 34) {
-                        cardnum = (lo >> 1) & 0xFFFF;
-                        fac = ((hi & 1) << 15) | (lo >> 17);
-                    }
-                    if (bitlen == 35) {
-                        cardnum = (lo >> 1) & 0xFFFFF;
-                        fac = ((hi & 1) << 11) | (lo >> 21);
-                    }
-                } else { //if bit 38 is not set then 37 bit format is used
-                    bitlen = 37;
-                    cardnum = (lo >> 1) & 0x7FFFF;
-                    fac = ((hi & 0xF) << 12) | (lo >> 20);
-                }
-                Dbprintf("TAG ID: " _GREEN_("%x%08x (%d)") " - Format Len: " _GREEN_("%d") " bit - FC: " _GREEN_("%d") " - Card: "_GREEN_("%d"),
-                         hi,
-                         lo,
-                         (lo >> 1) & 0xFFFF,
-                         bitlen,
-                         fac,
-                         cardnum
-                        );
-            }
-            if (findone) {
-                *high = hi;
-                *low = lo;
-                break;
-            }
-            // reset
+    if (((hi >> 5) & 1) == 1) { //if bit 38 is set then < 37 bit format is used
+        uint32_t lo2 = (((hi & 31) << 12) | (lo >> 20)); //get bits 21-37 to check for format len bit
+        uint8_t idx3 = 1;
+        while (lo2 > 1) { //find last bit set to 1 (format len bit)
+            lo2 >>= 1;
+            idx3++;
+        }
+        bitlen = idx3 + 19;
+        fac = 0;
+        cardnum = 0;
+        if (bitlen == 26) {
+            cardnum = (lo >> 1) & 0xFFFF;
+            fac = (lo >> 17) & 0xFF;
+        }
+        if (bitlen == 37) {
+            cardnum = (lo >> 1) & 0x7FFFF;
+            fac = ((hi & 0xF) << 12) | (lo >> 20);
+        }
+        if (bitlen == 34) {
+            cardnum = (lo >> 1) & 0xFFFF;
+            fac = ((hi & 1) << 15) | (lo >> 17);
+        }
+        if (bitlen == 35) {
+            cardnum = (lo >> 1) & 0xFFFFF;
+            fac = ((hi & 1) << 11) | (lo >> 21);
         }
-        hi2 = hi = lo = idx = 0;
     }
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    BigBuf_free();
-    if (ledcontrol) LEDsoff();
-    return res;
+
+    e->type = bitlen;
+    e->fc = fac;
+    e->cn = cardnum;
+    return true;
 }
 
-// loop to get raw HID waveform then FSK demodulate the TAG ID from it
-int lf_awid_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol) {
+// FSK demodulate the AWID TAG ID
+static bool lf_watch_awid(uint8_t *dest, lf_watch_entry_t *e) {
 
-    size_t size;
+    size_t size = 12800;
     int dummyIdx = 0;
 
-    uint8_t *dest = BigBuf_get_addr();
-    BigBuf_Clear_keep_EM();
-    clear_trace();
-    set_tracing(false);
-
-    LFSetupFPGAForADC(LF_DIVISOR_125, true);
-
-    int res = PM3_SUCCESS;
-    for (;;) {
-
-        WDT_HIT();
+    int idx = detectAWID(dest, &size, &dummyIdx);
+    if (idx <= 0 || size != 96) {
+        return false;
+    }
 
-        if (data_available() || BUTTON_PRESS()) {
-            res = PM3_EOPABORTED;
-            break;
-        }
+    // Index map
+    // 0            10            20            30              40            50              60
+    // |            |             |             |               |             |               |
+    // 01234567 890 1 234 5 678 9 012 3 456 7 890 1 234 5 678 9 012 3 456 7 890 1 234 5 678 9 012 3 - to 96
+    // -----------------------------------------------------------------------------
+    // 00000001 000 1 110 1 101 1 011 1 101 1 010 0 000 1 000 1 010 0 001 0 110 1 100 0 000 1 000 1
+    // premable bbb o bbb o bbw o fff o fff o ffc o ccc o ccc o ccc o ccc o ccc o wxx o xxx o xxx o - to 96
+    //          |---26 bit---|    |-----117----||-------------142-------------|
+    // b = format bit len, o = odd parity of last 3 bits
+    // f = facility code, c = card number
+    // w = wiegand parity
+    // (26 bit format shown)
+
+    //get raw ID before removing parities
+    e->raw[0] = bytebits_to_byte(dest + idx, 32);
+    e->raw[1] = bytebits_to_byte(dest + idx + 32, 32);
+    e->raw[2] = bytebits_to_byte(dest + idx + 64, 32);
+
+    size = removeParity(dest, idx + 8, 4, 1, 88);
+    if (size != 66) {
+        return false;
+    }
 
-        DoAcquisition_default(-1, false, ledcontrol);
-        // FSK demodulator
-
-        size = MIN(12800, BigBuf_max_traceLen());
-
-        //askdemod and manchester decode
-        int idx = detectAWID(dest, &size, &dummyIdx);
-
-        if (idx <= 0 || size != 96) continue;
-        // Index map
-        // 0            10            20            30              40            50              60
-        // |            |             |             |               |             |               |
-        // 01234567 890 1 234 5 678 9 012 3 456 7 890 1 234 5 678 9 012 3 456 7 890 1 234 5 678 9 012 3 - to 96
-        // -----------------------------------------------------------------------------
-        // 00000001 000 1 110 1 101 1 011 1 101 1 010 0 000 1 000 1 010 0 001 0 110 1 100 0 000 1 000 1
-        // premable bbb o bbb o bbw o fff o fff o ffc o ccc o ccc o ccc o ccc o ccc o wxx o xxx o xxx o - to 96
-        //          |---26 bit---|    |-----117----||-------------142-------------|
-        // b = format bit len, o = odd parity of last 3 bits
-        // f = facility code, c = card number
-        // w = wiegand parity
-        // (26 bit format shown)
-
-        //get raw ID before removing parities
-        uint32_t rawLo = bytebits_to_byte(dest + idx + 64, 32);
-        uint32_t rawHi = bytebits_to_byte(dest + idx + 32, 32);
-        uint32_t rawHi2 = bytebits_to_byte(dest + idx, 32);
-
-        size = removeParity(dest, idx + 8, 4, 1, 88);
-        if (size != 66) continue;
-        // ok valid card found!
-
-        // Index map
-        // 0           10         20        30          40        50        60
-        // |           |          |         |           |         |         |
-        // 01234567 8 90123456 7890123456789012 3 456789012345678901234567890123456
-        // -----------------------------------------------------------------------------
-        // 00011010 1 01110101 0000000010001110 1 000000000000000000000000000000000
-        // bbbbbbbb w ffffffff cccccccccccccccc w xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
-        // |26 bit|   |-117--| |-----142------|
-        // b = format bit len, o = odd parity of last 3 bits
-        // f = facility code, c = card number
-        // w = wiegand parity
-        // (26 bit format shown)
-
-        uint8_t fmtLen = bytebits_to_byte(dest, 8);
-        if (fmtLen == 26) {
-            uint32_t fac = bytebits_to_byte(dest + 9, 8);
-            uint32_t cardnum = bytebits_to_byte(dest + 17, 16);
-            uint32_t code1 = bytebits_to_byte(dest + 8, fmtLen);
-            Dbprintf("AWID Found - Bit length: " _GREEN_("%d") ", FC: " _GREEN_("%d") ", Card: " _GREEN_("%d") " - Wiegand: %x, Raw: %08x%08x%08x", fmtLen, fac, cardnum, code1, rawHi2, rawHi, rawLo);
+    // Index map
+    // 0           10         20        30          40        50        60
+    // |           |          |         |           |         |         |
+    // 01234567 8 90123456 7890123456789012 3 456789012345678901234567890123456
+    // -----------------------------------------------------------------------------
+    // 00011010 1 01110101 0000000010001110 1 000000000000000000000000000000000
+    // bbbbbbbb w ffffffff cccccccccccccccc w xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+    // |26 bit|   |-117--| |-----142------|
+    // b = format bit len, o = odd parity of last 3 bits
+    // f = facility code, c = card number
+    // w = wiegand parity
+    // (26 bit format shown)
+
+    uint8_t fmtLen = bytebits_to_byte(dest, 8);
+    e->type = fmtLen;
+    if (fmtLen == 26) {
+        e->fc = bytebits_to_byte(dest + 9, 8);
+        e->cn = bytebits_to_byte(dest + 17, 16);
+        e->wiegand[0] = bytebits_to_byte(dest + 8, fmtLen);
+    } else {
+        e->cn = bytebits_to_byte(dest + 8 + (fmtLen - 17), 16);
+        if (fmtLen > 32) {
+            e->wiegand[0] = bytebits_to_byte(dest + 8, fmtLen - 32);
+            e->wiegand[1] = bytebits_to_byte(dest + 8 + (fmtLen - 32), 32);
         } else {
-            uint32_t cardnum = bytebits_to_byte(dest + 8 + (fmtLen - 17), 16);
-            if (fmtLen > 32) {
-                uint32_t code1 = bytebits_to_byte(dest + 8, fmtLen - 32);
-                uint32_t code2 = bytebits_to_byte(dest + 8 + (fmtLen - 32), 32);
-                Dbprintf("AWID Found - Bit length: " _GREEN_("%d") " -unknown bit length- (%d) - Wiegand: %x%08x, Raw: %08x%08x%08x", fmtLen, cardnum, code1, code2, rawHi2, rawHi, rawLo);
-            } else {
-                uint32_t code1 = bytebits_to_byte(dest + 8, fmtLen);
-                Dbprintf("AWID Found - Bit length: " _GREEN_("%d") " -unknown bit length- (%d) - Wiegand: %x, Raw: %08x%08x%08x", fmtLen, cardnum, code1, rawHi2, rawHi, rawLo);
-            }
-        }
-        if (findone) {
-            *high = rawHi;
-            *low = rawLo;
-            break;
+            e->wiegand[0] = bytebits_to_byte(dest + 8, fmtLen);
         }
     }
-
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    BigBuf_free();
-    if (ledcontrol) LEDsoff();
-    return res;
+    return true;
 }
 
-int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low, bool ledcontrol) {
+// ASK / manchester demodulate the EM410x TAG ID
+static bool lf_watch_em410x(uint8_t *dest, lf_watch_entry_t *e) {
 
-    size_t size, idx = 0;
+    size_t size = LF_WATCH_SAMPLES, idx = 0;
     int clk = 0, invert = 0, maxErr = 20;
     uint32_t hi = 0;
     uint64_t lo = 0;
 
-    uint8_t *dest = BigBuf_get_addr();
-    clear_trace();
-    set_tracing(false);
-    BigBuf_Clear_keep_EM();
+    int errCnt = askdemod(dest, &size, &clk, &invert, maxErr, 0, 1);
+    if (errCnt > 50) {
+        return false;
+    }
 
-    LFSetupFPGAForADC(LF_DIVISOR_125, true);
+    WDT_HIT();
 
-    int res = PM3_SUCCESS;
-    for (;;) {
-        WDT_HIT();
+    int type = Em410xDecode(dest, &size, &idx, &hi, &lo);
+    if (type <= 0) {
+        return false;
+    }
 
-        if (data_available() || BUTTON_PRESS()) {
-            res = PM3_EOPABORTED;
-            break;
-        }
+    e->type = type;
+    e->raw[0] = hi;
+    e->raw[1] = (uint32_t)(lo >> 32);
+    e->raw[2] = (uint32_t)lo;
+    return true;
+}
 
-        DoAcquisition_default(-1, false, ledcontrol);
+// FSK demodulate the IO Prox TAG ID
+static bool lf_watch_io(uint8_t *dest, lf_watch_entry_t *e) {
 
-        size = MIN(16385, BigBuf_max_traceLen());
+    size_t size = 12000;
+    int dummyIdx = 0;
 
-        //askdemod and manchester decode
-        int errCnt = askdemod(dest, &size, &clk, &invert, maxErr, 0, 1);
-        if (errCnt > 50) continue;
+    //fskdemod and get start index
+    int idx = detectIOProx(dest, &size, &dummyIdx);
+    if (idx < 0) {
+        return false;
+    }
 
-        WDT_HIT();
+    //Index map
+    //0           10          20          30          40          50          60
+    //|           |           |           |           |           |           |
+    //01234567 8 90123456 7 89012345 6 78901234 5 67890123 4 56789012 3 45678901 23
+    //-----------------------------------------------------------------------------
+    //00000000 0 11110000 1 facility 1 version* 1 code*one 1 code*two 1 checksum 11
+    //
+    //Checksum:
+    //00000000 0 11110000 1 11100000 1 00000001 1 00000011 1 10110110 1 01110101 11
+    //preamble      F0         E0         01         03         B6         75
+    // How to calc checksum,
+    // http://www.proxmark.org/forum/viewtopic.php?id=364&p=6
+    //   F0 + E0 + 01 + 03 + B6 = 28A
+    //   28A & FF = 8A
+    //   FF - 8A = 75
+    // Checksum: 0x75
+    //XSF(version)facility:codeone+codetwo
+    e->raw[1] = bytebits_to_byte(dest + idx, 32);
+    e->raw[2] = bytebits_to_byte(dest + idx + 32, 32);
+    e->type = bytebits_to_byte(dest + idx + 27, 8); //14,4
+    e->fc = bytebits_to_byte(dest + idx + 18, 8);
+    e->cn = (bytebits_to_byte(dest + idx + 36, 8) << 8) | (bytebits_to_byte(dest + idx + 45, 8)); //36,9
+    return true;
+}
 
-        int type = Em410xDecode(dest, &size, &idx, &hi, &lo);
-        if (type > 0) {
-            if (type & 0x1) {
+static void lf_watch_print(const lf_watch_entry_t *e) {
+    switch (e->protocol) {
+        case LF_WATCH_HID: {
+            if (e->raw[0] != 0) { //extra large HID tags  88/192 bits
+                Dbprintf("TAG ID: " _GREEN_("%x%08x%08x") " (%d)", e->raw[0], e->raw[1], e->raw[2], (e->raw[2] >> 1) & 0xFFFF);
+            } else {
+                Dbprintf("TAG ID: " _GREEN_("%x%08x (%d)") " - Format Len: " _GREEN_("%d") " bit - FC: " _GREEN_("%d") " - Card: "_GREEN_("%d"),
+                         e->raw[1],
+                         e->raw[2],
+                         (e->raw[2] >> 1) & 0xFFFF,
+                         e->type,
+                         e->fc,
+                         e->cn
+                        );
+            }
+            break;
+        }
+        case LF_WATCH_AWID: {
+            if (e->type == 26) {
+                Dbprintf("AWID Found - Bit length: " _GREEN_("%d") ", FC: " _GREEN_("%d") ", Card: " _GREEN_("%d") " - Wiegand: %x, Raw: %08x%08x%08x", e->type, e->fc, e->cn, e->wiegand[0], e->raw[0], e->raw[1], e->raw[2]);
+            } else if (e->type > 32) {
+                Dbprintf("AWID Found - Bit length: " _GREEN_("%d") " -unknown bit length- (%d) - Wiegand: %x%08x, Raw: %08x%08x%08x", e->type, e->cn, e->wiegand[0], e->wiegand[1], e->raw[0], e->raw[1], e->raw[2]);
+            } else {
+                Dbprintf("AWID Found - Bit length: " _GREEN_("%d") " -unknown bit length- (%d) - Wiegand: %x, Raw: %08x%08x%08x", e->type, e->cn, e->wiegand[0], e->raw[0], e->raw[1], e->raw[2]);
+            }
+            break;
+        }
+        case LF_WATCH_EM410X: {
+            uint32_t hi = e->raw[0];
+            uint64_t lo = ((uint64_t)e->raw[1] << 32) | e->raw[2];
+            if (e->type & 0x1) {
                 Dbprintf("EM TAG ID: " _GREEN_("%02x%08x") " - ( %05d_%03d_%08d )",
                          (uint32_t)(lo >> 32),
                          (uint32_t)lo,
@@ -1518,7 +1615,7 @@ int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low, bool ledcontrol)
                          (uint32_t)((lo >> 16LL) & 0xFF),
                          (uint32_t)(lo & 0xFFFFFF));
             }
-            if (type & 0x2) {
+            if (e->type & 0x2) {
                 Dbprintf("EM XL TAG ID: " _GREEN_("%06x%08x%08x") " - ( %05d_%03d_%08d )",
                          hi,
                          (uint32_t)(lo >> 32),
@@ -1527,7 +1624,7 @@ int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low, bool ledcontrol)
                          (uint32_t)((lo >> 16LL) & 0xFF),
                          (uint32_t)(lo & 0xFFFFFF));
             }
-            if (type & 0x4) {
+            if (e->type & 0x4) {
                 uint64_t data = (lo << 20) >> 20;
                 // Convert back to Short ID
                 uint64_t id = ((uint64_t)hi << 16) | (lo >> 48);
@@ -1550,39 +1647,51 @@ int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low, bool ledcontrol)
                              (uint32_t)data);
                 }
             }
-            if (findone) {
-                *high = hi;
-                *low = lo;
-                break;
-            }
+            break;
+        }
+        case LF_WATCH_IO: {
+            Dbprintf("IO Prox " _GREEN_("XSF(%02d)%02x:%05d") " (%08x%08x)", e->type, e->fc, e->cn, e->raw[1], e->raw[2]);
+            break;
         }
-        hi = lo = size = idx = 0;
-        clk = invert = 0;
+        default:
+            break;
     }
-
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    BigBuf_free();
-    if (ledcontrol) LEDsoff();
-    return res;
 }
 
-int lf_io_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol) {
+// One acquisition per cycle, every enabled demodulator runs over the same samples.
+// The demodulators work in place, so with more than one enabled each gets a fresh copy.
+// Streaming sends every ID once per holdoff as CMD_LF_WATCH, otherwise every decode is
+// printed and with found set the loop ends on the first one.
+static int lf_watch_loop(uint8_t protocols, uint16_t holdoff, bool stream, lf_watch_entry_t *found, bool ledcontrol) {
 
-    int dummyIdx = 0;
-    uint32_t code = 0, code2 = 0;
-    uint8_t version = 0, facilitycode = 0;
-    uint16_t number = 0;
+    static bool (*const demods[])(uint8_t *, lf_watch_entry_t *) = {
+        lf_watch_hid, lf_watch_awid, lf_watch_em410x, lf_watch_io
+    };
 
     uint8_t *dest = BigBuf_get_addr();
     BigBuf_Clear_keep_EM();
     clear_trace();
     set_tracing(false);
 
+    // the acquisition gives BigBuf back every cycle, so the work areas are laid out by hand behind the samples
+    bool copy = (protocols & (protocols - 1)) != 0;
+    uint8_t *work = (copy) ? dest + LF_WATCH_BUF : dest;
+    seen_tag_t *seen = (seen_tag_t *)(dest + ((copy) ? 2 : 1) * LF_WATCH_BUF);
+    uint32_t need = ((copy) ? 2 : 1) * LF_WATCH_BUF + ((stream) ? SEEN_TAGS_MAX * sizeof(seen_tag_t) : 0);
+    if (BigBuf_max_traceLen() < need) {
+        return PM3_EMALLOC;
+    }
+    if (stream) {
+        memset(seen, 0, SEEN_TAGS_MAX * sizeof(seen_tag_t));
+    }
+
     // Configure to go in 125kHz listen mode
     LFSetupFPGAForADC(LF_DIVISOR_125, true);
 
     int res = PM3_SUCCESS;
-    for (;;) {
+    uint32_t t0 = GetTickCount();
+    bool done = false;
+    while (done == false) {
 
         WDT_HIT();
 
@@ -1591,65 +1700,106 @@ int lf_io_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol) {
             break;
         }
 
-        DoAcquisition_default(-1, false, ledcontrol);
-
-        size_t size = MIN(12000, BigBuf_max_traceLen());
-
-        //fskdemod and get start index
-        int idx = detectIOProx(dest, &size, &dummyIdx);
-        if (idx < 0) continue;
-        //valid tag found
-
-        //Index map
-        //0           10          20          30          40          50          60
-        //|           |           |           |           |           |           |
-        //01234567 8 90123456 7 89012345 6 78901234 5 67890123 4 56789012 3 45678901 23
-        //-----------------------------------------------------------------------------
-        //00000000 0 11110000 1 facility 1 version* 1 code*one 1 code*two 1 checksum 11
-        //
-        //Checksum:
-        //00000000 0 11110000 1 11100000 1 00000001 1 00000011 1 10110110 1 01110101 11
-        //preamble      F0         E0         01         03         B6         75
-        // How to calc checksum,
-        // http://www.proxmark.org/forum/viewtopic.php?id=364&p=6
-        //   F0 + E0 + 01 + 03 + B6 = 28A
-        //   28A & FF = 8A
-        //   FF - 8A = 75
-        // Checksum: 0x75
-        //XSF(version)facility:codeone+codetwo
-        //Handle the data
-        // if(findone){ //only print binary if we are doing one
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx],   dest[idx+1],   dest[idx+2],dest[idx+3],dest[idx+4],dest[idx+5],dest[idx+6],dest[idx+7],dest[idx+8]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+9], dest[idx+10],dest[idx+11],dest[idx+12],dest[idx+13],dest[idx+14],dest[idx+15],dest[idx+16],dest[idx+17]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+18],dest[idx+19],dest[idx+20],dest[idx+21],dest[idx+22],dest[idx+23],dest[idx+24],dest[idx+25],dest[idx+26]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+27],dest[idx+28],dest[idx+29],dest[idx+30],dest[idx+31],dest[idx+32],dest[idx+33],dest[idx+34],dest[idx+35]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+36],dest[idx+37],dest[idx+38],dest[idx+39],dest[idx+40],dest[idx+41],dest[idx+42],dest[idx+43],dest[idx+44]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d",dest[idx+45],dest[idx+46],dest[idx+47],dest[idx+48],dest[idx+49],dest[idx+50],dest[idx+51],dest[idx+52],dest[idx+53]);
-        // Dbprintf("%d%d%d%d%d%d%d%d %d%d",dest[idx+54],dest[idx+55],dest[idx+56],dest[idx+57],dest[idx+58],dest[idx+59],dest[idx+60],dest[idx+61],dest[idx+62],dest[idx+63]);
-        // }
-        code = bytebits_to_byte(dest + idx, 32);
-        code2 = bytebits_to_byte(dest + idx + 32, 32);
-        version = bytebits_to_byte(dest + idx + 27, 8); //14,4
-        facilitycode = bytebits_to_byte(dest + idx + 18, 8);
-        number = (bytebits_to_byte(dest + idx + 36, 8) << 8) | (bytebits_to_byte(dest + idx + 45, 8)); //36,9
-
-        Dbprintf("IO Prox " _GREEN_("XSF(%02d)%02x:%05d") " (%08x%08x) (%s)", version, facilitycode, number, code, code2);
-
-        if (findone) {
-            *high = code;
-            *low = code2;
-            break;
+        DoAcquisition(1, 8, 0, -1, false, LF_WATCH_SAMPLES, 0, 0, ledcontrol);
+
+        for (uint8_t i = 0; i < ARRAYLEN(demods) && done == false; i++) {
+
+            uint8_t protocol = 1 << i;
+            if ((protocols & protocol) == 0) {
+                continue;
+            }
+
+            WDT_HIT();
+
+            if (copy) {
+                memcpy(work, dest, LF_WATCH_SAMPLES);
+            }
+
+            lf_watch_entry_t e = {
+                .protocol = protocol,
+            };
+            if (demods[i](work, &e) == false) {
+                continue;
+            }
+
+            if (stream == false) {
+                lf_watch_print(&e);
+                if (found) {
+                    *found = e;
+                    done = true;
+                }
+                continue;
+            }
+
+            uint8_t key[1 + sizeof(e.raw)];
+            key[0] = protocol;
+            memcpy(key + 1, e.raw, sizeof(e.raw));
+
+            uint32_t now = GetTickCount();
+            if (seen_tag_is_new(seen, key, sizeof(key), now, holdoff) == false) {
+                continue;
+            }
+            e.ms = now - t0;
+            reply_ng(CMD_LF_WATCH, PM3_SUCCESS, (uint8_t *)&e, sizeof(e));
         }
-        code = code2 = 0;
-        version = facilitycode = 0;
-        number = 0;
     }
+
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
     BigBuf_free();
     if (ledcontrol) LEDsoff();
     return res;
 }
 
+int lf_watch(uint8_t protocols, uint16_t holdoff, bool ledcontrol) {
+    protocols &= LF_WATCH_ALL;
+    if (protocols == 0) {
+        return PM3_EINVARG;
+    }
+    return lf_watch_loop(protocols, holdoff, true, NULL, ledcontrol);
+}
+
+// loop to get raw HID waveform then FSK demodulate the TAG ID from it
+int lf_hid_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol) {
+    lf_watch_entry_t e = {0};
+    int res = lf_watch_loop(LF_WATCH_HID, 0, false, (findone) ? &e : NULL, ledcontrol);
+    if (findone && res == PM3_SUCCESS) {
+        *high = e.raw[1];
+        *low = e.raw[2];
+    }
+    return res;
+}
+
+// loop to get raw AWID waveform then FSK demodulate the TAG ID from it
+int lf_awid_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol) {
+    lf_watch_entry_t e = {0};
+    int res = lf_watch_loop(LF_WATCH_AWID, 0, false, (findone) ? &e : NULL, ledcontrol);
+    if (findone && res == PM3_SUCCESS) {
+        *high = e.raw[1];
+        *low = e.raw[2];
+    }
+    return res;
+}
+
+int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low, bool ledcontrol) {
+    lf_watch_entry_t e = {0};
+    int res = lf_watch_loop(LF_WATCH_EM410X, 0, false, (findone) ? &e : NULL, ledcontrol);
+    if (findone && res == PM3_SUCCESS) {
+        *high = e.raw[0];
+        *low = ((uint64_t)e.raw[1] << 32) | e.raw[2];
+    }
+    return res;
+}
+
+int lf_io_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol) {
+    lf_watch_entry_t e = {0};
+    int res = lf_watch_loop(LF_WATCH_IO, 0, false, (findone) ? &e : NULL, ledcontrol);
+    if (findone && res == PM3_SUCCESS) {
+        *high = e.raw[1];
+        *low = e.raw[2];
+    }
+    return res;
+}
+
 /*------------------------------
  * T5555/T5557/T5567/T5577 routines
  *------------------------------
@@ -2036,23 +2186,9 @@ bool brute_mem = (flags & 0x0100) >> 8;
 }
 */
 // Read one card block in page [page]
-void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, bool ledcontrol) {
-    /*
-    flag bits
-    xxxx xxxxxxx1 0x0001 PwdMode
-    xxxx xxxxxx1x 0x0002 Page
-    xxxx xxxxx1xx 0x0004 testMode
-    xxxx xxx11xxx 0x0018 downlink mode
-    xxxx xx1xxxxx 0x0020 !reg_readmode
-    xxxx x1xxxxxx 0x0040 called for a read, so no data packet
-    xxxx 1xxxxxxx 0x0080 reset
-    xxx1 xxxxxxxx 0x0100 brute / leave field on
-    */
-    uint16_t flags        = 0x0040; // read packet
-    if (pwd_mode)  flags |= 0x0001;
-    if (page)      flags |= 0x0002;
-    flags                |= (downlink_mode & 3) << 3;
-    if (brute_mem) flags |= 0x0100;
+// sends the read command in 'flags' and samples the answer into BigBuf
+// keep_bigbuf leaves the rest of BigBuf as is, only the samples area gets cleared
+static void t55xx_read_samples(uint16_t flags, uint8_t block, uint32_t pwd, size_t samples, bool keep_bigbuf, bool ledcontrol) {
 
     sample_config old_config;
     sample_config *curr_config = getSamplingConfig();
@@ -2061,12 +2197,6 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
 
     setDefaultSamplingConfig();
 
-    size_t samples = 12000;
-
-    if (ledcontrol) LED_A_ON();
-
-    if (brute_mem) samples = 2048;
-
     //-- Set Read Flag to ensure SendCMD does not add "data" to the packet
     //-- flags |= 0x40;
 
@@ -2077,7 +2207,11 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
     block &= 0x7;
 
     //clear buffer now so it does not interfere with timing later
-    BigBuf_Clear_keep_EM();
+    if (keep_bigbuf) {
+        memset(BigBuf_get_addr(), 0, samples);
+    } else {
+        BigBuf_Clear_keep_EM();
+    }
 
     T55xx_SendCMD(0,  pwd, flags | (block << 9));  //, true);
 
@@ -2092,20 +2226,175 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
     // Now do the acquisition
     DoPartialAcquisition(0, false, samples, 1000, ledcontrol);
 
-    // Turn the field off
-    if (brute_mem == false) {
-        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-        reply_ng(CMD_LF_T55XX_READBL, PM3_SUCCESS, NULL, 0);
-        if (ledcontrol) LED_A_OFF();
-    }
-
     // reset back to old / save config
     setSamplingConfig(&old_config);
 }
 
+void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, bool ledcontrol) {
+    /*
+    flag bits
+    xxxx xxxxxxx1 0x0001 PwdMode
+    xxxx xxxxxx1x 0x0002 Page
+    xxxx xxxxx1xx 0x0004 testMode
+    xxxx xxx11xxx 0x0018 downlink mode
+    xxxx xx1xxxxx 0x0020 !reg_readmode
+    xxxx x1xxxxxx 0x0040 called for a read, so no data packet
+    xxxx 1xxxxxxx 0x0080 reset
+    xxx1 xxxxxxxx 0x0100 brute / leave field on
+    */
+    uint16_t flags        = 0x0040; // read packet
+    if (pwd_mode)  flags |= 0x0001;
+    if (page)      flags |= 0x0002;
+    flags                |= (downlink_mode & 3) << 3;
+    if (brute_mem) flags |= 0x0100;
+
+    if (ledcontrol) LED_A_ON();
+
+    t55xx_read_samples(flags, block, pwd, (brute_mem) ? 2048 : 12000, false, ledcontrol);
+
+    // Turn the field off
+    if (brute_mem == false) {
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        reply_ng(CMD_LF_T55XX_READBL, PM3_SUCCESS, NULL, 0);
+        if (ledcontrol) LED_A_OFF();
+    }
+}
+
+// Same classification the client runs after a block 0 read in 'lf t55xx detect',
+// with the same detectors, so it can skip the downloads and demods that can't match.
+static void t55xx_probe_classify(const uint8_t *samples, uint8_t *scratch, size_t size, t55xx_probe_hint_t *hint) {
+
+    computeSignalProperties(samples, size);
+    hint->noise = getSignalProperties()->isnoise;
+    if (hint->noise) {
+        return;
+    }
+
+    uint16_t fc = countFC(samples, size, true);
+    if (fc) {
+        int edge = 0;
+        hint->fc_high = (fc >> 8) & 0xFF;
+        hint->fc_low = fc & 0xFF;
+        hint->fsk_clock = detectFSKClk(samples, size, hint->fc_high, hint->fc_low, &edge);
+    }
+
+    WDT_HIT();
+
+    // the clock detectors may change their buffer
+    int clk = 0;
+    size_t n = size, ststart = 0, stend = 0;
+    memcpy(scratch, samples, size);
+    if (DetectST(scratch, &n, &clk, &ststart, &stend) == false) {
+        DetectASKClock(scratch, n, &clk, 20);
+    }
+    hint->ask_clock = clk;
+
+    WDT_HIT();
+
+    size_t idx = 0;
+    memcpy(scratch, samples, size);
+    hint->nrz_clock = DetectNRZClock(scratch, size, 0, &idx);
+
+    WDT_HIT();
+
+    uint8_t phase = 0, carrier = 0;
+    memcpy(scratch, samples, size);
+    hint->psk_clock = DetectPSKClock(scratch, size, 0, &idx, &phase, &carrier);
+}
+
+void T55xxProbe(const t55xx_probe_t *p, bool ledcontrol) {
+
+    t55xx_probe_reply_t reply;
+    memset(&reply, 0, sizeof(reply));
+
+    if (ledcontrol) LED_A_ON();
+
+    size_t samples = 12000;
+    for (uint8_t m = 0; m < ARRAYLEN(reply.hints); m++) {
+
+        t55xx_probe_hint_t *hint = &reply.hints[m];
+        hint->noise = true;
+        if ((p->downlink_modes & (1 << m)) == 0) {
+            continue;
+        }
+
+        WDT_HIT();
+
+        uint16_t flags = 0x0040 | ((p->flags & 1) ? 0x0001 : 0) | (m << 3);
+        t55xx_read_samples(flags, 0, p->pwd, samples, false, ledcontrol);
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+        // let the tag power down, as between two reads from the client
+        WaitMS(20);
+
+        // the acquisition gave BigBuf back, the samples sit at its start
+        uint8_t *scratch = BigBuf_malloc(samples);
+        if (scratch == NULL) {
+            // can't tell, let the client look at it
+            hint->noise = false;
+            continue;
+        }
+        t55xx_probe_classify(BigBuf_get_addr(), scratch, samples, hint);
+    }
+
+    BigBuf_free();
+    if (ledcontrol) LED_A_OFF();
+    reply_ng(CMD_LF_T55XX_PROBE, PM3_SUCCESS, (uint8_t *)&reply, sizeof(reply));
+}
+
+void T55xxDump(const t55xx_dump_t *p, bool ledcontrol) {
+
+    t55xx_dump_reply_t reply = {
+        .samples = MIN(p->samples, 12000),
+        .blocks = 0,
+    };
+
+    if (reply.samples == 0) {
+        reply_ng(CMD_LF_T55XX_DUMP, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    // every acquisition lands at the start of BigBuf, slot 0,
+    // and is moved up to the next free slot before the next read
+    size_t samples = reply.samples;
+    uint32_t slots = BigBuf_max_traceLen() / samples;
+    reply.offset = samples;
+
+    uint8_t *buf = BigBuf_get_addr();
+    uint16_t flags = 0x0040 | ((p->flags & 1) ? 0x0001 : 0) | ((p->downlink_mode & 3) << 3);
+
+    if (ledcontrol) LED_A_ON();
+
+    uint32_t n = 0;
+    for (uint8_t b = 0; b < 12 && n + 1 < slots; b++) {
+
+        if ((p->blocks & (1 << b)) == 0) {
+            continue;
+        }
+
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            break;
+        }
+
+        // the field stays on between the reads, as for the password bruteforce
+        uint16_t f = flags | ((b >= 8) ? 0x0002 : 0) | ((n) ? 0x0100 : 0);
+        t55xx_read_samples(f, b & 7, p->pwd, samples, true, ledcontrol);
+
+        n++;
+        memcpy(buf + (n * samples), buf, samples);
+        reply.blocks |= (1 << b);
+    }
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    if (ledcontrol) LED_A_OFF();
+    reply_ng(CMD_LF_T55XX_DUMP, PM3_SUCCESS, (uint8_t *)&reply, sizeof(reply));
+}
+
+
+void T55xx_ChkPwds(uint8_t flags, bool ledcontrol) {
 
-void T55xx_ChkPwds(uint8_t flags, bool ledcontrol) {
-
 #define CHK_SAMPLES_SIGNAL 2048
 
 #ifdef WITH_FLASH
@@ -2149,80 +2438,468 @@ void T55xx_ChkPwds(uint8_t flags, bool ledcontrol) {
     payload.found = false;
     payload.candidate = 0;
 
+    uint64_t curr, prev = 0;
+
 #ifdef WITH_FLASH
 
     BigBuf_Clear_EM();
-    uint32_t size = 0;
 
-    if (exists_in_spiffs(T55XX_KEYS_FILE)) {
-        size = size_in_spiffs(T55XX_KEYS_FILE);
-    }
-    if (size == 0) {
+    // the dictionary goes through the EM buffer one chunk at a time, it may be bigger than that
+    rdv40_spiffs_reader_t reader;
+    if (rdv40_spiffs_reader_open(&reader, T55XX_KEYS_FILE) != SPIFFS_OK) {
         Dbprintf("Spiffs file: %s does not exists or empty.", T55XX_KEYS_FILE);
         goto OUT;
     }
 
-    pwd_count = size / T55XX_KEY_LENGTH;
-    if (pwd_count == 0)
+    if (reader.size < T55XX_KEY_LENGTH) {
+        Dbprintf("Spiffs file: %s does not exists or empty.", T55XX_KEYS_FILE);
+        rdv40_spiffs_reader_close(&reader);
         goto OUT;
+    }
 
-    // since flash can report way too many pwds, we need to limit it.
-    // bigbuff EM size is determined by CARD_MEMORY_SIZE
-    // a password is 4bytes.
-    uint16_t pwd_size_available = MIN(CARD_MEMORY_SIZE, pwd_count * T55XX_KEY_LENGTH);
+    if (g_dbglevel >= DBG_ERROR) Dbprintf("Checking %u passwords from spiffs file: %s", reader.size / T55XX_KEY_LENGTH, T55XX_KEYS_FILE);
 
-    // adjust available pwd_count
-    pwd_count = pwd_size_available / T55XX_KEY_LENGTH;
+    int32_t chunk;
+    while ((chunk = rdv40_spiffs_reader_next(&reader, pwds, CARD_MEMORY_SIZE)) >= T55XX_KEY_LENGTH) {
+        pwd_count = chunk / T55XX_KEY_LENGTH;
+#endif
 
-    if (SPIFFS_OK == rdv40_spiffs_read_as_filetype(T55XX_KEYS_FILE, pwds, pwd_size_available, RDV40_SPIFFS_SAFETY_SAFE)) {
-        if (g_dbglevel >= DBG_ERROR) Dbprintf("Loaded %u passwords from spiffs file: %s", pwd_count, T55XX_KEYS_FILE);
-    } else {
-        Dbprintf("Spiffs file: %s cannot be read.", T55XX_KEYS_FILE);
-        goto OUT;
+        for (uint32_t i = 0; i < pwd_count; i++) {
+
+            uint32_t pwd = bytes_to_num(pwds + (i * 4), 4);
+
+            T55xxReadBlock(0, true, true, 0, pwd, downlink_mode, ledcontrol);
+
+            uint64_t sum = 0;
+            for (uint16_t j = 0; j < CHK_SAMPLES_SIGNAL; ++j) {
+                sum += (buf[j] * buf[j]);
+            }
+            sum *= sum;
+            sum >>= 8;
+
+            int64_t tmp_dist = (baseline_faulty - sum);
+            curr = ABS(tmp_dist);
+
+            if (g_dbglevel >= DBG_DEBUG)
+                Dbprintf("%08x has distance " _YELLOW_("%llu"), pwd, curr);
+
+            if (curr > prev) {
+                payload.found = true;
+                payload.candidate = pwd;
+                prev = curr;
+            }
+        }
+
+#ifdef WITH_FLASH
     }
+    rdv40_spiffs_reader_close(&reader);
+#endif
 
+#ifdef WITH_FLASH
+OUT:
 #endif
 
-    uint64_t curr, prev = 0;
-    int32_t idx = -1;
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    if (ledcontrol) LEDsoff();
+    reply_ng(CMD_LF_T55XX_CHK_PWDS, PM3_SUCCESS, (uint8_t *)&payload, sizeof(payload));
+    BigBuf_free();
+}
+
+// response energy, the same measure T55xx_ChkPwds compares against its baseline
+static uint64_t T55xx_SignalEnergy(const uint8_t *buf, uint16_t samples) {
+    uint64_t sum = 0;
+    for (uint16_t j = 0; j < samples; ++j) {
+        sum += (buf[j] * buf[j]);
+    }
+    sum *= sum;
+    sum >>= 8;
+    return sum;
+}
 
-    for (uint32_t i = 0; i < pwd_count; i++) {
+// Read block 0 with the password and the field left on, no reset or power up
+// delay between attempts.  Returns the energy of the response.
+static uint64_t T55xx_BruteTry(uint32_t pwd, uint8_t downlink_mode, uint16_t read_gap, uint16_t samples, bool ledcontrol) {
+    // read packet, pwd mode, brute / leave field on
+    uint16_t flags = 0x0040 | 0x0001 | 0x0100 | ((downlink_mode & 3) << 3);
 
-        uint32_t pwd = bytes_to_num(pwds + (i * 4), 4);
+    T55xx_SendCMD(0, pwd, flags);
+    turn_read_lf_on(read_gap);
+    DoPartialAcquisition(0, false, samples, 0, ledcontrol);
+    return T55xx_SignalEnergy(BigBuf_get_addr(), samples);
+}
 
-        T55xxReadBlock(0, true, true, 0, pwd, downlink_mode, ledcontrol);
+// Pick the shortest read gap and sample window that give a stable response to
+// wrong passwords, and the baseline / threshold for the signal check from it.
+// These reads use passwords outside of the usual dictionaries, a lucky hit only
+// shows up as spread and makes that setting lose.
+static void T55xx_BruteTune(t55xx_brute_t *p, uint8_t downlink_mode, bool ledcontrol) {
 
-        uint64_t sum = 0;
-        for (uint16_t j = 0; j < CHK_SAMPLES_SIGNAL; ++j) {
-            sum += (buf[j] * buf[j]);
+#define BRUTE_TUNE_READS 8
+
+    const uint16_t gaps[] = { T55xx_Timing.m[downlink_mode].read_gap, 40 * 8, 80 * 8, 137 * 8 };
+    const uint16_t windows[] = { 512, 1024, 2048 };
+
+    // fallback, what T55xx_ChkPwds uses
+    p->read_gap = 137 * 8;
+    p->samples = 2048;
+    p->baseline = 0;
+    p->threshold = 0;
+
+    for (uint8_t g = 0; g < ARRAYLEN(gaps); g++) {
+        for (uint8_t w = 0; w < ARRAYLEN(windows); w++) {
+
+            uint64_t e[BRUTE_TUNE_READS];
+            uint64_t mean = 0;
+            for (uint8_t i = 0; i < BRUTE_TUNE_READS; i++) {
+                WDT_HIT();
+                e[i] = T55xx_BruteTry(~p->start ^ (i * 0x9E3779B9), downlink_mode, gaps[g], windows[w], ledcontrol);
+                mean += e[i];
+            }
+            mean /= BRUTE_TUNE_READS;
+
+            uint64_t dev = 0;
+            for (uint8_t i = 0; i < BRUTE_TUNE_READS; i++) {
+                dev += (e[i] > mean) ? e[i] - mean : mean - e[i];
+            }
+            dev /= BRUTE_TUNE_READS;
+
+            if (g_dbglevel >= DBG_DEBUG)
+                Dbprintf("gap %u samples %u baseline %llu spread %llu", gaps[g], windows[w], mean, dev);
+
+            // within ~6%, the fallback keeps the last (longest) measurement
+            p->read_gap = gaps[g];
+            p->samples = windows[w];
+            p->baseline = mean;
+            p->threshold = (4 * dev) + (mean >> 5);
+            if ((dev << 4) <= mean) {
+                return;
+            }
         }
-        sum *= sum;
-        sum >>= 8;
+    }
+}
 
-        int64_t tmp_dist = (baseline_faulty - sum);
-        curr = ABS(tmp_dist);
+// Device resident password bruteforce.  Tries the range without talking to the
+// client, stops at the first candidate and leaves its validation to the client,
+// which resumes after it on a false positive.
+void T55xx_BrutePwds(const uint8_t *data, bool ledcontrol) {
 
-        if (g_dbglevel >= DBG_DEBUG)
-            Dbprintf("%08x has distance " _YELLOW_("%llu"), pwd, curr);
+#define BRUTE_PROGRESS_INTERVAL 32
+
+    t55xx_brute_reply_t reply = {0};
+    memcpy(&reply.params, data, sizeof(t55xx_brute_t));
+
+    t55xx_brute_t *p = &reply.params;
+    uint8_t downlink_mode = (p->flags >> 3) & 0x03;
+    int status = PM3_SUCCESS;
+
+    sample_config old_config;
+    memcpy(&old_config, getSamplingConfig(), sizeof(sample_config));
+    old_config.verbose = false;
+    setDefaultSamplingConfig();
+
+    if (ledcontrol) LED_A_ON();
+    BigBuf_Clear_keep_EM();
+
+    if (p->read_gap == 0 || p->samples == 0 || p->samples > BigBuf_max_traceLen()) {
+        T55xx_BruteTune(p, downlink_mode, ledcontrol);
+    }
+
+    if (g_dbglevel >= DBG_DEBUG)
+        Dbprintf("read gap %u samples %u baseline " _YELLOW_("%llu") " threshold " _YELLOW_("%llu"), p->read_gap, p->samples, p->baseline, p->threshold);
+
+    uint64_t pwd = p->start;
+    for (; pwd <= p->end; pwd++) {
 
-        if (curr > prev) {
-            idx = i;
-            prev = curr;
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        uint64_t e = T55xx_BruteTry(pwd, downlink_mode, p->read_gap, p->samples, ledcontrol);
+        reply.tried++;
+
+        uint64_t dist = (e > p->baseline) ? e - p->baseline : p->baseline - e;
+        if (dist > p->threshold) {
+            if (g_dbglevel >= DBG_DEBUG)
+                Dbprintf("%08x has distance " _YELLOW_("%llu"), (uint32_t)pwd, dist);
+            reply.found = true;
+            break;
+        }
+
+        if ((reply.tried % BRUTE_PROGRESS_INTERVAL) == 0) {
+            reply.password = pwd + 1;
+            reply_ng(CMD_LF_T55XX_BRUTE_PROGRESS, PM3_SUCCESS, (uint8_t *)&reply, sizeof(reply));
         }
     }
 
-    if (idx != -1) {
-        payload.found = true;
-        payload.candidate = bytes_to_num(pwds + (idx * 4), 4);
+    // the candidate, or the next one to try
+    reply.password = pwd;
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    if (ledcontrol) LEDsoff();
+    setSamplingConfig(&old_config);
+    reply_ng(CMD_LF_T55XX_BRUTE, status, (uint8_t *)&reply, sizeof(reply));
+    BigBuf_free();
+}
+
+// data rate of a T55x7 block 0, in field clocks per bit
+static int T55xx_Block0Clock(uint32_t block0) {
+    const uint8_t rates[8] = {8, 16, 32, 40, 50, 64, 100, 128};
+    bool extended = (block0 >> (32 - 15)) & 0x01;
+    if (extended) {
+        return (2 * ((block0 >> (32 - 14)) & 0x3F)) + 2;
     }
+    return rates[(block0 >> (32 - 14)) & 0x07];
+}
 
-#ifdef WITH_FLASH
-OUT:
-#endif
+// Demodulates the samples in place, with the modulation of block 0, the same
+// way the client's DecodeT55xxBlock() does.  Returns the number of bits.
+static size_t T55xx_DemodBlock0(uint8_t *dest, size_t size, uint32_t block0, int clk) {
+    uint8_t datamod = (block0 >> (32 - 20)) & 0x1F;
+    int invert = (block0 >> (32 - 31)) & 0x01;
+    int start = 0;
+
+    computeSignalProperties(dest, size);
+    if (getSignalProperties()->isnoise) {
+        return 0;
+    }
+
+    switch (datamod) {
+        case 0x00: // NRZ
+            if (nrzRawDemod(dest, &size, &clk, &invert, &start) < 0)
+                return 0;
+            break;
+        case 0x01: // PSK1
+            if (pskRawDemod(dest, &size, &clk, &invert) < 0)
+                return 0;
+            break;
+        case 0x02: // PSK2
+        case 0x03: // PSK3
+            invert = 0;
+            if (pskRawDemod(dest, &size, &clk, &invert) < 0)
+                return 0;
+            psk1TOpsk2(dest, size);
+            break;
+        case 0x04: // FSK1
+        case 0x06: // FSK1a
+            size = fskdemod(dest, size, clk, (datamod == 0x06) ? 1 : invert, 8, 5, &start);
+            break;
+        case 0x05: // FSK2
+        case 0x07: // FSK2a
+            size = fskdemod(dest, size, clk, (datamod == 0x07) ? 1 : invert, 10, 8, &start);
+            break;
+        case 0x08: // ASK / Manchester
+            if (askdemod(dest, &size, &clk, &invert, 100, 0, 1) < 0)
+                return 0;
+            break;
+        case 0x10: // Biphase
+        case 0x18: { // Diphase, inverted biphase
+            int offset = 0;
+            if (datamod == 0x18)
+                invert = 1;
+            if (askdemod(dest, &size, &clk, &invert, 100, 0, 0) < 0)
+                return 0;
+            if (BiphaseRawDecode(dest, &size, &offset, invert) < 0)
+                return 0;
+            break;
+        }
+        default:
+            return 0;
+    }
+    return size;
+}
+
+// a block read repeats the block, so the data shows up somewhere in the bits
+static bool T55xx_FindBlock(const uint8_t *bits, size_t size, uint32_t data) {
+    for (size_t i = 0; i + 32 <= size; i++) {
+        uint8_t j = 0;
+        while (j < 32 && bits[i + j] == ((data >> (31 - j)) & 1)) {
+            j++;
+        }
+        if (j == 32) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Write one page 0 block, without the reply of T55xxWriteBlock
+static void T55xx_CloneWrite(uint8_t block, uint32_t data, const t55xx_clone_t *c) {
+    T55xx_SendCMD(data, c->pwd, (c->flags & 0x19) | (block << 9));
+    // programming takes ~5.6ms for t5577 ~18ms for E5550 or t5567
+    turn_read_lf_on(20 * 1000);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+}
+
+// Read one page 0 block back and look for its data, using the new block 0
+static bool T55xx_CloneVerifyBlock(uint8_t block, uint32_t data, const t55xx_clone_t *c, bool ledcontrol) {
+    uint32_t block0 = c->blocks[0];
+    int clk = T55xx_Block0Clock(block0);
+
+    // once the new block 0 sets the PWD bit, reads need the new password of block 7
+    bool pwd_mode = (block0 >> (32 - 28)) & 0x01;
+    uint32_t pwd = (c->numblocks > 7) ? c->blocks[7] : c->pwd;
+
+    // three repeats of the block, with room for a sequence terminator
+    uint32_t samples = MIN((uint32_t)((3 * 32) + 8) * clk, BigBuf_max_traceLen());
+
+    uint16_t flags = 0x0040 | (pwd_mode ? 0x0001 : 0) | (c->flags & 0x18) | (block << 9);
+    T55xx_SendCMD(0, pwd, flags);
+    turn_read_lf_on(137 * 8);
+    size_t size = DoPartialAcquisition(0, false, samples, 0, ledcontrol);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+    uint8_t *buf = BigBuf_get_addr();
+    size = T55xx_DemodBlock0(buf, size, block0, clk);
+    return T55xx_FindBlock(buf, size, data);
+}
+
+// Data blocks first and block 0 last, so the tag keeps its old configuration
+// until everything else is in place.  Returns a bit per block that failed to verify.
+static uint8_t T55xx_CloneOne(const t55xx_clone_t *c, bool ledcontrol) {
+    uint8_t failed = 0;
+
+    for (uint8_t i = c->numblocks; i > 0; i--) {
+        WDT_HIT();
+        T55xx_CloneWrite(i - 1, c->blocks[i - 1], c);
+    }
+
+    for (uint8_t i = 0; i < c->numblocks; i++) {
+        WDT_HIT();
+        if (T55xx_CloneVerifyBlock(i, c->blocks[i], c, ledcontrol) == false) {
+            failed |= (1 << i);
+        }
+    }
+    return failed;
+}
+
+// anything but noise on the antenna
+static bool T55xx_TagPresent(bool ledcontrol) {
+    LFSetupFPGAForADC(LF_DIVISOR_125, true);
+    WaitMS(4);
+    size_t size = DoPartialAcquisition(0, false, 2048, 0, ledcontrol);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    computeSignalProperties(BigBuf_get_addr(), size);
+    return (getSignalProperties()->isnoise == false);
+}
+
+// Wait for a tag, clone it and report it, then wait for it to be taken away.
+// Returns false when the button or the client ended the wait.
+static bool T55xx_CloneNextTag(const t55xx_clone_t *c, t55xx_clone_reply_t *reply, bool ledcontrol) {
+    for (;;) {
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            return false;
+        }
+
+        if (T55xx_TagPresent(ledcontrol)) {
+            break;
+        }
+    }
+
+    if (ledcontrol) LED_B_ON();
+    reply->failed_blocks = T55xx_CloneOne(c, ledcontrol);
+    if (reply->failed_blocks) {
+        reply->failed++;
+    } else {
+        reply->cloned++;
+    }
+    reply_ng(CMD_LF_T55XX_CLONE_PROGRESS, reply->failed_blocks ? PM3_ESOFT : PM3_SUCCESS, (uint8_t *)reply, sizeof(t55xx_clone_reply_t));
+
+    // wait for the tag to be taken away
+    while (T55xx_TagPresent(ledcontrol)) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            break;
+        }
+    }
+    if (ledcontrol) LED_B_OFF();
+    return true;
+}
+
+// Write and verify all blocks in one command.  In loop mode, wait for each new
+// tag, clone it and report it, then wait for it to be taken away.
+void T55xx_CloneVerify(const uint8_t *data, bool ledcontrol) {
+    t55xx_clone_t c;
+    memcpy(&c, data, sizeof(t55xx_clone_t));
+
+    t55xx_clone_reply_t reply = {0};
+    int status = PM3_SUCCESS;
+
+    if (c.numblocks < 1 || c.numblocks > ARRAYLEN(c.blocks)) {
+        reply_ng(CMD_LF_T55XX_CLONE, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    sample_config old_config;
+    memcpy(&old_config, getSamplingConfig(), sizeof(sample_config));
+    old_config.verbose = false;
+    setDefaultSamplingConfig();
+
+    if (ledcontrol) LED_A_ON();
+    BigBuf_Clear_keep_EM();
+
+    if (c.loop == false) {
+        reply.failed_blocks = T55xx_CloneOne(&c, ledcontrol);
+        if (reply.failed_blocks) {
+            reply.failed++;
+            status = PM3_ESOFT;
+        } else {
+            reply.cloned++;
+        }
+    } else {
+        while (T55xx_CloneNextTag(&c, &reply, ledcontrol)) {}
+    }
 
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
     if (ledcontrol) LEDsoff();
-    reply_ng(CMD_LF_T55XX_CHK_PWDS, PM3_SUCCESS, (uint8_t *)&payload, sizeof(payload));
+    setSamplingConfig(&old_config);
+    reply_ng(CMD_LF_T55XX_CLONE, status, (uint8_t *)&reply, sizeof(reply));
+    BigBuf_free();
+}
+
+// Every tag placed on the antenna gets the next credential of the queue, the
+// same one again when it didn't verify.  Ends when the queue is done, or aborted.
+void T55xx_CloneQueue(const uint8_t *data, bool ledcontrol) {
+    t55xx_clone_queue_t q;
+    memcpy(&q, data, sizeof(t55xx_clone_queue_t));
+
+    t55xx_clone_reply_t reply = {0};
+
+    t55xx_clone_t c = {
+        .numblocks = q.numblocks,
+        .pwd = q.pwd,
+        .flags = q.flags,
+        .loop = true,
+    };
+
+    if (q.numblocks < 1 || q.numblocks > ARRAYLEN(c.blocks) || q.count == 0 || (q.count * q.numblocks) > ARRAYLEN(q.blocks)) {
+        reply_ng(CMD_LF_T55XX_CLONE_QUEUE, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    sample_config old_config;
+    memcpy(&old_config, getSamplingConfig(), sizeof(sample_config));
+    old_config.verbose = false;
+    setDefaultSamplingConfig();
+
+    if (ledcontrol) LED_A_ON();
+    BigBuf_Clear_keep_EM();
+
+    while (reply.cloned < q.count) {
+        memcpy(c.blocks, &q.blocks[reply.cloned * q.numblocks], q.numblocks * sizeof(uint32_t));
+        if (T55xx_CloneNextTag(&c, &reply, ledcontrol) == false) {
+            break;
+        }
+    }
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    if (ledcontrol) LEDsoff();
+    setSamplingConfig(&old_config);
+    reply_ng(CMD_LF_T55XX_CLONE_QUEUE, (reply.cloned == q.count) ? PM3_SUCCESS : PM3_EOPABORTED, (uint8_t *)&reply, sizeof(reply));
     BigBuf_free();
 }
 
@@ -2637,9 +3314,91 @@ static void EM4xLoginEx(uint32_t pwd) {
     // 0000 0001 fail
 }
 
-void EM4xBruteforce(uint32_t start_pwd, uint32_t n, bool ledcontrol) {
-    // With current timing, 18.6 ms per test = 53.8 pwds/s
-    reply_ng(CMD_LF_EM4X_BF, PM3_SUCCESS, NULL, 0);
+// Sends the prepared login and samples the answer window.  True when the
+// answer is the "login ok" one, 'answered' tells if the tag said anything.
+static bool EM4xBruteTry(uint8_t len, bool *answered, bool ledcontrol) {
+    clear_trace();
+    SendForward(len, true);
+
+    WaitUS(400);
+    DoPartialAcquisition(0, false, 350, 1000, ledcontrol);
+
+    uint8_t *mem = BigBuf_get_addr();
+    if (answered != NULL) {
+        computeSignalProperties(mem, 350);
+        *answered = (getSignalProperties()->isnoise == false);
+    }
+    return (mem[334] < 128);
+}
+
+static uint8_t EM4xBrutePrepare(uint32_t pwd) {
+    forward_ptr = forwardLink_data;
+    uint8_t len = Prepare_Cmd(FWD_CMD_LOGIN);
+    len += Prepare_Data(pwd & 0xFFFF, pwd >> 16);
+    return len;
+}
+
+// Shortest pause between two logins the tag still answers every one of,
+// if it is shorter than the tag needs to listen again the logins are lost.
+static uint16_t EM4xBruteTune(uint32_t seed, bool ledcontrol) {
+
+#define EM4X05_BRUTE_TUNE_LOGINS 8
+
+    const uint16_t guards[] = { 100, 250, 500, 1000 };
+
+    for (uint8_t g = 0; g < ARRAYLEN(guards); g++) {
+        uint8_t answers = 0;
+        for (uint8_t i = 0; i < EM4X05_BRUTE_TUNE_LOGINS; i++) {
+            WDT_HIT();
+            uint8_t len = EM4xBrutePrepare(~seed ^ (i * 0x9E3779B9));
+            WaitUS(guards[g]);
+            bool answered = false;
+            EM4xBruteTry(len, &answered, ledcontrol);
+            answers += answered;
+        }
+
+        if (g_dbglevel >= DBG_DEBUG)
+            Dbprintf("guard %u us, %u / %u answered", guards[g], answers, EM4X05_BRUTE_TUNE_LOGINS);
+
+        if (answers == EM4X05_BRUTE_TUNE_LOGINS) {
+            return guards[g];
+        }
+    }
+    // what the loop always used
+    return 1000;
+}
+
+static bool EM4xBruteSetup(generator_context_t *ctx, const em4x05_brute_t *p, uint8_t word) {
+    if (p->mode == BF_MODE_MASK) {
+        if (word >= p->count) {
+            return false;
+        }
+        bf_generator_init(ctx, BF_MODE_MASK, BF_KEY_SIZE_32);
+        ctx->range_low = p->words[word];
+        ctx->mask = p->mask;
+        return true;
+    }
+
+    bf_generator_init(ctx, BF_MODE_RANGE, BF_KEY_SIZE_32);
+    ctx->range_low = p->start;
+    ctx->range_high = p->end;
+    return true;
+}
+
+// Device resident password bruteforce over a range, or over dictionary words
+// with a mask.  The next login is prepared while the tag settles from the last
+// one, candidates and progress go to the client as CMD_LF_EM4X_BF_PROGRESS.
+void EM4xBruteforce(const uint8_t *data, bool ledcontrol) {
+
+#define EM4X05_BRUTE_PROGRESS_INTERVAL 64
+
+    const em4x05_brute_t *p = (const em4x05_brute_t *)data;
+    em4x05_brute_reply_t reply = {
+        .word = p->word,
+        .guard_us = p->guard_us,
+    };
+    int status = PM3_SUCCESS;
+
     StartTicks();
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
     WaitMS(20);
@@ -2647,49 +3406,66 @@ void EM4xBruteforce(uint32_t start_pwd, uint32_t n, bool ledcontrol) {
 
     LFSetupFPGAForADC(LF_DIVISOR_125, true);
 
-    uint32_t candidates_found = 0;
-    for (uint32_t pwd = start_pwd; pwd < 0xFFFFFFFF; pwd++) {
+    if (reply.guard_us == 0) {
+        reply.guard_us = EM4xBruteTune(p->start, ledcontrol);
+    }
+
+    if (g_dbglevel >= DBG_DEBUG)
+        Dbprintf("guard " _YELLOW_("%u") " us", reply.guard_us);
+
+    generator_context_t ctx;
+    bool more = EM4xBruteSetup(&ctx, p, reply.word);
+    uint32_t guard_ticks = (reply.guard_us * 3) / 2;
+    uint32_t last = GetTicks();
 
-        if (((pwd - start_pwd) & 0x3F) == 0x00) {
+    while (more) {
 
+        int res = bf_generate(&ctx);
+        if (res == BF_GENERATOR_END) {
+            more = (p->mode == BF_MODE_MASK) && EM4xBruteSetup(&ctx, p, ++reply.word);
+            continue;
+        }
+        if (res != BF_GENERATOR_NEXT) {
+            status = PM3_ESOFT;
+            break;
+        }
+
+        reply.password = bf_get_key32(&ctx);
+
+        if ((reply.tried % EM4X05_BRUTE_PROGRESS_INTERVAL) == 0) {
             WDT_HIT();
             if (BUTTON_PRESS() || data_available()) {
-                Dbprintf("EM4x05 Bruteforce Interrupted");
+                status = PM3_EOPABORTED;
                 break;
             }
+            if (reply.tried) {
+                reply_ng(CMD_LF_EM4X_BF_PROGRESS, PM3_SUCCESS, (uint8_t *)&reply, sizeof(reply));
+            }
         }
 
-        // Report progress every 256 attempts
-        if (((pwd - start_pwd) & 0xFF) == 0x00) {
-            Dbprintf("Trying: %06Xxx", pwd >> 8);
-        }
-        clear_trace();
-
-        forward_ptr = forwardLink_data;
-        uint8_t len = Prepare_Cmd(FWD_CMD_LOGIN);
-        len += Prepare_Data(pwd & 0xFFFF, pwd >> 16);
-        SendForward(len, true);
-
-        WaitUS(400);
-        DoPartialAcquisition(0, false, 350, 1000, ledcontrol);
+        // prepared while the tag gets back to listening
+        uint8_t len = EM4xBrutePrepare(reply.password);
+        while (GetTicksDelta(last) < guard_ticks) {};
 
-        uint8_t *mem = BigBuf_get_addr();
+        bool ok = EM4xBruteTry(len, NULL, ledcontrol);
+        last = GetTicks();
+        reply.tried++;
 
-        if (mem[334] < 128) {
-            candidates_found++;
-            Dbprintf("Password candidate: " _GREEN_("%08X"), pwd);
-            if ((n != 0) && (candidates_found == n)) {
-                Dbprintf("EM4x05 Bruteforce Stopped. %i candidate%s found", candidates_found, candidates_found > 1 ? "s" : "");
+        if (ok) {
+            reply.candidates++;
+            reply.found = true;
+            if ((p->n != 0) && (reply.candidates == p->n)) {
                 break;
             }
+            reply_ng(CMD_LF_EM4X_BF_PROGRESS, PM3_SUCCESS, (uint8_t *)&reply, sizeof(reply));
+            reply.found = false;
         }
-
-        // Beware: if smaller, tag might not have time to be back in listening state yet
-        WaitMS(1);
     }
+
     StopTicks();
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
     if (ledcontrol) LEDsoff();
+    reply_ng(CMD_LF_EM4X_BF, status, (uint8_t *)&reply, sizeof(reply));
 }
 
 void EM4xLogin(uint32_t pwd, bool ledcontrol) {
@@ -2934,6 +3710,54 @@ void Cotag(uint32_t arg0, bool ledcontrol) {
     if (ledcontrol) LEDsoff();
 }
 
+// Indala is PSK1.  Sample with the default config, demodulate with the client's own
+// pskRawDemod_ext() and only send the bits, the client looks for the preamble.
+void IndalaRead(const lf_indala_read_t *p, bool ledcontrol) {
+
+    lf_indala_read_reply_t reply;
+    memset(&reply, 0, sizeof(reply));
+
+    sample_config old_config;
+    memcpy(&old_config, getSamplingConfig(), sizeof(sample_config));
+    old_config.verbose = false;
+    setDefaultSamplingConfig();
+
+    size_t size = SampleLF(false, (p->samples) ? p->samples : 30000, ledcontrol);
+
+    setSamplingConfig(&old_config);
+
+    uint8_t *dest = BigBuf_get_addr();
+    computeSignalProperties(dest, size);
+    if (getSignalProperties()->isnoise) {
+        reply_ng(CMD_LF_INDALA_READ, PM3_ENODATA, NULL, 0);
+        return;
+    }
+
+    WDT_HIT();
+
+    int clk = p->clock;
+    int invert = p->invert;
+    int start_idx = 0;
+    int errors = pskRawDemod_ext(dest, &size, &clk, &invert, &start_idx);
+    if (errors < 0 || errors > p->max_err || size < 16) {
+        reply_ng(CMD_LF_INDALA_READ, PM3_ESOFT, NULL, 0);
+        return;
+    }
+
+    reply.clock = clk;
+    reply.errors = errors;
+    reply.start_idx = start_idx;
+    reply.bitlen = MIN(size, LF_INDALA_READ_MAX_BITS);
+    for (uint16_t i = 0; i < reply.bitlen; i++) {
+        // demod errors, marked 7, go as zero bits
+        if (dest[i] == 1) {
+            reply.bits[i >> 3] |= 0x80 >> (i & 7);
+        }
+    }
+
+    reply_ng(CMD_LF_INDALA_READ, PM3_SUCCESS, (uint8_t *)&reply, sizeof(reply) - sizeof(reply.bits) + ((reply.bitlen + 7) / 8));
+}
+
 /*
 * EM4305 support
 */
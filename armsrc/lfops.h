@@ -32,11 +32,13 @@ void AcquireTiType(bool ledcontrol);
 void AcquireRawBitsTI(void);
 void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles);
 void SimulateTagLowFrequency(int period, int gap, bool ledcontrol);
+void SimulateTagLowFrequencyPacked(int period, int gap, bool ledcontrol);
 void SimulateTagLowFrequencyBidir(int divisor, int max_bitlen);
 
 bool add_HID_preamble(uint32_t *hi2, uint32_t *hi, uint32_t *lo, uint8_t length);
 void CmdHIDsimTAGEx(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol, int numcycles);
 void CmdHIDsimTAG(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol);
+void CmdHIDBrute(const lf_hid_brute_t *p, bool ledcontrol);
 
 void CmdFSKsimTAGEx(uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t clk, uint16_t bitslen,
                     const uint8_t *bits, bool ledcontrol, int numcycles);
@@ -53,6 +55,7 @@ int lf_hid_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol);
 int lf_awid_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol); // Realtime demodulation mode for AWID26
 int lf_em410x_watch(int findone, uint32_t *high, uint64_t *low, bool ledcontrol);
 int lf_io_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol);
+int lf_watch(uint8_t protocols, uint16_t holdoff, bool ledcontrol); // all of the above on one acquisition
 
 void CopyHIDtoT55x7(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool q5, bool em, bool ledcontrol); // Clone an HID card to T5557/T5567
 void CopyVikingtoT55xx(const uint8_t *blocks, bool q5, bool em, bool ledcontrol);
@@ -67,18 +70,24 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
                     uint8_t downlink_mode, bool ledcontrol);
 void T55xxWakeUp(uint32_t pwd, uint8_t flags, bool ledcontrol);
 void T55xx_ChkPwds(uint8_t flags, bool ledcontrol);
+void T55xx_BrutePwds(const uint8_t *data, bool ledcontrol);
+void T55xx_CloneVerify(const uint8_t *data, bool ledcontrol);
+void T55xx_CloneQueue(const uint8_t *data, bool ledcontrol);
+void T55xxProbe(const t55xx_probe_t *p, bool ledcontrol);
+void T55xxDump(const t55xx_dump_t *p, bool ledcontrol);
 void T55xxDangerousRawTest(const uint8_t *data, bool ledcontrol);
 
 void turn_read_lf_on(uint32_t delay);
 void turn_read_lf_off(uint32_t delay);
 
 void EM4xLogin(uint32_t pwd, bool ledcontrol);
-void EM4xBruteforce(uint32_t start_pwd, uint32_t n, bool ledcontrol);
+void EM4xBruteforce(const uint8_t *data, bool ledcontrol);
 void EM4xReadWord(uint8_t addr, uint32_t pwd, uint8_t usepwd, bool ledcontrol);
 void EM4xWriteWord(uint8_t addr, uint32_t data, uint32_t pwd, uint8_t usepwd, bool ledcontrol);
 void EM4xProtectWord(uint32_t data, uint32_t pwd, uint8_t usepwd, bool ledcontrol);
 
 void Cotag(uint32_t arg0, bool ledcontrol);
+void IndalaRead(const lf_indala_read_t *p, bool ledcontrol);
 void setT55xxConfig(uint8_t arg0, const t55xx_configurations_t *c);
 t55xx_configurations_t *getT55xxConfig(void);
 void printT55xxConfig(void);
@@ -28,6 +28,7 @@
 #include "string.h"  // memset
 #include "appmain.h" // print stack
 #include "usb_cdc.h" // real-time sampling
+#include "commonutil.h"  // reverse_array
 
 /*
 Default LF config is set to:
@@ -38,6 +39,8 @@ Default LF config is set to:
     trigger_threshold = 0
     samples_to_skip = 0
     verbose = YES
+    post_trigger = 0 (ring mode off)
+    trigger_gap = 0
     */
 
 static const sample_config def_config = {
@@ -48,9 +51,11 @@ static const sample_config def_config = {
     .trigger_threshold = 0,
     .samples_to_skip = 0,
     .verbose = false,
+    .post_trigger = 0,
+    .trigger_gap = 0,
 };
 
-static sample_config config = { 1, 8, 1, LF_DIVISOR_125, 0, 0, true} ;
+static sample_config config = { 1, 8, 1, LF_DIVISOR_125, 0, 0, true, 0, 0} ;
 
 // Holds bit packed struct of samples.
 static BitstreamOut_t data = {0, 0, 0};
@@ -67,6 +72,16 @@ void printLFConfig(void) {
     Dbprintf("  [a] averaging........... %s", (config.averaging) ? "yes" : "no");
     Dbprintf("  [t] trigger threshold... %d", config.trigger_threshold);
     Dbprintf("  [s] samples to skip..... %d ", config.samples_to_skip);
+    if (config.post_trigger > 0) {
+        Dbprintf("  [post] ring mode........ " _GREEN_("%d") " samples after trigger", config.post_trigger);
+        if (config.trigger_gap > 0) {
+            Dbprintf("  [gap] trigger gap....... %d samples", config.trigger_gap);
+        } else {
+            Dbprintf("  [gap] trigger gap....... off ( threshold edge )");
+        }
+    } else {
+        Dbprintf("  [post] ring mode........ off");
+    }
     DbpString("");
 }
 
@@ -121,6 +136,14 @@ void setSamplingConfig(const sample_config *sc) {
     if (sc->samples_to_skip > -1)
         config.samples_to_skip = sc->samples_to_skip;
 
+    // Ring mode, samples kept after the trigger
+    if (sc->post_trigger > -1)
+        config.post_trigger = sc->post_trigger;
+
+    // Ring mode, length of the field-off gap that triggers
+    if (sc->trigger_gap > -1)
+        config.trigger_gap = sc->trigger_gap;
+
     if (sc->verbose)
         printLFConfig();
 }
@@ -398,7 +421,144 @@ uint32_t DoAcquisition(uint8_t decimation, uint8_t bits_per_sample, bool avg, in
 uint32_t DoAcquisition_default(int trigger_threshold, bool verbose, bool ledcontrol) {
     return DoAcquisition(1, 8, 0, trigger_threshold, verbose, 0, 0, 0, ledcontrol);
 }
+/**
+ * Ring mode acquisition. Samples are written continuously into a circular buffer
+ * and the capture freezes post_trigger samples after the trigger, the rest of the
+ * buffer holds what came before it. The trigger is either the first sample outside
+ * +-trigger_threshold or, with trigger_gap set, a field-off gap of trigger_gap
+ * samples in a row below -trigger_threshold.
+ * Only 8 bits per sample, samples_to_skip is not used.
+ * @return the number of bits occupied by the samples.
+ */
+static uint32_t DoAcquisitionRing(uint8_t decimation, bool avg, int16_t trigger_threshold, uint16_t trigger_gap,
+                                  uint32_t post_trigger, bool verbose, uint32_t sample_size, bool ledcontrol) {
+
+    initSampleBuffer(&sample_size); // 8 bps, one sample per byte
+
+    if (decimation == 0) {
+        decimation = 1;
+    }
+
+    post_trigger = MIN(post_trigger, sample_size);
+
+    uint8_t *buf = data.buffer;
+    uint32_t pos = 0;
+    bool wrapped = false;
+    bool trigger_hit = false;
+    uint32_t remaining = post_trigger;
+    uint16_t low_run = 0;
+    uint8_t dec_counter = 0;
+    uint32_t sum = 0;
+    uint32_t seen = 0;
+    int16_t checked = 0;
+
+    while (BUTTON_PRESS() == false) {
+
+        // the ring never fills up, keep it interruptible until the trigger
+        if (trigger_hit == false && (checked >= 4000)) {
+            if (data_available()) {
+                checked = -1;
+                break;
+            } else {
+                checked = 0;
+            }
+        }
+        ++checked;
+
+        WDT_HIT();
+
+        if (ledcontrol && (AT91C_BASE_SSC->SSC_SR & AT91C_SSC_TXRDY)) {
+            LED_D_ON();
+        }
+
+        if (AT91C_BASE_SSC->SSC_SR & AT91C_SSC_RXRDY) {
+            volatile uint8_t sample = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
+
+            if (ledcontrol) LED_D_OFF();
+
+            seen++;
+
+            if (trigger_hit == false) {
+                if (trigger_gap) {
+                    if (sample <= (128 - trigger_threshold)) {
+                        if (++low_run >= trigger_gap) {
+                            trigger_hit = true;
+                        }
+                    } else {
+                        low_run = 0;
+                    }
+                } else if ((trigger_threshold == 0) || (sample >= (trigger_threshold + 128)) || (sample <= (128 - trigger_threshold))) {
+                    trigger_hit = true;
+                }
+            }
+
+            if (avg) {
+                sum += sample;
+            }
+
+            if (decimation > 1) {
+                if (++dec_counter < decimation) {
+                    continue;
+                }
+                dec_counter = 0;
+                if (avg) {
+                    sample = sum / decimation;
+                    sum = 0;
+                }
+            }
+
+            buf[pos++] = sample;
+            if (pos == sample_size) {
+                pos = 0;
+                wrapped = true;
+            }
+
+            if (trigger_hit) {
+                if (remaining == 0 || --remaining == 0) {
+                    break;
+                }
+            }
+        }
+    }
+
+    // unroll the ring, the oldest sample goes first
+    uint32_t count = (wrapped) ? sample_size : pos;
+    if (wrapped && pos) {
+        reverse_array(buf, pos);
+        reverse_array(buf + pos, sample_size - pos);
+        reverse_array(buf, sample_size);
+    }
+
+    samples.counter = seen;
+    samples.total_saved = count;
+    data.numbits = count << 3;
+
+    if (verbose) {
+        if (checked == -1) {
+            Dbprintf("lf sampling aborted");
+        } else if (trigger_hit == false) {
+            Dbprintf("lf sampling stopped before the trigger");
+        }
+
+        Dbprintf("Done, saved " _YELLOW_("%d")" out of " _YELLOW_("%d")" seen samples, " _YELLOW_("%d")" after the trigger", count, seen, (trigger_hit) ? post_trigger - remaining : 0);
+    }
+
+    removeSignalOffset(buf, count);
+    computeSignalProperties(buf, count);
+    return data.numbits;
+}
+
 uint32_t DoAcquisition_config(bool verbose, uint32_t sample_size, bool ledcontrol) {
+    if (config.post_trigger > 0 && config.bits_per_sample == 8) {
+        return DoAcquisitionRing(config.decimation
+                                 , config.averaging
+                                 , config.trigger_threshold
+                                 , config.trigger_gap
+                                 , config.post_trigger
+                                 , verbose
+                                 , sample_size
+                                 , ledcontrol);
+    }
     return DoAcquisition(config.decimation
                          , config.bits_per_sample
                          , config.averaging
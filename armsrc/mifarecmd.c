@@ -44,6 +44,9 @@
 #ifndef HARDNESTED_PRE_AUTHENTICATION_LEADTIME
 # define HARDNESTED_PRE_AUTHENTICATION_LEADTIME 400 // some (non standard) cards need a pause after select before they are ready for first authentication
 #endif
+#ifndef HARDNESTED_FILTER_BATCH_TIME
+# define HARDNESTED_FILTER_BATCH_TIME 1500          // ms, answer early when filtering leaves too few nonces, the client waits 3 s
+#endif
 
 // send an incomplete dummy response in order to trigger the card's authentication failure timeout
 #ifndef CHK_TIMEOUT
@@ -378,9 +381,38 @@ void MifareUReadBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain) {
     LEDsoff();
 }
 
+// select and authenticate again, after a NAK the card is idle
+static bool mfu_select_auth(uint8_t keytype, const uint8_t *key) {
+
+    if (iso14443a_select_card(NULL, NULL, NULL, true, 0, true) == 0) {
+        if (g_dbglevel >= DBG_ERROR) Dbprintf("Can't select card");
+        return false;
+    }
+
+    // UL-C authentication
+    if (keytype == 1) {
+        uint8_t k[16] = {0x00};
+        memcpy(k, key, sizeof(k));
+        if (mifare_ultra_auth(k) == 0) {
+            return false;
+        }
+    }
+
+    // UL-EV1 / NTAG authentication
+    if (keytype == 2) {
+        uint8_t pwd[4] = {0x00};
+        memcpy(pwd, key, sizeof(pwd));
+        uint8_t pack[4] = {0, 0, 0, 0};
+        if (mifare_ul_ev1_auth(pwd, pack) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // arg0 = blockNo (start)
 // arg1 = Pages (number of blocks)
-// arg2 = useKey
+// arg2 = useKey, ORed with MFU_READCARD_FASTREAD when the card takes FAST_READ
 // datain = KEY bytes
 void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain) {
     LEDsoff();
@@ -395,8 +427,8 @@ void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain)
     // params
     uint8_t blockNo = arg0;
     uint16_t blocks = arg1;
-    bool useKey = (arg2 == 1); // UL_C
-    bool usePwd = (arg2 == 2); // UL_EV1/NTAG
+    uint8_t keytype = (arg2 & 0x0F); // 1 = UL_C, 2 = UL_EV1/NTAG
+    bool fast = ((arg2 & MFU_READCARD_FASTREAD) == MFU_READCARD_FASTREAD);
     uint32_t countblocks = 0;
     uint8_t *dataout = BigBuf_calloc(CARD_MEMORY_SIZE);
     if (dataout == NULL) {
@@ -405,43 +437,35 @@ void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain)
         return;
     }
 
-    int len = iso14443a_select_card(NULL, NULL, NULL, true, 0, true);
-    if (len == 0) {
-        if (g_dbglevel >= DBG_ERROR) Dbprintf("Can't select card");
+    if (mfu_select_auth(keytype, datain) == false) {
         OnError(1);
         return;
     }
 
-    // UL-C authentication
-    if (useKey) {
-        uint8_t key[16] = {0x00};
-        memcpy(key, datain, sizeof(key));
-
-        if (mifare_ultra_auth(key) == 0) {
-            OnError(1);
-            return;
-        }
-    }
-
-    // UL-EV1 / NTAG authentication
-    if (usePwd) {
-        uint8_t pwd[4] = {0x00};
-        memcpy(pwd, datain, sizeof(pwd));
-        uint8_t pack[4] = {0, 0, 0, 0};
-
-        if (mifare_ul_ev1_auth(pwd, pack) == 0) {
-            OnError(1);
-            return;
-        }
-    }
-
-    for (int i = 0; i < blocks; i++) {
+    for (int i = 0; i < blocks;) {
         if ((i * 4) + 4 >= CARD_MEMORY_SIZE) {
             Dbprintf("Data exceeds buffer!!");
             break;
         }
 
-        len = mifare_ultra_readblock(blockNo + i, dataout + (4 * i));
+        // ranges of pages in one go
+        if (fast) {
+            uint8_t n = MIN(blocks - i, MFU_FASTREAD_MAX_PAGES);
+            n = MIN(n, (CARD_MEMORY_SIZE / 4) - 1 - i);
+            if (mifare_ultra_fastread(blockNo + i, blockNo + i + n - 1, dataout + (4 * i)) == 0) {
+                i += n;
+                countblocks += n;
+                continue;
+            }
+
+            // part of the range is protected or missing, find the last readable page one by one
+            fast = false;
+            if (mfu_select_auth(keytype, datain) == false) {
+                break;
+            }
+        }
+
+        int len = mifare_ultra_readblock(blockNo + i, dataout + (4 * i));
 
         if (len) {
             if (g_dbglevel >= DBG_ERROR) Dbprintf("Read block %d error", i);
@@ -456,9 +480,15 @@ void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain)
         } else {
             countblocks++;
         }
+        i++;
+    }
+
+    if (countblocks == 0) {
+        OnError(2);
+        return;
     }
 
-    len = mifare_ultra_halt();
+    int len = mifare_ultra_halt();
     if (len) {
         if (g_dbglevel >= DBG_ERROR) Dbprintf("Halt error");
         OnError(3);
@@ -476,6 +506,201 @@ void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain)
     set_tracing(false);
 }
 
+// Tries a batch of UL-C keys, UL-AES keys or EV1/NTAG passwords in one go, the card is
+// selected again after every failed attempt since it drops back to idle
+void MifareUChkKeys(const mfu_chk_keys_t *p) {
+    LEDsoff();
+    LED_A_ON();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    clear_trace();
+    set_tracing(false);
+
+    mfu_chk_keys_resp_t resp = {0};
+    int res = PM3_ESOFT;
+    uint8_t keylen = (p->keytype == MFU_CHK_PWD) ? 4 : 16;
+
+    for (uint16_t i = 0; i < p->count; i++) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        if (iso14443a_select_card(NULL, NULL, NULL, true, 0, true) == 0) {
+            // some cards need the field cycled after a failed authentication
+            FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+            SpinDelay(40);
+            iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+            if (iso14443a_select_card(NULL, NULL, NULL, true, 0, true) == 0) {
+                if (g_dbglevel >= DBG_ERROR) Dbprintf("Can't select card");
+                res = PM3_ECARDEXCHANGE;
+                break;
+            }
+        }
+
+        uint8_t key[16] = {0};
+        memcpy(key, p->keys + (i * keylen), keylen);
+        resp.tested++;
+
+        int ok = 0;
+        switch (p->keytype) {
+            case MFU_CHK_ULC:
+                ok = mifare_ultra_auth(key);
+                break;
+            case MFU_CHK_ULAES:
+                ok = mifare_ultra_aes_auth(p->keyno, key);
+                break;
+            case MFU_CHK_PWD: {
+                uint8_t pack[4] = {0};
+                ok = mifare_ul_ev1_auth(key, pack);
+                memcpy(resp.pack, pack, sizeof(resp.pack));
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (ok) {
+            resp.found = 1;
+            resp.index = i;
+            res = PM3_SUCCESS;
+            break;
+        }
+    }
+
+    reply_ng(CMD_HF_MIFAREU_CHKKEYS, res, (uint8_t *)&resp, sizeof(resp));
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+}
+
+// Reads count pages from start into out. FAST_READ when the card takes it, otherwise
+// READ, which returns four pages at a time
+static int mfu_read_range(uint8_t start, uint16_t count, uint8_t *out, bool fast, uint8_t keytype, const uint8_t *key) {
+
+    if (fast) {
+        uint16_t i = 0;
+        while (i < count) {
+            uint8_t n = MIN(count - i, MFU_FASTREAD_MAX_PAGES);
+            if (mifare_ultra_fastread(start + i, start + i + n - 1, out + (4 * i))) {
+                break;
+            }
+            i += n;
+        }
+        if (i == count) {
+            return PM3_SUCCESS;
+        }
+
+        if (mfu_select_auth(keytype, key) == false) {
+            return PM3_ECARDEXCHANGE;
+        }
+    }
+
+    uint8_t buf[16];
+    for (uint16_t i = 0; i < count; i += 4) {
+        if (mifare_ultra_readblock(start + i, buf)) {
+            return PM3_EFAILED;
+        }
+        memcpy(out + (4 * i), buf, MIN(count - i, 4) * 4);
+    }
+    return PM3_SUCCESS;
+}
+
+// Writes a range of pages in one field session.
+// MFU_WRITE_COMPARE reads the range first and skips pages already holding the data,
+// MFU_WRITE_VERIFY reads it back once at the end.
+void MifareUWritePages(const mfu_write_pages_t *p) {
+    LEDsoff();
+    LED_A_ON();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    clear_trace();
+    set_tracing(true);
+
+    mfu_write_pages_resp_t resp = {0};
+    int res = PM3_SUCCESS;
+    bool fast = (p->flags & MFU_WRITE_FASTREAD);
+
+    int arena = BigBuf_arena_begin("mfu_write_pages");
+    uint8_t *cur = BigBuf_calloc((p->count + 4) * 4);
+    if (cur == NULL) {
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    if (mfu_select_auth(p->keytype, p->key) == false) {
+        res = PM3_ECARDEXCHANGE;
+        goto out;
+    }
+
+    // best effort, a range we can't read is written in full
+    bool have_cur = false;
+    if (p->flags & MFU_WRITE_COMPARE) {
+        have_cur = (mfu_read_range(p->start, p->count, cur, fast, p->keytype, p->key) == PM3_SUCCESS);
+        if (have_cur == false && mfu_select_auth(p->keytype, p->key) == false) {
+            res = PM3_ECARDEXCHANGE;
+            goto out;
+        }
+    }
+
+    for (uint16_t i = 0; i < p->count; i++) {
+
+        const uint8_t *d = p->data + (4 * i);
+        if (have_cur && memcmp(cur + (4 * i), d, 4) == 0) {
+            resp.skipped++;
+            continue;
+        }
+
+        uint8_t page[4];
+        memcpy(page, d, sizeof(page));
+
+        res = PM3_EFAILED;
+        for (uint8_t retry = 0; retry < 3 && res != PM3_SUCCESS; retry++) {
+            res = mifare_ultra_writeblock(p->start + i, page);
+            if (res != PM3_SUCCESS && mfu_select_auth(p->keytype, p->key) == false) {
+                break;
+            }
+        }
+
+        if (res != PM3_SUCCESS) {
+            resp.page = p->start + i;
+            goto out;
+        }
+        resp.written++;
+    }
+
+    if ((p->flags & MFU_WRITE_VERIFY) && resp.written) {
+
+        res = mfu_read_range(p->start, p->count, cur, fast, p->keytype, p->key);
+        if (res != PM3_SUCCESS) {
+            goto out;
+        }
+
+        for (uint16_t i = 0; i < p->count; i++) {
+            if (memcmp(cur + (4 * i), p->data + (4 * i), 4) == 0) {
+                continue;
+            }
+
+            // the tail of a four page READ can cross into pages the card hides, ask for the page itself
+            uint8_t buf[16];
+            if (mifare_ultra_readblock(p->start + i, buf) || memcmp(buf, p->data + (4 * i), 4)) {
+                resp.page = p->start + i;
+                res = PM3_ESOFT;
+                goto out;
+            }
+        }
+    }
+
+    mifare_ultra_halt();
+
+out:
+    reply_ng(CMD_HF_MIFAREU_WRITE_PAGES, res, (uint8_t *)&resp, sizeof(resp));
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    BigBuf_arena_end(arena);
+    set_tracing(false);
+}
+
 void MifareValue(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain) {
     // params
     uint8_t blockNo = arg0;
@@ -892,6 +1117,14 @@ void MifareAcquireNonces(uint32_t arg0, uint32_t flags) {
 // Carlo Meijer, Roel Verdult, "Ciphertext-only Cryptanalysis on Hardened
 // Mifare Classic Cards" in Proceedings of the 22nd ACM SIGSAC Conference on
 // Computer and Communications Security, 2015
+//
+// multi target mode (flags 0x0008): datain is key[6], count[1], count * {block, keytype}
+// and the targets take turns, one nonce pair each. Every 9 byte record is then
+// prefixed with the index of its target.
+//
+// filter mode (flags 0x0010, single target only): a nonce whose first two bytes were
+// already reported since the last initialize tells the client nothing new and is
+// dropped. The seen map (65536 bits) stays in BigBuf between the calls.
 //-----------------------------------------------------------------------------
 void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags, uint8_t *datain) {
 
@@ -919,11 +1152,24 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
     bool field_off = flags & 0x0004;
     bool have_uid = false;
 
+    const uint8_t *targets = datain + 7;
+    uint8_t targets_cnt = (flags & 0x0008) ? datain[6] : 0;
+    uint8_t target = 0;
+    uint8_t rec_len = (targets_cnt) ? 10 : 9;
+    bool filter = (flags & 0x0010) && (targets_cnt == 0);
+
     LED_A_ON();
     LED_C_OFF();
 
     BigBuf_free();
-    BigBuf_Clear_ext(false);
+    // first allocation after a free, so the seen map lands on the same address every call
+    uint8_t *seen = NULL;
+    if (filter) {
+        seen = BigBuf_malloc(0x10000 / 8);
+    }
+    if (filter == false || initialize) {
+        BigBuf_Clear_ext(false);
+    }
     set_tracing(false);
 
     if (initialize) {
@@ -934,8 +1180,20 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
 
     uint8_t prev_enc_nt[] = {0, 0, 0, 0};
     uint8_t prev_counter = 0;
+    uint16_t pending = 0;
+    uint32_t start_time = GetTickCount();
 
-    for (uint16_t i = 0; i <= PM3_CMD_DATA_SIZE - 9;) {
+    for (uint16_t i = 0; i <= PM3_CMD_DATA_SIZE - rec_len;) {
+
+        // the first call only sets up the field, its nonces aren't used by the client
+        if (filter && initialize == false && GetTickCountDelta(start_time) > HARDNESTED_FILTER_BATCH_TIME) {
+            break;
+        }
+
+        if (targets_cnt) {
+            targetBlockNo = targets[target * 2];
+            targetKeyType = targets[(target * 2) + 1];
+        }
 
         // Test if the action was cancelled
         if (BUTTON_PRESS()) {
@@ -991,17 +1249,33 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
             continue;
         }
 
-        num_nonces++;
-        if (num_nonces % 2) {
-            memcpy(buf + i, receivedAnswer, 4);
-            nt_par_enc = par_enc[0] & 0xf0;
-        } else {
-            nt_par_enc |= par_enc[0] >> 4;
-            memcpy(buf + i + 4, receivedAnswer, 4);
-            memcpy(buf + i + 8, &nt_par_enc, 1);
-            i += 9;
+        bool fresh = true;
+        if (filter && initialize == false) {
+            uint16_t idx = (receivedAnswer[0] << 8) | receivedAnswer[1];
+            fresh = ((seen[idx >> 3] & (1 << (idx & 7))) == 0);
+            if (fresh) {
+                seen[idx >> 3] |= (1 << (idx & 7));
+                pending = idx;
+            }
         }
 
+        if (fresh) {
+            num_nonces++;
+            uint8_t *rec = buf + i + ((targets_cnt) ? 1 : 0);
+            if (num_nonces % 2) {
+                memcpy(rec, receivedAnswer, 4);
+                nt_par_enc = par_enc[0] & 0xf0;
+            } else {
+                nt_par_enc |= par_enc[0] >> 4;
+                memcpy(rec + 4, receivedAnswer, 4);
+                memcpy(rec + 8, &nt_par_enc, 1);
+                if (targets_cnt) {
+                    buf[i] = target;
+                    target = (target + 1) % targets_cnt;
+                }
+                i += rec_len;
+            }
+        }
 
         if (prev_enc_nt[0] == receivedAnswer[0] &&
                 prev_enc_nt[1] == receivedAnswer[1] &&
@@ -1024,6 +1298,14 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
 
     }
 
+    // half a record can't be sent, forget its nonce so it is reported again later
+    if (num_nonces % 2) {
+        if (filter && initialize == false) {
+            seen[pending >> 3] &= ~(1 << (pending & 7));
+        }
+        num_nonces--;
+    }
+
     LED_C_OFF();
     crypto1_deinit(pcs);
     LED_B_ON();
@@ -1349,6 +1631,8 @@ void MifareNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8
 
     uint32_t auth1_time, auth2_time;
     static uint16_t delta_time = 0;
+    // card the calibration was made on
+    static uint32_t calibrated_cuid = 0;
 
     LED_A_ON();
     LED_C_OFF();
@@ -1363,6 +1647,15 @@ void MifareNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8
     // statistics on nonce distance
     int16_t isOK = PM3_SUCCESS;
 #define NESTED_MAX_TRIES 12
+
+    // same card as last time, its calibration still holds
+    if (calibrate && calibrated_cuid) {
+        if (iso14443a_select_card(uid, NULL, &cuid, true, 0, true) && cuid == calibrated_cuid) {
+            if (g_dbglevel >= DBG_INFO) Dbprintf("Nested: reusing calibration, min=%d max=%d delta_time=%d", dmin, dmax, delta_time);
+            calibrate = false;
+        }
+    }
+
     if (calibrate) { // calibrate: for first call only. Otherwise reuse previous calibration
         LED_B_ON();
         WDT_HIT();
@@ -1462,6 +1755,8 @@ void MifareNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8
         dmin = davg - 2;
         dmax = davg + 2;
 
+        calibrated_cuid = (isOK == PM3_SUCCESS) ? cuid : 0;
+
         LED_B_OFF();
     }
 //  -------------------------------------------------------------------------------------------------
@@ -1882,12 +2177,17 @@ static void chkKey_loopBonly(struct chk_t *c, struct sector_t *k_sector, uint8_t
     }
 }
 
+// BigBuf left free for the transfer buffers when a check session stores its dictionary
+#define CHK_SESSION_RESERVE 8192
+
 // get Chunks of keys, to test authentication against card.
 // arg0 = antal sectorer
 // arg0 = first time
 // arg1 = clear trace
 // arg2 = antal nycklar i keychunk
 // datain = keys as array
+// arg1 bit 16 = check session, store the keys in BigBuf. first chunk starts a new dictionary
+// arg1 bit 17 = check session, test the stored keys instead of datain. Both strategies in one go
 void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain) {
 
     // first call or
@@ -1897,6 +2197,8 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
     uint16_t singleSectorParams = (arg0 >> 16) & 0xFFFF;
     uint8_t strategy = arg1 & 0xFF;
     uint8_t use_flashmem = (arg1 >> 8) & 0xFF;
+    bool session_store = (arg1 >> 16) & 1;
+    bool session_run = (arg1 >> 17) & 1;
     uint16_t keyCount = arg2 & 0xFF;
     uint8_t status = 0;
     bool singleSectorMode = (singleSectorParams >> 15) & 1;
@@ -1916,6 +2218,39 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
     static sector_t k_sector[80];
     static uint8_t found[80];
     static uint8_t uid[10] = {0};
+    static uint8_t *session_keys = NULL;
+    static uint16_t session_cnt = 0;
+    static uint16_t session_max = 0;
+
+    // keys for a check session, kept until its last chunk has run
+    if (session_store) {
+        if (firstchunk) {
+            BigBuf_free();
+            session_cnt = 0;
+            session_max = 0;
+            uint16_t avail = BigBuf_max_traceLen();
+            if (avail > CHK_SESSION_RESERVE) {
+                session_max = MIN((avail - CHK_SESSION_RESERVE) / MF_KEY_LENGTH, 0xFFFF / MF_KEY_LENGTH);
+            }
+            session_keys = BigBuf_malloc(session_max * MF_KEY_LENGTH);
+            if (session_keys == NULL) {
+                session_max = 0;
+            }
+        }
+
+        uint16_t n = MIN(keyCount, session_max - session_cnt);
+        if (n) {
+            memcpy(session_keys + (session_cnt * MF_KEY_LENGTH), datain, n * MF_KEY_LENGTH);
+            session_cnt += n;
+        }
+        reply_mix(CMD_ACK, session_cnt, session_max, 0, 0, 0);
+        return;
+    }
+
+    if (session_run) {
+        datain = session_keys;
+        keyCount = (session_keys) ? session_cnt : 0;
+    }
 
     int oldbg = g_dbglevel;
 
@@ -1960,6 +2295,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
 #endif
 
     iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    iso14a_adaptive_timeout(true);
 
     LEDsoff();
     LED_A_ON();
@@ -2028,12 +2364,14 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
         reply_mix(CMD_ACK, 0, 0, 0, 0, 0);
 out:
         LEDsoff();
+        iso14a_adaptive_timeout(false);
         crypto1_deinit(pcs);
         if (foundkeys == allkeys || lastchunk) {
             set_tracing(false);
             FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
             BigBuf_free();
             BigBuf_Clear_ext(false);
+            session_keys = NULL;
         }
         g_dbglevel = oldbg;
         return;
@@ -2041,7 +2379,7 @@ out:
 
 
     // keychunk loop - depth first one sector.
-    if (strategy == 1 || use_flashmem) {
+    if (strategy == 1 || use_flashmem || session_run) {
 
         uint8_t newfound = foundkeys;
 
@@ -2152,6 +2490,10 @@ out:
 
             // assume1. if no keys found in first sector, get next keychunk from client
             if (!use_flashmem && (newfound - foundkeys == 0)) {
+                // the whole dictionary is here, go on width first
+                if (session_run) {
+                    break;
+                }
                 goto OUT;
             }
 
@@ -2162,7 +2504,7 @@ out:
         goto OUT;
     }
 
-    if (strategy == 2 || use_flashmem) {
+    if (strategy == 2 || use_flashmem || session_run) {
 
         // Keychunk loop
         for (uint16_t i = 0; i < keyCount; i++) {
@@ -2235,6 +2577,7 @@ out:
     } // end loop strategy 2
 OUT:
     LEDsoff();
+    iso14a_adaptive_timeout(false);
 
     crypto1_deinit(pcs);
 
@@ -2252,6 +2595,7 @@ OUT:
             bar |= ((uint16_t)(found[m] & 1) << j++);
         }
 
+        int arena = BigBuf_arena_begin("chkkeys");
         uint8_t *tmp = BigBuf_malloc(480 + 10);
         memcpy(tmp, k_sector, sectorcnt * sizeof(sector_t));
         num_to_bytes(foo, 8, tmp + 480);
@@ -2259,11 +2603,13 @@ OUT:
         tmp[489] = bar >> 8 & 0xFF;
 
         reply_old(CMD_ACK, foundkeys, 0, 0, tmp, 480 + 10);
+        BigBuf_arena_end(arena);
 
         set_tracing(false);
         FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
         BigBuf_free();
         BigBuf_Clear_ext(false);
+        session_keys = NULL;
 
         // special trick ecfill
         if (use_flashmem && foundkeys == allkeys) {
@@ -2338,6 +2684,7 @@ void MifareChkKeys(uint8_t *datain, uint8_t reserved_mem) {
     LED_A_ON();
 
     iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    iso14a_adaptive_timeout(true);
 
     if (clearTrace)
         clear_trace();
@@ -2391,6 +2738,7 @@ void MifareChkKeys(uint8_t *datain, uint8_t reserved_mem) {
     }
 
     LED_B_ON();
+    iso14a_adaptive_timeout(false);
     crypto1_deinit(pcs);
 
     reply_ng(CMD_HF_MIFARE_CHKKEYS, PM3_SUCCESS, (uint8_t *)&keyresult, sizeof(keyresult));
@@ -2407,15 +2755,13 @@ void MifareChkKeys_file(uint8_t *fn) {
 
     SpinOff(0);
 
-    int changed = rdv40_spiffs_lazy_mount();
+    rdv40_spiffs_session_begin();
     uint32_t size = size_in_spiffs((char *)fn);
     uint8_t *mem = BigBuf_malloc(size);
 
     rdv40_spiffs_read_as_filetype((char *)fn, mem, size, RDV40_SPIFFS_SAFETY_SAFE);
 
-    if (changed) {
-        rdv40_spiffs_lazy_unmount();
-    }
+    rdv40_spiffs_session_end();
 
     SpinOff(0);
 
@@ -2677,7 +3023,145 @@ out:
     return retval;
 }
 
+//-----------------------------------------------------------------------------
+// Dump a whole card in one field session.
+// Sectors after the first authenticate nested, without a reselect. A failed auth
+// or read halts the card, then it is woken up again. Every sector is sent back
+// as soon as it is read.
+//-----------------------------------------------------------------------------
+static bool mf_dump_key_known(const mf_dump_req_t *req, uint8_t sector, uint8_t keytype) {
+    uint8_t bit = (2 * sector) + keytype;
+    return ((req->keymask[bit / 8] >> (bit % 8)) & 1);
+}
+
+static bool mf_dump_reselect(struct Crypto1State *pcs, uint8_t *uid, uint8_t cascade_levels, uint32_t *cuid) {
+    crypto1_deinit(pcs);
+    if (iso14443a_fast_select_card(uid, cascade_levels)) {
+        return true;
+    }
+    // card moved or answered late, one full anticollision
+    return (iso14443a_select_card(uid, NULL, cuid, true, 0, true) != 0);
+}
+
+void MifareDumpCard(mf_dump_req_t *req) {
+
+    if (req->sectorcnt == 0 || req->sectorcnt > MF_DUMP_MAX_SECTORS) {
+        reply_ng(CMD_HF_MIFARE_DUMP, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    LED_A_ON();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    clear_trace();
+    set_tracing(true);
+
+    uint8_t uid[10] = {0x00};
+    uint32_t cuid = 0;
+    uint8_t cascade_levels = 0;
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs = &mpcs;
+
+    // magic cards and readers far away need more time
+    uint32_t timeout = iso14a_get_timeout();
+    iso14a_set_timeout((256 * 16 * (1 << 7)) / (8 * 16));
+
+    iso14a_card_select_t card_info;
+    if (iso14443a_select_card(uid, &card_info, &cuid, true, 0, true) == 0) {
+        if (g_dbglevel >= DBG_ERROR) {
+            Dbprintf("Card not found");
+        }
+        iso14a_set_timeout(timeout);
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        LEDsoff();
+        set_tracing(false);
+        reply_ng(CMD_HF_MIFARE_DUMP, PM3_ECARDEXCHANGE, NULL, 0);
+        return;
+    }
+    cascade_levels = (card_info.uidlen == 10) ? 3 : (card_info.uidlen == 7) ? 2 : 1;
+
+    int retval = PM3_SUCCESS;
+    bool authenticated = false;
+    bool selected = true;
+    // 2 * sector + keytype of the running crypto session
+    uint8_t auth_for = 0;
+
+    for (uint8_t s = 0; s < req->sectorcnt; s++) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            retval = PM3_EOPABORTED;
+            break;
+        }
+
+        mf_dump_sector_t out = { .sector = s, .blocks = NumBlocksPerSector(s), .readmask = 0 };
+        uint16_t all = (uint16_t)((1u << out.blocks) - 1);
+
+        // key A first, key B for what key A may not read
+        for (uint8_t kt = MF_KEY_A; kt <= MF_KEY_B && out.readmask != all; kt++) {
+
+            if (mf_dump_key_known(req, s, kt) == false) {
+                continue;
+            }
+            uint64_t key = bytes_to_num(req->keys[s][kt], 6);
+
+            for (uint8_t b = 0; b < out.blocks; b++) {
+
+                if (out.readmask & (1u << b)) {
+                    continue;
+                }
+
+                uint8_t want = (2 * s) + kt;
+                if (authenticated == false) {
+                    if (selected == false && mf_dump_reselect(pcs, uid, cascade_levels, &cuid) == false) {
+                        break;
+                    }
+                    selected = true;
+                    if (mifare_classic_auth(pcs, cuid, FirstBlockOfSector(s), kt, key, AUTH_FIRST)) {
+                        selected = false;
+                        break;
+                    }
+                    authenticated = true;
+                    auth_for = want;
+                } else if (auth_for != want) {
+                    // still authenticated for the last sector or key
+                    if (mifare_classic_auth(pcs, cuid, FirstBlockOfSector(s), kt, key, AUTH_NESTED)) {
+                        authenticated = false;
+                        selected = false;
+                        break;
+                    }
+                    auth_for = want;
+                }
+
+                if (mifare_classic_readblock(pcs, FirstBlockOfSector(s) + b, out.data + (b * MIFARE_BLOCK_SIZE)) == 0) {
+                    out.readmask |= (1u << b);
+                } else {
+                    // NACK, the card is halted. Go on with the next block, same key
+                    authenticated = false;
+                    selected = false;
+                }
+            }
+        }
 
+        if (out.readmask != all) {
+            retval = PM3_EPARTIAL;
+        }
+
+        reply_ng(CMD_HF_MIFARE_DUMP, PM3_SUCCESS, (uint8_t *)&out, offsetof(mf_dump_sector_t, data) + (out.blocks * MIFARE_BLOCK_SIZE));
+    }
+
+    if (authenticated) {
+        mifare_classic_halt(pcs);
+    }
+    iso14a_set_timeout(timeout);
+    crypto1_deinit(pcs);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    set_tracing(false);
+
+    mf_dump_sector_t done = { .sector = MF_DUMP_DONE };
+    reply_ng(CMD_HF_MIFARE_DUMP, retval, (uint8_t *)&done, offsetof(mf_dump_sector_t, data));
+}
 
 //-----------------------------------------------------------------------------
 // Work with "magic Chinese" card (email him: ouyangweidaxian@live.cn)
@@ -2955,6 +3439,31 @@ static void mf_reset_card(void) {
     iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
 }
 
+#define MAGIC_PROBE_TIMEOUT     318     // ~3 ms, magic cards answer at the usual frame delay
+
+// Probe frame with a short answer timeout, a card without the feature doesn't answer at all
+static int mf_magic_probe(uint8_t *cmd, uint16_t len, uint8_t *buf, uint8_t *par) {
+    uint32_t save_iso14a_timeout = iso14a_get_timeout();
+    iso14a_set_timeout(MAGIC_PROBE_TIMEOUT);
+    ReaderTransmit(cmd, len, NULL);
+    int res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+    iso14a_set_timeout(save_iso14a_timeout);
+    return res;
+}
+
+// Selects the card again for the next probe. HLTA and WUPA bring back a card the last probe
+// left active or idle, the field is only reset when it doesn't answer.
+static int mf_magic_reselect(uint8_t *uid, uint32_t *cuid) {
+    uint8_t hlta[4] = {ISO14443A_CMD_HALT, 0x00, 0x57, 0xCD};
+    ReaderTransmit(hlta, sizeof(hlta), NULL);
+    int res = iso14443a_select_card(uid, NULL, cuid, true, 0, true);
+    if (res == 0) {
+        mf_reset_card();
+        res = iso14443a_select_card(uid, NULL, cuid, true, 0, true);
+    }
+    return res;
+}
+
 void MifareCIdent(bool is_mfc, uint8_t keytype, uint8_t *key) {
     // variables
     uint8_t rec[1] = {0x00};
@@ -2990,14 +3499,12 @@ void MifareCIdent(bool is_mfc, uint8_t keytype, uint8_t *key) {
         }
 
         // check for GDM config
-        ReaderTransmit(gen4gdmGetConf, sizeof(gen4gdmGetConf), NULL);
-        res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+        res = mf_magic_probe(gen4gdmGetConf, sizeof(gen4gdmGetConf), buf, par);
         if (res > 1) {
             // could be ZUID or full USCUID, the magic blocks don't exist on ZUID so
             // a failure here indicates a feature limited chip like ZUID
             // check for GDM hidden block read
-            ReaderTransmit(gen4gdmGetMagicBlock, sizeof(gen4gdmGetMagicBlock), NULL);
-            res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+            res = mf_magic_probe(gen4gdmGetMagicBlock, sizeof(gen4gdmGetMagicBlock), buf, par);
             if (res > 1) {
                 flag |= MAGIC_FLAG_GDM_WUP_40;
             } else {
@@ -3020,12 +3527,16 @@ void MifareCIdent(bool is_mfc, uint8_t keytype, uint8_t *key) {
         }
     }
 
-    // reset card
-    mf_reset_card();
+    // back to idle, the card only answers the GTU command when selected
+    uint8_t hlta[4] = {ISO14443A_CMD_HALT, 0x00, 0x57, 0xCD};
+    ReaderTransmit(hlta, sizeof(hlta), NULL);
     // Use special magic detection function that always attempts RATS regardless of SAK
     res = iso14443a_select_card_for_magic(uid, card, &cuid, true, 0);
-    if (res) {
+    if (res == 0) {
         mf_reset_card();
+        res = iso14443a_select_card_for_magic(uid, card, &cuid, true, 0);
+    }
+    if (res) {
         if (cuid == 0xAA55C396) {
             flag |= MAGIC_FLAG_GEN_UNFUSED;
         }
@@ -3060,9 +3571,13 @@ void MifareCIdent(bool is_mfc, uint8_t keytype, uint8_t *key) {
             flag |= MAGIC_FLAG_GEN_2;
         }
 
-        // test for super card
-        ReaderTransmit(superGen1, sizeof(superGen1), NULL);
-        res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+        // test for super card, it takes APDUs so a card without ATS can't be one
+        res = 0;
+        if (card->ats_len > 0) {
+            mf_reset_card();
+            ReaderTransmit(superGen1, sizeof(superGen1), NULL);
+            res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+        }
         if (res == 22) {
             uint8_t isGen = MAGIC_FLAG_SUPER_GEN1;
 
@@ -3071,8 +3586,7 @@ void MifareCIdent(bool is_mfc, uint8_t keytype, uint8_t *key) {
             mf_reset_card();
 
             iso14443a_select_card(uid, NULL, &cuid, true, 0, true);
-            ReaderTransmit(rdbl00, sizeof(rdbl00), NULL);
-            res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+            res = mf_magic_probe(rdbl00, sizeof(rdbl00), buf, par);
             if (res == 18) {
                 isGen = MAGIC_FLAG_SUPER_GEN2;
             }
@@ -3083,12 +3597,9 @@ void MifareCIdent(bool is_mfc, uint8_t keytype, uint8_t *key) {
 
     if (is_mfc == false) {
         // magic ntag test
-        mf_reset_card();
-
-        res = iso14443a_select_card(uid, NULL, &cuid, true, 0, true);
+        res = mf_magic_reselect(uid, &cuid);
         if (res == 2) {
-            ReaderTransmit(rdblf0, sizeof(rdblf0), NULL);
-            res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+            res = mf_magic_probe(rdblf0, sizeof(rdblf0), buf, par);
             if (res == 18) {
                 flag |= MAGIC_FLAG_NTAG21X;
             }
@@ -3105,9 +3616,7 @@ void MifareCIdent(bool is_mfc, uint8_t keytype, uint8_t *key) {
         // if we do get an ACK, we immediately abort to ensure nothing is ever actually written
         // only perform test if we haven't already identified Gen2.  No need test if we have a positive identification already
         if (isGen2 == false) {
-            mf_reset_card();
-
-            res = iso14443a_select_card(uid, NULL, &cuid, true, 0, true);
+            res = mf_magic_reselect(uid, &cuid);
             if (res) {
 
                 uint64_t tmpkey = bytes_to_num(key, 6);
@@ -3124,33 +3633,25 @@ void MifareCIdent(bool is_mfc, uint8_t keytype, uint8_t *key) {
         }
 
         // magic MFC Gen3 test 1
-        mf_reset_card();
-
-        res = iso14443a_select_card(uid, NULL, &cuid, true, 0, true);
+        res = mf_magic_reselect(uid, &cuid);
         if (res) {
-            ReaderTransmit(rdbl00, sizeof(rdbl00), NULL);
-            res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+            res = mf_magic_probe(rdbl00, sizeof(rdbl00), buf, par);
             if (res == 18) {
                 flag |= MAGIC_FLAG_GEN_3;
             }
         }
 
         // magic MFC Gen4 GDM magic auth test
-        mf_reset_card();
-
-        res = iso14443a_select_card(uid, NULL, &cuid, true, 0, true);
+        res = mf_magic_reselect(uid, &cuid);
         if (res) {
-            ReaderTransmit(gen4gdmAuth, sizeof(gen4gdmAuth), NULL);
-            res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+            res = mf_magic_probe(gen4gdmAuth, sizeof(gen4gdmAuth), buf, par);
             if (res == 4) {
                 flag |= MAGIC_FLAG_GDM_AUTH;
             }
         }
 
         // QL88 test
-        mf_reset_card();
-
-        res = iso14443a_select_card(uid, NULL, &cuid, true, 0, true);
+        res = mf_magic_reselect(uid, &cuid);
         if (res) {
 
             if (mifare_classic_authex(pcs, cuid, 68, MF_KEY_B, 0x707B11FC1481, AUTH_FIRST, NULL, NULL) == 0) {
@@ -3761,6 +4262,106 @@ OUT:
     BigBuf_free();
 }
 
+// Writes a range of blocks in the field session of MifareG4WriteBlk, then reads them back
+void MifareG4WriteBlocks(const mfg4_write_blocks_t *p) {
+    bool setup = ((p->workFlags & MAGIC_INIT) == MAGIC_INIT) ;
+    bool done = ((p->workFlags & MAGIC_OFF)  == MAGIC_OFF) ;
+
+    mfg4_write_blocks_resp_t resp = {0};
+    int retval = PM3_SUCCESS;
+
+    uint8_t *buf = BigBuf_malloc(PM3_CMD_DATA_SIZE);
+    uint8_t *par = BigBuf_malloc(MAX_PARITY_SIZE);
+    if (buf == NULL || par == NULL) {
+        retval = PM3_EMALLOC;
+        goto OUT;
+    }
+
+    if (p->count > MFG4_WRITE_MAX_BLOCKS) {
+        retval = PM3_EINVARG;
+        goto OUT;
+    }
+
+    if (setup) {
+        LEDsoff();
+        iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+        clear_trace();
+        set_tracing(true);
+
+        if (iso14443a_select_card(NULL, NULL, NULL, true, 0, true) == false) {
+            retval = PM3_ESOFT;
+            goto OUT;
+        }
+    }
+
+    LED_B_ON();
+
+    static uint32_t save_iso14a_timeout;
+    if (setup) {
+        save_iso14a_timeout = iso14a_get_timeout();
+        iso14a_set_timeout(13560000 / 1000 / (8 * 16) * 1000); // 2 seconds timeout
+    }
+
+    uint8_t cmd[] = { GEN_4GTU_CMD, 0x00, 0x00, 0x00, 0x00, GEN_4GTU_WRITE, 0x00,
+                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                      0x00, 0x00
+                    };
+    memcpy(cmd + 1, p->pwd, 4);
+
+    for (uint8_t i = 0; i < p->count; i++) {
+        cmd[6] = p->start + i;
+        memcpy(cmd + 7, p->data + (i * MIFARE_BLOCK_SIZE), MIFARE_BLOCK_SIZE);
+        AddCrc14A(cmd, sizeof(cmd) - 2);
+
+        ReaderTransmit(cmd, sizeof(cmd), NULL);
+        int res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+        if ((res != 4) || (memcmp(buf, "\x90\x00\xfd\x07", 4) != 0)) {
+            resp.block = cmd[6];
+            retval = PM3_ESOFT;
+            break;
+        }
+        resp.written++;
+    }
+
+    if (retval == PM3_SUCCESS && (p->flags & MFG4_WRITE_VERIFY)) {
+
+        // same command, shortened to a read
+        cmd[5] = GEN_4GTU_READ;
+        for (uint8_t i = 0; i < p->count; i++) {
+            cmd[6] = p->start + i;
+            AddCrc14A(cmd, 7);
+
+            ReaderTransmit(cmd, 9, NULL);
+            int res = ReaderReceive(buf, PM3_CMD_DATA_SIZE, par);
+            if ((res != 18) || (memcmp(buf, p->data + (i * MIFARE_BLOCK_SIZE), MIFARE_BLOCK_SIZE) != 0)) {
+                resp.block = cmd[6];
+                retval = PM3_ESOFT;
+                break;
+            }
+        }
+    }
+
+    if (done || retval != PM3_SUCCESS) {
+        iso14a_set_timeout(save_iso14a_timeout);
+    }
+    LED_B_OFF();
+
+OUT:
+    reply_ng(CMD_HF_MIFARE_G4_WRITE_BLOCKS, retval, (uint8_t *)&resp, sizeof(resp));
+    // turns off
+    if (done || retval != PM3_SUCCESS) {
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    }
+
+    LEDsoff();
+    if (done || retval != PM3_SUCCESS) {
+        set_tracing(false);
+    }
+
+    BigBuf_free();
+}
+
 void MifareSetMod(uint8_t *datain) {
 
     uint8_t mod = datain[0];
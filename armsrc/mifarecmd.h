@@ -19,6 +19,7 @@
 
 #include "common.h"
 #include "pm3_cmd.h"
+#include "mifare.h"
 
 int16_t mifare_cmd_readblocks(MifareWakeupType wakeup, uint8_t key_auth_cmd, uint8_t *key, uint8_t read_cmd, uint8_t block_no, uint8_t count, uint8_t *block_data);
 int16_t mifare_cmd_writeblocks(MifareWakeupType wakeup, uint8_t key_auth_cmd, uint8_t *key, uint8_t write_cmd, uint8_t block_no, uint8_t count, uint8_t *block_data);
@@ -30,6 +31,8 @@ void MifareUC_Auth(uint8_t arg0, uint8_t *keybytes);
 void MifareUL_AES_Auth(bool turn_off_field, uint8_t keyno, uint8_t *keybytes);
 
 void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain);
+void MifareUWritePages(const mfu_write_pages_t *p);
+void MifareUChkKeys(const mfu_chk_keys_t *p);
 void MifareUWriteBlockCompat(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 void MifareUWriteBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 
@@ -45,6 +48,7 @@ void MifareChkKeys_file(uint8_t *fn);
 
 int MifareECardLoad(uint8_t sectorcnt, uint8_t keytype, uint8_t *key);
 int MifareECardLoadExt(uint8_t sectorcnt, uint8_t keytype, uint8_t *key);
+void MifareDumpCard(mf_dump_req_t *req);
 
 // MFC GEN1a /1b
 void MifareCSetBlock(uint32_t arg0, uint32_t arg1, uint8_t *datain);  // Work with "magic Chinese" card
@@ -62,6 +66,7 @@ void MifareGen3Freez(void); // Gen 3 magic card lock further UID changes
 // MFC GEN4 GTU
 void MifareG4ReadBlk(uint8_t blockno, uint8_t *pwd, uint8_t workFlags);
 void MifareG4WriteBlk(uint8_t blockno, uint8_t *pwd, uint8_t *data, uint8_t workFlags);
+void MifareG4WriteBlocks(const mfg4_write_blocks_t *p);
 
 void MifareSetMod(uint8_t *datain);
 void MifarePersonalizeUID(uint8_t keyType, uint8_t perso_option, uint64_t key);
@@ -675,6 +675,159 @@ void MifareDES_Auth1(uint8_t *datain) {
     LED_B_OFF();
 }
 
+// Selects the card and the application for MifareDesfireChk
+static bool DesfireChkSelect(const uint8_t *aid) {
+
+    pcb_blocknum = 0;
+
+    iso14a_card_select_t card;
+    if (iso14443a_select_card(NULL, &card, NULL, true, 0, false) == 0) {
+        return false;
+    }
+
+    uint8_t cmd[] = {0x90, MFDES_SELECT_APPLICATION, 0x00, 0x00, 0x03, aid[0], aid[1], aid[2], 0x00};
+    uint8_t resp[RECEIVE_SIZE] = {0x00};
+    int len = DesfireAPDU(cmd, sizeof(cmd), resp);
+    return (len >= 5) && (resp[len - 4] == 0x91) && (resp[len - 3] == 0x00);
+}
+
+// One EV1 authentication with 'key'.  PM3_SUCCESS when the card takes it,
+// PM3_EWRONGANSWER when it is the wrong key, PM3_ESOFT when the key number
+// cannot authenticate with this algorithm, PM3_ECARDEXCHANGE if the card is gone.
+static int DesfireChkKey(desfirekey_t key, uint8_t keyno) {
+
+    uint8_t resp[RECEIVE_SIZE] = {0x00};
+    uint8_t cmd[5 + 32 + 1] = {0x00};
+    uint8_t IV[16] = {0x00};
+    uint8_t RndA[16] = {0x00};
+    uint8_t token[32] = {0x00};
+
+    int rndlen = (key->type == T_AES || key->type == T_3K3DES) ? 16 : 8;
+
+    for (int i = 0; i < rndlen; i += 4) {
+        num_to_bytes(prng_successor(GetTickCount(), 32), 4, &RndA[i]);
+    }
+
+    cmd[0] = 0x90;
+    cmd[1] = (key->type == T_AES) ? MFDES_AUTHENTICATE_AES : MFDES_AUTHENTICATE_ISO;
+    cmd[4] = 0x01;
+    cmd[5] = keyno;
+    int len = DesfireAPDU(cmd, 7, resp);
+    if (len == 0) {
+        return PM3_ECARDEXCHANGE;
+    }
+
+    if ((len != 1 + rndlen + 4) || (resp[len - 3] != MFDES_ADDITIONAL_FRAME)) {
+        return PM3_ESOFT;
+    }
+
+    // RndB, then ek(RndA + RndB') chained on from it
+    memcpy(token + rndlen, resp + 1, rndlen);
+    mifare_cypher_blocks_chained(NULL, key, IV, token + rndlen, rndlen, MCD_RECEIVE, MCO_DECYPHER);
+    rol(token + rndlen, rndlen);
+    memcpy(token, RndA, rndlen);
+    mifare_cypher_blocks_chained(NULL, key, IV, token, 2 * rndlen, MCD_SEND, MCO_ENCYPHER);
+
+    cmd[1] = MFDES_ADDITIONAL_FRAME;
+    cmd[4] = 2 * rndlen;
+    memcpy(cmd + 5, token, 2 * rndlen);
+    cmd[5 + (2 * rndlen)] = 0x00;
+    len = DesfireAPDU(cmd, 5 + (2 * rndlen) + 1, resp);
+    if (len == 0) {
+        return PM3_ECARDEXCHANGE;
+    }
+
+    if ((len >= 5) && (resp[len - 4] == 0x91) && (resp[len - 3] == 0x00)) {
+        return PM3_SUCCESS;
+    }
+    return PM3_EWRONGANSWER;
+}
+
+// Dictionary check of the key numbers of one application, the card stays
+// selected between the attempts and only the hits go back to the client.
+void MifareDesfireChk(const uint8_t *datain) {
+
+    const desfire_chk_t *payload = (const desfire_chk_t *)datain;
+    desfire_chk_reply_t reply = {0};
+    int status = PM3_SUCCESS;
+
+    size_t keylen = (payload->algo == T_DES) ? 8 : (payload->algo == T_3K3DES) ? 24 : 16;
+    uint8_t count = MIN(payload->count, DESFIRE_CHK_KEYS_SIZE / keylen);
+
+    LEDsoff();
+    LED_A_ON();
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    clear_trace();
+    set_tracing(true);
+
+    if (DesfireChkSelect(payload->aid) == false) {
+        if (g_dbglevel >= DBG_ERROR) DbpString("Can't select card or application");
+        OnSuccess();
+        reply_ng(CMD_HF_DESFIRE_CHK, PM3_ECARDEXCHANGE, NULL, 0);
+        return;
+    }
+
+    struct desfire_key defaultkey = {0};
+    desfirekey_t key = &defaultkey;
+
+    for (uint8_t keyno = 0; (keyno < ARRAYLEN(reply.keyidx)) && (status == PM3_SUCCESS); keyno++) {
+
+        if (((payload->keynos >> keyno) & 1) == 0) {
+            continue;
+        }
+
+        for (uint8_t i = 0; i < count; i++) {
+
+            WDT_HIT();
+            if (BUTTON_PRESS() || data_available()) {
+                status = PM3_EOPABORTED;
+                break;
+            }
+
+            const uint8_t *k = payload->keys + (i * keylen);
+            switch (payload->algo) {
+                case T_DES:
+                    Desfire_des_key_new_with_version(k, key);
+                    break;
+                case T_3DES:
+                    Desfire_3des_key_new_with_version(k, key);
+                    break;
+                case T_3K3DES:
+                    Desfire_3k3des_key_new_with_version(k, key);
+                    break;
+                default:
+                    Desfire_aes_key_new(k, key);
+                    break;
+            }
+
+            int res = DesfireChkKey(key, keyno);
+            if (res == PM3_ECARDEXCHANGE) {
+                // lost it, once more from the selection
+                if (DesfireChkSelect(payload->aid) == false) {
+                    status = PM3_ECARDEXCHANGE;
+                    break;
+                }
+                res = DesfireChkKey(key, keyno);
+            }
+
+            if (res == PM3_SUCCESS) {
+                reply.found |= (1 << keyno);
+                reply.keyidx[keyno] = i;
+                break;
+            }
+
+            // this key number takes no key of the algorithm
+            if (res != PM3_EWRONGANSWER) {
+                break;
+            }
+        }
+    }
+
+    OnSuccess();
+    reply_ng(CMD_HF_DESFIRE_CHK, status, (uint8_t *)&reply, sizeof(reply));
+}
+
 // 3 different ISO ways to send data to a DESFIRE (direct, capsuled, capsuled ISO)
 // cmd  =  cmd bytes to send
 // cmd_len = length of cmd
@@ -22,6 +22,7 @@ bool InitDesfireCard(void);
 void MifareSendCommand(uint8_t *datain);
 void MifareDesfireGetInformation(void);
 void MifareDES_Auth1(uint8_t *datain);
+void MifareDesfireChk(const uint8_t *datain);
 void ReaderMifareDES(uint32_t param, uint32_t param2, uint8_t *datain);
 int DesfireAPDU(uint8_t *cmd, size_t cmd_len, uint8_t *dataout);
 size_t CreateAPDU(uint8_t *datain, size_t len, uint8_t *dataout);
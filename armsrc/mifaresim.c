@@ -201,6 +201,98 @@ static bool IsAccessAllowed(uint8_t blockNo, uint8_t keytype, uint8_t action) {
     }
 }
 
+// Keystream of the next exchange. A fast reader expects the answer to a READ within a
+// few hundred microseconds and encrypting it bit by bit after the command came in does not
+// always make it. Once authenticated, the keystream for the reader's 4 byte command and
+// our 18 byte answer is computed while EmGetCmd waits for the reader, one bit per call.
+// The computation only runs on a copy, the real state moves on when it is used.
+#define MF_KS_CMD_LEN   4
+#define MF_KS_LEN       (MF_KS_CMD_LEN + MIFARE_BLOCK_SIZE + CRC16_SIZE)
+typedef struct {
+    bool active;
+    struct Crypto1State start;      // state the keystream starts from
+    struct Crypto1State cur;        // state after the bits done so far
+    struct Crypto1State after_cmd;  // state after the reader's command
+    uint8_t len;                    // complete bytes
+    uint8_t bits;                   // bits of the next byte
+    uint8_t ks[MF_KS_LEN];
+    uint8_t par[MF_KS_LEN];         // filter output after each byte, encrypts its parity bit
+} mf_ks_cache_t;
+static mf_ks_cache_t s_ks;
+
+static void mf_ks_prepare(const struct Crypto1State *pcs) {
+    s_ks.start = *pcs;
+    s_ks.cur = *pcs;
+    s_ks.len = 0;
+    s_ks.bits = 0;
+    s_ks.ks[0] = 0;
+    s_ks.active = true;
+}
+
+static void mf_ks_step(void) {
+    if (s_ks.active == false || s_ks.len == MF_KS_LEN) {
+        return;
+    }
+
+    s_ks.ks[s_ks.len] |= crypto1_bit(&s_ks.cur, 0, 0) << s_ks.bits;
+    if (++s_ks.bits < 8) {
+        return;
+    }
+
+    s_ks.par[s_ks.len] = filter(s_ks.cur.odd) & 0x01;
+    s_ks.bits = 0;
+    if (++s_ks.len == MF_KS_CMD_LEN) {
+        s_ks.after_cmd = s_ks.cur;
+    }
+    if (s_ks.len < MF_KS_LEN) {
+        s_ks.ks[s_ks.len] = 0;
+    }
+}
+
+// the rest of the keystream that was not ready yet
+static void mf_ks_fill(uint8_t len) {
+    while (s_ks.len < len) {
+        mf_ks_step();
+    }
+}
+
+static bool mf_ks_in_sync(const struct Crypto1State *pcs, const struct Crypto1State *at) {
+    return s_ks.active && pcs->odd == at->odd && pcs->even == at->even;
+}
+
+// same as mf_crypto1_decryptEx for a 4 byte command
+static bool mf_ks_decrypt_cmd(struct Crypto1State *pcs, const uint8_t *in, uint16_t len, uint8_t *out) {
+    if (len != MF_KS_CMD_LEN || mf_ks_in_sync(pcs, &s_ks.start) == false) {
+        s_ks.active = false;
+        return false;
+    }
+
+    mf_ks_fill(MF_KS_CMD_LEN);
+    for (uint8_t i = 0; i < MF_KS_CMD_LEN; i++) {
+        out[i] = in[i] ^ s_ks.ks[i];
+    }
+    *pcs = s_ks.after_cmd;
+    return true;
+}
+
+// same as mf_crypto1_encrypt for the answer to a READ
+static bool mf_ks_encrypt_block(struct Crypto1State *pcs, uint8_t *data, uint8_t *par) {
+    if (mf_ks_in_sync(pcs, &s_ks.after_cmd) == false) {
+        return false;
+    }
+
+    mf_ks_fill(MF_KS_LEN);
+    memset(par, 0, (MIFARE_BLOCK_SIZE + CRC16_SIZE + 7) / 8);
+    for (uint8_t i = 0; i < MIFARE_BLOCK_SIZE + CRC16_SIZE; i++) {
+        const uint8_t k = MF_KS_CMD_LEN + i;
+        par[i >> 3] |= ((s_ks.par[k] ^ oddparity8(data[i])) & 0x01) << (7 - (i & 0x07));
+        data[i] ^= s_ks.ks[k];
+    }
+    *pcs = s_ks.cur;
+    s_ks.active = false;
+    return true;
+}
+
 static uint8_t MifareMaxSector(uint16_t flags) {
     if (IS_FLAG_MF_SIZE(flags, MIFARE_MINI_MAX_BYTES)) {
         return MIFARE_MINI_MAXSECTOR;
@@ -552,8 +644,10 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *uid, uint16_t
     // We need to listen to the high-frequency, peak-detected path.
     iso14443a_setup(FPGA_HF_ISO14443A_TAGSIM_LISTEN);
 
-    // clear trace
+    // clear trace, the ring setting only applies to this one
+    set_tracing_ring((flags & FLAG_TRACE_RING) == FLAG_TRACE_RING);
     clear_trace();
+    set_tracing_ring(false);
     set_tracing(true);
     LED_D_ON();
     ResetSspClk();
@@ -564,6 +658,9 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *uid, uint16_t
     int counter = 0;
     bool finished = false;
     bool running_nested_auth_attack = false;
+    s_ks.active = false;
+    EmSetIdleWork(mf_ks_step);
+
     bool button_pushed = BUTTON_PRESS();
     while ((button_pushed == false) && (finished == false)) {
 
@@ -579,6 +676,12 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *uid, uint16_t
             counter++;
         }
 
+        if (cardSTATE == MFEMUL_WORK && cardAUTHKEY != AUTHKEYNONE) {
+            mf_ks_prepare(pcs);
+        } else {
+            s_ks.active = false;
+        }
+
         FpgaEnableTracing();
         //Now, get data
         int res = EmGetCmd(receivedCmd, sizeof(receivedCmd), &receivedCmd_len, receivedCmd_par);
@@ -753,7 +856,9 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *uid, uint16_t
                 encrypted_data = (cardAUTHKEY != AUTHKEYNONE);
                 if (encrypted_data) {
                     // decrypt seqence
-                    mf_crypto1_decryptEx(pcs, receivedCmd, receivedCmd_len, receivedCmd_dec);
+                    if (mf_ks_decrypt_cmd(pcs, receivedCmd, receivedCmd_len, receivedCmd_dec) == false) {
+                        mf_crypto1_decryptEx(pcs, receivedCmd, receivedCmd_len, receivedCmd_dec);
+                    }
                     if (g_dbglevel >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK] Decrypt sequence");
                 } else {
                     // Data in clear
@@ -1021,7 +1126,9 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *uid, uint16_t
                         }
                     }
                     AddCrc14A(response, MIFARE_BLOCK_SIZE);
-                    mf_crypto1_encrypt(pcs, response, MIFARE_BLOCK_SIZE + CRC16_SIZE, response_par);
+                    if (mf_ks_encrypt_block(pcs, response, response_par) == false) {
+                        mf_crypto1_encrypt(pcs, response, MIFARE_BLOCK_SIZE + CRC16_SIZE, response_par);
+                    }
                     EmSendCmdPar(response, MIFARE_BLOCK_SIZE + CRC16_SIZE, response_par);
                     FpgaDisableTracing();
 
@@ -1438,6 +1545,8 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *uid, uint16_t
             }
         }
     }
+    EmSetIdleWork(NULL);
+
     if (g_dbglevel >= DBG_ERROR) {
         Dbprintf("Emulator stopped. Tracing: %d  trace length: %d ", get_tracing(), BigBuf_get_traceLen());
     }
@@ -555,6 +555,33 @@ int mifare_ultra_readblock(uint8_t blockNo, uint8_t *blockData) {
     return res;
 }
 
+// FAST_READ of pages start .. end into out, (end - start + 1) * 4 bytes.
+// A NAK (protected or missing pages) leaves the card idle, it has to be selected again
+int mifare_ultra_fastread(uint8_t start, uint8_t end, uint8_t *out) {
+    uint8_t cmd[] = {start, end};
+    uint16_t n = (end - start + 1) * 4;
+
+    uint8_t receivedAnswer[MAX_FRAME_SIZE] = {0x00};
+    uint8_t receivedAnswerPar[MAX_PARITY_SIZE] = {0x00};
+
+    uint16_t len = mifare_sendcmd(MIFARE_ULEV1_FASTREAD, cmd, sizeof(cmd), receivedAnswer, sizeof(receivedAnswer), receivedAnswerPar, NULL);
+    if (len == 1) {
+        if (g_dbglevel >= DBG_EXTENDED) Dbprintf("FAST_READ %u-%u NAK: %02x", start, end, receivedAnswer[0]);
+        return 1;
+    }
+    if (len != n + 2) {
+        if (g_dbglevel >= DBG_ERROR) Dbprintf("FAST_READ error, len: %u", len);
+        return 2;
+    }
+    if (CheckCrc14A(receivedAnswer, len) == false) {
+        if (g_dbglevel >= DBG_ERROR) Dbprintf("FAST_READ CRC response error.");
+        return 3;
+    }
+
+    memcpy(out, receivedAnswer, n);
+    return 0;
+}
+
 int mifare_classic_writeblock(struct Crypto1State *pcs, uint8_t blockNo, uint8_t *blockData) {
     return mifare_classic_writeblock_ex(pcs, blockNo, blockData, ISO14443A_CMD_WRITEBLOCK);
 }
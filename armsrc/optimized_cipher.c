@@ -143,94 +143,77 @@ uint8_t xopt__select(bool x, bool y, uint8_t r)
 }
 */
 
-static void opt_successor(const uint8_t *k, State_t *s, uint8_t y) {
+/**
+  The MAC has to be ready inside the reader's response window when simulating.
+  The cipher steps now work on a state held in locals, so l, r, b and t stay in registers
+  for a whole MAC instead of going through State_t for every bit. The select index is
+  the LUT entry with Tt xored into bits 0 and 1 and the input bit into bit 1.
+  The bit loops are rolled to keep opt_suc / opt_output small, and both are placed in RAM,
+  where they run as ARM code without flash wait states.
+**/
+static inline __attribute__((always_inline)) void opt_successor(const uint8_t *k, uint8_t *l, uint8_t *r, uint8_t *b, uint16_t *t, uint8_t y) {
 // #define opt_T(s) (0x1 & ((s->t >> 15) ^ (s->t >> 14) ^ (s->t >> 10) ^ (s->t >> 8) ^ (s->t >> 5) ^ (s->t >> 4)^ (s->t >> 1) ^ s->t))
     // uint8_t Tt = opt_T(s);
-    uint16_t Tt = s->t & 0xc533;
+    uint16_t Tt = *t & 0xc533;
     Tt = Tt ^ (Tt >> 1);
     Tt = Tt ^ (Tt >> 4);
     Tt = Tt ^ (Tt >> 10);
     Tt = Tt ^ (Tt >> 8);
+    Tt &= 1;
 
-    s->t = (s->t >> 1);
-    s->t |= (Tt ^ (s->r >> 7) ^ (s->r >> 3)) << 15;
+    *t = (*t >> 1) | (((Tt ^ (*r >> 7) ^ (*r >> 3)) & 1) << 15);
 
-    uint8_t opt_B = s->b;
-    opt_B ^= s->b >> 6;
-    opt_B ^= s->b >> 5;
-    opt_B ^= s->b >> 4;
+    uint8_t opt_B = *b ^ (*b >> 6) ^ (*b >> 5) ^ (*b >> 4);
+    *b = (*b >> 1) | (((opt_B ^ *r) & 1) << 7);
 
-    s->b = s->b >> 1;
-    s->b |= (opt_B ^ s->r) << 7;
+    uint8_t opt_select = opt_select_LUT[*r] ^ (Tt * 3) ^ ((y & 1) << 1);
 
-    uint8_t opt_select = opt_select_LUT[s->r] & 0x04;
-    opt_select |= (opt_select_LUT[s->r] ^ ((Tt ^ y) << 1)) & 0x02;
-    opt_select |= (opt_select_LUT[s->r] ^ Tt) & 0x01;
-
-    uint8_t r = s->r;
-    s->r = (k[opt_select] ^ s->b) + s->l ;
-    s->l = s->r + r;
+    uint8_t r_old = *r;
+    *r = (k[opt_select] ^ *b) + *l;
+    *l = *r + r_old;
 }
 
-static void opt_suc(const uint8_t *k, State_t *s, const uint8_t *in, uint8_t length, bool add32Zeroes) {
-    for (int i = 0; i < length; i++) {
-        uint8_t head;
-        head = in[i];
-        opt_successor(k, s, head);
-
-        head >>= 1;
-        opt_successor(k, s, head);
-
-        head >>= 1;
-        opt_successor(k, s, head);
-
-        head >>= 1;
-        opt_successor(k, s, head);
-
-        head >>= 1;
-        opt_successor(k, s, head);
+static void RAMFUNC opt_suc(const uint8_t *k, State_t *s, const uint8_t *in, uint8_t length, bool add32Zeroes) {
+    uint8_t l = s->l, r = s->r, b = s->b;
+    uint16_t t = s->t;
 
-        head >>= 1;
-        opt_successor(k, s, head);
-
-        head >>= 1;
-        opt_successor(k, s, head);
-
-        head >>= 1;
-        opt_successor(k, s, head);
+    for (int i = 0; i < length; i++) {
+        uint8_t head = in[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            opt_successor(k, &l, &r, &b, &t, head);
+            head >>= 1;
+        }
     }
     //For tag MAC, an additional 32 zeroes
     if (add32Zeroes) {
-        for (int i = 0; i < 8; i++) {
-            opt_successor(k, s, 0);
-            opt_successor(k, s, 0);
-            opt_successor(k, s, 0);
-            opt_successor(k, s, 0);
+        for (uint8_t i = 0; i < 32; i++) {
+            opt_successor(k, &l, &r, &b, &t, 0);
         }
     }
+
+    s->l = l;
+    s->r = r;
+    s->b = b;
+    s->t = t;
 }
 
-static void opt_output(const uint8_t *k, State_t *s,  uint8_t *buffer) {
+static void RAMFUNC opt_output(const uint8_t *k, State_t *s,  uint8_t *buffer) {
+    uint8_t l = s->l, r = s->r, b = s->b;
+    uint16_t t = s->t;
+
     for (uint8_t times = 0; times < 4; times++) {
         uint8_t bout = 0;
-        bout |= (s->r & 0x4) >> 2;
-        opt_successor(k, s, 0);
-        bout |= (s->r & 0x4) >> 1;
-        opt_successor(k, s, 0);
-        bout |= (s->r & 0x4);
-        opt_successor(k, s, 0);
-        bout |= (s->r & 0x4) << 1;
-        opt_successor(k, s, 0);
-        bout |= (s->r & 0x4) << 2;
-        opt_successor(k, s, 0);
-        bout |= (s->r & 0x4) << 3;
-        opt_successor(k, s, 0);
-        bout |= (s->r & 0x4) << 4;
-        opt_successor(k, s, 0);
-        bout |= (s->r & 0x4) << 5;
-        opt_successor(k, s, 0);
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            bout |= ((r >> 2) & 1) << bit;
+            opt_successor(k, &l, &r, &b, &t, 0);
+        }
         buffer[times] = bout;
     }
+
+    s->l = l;
+    s->r = r;
+    s->b = b;
+    s->t = t;
 }
 
 static void opt_MAC(uint8_t *k, uint8_t *input, uint8_t *out) {
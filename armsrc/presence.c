@@ -0,0 +1,295 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Presence polling
+//
+// One loop on the device cycles through the requested protocols and only talks to the host
+// when something changed: a tag showed up, another one took its place, or it was not seen
+// for gone_ms. A reader mode is only set up when the previous step used another one, so with
+// a single protocol, or ISO15693 + iCLASS, the field stays up and a round is just one select.
+//-----------------------------------------------------------------------------
+#include "presence.h"
+
+#include "proxmark3_arm.h"
+#include "appmain.h"
+#include "cmd.h"
+#include "BigBuf.h"
+#include "fpgaloader.h"
+#include "ticks.h"
+#include "dbprint.h"
+#include "util.h"
+#include "commonutil.h"
+#include "string.h"
+
+#ifdef WITH_ISO14443a
+#include "iso14443a.h"
+#include "mifareutil.h"
+#endif
+#ifdef WITH_ISO14443b
+#include "iso14443b.h"
+#endif
+#ifdef WITH_ISO15693
+#include "iso15693.h"
+#endif
+#ifdef WITH_ICLASS
+#include "iclass.h"
+#endif
+#ifdef WITH_LF
+#include "lfsampling.h"
+#include "lfdemod.h"
+#endif
+
+typedef enum {
+    MODE_NONE,
+    MODE_14A,
+    MODE_14B,
+    MODE_HF15,      // ISO15693 and iCLASS
+    MODE_LF,
+} poll_mode_t;
+
+typedef struct {
+    uint8_t protocol;
+    bool present;
+    uint8_t idlen;
+    uint8_t id[12];
+    uint32_t last_seen;
+} poll_slot_t;
+
+static poll_mode_t poll_mode = MODE_NONE;
+
+static void poll_set_mode(poll_mode_t mode) {
+    if (mode == poll_mode) {
+        return;
+    }
+
+    switch_off();
+    BigBuf_free_keep_EM();
+    SpinDelay(5);
+
+    switch (mode) {
+#ifdef WITH_ISO14443a
+        case MODE_14A:
+            iso14443a_setup(FPGA_HF_ISO14443A_READER_MOD);
+            break;
+#endif
+#ifdef WITH_ISO14443b
+        case MODE_14B:
+            iso14443b_setup();
+            break;
+#endif
+#if defined(WITH_ISO15693) || defined(WITH_ICLASS)
+        case MODE_HF15:
+            Iso15693InitReader();
+            break;
+#endif
+#ifdef WITH_LF
+        case MODE_LF:
+            LFSetupFPGAForADC(LF_DIVISOR_125, true);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    set_tracing(false);
+    poll_mode = mode;
+}
+
+static void poll_id_put(uint8_t *id, uint8_t *idlen, uint64_t value, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) {
+        id[len - 1 - i] = (value >> (i * 8)) & 0xFF;
+    }
+    *idlen = len;
+}
+
+// one attempt with the given protocol, true and the tag ID when one answered
+static bool poll_one(uint8_t protocol, uint8_t *id, uint8_t *idlen, bool ledcontrol) {
+    switch (protocol) {
+#ifdef WITH_ISO14443a
+        case POLL_14A: {
+            poll_set_mode(MODE_14A);
+            iso14a_card_select_t card;
+            if (iso14443a_select_card(NULL, &card, NULL, true, 0, true) != 1) {
+                return false;
+            }
+            // halted, so the WUPA of the next round selects it again without a field reset
+            mifare_classic_halt(NULL);
+            memcpy(id, card.uid, card.uidlen);
+            *idlen = card.uidlen;
+            return true;
+        }
+#endif
+#ifdef WITH_ISO14443b
+        case POLL_14B: {
+            poll_set_mode(MODE_14B);
+            iso14b_card_select_t card;
+            bool found = (iso14443b_select_card(&card) == PM3_SUCCESS);
+            // an active PICC ignores REQB, power it down for the next round
+            switch_off();
+            poll_mode = MODE_NONE;
+            if (found == false) {
+                return false;
+            }
+            memcpy(id, card.uid, card.uidlen);
+            *idlen = card.uidlen;
+            return true;
+        }
+#endif
+#ifdef WITH_ISO15693
+        case POLL_15: {
+            poll_set_mode(MODE_HF15);
+            if (Iso15693Identify(id) == false) {
+                return false;
+            }
+            *idlen = ISO15693_UID_LENGTH;
+            return true;
+        }
+#endif
+#ifdef WITH_ICLASS
+        case POLL_ICLASS: {
+            poll_set_mode(MODE_HF15);
+            picopass_hdr_t hdr;
+            uint32_t eof_time = 0;
+            if (select_iclass_tag(&hdr, false, &eof_time, false) == false) {
+                return false;
+            }
+            memcpy(id, hdr.csn, sizeof(hdr.csn));
+            *idlen = sizeof(hdr.csn);
+            return true;
+        }
+#endif
+#ifdef WITH_LF
+        case POLL_EM410X: {
+            poll_set_mode(MODE_LF);
+            uint8_t *dest = BigBuf_get_addr();
+            size_t size = MIN(16385, BigBuf_max_traceLen());
+            DoAcquisition_default(-1, false, ledcontrol);
+
+            int clk = 0, invert = 0;
+            if (askdemod(dest, &size, &clk, &invert, 20, 0, 1) > 50) {
+                return false;
+            }
+
+            size_t idx = 0;
+            uint32_t hi = 0;
+            uint64_t lo = 0;
+            int type = Em410xDecode(dest, &size, &idx, &hi, &lo);
+            if (type <= 0) {
+                return false;
+            }
+            if (type & 0x1) {
+                poll_id_put(id, idlen, lo, 5);
+            } else {
+                poll_id_put(id, idlen, hi, 3);
+                poll_id_put(id + 3, idlen, lo, 8);
+                *idlen = 11;
+            }
+            return true;
+        }
+        case POLL_HID: {
+            poll_set_mode(MODE_LF);
+            uint8_t *dest = BigBuf_get_addr();
+            size_t size = MIN(12800, BigBuf_max_traceLen());
+            DoAcquisition_default(-1, false, ledcontrol);
+
+            uint32_t hi2 = 0, hi = 0, lo = 0;
+            int dummyIdx = 0;
+            int idx = HIDdemodFSK(dest, &size, &hi2, &hi, &lo, &dummyIdx);
+            if (idx <= 0 || lo == 0 || (size != 96 && size != 192)) {
+                return false;
+            }
+            poll_id_put(id, idlen, hi2, 4);
+            poll_id_put(id + 4, idlen, hi, 4);
+            poll_id_put(id + 8, idlen, lo, 4);
+            *idlen = 12;
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+static void poll_report(uint8_t event, const poll_slot_t *slot, uint32_t start) {
+    poll_event_t e = {
+        .event = event,
+        .protocol = slot->protocol,
+        .idlen = slot->idlen,
+        .time_ms = GetTickCount() - start,
+    };
+    memcpy(e.id, slot->id, slot->idlen);
+    reply_ng(CMD_POLL, PM3_SUCCESS, (uint8_t *)&e, sizeof(e));
+}
+
+void PresencePoll(const poll_params_t *params, bool ledcontrol) {
+
+    static const uint8_t order[] = { POLL_14A, POLL_14B, POLL_15, POLL_ICLASS, POLL_EM410X, POLL_HID };
+
+    poll_slot_t slots[ARRAYLEN(order)];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < ARRAYLEN(order); i++) {
+        if (params->protocols & order[i]) {
+            memset(&slots[n], 0, sizeof(poll_slot_t));
+            slots[n++].protocol = order[i];
+        }
+    }
+
+    if (ledcontrol) LEDsoff();
+    clear_trace();
+    set_tracing(false);
+    poll_mode = MODE_NONE;
+
+    uint32_t start = GetTickCount();
+    int res = PM3_SUCCESS;
+    bool running = (n > 0);
+    while (running) {
+        for (uint8_t i = 0; i < n; i++) {
+            WDT_HIT();
+
+            if (data_available() || BUTTON_PRESS()) {
+                res = PM3_EOPABORTED;
+                running = false;
+                break;
+            }
+
+            poll_slot_t *slot = &slots[i];
+            uint8_t id[12] = {0};
+            uint8_t idlen = 0;
+            uint32_t now = GetTickCount();
+
+            if (poll_one(slot->protocol, id, &idlen, ledcontrol)) {
+                if (slot->present == false || slot->idlen != idlen || memcmp(slot->id, id, idlen) != 0) {
+                    slot->present = true;
+                    slot->idlen = idlen;
+                    memcpy(slot->id, id, idlen);
+                    if (ledcontrol) LED_B_ON();
+                    poll_report(POLL_EVENT_NEW, slot, start);
+                }
+                slot->last_seen = now;
+
+            } else if (slot->present && now - slot->last_seen > params->gone_ms) {
+                slot->present = false;
+                if (ledcontrol) LED_B_OFF();
+                poll_report(POLL_EVENT_GONE, slot, start);
+            }
+        }
+    }
+
+    switch_off();
+    BigBuf_free_keep_EM();
+    poll_mode = MODE_NONE;
+    if (ledcontrol) LEDsoff();
+    reply_ng(CMD_POLL, res, NULL, 0);
+}
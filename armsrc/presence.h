@@ -0,0 +1,28 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Presence polling, cycles through a set of protocols and reports tags coming and going
+//-----------------------------------------------------------------------------
+#ifndef __PRESENCE_H
+#define __PRESENCE_H
+
+#include "common.h"
+#include "pm3_cmd.h"
+
+// Runs until the button or a new command. Every change is sent as a CMD_POLL reply carrying
+// a poll_event_t, the last CMD_POLL reply has no data
+void PresencePoll(const poll_params_t *params, bool ledcontrol);
+
+#endif
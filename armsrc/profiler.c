@@ -0,0 +1,115 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Lightweight runtime profiler
+//-----------------------------------------------------------------------------
+#include "profiler.h"
+
+#include "proxmark3_arm.h"
+#include "cmd.h"
+#include "ticks.h"
+#include "string.h"
+
+// The table lives outside of BigBuf, standalone modes free BigBuf all the time
+static prof_stats_t s_prof;
+static const char *s_prof_names[PROF_MAX_SLOTS];
+static uint32_t s_prof_ticks[PROF_MAX_SLOTS];  // GetTicks() at prof_start()
+static uint32_t s_prof_ms[PROF_MAX_SLOTS];     // GetTickCount() at prof_start()
+static uint16_t s_prof_running = 0;            // bit per slot between start and stop
+static uint32_t s_prof_reset_ms = 0;
+
+int prof_slot(const char *name) {
+    if (name == NULL) {
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < s_prof.slots; i++) {
+        if (s_prof_names[i] == name || strncmp(s_prof.slot[i].name, name, PROF_NAME_LEN) == 0) {
+            s_prof_names[i] = name;
+            return i;
+        }
+    }
+
+    if (s_prof.slots == PROF_MAX_SLOTS) {
+        return -1;
+    }
+
+    uint8_t i = s_prof.slots++;
+    s_prof_names[i] = name;
+    memset(&s_prof.slot[i], 0, sizeof(prof_slot_t));
+    strncpy(s_prof.slot[i].name, name, PROF_NAME_LEN);
+    s_prof.slot[i].min_us = UINT32_MAX;
+    return i;
+}
+
+void prof_count(int slot, uint32_t n) {
+    if (slot < 0 || slot >= s_prof.slots) {
+        return;
+    }
+    s_prof.slot[slot].count += n;
+}
+
+void prof_start(int slot) {
+    if (slot < 0 || slot >= s_prof.slots) {
+        return;
+    }
+    s_prof_running |= (1 << slot);
+    s_prof_ms[slot] = GetTickCount();
+    s_prof_ticks[slot] = GetTicks();
+}
+
+void prof_stop(int slot) {
+    if (slot < 0 || slot >= s_prof.slots || (s_prof_running & (1 << slot)) == 0) {
+        return;
+    }
+    s_prof_running &= ~(1 << slot);
+
+    uint32_t ticks = GetTicksDelta(s_prof_ticks[slot]);
+    uint32_t ms = GetTickCountDelta(s_prof_ms[slot]);
+
+    // The 1.5 MHz ticks are only right when nothing stopped or restarted them in
+    // between (StopTicks / StartTicks), check them against the slow 1 kHz RTT
+    uint32_t us = (ticks / 3) * 2;
+    uint32_t rtt_us = ms * 1000;
+    uint32_t margin = 2000 + (rtt_us >> 4);
+    if (us + margin < rtt_us || us > rtt_us + margin) {
+        us = rtt_us;
+    }
+
+    prof_slot_t *p = &s_prof.slot[slot];
+    p->calls++;
+    p->total_us += us;
+    if (us < p->min_us) {
+        p->min_us = us;
+    }
+    if (us > p->max_us) {
+        p->max_us = us;
+    }
+}
+
+void prof_reset(void) {
+    memset(&s_prof, 0, sizeof(s_prof));
+    memset(s_prof_names, 0, sizeof(s_prof_names));
+    s_prof_running = 0;
+    s_prof_reset_ms = GetTickCount();
+}
+
+void prof_send(bool reset) {
+    s_prof.uptime_ms = GetTickCountDelta(s_prof_reset_ms);
+    reply_ng(CMD_PROFILE, PM3_SUCCESS, (uint8_t *)&s_prof, sizeof(s_prof));
+    if (reset) {
+        prof_reset();
+    }
+}
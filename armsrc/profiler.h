@@ -0,0 +1,41 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Lightweight runtime profiler, named counters and timers read with `hw profile`
+//
+//    int brute = prof_slot("brute");
+//    while (...) {
+//        prof_start(brute);
+//        ...
+//        prof_stop(brute);
+//        prof_count(prof_slot("cards"), 1);
+//    }
+//-----------------------------------------------------------------------------
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include "common.h"
+
+// slot of the name, a new one is taken on first use. -1 when all slots are in use,
+// the other calls ignore it. Names are compared by pointer first, use string literals
+int prof_slot(const char *name);
+void prof_count(int slot, uint32_t n);
+void prof_start(int slot);
+void prof_stop(int slot);
+
+void prof_reset(void);
+void prof_send(bool reset);
+
+#endif
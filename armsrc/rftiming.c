@@ -0,0 +1,184 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// RF exchange timing as reader
+//-----------------------------------------------------------------------------
+#include "rftiming.h"
+
+#include "proxmark3_arm.h"
+#include "cmd.h"
+#include "ticks.h"
+#include "string.h"
+
+// one second, longer gaps are a new session or the clock restarted with the field
+#define RFT_MAX_GAP_FC          13560000
+// answers seen before a learned window is trusted, and its margin on top of twice
+// the slowest answer (~75us, a few bit periods of any of the protocols)
+#define RFT_LEARN_ANSWERS       8
+#define RFT_LEARN_MARGIN_FC     1024
+
+typedef struct {
+    uint32_t frame_end_fc;
+    uint32_t answer_end_fc;
+    bool waiting;               // a frame was sent and its answer is pending
+    bool answered;              // answer_end_fc is valid for the next turnaround
+} rft_state_t;
+
+typedef struct {
+    bool active;
+    uint16_t answers;
+    uint32_t max_latency_fc;
+} rft_learn_t;
+
+// Like the profiler this lives outside of BigBuf, which most commands free or overwrite
+static rft_stats_t s_rft[RFT_PROTOCOLS];
+static rft_state_t s_rft_state[RFT_PROTOCOLS];
+static uint32_t s_rft_reset_ms = 0;
+// not touched by rft_reset(), a `hw status -r` must not disturb a running key check
+static rft_learn_t s_rft_learn[RFT_PROTOCOLS];
+
+static uint32_t rft_fc_to_us(uint32_t fc) {
+    // 1 / 13.56 ~ 151 / 2048
+    return (uint32_t)(((uint64_t)fc * 151) >> 11);
+}
+
+static uint8_t rft_bucket(uint32_t us) {
+    if (us < 16) {
+        return 0;
+    }
+    uint8_t msb = 31 - __builtin_clz(us);
+    uint8_t b = 2 * (msb - 4) + ((us >> (msb - 1)) & 1);
+    return MIN(b, RFT_BUCKETS - 1);
+}
+
+void rft_frame(uint8_t protocol, uint32_t start_fc, uint32_t end_fc) {
+    if (protocol >= RFT_PROTOCOLS) {
+        return;
+    }
+    rft_stats_t *s = &s_rft[protocol];
+    rft_state_t *st = &s_rft_state[protocol];
+
+    s->frames++;
+
+    // the clock restarts with the field, a negative gap wraps to a huge one
+    uint32_t gap = start_fc - st->answer_end_fc;
+    if (st->answered && gap < RFT_MAX_GAP_FC) {
+        uint32_t us = rft_fc_to_us(gap);
+        s->turnarounds++;
+        s->turnaround_total_us += us;
+        s->turnaround[rft_bucket(us)]++;
+    }
+
+    st->frame_end_fc = end_fc;
+    st->waiting = true;
+    st->answered = false;
+}
+
+void rft_answer(uint8_t protocol, uint32_t start_fc, uint32_t end_fc) {
+    if (protocol >= RFT_PROTOCOLS) {
+        return;
+    }
+    rft_stats_t *s = &s_rft[protocol];
+    rft_state_t *st = &s_rft_state[protocol];
+
+    st->answer_end_fc = end_fc;
+    st->answered = true;
+
+    // more frames of the same answer, or nothing sent by us before
+    if (st->waiting == false) {
+        return;
+    }
+    st->waiting = false;
+
+    s->answers++;
+    uint32_t latency = start_fc - st->frame_end_fc;
+    if (latency >= RFT_MAX_GAP_FC) {
+        return;
+    }
+
+    // keeps learning after the window is trusted, it only ever grows
+    rft_learn_t *l = &s_rft_learn[protocol];
+    if (l->active) {
+        if (l->answers < 0xFFFF) {
+            l->answers++;
+        }
+        l->max_latency_fc = MAX(l->max_latency_fc, latency);
+    }
+
+    uint32_t us = rft_fc_to_us(latency);
+    if (s->answers == 1 || us < s->latency_min_us) {
+        s->latency_min_us = us;
+    }
+    if (us > s->latency_max_us) {
+        s->latency_max_us = us;
+    }
+    s->latency_total_us += us;
+    s->latency[rft_bucket(us)]++;
+}
+
+void rft_timeout(uint8_t protocol) {
+    if (protocol >= RFT_PROTOCOLS) {
+        return;
+    }
+    rft_state_t *st = &s_rft_state[protocol];
+    if (st->waiting) {
+        st->waiting = false;
+        s_rft[protocol].timeouts++;
+    }
+}
+
+void rft_learn_start(uint8_t protocol) {
+    if (protocol >= RFT_PROTOCOLS) {
+        return;
+    }
+    s_rft_learn[protocol].active = true;
+    s_rft_learn[protocol].answers = 0;
+    s_rft_learn[protocol].max_latency_fc = 0;
+}
+
+// Answer window for the tag in the field in carrier cycles, 0 while it is still unknown
+uint32_t rft_learned_window_fc(uint8_t protocol) {
+    if (protocol >= RFT_PROTOCOLS) {
+        return 0;
+    }
+    const rft_learn_t *l = &s_rft_learn[protocol];
+    if (l->active == false || l->answers < RFT_LEARN_ANSWERS) {
+        return 0;
+    }
+    return 2 * l->max_latency_fc + RFT_LEARN_MARGIN_FC;
+}
+
+void rft_reset(void) {
+    memset(s_rft, 0, sizeof(s_rft));
+    memset(s_rft_state, 0, sizeof(s_rft_state));
+    s_rft_reset_ms = GetTickCount();
+}
+
+void rft_send(const rft_request_t *req) {
+    if (req->protocol >= RFT_PROTOCOLS) {
+        reply_ng(CMD_RF_TIMING, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    rft_reply_t r;
+    r.uptime_ms = GetTickCountDelta(s_rft_reset_ms);
+    r.protocol = req->protocol;
+    memcpy(&r.stats, &s_rft[req->protocol], sizeof(rft_stats_t));
+    reply_ng(CMD_RF_TIMING, PM3_SUCCESS, (uint8_t *)&r, sizeof(r));
+
+    if (req->reset) {
+        rft_reset();
+    }
+}
@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// RF exchange timing as reader, read with `hw status`
+//
+// The protocol code reports each reader frame and each tag answer or timeout, with
+// times in carrier cycles (1/fc, 13.56 MHz) taken from GetCountSspClk(). Per protocol
+// it keeps histograms of the tag answer latency and of our turnaround after an answer.
+// It also learns the slowest answer of the tag in the field, for adaptive answer windows.
+//-----------------------------------------------------------------------------
+#ifndef __RFTIMING_H
+#define __RFTIMING_H
+
+#include "common.h"
+#include "pm3_cmd.h"
+
+void rft_frame(uint8_t protocol, uint32_t start_fc, uint32_t end_fc);
+void rft_answer(uint8_t protocol, uint32_t start_fc, uint32_t end_fc);
+void rft_timeout(uint8_t protocol);
+
+void rft_learn_start(uint8_t protocol);
+uint32_t rft_learned_window_fc(uint8_t protocol);
+
+void rft_reset(void);
+void rft_send(const rft_request_t *req);
+
+#endif
@@ -30,6 +30,7 @@
 #include "protocols.h"
 #include "optimized_cipher.h"
 #include "fpgaloader.h"
+#include "util.h"
 #include "pm3_cmd.h"
 
 /**
@@ -335,6 +336,61 @@ out:
 }
 
 
+/**
+ * @brief Continuous reader mode, streams the PACS of every card presented.
+ *
+ * The SAM session stays open between cards, so each card only costs its own
+ * CardDetected and RequestPACS exchanges. The field stays on, a card is read
+ * again only once it has left the field or another CSN shows up.
+ * Every card gets a CMD_HF_SAM_PICOPASS reply, PM3_EOPABORTED closes the stream.
+ * Runs until the button is pressed or the client sends a command.
+ */
+static int sam_picopass_stream_pacs(const uint8_t *cmd, uint16_t cmd_len, bool shallow_mod, bool break_on_nr_mac, bool prevent_epurse_update) {
+    uint8_t sam_response[ISO7816_MAX_FRAME] = { 0x00 };
+    uint8_t last_csn[PICOPASS_BLOCK_SIZE] = { 0x00 };
+    bool present = false;
+
+    // implicit StartSspClk() happens here
+    Iso15693InitReader();
+    set_tracing(false);
+
+    for (;;) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            break;
+        }
+
+        StartCountSspClk();
+
+        picopass_hdr_t card_a_info;
+        uint32_t eof_time = 0;
+        if (select_iclass_tag(&card_a_info, false, &eof_time, shallow_mod) == false) {
+            present = false;
+            continue;
+        }
+
+        if (present && memcmp(last_csn, card_a_info.csn, sizeof(last_csn)) == 0) {
+            continue;
+        }
+        memcpy(last_csn, card_a_info.csn, sizeof(last_csn));
+        present = true;
+
+        switch_clock_to_ticks();
+        sam_set_card_detected_picopass(&card_a_info);
+
+        uint8_t sam_response_len = 0;
+        if (sam_send_request_iso15(cmd, cmd_len, sam_response, &sam_response_len, shallow_mod, break_on_nr_mac, prevent_epurse_update) == PM3_SUCCESS) {
+            reply_ng(CMD_HF_SAM_PICOPASS, PM3_SUCCESS, sam_response, sam_response_len);
+        } else {
+            reply_ng(CMD_HF_SAM_PICOPASS, PM3_ENOPACS, NULL, 0);
+        }
+    }
+
+    switch_off();
+    reply_ng(CMD_HF_SAM_PICOPASS, PM3_EOPABORTED, NULL, 0);
+    return PM3_SUCCESS;
+}
+
 /**
  * @brief Retrieves PACS data from PICOPASS card using SAM.
  *
@@ -352,6 +408,7 @@ int sam_picopass_get_pacs(PacketCommandNG *c) {
     const bool preventEpurseUpdate = !!(flags & BITMASK(3));
     const bool shallow_mod = !!(flags & BITMASK(4));
     const bool info = !!(flags & BITMASK(5));
+    const bool continuous = !!(flags & BITMASK(6));
 
     uint8_t *cmd = c->data.asBytes + 1;
     uint16_t cmd_len = c->length - 1;
@@ -374,6 +431,11 @@ int sam_picopass_get_pacs(PacketCommandNG *c) {
         goto out;
     }
 
+    if (continuous) {
+        res = sam_picopass_stream_pacs(cmd, cmd_len, shallow_mod, breakOnNrMac, preventEpurseUpdate);
+        goto off;
+    }
+
     if (skipDetect == false) {
         // step 2: get card information
         picopass_hdr_t card_a_info;
@@ -35,6 +35,7 @@
 #include "protocols.h"
 #include "optimized_cipher.h"
 #include "fpgaloader.h"
+#include "util.h"
 #include "pm3_cmd.h"
 
 #include "cmd.h"
@@ -255,6 +256,56 @@ out:
     return res;
 }
 
+/**
+ * @brief Continuous reader mode, streams the PACS of every card presented.
+ *
+ * The SAM session stays open between cards, so each card only costs its own
+ * CardDetected and RequestPACS exchanges. A card read once is deselected and
+ * halts, it doesn't answer REQA again until it has left the field.
+ * Every card gets a CMD_HF_SAM_SEOS reply, PM3_EOPABORTED closes the stream.
+ * Runs until the button is pressed or the client sends a command.
+ */
+static int sam_seos_stream_pacs(const uint8_t *cmd, uint16_t cmd_len) {
+    static const uint8_t deselect_cmd[] = {0xc2, 0xe0, 0xb4};
+    uint8_t sam_response[ISO7816_MAX_FRAME] = { 0x00 };
+    uint8_t answer[MAX_FRAME_SIZE] = { 0x00 };
+    uint8_t par[MAX_PARITY_SIZE] = { 0x00 };
+
+    set_tracing(false);
+
+    for (;;) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            break;
+        }
+
+        // implicit StartSspClk() happens here, the field stays on
+        iso14a_card_select_t card_a_info;
+        iso14443a_setup(FPGA_HF_ISO14443A_READER_MOD);
+        if (iso14443a_select_cardEx(NULL, &card_a_info, NULL, true, 0, false, &REQA_POLLING_PARAMETERS, false) == 0) {
+            continue;
+        }
+
+        switch_clock_to_ticks();
+        sam_set_card_detected_seos(&card_a_info);
+
+        uint8_t sam_response_len = 0;
+        if (sam_send_request_iso14a(cmd, cmd_len, sam_response, &sam_response_len) == PM3_SUCCESS) {
+            reply_ng(CMD_HF_SAM_SEOS, PM3_SUCCESS, sam_response, sam_response_len);
+        } else {
+            reply_ng(CMD_HF_SAM_SEOS, PM3_ENOPACS, NULL, 0);
+        }
+
+        switch_clock_to_countsspclk();
+        ReaderTransmit(deselect_cmd, sizeof(deselect_cmd), NULL);
+        ReaderReceive(answer, sizeof(answer), par);
+    }
+
+    switch_off();
+    reply_ng(CMD_HF_SAM_SEOS, PM3_EOPABORTED, NULL, 0);
+    return PM3_SUCCESS;
+}
+
 /**
  * @brief Retrieves PACS data from SEOS card using SAM.
  *
@@ -268,6 +319,7 @@ int sam_seos_get_pacs(PacketCommandNG *c) {
     const uint8_t flags = c->data.asBytes[0];
     const bool disconnectAfter = !!(flags & BITMASK(0));
     const bool skipDetect = !!(flags & BITMASK(1));
+    const bool continuous = !!(flags & BITMASK(2));
 
     uint8_t *cmd = c->data.asBytes + 1;
     uint16_t cmd_len = c->length - 1;
@@ -284,6 +336,11 @@ int sam_seos_get_pacs(PacketCommandNG *c) {
     // step 1: ping SAM
     sam_get_version(false);
 
+    if (continuous) {
+        res = sam_seos_stream_pacs(cmd, cmd_len);
+        goto off;
+    }
+
     if (skipDetect == false) {
         // step 2: get card information
         iso14a_card_select_t card_a_info;
@@ -600,6 +600,76 @@ int rdv40_spiffs_read_as_filetype(const char *filename, uint8_t *dst, uint32_t s
     )
 }
 
+// A session keeps SPIFFS mounted over several calls. SAFE level calls inside it find
+// the FS mounted and leave it so, which saves the mount scan of every call and keeps
+// the page cache of the mount (RDV40_SPIFFS_CACHE_SZ, least recently used page out)
+// warm between them. Sessions nest, the outermost end unmounts if its begin mounted.
+static uint8_t s_session_depth = 0;
+static int s_session_changed = 0;
+
+void rdv40_spiffs_session_begin(void) {
+    if (s_session_depth++ == 0) {
+        s_session_changed = rdv40_spiffs_lazy_mount();
+    }
+}
+
+void rdv40_spiffs_session_end(void) {
+    if (s_session_depth == 0) {
+        return;
+    }
+    if (--s_session_depth == 0 && s_session_changed) {
+        rdv40_spiffs_lazy_unmount();
+        s_session_changed = 0;
+    }
+}
+
+// Sequential reads of a file or symlink, in chunks of any size, so a file does not
+// have to fit in BigBuf. The reader holds a session until it is closed
+int rdv40_spiffs_reader_open(rdv40_spiffs_reader_t *r, const char *filename) {
+    rdv40_spiffs_session_begin();
+
+    char name[SPIFFS_OBJ_NAME_LEN] = {0};
+    if (filetype_in_spiffs(filename) == RDV40_SPIFFS_FILETYPE_SYMLINK) {
+        char linkfilename[SPIFFS_OBJ_NAME_LEN];
+        sprintf(linkfilename, "%s.lnk", filename);
+        read_from_spiffs(linkfilename, (uint8_t *)name, SPIFFS_OBJ_NAME_LEN);
+        name[SPIFFS_OBJ_NAME_LEN - 1] = 0;
+    } else {
+        strncpy(name, filename, SPIFFS_OBJ_NAME_LEN - 1);
+    }
+
+    r->fd = SPIFFS_open(&fs, name, SPIFFS_RDONLY, 0);
+    spiffs_stat st;
+    if (r->fd < 0 || SPIFFS_fstat(&fs, r->fd, &st) < 0) {
+        int res = SPIFFS_errno(&fs);
+        if (r->fd >= 0) {
+            SPIFFS_close(&fs, r->fd);
+        }
+        r->fd = -1;
+        rdv40_spiffs_session_end();
+        return (res) ? res : SPIFFS_ERR_NOT_FOUND;
+    }
+    r->size = st.size;
+    return SPIFFS_OK;
+}
+
+// bytes read, 0 at the end of the file, < 0 on errors
+int32_t rdv40_spiffs_reader_next(rdv40_spiffs_reader_t *r, uint8_t *dst, uint32_t len) {
+    if (r->fd < 0) {
+        return SPIFFS_ERR_FILE_CLOSED;
+    }
+    return SPIFFS_read(&fs, r->fd, dst, len);
+}
+
+void rdv40_spiffs_reader_close(rdv40_spiffs_reader_t *r) {
+    if (r->fd < 0) {
+        return;
+    }
+    SPIFFS_close(&fs, r->fd);
+    r->fd = -1;
+    rdv40_spiffs_session_end();
+}
+
 // TODO regarding reads/write and symlinks :
 // Provide a higher level readFile function which
 //   - don't need a size to be provided, getting it from STAT call and using bigbuff malloc
@@ -46,8 +46,19 @@ typedef struct rdv40_spiffs_fsinfo {
     uint32_t usedPercent, freePercent;
 } rdv40_spiffs_fsinfo;
 
+typedef struct {
+    int16_t fd;
+    uint32_t size;
+} rdv40_spiffs_reader_t;
+
 int rdv40_spiffs_read_as_filetype(const char *filename, uint8_t *dst, uint32_t size, RDV40SpiFFSSafetyLevel level);
 
+void rdv40_spiffs_session_begin(void);
+void rdv40_spiffs_session_end(void);
+int rdv40_spiffs_reader_open(rdv40_spiffs_reader_t *r, const char *filename);
+int32_t rdv40_spiffs_reader_next(rdv40_spiffs_reader_t *r, uint8_t *dst, uint32_t len);
+void rdv40_spiffs_reader_close(rdv40_spiffs_reader_t *r);
+
 int rdv40_spiffs_check(void);
 int rdv40_spiffs_lazy_unmount(void);
 int rdv40_spiffs_lazy_mount(void);
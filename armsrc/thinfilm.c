@@ -27,6 +27,9 @@
 #include "ticks.h"
 #include "dbprint.h"
 #include "util.h"
+#include "string.h"
+#include "crc16.h"
+#include "mifare.h"
 
 /**
   * ref
@@ -54,6 +57,72 @@ void ReadThinFilm(void) {
     BigBuf_free();
 }
 
+// Keeps the field on and reports every barcode once, with the time it was first seen.
+// Thinfilm tags repeat their barcode for as long as they are powered, so nothing needs to be sent.
+void ThinfilmReader(const hf_tagstream_t *p) {
+
+    clear_trace();
+    set_tracing(false);
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    BigBuf_free();
+    seen_tag_t *seen = (seen_tag_t *)BigBuf_calloc(SEEN_TAGS_MAX * sizeof(seen_tag_t));
+    uint8_t *buf = BigBuf_calloc(36);
+    if (seen == NULL || buf == NULL) {
+        reply_ng(CMD_HF_THINFILM_READER, PM3_EMALLOC, NULL, 0);
+        hf_field_off();
+        return;
+    }
+
+    int res = PM3_SUCCESS;
+    uint32_t t0 = GetTickCount();
+
+    for (;;) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        uint32_t now = GetTickCountDelta(t0);
+        if (p->duration && now > p->duration) {
+            break;
+        }
+
+        uint8_t len = 0;
+        if (GetIso14443aAnswerFromTag_Thinfilm(buf, 36, &len) == false) {
+            continue;
+        }
+
+        if (len != 16 && len != 32) {
+            continue;
+        }
+
+        // crc is stored msb first
+        uint8_t b1 = 0, b2 = 0;
+        compute_crc(CRC_14443_A, buf, len - 2, &b1, &b2);
+        if (buf[len - 1] != b1 || buf[len - 2] != b2) {
+            continue;
+        }
+
+        if (seen_tag_is_new(seen, buf, len, now, p->holdoff) == false) {
+            continue;
+        }
+
+        hf_tagstream_entry_t e = {
+            .ms = now,
+            .len = len,
+        };
+        memcpy(e.data, buf, len);
+        reply_ng(CMD_HF_THINFILM_READER, PM3_SUCCESS, (uint8_t *)&e, sizeof(e));
+    }
+
+    reply_ng(CMD_HF_THINFILM_READER, res, NULL, 0);
+    hf_field_off();
+    BigBuf_free();
+}
+
 #define SEC_D 0xf0
 #define SEC_E 0x0f
 #define SEC_F 0x00
@@ -20,8 +20,10 @@
 #define __THINFILM_H
 
 #include "common.h"
+#include "mifare.h"
 
 void ReadThinFilm(void);
+void ThinfilmReader(const hf_tagstream_t *p);
 void SimulateThinFilm(uint8_t *data, size_t len);
 
 #endif /* __ISO14443A_H */
@@ -415,3 +415,36 @@ void convertToHexArray(uint32_t num, uint8_t *partialkey) {
         partialkey[i] = (uint8_t)strtoul(group, NULL, 2);
     }
 }
+
+// A tag is new when it isn't in the table, or wasn't seen for holdoff ms.
+// When the table is full the entry seen longest ago is reused.
+bool seen_tag_is_new(seen_tag_t *tags, const uint8_t *id, uint8_t len, uint32_t now, uint32_t holdoff) {
+
+    len = MIN(len, sizeof(tags[0].id));
+
+    uint8_t oldest = 0;
+    for (uint8_t i = 0; i < SEEN_TAGS_MAX; i++) {
+        seen_tag_t *t = &tags[i];
+
+        if (t->len == len && memcmp(t->id, id, len) == 0) {
+            bool is_new = (now - t->last) > holdoff;
+            t->last = now;
+            return is_new;
+        }
+
+        if (t->len == 0) {
+            oldest = i;
+            break;
+        }
+
+        if (t->last < tags[oldest].last) {
+            oldest = i;
+        }
+    }
+
+    seen_tag_t *t = &tags[oldest];
+    t->len = len;
+    t->last = now;
+    memcpy(t->id, id, len);
+    return true;
+}
@@ -105,4 +105,14 @@ bool data_available_fast(void);
 uint32_t flash_size_from_cidr(uint32_t cidr);
 uint32_t get_flash_size(void);
 
+// recently seen tag ids, for reader loops reporting every tag once
+#define SEEN_TAGS_MAX   32
+typedef struct {
+    uint32_t last;      // ms
+    uint8_t len;
+    uint8_t id[32];
+} seen_tag_t;
+
+bool seen_tag_is_new(seen_tag_t *tags, const uint8_t *id, uint8_t len, uint32_t now, uint32_t holdoff);
+
 #endif
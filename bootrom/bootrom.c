@@ -19,6 +19,7 @@
 
 #include "clocks.h"
 #include "usb_cdc.h"
+#include "crc32.h"
 
 #ifdef WITH_FLASH
 #include "flashmem.h"
@@ -137,7 +138,9 @@ static void UsbPacketReceived(uint8_t *packet) {
                    DEVICE_INFO_FLAG_UNDERSTANDS_START_FLASH |
                    DEVICE_INFO_FLAG_UNDERSTANDS_CHIP_INFO |
                    DEVICE_INFO_FLAG_UNDERSTANDS_VERSION |
-                   DEVICE_INFO_FLAG_UNDERSTANDS_READ_MEM;
+                   DEVICE_INFO_FLAG_UNDERSTANDS_READ_MEM |
+                   DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC |
+                   DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC_REGION;
 
             if (g_common_area.flags.osimage_present) {
                 arg0 |= DEVICE_INFO_FLAG_OSIMAGE_PRESENT;
@@ -212,6 +215,59 @@ static void UsbPacketReceived(uint8_t *packet) {
             break;
         }
 
+        case CMD_FLASH_CRC: {
+            // CRC32 of each flash block, lets the flasher skip blocks that are already up to date
+            ack = false;
+            LED_B_ON();
+
+            uint32_t address = arg0;
+            uint32_t blocks = (uint32_t) c->arg[1];
+
+            // one CRC32 over a whole written region, verifies an image in a single round trip
+            if (((uint32_t) c->arg[2] & FLASH_CRC_FLAG_REGION) == FLASH_CRC_FLAG_REGION) {
+                uint32_t length = blocks;
+                uint32_t crc = 0;
+                bool isok = (address >= (uint32_t)_flash_start) &&
+                            (address < (uint32_t)_flash_end) &&
+                            (length <= (uint32_t)_flash_end - address);
+                if (isok) {
+                    crc32_ex((uint8_t *)address, length, (uint8_t *)&crc);
+                    isok = 0 == reply_old(CMD_FLASH_CRC, 0, 1, 0, &crc, sizeof(crc));
+                }
+
+                if (isok)
+                    reply_old(CMD_ACK, 1, 0, 0, 0, 0);
+                else
+                    reply_old(CMD_NACK, 0, 0, 0, 0, 0);
+
+                LED_B_OFF();
+                break;
+            }
+
+            const uint32_t per_frame = PM3_CMD_DATA_SIZE / sizeof(uint32_t);
+            uint32_t crcs[PM3_CMD_DATA_SIZE / sizeof(uint32_t)];
+
+            bool isok = (address >= (uint32_t)_flash_start) &&
+                        (address < (uint32_t)_flash_end) &&
+                        (blocks <= ((uint32_t)_flash_end - address) / FLASH_CRC_BLOCK_SIZE);
+
+            for (uint32_t pos = 0; isok && pos < blocks; pos += per_frame) {
+                uint32_t n = MIN(blocks - pos, per_frame);
+                for (uint32_t i = 0; i < n; i++) {
+                    crc32_ex((uint8_t *)(address + (pos + i) * FLASH_CRC_BLOCK_SIZE), FLASH_CRC_BLOCK_SIZE, (uint8_t *)&crcs[i]);
+                }
+                isok = 0 == reply_old(CMD_FLASH_CRC, pos, n, 0, crcs, n * sizeof(uint32_t));
+            }
+
+            if (isok)
+                reply_old(CMD_ACK, 1, 0, 0, 0, 0);
+            else
+                reply_old(CMD_NACK, 0, 0, 0, 0, 0);
+
+            LED_B_OFF();
+            break;
+        }
+
         case CMD_FINISH_WRITE: {
 #if defined ICOPYX
             if (c->arg[1] == 0xff && c->arg[2] == 0x1fd) {
@@ -340,6 +396,11 @@ static void flash_mode(void) {
         }
 
         bool button_state = BUTTON_PRESS();
+        // nothing changed, don't spend the debounce time between two usb packets
+        if (button_state == g_common_area.flags.button_pressed) {
+            continue;
+        }
+
         // ~10ms, prevent jitter
         delay_loop(3333);
         if (button_state != BUTTON_PRESS()) {
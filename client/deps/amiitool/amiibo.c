@@ -148,8 +148,17 @@ void nfc3d_amiibo_pack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *pla
     nfc3d_amiibo_internal_to_tag(cipher, tag);
 }
 
+// the key file is read once per session
+static nfc3d_amiibo_keys_t g_amiibo_keys;
+static bool g_amiibo_keys_loaded = false;
+
 bool nfc3d_amiibo_load_keys(nfc3d_amiibo_keys_t *amiiboKeys) {
 
+    if (g_amiibo_keys_loaded) {
+        memcpy(amiiboKeys, &g_amiibo_keys, sizeof(*amiiboKeys));
+        return true;
+    }
+
     uint8_t *dump = NULL;
     size_t bytes_read = 0;
     if (loadFile_safe(AMIBOO_KEY_FN, "", (void **)&dump, &bytes_read) != PM3_SUCCESS) {
@@ -168,9 +177,21 @@ bool nfc3d_amiibo_load_keys(nfc3d_amiibo_keys_t *amiiboKeys) {
         return false;
     }
 
+    memcpy(&g_amiibo_keys, amiiboKeys, sizeof(g_amiibo_keys));
+    g_amiibo_keys_loaded = true;
     return true;
 }
 
+void nfc3d_amiibo_set_uid(uint8_t *plain, const uint8_t *uid) {
+    // UID0-2, BCC0, UID3-6 as on the tag, BCC1 leads the internal layout
+    plain[0x1D4] = uid[0];
+    plain[0x1D5] = uid[1];
+    plain[0x1D6] = uid[2];
+    plain[0x1D7] = 0x88 ^ uid[0] ^ uid[1] ^ uid[2];
+    memcpy(plain + 0x1D8, uid + 3, 4);
+    plain[0x000] = uid[3] ^ uid[4] ^ uid[5] ^ uid[6];
+}
+
 void nfc3d_amiibo_copy_app_data(const uint8_t *src, uint8_t *dst) {
 
 
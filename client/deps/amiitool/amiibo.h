@@ -27,5 +27,6 @@ bool nfc3d_amiibo_unpack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *t
 void nfc3d_amiibo_pack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *plain, uint8_t *tag);
 bool nfc3d_amiibo_load_keys(nfc3d_amiibo_keys_t *amiiboKeys);
 void nfc3d_amiibo_copy_app_data(const uint8_t *src, uint8_t *dst);
+void nfc3d_amiibo_set_uid(uint8_t *plain, const uint8_t *uid);
 
 #endif
@@ -60,6 +60,9 @@ THE SOFTWARE.
 #include "crapto1/crapto1.h"
 #include "parity.h"
 #include "ui.h"             // PrintAndLogEx
+#if defined(HAVE_OPENCL)
+#include "hardnested_bf_opencl.h"
+#endif
 //#include "common.h"
 
 // bitslice type
@@ -137,6 +140,7 @@ crack_states_bitsliced_t crack_states_bitsliced_SSE2;
 crack_states_bitsliced_t crack_states_bitsliced_MMX;
 crack_states_bitsliced_t crack_states_bitsliced_NEON;
 crack_states_bitsliced_t crack_states_bitsliced_NOSIMD;
+crack_states_bitsliced_t crack_states_bitsliced_OPENCL;
 crack_states_bitsliced_t crack_states_bitsliced_dispatch;
 
 typedef void bitslice_test_nonces_t(uint32_t, const uint32_t *, const uint8_t *);
@@ -147,6 +151,7 @@ bitslice_test_nonces_t bitslice_test_nonces_SSE2;
 bitslice_test_nonces_t bitslice_test_nonces_MMX;
 bitslice_test_nonces_t bitslice_test_nonces_NEON;
 bitslice_test_nonces_t bitslice_test_nonces_NOSIMD;
+bitslice_test_nonces_t bitslice_test_nonces_OPENCL;
 bitslice_test_nonces_t bitslice_test_nonces_dispatch;
 
 #if defined (_WIN32)
@@ -567,6 +572,13 @@ static SIMDExecInstr intSIMDInstr = SIMD_AUTO;
 void SetSIMDInstr(SIMDExecInstr instr) {
     intSIMDInstr = instr;
 
+#if defined(HAVE_OPENCL)
+    if (instr == SIMD_OPENCL && hardnested_opencl_init() == false) {
+        PrintAndLogEx(WARNING, "No usable OpenCL device found, using the CPU");
+        intSIMDInstr = SIMD_AUTO;
+    }
+#endif
+
     crack_states_bitsliced_function_p = &crack_states_bitsliced_dispatch;
     bitslice_test_nonces_function_p = &bitslice_test_nonces_dispatch;
 }
@@ -612,77 +624,109 @@ SIMDExecInstr GetSIMDInstrAuto(void) {
     return instr;
 }
 
-// determine the available instruction set at runtime and call the correct function
-uint64_t crack_states_bitsliced_dispatch(uint32_t cuid, uint8_t *best_first_bytes, statelist_t *p,
-                                         uint32_t *keys_found, uint64_t *num_keys_tested,
-                                         uint32_t nonces_to_bruteforce, const uint8_t *bf_test_nonce_2nd_byte,
-                                         noncelist_t *nonces) {
-    switch (GetSIMDInstrAuto()) {
+SIMDExecInstr GetSIMDInstrCPU(void) {
+    SIMDExecInstr instr = GetSIMDInstrAuto();
+#if defined(HAVE_OPENCL)
+    if (instr == SIMD_OPENCL)
+        return GetSIMDInstr();
+#endif
+    return instr;
+}
+
+static crack_states_bitsliced_t *crack_states_bitsliced_select(SIMDExecInstr instr) {
+    switch (instr) {
 #if defined(COMPILER_HAS_SIMD_AVX512)
         case SIMD_AVX512:
-            crack_states_bitsliced_function_p = &crack_states_bitsliced_AVX512;
-            break;
+            return &crack_states_bitsliced_AVX512;
 #endif
 #if defined(COMPILER_HAS_SIMD_X86)
         case SIMD_AVX2:
-            crack_states_bitsliced_function_p = &crack_states_bitsliced_AVX2;
-            break;
+            return &crack_states_bitsliced_AVX2;
         case SIMD_AVX:
-            crack_states_bitsliced_function_p = &crack_states_bitsliced_AVX;
-            break;
+            return &crack_states_bitsliced_AVX;
         case SIMD_SSE2:
-            crack_states_bitsliced_function_p = &crack_states_bitsliced_SSE2;
-            break;
+            return &crack_states_bitsliced_SSE2;
         case SIMD_MMX:
-            crack_states_bitsliced_function_p = &crack_states_bitsliced_MMX;
-            break;
+            return &crack_states_bitsliced_MMX;
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
         case SIMD_NEON:
-            crack_states_bitsliced_function_p = &crack_states_bitsliced_NEON;
-            break;
+            return &crack_states_bitsliced_NEON;
+#endif
+#if defined(HAVE_OPENCL)
+        case SIMD_OPENCL:
+            return &crack_states_bitsliced_OPENCL;
 #endif
         case SIMD_AUTO:
         case SIMD_NONE:
-            crack_states_bitsliced_function_p = &crack_states_bitsliced_NOSIMD;
             break;
     }
-
-    // call the most optimized function for this CPU
-    return (*crack_states_bitsliced_function_p)(cuid, best_first_bytes, p, keys_found, num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, nonces);
+    return &crack_states_bitsliced_NOSIMD;
 }
 
-void bitslice_test_nonces_dispatch(uint32_t nonces_to_bruteforce, const uint32_t *bf_test_nonce, const uint8_t *bf_test_nonce_par) {
-    switch (GetSIMDInstrAuto()) {
+static bitslice_test_nonces_t *bitslice_test_nonces_select(SIMDExecInstr instr) {
+    switch (instr) {
 #if defined(COMPILER_HAS_SIMD_AVX512)
         case SIMD_AVX512:
-            bitslice_test_nonces_function_p = &bitslice_test_nonces_AVX512;
-            break;
+            return &bitslice_test_nonces_AVX512;
 #endif
 #if defined(COMPILER_HAS_SIMD_X86)
         case SIMD_AVX2:
-            bitslice_test_nonces_function_p = &bitslice_test_nonces_AVX2;
-            break;
+            return &bitslice_test_nonces_AVX2;
         case SIMD_AVX:
-            bitslice_test_nonces_function_p = &bitslice_test_nonces_AVX;
-            break;
+            return &bitslice_test_nonces_AVX;
         case SIMD_SSE2:
-            bitslice_test_nonces_function_p = &bitslice_test_nonces_SSE2;
-            break;
+            return &bitslice_test_nonces_SSE2;
         case SIMD_MMX:
-            bitslice_test_nonces_function_p = &bitslice_test_nonces_MMX;
-            break;
+            return &bitslice_test_nonces_MMX;
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
         case SIMD_NEON:
-            bitslice_test_nonces_function_p = &bitslice_test_nonces_NEON;
-            break;
+            return &bitslice_test_nonces_NEON;
+#endif
+#if defined(HAVE_OPENCL)
+        case SIMD_OPENCL:
+            return &bitslice_test_nonces_OPENCL;
 #endif
         case SIMD_AUTO:
         case SIMD_NONE:
-            bitslice_test_nonces_function_p = &bitslice_test_nonces_NOSIMD;
             break;
     }
+    return &bitslice_test_nonces_NOSIMD;
+}
+
+#if defined(HAVE_OPENCL)
+// the CPU core stays ready for buckets the device fails on
+uint64_t crack_states_bitsliced_OPENCL(uint32_t cuid, uint8_t *best_first_bytes, statelist_t *p,
+                                       uint32_t *keys_found, uint64_t *num_keys_tested,
+                                       uint32_t nonces_to_bruteforce, const uint8_t *bf_test_nonce_2nd_byte,
+                                       noncelist_t *nonces) {
+    uint64_t key;
+    if (hardnested_opencl_crack(cuid, best_first_bytes, p, keys_found, num_keys_tested, nonces, &key)) {
+        return key;
+    }
+    return (*crack_states_bitsliced_select(GetSIMDInstr()))(cuid, best_first_bytes, p, keys_found, num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, nonces);
+}
+
+void bitslice_test_nonces_OPENCL(uint32_t nonces_to_bruteforce, const uint32_t *bf_test_nonce, const uint8_t *bf_test_nonce_par) {
+    hardnested_opencl_set_nonces(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
+    (*bitslice_test_nonces_select(GetSIMDInstr()))(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
+}
+#endif
+
+// determine the available instruction set at runtime and call the correct function
+uint64_t crack_states_bitsliced_dispatch(uint32_t cuid, uint8_t *best_first_bytes, statelist_t *p,
+                                         uint32_t *keys_found, uint64_t *num_keys_tested,
+                                         uint32_t nonces_to_bruteforce, const uint8_t *bf_test_nonce_2nd_byte,
+                                         noncelist_t *nonces) {
+    crack_states_bitsliced_function_p = crack_states_bitsliced_select(GetSIMDInstrAuto());
+
+    // call the most optimized function for this CPU
+    return (*crack_states_bitsliced_function_p)(cuid, best_first_bytes, p, keys_found, num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, nonces);
+}
+
+void bitslice_test_nonces_dispatch(uint32_t nonces_to_bruteforce, const uint32_t *bf_test_nonce, const uint8_t *bf_test_nonce_par) {
+    bitslice_test_nonces_function_p = bitslice_test_nonces_select(GetSIMDInstrAuto());
 
     // call the most optimized function for this CPU
     (*bitslice_test_nonces_function_p)(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
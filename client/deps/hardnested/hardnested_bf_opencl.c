@@ -0,0 +1,440 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// OpenCL backend for the hardnested brute force
+//-----------------------------------------------------------------------------
+
+#include "hardnested_bf_opencl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "opencl.h"         // crack5opencl device enumeration
+#include "crapto1/crapto1.h"
+#include "ui.h"             // PrintAndLogEx
+
+#define ODD_STATE  1
+#define EVEN_STATE 0
+
+// work items per kernel run, keeps a single run well below watchdog timeouts
+#define HN_CL_PAIRS_PER_RUN (1 << 22)
+#define HN_CL_MAX_NONCES    256
+#define HN_CL_MATCHES_INIT  1024
+
+// The state pairs already have the best first byte shifted in, like for the
+// bitsliced cores. For every test nonce the 2nd to 4th byte are decrypted and
+// the parity bits compared, same as verify_key() minus the first byte.
+static const char *hn_cl_kernel_source =
+    "#define LF_POLY_ODD  (0x29CE5C)\n"
+    "#define LF_POLY_EVEN (0x870804)\n"
+    "\n"
+    "inline uint filter(uint x) {\n"
+    "    uint f;\n"
+    "    f  = 0xf22c0 >> (x       & 0xf) & 16;\n"
+    "    f |= 0x6c9c0 >> (x >>  4 & 0xf) &  8;\n"
+    "    f |= 0x3c8b0 >> (x >>  8 & 0xf) &  4;\n"
+    "    f |= 0x1e458 >> (x >> 12 & 0xf) &  2;\n"
+    "    f |= 0x0d938 >> (x >> 16 & 0xf) &  1;\n"
+    "    return (0xEC57E80A >> f) & 1;\n"
+    "}\n"
+    "\n"
+    "__kernel void hardnested_bf(__global const uint *odd_states, uint odd_first,\n"
+    "                            __global const uint *even_states,\n"
+    "                            __constant uint *nonces, __constant uchar *pars, uint num_nonces,\n"
+    "                            __global uint *matches, volatile __global uint *num_matches, uint max_matches) {\n"
+    "    const uint odd_idx = odd_first + get_global_id(1);\n"
+    "    const uint even_idx = get_global_id(0);\n"
+    "    const uint odd0 = odd_states[odd_idx];\n"
+    "    const uint even0 = even_states[even_idx];\n"
+    "\n"
+    "    for (uint n = 0; n < num_nonces; n++) {\n"
+    "        uint odd = odd0;\n"
+    "        uint even = even0;\n"
+    "        const uint nonce = nonces[n];\n"
+    "        const uint par = pars[n];\n"
+    "        for (int byte_pos = 2; byte_pos >= 0; byte_pos--) {\n"
+    "            const uint enc = nonce >> (8 * byte_pos);\n"
+    "            uint dec_par = 0;\n"
+    "            for (uint i = 0; i < 8; i++) {\n"
+    "                const uint dec = ((enc >> i) & 1) ^ filter(odd);\n"
+    "                dec_par ^= dec;\n"
+    "                const uint fb = dec ^ (popcount((odd & LF_POLY_ODD) ^ (even & LF_POLY_EVEN)) & 1);\n"
+    "                const uint t = odd;\n"
+    "                odd = (even << 1) | fb;\n"
+    "                even = t;\n"
+    "            }\n"
+    "            if (((par >> byte_pos) & 1) != (filter(odd) ^ dec_par)) {\n"
+    "                return;\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    const uint slot = atomic_inc(num_matches);\n"
+    "    if (slot < max_matches) {\n"
+    "        matches[2 * slot] = odd_idx;\n"
+    "        matches[2 * slot + 1] = even_idx;\n"
+    "    }\n"
+    "}\n";
+
+typedef struct {
+    cl_context context;
+    cl_command_queue queue;
+    cl_program program;
+    cl_kernel kernel;
+    cl_mem odd_states;
+    cl_mem even_states;
+    size_t odd_size;
+    size_t even_size;
+    cl_mem nonces;
+    cl_mem pars;
+    cl_mem matches;
+    cl_mem num_matches;
+    uint32_t max_matches;
+    uint32_t nonces_gen;        // test nonces uploaded to this device
+    bool busy;
+} hn_cl_device_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t free_sig;
+    bool init_done;
+    bool failed;                // a device error, everything left goes to the CPU
+    uint32_t num_devices;
+    hn_cl_device_t dev[MAX_OPENCL_DEVICES];
+    uint32_t nonces_gen;
+    uint32_t num_nonces;
+    uint32_t nonce[HN_CL_MAX_NONCES];
+    uint8_t par[HN_CL_MAX_NONCES];
+} hn_cl = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .free_sig = PTHREAD_COND_INITIALIZER,
+};
+
+static void device_release(hn_cl_device_t *dev) {
+    if (dev->matches) clReleaseMemObject(dev->matches);
+    if (dev->num_matches) clReleaseMemObject(dev->num_matches);
+    if (dev->nonces) clReleaseMemObject(dev->nonces);
+    if (dev->pars) clReleaseMemObject(dev->pars);
+    if (dev->odd_states) clReleaseMemObject(dev->odd_states);
+    if (dev->even_states) clReleaseMemObject(dev->even_states);
+    if (dev->kernel) clReleaseKernel(dev->kernel);
+    if (dev->program) clReleaseProgram(dev->program);
+    if (dev->queue) clReleaseCommandQueue(dev->queue);
+    if (dev->context) clReleaseContext(dev->context);
+    memset(dev, 0, sizeof(hn_cl_device_t));
+}
+
+static bool device_setup(hn_cl_device_t *dev, const compute_device_ctx_t *cd) {
+    cl_int err;
+    cl_device_id id = cd->device_id;
+
+    dev->context = clCreateContext(NULL, 1, &id, NULL, NULL, &err);
+    if (dev->context == NULL || err != CL_SUCCESS) {
+        PrintAndLogEx(WARNING, "OpenCL %s: clCreateContext() failed (%d)", cd->name, err);
+        return false;
+    }
+
+    dev->queue = clCreateCommandQueue(dev->context, id, 0, &err);
+    if (dev->queue == NULL || err != CL_SUCCESS) {
+        PrintAndLogEx(WARNING, "OpenCL %s: clCreateCommandQueue() failed (%d)", cd->name, err);
+        return false;
+    }
+
+    dev->program = clCreateProgramWithSource(dev->context, 1, &hn_cl_kernel_source, NULL, &err);
+    if (dev->program == NULL || err != CL_SUCCESS) {
+        PrintAndLogEx(WARNING, "OpenCL %s: clCreateProgramWithSource() failed (%d)", cd->name, err);
+        return false;
+    }
+
+    err = clBuildProgram(dev->program, 1, &id, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        PrintAndLogEx(WARNING, "OpenCL %s: clBuildProgram() failed (%d)", cd->name, err);
+        size_t len = 0;
+        clGetProgramBuildInfo(dev->program, id, CL_PROGRAM_BUILD_LOG, 0, NULL, &len);
+        char *log = calloc(len + 1, sizeof(char));
+        if (log != NULL) {
+            clGetProgramBuildInfo(dev->program, id, CL_PROGRAM_BUILD_LOG, len, log, NULL);
+            PrintAndLogEx(WARNING, "%s", log);
+            free(log);
+        }
+        return false;
+    }
+
+    dev->kernel = clCreateKernel(dev->program, "hardnested_bf", &err);
+    if (dev->kernel == NULL || err != CL_SUCCESS) {
+        PrintAndLogEx(WARNING, "OpenCL %s: clCreateKernel() failed (%d)", cd->name, err);
+        return false;
+    }
+
+    dev->nonces = clCreateBuffer(dev->context, CL_MEM_READ_ONLY, HN_CL_MAX_NONCES * sizeof(uint32_t), NULL, &err);
+    if (err == CL_SUCCESS) {
+        dev->pars = clCreateBuffer(dev->context, CL_MEM_READ_ONLY, HN_CL_MAX_NONCES * sizeof(uint8_t), NULL, &err);
+    }
+    if (err == CL_SUCCESS) {
+        dev->num_matches = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, sizeof(uint32_t), NULL, &err);
+    }
+    if (err == CL_SUCCESS) {
+        dev->max_matches = HN_CL_MATCHES_INIT;
+        dev->matches = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY, 2 * dev->max_matches * sizeof(uint32_t), NULL, &err);
+    }
+    if (err != CL_SUCCESS) {
+        PrintAndLogEx(WARNING, "OpenCL %s: clCreateBuffer() failed (%d)", cd->name, err);
+        return false;
+    }
+    return true;
+}
+
+// GPUs first, any other device only if there is no GPU at all
+static void discover(cl_device_type type) {
+    unsigned int plat_sel[1] = { 0xff };
+    unsigned int dev_sel[1] = { 0xff };
+    cl_uint platform_cnt = 0;
+    size_t selected_platforms_cnt = 0;
+    size_t selected_devices_cnt = 0;
+    compute_platform_ctx_t *cd_ctx = NULL;
+
+    if (discoverDevices(PROFILE_DEFAULT, type, &platform_cnt, &selected_platforms_cnt, &selected_devices_cnt,
+                        &cd_ctx, plat_sel, 0, dev_sel, 0, false, false) != 0) {
+        return;
+    }
+
+    for (cl_uint w = 0; w < platform_cnt; w++) {
+        if (cd_ctx[w].selected == false) {
+            continue;
+        }
+        for (unsigned int q = 0; q < cd_ctx[w].device_cnt && hn_cl.num_devices < MAX_OPENCL_DEVICES; q++) {
+            const compute_device_ctx_t *cd = &cd_ctx[w].device[q];
+            if (cd->selected == false || cd->unsupported) {
+                continue;
+            }
+            hn_cl_device_t *dev = &hn_cl.dev[hn_cl.num_devices];
+            if (device_setup(dev, cd)) {
+                PrintAndLogEx(INFO, "OpenCL device " _YELLOW_("%u") ": %s", hn_cl.num_devices, cd->name);
+                hn_cl.num_devices++;
+            } else {
+                device_release(dev);
+            }
+        }
+    }
+    free(cd_ctx);
+}
+
+bool hardnested_opencl_init(void) {
+    pthread_mutex_lock(&hn_cl.lock);
+    if (hn_cl.init_done == false) {
+        hn_cl.init_done = true;
+        // discoverDevices() is chatty when there's no platform at all
+        cl_uint platform_cnt = 0;
+        if (clGetPlatformIDs(0, NULL, &platform_cnt) == CL_SUCCESS && platform_cnt > 0) {
+            discover(CL_DEVICE_TYPE_GPU);
+            if (hn_cl.num_devices == 0) {
+                discover(CL_DEVICE_TYPE_ALL);
+            }
+        }
+    }
+    bool res = (hn_cl.num_devices > 0);
+    pthread_mutex_unlock(&hn_cl.lock);
+    return res;
+}
+
+void hardnested_opencl_set_nonces(uint32_t nonces_to_bruteforce, const uint32_t *bf_test_nonce, const uint8_t *bf_test_nonce_par) {
+    if (nonces_to_bruteforce > HN_CL_MAX_NONCES) {
+        nonces_to_bruteforce = HN_CL_MAX_NONCES;
+    }
+    pthread_mutex_lock(&hn_cl.lock);
+    memcpy(hn_cl.nonce, bf_test_nonce, nonces_to_bruteforce * sizeof(uint32_t));
+    memcpy(hn_cl.par, bf_test_nonce_par, nonces_to_bruteforce * sizeof(uint8_t));
+    hn_cl.num_nonces = nonces_to_bruteforce;
+    hn_cl.nonces_gen++;
+    pthread_mutex_unlock(&hn_cl.lock);
+}
+
+static hn_cl_device_t *device_get(void) {
+    pthread_mutex_lock(&hn_cl.lock);
+    for (;;) {
+        for (uint32_t i = 0; i < hn_cl.num_devices; i++) {
+            if (hn_cl.dev[i].busy == false) {
+                hn_cl.dev[i].busy = true;
+                pthread_mutex_unlock(&hn_cl.lock);
+                return &hn_cl.dev[i];
+            }
+        }
+        pthread_cond_wait(&hn_cl.free_sig, &hn_cl.lock);
+    }
+}
+
+static void device_put(hn_cl_device_t *dev) {
+    pthread_mutex_lock(&hn_cl.lock);
+    dev->busy = false;
+    pthread_cond_signal(&hn_cl.free_sig);
+    pthread_mutex_unlock(&hn_cl.lock);
+}
+
+// (re)allocate a device buffer if it is too small and fill it
+static cl_int upload(hn_cl_device_t *dev, cl_mem *mem, size_t *size, const void *data, size_t len) {
+    cl_int err = CL_SUCCESS;
+    if (*size < len) {
+        if (*mem) {
+            clReleaseMemObject(*mem);
+        }
+        *mem = clCreateBuffer(dev->context, CL_MEM_READ_ONLY, len, NULL, &err);
+        if (err != CL_SUCCESS) {
+            *mem = NULL;
+            *size = 0;
+            return err;
+        }
+        *size = len;
+    }
+    return clEnqueueWriteBuffer(dev->queue, *mem, CL_FALSE, 0, len, data, 0, NULL, NULL);
+}
+
+static cl_int upload_nonces(hn_cl_device_t *dev, uint32_t *num_nonces) {
+    cl_int err = CL_SUCCESS;
+    pthread_mutex_lock(&hn_cl.lock);
+    *num_nonces = hn_cl.num_nonces;
+    if (dev->nonces_gen != hn_cl.nonces_gen) {
+        // blocking, hn_cl.nonce may change once the lock is dropped
+        err = clEnqueueWriteBuffer(dev->queue, dev->nonces, CL_TRUE, 0, hn_cl.num_nonces * sizeof(uint32_t), hn_cl.nonce, 0, NULL, NULL);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueWriteBuffer(dev->queue, dev->pars, CL_TRUE, 0, hn_cl.num_nonces * sizeof(uint8_t), hn_cl.par, 0, NULL, NULL);
+        }
+        if (err == CL_SUCCESS) {
+            dev->nonces_gen = hn_cl.nonces_gen;
+        }
+    }
+    pthread_mutex_unlock(&hn_cl.lock);
+    return err;
+}
+
+static cl_int run_chunk(hn_cl_device_t *dev, uint32_t odd_first, uint32_t odd_cnt, uint32_t even_cnt, uint32_t num_nonces, uint32_t *num_matches) {
+    const uint32_t zero = 0;
+    cl_int err = clEnqueueWriteBuffer(dev->queue, dev->num_matches, CL_TRUE, 0, sizeof(uint32_t), &zero, 0, NULL, NULL);
+
+    err |= clSetKernelArg(dev->kernel, 0, sizeof(cl_mem), &dev->odd_states);
+    err |= clSetKernelArg(dev->kernel, 1, sizeof(uint32_t), &odd_first);
+    err |= clSetKernelArg(dev->kernel, 2, sizeof(cl_mem), &dev->even_states);
+    err |= clSetKernelArg(dev->kernel, 3, sizeof(cl_mem), &dev->nonces);
+    err |= clSetKernelArg(dev->kernel, 4, sizeof(cl_mem), &dev->pars);
+    err |= clSetKernelArg(dev->kernel, 5, sizeof(uint32_t), &num_nonces);
+    err |= clSetKernelArg(dev->kernel, 6, sizeof(cl_mem), &dev->matches);
+    err |= clSetKernelArg(dev->kernel, 7, sizeof(cl_mem), &dev->num_matches);
+    err |= clSetKernelArg(dev->kernel, 8, sizeof(uint32_t), &dev->max_matches);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    const size_t global_ws[2] = { even_cnt, odd_cnt };
+    err = clEnqueueNDRangeKernel(dev->queue, dev->kernel, 2, NULL, global_ws, NULL, 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    return clEnqueueReadBuffer(dev->queue, dev->num_matches, CL_TRUE, 0, sizeof(uint32_t), num_matches, 0, NULL, NULL);
+}
+
+static cl_int grow_matches(hn_cl_device_t *dev, uint32_t num_matches) {
+    cl_int err;
+    clReleaseMemObject(dev->matches);
+    dev->max_matches = num_matches;
+    dev->matches = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY, 2 * dev->max_matches * sizeof(uint32_t), NULL, &err);
+    return err;
+}
+
+bool hardnested_opencl_crack(uint32_t cuid, const uint8_t *best_first_bytes, const statelist_t *p, const uint32_t *keys_found,
+                             uint64_t *num_keys_tested, noncelist_t *nonces, uint64_t *key) {
+
+    const uint32_t odd_cnt = p->len[ODD_STATE];
+    const uint32_t even_cnt = p->len[EVEN_STATE];
+    *key = -1;
+    if (__atomic_load_n(&hn_cl.failed, __ATOMIC_SEQ_CST)) {
+        return false;
+    }
+    if (odd_cnt == 0 || even_cnt == 0) {
+        return true;
+    }
+
+    hn_cl_device_t *dev = device_get();
+    uint32_t *matches = NULL;
+    uint32_t num_nonces = 0;
+
+    cl_int err = upload_nonces(dev, &num_nonces);
+    if (err == CL_SUCCESS) {
+        err = upload(dev, &dev->odd_states, &dev->odd_size, p->states[ODD_STATE], odd_cnt * sizeof(uint32_t));
+    }
+    if (err == CL_SUCCESS) {
+        err = upload(dev, &dev->even_states, &dev->even_size, p->states[EVEN_STATE], even_cnt * sizeof(uint32_t));
+    }
+
+    const uint32_t odd_step = MAX(1, HN_CL_PAIRS_PER_RUN / even_cnt);
+    for (uint32_t odd_first = 0; err == CL_SUCCESS && odd_first < odd_cnt; odd_first += odd_step) {
+        if (__atomic_load_n(keys_found, __ATOMIC_SEQ_CST)) {
+            break;
+        }
+
+        const uint32_t odd_run = MIN(odd_step, odd_cnt - odd_first);
+        uint32_t num_matches = 0;
+        err = run_chunk(dev, odd_first, odd_run, even_cnt, num_nonces, &num_matches);
+        if (err == CL_SUCCESS && num_matches > dev->max_matches) {
+            // only with very few test nonces. Make room for all of them and redo
+            err = grow_matches(dev, num_matches);
+            if (err == CL_SUCCESS) {
+                err = run_chunk(dev, odd_first, odd_run, even_cnt, num_nonces, &num_matches);
+            }
+        }
+        if (err != CL_SUCCESS) {
+            break;
+        }
+
+        __atomic_fetch_add(num_keys_tested, (uint64_t)odd_run * even_cnt, __ATOMIC_SEQ_CST);
+        if (num_matches == 0) {
+            continue;
+        }
+
+        uint32_t *tmp = realloc(matches, 2 * num_matches * sizeof(uint32_t));
+        if (tmp == NULL) {
+            PrintAndLogEx(WARNING, "Out of memory error in brute_force. Aborting...");
+            exit(4);
+        }
+        matches = tmp;
+        err = clEnqueueReadBuffer(dev->queue, dev->matches, CL_TRUE, 0, 2 * num_matches * sizeof(uint32_t), matches, 0, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            break;
+        }
+
+        for (uint32_t i = 0; i < num_matches; i++) {
+            uint32_t odd = p->states[ODD_STATE][matches[2 * i]];
+            uint32_t even = p->states[EVEN_STATE][matches[2 * i + 1]];
+            if (verify_key(cuid, nonces, best_first_bytes, odd, even)) {
+                struct Crypto1State pcs;
+                pcs.odd = odd;
+                pcs.even = even;
+                lfsr_rollback_byte(&pcs, (cuid >> 24) ^ best_first_bytes[0], true);
+                crypto1_get_lfsr(&pcs, key);
+                goto out;
+            }
+        }
+    }
+
+out:
+    free(matches);
+    device_put(dev);
+    if (err != CL_SUCCESS) {
+        if (__atomic_exchange_n(&hn_cl.failed, true, __ATOMIC_SEQ_CST) == false) {
+            PrintAndLogEx(WARNING, "OpenCL brute force failed (%d), continuing on the CPU", err);
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// OpenCL backend for the hardnested brute force (SIMD_OPENCL).
+//
+// Device enumeration is shared with tools/hitag2crack/crack5opencl. Every
+// selected device gets its own context and queue, pool workers borrow a free
+// device for one bucket at a time. Each work item tests one (odd, even) state
+// pair against the test nonces, survivors are checked with verify_key().
+//-----------------------------------------------------------------------------
+
+#ifndef HARDNESTED_BF_OPENCL_H__
+#define HARDNESTED_BF_OPENCL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardnested_bruteforce.h" // statelist_t
+
+// enumerate devices and build the kernel, once. False if there is no usable device
+bool hardnested_opencl_init(void);
+void hardnested_opencl_set_nonces(uint32_t nonces_to_bruteforce, const uint32_t *bf_test_nonce, const uint8_t *bf_test_nonce_par);
+// same contract as crack_states_bitsliced(). Returns false if the device failed,
+// the caller then has to do this bucket on the CPU
+bool hardnested_opencl_crack(uint32_t cuid, const uint8_t *best_first_bytes, const statelist_t *p, const uint32_t *keys_found,
+                             uint64_t *num_keys_tested, noncelist_t *nonces, uint64_t *key);
+
+#endif
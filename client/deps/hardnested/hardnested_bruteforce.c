@@ -52,7 +52,6 @@ THE SOFTWARE.
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -60,6 +59,7 @@ THE SOFTWARE.
 #include "proxmark3.h"
 #include "cmdhfmfhard.h"
 #include "hardnested_bf_core.h"
+#include "hardnested_pool.h"
 #include "ui.h"
 #include "util.h"
 #include "util_posix.h"
@@ -68,7 +68,6 @@ THE SOFTWARE.
 #include "fileutils.h"
 #include "pm3_cmd.h"
 
-#define NUM_BRUTE_FORCE_THREADS         (num_CPUs())
 #define DEFAULT_BRUTE_FORCE_RATE        (120000000.0) // if benchmark doesn't succeed
 #define TEST_BENCH_SIZE                 (6000)        // number of odd and even states for brute force benchmark
 #define TEST_BENCH_FILENAME             "hardnested_bf_bench_data.bin"
@@ -79,6 +78,7 @@ THE SOFTWARE.
 // #define DEBUG_BRUTE_FORCE
 
 #define MIN_BUCKETS_SIZE                128
+#define SHARD_CHUNK_SIZE                4096          // odd states per work unit when sharding
 
 typedef enum {
     EVEN_STATE = 0,
@@ -95,6 +95,9 @@ static statelist_t **buckets = NULL;
 static uint32_t keys_found = 0;
 static uint64_t num_keys_tested;
 static uint64_t found_bs_key = 0;
+static uint32_t bf_shard = 0;
+static uint32_t bf_shards = 1;
+static statelist_t *shard_units = NULL;
 
 uint8_t trailing_zeros(uint8_t byte) {
     static const uint8_t trailing_zeros_LUT[256] = {
@@ -143,59 +146,50 @@ bool verify_key(uint32_t cuid, noncelist_t *nonces, const uint8_t *best_first_by
     }
     return true;
 }
-static void *
-#ifdef __has_attribute
-#if __has_attribute(force_align_arg_pointer)
-__attribute__((force_align_arg_pointer))
-#endif
-#endif
-crack_states_thread(void *x) {
-    struct arg {
-        bool silent;
-        int thread_ID;
-        uint32_t cuid;
-        uint32_t num_acquired_nonces;
-        uint64_t maximum_states;
-        noncelist_t *nonces;
-        uint8_t *best_first_bytes;
-    } *thread_arg;
-
-    const int num_brute_force_threads = NUM_BRUTE_FORCE_THREADS;
-    thread_arg = (struct arg *)x;
-    const int thread_id = thread_arg->thread_ID;
-    uint32_t current_bucket = thread_id;
-    while (current_bucket < bucket_count) {
-        statelist_t *bucket = buckets[current_bucket];
-        if (bucket) {
+typedef struct {
+    bool silent;
+    uint32_t cuid;
+    uint32_t num_acquired_nonces;
+    uint64_t maximum_states;
+    noncelist_t *nonces;
+    uint8_t *best_first_bytes;
+} crack_states_args_t;
+
+// one bucket per pool item, bucket sizes are very uneven so the pool balances them
+static void crack_states_bucket(uint32_t current_bucket, uint32_t worker, void *x) {
+    const crack_states_args_t *thread_arg = (const crack_states_args_t *)x;
+    (void)worker;
+
+    // once a key is found the remaining buckets are skipped
+    if (__atomic_load_n(&keys_found, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+
+    statelist_t *bucket = buckets[current_bucket];
+    if (bucket == NULL) {
+        return;
+    }
+
 #if defined (DEBUG_BRUTE_FORCE)
-            PrintAndLogEx(INFO, "Thread " _YELLOW_("%u") " starts working on bucket " _YELLOW_("%u") "\n", thread_id, current_bucket);
+    PrintAndLogEx(INFO, "Thread " _YELLOW_("%u") " starts working on bucket " _YELLOW_("%u") "\n", worker, current_bucket);
 #endif
-            const uint64_t key = crack_states_bitsliced(thread_arg->cuid, thread_arg->best_first_bytes, bucket, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, thread_arg->nonces);
-            if (key != -1) {
-                __atomic_fetch_add(&keys_found, 1, __ATOMIC_SEQ_CST);
-                __atomic_fetch_add(&found_bs_key, key, __ATOMIC_SEQ_CST);
-
-                char progress_text[80];
-                char keystr[19];
-                snprintf(keystr, sizeof(keystr), "%012" PRIX64, key);
-                snprintf(progress_text, sizeof(progress_text), "Brute force phase completed.  Key found: " _GREEN_("%s"), keystr);
-                hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, 0.0, 0);
-                PrintAndLogEx(INFO, "---------+---------+---------------------------------------------------------+-----------------+-------");
-                break;
-            } else if (keys_found) {
-                break;
-            } else {
-                if (thread_arg->silent == false) {
-                    char progress_text[80];
-                    snprintf(progress_text, sizeof(progress_text), "Brute force phase: %6.02f%%  ", 100.0 * (float)num_keys_tested / (float)(thread_arg->maximum_states));
-                    float remaining_bruteforce = thread_arg->nonces[thread_arg->best_first_bytes[0]].expected_num_brute_force - (float)num_keys_tested / 2;
-                    hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, remaining_bruteforce, 5000);
-                }
-            }
-        }
-        current_bucket += num_brute_force_threads;
+    const uint64_t key = crack_states_bitsliced(thread_arg->cuid, thread_arg->best_first_bytes, bucket, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, thread_arg->nonces);
+    if (key != -1) {
+        __atomic_fetch_add(&keys_found, 1, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&found_bs_key, key, __ATOMIC_SEQ_CST);
+
+        char progress_text[80];
+        char keystr[19];
+        snprintf(keystr, sizeof(keystr), "%012" PRIX64, key);
+        snprintf(progress_text, sizeof(progress_text), "Brute force phase completed.  Key found: " _GREEN_("%s"), keystr);
+        hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, 0.0, 0);
+        PrintAndLogEx(INFO, "---------+---------+---------------------------------------------------------+-----------------+-------");
+    } else if (keys_found == 0 && thread_arg->silent == false) {
+        char progress_text[80];
+        snprintf(progress_text, sizeof(progress_text), "Brute force phase: %6.02f%%  ", 100.0 * (float)num_keys_tested / (float)(thread_arg->maximum_states));
+        float remaining_bruteforce = thread_arg->nonces[thread_arg->best_first_bytes[0]].expected_num_brute_force - (float)num_keys_tested / 2;
+        hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, remaining_bruteforce, 5000);
     }
-    return NULL;
 }
 
 
@@ -320,14 +314,82 @@ static bool ensure_buckets_alloc(size_t need_buckets) {
 }
 
 
+void brute_force_set_shard(uint32_t shard, uint32_t shards) {
+    bf_shards = (shards) ? shards : 1;
+    bf_shard = (shard < bf_shards) ? shard : 0;
+}
+
+// The candidate list is built by several threads and its order differs from
+// run to run. Work units are therefore named by their content (sizes and first
+// states of the bucket, plus the chunk offset), which is the same on every host
+// reading the same nonces.
+static bool unit_in_shard(const statelist_t *p, uint32_t chunk) {
+    uint32_t h = p->len[ODD_STATE] * 0x9E3779B1 ^ p->len[EVEN_STATE] * 0x85EBCA6B;
+    h ^= p->states[ODD_STATE][0] * 0xC2B2AE35 ^ p->states[EVEN_STATE][0];
+    h ^= chunk * 0x27D4EB2F;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6D;
+    h ^= h >> 13;
+    return (h % bf_shards) == bf_shard;
+}
+
+// split every bucket into chunks of odd states and keep the ones owned by this shard
+static bool build_shard_buckets(statelist_t *candidates, uint64_t *shard_states) {
+    uint32_t units = 0;
+    for (statelist_t *p = candidates; p != NULL; p = p->next) {
+        if (p->states[ODD_STATE] != NULL && p->states[EVEN_STATE] != NULL && p->len[ODD_STATE] && p->len[EVEN_STATE]) {
+            units += (p->len[ODD_STATE] + SHARD_CHUNK_SIZE - 1) / SHARD_CHUNK_SIZE;
+        }
+    }
+
+    if (units == 0) {
+        *shard_states = 0;
+        return true;
+    }
+
+    shard_units = calloc(units, sizeof(statelist_t));
+    if (shard_units == NULL) {
+        return false;
+    }
+
+    *shard_states = 0;
+    for (statelist_t *p = candidates; p != NULL; p = p->next) {
+        if (p->states[ODD_STATE] == NULL || p->states[EVEN_STATE] == NULL || p->len[ODD_STATE] == 0 || p->len[EVEN_STATE] == 0) {
+            continue;
+        }
+
+        for (uint32_t start = 0; start < p->len[ODD_STATE]; start += SHARD_CHUNK_SIZE) {
+            if (unit_in_shard(p, start / SHARD_CHUNK_SIZE) == false) {
+                continue;
+            }
+
+            if (ensure_buckets_alloc(bucket_count + 1) == false) {
+                free(shard_units);
+                shard_units = NULL;
+                return false;
+            }
+
+            statelist_t *unit = &shard_units[bucket_count];
+            unit->states[ODD_STATE] = p->states[ODD_STATE] + start;
+            unit->len[ODD_STATE] = MIN(SHARD_CHUNK_SIZE, p->len[ODD_STATE] - start);
+            unit->states[EVEN_STATE] = p->states[EVEN_STATE];
+            unit->len[EVEN_STATE] = p->len[EVEN_STATE];
+            *shard_states += (uint64_t)unit->len[ODD_STATE] * unit->len[EVEN_STATE];
+
+            buckets[bucket_count] = unit;
+            bucket_count++;
+        }
+    }
+    return true;
+}
+
+
 bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint32_t num_acquired_nonces, uint64_t maximum_states, noncelist_t *nonces, uint8_t *best_first_bytes, uint64_t *found_key) {
 #if defined (WRITE_BENCH_FILE)
     write_benchfile(candidates);
 #endif
     bool silent = (bf_rate != NULL);
 
-    const int num_brute_force_threads = NUM_BRUTE_FORCE_THREADS;
-
     keys_found = 0;
     num_keys_tested = 0;
     found_bs_key = 0;
@@ -336,54 +398,42 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
 
     // count number of states to go
     bucket_count = 0;
-    for (statelist_t *p = candidates; p != NULL; p = p->next) {
-        if (p->states[ODD_STATE] != NULL && p->states[EVEN_STATE] != NULL) {
-            if (ensure_buckets_alloc(bucket_count + 1) == false) {
-                PrintAndLogEx(ERR, "Can't allocate buckets, abort!");
-                return false;
-            }
+    if (silent == false && bf_shards > 1) {
+        if (build_shard_buckets(candidates, &maximum_states) == false) {
+            PrintAndLogEx(ERR, "Can't allocate buckets, abort!");
+            return false;
+        }
+    } else {
+        for (statelist_t *p = candidates; p != NULL; p = p->next) {
+            if (p->states[ODD_STATE] != NULL && p->states[EVEN_STATE] != NULL) {
+                if (ensure_buckets_alloc(bucket_count + 1) == false) {
+                    PrintAndLogEx(ERR, "Can't allocate buckets, abort!");
+                    return false;
+                }
 
-            buckets[bucket_count] = p;
-            bucket_count++;
+                buckets[bucket_count] = p;
+                bucket_count++;
+            }
         }
     }
 
     uint64_t start_time = msclock();
 
-#if defined(__linux__) ||  defined(__APPLE__)
-    if (NUM_BRUTE_FORCE_THREADS < 0)
-        return false;
-#endif
-
-    pthread_t threads[num_brute_force_threads];
-    struct args {
-        bool silent;
-        int thread_ID;
-        uint32_t cuid;
-        uint32_t num_acquired_nonces;
-        uint64_t maximum_states;
-        noncelist_t *nonces;
-        uint8_t *best_first_bytes;
-    } thread_args[num_brute_force_threads];
-
-    for (uint32_t i = 0; i < num_brute_force_threads; i++) {
-        thread_args[i].thread_ID = i;
-        thread_args[i].silent = silent;
-        thread_args[i].cuid = cuid;
-        thread_args[i].num_acquired_nonces = num_acquired_nonces;
-        thread_args[i].maximum_states = maximum_states;
-        thread_args[i].nonces = nonces;
-        thread_args[i].best_first_bytes = best_first_bytes;
-        pthread_create(&threads[i], NULL, crack_states_thread, (void *)&thread_args[i]);
-    }
-
-    for (uint32_t i = 0; i < num_brute_force_threads; i++) {
-        pthread_join(threads[i], 0);
-    }
+    crack_states_args_t thread_args = {
+        .silent = silent,
+        .cuid = cuid,
+        .num_acquired_nonces = num_acquired_nonces,
+        .maximum_states = maximum_states,
+        .nonces = nonces,
+        .best_first_bytes = best_first_bytes,
+    };
+    hn_pool_run(bucket_count, crack_states_bucket, &thread_args);
 
     free(buckets);
     buckets = NULL;
     buckets_allocated = 0;
+    free(shard_units);
+    shard_units = NULL;
 
     uint64_t elapsed_time = msclock() - start_time;
 
@@ -399,6 +449,47 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
 }
 
 
+// no progress output and no sharding, the caller sizes the units to a time slice
+bool brute_force_units(statelist_t *units, uint32_t count, uint32_t cuid, uint32_t num_acquired_nonces, noncelist_t *nonces, uint8_t *best_first_bytes, uint64_t *found_key) {
+    keys_found = 0;
+    num_keys_tested = 0;
+    found_bs_key = 0;
+
+    bitslice_test_nonces(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
+
+    bucket_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (units[i].len[ODD_STATE] && units[i].len[EVEN_STATE]) {
+            if (ensure_buckets_alloc(bucket_count + 1) == false) {
+                PrintAndLogEx(ERR, "Can't allocate buckets, abort!");
+                return false;
+            }
+            buckets[bucket_count] = &units[i];
+            bucket_count++;
+        }
+    }
+
+    crack_states_args_t thread_args = {
+        .silent = true,
+        .cuid = cuid,
+        .num_acquired_nonces = num_acquired_nonces,
+        .nonces = nonces,
+        .best_first_bytes = best_first_bytes,
+    };
+    hn_pool_run(bucket_count, crack_states_bucket, &thread_args);
+
+    free(buckets);
+    buckets = NULL;
+    buckets_allocated = 0;
+
+    if (keys_found > 0) {
+        *found_key = found_bs_key;
+    }
+
+    return (keys_found != 0);
+}
+
+
 static bool read_bench_data(statelist_t *test_candidates) {
 
     size_t bytes_read = 0;
@@ -483,7 +574,8 @@ static bool read_bench_data(statelist_t *test_candidates) {
 
 
 float brute_force_benchmark(void) {
-    const int num_brute_force_threads = NUM_BRUTE_FORCE_THREADS;
+    // one bucket per worker
+    const int num_brute_force_threads = hn_pool_workers();
     statelist_t test_candidates[num_brute_force_threads];
 
     test_candidates[0].states[ODD_STATE] = calloc(1, (TEST_BENCH_SIZE + 1) * sizeof(uint32_t));
@@ -53,8 +53,12 @@ typedef struct {
     void *next;
 } statelist_t;
 
+// only brute force the share of work units owned by shard in [0, shards). Default 0 of 1, i.e. all
+void brute_force_set_shard(uint32_t shard, uint32_t shards);
 void prepare_bf_test_nonces(noncelist_t *nonces, uint8_t best_first_byte);
 bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint32_t num_acquired_nonces, uint64_t maximum_states, noncelist_t *nonces, uint8_t *best_first_bytes, uint64_t *found_key);
+// crack an array of work units in one go, used for the speculative slices of the pipelined mode
+bool brute_force_units(statelist_t *units, uint32_t count, uint32_t cuid, uint32_t num_acquired_nonces, noncelist_t *nonces, uint8_t *best_first_bytes, uint64_t *found_key);
 float brute_force_benchmark(void);
 uint8_t trailing_zeros(uint8_t byte);
 bool verify_key(uint32_t cuid, noncelist_t *nonces, const uint8_t *best_first_bytes, uint32_t odd, uint32_t even);
@@ -0,0 +1,215 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Worker pool shared by the hardnested phases, with work stealing
+//-----------------------------------------------------------------------------
+
+#include "hardnested_pool.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "util.h"       // num_CPUs
+
+// slice of the current job owned by one worker, [next, end)
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t next;
+    uint32_t end;
+} hn_slice_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t start_sig;    // a new job was posted
+    pthread_cond_t done_sig;     // the last busy worker finished
+    pthread_t *threads;
+    hn_slice_t *slices;
+    uint32_t num_workers;
+    uint32_t generation;         // bumped for every job
+    uint32_t busy;
+    hn_pool_fn_t fn;
+    void *ctx;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start_sig = PTHREAD_COND_INITIALIZER,
+    .done_sig = PTHREAD_COND_INITIALIZER,
+};
+
+static bool take_own(uint32_t worker, uint32_t *item) {
+    hn_slice_t *s = &pool.slices[worker];
+    bool res = false;
+    pthread_mutex_lock(&s->lock);
+    if (s->next < s->end) {
+        *item = s->next++;
+        res = true;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return res;
+}
+
+// move the upper half of the biggest slice left over to our own (empty) slice
+static bool steal(uint32_t worker) {
+    for (;;) {
+        uint32_t victim = worker;
+        uint32_t best = 0;
+        for (uint32_t i = 0; i < pool.num_workers; i++) {
+            // unlocked peek, only used to pick a victim
+            uint32_t left = __atomic_load_n(&pool.slices[i].end, __ATOMIC_RELAXED) - __atomic_load_n(&pool.slices[i].next, __ATOMIC_RELAXED);
+            if (i != worker && (int32_t)left > (int32_t)best) {
+                best = left;
+                victim = i;
+            }
+        }
+        if (victim == worker) {
+            return false;
+        }
+
+        hn_slice_t *v = &pool.slices[victim];
+        pthread_mutex_lock(&v->lock);
+        uint32_t left = (v->next < v->end) ? v->end - v->next : 0;
+        if (left == 0) {
+            // someone else was faster, look again
+            pthread_mutex_unlock(&v->lock);
+            continue;
+        }
+        uint32_t end = v->end;
+        uint32_t mid = v->end - (left + 1) / 2;
+        v->end = mid;
+        pthread_mutex_unlock(&v->lock);
+
+        hn_slice_t *s = &pool.slices[worker];
+        pthread_mutex_lock(&s->lock);
+        s->next = mid;
+        s->end = end;
+        pthread_mutex_unlock(&s->lock);
+        return true;
+    }
+}
+
+static void run_slices(uint32_t worker) {
+    uint32_t item;
+    for (;;) {
+        if (take_own(worker, &item)) {
+            pool.fn(item, worker, pool.ctx);
+        } else if (steal(worker) == false) {
+            return;
+        }
+    }
+}
+
+static void *
+#ifdef __has_attribute
+#if __has_attribute(force_align_arg_pointer)
+__attribute__((force_align_arg_pointer))
+#endif
+#endif
+hn_pool_worker(void *arg) {
+    uint32_t worker = (uint32_t)(uintptr_t)arg;
+    uint32_t seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool.lock);
+        while (pool.generation == seen) {
+            pthread_cond_wait(&pool.start_sig, &pool.lock);
+        }
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        run_slices(worker);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.busy == 0) {
+            pthread_cond_signal(&pool.done_sig);
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
+    return NULL;
+}
+
+// only called from hn_pool_run, which isn't reentrant
+static void hn_pool_init(void) {
+    if (pool.threads != NULL) {
+        return;
+    }
+
+    int cpus = num_CPUs();
+    uint32_t n = (cpus > 0) ? cpus : 1;
+
+    pool.threads = calloc(n, sizeof(pthread_t));
+    pool.slices = calloc(n, sizeof(hn_slice_t));
+    if (pool.threads == NULL || pool.slices == NULL) {
+        free(pool.threads);
+        free(pool.slices);
+        pool.threads = NULL;
+        pool.slices = NULL;
+        return;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        pthread_mutex_init(&pool.slices[i].lock, NULL);
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (pthread_create(&pool.threads[i], NULL, hn_pool_worker, (void *)(uintptr_t)i) != 0) {
+            break;
+        }
+        pool.num_workers++;
+    }
+}
+
+uint32_t hn_pool_workers(void) {
+    hn_pool_init();
+    return (pool.num_workers) ? pool.num_workers : 1;
+}
+
+void hn_pool_run(uint32_t count, hn_pool_fn_t fn, void *ctx) {
+    if (count == 0) {
+        return;
+    }
+
+    hn_pool_init();
+
+    // no threads at all, do it ourselves
+    if (pool.num_workers == 0) {
+        for (uint32_t i = 0; i < count; i++) {
+            fn(i, 0, ctx);
+        }
+        return;
+    }
+
+    uint32_t per_worker = count / pool.num_workers;
+    uint32_t extra = count % pool.num_workers;
+    uint32_t start = 0;
+    for (uint32_t i = 0; i < pool.num_workers; i++) {
+        uint32_t len = per_worker + ((i < extra) ? 1 : 0);
+        pthread_mutex_lock(&pool.slices[i].lock);
+        pool.slices[i].next = start;
+        pool.slices[i].end = start + len;
+        pthread_mutex_unlock(&pool.slices[i].lock);
+        start += len;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.busy = pool.num_workers;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.start_sig);
+    while (pool.busy) {
+        pthread_cond_wait(&pool.done_sig, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
@@ -0,0 +1,37 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Worker pool shared by the hardnested phases (bitflip checks, candidate
+// generation and brute force).
+//
+// The threads are started once and kept for the life of the client. A job
+// is a range of items [0, count), split into one contiguous slice per worker.
+// A worker done with its slice steals the upper half of the biggest slice
+// left, so skewed item costs (e.g. statelist buckets) don't leave cores idle.
+//-----------------------------------------------------------------------------
+
+#ifndef HARDNESTED_POOL_H__
+#define HARDNESTED_POOL_H__
+
+#include <stdint.h>
+
+// called once per item, worker is in [0, hn_pool_workers())
+typedef void (*hn_pool_fn_t)(uint32_t item, uint32_t worker, void *ctx);
+
+uint32_t hn_pool_workers(void);
+// runs fn on all items and returns when every item is done. Not reentrant
+void hn_pool_run(uint32_t count, hn_pool_fn_t fn, void *ctx);
+
+#endif
@@ -0,0 +1,215 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Hitag2 key recovery from a UID and two encrypted nR/aR pairs, the setup and
+// key test of tools/hitag2crack/crack5 around the dispatched ht2crack5 core.
+//-----------------------------------------------------------------------------
+
+#include "ht2crack5.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "commonutil.h"     // REV32, MemLeToUint4byte
+#include "pm3_cmd.h"        // PM3_*
+#include "ui.h"             // PrintAndLogEx
+#include "util.h"           // kbd_enter_pressed
+#include "util_posix.h"     // msclock
+#include "hitag2/hitag2_crypto.h"
+#include "hardnested_bf_core.h"
+#include "hardnested_pool.h"
+#include "ht2crack5_core.h"
+
+#define i4(x,a,b,c,d) ((uint32_t)((((x)>>(a))&1)<<3)|(((x)>>(b))&1)<<2|(((x)>>(c))&1)<<1|(((x)>>(d))&1))
+#define f(state) ((0xdd3929b >> ( (((0x3c65 >> i4(state, 2, 3, 5, 6) ) & 1) <<4) \
+                                | ((( 0xee5 >> i4(state, 8,12,14,15) ) & 1) <<3) \
+                                | ((( 0xee5 >> i4(state,17,21,23,26) ) & 1) <<2) \
+                                | ((( 0xee5 >> i4(state,28,29,31,33) ) & 1) <<1) \
+                                | (((0x3c65 >> i4(state,34,43,44,46) ) & 1) ))) & 1)
+
+// layer 0 guesses 20 state bits
+#define HT2CRACK5_LAYER0    (1 << 20)
+
+typedef struct {
+    uint32_t uid;
+    uint32_t nR1;
+    uint32_t nR2;
+    uint32_t aR2;
+    bool use_ks;
+    uint32_t ks;
+    ht2crack5_find_t *find;
+    uint32_t done;
+    uint32_t step;
+    bool found;
+    bool abort;
+    uint64_t key;
+} ht2crack5_job_t;
+
+static uint64_t expand(uint64_t mask, uint64_t value) {
+    uint64_t fill = 0;
+    for (uint64_t bit_index = 0; bit_index < 48; bit_index++) {
+        if (mask & 1) {
+            fill |= (value & 1) << bit_index;
+            value >>= 1;
+        }
+        mask >>= 1;
+    }
+    return fill;
+}
+
+// recovers the key from a state producing the first aR and tests it against the second pair,
+// or against the keystream after the first one
+static void ht2crack5_try_state(const ht2crack5_ctx_t *ctx, uint64_t s) {
+    ht2crack5_job_t *job = (ht2crack5_job_t *)ctx->data;
+    hitag_state_t hstate;
+    uint32_t b = 0;
+
+    hstate.shiftreg = s;
+    hstate.lfsr = 0;
+
+    uint64_t keyrev = hstate.shiftreg & 0xffff;
+    uint64_t nR1xk = (hstate.shiftreg >> 16) & 0xffffffff;
+    for (int i = 0; i < 32; i++) {
+        hstate.shiftreg = ((hstate.shiftreg) << 1) | ((job->uid >> (31 - i)) & 0x1);
+        b = (b << 1) | ht2_fnf(hstate.shiftreg);
+    }
+    keyrev |= (nR1xk ^ job->nR1 ^ b) << 16;
+
+    bool match;
+    if (job->use_ks) {
+        ht2_hitag2_init_ex(&hstate, keyrev, job->uid, job->nR1);
+        ht2_hitag2_nstep(&hstate, 64);      // aR, encrypted page 3
+        match = (ht2_hitag2_nstep(&hstate, 32) == job->ks);
+    } else {
+        ht2_hitag2_init_ex(&hstate, keyrev, job->uid, job->nR2);
+        match = ((job->aR2 ^ ht2_hitag2_nstep(&hstate, 32)) == 0xffffffff);
+    }
+
+    if (match) {
+        if (__atomic_exchange_n(&job->found, true, __ATOMIC_SEQ_CST) == false) {
+            job->key = REV64(keyrev);
+        }
+    }
+}
+
+static void ht2crack5_candidate(uint32_t item, uint32_t worker, void *x) {
+    const ht2crack5_ctx_t *ctx = (const ht2crack5_ctx_t *)x;
+    ht2crack5_job_t *job = (ht2crack5_job_t *)ctx->data;
+
+    if (__atomic_load_n(&job->found, __ATOMIC_SEQ_CST) || __atomic_load_n(&job->abort, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+
+    job->find(ctx, item);
+
+    uint32_t done = __atomic_add_fetch(&job->done, 1, __ATOMIC_SEQ_CST);
+    if ((done % job->step) == 0) {
+        PrintAndLogEx(INPLACE, "Searched " _YELLOW_("%3u") "%% of the layer 0 candidates", (uint32_t)(((uint64_t)done * 100) / ctx->num_candidates));
+    }
+
+    // the keyboard is only polled from one thread
+    if ((worker == 0) && ((done & 0x3ff) == 0) && kbd_enter_pressed()) {
+        __atomic_store_n(&job->abort, true, __ATOMIC_SEQ_CST);
+    }
+}
+
+static int ht2crack5_run(ht2crack5_job_t *job, uint32_t aR1, uint8_t *key) {
+    job->find = ht2crack5_find_select();
+
+    // on the stack, the bitslices need their vector alignment
+    ht2crack5_ctx_t bs_ctx;
+    ht2crack5_ctx_t *ctx = &bs_ctx;
+    memset(ctx, 0, sizeof(bs_ctx));
+
+    uint64_t *candidates = calloc(HT2CRACK5_LAYER0, sizeof(uint64_t));
+    if (candidates == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    // bitslice the inverted target, i.e. aR1 itself, most significant bit first
+    for (int i = 0; i < 32; i++) {
+        memset(ctx->keystream[i], ((aR1 >> (31 - i)) & 1) ? 0xff : 0x00, HT2CRACK5_VECTOR_SIZE);
+    }
+
+    // bitslice all possible 256 values in the lowest 8 bits
+    memset(ctx->initial[0], 0xaa, HT2CRACK5_VECTOR_SIZE);
+    memset(ctx->initial[1], 0xcc, HT2CRACK5_VECTOR_SIZE);
+    memset(ctx->initial[2], 0xf0, HT2CRACK5_VECTOR_SIZE);
+    size_t interval = 1;
+    for (size_t bit = 3; bit < 8; bit++) {
+        for (size_t byte = 0; byte < HT2CRACK5_VECTOR_SIZE;) {
+            for (size_t length = 0; length < interval; length++) {
+                ctx->initial[bit][byte++] = 0x00;
+            }
+            for (size_t length = 0; length < interval; length++) {
+                ctx->initial[bit][byte++] = 0xff;
+            }
+        }
+        interval <<= 1;
+    }
+
+    // layer 0, states whose output matches the first keystream bit
+    uint32_t target = ~aR1;
+    for (uint32_t i0 = 0; i0 < HT2CRACK5_LAYER0; i0++) {
+        uint64_t state0 = expand(0x5806b4a2d16c, i0);
+        if (f(state0) == target >> 31) {
+            candidates[ctx->num_candidates++] = state0;
+        }
+    }
+
+    ctx->candidates = candidates;
+    ctx->found = ht2crack5_try_state;
+    ctx->data = job;
+    job->step = MAX(ctx->num_candidates / 100, 1);
+
+    PrintAndLogEx(INFO, "Searching " _YELLOW_("%u") " layer 0 candidates on " _YELLOW_("%u") " threads... ( " _YELLOW_("<Enter>") " to abort )", ctx->num_candidates, hn_pool_workers());
+
+    uint64_t t1 = msclock();
+    hn_pool_run(ctx->num_candidates, ht2crack5_candidate, ctx);
+    t1 = msclock() - t1;
+
+    PROMPT_CLEARLINE;
+    PrintAndLogEx(INFO, "Time in crack5: " _YELLOW_("%.0f") " seconds", (float)t1 / 1000.0);
+
+    free(candidates);
+
+    if (job->found) {
+        Uint6byteToMemLe(key, job->key);
+        return PM3_SUCCESS;
+    }
+    return job->abort ? PM3_EOPABORTED : PM3_ESOFT;
+}
+
+int ht2crack5(const uint8_t *uid, const uint8_t *nrar1, const uint8_t *nrar2, uint8_t *key) {
+    ht2crack5_job_t job = {
+        .uid = REV32(MemLeToUint4byte(uid)),
+        .nR1 = REV32(MemLeToUint4byte(nrar1)),
+        .nR2 = REV32(MemLeToUint4byte(nrar2)),
+        .aR2 = MemBeToUint4byte(nrar2 + 4),
+    };
+    return ht2crack5_run(&job, MemBeToUint4byte(nrar1 + 4), key);
+}
+
+int ht2crack5_keystream(const uint8_t *uid, const uint8_t *nrar, const uint8_t *ks, uint8_t *key) {
+    ht2crack5_job_t job = {
+        .uid = REV32(MemLeToUint4byte(uid)),
+        .nR1 = REV32(MemLeToUint4byte(nrar)),
+        .use_ks = true,
+        .ks = MemBeToUint4byte(ks),
+    };
+    return ht2crack5_run(&job, MemBeToUint4byte(nrar + 4), key);
+}
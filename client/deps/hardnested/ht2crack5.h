@@ -0,0 +1,36 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Hitag2 key recovery from a UID and two encrypted nR/aR pairs (crack5),
+// run on the hardnested worker pool with the SIMD core of SetSIMDInstr()
+//-----------------------------------------------------------------------------
+
+#ifndef HT2CRACK5_H__
+#define HT2CRACK5_H__
+
+#include <stdint.h>
+
+// uid    4 bytes, as the tag sends it
+// nrar1  8 bytes, {nR} {aR} of the first authentication, as sniffed
+// nrar2  8 bytes, {nR} {aR} of a second authentication
+// key    6 bytes out
+// returns PM3_SUCCESS with the key, PM3_ESOFT when no key fits, PM3_EOPABORTED
+int ht2crack5(const uint8_t *uid, const uint8_t *nrar1, const uint8_t *nrar2, uint8_t *key);
+
+// the same search, with the keystream crack1 / crack2 recover instead of a second pair
+// ks     the first 4 bytes of that keystream, it follows aR and the tag's encrypted page 3
+int ht2crack5_keystream(const uint8_t *uid, const uint8_t *nrar, const uint8_t *ks, uint8_t *key);
+
+#endif
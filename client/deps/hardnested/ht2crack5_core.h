@@ -0,0 +1,57 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Hitag2 state search of tools/hitag2crack/crack5 (HiTag2 Hell by
+// FactorIT B.V.), compiled once per instruction set like the hardnested cores
+// and selected at runtime with SetSIMDInstr() / GetSIMDInstrAuto().
+//-----------------------------------------------------------------------------
+
+#ifndef HT2CRACK5_CORE_H__
+#define HT2CRACK5_CORE_H__
+
+#include <stdint.h>
+
+// the search enumerates the lowest 8 state bits in one 256 bit vector, on every instruction set
+#define HT2CRACK5_BITSLICES    256
+#define HT2CRACK5_VECTOR_SIZE  (HT2CRACK5_BITSLICES / 8)
+
+typedef struct ht2crack5_ctx ht2crack5_ctx_t;
+
+// called for every 48 bit state producing the first keystream
+typedef void ht2crack5_found_t(const ht2crack5_ctx_t *ctx, uint64_t state);
+
+struct ht2crack5_ctx {
+    uint8_t keystream[32][HT2CRACK5_VECTOR_SIZE] __attribute__((aligned(HT2CRACK5_VECTOR_SIZE)));   // bitsliced ~aR1
+    uint8_t initial[8][HT2CRACK5_VECTOR_SIZE] __attribute__((aligned(HT2CRACK5_VECTOR_SIZE)));      // all values of the lowest 8 bits
+    const uint64_t *candidates;     // layer 0 states matching the first keystream bit
+    uint32_t num_candidates;
+    ht2crack5_found_t *found;
+    void *data;
+};
+
+// searches all states grown from layer 0 candidate 'index'
+typedef void ht2crack5_find_t(const ht2crack5_ctx_t *ctx, uint32_t index);
+ht2crack5_find_t ht2crack5_find_AVX512;
+ht2crack5_find_t ht2crack5_find_AVX2;
+ht2crack5_find_t ht2crack5_find_AVX;
+ht2crack5_find_t ht2crack5_find_SSE2;
+ht2crack5_find_t ht2crack5_find_MMX;
+ht2crack5_find_t ht2crack5_find_NEON;
+ht2crack5_find_t ht2crack5_find_NOSIMD;
+
+// the core for the instruction set from GetSIMDInstrAuto(), there is no OpenCL one
+ht2crack5_find_t *ht2crack5_find_select(void);
+
+#endif
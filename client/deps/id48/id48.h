@@ -200,6 +200,37 @@ bool id48lib_key_recovery_next(
     ID48LIB_KEY *potential_key_output
 );
 
+/// <summary>
+/// Finds all potential keys whose bits K₄₇..K₄₀ are
+/// `k47_to_k40`, i.e. 1/256 of the search done by the
+/// init() / next() functions.  Keeps no global state,
+/// so the 256 partitions can be searched by as many
+/// threads at once, and several authentications too.
+/// </summary>
+/// <param name="input_partial_key">As for init().</param>
+/// <param name="input_nonce">As for init().</param>
+/// <param name="input_frn">As for init().</param>
+/// <param name="input_grn">As for init().</param>
+/// <param name="k47_to_k40">The partition, from 0 to 255.</param>
+/// <param name="potential_keys_output">
+/// Caller-provided array, filled with up to
+/// `max_potential_keys` potential keys, in
+/// ascending order.
+/// </param>
+/// <returns>
+/// The number of potential keys in the partition,
+/// which may be more than `max_potential_keys`.
+/// </returns>
+size_t id48lib_key_recovery_partition(
+    const ID48LIB_KEY *input_partial_key,
+    const ID48LIB_NONCE *input_nonce,
+    const ID48LIB_FRN *input_frn,
+    const ID48LIB_GRN *input_grn,
+    uint8_t k47_to_k40,
+    ID48LIB_KEY *potential_keys_output,
+    size_t max_potential_keys
+);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -105,6 +105,18 @@ typedef struct _RECOVERY_STATE {
     /// </summary>
     ID48LIB_NONCE known_nonce;
     /// <summary>
+    /// Key bits K₄₇..K₀₀ where the search starts.  Zero, or K₄₇..K₄₀
+    /// of the partition when only searching 1/256 of the keys.
+    /// Constant after initialization.
+    /// </summary>
+    KEY_BITS_K47_TO_K00 first_key;
+    /// <summary>
+    /// How many of the low key bits are searched: 48, or 40 when
+    /// K₄₇..K₄₀ are fixed by the partition.
+    /// Constant after initialization.
+    /// </summary>
+    uint8_t search_bits;
+    /// <summary>
     /// boolean to identify first run after initialization (an edge case)
     /// </summary>
     bool is_fresh_initialization;
@@ -221,32 +233,32 @@ static bool validate_output_from_additional_fifteen_zero_bits(RECOVERY_STATE *s)
 }
 
 
-// intentionally declare this global state only here, as a way
-// of forcing the above functions to act on a pointer.  Ensuring
-// the above routines don't inadvertently use the global state
-// makes it easier to enable a multi-threaded version.
-RECOVERY_STATE g_S = { 0 };
-
 static void init(
+    RECOVERY_STATE       *s,
     const ID48LIB_KEY    *input_partial_key,
     const ID48LIB_NONCE *input_nonce,
     const ID48LIB_FRN    *input_frn,
-    const ID48LIB_GRN    *input_grn
+    const ID48LIB_GRN    *input_grn,
+    uint8_t              search_bits,
+    uint8_t              k47_to_k40
 ) {
-    memset(&g_S, 0, sizeof(RECOVERY_STATE));
-    memset(&(g_S.states[0]), 0xAA, sizeof(ID48LIBX_STATE_REGISTERS) * MAXIMUM_STATE_HISTORY);
-    g_S.known_k95_to_k48.k[0] = input_partial_key->k[0];
-    g_S.known_k95_to_k48.k[1] = input_partial_key->k[1];
-    g_S.known_k95_to_k48.k[2] = input_partial_key->k[2];
-    g_S.known_k95_to_k48.k[3] = input_partial_key->k[3];
-    g_S.known_k95_to_k48.k[4] = input_partial_key->k[4];
-    g_S.known_k95_to_k48.k[5] = input_partial_key->k[5];
-    g_S.known_nonce = *input_nonce;
-    g_S.expected_output_bits = create_expected_output_bits(input_frn, input_grn);
-    g_S.more_keys_to_test = true;
-    g_S.is_fresh_initialization = true;
+    memset(s, 0, sizeof(RECOVERY_STATE));
+    memset(&(s->states[0]), 0xAA, sizeof(ID48LIBX_STATE_REGISTERS) * MAXIMUM_STATE_HISTORY);
+    s->known_k95_to_k48.k[0] = input_partial_key->k[0];
+    s->known_k95_to_k48.k[1] = input_partial_key->k[1];
+    s->known_k95_to_k48.k[2] = input_partial_key->k[2];
+    s->known_k95_to_k48.k[3] = input_partial_key->k[3];
+    s->known_k95_to_k48.k[4] = input_partial_key->k[4];
+    s->known_k95_to_k48.k[5] = input_partial_key->k[5];
+    s->known_nonce = *input_nonce;
+    s->expected_output_bits = create_expected_output_bits(input_frn, input_grn);
+    s->first_key.Raw = (search_bits < 48) ? ((uint64_t)k47_to_k40 << 40) : 0ull;
+    s->search_bits = search_bits;
+    s->more_keys_to_test = true;
+    s->is_fresh_initialization = true;
 }
 static bool get_next_potential_key(
+    RECOVERY_STATE *s,
     ID48LIB_KEY *potential_key_output
 ) {
     memset(potential_key_output, 0, sizeof(ID48LIB_KEY));
@@ -265,7 +277,7 @@ static bool get_next_potential_key(
     //        bit that was zero.
 
     // Early exit when no more keys to test
-    if (!g_S.more_keys_to_test) {
+    if (!s->more_keys_to_test) {
         return false;
     }
 
@@ -273,19 +285,21 @@ static bool get_next_potential_key(
     int8_t current_key_bit_shift;
 
     // Setup the next key to be tested.
-    if (g_S.is_fresh_initialization) {
-        // first-time init is easy: key is zero, and zero bits set
-        g_S.is_fresh_initialization = false;
-        k_low.Raw = 0ull;
+    if (s->is_fresh_initialization) {
+        // first-time init is easy: key is zero (or the partition), and zero bits set
+        s->is_fresh_initialization = false;
+        k_low = s->first_key;
         current_key_bit_shift = 47;
     } else {
         // by definition, a returned potential key had all the bits defined
         current_key_bit_shift = 0;
-        k_low = g_S.last_returned_potential_key;
+        k_low = s->last_returned_potential_key;
 
-        // edge case: returned potential key 0xFFFFFFFFFFFFull, so no more keys to be tested!
-        if (k_low.Raw == 0xFFFFFFFFFFFFull) {
-            g_S.more_keys_to_test = false;
+        // edge case: returned potential key 0xFFFFFFFFFFFFull (or last of the partition),
+        // so no more keys to be tested!
+        const uint64_t search_mask = (1ull << s->search_bits) - 1u;
+        if ((k_low.Raw & search_mask) == search_mask) {
+            s->more_keys_to_test = false;
             return false;
         }
 
@@ -317,7 +331,7 @@ static bool get_next_potential_key(
         ASSERT(current_key_bit_shift < 48);
         // Anytime bit shift is 40+, changes would affect s00 ...
         if (current_key_bit_shift > 39) {
-            restart_and_calculate_s00(&g_S, &k_low);
+            restart_and_calculate_s00(s, &k_low);
             current_key_bit_shift = 39; // k47..k40 used to get to s00
         }
 
@@ -327,8 +341,8 @@ static bool get_next_potential_key(
         while (current_key_bit_shift > 32) { // k39..k33 used to move from s00-->s07
             uint8_t src_idx = 39 - current_key_bit_shift;
             bool input_bit = !!(((uint8_t)(k_low.Raw >> current_key_bit_shift)) & 0x1u);
-            ID48LIBX_SUCCESSOR_RESULT r = successor_fn(&(g_S.states[src_idx]), input_bit);
-            g_S.states[src_idx + 1] = r.state;
+            ID48LIBX_SUCCESSOR_RESULT r = successor_fn(&(s->states[src_idx]), input_bit);
+            s->states[src_idx + 1] = r.state;
             --current_key_bit_shift;
         }
 
@@ -339,11 +353,11 @@ static bool get_next_potential_key(
         // Check if the current state + current key bit (as stored) gives expected result.
         const uint8_t src_idx = 39 - current_key_bit_shift;
         bool input_bit = !!(((uint8_t)(k_low.Raw >> current_key_bit_shift)) & 0x1u);
-        ID48LIBX_SUCCESSOR_RESULT r = successor_fn(&(g_S.states[src_idx]), input_bit);
+        ID48LIBX_SUCCESSOR_RESULT r = successor_fn(&(s->states[src_idx]), input_bit);
         // can unconditionally overwrite next state...
-        g_S.states[src_idx + 1] = r.state;
+        s->states[src_idx + 1] = r.state;
 
-        bool expected_result = get_expected_output_bit(&g_S, src_idx);
+        bool expected_result = get_expected_output_bit(s, src_idx);
         bool matched = expected_result == (!!r.output);
         // when matched the last bit, actually check the next 15x inputs (all zero) as well
         if (matched && current_key_bit_shift == 0) {
@@ -351,18 +365,18 @@ static bool get_next_potential_key(
             // but, must also test 15x additional zero bit inputs before
             // reporting that this may be a potential key
             ASSERT(src_idx == 39);
-            matched = validate_output_from_additional_fifteen_zero_bits(&g_S);
+            matched = validate_output_from_additional_fifteen_zero_bits(s);
         }
 
         // Exit point ... found a potential key!
         if (matched && current_key_bit_shift == 0) {
-            g_S.last_returned_potential_key = k_low;
-            potential_key_output->k[ 0] = g_S.known_k95_to_k48.k[0];
-            potential_key_output->k[ 1] = g_S.known_k95_to_k48.k[1];
-            potential_key_output->k[ 2] = g_S.known_k95_to_k48.k[2];
-            potential_key_output->k[ 3] = g_S.known_k95_to_k48.k[3];
-            potential_key_output->k[ 4] = g_S.known_k95_to_k48.k[4];
-            potential_key_output->k[ 5] = g_S.known_k95_to_k48.k[5];
+            s->last_returned_potential_key = k_low;
+            potential_key_output->k[ 0] = s->known_k95_to_k48.k[0];
+            potential_key_output->k[ 1] = s->known_k95_to_k48.k[1];
+            potential_key_output->k[ 2] = s->known_k95_to_k48.k[2];
+            potential_key_output->k[ 3] = s->known_k95_to_k48.k[3];
+            potential_key_output->k[ 4] = s->known_k95_to_k48.k[4];
+            potential_key_output->k[ 5] = s->known_k95_to_k48.k[5];
             potential_key_output->k[ 6] = (uint8_t)(k_low.Raw >> (8 * 5));
             potential_key_output->k[ 7] = (uint8_t)(k_low.Raw >> (8 * 4));
             potential_key_output->k[ 8] = (uint8_t)(k_low.Raw >> (8 * 3));
@@ -379,7 +393,7 @@ static bool get_next_potential_key(
         // Backtrack to find next one to be tested.
         else {
             // not required ... but makes debugging easier
-            memset(&g_S.states[src_idx + 1], 0xAA, sizeof(ID48LIBX_STATE_REGISTERS));
+            memset(&s->states[src_idx + 1], 0xAA, sizeof(ID48LIBX_STATE_REGISTERS));
 
             // that bit of the key results in wrong output.
             // backtrack until the next zero bit, flip it to one, and
@@ -398,10 +412,10 @@ static bool get_next_potential_key(
                 k_low.Raw ^= mask;
             }
 
-            // EXIT CONDITION: k_low wraps to invalid value
-            if (current_key_bit_shift >= 48) {
+            // EXIT CONDITION: k_low wraps to invalid value (or out of the partition)
+            if (current_key_bit_shift >= s->search_bits) {
                 // no more results available ... return!
-                g_S.more_keys_to_test = false;
+                s->more_keys_to_test = false;
                 return 0u;
             }
 
@@ -422,16 +436,41 @@ static bool get_next_potential_key(
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
+// state of the iterator API, the partition API keeps its own on the stack
+static RECOVERY_STATE g_S = { 0 };
+
 void id48lib_key_recovery_init(
     const ID48LIB_KEY    *input_partial_key,
     const ID48LIB_NONCE *input_nonce,
     const ID48LIB_FRN    *input_frn,
     const ID48LIB_GRN    *input_grn
 ) {
-    init(input_partial_key, input_nonce, input_frn, input_grn);
+    init(&g_S, input_partial_key, input_nonce, input_frn, input_grn, 48, 0);
 }
 bool id48lib_key_recovery_next(
     ID48LIB_KEY *potential_key_output
 ) {
-    return get_next_potential_key(potential_key_output);
+    return get_next_potential_key(&g_S, potential_key_output);
+}
+size_t id48lib_key_recovery_partition(
+    const ID48LIB_KEY    *input_partial_key,
+    const ID48LIB_NONCE *input_nonce,
+    const ID48LIB_FRN    *input_frn,
+    const ID48LIB_GRN    *input_grn,
+    uint8_t              k47_to_k40,
+    ID48LIB_KEY          *potential_keys_output,
+    size_t               max_potential_keys
+) {
+    RECOVERY_STATE s;
+    init(&s, input_partial_key, input_nonce, input_frn, input_grn, 40, k47_to_k40);
+
+    size_t count = 0;
+    ID48LIB_KEY q;
+    while (get_next_potential_key(&s, &q)) {
+        if (count < max_potential_keys) {
+            potential_keys_output[count] = q;
+        }
+        ++count;
+    }
+    return count;
 }
@@ -10,6 +10,7 @@ add_library(pm3rrg_rdv4_reveng STATIC
 target_compile_definitions(pm3rrg_rdv4_reveng PRIVATE PRESETS)
 target_include_directories(pm3rrg_rdv4_reveng PRIVATE
         cliparser
+        hardnested
         ../src
         ../../include)
 target_include_directories(pm3rrg_rdv4_reveng INTERFACE reveng)
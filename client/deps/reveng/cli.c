@@ -62,11 +62,17 @@
 #  endif /* STDIN_FILENO */
 #endif /* _WIN32 */
 
+#include <pthread.h>
 #include "reveng.h"
+#include "hardnested_pool.h"
 
 static FILE *oread(const char *);
 static poly_t rdpoly(const char *, int, int);
 static void usage(void);
+static int preveng(const model_t *guess, const poly_t qpoly, int rflags, int args, const poly_t *argpolys);
+
+/* ufound() and the progress report are called from the search workers */
+static pthread_mutex_t ulock = PTHREAD_MUTEX_INITIALIZER;
 
 static const char *myname = "reveng"; /* name of our program */
 
@@ -84,7 +90,7 @@ int reveng_main(int argc, char *argv[]) {
     unsigned long width = 0UL;
     int c, mode = 0, args, psets, pass;
     poly_t apoly, crc, qpoly = PZERO, *apolys, *pptr = NULL, *qptr = NULL;
-    model_t pset = model, *candmods, *mptr;
+    model_t pset = model;
     char *string;
 
     myname = argv[0];
@@ -481,21 +487,11 @@ ipqx:
             }
             pass = 0;
             do {
-                mptr = candmods = reveng(&model, qpoly, rflags, args, apolys);
-                if (mptr && plen(mptr->spoly)) {
+                /* results are printed by the callback */
+                if (preveng(&model, qpoly, rflags, args, apolys) > 0) {
                     uflags |= C_RESULT;
                 }
 
-                while (mptr && plen(mptr->spoly)) {
-                    /* results were printed by the callback
-                     * string = mtostr(mptr);
-                     * puts(string);
-                     * free(string);
-                     */
-                    mfree(mptr++);
-                }
-                free(candmods);
-
                 if (~rflags & R_HAVERI) {
                     model.flags ^= P_REFIN | P_REFOUT;
                     for (qptr = apolys; qptr < pptr; ++qptr) {
@@ -530,7 +526,9 @@ ufound(const model_t *model) {
     if (!model) return;
     /* generated models will be canonical */
     string = mtostr(model);
+    pthread_mutex_lock(&ulock);
     puts(string);
+    pthread_mutex_unlock(&ulock);
     free(string);
 }
 
@@ -560,6 +558,121 @@ uprog(const poly_t gpoly, int flags, unsigned long seq) {
     free(string);
 }
 
+/* Parallel brute force search.
+ * The poly space is cut into PR_CHUNKS ranges on the top PR_BITS bits of
+ * the poly, each range is a plain reveng() call with a start poly and a
+ * range end (R_HAVEQ) run on the hardnested worker pool. A -p / -q range
+ * given by the user is honoured by clipping the chunks to it.
+ * Models are reported by ufound() as they are found, so their order
+ * varies between runs.
+ */
+#define PR_BITS     8
+#define PR_CHUNKS   (1UL << PR_BITS)
+#define PR_MINWIDTH 12
+
+typedef struct {
+    const model_t *guess;
+    const poly_t *qpoly;
+    int rflags;
+    int args;
+    const poly_t *argpolys;
+    int found;
+    unsigned long done;
+    unsigned long step;
+} preveng_t;
+
+static poly_t
+prchunk(unsigned long width, unsigned long chunk) {
+    /* poly of width bits with the chunk number in its top PR_BITS bits */
+    poly_t poly = PZERO;
+    palloc(&poly, width);
+    if (poly.bitmap)
+        *poly.bitmap |= (bmp_t) chunk << (BMP_BIT - PR_BITS);
+    return (poly);
+}
+
+static void
+prsearch(uint32_t item, uint32_t worker, void *ctx) {
+    preveng_t *pr = (preveng_t *) ctx;
+    model_t guess = *pr->guess;
+    unsigned long width = plen(guess.spoly);
+    poly_t lo, hi = PZERO, *end = NULL;
+    model_t *candmods, *mptr;
+    int rflags = pr->rflags & ~R_HAVEQ, found = 0;
+    (void) worker;
+
+    /* range start, never below the user's start poly */
+    lo = prchunk(width, item);
+    if (pcmp(&lo, &guess.spoly) < 0)
+        pcpy(&lo, guess.spoly);
+
+    /* range end, never above the user's -q poly */
+    if (item + 1UL < PR_CHUNKS) {
+        hi = prchunk(width, item + 1UL);
+        end = &hi;
+    }
+    if (pr->rflags & R_HAVEQ && (!end || pcmp(pr->qpoly, end) < 0))
+        end = (poly_t *) pr->qpoly;
+
+    if (!end || pcmp(&lo, end) < 0) {
+        if (end)
+            rflags |= R_HAVEQ;
+        guess.spoly = lo;
+        mptr = candmods = reveng(&guess, end ? *end : hi, rflags, pr->args, pr->argpolys);
+        while (mptr && plen(mptr->spoly)) {
+            ++found;
+            mfree(mptr++);
+        }
+        free(candmods);
+    }
+    pfree(&lo);
+    pfree(&hi);
+
+    pthread_mutex_lock(&ulock);
+    pr->found += found;
+    if (++pr->done % pr->step == 0)
+        fprintf(stderr, "%s: searching: width=%lu  refin=%s  refout=%s  %3lu%%\n",
+                myname,
+                width,
+                ((guess.flags & P_REFIN) ? "true" : "false"),
+                ((guess.flags & P_REFOUT) ? "true" : "false"),
+                (pr->done * 100UL) / PR_CHUNKS
+               );
+    pthread_mutex_unlock(&ulock);
+}
+
+static int
+preveng(const model_t *guess, const poly_t qpoly, int rflags, int args, const poly_t *argpolys) {
+    /* Runs reveng() over all cores when the poly is searched for,
+     * returns the number of models found.
+     */
+    model_t *candmods, *mptr;
+    int found = 0;
+
+    if (rflags & R_HAVEP || plen(guess->spoly) < PR_MINWIDTH || hn_pool_workers() < 2) {
+        mptr = candmods = reveng(guess, qpoly, rflags, args, argpolys);
+        while (mptr && plen(mptr->spoly)) {
+            ++found;
+            mfree(mptr++);
+        }
+        free(candmods);
+        return (found);
+    }
+
+    preveng_t pr = {
+        .guess = guess,
+        .qpoly = &qpoly,
+        .rflags = rflags,
+        .args = args,
+        .argpolys = argpolys,
+        .found = 0,
+        .done = 0,
+        .step = PR_CHUNKS / 16UL,
+    };
+    hn_pool_run(PR_CHUNKS, prsearch, &pr);
+    return (pr.found);
+}
+
 static poly_t
 rdpoly(const char *name, int flags, int bperhx) {
     /* read poly from file in chunks and report errors */
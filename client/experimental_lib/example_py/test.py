@@ -20,3 +20,14 @@ prefs = json.loads(p.grabbed_output)
 print("Save path: ", prefs['file.default.savepath'])
 print("Dump path: ", prefs['file.default.dumppath'])
 print("Trace path:", prefs['file.default.tracepath'])
+
+print("Structured results, no output parsing:")
+p.console("hf 14a reader", capture=False)
+res = json.loads(p.result)
+if 'uid' in res:
+    print("UID:", res['uid'], "SAK:", res['sak'])
+
+print("Emulator memory in one bulk transfer:")
+eml = bytearray(1024)
+if p.mem_read(pm3.MEM_EML, 0, eml) == 0:
+    print("Block 0:", eml[:16].hex())
@@ -17,13 +17,42 @@
 #define LIBPM3_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef struct pm3_device pm3;
 
+// Every pm3_open returns its own device, several Proxmark3 can be used from one process.
+// Calls on a device select it first, commands are run on one device at a time.
 pm3 *pm3_open(const char *port);
 int pm3_console(pm3 *dev, const char *cmd, bool capture, bool quiet);
 const char *pm3_grabbed_output_get(pm3 *dev);
+// Results of the last pm3_console call as a JSON object, e.g. {"uid":"04A1B2C3","sak":8}.
+// No text parsing needed, a key reported several times holds an array
+const char *pm3_result_get(pm3 *dev);
 const char *pm3_name_get(pm3 *dev);
 void pm3_close(pm3 *dev);
 pm3 *pm3_get_current_dev(void);
+
+// Asynchronous commands: submit, get a ticket, poll or wait for the reply later.
+// Replies are matched on reply_cmd, in submission order.
+int pm3_async_send(pm3 *dev, uint16_t cmd, const char *data, size_t len, uint16_t reply_cmd);
+int pm3_async_poll(pm3 *dev, int ticket);
+int pm3_async_wait(pm3 *dev, int ticket, int timeout);
+int pm3_async_status(pm3 *dev);
+const char *pm3_async_data_get(pm3 *dev);
+void pm3_async_cancel(pm3 *dev, int ticket);
+
+// Raw packets, so scripts can skip the CLI. pm3_reply_get copies the payload of the last
+// reply, from pm3_exchange or an async one, and returns its length
+int pm3_send(pm3 *dev, uint16_t cmd, const char *data, size_t len);
+int pm3_exchange(pm3 *dev, uint16_t cmd, const char *data, size_t len, int timeout);
+int pm3_reply_get(pm3 *dev, char *buf, size_t size);
+
+// Bulk memory transfers
+#define PM3_MEM_BIGBUF  0
+#define PM3_MEM_EML     1
+#define PM3_MEM_FLASH   2
+int pm3_mem_read(pm3 *dev, int mem, uint32_t offset, char *buf, size_t size);
+int pm3_mf_eml_write(pm3 *dev, int block, const char *data, size_t len);
 #endif // LIBPM3_H
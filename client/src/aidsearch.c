@@ -22,35 +22,24 @@
 #include "pm3_cmd.h"
 
 static int openAIDFile(json_t **root, bool verbose) {
-    json_error_t error;
-
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, "aidlist", ".json", false);
+    const char *path;
+    int res = loadResourceJSON("aidlist", false, root, &path);
     if (res != PM3_SUCCESS) {
-        return PM3_EFILE;
-    }
-
-    int retval = PM3_SUCCESS;
-    *root = json_load_file(path, 0, &error);
-    if (!*root) {
-        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
-        retval = PM3_ESOFT;
-        goto out;
+        return res;
     }
 
     if (!json_is_array(*root)) {
         PrintAndLogEx(ERR, "Invalid json (%s) format. root must be an array.", path);
-        retval = PM3_ESOFT;
-        goto out;
+        json_decref(*root);
+        *root = NULL;
+        return PM3_ESOFT;
     }
 
     PrintAndLogEx(DEBUG, "Loaded file " _YELLOW_("%s") " " _GREEN_("%zu") " records ( " _GREEN_("ok") " )"
                   , path
                   , json_array_size(*root)
                  );
-out:
-    free(path);
-    return retval;
+    return PM3_SUCCESS;
 }
 
 static int closeAIDFile(json_t *root) {
@@ -100,15 +89,108 @@ static const char *jsonStrGet(json_t *data, const char *name) {
     return cstr;
 }
 
-static bool aidCompare(const char *aidlarge, const char *aidsmall) {
-    if (strcmp(aidlarge, aidsmall) == 0)
+// Sorted AID index over the records of one aidlist root, built on first lookup.
+// The index holds a reference on its root, the resource cache hands out the same
+// root every time, so it is only rebuilt when a different list is searched.
+typedef struct {
+    const char *aid;
+    size_t pos;
+    json_t *elm;
+} aid_index_entry_t;
+
+static struct {
+    json_t *root;
+    size_t count;
+    aid_index_entry_t *entries;
+} aid_index;
+
+static int aidIndexCmp(const void *a, const void *b) {
+    const aid_index_entry_t *ea = a;
+    const aid_index_entry_t *eb = b;
+    int res = strcmp(ea->aid, eb->aid);
+    if (res) {
+        return res;
+    }
+    return (ea->pos > eb->pos) - (ea->pos < eb->pos);
+}
+
+static bool aidIndexBuild(json_t *root) {
+    if (aid_index.root == root) {
         return true;
+    }
+
+    free(aid_index.entries);
+    aid_index.entries = NULL;
+    aid_index.count = 0;
+    json_decref(aid_index.root);
+    aid_index.root = NULL;
+
+    size_t n = json_array_size(root);
+    aid_index.entries = calloc(n ? n : 1, sizeof(aid_index_entry_t));
+    if (aid_index.entries == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return false;
+    }
+
+    for (size_t elmindx = 0; elmindx < n; elmindx++) {
+        json_t *data = AIDSearchGetElm(root, elmindx);
+        if (data == NULL) {
+            continue;
+        }
+        const char *dictaid = jsonStrGet(data, "AID");
+        if (dictaid == NULL) {
+            continue;
+        }
+        aid_index_entry_t *e = &aid_index.entries[aid_index.count++];
+        e->aid = dictaid;
+        e->pos = elmindx;
+        e->elm = data;
+    }
 
-    if (strlen(aidlarge) > strlen(aidsmall))
-        if (strncmp(aidlarge, aidsmall, strlen(aidsmall)) == 0)
-            return true;
+    qsort(aid_index.entries, aid_index.count, sizeof(aid_index_entry_t), aidIndexCmp);
+    aid_index.root = json_incref(root);
+    return true;
+}
 
-    return false;
+// first record, in list order, whose AID is exactly the first `len` chars of aid
+static json_t *aidIndexGet(const char *aid, size_t len) {
+    size_t lo = 0, hi = aid_index.count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const char *key = aid_index.entries[mid].aid;
+        int res = strncmp(key, aid, len);
+        if (res == 0 && key[len] != '\0') {
+            res = 1;
+        }
+        if (res < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo < aid_index.count) {
+        const char *key = aid_index.entries[lo].aid;
+        if (strncmp(key, aid, len) == 0 && key[len] == '\0') {
+            return aid_index.entries[lo].elm;
+        }
+    }
+    return NULL;
+}
+
+// longest dictionary AID which is the requested aid or a prefix of it
+static json_t *aidIndexFind(json_t *root, const char *aid) {
+    if (aid == NULL || aidIndexBuild(root) == false) {
+        return NULL;
+    }
+
+    for (size_t len = strlen(aid); len > 0; len--) {
+        json_t *elm = aidIndexGet(aid, len);
+        if (elm) {
+            return elm;
+        }
+    }
+    return NULL;
 }
 
 bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
@@ -135,21 +217,7 @@ int PrintAIDDescription(json_t *xroot, char *aid, bool verbose) {
         goto out;
     }
 
-    json_t *elm = NULL;
-    size_t maxaidlen = 0;
-    for (size_t elmindx = 0; elmindx < json_array_size(root); elmindx++) {
-        json_t *data = AIDSearchGetElm(root, elmindx);
-        if (data == NULL) {
-            continue;
-        }
-        const char *dictaid = jsonStrGet(data, "AID");
-        if (aidCompare(aid, dictaid)) {  // dictaid may be less length than requested aid
-            if (maxaidlen < strlen(dictaid) && strlen(dictaid) <= strlen(aid)) {
-                maxaidlen = strlen(dictaid);
-                elm = data;
-            }
-        }
-    }
+    json_t *elm = aidIndexFind(root, aid);
 
     if (elm == NULL) {
         goto out;
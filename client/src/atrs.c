@@ -18,52 +18,130 @@
 #include "atrs.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include "commonutil.h" // ARRAYLEN
 #include "ui.h"         // PrintAndLogEx
 
-// get a ATR description based on the atr bytes
-// returns description of the best match
-const char *getAtrInfo(const char *atr_str) {
+// Lookup index over AtrTable, built on first use.
+// Plain patterns are sorted by their bytes, wildcard patterns by length and then by
+// descending table position, so both keep the answer of a walk in table order:
+// the first exact match, else the last wildcard match.
+static struct {
+    bool ready;
+    size_t n_exact;
+    size_t n_wild;
+    uint16_t *exact;
+    uint16_t *wild;
+} atr_index;
 
-    size_t slen = strlen(atr_str);
-    int match = -1;
+static int atr_exact_cmp(const void *a, const void *b) {
+    uint16_t ia = *(const uint16_t *)a;
+    uint16_t ib = *(const uint16_t *)b;
+    int res = strcmp(AtrTable[ia].bytes, AtrTable[ib].bytes);
+    if (res) {
+        return res;
+    }
+    return (ia > ib) - (ia < ib);
+}
+
+static int atr_wild_cmp(const void *a, const void *b) {
+    uint16_t ia = *(const uint16_t *)a;
+    uint16_t ib = *(const uint16_t *)b;
+    size_t la = strlen(AtrTable[ia].bytes);
+    size_t lb = strlen(AtrTable[ib].bytes);
+    if (la != lb) {
+        return (la > lb) - (la < lb);
+    }
+    return (ia < ib) - (ia > ib);
+}
+
+static bool atr_index_build(void) {
+    if (atr_index.ready) {
+        return true;
+    }
 
     // skip last element of AtrTable
-    for (size_t i = 0; i < ARRAYLEN(AtrTable) - 1; ++i) {
+    size_t n = ARRAYLEN(AtrTable) - 1;
+    atr_index.exact = calloc(n, sizeof(uint16_t));
+    atr_index.wild = calloc(n, sizeof(uint16_t));
+    if (atr_index.exact == NULL || atr_index.wild == NULL) {
+        free(atr_index.exact);
+        free(atr_index.wild);
+        atr_index.exact = NULL;
+        atr_index.wild = NULL;
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return false;
+    }
 
-        if (strlen(AtrTable[i].bytes) != slen) {
-            continue;
+    for (size_t i = 0; i < n; ++i) {
+        if (strchr(AtrTable[i].bytes, '.') != NULL) {
+            atr_index.wild[atr_index.n_wild++] = i;
+        } else {
+            atr_index.exact[atr_index.n_exact++] = i;
         }
+    }
 
-        if (strstr(AtrTable[i].bytes, ".") != NULL) {
+    qsort(atr_index.exact, atr_index.n_exact, sizeof(uint16_t), atr_exact_cmp);
+    qsort(atr_index.wild, atr_index.n_wild, sizeof(uint16_t), atr_wild_cmp);
+    atr_index.ready = true;
+    return true;
+}
 
-            char *tmp_atr = calloc(slen, sizeof(uint8_t));
-            if (tmp_atr == NULL) {
-                PrintAndLogEx(WARNING, "Failed to allocate memory");
-                return NULL;
-            }
+static bool atr_wild_match(const char *pattern, const char *atr_str, size_t slen) {
+    for (size_t j = 0; j < slen; j++) {
+        if (pattern[j] != '.' && pattern[j] != atr_str[j]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// get a ATR description based on the atr bytes
+// returns description of the best match
+const char *getAtrInfo(const char *atr_str) {
 
-            for (size_t j = 0; j < slen; j++) {
-                tmp_atr[j] = (AtrTable[i].bytes[j] == '.') ? '.' : atr_str[j];
-            }
+    if (atr_index_build() == false) {
+        return NULL;
+    }
 
-            if (strncmp(tmp_atr, AtrTable[i].bytes, slen) == 0) {
-                // record partial match but continue looking for full match
-                match = i;
-            }
-            free(tmp_atr);
+    size_t slen = strlen(atr_str);
 
+    // first exact match in table order
+    size_t lo = 0, hi = atr_index.n_exact;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strcmp(AtrTable[atr_index.exact[mid]].bytes, atr_str) < 0) {
+            lo = mid + 1;
         } else {
-            if (strncmp(atr_str, AtrTable[i].bytes, slen) == 0) {
-                return AtrTable[i].desc;
-            }
+            hi = mid;
         }
     }
+    if (lo < atr_index.n_exact && strcmp(AtrTable[atr_index.exact[lo]].bytes, atr_str) == 0) {
+        return AtrTable[atr_index.exact[lo]].desc;
+    }
 
-    if (match >= 0) {
-        return AtrTable[match].desc;
-    } else {
-        //No match, return default = last element of AtrTable
-        return AtrTable[ARRAYLEN(AtrTable) - 1].desc;
+    // wildcard patterns of the same length, last one in table order first
+    lo = 0;
+    hi = atr_index.n_wild;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strlen(AtrTable[atr_index.wild[mid]].bytes) < slen) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
+    for (; lo < atr_index.n_wild; lo++) {
+        const char *pattern = AtrTable[atr_index.wild[lo]].bytes;
+        if (strlen(pattern) != slen) {
+            break;
+        }
+        if (atr_wild_match(pattern, atr_str, slen)) {
+            return AtrTable[atr_index.wild[lo]].desc;
+        }
+    }
+
+    //No match, return default = last element of AtrTable
+    return AtrTable[ARRAYLEN(AtrTable) - 1].desc;
 }
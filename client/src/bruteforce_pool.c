@@ -0,0 +1,124 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Key space engine: a bruteforce.c generator context split into shards and
+// run on the hardnested worker pool.
+//-----------------------------------------------------------------------------
+#include "bruteforce_pool.h"
+
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "hardnested_pool.h"
+#include "ui.h"                 // PrintAndLogEx
+#include "pm3_cmd.h"            // PM3_xxx
+
+// shards per worker, the pool rebalances them when key costs differ
+#define BF_POOL_SHARDS_PER_WORKER 16
+// keys between two looks at the stop flag
+#define BF_POOL_STOP_CHECK 256
+
+typedef struct {
+    const generator_context_t *gen;
+    bf_pool_fn_t fn;
+    void *ctx;
+    uint32_t shards;
+    bool show_progress;
+
+    pthread_mutex_t lock;
+    volatile bool stop;
+    bool error;
+    uint64_t tested;
+    uint32_t shards_done;
+} bf_pool_job_t;
+
+static void bf_pool_shard(uint32_t item, uint32_t worker, void *arg) {
+    bf_pool_job_t *job = (bf_pool_job_t *)arg;
+
+    if (job->stop) {
+        return;
+    }
+
+    generator_context_t gen = *job->gen;
+    int ret = bf_generator_shard(&gen, item, job->shards);
+
+    uint64_t n = 0;
+    bool stop = false;
+    while (ret == BF_GENERATOR_NEXT) {
+
+        ret = bf_generate(&gen);
+        if (ret != BF_GENERATOR_NEXT) {
+            break;
+        }
+
+        n++;
+        if (job->fn(gen.current_key, worker, job->ctx)) {
+            stop = true;
+            break;
+        }
+
+        if ((n % BF_POOL_STOP_CHECK) == 0 && job->stop) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->tested += n;
+    job->shards_done++;
+    if (stop) {
+        job->stop = true;
+    }
+    if (ret == BF_GENERATOR_ERROR) {
+        job->error = true;
+        job->stop = true;
+    }
+    if (job->show_progress && job->stop == false) {
+        PrintAndLogEx(INPLACE, "Tested " _YELLOW_("%" PRIu64) " keys ( %u%% )", job->tested, (job->shards_done * 100) / job->shards);
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+int bf_pool_run(const generator_context_t *gen, bf_pool_fn_t fn, void *ctx, bool show_progress, bf_pool_result_t *result) {
+
+    memset(result, 0, sizeof(bf_pool_result_t));
+
+    result->total = bf_generator_count(gen);
+    if (result->total == 0) {
+        return PM3_EINVARG;
+    }
+
+    bf_pool_job_t job = {
+        .gen = gen,
+        .fn = fn,
+        .ctx = ctx,
+        .show_progress = show_progress,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+    };
+
+    // no point in shards of a handful of keys
+    uint64_t shards = (uint64_t)hn_pool_workers() * BF_POOL_SHARDS_PER_WORKER;
+    job.shards = (uint32_t)MIN(shards, result->total);
+
+    hn_pool_run(job.shards, bf_pool_shard, &job);
+
+    if (show_progress) {
+        PrintAndLogEx(NORMAL, "");
+    }
+
+    pthread_mutex_destroy(&job.lock);
+    result->tested = job.tested;
+    result->stopped = job.stop && (job.error == false);
+    return job.error ? PM3_ESOFT : PM3_SUCCESS;
+}
@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Key space engine: a bruteforce.c generator context split into shards and
+// run on the hardnested worker pool.
+//-----------------------------------------------------------------------------
+
+#ifndef BRUTEFORCE_POOL_H__
+#define BRUTEFORCE_POOL_H__
+
+#include "common.h"
+#include "bruteforce.h"
+
+// called once per key, worker is in [0, hn_pool_workers()).
+// Return true to stop the whole run, e.g. when the key was found
+typedef bool (*bf_pool_fn_t)(uint64_t key, uint32_t worker, void *ctx);
+
+typedef struct {
+    uint64_t total;     // size of the key space
+    uint64_t tested;    // keys handed to the callback
+    bool stopped;       // a callback returned true
+} bf_pool_result_t;
+
+// Runs fn on every key of the configured, not yet started, generator context.
+// Returns PM3_SUCCESS, PM3_EINVARG on a bad context or PM3_ESOFT on a generator error
+int bf_pool_run(const generator_context_t *gen, bf_pool_fn_t fn, void *ctx, bool show_progress, bf_pool_result_t *result);
+
+#endif
@@ -22,6 +22,7 @@
 #include <ctype.h>        // tolower
 #include <math.h>
 #include <inttypes.h>     // PRIx64 macro
+#include <pthread.h>
 #include "commonutil.h"   // reflect...
 #include "comms.h"        // clearCommandBuffer
 #include "cmdparser.h"    // command_t
@@ -36,6 +37,11 @@
 #include "cliparser.h"
 #include "generator.h"    // generate nuid
 #include "iso14b.h"       // defines for ETU conversions
+#include "reveng.h"       // reveng_main
+#include "cmdanalysebench.h" // CmdAnalyseBench
+#include "util.h"         // num_CPUs
+#include "util_posix.h"   // msclock
+#include "fileutils.h"    // FILE_PATH_SIZE
 
 static int CmdHelp(const char *Cmd);
 
@@ -274,16 +280,52 @@ static int CmdAnalyseCRC(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "analyse crc",
                   "A stub method to test different crc implementations inside the PM3 sourcecode.\n"
-                  "Just because you figured out the poly, doesn't mean you get the desired output",
-                  "analyse crc -d 137AF00A0A0D"
+                  "Just because you figured out the poly, doesn't mean you get the desired output.\n"
+                  "With `-w` the data are codewords ending with their CRC and all CRC models of\n"
+                  "that width matching them are searched for on all cores (`reveng -w <w> -s`)",
+                  "analyse crc -d 137AF00A0A0D\n"
+                  "analyse crc -w 16 -d 0102030405eac6 -d 1122334455858a -d a0b1c2d3e48447"
                  );
 
     void *argtable[] = {
         arg_param_begin,
-        arg_str1("d", "data", "<hex>", "bytes to calc crc"),
+        arg_strn("d", "data", "<hex>", 1, 16, "bytes to calc crc, codeword when searching"),
+        arg_int0("w", "width", "<dec>", "search CRC models of this width"),
         arg_param_end
     };
-    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int width = arg_get_int_def(ctx, 2, 0);
+    if (width > 0) {
+        struct arg_str *words = arg_get_str(ctx, 1);
+        if (words->count < 2) {
+            PrintAndLogEx(FAILED, "Searching needs at least two codewords of the same length");
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+
+        char w[12];
+        snprintf(w, sizeof(w), "%d", width);
+        char *argv[4 + 16];
+        int argc = 0;
+        argv[argc++] = strdup("reveng");
+        argv[argc++] = strdup("-w");
+        argv[argc++] = strdup(w);
+        argv[argc++] = strdup("-s");
+        for (int i = 0; i < words->count; i++) {
+            argv[argc++] = strdup(words->sval[i]);
+        }
+        CLIParserFree(ctx);
+
+        PrintAndLogEx(INFO, "Searching width " _YELLOW_("%d") " CRC models over " _YELLOW_("%d") " codewords", width, argc - 4);
+        reveng_main(argc, argv);
+
+        for (int i = 0; i < argc; i++) {
+            free(argv[i]);
+        }
+        return PM3_SUCCESS;
+    }
+
     int dlen = 0;
     uint8_t data[1024] = {0x00};
     int res = CLIParamHexToBuf(arg_get_str(ctx, 1), data, sizeof(data), &dlen);
@@ -818,17 +860,316 @@ static int CmdAnalyseA(const char *Cmd) {
 //    return PM3_SUCCESS;
 }
 
+// key algorithms scored by `analyse nuid -f`, each fills keys A then keys B
+typedef struct {
+    const char *name;
+    uint8_t uidlen;     // uid length the algorithm takes, 7 byte uids use their NUID for 4 byte ones
+    uint8_t keycnt;
+    int (*all)(uint8_t *uid, uint8_t *keys);
+} nuid_algo_t;
+
+static int nuid_touch_all(uint8_t *uid, uint8_t *keys) {
+    uint64_t key = 0;
+    mfc_algo_touch_one(uid, 0, 0, &key);
+    num_to_bytes(key, 6, keys);
+    return PM3_SUCCESS;
+}
+
+static const nuid_algo_t nuid_algos[] = {
+    {"MIZIP",    4, 5 * 2,  mfc_algo_mizip_all},
+    {"Saflok",   4, 16 * 2, mfc_algo_saflok_all},
+    {"Skylander", 4, 16 * 2, mfc_algo_sky_all},
+    {"Bambu",    4, 16 * 2, mfc_algo_bambu_all},
+    {"TouchNGo", 4, 1,      nuid_touch_all},
+    {"Disney",   7, 5 * 2,  mfc_algo_di_all},
+};
+#define NUID_ALGO_COUNT     ARRAYLEN(nuid_algos)
+#define NUID_ALGO_KEYS_MAX  (16 * 2)
+#define NUID_REC_KEYS_MAX   80      // MIFARE Classic 4K, keys A and B
+#define NUID_CHUNK          65536   // records in memory at once
+
+typedef struct {
+    uint8_t uid[7];
+    uint8_t uidlen;
+    uint8_t nuid[4];
+    uint8_t keycnt;
+    uint64_t keys[NUID_REC_KEYS_MAX];
+    uint8_t matched[NUID_ALGO_COUNT];   // known keys the algorithm generates
+} nuid_rec_t;
+
+typedef struct {
+    nuid_rec_t *recs;
+    size_t count;
+    size_t next;
+    bool fixed[NUID_ALGO_COUNT][NUID_ALGO_KEYS_MAX];
+} nuid_batch_t;
+
+// keys an algorithm outputs for any uid, like MIZIP sector 0, tell nothing about it
+static void nuid_fixed_keys(nuid_batch_t *b) {
+    uint8_t uids[3][7] = {
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0x04, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC},
+    };
+    for (size_t a = 0; a < NUID_ALGO_COUNT; a++) {
+        uint8_t keys[3][NUID_ALGO_KEYS_MAX * 6];
+        for (int i = 0; i < 3; i++) {
+            nuid_algos[a].all(uids[i], keys[i]);
+        }
+        for (uint8_t k = 0; k < nuid_algos[a].keycnt; k++) {
+            b->fixed[a][k] = (memcmp(keys[0] + (k * 6), keys[1] + (k * 6), 6) == 0) &&
+                             (memcmp(keys[0] + (k * 6), keys[2] + (k * 6), 6) == 0);
+        }
+    }
+}
+
+static void nuid_eval(const nuid_batch_t *b, nuid_rec_t *r) {
+    if (r->uidlen == 7) {
+        mfc_generate4b_nuid(r->uid, r->nuid);
+    }
+    if (r->keycnt == 0) {
+        return;
+    }
+
+    uint8_t *uid4 = (r->uidlen == 7) ? r->nuid : r->uid;
+    for (size_t a = 0; a < NUID_ALGO_COUNT; a++) {
+        const nuid_algo_t *algo = &nuid_algos[a];
+        uint8_t keys[NUID_ALGO_KEYS_MAX * 6];
+        algo->all((algo->uidlen == 7) ? r->uid : uid4, keys);
+
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < r->keycnt; i++) {
+            for (uint8_t k = 0; k < algo->keycnt; k++) {
+                if (b->fixed[a][k] == false && bytes_to_num(keys + (k * 6), 6) == r->keys[i]) {
+                    n++;
+                    break;
+                }
+            }
+        }
+        r->matched[a] = n;
+    }
+}
+
+static void *nuid_batch_worker(void *arg) {
+    nuid_batch_t *b = (nuid_batch_t *)arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->count) {
+            break;
+        }
+        nuid_eval(b, &b->recs[i]);
+    }
+    return NULL;
+}
+
+static void nuid_batch_run(nuid_batch_t *b) {
+    b->next = 0;
+    int n = MIN(num_CPUs(), (int)b->count);
+    pthread_t *tids = calloc(n, sizeof(pthread_t));
+    int started = 0;
+    for (; tids && started < n; started++) {
+        if (pthread_create(&tids[started], NULL, nuid_batch_worker, b) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        nuid_batch_worker(b);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+}
+
+// one line, `<uid> [<key> ...]`, separated by spaces, tabs, commas or semicolons
+static bool nuid_parse_line(char *line, nuid_rec_t *r) {
+    memset(r, 0, sizeof(nuid_rec_t));
+
+    char *save = NULL;
+    char *tok = strtok_r(line, " \t,;\r\n", &save);
+    if (tok == NULL || tok[0] == '#') {
+        return false;
+    }
+
+    size_t len = strlen(tok);
+    if ((len != 8 && len != 14) || hex_to_bytes(tok, r->uid, sizeof(r->uid)) != (int)(len / 2)) {
+        return false;
+    }
+    r->uidlen = len / 2;
+
+    while ((tok = strtok_r(NULL, " \t,;\r\n", &save)) != NULL && r->keycnt < NUID_REC_KEYS_MAX) {
+        uint8_t key[6];
+        if (strlen(tok) == 12 && hex_to_bytes(tok, key, sizeof(key)) == 6) {
+            r->keys[r->keycnt++] = bytes_to_num(key, 6);
+        }
+    }
+    return true;
+}
+
+// streams the uid file in chunks, every chunk is evaluated on all cores
+static int nuid_batch(const char *fn, const char *outfn) {
+
+    FILE *f = fopen(fn, "r");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fn);
+        return PM3_EFILE;
+    }
+
+    FILE *fout = NULL;
+    if (outfn[0] != '\0') {
+        fout = fopen(outfn, "w");
+        if (fout == NULL) {
+            PrintAndLogEx(WARNING, "could not create `" _YELLOW_("%s") "`", outfn);
+            fclose(f);
+            return PM3_EFILE;
+        }
+    }
+
+    nuid_batch_t b = {0};
+    b.recs = calloc(NUID_CHUNK, sizeof(nuid_rec_t));
+    if (b.recs == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        fclose(f);
+        if (fout) {
+            fclose(fout);
+        }
+        return PM3_EMALLOC;
+    }
+
+    size_t total = 0, uid7 = 0, skipped = 0;
+    size_t applicable[NUID_ALGO_COUNT] = {0};
+    size_t hit[NUID_ALGO_COUNT] = {0};
+    size_t full[NUID_ALGO_COUNT] = {0};
+    uint64_t keys_matched[NUID_ALGO_COUNT] = {0};
+    uint64_t keys_known = 0;
+
+    nuid_fixed_keys(&b);
+
+    uint64_t t1 = msclock();
+    char line[2048];
+    bool eof = false;
+    while (eof == false) {
+
+        b.count = 0;
+        while (b.count < NUID_CHUNK) {
+            if (fgets(line, sizeof(line), f) == NULL) {
+                eof = true;
+                break;
+            }
+            char *p = line;
+            while (*p == ' ' || *p == '\t') {
+                p++;
+            }
+            if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') {
+                continue;
+            }
+            if (nuid_parse_line(p, &b.recs[b.count])) {
+                b.count++;
+            } else {
+                skipped++;
+            }
+        }
+        if (b.count == 0) {
+            continue;
+        }
+
+        nuid_batch_run(&b);
+
+        for (size_t i = 0; i < b.count; i++) {
+            const nuid_rec_t *r = &b.recs[i];
+            total++;
+            uid7 += (r->uidlen == 7);
+            keys_known += r->keycnt;
+
+            // fprintf is hooked to the console by the reveng headers
+            char out[128];
+            int olen = snprintf(out, sizeof(out), "%s ", sprint_hex_inrow(r->uid, r->uidlen));
+            olen += snprintf(out + olen, sizeof(out) - olen, "%s", (r->uidlen == 7) ? sprint_hex_inrow(r->nuid, 4) : "-");
+
+            bool any = false;
+            for (size_t a = 0; a < NUID_ALGO_COUNT; a++) {
+                if (r->keycnt == 0) {
+                    break;
+                }
+                if (nuid_algos[a].uidlen == 7 && r->uidlen != 7) {
+                    continue;
+                }
+                applicable[a]++;
+                if (r->matched[a] == 0) {
+                    continue;
+                }
+                hit[a]++;
+                full[a] += (r->matched[a] == r->keycnt);
+                keys_matched[a] += r->matched[a];
+                olen += snprintf(out + olen, sizeof(out) - olen, "%s%s", (any) ? "," : " ", nuid_algos[a].name);
+                any = true;
+            }
+            olen += snprintf(out + olen, sizeof(out) - olen, "%s\n", (any) ? "" : " -");
+            if (fout) {
+                fwrite(out, 1, olen, fout);
+            }
+        }
+    }
+    t1 = msclock() - t1;
+
+    fclose(f);
+    if (fout) {
+        fclose(fout);
+    }
+    free(b.recs);
+
+    PrintAndLogEx(INFO, "Read " _YELLOW_("%zu") " UIDs, " _YELLOW_("%zu") " of 7 bytes, " _YELLOW_("%" PRIu64) " known keys ( %.1f s )"
+                  , total, uid7, keys_known, (float)t1 / 1000.0);
+    if (skipped) {
+        PrintAndLogEx(WARNING, "skipped " _YELLOW_("%zu") " lines without a 4 or 7 byte UID", skipped);
+    }
+    if (fout) {
+        PrintAndLogEx(SUCCESS, "saved UID / NUID / algorithms to `" _YELLOW_("%s") "`", outfn);
+    }
+
+    if (keys_known == 0) {
+        PrintAndLogEx(HINT, "Hint: add the known keys after each UID to score the key algorithms");
+        return PM3_SUCCESS;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "-----------+---------+---------+---------+---------+--------");
+    PrintAndLogEx(INFO, " algorithm | UIDs    | any key | all keys| keys    | hit %%");
+    PrintAndLogEx(INFO, "-----------+---------+---------+---------+---------+--------");
+    for (size_t a = 0; a < NUID_ALGO_COUNT; a++) {
+        float rate = (applicable[a]) ? (100.0 * hit[a]) / applicable[a] : 0;
+        PrintAndLogEx(INFO, " %-9s | %7zu | %7zu | %7zu | %7" PRIu64 " | %5.1f"
+                      , nuid_algos[a].name
+                      , applicable[a]
+                      , hit[a]
+                      , full[a]
+                      , keys_matched[a]
+                      , rate
+                     );
+    }
+    PrintAndLogEx(INFO, "-----------+---------+---------+---------+---------+--------");
+    return PM3_SUCCESS;
+}
+
 static int CmdAnalyseNuid(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "analyse nuid",
-                  "Generate 4byte NUID from 7byte UID",
-                  "analyse nuid -d 11223344556677"
+                  "Generate 4byte NUID from 7byte UID.\n"
+                  "With a file, every line holds a 4 or 7 byte UID optionally followed by known keys.\n"
+                  "The NUIDs are derived and the MIFARE Classic key algorithms are scored against\n"
+                  "the known keys on all cores. 4 byte algorithms use the NUID of 7 byte UIDs,\n"
+                  "keys an algorithm generates for every UID are not counted.",
+                  "analyse nuid -d 11223344556677\n"
+                  "analyse nuid -f uids.txt\n"
+                  "analyse nuid -f uids.txt -o scored.txt"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_str0("d", "data", "<hex>", "bytes to send"),
         arg_lit0("t", "test", "self test"),
+        arg_str0("f", "file", "<fn>", "text file with one UID and its known keys per line"),
+        arg_str0("o", "out", "<fn>", "save UID, NUID and matching algorithms per line"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -837,6 +1178,14 @@ static int CmdAnalyseNuid(const char *Cmd) {
     uint8_t uid[7] = {0};
     int res = CLIParamHexToBuf(arg_get_str(ctx, 1), uid, sizeof(uid), &uidlen);
     bool selftest = arg_get_lit(ctx, 2);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int outlen = 0;
+    char outfn[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)outfn, FILE_PATH_SIZE, &outlen);
     CLIParserFree(ctx);
 
     if (res) {
@@ -844,6 +1193,10 @@ static int CmdAnalyseNuid(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if (fnlen) {
+        return nuid_batch(filename, outfn);
+    }
+
     uint8_t nuid[4] = {0};
 
     /* src: https://www.nxp.com/docs/en/application-note/AN10927.pdf */
@@ -1181,6 +1534,7 @@ static command_t CommandTable[] = {
     {"freq",    CmdAnalyseFreq,     AlwaysAvailable, "Calc wave lengths"},
     {"foo",     CmdAnalyseFoo,      AlwaysAvailable, "muxer"},
     {"units",   CmdAnalyseUnits,    AlwaysAvailable, "convert ETU <> US <> SSP_CLK (3.39MHz)"},
+    {"bench",   CmdAnalyseBench,    AlwaysAvailable, "Benchmark crypto, CRC and demodulation kernels"},
     {NULL, NULL, NULL, NULL}
 };
 
@@ -0,0 +1,577 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Benchmark of the client side crypto, CRC and demodulation kernels
+//-----------------------------------------------------------------------------
+#include "cmdanalysebench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "commonutil.h"              // REV32, REV64
+#include "ui.h"                      // PrintAndLog
+#include "util.h"                    // num_CPUs
+#include "util_posix.h"              // usclock
+#include "cliparser.h"
+#include "fileutils.h"               // searchFile
+#include "jansson.h"
+#include "crc16.h"
+#include "crc32.h"
+#include "lfdemod.h"
+#include "mifare.h"                  // nonces_t
+#include "crapto1/crapto1.h"
+#include "mifare/mfkey.h"
+#include "mifare/desfirecrypto.h"
+#include "loclass/cipher.h"          // doMAC
+#include "loclass/elite_crack.h"     // hash1, hash2
+#include "hitag2/hitag2_crypto.h"
+#include "hardnested_bruteforce.h"   // brute_force_benchmark
+#include "hardnested_bf_core.h"      // SetSIMDInstr
+
+#define BENCH_DEFAULT_MS    250
+#define BENCH_BUF_SIZE      1024
+#define BENCH_LF_BITS       256
+
+// Each kernel runs n operations on fixed inputs and checks the result of the last one
+// against a known answer, so a regression in speed can't hide a broken kernel.
+typedef bool (*bench_fn_t)(uint64_t n);
+
+typedef struct {
+    const char *name;
+    bench_fn_t fn;
+    size_t bytes;       // payload bytes per operation, 0 if it isn't a stream kernel
+} bench_kernel_t;
+
+typedef struct {
+    json_t *kernels;
+    uint32_t min_ms;
+    const char *filter;
+    bool json_only;
+    int count;
+    int failed;
+} bench_ctx_t;
+
+static uint8_t bench_buf[BENCH_BUF_SIZE];
+
+// LF test signals, demodulated from a copy since the demodulators work in place
+static uint8_t bench_ask_wave[BENCH_LF_BITS * 64];
+static uint8_t bench_fsk_wave[BENCH_LF_BITS * 50];
+static uint8_t bench_psk_wave[BENCH_LF_BITS * 32];
+static uint8_t bench_lf_work[BENCH_LF_BITS * 64];
+
+static void bench_fill(uint8_t *d, size_t n) {
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < n; i++) {
+        x = x * 1103515245 + 12345;
+        d[i] = x >> 24;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// MIFARE Classic crypto1
+//-----------------------------------------------------------------------------
+
+// same reader responses as the mfkey32v2 test in pm3_tests.sh, key A0A1A2A3A4A5
+static nonces_t bench_mfkey32_data = {
+    .cuid = 0x12345678,
+    .nonce = 0x1AD8DF2B, .nr = 0x1D316024, .ar = 0x620EF048,
+    .nonce2 = 0x30D6CB07, .nr2 = 0xC52077E2, .ar2 = 0x837AC61A,
+};
+
+// same authentication as the mfkey64 test in pm3_tests.sh, key FFFFFFFFFFFF
+static nonces_t bench_mfkey64_data = {
+    .cuid = 0x9c599b32,
+    .nonce = 0x82a4166c, .nr = 0xa1e458ce, .ar = 0x6eea41e0, .at = 0x5cadf439,
+};
+
+static bool bench_lfsr_recovery32(uint64_t n) {
+    uint32_t ks2 = bench_mfkey32_data.ar ^ prng_successor(bench_mfkey32_data.nonce, 64);
+    bool ok = false;
+    for (uint64_t i = 0; i < n; i++) {
+        struct Crypto1State *s = lfsr_recovery32(ks2, 0);
+        ok = (s != NULL) && (s->odd | s->even);
+        crypto1_destroy(s);
+    }
+    return ok;
+}
+
+static bool bench_lfsr_recovery64(uint64_t n) {
+    uint64_t key = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        mfkey64(&bench_mfkey64_data, &key);
+    }
+    return (key == 0xFFFFFFFFFFFF);
+}
+
+static bool bench_mfkey32(uint64_t n) {
+    uint64_t key = 0;
+    bool ok = false;
+    for (uint64_t i = 0; i < n; i++) {
+        ok = mfkey32_moebius(&bench_mfkey32_data, &key);
+    }
+    return ok && (key == 0xA0A1A2A3A4A5);
+}
+
+//-----------------------------------------------------------------------------
+// iCLASS, vectors from the loclass self tests
+//-----------------------------------------------------------------------------
+static bool bench_iclass_domac(uint64_t n) {
+    uint8_t cc_nr[] = {0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0};
+    uint8_t div_key[8] = {0xE0, 0x33, 0xCA, 0x41, 0x9A, 0xEE, 0x43, 0xF9};
+    const uint8_t expected[4] = {0x1d, 0x49, 0xC9, 0xDA};
+    uint8_t mac[4] = {0};
+    for (uint64_t i = 0; i < n; i++) {
+        doMAC(cc_nr, div_key, mac);
+    }
+    return (memcmp(mac, expected, sizeof(mac)) == 0);
+}
+
+static bool bench_iclass_hash1(uint64_t n) {
+    uint8_t csn[8] = {0x01, 0x02, 0x03, 0x04, 0xF7, 0xFF, 0x12, 0xE0};
+    const uint8_t expected[8] = {0x7E, 0x72, 0x2F, 0x40, 0x2D, 0x02, 0x51, 0x42};
+    uint8_t k[8] = {0};
+    // vary the CSN so the compiler can't hoist the call out of the loop
+    for (uint64_t i = 0; i < n; i++) {
+        csn[0] = (uint8_t)i;
+        hash1(csn, k);
+    }
+    csn[0] = 0x01;
+    hash1(csn, k);
+    return (memcmp(k, expected, sizeof(k)) == 0);
+}
+
+static bool bench_iclass_hash2(uint64_t n) {
+    uint8_t k_cus[8] = {0x5B, 0x7C, 0x62, 0xC4, 0x91, 0xC1, 0x1B, 0x39};
+    uint8_t keytable[128] = {0};
+    for (uint64_t i = 0; i < n; i++) {
+        hash2(k_cus, keytable);
+    }
+    return (keytable[3] == 0xA1 && keytable[0x30] == 0xA3 && keytable[0x6F] == 0x95);
+}
+
+//-----------------------------------------------------------------------------
+// Hitag2, "MIKRON" vector, one operation is a cipher init and 32 keystream bits
+//-----------------------------------------------------------------------------
+static bool bench_hitag2(uint64_t n) {
+    const uint64_t key = REV64(UINT64_C(0x524B494D4E4F));
+    const uint32_t uid = REV32(UINT32_C(0x69574349));
+    const uint32_t iv = REV32(UINT32_C(0x72456E65));
+    uint32_t ks = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t cs = ht2_hitag2_init(key, uid, iv);
+        ks = ht2_hitag2_byte(&cs) << 24;
+        ks |= ht2_hitag2_byte(&cs) << 16;
+        ks |= ht2_hitag2_byte(&cs) << 8;
+        ks |= ht2_hitag2_byte(&cs);
+    }
+    return (ks == 0xD7237FCE);
+}
+
+//-----------------------------------------------------------------------------
+// CRC, 1 kB per operation, checked with the catalogue check values
+//-----------------------------------------------------------------------------
+static bool bench_crc16_a(uint64_t n) {
+    init_table(CRC_14443_A);
+    volatile uint16_t crc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        crc = crc16_a(bench_buf, sizeof(bench_buf));
+    }
+    (void)crc;
+    return (crc16_a((const uint8_t *)"123456789", 9) == 0xBF05);
+}
+
+static bool bench_crc16_ccitt(uint64_t n) {
+    init_table(CRC_CCITT);
+    volatile uint16_t crc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        crc = crc16_ccitt(bench_buf, sizeof(bench_buf));
+    }
+    (void)crc;
+    return (crc16_ccitt((const uint8_t *)"123456789", 9) == 0x29B1);
+}
+
+static bool bench_crc32(uint64_t n) {
+    uint8_t crc[4] = {0};
+    for (uint64_t i = 0; i < n; i++) {
+        crc32_ex(bench_buf, sizeof(bench_buf), crc);
+    }
+    // DESFire flavour, without the final xor
+    crc32_ex((const uint8_t *)"123456789", 9, crc);
+    return (MemLeToUint4byte(crc) == 0x340BC6D9);
+}
+
+//-----------------------------------------------------------------------------
+// LF demodulators on synthetic signals of BENCH_LF_BITS bits
+//-----------------------------------------------------------------------------
+static uint8_t bench_lf_bit(uint32_t i) {
+    // fixed bit pattern with runs of ones and zeros
+    return ((i * 0x9E3779B9u) >> 29) & 1;
+}
+
+static void bench_lf_setup(void) {
+    // ASK/Manchester, RF/64
+    for (uint32_t i = 0; i < BENCH_LF_BITS; i++) {
+        for (uint32_t j = 0; j < 64; j++) {
+            bool first_half = (j < 32);
+            bench_ask_wave[i * 64 + j] = (bench_lf_bit(i) ^ first_half) ? 200 : 56;
+        }
+    }
+
+    // FSK2a, RF/50, fc/10 and fc/8
+    for (uint32_t i = 0; i < BENCH_LF_BITS; i++) {
+        uint8_t fc = bench_lf_bit(i) ? 10 : 8;
+        for (uint32_t j = 0; j < 50; j++) {
+            bench_fsk_wave[i * 50 + j] = ((j % fc) < (fc / 2)) ? 200 : 56;
+        }
+    }
+
+    // PSK1, RF/32, fc/4 carrier, the phase follows the bit value
+    for (uint32_t i = 0; i < BENCH_LF_BITS; i++) {
+        uint8_t phase = bench_lf_bit(i) ? 2 : 0;
+        for (uint32_t j = 0; j < 32; j++) {
+            bench_psk_wave[i * 32 + j] = (((j + phase) % 4) < 2) ? 200 : 56;
+        }
+    }
+}
+
+// the demodulated bits must contain a 64 bit run of the pattern, in either polarity
+static bool bench_lf_check(const uint8_t *bits, size_t size) {
+    for (int inv = 0; inv < 2; inv++) {
+        for (size_t off = 0; off + 64 <= size; off++) {
+            for (uint32_t i = 0; i + 64 <= BENCH_LF_BITS; i++) {
+                uint32_t j = 0;
+                while (j < 64 && (bits[off + j] ^ inv) == bench_lf_bit(i + j)) {
+                    j++;
+                }
+                if (j == 64) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+static bool bench_askdemod(uint64_t n) {
+    int errors = -1;
+    size_t size = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        memcpy(bench_lf_work, bench_ask_wave, sizeof(bench_ask_wave));
+        computeSignalProperties(bench_lf_work, sizeof(bench_ask_wave));
+        size = sizeof(bench_ask_wave);
+        int clk = 0, invert = 0, start = 0;
+        errors = askdemod_ext(bench_lf_work, &size, &clk, &invert, 100, 0, 1, &start);
+    }
+    return (errors == 0) && bench_lf_check(bench_lf_work, size);
+}
+
+static bool bench_fskdemod(uint64_t n) {
+    size_t size = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        memcpy(bench_lf_work, bench_fsk_wave, sizeof(bench_fsk_wave));
+        computeSignalProperties(bench_lf_work, sizeof(bench_fsk_wave));
+        int start = 0;
+        size = fskdemod(bench_lf_work, sizeof(bench_fsk_wave), 50, 0, 10, 8, &start);
+    }
+    return bench_lf_check(bench_lf_work, size);
+}
+
+static bool bench_pskdemod(uint64_t n) {
+    int errors = -1;
+    size_t size = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        memcpy(bench_lf_work, bench_psk_wave, sizeof(bench_psk_wave));
+        computeSignalProperties(bench_lf_work, sizeof(bench_psk_wave));
+        size = sizeof(bench_psk_wave);
+        int clk = 32, invert = 0, start = 0;
+        errors = pskRawDemod_ext(bench_lf_work, &size, &clk, &invert, &start);
+    }
+    return (errors == 0) && bench_lf_check(bench_lf_work, size);
+}
+
+//-----------------------------------------------------------------------------
+// DESFire CMAC over 64 bytes. AES is checked against RFC 4493 example 3,
+// 2TDEA against NIST SP 800-38B example 6 (20 bytes).
+//-----------------------------------------------------------------------------
+static bool bench_desfire_cmac(DesfireCryptoAlgorithm algo, uint8_t *key, const uint8_t *msg, size_t msglen, const uint8_t *expected, size_t maclen, uint64_t n) {
+    DesfireContext_t dctx;
+    DesfireClearContext(&dctx);
+    DesfireSetKey(&dctx, 0, algo, key);
+
+    uint8_t cmac[DESFIRE_MAX_KEY_SIZE] = {0};
+    for (uint64_t i = 0; i < n; i++) {
+        DesfireClearIV(&dctx);
+        DesfireCryptoCMACEx(&dctx, DCOMainKey, bench_buf, 64, 0, cmac);
+    }
+
+    DesfireClearIV(&dctx);
+    DesfireCryptoCMACEx(&dctx, DCOMainKey, (uint8_t *)msg, msglen, 0, cmac);
+    return (memcmp(cmac, expected, maclen) == 0);
+}
+
+static const uint8_t bench_cmac_msg[40] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11
+};
+
+static bool bench_desfire_aes(uint64_t n) {
+    uint8_t key[16] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+    const uint8_t expected[16] = {0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97, 0xc8, 0x27};
+    return bench_desfire_cmac(T_AES, key, bench_cmac_msg, sizeof(bench_cmac_msg), expected, sizeof(expected), n);
+}
+
+static bool bench_desfire_3des(uint64_t n) {
+    uint8_t key[16] = {0x4c, 0xf1, 0x51, 0x34, 0xa2, 0x85, 0x0d, 0xd5, 0x8a, 0x3d, 0x10, 0xba, 0x80, 0x57, 0x0d, 0x38};
+    const uint8_t expected[8] = {0x62, 0xdd, 0x1b, 0x47, 0x19, 0x02, 0xbd, 0x4e};
+    return bench_desfire_cmac(T_3DES, key, bench_cmac_msg, 20, expected, sizeof(expected), n);
+}
+
+static const bench_kernel_t bench_kernels[] = {
+    {"crc/crc16_a",             bench_crc16_a,          BENCH_BUF_SIZE},
+    {"crc/crc16_ccitt",         bench_crc16_ccitt,      BENCH_BUF_SIZE},
+    {"crc/crc32",               bench_crc32,            BENCH_BUF_SIZE},
+    {"hitag2/init_32bits",      bench_hitag2,           0},
+    {"iclass/doMAC",            bench_iclass_domac,     0},
+    {"iclass/elite_hash1",      bench_iclass_hash1,     0},
+    {"iclass/elite_hash2",      bench_iclass_hash2,     0},
+    {"desfire/cmac_aes",        bench_desfire_aes,      64},
+    {"desfire/cmac_2tdea",      bench_desfire_3des,     64},
+    {"lf/askdemod_ext",         bench_askdemod,         sizeof(bench_ask_wave)},
+    {"lf/fskdemod",             bench_fskdemod,         sizeof(bench_fsk_wave)},
+    {"lf/pskRawDemod_ext",      bench_pskdemod,         sizeof(bench_psk_wave)},
+    {"crypto1/mfkey32v2",       bench_mfkey32,          0},
+    {"crypto1/lfsr_recovery32", bench_lfsr_recovery32,  0},
+    {"crypto1/lfsr_recovery64", bench_lfsr_recovery64,  0},
+};
+
+static bool bench_selected(const bench_ctx_t *ctx, const char *name) {
+    return (ctx->filter == NULL) || (strstr(name, ctx->filter) != NULL);
+}
+
+static void bench_report(bench_ctx_t *ctx, const char *name, bool ok, uint64_t ops, double seconds, size_t bytes) {
+
+    double rate = (seconds > 0) ? (double)ops / seconds : 0;
+
+    ctx->count++;
+    if (ok == false) {
+        ctx->failed++;
+    }
+
+    json_t *k = json_object();
+    json_object_set_new(k, "name", json_string(name));
+    json_object_set_new(k, "ok", json_boolean(ok));
+    json_object_set_new(k, "ops", json_integer((json_int_t)ops));
+    json_object_set_new(k, "seconds", json_real(seconds));
+    json_object_set_new(k, "ops_per_sec", json_real(rate));
+    if (bytes) {
+        json_object_set_new(k, "bytes_per_op", json_integer((json_int_t)bytes));
+    }
+    json_array_append_new(ctx->kernels, k);
+
+    if (ctx->json_only) {
+        return;
+    }
+
+    if (ok == false) {
+        PrintAndLogEx(FAILED, "  %-26s " _RED_("fail"), name);
+    } else if (bytes) {
+        PrintAndLogEx(SUCCESS, "  %-26s " _YELLOW_("%14.0f") " ops/s  %9.1f MB/s", name, rate, rate * bytes / (1024 * 1024));
+    } else {
+        PrintAndLogEx(SUCCESS, "  %-26s " _YELLOW_("%14.0f") " ops/s", name, rate);
+    }
+}
+
+// grow the iteration count until one run takes at least min_ms
+static void bench_run_kernel(bench_ctx_t *ctx, const bench_kernel_t *k) {
+
+    uint64_t target = (uint64_t)ctx->min_ms * 1000;
+    uint64_t n = 1;
+
+    while (true) {
+        uint64_t t = usclock();
+        bool ok = k->fn(n);
+        t = usclock() - t;
+
+        if (ok == false) {
+            bench_report(ctx, k->name, false, n, t / 1e6, k->bytes);
+            return;
+        }
+
+        if (t >= target) {
+            bench_report(ctx, k->name, true, n, t / 1e6, k->bytes);
+            return;
+        }
+
+        // aim 20% past the target, at most 16x per step since the first runs are noisy
+        uint64_t next = (t == 0) ? n * 16 : (n * target * 12) / (t * 10) + 1;
+        n = MIN(MAX(next, n + 1), n * 16);
+    }
+}
+
+static const char *bench_simd_name(SIMDExecInstr instr) {
+    switch (instr) {
+#if defined(COMPILER_HAS_SIMD_AVX512)
+        case SIMD_AVX512:
+            return "AVX512F";
+#endif
+#if defined(COMPILER_HAS_SIMD_X86)
+        case SIMD_AVX2:
+            return "AVX2";
+        case SIMD_AVX:
+            return "AVX";
+        case SIMD_SSE2:
+            return "SSE2";
+        case SIMD_MMX:
+            return "MMX";
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+        case SIMD_NEON:
+            return "NEON";
+#endif
+#if defined(HAVE_OPENCL)
+        case SIMD_OPENCL:
+            return "OpenCL";
+#endif
+        case SIMD_AUTO:
+        case SIMD_NONE:
+        default:
+            return "none";
+    }
+}
+
+// The bitsliced core is timed by its own benchmark on all workers, once per
+// instruction set this CPU supports, best first.
+static void bench_run_hardnested(bench_ctx_t *ctx) {
+
+    char *path = NULL;
+    bool have_data = (searchFile(&path, RESOURCES_SUBDIR, "hardnested_bf_bench_data.bin", "", true) == PM3_SUCCESS);
+    free(path);
+
+    SetSIMDInstr(SIMD_AUTO);
+    SIMDExecInstr best = GetSIMDInstrCPU();
+
+    for (int instr = best; instr <= SIMD_NONE; instr++) {
+        char name[48];
+        snprintf(name, sizeof(name), "hardnested/bitsliced_%s", bench_simd_name(instr));
+        if (bench_selected(ctx, name) == false) {
+            continue;
+        }
+
+        if (have_data == false) {
+            bench_report(ctx, name, false, 0, 0, 0);
+            continue;
+        }
+
+        SetSIMDInstr(instr);
+        uint64_t t = usclock();
+        float rate = brute_force_benchmark();
+        t = usclock() - t;
+        bench_report(ctx, name, true, (uint64_t)(rate * (t / 1e6)), t / 1e6, 0);
+    }
+
+    SetSIMDInstr(SIMD_AUTO);
+}
+
+int CmdAnalyseBench(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "analyse bench",
+                  "Benchmark the client side kernels on fixed inputs and report operations per second.\n"
+                  "Every kernel also checks its result against a known answer.\n"
+                  "Covers crypto1 key recovery, the hardnested bitsliced core for each SIMD level,\n"
+                  "iCLASS MAC and elite hashing, Hitag2, CRC, LF demodulators and DESFire CMAC.",
+                  "analyse bench\n"
+                  "analyse bench -k crc               -> only kernels with `crc` in their name\n"
+                  "analyse bench --json -f bench.json -> save results for trend tracking"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("k", "kernel", "<str>", "only run kernels whose name contains this"),
+        arg_int0(NULL, "ms", "<dec>", "minimum run time per kernel in ms (def 250)"),
+        arg_lit0(NULL, "json", "print the results as JSON only"),
+        arg_str0("f", "file", "<fn>", "save the results as JSON to file"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    char filter[64] = {0};
+    int filterlen = 0;
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filter, sizeof(filter) - 1, &filterlen);
+    int ms = arg_get_int_def(ctx, 2, BENCH_DEFAULT_MS);
+    bool json_only = arg_get_lit(ctx, 3);
+
+    char filename[FILE_PATH_SIZE] = {0};
+    int fnlen = 0;
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    CLIParserFree(ctx);
+
+    if (ms < 1 || ms > 60000) {
+        PrintAndLogEx(WARNING, "run time must be between 1 and 60000 ms");
+        return PM3_EINVARG;
+    }
+
+    bench_ctx_t bctx = {
+        .kernels = json_array(),
+        .min_ms = ms,
+        .filter = (filterlen) ? filter : NULL,
+        .json_only = json_only,
+    };
+
+    bench_fill(bench_buf, sizeof(bench_buf));
+    bench_lf_setup();
+
+    if (json_only == false) {
+        PrintAndLogEx(INFO, "Benchmarking, at least " _YELLOW_("%d") " ms per kernel, " _YELLOW_("%d") " cpu(s)", ms, num_CPUs());
+    }
+
+    for (size_t i = 0; i < ARRAYLEN(bench_kernels); i++) {
+        if (bench_selected(&bctx, bench_kernels[i].name)) {
+            bench_run_kernel(&bctx, &bench_kernels[i]);
+        }
+    }
+    bench_run_hardnested(&bctx);
+
+    json_t *root = json_object();
+    json_object_set_new(root, "cpus", json_integer(num_CPUs()));
+    json_object_set_new(root, "simd", json_string(bench_simd_name(GetSIMDInstrCPU())));
+    json_object_set_new(root, "min_ms", json_integer(ms));
+    json_object_set_new(root, "kernels", bctx.kernels);
+
+    if (json_only) {
+        char *s = json_dumps(root, JSON_INDENT(2));
+        if (s) {
+            PrintAndLogEx(NORMAL, "%s", s);
+            free(s);
+        }
+    } else {
+        PrintAndLogEx(INFO, "Benchmark: %d kernels, " _YELLOW_("%d") " failed", bctx.count, bctx.failed);
+    }
+
+    int res = PM3_SUCCESS;
+    if (fnlen) {
+        if (json_dump_file(root, filename, JSON_INDENT(2)) == 0) {
+            if (json_only == false) {
+                PrintAndLogEx(SUCCESS, "saved results to " _YELLOW_("%s"), filename);
+            }
+        } else {
+            PrintAndLogEx(WARNING, "could not save " _YELLOW_("%s"), filename);
+            res = PM3_EFILE;
+        }
+    }
+
+    json_decref(root);
+    return (bctx.failed) ? PM3_ESOFT : res;
+}
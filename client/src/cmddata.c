@@ -22,6 +22,7 @@
 #include <math.h>                // pow
 #include <ctype.h>               // tolower
 #include <locale.h>              // number formatter..
+#include <pthread.h>
 #include "commonutil.h"          // ARRAYLEN
 #include "cmdparser.h"           // for command_t
 #include "ui.h"                  // for show graph controls
@@ -42,6 +43,7 @@
 #include "mbedtls/ctr_drbg.h"    // random generator
 #include "atrs.h"                // ATR lookup
 #include "crypto/libpcrypto.h"   // Cryptography
+#include "iclass_cmd.h"          // picopass_hdr_t
 
 
 uint8_t g_DemodBuffer[MAX_DEMOD_BUF_LEN] = { 0x00 };
@@ -848,6 +850,107 @@ static int Cmdaskrawdemod(const char *Cmd) {
     return ASKDemod_ext(clk, invert, max_err, max_len, amplify, true, false, 0, &st);
 }
 
+// lag sums needing fewer multiply-adds than this are computed directly
+#define AUTOCORR_FFT_MIN_WORK   (1ULL << 22)
+
+// in-place radix-2 FFT, n a power of two. tw holds cos / sin of 2*pi*k/n for k < n/2.
+// The inverse transform is not scaled
+static void fft_radix2(double *re, double *im, const double *tw_re, const double *tw_im, size_t n, bool inverse) {
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            double t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (size_t half = 1; half < n; half <<= 1) {
+        size_t step = n / (half << 1);
+        for (size_t i = 0; i < n; i += (half << 1)) {
+            for (size_t k = 0; k < half; k++) {
+                double wr = tw_re[k * step];
+                double wi = (inverse) ? tw_im[k * step] : -tw_im[k * step];
+                size_t u = i + k, v = i + k + half;
+                double xr = re[v] * wr - im[v] * wi;
+                double xi = re[v] * wi + im[v] * wr;
+                re[v] = re[u] - xr;
+                im[v] = im[u] - xi;
+                re[u] += xr;
+                im[u] += xi;
+            }
+        }
+    }
+}
+
+// sums[i] = sum of (in[j] - mean) * (in[j + i] - mean) over j, for lags i < nlags.
+// Goes through the power spectrum of the zero padded signal once the direct
+// O(len * nlags) loop gets expensive
+static bool autocorr_lag_sums(const int *in, size_t len, double mean, double *sums, size_t nlags) {
+
+    if ((uint64_t)len * nlags < AUTOCORR_FFT_MIN_WORK) {
+        for (size_t i = 0; i < nlags; i++) {
+            double sum = 0.0;
+            for (size_t j = 0; j < (len - i); j++) {
+                sum += (in[j] - mean) * (in[j + i] - mean);
+            }
+            sums[i] = sum;
+        }
+        return true;
+    }
+
+    // no wrap around for the lags we want
+    size_t n = 1;
+    while (n < len + nlags) {
+        n <<= 1;
+    }
+
+    double *re = calloc(n, sizeof(double));
+    double *im = calloc(n, sizeof(double));
+    double *tw_re = calloc(n / 2, sizeof(double));
+    double *tw_im = calloc(n / 2, sizeof(double));
+    if (re == NULL || im == NULL || tw_re == NULL || tw_im == NULL) {
+        free(re);
+        free(im);
+        free(tw_re);
+        free(tw_im);
+        return false;
+    }
+
+    for (size_t k = 0; k < n / 2; k++) {
+        tw_re[k] = cos(2.0 * M_PI * k / n);
+        tw_im[k] = sin(2.0 * M_PI * k / n);
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        re[i] = in[i] - mean;
+    }
+
+    fft_radix2(re, im, tw_re, tw_im, n, false);
+    for (size_t i = 0; i < n; i++) {
+        re[i] = re[i] * re[i] + im[i] * im[i];
+        im[i] = 0.0;
+    }
+    fft_radix2(re, im, tw_re, tw_im, n, true);
+
+    for (size_t i = 0; i < nlags; i++) {
+        sums[i] = re[i] / n;
+    }
+
+    free(re);
+    free(im);
+    free(tw_re);
+    free(tw_im);
+    return true;
+}
+
 int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveGrph, bool verbose) {
     // sanity check
     if (window > len) {
@@ -864,16 +967,29 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
     // Computed variance
     double variance = compute_variance(in, len);
 
-    int *correl_buf = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
+    size_t nlags = len - window;
+    int *correl_buf = calloc(len, sizeof(int));
+    double *sums = calloc(nlags ? nlags : 1, sizeof(double));
+    if (correl_buf == NULL || sums == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(correl_buf);
+        free(sums);
+        return -1;
+    }
+
+    if (autocorr_lag_sums(in, len, mean, sums, nlags) == false) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(correl_buf);
+        free(sums);
+        return -1;
+    }
 
     uint8_t peak_cnt = 0;
     size_t peaks[10] = {0};
 
-    for (size_t i = 0; i < len - window; ++i) {
+    for (size_t i = 0; i < nlags; ++i) {
 
-        for (size_t j = 0; j < (len - i); j++) {
-            autocv += (in[j] - mean) * (in[j + i] - mean);
-        }
+        autocv += sums[i];
         autocv = (1.0 / (len - i)) * autocv;
 
         correl_buf[i] = autocv;
@@ -893,6 +1009,7 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
             }
         }
     }
+    free(sums);
 
     // Find shorts distance between peaks
     int distance = -1;
@@ -919,6 +1036,7 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
         }
     } else {
         PrintAndLogEx(HINT, "Hint: No repeating pattern found, try increasing window size");
+        free(correl_buf);
         // return value -1, indication to increase window size
         return -1;
     }
@@ -1025,6 +1143,83 @@ static int CmdBuffClear(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdSnapshot(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data snapshot",
+                  "Keep named copies of the graph for this session, to switch between\n"
+                  "or compare captures without reading the tag again.\n"
+                  "Copies of identical samples share memory.\n"
+                  "Without options it lists the named copies",
+                  "data snapshot                  -> list\n"
+                  "data snapshot -n cap1          -> keep the graph as `cap1`\n"
+                  "data snapshot -n cap1 --load   -> replace the graph with `cap1`\n"
+                  "data snapshot -n cap1 --ov     -> show `cap1` as overlay over the graph\n"
+                  "data snapshot -n cap1 --del    -> forget `cap1`"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("n", "name", "<str>", "snapshot name"),
+        arg_lit0(NULL, "load", "replace the graph with the snapshot"),
+        arg_lit0(NULL, "ov", "draw the snapshot as overlay"),
+        arg_lit0(NULL, "del", "delete the snapshot"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    int nlen = 0;
+    char name[GRAPH_TRACE_NAME_LEN] = {0};
+    int res = CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)name, sizeof(name) - 1, &nlen);
+    bool load = arg_get_lit(ctx, 2);
+    bool overlay = arg_get_lit(ctx, 3);
+    bool del = arg_get_lit(ctx, 4);
+    CLIParserFree(ctx);
+
+    if (res) {
+        PrintAndLogEx(FAILED, "Name too long, max %u chars", GRAPH_TRACE_NAME_LEN - 1);
+        return PM3_EINVARG;
+    }
+
+    if ((load + overlay + del) > 1) {
+        PrintAndLogEx(FAILED, "Select only one of --load, --ov, --del");
+        return PM3_EINVARG;
+    }
+
+    if (nlen == 0) {
+        if (load || overlay || del) {
+            PrintAndLogEx(FAILED, "Missing snapshot name");
+            return PM3_EINVARG;
+        }
+        graph_trace_list();
+        return PM3_SUCCESS;
+    }
+
+    if (load || overlay) {
+        res = graph_trace_load(name, overlay);
+        if (res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "%s " _YELLOW_("%s"), (overlay) ? "Overlay" : "Loaded", name);
+        }
+    } else if (del) {
+        res = graph_trace_delete(name);
+        if (res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Deleted " _YELLOW_("%s"), name);
+        }
+    } else {
+        res = graph_trace_save(name);
+        if (res == PM3_ENODATA) {
+            PrintAndLogEx(WARNING, "GraphBuffer is empty");
+            return res;
+        }
+        if (res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " samples as " _YELLOW_("%s"), g_GraphTraceLen, name);
+        }
+        return res;
+    }
+
+    if (res == PM3_EINVARG) {
+        PrintAndLogEx(FAILED, "No snapshot named " _YELLOW_("%s"), name);
+    }
+    return res;
+}
+
 static int CmdDecimate(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1892,6 +2087,25 @@ int getSamplesEx(uint32_t start, uint32_t end, bool verbose, bool ignore_lf_conf
     return getSamplesFromBufEx(got, n, bits_per_sample, verbose);;
 }
 
+// signal properties and graph refresh, once GraphBuffer got new samples
+static int samplesToGraphDone(void) {
+    uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    size_t size = getFromGraphBuffer(bits);
+    // set signal properties low/high/mean/amplitude and is_noise detection
+    computeSignalProperties(bits, size);
+    free(bits);
+
+    setClockGrid(0, 0);
+    g_DemodBufferLen = 0;
+    RepaintGraphWindow();
+
+    return PM3_SUCCESS;
+}
+
 int getSamplesFromBufEx(uint8_t *data, size_t sample_num, uint8_t bits_per_sample, bool verbose) {
 
     size_t max_num = MIN(sample_num, MAX_GRAPH_TRACE_LEN);
@@ -1917,21 +2131,72 @@ int getSamplesFromBufEx(uint8_t *data, size_t sample_num, uint8_t bits_per_sampl
         g_GraphTraceLen = max_num;
     }
 
-    uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
-    if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        return PM3_EMALLOC;
+    return samplesToGraphDone();
+}
+
+void getSamplesStreamInit(samples_stream_t *stream, uint8_t bits_per_sample) {
+    memset(stream, 0, sizeof(samples_stream_t));
+    stream->bits_per_sample = bits_per_sample;
+}
+
+void getSamplesStreamSetCallback(samples_stream_t *stream, samples_stream_cb_t cb, void *ctx) {
+    stream->cb = cb;
+    stream->cb_ctx = ctx;
+}
+
+static void samples_stream_put(samples_stream_t *stream, int sample) {
+    if (g_GraphTraceLen < MAX_GRAPH_TRACE_LEN) {
+        g_GraphBuffer[g_GraphTraceLen++] = sample;
     }
-    size_t size = getFromGraphBuffer(bits);
-    // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
-    free(bits);
+    if (stream->cb) {
+        stream->chunk[stream->chunk_len++] = sample;
+        if (stream->chunk_len == SAMPLES_STREAM_CHUNK) {
+            stream->cb(stream->chunk, stream->chunk_len, stream->cb_ctx);
+            stream->chunk_len = 0;
+        }
+    }
+}
 
-    setClockGrid(0, 0);
-    g_DemodBufferLen = 0;
-    RepaintGraphWindow();
+// raw_stream_cb_t, unpacks samples into GraphBuffer as the raw data arrives
+bool getSamplesStreamPush(const uint8_t *data, size_t len, void *ctx) {
+    samples_stream_t *stream = (samples_stream_t *)ctx;
+    uint8_t bps = stream->bits_per_sample;
 
-    return PM3_SUCCESS;
+    // GraphBuffer is only replaced once samples arrive
+    if (stream->started == false) {
+        g_GraphTraceLen = 0;
+        stream->started = true;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        if (bps >= 8) {
+            samples_stream_put(stream, ((int)data[i]) - 127);
+            continue;
+        }
+
+        stream->pending = (stream->pending << 8) | data[i];
+        stream->pending_bits += 8;
+        while (stream->pending_bits >= bps) {
+            stream->pending_bits -= bps;
+            uint8_t sample = ((stream->pending >> stream->pending_bits) & ((1 << bps) - 1)) << (8 - bps);
+            samples_stream_put(stream, ((int) sample) - 127);
+        }
+    }
+
+    if (stream->cb) {
+        return true;
+    }
+    // no room left, stop the transfer
+    return (g_GraphTraceLen < MAX_GRAPH_TRACE_LEN);
+}
+
+int getSamplesStreamDone(samples_stream_t *stream, bool verbose) {
+    if (stream->cb && stream->chunk_len) {
+        stream->cb(stream->chunk, stream->chunk_len, stream->cb_ctx);
+        stream->chunk_len = 0;
+    }
+    if (verbose) PrintAndLogEx(INFO, "Unpacked %zu samples", g_GraphTraceLen);
+    return samplesToGraphDone();
 }
 
 static int CmdSamples(const char *Cmd) {
@@ -2866,153 +3131,90 @@ static int CmdAsn1Decoder(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-static int CmdDiff(const char *Cmd) {
-
-    CLIParserContext *ctx;
-    CLIParserInit(&ctx, "data diff",
-                  "Diff takes a multitude of input data and makes a binary compare.\n"
-                  "It accepts filenames (filesystem or RDV4 flashmem SPIFFS), emulator memory, magic gen1",
-                  "data diff -w 4 -a hf-mfu-01020304.bin -b hf-mfu-04030201.bin\n"
-                  "data diff -a fileA -b fileB\n"
-                  "data diff -a fileA --eb\n"
-                  "data diff --fa fileA -b fileB\n"
-                  "data diff --fa fileA --fb fileB\n"
-                 );
-
-    void *argtable[] = {
-        arg_param_begin,
-        arg_str0("a",  NULL, "<fn>", "input file name A"),
-        arg_str0("b",  NULL, "<fn>", "input file name B"),
-        arg_lit0(NULL, "eb", "emulator memory <hf mf esave>"),
-        arg_str0(NULL, "fa", "<fn>", "input spiffs file A"),
-        arg_str0(NULL, "fb", "<fn>", "input spiffs file B"),
-        arg_int0("w",  NULL, "<4|8|16>", "Width of data output"),
-        arg_param_end
-    };
-    CLIExecWithReturn(ctx, Cmd, argtable, false);
-
-    int fnlenA = 0;
-    char filenameA[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filenameA, FILE_PATH_SIZE, &fnlenA);
-
-    int fnlenB = 0;
-    char filenameB[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filenameB, FILE_PATH_SIZE, &fnlenB);
-
-    bool use_e = arg_get_lit(ctx, 3);
-
-    // SPIFFS filename A
-    int splenA = 0;
-    char spnameA[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)spnameA, FILE_PATH_SIZE, &splenA);
-
-    // SPIFFS filename B
-    int splenB = 0;
-    char spnameB[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)spnameB, FILE_PATH_SIZE, &splenB);
-
-    int width = arg_get_int_def(ctx, 6, 16);
-    CLIParserFree(ctx);
-
-    // sanity check
-    if (IfPm3Rdv4Fw() == false && (splenA > 0 || splenB > 0)) {
-        PrintAndLogEx(WARNING, "No RDV4 Flashmemory available");
-        return PM3_EINVARG;
-    }
-
-    if (splenA > 32) {
-        PrintAndLogEx(WARNING, "SPIFFS filname A length is large than 32 bytes, got %d", splenA);
-        return PM3_EINVARG;
-    }
-    if (splenB > 32) {
-        PrintAndLogEx(WARNING, "SPIFFS filname B length is large than 32 bytes, got %d", splenB);
-        return PM3_EINVARG;
-    }
-
-    //
-    if (width > 16 || width < 1) {
-        PrintAndLogEx(INFO, "Width out of range, using default 16 bytes width");
-        width = 16;
-    }
-
-    // if user supplied dump file,  time to load it
-    int res = PM3_SUCCESS;
-    uint8_t *inA = NULL, *inB = NULL;
-    size_t datalenA = 0, datalenB = 0;
-
-
-
-    // read file A
-    if (fnlenA) {
-        // read dump file
-        res = pm3_load_dump(filenameA, (void **)&inA, &datalenA, MIFARE_4K_MAX_BYTES);
-        if (res != PM3_SUCCESS) {
-            return res;
+// first offset in [pos, end) where a and b differ, or end. Equal 8 byte words are skipped
+static size_t diff_next(const uint8_t *a, const uint8_t *b, size_t pos, size_t end) {
+    for (; pos + 8 <= end; pos += 8) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + pos, sizeof(wa));
+        memcpy(&wb, b + pos, sizeof(wb));
+        if (wa != wb) {
+            break;
         }
     }
-
-    // read file B
-    if (fnlenB) {
-        // read dump file
-        res = pm3_load_dump(filenameB, (void **)&inB, &datalenB, MIFARE_4K_MAX_BYTES);
-        if (res != PM3_SUCCESS) {
-            return res;
+    for (; pos < end; pos++) {
+        if (a[pos] != b[pos]) {
+            break;
         }
     }
+    return pos;
+}
 
-    // read spiffs file A
-    if (splenA) {
-        res = flashmem_spiffs_download(spnameA, splenA, (void **)&inA, &datalenA);
-        if (res != PM3_SUCCESS) {
-            return res;
+typedef struct {
+    size_t bytes;       // differing bytes, bytes only one side has count too
+    size_t lines;       // output lines of width bytes with a difference
+    size_t first;       // offset of the first difference, SIZE_MAX if none
+} diff_stats_t;
+
+static void diff_stats(const uint8_t *a, size_t alen, const uint8_t *b, size_t blen, int width, diff_stats_t *st) {
+    memset(st, 0, sizeof(diff_stats_t));
+    st->first = SIZE_MAX;
+
+    size_t common = MIN(alen, blen);
+    size_t biggest = MAX(alen, blen);
+    size_t last_line = SIZE_MAX;
+    for (size_t pos = diff_next(a, b, 0, common); pos < common; pos = diff_next(a, b, pos + 1, common)) {
+        if (st->first == SIZE_MAX) {
+            st->first = pos;
         }
-    }
-
-    // read spiffs file B
-    if (splenB) {
-        res = flashmem_spiffs_download(spnameB, splenB, (void **)&inB, &datalenB);
-        if (res != PM3_SUCCESS) {
-            return res;
+        st->bytes++;
+        if (pos / width != last_line) {
+            last_line = pos / width;
+            st->lines++;
         }
     }
 
-    // download emulator memory
-    if (use_e) {
-
-        uint8_t *d = calloc(MIFARE_4K_MAX_BYTES, sizeof(uint8_t));
-        if (d == NULL) {
-            PrintAndLogEx(WARNING, "Failed to allocate memory");
-            return PM3_EMALLOC;
+    if (biggest > common) {
+        if (st->first == SIZE_MAX) {
+            st->first = common;
         }
-
-        PrintAndLogEx(INFO, "downloading from emulator memory");
-        if (GetFromDevice(BIG_BUF_EML, d, MIFARE_4K_MAX_BYTES, 0, NULL, 0, NULL, 2500, false) == false) {
-            PrintAndLogEx(WARNING, "Fail, transfer from device time-out");
-            free(inA);
-            free(inB);
-            free(d);
-            return PM3_ETIMEOUT;
+        st->bytes += biggest - common;
+        size_t from = common / width;
+        if (from == last_line) {
+            from++;
         }
-
-        if (fnlenA) {
-            datalenB = MIFARE_4K_MAX_BYTES;
-            inB = d;
-        } else {
-            datalenA = MIFARE_4K_MAX_BYTES;
-            inA = d;
+        size_t to = (biggest - 1) / width;
+        if (to >= from) {
+            st->lines += to - from + 1;
         }
     }
+}
+
+static void diff_print_summary(const char *nameA, const char *nameB, size_t alen, size_t blen, const diff_stats_t *st) {
+    char first[20] = "none";
+    if (st->first != SIZE_MAX) {
+        snprintf(first, sizeof(first), "0x%zX", st->first);
+    }
+    PrintAndLogEx(NORMAL, "a=%s\tb=%s\tlen_a=%zu\tlen_b=%zu\tdiff_bytes=%zu\tdiff_lines=%zu\tfirst=%s"
+                  , nameA, nameB, alen, blen, st->bytes, st->lines, first
+                 );
+}
+
+// side by side hex listing, changes only prints the lines with a difference
+static void diff_print(const char *nameA, const char *nameB, const uint8_t *inA, size_t datalenA, const uint8_t *inB, size_t datalenB, int width, bool changes) {
 
     size_t biggest = (datalenA > datalenB) ? datalenA : datalenB;
     PrintAndLogEx(DEBUG, "data len:  %zu   A %zu  B %zu", biggest, datalenA, datalenB);
 
-    if (inA == NULL) {
-        PrintAndLogEx(INFO, "inA null");
+    char filenameA[FILE_PATH_SIZE] = {0};
+    char filenameB[FILE_PATH_SIZE] = {0};
+    if (nameA) {
+        strncpy(filenameA, nameA, sizeof(filenameA) - 1);
     }
-
-    if (inB == NULL) {
-        PrintAndLogEx(INFO, "inB null");
+    if (nameB) {
+        strncpy(filenameB, nameB, sizeof(filenameB) - 1);
     }
+    int fnlenA = strlen(filenameA);
+    int fnlenB = strlen(filenameB);
 
     char hdr0[400] = {0};
 
@@ -3059,7 +3261,16 @@ static int CmdDiff(const char *Cmd) {
     char line[880] = {0};
 
     // print data diff loop
+    size_t common = MIN(datalenA, datalenB);
+    size_t skipped = 0;
     for (int i = 0 ; i < biggest ; i += width) {
+
+        // identical line, both sides have all of it
+        if (changes && i + width <= common && diff_next(inA, inB, i, i + width) == (size_t)(i + width)) {
+            skipped++;
+            continue;
+        }
+
         char dlnA[240] = {0};
         char dlnB[240] = {0};
         char dlnAii[180] = {0};
@@ -3127,11 +3338,649 @@ static int CmdDiff(const char *Cmd) {
 
     // footer
     PrintAndLogEx(INFO, hdr1);
+    if (changes) {
+        PrintAndLogEx(INFO, "skipped " _YELLOW_("%zu") " identical lines", skipped);
+    }
     PrintAndLogEx(NORMAL, "");
+}
 
-    free(inB);
-    free(inA);
-    return PM3_SUCCESS;
+typedef struct {
+    const char *fn;
+    uint8_t *data;
+    size_t len;
+    int res;
+    diff_stats_t st;
+} diff_job_t;
+
+typedef struct {
+    const uint8_t *ref;
+    size_t reflen;
+    int width;
+    bool keep;          // keep the data for a listing afterwards
+    diff_job_t *jobs;
+    size_t count;
+    size_t next;
+} diff_batch_t;
+
+static void *diff_batch_worker(void *arg) {
+    diff_batch_t *b = (diff_batch_t *)arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->count) {
+            break;
+        }
+        diff_job_t *job = &b->jobs[i];
+        job->res = pm3_load_dump(job->fn, (void **)&job->data, &job->len, MIFARE_4K_MAX_BYTES);
+        if (job->res != PM3_SUCCESS) {
+            job->data = NULL;
+            continue;
+        }
+        diff_stats(b->ref, b->reflen, job->data, job->len, b->width, &job->st);
+        if (b->keep == false) {
+            free(job->data);
+            job->data = NULL;
+        }
+    }
+    return NULL;
+}
+
+// one reference against many files, loaded and compared on all cores
+static int diff_batch(const char *nameA, const uint8_t *inA, size_t datalenA, const char **files, size_t count, int width, bool summary, bool changes) {
+
+    diff_batch_t b = {
+        .ref = inA,
+        .reflen = datalenA,
+        .width = width,
+        .keep = (summary == false),
+        .count = count,
+    };
+    b.jobs = calloc(b.count, sizeof(diff_job_t));
+    if (b.jobs == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    for (size_t i = 0; i < b.count; i++) {
+        b.jobs[i].fn = files[i];
+    }
+
+    int n = MIN(num_CPUs(), (int)b.count);
+    pthread_t *tids = calloc(n, sizeof(pthread_t));
+    int started = 0;
+    for (; tids && started < n; started++) {
+        if (pthread_create(&tids[started], NULL, diff_batch_worker, &b) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        diff_batch_worker(&b);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    size_t same = 0, failed = 0;
+    for (size_t i = 0; i < b.count; i++) {
+        diff_job_t *job = &b.jobs[i];
+        if (job->res != PM3_SUCCESS) {
+            failed++;
+            if (summary) {
+                PrintAndLogEx(NORMAL, "a=%s\tb=%s\terror=%d", nameA, job->fn, job->res);
+            }
+            continue;
+        }
+        if (job->st.bytes == 0) {
+            same++;
+        }
+        if (summary) {
+            diff_print_summary(nameA, job->fn, datalenA, job->len, &job->st);
+        } else {
+            diff_print(nameA, job->fn, inA, datalenA, job->data, job->len, width, changes);
+            free(job->data);
+        }
+    }
+    free(b.jobs);
+
+    if (summary == false) {
+        PrintAndLogEx(SUCCESS, "%zu files, " _GREEN_("%zu") " identical, " _YELLOW_("%zu") " different, %zu failed"
+                      , b.count, same, b.count - same - failed, failed
+                     );
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdDiff(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data diff",
+                  "Diff takes a multitude of input data and makes a binary compare.\n"
+                  "It accepts filenames (filesystem or RDV4 flashmem SPIFFS), emulator memory, magic gen1",
+                  "data diff -w 4 -a hf-mfu-01020304.bin -b hf-mfu-04030201.bin\n"
+                  "data diff -a fileA -b fileB\n"
+                  "data diff -a fileA --eb\n"
+                  "data diff --fa fileA -b fileB\n"
+                  "data diff --fa fileA --fb fileB\n"
+                  "data diff -a fileA -b fileB --changes\n"
+                  "data diff -a ref.bin -b d1.bin -b d2.bin -b d3.bin --summary\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("a",  NULL, "<fn>", "input file name A"),
+        arg_strn("b",  NULL, "<fn>", 0, 4096, "input file name B, more than one compares each against A"),
+        arg_lit0(NULL, "eb", "emulator memory <hf mf esave>"),
+        arg_str0(NULL, "fa", "<fn>", "input spiffs file A"),
+        arg_str0(NULL, "fb", "<fn>", "input spiffs file B"),
+        arg_int0("w",  NULL, "<4|8|16>", "Width of data output"),
+        arg_lit0(NULL, "changes", "only print lines with a difference"),
+        arg_lit0(NULL, "summary", "print one tab separated key=value line per compare instead"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlenA = 0;
+    char filenameA[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filenameA, FILE_PATH_SIZE, &fnlenA);
+
+    int fnlenB = 0;
+    char filenameB[FILE_PATH_SIZE] = {0};
+    struct arg_str *filesB = arg_get_str(ctx, 2);
+    if (filesB->count == 1) {
+        CLIParamStrToBuf(filesB, (uint8_t *)filenameB, FILE_PATH_SIZE, &fnlenB);
+    }
+
+    bool use_e = arg_get_lit(ctx, 3);
+
+    // SPIFFS filename A
+    int splenA = 0;
+    char spnameA[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)spnameA, FILE_PATH_SIZE, &splenA);
+
+    // SPIFFS filename B
+    int splenB = 0;
+    char spnameB[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)spnameB, FILE_PATH_SIZE, &splenB);
+
+    int width = arg_get_int_def(ctx, 6, 16);
+    bool changes = arg_get_lit(ctx, 7);
+    bool summary = arg_get_lit(ctx, 8);
+
+    // the file names of a batch belong to the parser context, it is freed at the end
+    size_t batchcnt = (filesB->count > 1) ? filesB->count : 0;
+    if (batchcnt && (splenB || (use_e && fnlenA))) {
+        PrintAndLogEx(WARNING, "Several B files can't be combined with --fb or emulator memory as B");
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    // sanity check
+    int res = PM3_SUCCESS;
+    if (IfPm3Rdv4Fw() == false && (splenA > 0 || splenB > 0)) {
+        PrintAndLogEx(WARNING, "No RDV4 Flashmemory available");
+        res = PM3_EINVARG;
+    }
+
+    if (splenA > 32) {
+        PrintAndLogEx(WARNING, "SPIFFS filname A length is large than 32 bytes, got %d", splenA);
+        res = PM3_EINVARG;
+    }
+    if (splenB > 32) {
+        PrintAndLogEx(WARNING, "SPIFFS filname B length is large than 32 bytes, got %d", splenB);
+        res = PM3_EINVARG;
+    }
+
+    //
+    if (width > 16 || width < 1) {
+        PrintAndLogEx(INFO, "Width out of range, using default 16 bytes width");
+        width = 16;
+    }
+
+    // if user supplied dump file,  time to load it
+    uint8_t *inA = NULL, *inB = NULL;
+    size_t datalenA = 0, datalenB = 0;
+
+    // read file A
+    if (res == PM3_SUCCESS && fnlenA) {
+        // read dump file
+        res = pm3_load_dump(filenameA, (void **)&inA, &datalenA, MIFARE_4K_MAX_BYTES);
+    }
+
+    // read file B
+    if (res == PM3_SUCCESS && fnlenB) {
+        // read dump file
+        res = pm3_load_dump(filenameB, (void **)&inB, &datalenB, MIFARE_4K_MAX_BYTES);
+    }
+
+    // read spiffs file A
+    if (res == PM3_SUCCESS && splenA) {
+        res = flashmem_spiffs_download(spnameA, splenA, (void **)&inA, &datalenA);
+    }
+
+    // read spiffs file B
+    if (res == PM3_SUCCESS && splenB) {
+        res = flashmem_spiffs_download(spnameB, splenB, (void **)&inB, &datalenB);
+    }
+
+    // download emulator memory
+    if (res == PM3_SUCCESS && use_e) {
+
+        uint8_t *d = calloc(MIFARE_4K_MAX_BYTES, sizeof(uint8_t));
+        if (d == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            res = PM3_EMALLOC;
+        } else {
+            PrintAndLogEx(INFO, "downloading from emulator memory");
+            if (GetFromDevice(BIG_BUF_EML, d, MIFARE_4K_MAX_BYTES, 0, NULL, 0, NULL, 2500, false) == false) {
+                PrintAndLogEx(WARNING, "Fail, transfer from device time-out");
+                free(d);
+                res = PM3_ETIMEOUT;
+            } else if (fnlenA) {
+                datalenB = MIFARE_4K_MAX_BYTES;
+                inB = d;
+            } else {
+                datalenA = MIFARE_4K_MAX_BYTES;
+                inA = d;
+            }
+        }
+    }
+
+    const char *nameA = (fnlenA) ? filenameA : (splenA) ? spnameA : "emulator";
+    const char *nameB = (fnlenB) ? filenameB : (splenB) ? spnameB : "emulator";
+
+    if (res != PM3_SUCCESS) {
+        if (summary && batchcnt == 0) {
+            PrintAndLogEx(NORMAL, "a=%s\tb=%s\terror=%d", nameA, nameB, res);
+        }
+    } else if (inA == NULL && batchcnt) {
+        PrintAndLogEx(WARNING, "Several B files need A as file, spiffs file or emulator memory");
+        res = PM3_EINVARG;
+    } else if (batchcnt) {
+        res = diff_batch(nameA, inA, datalenA, filesB->sval, batchcnt, width, summary, changes);
+    } else {
+
+        if (inA == NULL) {
+            PrintAndLogEx(INFO, "inA null");
+        }
+
+        if (inB == NULL) {
+            PrintAndLogEx(INFO, "inB null");
+        }
+
+        if (summary) {
+            diff_stats_t st;
+            diff_stats(inA, datalenA, inB, datalenB, width, &st);
+            diff_print_summary(nameA, nameB, datalenA, datalenB, &st);
+        } else {
+            diff_print(filenameA, filenameB, inA, datalenA, inB, datalenB, width, changes);
+        }
+    }
+
+    CLIParserFree(ctx);
+    free(inA);
+    free(inB);
+    return res;
+}
+
+#define CONVERT_MAX_BYTES   (64 * 1024)
+
+typedef enum {
+    CONV_DF_AUTO,
+    CONV_DF_MFC,
+    CONV_DF_MFU,
+    CONV_DF_ICLASS,
+    CONV_DF_RAW,
+} conv_df_e;
+
+static const char *conv_df_str[] = { "auto", "mfc", "mfu", "iclass", "raw" };
+
+typedef struct {
+    const char *fn;
+    char out[FILE_PATH_SIZE];   // output name without suffix
+    conv_df_e type;
+    int res;
+} convert_job_t;
+
+typedef struct {
+    DumpFileType_t to;
+    conv_df_e type;
+    convert_job_t *jobs;
+    size_t count;
+    size_t next;
+} convert_batch_t;
+
+// json and nfc files name their content, bin and eml files are guessed from size and content
+static conv_df_e convert_detect(const char *fn, const uint8_t *data, size_t len) {
+
+    DumpFileType_t ft = get_filetype(fn);
+    if (ft == MCT) {
+        return CONV_DF_MFC;
+    }
+
+    if (ft == FLIPPER) {
+        nfc_df_e nfctype = NFC_DF_UNKNOWN;
+        detect_nfc_dump_format(fn, &nfctype, false);
+        if (nfctype == NFC_DF_MFC) {
+            return CONV_DF_MFC;
+        }
+        if (nfctype == NFC_DF_MFU) {
+            return CONV_DF_MFU;
+        }
+        if (nfctype == NFC_DF_PICOPASS) {
+            return CONV_DF_ICLASS;
+        }
+        return CONV_DF_RAW;
+    }
+
+    if (ft == JSON) {
+        char ctype[32] = {0};
+        loadFileJSONtype(fn, ctype, sizeof(ctype));
+        if (strcmp(ctype, "mfcard") == 0 || strcmp(ctype, "mfc v2") == 0 || strcmp(ctype, "mfc v3") == 0) {
+            return CONV_DF_MFC;
+        }
+        if (strcmp(ctype, "mfu") == 0) {
+            return CONV_DF_MFU;
+        }
+        if (strcmp(ctype, "iclass") == 0) {
+            return CONV_DF_ICLASS;
+        }
+        return CONV_DF_RAW;
+    }
+
+    if (len == MIFARE_MINI_MAX_BYTES || len == MIFARE_1K_MAX_BYTES || len == MIFARE_2K_MAX_BYTES || len == MIFARE_4K_MAX_BYTES) {
+        return CONV_DF_MFC;
+    }
+
+    // plain, old or new Ultralight / NTAG layout, checked on a zero padded copy
+    if (len >= OLD_MFU_DUMP_PREFIX_LENGTH && len <= sizeof(mfu_dump_t)) {
+        uint8_t *tmp = calloc(1, sizeof(mfu_dump_t));
+        if (tmp) {
+            memcpy(tmp, data, len);
+            mfu_df_e mfutype = detect_mfu_dump_format(&tmp, false);
+            free(tmp);
+            if (mfutype != MFU_DF_UNKNOWN) {
+                return CONV_DF_MFU;
+            }
+        }
+    }
+    return CONV_DF_RAW;
+}
+
+static int convert_save(const convert_batch_t *b, const convert_job_t *job, uint8_t *data, size_t len) {
+
+    if (b->to == BIN) {
+        return saveFileEx(job->out, ".bin", data, len, spItemCount);
+    }
+
+    if (b->to == EML) {
+        if (job->type == CONV_DF_MFU) {
+            // emulator files hold the pages only
+            const mfu_dump_t *mfu = (const mfu_dump_t *)data;
+            return saveFileEML(job->out, mfu->data, len - MFU_DUMP_PREFIX_LENGTH, MFU_BLOCK_SIZE, spItemCount);
+        }
+        size_t blocksize = (job->type == CONV_DF_ICLASS) ? PICOPASS_BLOCK_SIZE : MFBLOCK_SIZE;
+        return saveFileEML(job->out, data, len, blocksize, spItemCount);
+    }
+
+    if (job->type == CONV_DF_MFC) {
+        if (len > MIFARE_4K_MAX_BYTES) {
+            PrintAndLogEx(WARNING, "`%s` is too large for a MIFARE Classic dump", job->fn);
+            return PM3_EOVFLOW;
+        }
+        iso14a_mf_extdump_t jd = {0};
+        pm3_mf_dump_card_info(data, len, &jd.card_info);
+        jd.dump = data;
+        jd.dumplen = len;
+        return saveFileJSONex(job->out, jsfMfc_v2, (uint8_t *)&jd, sizeof(jd), true, NULL, spItemCount);
+    }
+
+    if (job->type == CONV_DF_MFU) {
+        return saveFileJSONex(job->out, jsfMfuMemory, data, len, true, NULL, spItemCount);
+    }
+
+    if (job->type == CONV_DF_ICLASS) {
+        if (len < sizeof(picopass_hdr_t)) {
+            PrintAndLogEx(WARNING, "`%s` is too small for an iCLASS dump", job->fn);
+            return PM3_ESOFT;
+        }
+        return saveFileJSONex(job->out, jsfIclass, data, len, true, NULL, spItemCount);
+    }
+
+    return saveFileJSONex(job->out, jsfRaw, data, len, true, NULL, spItemCount);
+}
+
+static int convert_one(const convert_batch_t *b, convert_job_t *job) {
+
+    uint8_t *data = NULL;
+    size_t len = 0;
+    int res = pm3_load_dump(job->fn, (void **)&data, &len, CONVERT_MAX_BYTES);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    if (len == 0) {
+        free(data);
+        return PM3_ESOFT;
+    }
+
+    job->type = (b->type == CONV_DF_AUTO) ? convert_detect(job->fn, data, len) : b->type;
+
+    if (job->type == CONV_DF_MFU) {
+        // plain and old layouts become the one hf mfu dump saves
+        if (len < OLD_MFU_DUMP_PREFIX_LENGTH || len > sizeof(mfu_dump_t)) {
+            PrintAndLogEx(WARNING, "`%s` is not a MIFARE Ultralight / NTAG dump", job->fn);
+            free(data);
+            return PM3_ESOFT;
+        }
+
+        uint8_t *mfu = calloc(1, sizeof(mfu_dump_t));
+        if (mfu == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            free(data);
+            return PM3_EMALLOC;
+        }
+        memcpy(mfu, data, len);
+        free(data);
+        data = mfu;
+
+        res = convert_mfu_dump_format(&data, &len, false);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "`%s` is not a MIFARE Ultralight / NTAG dump", job->fn);
+            free(data);
+            return res;
+        }
+    }
+
+    res = convert_save(b, job, data, len);
+    free(data);
+    return res;
+}
+
+static void *convert_batch_worker(void *arg) {
+    convert_batch_t *b = (convert_batch_t *)arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->count) {
+            break;
+        }
+        if (b->jobs[i].res == PM3_SUCCESS) {
+            b->jobs[i].res = convert_one(b, &b->jobs[i]);
+        }
+    }
+    return NULL;
+}
+
+static bool convert_outname_used(const convert_job_t *jobs, size_t count, const char *out) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(jobs[i].out, out) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int CmdConvert(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data convert",
+                  "Convert dump files between bin, eml and json, on all cores.\n"
+                  "Reads bin, eml, json, mct and Flipper nfc / picopass dumps. The card type is taken from\n"
+                  "json and nfc files, bin and eml files are detected by size and content unless `-t` is given.\n"
+                  "Output files get the input name with the new suffix, existing files are never overwritten",
+                  "data convert -f hf-mf-01020304-dump.bin --to json\n"
+                  "data convert -f hf-mfu-04030201-dump.json --to eml\n"
+                  "data convert -d dumps --to json -o converted\n"
+                  "data convert -d dumps --to bin -t raw\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_strn("f",  "file", "<fn>", 0, 4096, "input file name, can be given several times"),
+        arg_str0("d",  "dir", "<dir>", "convert all dump files in this directory"),
+        arg_str1(NULL, "to", "<bin|eml|json>", "output format"),
+        arg_str0("o",  "out", "<dir>", "output directory (def: next to each input file)"),
+        arg_str0("t",  "type", "<mfc|mfu|iclass|raw>", "card type (def: auto detect)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    struct arg_str *files = arg_get_str(ctx, 1);
+
+    int dlen = 0;
+    char dir[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)dir, FILE_PATH_SIZE, &dlen);
+
+    int tolen = 0;
+    char to[8] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)to, sizeof(to), &tolen);
+
+    int olen = 0;
+    char outdir[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)outdir, FILE_PATH_SIZE, &olen);
+
+    int tlen = 0;
+    char type[8] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)type, sizeof(type), &tlen);
+
+    convert_batch_t b = { .type = CONV_DF_AUTO };
+
+    str_lower(to);
+    if (strcmp(to, "bin") == 0) {
+        b.to = BIN;
+    } else if (strcmp(to, "eml") == 0) {
+        b.to = EML;
+    } else if (strcmp(to, "json") == 0) {
+        b.to = JSON;
+    } else {
+        PrintAndLogEx(WARNING, "Unknown output format `" _YELLOW_("%s") "`, use bin, eml or json", to);
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    str_lower(type);
+    if (tlen) {
+        bool found = false;
+        for (int i = CONV_DF_MFC; i < ARRAYLEN(conv_df_str); i++) {
+            if (strcmp(type, conv_df_str[i]) == 0) {
+                b.type = i;
+                found = true;
+            }
+        }
+        if (found == false) {
+            PrintAndLogEx(WARNING, "Unknown card type `" _YELLOW_("%s") "`, use mfc, mfu, iclass or raw", type);
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+    }
+
+    if (files->count == 0 && dlen == 0) {
+        PrintAndLogEx(WARNING, "Give input files or a directory");
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    char **dirfiles = NULL;
+    size_t dircount = 0;
+    if (dlen) {
+        int res = listDumpFiles(dir, &dirfiles, &dircount);
+        if (res != PM3_SUCCESS) {
+            CLIParserFree(ctx);
+            return res;
+        }
+    }
+
+    b.count = files->count + dircount;
+    b.jobs = calloc(b.count ? b.count : 1, sizeof(convert_job_t));
+    if (b.jobs == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        for (size_t i = 0; i < dircount; i++) {
+            free(dirfiles[i]);
+        }
+        free(dirfiles);
+        CLIParserFree(ctx);
+        return PM3_EMALLOC;
+    }
+
+    // output names are settled here, two inputs with the same name must not race for one file
+    for (size_t i = 0; i < b.count; i++) {
+        convert_job_t *job = &b.jobs[i];
+        job->fn = (i < (size_t)files->count) ? files->sval[i] : dirfiles[i - files->count];
+
+        // leaves room for the suffixes added below
+        char base[FILE_PATH_SIZE - 32] = {0};
+        if (dump_outname(job->fn, outdir, base, sizeof(base)) == false) {
+            PrintAndLogEx(WARNING, "Output name for `%s` is too long", job->fn);
+            job->res = PM3_EOVFLOW;
+            continue;
+        }
+        snprintf(job->out, sizeof(job->out), "%s", base);
+
+        if (convert_outname_used(b.jobs, i, job->out)) {
+            // a.bin and a.eml both becoming a.json, tell them apart by the old suffix
+            const char *dot = strrchr(job->fn, '.');
+            snprintf(job->out, sizeof(job->out), "%s_%s", base, (dot) ? dot + 1 : "");
+        }
+        for (size_t n = 1; convert_outname_used(b.jobs, i, job->out); n++) {
+            snprintf(job->out, sizeof(job->out), "%s-%zu", base, n);
+        }
+    }
+
+    if (b.count == 0) {
+        PrintAndLogEx(INFO, "No dump files found in `" _YELLOW_("%s") "`", dir);
+    }
+
+    int n = MIN(num_CPUs(), (int)b.count);
+    pthread_t *tids = calloc(n ? n : 1, sizeof(pthread_t));
+    int started = 0;
+    for (; tids && started < n; started++) {
+        if (pthread_create(&tids[started], NULL, convert_batch_worker, &b) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        convert_batch_worker(&b);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    size_t failed = 0;
+    for (size_t i = 0; i < b.count; i++) {
+        convert_job_t *job = &b.jobs[i];
+        if (job->res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "`" _YELLOW_("%s") "` ( %s ) failed, error %d", job->fn, conv_df_str[job->type], job->res);
+            failed++;
+        }
+    }
+    PrintAndLogEx(SUCCESS, "%zu files, " _GREEN_("%zu") " converted to %s, %zu failed", b.count, b.count - failed, to, failed);
+
+    free(b.jobs);
+    for (size_t i = 0; i < dircount; i++) {
+        free(dirfiles[i]);
+    }
+    free(dirfiles);
+    CLIParserFree(ctx);
+    return (failed) ? PM3_ESOFT : PM3_SUCCESS;
 }
 
 /**
@@ -3987,6 +4836,7 @@ static command_t CommandTable[] = {
     {"print",            CmdPrintDemodBuff,       AlwaysAvailable,  "Print the data in the DemodBuffer"},
     {"save",             CmdSave,                 AlwaysAvailable,  "Save signal trace data"},
     {"setdebugmode",     CmdSetDebugMode,         AlwaysAvailable,  "Set Debugging Level on client side"},
+    {"snapshot",         CmdSnapshot,             AlwaysAvailable,  "Keep named copies of the graph"},
     {"xor",              CmdXor,                  AlwaysAvailable,  "Xor a input string"},
 
     {"-----------",      CmdHelp,                 AlwaysAvailable, "------------------------- " _CYAN_("Modulation") "-------------------------"},
@@ -4024,6 +4874,7 @@ static command_t CommandTable[] = {
     {"atr",              CmdAtrLookup,            AlwaysAvailable,  "ATR lookup"},
     {"bitsamples",       CmdBitsamples,           IfPm3Present,     "Get raw samples as bitstring"},
     {"bmap",             CmdBinaryMap,            AlwaysAvailable,  "Convert hex value according a binary template"},
+    {"convert",          CmdConvert,              AlwaysAvailable,  "Convert dump files between bin, eml and json"},
     {"crypto",           CmdCryptography,         AlwaysAvailable,  "Encrypt and decrypt data"},
     {"diff",             CmdDiff,                 AlwaysAvailable,  "Diff of input files"},
     {"hexsamples",       CmdHexsamples,           IfPm3Present,     "Dump big buffer as hex bytes"},
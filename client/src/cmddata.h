@@ -86,6 +86,26 @@ int getSamples(uint32_t n, bool verbose);
 int getSamplesEx(uint32_t start, uint32_t end, bool verbose, bool ignore_lf_config);
 int getSamplesFromBufEx(uint8_t *data, size_t sample_num, uint8_t bits_per_sample, bool verbose);
 
+// streaming unpack of raw samples into GraphBuffer, see WaitForRawDataStream
+// With a sample callback the unpacked samples are also handed over in chunks,
+// and the transfer goes on once GraphBuffer is full
+typedef void (*samples_stream_cb_t)(const int *samples, size_t n, void *ctx);
+#define SAMPLES_STREAM_CHUNK 256
+typedef struct {
+    uint8_t bits_per_sample;
+    uint8_t pending_bits;
+    uint16_t pending;
+    bool started;
+    samples_stream_cb_t cb;
+    void *cb_ctx;
+    uint16_t chunk_len;
+    int chunk[SAMPLES_STREAM_CHUNK];
+} samples_stream_t;
+void getSamplesStreamInit(samples_stream_t *stream, uint8_t bits_per_sample);
+void getSamplesStreamSetCallback(samples_stream_t *stream, samples_stream_cb_t cb, void *ctx);
+bool getSamplesStreamPush(const uint8_t *data, size_t len, void *ctx);
+int getSamplesStreamDone(samples_stream_t *stream, bool verbose);
+
 void setClockGrid(uint32_t clk, int offset);
 int directionalThreshold(const int *in, int *out, size_t len, int8_t up, int8_t down);
 int centerThreshold(const int *in, int *out, size_t len, int8_t up, int8_t down);
@@ -59,6 +59,10 @@
 #include "cmddata.h"
 #include "graph.h"
 #include "fpga.h"
+#include "fileutils.h"        // newfilenamemcopy
+#include "commonutil.h"       // MemLeToUint4byte
+#include "util_posix.h"       // msclock
+#include "cmdhw.h"            // set_fpga_mode
 
 static int CmdHelp(const char *Cmd);
 
@@ -418,6 +422,161 @@ const CLIParserOption HFSnoopSkipModeOpts[] = {
     {0,    NULL},
 };
 
+#define HF_STREAM_BUF_COUNT  16
+#define HF_STREAM_BUF_SIZE   (HF_STREAM_PACKET_LEN * 64)
+// dropped samples are written as mid scale, so they show up as a flat line
+#define HF_STREAM_GAP_VALUE  0x80
+
+typedef struct {
+    uint8_t pend[HF_STREAM_PACKET_LEN];     // received bytes, not a complete packet yet
+    size_t pend_len;
+    uint8_t last[HF_STREAM_PACKET_LEN - HF_STREAM_HDR_LEN];    // held back, it may be padded
+    bool have_last;
+    bool started;
+    bool ended;
+    uint32_t written;       // samples written, without gaps
+    uint32_t gaps;          // dropped samples, as reported in the packets
+    uint32_t total;         // from the end packet
+    uint32_t dropped;
+    FILE *f;
+    uint64_t last_print;
+} hf_stream_ctx_t;
+
+static void hf_stream_write_last(hf_stream_ctx_t *c, uint32_t n) {
+    if (c->have_last) {
+        fwrite(c->last, 1, n, c->f);
+        c->written += n;
+        c->have_last = false;
+    }
+}
+
+static bool hf_stream_packet(hf_stream_ctx_t *c, const uint8_t *p) {
+    if (p[0] == HF_STREAM_MAGIC_END) {
+        c->total = MemLeToUint4byte(p + 4);
+        c->dropped = MemLeToUint4byte(p + 8);
+        // strip the padding of the last data packet
+        uint32_t n = (c->total > c->written) ? c->total - c->written : 0;
+        hf_stream_write_last(c, MIN(n, sizeof(c->last)));
+        c->ended = true;
+        return true;
+    }
+
+    if (p[0] != HF_STREAM_MAGIC_DATA) {
+        PrintAndLogEx(WARNING, "\nunexpected data in the sample stream");
+        return false;
+    }
+
+    hf_stream_write_last(c, sizeof(c->last));
+
+    uint32_t gap = MemLeToUint3byte(p + 1);
+    c->gaps += gap;
+    while (gap--) {
+        fputc(HF_STREAM_GAP_VALUE, c->f);
+    }
+
+    memcpy(c->last, p + HF_STREAM_HDR_LEN, sizeof(c->last));
+    c->have_last = true;
+    return true;
+}
+
+static bool hf_stream_cb(const uint8_t *data, size_t len, void *ctx) {
+    hf_stream_ctx_t *c = (hf_stream_ctx_t *)ctx;
+
+    for (size_t i = 0; i < len && c->ended == false; i++) {
+
+        // anything the device sent before the stream started is skipped
+        if (c->started == false) {
+            if (data[i] != HF_STREAM_MAGIC_DATA && data[i] != HF_STREAM_MAGIC_END) {
+                continue;
+            }
+            c->started = true;
+        }
+
+        c->pend[c->pend_len++] = data[i];
+
+        size_t need = (c->pend[0] == HF_STREAM_MAGIC_END) ? HF_STREAM_END_LEN : HF_STREAM_PACKET_LEN;
+        if (c->pend_len == need) {
+            c->pend_len = 0;
+            if (hf_stream_packet(c, c->pend) == false) {
+                return false;
+            }
+        }
+    }
+
+    if (msclock() - c->last_print > 1000) {
+        c->last_print = msclock();
+        PrintAndLogEx(INPLACE, "%u samples, %u dropped", c->written, c->gaps);
+    }
+    return (c->ended == false);
+}
+
+static int hf_sniff_stream(const void *params, size_t params_len, const char *filename) {
+
+    hf_stream_ctx_t c;
+    memset(&c, 0, sizeof(c));
+
+    char *fn = newfilenamemcopy(filename, ".bin");
+    if (fn == NULL) {
+        return PM3_EMALLOC;
+    }
+    c.f = fopen(fn, "wb");
+    if (c.f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fn);
+        free(fn);
+        return PM3_EFILE;
+    }
+
+    uint8_t *mem = calloc(HF_STREAM_BUF_COUNT, HF_STREAM_BUF_SIZE);
+    if (mem == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        fclose(c.f);
+        free(fn);
+        return PM3_EMALLOC;
+    }
+    uint8_t *bufs[HF_STREAM_BUF_COUNT];
+    for (uint8_t i = 0; i < HF_STREAM_BUF_COUNT; i++) {
+        bufs[i] = mem + (i * HF_STREAM_BUF_SIZE);
+    }
+
+    // load the HF bitstream first, its answer must not end up in the sample stream
+    int res = set_fpga_mode(FPGA_BITSTREAM_HF);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "failed to load HF bitstream to FPGA");
+    } else {
+        clearCommandBuffer();
+        if (StartRawDataStream(bufs, HF_STREAM_BUF_COUNT, HF_STREAM_BUF_SIZE, (size_t) -1) == false) {
+            res = PM3_EFAILED;
+        } else {
+            SendCommandNG(CMD_HF_SNIFF, (uint8_t *)params, params_len);
+            PrintAndLogEx(INFO, "Streaming samples, press " _GREEN_("<Enter>") " or " _GREEN_("pm3 button") " to stop");
+            c.last_print = msclock();
+            WaitForRawDataStream((size_t) -1, false, false, hf_stream_cb, &c);
+            PrintAndLogEx(NORMAL, "");
+        }
+    }
+    free(mem);
+    // stopped before the end packet, keep what was received
+    hf_stream_write_last(&c, sizeof(c.last));
+    fclose(c.f);
+
+    if (c.started == false && res == PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "no sample stream received, the device needs to be connected over USB");
+        res = PM3_ESOFT;
+    } else if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Received " _YELLOW_("%u") " samples", c.written);
+        if (c.ended == false) {
+            PrintAndLogEx(WARNING, "stream ended without end marker, the last samples may be missing");
+        }
+        if (c.gaps || c.dropped) {
+            PrintAndLogEx(WARNING, "device dropped " _RED_("%u") " samples, the host was too slow", (c.ended) ? c.dropped : c.gaps);
+        }
+        PrintAndLogEx(SUCCESS, "Saved to binary file `" _YELLOW_("%s") "`", fn);
+        PrintAndLogEx(HINT, "Hint: Use `" _YELLOW_("data load -b -f %s") "` to view", fn);
+    }
+    free(fn);
+    return res;
+}
+
 // Collects pars of u8,
 // uses 16bit transfers from FPGA for speed
 // Takes all available bigbuff memory
@@ -430,7 +589,8 @@ int CmdHFSniff(const char *Cmd) {
                   "Use `data samples` to download from device and `data plot` to visualize it.\n"
                   "Press button to quit the sniffing.",
                   "hf sniff\n"
-                  "hf sniff --sp 1000 --st 0   -> skip 1000 pairs, skip 0 triggers"
+                  "hf sniff --sp 1000 --st 0   -> skip 1000 pairs, skip 0 triggers\n"
+                  "hf sniff --stream -f sniff  -> stream samples to sniff.bin until stopped"
                  );
     void *argtable[] = {
         arg_param_begin,
@@ -438,6 +598,8 @@ int CmdHFSniff(const char *Cmd) {
         arg_u64_0(NULL, "st",    "<dec>", "skip number of triggers"),
         arg_str0(NULL,  "smode", "[none|drop|min|max|avg]", "Skip mode. It switches on the function that applies to several samples before they saved to memory"),
         arg_int0(NULL,  "sratio",  "<dec, ms>", "Skip ratio. It applied the function above to (ratio * 2) samples. For ratio = 1 it 2 samples."),
+        arg_lit0(NULL,  "stream", "stream the samples to the host instead of filling the device memory"),
+        arg_str0("f",   "file",   "<fn>", "file to save the streamed samples to"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -447,6 +609,7 @@ int CmdHFSniff(const char *Cmd) {
         uint32_t triggersToSkip;
         uint8_t skipMode;
         uint8_t skipRatio;
+        uint8_t stream;
     } PACKED params;
 
     params.samplesToSkip = arg_get_u32_def(ctx, 1, 0);
@@ -460,9 +623,19 @@ int CmdHFSniff(const char *Cmd) {
 
     params.skipMode = smode;
     params.skipRatio = arg_get_int_def(ctx, 4, 0);
+    params.stream = arg_get_lit(ctx, 5);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 6), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
 
     CLIParserFree(ctx);
 
+    if (params.stream && fnlen == 0) {
+        PrintAndLogEx(WARNING, "streaming needs a file name, see `-f`");
+        return PM3_EINVARG;
+    }
+
     if (params.skipMode != HF_SNOOP_SKIP_NONE) {
         PrintAndLogEx(INFO, "Skip mode. Function: %s, each: %d sample",
                       CLIGetOptionListStr(HFSnoopSkipModeOpts, params.skipMode),
@@ -470,6 +643,10 @@ int CmdHFSniff(const char *Cmd) {
                      );
     }
 
+    if (params.stream) {
+        return hf_sniff_stream(&params, sizeof(params), filename);
+    }
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_SNIFF, (uint8_t *)&params, sizeof(params));
 
@@ -388,7 +388,9 @@ static int CmdHf14AConfig(const char *Cmd) {
                   "hf 14a config --mag on          -> Enable Apple magsafe polling\n"
                   "hf 14a config --mag off         -> Disable Apple magsafe polling\n"
                   "hf 14a config --pla <hex>       -> Set polling loop annotation (max 22 bytes)\n"
-                  "hf 14a config --pla off         -> Disable polling loop annotation\n");
+                  "hf 14a config --pla off         -> Disable polling loop annotation\n"
+                  "hf 14a config --adapt on        -> Learn tag answer times, shorten timeouts in key checks\n"
+                  "hf 14a config --adapt off       -> Use the full timeouts in key checks\n");
     void *argtable[] = {
         arg_param_begin,
         arg_str0(NULL, "atqa", "<std|force|skip>", "Configure ATQA<>anticollision behavior"),
@@ -398,13 +400,14 @@ static int CmdHf14AConfig(const char *Cmd) {
         arg_str0(NULL, "rats", "<std|force|skip>", "Configure RATS behavior"),
         arg_str0(NULL, "mag", "<on|off>", "Configure Apple MagSafe polling"),
         arg_str0(NULL, "pla", "<hex|off>", "Configure polling loop annotation"),
+        arg_str0(NULL, "adapt", "<on|off>", "Configure adaptive timeouts in key checks"),
         arg_lit0(NULL, "std", "Reset default configuration: follow all standard"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
-    bool defaults = arg_get_lit(ctx, 8);
-    bool verbose = arg_get_lit(ctx, 9);
+    bool defaults = arg_get_lit(ctx, 9);
+    bool verbose = arg_get_lit(ctx, 10);
 
     int vlen = 0;
     char value[64];
@@ -521,6 +524,19 @@ static int CmdHf14AConfig(const char *Cmd) {
         }
     }
 
+    int adaptive = defaults ? 0 : -1;
+    CLIParamStrToBuf(arg_get_str(ctx, 8), (uint8_t *)value, sizeof(value), &vlen);
+    if (vlen > 0) {
+        if (strcmp(value, "std") == 0) adaptive = 0;
+        else if (strcmp(value, "off") == 0) adaptive = 0;
+        else if (strcmp(value, "on") == 0) adaptive = 1;
+        else {
+            PrintAndLogEx(ERR, "adapt argument must be 'std', 'off' or 'on'");
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+    }
+
     CLIParserFree(ctx);
 
     // Handle empty command
@@ -540,6 +556,7 @@ static int CmdHf14AConfig(const char *Cmd) {
         .forcecl3 = cl3,
         .forcerats = rats,
         .magsafe = magsafe,
+        .adaptive = adaptive,
         .polling_loop_annotation = pla
     };
 
@@ -731,6 +748,12 @@ static int CmdHF14AReader(const char *Cmd) {
             }
 
             PrintAndLogEx(SUCCESS, " UID: " _GREEN_("%s"), sprint_hex(card.uid, card.uidlen));
+            result_add_hex("uid", card.uid, card.uidlen);
+            result_add_hex("atqa", (uint8_t[]) {card.atqa[1], card.atqa[0]}, 2);
+            result_add_int("sak", card.sak);
+            if (card.ats_len >= 3) {
+                result_add_hex("ats", card.ats, card.ats_len);
+            }
 
             if (!(silent && continuous)) {
                 PrintAndLogEx(SUCCESS, "ATQA: " _GREEN_("%02X %02X"), card.atqa[1], card.atqa[0]);
@@ -805,15 +828,27 @@ static int CmdHF14AInfo(const char *Cmd) {
 }
 
 // Collect ISO14443 Type A UIDs
+// UIDs as length byte + 10 bytes, for the duplicate count
+#define CUIDS_RECORD_SIZE 11
+
+static int cuids_cmp(const void *a, const void *b) {
+    return memcmp(a, b, CUIDS_RECORD_SIZE);
+}
+
 static int CmdHF14ACUIDs(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf 14a cuids",
-                  "Collect n>0 ISO14443-a UIDs in one go",
-                  "hf 14a cuids -n 5   --> Collect 5 UIDs");
+                  "Collect n>0 ISO14443-a UIDs in one go\n"
+                  "The device resets the field and selects the card in a loop, the UIDs come in bulk",
+                  "hf 14a cuids -n 5                  --> Collect 5 UIDs\n"
+                  "hf 14a cuids -n 0 -f uids.txt      --> Collect UIDs into a file until aborted"
+                 );
 
     void *argtable[] = {
         arg_param_begin,
-        arg_int0("n", "num", "<dec>", "Number of UIDs to collect"),
+        arg_int0("n", "num", "<dec>", "Number of UIDs to collect, 0 = until aborted"),
+        arg_str0("f", "file", "<fn>", "write the UIDs to this text file instead of the console"),
+        arg_int0(NULL, "reset", "<ms>", "field off and on time between two selects (def 5)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -822,44 +857,174 @@ static int CmdHF14ACUIDs(const char *Cmd) {
     // collect at least 1 (e.g. if no parameter was given)
     int n = arg_get_int_def(ctx, 1, 1);
 
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int reset_ms = arg_get_int_def(ctx, 3, 5);
     CLIParserFree(ctx);
 
-    uint64_t t1 =  msclock();
-    PrintAndLogEx(SUCCESS, "collecting %d UIDs", n);
+    if (n < 0 || reset_ms < 1 || reset_ms > 0xFF) {
+        PrintAndLogEx(ERR, "--num or --reset out of range");
+        return PM3_EINVARG;
+    }
 
-    // repeat n times
-    for (int i = 0; i < n; i++) {
+    FILE *f = NULL;
+    if (fnlen) {
+        f = fopen(filename, "w");
+        if (f == NULL) {
+            PrintAndLogEx(ERR, "error, could not create " _YELLOW_("%s"), filename);
+            return PM3_EFILE;
+        }
+    }
 
-        if (kbd_enter_pressed()) {
+    size_t cap = 0, count = 0;
+    uint8_t *uids = NULL;
+
+    iso14a_cuids_t payload = { .count = n, .reset_ms = reset_ms };
+
+    uint64_t t1 = msclock();
+    if (n) {
+        PrintAndLogEx(SUCCESS, "collecting %d UIDs", n);
+    } else {
+        PrintAndLogEx(SUCCESS, "collecting UIDs, press " _GREEN_("<Enter>") " to stop");
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_CUIDS, (uint8_t *)&payload, sizeof(payload));
+
+    int res = PM3_SUCCESS;
+    bool aborted = false;
+    iso14a_cuids_resp_t hdr = {0};
+    PacketResponseNG resp;
+    while (hdr.final == false) {
+
+        if (aborted == false && kbd_enter_pressed()) {
             PrintAndLogEx(WARNING, "aborted via keyboard!\n");
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_ISO14443A_CUIDS, &resp, 500) == false) {
+            continue;
+        }
+
+        if (resp.length < sizeof(iso14a_cuids_resp_t)) {
+            res = (resp.status != PM3_SUCCESS) ? resp.status : PM3_ESOFT;
             break;
         }
+        memcpy(&hdr, resp.data.asBytes, sizeof(hdr));
 
-        // execute anticollision procedure
-        SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT | ISO14A_NO_RATS, 0, 0, NULL, 0);
-        PacketResponseNG resp;
+        for (size_t pos = sizeof(hdr); pos < resp.length; ) {
+            uint8_t uidlen = resp.data.asBytes[pos];
+            const uint8_t *uid = resp.data.asBytes + pos + 1;
+            if (uidlen > 10 || pos + 1 + uidlen > resp.length) {
+                break;
+            }
+            pos += 1 + uidlen;
+
+            if (count == cap) {
+                cap = (cap) ? cap * 2 : 4096;
+                uint8_t *tmp = realloc(uids, cap * CUIDS_RECORD_SIZE);
+                if (tmp == NULL) {
+                    PrintAndLogEx(WARNING, "Failed to allocate memory");
+                    free(uids);
+                    if (f) {
+                        fclose(f);
+                    }
+                    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                    return PM3_EMALLOC;
+                }
+                uids = tmp;
+            }
+            uint8_t *rec = uids + (count++ * CUIDS_RECORD_SIZE);
+            memset(rec, 0, CUIDS_RECORD_SIZE);
+            rec[0] = uidlen;
+            memcpy(rec + 1, uid, uidlen);
 
-        if (WaitForResponseTimeout(CMD_ACK, &resp, 2500) == false) {
-            PrintAndLogEx(WARNING, "timeout while waiting for reply");
-            return PM3_ETIMEOUT;
+            if (f) {
+                fprintf(f, "%s\n", sprint_hex_inrow(uid, uidlen));
+            } else {
+                PrintAndLogEx(SUCCESS, "%s", sprint_hex_inrow(uid, uidlen));
+            }
         }
 
-        iso14a_card_select_t *card = (iso14a_card_select_t *) resp.data.asBytes;
+        if (hdr.final && resp.status != PM3_SUCCESS && resp.status != PM3_EOPABORTED) {
+            res = resp.status;
+        }
+    }
 
-        // check if command failed
-        if (resp.oldarg[0] == 0) {
-            PrintAndLogEx(WARNING, "card select failed.");
-        } else {
-            char uid_string[20];
-            for (uint16_t m = 0; m < card->uidlen; m++) {
-                int offset = 2 * m;
-                snprintf(uid_string + offset, sizeof(uid_string) - offset, "%02X", card->uid[m]);
+    uint64_t t2 = msclock() - t1;
+    if (f) {
+        fclose(f);
+        PrintAndLogEx(SUCCESS, "saved %zu UIDs to " _YELLOW_("%s"), count, filename);
+    }
+
+    // how random are they
+    size_t unique = 0;
+    if (count) {
+        qsort(uids, count, CUIDS_RECORD_SIZE, cuids_cmp);
+        unique = 1;
+        for (size_t i = 1; i < count; i++) {
+            if (memcmp(uids + (i * CUIDS_RECORD_SIZE), uids + ((i - 1) * CUIDS_RECORD_SIZE), CUIDS_RECORD_SIZE)) {
+                unique++;
             }
-            PrintAndLogEx(SUCCESS, "%s", uid_string);
         }
     }
-    PrintAndLogEx(SUCCESS, "end: %" PRIu64 " seconds", (msclock() - t1) / 1000);
-    return PM3_SUCCESS;
+    free(uids);
+
+    PrintAndLogEx(SUCCESS, "collected " _YELLOW_("%zu") " UIDs, " _YELLOW_("%zu") " unique, %u selects failed", count, unique, hdr.failed);
+    PrintAndLogEx(SUCCESS, "end: %" PRIu64 " seconds, %.1f UIDs/s", t2 / 1000, (t2) ? (float)count * 1000.0 / t2 : 0.0);
+    return res;
+}
+
+// UID list for a rotating simulation, one hex UID per line, `#` starts a comment
+static int hf14a_sim_load_uids(const char *filename, uint8_t uidlen, uint8_t *uids, uint16_t max, uint16_t *count) {
+
+    char *text = NULL;
+    size_t textlen = 0;
+    int res = loadFile_safeEx(filename, "", (void **)&text, &textlen, false);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    char *buf = realloc(text, textlen + 1);
+    if (buf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(text);
+        return PM3_EMALLOC;
+    }
+    buf[textlen] = '\0';
+
+    *count = 0;
+    res = PM3_SUCCESS;
+    int lineno = 0;
+    for (char *line = strtok(buf, "\r\n"); line != NULL; line = strtok(NULL, "\r\n")) {
+        lineno++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        uint8_t uid[10] = {0};
+        int n = hex_to_bytes(line, uid, sizeof(uid));
+        if (n == 0) {
+            continue;
+        }
+        if (n != uidlen) {
+            PrintAndLogEx(ERR, "line %d, expected a %u byte UID", lineno, uidlen);
+            res = PM3_EINVARG;
+            break;
+        }
+        if (*count == max) {
+            PrintAndLogEx(WARNING, "Only the first " _YELLOW_("%u") " UIDs fit in the command", max);
+            break;
+        }
+        memcpy(uids + (*count * uidlen), uid, uidlen);
+        (*count)++;
+    }
+    free(buf);
+    return res;
 }
 
 // ## simulate iso14443a tag
@@ -880,7 +1045,9 @@ int CmdHF14ASim(const char *Cmd) {
                   "hf 14a sim -t 10                -> ST25TA IKEA Rothult\n"
                   "hf 14a sim -t 11                -> Javacard (JCOP)\n"
                   "hf 14a sim -t 12                -> 4K Seos card\n"
-                  "hf 14a sim -t 13                -> MIFARE Ultralight C"
+                  "hf 14a sim -t 13                -> MIFARE Ultralight C\n"
+                  "hf 14a sim -t 1 --uid 11223344 --count 100      -> 100 UIDs from 11223344, next one on every activation\n"
+                  "hf 14a sim -t 1 --uid 11223344 --uids uids.txt  -> UIDs of the file, one per line"
                  );
 
     void *argtable[] = {
@@ -893,6 +1060,11 @@ int CmdHF14ASim(const char *Cmd) {
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0(NULL, "c1", "UL-C Auth - all zero handshake part 1"),
         arg_lit0(NULL, "c2", "UL-C Auth - all zero handshake part 2"),
+        arg_lit0(NULL, "ring", "keep the newest frames when the trace is full, instead of the oldest"),
+        arg_str0(NULL, "uids", "<fn>", "rotate through the UIDs of this file, same length as --uid"),
+        arg_int0(NULL, "count", "<dec>", "rotate through <count> UIDs counting up from --uid"),
+        arg_int0(NULL, "step", "<dec>", "increment between the counted UIDs (def 1)"),
+        arg_int0(NULL, "rotate", "<dec>", "activations before switching to the next UID (def 1)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -929,6 +1101,17 @@ int CmdHF14ASim(const char *Cmd) {
     bool ulc_p1 = arg_get_lit(ctx, 7);
     bool ulc_p2 = arg_get_lit(ctx, 8);
 
+    if (arg_get_lit(ctx, 9)) {
+        flags |= FLAG_TRACE_RING;
+    }
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 10), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int uid_count = arg_get_int_def(ctx, 11, 0);
+    int uid_step = arg_get_int_def(ctx, 12, 1);
+    int rotate_after = arg_get_int_def(ctx, 13, 1);
     CLIParserFree(ctx);
 
     if (tagtype > 13) {
@@ -936,6 +1119,16 @@ int CmdHF14ASim(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if ((fnlen || uid_count) && useUIDfromEML) {
+        PrintAndLogEx(ERR, "Rotating UIDs needs --uid");
+        return PM3_EINVARG;
+    }
+
+    if (uid_count < 0 || uid_count > UINT16_MAX || uid_step < 1 || uid_step > 0xFF || rotate_after < 1 || rotate_after > 0xFF) {
+        PrintAndLogEx(ERR, "--count, --step or --rotate out of range");
+        return PM3_EINVARG;
+    }
+
     if (useUIDfromEML) {
         FLAG_SET_UID_IN_EMUL(flags);
     }
@@ -948,8 +1141,13 @@ int CmdHF14ASim(const char *Cmd) {
         uint8_t rats[20];
         bool ulc_p1;
         bool ulc_p2;
+        uint8_t rotate_after;
+        uint8_t uid_step;
+        uint16_t uid_count;
+        uint8_t uids[PM3_CMD_DATA_SIZE - 40];
     } PACKED payload;
 
+    memset(&payload, 0, sizeof(payload));
     payload.tagtype = tagtype;
     payload.flags = flags;
     payload.exitAfter = exitAfterNReads;
@@ -957,8 +1155,32 @@ int CmdHF14ASim(const char *Cmd) {
     payload.ulc_p2 = ulc_p2;
     memcpy(payload.uid, uid, uid_len);
 
+    // rotating identities, precomputed by the device
+    size_t payload_len = sizeof(payload) - sizeof(payload.uids);
+    payload.rotate_after = rotate_after;
+    payload.uid_step = uid_step;
+    payload.uid_count = uid_count;
+    if (fnlen) {
+        uint16_t max = sizeof(payload.uids) / uid_len;
+        uint16_t count = 0;
+        int res = hf14a_sim_load_uids(filename, uid_len, payload.uids, max, &count);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        payload.uid_count = count;
+        payload_len += (payload.uid_count * uid_len);
+    }
+
+    if (payload.uid_count > 1) {
+        PrintAndLogEx(INFO, "Rotating " _YELLOW_("%u") " UIDs, next one after " _YELLOW_("%u") " activation%s"
+                      , payload.uid_count
+                      , rotate_after
+                      , (rotate_after > 1) ? "s" : ""
+                     );
+    }
+
     clearCommandBuffer();
-    SendCommandNG(CMD_HF_ISO14443A_SIMULATE, (uint8_t *)&payload, sizeof(payload));
+    SendCommandNG(CMD_HF_ISO14443A_SIMULATE, (uint8_t *)&payload, payload_len);
     PacketResponseNG resp = {0};
 
     sector_t *k_sector = NULL;
@@ -972,6 +1194,11 @@ int CmdHF14ASim(const char *Cmd) {
             continue;
         }
 
+        if (resp.status == PM3_EMALLOC && payload.uid_count > 1) {
+            PrintAndLogEx(ERR, "Not enough device memory for %u UIDs", payload.uid_count);
+            break;
+        }
+
         if (resp.status != PM3_SUCCESS) {
             break;
         }
@@ -1001,14 +1228,24 @@ int CmdHF14ASniff(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf 14a sniff",
                   "Sniff the communication between reader and tag\n"
-                  "Use `hf 14a list` to view collected data.",
-                  " hf 14a sniff -c -r"
+                  "Use `hf 14a list` to view collected data.\n"
+                  "With `--stream` the trace goes to the client while sniffing and is not limited by the device memory,\n"
+                  "view it with `hf 14a list -1`\n"
+                  "With `--keys` MIFARE Classic keys are recovered from the streamed authentications while sniffing",
+                  " hf 14a sniff -c -r\n"
+                  " hf 14a sniff --stream -f hf-14a-sniff\n"
+                  " hf 14a sniff --keys\n"
+                  " hf 14a sniff --keys -d mfc_default_keys.dic"
                  );
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("c", "card", "triggered by first data from card"),
         arg_lit0("r", "reader", "triggered by first 7-bit request from reader (REQ, WUP)"),
         arg_lit0("i", "interactive", "Console will not be returned until sniff finishes or is aborted"),
+        arg_lit0(NULL, "stream", "stream the trace to the client while sniffing (USB only)"),
+        arg_str0("f", "file", "<fn>", "with --stream, also write the trace to this file as it arrives"),
+        arg_lit0("k", "keys", "recover MIFARE Classic keys while sniffing (implies --stream)"),
+        arg_str0("d", "dict", "<fn>", "with --keys, dictionary for nested authentications"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1024,8 +1261,33 @@ int CmdHF14ASniff(const char *Cmd) {
     }
 
     bool interactive = arg_get_lit(ctx, 3);
+    bool stream = arg_get_lit(ctx, 4);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    bool keys = arg_get_lit(ctx, 6);
+
+    int diclen = 0;
+    char dictionary[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 7), (uint8_t *)dictionary, FILE_PATH_SIZE, &diclen);
     CLIParserFree(ctx);
 
+    if (stream || keys) {
+        param |= 0x04;
+        int res;
+        if (keys) {
+            res = trace_stream_sniff_mf(CMD_HF_ISO14443A_SNIFF, &param, sizeof(uint8_t), filename, dictionary);
+        } else {
+            res = trace_stream_sniff(CMD_HF_ISO14443A_SNIFF, &param, sizeof(uint8_t), filename);
+        }
+        if (res == PM3_SUCCESS) {
+            PrintAndLogEx(HINT, "Hint: Try `" _YELLOW_("hf 14a list -1")"` to view captured tracelog");
+        }
+        return res;
+    }
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_ISO14443A_SNIFF, (uint8_t *)&param, sizeof(uint8_t));
 
@@ -1410,6 +1672,317 @@ int ExchangeAPDU14a(const uint8_t *datain, int datainlen, bool activateField, bo
     return PM3_SUCCESS;
 }
 
+// Runs the APDUs back to back on the device, as many per CMD_HF_ISO14443A_APDU_BATCH round trip as fit.
+// The card must be selected with the field left on. cb gets every result in order, a result with an
+// error status ends the run. Returns how many APDUs ran in *executed.
+int ExchangeAPDU14aBatch(const apdu_batch_item_t *items, size_t count, bool stop_on_sw, apdu_batch_cb_t cb, void *cbdata, size_t *executed) {
+    apdu_batch_hdr_t hdr = {
+        .flags = (stop_on_sw) ? APDU_BATCH_FLAG_STOP_ON_SW : 0,
+        .frame_len = (g_apdu_in_framing_enable) ? gs_frame_len : 0,
+    };
+
+    uint8_t payload[PM3_CMD_DATA_SIZE];
+    int res = PM3_SUCCESS;
+    *executed = 0;
+
+    while (*executed < count) {
+
+        memcpy(payload, &hdr, sizeof(hdr));
+        uint16_t plen = sizeof(hdr);
+        size_t n = 0;
+        while ((*executed + n < count) && (n < UINT8_MAX)) {
+            const apdu_batch_item_t *item = &items[*executed + n];
+            if (item->len > APDU_BATCH_APDU_MAX) {
+                return PM3_EINVARG;
+            }
+            if (plen + sizeof(apdu_batch_cmd_t) + item->len > sizeof(payload)) {
+                break;
+            }
+            apdu_batch_cmd_t cmd = { .len = item->len, .sw = item->sw, .sw_mask = item->sw_mask };
+            memcpy(payload + plen, &cmd, sizeof(cmd));
+            plen += sizeof(cmd);
+            memcpy(payload + plen, item->apdu, item->len);
+            plen += item->len;
+            n++;
+        }
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_ISO14443A_APDU_BATCH, payload, plen);
+
+        bool final = false;
+        uint8_t done = 0;
+        while (final == false) {
+            PacketResponseNG resp;
+            // every frame and WTX restarts the timeout
+            if (WaitForResponseTimeout(CMD_HF_ISO14443A_APDU_BATCH, &resp, 1500 * n) == false) {
+                PrintAndLogEx(DEBUG, "ERR: APDU batch: Reply timeout");
+                return PM3_ETIMEOUT;
+            }
+
+            if (resp.length < sizeof(batch_reply_hdr_t)) {
+                return (resp.status != PM3_SUCCESS) ? resp.status : PM3_ESOFT;
+            }
+
+            batch_reply_hdr_t rhdr;
+            memcpy(&rhdr, resp.data.asBytes, sizeof(rhdr));
+            final = rhdr.final;
+
+            uint16_t pos = sizeof(rhdr);
+            while (pos + sizeof(apdu_batch_reply_t) <= resp.length) {
+                apdu_batch_reply_t entry;
+                memcpy(&entry, resp.data.asBytes + pos, sizeof(entry));
+                pos += sizeof(entry);
+                if (entry.len > resp.length - pos || entry.index >= n) {
+                    return PM3_ESOFT;
+                }
+
+                if (cb) {
+                    cb(*executed + entry.index, entry.status, resp.data.asBytes + pos, entry.len, cbdata);
+                }
+                pos += entry.len;
+            }
+
+            if (final) {
+                res = resp.status;
+                done = rhdr.executed;
+            }
+        }
+
+        *executed += done;
+
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+
+        // stopped at an unexpected status word
+        if (done < n) {
+            break;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+#define APDU_SCRIPT_MAX_LINES 1024
+
+typedef struct {
+    uint8_t apdu[APDU_BATCH_APDU_MAX];
+    uint16_t len;
+    uint16_t sw;
+    uint16_t sw_mask;
+} apdu_script_line_t;
+
+typedef struct {
+    const apdu_script_line_t *lines;
+    bool decodeTLV;
+    size_t failed;
+} apdu_script_ctx_t;
+
+// expected status word, four hex digits where x is any, e.g. 9000 or 61xx
+static bool APDUScriptParseSW(const char *s, uint16_t *sw, uint16_t *mask) {
+    *sw = 0;
+    *mask = 0;
+    if (strlen(s) != 4) {
+        return false;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        *sw <<= 4;
+        *mask <<= 4;
+        if (tolower(s[i]) == 'x') {
+            continue;
+        }
+        if (isxdigit(s[i]) == 0) {
+            return false;
+        }
+        *sw |= char2int(s[i]);
+        *mask |= 0xF;
+    }
+    return true;
+}
+
+// one APDU per line, optionally followed by the expected status word. # starts a comment
+static int APDUScriptLoad(const char *filename, apdu_script_line_t **plines, size_t *pcount) {
+    *plines = NULL;
+    *pcount = 0;
+
+    char *path = NULL;
+    if (searchFile(&path, RESOURCES_SUBDIR, filename, ".txt", true) != PM3_SUCCESS) {
+        if (searchFile(&path, RESOURCES_SUBDIR, filename, "", false) != PM3_SUCCESS) {
+            return PM3_EFILE;
+        }
+    }
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "couldn't open `" _YELLOW_("%s") "`", path);
+        free(path);
+        return PM3_EFILE;
+    }
+    free(path);
+
+    apdu_script_line_t *lines = calloc(APDU_SCRIPT_MAX_LINES, sizeof(apdu_script_line_t));
+    if (lines == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    char line[1200];
+    char apduhex[1100];
+    char swhex[16];
+    size_t count = 0;
+    int lineno = 0;
+    int res = PM3_SUCCESS;
+
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        memset(swhex, 0, sizeof(swhex));
+        int n = sscanf(line, "%1099s %15s", apduhex, swhex);
+        if (n <= 0) {
+            continue;
+        }
+
+        if (count == APDU_SCRIPT_MAX_LINES) {
+            PrintAndLogEx(ERR, "script has more than %d APDUs", APDU_SCRIPT_MAX_LINES);
+            res = PM3_EOVFLOW;
+            break;
+        }
+
+        apdu_script_line_t *l = &lines[count];
+        int len = hex_to_bytes(apduhex, l->apdu, sizeof(l->apdu));
+        if (len <= 0) {
+            PrintAndLogEx(ERR, "line %d, APDU must be hex and at most %zu bytes", lineno, sizeof(l->apdu));
+            res = PM3_EINVARG;
+            break;
+        }
+        l->len = len;
+
+        if (n > 1 && APDUScriptParseSW(swhex, &l->sw, &l->sw_mask) == false) {
+            PrintAndLogEx(ERR, "line %d, status word must be 4 hex digits, x for any. e.g. 9000 or 61xx", lineno);
+            res = PM3_EINVARG;
+            break;
+        }
+        count++;
+    }
+    fclose(f);
+
+    if (res != PM3_SUCCESS) {
+        free(lines);
+        return res;
+    }
+
+    *plines = lines;
+    *pcount = count;
+    return PM3_SUCCESS;
+}
+
+static bool APDUScriptPrintResult(const apdu_script_line_t *l, int8_t status, uint8_t *data, uint16_t len, bool decodeTLV) {
+    PrintAndLogEx(SUCCESS, ">>> %s", sprint_hex_inrow(l->apdu, l->len));
+
+    if (status != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "<<< exchange failed ( %d )", status);
+        return false;
+    }
+
+    if (len < 2) {
+        PrintAndLogEx(FAILED, "<<< no status word, len %u", len);
+        return false;
+    }
+
+    PrintAndLogEx(SUCCESS, "<<< %s | %s", sprint_hex_inrow(data, len), sprint_ascii(data, len));
+
+    uint16_t sw = (data[len - 2] << 8) | data[len - 1];
+    bool ok = ((sw & l->sw_mask) == (l->sw & l->sw_mask));
+    if (ok) {
+        PrintAndLogEx(SUCCESS, "<<< status: %02X %02X - %s", data[len - 2], data[len - 1], GetAPDUCodeDescription(data[len - 2], data[len - 1]));
+    } else {
+        PrintAndLogEx(WARNING, "<<< status: " _RED_("%02X %02X") " - %s, expected %04X/%04X", data[len - 2], data[len - 1], GetAPDUCodeDescription(data[len - 2], data[len - 1]), l->sw, l->sw_mask);
+    }
+
+    if (decodeTLV && len > 4) {
+        TLVPrintFromBuffer(data, len - 2);
+    }
+    return ok;
+}
+
+static void APDUScriptResult(size_t index, int8_t status, uint8_t *data, uint16_t len, void *cbdata) {
+    apdu_script_ctx_t *sctx = (apdu_script_ctx_t *)cbdata;
+    if (APDUScriptPrintResult(&sctx->lines[index], status, data, len, sctx->decodeTLV) == false) {
+        sctx->failed++;
+    }
+}
+
+// Runs an APDU script on the device, see ExchangeAPDU14aBatch
+static int CmdHF14AAPDUScript(const char *filename, bool activateField, bool leaveSignalON, bool decodeTLV, bool stop) {
+    apdu_script_line_t *lines = NULL;
+    size_t count = 0;
+    int res = APDUScriptLoad(filename, &lines, &count);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    if (count == 0) {
+        PrintAndLogEx(WARNING, "no APDUs in `" _YELLOW_("%s") "`", filename);
+        free(lines);
+        return PM3_EINVARG;
+    }
+
+    apdu_batch_item_t *items = calloc(count, sizeof(apdu_batch_item_t));
+    if (items == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(lines);
+        return PM3_EMALLOC;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        items[i].apdu = lines[i].apdu;
+        items[i].len = lines[i].len;
+        items[i].sw = lines[i].sw;
+        items[i].sw_mask = lines[i].sw_mask;
+    }
+
+    PrintAndLogEx(SUCCESS, "Loaded " _YELLOW_("%zu") " APDUs from `" _YELLOW_("%s") "`", count, filename);
+
+    if (activateField) {
+        // sets gs_frame_len
+        iso14a_card_select_t card;
+        res = SelectCard14443A_4(false, true, &card);
+        if (res != PM3_SUCCESS) {
+            free(items);
+            free(lines);
+            return res;
+        }
+    }
+
+    apdu_script_ctx_t sctx = { .lines = lines, .decodeTLV = decodeTLV, .failed = 0 };
+    size_t done = 0;
+    uint64_t t1 = msclock();
+
+    res = ExchangeAPDU14aBatch(items, count, stop, APDUScriptResult, &sctx, &done);
+    if (res == PM3_ETIMEOUT) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply, does the firmware know APDU batches?");
+    }
+
+    if (leaveSignalON == false) {
+        DropField();
+    }
+
+    PrintAndLogEx(SUCCESS, "executed " _YELLOW_("%zu") " of %zu APDUs, " _YELLOW_("%zu") " not as expected, in %" PRIu64 " ms", done, count, sctx.failed, msclock() - t1);
+    if (done < count) {
+        PrintAndLogEx(INFO, "stopped, next APDU " _YELLOW_("%s"), sprint_hex_inrow(lines[done].apdu, lines[done].len));
+    }
+
+    free(items);
+    free(lines);
+    return res;
+}
+
 // ISO14443-4. 7. Half-duplex block transmission protocol
 static int CmdHF14AAPDU(const char *Cmd) {
     CLIParserContext *ctx;
@@ -1424,11 +1997,20 @@ static int CmdHF14AAPDU(const char *Cmd) {
                   "  OR\n"
                   "\n"
                   "   use `-d` with complete APDU data\n"
-                  "   -d 00A404000E325041592E5359532E444446303100",
+                  "   -d 00A404000E325041592E5359532E444446303100\n"
+                  "\n"
+                  "  OR\n"
+                  "\n"
+                  "   use `-f` with a script, one APDU per line with an optional expected status word\n"
+                  "   (x for any digit), # starts a comment. The device runs the APDUs back to back,\n"
+                  "   chaining and WTX included.\n"
+                  "   00A404000E325041592E5359532E444446303100 9000\n"
+                  "   00B2010C00 61xx",
                   "hf 14a apdu -st -d 00A404000E325041592E5359532E444446303100\n"
                   "hf 14a apdu -sd -d 00A404000E325041592E5359532E444446303100        -> decode apdu\n"
                   "hf 14a apdu -sm 00A40400 -d 325041592E5359532E4444463031 -l 256    -> encode standard apdu\n"
-                  "hf 14a apdu -sm 00A40400 -d 325041592E5359532E4444463031 -el 65536 -> encode extended apdu\n");
+                  "hf 14a apdu -sm 00A40400 -d 325041592E5359532E4444463031 -el 65536 -> encode extended apdu\n"
+                  "hf 14a apdu -s -f apdu_script.txt --stop                            -> run script, stop at unexpected status\n");
 
     void *argtable[] = {
         arg_param_begin,
@@ -1439,7 +2021,9 @@ static int CmdHF14AAPDU(const char *Cmd) {
         arg_str0("m",  "make",     "<hex>", "APDU header, 4 bytes <CLA INS P1 P2>"),
         arg_lit0("e",  "extended", "make extended length apdu if `m` parameter included"),
         arg_int0("l",  "le",       "<dec>", "Le APDU parameter if `m` parameter included"),
-        arg_strx1("d", "data",     "<hex>", "full APDU package or data if `m` parameter included"),
+        arg_strx0("d", "data",     "<hex>", "full APDU package or data if `m` parameter included"),
+        arg_str0("f",  "file",     "<fn>", "APDU script file"),
+        arg_lit0(NULL, "stop",     "script, stop at the first unexpected status word"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -1449,6 +2033,33 @@ static int CmdHF14AAPDU(const char *Cmd) {
     bool decodeTLV = arg_get_lit(ctx, 3);
     bool decodeAPDU = arg_get_lit(ctx, 4);
 
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 9), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    bool stop = arg_get_lit(ctx, 10);
+
+    if (fnlen) {
+        if (arg_get_str_len(ctx, 5) || arg_get_str_len(ctx, 8) || arg_get_lit(ctx, 6) || decodeAPDU) {
+            PrintAndLogEx(ERR, "script mode, `-d`, `-m`, `-e` and `--decode` can't be used with `-f`");
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+        CLIParserFree(ctx);
+        return CmdHF14AAPDUScript(filename, activateField, leaveSignalON, decodeTLV, stop);
+    }
+
+    if (stop) {
+        PrintAndLogEx(ERR, "`--stop` only goes with `-f`");
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    if (arg_get_str_len(ctx, 8) == 0) {
+        PrintAndLogEx(ERR, "`-d` or `-f` is required");
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
     uint8_t header[PM3_CMD_DATA_SIZE];
     int headerlen = 0;
     CLIGetHexWithReturn(ctx, 5, header, &headerlen);
@@ -2659,6 +3270,12 @@ int infoHF14A(bool verbose, bool do_nack_test, bool do_aid_search) {
     PrintAndLogEx(SUCCESS, " UID: " _GREEN_("%s") " %s", sprint_hex(card.uid, card.uidlen), get_uid_type(&card));
     PrintAndLogEx(SUCCESS, "ATQA: " _GREEN_("%02X %02X"), card.atqa[1], card.atqa[0]);
     PrintAndLogEx(SUCCESS, " SAK: " _GREEN_("%02X [%" PRIu64 "]"), card.sak, select_status);
+    result_add_hex("uid", card.uid, card.uidlen);
+    result_add_hex("atqa", (uint8_t[]) {card.atqa[1], card.atqa[0]}, 2);
+    result_add_int("sak", card.sak);
+    if (card.ats_len >= 3) {
+        result_add_hex("ats", card.ats, card.ats_len);
+    }
     if (version_hw_available) {
         PrintAndLogEx(DEBUG, "GetV: " _GREEN_("%s"), sprint_hex((uint8_t *)&version_hw, sizeof(version_hw)));
     }
@@ -3338,6 +3955,67 @@ static uint32_t inc_sw_error_occurrence(uint16_t sw, uint32_t *all_sw) {
     return all_sw[(sw1 * 256) + sw2];
 }
 
+// probes of one P1/P2 sweep over all INS, with and without Le
+#define APDUFIND_MAX_PROBES (256 * 2)
+
+typedef struct {
+    uint8_t commands[APDUFIND_MAX_PROBES][5];
+    apdu_batch_item_t items[APDUFIND_MAX_PROBES];
+    size_t offset;               // first item of the running batch
+    uint32_t all_sw[256][256];
+    uint32_t error_limit;
+    bool verbose;
+    bool ins_unsupported[256];   // answered 6D00, no need to try other P1/P2
+    bool cla_supported;          // some INS answered something else than 6E00
+} apdufind_ctx_t;
+
+static void apdufind_result(size_t index, int8_t status, uint8_t *data, uint16_t len, void *cbdata) {
+    apdufind_ctx_t *fctx = (apdufind_ctx_t *)cbdata;
+    const apdu_batch_item_t *item = &fctx->items[fctx->offset + index];
+
+    // retried by the caller
+    if (status != PM3_SUCCESS) {
+        return;
+    }
+
+    uint16_t sw = get_sw(data, len);
+    uint32_t sw_occurrences = inc_sw_error_occurrence(sw, fctx->all_sw[0]);
+
+    if (sw == 0x6D00) {
+        fctx->ins_unsupported[item->apdu[1]] = true;
+    }
+    if (sw != 0x6E00) {
+        fctx->cla_supported = true;
+    }
+
+    if (fctx->verbose) {
+        PrintAndLogEx(INFO, "Status: [ CLA " _GREEN_("%02X") " INS " _GREEN_("%02X") " P1 " _GREEN_("%02X") " P2 " _GREEN_("%02X") " ]", item->apdu[0], item->apdu[1], item->apdu[2], item->apdu[3]);
+    }
+
+    // Show response.
+    if (sw_occurrences < fctx->error_limit) {
+        logLevel_t log_level = INFO;
+        if (sw == ISO7816_OK) {
+            log_level = SUCCESS;
+        }
+
+        if (fctx->verbose == true || sw != 0x6e00) {
+            PrintAndLogEx(log_level, "Got response for APDU \"%s\": %04X (%s)",
+                          sprint_hex_inrow(item->apdu, item->len),
+                          sw,
+                          GetAPDUCodeDescription(sw >> 8, sw & 0xff)
+                         );
+
+            if (len > 2) {
+                PrintAndLogEx(SUCCESS, "Response data is: %s | %s",
+                              sprint_hex_inrow(data, len - 2),
+                              sprint_ascii(data, len - 2)
+                             );
+            }
+        }
+    }
+}
+
 static int CmdHf14AFindapdu(const char *Cmd) {
     // TODO: Option to select AID/File (and skip INS 0xA4).
     // TODO: Check all instructions with extended APDUs if the card support it.
@@ -3347,6 +4025,9 @@ static int CmdHf14AFindapdu(const char *Cmd) {
                   "Enumerate APDU's of ISO7816 protocol to find valid CLS/INS/P1/P2 commands.\n"
                   "It loops all 256 possible values for each byte.\n"
                   "The loop oder is INS -> P1/P2 (alternating) -> CLA.\n"
+                  "Each INS loop runs on the device as APDU batches.\n"
+                  "An INS answered with 6D00 is not tried with other P1/P2, a CLA answered with 6E00\n"
+                  "for every INS is skipped. Use `--all` to try them anyway.\n"
                   "Tag must be on antenna before running.",
                   "hf 14a apdufind\n"
                   "hf 14a apdufind --cla 80\n"
@@ -3364,6 +4045,7 @@ static int CmdHf14AFindapdu(const char *Cmd) {
         arg_strx0("s", "skip-ins",      "<hex>",    "Do not test an instruction (can be specified multiple times)"),
         arg_lit0("l",  "with-le",                   "Search  for APDUs with Le=0 (case 2S) as well"),
         arg_lit0("v",  "verbose",                   "Verbose output"),
+        arg_lit0("a",  "all",                       "Try every P1/P2 and CLA, also after 6D00 / 6E00"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -3393,11 +4075,10 @@ static int CmdHf14AFindapdu(const char *Cmd) {
 
     bool with_le = arg_get_lit(ctx, 8);
     bool verbose = arg_get_lit(ctx, 9);
+    bool try_all = arg_get_lit(ctx, 10);
 
     CLIParserFree(ctx);
 
-    bool activate_field = true;
-    bool keep_field_on = true;
     uint8_t cla = cla_arg[0];
     uint8_t ins = ins_arg[0];
     uint8_t p1 = p1_arg[0];
@@ -3417,30 +4098,37 @@ static int CmdHf14AFindapdu(const char *Cmd) {
         return res;
     }
 
+    apdufind_ctx_t *fctx = calloc(1, sizeof(apdufind_ctx_t));
+    if (fctx == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    fctx->error_limit = error_limit;
+    fctx->verbose = verbose;
+
     PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(SUCCESS, "Starting the APDU finder [ CLA " _GREEN_("%02X") " INS " _GREEN_("%02X") " P1 " _GREEN_("%02X") " P2 " _GREEN_("%02X") " ]", cla, ins, p1, p2);
 
     bool inc_p1 = false;
-    bool skip_ins = false;
-    uint32_t all_sw[256][256] = { { 0 } };
-    uint32_t sw_occurrences = 0;
+    bool activate_field = true;
+    iso14a_card_select_t card;
 
     uint64_t t_start = msclock();
     uint64_t t_last_reset = msclock();
 
     // Enumerate APDUs.
     do {
+        memset(fctx->ins_unsupported, 0, sizeof(fctx->ins_unsupported));
+        fctx->cla_supported = false;
+        bool first_sweep = true;
+
         do {
+            // All INS for this CLA/P1/P2. Without Le (case 1) and with Le = 0 (case 2S), if "with-le" was set.
+            size_t n = 0;
             do {
-retry_ins:
-                // Exit (was the Enter key pressed)?
-                if (kbd_enter_pressed()) {
-                    PrintAndLogEx(INFO, "User interrupted detected. Aborting");
-                    goto out;
-                }
-
                 // Skip/Ignore this instrctuion?
+                bool skip_ins = (try_all == false) && fctx->ins_unsupported[ins];
                 for (int i = 0; i < ignore_ins_len; i++) {
                     if (ins == ignore_ins_arg[i]) {
                         skip_ins = true;
@@ -3449,55 +4137,73 @@ retry_ins:
                 }
 
                 if (skip_ins) {
-                    skip_ins = false;
                     continue;
                 }
 
-                if (verbose) {
-                    PrintAndLogEx(INFO, "Status: [ CLA " _GREEN_("%02X") " INS " _GREEN_("%02X") " P1 " _GREEN_("%02X") " P2 " _GREEN_("%02X") " ]", cla, ins, p1, p2);
+                for (int i = 0; i < 1 + with_le; i++) {
+                    uint8_t *command = fctx->commands[n];
+                    command[0] = cla;
+                    command[1] = ins;
+                    command[2] = p1;
+                    command[3] = p2;
+                    command[4] = 0x00;
+                    fctx->items[n].apdu = command;
+                    fctx->items[n].len = 4 + i;
+                    n++;
                 }
+            } while (++ins != ins_arg[0]);
 
-                // Send APDU without Le (case 1) and with Le = 0 (case 2S), if "with-le" was set.
-                uint8_t command[5] = {cla, ins, p1, p2, 0x00};
-                int command_n = 4;
-                for (int i = 0; i < 1 + with_le; i++) {
-                    // Send APDU.
-                    res = ExchangeAPDU14a(command, command_n + i, activate_field, keep_field_on, response, sizeof(response), &response_n);
-                    if (res != PM3_SUCCESS) {
+            size_t done = 0;
+            int retries = 0;
+            while (done < n) {
+                // Exit (was the Enter key pressed)?
+                if (kbd_enter_pressed()) {
+                    PrintAndLogEx(INFO, "User interrupted detected. Aborting");
+                    goto out;
+                }
+
+                if (activate_field) {
+                    if (SelectCard14443A_4(false, false, &card) != PM3_SUCCESS) {
                         DropField();
-                        activate_field = true;
-                        goto retry_ins;
+                        continue;
                     }
+                    // Do not reativate the filed until the next reset.
+                    activate_field = false;
+                }
 
-                    uint16_t sw = get_sw(response, response_n);
-                    sw_occurrences = inc_sw_error_occurrence(sw, all_sw[0]);
+                size_t executed = 0;
+                fctx->offset = done;
+                res = ExchangeAPDU14aBatch(&fctx->items[done], n - done, false, apdufind_result, fctx, &executed);
+                done += executed;
 
-                    // Show response.
-                    if (sw_occurrences < error_limit) {
-                        logLevel_t log_level = INFO;
-                        if (sw == ISO7816_OK) {
-                            log_level = SUCCESS;
-                        }
+                if (res != PM3_SUCCESS) {
+                    // the failed APDU is counted, try it again on a fresh selected tag
+                    if (executed) {
+                        done--;
+                    }
 
-                        if (verbose == true || sw != 0x6e00) {
-                            PrintAndLogEx(log_level, "Got response for APDU \"%s\": %04X (%s)",
-                                          sprint_hex_inrow(command, command_n + i),
-                                          sw,
-                                          GetAPDUCodeDescription(sw >> 8, sw & 0xff)
-                                         );
-
-                            if (response_n > 2) {
-                                PrintAndLogEx(SUCCESS, "Response data is: %s | %s",
-                                              sprint_hex_inrow(response, response_n - 2),
-                                              sprint_ascii(response, response_n - 2)
-                                             );
-                            }
-                        }
+                    if (++retries > 3) {
+                        PrintAndLogEx(WARNING, "No response for APDU \"%s\", skipping", sprint_hex_inrow(fctx->items[done].apdu, fctx->items[done].len));
+                        done++;
+                        retries = 0;
                     }
+
+                    DropField();
+                    activate_field = true;
+                } else {
+                    retries = 0;
                 }
-                // Do not reativate the filed until the next reset.
-                activate_field = false;
-            } while (++ins != ins_arg[0]);
+            }
+
+            // A CLA the tag doesn't support answers 6E00 to everything
+            if (first_sweep && n && fctx->cla_supported == false && try_all == false) {
+                PrintAndLogEx(INFO, "CLA " _YELLOW_("%02X") " is not supported, skipping it", cla);
+                p1 = p1_arg[0];
+                p2 = p2_arg[0];
+                inc_p1 = false;
+                break;
+            }
+            first_sweep = false;
 
             // Increment P1/P2 in an alternating fashion.
             if (inc_p1) {
@@ -3528,6 +4234,7 @@ retry_ins:
 out:
     PrintAndLogEx(SUCCESS, "Runtime: %" PRIu64 " seconds\n", (msclock() - t_start) / 1000);
     DropField();
+    free(fctx);
     return PM3_SUCCESS;
 }
 
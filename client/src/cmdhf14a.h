@@ -84,6 +84,18 @@ int infoHF14A4Applications(bool verbose);
 const char *getTagInfo(uint8_t uid);
 int Hf14443_4aGetCardData(iso14a_card_select_t *card);
 int ExchangeAPDU14a(const uint8_t *datain, int datainlen, bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen);
+// one APDU of ExchangeAPDU14aBatch, sw_mask 0 = any status word is fine
+typedef struct {
+    const uint8_t *apdu;
+    uint16_t len;
+    uint16_t sw;
+    uint16_t sw_mask;
+} apdu_batch_item_t;
+
+// result of APDU 'index', data holds the response with the status word
+typedef void (*apdu_batch_cb_t)(size_t index, int8_t status, uint8_t *data, uint16_t len, void *cbdata);
+
+int ExchangeAPDU14aBatch(const apdu_batch_item_t *items, size_t count, bool stop_on_sw, apdu_batch_cb_t cb, void *cbdata, size_t *executed);
 int ExchangeRAW14a(uint8_t *datain, int datainlen, bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen, bool silentMode);
 
 int SelectCard14443A_4(bool disconnect, bool verbose, iso14a_card_select_t *card);
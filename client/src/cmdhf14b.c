@@ -770,26 +770,24 @@ static void print_footer(void) {
     PrintAndLogEx(NORMAL, "");
 }
 
-/*
-static void print_ct_blocks(uint8_t *data, size_t len) {
+static void print_ct_blocks(uint8_t *data, size_t len, uint8_t block_size) {
 
-    size_t blocks = len / ST25TB_SR_BLOCK_SIZE;
+    size_t blocks = len / block_size;
 
     print_hdr();
 
-    for (int i = 0; i <= blocks; i++) {
+    for (int i = 0; i < blocks; i++) {
         PrintAndLogEx(INFO,
-                      "%3d/0x%02X | %s | %s | %s",
+                      "%3d/0x%02X | %-12s| %s | %s",
                       i,
                       i,
-                      sprint_hex(data + (i * 4), 4),
+                      sprint_hex(data + (i * block_size), block_size),
                       " ",
-                      sprint_ascii(data + (i * 4), 4)
+                      sprint_ascii(data + (i * block_size), block_size)
                      );
     }
     print_footer();
 }
-*/
 
 static void print_sr_blocks(uint8_t *data, size_t len, const uint8_t *uid, bool dense_output) {
 
@@ -1706,15 +1704,67 @@ static int CmdHF14BSriWrbl(const char *Cmd) {
     return status;
 }
 
-// need to write to file
+// Runs a device side bulk read. The blocks set in bitmap are read in one field session (all when NULL)
+// and downloaded in a single BIG_BUF transfer into data, block n at n * block size.
+static int hf14b_device_dump(iso14b_type_t type, uint8_t count, bool sysblock, const uint8_t *bitmap,
+                             iso14b_dump_resp_t *out, uint8_t *data, size_t datalen) {
+
+    iso14b_dump_t payload = {
+        .type = type,
+        .flags = (sysblock) ? ISO14B_DUMP_SYSBLOCK : 0,
+        .count = count,
+    };
+    if (bitmap) {
+        memcpy(payload.bitmap, bitmap, sizeof(payload.bitmap));
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443B_DUMP, (uint8_t *)&payload, sizeof(payload));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_HF_ISO14443B_DUMP, &resp, 5000) == false) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply");
+        return PM3_ETIMEOUT;
+    }
+
+    if (resp.length < sizeof(iso14b_dump_resp_t)) {
+        PrintAndLogEx(FAILED, "failed to select ( " _RED_("%d") " )", resp.status);
+        return (resp.status != PM3_SUCCESS) ? resp.status : PM3_ESOFT;
+    }
+
+    memcpy(out, resp.data.asBytes, sizeof(iso14b_dump_resp_t));
+    if (out->len == 0) {
+        PrintAndLogEx(FAILED, "failed to select ( " _RED_("%d") " )", resp.status);
+        return (resp.status != PM3_SUCCESS) ? resp.status : PM3_ESOFT;
+    }
+
+    int res = resp.status;
+    if (out->len > datalen) {
+        return PM3_EOVFLOW;
+    }
+
+    // the blocks read before a failure are still worth showing
+    if (GetFromDevice(BIG_BUF, data, out->len, out->offset, NULL, 0, NULL, 2500, false) == false) {
+        PrintAndLogEx(WARNING, "command execution time out");
+        return PM3_ETIMEOUT;
+    }
+    return res;
+}
+
+static bool hf14b_dump_has_block(const iso14b_dump_resp_t *r, uint8_t blockno) {
+    return (r->bitmap[blockno >> 3] & (1 << (blockno & 7)));
+}
+
 static int CmdHF14BDump(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf 14b dump",
                   "This command dumps the contents of a ISO-14443-B tag and save it to file\n"
-                  "Tries to autodetect cardtype, memory size defaults to SRI4K",
+                  "Tries to autodetect cardtype, memory size defaults to SRI4K\n"
+                  "All blocks are read by the device in one field session and downloaded in one transfer.\n"
+                  "Use `--start` / `--end` to only read a block range, and `--diff` to compare it with a previous dump",
                   "hf 14b dump\n"
                   "hf 14b dump -f myfilename\n"
+                  "hf 14b dump --start 5 --end 6 --diff hf-14b-D00233000A4F1B50-dump.json  -> poll the counter blocks\n"
                  );
 
     void *argtable[] = {
@@ -1722,6 +1772,9 @@ static int CmdHF14BDump(const char *Cmd) {
         arg_str0("f", "file", "<fn>", "(optional) filename,  if no <name> UID will be used as filename"),
         arg_lit0(NULL, "ns", "no save to file"),
         arg_lit0("z", "dense", "dense dump output style"),
+        arg_int0(NULL, "start", "<dec>", "first block to read (def 0)"),
+        arg_int0(NULL, "end", "<dec>", "last block to read (def last block of the tag)"),
+        arg_str0(NULL, "diff", "<fn>", "only show blocks that differ from this dump file"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1731,8 +1784,18 @@ static int CmdHF14BDump(const char *Cmd) {
     CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     bool nosave = arg_get_lit(ctx, 2);
     bool dense_output = (g_session.dense_output || arg_get_lit(ctx, 3));
+    int start = arg_get_int_def(ctx, 4, 0);
+    int end = arg_get_int_def(ctx, 5, -1);
+
+    int difflen = 0;
+    char diffname[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 6), (uint8_t *)diffname, FILE_PATH_SIZE, &difflen);
     CLIParserFree(ctx);
 
+    if (start < 0 || (end != -1 && end < start)) {
+        PrintAndLogEx(WARNING, "invalid block range");
+        return PM3_EINVARG;
+    }
 
     uint8_t select[sizeof(iso14b_card_select_t)] = {0};
     iso14b_type_t select_cardtype = ISO14B_NONE;
@@ -1741,20 +1804,6 @@ static int CmdHF14BDump(const char *Cmd) {
         return PM3_SUCCESS;
     }
 
-    if (select_cardtype == ISO14B_CT) {
-        iso14b_cts_card_select_t ct_card;
-        memcpy(&ct_card, (iso14b_cts_card_select_t *)&select, sizeof(iso14b_cts_card_select_t));
-
-        uint32_t uid32 = MemLeToUint4byte(ct_card.uid);
-        PrintAndLogEx(SUCCESS, "UID: " _GREEN_("%s") " ( " _YELLOW_("%010u") " )", sprint_hex(ct_card.uid, 4), uid32);
-
-        // Have to figure out how large one of these are..
-        PrintAndLogEx(FAILED, "Dumping CT tags is not implemented yet.");
-
-        // print_ct_blocks(data, cardsize);
-        return switch_off_field_14b();
-    }
-
     if (select_cardtype == ISO14B_STANDARD) {
         // Have to figure out how large one of these are..
         PrintAndLogEx(FAILED, "Dumping Standard ISO14443-B tags is not implemented yet.");
@@ -1762,137 +1811,156 @@ static int CmdHF14BDump(const char *Cmd) {
         return switch_off_field_14b();
     }
 
-    if (select_cardtype == ISO14B_SR) {
+    if (select_cardtype != ISO14B_SR && select_cardtype != ISO14B_CT) {
+        return PM3_ESOFT;
+    }
+
+    uint8_t lastblock = 0;
+    uint8_t block_size = ST25TB_SR_BLOCK_SIZE;
+
+    if (select_cardtype == ISO14B_CT) {
+        iso14b_cts_card_select_t ct_card;
+        memcpy(&ct_card, (iso14b_cts_card_select_t *)&select, sizeof(iso14b_cts_card_select_t));
+
+        uint32_t uid32 = MemLeToUint4byte(ct_card.uid);
+        PrintAndLogEx(SUCCESS, "UID: " _GREEN_("%s") " ( " _YELLOW_("%010u") " )", sprint_hex(ct_card.uid, 4), uid32);
+
+        // CTS256, 16 blocks of 16 bits. The read command only carries a 4 bit block number
+        lastblock = 0x0F;
+        block_size = 2;
+    } else {
         iso14b_card_select_t card;
         memcpy(&card, (iso14b_card_select_t *)&select, sizeof(iso14b_card_select_t));
 
         // detect cardsize
         // 1 = 4096
         // 2 = 512
-        uint8_t cardtype = get_st_cardsize(card.uid);
-        uint8_t lastblock = 0;
-        uint16_t cardsize = 0;
-
-        switch (cardtype) {
+        switch (get_st_cardsize(card.uid)) {
             case SR_SIZE_512:
-                cardsize = (512 / 8) + ST25TB_SR_BLOCK_SIZE;
                 lastblock = 0x0F;
                 break;
             case SR_SIZE_4K:
             default:
-                cardsize = (4096 / 8) + ST25TB_SR_BLOCK_SIZE;
                 lastblock = 0x7F;
                 break;
         }
 
         uint8_t chipid = get_st_chipid(card.uid);
         PrintAndLogEx(SUCCESS, "found a " _GREEN_("%s") " tag", get_st_chip_model(chipid));
+    }
 
-        // detect blocksize from card :)
-        PrintAndLogEx(INFO, "reading tag memory");
-
-        iso14b_raw_cmd_t *packet = (iso14b_raw_cmd_t *)calloc(1, sizeof(iso14b_raw_cmd_t) + 2);
-        if (packet == NULL) {
-            PrintAndLogEx(WARNING, "Failed to allocate memory");
-            return PM3_EMALLOC;
-        }
-        packet->flags = (ISO14B_CONNECT | ISO14B_SELECT_SR);
-        packet->timeout = 0;
-        packet->rawlen = 0;
-
-        clearCommandBuffer();
-        SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)packet, sizeof(iso14b_raw_cmd_t));
-        PacketResponseNG resp;
-
-        // select SR tag
-        if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, 2000)) {
-            if (resp.status != PM3_SUCCESS) {
-                PrintAndLogEx(FAILED, "failed to select ( " _RED_("%d") " )", resp.status);
-                free(packet);
-                return switch_off_field_14b();
-            }
-        }
-
-        PrintAndLogEx(INFO, "." NOLF);
-
-        uint8_t data[cardsize];
-        memset(data, 0, sizeof(data));
-        uint16_t blocknum = 0;
-
-        for (int retry = 0; retry < 3; retry++) {
-
-            // set up the read command
-            packet->flags = (ISO14B_APPEND_CRC | ISO14B_RAW);
-            packet->rawlen = 2;
-            packet->raw[0] = ISO14443B_READ_BLK;
-            packet->raw[1] = blocknum & 0xFF;
-
-            clearCommandBuffer();
-            SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)packet, sizeof(iso14b_raw_cmd_t) + 2);
-            if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, 2000)) {
+    if (end == -1 || end > lastblock) {
+        end = lastblock;
+    }
+    if (start > end) {
+        PrintAndLogEx(WARNING, "invalid block range, tag has blocks 0 - %u", lastblock);
+        return PM3_EINVARG;
+    }
 
-                if (resp.status != PM3_SUCCESS) {
-                    PrintAndLogEx(FAILED, "retrying one more time");
-                    continue;
-                }
+    bool partial = (start != 0 || end != lastblock);
+    uint8_t bitmap[ISO14B_DUMP_MAX_BLOCKS / 8] = {0};
+    for (int i = start; i <= end; i++) {
+        bitmap[i >> 3] |= (1 << (i & 7));
+    }
 
-                uint8_t *recv = resp.data.asBytes;
+    PrintAndLogEx(INFO, "reading tag memory");
 
-                if (check_crc(CRC_14443_B, recv, resp.length) == false) {
-                    PrintAndLogEx(FAILED, "crc fail, retrying one more time");
-                    continue;
-                }
+    // room for the SRx system block after the last block
+    uint16_t cardsize = (lastblock + 2) * block_size;
+    uint8_t data[(ISO14B_DUMP_MAX_BLOCKS + 1) * ST25TB_SR_BLOCK_SIZE];
+    memset(data, 0, sizeof(data));
 
-                // last read
-                if (blocknum == 0xFF) {
-                    // we reserved space for this block after 0x0F and 0x7F,  ie 0x10, 0x80
-                    memcpy(data + ((lastblock + 1) * ST25TB_SR_BLOCK_SIZE), recv, ST25TB_SR_BLOCK_SIZE);
-                    break;
-                }
-                memcpy(data + (blocknum * ST25TB_SR_BLOCK_SIZE), recv, ST25TB_SR_BLOCK_SIZE);
+    iso14b_dump_resp_t dresp;
+    memset(&dresp, 0, sizeof(dresp));
+    int res = hf14b_device_dump(select_cardtype, lastblock + 1, (select_cardtype == ISO14B_SR), bitmap, &dresp, data, sizeof(data));
+    if (res == PM3_ETIMEOUT || res == PM3_EOVFLOW || dresp.len == 0) {
+        PrintAndLogEx(FAILED, "dump failed");
+        return res;
+    }
 
+    if (difflen) {
+        uint8_t *prev = NULL;
+        size_t prevlen = 0;
+        if (pm3_load_dump(diffname, (void **)&prev, &prevlen, cardsize) != PM3_SUCCESS) {
+            return PM3_EFILE;
+        }
 
-                retry = 0;
-                blocknum++;
-                if (blocknum > lastblock) {
-                    // read config block
-                    blocknum = 0xFF;
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "block#   | previous    | now");
+        PrintAndLogEx(INFO, "---------+-------------+------------");
+        uint16_t changed = 0;
+        for (int i = start; i <= end; i++) {
+            if (hf14b_dump_has_block(&dresp, i) == false) {
+                PrintAndLogEx(INFO, "%3d/0x%02X | %-11s | " _RED_("not read"), i, i, ((i + 1) * block_size <= prevlen) ? sprint_hex(prev + (i * block_size), block_size) : "");
+                continue;
+            }
+            if ((i + 1) * block_size > prevlen || memcmp(prev + (i * block_size), data + (i * block_size), block_size)) {
+                char old[32] = {0};
+                if ((i + 1) * block_size <= prevlen) {
+                    snprintf(old, sizeof(old), "%s", sprint_hex(prev + (i * block_size), block_size));
                 }
-
-                PrintAndLogEx(NORMAL, "." NOLF);
-                fflush(stdout);
+                PrintAndLogEx(INFO, "%3d/0x%02X | %-11s | " _YELLOW_("%s"), i, i, old, sprint_hex(data + (i * block_size), block_size));
+                changed++;
             }
         }
-        free(packet);
-
-        PrintAndLogEx(NORMAL, "");
-        switch_off_field_14b();
+        free(prev);
+        PrintAndLogEx(SUCCESS, "%u changed block%s", changed, (changed == 1) ? "" : "s");
+        return res;
+    }
 
-        if (blocknum != 0xFF) {
-            PrintAndLogEx(FAILED, "dump failed");
-            return PM3_ESOFT;
+    bool complete = true;
+    for (int i = start; i <= end; i++) {
+        if (hf14b_dump_has_block(&dresp, i) == false) {
+            complete = false;
+            break;
         }
+    }
+    if (select_cardtype == ISO14B_SR && (dresp.flags & ISO14B_DUMP_SYSBLOCK) == 0) {
+        complete = false;
+    }
 
-        print_sr_blocks(data, cardsize, card.uid, dense_output);
+    if (select_cardtype == ISO14B_CT) {
+        print_ct_blocks(data, (lastblock + 1) * block_size, block_size);
+    } else {
+        print_sr_blocks(data, cardsize, dresp.card.uid, dense_output);
+    }
 
-        if (nosave) {
-            PrintAndLogEx(INFO, "Called with no save option");
-            PrintAndLogEx(NORMAL, "");
-            return PM3_SUCCESS;
-        }
+    if (complete == false) {
+        PrintAndLogEx(FAILED, "dump failed ( " _RED_("%d") " ), not all blocks could be read", res);
+        return (res != PM3_SUCCESS) ? res : PM3_ESOFT;
+    }
 
-        // save to file
+    if (nosave) {
+        PrintAndLogEx(INFO, "Called with no save option");
+        PrintAndLogEx(NORMAL, "");
+        return PM3_SUCCESS;
+    }
+
+    if (partial) {
+        PrintAndLogEx(INFO, "Partial dump, not saved");
+        PrintAndLogEx(NORMAL, "");
+        return PM3_SUCCESS;
+    }
+
+    // save to file
+    if (select_cardtype == ISO14B_CT) {
         if (fnlen < 1) {
             PrintAndLogEx(INFO, "using UID as filename");
             char *fptr = filename + snprintf(filename, sizeof(filename), "hf-14b-");
-            FillFileNameByUID(fptr, SwapEndian64(card.uid, card.uidlen, 8), "-dump", card.uidlen);
+            FillFileNameByUID(fptr, dresp.cts.uid, "-dump", sizeof(dresp.cts.uid));
         }
+        saveFile(filename, ".bin", data, (lastblock + 1) * block_size);
+        return PM3_SUCCESS;
+    }
 
-        size_t datalen = (lastblock + 2) * ST25TB_SR_BLOCK_SIZE;
-        pm3_save_dump(filename, data, datalen, jsf14b_v2);
+    if (fnlen < 1) {
+        PrintAndLogEx(INFO, "using UID as filename");
+        char *fptr = filename + snprintf(filename, sizeof(filename), "hf-14b-");
+        FillFileNameByUID(fptr, SwapEndian64(dresp.card.uid, dresp.card.uidlen, 8), "-dump", dresp.card.uidlen);
     }
 
-    return PM3_ESOFT;
+    pm3_save_dump(filename, data, cardsize, jsf14b_v2);
+    return PM3_SUCCESS;
 }
 
 static int CmdHF14BRestore(const char *Cmd) {
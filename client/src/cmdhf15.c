@@ -44,6 +44,7 @@
 #include "util_posix.h"         // msleep
 #include "iso15.h"              // typedef structs / enum
 #include "crypto/originality.h"
+#include "jansson.h"
 
 #define FrameSOF                Iso15693FrameSOF
 #define Logic0                  Iso15693Logic0
@@ -1536,8 +1537,8 @@ static int CmdHF15Sim(const char *Cmd) {
 static int CmdHF15FindAfi(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf 15 findafi",
-                  "This command attempts to brute force AFI of an ISO-15693 tag\n"
-                  "Estimated execution time is around 2 minutes",
+                  "This command attempts to brute force AFI of ISO-15693 tags\n"
+                  "All tags answering for an AFI are listed, with their DSFID",
                   "hf 15 findafi");
 
     void *argtable[] = {
@@ -1565,6 +1566,7 @@ static int CmdHF15FindAfi(const char *Cmd) {
     PacketResponseNG resp;
 
     uint32_t timeout = 0;
+    uint16_t found = 0;
     for (;;) {
 
         if (kbd_enter_pressed()) {
@@ -1575,14 +1577,27 @@ static int CmdHF15FindAfi(const char *Cmd) {
         }
 
         if (WaitForResponseTimeout(CMD_HF_ISO15693_FINDAFI, &resp, 2000)) {
+
+            // one reply per tag and AFI, the last one has no data
+            if (resp.length >= sizeof(iso15_inventory_tag_t)) {
+                const iso15_inventory_tag_t *t = (const iso15_inventory_tag_t *)resp.data.asBytes;
+                if (found == 0) {
+                    PrintAndLogEx(INFO, "AFI | UID                     | DSFID");
+                    PrintAndLogEx(INFO, "----+-------------------------+------");
+                }
+                PrintAndLogEx(SUCCESS, " " _GREEN_("%02X") " | %s |  %02X", t->afi, sprint_hex(t->uid, sizeof(t->uid)), t->dsfid);
+                found++;
+                timeout = 0;
+                continue;
+            }
+
             if (resp.status == PM3_EOPABORTED) {
                 PrintAndLogEx(DEBUG, "Button pressed, user aborted");
             }
             break;
         }
 
-        // should be done in about 2 minutes
-        if (timeout > 180) {
+        if (timeout > 30) {
             PrintAndLogEx(WARNING, "\nNo response from Proxmark3. Aborting...");
             break;
         }
@@ -1590,10 +1605,189 @@ static int CmdHF15FindAfi(const char *Cmd) {
     }
 
     DropField();
+    if (found == 0) {
+        PrintAndLogEx(INFO, "No tag answered");
+    }
     PrintAndLogEx(INFO, "Done!");
     return PM3_SUCCESS;
 }
 
+typedef struct {
+    iso15_inventory_tag_t info;
+    uint8_t data[256 * 32];
+    uint16_t len;
+} hf15_inventory_tag_t;
+
+static void hf15_inventory_print(const hf15_inventory_tag_t *tag, bool json, bool verbose) {
+
+    uint8_t bs = tag->info.block_size;
+    uint16_t nblocks = (bs) ? tag->len / bs : 0;
+
+    if (json) {
+        json_t *root = json_object();
+        json_object_set_new(root, "uid", json_string(sprint_hex_inrow(tag->info.uid, sizeof(tag->info.uid))));
+        json_object_set_new(root, "dsfid", json_integer(tag->info.dsfid));
+        json_object_set_new(root, "afi", json_integer(tag->info.afi));
+        json_object_set_new(root, "ic", json_integer(tag->info.ic));
+        json_object_set_new(root, "block_size", json_integer(bs));
+        json_object_set_new(root, "block_count", json_integer(tag->info.block_count));
+        json_t *blocks = json_array();
+        for (uint16_t i = 0; i < nblocks; i++) {
+            json_array_append_new(blocks, json_string(sprint_hex_inrow(tag->data + (i * bs), bs)));
+        }
+        json_object_set_new(root, "blocks", blocks);
+        char *s = json_dumps(root, JSON_COMPACT);
+        if (s) {
+            PrintAndLogEx(NORMAL, "%s", s);
+            free(s);
+        }
+        json_decref(root);
+        return;
+    }
+
+    PrintAndLogEx(SUCCESS, _GREEN_("%s") "  DSFID %02X  AFI %02X  %u x %u bytes, %u read"
+                  , sprint_hex(tag->info.uid, sizeof(tag->info.uid))
+                  , tag->info.dsfid
+                  , tag->info.afi
+                  , tag->info.block_count
+                  , bs
+                  , nblocks
+                 );
+
+    if (verbose) {
+        for (uint16_t i = 0; i < nblocks; i++) {
+            PrintAndLogEx(INFO, "  %3u/0x%02X | %s", i, i, sprint_hex(tag->data + (i * bs), bs));
+        }
+    }
+}
+
+static int CmdHF15Inventory(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf 15 inventory",
+                  "Find every ISO-15693 tag in the field with 16 slot anticollision and read their memory.\n"
+                  "Anticollision and reading both run on the device, results are printed per tag.",
+                  "hf 15 inventory\n"
+                  "hf 15 inventory --noread        --> only list UIDs\n"
+                  "hf 15 inventory --afi 07 --json --> tags of AFI 07, one JSON object per line"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0(NULL, "afi", "<hex>", "only tags with this AFI"),
+        arg_lit0(NULL, "noread", "don't read tag memory"),
+        arg_int0(NULL, "blocks", "<dec>", "blocks per READ MULTIPLE BLOCKS request, 1 = single block reads (def 32)"),
+        arg_lit0(NULL, "json", "print one JSON object per tag"),
+        arg_lit0("v", "verbose", "print block contents"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    uint8_t afi[1] = {0};
+    int afilen = 0;
+    int res = CLIParamHexToBuf(arg_get_str(ctx, 1), afi, sizeof(afi), &afilen);
+    bool noread = arg_get_lit(ctx, 2);
+    int blocks = arg_get_int_def(ctx, 3, 32);
+    bool json = arg_get_lit(ctx, 4);
+    bool verbose = arg_get_lit(ctx, 5);
+    CLIParserFree(ctx);
+
+    if (res) {
+        PrintAndLogEx(FAILED, "Error parsing AFI");
+        return PM3_EINVARG;
+    }
+
+    if (blocks < 1 || blocks > 64) {
+        PrintAndLogEx(WARNING, "--blocks must be between 1 and 64");
+        return PM3_EINVARG;
+    }
+
+    iso15_inventory_t packet = {
+        .flags = (afilen ? ISO15_INVENTORY_AFI : 0) | (noread ? 0 : ISO15_INVENTORY_READ),
+        .afi = afi[0],
+        .blocks_per_read = blocks,
+    };
+
+    hf15_inventory_tag_t *tag = calloc(1, sizeof(hf15_inventory_tag_t));
+    if (tag == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    if (json == false) {
+        PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to abort");
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO15693_INVENTORY, (uint8_t *)&packet, sizeof(packet));
+
+    PacketResponseNG resp;
+    bool have_tag = false;
+    uint16_t count = 0;
+    uint32_t timeout = 0;
+    res = PM3_SUCCESS;
+
+    for (;;) {
+
+        if (kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(DEBUG, "User aborted");
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_ISO15693_INVENTORY, &resp, 2000) == false) {
+            if (timeout++ > 30) {
+                PrintAndLogEx(WARNING, "\nNo response from Proxmark3. Aborting...");
+                res = PM3_ETIMEOUT;
+                break;
+            }
+            continue;
+        }
+        timeout = 0;
+
+        // the last reply has no data
+        if (resp.length < sizeof(iso15_inventory_tag_t)) {
+            res = resp.status;
+            break;
+        }
+
+        const iso15_inventory_tag_t *chunk = (const iso15_inventory_tag_t *)resp.data.asBytes;
+
+        if (have_tag == false || memcmp(chunk->uid, tag->info.uid, sizeof(chunk->uid)) != 0) {
+            if (have_tag) {
+                hf15_inventory_print(tag, json, verbose);
+            }
+            memset(tag, 0, sizeof(hf15_inventory_tag_t));
+            have_tag = true;
+            count++;
+        }
+
+        // later chunks carry what the device learnt while reading
+        memcpy(&tag->info, chunk, sizeof(iso15_inventory_tag_t));
+
+        if (chunk->block_size && chunk->len && chunk->len <= resp.length - sizeof(iso15_inventory_tag_t)) {
+            uint32_t offset = chunk->first_block * chunk->block_size;
+            if (offset + chunk->len <= sizeof(tag->data)) {
+                memcpy(tag->data + offset, chunk->data, chunk->len);
+                tag->len = MAX(tag->len, offset + chunk->len);
+            }
+        }
+    }
+
+    if (have_tag) {
+        hf15_inventory_print(tag, json, verbose);
+    }
+    free(tag);
+
+    result_add_int("tags", count);
+
+    if (json == false) {
+        if (res == PM3_EOPABORTED) {
+            PrintAndLogEx(WARNING, "aborted");
+        }
+        PrintAndLogEx(SUCCESS, "Found " _YELLOW_("%u") " tag(s)", count);
+    }
+    return res;
+}
+
 // Writes the AFI (Application Family Identifier) of a card
 static int CmdHF15WriteAfi(const char *Cmd) {
     CLIParserContext *ctx;
@@ -1950,75 +2144,81 @@ static int CmdHF15Dump(const char *Cmd) {
         tag->pagesCount = 128;
     }
 
-    // add length for blockno (1)
-    packet->rawlen++;
-    packet->raw[0] |= ISO15_REQ_OPTION; // Add option to dump lock status
-    packet->raw[1] = ISO15693_READBLOCK;
-
-    packet->flags = (ISO15_READ_RESPONSE | ISO15_NO_DISCONNECT);
-    if (fast) {
-        packet->flags |= ISO15_HIGH_SPEED;
+    // the block loop runs on the device, READ MULTIPLE BLOCKS when the tag takes them
+    iso15_blocks_t rq = {
+        .flags = (fast) ? ISO15_HIGH_SPEED : 0,
+        .req_flags = packet->raw[0] | ISO15_REQ_OPTION, // Add option to dump lock status
+        .first_block = 0,
+        .count = tag->pagesCount,
+        .block_size = tag->bytesPerPage,
+        .blocks_per_cmd = 0,
+        .retries = 2,
+    };
+    if (used_uid) {
+        memcpy(rq.uid, uid, ISO15693_UID_LENGTH);
     }
 
     PrintAndLogEx(SUCCESS, "Reading memory");
 
-    int blocknum = 0;
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO15693_READ_BLOCKS, (uint8_t *)&rq, sizeof(rq));
 
-    for (int retry = 0; (retry < 2 && blocknum < tag->pagesCount); retry++) {
-        if (used_uid) {
-            packet->raw[10] = (uint8_t)blocknum & 0xFF;
-            AddCrc15(packet->raw, 11);
-        } else {
-            packet->raw[2] = (uint8_t)blocknum & 0xFF;
-            AddCrc15(packet->raw, 3);
+    int blocknum = 0;
+    uint8_t per_cmd = 0;
+    for (;;) {
+        if (WaitForResponseTimeout(CMD_HF_ISO15693_READ_BLOCKS, &resp, 2000) == false) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(WARNING, "iso15693 timeout");
+            break;
         }
 
-        clearCommandBuffer();
-        SendCommandNG(CMD_HF_ISO15693_COMMAND, (uint8_t *)packet, ISO15_RAW_LEN(packet->rawlen));
+        if (resp.length < sizeof(iso15_blocks_resp_t)) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(FAILED, "iso15693 command failed");
+            break;
+        }
 
-        if (WaitForResponseTimeout(CMD_HF_ISO15693_COMMAND, &resp, 2000)) {
+        const iso15_blocks_resp_t *br = (const iso15_blocks_resp_t *)resp.data.asBytes;
+        per_cmd = br->blocks_per_cmd;
 
-            if (resp.length < 2) {
+        // final reply
+        if (br->count == 0) {
+            if (resp.status == PM3_ECRC) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(FAILED, "crc ( " _RED_("fail") " )");
+            } else if (resp.status != PM3_SUCCESS) {
                 PrintAndLogEx(NORMAL, "");
                 PrintAndLogEx(FAILED, "iso15693 command failed");
-                continue;
-            }
-
-            d = resp.data.asBytes;
-
-            if (CheckCrc15(d, resp.length) == false) {
+            } else if (br->error && br->error != 0x0F && br->error != 0x10) {
+                // 0x0F / 0x10 is the heuristic end of available memory
                 PrintAndLogEx(NORMAL, "");
-                PrintAndLogEx(FAILED, "crc ( " _RED_("fail") " )");
-                continue;
+                PrintAndLogEx(FAILED, "Tag returned Error %i: %s", br->error, TagErrorStr(br->error));
             }
+            break;
+        }
 
-            if ((d[0] & ISO15_RES_ERROR) == ISO15_RES_ERROR) {
-
-                // heuristic determine end of available memory
-                if (d[1] == 0x0F || d[1] == 0x10) {
-                    break;
-                }
-
-                PrintAndLogEx(NORMAL, "");
-                PrintAndLogEx(FAILED, "Tag returned Error %i: %s", d[1], TagErrorStr(d[1]));
-                break;
+        for (uint16_t i = 0; i < br->count; i++) {
+            uint16_t blk = br->first_block + i;
+            if (blk >= ISO15693_TAG_MAX_PAGES || (blk + 1) * tag->bytesPerPage > ISO15693_TAG_MAX_SIZE) {
+                continue;
             }
-
-            tag->locks[blocknum] = d[1];
-
-            // copy read data
-            memcpy(&tag->data[blocknum * tag->bytesPerPage], d + 2, tag->bytesPerPage);
-
-            retry = 0;
-            blocknum++;
-
-            PrintAndLogEx(INPLACE, "blk %3d", blocknum);
+            const uint8_t *b = br->data + (i * (br->block_size + 1));
+            tag->locks[blk] = b[0];
+            memcpy(&tag->data[blk * tag->bytesPerPage], b + 1, tag->bytesPerPage);
+            blocknum = blk + 1;
         }
+
+        PrintAndLogEx(INPLACE, "blk %3d", blocknum);
     }
 
     free(packet);
     DropField();
 
+    if (verbose) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "%u block(s) per read command", per_cmd);
+    }
+
     // done reading tag memory
 
     if (tag->bytesPerPage != blocksize) {
@@ -2734,61 +2934,89 @@ static int CmdHF15Restore(const char *Cmd) {
 
     uint16_t flags = arg_get_raw_flag(uidlen, unaddressed, scan, add_option);
 
-    uint8_t pm3flags = (ISO15_CONNECT | ISO15_READ_RESPONSE | ISO15_LONG_WAIT | ISO15_NO_DISCONNECT);
+    // the device writes a chunk of blocks per command, WRITE MULTIPLE BLOCKS when the tag takes them
+    uint16_t chunk_blocks = (PM3_CMD_DATA_SIZE - sizeof(iso15_blocks_t)) / tag->bytesPerPage;
+    iso15_blocks_t *rq = calloc(1, sizeof(iso15_blocks_t) + chunk_blocks * tag->bytesPerPage);
+    if (rq == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(tag);
+        return PM3_EMALLOC;
+    }
+
+    rq->flags = ISO15_CONNECT;
     if (fast) {
-        pm3flags |= ISO15_HIGH_SPEED;
+        rq->flags |= ISO15_HIGH_SPEED;
     }
+    rq->req_flags = flags;
+    if (unaddressed == false) {
+        memcpy(rq->uid, uid, ISO15693_UID_LENGTH);
+    }
+    rq->block_size = tag->bytesPerPage;
+    rq->blocks_per_cmd = 0;
+    rq->retries = MIN(retries, UINT8_MAX);
 
     int retval = PM3_SUCCESS;
-    size_t bytes = 0;
     uint16_t i = 0;
-    uint8_t *data = calloc(tag->bytesPerPage, sizeof(uint8_t));
-    if (data == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        free(tag);
-        return PM3_EMALLOC;
-    }
-    uint32_t tried;
-    while (bytes < (tag->pagesCount * tag->bytesPerPage)) {
+    while (i < tag->pagesCount) {
 
-        // copy over the data to the request
-        memcpy(data, &tag->data[bytes], tag->bytesPerPage);
+        rq->first_block = i;
+        rq->count = MIN(chunk_blocks, tag->pagesCount - i);
+        memcpy(rq->data, &tag->data[i * tag->bytesPerPage], rq->count * tag->bytesPerPage);
 
-        for (tried = 0; tried < retries; tried++) {
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_ISO15693_WRITE_BLOCKS, (uint8_t *)rq, sizeof(iso15_blocks_t) + rq->count * tag->bytesPerPage);
 
-            retval = hf_15_write_blk(&pm3flags, flags, uid, fast, i, data, tag->bytesPerPage);
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_ISO15693_WRITE_BLOCKS, &resp, 2000 + rq->count * 100) == false) {
+            PrintAndLogEx(FAILED, "iso15693 card timeout, data may be written anyway");
+            retval = PM3_ETIMEOUT;
+            break;
+        }
 
-            if (retval == PM3_SUCCESS) {
-                PrintAndLogEx(INPLACE, "blk %3d", i);
+        if (resp.status == PM3_ETEAROFF || resp.length < sizeof(iso15_blocks_resp_t)) {
+            retval = (resp.status == PM3_ETEAROFF) ? PM3_ETEAROFF : PM3_EWRONGANSWER;
+            break;
+        }
 
-                if (i == 0) {
-                    pm3flags = (ISO15_READ_RESPONSE | ISO15_LONG_WAIT | ISO15_NO_DISCONNECT);
-                    if (fast) {
-                        pm3flags |= ISO15_HIGH_SPEED;
-                    }
-                }
-                break;
-            } else if (retval == PM3_EOUTOFBOUND) {
-                // we only get this when we reached end of tag memory
-                // break out of retry loop
-                break;
-            }
+        const iso15_blocks_resp_t *br = (const iso15_blocks_resp_t *)resp.data.asBytes;
+        i += br->count;
+
+        // keep what the tag accepted for the next chunks
+        rq->flags &= ~ISO15_CONNECT;
+        rq->blocks_per_cmd = br->blocks_per_cmd;
+
+        PrintAndLogEx(INPLACE, "blk %3d", i);
+
+        if (resp.status == PM3_EOUTOFBOUND) {
+            // we only get this when we reached end of tag memory
+            break;
         }
 
-        if (tried >= retries) {
-            free(data);
-            free(tag);
+        if (resp.status != PM3_SUCCESS) {
+            if (br->error) {
+                PrintAndLogEx(ERR, "iso15693 card returned error %i: %s", br->error, TagErrorStr(br->error));
+            }
             PrintAndLogEx(NORMAL, "");
             PrintAndLogEx(FAILED, "Too many retries (" _RED_("fail") " )");
-            DropField();
-            return retval;
+            retval = resp.status;
+            break;
         }
+    }
 
-        bytes += tag->bytesPerPage;
-        i++;
+    uint8_t per_cmd = rq->blocks_per_cmd;
+    free(rq);
+
+    if (retval != PM3_SUCCESS) {
+        free(tag);
+        DropField();
+        return retval;
+    }
+
+    if (verbose) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "%u block(s) per write command", per_cmd);
     }
 
-    free(data);
     free(tag);
     DropField();
 
@@ -3074,6 +3302,192 @@ static int CmdHF15SlixDisable(const char *Cmd) {
     return resp.status;
 }
 
+// runs one password search job on the device, prints progress until its final reply
+static int hf15_slix_brute_run(const iso15_slix_brute_t *payload, size_t len, uint64_t done_before, uint64_t total, uint8_t *found) {
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO15693_SLIX_BRUTE, (uint8_t *)payload, len);
+
+    uint64_t t1 = msclock();
+    uint8_t timeouts = 0;
+    PacketResponseNG resp;
+    for (;;) {
+
+        if (kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(DEBUG, "User aborted");
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_ISO15693_SLIX_BRUTE, &resp, 2000) == false) {
+            if (++timeouts > 5) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(WARNING, "timeout while waiting for reply");
+                return PM3_ETIMEOUT;
+            }
+            continue;
+        }
+        timeouts = 0;
+
+        if (resp.length < sizeof(iso15_slix_brute_resp_t)) {
+            return PM3_EWRONGANSWER;
+        }
+
+        const iso15_slix_brute_resp_t *r = (const iso15_slix_brute_resp_t *)resp.data.asBytes;
+        uint64_t ms = msclock() - t1;
+        PrintAndLogEx(INPLACE, "%" PRIu64 " / %" PRIu64 "  %s  ( %.0f pwd/s )"
+                      , done_before + r->tried
+                      , total
+                      , sprint_hex_inrow(r->current, sizeof(r->current))
+                      , (ms) ? (r->tried * 1000.0) / ms : 0.0
+                     );
+
+        if (r->done) {
+            if (resp.status == PM3_SUCCESS) {
+                memcpy(found, r->current, sizeof(r->current));
+            }
+            return resp.status;
+        }
+    }
+}
+
+static int CmdHF15SlixBrute(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf 15 slixbrute",
+                  "Search the password of a SLIX family ISO-15693 tag on the device.\n"
+                  "Either a range of passwords or a dictionary file is tried, also works on tags in privacy mode.\n"
+                  "Some tags ignore passwords after a wrong one until the field drops, --reset sets the off time for them.",
+                  "hf 15 slixbrute -t privacy --start 00000000 --end 0000FFFF\n"
+                  "hf 15 slixbrute -t privacy -f my_slix_pwds.dic --reset 0");
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("t", "type", "<read|write|privacy|destroy|easafi>", "which password to search (def privacy)"),
+        arg_str0(NULL, "start", "<hex>", "first password of the range, 4 hex bytes (def 00000000)"),
+        arg_str0(NULL, "end", "<hex>", "last password of the range, 4 hex bytes (def FFFFFFFF)"),
+        arg_str0("f", "file", "<fn>", "dictionary file with passwords"),
+        arg_int0(NULL, "reset", "<ms>", "field off time after a wrong password, 0 = none (def 10)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    int vlen = 0;
+    char value[10] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)value, sizeof(value), &vlen);
+
+    uint8_t start[4] = {0x00, 0x00, 0x00, 0x00};
+    uint8_t end[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+    int slen = 0, elen = 0;
+    int res = CLIParamHexToBuf(arg_get_str(ctx, 2), start, sizeof(start), &slen);
+    res |= CLIParamHexToBuf(arg_get_str(ctx, 3), end, sizeof(end), &elen);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int reset_ms = arg_get_int_def(ctx, 5, 10);
+    CLIParserFree(ctx);
+
+    if (res || (slen && slen != 4) || (elen && elen != 4)) {
+        PrintAndLogEx(WARNING, "range passwords must be 4 hex bytes");
+        return PM3_EINVARG;
+    }
+
+    if (reset_ms < 0 || reset_ms > 255) {
+        PrintAndLogEx(WARNING, "--reset must be between 0 and 255 ms");
+        return PM3_EINVARG;
+    }
+
+    uint8_t pass_id = 0x04;
+    if (vlen) {
+        if (strcmp(value, "read") == 0) {
+            pass_id = 0x01;
+        } else if (strcmp(value, "write") == 0) {
+            pass_id = 0x02;
+        } else if (strcmp(value, "privacy") == 0) {
+            pass_id = 0x04;
+        } else if (strcmp(value, "destroy") == 0) {
+            pass_id = 0x08;
+        } else if (strcmp(value, "easafi") == 0) {
+            pass_id = 0x10;
+        } else {
+            PrintAndLogEx(ERR, "t argument must be 'read', 'write', 'privacy', 'destroy', or 'easafi'");
+            return PM3_EINVARG;
+        }
+    }
+
+    uint8_t found[4] = {0};
+    uint16_t max_chunk = (PM3_CMD_DATA_SIZE - sizeof(iso15_slix_brute_t)) / 4;
+    iso15_slix_brute_t *payload = calloc(1, sizeof(iso15_slix_brute_t) + max_chunk * 4);
+    if (payload == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    payload->pass_id = pass_id;
+    payload->reset_ms = reset_ms;
+
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to abort");
+
+    if (fnlen) {
+
+        uint8_t *keys = NULL;
+        uint32_t keycnt = 0;
+        res = loadFileDICTIONARY_safe(filename, (void **) &keys, 4, &keycnt);
+        if (res != PM3_SUCCESS || keycnt == 0 || keys == NULL) {
+            PrintAndLogEx(FAILED, "An error occurred while loading the dictionary!");
+            free(keys);
+            free(payload);
+            return PM3_EFILE;
+        }
+
+        // the device gets the dictionary in chunks of one packet each
+        res = PM3_ENODATA;
+        for (uint32_t i = 0; i < keycnt && res == PM3_ENODATA; i += max_chunk) {
+            payload->count = MIN(max_chunk, keycnt - i);
+            memcpy(payload->data, keys + (i * 4), payload->count * 4);
+            res = hf15_slix_brute_run(payload, sizeof(iso15_slix_brute_t) + payload->count * 4, i, keycnt, found);
+        }
+        free(keys);
+
+    } else {
+
+        payload->start = bytes_to_num(start, 4);
+        payload->end = bytes_to_num(end, 4);
+        if (payload->end < payload->start) {
+            PrintAndLogEx(WARNING, "end of range is before its start");
+            free(payload);
+            return PM3_EINVARG;
+        }
+        res = hf15_slix_brute_run(payload, sizeof(iso15_slix_brute_t), 0, (uint64_t)payload->end - payload->start + 1, found);
+    }
+
+    free(payload);
+    PrintAndLogEx(NORMAL, "");
+
+    switch (res) {
+        case PM3_SUCCESS: {
+            PrintAndLogEx(SUCCESS, "Found password " _GREEN_("%s"), sprint_hex_inrow(found, sizeof(found)));
+            result_add_hex("password", found, sizeof(found));
+            break;
+        }
+        case PM3_ENODATA: {
+            PrintAndLogEx(FAILED, "Password not found");
+            break;
+        }
+        case PM3_ETIMEOUT: {
+            PrintAndLogEx(WARNING, "no tag found");
+            break;
+        }
+        case PM3_EOPABORTED: {
+            PrintAndLogEx(WARNING, "aborted");
+            break;
+        }
+        default:
+            break;
+    }
+    return res;
+}
+
 static int CmdHF15SlixEnable(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -3607,6 +4021,7 @@ static command_t CommandTable[] = {
     {"demod",               CmdHF15Demod,             AlwaysAvailable, "Demodulate ISO-15693 from tag"},
     {"dump",                CmdHF15Dump,              IfPm3Iso15693,   "Read all memory pages of an ISO-15693 tag, save to file"},
     {"info",                CmdHF15Info,              IfPm3Iso15693,   "Tag information"},
+    {"inventory",           CmdHF15Inventory,         IfPm3Iso15693,   "Find and read all tags in the field"},
     {"sniff",               CmdHF15Sniff,             IfPm3Iso15693,   "Sniff ISO-15693 traffic"},
     {"raw",                 CmdHF15Raw,               IfPm3Iso15693,   "Send raw hex data to tag"},
     {"rdbl",                CmdHF15Readblock,         IfPm3Iso15693,   "Read a block"},
@@ -3623,6 +4038,7 @@ static command_t CommandTable[] = {
     {"esave",               CmdHF15ESave,             IfPm3Iso15693,   "Save emulator memory to file"},
     {"eview",               CmdHF15EView,             IfPm3Iso15693,   "View emulator memory"},
     {"-----------",         CmdHF15Help,              IfPm3Iso15693,   "------------------------ " _CYAN_("SLIX") " -------------------------"},
+    {"slixbrute",           CmdHF15SlixBrute,         IfPm3Iso15693,   "Search the password of a SLIX ISO-15693 tag"},
     {"slixwritepwd",        CmdHF15SlixWritePassword, IfPm3Iso15693,   "Writes a password on a SLIX ISO-15693 tag"},
     {"slixeasdisable",      CmdHF15SlixEASDisable,    IfPm3Iso15693,   "Disable EAS mode on SLIX ISO-15693 tag"},
     {"slixeasenable",       CmdHF15SlixEASEnable,     IfPm3Iso15693,   "Enable EAS mode on SLIX ISO-15693 tag"},
@@ -34,6 +34,7 @@
 #include "util_posix.h"             // msclock
 #include "ui.h"                     // search home directory
 #include "proxgui.h"                // Picture Window
+#include "cmdhf14a.h"               // ExchangeAPDU14aBatch
 
 // Max file size in bytes. Used in several places.
 // Average EF_DG2 seems to be around 20-25kB or so, but ICAO doesn't set an upper limit
@@ -51,6 +52,21 @@
 
 #define EMRTD_KMAC_LEN              16
 
+// EF.ATR/INFO, in the master file
+#define EMRTD_EF_ATR_INFO           0x2F01
+
+// READ BINARY sizes. 118 bytes keep the length of the secure messaging DO'87' in one byte.
+// Chips announcing extended length get up to 472 bytes, the secured answer to that still fits one device reply
+#define EMRTD_READ_SIZE             118
+#define EMRTD_READ_SIZE_EXT         472
+// DO'87' tag and length, padding indicator, padding, DO'99', DO'8E' and the status word
+#define EMRTD_SM_READ_OVERHEAD      (4 + 1 + 8 + 4 + 10 + 2)
+#define EMRTD_READ_APDU_MAX_LEN     24
+#define EMRTD_SM_MAX_LEN            PM3_CMD_DATA_SIZE
+
+// READ BINARY size used on the connected chip
+static int emrtd_read_size = EMRTD_READ_SIZE;
+
 // DESKey Types
 static const uint8_t KENC_type[4] = {0x00, 0x00, 0x00, 0x01};
 static const uint8_t KMAC_type[4] = {0x00, 0x00, 0x00, 0x02};
@@ -377,7 +393,7 @@ static void retail_mac(uint8_t *key, uint8_t *input, int inputlen, uint8_t *outp
     uint8_t intermediate[8] = {0x00};
     uint8_t intermediate_des[256];
     uint8_t block[8];
-    uint8_t message[256];
+    uint8_t message[EMRTD_SM_MAX_LEN];
 
     // Populate keys
     memcpy(k0, key, 8);
@@ -473,8 +489,8 @@ static void emrtd_bump_ssc(uint8_t *ssc) {
 
 static bool emrtd_check_cc(uint8_t *ssc, uint8_t *key, uint8_t *rapdu, int rapdulength) {
     // https://elixi.re/i/clarkson.png
-    uint8_t k[500] = { 0x00 };
-    uint8_t cc[500] = { 0x00 };
+    uint8_t k[EMRTD_SM_MAX_LEN] = { 0x00 };
+    uint8_t cc[8] = { 0x00 };
 
     emrtd_bump_ssc(ssc);
 
@@ -483,7 +499,10 @@ static bool emrtd_check_cc(uint8_t *ssc, uint8_t *key, uint8_t *rapdu, int rapdu
     int length2 = 0;
 
     if (*(rapdu) == 0x87) {
-        length += 2 + (*(rapdu + 1));
+        length += 1 + emrtd_get_asn1_field_length(rapdu, rapdulength, 1) + emrtd_get_asn1_data_length(rapdu, rapdulength, 1);
+        if (length > rapdulength || length + 8 > sizeof(k)) {
+            return false;
+        }
         memcpy(k + 8, rapdu, length);
         PrintAndLogEx(DEBUG, "len1: %i", length);
     }
@@ -563,9 +582,10 @@ static bool emrtd_secure_select_file_by_ef(uint8_t *kenc, uint8_t *kmac, uint8_t
     return emrtd_check_cc(ssc, kmac, response, resplen);
 }
 
-static bool _emrtd_secure_read_binary(uint8_t *kmac, uint8_t *ssc, int offset, int bytes_to_read, uint8_t *dataout, size_t maxdataoutlen, size_t *dataoutlen) {
+// Secure messaging data of a READ BINARY, DO'97' with the expected length and DO'8E' with the MAC.
+// More than 256 bytes need a two byte DO'97' and an extended length APDU. Returns the data length
+static int emrtd_secure_read_binary_data(uint8_t *kmac, uint8_t *ssc, int offset, int bytes_to_read, uint8_t *data) {
     uint8_t cmd[8] = { 0x00 };
-    uint8_t data[21] = { 0x00 };
     uint8_t temp[8] = {0x0c, 0xb0};
 
     PrintAndLogEx(DEBUG, "kmac: %s", sprint_hex_inrow(kmac, EMRTD_KMAC_LEN));
@@ -577,63 +597,236 @@ static bool _emrtd_secure_read_binary(uint8_t *kmac, uint8_t *ssc, int offset, i
     int cmdlen = pad_block(temp, 4, cmd);
     PrintAndLogEx(DEBUG, "cmd: %s", sprint_hex_inrow(cmd, cmdlen));
 
-    uint8_t do97[3] = {0x97, 0x01, bytes_to_read};
-
-    uint8_t m[11] = { 0x00 };
-    memcpy(m, cmd, 8);
-    memcpy(m + 8, do97, 3);
+    uint8_t do97[4] = {0x97, 0x01, bytes_to_read};
+    int do97len = 3;
+    if (bytes_to_read > 256) {
+        do97[1] = 0x02;
+        do97[2] = (uint8_t)(bytes_to_read >> 8);
+        do97[3] = (uint8_t)(bytes_to_read >> 0);
+        do97len = 4;
+    }
 
     emrtd_bump_ssc(ssc);
 
-    uint8_t n[19] = { 0x00 };
+    uint8_t n[20] = { 0x00 };
     memcpy(n, ssc, 8);
-    memcpy(n + 8, m, 11);
-    PrintAndLogEx(DEBUG, "n: %s", sprint_hex_inrow(n, sizeof(n)));
+    memcpy(n + 8, cmd, 8);
+    memcpy(n + 16, do97, do97len);
+    PrintAndLogEx(DEBUG, "n: %s", sprint_hex_inrow(n, 16 + do97len));
 
     uint8_t cc[8] = { 0x00 };
-    retail_mac(kmac, n, 19, cc);
+    retail_mac(kmac, n, 16 + do97len, cc);
     PrintAndLogEx(DEBUG, "cc: %s", sprint_hex_inrow(cc, sizeof(cc)));
 
     uint8_t do8e[10] = {0x8E, 0x08};
     memcpy(do8e + 2, cc, 8);
     PrintAndLogEx(DEBUG, "do8e: %s", sprint_hex_inrow(do8e, sizeof(do8e)));
 
-    int lc = 13;
-    PrintAndLogEx(DEBUG, "lc: %i", lc);
+    memcpy(data, do97, do97len);
+    memcpy(data + do97len, do8e, 10);
+    PrintAndLogEx(DEBUG, "data: %s", sprint_hex_inrow(data, do97len + 10));
+    return do97len + 10;
+}
 
-    memcpy(data, do97, 3);
-    memcpy(data + 3, do8e, 10);
-    PrintAndLogEx(DEBUG, "data: %s", sprint_hex_inrow(data, lc));
+// Checks the MAC of a protected READ BINARY answer, status word cut, and decrypts its DO'87'
+static bool emrtd_secure_read_binary_unwrap(uint8_t *kenc, uint8_t *kmac, uint8_t *ssc, int offset, int bytes_to_read, uint8_t *rapdu, size_t rapdulen, uint8_t *dataout) {
+    uint8_t temp[EMRTD_SM_MAX_LEN] = { 0x00 };
+    uint8_t iv[8] = { 0x00 };
 
-    if (emrtd_exchange_commands((sAPDU_t) {0x0C, ISO7816_READ_BINARY, offset >> 8, offset & 0xFF, lc, data}, true, 0, dataout, maxdataoutlen, dataoutlen, false, true) == false) {
+    if (emrtd_check_cc(ssc, kmac, rapdu, rapdulen) == false) {
         return false;
     }
 
-    return emrtd_check_cc(ssc, kmac, dataout, *dataoutlen);
-}
+    PrintAndLogEx(DEBUG, "secreadbindec, offset %i on read %i: encrypted: %s", offset, bytes_to_read, sprint_hex_inrow(rapdu, rapdulen));
 
-static bool _emrtd_secure_read_binary_decrypt(uint8_t *kenc, uint8_t *kmac, uint8_t *ssc, int offset, int bytes_to_read, uint8_t *dataout, size_t *dataoutlen) {
-    uint8_t response[500] = { 0x00 };
-    uint8_t temp[500] = { 0x00 };
-    size_t resplen, cutat = 0;
-    uint8_t iv[8] = { 0x00 };
-
-    if (_emrtd_secure_read_binary(kmac, ssc, offset, bytes_to_read, response, sizeof(response), &resplen) == false) {
+    if (rapdulen < 3 || rapdu[0] != 0x87) {
         return false;
     }
 
-    PrintAndLogEx(DEBUG, "secreadbindec, offset %i on read %i: encrypted: %s", offset, bytes_to_read, sprint_hex_inrow(response, resplen));
-
-    cutat = ((int) response[1]) - 1;
+    // DO'87' value is the padding indicator followed by the cryptogram
+    int fieldlen = emrtd_get_asn1_field_length(rapdu, rapdulen, 1);
+    int cutat = emrtd_get_asn1_data_length(rapdu, rapdulen, 1) - 1;
+    if (cutat < bytes_to_read || cutat > sizeof(temp) || 2 + fieldlen + cutat > rapdulen) {
+        return false;
+    }
 
-    des3_decrypt_cbc(iv, kenc, response + 3, cutat, temp);
+    des3_decrypt_cbc(iv, kenc, rapdu + 2 + fieldlen, cutat, temp);
     memcpy(dataout, temp, bytes_to_read);
     PrintAndLogEx(DEBUG, "secreadbindec, offset %i on read %i: decrypted: %s", offset, bytes_to_read, sprint_hex_inrow(temp, cutat));
     PrintAndLogEx(DEBUG, "secreadbindec, offset %i on read %i: decrypted and cut: %s", offset, bytes_to_read, sprint_hex_inrow(dataout, bytes_to_read));
+    return true;
+}
+
+static bool _emrtd_secure_read_binary_decrypt(uint8_t *kenc, uint8_t *kmac, uint8_t *ssc, int offset, int bytes_to_read, uint8_t *dataout, size_t *dataoutlen) {
+    uint8_t response[EMRTD_SM_MAX_LEN] = { 0x00 };
+    uint8_t data[14] = { 0x00 };
+    size_t resplen = 0;
+
+    int lc = emrtd_secure_read_binary_data(kmac, ssc, offset, bytes_to_read, data);
+    PrintAndLogEx(DEBUG, "lc: %i", lc);
+
+    if (emrtd_exchange_commands((sAPDU_t) {0x0C, ISO7816_READ_BINARY, offset >> 8, offset & 0xFF, lc, data}, true, 0, response, sizeof(response), &resplen, false, true) == false) {
+        return false;
+    }
+
+    if (emrtd_secure_read_binary_unwrap(kenc, kmac, ssc, offset, bytes_to_read, response, resplen, dataout) == false) {
+        return false;
+    }
     *dataoutlen = bytes_to_read;
     return true;
 }
 
+static void emrtd_read_progress(uint8_t *lnbreak) {
+    PrintAndLogEx(NORMAL, "." NOLF);
+    fflush(stdout);
+    (*lnbreak)--;
+    if (*lnbreak == 0) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "." NOLF);
+        *lnbreak = 32;
+    }
+}
+
+typedef struct {
+    uint8_t *kenc;
+    uint8_t *kmac;
+    uint8_t ssc[8];         // ahead of the session one by the commands already built
+    bool use_secure;
+    int offset;
+    const int *toread;
+    uint8_t *dataout;
+    size_t dataoutlen;
+    size_t done;
+    uint8_t lnbreak;
+} emrtd_read_batch_t;
+
+static void emrtd_read_batch_cb(size_t index, int8_t status, uint8_t *data, uint16_t len, void *cbdata) {
+    emrtd_read_batch_t *ctx = (emrtd_read_batch_t *)cbdata;
+
+    // an answer lost breaks the secure messaging session, all following ones are useless
+    if (index != ctx->done || status != PM3_SUCCESS || len < 2) {
+        return;
+    }
+
+    uint16_t sw = (data[len - 2] << 8) | data[len - 1];
+    if (sw != ISO7816_OK) {
+        PrintAndLogEx(DEBUG, "Command failed (%04x - %s).", sw, GetAPDUCodeDescription(sw >> 8, sw & 0xff));
+        return;
+    }
+    len -= 2;
+
+    int toread = ctx->toread[index];
+    if (ctx->use_secure) {
+        // the command of this answer
+        emrtd_bump_ssc(ctx->ssc);
+        if (emrtd_secure_read_binary_unwrap(ctx->kenc, ctx->kmac, ctx->ssc, ctx->offset, toread, data, len, ctx->dataout + ctx->dataoutlen) == false) {
+            return;
+        }
+    } else {
+        if (len != toread) {
+            return;
+        }
+        memcpy(ctx->dataout + ctx->dataoutlen, data, len);
+    }
+
+    ctx->offset += toread;
+    ctx->dataoutlen += toread;
+    ctx->done++;
+    emrtd_read_progress(&ctx->lnbreak);
+}
+
+// Reads the rest of a file with all the READ BINARY commands built up front and run back to back on the
+// device. The secure messaging counter of every exchange is known in advance, so the MACs of the commands
+// are computed before the first one is sent and the answers are checked as they stream in.
+static bool emrtd_read_file_batch(uint8_t *dataout, size_t *dataoutlen, int offset, int readlen, uint8_t *kenc, uint8_t *kmac, uint8_t *ssc, bool use_secure) {
+    size_t count = (readlen + emrtd_read_size - 1) / emrtd_read_size;
+
+    int *toread = calloc(count, sizeof(int));
+    apdu_batch_item_t *items = calloc(count, sizeof(apdu_batch_item_t));
+    uint8_t *apdus = calloc(count, EMRTD_READ_APDU_MAX_LEN);
+    if (toread == NULL || items == NULL || apdus == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(apdus);
+        free(items);
+        free(toread);
+        return false;
+    }
+
+    emrtd_read_batch_t ctx = {
+        .kenc = kenc,
+        .kmac = kmac,
+        .use_secure = use_secure,
+        .offset = offset,
+        .toread = toread,
+        .dataout = dataout,
+        .dataoutlen = *dataoutlen,
+        .lnbreak = 32,
+    };
+    if (use_secure) {
+        memcpy(ctx.ssc, ssc, sizeof(ctx.ssc));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        toread[i] = MIN(readlen, emrtd_read_size);
+        readlen -= toread[i];
+
+        uint8_t *apdu = apdus + (i * EMRTD_READ_APDU_MAX_LEN);
+        bool extended = (toread[i] > 256);
+        int len = 0;
+        apdu[len++] = (use_secure) ? 0x0C : 0x00;
+        apdu[len++] = ISO7816_READ_BINARY;
+        apdu[len++] = (uint8_t)(offset >> 8);
+        apdu[len++] = (uint8_t)(offset >> 0);
+
+        if (use_secure) {
+            uint8_t data[14] = { 0x00 };
+            int lc = emrtd_secure_read_binary_data(kmac, ssc, offset, toread[i], data);
+            // the answer
+            emrtd_bump_ssc(ssc);
+
+            if (extended) {
+                apdu[len++] = 0x00;
+                apdu[len++] = 0x00;
+            }
+            apdu[len++] = lc;
+            memcpy(apdu + len, data, lc);
+            len += lc;
+            // the answer is longer than what was asked for
+            apdu[len++] = 0x00;
+            if (extended) {
+                apdu[len++] = 0x00;
+            }
+        } else if (extended) {
+            apdu[len++] = 0x00;
+            apdu[len++] = (uint8_t)(toread[i] >> 8);
+            apdu[len++] = (uint8_t)(toread[i] >> 0);
+        } else {
+            apdu[len++] = (uint8_t)toread[i];
+        }
+
+        items[i].apdu = apdu;
+        items[i].len = len;
+        items[i].sw = ISO7816_OK;
+        items[i].sw_mask = 0xFFFF;
+        offset += toread[i];
+    }
+
+    size_t executed = 0;
+    int res = ExchangeAPDU14aBatch(items, count, true, emrtd_read_batch_cb, &ctx, &executed);
+    PrintAndLogEx(NORMAL, "");
+
+    free(apdus);
+    free(items);
+    free(toread);
+
+    if (res != PM3_SUCCESS || ctx.done != count) {
+        PrintAndLogEx(DEBUG, "batched read stopped after %zu of %zu commands (%d)", ctx.done, count, res);
+        return false;
+    }
+    *dataoutlen = ctx.dataoutlen;
+    return true;
+}
+
 static int emrtd_read_file(uint8_t *dataout, size_t *dataoutlen, uint8_t *kenc, uint8_t *kmac, uint8_t *ssc, bool use_secure) {
     uint8_t response[EMRTD_MAX_FILE_SIZE] = { 0x00 };
     size_t resplen = 0;
@@ -656,12 +849,26 @@ static int emrtd_read_file(uint8_t *dataout, size_t *dataoutlen, uint8_t *kenc,
     int readlen = datalen - (3 - emrtd_get_asn1_field_length(response, resplen, 1));
     offset = 4;
 
-    uint8_t lnbreak = 32;
+    if (readlen > (int)(sizeof(response) - resplen)) {
+        PrintAndLogEx(ERR, "File too large, %i bytes", readlen);
+        return false;
+    }
+
     PrintAndLogEx(INFO, "." NOLF);
+
+    // the device runs the commands back to back
+    if (readlen > 0 && GetISODEPState() == ISODEP_NFCA) {
+        if (emrtd_read_file_batch(response, &resplen, offset, readlen, kenc, kmac, ssc, use_secure) == false) {
+            return false;
+        }
+        readlen = 0;
+    }
+
+    uint8_t lnbreak = 32;
     while (readlen > 0) {
         toread = readlen;
-        if (readlen > 118) {
-            toread = 118;
+        if (readlen > EMRTD_READ_SIZE) {
+            toread = EMRTD_READ_SIZE;
         }
 
         if (use_secure) {
@@ -681,14 +888,7 @@ static int emrtd_read_file(uint8_t *dataout, size_t *dataoutlen, uint8_t *kenc,
         readlen -= toread;
         resplen += tempresplen;
 
-        PrintAndLogEx(NORMAL, "." NOLF);
-        fflush(stdout);
-        lnbreak--;
-        if (lnbreak == 0) {
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(INFO, "." NOLF);
-            lnbreak = 32;
-        }
+        emrtd_read_progress(&lnbreak);
     }
     PrintAndLogEx(NORMAL, "");
 
@@ -1043,9 +1243,51 @@ static bool emrtd_do_bac(char *documentnumber, char *dob, char *expiry, uint8_t
     return true;
 }
 
+// Picks the READ BINARY size from the extended length information DO'7F66' in EF.ATR/INFO,
+// two integers, the largest command and the largest answer the chip takes
+static void emrtd_read_atr_info(void) {
+    emrtd_read_size = EMRTD_READ_SIZE;
+
+    if (emrtd_select_file_by_ef(EMRTD_EF_ATR_INFO) == false) {
+        PrintAndLogEx(DEBUG, "No EF.ATR/INFO, using short READ BINARY");
+        return;
+    }
+
+    // the file is short, the chip may warn that it ends before 256 bytes
+    uint8_t response[PM3_CMD_DATA_SIZE] = { 0x00 };
+    size_t resplen = 0;
+    uint16_t sw = 0;
+    int res = Iso7816ExchangeEx(CC_CONTACTLESS, false, true, (sAPDU_t) {0, ISO7816_READ_BINARY, 0, 0, 0, NULL}, true, 0, response, sizeof(response), &resplen, &sw);
+    if (res != PM3_SUCCESS || (sw != ISO7816_OK && sw != 0x6282)) {
+        return;
+    }
+
+    // the copies are bounded by the input only
+    uint8_t info[PM3_CMD_DATA_SIZE] = { 0x00 };
+    size_t infolen = 0;
+    uint8_t maxresp[PM3_CMD_DATA_SIZE] = { 0x00 };
+    size_t maxresplen = 0;
+    if (emrtd_lds_get_data_by_tag(response, resplen, info, &infolen, 0x7F, 0x66, true, false, 0) == false) {
+        return;
+    }
+    if (emrtd_lds_get_data_by_tag(info, infolen, maxresp, &maxresplen, 0x02, 0x00, false, false, 1) == false || maxresplen > 4) {
+        return;
+    }
+
+    int max = bytes_to_num(maxresp, maxresplen) - EMRTD_SM_READ_OVERHEAD;
+    if (max > EMRTD_READ_SIZE) {
+        emrtd_read_size = MIN(max, EMRTD_READ_SIZE_EXT);
+        PrintAndLogEx(DEBUG, "Extended length supported, READ BINARY of %i bytes", emrtd_read_size);
+    }
+}
+
 static bool emrtd_connect(void) {
     int res = Iso7816Connect(CC_CONTACTLESS);
-    return res == PM3_SUCCESS;
+    if (res != PM3_SUCCESS) {
+        return false;
+    }
+    emrtd_read_atr_info();
+    return true;
 }
 
 static bool emrtd_do_auth(char *documentnumber, char *dob, char *expiry, bool BAC_available, bool *BAC, uint8_t *ssc, uint8_t *ks_enc, uint8_t *ks_mac) {
@@ -31,6 +31,9 @@
 #include "des.h"
 #include "cliparser.h"   // cliparser
 #include "util_posix.h"  // msleep
+#include "fileutils.h"
+#include "proxmark3.h"   // get_my_user_directory
+#include "jansson.h"
 
 #define AddCrc(data, len) compute_crc(CRC_FELICA, (data), (len), (data)+(len)+1, (data)+(len))
 
@@ -1881,6 +1884,348 @@ static int CmdHFFelicaDumpServiceArea(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+// Cache of the service layout of a card, in the user directory. Walking the
+// code space with Search Service Code takes one exchange per node, the cache
+// keeps the readable services and their block counts per IDm / PMm so the next
+// dump of the same card goes straight to the device side read.
+//----------------------------------------------------------------------------
+#define FELICA_SVC_CACHE_TEMPLATE   "felica_%s_%s.cache"
+#define FELICA_SVC_CACHE_MAGIC      "PM3FSVC"
+#define FELICA_SVC_CACHE_VERSION    1
+#define FELICA_SVC_MAX              256
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint8_t IDm[8];
+    uint8_t PMm[8];
+    uint8_t max_blocks;
+    uint16_t count;
+} PACKED felica_svc_cache_hdr_t;
+
+// no cache in incognito mode
+static bool felica_svc_cache_path(char *path, size_t len, const felica_card_select_t *card) {
+    const char *user_path = get_my_user_directory();
+    if (user_path == NULL || g_session.incognito) {
+        return false;
+    }
+    char idm[17], pmm[17];
+    snprintf(idm, sizeof(idm), "%s", sprint_hex_inrow(card->IDm, sizeof(card->IDm)));
+    snprintf(pmm, sizeof(pmm), "%s", sprint_hex_inrow(card->PMm, sizeof(card->PMm)));
+
+    char fn[64];
+    snprintf(fn, sizeof(fn), FELICA_SVC_CACHE_TEMPLATE, idm, pmm);
+    int n = snprintf(path, len, "%s%s%s", user_path, PM3_USER_DIRECTORY, fn);
+    return (n > 0 && (size_t)n < len);
+}
+
+static bool felica_svc_cache_load(const felica_card_select_t *card, felica_service_read_t *services, uint16_t *count, uint8_t *max_blocks) {
+    char path[FILE_PATH_SIZE];
+    if (felica_svc_cache_path(path, sizeof(path), card) == false) {
+        return false;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+
+    felica_svc_cache_hdr_t hdr;
+    bool ok = (fread(&hdr, sizeof(hdr), 1, f) == 1)
+              && memcmp(hdr.magic, FELICA_SVC_CACHE_MAGIC, sizeof(FELICA_SVC_CACHE_MAGIC)) == 0
+              && hdr.version == FELICA_SVC_CACHE_VERSION
+              && memcmp(hdr.IDm, card->IDm, sizeof(hdr.IDm)) == 0
+              && memcmp(hdr.PMm, card->PMm, sizeof(hdr.PMm)) == 0
+              && hdr.count <= FELICA_SVC_MAX
+              && fread(services, sizeof(felica_service_read_t), hdr.count, f) == hdr.count;
+    fclose(f);
+
+    if (ok == false) {
+        PrintAndLogEx(DEBUG, "Service cache " _YELLOW_("%s") " is stale, rescanning", path);
+        return false;
+    }
+
+    *count = hdr.count;
+    *max_blocks = hdr.max_blocks;
+    PrintAndLogEx(DEBUG, "Service layout loaded from " _YELLOW_("%s"), path);
+    return true;
+}
+
+// written to a temp file first and renamed, concurrent clients never see a partial cache
+static void felica_svc_cache_save(const felica_card_select_t *card, const felica_service_read_t *services, uint16_t count, uint8_t max_blocks) {
+    char path[FILE_PATH_SIZE];
+    if (felica_svc_cache_path(path, sizeof(path), card) == false) {
+        return;
+    }
+
+    felica_svc_cache_hdr_t hdr = {0};
+    memcpy(hdr.magic, FELICA_SVC_CACHE_MAGIC, sizeof(FELICA_SVC_CACHE_MAGIC));
+    hdr.version = FELICA_SVC_CACHE_VERSION;
+    memcpy(hdr.IDm, card->IDm, sizeof(hdr.IDm));
+    memcpy(hdr.PMm, card->PMm, sizeof(hdr.PMm));
+    hdr.max_blocks = max_blocks;
+    hdr.count = count;
+
+    char tmp[FILE_PATH_SIZE + 16];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        return;
+    }
+
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1);
+    ok = ok && (fwrite(services, sizeof(felica_service_read_t), count, f) == count);
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok == false || rename(tmp, path) != 0) {
+        PrintAndLogEx(DEBUG, "Could not write service cache " _YELLOW_("%s"), path);
+        remove(tmp);
+        return;
+    }
+    PrintAndLogEx(DEBUG, "Service layout saved to " _YELLOW_("%s"), path);
+}
+
+// Walks the code space with Search Service Code, keeps the services readable without a key
+static int felica_search_services(const uint8_t *idm, felica_service_read_t *services, uint16_t *count) {
+
+    uint8_t data[PM3_CMD_DATA_SIZE] = {0};
+    data[0] = 0x0C;
+    data[1] = 0x0A;
+    memcpy(data + 2, idm, 8);
+    uint16_t datalen = 12;
+
+    *count = 0;
+    felica_service_dump_response_t resp;
+
+    for (uint16_t cursor = 0; cursor < 0xFFFF; cursor++) {
+
+        data[10] = cursor & 0xFF;
+        data[11] = cursor >> 8;
+        AddCrc(data, datalen);
+
+        if (send_dump_sv_plain((FELICA_APPEND_CRC | FELICA_RAW), datalen + 2, data, false, &resp, false) != PM3_SUCCESS) {
+            return PM3_ERFTRANS;
+        }
+
+        if (resp.frame_response.cmd_code[0] != 0x0B) {
+            PrintAndLogEx(FAILED, "Bad response cmd 0x%02X @ 0x%04X.", resp.frame_response.cmd_code[0], cursor);
+            return PM3_ERFTRANS;
+        }
+
+        uint16_t node_code = resp.payload[0] | (resp.payload[1] << 8);
+        if (node_code == 0xFFFF) {
+            break;
+        }
+
+        // services come with a 2 byte payload, areas with 4. Odd attributes need no key
+        if (resp.frame_response.length[0] == 0x0C && (node_code & 1) && *count < FELICA_SVC_MAX) {
+            services[*count].code = node_code;
+            services[*count].count = 0;
+            (*count)++;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdHFFelicaDump(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf felica dump",
+                  "Dump all services readable without authentication.\n"
+                  "The service layout is discovered once and cached per IDm / PMm in the user directory.\n"
+                  "Blocks are read by the device with Read Without Encryption over several services\n"
+                  "and blocks per frame, in one field session.",
+                  "hf felica dump\n"
+                  "hf felica dump --rescan        -> ignore the cached service layout\n"
+                  "hf felica dump --max 4 --ns\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("f", "file", "<fn>", "Specify a filename for dump file"),
+        arg_lit0(NULL, "ns", "no save to file"),
+        arg_lit0(NULL, "rescan", "walk the service codes again, ignore the cache"),
+        arg_int0(NULL, "max", "<dec>", "max blocks per frame (def 15)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    bool nosave = arg_get_lit(ctx, 2);
+    bool rescan = arg_get_lit(ctx, 3);
+    int max_blocks = arg_get_int_def(ctx, 4, FELICA_RDBLK_MAX_BLOCKS);
+    CLIParserFree(ctx);
+
+    if (max_blocks < 1 || max_blocks > FELICA_RDBLK_MAX_BLOCKS) {
+        PrintAndLogEx(WARNING, "max blocks per frame must be 1 - %u", FELICA_RDBLK_MAX_BLOCKS);
+        return PM3_EINVARG;
+    }
+
+    clearCommandBuffer();
+    SendCommandMIX(CMD_HF_FELICA_COMMAND, FELICA_CONNECT, 0, 0, NULL, 0);
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_ACK, &resp, 2500) == false || resp.oldarg[0] != 0) {
+        PrintAndLogEx(WARNING, "FeliCa card select failed");
+        return PM3_ESOFT;
+    }
+
+    felica_card_select_t card;
+    memcpy(&card, (felica_card_select_t *)resp.data.asBytes, sizeof(felica_card_select_t));
+    set_last_known_card(card);
+    PrintAndLogEx(INFO, "IDm... " _GREEN_("%s") "  PMm... " _YELLOW_("%s"), sprint_hex_inrow(card.IDm, sizeof(card.IDm)), sprint_hex_inrow(card.PMm, sizeof(card.PMm)));
+
+    felica_service_read_t *services = calloc(FELICA_SVC_MAX, sizeof(felica_service_read_t));
+    if (services == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    uint16_t count = 0;
+    uint8_t cached_max = 0;
+    bool cached = (rescan == false) && felica_svc_cache_load(&card, services, &count, &cached_max);
+    if (cached) {
+        PrintAndLogEx(INFO, "Using cached service layout, " _YELLOW_("%u") " services", count);
+        if (cached_max) {
+            max_blocks = MIN(max_blocks, cached_max);
+        }
+    } else {
+        PrintAndLogEx(INFO, "Searching service codes...");
+        int res = felica_search_services(card.IDm, services, &count);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "Service search failed, move the card around and try again");
+            free(services);
+            return res;
+        }
+        PrintAndLogEx(INFO, "Found " _YELLOW_("%u") " services readable without a key", count);
+    }
+
+    if (count == 0) {
+        free(services);
+        return PM3_SUCCESS;
+    }
+
+    felica_block_t *blocks = calloc(FELICA_SVC_MAX * 16, sizeof(felica_block_t));
+    if (blocks == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(services);
+        return PM3_EMALLOC;
+    }
+    size_t nblocks = 0;
+    size_t blocks_max = FELICA_SVC_MAX * 16;
+
+    int res = PM3_SUCCESS;
+    uint8_t learned_max = max_blocks;
+    uint64_t t1 = msclock();
+
+    for (uint16_t start = 0; start < count && res == PM3_SUCCESS; start += FELICA_READ_MAX_SERVICES) {
+
+        uint8_t n = MIN(count - start, FELICA_READ_MAX_SERVICES);
+        uint8_t payload[sizeof(felica_read_services_t) + FELICA_READ_MAX_SERVICES * sizeof(felica_service_read_t)];
+        felica_read_services_t *rq = (felica_read_services_t *)payload;
+        rq->max_blocks = learned_max;
+        rq->count = n;
+        memcpy(rq->services, services + start, n * sizeof(felica_service_read_t));
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_FELICA_READ_SERVICES, payload, sizeof(felica_read_services_t) + n * sizeof(felica_service_read_t));
+
+        for (;;) {
+            if (WaitForResponseTimeout(CMD_HF_FELICA_READ_SERVICES, &resp, 5000) == false) {
+                PrintAndLogEx(WARNING, "timeout while waiting for reply");
+                res = PM3_ETIMEOUT;
+                break;
+            }
+
+            // final reply
+            if (resp.length == sizeof(felica_read_services_resp_t) || resp.length == 0) {
+                res = resp.status;
+                if (resp.length) {
+                    const felica_read_services_resp_t *fin = (const felica_read_services_resp_t *)resp.data.asBytes;
+                    learned_max = fin->max_blocks;
+                    for (uint8_t i = 0; i < n; i++) {
+                        services[start + i].count = fin->blocks[i];
+                    }
+                }
+                break;
+            }
+
+            size_t cnt = resp.length / sizeof(felica_block_t);
+            if (nblocks + cnt > blocks_max) {
+                cnt = blocks_max - nblocks;
+            }
+            memcpy(blocks + nblocks, resp.data.asBytes, cnt * sizeof(felica_block_t));
+            nblocks += cnt;
+        }
+    }
+
+    t1 = msclock() - t1;
+
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Read failed ( " _RED_("%d") " ), %zu blocks read", res, nblocks);
+    } else {
+        // drop the services the card had nothing to read from
+        uint16_t keep = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            if (services[i].count) {
+                services[keep++] = services[i];
+            }
+        }
+        felica_svc_cache_save(&card, services, keep, learned_max);
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "service | block | data");
+    PrintAndLogEx(INFO, "--------+-------+-------------------------------------------------");
+    for (size_t i = 0; i < nblocks; i++) {
+        PrintAndLogEx(INFO, "  %04X  | %04X  | %s", blocks[i].code, blocks[i].block, sprint_hex(blocks[i].data, FELICA_BLOCK_SIZE));
+    }
+    PrintAndLogEx(INFO, "--------+-------+-------------------------------------------------");
+    PrintAndLogEx(SUCCESS, "%zu blocks in %" PRIu64 " ms, up to %u blocks per frame", nblocks, t1, learned_max);
+
+    if (nosave || nblocks == 0) {
+        free(blocks);
+        free(services);
+        return res;
+    }
+
+    // json layout, one object per service keyed by service code, block number -> data
+    json_t *root = json_object();
+    json_object_set_new(root, "Created", json_string("proxmark3"));
+    json_object_set_new(root, "FileType", json_string("felica services"));
+    json_t *jcard = json_object();
+    json_object_set_new(jcard, "IDm", json_string(sprint_hex_inrow(card.IDm, sizeof(card.IDm))));
+    json_object_set_new(jcard, "PMm", json_string(sprint_hex_inrow(card.PMm, sizeof(card.PMm))));
+    json_object_set_new(root, "Card", jcard);
+
+    json_t *jsvc = json_object();
+    for (size_t i = 0; i < nblocks; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "%04X", blocks[i].code);
+        json_t *js = json_object_get(jsvc, key);
+        if (js == NULL) {
+            js = json_object();
+            json_object_set_new(jsvc, key, js);
+        }
+        char blk[8];
+        snprintf(blk, sizeof(blk), "%u", blocks[i].block);
+        json_object_set_new(js, blk, json_string(sprint_hex_inrow(blocks[i].data, FELICA_BLOCK_SIZE)));
+    }
+    json_object_set_new(root, "Services", jsvc);
+
+    if (fnlen < 1) {
+        char *fptr = filename + snprintf(filename, sizeof(filename), "hf-felica-");
+        FillFileNameByUID(fptr, card.IDm, "-dump", sizeof(card.IDm));
+    }
+    saveFileJSONroot(filename, root, JSON_INDENT(2), true);
+    json_decref(root);
+
+    free(blocks);
+    free(services);
+    return res;
+}
+
 static int CmdHFFelicaSniff(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf felica sniff",
@@ -2344,7 +2689,7 @@ static command_t CommandTable[] = {
     {"sniff",           CmdHFFelicaSniff,                 IfPm3Felica,     "Sniff ISO 18092/FeliCa traffic"},
     {"wrbl",            CmdHFFelicaWritePlain,            IfPm3Felica,     "write block data to an authentication-not-required Service."},
     {"-----------",     CmdHelp,                          AlwaysAvailable, "----------------------- " _CYAN_("FeliCa Standard") " -----------------------"},
-    //{"dump",          CmdHFFelicaDump,                    IfPm3Felica,     "Wait for and try dumping FeliCa"},
+    {"dump",            CmdHFFelicaDump,                  IfPm3Felica,     "Dump the services readable without a key"},
     {"rqservice",       CmdHFFelicaRequestService,        IfPm3Felica,     "verify the existence of Area and Service, and to acquire Key Version."},
     {"rqresponse",      CmdHFFelicaRequestResponse,       IfPm3Felica,     "verify the existence of a card and its Mode."},
     {"scsvcode",        CmdHFFelicaDumpServiceArea,       IfPm3Felica,     "acquire Area Code and Service Code."},
@@ -45,6 +45,7 @@
 #include "util.h"
 #include "fileutils.h"   // laodFileJSONroot
 #include "protocols.h"   // ISO7816 APDU return codes
+#include "util_posix.h"  // usclock
 
 #define DEF_FIDO_SIZE        2048
 #define DEF_FIDO_PARAM_FILE  "hf_fido2_defparams.json"
@@ -910,6 +911,210 @@ static int CmdHFFido2GetAssertion(const char *cmd) {
     return res;
 }
 
+static int fido_bench_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void FIDO2BenchPrint(const char *name, uint32_t *lat, uint32_t n, uint32_t failed) {
+    if (n == 0) {
+        PrintAndLogEx(FAILED, "%s " _RED_("no successful operations") ", %u failed", name, failed);
+        return;
+    }
+
+    qsort(lat, n, sizeof(uint32_t), fido_bench_cmp_u32);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        total += lat[i];
+    }
+
+    PrintAndLogEx(SUCCESS, "%s " _YELLOW_("%u") " ok, %u failed", name, n, failed);
+    PrintAndLogEx(SUCCESS, "   min / avg... " _YELLOW_("%u") " / " _YELLOW_("%" PRIu64) " ms", lat[0] / 1000, (total / n) / 1000);
+    PrintAndLogEx(SUCCESS, "   p50 / p90... " _YELLOW_("%u") " / " _YELLOW_("%u") " ms", lat[n / 2] / 1000, lat[(n * 90) / 100] / 1000);
+    PrintAndLogEx(SUCCESS, "   p99 / max... " _YELLOW_("%u") " / " _YELLOW_("%u") " ms", lat[(n * 99) / 100] / 1000, lat[n - 1] / 1000);
+}
+
+// one FIDO2 command, the time from sending the request to the complete answer
+static int FIDO2BenchExchange(bool make, uint8_t *data, size_t datalen, uint8_t *buf, size_t maxlen, size_t *len, uint32_t *us) {
+    uint16_t sw = 0;
+    uint64_t t = usclock();
+    int res = (make) ? FIDO2MakeCredential(data, datalen, buf, maxlen, len, &sw) : FIDO2GetAssertion(data, datalen, buf, maxlen, len, &sw);
+    *us = (uint32_t)(usclock() - t);
+
+    if (res) {
+        return res;
+    }
+    if (sw != ISO7816_OK) {
+        PrintAndLogEx(ERR, "APDU response status: %04x - %s", sw, GetAPDUCodeDescription(sw >> 8, sw & 0xff));
+        return PM3_ESOFT;
+    }
+    if (*len == 0 || buf[0]) {
+        PrintAndLogEx(ERR, "FIDO2 error: %d - %s", buf[0], fido2GetCmdErrorDescription(buf[0]));
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdHFFido2Bench(const char *cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf fido bench",
+                  "Run FIDO2 MakeCredential / GetAssertion cycles back to back and report the latency percentiles.\n"
+                  "The requests are encoded once from the json parameters file, the card stays selected in between.\n"
+                  "GetAssertion uses the credential from the first MakeCredential.\n"
+                  "Authenticators that ask for user presence need `\"up\": false` in the options, or a touch per operation.",
+                  "hf fido bench                --> 10 cycles with `fido2_defparams.json`\n"
+                  "hf fido bench -n 100 --make  --> 100 MakeCredential commands\n"
+                  "hf fido bench -n 100 -f test.json"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("a", "apdu", "Show APDU requests and responses"),
+        arg_str0("f", "file", "<fn>", "Parameter JSON file name"),
+        arg_u64_0("n", "count", "<dec>", "number of cycles (def 10)"),
+        arg_lit0(NULL, "make", "MakeCredential only"),
+        arg_lit0(NULL, "assert", "GetAssertion only, after one MakeCredential"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, cmd, argtable, true);
+
+    bool APDULogging = arg_get_lit(ctx, 1);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    uint32_t count = arg_get_u32_def(ctx, 3, 10);
+    bool do_make = arg_get_lit(ctx, 4);
+    bool do_assert = arg_get_lit(ctx, 5);
+    CLIParserFree(ctx);
+
+    if ((do_make || do_assert) == false) {
+        do_make = do_assert = true;
+    }
+
+    if (count == 0) {
+        PrintAndLogEx(WARNING, "Count must be above zero");
+        return PM3_EINVARG;
+    }
+
+    // default name
+    if (fnlen == 0) {
+        strcat(filename, DEF_FIDO_PARAM_FILE);
+        fnlen = strlen(filename);
+    }
+
+    json_t *root = NULL;
+    loadFileJSONroot(filename, (void **)&root, false);
+    if (root == NULL) {
+        return PM3_EFILE;
+    }
+
+    uint32_t *lat_make = calloc(count, sizeof(uint32_t));
+    uint32_t *lat_assert = calloc(count, sizeof(uint32_t));
+    uint8_t *make_req = calloc(1, DEF_FIDO_SIZE);
+    uint8_t *assert_req = calloc(1, DEF_FIDO_SIZE);
+    uint8_t *buf = calloc(1, DEF_FIDO_SIZE);
+    if (lat_make == NULL || lat_assert == NULL || make_req == NULL || assert_req == NULL || buf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(lat_make);
+        free(lat_assert);
+        free(make_req);
+        free(assert_req);
+        free(buf);
+        json_decref(root);
+        return PM3_EMALLOC;
+    }
+
+    size_t make_len = 0, assert_len = 0, len = 0;
+    uint32_t n_make = 0, n_assert = 0, fail_make = 0, fail_assert = 0;
+    uint16_t sw = 0;
+    uint32_t us = 0;
+
+    SetAPDULogging(APDULogging);
+
+    // the MakeCredential request doesn't change between the cycles
+    int res = FIDO2CreateMakeCredentionalReq(root, make_req, DEF_FIDO_SIZE, &make_len);
+    if (res) {
+        PrintAndLogEx(ERR, "Can't create MakeCredential request");
+        goto out;
+    }
+
+    DropField();
+    res = FIDOSelect(true, true, buf, DEF_FIDO_SIZE, &len, &sw);
+    if (res || sw != ISO7816_OK) {
+        PrintAndLogEx(ERR, "Can't select FIDO application. res=%x sw=%04x", res, sw);
+        res = (res) ? res : PM3_ESOFT;
+        goto out;
+    }
+
+    // a credential for the GetAssertion requests, its id is stored in the json by the parser
+    res = FIDO2BenchExchange(true, make_req, make_len, buf, DEF_FIDO_SIZE, &len, &us);
+    if (res) {
+        PrintAndLogEx(ERR, "Can't execute MakeCredential command. res=%x", res);
+        goto out;
+    }
+    if (do_make) {
+        lat_make[n_make++] = us;
+    }
+
+    if (do_assert) {
+        FIDO2MakeCredentionalParseRes(root, &buf[1], len - 1, false, false, false, false);
+
+        res = FIDO2CreateGetAssertionReq(root, assert_req, DEF_FIDO_SIZE, &assert_len, true);
+        if (res) {
+            PrintAndLogEx(ERR, "Can't create GetAssertion request");
+            goto out;
+        }
+    }
+
+    PrintAndLogEx(INFO, "Running " _YELLOW_("%u") " cycles, press " _GREEN_("<Enter>") " to abort", count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!");
+            break;
+        }
+
+        if (do_make && i > 0) {
+            if (FIDO2BenchExchange(true, make_req, make_len, buf, DEF_FIDO_SIZE, &len, &us) == PM3_SUCCESS) {
+                lat_make[n_make++] = us;
+            } else {
+                fail_make++;
+            }
+        }
+
+        if (do_assert) {
+            if (FIDO2BenchExchange(false, assert_req, assert_len, buf, DEF_FIDO_SIZE, &len, &us) == PM3_SUCCESS) {
+                lat_assert[n_assert++] = us;
+            } else {
+                fail_assert++;
+            }
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    if (do_make) {
+        FIDO2BenchPrint("MakeCredential.", lat_make, n_make, fail_make);
+    }
+    if (do_assert) {
+        FIDO2BenchPrint("GetAssertion...", lat_assert, n_assert, fail_assert);
+    }
+    res = (fail_make || fail_assert) ? PM3_ESOFT : PM3_SUCCESS;
+
+out:
+    DropField();
+    SetAPDULogging(false);
+    free(lat_make);
+    free(lat_assert);
+    free(make_req);
+    free(assert_req);
+    free(buf);
+    json_decref(root);
+    return res;
+}
+
 static command_t CommandTable[] = {
     {"help",      CmdHelp,                   AlwaysAvailable, "This help."},
     {"list",      CmdHFFidoList,             AlwaysAvailable, "List ISO 14443A history"},
@@ -919,6 +1124,7 @@ static command_t CommandTable[] = {
     {"auth",      CmdHFFidoAuthenticate,     IfPm3Iso14443a,  "FIDO U2F Authentication Message."},
     {"make",      CmdHFFido2MakeCredential,  IfPm3Iso14443a,  "FIDO2 MakeCredential command."},
     {"assert",    CmdHFFido2GetAssertion,    IfPm3Iso14443a,  "FIDO2 GetAssertion command."},
+    {"bench",     CmdHFFido2Bench,           IfPm3Iso14443a,  "FIDO2 MakeCredential / GetAssertion latency benchmark."},
     {NULL, NULL, 0, NULL}
 };
 
@@ -18,6 +18,12 @@
 
 #include "cmdhficlass.h"
 #include <ctype.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "cliparser.h"
 #include "cmdparser.h"              // command_t
 #include "commonutil.h"             // ARRAYLEN
@@ -36,12 +42,14 @@
 #include "wiegand_formatutils.h"
 #include "cmdsmartcard.h"           // smart select fct
 #include "proxendian.h"
+#include "crc32.h"                  // crc32_ex, emulator memory shadow
 #include "iclass_cmd.h"
 #include "crypto/asn1utils.h"       // ASN1 decoder
 #include "preferences.h"
 #include "generator.h"
 #include "cmdhw.h"
 #include "hidsio.h"
+#include "proxmark3.h"             // get_my_user_directory
 
 
 #define ICLASS_DEBIT_KEYTYPE   ( 0x88 )
@@ -55,6 +63,7 @@
 #define ICLASS_DECRYPTION_BIN           "iclass_decryptionkey.bin"
 #define ICLASS_DEFAULT_KEY_DIC          "iclass_default_keys.dic"
 #define ICLASS_DEFAULT_KEY_ELITE_DIC    "iclass_elite_keys.dic"
+#define ICLASS_ELITE_KEYTABLE_SIZE      128 // hash2 output
 
 static void print_picopass_info(const picopass_hdr_t *hdr);
 void print_picopass_header(const picopass_hdr_t *hdr);
@@ -202,47 +211,150 @@ static inline uint32_t leadingzeros(uint64_t a) {
 #endif
 }
 
-static void iclass_upload_emul(uint8_t *d, uint16_t n, uint16_t offset, uint16_t *bytes_sent) {
+// Client copy of the emulator memory as last uploaded, from offset 0 up to len bytes.
+// Uploads only send the blocks that differ from it, after a CRC32 of the device memory
+// confirmed the copy still holds: a sim writes blocks, other commands and bitstream
+// switches reuse the memory, the device may have been restarted.
+#define ICLASS_EMUL_SHADOW_SIZE 4096 // device emulator memory, CARD_MEMORY_SIZE
+static struct {
+    bool valid;
+    uint16_t len;
+    uint8_t data[ICLASS_EMUL_SHADOW_SIZE];
+} iclass_emul_shadow;
 
-    struct p {
+static bool iclass_emul_shadow_check(void) {
+
+    if (iclass_emul_shadow.valid == false || iclass_emul_shadow.len == 0) {
+        return false;
+    }
+
+    struct {
         uint16_t offset;
         uint16_t len;
-        uint8_t data[];
-    } PACKED;
+    } PACKED payload = { 0, iclass_emul_shadow.len };
 
-    // fast push mode
-    g_conn.block_after_ACK = true;
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ICLASS_EML_CRC, (uint8_t *)&payload, sizeof(payload));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_HF_ICLASS_EML_CRC, &resp, 1500) == false || resp.status != PM3_SUCCESS || resp.length != 4) {
+        // older firmware, or no reply
+        iclass_emul_shadow.valid = false;
+        return false;
+    }
 
-    //Send to device
-    *bytes_sent = 0;
-    uint16_t bytes_remaining = n;
+    uint8_t crc[4] = {0};
+    crc32_ex(iclass_emul_shadow.data, iclass_emul_shadow.len, crc);
+    if (memcmp(crc, resp.data.asBytes, sizeof(crc)) != 0) {
+        PrintAndLogEx(DEBUG, "emulator memory changed on device, full upload");
+        iclass_emul_shadow.valid = false;
+        return false;
+    }
+    return true;
+}
+
+static void iclass_emul_shadow_update(const uint8_t *d, uint16_t n, uint16_t offset) {
+
+    if ((uint32_t)offset + n > ICLASS_EMUL_SHADOW_SIZE) {
+        iclass_emul_shadow.valid = false;
+        return;
+    }
+
+    // a gap in front of the new data is memory the shadow does not know
+    uint16_t known = iclass_emul_shadow.valid ? iclass_emul_shadow.len : 0;
+    if (offset > known) {
+        return;
+    }
+
+    memcpy(iclass_emul_shadow.data + offset, d, n);
+    iclass_emul_shadow.len = MAX(known, offset + n);
+    iclass_emul_shadow.valid = true;
+}
+
+static void iclass_upload_range(const uint8_t *d, uint16_t n, uint16_t offset, bool last) {
 
-    PrintAndLogEx(INFO, "Uploading to emulator memory");
-    PrintAndLogEx(INFO, "." NOLF);
+    struct p {
+        uint16_t offset;
+        uint16_t len;
+        uint8_t data[];
+    } PACKED;
 
-    while (bytes_remaining > 0) {
-        uint32_t bytes_in_packet = MIN(PM3_CMD_DATA_SIZE - 4, bytes_remaining);
-        if (bytes_in_packet == bytes_remaining) {
+    uint16_t sent = 0;
+    while (sent < n) {
+        uint32_t bytes_in_packet = MIN(GetJumboPayloadSize() - 4, n - sent);
+        if (last && bytes_in_packet == (uint32_t)(n - sent)) {
             // Disable fast mode on last packet
             g_conn.block_after_ACK = false;
         }
 
         struct p *payload = calloc(4 + bytes_in_packet, sizeof(uint8_t));
-        payload->offset = offset + *bytes_sent;
+        payload->offset = offset + sent;
         payload->len = bytes_in_packet;
-        memcpy(payload->data, d + *bytes_sent, bytes_in_packet);
+        memcpy(payload->data, d + sent, bytes_in_packet);
 
         clearCommandBuffer();
         SendCommandNG(CMD_HF_ICLASS_EML_MEMSET, (uint8_t *)payload, 4 + bytes_in_packet);
         free(payload);
 
-        bytes_remaining -= bytes_in_packet;
-        *bytes_sent += bytes_in_packet;
+        sent += bytes_in_packet;
 
         PrintAndLogEx(NORMAL, "." NOLF);
         fflush(stdout);
     }
-    PrintAndLogEx(NORMAL, "");
+}
+
+static void iclass_upload_emul(uint8_t *d, uint16_t n, uint16_t offset, uint16_t *bytes_sent) {
+
+    //Send to device
+    *bytes_sent = 0;
+
+    // blocks inside what the shadow knows are compared against it, the rest goes as is
+    uint16_t known = 0;
+    if (iclass_emul_shadow.valid && offset < iclass_emul_shadow.len && iclass_emul_shadow_check()) {
+        known = MIN(n, iclass_emul_shadow.len - offset);
+    }
+
+    // runs of changed blocks, from start to end
+    uint16_t runs[ICLASS_EMUL_SHADOW_SIZE / PICOPASS_BLOCK_SIZE][2];
+    uint16_t nruns = 0;
+    uint16_t changed = 0, total = 0;
+
+    for (uint16_t pos = 0; pos < n; pos += PICOPASS_BLOCK_SIZE) {
+        uint16_t len = MIN(PICOPASS_BLOCK_SIZE, n - pos);
+        total++;
+
+        if (pos + len <= known && memcmp(d + pos, iclass_emul_shadow.data + offset + pos, len) == 0) {
+            continue;
+        }
+
+        changed++;
+        if (nruns && (runs[nruns - 1][1] == pos || nruns == ARRAYLEN(runs))) {
+            runs[nruns - 1][1] = pos + len;
+        } else {
+            runs[nruns][0] = pos;
+            runs[nruns][1] = pos + len;
+            nruns++;
+        }
+    }
+
+    if (known) {
+        PrintAndLogEx(INFO, "Uploading to emulator memory, " _YELLOW_("%u") " of %u blocks changed", changed, total);
+    } else {
+        PrintAndLogEx(INFO, "Uploading to emulator memory");
+    }
+
+    if (nruns) {
+        // fast push mode
+        g_conn.block_after_ACK = true;
+
+        PrintAndLogEx(INFO, "." NOLF);
+        for (uint16_t i = 0; i < nruns; i++) {
+            iclass_upload_range(d + runs[i][0], runs[i][1] - runs[i][0], offset + runs[i][0], i == nruns - 1);
+            *bytes_sent += runs[i][1] - runs[i][0];
+        }
+        PrintAndLogEx(NORMAL, "");
+    }
+
+    iclass_emul_shadow_update(d, n, offset);
 }
 
 static const char *card_types[] = {
@@ -811,19 +923,29 @@ static int CmdHFiClassSniff(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf iclass sniff",
-                  "Sniff the communication between reader and tag",
+                  "Sniff the communication between reader and tag\n"
+                  "With `--stream` the trace goes to the client while sniffing and is not limited by the device memory,\n"
+                  "view it with `hf iclass list -1`",
                   "hf iclass sniff\n"
                   "hf iclass sniff -j    --> jam e-purse updates\n"
+                  "hf iclass sniff --stream -f hf-iclass-sniff\n"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("j",  "jam",    "Jam (prevent) e-purse updates"),
+        arg_lit0(NULL, "stream", "stream the trace to the client while sniffing (USB only)"),
+        arg_str0("f", "file", "<fn>", "with --stream, also write the trace to this file as it arrives"),
         arg_param_end
     };
 
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     bool jam_epurse_update = arg_get_lit(ctx, 1);
+    bool stream = arg_get_lit(ctx, 2);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
     if (jam_epurse_update) {
@@ -833,6 +955,7 @@ static int CmdHFiClassSniff(const char *Cmd) {
     struct {
         uint8_t jam_search_len;
         uint8_t jam_search_string[2];
+        uint8_t flags;
     } PACKED payload;
 
     memset(&payload, 0, sizeof(payload));
@@ -843,6 +966,15 @@ static int CmdHFiClassSniff(const char *Cmd) {
         memcpy(payload.jam_search_string, update_epurse_sequence, sizeof(payload.jam_search_string));
     }
 
+    if (stream) {
+        payload.flags |= 0x01;
+        int res = trace_stream_sniff(CMD_HF_ICLASS_SNIFF, (uint8_t *)&payload, sizeof(payload), filename);
+        if (res == PM3_SUCCESS) {
+            PrintAndLogEx(HINT, "Hint: Try `" _YELLOW_("hf iclass list -1") "` to view captured tracelog");
+        }
+        return res;
+    }
+
     PacketResponseNG resp;
     clearCommandBuffer();
     SendCommandNG(CMD_HF_ICLASS_SNIFF, (uint8_t *)&payload, sizeof(payload));
@@ -859,6 +991,69 @@ static int CmdHFiClassSniff(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// loclass while the reader attack is still capturing, see `hf iclass sim -t 2 --live`.
+// The capture loop appends the items, the solver thread takes them in order.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    loclass_dumpdata_t items[NUM_CSNS];
+    uint8_t captured;
+    bool capture_done;
+    int res;                // PM3_EPARTIAL until the key is known or an item fails
+    uint8_t kcus[8];
+    uint16_t keytable[128];
+} iclass_live_loclass_t;
+
+static void *iclass_live_loclass(void *thread_arg) {
+    iclass_live_loclass_t *live = (iclass_live_loclass_t *)thread_arg;
+
+    uint8_t solved = 0;
+    for (;;) {
+        pthread_mutex_lock(&live->lock);
+        while (solved == live->captured && live->capture_done == false) {
+            pthread_cond_wait(&live->cond, &live->lock);
+        }
+        if (solved == live->captured) {
+            pthread_mutex_unlock(&live->lock);
+            break;
+        }
+        loclass_dumpdata_t item = live->items[solved];
+        pthread_mutex_unlock(&live->lock);
+
+        int res = bruteforceItemIncremental(item, live->keytable, live->kcus);
+        solved++;
+
+        pthread_mutex_lock(&live->lock);
+        live->res = res;
+        pthread_mutex_unlock(&live->lock);
+
+        if (res != PM3_EPARTIAL) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static int iclass_live_loclass_result(iclass_live_loclass_t *live) {
+    pthread_mutex_lock(&live->lock);
+    int res = live->res;
+    pthread_mutex_unlock(&live->lock);
+    return res;
+}
+
+// no more items, waits for the solver to finish the ones it has
+static int iclass_live_loclass_finish(iclass_live_loclass_t *live, pthread_t thread) {
+    pthread_mutex_lock(&live->lock);
+    live->capture_done = true;
+    pthread_cond_signal(&live->cond);
+    pthread_mutex_unlock(&live->lock);
+
+    pthread_join(thread, NULL);
+    pthread_cond_destroy(&live->cond);
+    pthread_mutex_destroy(&live->lock);
+    return live->res;
+}
+
 static int CmdHFiClassSim(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf iclass sim",
@@ -866,6 +1061,7 @@ static int CmdHFiClassSim(const char *Cmd) {
                   "hf iclass sim -t 0 --csn 031FEC8AF7FF12E0   --> simulate with specified CSN\n"
                   "hf iclass sim -t 1                          --> simulate with default CSN\n"
                   "hf iclass sim -t 2                          --> execute loclass attack online part\n"
+                  "hf iclass sim -t 2 --live                   --> execute loclass attack online part, solving the MACs as they come in\n"
                   "hf iclass sim -t 3                          --> simulate full iCLASS 2k tag\n"
                   "hf iclass sim -t 4                          --> Reader-attack, adapted for KeyRoll mode, gather reader responses to extract elite key\n"
                   "hf iclass sim -t 6                          --> simulate full iCLASS 2k tag that doesn't respond to r/w requests to the last SIO block\n"
@@ -875,6 +1071,7 @@ static int CmdHFiClassSim(const char *Cmd) {
         arg_param_begin,
         arg_int1("t", "type", "<0-4> ", "Simulation type to use"),
         arg_str0(NULL, "csn", "<hex>", "Specify CSN as 8 hex bytes to use with sim type 0"),
+        arg_lit0(NULL, "live", "sim type 2, run loclass on every MAC as soon as it is collected"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -885,6 +1082,8 @@ static int CmdHFiClassSim(const char *Cmd) {
     uint8_t csn[8] = {0};
     CLIGetHexWithReturn(ctx, 2, csn, &csn_len);
 
+    bool live = arg_get_lit(ctx, 3);
+
     if (sim_type == 0 && csn_len > 0) {
         if (csn_len != 8) {
             PrintAndLogEx(ERR, "CSN is incorrect length");
@@ -900,6 +1099,11 @@ static int CmdHFiClassSim(const char *Cmd) {
 
     CLIParserFree(ctx);
 
+    if (live && sim_type != ICLASS_SIM_MODE_READER_ATTACK) {
+        PrintAndLogEx(ERR, "--live only works with sim type 2");
+        return PM3_EINVARG;
+    }
+
     if (sim_type > 4 && sim_type != 6 && sim_type != 7) {
         PrintAndLogEx(ERR, "Undefined simtype %d", sim_type);
         return PM3_EINVARG;
@@ -938,24 +1142,110 @@ static int CmdHFiClassSim(const char *Cmd) {
         case ICLASS_SIM_MODE_READER_ATTACK: {
             PrintAndLogEx(INFO, "Starting iCLASS sim 2 attack (elite mode)");
             PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to abort");
+
+            iclass_live_loclass_t live_state;
+            pthread_t live_thread;
+            if (live) {
+                memset(&live_state, 0, sizeof(live_state));
+                live_state.res = PM3_EPARTIAL;
+                pthread_mutex_init(&live_state.lock, NULL);
+                pthread_cond_init(&live_state.cond, NULL);
+                if (pthread_create(&live_thread, NULL, iclass_live_loclass, (void *)&live_state)) {
+                    PrintAndLogEx(WARNING, "Failed to create pthread, solving after the capture");
+                    pthread_cond_destroy(&live_state.cond);
+                    pthread_mutex_destroy(&live_state.lock);
+                    live = false;
+                }
+            }
+
             PacketResponseNG resp;
             clearCommandBuffer();
             SendCommandMIX(CMD_HF_ICLASS_SIMULATE, sim_type, NUM_CSNS, 1, csns, NUM_CSNS * PICOPASS_BLOCK_SIZE);
 
-            while (WaitForResponseTimeout(CMD_ACK, &resp, 2000) == false) {
-                tries++;
-                if (kbd_enter_pressed()) {
-                    PrintAndLogEx(WARNING, "\naborted via keyboard.");
-                    return PM3_EOPABORTED;
+            bool stop_sent = false;
+            int res = PM3_SUCCESS;
+            for (;;) {
+
+                if (live && stop_sent == false && iclass_live_loclass_result(&live_state) == PM3_SUCCESS) {
+                    // key is known, the remaining CSNs are not needed
+                    PrintAndLogEx(INFO, "Key recovered, stopping the simulation");
+                    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                    stop_sent = true;
                 }
-                if (tries > 20) {
-                    PrintAndLogEx(WARNING, "\ntimeout while waiting for reply");
-                    return PM3_ETIMEOUT;
+
+                // MACs come in one by one, the ACK carries all of them when the sim is done
+                if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 500) == false) {
+                    tries++;
+                    if (kbd_enter_pressed()) {
+                        PrintAndLogEx(WARNING, "\naborted via keyboard.");
+                        res = PM3_EOPABORTED;
+                        break;
+                    }
+                    if (tries > 80) {
+                        PrintAndLogEx(WARNING, "\ntimeout while waiting for reply");
+                        res = PM3_ETIMEOUT;
+                        break;
+                    }
+                    continue;
+                }
+
+                if (resp.cmd == CMD_ACK) {
+                    break;
+                }
+
+                if (resp.cmd != CMD_HF_ICLASS_SIMULATE || resp.length != sizeof(iclass_sim_mac_t)) {
+                    continue;
+                }
+
+                tries = 0;
+                const iclass_sim_mac_t *mac = (const iclass_sim_mac_t *)resp.data.asBytes;
+                PrintAndLogEx(SUCCESS, "MAC " _YELLOW_("%u") " / %u collected", mac->csn_index + 1, NUM_CSNS);
+
+                if (live && mac->csn_index < NUM_CSNS) {
+                    pthread_mutex_lock(&live_state.lock);
+                    if (mac->csn_index == live_state.captured) {
+                        loclass_dumpdata_t *item = &live_state.items[live_state.captured++];
+                        memcpy(item->csn, csns + (mac->csn_index * PICOPASS_BLOCK_SIZE), sizeof(item->csn));
+                        memcpy(item->cc_nr, mac->epurse_nr_mac, sizeof(item->cc_nr));
+                        memcpy(item->mac, mac->epurse_nr_mac + sizeof(item->cc_nr), sizeof(item->mac));
+                        pthread_cond_signal(&live_state.cond);
+                    }
+                    pthread_mutex_unlock(&live_state.lock);
+                }
+            }
+
+            if (res != PM3_SUCCESS) {
+                if (live) {
+                    PrintAndLogEx(INFO, "waiting for loclass to finish the MACs collected so far");
+                    iclass_live_loclass_finish(&live_state, live_thread);
                 }
+                return res;
             }
+
             uint8_t num_mac  = resp.oldarg[1];
             bool success = (NUM_CSNS == num_mac);
-            PrintAndLogEx((success) ? SUCCESS : WARNING, "[%c] %d out of %d MAC obtained [%s]", (success) ? '+' : '!', num_mac, NUM_CSNS, (success) ? "OK" : "FAIL");
+            PrintAndLogEx((success || stop_sent) ? SUCCESS : WARNING, "[%c] %d out of %d MAC obtained [%s]", (success || stop_sent) ? '+' : '!', num_mac, NUM_CSNS, (success || stop_sent) ? "OK" : "FAIL");
+
+            if (live) {
+                // the ACK has all MACs, hand over any the solver has not seen
+                pthread_mutex_lock(&live_state.lock);
+                while (live_state.captured < num_mac && live_state.captured < NUM_CSNS) {
+                    uint8_t i = live_state.captured++;
+                    loclass_dumpdata_t *item = &live_state.items[i];
+                    memcpy(item->csn, csns + (i * PICOPASS_BLOCK_SIZE), sizeof(item->csn));
+                    memcpy(item->cc_nr, resp.data.asBytes + (i * 16), sizeof(item->cc_nr));
+                    memcpy(item->mac, resp.data.asBytes + (i * 16) + sizeof(item->cc_nr), sizeof(item->mac));
+                }
+                pthread_cond_signal(&live_state.cond);
+                pthread_mutex_unlock(&live_state.lock);
+
+                res = iclass_live_loclass_finish(&live_state, live_thread);
+                if (res == PM3_EPARTIAL) {
+                    PrintAndLogEx(WARNING, "Not enough MACs to recover the key");
+                } else if (res != PM3_SUCCESS) {
+                    PrintAndLogEx(ERR, "loclass key recovery( %s )", _RED_("fail"));
+                }
+            }
 
             if (num_mac == 0)
                 break;
@@ -1898,6 +2188,68 @@ static bool select_only(uint8_t *CSN, uint8_t *CCNR, bool verbose, bool shallow_
     return true;
 }
 
+// Runs one CMD_HF_ICLASS_DUMP and places the streamed blocks into tag_data as they arrive,
+// unread blocks keep their 0xFF. last_block is the highest block read, it is left alone
+// when nothing was read. The diversified key goes to block 3 (debit) or 4 (credit).
+static int iclass_dump_stream(const iclass_dump_req_t *payload, uint8_t *tag_data, size_t tag_data_len, uint16_t *blocks_read, uint16_t *last_block) {
+
+    uint16_t total = payload->end_block - payload->start_block + 1;
+    bool aborted = false;
+    *blocks_read = 0;
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ICLASS_DUMP, (uint8_t *)payload, sizeof(iclass_dump_req_t));
+
+    PacketResponseNG resp;
+    for (;;) {
+
+        if (aborted == false && kbd_enter_pressed()) {
+            // the device stops at the next group and reports what it read so far
+            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        // one reply per chunk of blocks, the device is still busy until the last one
+        if (WaitForResponseTimeout(CMD_HF_ICLASS_DUMP, &resp, 2000) == false) {
+            PrintAndLogEx(NORMAL, "." NOLF);
+            continue;
+        }
+
+        const iclass_dump_chunk_t *chunk = (const iclass_dump_chunk_t *)resp.data.asBytes;
+        if (resp.length < offsetof(iclass_dump_chunk_t, data)) {
+            // select or authentication failed
+            PrintAndLogEx(NORMAL, "");
+            return (resp.status == PM3_SUCCESS) ? PM3_ESOFT : resp.status;
+        }
+
+        if (chunk->done) {
+            PrintAndLogEx(NORMAL, "");
+            if (payload->req.do_auth) {
+                uint8_t kblock = payload->req.use_credit_key ? 4 : 3;
+                memcpy(tag_data + (PICOPASS_BLOCK_SIZE * kblock), chunk->div_key, PICOPASS_BLOCK_SIZE);
+            }
+            return resp.status;
+        }
+
+        if (chunk->count > ICLASS_DUMP_CHUNK_BLOCKS ||
+                ((chunk->start_block + chunk->count) * PICOPASS_BLOCK_SIZE) > tag_data_len ||
+                resp.length < offsetof(iclass_dump_chunk_t, data) + (chunk->count * PICOPASS_BLOCK_SIZE)) {
+            PrintAndLogEx(DEBUG, "unexpected dump reply, block %u", chunk->start_block);
+            continue;
+        }
+
+        for (uint8_t b = 0; b < chunk->count; b++) {
+            if (chunk->readmask & (1 << b)) {
+                memcpy(tag_data + ((chunk->start_block + b) * PICOPASS_BLOCK_SIZE), chunk->data + (b * PICOPASS_BLOCK_SIZE), PICOPASS_BLOCK_SIZE);
+                *last_block = chunk->start_block + b;
+                (*blocks_read)++;
+            }
+        }
+        PrintAndLogEx(INPLACE, "Block... " _YELLOW_("%3u") " ( %u / %u blocks )", chunk->start_block + chunk->count - 1, *blocks_read, total);
+    }
+}
+
 static int CmdHFiClassDump(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf iclass dump",
@@ -2118,68 +2470,27 @@ static int CmdHFiClassDump(const char *Cmd) {
         payload.start_block = 5;
     }
 
-    clearCommandBuffer();
-    SendCommandNG(CMD_HF_ICLASS_DUMP, (uint8_t *)&payload, sizeof(payload));
-
-    while (true) {
-
-        PrintAndLogEx(NORMAL, "." NOLF);
-        if (kbd_enter_pressed()) {
-            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
-            DropField();
-            return PM3_EOPABORTED;
-        }
-
-        if (WaitForResponseTimeout(CMD_HF_ICLASS_DUMP, &resp, 2000)) {
-            break;
-        }
-    }
+    // header and keys are there, the blocks after the last one read are cut off
+    uint16_t last_block = payload.start_block - 1;
+    uint16_t blocks_read = 0;
 
-    PrintAndLogEx(NORMAL, "");
-    if (resp.status != PM3_SUCCESS) {
+    int res = iclass_dump_stream(&payload, tag_data, sizeof(tag_data), &blocks_read, &last_block);
+    if (blocks_read == 0) {
         PrintAndLogEx(ERR, "failed to communicate with card");
-        return resp.status;
-    }
-
-    struct p_resp {
-        bool isOK;
-        uint16_t block_cnt;
-        uint32_t bb_offset;
-    } PACKED;
-    struct p_resp *packet = (struct p_resp *)resp.data.asBytes;
-
-    if (packet->isOK == false) {
-        PrintAndLogEx(WARNING, "read AA1 blocks failed");
-        return PM3_ESOFT;
-    }
-
-    uint32_t startindex = packet->bb_offset;
-    uint32_t blocks_read = packet->block_cnt;
-
-    uint8_t tempbuf[0x100 * 8];
-
-    // response ok - now get bigbuf content of the dump
-    if (GetFromDevice(BIG_BUF, tempbuf, sizeof(tempbuf), startindex, NULL, 0, NULL, 2500, false) == false) {
-        PrintAndLogEx(WARNING, "command execution time out");
-        return PM3_ETIMEOUT;
+        return (res == PM3_SUCCESS) ? PM3_ESOFT : res;
     }
 
-    if (pagemap != PICOPASS_NON_SECURE_PAGEMODE) {
-        // div key KD
-        memcpy(tag_data + (PICOPASS_BLOCK_SIZE * 3),
-               tempbuf + (PICOPASS_BLOCK_SIZE * 3), PICOPASS_BLOCK_SIZE);
+    bool partial = (res != PM3_SUCCESS);
+    if (partial) {
+        PrintAndLogEx(WARNING, "read AA1 blocks failed, " _YELLOW_("%u") " of %u blocks read", blocks_read, payload.end_block - payload.start_block + 1);
     }
-    // all memory available
-    memcpy(tag_data + (PICOPASS_BLOCK_SIZE * payload.start_block),
-           tempbuf + (PICOPASS_BLOCK_SIZE * payload.start_block),
-           blocks_read * PICOPASS_BLOCK_SIZE);
 
-    uint16_t bytes_got = (app_limit1 + 1) * 8;
+    uint16_t bytes_got = (last_block + 1) * 8;
 
     // try AA2 Kc, Credit
     bool aa2_success = false;
 
-    if (have_credit_key && pagemap != PICOPASS_NON_SECURE_PAGEMODE && app_limit2 != 0) {
+    if (partial == false && have_credit_key && pagemap != PICOPASS_NON_SECURE_PAGEMODE && app_limit2 != 0) {
 
         // AA2 authenticate credit key
         memcpy(payload.req.key, credit_key, 8);
@@ -2189,55 +2500,18 @@ static int CmdHFiClassDump(const char *Cmd) {
         payload.end_block = app_limit2;
         payload.req.do_auth = true;
 
-        clearCommandBuffer();
-        SendCommandNG(CMD_HF_ICLASS_DUMP, (uint8_t *)&payload, sizeof(payload));
-
-        while (true) {
-            PrintAndLogEx(NORMAL, "." NOLF);
-            if (kbd_enter_pressed()) {
-                PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
-                DropField();
-                return PM3_EOPABORTED;
-            }
-
-            if (WaitForResponseTimeout(CMD_HF_ICLASS_DUMP, &resp, 2000))
-                break;
-        }
-        PrintAndLogEx(NORMAL, "");
-        if (resp.status != PM3_SUCCESS) {
-            PrintAndLogEx(ERR, "failed to communicate with card");
-            goto write_dump;
-        }
-
-        packet = (struct p_resp *)resp.data.asBytes;
-        if (packet->isOK == false) {
+        res = iclass_dump_stream(&payload, tag_data, sizeof(tag_data), &blocks_read, &last_block);
+        if (blocks_read == 0) {
             PrintAndLogEx(WARNING, "failed read block using credit key");
             goto write_dump;
         }
 
-        blocks_read = packet->block_cnt;
-        startindex = packet->bb_offset;
-
-        if (blocks_read * 8 > sizeof(tag_data) - bytes_got) {
-            PrintAndLogEx(WARNING, "data exceeded buffer size! ");
-            blocks_read = (sizeof(tag_data) - bytes_got) / 8;
-        }
-
-        // get dumped data from bigbuf
-        if (GetFromDevice(BIG_BUF, tempbuf, sizeof(tempbuf), startindex, NULL, 0, NULL, 2500, false) == false) {
-            PrintAndLogEx(WARNING, "command execution time out");
-            goto write_dump;
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "read AA2 blocks failed, " _YELLOW_("%u") " of %u blocks read", blocks_read, payload.end_block - payload.start_block + 1);
+            partial = true;
         }
 
-        // div key KC
-        memcpy(tag_data + (PICOPASS_BLOCK_SIZE * 4), tempbuf + (PICOPASS_BLOCK_SIZE * 4), PICOPASS_BLOCK_SIZE);
-
-        // AA2 data
-        memcpy(tag_data + (PICOPASS_BLOCK_SIZE * payload.start_block),
-               tempbuf + (PICOPASS_BLOCK_SIZE * payload.start_block),
-               blocks_read * PICOPASS_BLOCK_SIZE);
-
-        bytes_got += (blocks_read * PICOPASS_BLOCK_SIZE);
+        bytes_got = (last_block + 1) * 8;
 
         aa2_success = true;
     }
@@ -2248,6 +2522,10 @@ write_dump:
         PrintAndLogEx(INFO, "Reading AA2 failed. dumping AA1 data to file");
     }
 
+    if (partial) {
+        PrintAndLogEx(WARNING, "partial dump, unread blocks are " _YELLOW_("FF") " and the dump ends at block %u", last_block);
+    }
+
     // print the dump
     printIclassDumpContents(tag_data, 1, (bytes_got / 8), bytes_got, dense_output);
 
@@ -3546,13 +3824,15 @@ static int CmdHFiClass_loclass(const char *Cmd) {
                   "  <8 byte CSN><8 byte CC><4 byte NR><4 byte MAC>\n"
                   "   ... totalling N*24 bytes",
                   "hf iclass loclass -f iclass_dump.bin\n"
-                  "hf iclass loclass --test");
+                  "hf iclass loclass --test\n"
+                  "hf iclass loclass --bench");
 
     void *argtable[] = {
         arg_param_begin,
         arg_str0("f", "file", "<fn>", "filename with nr/mac data from `hf iclass sim -t 2` "),
         arg_lit0(NULL, "test",        "Perform self test"),
         arg_lit0(NULL, "long",        "Perform self test, including long ones"),
+        arg_lit0(NULL, "bench",       "Benchmark the elite keytable search"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -3563,9 +3843,14 @@ static int CmdHFiClass_loclass(const char *Cmd) {
 
     bool test = arg_get_lit(ctx, 2);
     bool longtest = arg_get_lit(ctx, 3);
+    bool bench = arg_get_lit(ctx, 4);
 
     CLIParserFree(ctx);
 
+    if (bench) {
+        return benchElite();
+    }
+
     if (test || longtest) {
         int errors = testCipherUtils();
         errors += testMAC();
@@ -3941,21 +4226,26 @@ static int CmdHFiClassView(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// elite diversification once hash2 (keytable) and hash1 (key_index) are known
+static void iclass_elite_div_key(uint8_t *CSN, const uint8_t *keytable, const uint8_t *key_index, uint8_t *div_key) {
+    uint8_t key_sel[PICOPASS_BLOCK_SIZE] = {0};
+    uint8_t key_sel_p[PICOPASS_BLOCK_SIZE] = {0};
+    for (uint8_t i = 0; i < 8 ; i++) {
+        key_sel[i] = keytable[key_index[i]];
+    }
+
+    //Permute from iclass format to standard format
+    permutekey_rev(key_sel, key_sel_p);
+    diversifyKey(CSN, key_sel_p, div_key);
+}
+
 void HFiClassCalcDivKey(uint8_t *CSN, uint8_t *KEY, uint8_t *div_key, bool elite) {
     if (elite) {
-        uint8_t keytable[128] = {0};
+        uint8_t keytable[ICLASS_ELITE_KEYTABLE_SIZE] = {0};
         uint8_t key_index[PICOPASS_BLOCK_SIZE] = {0};
-        uint8_t key_sel[PICOPASS_BLOCK_SIZE] = {0};
-        uint8_t key_sel_p[PICOPASS_BLOCK_SIZE] = {0};
         hash2(KEY, keytable);
         hash1(CSN, key_index);
-        for (uint8_t i = 0; i < 8 ; i++) {
-            key_sel[i] = keytable[key_index[i]];
-        }
-
-        //Permute from iclass format to standard format
-        permutekey_rev(key_sel, key_sel_p);
-        diversifyKey(CSN, key_sel_p, div_key);
+        iclass_elite_div_key(CSN, keytable, key_index, div_key);
     } else {
         diversifyKey(CSN, KEY, div_key);
     }
@@ -4402,10 +4692,6 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
     if (use_raw)
         PrintAndLogEx(NORMAL, "using " _YELLOW_("raw mode"));
 
-    GenerateMacFrom(CSN, CCNR, use_raw, use_elite, keyBlock, keycount, pre);
-
-    PrintAndLogEx(SUCCESS, "Searching for " _YELLOW_("%s") " key...", (use_credit_key) ? "CREDIT" : "DEBIT");
-
     // USB_COMMAND.  512/4 = 103 mac
     uint32_t max_chunk_size = 0;
     if (keycount > ((PM3_CMD_DATA_SIZE - sizeof(iclass_chk_t)) / 4))
@@ -4413,6 +4699,11 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
     else
         max_chunk_size = keycount;
 
+    // only the first chunk is generated upfront, the next one while the device tests the current one
+    GenerateMacFrom(CSN, CCNR, use_raw, use_elite, keyBlock, max_chunk_size, pre);
+
+    PrintAndLogEx(SUCCESS, "Searching for " _YELLOW_("%s") " key...", (use_credit_key) ? "CREDIT" : "DEBIT");
+
     // fast push mode
     g_conn.block_after_ACK = true;
 
@@ -4455,6 +4746,9 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
         packet->use_credit_key = use_credit_key;
         packet->count = curr_chunk_cnt;
         packet->shallow_mod = shallow_mod;
+        // the card stays selected between the chunks
+        packet->resume = (chunk_offset > 0);
+        packet->keep_field = (chunk_offset + curr_chunk_cnt < keycount);
         // copy chunk of pre calculated macs to packet
         memcpy(packet->items, (pre + chunk_offset), (4 * curr_chunk_cnt));
 
@@ -4462,6 +4756,13 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
         SendCommandNG(CMD_HF_ICLASS_CHKKEYS, (uint8_t *)packet, tmp_plen);
         free(packet);
 
+        // next chunk of macs
+        uint32_t next_offset = chunk_offset + curr_chunk_cnt;
+        if (next_offset < keycount) {
+            uint32_t next_cnt = MIN(keycount - next_offset, max_chunk_size);
+            GenerateMacFrom(CSN, CCNR, use_raw, use_elite, keyBlock + (next_offset * 8), next_cnt, pre + next_offset);
+        }
+
         bool looped = false;
         uint8_t timeout = 0;
 
@@ -4669,50 +4970,58 @@ typedef struct {
 } thread_args_t;
 
 // HF iClass legbrute - Brute-force worker thread
+// The candidates go through the bitsliced MAC in batches of MAC_BS_LANES keys
 static void *brute_thread(void *args_void) {
 
     thread_args_t *args = (thread_args_t *)args_void;
-    uint8_t div_key[8];
-    uint8_t mac[4];
+    uint8_t div_keys[MAC_BS_LANES][8];
     uint8_t verification_mac[4];
     uint64_t index = args->index_start;
 
     while (!*(args->found)) {
 
-        generate_key_block_inverted(args->startingKey, index, div_key);
-        doMAC(args->CCNR1, div_key, mac);
+        for (int i = 0; i < MAC_BS_LANES; i++) {
+            generate_key_block_inverted(args->startingKey, index + i, div_keys[i]);
+        }
+
+        uint64_t hits = doMAC_bs_match(args->CCNR1, div_keys, MAC_BS_LANES, args->MAC_TAG1);
+
+        for (int i = 0; hits; i++, hits >>= 1) {
+            if ((hits & 1) == 0) {
+                continue;
+            }
 
-        if (memcmp(mac, args->MAC_TAG1, 4) == 0) {
-            doMAC(args->CCNR2, div_key, verification_mac);
+            doMAC(args->CCNR2, div_keys[i], verification_mac);
             if (memcmp(verification_mac, args->MAC_TAG2, 4) == 0) {
                 pthread_mutex_lock(args->log_lock);
                 if (!*(args->found)) {
                     *args->found = true;
                     PrintAndLogEx(NORMAL, "\n");
-                    PrintAndLogEx(SUCCESS, "Found valid raw key " _GREEN_("%s"), sprint_hex_inrow(div_key, 8));
-                    PrintAndLogEx(HINT, "Hint: Run `"_YELLOW_("hf iclass unhash -k %s")"` to find the needed pre-images", sprint_hex_inrow(div_key, 8));
+                    PrintAndLogEx(SUCCESS, "Found valid raw key " _GREEN_("%s"), sprint_hex_inrow(div_keys[i], 8));
+                    PrintAndLogEx(HINT, "Hint: Run `"_YELLOW_("hf iclass unhash -k %s")"` to find the needed pre-images", sprint_hex_inrow(div_keys[i], 8));
                     PrintAndLogEx(INFO, "Done!");
                     PrintAndLogEx(NORMAL, "");
                 }
                 pthread_mutex_unlock(args->log_lock);
-                break;
+                return NULL;
             }
         }
 
-        if (index % 1000000 == 0 && !*(args->found)) {
+        // a million boundary in this batch
+        if (((index + MAC_BS_LANES) / 1000000) != (index / 1000000) && !*(args->found)) {
 
             if (args->thread_id == 0) {
                 pthread_mutex_lock(args->log_lock);
                 PrintAndLogEx(INPLACE, "Tested "_YELLOW_("%" PRIu64)" million keys, curr index: "_YELLOW_("%" PRIu64)", Thread[0]: %s"
-                              , ((index / 1000000) * args->thread_count)
-                              , (index / 1000000)
-                              , sprint_hex_inrow(div_key, 8)
+                              , (((index + MAC_BS_LANES) / 1000000) * args->thread_count)
+                              , ((index + MAC_BS_LANES) / 1000000)
+                              , sprint_hex_inrow(div_keys[MAC_BS_LANES - 1], 8)
                              );
                 pthread_mutex_unlock(args->log_lock);
             }
 
         }
-        index++;
+        index += MAC_BS_LANES;
     }
     return NULL;
 }
@@ -4776,7 +5085,8 @@ static int CmdHFiClassLegBrute(const char *Cmd) {
     CLIParserInit(&ctx, "hf iclass legbrute",
                   "This command takes sniffed trace data and a partial raw key and bruteforces the remaining 40 bits of the raw key.\n"
                   "Complete 40 bit keyspace is 1'099'511'627'776 and command is locked down to max 16 threads currently.\n"
-                  "A possible worst case scenario on 16 threads estimates XXX days YYY hours MMM minutes.",
+                  "A possible worst case scenario on 16 threads estimates XXX days YYY hours MMM minutes.\n"
+                  "For GPUs, see `tools/iclass_legbrute_opencl` which tests the same indexes.",
                   "hf iclass legbrute --epurse feffffffffffffff --macs1 1306cad9b6c24466 --macs2 f0bf905e35f97923 --pk B4F12AADC5301225");
 
     void *argtable[] = {
@@ -5033,47 +5343,166 @@ static int CmdHFiClassLegacyRecover(const char *Cmd) {
 
 }
 
-static int CmdHFiClassUnhash(const char *Cmd) {
-
-    CLIParserContext *ctx;
-    CLIParserInit(&ctx, "hf iclass unhash",
-                  "Reverses the hash0 function used generate iclass diversified keys after DES encryption,\n"
-                  "Function returns the DES crypted CSN.  Next step bruteforcing.",
-                  "hf iclass unhash -k B4F12AADC5301A2D"
-                 );
+// a hash0 output has four odd and four even bytes, otherwise the key might be AES based
+static bool iclass_divkey_is_hash0(const uint8_t *div_key) {
+    int count_lsb1 = 0;
+    for (int i = 0; i < PICOPASS_BLOCK_SIZE; i++) {
+        count_lsb1 += (div_key[i] & 0x01);
+    }
+    return (count_lsb1 == 4);
+}
 
-    void *argtable[] = {
-        arg_param_begin,
-        arg_str1("k", "divkey", "<hex>", "Card diversified key"),
-        arg_param_end
-    };
-    CLIExecWithReturn(ctx, Cmd, argtable, false);
+typedef struct {
+    size_t thread_idx;
+    const uint8_t *keys;
+    uint32_t keycnt;
+    uint64_t *preimages;    // HASH0_MAX_PREIMAGES per key
+    int *counts;            // -1 when the key is no hash0 output
+} iclass_unhash_arg_t;
 
-    int dk_len = 0;
-    uint8_t div_key[PICOPASS_BLOCK_SIZE] = {0};
-    CLIGetHexWithReturn(ctx, 1, div_key, &dk_len);
+static size_t iclass_unhash_tc = 1;
 
-    CLIParserFree(ctx);
+static void *bf_unhash(void *thread_arg) {
+    iclass_unhash_arg_t *targ = (iclass_unhash_arg_t *)thread_arg;
 
-    if (dk_len && dk_len != PICOPASS_BLOCK_SIZE) {
-        PrintAndLogEx(ERR, "Diversified key is incorrect length");
-        return PM3_EINVARG;
+    for (uint32_t i = targ->thread_idx; i < targ->keycnt; i += iclass_unhash_tc) {
+        const uint8_t *div_key = targ->keys + ((size_t)i * PICOPASS_BLOCK_SIZE);
+        if (iclass_divkey_is_hash0(div_key) == false) {
+            targ->counts[i] = -1;
+            continue;
+        }
+        targ->counts[i] = invert_hash0_ex(div_key, targ->preimages + ((size_t)i * HASH0_MAX_PREIMAGES), HASH0_MAX_PREIMAGES);
     }
+    return NULL;
+}
 
-    //check if divkey respects hash0 rules (legacy format) or if it could be AES Based
+// every key of a dictionary file, on all cores
+static int iclass_unhash_file(const char *filename) {
+    uint8_t *keys = NULL;
+    uint32_t keycnt = 0;
+    int res = loadFileDICTIONARY_safe(filename, (void **)&keys, PICOPASS_BLOCK_SIZE, &keycnt);
+    if (res != PM3_SUCCESS || keycnt == 0) {
+        free(keys);
+        return (res == PM3_SUCCESS) ? PM3_EFILE : res;
+    }
 
-    int count_lsb0 = 0;
-    int count_lsb1 = 0;
+    uint64_t *preimages = calloc((size_t)keycnt * HASH0_MAX_PREIMAGES, sizeof(uint64_t));
+    int *counts = calloc(keycnt, sizeof(int));
+    if (preimages == NULL || counts == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(preimages);
+        free(counts);
+        free(keys);
+        return PM3_EMALLOC;
+    }
 
-    for (int i = 0; i < PICOPASS_BLOCK_SIZE; i++) {
-        if ((div_key[i] & 0x01) == 0) {
-            count_lsb0++;
-        } else {
-            count_lsb1++;
+    uint64_t t1 = msclock();
+
+    iclass_unhash_tc = num_CPUs();
+    pthread_t threads[iclass_unhash_tc];
+    iclass_unhash_arg_t args[iclass_unhash_tc];
+    for (size_t i = 0; i < iclass_unhash_tc; i++) {
+        args[i].thread_idx = i;
+        args[i].keys = keys;
+        args[i].keycnt = keycnt;
+        args[i].preimages = preimages;
+        args[i].counts = counts;
+        if (pthread_create(&threads[i], NULL, bf_unhash, (void *)&args[i])) {
+            PrintAndLogEx(WARNING, "Failed to create pthreads. Quitting");
+            for (size_t j = 0; j < i; j++) {
+                pthread_join(threads[j], NULL);
+            }
+            free(preimages);
+            free(counts);
+            free(keys);
+            return PM3_ESOFT;
         }
     }
+    for (size_t i = 0; i < iclass_unhash_tc; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    t1 = msclock() - t1;
+
+    uint32_t skipped = 0;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < keycnt; i++) {
+        const uint8_t *div_key = keys + ((size_t)i * PICOPASS_BLOCK_SIZE);
+        char dk_str[(PICOPASS_BLOCK_SIZE * 2) + 1] = {0};
+        hex_to_buffer((uint8_t *)dk_str, div_key, PICOPASS_BLOCK_SIZE, sizeof(dk_str) - 1, 0, 0, true);
+
+        if (counts[i] < 0) {
+            PrintAndLogEx(INFO, "%s ( " _RED_("not hash0, AES based?") " )", dk_str);
+            skipped++;
+            continue;
+        }
+
+        total += counts[i];
+        for (int j = 0; j < MIN(counts[i], HASH0_MAX_PREIMAGES); j++) {
+            uint8_t des_pre_image[8] = {0};
+            x_num_to_bytes(preimages[((size_t)i * HASH0_MAX_PREIMAGES) + j], sizeof(uint64_t), des_pre_image);
+            PrintAndLogEx(SUCCESS, "%s  pre-image " _YELLOW_("%s"), dk_str, sprint_hex_inrow(des_pre_image, sizeof(des_pre_image)));
+        }
+        if (counts[i] > HASH0_MAX_PREIMAGES) {
+            PrintAndLogEx(INFO, "%s  %d more pre-images, try `" _YELLOW_("hf iclass unhash -k %s") "`", dk_str, counts[i] - HASH0_MAX_PREIMAGES, dk_str);
+        }
+    }
+
+    PrintAndLogEx(INFO, "-----------------------------------");
+    PrintAndLogEx(SUCCESS, "Unhashed " _YELLOW_("%u") " keys, " _YELLOW_("%" PRIu64) " pre-images, %u skipped, %zu threads, " _YELLOW_("%.3f") " seconds"
+                  , keycnt - skipped, total, skipped, iclass_unhash_tc, (float)t1 / 1000.0);
+
+    free(preimages);
+    free(counts);
+    free(keys);
+    return PM3_SUCCESS;
+}
+
+static int CmdHFiClassUnhash(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf iclass unhash",
+                  "Reverses the hash0 function used generate iclass diversified keys after DES encryption,\n"
+                  "Function returns the DES crypted CSN.  Next step bruteforcing.\n"
+                  "A dictionary file of diversified keys is processed on all cores.",
+                  "hf iclass unhash -k B4F12AADC5301A2D\n"
+                  "hf iclass unhash -f divkeys.dic"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("k", "divkey", "<hex>", "Card diversified key"),
+        arg_str0("f", "file", "<fn>", "Dictionary file with diversified keys"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int dk_len = 0;
+    uint8_t div_key[PICOPASS_BLOCK_SIZE] = {0};
+    CLIGetHexWithReturn(ctx, 1, div_key, &dk_len);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    CLIParserFree(ctx);
+
+    if ((dk_len == 0) == (fnlen == 0)) {
+        PrintAndLogEx(ERR, "Specify either a diversified key or a file");
+        return PM3_EINVARG;
+    }
 
-    if (count_lsb0 != 4 || count_lsb1 != 4) {
+    if (fnlen) {
+        return iclass_unhash_file(filename);
+    }
+
+    if (dk_len && dk_len != PICOPASS_BLOCK_SIZE) {
+        PrintAndLogEx(ERR, "Diversified key is incorrect length");
+        return PM3_EINVARG;
+    }
+
+    //check if divkey respects hash0 rules (legacy format) or if it could be AES Based
+    if (iclass_divkey_is_hash0(div_key) == false) {
         PrintAndLogEx(INFO, _RED_("Incorrect LSB Distribution, unable to unhash - the key might be AES based."));
         return PM3_SUCCESS;
     }
@@ -5090,6 +5519,180 @@ static int CmdHFiClassUnhash(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+// Cache of the elite keytables (hash2) of a dictionary, in the user directory.
+// hash2 only depends on the key, with the keytables at hand a lookup is left
+// with hash1, one DES, hash0 and the MAC per key. One file per dictionary
+// content, mmap'ed read-only on later runs. The keys follow the header, then
+// their keytables, both in dictionary order.
+//----------------------------------------------------------------------------
+#define ICLASS_ELITE_CACHE_TEMPLATE     "iclass_elite_%08x.cache"
+#define ICLASS_ELITE_CACHE_MAGIC        "PM3ICEL"
+#define ICLASS_ELITE_CACHE_VERSION      1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t keys_sig;
+    uint32_t keycnt;
+    uint32_t pad;
+} PACKED iclass_elite_cache_hdr_t;
+
+#define ICLASS_ELITE_CACHE_LEN(n)       (sizeof(iclass_elite_cache_hdr_t) + (size_t)(n) * (PICOPASS_BLOCK_SIZE + ICLASS_ELITE_KEYTABLE_SIZE))
+
+// FNV-1a over the key list
+static uint32_t iclass_keys_signature(const uint8_t *keys, uint32_t keycnt) {
+    uint32_t sig = 0x811C9DC5;
+    for (size_t i = 0; i < (size_t)keycnt * PICOPASS_BLOCK_SIZE; i++) {
+        sig = (sig ^ keys[i]) * 0x01000193;
+    }
+    return sig;
+}
+
+#if !defined(_WIN32)
+// no cache in incognito mode
+static bool iclass_elite_cache_path(char *path, size_t len, uint32_t sig) {
+    const char *user_path = get_my_user_directory();
+    if (user_path == NULL || g_session.incognito) {
+        return false;
+    }
+    char fn[32];
+    snprintf(fn, sizeof(fn), ICLASS_ELITE_CACHE_TEMPLATE, sig);
+    int n = snprintf(path, len, "%s%s%s", user_path, PM3_USER_DIRECTORY, fn);
+    return (n > 0 && (size_t)n < len);
+}
+
+// returns the mapping, NULL when missing or built from other keys
+static void *iclass_elite_cache_load(const uint8_t *keys, uint32_t keycnt, uint32_t sig) {
+    char path[FILE_PATH_SIZE];
+    if (iclass_elite_cache_path(path, sizeof(path), sig) == false) {
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != ICLASS_ELITE_CACHE_LEN(keycnt)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, ICLASS_ELITE_CACHE_LEN(keycnt), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    const iclass_elite_cache_hdr_t *hdr = (const iclass_elite_cache_hdr_t *)map;
+    if (memcmp(hdr->magic, ICLASS_ELITE_CACHE_MAGIC, sizeof(ICLASS_ELITE_CACHE_MAGIC)) != 0
+            || hdr->version != ICLASS_ELITE_CACHE_VERSION
+            || hdr->keys_sig != sig
+            || hdr->keycnt != keycnt
+            || memcmp((const uint8_t *)map + sizeof(iclass_elite_cache_hdr_t), keys, (size_t)keycnt * PICOPASS_BLOCK_SIZE) != 0) {
+        PrintAndLogEx(DEBUG, "Elite keytable cache " _YELLOW_("%s") " is stale, rebuilding", path);
+        munmap(map, ICLASS_ELITE_CACHE_LEN(keycnt));
+        return NULL;
+    }
+    PrintAndLogEx(DEBUG, "Elite keytables mapped from " _YELLOW_("%s"), path);
+    return map;
+}
+
+// written to a temp file first and renamed, concurrent clients never see a partial cache
+static void iclass_elite_cache_save(const uint8_t *keys, const uint8_t *keytables, uint32_t keycnt, uint32_t sig) {
+    char path[FILE_PATH_SIZE];
+    if (iclass_elite_cache_path(path, sizeof(path), sig) == false) {
+        return;
+    }
+
+    iclass_elite_cache_hdr_t hdr = {0};
+    memcpy(hdr.magic, ICLASS_ELITE_CACHE_MAGIC, sizeof(ICLASS_ELITE_CACHE_MAGIC));
+    hdr.version = ICLASS_ELITE_CACHE_VERSION;
+    hdr.keys_sig = sig;
+    hdr.keycnt = keycnt;
+
+    char tmp[FILE_PATH_SIZE + 16];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        return;
+    }
+
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1);
+    ok = ok && (fwrite(keys, PICOPASS_BLOCK_SIZE, keycnt, f) == keycnt);
+    ok = ok && (fwrite(keytables, ICLASS_ELITE_KEYTABLE_SIZE, keycnt, f) == keycnt);
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok == false || rename(tmp, path) != 0) {
+        PrintAndLogEx(DEBUG, "Could not write elite keytable cache " _YELLOW_("%s"), path);
+        remove(tmp);
+        return;
+    }
+    PrintAndLogEx(DEBUG, "Elite keytable cache saved to " _YELLOW_("%s"), path);
+}
+
+static void iclass_elite_cache_unmap(void *map, uint32_t keycnt) {
+    munmap(map, ICLASS_ELITE_CACHE_LEN(keycnt));
+}
+#else
+// no mmap, keytables are computed on every lookup
+static void *iclass_elite_cache_load(const uint8_t *keys, uint32_t keycnt, uint32_t sig) {
+    (void)keys;
+    (void)keycnt;
+    (void)sig;
+    return NULL;
+}
+static void iclass_elite_cache_save(const uint8_t *keys, const uint8_t *keytables, uint32_t keycnt, uint32_t sig) {
+    (void)keys;
+    (void)keytables;
+    (void)keycnt;
+    (void)sig;
+}
+static void iclass_elite_cache_unmap(void *map, uint32_t keycnt) {
+    (void)map;
+    (void)keycnt;
+}
+#endif
+
+// hash2 of every key, from the cache when possible. *map is set when the tables are mapped,
+// otherwise the returned buffer is on the heap. Release with iclass_elite_keytables_free()
+static const uint8_t *iclass_elite_keytables(const uint8_t *keys, uint32_t keycnt, void **map) {
+    uint32_t sig = iclass_keys_signature(keys, keycnt);
+
+    *map = iclass_elite_cache_load(keys, keycnt, sig);
+    if (*map != NULL) {
+        PrintAndLogEx(INFO, "Using cached elite keytables");
+        return (const uint8_t *)*map + sizeof(iclass_elite_cache_hdr_t) + (size_t)keycnt * PICOPASS_BLOCK_SIZE;
+    }
+
+    uint8_t *keytables = calloc(keycnt, ICLASS_ELITE_KEYTABLE_SIZE);
+    if (keytables == NULL) {
+        return NULL;
+    }
+
+    PrintAndLogEx(INFO, "Generating elite keytables...");
+    for (uint32_t i = 0; i < keycnt; i++) {
+        uint8_t key[PICOPASS_BLOCK_SIZE];
+        memcpy(key, keys + ((size_t)i * PICOPASS_BLOCK_SIZE), sizeof(key));
+        hash2(key, keytables + ((size_t)i * ICLASS_ELITE_KEYTABLE_SIZE));
+    }
+
+    iclass_elite_cache_save(keys, keytables, keycnt, sig);
+    return keytables;
+}
+
+static void iclass_elite_keytables_free(const uint8_t *keytables, void *map, uint32_t keycnt) {
+    if (map != NULL) {
+        iclass_elite_cache_unmap(map, keycnt);
+    } else {
+        free((void *)keytables);
+    }
+}
+
+static void generate_mackey(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, const uint8_t *keytables, uint32_t keycnt, iclass_prekey_t *list);
+
 static int CmdHFiClassLookUp(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf iclass lookup",
@@ -5205,8 +5808,16 @@ static int CmdHFiClassLookUp(const char *Cmd) {
         return PM3_EMALLOC;
     }
 
+    // the key only part of the elite diversification is cached per dictionary
+    const uint8_t *keytables = NULL;
+    void *keytables_map = NULL;
+    if (use_elite && use_raw == false) {
+        keytables = iclass_elite_keytables(keyBlock, keycount, &keytables_map);
+    }
+
     PrintAndLogEx(INFO, "Generating diversified keys...");
-    GenerateMacKeyFrom(csn, CCNR, use_raw, use_elite, keyBlock, keycount, prekey);
+    generate_mackey(csn, CCNR, use_raw, use_elite, keyBlock, keytables, keycount, prekey);
+    iclass_elite_keytables_free(keytables, keytables_map, keycount);
 
     if (use_elite) {
         PrintAndLogEx(INFO, "Using " _YELLOW_("elite algo"));
@@ -5251,6 +5862,7 @@ typedef struct {
     uint8_t csn[PICOPASS_BLOCK_SIZE];
     uint8_t cc_nr[12];
     uint8_t *keys;
+    const uint8_t *keytables;   // elite hash2 of every key, or NULL
     union {
         iclass_premac_t *premac;
         iclass_prekey_t *prekey;
@@ -5311,6 +5923,7 @@ void GenerateMacFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite,
         args[i].use_elite = use_elite;
         args[i].keycnt = keycnt;
         args[i].keys = keys;
+        args[i].keytables = NULL;
         args[i].list.premac = list;
 
         memcpy(args[i].csn, CSN, sizeof(args[i].csn));
@@ -5340,6 +5953,7 @@ static void *bf_generate_mackey(void *thread_arg) {
     const uint32_t keycnt = targ->keycnt;
 
     uint8_t *keys = targ->keys;
+    const uint8_t *keytables = targ->keytables;
     iclass_prekey_t *list = targ->list.prekey;
 
     uint8_t csn[PICOPASS_BLOCK_SIZE];
@@ -5349,6 +5963,19 @@ static void *bf_generate_mackey(void *thread_arg) {
 
     uint8_t div_key[PICOPASS_BLOCK_SIZE] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
+    // with the keytables at hand only the card dependent part is left, and that part needs no lock
+    if (use_elite && keytables != NULL) {
+        uint8_t key_index[PICOPASS_BLOCK_SIZE] = {0};
+        hash1(csn, key_index);
+
+        for (uint32_t i = idx; i < keycnt; i += iclass_tc) {
+            memcpy(list[i].key, keys + 8 * i, PICOPASS_BLOCK_SIZE);
+            iclass_elite_div_key(csn, keytables + ((size_t)i * ICLASS_ELITE_KEYTABLE_SIZE), key_index, div_key);
+            doMAC(cc_nr, div_key, list[i].mac);
+        }
+        return NULL;
+    }
+
     for (uint32_t i = idx; i < keycnt; i += iclass_tc) {
 
         memcpy(list[i].key, keys + 8 * i, PICOPASS_BLOCK_SIZE);
@@ -5366,7 +5993,7 @@ static void *bf_generate_mackey(void *thread_arg) {
     return NULL;
 }
 
-void GenerateMacKeyFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, iclass_prekey_t *list) {
+static void generate_mackey(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, const uint8_t *keytables, uint32_t keycnt, iclass_prekey_t *list) {
 
     pthread_mutex_init(&generator_mutex, NULL);
     iclass_tc = num_CPUs();
@@ -5379,6 +6006,7 @@ void GenerateMacKeyFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elit
         args[i].use_elite = use_elite;
         args[i].keycnt = keycnt;
         args[i].keys = keys;
+        args[i].keytables = keytables;
         args[i].list.prekey = list;
 
         memcpy(args[i].csn, CSN, sizeof(args[i].csn));
@@ -5399,6 +6027,10 @@ void GenerateMacKeyFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elit
     }
 }
 
+void GenerateMacKeyFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, iclass_prekey_t *list) {
+    generate_mackey(CSN, CCNR, use_raw, use_elite, keys, NULL, keycnt, list);
+}
+
 // print diversified keys
 void PrintPreCalcMac(uint8_t *keys, uint32_t keycnt, iclass_premac_t *pre_list) {
 
@@ -5915,6 +6547,126 @@ static bool match_with_wildcard(const uint8_t *data, const uint8_t *pattern, con
     return true;
 }
 
+// Prints the PACS, Nr-MAC or SAM error of a SAM answer
+static int iclass_sam_print(const uint8_t *d, uint16_t len, bool verbose, bool break_nrmac, bool decodeTLV) {
+    bool is_snmp = false;
+    uint8_t snmp_pattern[] = {0xBD, 0x81, 0xFF, 0x8A, 0x81, 0xFF}; // SNMP Response header pattern, 0xFF is a wildcard value for message length
+    bool snmp_mask[] = {true, true, false, true, true, false}; // false means wildcard value in that position
+    uint8_t ok_pattern[] = {0xBD, 0xFF, 0x8A}; // Ok response header pattern, 0xFF is a wildcard value for message length
+    bool ok_mask[] = {true, false, true}; // false means wildcard value in that position
+
+    // check for standard SamCommandGetContentElement response
+    // bd 09
+    //    8a 07
+    //       03 05 <- tag + length
+    //          06 85 80 6d c0 <- decoded PACS data
+    if (d[0] == 0xbd && d[2] == 0x8a && d[4] == 0x03) {
+        uint8_t pacs_length = d[5];
+        const uint8_t *pacs_data = d + 6;
+        int res = HIDDumpPACSBits(pacs_data, pacs_length, verbose);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        // check for standard samCommandGetContentElement2:
+        // bd 1e
+        //    b3 1c
+        //       a0 1a
+        //          80 05
+        //             06 85 80 6d c0
+        //          81 0e
+        //             2b 06 01 04 01 81 e4 38 01 01 02 04 3c ff
+        //          82 01
+        //             07
+    } else if (d[0] == 0xbd && d[2] == 0xb3 && d[4] == 0xa0) {
+        const uint8_t *pacs = d + 6;
+        const uint8_t pacs_length = pacs[1];
+        const uint8_t *pacs_data = pacs + 2;
+        int res = HIDDumpPACSBits(pacs_data, pacs_length, verbose);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+
+        const uint8_t *oid = pacs + 2 + pacs_length;
+        const uint8_t oid_length = oid[1];
+        const uint8_t *oid_data = oid + 2;
+        PrintAndLogEx(SUCCESS, "SIO OID.......... " _GREEN_("%s"), sprint_hex_inrow(oid_data, oid_length));
+
+        const uint8_t *mediaType = oid + 2 + oid_length;
+        const uint8_t mediaType_data = mediaType[2];
+        PrintAndLogEx(SUCCESS, "SIO Media Type... " _GREEN_("%s"), getSioMediaTypeInfo(mediaType_data));
+    } else if (break_nrmac && d[0] == 0x05) {
+        PrintAndLogEx(SUCCESS, "Nr-MAC........... " _GREEN_("%s"), sprint_hex_inrow(d + 1, 8));
+        if (verbose) {
+            PrintAndLogEx(INFO, "Replay Nr-MAC to dump SIO:");
+            PrintAndLogEx(SUCCESS, "    hf iclass dump --nr -k %s", sprint_hex_inrow(d + 1, 8));
+        }
+    } else {
+        //if it is an error decode it
+        if (memcmp(d, "\xBE\x07\x80\x01", 4) == 0) { //if it the string is 0xbe 0x07 0x80 0x01 the next byte will indicate the error code
+            PrintAndLogEx(ERR, _RED_("Sam Error Code: %02x"), d[4]);
+            print_hex(d, len);
+        } else if (match_with_wildcard(d, snmp_pattern, snmp_mask, 6)) {
+            is_snmp = true;
+            PrintAndLogEx(SUCCESS, _YELLOW_("[samSNMPMessageResponse] ")"%s", sprint_hex(d + 6, len - 6));
+        } else if (match_with_wildcard(d, ok_pattern, ok_mask, 3)) {
+            PrintAndLogEx(SUCCESS, _YELLOW_("[samResponseAcknowledge] ")"%s", sprint_hex(d + 4, len - 4));
+        } else {
+            print_hex(d, len);
+        }
+    }
+
+    if (decodeTLV && is_snmp == false) {
+        asn1_print((uint8_t *)d, d[1] + 2, " ");
+    } else if (decodeTLV && is_snmp) {
+        asn1_print((uint8_t *)d + 6, len - 6, "  ");
+    }
+
+    return PM3_SUCCESS;
+}
+
+// Continuous reader mode, the device streams one reply per card until aborted
+static int iclass_sam_loop(uint8_t *data, uint16_t datalen, bool verbose, bool break_nrmac, bool decodeTLV) {
+    PrintAndLogEx(INFO, "Present cards to the reader, press " _GREEN_("<Enter>") " to exit");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_SAM_PICOPASS, data, datalen);
+
+    uint32_t cards = 0;
+    bool aborted = false;
+    uint64_t t1 = msclock();
+    for (;;) {
+        if (aborted == false && kbd_enter_pressed()) {
+            aborted = true;
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+        }
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_SAM_PICOPASS, &resp, aborted ? 2000 : 500) == false) {
+            if (aborted) {
+                PrintAndLogEx(WARNING, "timeout while waiting for reply");
+                break;
+            }
+            continue;
+        }
+
+        if (resp.status == PM3_EOPABORTED) {
+            break;
+        }
+
+        cards++;
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "--- " _CYAN_("Card %u") " ---------- %.1f s", cards, (float)(msclock() - t1) / 1000.0);
+        if (resp.status == PM3_SUCCESS) {
+            iclass_sam_print(resp.data.asBytes, resp.length, verbose, break_nrmac, decodeTLV);
+        } else {
+            PrintAndLogEx(SUCCESS, "No PACS data found. Card empty?");
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "Done, " _YELLOW_("%u") " cards read", cards);
+    return PM3_SUCCESS;
+}
+
 static int CmdHFiClassSAM(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf iclass sam",
@@ -5922,6 +6674,7 @@ static int CmdHFiClassSAM(const char *Cmd) {
                   "hf iclass sam\n"
                   "hf iclass sam -p -d a005a103800104  -> get PACS data, prevent epurse update\n"
                   "hf iclass sam --break               -> get Nr-MAC for extracting encrypted SIO\n"
+                  "hf iclass sam --loop                -> read every card presented until <Enter>\n"
                  );
 
     void *argtable[] = {
@@ -5936,6 +6689,7 @@ static int CmdHFiClassSAM(const char *Cmd) {
         arg_strx0("d", "data", "<hex>", "DER encoded command to send to SAM"),
         arg_lit0("s", "snmp",  "data is in snmp format without headers"),
         arg_lit0(NULL, "info",  "get SAM infos (version, serial number)"),
+        arg_lit0(NULL, "loop",  "continuous reader mode, stream the PACS of each card presented"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -5949,6 +6703,7 @@ static int CmdHFiClassSAM(const char *Cmd) {
     bool shallow_mod = arg_get_lit(ctx, 7);
     bool snmp_data = arg_get_lit(ctx, 9);
     bool info = arg_get_lit(ctx, 10);
+    bool loop = arg_get_lit(ctx, 11);
 
     uint8_t flags = 0;
     if (disconnect_after) {
@@ -5975,6 +6730,10 @@ static int CmdHFiClassSAM(const char *Cmd) {
         flags |= BITMASK(5);
     }
 
+    if (loop) {
+        flags |= BITMASK(6);
+    }
+
     uint8_t data[PM3_CMD_DATA_SIZE] = {0};
     data[0] = flags;
 
@@ -5998,17 +6757,15 @@ static int CmdHFiClassSAM(const char *Cmd) {
         cmdlen += 4;
     }
 
+    if (loop) {
+        return iclass_sam_loop(data, cmdlen + 1, verbose, break_nrmac, decodeTLV);
+    }
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_SAM_PICOPASS, data, cmdlen + 1);
     PacketResponseNG resp;
     WaitForResponse(CMD_HF_SAM_PICOPASS, &resp);
 
-    bool is_snmp = false;
-    uint8_t snmp_pattern[] = {0xBD, 0x81, 0xFF, 0x8A, 0x81, 0xFF}; // SNMP Response header pattern, 0xFF is a wildcard value for message length
-    bool snmp_mask[] = {true, true, false, true, true, false}; // false means wildcard value in that position
-    uint8_t ok_pattern[] = {0xBD, 0xFF, 0x8A}; // Ok response header pattern, 0xFF is a wildcard value for message length
-    bool ok_mask[] = {true, false, true}; // false means wildcard value in that position
-
     switch (resp.status) {
         case PM3_SUCCESS:
             break;
@@ -6020,74 +6777,7 @@ static int CmdHFiClassSAM(const char *Cmd) {
             return resp.status;
     }
 
-    uint8_t *d = resp.data.asBytes;
-    // check for standard SamCommandGetContentElement response
-    // bd 09
-    //    8a 07
-    //       03 05 <- tag + length
-    //          06 85 80 6d c0 <- decoded PACS data
-    if (d[0] == 0xbd && d[2] == 0x8a && d[4] == 0x03) {
-        uint8_t pacs_length = d[5];
-        uint8_t *pacs_data = d + 6;
-        int res = HIDDumpPACSBits(pacs_data, pacs_length, verbose);
-        if (res != PM3_SUCCESS) {
-            return res;
-        }
-        // check for standard samCommandGetContentElement2:
-        // bd 1e
-        //    b3 1c
-        //       a0 1a
-        //          80 05
-        //             06 85 80 6d c0
-        //          81 0e
-        //             2b 06 01 04 01 81 e4 38 01 01 02 04 3c ff
-        //          82 01
-        //             07
-    } else if (d[0] == 0xbd && d[2] == 0xb3 && d[4] == 0xa0) {
-        const uint8_t *pacs = d + 6;
-        const uint8_t pacs_length = pacs[1];
-        const uint8_t *pacs_data = pacs + 2;
-        int res = HIDDumpPACSBits(pacs_data, pacs_length, verbose);
-        if (res != PM3_SUCCESS) {
-            return res;
-        }
-
-        const uint8_t *oid = pacs + 2 + pacs_length;
-        const uint8_t oid_length = oid[1];
-        const uint8_t *oid_data = oid + 2;
-        PrintAndLogEx(SUCCESS, "SIO OID.......... " _GREEN_("%s"), sprint_hex_inrow(oid_data, oid_length));
-
-        const uint8_t *mediaType = oid + 2 + oid_length;
-        const uint8_t mediaType_data = mediaType[2];
-        PrintAndLogEx(SUCCESS, "SIO Media Type... " _GREEN_("%s"), getSioMediaTypeInfo(mediaType_data));
-    } else if (break_nrmac && d[0] == 0x05) {
-        PrintAndLogEx(SUCCESS, "Nr-MAC........... " _GREEN_("%s"), sprint_hex_inrow(d + 1, 8));
-        if (verbose) {
-            PrintAndLogEx(INFO, "Replay Nr-MAC to dump SIO:");
-            PrintAndLogEx(SUCCESS, "    hf iclass dump --nr -k %s", sprint_hex_inrow(d + 1, 8));
-        }
-    } else {
-        //if it is an error decode it
-        if (memcmp(d, "\xBE\x07\x80\x01", 4) == 0) { //if it the string is 0xbe 0x07 0x80 0x01 the next byte will indicate the error code
-            PrintAndLogEx(ERR, _RED_("Sam Error Code: %02x"), d[4]);
-            print_hex(d, resp.length);
-        } else if (match_with_wildcard(d, snmp_pattern, snmp_mask, 6)) {
-            is_snmp = true;
-            PrintAndLogEx(SUCCESS, _YELLOW_("[samSNMPMessageResponse] ")"%s", sprint_hex(d + 6, resp.length - 6));
-        } else if (match_with_wildcard(d, ok_pattern, ok_mask, 3)) {
-            PrintAndLogEx(SUCCESS, _YELLOW_("[samResponseAcknowledge] ")"%s", sprint_hex(d + 4, resp.length - 4));
-        } else {
-            print_hex(d, resp.length);
-        }
-    }
-
-    if (decodeTLV && is_snmp == false) {
-        asn1_print(d, d[1] + 2, " ");
-    } else if (decodeTLV && is_snmp) {
-        asn1_print(d + 6, resp.length - 6, "  ");
-    }
-
-    return PM3_SUCCESS;
+    return iclass_sam_print(resp.data.asBytes, resp.length, verbose, break_nrmac, decodeTLV);
 }
 
 static command_t CommandTable[] = {
@@ -977,7 +977,8 @@ static int CmdLegicRestore(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf legic restore",
                   "Reads (bin/eml/json) file and it autodetects card type and verifies that the file has the same size\n"
-                  "Then write the data back to card. All bytes except the first 7bytes [UID(4) MCC(1) DCF(2)]",
+                  "Then write the data back to card. All bytes except the first 7bytes [UID(4) MCC(1) DCF(2)]\n"
+                  "The dump is staged in emulator memory and written in one go, bytes are retried on the device",
                   "hf legic restore -f myfile        --> use user specified filename\n"
                   "hf legic restore -f myfile --ob   --> use UID as filename and obfuscate data");
 
@@ -1029,55 +1030,38 @@ static int CmdLegicRestore(const char *Cmd) {
         }
     }
 
-    PrintAndLogEx(SUCCESS, "Restoring to card");
+    // the whole dump goes to emulator memory, the device then writes it in one field session
+    legic_seteml(dump, 0, bytes_read);
 
-    // fast push mode
-    g_conn.block_after_ACK = true;
+    PrintAndLogEx(SUCCESS, "Restoring to card" NOLF);
 
-    // transfer to device
-    PacketResponseNG resp;
     // 7 = skip UID bytes and MCC
-    for (size_t i = 7; i < bytes_read; i += LEGIC_PACKET_SIZE) {
+    legic_packet_t payload = {
+        .offset = 7,
+        .len = bytes_read - 7,
+        .iv = 0x55,
+    };
 
-        size_t len = MIN((bytes_read - i), LEGIC_PACKET_SIZE);
-        if (len == bytes_read - i) {
-            // Disable fast mode on last packet
-            g_conn.block_after_ACK = false;
-        }
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_LEGIC_WRITER_EML, (uint8_t *)&payload, sizeof(payload));
 
-        legic_packet_t *payload = calloc(1, sizeof(legic_packet_t) + len);
-        if (payload == NULL) {
-            PrintAndLogEx(WARNING, "Failed to allocate memory");
+    PacketResponseNG resp;
+    uint8_t timeout = 0;
+    while (WaitForResponseTimeout(CMD_HF_LEGIC_WRITER_EML, &resp, 2000) == false) {
+        ++timeout;
+        PrintAndLogEx(NORMAL, "." NOLF);
+        if (timeout > 10) {
+            PrintAndLogEx(WARNING, "\ncommand execution time out");
             free(dump);
-            return PM3_EMALLOC;
-        }
-        payload->offset = i;
-        payload->iv = 0x55;
-        payload->len = len;
-        memcpy(payload->data, dump + i, len);
-
-        clearCommandBuffer();
-        SendCommandNG(CMD_HF_LEGIC_WRITER, (uint8_t *)payload, sizeof(legic_packet_t) + len);
-        free(payload);
-
-        uint8_t timeout = 0;
-        while (WaitForResponseTimeout(CMD_HF_LEGIC_WRITER, &resp, 2000) == false) {
-            ++timeout;
-            PrintAndLogEx(NORMAL, "." NOLF);
-            if (timeout > 10) {
-                PrintAndLogEx(WARNING, "\ncommand execution time out");
-                free(dump);
-                return PM3_ETIMEOUT;
-            }
+            return PM3_ETIMEOUT;
         }
-        PrintAndLogEx(NORMAL, "");
+    }
+    PrintAndLogEx(NORMAL, "");
 
-        if (resp.status != PM3_SUCCESS) {
-            PrintAndLogEx(WARNING, "Failed writing tag");
-            free(dump);
-            return PM3_ERFTRANS;
-        }
-        PrintAndLogEx(SUCCESS, "Wrote chunk [offset %zu | len %zu | total %zu", i, len, i + len);
+    if (resp.status != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Failed writing tag");
+        free(dump);
+        return PM3_ERFTRANS;
     }
 
     free(dump);
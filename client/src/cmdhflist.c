@@ -21,6 +21,8 @@
 #include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
 
 #include "commonutil.h"  // ARRAYLEN
 #include "mifare/mifarehost.h"
@@ -28,10 +30,12 @@
 #include "ui.h"
 #include "crc16.h"
 #include "crapto1/crapto1.h"
+#include "mifare/crypto1_batch.h"
 #include "protocols.h"
 #include "cmdhficlass.h"
 #include "mifare/mifaredefault.h"  // mifare consts
 #include "cmdhfseos.h"
+#include "util.h"           // num_CPUs
 
 enum MifareAuthSeq {
     masNone,
@@ -45,6 +49,8 @@ enum MifareAuthSeq {
 };
 static enum MifareAuthSeq MifareAuthState;
 static AuthData_t AuthData;
+static mf_trace_auth_t *gs_mf_trace_auths;
+static size_t gs_mf_trace_auths_count;
 
 void ClearAuthData(void) {
     AuthData.uid = 0;
@@ -2244,6 +2250,44 @@ static void mf_get_paritybinstr(char *s, uint32_t val, uint8_t par) {
     s[0] = '\0';
 }
 
+static int mf_trace_auth_cmp(const void *a, const void *b) {
+    const mf_trace_auth_t *x = (const mf_trace_auth_t *)a;
+    const mf_trace_auth_t *y = (const mf_trace_auth_t *)b;
+    uint32_t kx[] = {x->nt_enc, x->nr_enc, x->ar_enc, x->at_enc, x->uid, x->cmdsize};
+    uint32_t ky[] = {y->nt_enc, y->nr_enc, y->ar_enc, y->at_enc, y->uid, y->cmdsize};
+    for (size_t i = 0; i < ARRAYLEN(kx); i++) {
+        if (kx[i] != ky[i]) {
+            return (kx[i] < ky[i]) ? -1 : 1;
+        }
+    }
+    return memcmp(x->cmd, y->cmd, x->cmdsize);
+}
+
+void MifareTraceSetKeys(mf_trace_auth_t *auths, size_t count) {
+    gs_mf_trace_auths = auths;
+    gs_mf_trace_auths_count = (auths) ? count : 0;
+    if (gs_mf_trace_auths_count) {
+        qsort(auths, count, sizeof(mf_trace_auth_t), mf_trace_auth_cmp);
+    }
+}
+
+static const mf_trace_auth_t *MifareTraceGetAuth(const AuthData_t *ad, const uint8_t *cmd, uint8_t cmdsize) {
+    if (gs_mf_trace_auths_count == 0) {
+        return NULL;
+    }
+
+    mf_trace_auth_t key = {
+        .uid = ad->uid,
+        .nt_enc = ad->nt_enc,
+        .nr_enc = ad->nr_enc,
+        .ar_enc = ad->ar_enc,
+        .at_enc = ad->at_enc,
+        .cmdsize = cmdsize,
+    };
+    memcpy(key.cmd, cmd, cmdsize);
+    return bsearch(&key, gs_mf_trace_auths, gs_mf_trace_auths_count, sizeof(mf_trace_auth_t), mf_trace_auth_cmp);
+}
+
 bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isResponse, uint8_t *mfData, size_t *mfDataLen, const uint64_t *dicKeys, uint32_t dicKeysCount) {
     static struct Crypto1State *traceCrypto1;
 
@@ -2291,43 +2335,25 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
                 };
             }
 
-            // check default keys
-            if (!traceCrypto1 && dicKeys != NULL && dicKeysCount > 0) {
-                for (int i = 0; i < dicKeysCount; i++) {
-                    if (NestedCheckKey(dicKeys[i], &AuthData, cmd, cmdsize, parity)) {
-                        PrintAndLogEx(NORMAL, "            |            |  *  |%60s " _GREEN_("%012" PRIX64) "|     |", "key", dicKeys[i]);
+            // searched before the listing
+            const mf_trace_auth_t *pre = MifareTraceGetAuth(&AuthData, cmd, cmdsize);
+            if (!traceCrypto1 && pre && pre->found && NestedCheckKey(pre->key, &AuthData, cmd, cmdsize, parity)) {
+                PrintAndLogEx(NORMAL, "            |            |  *  |%60s " _GREEN_("%012" PRIX64) "|     |", "key", pre->key);
 
-                        mfLastKey = dicKeys[i];
-                        traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
-                        break;
-                    };
-                }
+                mfLastKey = pre->key;
+                traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
             }
 
-            // nested
-            if (!traceCrypto1 && validate_prng_nonce(AuthData.nt)) {
-                uint32_t ntx = prng_successor(AuthData.nt, 90);
-                for (int i = 0; i < 16383; i++) {
-                    ntx = prng_successor(ntx, 1);
-                    if (NTParityChk(&AuthData, ntx)) {
-
-                        uint32_t ks2 = AuthData.ar_enc ^ prng_successor(ntx, 64);
-                        uint32_t ks3 = AuthData.at_enc ^ prng_successor(ntx, 96);
-                        struct Crypto1State *pcs = lfsr_recovery64(ks2, ks3);
-                        memcpy(mfData, cmd, cmdsize);
-                        mf_crypto1_decrypt(pcs, mfData, cmdsize, 0);
-                        crypto1_destroy(pcs);
-
-                        if (CheckCrypto1Parity(cmd, cmdsize, mfData, parity) && check_crc(CRC_14443_A, mfData, cmdsize)) {
-                            AuthData.ks2 = ks2;
-                            AuthData.ks3 = ks3;
-                            AuthData.nt = ntx;
-                            mfLastKey = GetCrypto1ProbableKey(&AuthData);
-                            PrintAndLogEx(NORMAL, "            |            |  *  | nested probable key: " _GREEN_("%012" PRIX64) "     ks2:%08x ks3:%08x |     |",
-                                          mfLastKey,
-                                          AuthData.ks2,
-                                          AuthData.ks3);
+            // check default keys, 64 at a time. Only the keys that pass the auth get the full check
+            if (!traceCrypto1 && pre == NULL && dicKeys != NULL && dicKeysCount > 0) {
+                for (uint32_t i = 0; i < dicKeysCount && !traceCrypto1; i += CRYPTO1_BATCH_SIZE) {
+                    uint32_t n = MIN(dicKeysCount - i, CRYPTO1_BATCH_SIZE);
+                    uint64_t candidates = NestedCheckKeys(&dicKeys[i], n, &AuthData);
+                    for (uint32_t lane = 0; candidates; lane++, candidates >>= 1) {
+                        if ((candidates & 1) && NestedCheckKey(dicKeys[i + lane], &AuthData, cmd, cmdsize, parity)) {
+                            PrintAndLogEx(NORMAL, "            |            |  *  |%60s " _GREEN_("%012" PRIX64) "|     |", "key", dicKeys[i + lane]);
 
+                            mfLastKey = dicKeys[i + lane];
                             traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
                             break;
                         }
@@ -2335,6 +2361,16 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
                 }
             }
 
+            // nested
+            if (!traceCrypto1 && validate_prng_nonce(AuthData.nt) && MifareTraceNestedKey(&AuthData, cmd, cmdsize, parity, &mfLastKey)) {
+                PrintAndLogEx(NORMAL, "            |            |  *  | nested probable key: " _GREEN_("%012" PRIX64) "     ks2:%08x ks3:%08x |     |",
+                              mfLastKey,
+                              AuthData.ks2,
+                              AuthData.ks3);
+
+                traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
+            }
+
             //hardnested
             if (!traceCrypto1) {
 
@@ -2398,7 +2434,7 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
     return *mfDataLen > 0;
 }
 
-bool NTParityChk(AuthData_t *ad, uint32_t ntx) {
+bool NTParityChk(const AuthData_t *ad, uint32_t ntx) {
     if (
         (oddparity8(ntx >> 8 & 0xff) ^ (ntx & 0x01) ^ ((ad->nt_enc_par >> 5) & 0x01) ^ (ad->nt_enc & 0x01)) ||
         (oddparity8(ntx >> 16 & 0xff) ^ (ntx >> 8 & 0x01) ^ ((ad->nt_enc_par >> 6) & 0x01) ^ (ad->nt_enc >> 8 & 0x01)) ||
@@ -2426,13 +2462,45 @@ bool NTParityChk(AuthData_t *ad, uint32_t ntx) {
     return true;
 }
 
-bool NestedCheckKey(uint64_t key, AuthData_t *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+uint64_t NestedCheckKeys(const uint64_t *keys, uint32_t n, AuthData_t *ad) {
+    crypto1_batch_t b;
+    uint32_t nt[CRYPTO1_BATCH_SIZE];
+    uint32_t ar[CRYPTO1_BATCH_SIZE];
+    uint32_t at[CRYPTO1_BATCH_SIZE];
+
+    crypto1_batch_load_keys(&b, keys, n);
+    crypto1_batch_word(&b, ad->nt_enc ^ ad->uid, 1, nt);
+    crypto1_batch_word(&b, ad->nr_enc, 1, NULL);
+    crypto1_batch_word(&b, 0, 0, ar);
+    crypto1_batch_word(&b, 0, 0, at);
+
+    uint64_t res = 0;
+    for (uint32_t i = 0; i < b.lanes; i++) {
+        uint32_t nt1 = nt[i] ^ ad->nt_enc;
+        if ((prng_successor(nt1, 64) == (ar[i] ^ ad->ar_enc)) && (prng_successor(nt1, 96) == (at[i] ^ ad->at_enc)) && NTParityChk(ad, nt1)) {
+            res |= UINT64_C(1) << i;
+        }
+    }
+    return res;
+}
+
+uint64_t FirstAuthCheckKeys(const uint64_t *keys, uint32_t n, const mf_trace_auth_t *a) {
+    crypto1_batch_t b;
+    crypto1_batch_load_keys(&b, keys, n);
+    crypto1_batch_word(&b, a->uid ^ a->nt_enc, 0, NULL);
+    crypto1_batch_word(&b, a->nr_enc, 1, NULL);
+    uint64_t res = crypto1_batch_word_match(&b, 0, 0, a->ar_enc ^ prng_successor(a->nt_enc, 64));
+    if (res && a->has_at) {
+        res &= crypto1_batch_word_match(&b, 0, 0, a->at_enc ^ prng_successor(a->nt_enc, 96));
+    }
+    return res;
+}
+
+// NestedCheckKey() without touching AuthData, the decrypted tag nonce in nt
+static bool NestedCheckKeyNt(uint64_t key, const AuthData_t *ad, const uint8_t *cmd, uint8_t cmdsize, const uint8_t *parity, uint32_t *nt) {
     uint8_t buf[32] = {0};
     struct Crypto1State *pcs;
 
-    AuthData.ks2 = 0;
-    AuthData.ks3 = 0;
-
     pcs = crypto1_create(key);
     uint32_t nt1 = crypto1_word(pcs, ad->nt_enc ^ ad->uid, 1) ^ ad->nt_enc;
     uint32_t ar = prng_successor(nt1, 64);
@@ -2458,12 +2526,159 @@ bool NestedCheckKey(uint64_t key, AuthData_t *ad, uint8_t *cmd, uint8_t cmdsize,
     if (!check_crc(CRC_14443_A, buf, cmdsize))
         return false;
 
+    *nt = nt1;
+    return true;
+}
+
+bool NestedCheckKey(uint64_t key, AuthData_t *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+    AuthData.ks2 = 0;
+    AuthData.ks3 = 0;
+
+    uint32_t nt1 = 0;
+    if (NestedCheckKeyNt(key, ad, cmd, cmdsize, parity, &nt1) == false) {
+        return false;
+    }
+
     AuthData.nt = nt1;
-    AuthData.ks2 = AuthData.ar_enc ^ ar;
-    AuthData.ks3 = AuthData.at_enc ^ at;
+    AuthData.ks2 = AuthData.ar_enc ^ prng_successor(nt1, 64);
+    AuthData.ks3 = AuthData.at_enc ^ prng_successor(nt1, 96);
     return true;
 }
 
+// keys per work item, small enough that a single authentication is spread over all cores
+#define MF_TRACE_KEYS_BLOCK  4096
+
+typedef struct {
+    mf_trace_auth_t *auths;
+    size_t count;
+    const uint64_t *keys;
+    uint32_t keys_count;
+    size_t blocks;          // key blocks per authentication
+    size_t next;            // next work item, authentication * blocks + block
+    size_t found;
+    pthread_mutex_t lock;
+} mf_trace_keys_t;
+
+static void *mf_trace_keys_worker(void *arg) {
+    mf_trace_keys_t *w = (mf_trace_keys_t *)arg;
+    AuthData_t *ad = calloc(1, sizeof(AuthData_t));
+    if (ad == NULL) {
+        return NULL;
+    }
+
+    for (;;) {
+        size_t item = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+        if (item >= w->count * w->blocks) {
+            break;
+        }
+
+        mf_trace_auth_t *auth = &w->auths[item / w->blocks];
+        if (__atomic_load_n(&auth->found, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        ad->uid = auth->uid;
+        ad->nt_enc = auth->nt_enc;
+        ad->nt_enc_par = auth->nt_enc_par;
+        ad->nr_enc = auth->nr_enc;
+        ad->ar_enc = auth->ar_enc;
+        ad->ar_enc_par = auth->ar_enc_par;
+        ad->at_enc = auth->at_enc;
+        ad->at_enc_par = auth->at_enc_par;
+
+        uint32_t first = (item % w->blocks) * MF_TRACE_KEYS_BLOCK;
+        uint32_t last = MIN(first + MF_TRACE_KEYS_BLOCK, w->keys_count);
+
+        for (uint32_t i = first; i < last; i += CRYPTO1_BATCH_SIZE) {
+            uint32_t n = MIN(last - i, CRYPTO1_BATCH_SIZE);
+            uint64_t candidates = (auth->first) ? FirstAuthCheckKeys(&w->keys[i], n, auth) : NestedCheckKeys(&w->keys[i], n, ad);
+            uint32_t nt = 0;
+            for (uint32_t lane = 0; candidates; lane++, candidates >>= 1) {
+                // 32 bits of ar, and at if present, leave no doubt about a first authentication
+                if ((candidates & 1) && (auth->first || NestedCheckKeyNt(w->keys[i + lane], ad, auth->cmd, auth->cmdsize, auth->parity, &nt))) {
+                    pthread_mutex_lock(&w->lock);
+                    if (auth->found == false) {
+                        auth->key = w->keys[i + lane];
+                        __atomic_store_n(&auth->found, true, __ATOMIC_RELAXED);
+                        w->found++;
+                    }
+                    pthread_mutex_unlock(&w->lock);
+                    break;
+                }
+            }
+            if (__atomic_load_n(&auth->found, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+    }
+    free(ad);
+    return NULL;
+}
+
+size_t MifareTraceFindKeys(mf_trace_auth_t *auths, size_t count, const uint64_t *dicKeys, uint32_t dicKeysCount) {
+    if (count == 0 || dicKeys == NULL || dicKeysCount == 0) {
+        return 0;
+    }
+
+    mf_trace_keys_t w = {
+        .auths = auths,
+        .count = count,
+        .keys = dicKeys,
+        .keys_count = dicKeysCount,
+        .blocks = (dicKeysCount + MF_TRACE_KEYS_BLOCK - 1) / MF_TRACE_KEYS_BLOCK,
+    };
+    pthread_mutex_init(&w.lock, NULL);
+
+    int n = MIN(num_CPUs(), (int)MIN(w.count * w.blocks, 256));
+    pthread_t *tids = calloc(n, sizeof(pthread_t));
+    int started = 0;
+    for (; tids && started < n; started++) {
+        if (pthread_create(&tids[started], NULL, mf_trace_keys_worker, &w) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        mf_trace_keys_worker(&w);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+    pthread_mutex_destroy(&w.lock);
+    return w.found;
+}
+
+bool MifareTraceNestedKey(AuthData_t *ad, const uint8_t *cmd, uint8_t cmdsize, const uint8_t *parity, uint64_t *key) {
+    if (cmdsize > 32) {
+        return false;
+    }
+
+    uint8_t dec[32];
+    uint32_t ntx = prng_successor(ad->nt, 90);
+    for (int i = 0; i < 16383; i++) {
+        ntx = prng_successor(ntx, 1);
+        if (NTParityChk(ad, ntx) == false) {
+            continue;
+        }
+
+        uint32_t ks2 = ad->ar_enc ^ prng_successor(ntx, 64);
+        uint32_t ks3 = ad->at_enc ^ prng_successor(ntx, 96);
+        struct Crypto1State *pcs = lfsr_recovery64(ks2, ks3);
+        memcpy(dec, cmd, cmdsize);
+        mf_crypto1_decrypt(pcs, dec, cmdsize, 0);
+        crypto1_destroy(pcs);
+
+        if (CheckCrypto1Parity(cmd, cmdsize, dec, parity) && check_crc(CRC_14443_A, dec, cmdsize)) {
+            ad->ks2 = ks2;
+            ad->ks3 = ks3;
+            ad->nt = ntx;
+            *key = GetCrypto1ProbableKey(ad);
+            return true;
+        }
+    }
+    return false;
+}
+
 bool CheckCrypto1Parity(const uint8_t *cmd_enc, uint8_t cmdsize, uint8_t *cmd, const uint8_t *parity_enc) {
     for (int i = 0; i < cmdsize - 1; i++) {
         if (oddparity8(cmd[i]) ^ (cmd[i + 1] & 0x01) ^ ((parity_enc[i / 8] >> (7 - i % 8)) & 0x01) ^ (cmd_enc[i + 1] & 0x01))
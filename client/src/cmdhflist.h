@@ -38,6 +38,27 @@ typedef struct {
     uint8_t mem[MIFARE_4K_MAX_BYTES];
 } AuthData_t;
 
+// An authentication found in a trace before it is listed, and its dictionary key
+typedef struct {
+    uint32_t uid;
+    uint32_t nt_enc;    // plain tag nonce of a first authentication
+    uint8_t nt_enc_par;
+    uint32_t nr_enc;
+    uint32_t ar_enc;
+    uint8_t ar_enc_par;
+    uint32_t at_enc;
+    uint8_t at_enc_par;
+    uint8_t cmd[32];    // first encrypted frame after the authentication
+    uint8_t cmdsize;
+    uint8_t parity[4];
+    bool first;         // first authentication, no encrypted frame is needed to check a key
+    bool has_at;        // the tag answered, so the key is the one of the tag
+    uint8_t block;      // first authentication only, block and key type of the auth command
+    uint8_t keytype;
+    bool found;
+    uint64_t key;
+} mf_trace_auth_t;
+
 void ClearAuthData(void);
 
 uint8_t iso14443A_CRC_check(bool isResponse, uint8_t *d, uint8_t n);
@@ -72,10 +93,23 @@ void annotateCryptoRF(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize);
 void annotateSeos(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize, bool isResponse);
 
 bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isResponse, uint8_t *mfData, size_t *mfDataLen, const uint64_t *dicKeys, uint32_t dicKeysCount);
-bool NTParityChk(AuthData_t *ad, uint32_t ntx);
+bool NTParityChk(const AuthData_t *ad, uint32_t ntx);
 bool NestedCheckKey(uint64_t key, AuthData_t *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity);
+// auth part of NestedCheckKey() for up to 64 keys, returns the mask of keys worth a full check
+uint64_t NestedCheckKeys(const uint64_t *keys, uint32_t n, AuthData_t *ad);
 bool CheckCrypto1Parity(const uint8_t *cmd_enc, uint8_t cmdsize, uint8_t *cmd, const uint8_t *parity_enc);
 uint64_t GetCrypto1ProbableKey(AuthData_t *ad);
+// Nested authentication on a weak PRNG card, ad->nt is the plain nonce of the previous authentication.
+// Searches the nonces that follow it, on success ad gets the nonce and keystream and key is set
+bool MifareTraceNestedKey(AuthData_t *ad, const uint8_t *cmd, uint8_t cmdsize, const uint8_t *parity, uint64_t *key);
+
+// NestedCheckKeys() for a first authentication, nt in plain
+uint64_t FirstAuthCheckKeys(const uint64_t *keys, uint32_t n, const mf_trace_auth_t *a);
+// Checks the dictionary against all authentications on all cores, returns how many keys were found
+size_t MifareTraceFindKeys(mf_trace_auth_t *auths, size_t count, const uint64_t *dicKeys, uint32_t dicKeysCount);
+// DecodeMifareData() takes the keys of these authentications instead of trying the dictionary,
+// the array is sorted and used until it is set to NULL
+void MifareTraceSetKeys(mf_trace_auth_t *auths, size_t count);
 
 void annotateFMCOS20(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize);
 
@@ -28,6 +28,7 @@
 #include "mifare/mifaredefault.h"  // mifare default key array
 #include "cliparser.h"             // argtable
 #include "hardnested_bf_core.h"    // SetSIMDInstr
+#include "hardnested_bruteforce.h"  // brute_force_set_shard
 #include "mifare/mad.h"
 #include "nfc/ndef.h"
 #include "protocols.h"
@@ -46,6 +47,8 @@
 #include "generator.h"              // keygens.
 #include "fpga.h"
 #include "mifare/mifarehost.h"
+#include "mifare/mfkeystats.h"      // key hit history
+#include "mifare/mfkey.h"           // compare_uint64
 #include "crypto/originality.h"
 
 // Defines for Saflok parsing
@@ -344,24 +347,6 @@ static void ParseAndPrintSaflokData(const sector_t *sector0_info, const sector_t
     PrintAndLogEx(SUCCESS, "Checksum Valid........ ( %s )", checksum_valid ? _GREEN_("ok") : _RED_("fail"));
 }
 
-/*
-static int usage_hf14_keybrute(void) {
-    PrintAndLogEx(NORMAL, "J_Run's 2nd phase of multiple sector nested authentication key recovery");
-    PrintAndLogEx(NORMAL, "You have a known 4 last bytes of a key recovered with mf_nonce_brute tool.");
-    PrintAndLogEx(NORMAL, "First 2 bytes of key will be bruteforced");
-    PrintAndLogEx(NORMAL, "");
-    PrintAndLogEx(NORMAL, " ---[ This attack is obsolete,  try hardnested instead ]---");
-    PrintAndLogEx(NORMAL, "Options:");
-    PrintAndLogEx(NORMAL, "      h               this help");
-    PrintAndLogEx(NORMAL, "      <block number>  target block number");
-    PrintAndLogEx(NORMAL, "      <A|B>           target key type");
-    PrintAndLogEx(NORMAL, "      <key>           candidate key from mf_nonce_brute tool");
-    PrintAndLogEx(NORMAL, "Examples:");
-    PrintAndLogEx(NORMAL, _YELLOW_("           hf mf keybrute --blk 1 -k 000011223344"));
-    return 0;
-}
-*/
-
 int mfc_ev1_print_signature(uint8_t *uid, uint8_t uidlen, uint8_t *signature, int signature_len) {
     int index = originality_check_verify(uid, uidlen, signature, signature_len, PK_MFC);
     return originality_check_print(signature, signature_len, index);
@@ -560,6 +545,9 @@ bool mfc_value(const uint8_t *d, int32_t *val) {
 
 void mf_print_block_one(uint8_t blockno, uint8_t *d, bool verbose) {
 
+    result_add_int("block", blockno);
+    result_add_hex("data", d, MFBLOCK_SIZE);
+
     if (blockno == 0) {
         char ascii[24] = {0};
         ascii_to_buffer((uint8_t *)ascii, d, MFBLOCK_SIZE, sizeof(ascii) - 1, 1);
@@ -893,6 +881,41 @@ static int mf_analyse_st_block(uint8_t blockno, uint8_t *block, bool force) {
  * @param numSectors: size of the card
  * @param keyFileName: filename containing keys or NULL.
 */
+// One read attempt per block, packed in as few CMD_BATCH round trips as possible.
+// replies[i] stays CMD_UNKNOWN for blocks not read, e.g. when the firmware has no CMD_BATCH.
+static void mf_read_blocks_batched(const mf_readblock_t *reads, uint8_t count, PacketResponseNG *replies) {
+    for (uint8_t i = 0; i < count; i++) {
+        replies[i].cmd = CMD_UNKNOWN;
+    }
+
+    uint8_t done = 0;
+    while (done < count) {
+        cmd_batch_t batch;
+        BatchInit(&batch, 0);
+        uint8_t n = 0;
+        while ((done + n < count) && (BatchAdd(&batch, CMD_HF_MIFARE_READBL, &reads[done + n], sizeof(mf_readblock_t)) == PM3_SUCCESS)) {
+            n++;
+        }
+
+        uint8_t executed = 0;
+        if (BatchRun(&batch, replies + done, n, &executed, 1500) != PM3_SUCCESS) {
+            return;
+        }
+        done += n;
+    }
+}
+
+static bool mf_read_batched_ok(const PacketResponseNG *reply) {
+    return (reply->cmd == CMD_HF_MIFARE_READBL) && (reply->status == PM3_SUCCESS) && (reply->length >= MFBLOCK_SIZE);
+}
+
+static void mf_decode_access_rights(uint8_t *rights, const uint8_t *data) {
+    rights[0] = ((data[7] & 0x10) >> 2) | ((data[8] & 0x1) << 1) | ((data[8] & 0x10) >> 4); // C1C2C3 for data area 0
+    rights[1] = ((data[7] & 0x20) >> 3) | ((data[8] & 0x2) << 0) | ((data[8] & 0x20) >> 5); // C1C2C3 for data area 1
+    rights[2] = ((data[7] & 0x40) >> 4) | ((data[8] & 0x4) >> 1) | ((data[8] & 0x40) >> 6); // C1C2C3 for data area 2
+    rights[3] = ((data[7] & 0x80) >> 5) | ((data[8] & 0x8) >> 2) | ((data[8] & 0x80) >> 7); // C1C2C3 for sector trailer
+}
+
 static int mfc_read_tag(iso14a_card_select_t *card, uint8_t *carddata, uint8_t numSectors, char *keyfn) {
 
     // Select card to get UID/UIDLEN/ATQA/SAK information
@@ -936,6 +959,23 @@ static int mfc_read_tag(iso14a_card_select_t *card, uint8_t *carddata, uint8_t n
         return PM3_ELENGTH;
     }
 
+    // whole card in one field session first, the reads below only retry what it missed
+    sector_t e_sector[40] = {0};
+    uint16_t dumped[40] = {0};
+    for (uint8_t sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+        e_sector[sectorNo].Key[MF_KEY_A] = bytes_to_num(keyA + (sectorNo * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        e_sector[sectorNo].Key[MF_KEY_B] = bytes_to_num(keyB + (sectorNo * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        e_sector[sectorNo].foundKey[MF_KEY_A] = true;
+        e_sector[sectorNo].foundKey[MF_KEY_B] = true;
+    }
+    PrintAndLogEx(INFO, "Dumping card in one go...");
+    int res = mf_dump_card(e_sector, numSectors, carddata, dumped);
+    PrintAndLogEx(NORMAL, "");
+    if (res == PM3_ETIMEOUT) {
+        // firmware without CMD_HF_MIFARE_DUMP or card lost, take the slow path for all
+        memset(dumped, 0, sizeof(dumped));
+    }
+
     PrintAndLogEx(INFO, "Reading sector access bits...");
     PrintAndLogEx(INFO, "." NOLF);
 
@@ -944,16 +984,52 @@ static int mfc_read_tag(iso14a_card_select_t *card, uint8_t *carddata, uint8_t n
     mf_readblock_t payload;
     uint8_t current_key;
 
+    // first try of every sector trailer with key A in one go, failures take the regular retry path below
+    mf_readblock_t reads[40];
+    uint8_t pending[40];
+    PacketResponseNG *batched = calloc(40, sizeof(PacketResponseNG));
+    if (batched == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(keyA);
+        free(keyB);
+        return PM3_EMALLOC;
+    }
+
+    uint8_t npending = 0;
     for (uint8_t sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+        uint8_t trailer = mfNumBlocksPerSector(sectorNo) - 1;
+        if (dumped[sectorNo] & (1 << trailer)) {
+            continue;
+        }
+        reads[npending].blockno = mfFirstBlockOfSector(sectorNo) + trailer;
+        reads[npending].keytype = MF_KEY_A;
+        memcpy(reads[npending].key, keyA + (sectorNo * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        pending[npending++] = sectorNo;
+    }
+    mf_read_blocks_batched(reads, npending, batched);
+
+    for (uint8_t sectorNo = 0, p = 0; sectorNo < numSectors; sectorNo++) {
 
         current_key = MF_KEY_A;
 
+        uint8_t trailer = mfNumBlocksPerSector(sectorNo) - 1;
+        if (dumped[sectorNo] & (1 << trailer)) {
+            mf_decode_access_rights(rights[sectorNo], carddata + ((mfFirstBlockOfSector(sectorNo) + trailer) * MFBLOCK_SIZE));
+            continue;
+        }
+
+        if ((p < npending) && (pending[p] == sectorNo) && mf_read_batched_ok(&batched[p++])) {
+            mf_decode_access_rights(rights[sectorNo], batched[p - 1].data.asBytes);
+            continue;
+        }
+
         for (uint8_t tries = 0; tries < MIFARE_SECTOR_RETRY; tries++) {
             PrintAndLogEx(NORMAL, "." NOLF);
             fflush(stdout);
 
             if (kbd_enter_pressed()) {
                 PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+                free(batched);
                 free(keyA);
                 free(keyB);
                 return PM3_EOPABORTED;
@@ -971,10 +1047,7 @@ static int mfc_read_tag(iso14a_card_select_t *card, uint8_t *carddata, uint8_t n
 
                 uint8_t *data = resp.data.asBytes;
                 if (resp.status == PM3_SUCCESS) {
-                    rights[sectorNo][0] = ((data[7] & 0x10) >> 2) | ((data[8] & 0x1) << 1) | ((data[8] & 0x10) >> 4); // C1C2C3 for data area 0
-                    rights[sectorNo][1] = ((data[7] & 0x20) >> 3) | ((data[8] & 0x2) << 0) | ((data[8] & 0x20) >> 5); // C1C2C3 for data area 1
-                    rights[sectorNo][2] = ((data[7] & 0x40) >> 4) | ((data[8] & 0x4) >> 1) | ((data[8] & 0x40) >> 6); // C1C2C3 for data area 2
-                    rights[sectorNo][3] = ((data[7] & 0x80) >> 5) | ((data[8] & 0x8) >> 2) | ((data[8] & 0x80) >> 7); // C1C2C3 for sector trailer
+                    mf_decode_access_rights(rights[sectorNo], data);
                     break;
                 } else if (tries == (MIFARE_SECTOR_RETRY / 2)) { // after half unsuccessful tries, give key B a go
                     PrintAndLogEx(WARNING, "\nTrying with " _YELLOW_("key B") " instead...");
@@ -999,17 +1072,48 @@ static int mfc_read_tag(iso14a_card_select_t *card, uint8_t *carddata, uint8_t n
 
     for (uint8_t sectorNo = 0; sectorNo < numSectors; sectorNo++) {
 
+        // first try of the whole sector in one go, same key choice as the retry loop below
+        uint8_t blocks = mfNumBlocksPerSector(sectorNo);
+        uint8_t batch_cnt = blocks;
+        if (dumped[sectorNo] == (uint16_t)((1 << blocks) - 1)) {
+            batch_cnt = 0;
+        }
+        for (uint8_t blockNo = 0; blockNo < batch_cnt; blockNo++) {
+            uint8_t data_area = (sectorNo < 32) ? blockNo : blockNo / 5;
+            bool use_b = (mfIsSectorTrailerBasedOnBlocks(sectorNo, blockNo) == false) && ((rights[sectorNo][data_area] == 0x03) || (rights[sectorNo][data_area] == 0x05));
+            reads[blockNo].blockno = mfFirstBlockOfSector(sectorNo) + blockNo;
+            reads[blockNo].keytype = use_b ? MF_KEY_B : MF_KEY_A;
+            memcpy(reads[blockNo].key, (use_b ? keyB : keyA) + (sectorNo * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        }
+        mf_read_blocks_batched(reads, batch_cnt, batched);
+
         for (uint8_t blockNo = 0; blockNo < mfNumBlocksPerSector(sectorNo); blockNo++) {
 
             bool received = false;
             current_key = MF_KEY_A;
             uint8_t data_area = (sectorNo < 32) ? blockNo : blockNo / 5;
+
+            if (dumped[sectorNo] & (1 << blockNo)) {
+                uint8_t *data = carddata + (MFBLOCK_SIZE * (mfFirstBlockOfSector(sectorNo) + blockNo));
+                if (mfIsSectorTrailerBasedOnBlocks(sectorNo, blockNo)) {
+                    // sector trailer. Fill in the keys.
+                    memcpy(data, keyA + (sectorNo * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+                    memcpy(data + 10, keyB + (sectorNo * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+                }
+                continue;
+            }
             if (rights[sectorNo][data_area] == 0x07) {                                     // no key would work
                 PrintAndLogEx(WARNING, "Access rights prevent reading sector... " _YELLOW_("%2d") " block... " _YELLOW_("%3d") " ( skip )", sectorNo, blockNo);
                 continue;
             }
 
-            for (uint8_t tries = 0; tries < MIFARE_SECTOR_RETRY; tries++) {
+            bool prefetched = (blockNo < batch_cnt) && mf_read_batched_ok(&batched[blockNo]);
+            if (prefetched) {
+                memcpy(&resp, &batched[blockNo], sizeof(PacketResponseNG));
+                received = true;
+            }
+
+            for (uint8_t tries = 0; (prefetched == false) && (tries < MIFARE_SECTOR_RETRY); tries++) {
 
                 if (mfIsSectorTrailerBasedOnBlocks(sectorNo, blockNo)) {
 
@@ -1085,6 +1189,7 @@ static int mfc_read_tag(iso14a_card_select_t *card, uint8_t *carddata, uint8_t n
     }
 
 
+    free(batched);
     free(keyA);
     free(keyB);
 
@@ -1092,7 +1197,69 @@ static int mfc_read_tag(iso14a_card_select_t *card, uint8_t *carddata, uint8_t n
     return PM3_SUCCESS ;
 }
 
-static int mf_load_keys(uint8_t **pkeyBlock, uint32_t *pkeycnt, uint8_t *userkey, int userkeylen, const char *filename, int fnlen, bool load_default) {
+// dictionary files given with -f, in the order they were given
+#define MF_DICT_MAX_FILES   8
+
+typedef struct {
+    int count;
+    char name[MF_DICT_MAX_FILES][FILE_PATH_SIZE];
+} mf_dict_files_t;
+
+static int mf_dict_files_get(CLIParserContext *ctx, int paramnum, mf_dict_files_t *files) {
+    memset(files, 0, sizeof(mf_dict_files_t));
+    struct arg_str *fns = arg_get_str(ctx, paramnum);
+    for (int i = 0; i < fns->count; i++) {
+        if (strlen(fns->sval[i]) >= FILE_PATH_SIZE) {
+            PrintAndLogEx(ERR, "Parameter error: filename too long `%s`", fns->sval[i]);
+            return PM3_EINVARG;
+        }
+        strcpy(files->name[files->count++], fns->sval[i]);
+    }
+    return PM3_SUCCESS;
+}
+
+typedef struct {
+    uint32_t hits;
+    uint32_t idx;
+} mf_key_rank_t;
+
+static int mf_key_rank_cmp(const void *a, const void *b) {
+    const mf_key_rank_t *ra = a;
+    const mf_key_rank_t *rb = b;
+    if (ra->hits != rb->hits) {
+        return (ra->hits > rb->hits) ? -1 : 1;
+    }
+    return (ra->idx > rb->idx) - (ra->idx < rb->idx);
+}
+
+// keys listed by more of the sources go first, keys listed equally often keep their order
+static int mf_keys_rank(uint8_t *keys, uint32_t keycnt, const uint32_t *hits) {
+    mf_key_rank_t *rank = calloc(keycnt, sizeof(mf_key_rank_t));
+    uint8_t *tmp = calloc(keycnt, MIFARE_KEY_SIZE);
+    if (rank == NULL || tmp == NULL) {
+        free(rank);
+        free(tmp);
+        return PM3_EMALLOC;
+    }
+
+    for (uint32_t i = 0; i < keycnt; i++) {
+        rank[i].hits = hits[i];
+        rank[i].idx = i;
+    }
+    qsort(rank, keycnt, sizeof(mf_key_rank_t), mf_key_rank_cmp);
+
+    for (uint32_t i = 0; i < keycnt; i++) {
+        memcpy(tmp + (i * MIFARE_KEY_SIZE), keys + (rank[i].idx * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+    }
+    memcpy(keys, tmp, keycnt * MIFARE_KEY_SIZE);
+    free(tmp);
+    free(rank);
+    return PM3_SUCCESS;
+}
+
+// Loads user keys, hardcoded keys and the dictionary files, in that order, into one list without duplicates.
+// With rank, the keys after the user keys are ordered by how many of the sources list them
+static int mf_load_keys(uint8_t **pkeyBlock, uint32_t *pkeycnt, uint8_t *userkey, int userkeylen, const mf_dict_files_t *files, bool load_default, bool rank) {
     // Handle Keys
     *pkeycnt = 0;
     *pkeyBlock = NULL;
@@ -1136,11 +1303,11 @@ static int mf_load_keys(uint8_t **pkeyBlock, uint32_t *pkeycnt, uint8_t *userkey
         PrintAndLogEx(SUCCESS, "loaded " _GREEN_("%zu") " hardcoded keys", ARRAYLEN(g_mifare_default_keys));
     }
 
-    // Handle user supplied dictionary file
-    if (fnlen > 0) {
+    // Handle user supplied dictionary files
+    for (int f = 0; files && f < files->count; f++) {
         uint32_t loaded_numKeys = 0;
         uint8_t *keyBlock_tmp = NULL;
-        int res = loadFileDICTIONARY_safe(filename, (void **) &keyBlock_tmp, MIFARE_KEY_SIZE, &loaded_numKeys);
+        int res = loadFileDICTIONARY_safe(files->name[f], (void **) &keyBlock_tmp, MIFARE_KEY_SIZE, &loaded_numKeys);
         if (res != PM3_SUCCESS || loaded_numKeys == 0 || keyBlock_tmp == NULL) {
             PrintAndLogEx(FAILED, "An error occurred while loading the dictionary!");
             free(keyBlock_tmp);
@@ -1160,6 +1327,84 @@ static int mf_load_keys(uint8_t **pkeyBlock, uint32_t *pkeycnt, uint8_t *userkey
             free(keyBlock_tmp);
         }
     }
+
+    if (*pkeycnt == 0) {
+        return PM3_SUCCESS;
+    }
+
+    // every duplicate dropped here is one authentication less on the card
+    uint32_t *hits = calloc(*pkeycnt, sizeof(uint32_t));
+    if (hits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(*pkeyBlock);
+        return PM3_EMALLOC;
+    }
+
+    uint32_t cnt = dictionary_dedup(*pkeyBlock, *pkeycnt, MIFARE_KEY_SIZE, hits);
+    if (cnt != *pkeycnt) {
+        PrintAndLogEx(SUCCESS, "removed " _GREEN_("%u") " duplicate keys, " _GREEN_("%u") " keys left", *pkeycnt - cnt, cnt);
+        *pkeycnt = cnt;
+    }
+
+    uint32_t userkeycnt = MIN((uint32_t)(userkeylen / MIFARE_KEY_SIZE), cnt);
+    if (rank && cnt > userkeycnt) {
+        if (mf_keys_rank(*pkeyBlock + (userkeycnt * MIFARE_KEY_SIZE), cnt - userkeycnt, hits + userkeycnt) != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            free(hits);
+            free(*pkeyBlock);
+            return PM3_EMALLOC;
+        }
+        PrintAndLogEx(SUCCESS, "keys ordered by number of sources listing them");
+    }
+    free(hits);
+    return PM3_SUCCESS;
+}
+
+// reads the card identity for the key statistics and, if asked, moves the dictionary keys
+// with hits on alike cards to the front. User supplied keys stay first
+static void mf_keystats_prepare(mfc_keystats_ctx_t *kctx, uint8_t sectors, uint8_t *keyBlock, uint32_t keycnt, uint32_t userkeycnt, bool order) {
+    memset(kctx, 0, sizeof(mfc_keystats_ctx_t));
+    kctx->sectors = sectors;
+
+    int uidlen = 0;
+    if (IfPm3Iso14443a() && mf_read_uid(kctx->uid, &uidlen, NULL) == PM3_SUCCESS) {
+        kctx->uidlen = uidlen;
+    }
+
+    if (order == false || keycnt <= userkeycnt) {
+        return;
+    }
+
+    uint32_t n = mfc_keystats_order(kctx, keyBlock + (userkeycnt * MIFARE_KEY_SIZE), keycnt - userkeycnt);
+    if (n) {
+        PrintAndLogEx(INFO, "Moved " _YELLOW_("%u") " keys with hits on alike cards to the front", n);
+    }
+}
+
+// puts the keys of every known key algorithm applying to this uid right after the user supplied
+// keys, the dictionary copies of them are dropped. Cards of those systems fall on the first batch
+static int mf_keys_add_derived(uint8_t **pkeyBlock, uint32_t *pkeycnt, uint32_t userkeycnt, uint8_t *uid, uint8_t uidlen) {
+    uint8_t derived[MFC_ALGO_UID_KEYS_MAX * MIFARE_KEY_SIZE];
+    uint32_t n = mfc_algo_uid_keys(uid, uidlen, derived);
+    n = dictionary_dedup(derived, n, MIFARE_KEY_SIZE, NULL);
+    if (n == 0) {
+        return PM3_SUCCESS;
+    }
+
+    uint8_t *p = realloc(*pkeyBlock, (*pkeycnt + n) * MIFARE_KEY_SIZE);
+    if (p == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    *pkeyBlock = p;
+
+    userkeycnt = MIN(userkeycnt, *pkeycnt);
+    memmove(p + ((userkeycnt + n) * MIFARE_KEY_SIZE), p + (userkeycnt * MIFARE_KEY_SIZE), (*pkeycnt - userkeycnt) * MIFARE_KEY_SIZE);
+    memcpy(p + (userkeycnt * MIFARE_KEY_SIZE), derived, n * MIFARE_KEY_SIZE);
+
+    uint32_t before = *pkeycnt;
+    *pkeycnt = dictionary_dedup(p, *pkeycnt + n, MIFARE_KEY_SIZE, NULL);
+    PrintAndLogEx(SUCCESS, "loaded " _GREEN_("%u") " keys derived from the UID, " _GREEN_("%u") " of them new", n, *pkeycnt - before);
     return PM3_SUCCESS;
 }
 
@@ -2611,6 +2856,74 @@ jumptoend:
     return PM3_SUCCESS;
 }
 
+// hf mf hardnested --sectors. One field session collects the nonces of every key, the device
+// takes turns between them. They are solved one after the other from their nonce files, so the
+// card can be taken away once the acquisition is done.
+static int mf_hardnested_sectors(uint8_t blockno, uint8_t keytype, uint8_t *key, uint8_t sectors, uint32_t nonces_per_target, bool slow, bool write_only) {
+
+    char *base = GenerateFilename("hf-mf-", "-nonces");
+    if (base == NULL) {
+        return PM3_EFILE;
+    }
+
+    uint8_t targets[HARDNESTED_MULTI_MAX_TARGETS * 2];
+    char names[HARDNESTED_MULTI_MAX_TARGETS][FILE_PATH_SIZE];
+    char *pnames[HARDNESTED_MULTI_MAX_TARGETS];
+    uint8_t cnt = 0;
+
+    for (uint8_t s = 0; s < sectors; s++) {
+        for (uint8_t k = MF_KEY_A; k <= MF_KEY_B && cnt < HARDNESTED_MULTI_MAX_TARGETS; k++) {
+            // the key we already have
+            if (s == mfSectorNum(blockno) && k == keytype) {
+                continue;
+            }
+            targets[cnt * 2] = mfFirstBlockOfSector(s);
+            targets[(cnt * 2) + 1] = k;
+            snprintf(names[cnt], FILE_PATH_SIZE, "%s-%03u-%c.bin", base, targets[cnt * 2], (k == MF_KEY_B) ? 'B' : 'A');
+            pnames[cnt] = names[cnt];
+            cnt++;
+        }
+    }
+    free(base);
+
+    PrintAndLogEx(INFO, "Acquiring " _YELLOW_("%u") " nonces for each of " _YELLOW_("%u") " targets", nonces_per_target, cnt);
+    int res = mfnestedhard_acquire_multi(blockno, keytype, key, targets, cnt, nonces_per_target, slow, pnames);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Nonce acquisition failed ( %d )", res);
+        return res;
+    }
+
+    if (write_only) {
+        for (uint8_t i = 0; i < cnt; i++) {
+            PrintAndLogEx(SUCCESS, "Wrote `" _YELLOW_("%s") "`", names[i]);
+        }
+        PrintAndLogEx(HINT, "Hint: Solve each with `" _YELLOW_("hf mf hardnested -r -f <file>") "`");
+        return PM3_SUCCESS;
+    }
+
+    uint64_t keys[HARDNESTED_MULTI_MAX_TARGETS] = {0};
+    bool found[HARDNESTED_MULTI_MAX_TARGETS] = {0};
+    for (uint8_t i = 0; i < cnt; i++) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "--- " _CYAN_("Target block %3u key %c") " ---------------------------", targets[i * 2], (targets[(i * 2) + 1] == MF_KEY_B) ? 'B' : 'A');
+        res = mfnestedhard(blockno, keytype, key, targets[i * 2], targets[(i * 2) + 1], NULL, true, false, slow, 0, &keys[i], names[i]);
+        if (res == PM3_EOPABORTED) {
+            break;
+        }
+        found[i] = (res == PM3_SUCCESS);
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    for (uint8_t i = 0; i < cnt; i++) {
+        if (found[i]) {
+            PrintAndLogEx(SUCCESS, "Target block %3u key %c -- found valid key [ " _GREEN_("%012" PRIX64) " ]", targets[i * 2], (targets[(i * 2) + 1] == MF_KEY_B) ? 'B' : 'A', keys[i]);
+        } else {
+            PrintAndLogEx(FAILED, "Target block %3u key %c -- " _RED_("not found") ", nonces in `%s`", targets[i * 2], (targets[(i * 2) + 1] == MF_KEY_B) ? 'B' : 'A', names[i]);
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 static int CmdHF14AMfNestedHard(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -2622,6 +2935,9 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                   " or \n"
                   "    hf mf hardnested -r --tk [known target key]\n"
                   "Add the known target key to check if it is present in the remaining key space\n"
+                  " \n"
+                  "`--shard <i> --shards <n>` splits the brute force over n hosts. Copy the nonce file\n"
+                  "to every host and run `-r` with a different shard on each, one of them reports the key.\n"
                   "    hf mf hardnested --blk 0 -a -k A0A1A2A3A4A5 --tblk 4 --ta --tk FFFFFFFFFFFF\n"
                   ,
                   "hf mf hardnested --tblk 4 --ta     --> works for MFC EV1\n"
@@ -2631,6 +2947,10 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                   "hf mf hardnested -r\n"
                   "hf mf hardnested -r --tk a0a1a2a3a4a5\n"
                   "hf mf hardnested -t --tk a0a1a2a3a4a5\n"
+                  "hf mf hardnested -r --shard 2 --shards 4   --> brute force the 2nd quarter of the key space\n"
+                  "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta -p   --> brute force during acquisition\n"
+                  "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --sectors 16       --> nonces of all keys in one go, then solve each\n"
+                  "hf mf hardnested -r --lowmem                --> small hosts, bitarrays file backed in the user directory\n"
                   "hf mf hardnested --blk 0 -a -k a0a1a2a3a4a5 --tblk 4 --ta --tk FFFFFFFFFFFF\n"
                  );
 
@@ -2650,6 +2970,12 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         arg_lit0("s",  "slow",           "Slower acquisition (required by some non standard cards)"),
         arg_lit0("t",  "tests",          "Run tests"),
         arg_lit0("w",  "wr",             "Acquire nonces and UID, and write them to file `hf-mf-<UID>-nonces.bin`"),
+        arg_int0(NULL, "shard", "<dec>", "Brute force only this shard, 1..<shards> (def 1)"),   // 15
+        arg_int0(NULL, "shards", "<dec>", "Number of shards the brute force is split into (def 1)"),
+        arg_lit0("p",  "pipe",           "Start brute forcing on spare time while nonces are still acquired"),
+        arg_int0(NULL, "sectors", "<dec>", "Acquire nonces for key A and B of sectors 0..<dec>-1 in one field session"),  // 18
+        arg_int0(NULL, "nonces", "<dec>", "Nonces per target with --sectors (def 2000)"),
+        arg_lit0(NULL, "lowmem",         "Bound memory use, for small hosts. Slower, writes scratch data to the user directory"),  // 20
 
         arg_lit0(NULL, "in", "None (use CPU regular instruction set)"),
 #if defined(COMPILER_HAS_SIMD_X86)
@@ -2663,6 +2989,9 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
         arg_lit0(NULL, "ie", "NEON"),
+#endif
+#if defined(HAVE_OPENCL)
+        arg_lit0(NULL, "icl", "OpenCL (brute force on GPU)"),
 #endif
         arg_param_end
     };
@@ -2711,18 +3040,28 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
     bool tests = arg_get_lit(ctx, 13);
     bool nonce_file_write = arg_get_lit(ctx, 14);
 
-    bool in = arg_get_lit(ctx, 15);
+    uint32_t shard = arg_get_u32_def(ctx, 15, 1);
+    uint32_t shards = arg_get_u32_def(ctx, 16, 1);
+    bool pipe = arg_get_lit(ctx, 17);
+    uint32_t sectors = arg_get_u32_def(ctx, 18, 0);
+    uint32_t nonces_per_target = arg_get_u32_def(ctx, 19, 2000);
+    bool lowmem = arg_get_lit(ctx, 20);
+
+    bool in = arg_get_lit(ctx, 21);
 #if defined(COMPILER_HAS_SIMD_X86)
-    bool im = arg_get_lit(ctx, 16);
-    bool is = arg_get_lit(ctx, 17);
-    bool ia = arg_get_lit(ctx, 18);
-    bool i2 = arg_get_lit(ctx, 19);
+    bool im = arg_get_lit(ctx, 22);
+    bool is = arg_get_lit(ctx, 23);
+    bool ia = arg_get_lit(ctx, 24);
+    bool i2 = arg_get_lit(ctx, 25);
 #endif
 #if defined(COMPILER_HAS_SIMD_AVX512)
-    bool i5 = arg_get_lit(ctx, 20);
+    bool i5 = arg_get_lit(ctx, 26);
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
-    bool ie = arg_get_lit(ctx, 16);
+    bool ie = arg_get_lit(ctx, 22);
+#endif
+#if defined(HAVE_OPENCL)
+    bool icl = arg_get_lit(ctx, ARRAYLEN(argtable) - 2);
 #endif
     CLIParserFree(ctx);
 
@@ -2750,19 +3089,40 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         SetSIMDInstr(SIMD_NEON);
 #endif
 
+#if defined(HAVE_OPENCL)
+    if (icl)
+        SetSIMDInstr(SIMD_OPENCL);
+#endif
+
     if (in) {
         SetSIMDInstr(SIMD_NONE);
     }
 
     // santiy checks
-    if ((g_session.pm3_present == false) && (tests == false)) {
+    if (shards == 0 || shard == 0 || shard > shards) {
+        PrintAndLogEx(WARNING, "Shard must be in 1..%u", (shards) ? shards : 1);
+        return PM3_EINVARG;
+    }
+
+    if (shards > 1 && nonce_file_read == false && tests == false) {
+        PrintAndLogEx(WARNING, "Sharding needs the nonces from file, use `-r`");
+        return PM3_EINVARG;
+    }
+
+    if (sectors && (nonce_file_read || tests || (sectors * 2) > HARDNESTED_MULTI_MAX_TARGETS + 1)) {
+        PrintAndLogEx(WARNING, "--sectors takes 1..%u and can't be combined with `-r` or `-t`", (HARDNESTED_MULTI_MAX_TARGETS + 1) / 2);
+        return PM3_EINVARG;
+    }
+
+    // a shard host only needs the nonce file
+    if ((g_session.pm3_present == false) && (tests == false) && (nonce_file_read == false)) {
         PrintAndLogEx(INFO, "No device connected");
         return PM3_EFAILED;
     }
 
     bool known_target_key = (trg_keylen);
 
-    if (nonce_file_read) {
+    if (nonce_file_read && fnlen == 0) {
         char *fptr = GenerateFilename("hf-mf-", "-nonces.bin");
         if (fptr == NULL)
             strncpy(filename, "nonces.bin", FILE_PATH_SIZE - 1);
@@ -2771,7 +3131,7 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         free(fptr);
     }
 
-    if (nonce_file_write) {
+    if (nonce_file_write && fnlen == 0 && sectors == 0) {
         char *fptr = GenerateFilename("hf-mf-", "-nonces.bin");
         if (fptr == NULL) {
             return PM3_EFILE;
@@ -2814,6 +3174,13 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         }
     }
 
+    if (sectors) {
+        hardnested_set_lowmem(lowmem);
+        int res = mf_hardnested_sectors(blockno, keytype, key, sectors, nonces_per_target, slow, nonce_file_write);
+        hardnested_set_lowmem(false);
+        return res;
+    }
+
     PrintAndLogEx(INFO, "Target block no " _YELLOW_("%3d") " target key type: " _YELLOW_("%c") " known target key: " _YELLOW_("%02x%02x%02x%02x%02x%02x%s"),
                   trg_blockno,
                   (trg_keytype == MF_KEY_B) ? 'B' : 'A',
@@ -2825,8 +3192,18 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                   slow ? "Yes" : "No",
                   tests);
 
+    if (shards > 1) {
+        PrintAndLogEx(INFO, "Shard " _YELLOW_("%u") " of " _YELLOW_("%u"), shard, shards);
+    }
+
     uint64_t foundkey = 0;
+    brute_force_set_shard(shard - 1, shards);
+    hardnested_set_pipelined(pipe);
+    hardnested_set_lowmem(lowmem);
     int16_t isOK = mfnestedhard(blockno, keytype, key, trg_blockno, trg_keytype, known_target_key ? trg_key : NULL, nonce_file_read, nonce_file_write, slow, tests, &foundkey, filename);
+    hardnested_set_pipelined(false);
+    hardnested_set_lowmem(false);
+    brute_force_set_shard(0, 1);
     switch (isOK) {
         case PM3_ETIMEOUT :
             PrintAndLogEx(ERR, "Error: No response from Proxmark3\n");
@@ -2840,6 +3217,9 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
             break;
         case PM3_EFAILED: {
             PrintAndLogEx(FAILED, "\nFailed to recover a key...");
+            if (shards > 1) {
+                PrintAndLogEx(HINT, "Hint: the key isn't in shard %u, check the other hosts", shard);
+            }
             break;
         }
         default :
@@ -2852,6 +3232,58 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
     return isOK;
 }
 
+// Nested attack for autopwn. The nonces of the next key still unknown are collected while the
+// current ones are solved on the host, and solved while the current candidates are checked on
+// the device, so neither side waits on the other. `next` carries that prefetch between calls,
+// it is dropped on any failure and must be discarded by the caller when done.
+static int mf_nested_pipelined(const sector_t *e_sector, uint8_t sector_cnt, uint8_t blockNo, uint8_t keyType, uint8_t *key,
+                               uint8_t trgSector, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate, mf_nested_job_t *next) {
+
+    uint8_t trgBlockNo = mfFirstBlockOfSector(trgSector);
+
+    // the prefetched key was found some other way meanwhile
+    if (next->active && e_sector[mfSectorNum(next->nonces.block)].foundKey[next->nonces.keytype]) {
+        mf_nested_job_discard(next);
+    }
+
+    mf_nested_job_t cur = {0};
+    if (next->active && next->nonces.block == trgBlockNo && next->nonces.keytype == trgKeyType) {
+        cur = *next;
+        memset(next, 0, sizeof(mf_nested_job_t));
+    } else {
+        int res = mf_nested_acquire(blockNo, keyType, key, trgBlockNo, trgKeyType, calibrate, &cur.nonces);
+        if (res != PM3_SUCCESS) {
+            mf_nested_job_discard(next);
+            return res;
+        }
+        mf_nested_job_start(&cur);
+    }
+
+    // prefetch the next unknown key
+    for (uint8_t s = trgSector; next->active == false && s < sector_cnt; s++) {
+        for (uint8_t k = (s == trgSector) ? trgKeyType + 1 : MF_KEY_A; k <= MF_KEY_B; k++) {
+            if (e_sector[s].foundKey[k]) {
+                continue;
+            }
+            if (mf_nested_acquire(blockNo, keyType, key, mfFirstBlockOfSector(s), k, false, &next->nonces) == PM3_SUCCESS) {
+                mf_nested_job_start(next);
+            }
+            // failed or not, try again when it's that key's turn
+            break;
+        }
+    }
+
+    int res = mf_nested_job_wait(&cur);
+    if (res == PM3_SUCCESS) {
+        res = mf_nested_verify(&cur.nonces, cur.statelists, resultKey);
+    }
+
+    if (res != PM3_SUCCESS) {
+        mf_nested_job_discard(next);
+    }
+    return res;
+}
+
 static int CmdHF14AMfAutoPWN(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -2861,7 +3293,9 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
                   "If all keys are found, it try dumping card content both to file and emulator memory.\n"
                   "\n"
                   "default file name template is `hf-mf-<uid>-<dump|key>.`\n"
-                  "using suffix the template becomes `hf-mf-<uid>-<dump|key>-<suffix>.` \n",
+                  "using suffix the template becomes `hf-mf-<uid>-<dump|key>-<suffix>.` \n"
+                  "Recovered keys are journaled to `hf-mf-<uid>-key.journal` as they are found,\n"
+                  "an interrupted run continues from there. The journal is removed once all keys are saved.\n",
                   "hf mf autopwn\n"
                   "hf mf autopwn -s 0 -a -k FFFFFFFFFFFF     --> target MFC 1K card, Sector 0 with known key A 'FFFFFFFFFFFF'\n"
                   "hf mf autopwn --1k -f mfc_default_keys    --> target MFC 1K card, default dictionary\n"
@@ -2875,7 +3309,7 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
         arg_int0("s",  "sector", "<dec>",  "Input sector number"),
         arg_lit0("a",   NULL,              "Input key A (def)"),
         arg_lit0("b",   NULL,              "Input key B"),
-        arg_str0("f",  "file",    "<fn>",  "filename of dictionary"),
+        arg_strn("f",  "file",    "<fn>", 0, MF_DICT_MAX_FILES, "filename of dictionary, more than one are merged"),
         arg_str0(NULL, "suffix",  "<txt>", "Add this suffix to generated files"),
         arg_lit0(NULL, "slow",             "Slower acquisition (required by some non standard cards)"),
         arg_lit0("l",  "legacy",           "legacy mode (use the slow `hf mf chk`)"),
@@ -2883,6 +3317,7 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
         arg_lit0(NULL, "mem", "Use dictionary from flashmemory"),
 
         arg_lit0(NULL, "ns", "No save to file"),
+        arg_lit0(NULL, "rank", "Try keys listed by more of the dictionaries first"),
 
         arg_lit0(NULL, "mini", "MIFARE Classic Mini / S20"),
         arg_lit0(NULL, "1k", "MIFARE Classic 1k / S50 (default)"),
@@ -2901,6 +3336,9 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
         arg_lit0(NULL, "ie", "NEON"),
+#endif
+#if defined(HAVE_OPENCL)
+        arg_lit0(NULL, "icl", "OpenCL (brute force on GPU)"),
 #endif
         arg_param_end
     };
@@ -2921,9 +3359,11 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
         keytype = MF_KEY_B;
     }
 
-    int fnlen = 0;
-    char filename[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    mf_dict_files_t files;
+    if (mf_dict_files_get(ctx, 5, &files) != PM3_SUCCESS) {
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
 
     int outfnlen = 0;
     char outfilename[FILE_PATH_SIZE] = {0};
@@ -2935,24 +3375,28 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
     bool use_flashmemory = arg_get_lit(ctx, 10);
 
     bool no_save = arg_get_lit(ctx, 11);
+    bool rank = arg_get_lit(ctx, 12);
 
-    bool m0 = arg_get_lit(ctx, 12);
-    bool m1 = arg_get_lit(ctx, 13);
-    bool m2 = arg_get_lit(ctx, 14);
-    bool m4 = arg_get_lit(ctx, 15);
+    bool m0 = arg_get_lit(ctx, 13);
+    bool m1 = arg_get_lit(ctx, 14);
+    bool m2 = arg_get_lit(ctx, 15);
+    bool m4 = arg_get_lit(ctx, 16);
 
-    bool in = arg_get_lit(ctx, 16);
+    bool in = arg_get_lit(ctx, 17);
 #if defined(COMPILER_HAS_SIMD_X86)
-    bool im = arg_get_lit(ctx, 17);
-    bool is = arg_get_lit(ctx, 18);
-    bool ia = arg_get_lit(ctx, 19);
-    bool i2 = arg_get_lit(ctx, 20);
+    bool im = arg_get_lit(ctx, 18);
+    bool is = arg_get_lit(ctx, 19);
+    bool ia = arg_get_lit(ctx, 20);
+    bool i2 = arg_get_lit(ctx, 21);
 #endif
 #if defined(COMPILER_HAS_SIMD_AVX512)
-    bool i5 = arg_get_lit(ctx, 21);
+    bool i5 = arg_get_lit(ctx, 22);
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
-    bool ie = arg_get_lit(ctx, 17);
+    bool ie = arg_get_lit(ctx, 18);
+#endif
+#if defined(HAVE_OPENCL)
+    bool icl = arg_get_lit(ctx, ARRAYLEN(argtable) - 2);
 #endif
 
     CLIParserFree(ctx);
@@ -3010,6 +3454,11 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
         SetSIMDInstr(SIMD_NEON);
 #endif
 
+#if defined(HAVE_OPENCL)
+    if (icl)
+        SetSIMDInstr(SIMD_OPENCL);
+#endif
+
     if (in) {
         SetSIMDInstr(SIMD_NONE);
     }
@@ -3130,29 +3579,6 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
         memcpy(key, in_keys, sizeof(key));
     }
 
-    // Add KDF keys...
-    uint16_t key1_offset = in_keys_len;
-    uint64_t key1 = 0;
-
-    // iceman: todo, need to add all generated keys
-    mfc_algo_mizip_one(card.uid, 0, MF_KEY_A, &key1);
-    num_to_bytes(key1, MIFARE_KEY_SIZE, in_keys + key1_offset + (0 * MIFARE_KEY_SIZE));
-
-    mfc_algo_di_one(card.uid, 0, MF_KEY_A, &key1);
-    num_to_bytes(key1, MIFARE_KEY_SIZE, in_keys + key1_offset + (1 * MIFARE_KEY_SIZE));
-
-    mfc_algo_sky_one(card.uid, 15, MF_KEY_A, &key1);
-    num_to_bytes(key1, MIFARE_KEY_SIZE, in_keys + key1_offset + (2 * MIFARE_KEY_SIZE));
-
-    // one key
-    mfc_algo_saflok_one(card.uid, 0, MF_KEY_A, &key1);
-    num_to_bytes(key1, MIFARE_KEY_SIZE, in_keys + key1_offset + (3 * MIFARE_KEY_SIZE));
-
-    mfc_algo_touch_one(card.uid, 0, MF_KEY_A, &key1);
-    num_to_bytes(key1, MIFARE_KEY_SIZE, in_keys + key1_offset + (4 * MIFARE_KEY_SIZE));
-
-    in_keys_len += (MIFARE_KEY_SIZE * 5);
-
     // detect MFC EV1 Signature
     bool is_ev1 = detect_mfc_ev1_signature();
     if (is_ev1) {
@@ -3165,14 +3591,14 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
 
     // check if we can authenticate to sector
     uint8_t loopupblk = mfFirstBlockOfSector(sectorno);
-    if (mf_check_keys(loopupblk, keytype, true, (in_keys_len / MIFARE_KEY_SIZE), in_keys, &key64) != PM3_SUCCESS) {
+    if (known_key && mf_check_keys(loopupblk, keytype, true, (in_keys_len / MIFARE_KEY_SIZE), in_keys, &key64) != PM3_SUCCESS) {
         if (keytype < 2) {
             PrintAndLogEx(WARNING, "Known key failed. Can't authenticate to block %3d key type %c", loopupblk, keytype ? 'B' : 'A');
         } else {
             PrintAndLogEx(WARNING, "Known key failed. Can't authenticate to block %3d key type %02x", loopupblk, MIFARE_AUTH_KEYA + keytype);
         }
         known_key = false;
-    } else {
+    } else if (known_key) {
         num_to_bytes(key64, MIFARE_KEY_SIZE, key);
     }
 
@@ -3204,6 +3630,17 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
     }
     char *fptr = GenerateFilename("hf-mf-", suffix);
 
+    // every recovered key is journaled right away, an interrupted run picks them up again
+    char journal[FILE_PATH_SIZE] = {0};
+    const char *pjournal = NULL;
+    if (no_save == false && fptr != NULL) {
+        char base[FILE_PATH_SIZE] = {0};
+        snprintf(base, sizeof(base), "%.*s", (int)(strlen(fptr) - (str_endswith(fptr, ".bin") ? 4 : 0)), fptr);
+        if (mfcKeyJournalName(base, journal, sizeof(journal)) == PM3_SUCCESS) {
+            pjournal = journal;
+        }
+    }
+
     // check if tag doesn't have static nonce
     int has_staticnonce = detect_classic_static_nonce();
 
@@ -3254,7 +3691,12 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
             }
         }
 
-        PrintAndLogEx(INFO, "Dictionary .... " _YELLOW_("%s"), strlen(filename) ? filename : "n/a");
+        if (files.count == 0) {
+            PrintAndLogEx(INFO, "Dictionary .... n/a");
+        }
+        for (int i = 0; i < files.count; i++) {
+            PrintAndLogEx(INFO, "Dictionary .... " _YELLOW_("%s"), files.name[i]);
+        }
         PrintAndLogEx(INFO, "Legacy mode ... %s", (legacy_mfchk) ? _YELLOW_("yes") : "no");
 
         PrintAndLogEx(INFO, "----------------------------------------------------------------");
@@ -3271,17 +3713,60 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
     // If we use the dictionary in flash memory, we don't want to load keys
     // from hard drive dictionary as it could exceed BigBuf capacity
     if (use_flashmemory) {
-        fnlen = 0;
+        files.count = 0;
     }
 
-    int ret = mf_load_keys(&keyBlock, &key_cnt, in_keys, in_keys_len, filename, fnlen, true);
+    int ret = mf_load_keys(&keyBlock, &key_cnt, in_keys, in_keys_len, &files, true, rank);
     if (ret != PM3_SUCCESS) {
         free(e_sector);
         return ret;
     }
 
+    // keys of the known key algorithms for this uid go first
+    if (use_flashmemory == false) {
+        ret = mf_keys_add_derived(&keyBlock, &key_cnt, in_keys_len / MIFARE_KEY_SIZE, card.uid, card.uidlen);
+        if (ret != PM3_SUCCESS) {
+            free(keyBlock);
+            free(e_sector);
+            return ret;
+        }
+    }
+
     res = PM3_SUCCESS;
 
+    // Resume from the keys an interrupted run has journaled
+    uint8_t num_resumed_keys = 0;
+    size_t journal_cnt = 0;
+    if (pjournal && loadMfcKeyJournal(pjournal, sector_cnt, e_sector, &journal_cnt) == PM3_SUCCESS && journal_cnt) {
+        for (int i = 0; i < sector_cnt; i++) {
+            for (int j = MF_KEY_A; j <= MF_KEY_B; j++) {
+
+                if (e_sector[i].foundKey[j] == 0) {
+                    continue;
+                }
+
+                // the card may not be the same, only keep what still authenticates
+                uint8_t jkey[MIFARE_KEY_SIZE];
+                num_to_bytes(e_sector[i].Key[j], MIFARE_KEY_SIZE, jkey);
+                if (mf_check_keys(mfFirstBlockOfSector(i), j, true, 1, jkey, &key64) != PM3_SUCCESS) {
+                    e_sector[i].Key[j] = 0xffffffffffff;
+                    e_sector[i].foundKey[j] = 0;
+                    continue;
+                }
+
+                ++num_resumed_keys;
+
+                if (known_key == false) {
+                    memcpy(key, jkey, sizeof(key));
+                    known_key = true;
+                    sectorno = i;
+                    keytype = j;
+                }
+            }
+        }
+        PrintAndLogEx(SUCCESS, "Resumed " _GREEN_("%u") " of %zu keys from journal `" _YELLOW_("%s") "`", num_resumed_keys, journal_cnt, pjournal);
+    }
+
     // Use the dictionary to find sector keys on the card
     if (verbose) {
         PrintAndLogEx(INFO, "--- " _CYAN_("Enter dictionary recovery mode") " -----------------------------");
@@ -3315,46 +3800,13 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
             res = mf_check_keys_fast(sector_cnt, true, true, 1, key_cnt, keyBlock, e_sector, use_flashmemory, verbose);
         } else {
 
-            uint32_t chunksize = key_cnt > (PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE) ? (PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE) : key_cnt;
-            bool firstChunk = true, lastChunk = false;
-
-            for (uint8_t strategy = 1; strategy < 3; strategy++) {
-                PrintAndLogEx(INFO, "Running strategy %u", strategy);
-                // main keychunk loop
-                for (uint32_t i = 0; i < key_cnt; i += chunksize) {
-
-                    if (kbd_enter_pressed()) {
-                        PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
-                        i = key_cnt;
-                        strategy = 3;
-                        break; // Exit the loop
-                    }
-
-                    uint32_t size = ((key_cnt - i)  > chunksize) ? chunksize : key_cnt - i;
-                    // last chunk?
-                    if (size == key_cnt - i) {
-                        lastChunk = true;
-                    }
-
-                    res = mf_check_keys_fast(sector_cnt, firstChunk, lastChunk, strategy, size, keyBlock + (i * MIFARE_KEY_SIZE), e_sector, false, verbose);
-                    if (firstChunk) {
-                        firstChunk = false;
-                    }
-                    // all keys,  aborted
-                    if (res == PM3_SUCCESS) {
-                        i = key_cnt;
-                        strategy = 3;
-                        break; // Exit the loop
-                    }
-                } // end chunks of keys
-                firstChunk = true;
-                lastChunk = false;
-            } // end strategy
+            // the device keeps the dictionary and runs both strategies
+            res = mf_check_keys_session(sector_cnt, key_cnt, keyBlock, e_sector, verbose, false, 0);
         }
     }
 
     // Analyse the dictionary attack
-    uint8_t num_found_keys = 0;
+    uint8_t num_found_keys = num_resumed_keys;
     for (int i = 0; i < sector_cnt; i++) {
         for (int j = MF_KEY_A; j <= MF_KEY_B; j++) {
 
@@ -3365,6 +3817,7 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
             ++num_found_keys;
 
             e_sector[i].foundKey[j] = 'D';
+            appendMfcKeyJournal(pjournal, i, j, e_sector[i].Key[j], 'D');
             num_to_bytes(e_sector[i].Key[j], MIFARE_KEY_SIZE, tmp_key);
 
             // Store valid credentials for the nested / hardnested attack if none exist
@@ -3415,6 +3868,7 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
             num_to_bytes(key64, MIFARE_KEY_SIZE, key);
             e_sector[sectorno].Key[keytype] = key64;
             e_sector[sectorno].foundKey[keytype] = 'S';
+            appendMfcKeyJournal(pjournal, sectorno, keytype, key64, 'S');
             PrintAndLogEx(SUCCESS, "Target sector " _GREEN_("%3u") " key type "_GREEN_("%c") " -- found valid key [ " _GREEN_("%012" PRIX64) " ] (used for nested / hardnested attack)",
                           sectorno,
                           (keytype == MF_KEY_B) ? 'B' : 'A',
@@ -3424,7 +3878,7 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
 
 noValidKeyFound:
             PrintAndLogEx(FAILED, "No usable key was found!");
-            if (use_flashmemory == false && fnlen == 0) {
+            if (use_flashmemory == false && files.count == 0) {
                 PrintAndLogEx(HINT, "Hint: Try `" _YELLOW_("hf mf autopwn -f mfc_default_keys")"`  i.e. the Randy special");
             }
 
@@ -3445,6 +3899,7 @@ noValidKeyFound:
     // Clear the needed variables
     num_to_bytes(0, MIFARE_KEY_SIZE, tmp_key);
     bool nested_failed = false;
+    mf_nested_job_t nested_next = {0};
 
     // Iterate over each sector and key(A/B)
     for (current_sector_i = 0; current_sector_i < sector_cnt; current_sector_i++) {
@@ -3473,6 +3928,7 @@ noValidKeyFound:
                             if (mf_check_keys(mfFirstBlockOfSector(i), j, true, 1, tmp_key, &key64) == PM3_SUCCESS) {
                                 e_sector[i].Key[j] = bytes_to_num(tmp_key, MIFARE_KEY_SIZE);
                                 e_sector[i].foundKey[j] = 'R';
+                                appendMfcKeyJournal(pjournal, i, j, e_sector[i].Key[j], 'R');
                                 PrintAndLogEx(SUCCESS, "Target sector " _GREEN_("%3u") " key type " _GREEN_("%c") " -- found valid key [ " _GREEN_("%s") " ]",
                                               i,
                                               (j == MF_KEY_B) ? 'B' : 'A',
@@ -3518,6 +3974,7 @@ noValidKeyFound:
                         if (key64) {
                             e_sector[current_sector_i].foundKey[current_key_type_i] = 'A';
                             e_sector[current_sector_i].Key[current_key_type_i] = key64;
+                            appendMfcKeyJournal(pjournal, current_sector_i, current_key_type_i, key64, 'A');
                             num_to_bytes(key64, MIFARE_KEY_SIZE, tmp_key);
                             PrintAndLogEx(SUCCESS, "Target sector " _GREEN_("%3u") " key type " _GREEN_("%c") " -- found valid key [ " _GREEN_("%s") " ]",
                                           current_sector_i,
@@ -3557,7 +4014,7 @@ skipReadBKey:
                                           (current_key_type_i == MF_KEY_B) ? 'B' : 'A');
                         }
 tryNested:
-                        isOK = mf_nested(mfFirstBlockOfSector(sectorno), keytype, key, mfFirstBlockOfSector(current_sector_i), current_key_type_i, tmp_key, calibrate);
+                        isOK = mf_nested_pipelined(e_sector, sector_cnt, mfFirstBlockOfSector(sectorno), keytype, key, current_sector_i, current_key_type_i, tmp_key, calibrate, &nested_next);
 
                         switch (isOK) {
                             case PM3_ETIMEOUT: {
@@ -3722,6 +4179,9 @@ tryStaticnested:
 
                     // Check if the key was found
                     if (e_sector[current_sector_i].foundKey[current_key_type_i]) {
+                        appendMfcKeyJournal(pjournal, current_sector_i, current_key_type_i,
+                                            e_sector[current_sector_i].Key[current_key_type_i],
+                                            e_sector[current_sector_i].foundKey[current_key_type_i]);
                         PrintAndLogEx(SUCCESS, "Target sector " _GREEN_("%3u") " key type " _GREEN_("%c") " -- found valid key [ " _GREEN_("%s") " ]",
                                       current_sector_i,
                                       (current_key_type_i == MF_KEY_B) ? 'B' : 'A',
@@ -3733,6 +4193,8 @@ tryStaticnested:
         }
     }
 
+    mf_nested_job_discard(&nested_next);
+
 all_found:
 
     // Show the results to the user
@@ -3744,6 +4206,15 @@ all_found:
         PrintAndLogEx(NORMAL, "");
         if (createMfcKeyDump(fptr, sector_cnt, e_sector) != PM3_SUCCESS) {
             PrintAndLogEx(ERR, "Failed to save keys to file");
+        } else if (pjournal && fileExists(pjournal)) {
+            // once every key is in the key file there is nothing left to resume
+            bool all_keys = true;
+            for (int i = 0; i < sector_cnt; i++) {
+                all_keys &= (e_sector[i].foundKey[MF_KEY_A] && e_sector[i].foundKey[MF_KEY_B]);
+            }
+            if (all_keys) {
+                remove(pjournal);
+            }
         }
     }
 
@@ -3842,7 +4313,8 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
                   "hf mf fchk --1k -f mfc_default_keys.dic        --> Target 1K using default dictionary file\n"
                   "hf mf fchk --1k --emu                          --> Target 1K, write keys to emulator memory\n"
                   "hf mf fchk --1k --dump                         --> Target 1K, write keys to file\n"
-                  "hf mf fchk --1k --mem                          --> Target 1K, use dictionary from flash memory");
+                  "hf mf fchk --1k --mem                          --> Target 1K, use dictionary from flash memory\n"
+                  "hf mf fchk --1k -f a.dic -f b.dic --rank       --> Target 1K, merge two dictionaries, shared keys first");
 
     void *argtable[] = {
         arg_param_begin,
@@ -3854,11 +4326,12 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
         arg_lit0(NULL, "emu", "Fill simulator keys from found keys"),
         arg_lit0(NULL, "dump", "Dump found keys to binary file"),
         arg_lit0(NULL, "mem", "Use dictionary from flashmemory"),
-        arg_str0("f", "file", "<fn>", "filename of dictionary"),
+        arg_strn("f", "file", "<fn>", 0, MF_DICT_MAX_FILES, "filename of dictionary, more than one are merged"),
         arg_int0(NULL, "blk", "<dec>", "block number (single block recovery mode)"),
         arg_lit0("a", NULL, "single block recovery key A"),
         arg_lit0("b", NULL, "single block recovery key B"),
         arg_lit0(NULL, "no-default", "Skip check default keys"),
+        arg_lit0(NULL, "rank", "Try keys listed by more of the dictionaries first"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -3876,9 +4349,11 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
     bool createDumpFile = arg_get_lit(ctx, 7);
     bool use_flashmemory = arg_get_lit(ctx, 8);
 
-    int fnlen = 0;
-    char filename[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 9), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    mf_dict_files_t files;
+    if (mf_dict_files_get(ctx, 9, &files) != PM3_SUCCESS) {
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
 
     int blockn = arg_get_int_def(ctx, 10, -1);
     uint8_t keytype = MF_KEY_A;
@@ -3890,6 +4365,7 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
         keytype = MF_KEY_B;
     }
     bool load_default = ! arg_get_lit(ctx, 13);
+    bool rank = arg_get_lit(ctx, 14);
 
     CLIParserFree(ctx);
 
@@ -3921,13 +4397,25 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
     // If we use the dictionary in flash memory, we don't want to load keys
     // from hard drive dictionary as it could exceed BigBuf capacity
     if (use_flashmemory) {
-        fnlen = 0;
+        files.count = 0;
     }
-    int ret = mf_load_keys(&keyBlock, &keycnt, key, keylen, filename, fnlen, load_default);
+    int ret = mf_load_keys(&keyBlock, &keycnt, key, keylen, &files, load_default, rank);
     if (ret != PM3_SUCCESS) {
         return ret;
     }
 
+    // the dictionary in flash memory is used as is
+    mfc_keystats_ctx_t kctx;
+    mf_keystats_prepare(&kctx, sectorsCnt, keyBlock, keycnt, keylen / MIFARE_KEY_SIZE, (use_flashmemory == false));
+
+    if (use_flashmemory == false && kctx.uidlen) {
+        ret = mf_keys_add_derived(&keyBlock, &keycnt, keylen / MIFARE_KEY_SIZE, kctx.uid, kctx.uidlen);
+        if (ret != PM3_SUCCESS) {
+            free(keyBlock);
+            return ret;
+        }
+    }
+
     // create/initialize key storage structure
     sector_t *e_sector = NULL;
     if (initSectorTable(&e_sector, sectorsCnt) != PM3_SUCCESS) {
@@ -3935,9 +4423,6 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
         return PM3_EMALLOC;
     }
 
-    uint32_t chunksize = (keycnt > (PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE)) ? (PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE) : keycnt;
-    bool firstChunk = true, lastChunk = false;
-
     int i = 0;
 
     // time
@@ -3951,54 +4436,11 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
         PrintAndLogEx(SUCCESS, "Using dictionary in flash memory");
         mf_check_keys_fast_ex(sectorsCnt, true, true, 1, keycnt, keyBlock, e_sector, use_flashmemory, false, false, singleSectorParams);
     } else {
-
-        // strategies. 1= deep first on sector 0 AB,  2= width first on all sectors
-        for (uint8_t strategy = 1; strategy < 3; strategy++) {
-            PrintAndLogEx(INFO, "Running strategy " _YELLOW_("%u"), strategy);
-
-            // main keychunk loop
-            for (i = 0; i < keycnt; i += chunksize) {
-
-                if (kbd_enter_pressed()) {
-                    clearCommandBuffer();
-                    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
-                    SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);   // field is still ON if not on last chunk
-                    PrintAndLogEx(NORMAL, "");
-                    PrintAndLogEx(WARNING, "\naborted via keyboard!");
-                    goto out;
-                }
-
-                uint32_t size = ((keycnt - i)  > chunksize) ? chunksize : keycnt - i;
-
-                // last chunk?
-                if (size == keycnt - i) {
-                    lastChunk = true;
-                }
-                int res = mf_check_keys_fast_ex(sectorsCnt, firstChunk, lastChunk, strategy, size, keyBlock + (i * MIFARE_KEY_SIZE), e_sector, false, false, true, singleSectorParams);
-                if (firstChunk)
-                    firstChunk = false;
-
-                // all keys,  aborted
-                if (res == PM3_SUCCESS || res == 2) {
-                    PrintAndLogEx(NORMAL, "");
-                    goto out;
-                }
-                PrintAndLogEx(INPLACE, "Testing %5i/%5i ( " _YELLOW_("%02.1f %%") " )", i, keycnt, (float)i * 100 / keycnt);
-            } // end chunks of keys
-
-            PrintAndLogEx(INPLACE, "Testing %5i/%5i ( " _YELLOW_("100 %%") " )  ", keycnt, keycnt);
-            PrintAndLogEx(NORMAL, "");
-
-            // reset chunks when swapping strategies
-            firstChunk = true;
-            lastChunk = false;
-
-            if (blockn != -1) {
-                break;
-            }
-        } // end strategy
+        // the device keeps the dictionary and runs both strategies, 1= deep first on sector 0 AB,  2= width first on all sectors
+        PrintAndLogEx(INFO, "Testing " _YELLOW_("%u") " keys", keycnt);
+        mf_check_keys_session(sectorsCnt, keycnt, keyBlock, e_sector, false, false, singleSectorParams);
+        PrintAndLogEx(NORMAL, "");
     }
-out:
     t1 = msclock() - t1;
     PrintAndLogEx(INFO, "Time in checkkeys (fast) " _YELLOW_("%.1fs") "\n", (float)(t1 / 1000.0));
 
@@ -4022,6 +4464,7 @@ out:
     } else {
 
         printKeyTable(sectorsCnt, e_sector);
+        mfc_keystats_record(&kctx, e_sector, sectorsCnt);
 
         if (use_flashmemory && found_keys == (sectorsCnt << 1)) {
             PrintAndLogEx(SUCCESS, "Card dumped as well. run " _YELLOW_("`%s %c`"),
@@ -4146,6 +4589,7 @@ static int CmdHF14AMfSmartBrute(const char *Cmd) {
     // initialize bruteforce engine
     generator_context_t bctx;
     bf_generator_init(&bctx, BF_MODE_SMART, BF_KEY_SIZE_48);
+    PrintAndLogEx(INFO, "Trying " _YELLOW_("%" PRIu64) " candidate keys", bf_generator_count(&bctx));
 
     int i = 0, ret;
     int smart_mode_stage = -1;
@@ -4285,6 +4729,111 @@ out:
     return PM3_SUCCESS;
 }
 
+// What the authentications of the tag in the trace tell about one key, see `hf mf chk --trace`
+typedef struct {
+    bool candidate;     // a dictionary key matches an authentication
+    bool absent;        // the tag answered an authentication no dictionary key matches
+    uint64_t key;
+} mf_chk_trace_t;
+
+// Tests the whole dictionary offline against the first authentications of the tag on the reader
+// found in the trace buffer. Matching keys are moved to the front of the dictionary.
+static int mf_chk_trace_prefilter(uint8_t *keyBlock, uint32_t keycnt, size_t sectors_cnt, mf_chk_trace_t trace[][2]) {
+
+    // the trace may hold several tags, only the one on the reader counts
+    uint8_t uid[10] = {0};
+    int uidlen = 0;
+    if (mf_read_uid(uid, &uidlen, NULL) != PM3_SUCCESS || uidlen < 4) {
+        PrintAndLogEx(WARNING, "no tag found, can't pick its authentications in the trace");
+        return PM3_ESOFT;
+    }
+    uint32_t cuid = bytes_to_num(uid + uidlen - 4, 4);
+
+    mf_trace_auth_t *auths = NULL;
+    size_t count = trace_mf_first_auths(&auths);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (auths[i].uid == cuid && mfSectorNum(auths[i].block) < sectors_cnt) {
+            auths[n++] = auths[i];
+        }
+    }
+    if (n == 0) {
+        PrintAndLogEx(INFO, "No authentications of this tag in the trace, checking the whole dictionary");
+        free(auths);
+        return PM3_SUCCESS;
+    }
+
+    uint64_t *keys = calloc(keycnt, sizeof(uint64_t));
+    if (keys == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(auths);
+        return PM3_EMALLOC;
+    }
+    for (uint32_t i = 0; i < keycnt; i++) {
+        keys[i] = bytes_to_num(keyBlock + (i * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+    }
+
+    uint64_t t1 = msclock();
+    size_t found = MifareTraceFindKeys(auths, n, keys, keycnt);
+    t1 = msclock() - t1;
+
+    // a key the tag accepted wins, then a tag answer no dictionary key matches, then the key a reader tried
+    for (int pass = 0; pass < 3; pass++) {
+        for (size_t i = 0; i < n; i++) {
+            const mf_trace_auth_t *a = &auths[i];
+            mf_chk_trace_t *t = &trace[mfSectorNum(a->block)][a->keytype];
+            if (pass == 0 && a->found && a->has_at) {
+                t->candidate = true;
+                t->key = a->key;
+            } else if (pass == 1 && a->found == false && a->has_at && t->candidate == false) {
+                t->absent = true;
+            } else if (pass == 2 && a->found && t->candidate == false && t->absent == false) {
+                t->candidate = true;
+                t->key = a->key;
+            }
+        }
+    }
+
+    // keys matching any authentication go first, tags often reuse them
+    uint64_t *hits = calloc(n, sizeof(uint64_t));
+    uint8_t *tmp = calloc(keycnt, MIFARE_KEY_SIZE);
+    if (hits && tmp) {
+        size_t hitcnt = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (auths[i].found) {
+                hits[hitcnt++] = auths[i].key;
+            }
+        }
+        qsort(hits, hitcnt, sizeof(uint64_t), compare_uint64);
+
+        uint32_t pos = 0;
+        for (int front = 1; front >= 0; front--) {
+            for (uint32_t i = 0; i < keycnt; i++) {
+                bool hit = (bsearch(&keys[i], hits, hitcnt, sizeof(uint64_t), compare_uint64) != NULL);
+                if (hit == (front == 1)) {
+                    memcpy(tmp + (pos++ * MIFARE_KEY_SIZE), keyBlock + (i * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+                }
+            }
+        }
+        memcpy(keyBlock, tmp, keycnt * MIFARE_KEY_SIZE);
+    }
+    free(tmp);
+    free(hits);
+    free(keys);
+    free(auths);
+
+    uint32_t absent = 0;
+    for (size_t i = 0; i < sectors_cnt; i++) {
+        absent += trace[i][0].absent + trace[i][1].absent;
+    }
+    PrintAndLogEx(INFO, "Trace, " _YELLOW_("%zu") " authentications of this tag, " _YELLOW_("%zu") " matched by the dictionary ( %.1f s )",
+                  n, found, (float)t1 / 1000.0);
+    if (absent) {
+        PrintAndLogEx(INFO, "Trace, " _YELLOW_("%u") " keys are not in the dictionary, they won't be checked", absent);
+    }
+    return PM3_SUCCESS;
+}
+
 static int CmdHF14AMfChk(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mf chk",
@@ -4295,7 +4844,9 @@ static int CmdHF14AMfChk(const char *Cmd) {
                   "hf mf chk --4k -k FFFFFFFFFFFF                --> Check all sectors, all keys against MIFARE 4k\n"
                   "hf mf chk --1k --emu                          --> Check all sectors, all keys, 1K, and write to emulator memory\n"
                   "hf mf chk --1k --dump                         --> Check all sectors, all keys, 1K, and write to file\n"
-                  "hf mf chk -a --tblk 0 -f mfc_default_keys.dic --> Check dictionary against block 0, key A");
+                  "hf mf chk -a --tblk 0 -f mfc_default_keys.dic --> Check dictionary against block 0, key A\n"
+                  "hf mf chk --1k -f a.dic -f b.dic --no-default --> Check two merged dictionaries, 1K\n"
+                  "hf mf chk --1k --trace                        --> Check only keys matching the authentications in the trace");
 
     void *argtable[] = {
         arg_param_begin,
@@ -4310,8 +4861,10 @@ static int CmdHF14AMfChk(const char *Cmd) {
         arg_lit0(NULL, "4k", "MIFARE Classic 4k / S70"),
         arg_lit0(NULL, "emu", "Fill simulator keys from found keys"),
         arg_lit0(NULL, "dump", "Dump found keys to binary file"),
-        arg_str0("f", "file", "<fn>", "Filename of dictionary"),
+        arg_strn("f", "file", "<fn>", 0, MF_DICT_MAX_FILES, "Filename of dictionary, more than one are merged"),
         arg_lit0(NULL, "no-default", "Skip check default keys"),
+        arg_lit0(NULL, "rank", "Try keys listed by more of the dictionaries first"),
+        arg_lit0(NULL, "trace", "Test the keys offline against the authentications in the trace first"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -4340,10 +4893,14 @@ static int CmdHF14AMfChk(const char *Cmd) {
     bool transferToEml = arg_get_lit(ctx, 10);
     bool createDumpFile = arg_get_lit(ctx, 11);
 
-    int fnlen = 0;
-    char filename[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 12), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    mf_dict_files_t files;
+    if (mf_dict_files_get(ctx, 12, &files) != PM3_SUCCESS) {
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
     bool load_default = ! arg_get_lit(ctx, 13);
+    bool rank = arg_get_lit(ctx, 14);
+    bool use_trace = arg_get_lit(ctx, 15);
 
     CLIParserFree(ctx);
 
@@ -4403,11 +4960,24 @@ static int CmdHF14AMfChk(const char *Cmd) {
 
     uint8_t *keyBlock = NULL;
     uint32_t keycnt = 0;
-    int res = mf_load_keys(&keyBlock, &keycnt, key, keylen, filename, fnlen, load_default);
+    int res = mf_load_keys(&keyBlock, &keycnt, key, keylen, &files, load_default, rank);
     if (res != PM3_SUCCESS) {
         return res;
     }
 
+    mfc_keystats_ctx_t kctx;
+    mf_keystats_prepare(&kctx, sectors_cnt, keyBlock, keycnt, keylen / MIFARE_KEY_SIZE, true);
+
+    mf_chk_trace_t trace[MIFARE_4K_MAXSECTOR][2];
+    memset(trace, 0, sizeof(trace));
+    if (use_trace) {
+        res = mf_chk_trace_prefilter(keyBlock, keycnt, sectors_cnt, trace);
+        if (res != PM3_SUCCESS) {
+            free(keyBlock);
+            return res;
+        }
+    }
+
     uint64_t key64 = 0;
 
     // create/initialize key storage structure
@@ -4442,7 +5012,20 @@ static int CmdHF14AMfChk(const char *Cmd) {
             // skip already found keys.
             if (e_sector[i].foundKey[trgKeyType]) continue;
 
-            for (uint32_t c = 0; c < keycnt; c += max_keys) {
+            // the key matching the trace, or none when the trace rules out the dictionary
+            bool done = trace[i][trgKeyType].absent;
+            if (trace[i][trgKeyType].candidate) {
+                uint8_t tkey[MIFARE_KEY_SIZE];
+                num_to_bytes(trace[i][trgKeyType].key, MIFARE_KEY_SIZE, tkey);
+                if (mf_check_keys(b, trgKeyType, clearLog, 1, tkey, &key64) == PM3_SUCCESS) {
+                    e_sector[i].Key[trgKeyType] = key64;
+                    e_sector[i].foundKey[trgKeyType] = true;
+                    done = true;
+                }
+                clearLog = false;
+            }
+
+            for (uint32_t c = 0; done == false && c < keycnt; c += max_keys) {
 
                 PrintAndLogEx(NORMAL, "." NOLF);
                 fflush(stdout);
@@ -4529,6 +5112,7 @@ out:
 //        printKeyTableEx(1, e_sector, mfSectorNum(blockNo));
 //    else
     printKeyTable(sectors_cnt, e_sector);
+    mfc_keystats_record(&kctx, e_sector, sectors_cnt);
 
     if (transferToEml) {
         // fast push mode
@@ -4674,6 +5258,7 @@ static int CmdHF14AMfSim(const char *Cmd) {
         arg_lit0(NULL, "allowover", "Allow auth attempts out of range for selected MIFARE Classic type"),
         arg_lit0("v", "verbose", "Verbose output"),
         arg_lit0(NULL, "cve", "Trigger CVE 2021_0430"),
+        arg_lit0(NULL, "ring", "Keep the newest frames when the trace is full, instead of the oldest"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -4735,6 +5320,10 @@ static int CmdHF14AMfSim(const char *Cmd) {
     if (arg_get_lit(ctx, 16)) {
         flags |= FLAG_CVE21_0430;
     }
+
+    if (arg_get_lit(ctx, 17)) {
+        flags |= FLAG_TRACE_RING;
+    }
     CLIParserFree(ctx);
 
     //Validations
@@ -4886,41 +5475,65 @@ static int CmdHF14AMfSim(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-/*
 static int CmdHF14AMfKeyBrute(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mf keybrute",
+                  "J_Run's 2nd phase of multiple sector nested authentication key recovery.\n"
+                  "You have a known 4 last bytes of a key recovered with mf_nonce_brute tool.\n"
+                  "First 2 bytes of key will be bruteforced.\n"
+                  "The next block of candidates is queued on the device while the current one is checked.\n"
+                  " ---[ This attack is obsolete, try hardnested instead ]---",
+                  "hf mf keybrute --blk 1 -k 000011223344\n"
+                  "hf mf keybrute --blk 1 -b -k 000011223344"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_int1(NULL, "blk", "<dec>", "target block number"),
+        arg_lit0("a", NULL, "target key type is key A (def)"),
+        arg_lit0("b", NULL, "target key type is key B"),
+        arg_str1("k", "key", "<hex>", "candidate key from mf_nonce_brute tool, 6 hex bytes"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+    int b = arg_get_int_def(ctx, 1, 0);
 
-    uint8_t blockNo = 0, keytype = MF_KEY_A;
-    uint8_t key[6] = {0, 0, 0, 0, 0, 0};
-    uint64_t foundkey = 0;
-
-    char cmdp = tolower(param_getchar(Cmd, 0));
-    if (cmdp == 'h') return usage_hf14_keybrute();
+    uint8_t keytype = MF_KEY_A;
+    if (arg_get_lit(ctx, 2) && arg_get_lit(ctx, 3)) {
+        CLIParserFree(ctx);
+        PrintAndLogEx(WARNING, "Choose one single input key type");
+        return PM3_EINVARG;
+    } else if (arg_get_lit(ctx, 3)) {
+        keytype = MF_KEY_B;
+    }
 
-    // block number
-    blockNo = param_get8(Cmd, 0);
+    int keylen = 0;
+    uint8_t key[6] = {0};
+    CLIGetHexWithReturn(ctx, 4, key, &keylen);
+    CLIParserFree(ctx);
 
-    // keytype
-    cmdp = tolower(param_getchar(Cmd, 1));
-    if (cmdp == 'b') keytype = MF_KEY_B;
+    if (keylen != 6) {
+        PrintAndLogEx(WARNING, "Key must be 12 hex digits. Got %d", keylen);
+        return PM3_EINVARG;
+    }
 
-    // key
-    int keylen = 0;
-    if (param_gethex_ex(Cmd, 2, key, &keylen) && (keylen != 12)) {
-        return usage_hf14_keybrute();
+    if (b > 255) {
+        return PM3_EINVARG;
     }
 
+    uint64_t foundkey = 0;
     uint64_t t1 = msclock();
 
-    if (mfKeyBrute(blockNo, keytype, key, &foundkey))
-        PrintAndLogEx(SUCCESS, "Found valid key [ %012" PRIX64 " ]\n", foundkey);
-    else
+    int res = mf_key_brute((uint8_t)b, keytype, key, &foundkey);
+    if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Found valid key [ " _GREEN_("%012" PRIX64) " ]", foundkey);
+    } else if (res == PM3_ESOFT) {
         PrintAndLogEx(FAILED, "key not found");
+    }
 
     t1 = msclock() - t1;
-    PrintAndLogEx(SUCCESS, "\ntime in keybrute " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
-    return PM3_SUCCESS;
+    PrintAndLogEx(SUCCESS, "time in keybrute " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
+    return (res == PM3_ESOFT) ? PM3_SUCCESS : res;
 }
-*/
 
 void printKeyTable(size_t sectorscnt, sector_t *e_sector) {
     printKeyTableEx(sectorscnt, e_sector, 0);
@@ -4982,6 +5595,13 @@ void printKeyTableEx(size_t sectorscnt, sector_t *e_sector, uint8_t start_sector
             s = i;
         }
 
+        uint8_t key[MIFARE_KEY_SIZE];
+        result_add_int("sector", s);
+        num_to_bytes(e_sector[i].Key[0], sizeof(key), key);
+        result_add_hex("key_a", (e_sector[i].foundKey[0]) ? key : NULL, sizeof(key));
+        num_to_bytes(e_sector[i].Key[1], sizeof(key), key);
+        result_add_hex("key_b", (e_sector[i].foundKey[1]) ? key : NULL, sizeof(key));
+
         char extra[24] = {0x00};
         if (sectorscnt == 18 && i > 15) {
             strcat(extra, "( " _MAGENTA_("*") " )");
@@ -5309,40 +5929,13 @@ int CmdHF14AMfELoad(const char *Cmd) {
         PrintAndLogEx(INFO, "MIFARE Ultralight override, will use " _YELLOW_("%d") " blocks ( " _YELLOW_("%u") " bytes )", block_cnt, block_cnt * block_width);
     }
 
-    PrintAndLogEx(INFO, "Uploading to emulator memory");
-    PrintAndLogEx(INFO, "." NOLF);
-
-    // fast push mode
-    g_conn.block_after_ACK = true;
-
-    size_t offset = 0;
-    int cnt = 0;
-
-    // 12 is the size of the struct the fct mf_eml_set_mem_xt uses to transfer to device
-    uint16_t max_avail_blocks = ((PM3_CMD_DATA_SIZE - 12) / block_width) * block_width;
-
-    while (bytes_read && cnt < block_cnt) {
-        if (bytes_read == block_width) {
-            // Disable fast mode on last packet
-            g_conn.block_after_ACK = false;
-        }
-
-        uint16_t chunk_size = MIN(max_avail_blocks, bytes_read);
-        uint16_t blocks_to_send = chunk_size / block_width;
-
-        if (mf_eml_set_mem_xt(data + offset, cnt, blocks_to_send, block_width) != PM3_SUCCESS) {
-            PrintAndLogEx(FAILED, "Can't set emulator mem at block: %3d", cnt);
-            free(data);
-            return PM3_ESOFT;
-        }
-        cnt += blocks_to_send;
-        offset += chunk_size;
-        bytes_read -= chunk_size;
-        PrintAndLogEx(NORMAL, "." NOLF);
-        fflush(stdout);
+    // whole blocks only, only the changed ones go over when the device still holds the last upload
+    int cnt = MIN(block_cnt, (int)(bytes_read / block_width));
+    if (mf_eml_upload(data, cnt, block_width) != PM3_SUCCESS) {
+        free(data);
+        return PM3_ESOFT;
     }
     free(data);
-    PrintAndLogEx(NORMAL, "");
 
     if (block_width == MFU_BLOCK_SIZE) {
         PrintAndLogEx(HINT, "Hint: You are ready to simulate. See `" _YELLOW_("hf mfu sim -h`") "`");
@@ -6321,27 +6914,9 @@ static int CmdHF14AMfCSave(const char *Cmd) {
     PrintAndLogEx(NORMAL, "");
 
     if (fill_emulator) {
-        PrintAndLogEx(INFO, "uploading to emulator memory");
-        PrintAndLogEx(INFO, "." NOLF);
-        // fast push mode
-        g_conn.block_after_ACK = true;
-        for (int i = 0; i < block_cnt; i += 5) {
-            if (i == block_cnt - 1) {
-                // Disable fast mode on last packet
-                g_conn.block_after_ACK = false;
-            }
-            if (mf_elm_set_mem(dump + (i * MFBLOCK_SIZE), i, 5) != PM3_SUCCESS) {
-                PrintAndLogEx(WARNING, "Can't set emul block: " _YELLOW_("%d"), i);
-            }
-            if (i % 64 == 0) {
-                PrintAndLogEx(NORMAL, "");
-                PrintAndLogEx(INFO, "" NOLF) ;
-            }
-            PrintAndLogEx(NORMAL, "." NOLF);
-            fflush(stdout);
+        if (mf_eml_upload(dump, block_cnt, MFBLOCK_SIZE) == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "uploaded " _YELLOW_("%d") " bytes to emulator memory", bytes);
         }
-        PrintAndLogEx(NORMAL, "");
-        PrintAndLogEx(SUCCESS, "uploaded " _YELLOW_("%d") " bytes to emulator memory", bytes);
     }
 
     // user supplied filename?
@@ -8960,25 +9535,23 @@ static int CmdHF14AGen4Load(const char *cmd) {
     PrintAndLogEx(INFO, "Copying to magic gen4 GTU MIFARE Classic " _GREEN_("%s"), s);
     PrintAndLogEx(INFO, "Block... %d - %d", start, end);
 
-    // copy to card
-    for (uint16_t blockno = start; blockno <= end; blockno++) {
+    // copy to card, in batches written and verified on the device in one field session
+    PrintAndLogEx(INFO, "" NOLF) ;
+    for (uint16_t blockno = start; blockno <= end; blockno += MFG4_WRITE_MAX_BLOCKS) {
 
-        // 4k writes can be long, so we split status each 64 block boundary.
-        if (blockno % 64 == 0 || blockno == start) {
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(INFO, "" NOLF) ;
-        }
         PrintAndLogEx(NORMAL, "." NOLF);
         fflush(stdout);
 
-        // write block
+        uint8_t count = MIN(MFG4_WRITE_MAX_BLOCKS, end - blockno + 1);
         uint8_t flags = 0 ;
         if (blockno == start) flags |= MAGIC_INIT ;
-        if (blockno == end)   flags |= MAGIC_OFF ;
+        if (blockno + count > end) flags |= MAGIC_OFF ;
 
-        int res = mfG4SetBlock(pwd, blockno, data + (blockno * MFBLOCK_SIZE), flags);
+        uint8_t failed = blockno;
+        int res = mfG4SetBlocks(pwd, blockno, count, data + (blockno * MFBLOCK_SIZE), flags, true, &failed);
         if (res !=  PM3_SUCCESS) {
-            PrintAndLogEx(WARNING, "Can't set magic card block: %d. error=%d", blockno, res);
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(WARNING, "Can't set magic card block: %d. error=%d", failed, res);
             PrintAndLogEx(HINT, "Hint: Verify your card size and try again or try another tag position");
             free(data);
             return PM3_ESOFT;
@@ -9308,41 +9881,11 @@ static int CmdHF14AGen4Save(const char *Cmd) {
     PrintAndLogEx(NORMAL, "");
 
     if (fill_emulator) {
-        PrintAndLogEx(INFO, "uploading to emulator memory");
-        PrintAndLogEx(INFO, "." NOLF);
-        // fast push mode
-        g_conn.block_after_ACK = true;
-
-        size_t offset = 0;
-        int cnt = 0;
-        uint16_t bytes_left = bytes ;
-
-        // 12 is the size of the struct the fct mf_eml_set_mem_xt uses to transfer to device
-        uint16_t max_avail_blocks = ((PM3_CMD_DATA_SIZE - 12) / MFBLOCK_SIZE) * MFBLOCK_SIZE;
-
-        while (bytes_left > 0 && cnt < block_cnt) {
-            if (bytes_left == MFBLOCK_SIZE) {
-                // Disable fast mode on last packet
-                g_conn.block_after_ACK = false;
-            }
-
-            uint16_t chunk_size = MIN(max_avail_blocks, bytes_left);
-            uint16_t blocks_to_send = chunk_size / MFBLOCK_SIZE;
-
-            if (mf_eml_set_mem_xt(dump + offset, cnt, blocks_to_send, MFBLOCK_SIZE) != PM3_SUCCESS) {
-                PrintAndLogEx(FAILED, "Can't set emulator mem at block: %3d", cnt);
-                free(dump);
-                return PM3_ESOFT;
-            }
-
-            cnt += blocks_to_send;
-            offset += chunk_size;
-            bytes_left -= chunk_size;
-            PrintAndLogEx(NORMAL, "." NOLF);
-            fflush(stdout);
+        if (mf_eml_upload(dump, block_cnt, MFBLOCK_SIZE) != PM3_SUCCESS) {
+            free(dump);
+            return PM3_ESOFT;
         }
 
-        PrintAndLogEx(NORMAL, "");
         PrintAndLogEx(SUCCESS, "uploaded " _YELLOW_("%d") " bytes to emulator memory", bytes);
     }
 
@@ -10327,7 +10870,7 @@ static int CmdHF14AMfInfo(const char *Cmd) {
     int sectorsCnt = 2;
     uint8_t *keyBlock = NULL;
     uint32_t keycnt = 0;
-    res = mf_load_keys(&keyBlock, &keycnt, key, MIFARE_KEY_SIZE * 2, NULL, 0, true);
+    res = mf_load_keys(&keyBlock, &keycnt, key, MIFARE_KEY_SIZE * 2, NULL, true, false);
     if (res != PM3_SUCCESS) {
         return res;
     }
@@ -10601,6 +11144,64 @@ out:
     return PM3_SUCCESS;
 }
 
+// All nT/{nT}/par_err of a FM11RF08S in one field session, optionally with the data blocks
+static int mf_fm11rf08s_collect(uint8_t blockn, uint8_t keytype, const uint8_t *key, bool with_data, bool without_backdoor, iso14a_fm11rf08s_nonces_with_data_t *nonces) {
+
+    clearCommandBuffer();
+    uint32_t flags = with_data | (without_backdoor << 1);
+    SendCommandMIX(CMD_HF_MIFARE_ACQ_STATIC_ENCRYPTED_NONCES, flags, blockn, keytype, key, MIFARE_KEY_SIZE);
+
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_ACK, &resp, 2500)) {
+        if (resp.oldarg[0] != PM3_SUCCESS) {
+            return NONCE_FAIL;
+        }
+    } else {
+        PrintAndLogEx(WARNING, "Fail, transfer from device time-out");
+        return PM3_ETIMEOUT;
+    }
+
+    uint8_t num_sectors = MIFARE_1K_MAXSECTOR + 1;
+    for (uint8_t sec = 0; sec < num_sectors; sec++) {
+        // reconstruct full nt
+        uint32_t nt;
+        nt = bytes_to_num(resp.data.asBytes + ((sec * 2) * 8), 2);
+        nt = nt << 16 | prng_successor(nt, 16);
+        num_to_bytes(nt, 4, nonces->nt[sec][0]);
+        nt = bytes_to_num(resp.data.asBytes + (((sec * 2) + 1) * 8), 2);
+        nt = nt << 16 | prng_successor(nt, 16);
+        num_to_bytes(nt, 4, nonces->nt[sec][1]);
+    }
+    for (uint8_t sec = 0; sec < num_sectors; sec++) {
+        memcpy(nonces->nt_enc[sec][0], resp.data.asBytes + ((sec * 2) * 8) + 4, 4);
+        memcpy(nonces->nt_enc[sec][1], resp.data.asBytes + (((sec * 2) + 1) * 8) + 4, 4);
+    }
+    for (uint8_t sec = 0; sec < num_sectors; sec++) {
+        nonces->par_err[sec][0] = resp.data.asBytes[((sec * 2) * 8) + 2];
+        nonces->par_err[sec][1] = resp.data.asBytes[(((sec * 2) + 1) * 8) + 2];
+    }
+
+    if (with_data) {
+        int bytes = MIFARE_1K_MAXBLOCK * MFBLOCK_SIZE;
+
+        uint8_t *dump = calloc(bytes, sizeof(uint8_t));
+        if (dump == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return PM3_EFAILED;
+        }
+        if (GetFromDevice(BIG_BUF_EML, dump, bytes, 0, NULL, 0, NULL, 2500, false) == false) {
+            PrintAndLogEx(WARNING, "Fail, transfer from device time-out");
+            free(dump);
+            return PM3_ETIMEOUT;
+        }
+        for (uint8_t blk = 0; blk < MIFARE_1K_MAXBLOCK; blk++) {
+            memcpy(nonces->blocks[blk], dump + blk * MFBLOCK_SIZE, MFBLOCK_SIZE);
+        }
+        free(dump);
+    }
+    return PM3_SUCCESS;
+}
+
 static int CmdHF14AMfISEN(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mf isen",
@@ -10768,53 +11369,10 @@ static int CmdHF14AMfISEN(const char *Cmd) {
 
     if (collect_fm11rf08s) {
         uint64_t t1 = msclock();
-        uint32_t flags = collect_fm11rf08s_with_data | (collect_fm11rf08s_without_backdoor << 1);
-        SendCommandMIX(CMD_HF_MIFARE_ACQ_STATIC_ENCRYPTED_NONCES, flags, blockn, keytype, key, sizeof(key));
-        if (WaitForResponseTimeout(CMD_ACK, &resp, 2500)) {
-            if (resp.oldarg[0] != PM3_SUCCESS) {
-                return NONCE_FAIL;
-            }
-        } else {
-            PrintAndLogEx(WARNING, "Fail, transfer from device time-out");
-            return PM3_ETIMEOUT;
-        }
-        uint8_t num_sectors = MIFARE_1K_MAXSECTOR + 1;
         iso14a_fm11rf08s_nonces_with_data_t nonces_dump = {0};
-        for (uint8_t sec = 0; sec < num_sectors; sec++) {
-            // reconstruct full nt
-            uint32_t nt;
-            nt = bytes_to_num(resp.data.asBytes + ((sec * 2) * 8), 2);
-            nt = nt << 16 | prng_successor(nt, 16);
-            num_to_bytes(nt, 4, nonces_dump.nt[sec][0]);
-            nt = bytes_to_num(resp.data.asBytes + (((sec * 2) + 1) * 8), 2);
-            nt = nt << 16 | prng_successor(nt, 16);
-            num_to_bytes(nt, 4, nonces_dump.nt[sec][1]);
-        }
-        for (uint8_t sec = 0; sec < num_sectors; sec++) {
-            memcpy(nonces_dump.nt_enc[sec][0], resp.data.asBytes + ((sec * 2) * 8) + 4, 4);
-            memcpy(nonces_dump.nt_enc[sec][1], resp.data.asBytes + (((sec * 2) + 1) * 8) + 4, 4);
-        }
-        for (uint8_t sec = 0; sec < num_sectors; sec++) {
-            nonces_dump.par_err[sec][0] = resp.data.asBytes[((sec * 2) * 8) + 2];
-            nonces_dump.par_err[sec][1] = resp.data.asBytes[(((sec * 2) + 1) * 8) + 2];
-        }
-        if (collect_fm11rf08s_with_data) {
-            int bytes = MIFARE_1K_MAXBLOCK * MFBLOCK_SIZE;
-
-            uint8_t *dump = calloc(bytes, sizeof(uint8_t));
-            if (dump == NULL) {
-                PrintAndLogEx(WARNING, "Failed to allocate memory");
-                return PM3_EFAILED;
-            }
-            if (GetFromDevice(BIG_BUF_EML, dump, bytes, 0, NULL, 0, NULL, 2500, false) == false) {
-                PrintAndLogEx(WARNING, "Fail, transfer from device time-out");
-                free(dump);
-                return PM3_ETIMEOUT;
-            }
-            for (uint8_t blk = 0; blk < MIFARE_1K_MAXBLOCK; blk++) {
-                memcpy(nonces_dump.blocks[blk], dump + blk * MFBLOCK_SIZE, MFBLOCK_SIZE);
-            }
-            free(dump);
+        int res = mf_fm11rf08s_collect(blockn, keytype, key, collect_fm11rf08s_with_data, collect_fm11rf08s_without_backdoor, &nonces_dump);
+        if (res != PM3_SUCCESS) {
+            return res;
         }
         t1 = msclock() - t1;
         PrintAndLogEx(SUCCESS, "time: " _YELLOW_("%" PRIu64) " ms", t1);
@@ -10860,6 +11418,306 @@ static int CmdHF14AMfISEN(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// index 16 of the FM11RF08S nonces is the advanced sector 32
+#define RF08S_SECTORS           (MIFARE_1K_MAXSECTOR + 1)
+#define RF08S_REAL_SECTOR(s)    (((s) < MIFARE_1K_MAXSECTOR) ? (s) : 32)
+
+// Tests keys against one block in a check session on the device
+static int mf_rf08s_check(uint8_t blockno, uint8_t keytype, const uint64_t *keys, uint32_t cnt, uint64_t *found) {
+
+    if (cnt == 0) {
+        return PM3_ESOFT;
+    }
+
+    uint8_t *buf = calloc(cnt, MIFARE_KEY_SIZE);
+    if (buf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    for (uint32_t i = 0; i < cnt; i++) {
+        num_to_bytes(keys[i], MIFARE_KEY_SIZE, buf + (i * MIFARE_KEY_SIZE));
+    }
+
+    PrintAndLogEx(INPLACE, "Block %3u key %c... %5u keys", blockno, (keytype == MF_KEY_B) ? 'B' : 'A', cnt);
+
+    // only the found key is taken from e_sector, the rest of it isn't filled in single block mode
+    sector_t e_sector[MIFARE_4K_MAXSECTOR] = {0};
+    uint16_t params = blockno | (keytype << 8) | (1 << 15);
+    int res = mf_check_keys_session(MIFARE_4K_MAXSECTOR, cnt, buf, e_sector, false, true, params);
+    free(buf);
+    if (res == PM3_SUCCESS) {
+        *found = e_sector[mfSectorNum(blockno)].Key[keytype];
+    }
+    return res;
+}
+
+// The keys of the other type whose seed matches the found key, usually just one
+static uint32_t mf_rf08s_partners(uint32_t nt, uint64_t key, uint32_t nt2, const uint64_t *keys2, uint32_t cnt2, uint64_t *out, uint32_t max) {
+    uint16_t seed = mf_fm11rf08s_seednt16(nt, key);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < cnt2 && n < max; i++) {
+        if (mf_fm11rf08s_seednt16(nt2, keys2[i]) == seed) {
+            out[n++] = keys2[i];
+        }
+    }
+    return n;
+}
+
+// Moves the likely keys to the front, keeping the order otherwise:
+// dictionary keys first, then keys that are candidates in another list as well
+static void mf_rf08s_prioritize(uint64_t *keys, uint32_t cnt, const uint64_t *dict, uint32_t dictcnt, const uint64_t *all, uint32_t allcnt) {
+    uint64_t *tmp = malloc(cnt * sizeof(uint64_t));
+    uint8_t *rank = malloc(cnt);
+    if (tmp == NULL || rank == NULL) {
+        free(tmp);
+        free(rank);
+        return;
+    }
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        rank[i] = 2;
+        if (dictcnt && bsearch(&keys[i], dict, dictcnt, sizeof(uint64_t), compare_uint64)) {
+            rank[i] = 0;
+            continue;
+        }
+        const uint64_t *p = bsearch(&keys[i], all, allcnt, sizeof(uint64_t), compare_uint64);
+        if (p && ((p > all && p[-1] == keys[i]) || (p < all + allcnt - 1 && p[1] == keys[i]))) {
+            rank[i] = 1;
+        }
+    }
+
+    uint32_t n = 0;
+    for (uint8_t r = 0; r < 3; r++) {
+        for (uint32_t i = 0; i < cnt; i++) {
+            if (rank[i] == r) {
+                tmp[n++] = keys[i];
+            }
+        }
+    }
+    memcpy(keys, tmp, cnt * sizeof(uint64_t));
+    free(tmp);
+    free(rank);
+}
+
+static int CmdHF14AMfRf08s(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mf rf08s",
+                  "Recover the keys of a Fudan FM11RF08S card through its backdoor, in one run.\n"
+                  "The static encrypted nonces of all sectors are collected in one field session,\n"
+                  "key candidates are computed on all cores and tested with the fast check.\n"
+                  "Does what `script run fm11rf08s_recovery.py` does, without its helper tools.",
+                  "hf mf rf08s\n"
+                  "hf mf rf08s -k A396EFA4E24F        --> use this backdoor key\n"
+                  "hf mf rf08s -f mfc_default_keys    --> test candidates that are in the dictionary first\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("k", "key", "<hex>", "backdoor key, 6 hex bytes (def: try the known ones)"),
+        arg_str0("f", "file", "<fn>", "dictionary file, its keys are tested first"),
+        arg_lit0(NULL, "ns", "No save to file"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    int keylen = 0;
+    uint8_t key[MIFARE_KEY_SIZE] = {0};
+    CLIGetHexWithReturn(ctx, 1, key, &keylen);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    bool no_save = arg_get_lit(ctx, 3);
+    CLIParserFree(ctx);
+
+    if (keylen != 0 && keylen != MIFARE_KEY_SIZE) {
+        PrintAndLogEx(ERR, "Key length must be %u bytes", MIFARE_KEY_SIZE);
+        return PM3_EINVARG;
+    }
+
+    uint64_t t1 = msclock();
+
+    clearCommandBuffer();
+    SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT, 0, 0, NULL, 0);
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_ACK, &resp, 2500) == false) {
+        PrintAndLogEx(WARNING, "iso14443a card select timeout");
+        return PM3_ETIMEOUT;
+    }
+
+    iso14a_card_select_t card;
+    memcpy(&card, (iso14a_card_select_t *)resp.data.asBytes, sizeof(iso14a_card_select_t));
+    if (resp.oldarg[0] == 0 || card.uidlen < 4) {
+        PrintAndLogEx(WARNING, "No tag found");
+        return PM3_ECARDEXCHANGE;
+    }
+    uint32_t uid = bytes_to_num(card.uid + card.uidlen - 4, 4);
+    PrintAndLogEx(INFO, "UID... " _GREEN_("%s"), sprint_hex_inrow(card.uid, card.uidlen));
+
+    // one field session for all nonces
+    const uint8_t *backdoor[] = { g_mifare_k08s, g_mifare_k08, g_mifare_k32n };
+    iso14a_fm11rf08s_nonces_with_data_t nonces = {0};
+    int res = PM3_ESOFT;
+    if (keylen) {
+        res = mf_fm11rf08s_collect(0, MF_KEY_A, key, false, false, &nonces);
+    } else {
+        for (uint8_t i = 0; i < ARRAYLEN(backdoor) && res != PM3_SUCCESS; i++) {
+            res = mf_fm11rf08s_collect(0, MF_KEY_A, backdoor[i], false, false, &nonces);
+        }
+    }
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Can't collect the nonces, no FM11RF08S backdoor?");
+        return res;
+    }
+    PrintAndLogEx(SUCCESS, "Collected the nonces of " _YELLOW_("%u") " sectors ( " _YELLOW_("%" PRIu64) " ms )", RF08S_SECTORS, msclock() - t1);
+
+    // optional dictionary, sorted for bsearch
+    uint64_t *dict = NULL;
+    uint32_t dictcnt = 0;
+    if (fnlen) {
+        uint8_t *keyblock = NULL;
+        if (loadFileDICTIONARY_safe(filename, (void **)&keyblock, MIFARE_KEY_SIZE, &dictcnt) != PM3_SUCCESS || keyblock == NULL) {
+            return PM3_EFILE;
+        }
+        dict = calloc(dictcnt ? dictcnt : 1, sizeof(uint64_t));
+        if (dict == NULL) {
+            free(keyblock);
+            return PM3_EMALLOC;
+        }
+        for (uint32_t i = 0; i < dictcnt; i++) {
+            dict[i] = bytes_to_num(keyblock + (i * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        }
+        free(keyblock);
+        qsort(dict, dictcnt, sizeof(uint64_t), compare_uint64);
+    }
+
+    // key candidates, the nested engine spreads every recovery over all cores
+    uint64_t *keys[RF08S_SECTORS][2] = {{0}};
+    uint32_t cnt[RF08S_SECTORS][2] = {{0}};
+    uint32_t nt[RF08S_SECTORS][2];
+    uint32_t allcnt = 0;
+    for (uint8_t s = 0; s < RF08S_SECTORS; s++) {
+        for (uint8_t kt = MF_KEY_A; kt <= MF_KEY_B; kt++) {
+            nt[s][kt] = bytes_to_num(nonces.nt[s][kt], 4);
+        }
+        for (uint8_t kt = MF_KEY_A; kt <= MF_KEY_B; kt++) {
+            // same nonce, same key. One list does for both
+            if (kt == MF_KEY_B && nt[s][0] == nt[s][1]) {
+                break;
+            }
+            PrintAndLogEx(INPLACE, "Computing candidates of sector %2u key %c", RF08S_REAL_SECTOR(s), (kt == MF_KEY_B) ? 'B' : 'A');
+            cnt[s][kt] = mf_static_enc_candidates(uid, nt[s][kt], bytes_to_num(nonces.nt_enc[s][kt], 4), nonces.par_err[s][kt], &keys[s][kt]);
+        }
+        if (nt[s][0] != nt[s][1]) {
+            mf_fm11rf08s_filter(nt[s][0], keys[s][0], &cnt[s][0], nt[s][1], keys[s][1], &cnt[s][1]);
+        }
+        allcnt += cnt[s][0] + cnt[s][1];
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    // keys reused over sectors show up in several lists
+    uint64_t *all = calloc(allcnt ? allcnt : 1, sizeof(uint64_t));
+    if (all == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        res = PM3_EMALLOC;
+        goto out;
+    }
+    uint32_t n = 0;
+    for (uint8_t s = 0; s < RF08S_SECTORS; s++) {
+        for (uint8_t kt = MF_KEY_A; kt <= MF_KEY_B; kt++) {
+            memcpy(all + n, keys[s][kt], cnt[s][kt] * sizeof(uint64_t));
+            n += cnt[s][kt];
+        }
+    }
+    qsort(all, allcnt, sizeof(uint64_t), compare_uint64);
+
+    uint32_t total = 0;
+    for (uint8_t s = 0; s < RF08S_SECTORS; s++) {
+        for (uint8_t kt = MF_KEY_A; kt <= MF_KEY_B; kt++) {
+            mf_rf08s_prioritize(keys[s][kt], cnt[s][kt], dict, dictcnt, all, allcnt);
+            total += cnt[s][kt];
+        }
+    }
+    free(all);
+    PrintAndLogEx(SUCCESS, "Found " _YELLOW_("%u") " key candidates ( " _YELLOW_("%" PRIu64) " ms )", total, msclock() - t1);
+
+    // test them
+    sector_t e_sector[RF08S_SECTORS] = {0};
+    uint64_t partners[64];
+    for (uint8_t s = 0; s < RF08S_SECTORS; s++) {
+        uint8_t blockno = mfFirstBlockOfSector(RF08S_REAL_SECTOR(s));
+        uint64_t found = 0;
+
+        if (nt[s][0] == nt[s][1]) {
+            res = mf_rf08s_check(blockno, MF_KEY_A, keys[s][0], cnt[s][0], &found);
+            if (res == PM3_EOPABORTED) {
+                goto out;
+            }
+            if (res == PM3_SUCCESS) {
+                e_sector[s].Key[0] = found;
+                e_sector[s].foundKey[0] = 1;
+                if (mf_rf08s_check(blockno, MF_KEY_B, &found, 1, &found) == PM3_SUCCESS) {
+                    e_sector[s].Key[1] = found;
+                    e_sector[s].foundKey[1] = 1;
+                }
+            }
+            continue;
+        }
+
+        // one key of the sector, then its partner through the seed
+        for (uint8_t kt = MF_KEY_A; kt <= MF_KEY_B; kt++) {
+            res = mf_rf08s_check(blockno, kt, keys[s][kt], cnt[s][kt], &found);
+            if (res == PM3_EOPABORTED) {
+                goto out;
+            }
+            if (res != PM3_SUCCESS) {
+                continue;
+            }
+            e_sector[s].Key[kt] = found;
+            e_sector[s].foundKey[kt] = 1;
+
+            uint8_t other = kt ^ 1;
+            uint32_t pcnt = mf_rf08s_partners(nt[s][kt], found, nt[s][other], keys[s][other], cnt[s][other], partners, ARRAYLEN(partners));
+            res = mf_rf08s_check(blockno, other, partners, pcnt, &found);
+            if (res != PM3_SUCCESS && res != PM3_EOPABORTED) {
+                res = mf_rf08s_check(blockno, other, keys[s][other], cnt[s][other], &found);
+            }
+            if (res == PM3_EOPABORTED) {
+                goto out;
+            }
+            if (res == PM3_SUCCESS) {
+                e_sector[s].Key[other] = found;
+                e_sector[s].foundKey[other] = 1;
+            }
+            break;
+        }
+    }
+    res = PM3_SUCCESS;
+
+out:
+    PrintAndLogEx(NORMAL, "");
+    printKeyTable(MIFARE_1K_MAXSECTOR, e_sector);
+    printKeyTableEx(1, &e_sector[MIFARE_1K_MAXSECTOR], 32);
+
+    if (no_save == false) {
+        char *fptr = GenerateFilename("hf-mf-", "-key.bin");
+        if (fptr != NULL) {
+            createMfcKeyDump(fptr, MIFARE_1K_MAXSECTOR, e_sector);
+            free(fptr);
+        }
+    }
+
+    PrintAndLogEx(SUCCESS, "time: " _YELLOW_("%" PRIu64) " s", (msclock() - t1) / 1000);
+
+    for (uint8_t s = 0; s < RF08S_SECTORS; s++) {
+        free(keys[s][0]);
+        free(keys[s][1]);
+    }
+    free(dict);
+    return res;
+}
+
 static int CmdHF14AMfBambuKeys(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mf bambukeys",
@@ -10926,9 +11784,10 @@ static command_t CommandTable[] = {
     {"nested",      CmdHF14AMfNested,       IfPm3Iso14443a,  "Nested attack"},
     {"hardnested",  CmdHF14AMfNestedHard,   AlwaysAvailable, "Nested attack for hardened MIFARE Classic cards"},
     {"staticnested", CmdHF14AMfNestedStatic, IfPm3Iso14443a, "Nested attack against static nonce MIFARE Classic cards"},
+    {"rf08s",       CmdHF14AMfRf08s,        IfPm3Iso14443a,  "Backdoor key recovery for FM11RF08S cards"},
     {"brute",       CmdHF14AMfSmartBrute,   IfPm3Iso14443a,  "Smart bruteforce to exploit weak key generators"},
     {"autopwn",     CmdHF14AMfAutoPWN,      IfPm3Iso14443a,  "Automatic key recovery tool for MIFARE Classic"},
-//    {"keybrute",    CmdHF14AMfKeyBrute,     IfPm3Iso14443a,  "J_Run's 2nd phase of multiple sector nested authentication key recovery"},
+    {"keybrute",    CmdHF14AMfKeyBrute,     IfPm3Iso14443a,  "J_Run's 2nd phase of multiple sector nested authentication key recovery"},
     {"nack",        CmdHf14AMfNack,         IfPm3Iso14443a,  "Test for MIFARE NACK bug"},
     {"chk",         CmdHF14AMfChk,          IfPm3Iso14443a,  "Check keys"},
     {"fchk",        CmdHF14AMfChk_fast,     IfPm3Iso14443a,  "Check keys fast, targets all keys on card"},
@@ -932,6 +932,69 @@ static void DesFill2bPattern(
     (*startPattern)++;
 }
 
+// Checks the keys of one algorithm for the key numbers in 'usedkeys' with
+// CMD_HF_DESFIRE_CHK, a batch at a time, the device only sends back the hits.
+static int AuthCheckDesfireDevice(uint32_t aid, DesfireCryptoAlgorithm algo, const char *algoname, const int *usedkeys,
+                                  const uint8_t *keyList, uint32_t keyListLen, size_t stride,
+                                  uint8_t foundKeys[0xE][24 + 1], bool *result) {
+
+    int keylen = desfire_get_key_length(algo);
+
+    desfire_chk_t payload = {
+        .aid = {aid & 0xFF, (aid >> 8) & 0xFF, (aid >> 16) & 0xFF},
+        .algo = algo,
+    };
+
+    for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
+        if (usedkeys[keyno] == 1 && foundKeys[keyno][0] == 0) {
+            payload.keynos |= (1 << keyno);
+        }
+    }
+
+    for (uint32_t first = 0; (first < keyListLen) && payload.keynos; first += payload.count) {
+
+        payload.count = MIN(keyListLen - first, DESFIRE_CHK_KEYS_SIZE / keylen);
+        for (uint8_t i = 0; i < payload.count; i++) {
+            memcpy(payload.keys + (i * keylen), keyList + ((first + i) * stride), keylen);
+        }
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_DESFIRE_CHK, (uint8_t *)&payload, sizeof(payload));
+
+        PacketResponseNG resp;
+        uint8_t timeout = 0;
+        while (WaitForResponseTimeout(CMD_HF_DESFIRE_CHK, &resp, 1000) == false) {
+            if (kbd_enter_pressed()) {
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            }
+            // a full batch for all key numbers takes a few seconds
+            if (++timeout > 30) {
+                PrintAndLogEx(WARNING, "command execution time out");
+                return PM3_ETIMEOUT;
+            }
+        }
+
+        if (resp.status != PM3_SUCCESS) {
+            return resp.status;
+        }
+
+        const desfire_chk_reply_t *reply = (const desfire_chk_reply_t *)resp.data.asBytes;
+        for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
+            if (((reply->found >> keyno) & 1) == 0) {
+                continue;
+            }
+
+            const uint8_t *key = keyList + ((first + reply->keyidx[keyno]) * stride);
+            PrintAndLogEx(SUCCESS, "AID 0x%06X, Found %s Key %02u... " _GREEN_("%s"), aid, algoname, keyno, sprint_hex_inrow(key, keylen));
+            foundKeys[keyno][0] = 0x01;
+            memcpy(&foundKeys[keyno][1], key, keylen);
+            *result = true;
+            payload.keynos &= ~(1 << keyno);
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 static int AuthCheckDesfire(DesfireContext_t *dctx,
                             DesfireSecureChannel secureChannel,
                             const uint8_t *aid,
@@ -1021,6 +1084,26 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
         PrintAndLogEx(NORMAL, "");
     }
 
+    // without key diversification the authentications run on the device
+    if (cmdKdfAlgo == MFDES_KDF_ALGO_NONE && secureChannel == DACEV1) {
+        DropField();
+
+        res = PM3_SUCCESS;
+        if (des) {
+            res = AuthCheckDesfireDevice(curaid, T_DES, "DES", usedkeys, deskeyList[0], deskeyListLen, sizeof(deskeyList[0]), foundKeys[0], result);
+        }
+        if (tdes && res == PM3_SUCCESS) {
+            res = AuthCheckDesfireDevice(curaid, T_3DES, "2TDEA", usedkeys, aeskeyList[0], aeskeyListLen, sizeof(aeskeyList[0]), foundKeys[1], result);
+        }
+        if (aes && res == PM3_SUCCESS) {
+            res = AuthCheckDesfireDevice(curaid, T_AES, "AES", usedkeys, aeskeyList[0], aeskeyListLen, sizeof(aeskeyList[0]), foundKeys[2], result);
+        }
+        if (k3kdes && res == PM3_SUCCESS) {
+            res = AuthCheckDesfireDevice(curaid, T_3K3DES, "3TDEA", usedkeys, k3kkeyList[0], k3kkeyListLen, sizeof(k3kkeyList[0]), foundKeys[3], result);
+        }
+        return res;
+    }
+
     bool badlen = false;
 
     if (des) {
@@ -1166,7 +1249,8 @@ static int CmdHF14aDesChk(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mfdes chk",
-                  "Checks keys with MIFARE DESFire card.",
+                  "Checks keys with MIFARE DESFire card.\n"
+                  "Without key diversification the authentications run on the device, only hits are sent back.",
                   "hf mfdes chk --aid 123456 -k 000102030405060708090a0b0c0d0e0f  -> check key on aid 0x123456\n"
                   "hf mfdes chk -f mfdes_default_keys                     -> check keys against all existing aid on card\n"
                   "hf mfdes chk -f mfdes_default_keys --aid 123456        -> check keys against aid 0x123456\n"
@@ -4821,10 +4905,26 @@ static int DesfileReadISOFileAndPrint(DesfireContext_t *dctx,
     return PM3_SUCCESS;
 }
 
+// Adds 'data' as a hex string to the json object, any length
+static void DesfireJsonAddHex(json_t *obj, const char *name, const uint8_t *data, size_t datalen) {
+    char *hex = calloc((datalen * 2) + 1, 1);
+    if (hex == NULL) {
+        return;
+    }
+    if (datalen) {
+        hex_to_buffer((uint8_t *)hex, data, datalen, datalen * 2, 0, 0, true);
+    }
+    json_object_set_new(obj, name, json_string(hex));
+    free(hex);
+}
+
+// 'knownsettings' skips the GetFileSettings when the caller has them already,
+// with 'jfile' the data read goes to that json object too.
 static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
                                    uint8_t fnum, int filetype,
                                    uint32_t offset, uint32_t length,
-                                   uint32_t maxdatafilelength, bool noauth, bool verbose) {
+                                   uint32_t maxdatafilelength, bool noauth, bool verbose,
+                                   const FileSettings_t *knownsettings, json_t *jfile) {
 
     int res;
     // length of record for record file
@@ -4838,9 +4938,14 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
         FileSettings_t fsettings;
 
         DesfireCommunicationMode commMode = dctx->commMode;
-        DesfireSetCommMode(dctx, DCMMACed);
-        res = DesfireFileSettingsStruct(dctx, fnum, &fsettings);
-        DesfireSetCommMode(dctx, commMode);
+        if (knownsettings != NULL) {
+            fsettings = *knownsettings;
+            res = PM3_SUCCESS;
+        } else {
+            DesfireSetCommMode(dctx, DCMMACed);
+            res = DesfireFileSettingsStruct(dctx, fnum, &fsettings);
+            DesfireSetCommMode(dctx, commMode);
+        }
 
         if (res == PM3_SUCCESS) {
             switch (fsettings.fileType) {
@@ -4926,6 +5031,10 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
             return PM3_ESOFT;
         }
 
+        if (jfile != NULL) {
+            DesfireJsonAddHex(jfile, "data", resp, resplen);
+        }
+
         if (resplen > 0) {
             PrintAndLogEx(SUCCESS, "Read %zu bytes from file 0x%02x offset %u", resplen, fnum, offset);
             print_buffer_with_offset(resp, resplen, offset, true);
@@ -4944,6 +5053,9 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
             return PM3_ESOFT;
         }
         PrintAndLogEx(SUCCESS, "Read file 0x%02x value: %d (0x%08x)", fnum, value, value);
+        if (jfile != NULL) {
+            json_object_set_new(jfile, "value", json_integer((int32_t)value));
+        }
     }
 
     if (filetype == RFTRecord) {
@@ -4973,6 +5085,11 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
             }
         }
 
+        if (jfile != NULL) {
+            json_object_set_new(jfile, "recordSize", json_integer(reclen));
+            DesfireJsonAddHex(jfile, "records", resp, resplen);
+        }
+
         if (resplen > 0 && reclen > 0) {
             size_t reccount = resplen / reclen;
             PrintAndLogEx(SUCCESS, "Read %zu bytes from file 0x%02x from record %d record count %zu record length %zu", resplen, fnum, offset, reccount, reclen);
@@ -5000,6 +5117,10 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
             return PM3_ESOFT;
         }
 
+        if (jfile != NULL) {
+            DesfireJsonAddHex(jfile, "data", resp, resplen);
+        }
+
         if (resplen > 0) {
             if (resplen != 12) {
                 PrintAndLogEx(WARNING, "Read wrong %zu bytes from file 0x%02x offset %u", resplen, fnum, offset);
@@ -5134,7 +5255,7 @@ static int CmdHF14ADesReadData(const char *Cmd) {
     }
 
     if (dctx.cmdSet != DCCISO)
-        res = DesfileReadFileAndPrint(&dctx, fnum, op, offset, length, 0, noauth, verbose);
+        res = DesfileReadFileAndPrint(&dctx, fnum, op, offset, length, 0, noauth, verbose, NULL, NULL);
     else
         res = DesfileReadISOFileAndPrint(&dctx, fileisoidpresent, fnum, fileisoid, op, offset, length, noauth, verbose);
 
@@ -5687,12 +5808,109 @@ static int CmdHF14ADesLsApp(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Dumps all files of one application.  The file list with its settings is the
+// read plan, the application is selected and authenticated once and that
+// session is used for every file, only a failed read makes it authenticate again.
+// With 'fieldon' false the application is selected on the card already active.
+static int DesfireDumpApp(DesfireContext_t *dctx, int securechann, DesfireISOSelectWay selectway, uint32_t id,
+                          bool fieldon, uint32_t maxlength, bool noauth, bool verbose, json_t *japps) {
+
+    DesfireCommunicationMode commMode = dctx->commMode;
+    int res;
+
+    if (fieldon) {
+        res = DesfireSelectAndAuthenticateAppW(dctx, securechann, selectway, id, noauth, verbose);
+    } else {
+        DesfireClearSession(dctx);
+        DesfireSetCommMode(dctx, DCMPlain);
+        res = DesfireSelectAIDHexNoFieldOn(dctx, id);
+        DesfireSetCommMode(dctx, commMode);
+        if (res == PM3_SUCCESS && noauth == false) {
+            res = DesfireAuthenticate(dctx, securechann, verbose);
+        }
+    }
+
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Select or authentication %s " _RED_("failed") ". Result [%d] %s", DesfireWayIDStr(selectway, id), res, DesfireAuthErrorToStr(res));
+        return res;
+    }
+
+    FileList_t FileList = {{0}};
+    size_t filescount = 0;
+    bool isopresent = false;
+    res = DesfireFillFileList(dctx, FileList, &filescount, &isopresent);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, "Application " _CYAN_("%s") " have " _GREEN_("%zu") " files", DesfireWayIDStr(selectway, id), filescount);
+
+    if (selectway == ISW6bAID)
+        DesfirePrintAIDFunctions(id);
+
+    if (filescount == 0) {
+        PrintAndLogEx(INFO, "There is no files in the application %s", DesfireWayIDStr(selectway, id));
+        return res;
+    }
+
+    json_t *japp = NULL;
+    if (japps != NULL) {
+        char appid[16];
+        snprintf(appid, sizeof(appid), (selectway == ISW6bAID) ? "%06X" : "%04X", id);
+        japp = json_object();
+        json_object_set_new(japps, appid, japp);
+    }
+
+    res = PM3_SUCCESS;
+    for (int i = 0; i < filescount; i++) {
+        if (res != PM3_SUCCESS) {
+            DesfireSetCommMode(dctx, DCMPlain);
+            res = DesfireSelectAndAuthenticateAppW(dctx, securechann, selectway, id, noauth, verbose);
+            if (res != PM3_SUCCESS) {
+                return res;
+            }
+        }
+
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "--------------------------------- " _CYAN_("File %02x") " ----------------------------------", FileList[i].fileNum);
+        PrintAndLogEx(SUCCESS, "File ID         : " _GREEN_("%02x"), FileList[i].fileNum);
+        if (isopresent) {
+            if (FileList[i].fileISONum != 0)
+                PrintAndLogEx(SUCCESS, "File ISO ID     : %04x", FileList[i].fileISONum);
+            else
+                PrintAndLogEx(SUCCESS, "File ISO ID     : " _YELLOW_("n/a"));
+        }
+        DesfirePrintFileSettingsExtended(&FileList[i].fileSettings);
+
+        json_t *jfile = NULL;
+        if (japp != NULL) {
+            char fileid[4];
+            snprintf(fileid, sizeof(fileid), "%02X", FileList[i].fileNum);
+            jfile = json_object();
+            json_object_set_new(jfile, "type", json_integer(FileList[i].fileSettings.fileType));
+            if (FileList[i].fileISONum != 0) {
+                json_object_set_new(jfile, "isoid", json_integer(FileList[i].fileISONum));
+            }
+            json_object_set_new(japp, fileid, jfile);
+        }
+
+        res = DesfileReadFileAndPrint(dctx, FileList[i].fileNum, RFTAuto, 0, 0, maxlength, noauth, verbose, &FileList[i].fileSettings, jfile);
+    }
+
+    // the next application starts from the mode of the command line again
+    DesfireSetCommMode(dctx, commMode);
+    return PM3_SUCCESS;
+}
+
 static int CmdHF14ADesDump(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mfdes dump",
-                  "For each application show fil list and then file content. Key needs to be provided for authentication or flag --no-auth set (depend on cards settings).",
+                  "For each application show fil list and then file content. Key needs to be provided for authentication or flag --no-auth set (depend on cards settings).\n"
+                  "With --all every application of the card is dumped in one session with the same key, --file saves everything read to one json file.",
                   "hf mfdes dump --aid 123456     -> show file dump for: app=123456 with channel defaults from `default` command/n"
-                  "hf mfdes dump --isoid df01 --schann lrp -t aes --length 000090    -> lrp default settings with length limit");
+                  "hf mfdes dump --isoid df01 --schann lrp -t aes --length 000090    -> lrp default settings with length limit\n"
+                  "hf mfdes dump --all --no-auth -f card    -> dump all free files of all applications to `card.json`");
 
     void *argtable[] = {
         arg_param_begin,
@@ -5710,6 +5928,8 @@ static int CmdHF14ADesDump(const char *Cmd) {
         arg_str0(NULL, "isoid",   "<hex>", "Application ISO ID (ISO DF ID) (2 hex bytes, big endian)"),
         arg_str0("l", "length",   "<hex>", "Maximum length for read data files (3 hex bytes, big endian)"),
         arg_lit0(NULL, "no-auth", "Execute without authentication"),
+        arg_lit0(NULL, "all",     "Dump all applications of the card"),
+        arg_str0("f", "file",     "<fn>", "Save the dump to this json file"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -5717,6 +5937,7 @@ static int CmdHF14ADesDump(const char *Cmd) {
     bool APDULogging = arg_get_lit(ctx, 1);
     bool verbose = arg_get_lit(ctx, 2);
     bool noauth = arg_get_lit(ctx, 14);
+    bool dumpall = arg_get_lit(ctx, 15);
 
     DesfireContext_t dctx;
     int securechann = defaultSecureChannel;
@@ -5734,64 +5955,66 @@ static int CmdHF14ADesDump(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 16), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
     SetAPDULogging(APDULogging);
     CLIParserFree(ctx);
 
-    res = DesfireSelectAndAuthenticateAppW(&dctx, securechann, selectway, id, noauth, verbose);
-    if (res != PM3_SUCCESS) {
-        DropField();
-        PrintAndLogEx(FAILED, "Select or authentication %s " _RED_("failed") ". Result [%d] %s", DesfireWayIDStr(selectway, id), res, DesfireAuthErrorToStr(res));
-        return res;
-    }
-
-    FileList_t FileList = {{0}};
-    size_t filescount = 0;
-    bool isopresent = false;
-    res = DesfireFillFileList(&dctx, FileList, &filescount, &isopresent);
-    if (res != PM3_SUCCESS) {
-        DropField();
-        return res;
+    json_t *root = NULL;
+    json_t *japps = NULL;
+    if (fnlen) {
+        root = json_object();
+        japps = json_object();
+        json_object_set_new(root, "Created", json_string("proxmark3"));
+        json_object_set_new(root, "FileType", json_string("mfdes"));
+        json_object_set_new(root, "Applications", japps);
     }
 
-    PrintAndLogEx(NORMAL, "");
-    PrintAndLogEx(SUCCESS, "Application " _CYAN_("%s") " have " _GREEN_("%zu") " files", DesfireWayIDStr(selectway, id), filescount);
-
-    if (selectway == ISW6bAID)
-        DesfirePrintAIDFunctions(id);
+    if (dumpall == false) {
+        res = DesfireDumpApp(&dctx, securechann, selectway, id, true, maxlength, noauth, verbose, japps);
+    } else {
+        uint8_t buf[250] = {0};
+        size_t buflen = 0;
 
-    if (filescount == 0) {
-        PrintAndLogEx(INFO, "There is no files in the application %s", DesfireWayIDStr(selectway, id));
-        DropField();
-        return res;
-    }
+        DesfireCommunicationMode commMode = dctx.commMode;
+        DesfireSetCommMode(&dctx, DCMPlain);
+        res = DesfireSelectAIDHex(&dctx, 0x000000, false, 0);
+        if (res == PM3_SUCCESS) {
+            res = DesfireGetAIDList(&dctx, buf, &buflen);
+        }
+        DesfireSetCommMode(&dctx, commMode);
 
-    res = PM3_SUCCESS;
-    for (int i = 0; i < filescount; i++) {
         if (res != PM3_SUCCESS) {
-            DesfireSetCommMode(&dctx, DCMPlain);
-            res = DesfireSelectAndAuthenticateAppW(&dctx, securechann, selectway, id, noauth, verbose);
-            if (res != PM3_SUCCESS) {
-                DropField();
-                return res;
-            }
+            PrintAndLogEx(ERR, "Can't get list of applications on tag");
+        } else {
+            PrintAndLogEx(SUCCESS, "Card has " _GREEN_("%zu") " applications", buflen / 3);
         }
 
-        PrintAndLogEx(NORMAL, "");
-        PrintAndLogEx(INFO, "--------------------------------- " _CYAN_("File %02x") " ----------------------------------", FileList[i].fileNum);
-        PrintAndLogEx(SUCCESS, "File ID         : " _GREEN_("%02x"), FileList[i].fileNum);
-        if (isopresent) {
-            if (FileList[i].fileISONum != 0)
-                PrintAndLogEx(SUCCESS, "File ISO ID     : %04x", FileList[i].fileISONum);
-            else
-                PrintAndLogEx(SUCCESS, "File ISO ID     : " _YELLOW_("n/a"));
+        // the card stays active, a failed application costs a new activation for the next one
+        bool fieldon = false;
+        for (size_t i = 0; (res == PM3_SUCCESS) && (i < buflen); i += 3) {
+            uint32_t aid = DesfireAIDByteToUint(&buf[i]);
+            if (DesfireDumpApp(&dctx, securechann, ISW6bAID, aid, fieldon, maxlength, noauth, verbose, japps) == PM3_SUCCESS) {
+                fieldon = false;
+            } else {
+                fieldon = true;
+            }
         }
-        DesfirePrintFileSettingsExtended(&FileList[i].fileSettings);
-
-        res = DesfileReadFileAndPrint(&dctx, FileList[i].fileNum, RFTAuto, 0, 0, maxlength, noauth, verbose);
     }
 
     DropField();
-    return PM3_SUCCESS;
+
+    if (root != NULL) {
+        if (json_object_size(japps)) {
+            saveFileJSONroot(filename, root, JSON_INDENT(2), true);
+        } else {
+            PrintAndLogEx(WARNING, "Nothing read, no file saved");
+        }
+        json_decref(root);
+    }
+    return res;
 }
 
 static int CmdHF14ADesTest(const char *Cmd) {
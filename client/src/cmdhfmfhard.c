@@ -32,6 +32,12 @@
 #include <time.h> // MingW
 #include <lz4frame.h>
 #include <bzlib.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "commonutil.h"  // ARRAYLEN
 #include "comms.h"
@@ -43,10 +49,9 @@
 #include "hardnested_bruteforce.h"
 #include "hardnested_bf_core.h"
 #include "hardnested_bitarray_core.h"
+#include "hardnested_pool.h"
 #include "fileutils.h"
 
-#define NUM_CHECK_BITFLIPS_THREADS      (num_CPUs())
-#define NUM_REDUCTION_WORKING_THREADS   (num_CPUs())
 
 // ignore bitflip arrays which have nearly only valid states
 #define IGNORE_BITFLIP_THRESHOLD        0.9901
@@ -59,6 +64,9 @@
 #define DEBUG_KEY_ELIMINATION
 // #define DEBUG_REDUCTION
 
+// bounded memory use, see hardnested_set_lowmem()
+static bool lowmem = false;
+
 // possible sum property values
 static uint16_t sums[NUM_SUMS] = {
     0,   32,  56,  64,  80,  96,  104, 112,
@@ -113,6 +121,11 @@ static void get_SIMD_instruction_set(char *instruction_set) {
         case SIMD_NEON:
             strcpy(instruction_set, "NEON");
             break;
+#endif
+#if defined(HAVE_OPENCL)
+        case SIMD_OPENCL:
+            strcpy(instruction_set, "OpenCL");
+            break;
 #endif
         case SIMD_AUTO:
         case SIMD_NONE:
@@ -125,7 +138,7 @@ static void print_progress_header(void) {
     char progress_text[80];
     char instr_set[12] = "";
     get_SIMD_instruction_set(instr_set);
-    snprintf(progress_text, sizeof(progress_text), "Start using " _YELLOW_("%d") " threads and " _YELLOW_("%s") " SIMD core", num_CPUs(), instr_set);
+    snprintf(progress_text, sizeof(progress_text), "Start using " _YELLOW_("%u") " threads and " _YELLOW_("%s") " SIMD core", hn_pool_workers(), instr_set);
 
     PrintAndLogEx(INFO, "---------+---------+---------------------------------------------------------+-----------------+-------");
     PrintAndLogEx(INFO, "         |         |                                                         | Expected to brute force");
@@ -274,48 +287,383 @@ static void init_bunzip2(bz_stream *compressed_stream, char *input_buffer, uint3
 
 }
 
-static void init_bitflip_bitarrays(void) {
+typedef enum {
+    BITFLIP_FILE_NONE = 0,
+    BITFLIP_FILE_RAW,
+    BITFLIP_FILE_LZ4,
+    BITFLIP_FILE_BZ2,
+} bitflip_file_t;
+
+// finds the table file of a bitflip, raw preferred over LZ4 over BZ2. *path must be freed by the caller
+static bitflip_file_t locate_bitflip_file(odd_even_t odd_even, uint16_t bitflip, char **path, char *state_file_name, size_t name_len) {
+    const char *templates[] = {STATE_FILE_TEMPLATE_RAW, STATE_FILE_TEMPLATE_LZ4, STATE_FILE_TEMPLATE_BZ2};
+    const bitflip_file_t fmts[] = {BITFLIP_FILE_RAW, BITFLIP_FILE_LZ4, BITFLIP_FILE_BZ2};
+    char state_files_path[strlen(STATE_FILES_DIRECTORY) + name_len];
+
+    for (size_t k = 0; k < ARRAYLEN(templates); k++) {
+        snprintf(state_file_name, name_len, templates[k], odd_even, bitflip);
+        snprintf(state_files_path, sizeof(state_files_path), "%s%s", STATE_FILES_DIRECTORY, state_file_name);
+        if (searchFile(path, RESOURCES_SUBDIR, state_files_path, "", true) == PM3_SUCCESS) {
+            return fmts[k];
+        }
+    }
+    return BITFLIP_FILE_NONE;
+}
+
+//----------------------------------------------------------------------------
+// Cache of the decompressed bitflip tables in the user directory.
+// Built on the first run, later runs mmap it read-only so that concurrent
+// clients share the page cache instead of decompressing into their own heap.
+// Tables are stored in load order, data starts on a page boundary and every
+// table is 2 MiB, so the SIMD alignment of malloc_bitarray() is kept.
+//----------------------------------------------------------------------------
+#define BITFLIP_CACHE_FILE              "hardnested_bitflips.cache"
+#define BITFLIP_CACHE_MAGIC             "PM3HNBF"
+#define BITFLIP_CACHE_VERSION           1
+#define BITFLIP_TABLE_SIZE              (sizeof(uint32_t) * (1 << 19))
+
+typedef struct {
+    uint16_t bitflip;
+    uint8_t odd_even;
+    uint8_t pad;
+    uint32_t count;
+} PACKED bitflip_cache_entry_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t threshold;          // IGNORE_BITFLIP_THRESHOLD * 10000
+    uint32_t source_sig;         // bitflip_sources_signature() of the tables it was built from
+    uint32_t num_tables;
+    bitflip_cache_entry_t entry[2 * 0x400];
+} PACKED bitflip_cache_hdr_t;
+
+#define BITFLIP_CACHE_DATA_OFFSET       ((sizeof(bitflip_cache_hdr_t) + 0xFFF) & ~0xFFF)
+
+#if !defined(_WIN32)
+static void *bitflip_cache_map = NULL;
+static size_t bitflip_cache_map_len = 0;
+
+// no cache in incognito mode
+static bool bitflip_cache_path(char *path, size_t len) {
+    const char *user_path = get_my_user_directory();
+    if (user_path == NULL || g_session.incognito) {
+        return false;
+    }
+    int n = snprintf(path, len, "%s%s%s", user_path, PM3_USER_DIRECTORY, BITFLIP_CACHE_FILE);
+    return (n > 0 && (size_t)n < len);
+}
+
+// FNV-1a over which table files exist, their format and size. Changes when the tables are replaced
+static uint32_t bitflip_sources_signature(void) {
+    uint32_t sig = 0x811C9DC5;
+    char state_file_name[MAX(sizeof(STATE_FILE_TEMPLATE_RAW), MAX(sizeof(STATE_FILE_TEMPLATE_LZ4), sizeof(STATE_FILE_TEMPLATE_BZ2)))];
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
+            char *path = NULL;
+            bitflip_file_t fmt = locate_bitflip_file(odd_even, bitflip, &path, state_file_name, sizeof(state_file_name));
+            if (fmt == BITFLIP_FILE_NONE) {
+                continue;
+            }
+            struct stat st;
+            uint32_t size = (stat(path, &st) == 0) ? (uint32_t)st.st_size : 0;
+            free(path);
+
+            uint8_t item[8] = {odd_even, bitflip >> 8, bitflip & 0xFF, fmt, size >> 24, size >> 16, size >> 8, size};
+            for (size_t k = 0; k < sizeof(item); k++) {
+                sig = (sig ^ item[k]) * 0x01000193;
+            }
+        }
+    }
+    return sig;
+}
+
+static bool bitflip_cache_load(uint32_t source_sig) {
+    char path[FILE_PATH_SIZE];
+    if (bitflip_cache_path(path, sizeof(path)) == false) {
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < BITFLIP_CACHE_DATA_OFFSET) {
+        close(fd);
+        return false;
+    }
+
+    size_t len = st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const bitflip_cache_hdr_t *hdr = (const bitflip_cache_hdr_t *)map;
+    if (memcmp(hdr->magic, BITFLIP_CACHE_MAGIC, sizeof(BITFLIP_CACHE_MAGIC)) != 0
+            || hdr->version != BITFLIP_CACHE_VERSION
+            || hdr->threshold != (uint32_t)(IGNORE_BITFLIP_THRESHOLD * 10000)
+            || hdr->source_sig != source_sig
+            || hdr->num_tables > ARRAYLEN(hdr->entry)
+            || len != BITFLIP_CACHE_DATA_OFFSET + (size_t)hdr->num_tables * BITFLIP_TABLE_SIZE) {
+        PrintAndLogEx(DEBUG, "Bitflip cache " _YELLOW_("%s") " is stale, rebuilding", path);
+        munmap(map, len);
+        return false;
+    }
+
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        num_effective_bitflips[odd_even] = 0;
+        for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
+            bitflip_bitarrays[odd_even][bitflip] = NULL;
+            count_bitflip_bitarrays[odd_even][bitflip] = 1 << 24;
+        }
+    }
+
+    for (uint32_t k = 0; k < hdr->num_tables; k++) {
+        const bitflip_cache_entry_t *e = &hdr->entry[k];
+        odd_even_t odd_even = (e->odd_even) ? ODD_STATE : EVEN_STATE;
+        uint16_t bitflip = e->bitflip & 0x3FF;
+        effective_bitflip[odd_even][num_effective_bitflips[odd_even]++] = bitflip;
+        // the tables are only ever read
+        bitflip_bitarrays[odd_even][bitflip] = (uint32_t *)((uint8_t *)map + BITFLIP_CACHE_DATA_OFFSET + (size_t)k * BITFLIP_TABLE_SIZE);
+        count_bitflip_bitarrays[odd_even][bitflip] = e->count;
+    }
+    effective_bitflip[EVEN_STATE][num_effective_bitflips[EVEN_STATE]] = 0x400; // EndOfList marker
+    effective_bitflip[ODD_STATE][num_effective_bitflips[ODD_STATE]] = 0x400;
+
+    bitflip_cache_map = map;
+    bitflip_cache_map_len = len;
+    return true;
+}
+
+// written to a temp file first and renamed, concurrent clients never see a partial cache.
+// The tables go after the room left for the header, which is written last
+static FILE *bitflip_cache_create(char *tmp, size_t tmplen) {
+    char path[FILE_PATH_SIZE];
+    if (bitflip_cache_path(path, sizeof(path)) == false) {
+        return NULL;
+    }
+
+    snprintf(tmp, tmplen, "%s.%d", path, (int)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        return NULL;
+    }
+    if (fseek(f, BITFLIP_CACHE_DATA_OFFSET, SEEK_SET) != 0) {
+        fclose(f);
+        remove(tmp);
+        return NULL;
+    }
+    return f;
+}
+
+// the header lists the effective tables in load order, even ones first
+static bool bitflip_cache_finish(FILE *f, const char *tmp, uint32_t source_sig, bool ok) {
+    char path[FILE_PATH_SIZE];
+    bitflip_cache_path(path, sizeof(path));
+
+    bitflip_cache_hdr_t *hdr = calloc(1, BITFLIP_CACHE_DATA_OFFSET);
+    if (hdr) {
+        memcpy(hdr->magic, BITFLIP_CACHE_MAGIC, sizeof(BITFLIP_CACHE_MAGIC));
+        hdr->version = BITFLIP_CACHE_VERSION;
+        hdr->threshold = (uint32_t)(IGNORE_BITFLIP_THRESHOLD * 10000);
+        hdr->source_sig = source_sig;
+        for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+            for (uint16_t k = 0; k < num_effective_bitflips[odd_even]; k++) {
+                uint16_t bitflip = effective_bitflip[odd_even][k];
+                bitflip_cache_entry_t *e = &hdr->entry[hdr->num_tables++];
+                e->bitflip = bitflip;
+                e->odd_even = odd_even;
+                e->count = count_bitflip_bitarrays[odd_even][bitflip];
+            }
+        }
+        ok = ok && (fseek(f, 0, SEEK_SET) == 0) && (fwrite(hdr, 1, BITFLIP_CACHE_DATA_OFFSET, f) == BITFLIP_CACHE_DATA_OFFSET);
+        free(hdr);
+    }
+    ok = (fclose(f) == 0) && (hdr != NULL) && ok;
+
+    if (ok == false || rename(tmp, path) != 0) {
+        PrintAndLogEx(DEBUG, "Could not write bitflip cache " _YELLOW_("%s"), path);
+        remove(tmp);
+        return false;
+    }
+    PrintAndLogEx(DEBUG, "Bitflip cache saved to " _YELLOW_("%s"), path);
+    return true;
+}
+
+static void bitflip_cache_save(uint32_t source_sig) {
+    char tmp[FILE_PATH_SIZE + 16];
+    FILE *f = bitflip_cache_create(tmp, sizeof(tmp));
+    if (f == NULL) {
+        return;
+    }
+
+    bool ok = true;
+    for (odd_even_t odd_even = EVEN_STATE; ok && odd_even <= ODD_STATE; odd_even++) {
+        for (uint16_t k = 0; ok && k < num_effective_bitflips[odd_even]; k++) {
+            uint16_t bitflip = effective_bitflip[odd_even][k];
+            ok = (fwrite(bitflip_bitarrays[odd_even][bitflip], 1, BITFLIP_TABLE_SIZE, f) == BITFLIP_TABLE_SIZE);
+        }
+    }
+    bitflip_cache_finish(f, tmp, source_sig, ok);
+}
+
+static bool bitflip_cache_unmap(void) {
+    if (bitflip_cache_map == NULL) {
+        return false;
+    }
+    munmap(bitflip_cache_map, bitflip_cache_map_len);
+    bitflip_cache_map = NULL;
+    bitflip_cache_map_len = 0;
+    return true;
+}
+#else
+// no mmap, always decompress
+static uint32_t bitflip_sources_signature(void) {
+    return 0;
+}
+static bool bitflip_cache_load(uint32_t source_sig) {
+    (void)source_sig;
+    return false;
+}
+static FILE *bitflip_cache_create(char *tmp, size_t tmplen) {
+    (void)tmp;
+    (void)tmplen;
+    return NULL;
+}
+static bool bitflip_cache_finish(FILE *f, const char *tmp, uint32_t source_sig, bool ok) {
+    (void)f;
+    (void)tmp;
+    (void)source_sig;
+    (void)ok;
+    return false;
+}
+static void bitflip_cache_save(uint32_t source_sig) {
+    (void)source_sig;
+}
+static bool bitflip_cache_unmap(void) {
+    return false;
+}
+#endif
+
+//----------------------------------------------------------------------------
+// Low memory mode keeps the large bitarrays in an unlinked scratch file in the
+// user directory. Its pages are file backed, under memory pressure the kernel
+// writes them back and drops them instead of swapping or killing the client.
+// The file is sparse, bitarrays never written take no disk space.
+//----------------------------------------------------------------------------
+typedef struct {
+    uint8_t *base;
+    size_t count;
+} bitarray_arena_t;
+
+#if !defined(_WIN32)
+static bool bitarray_arena_create(bitarray_arena_t *a, size_t count) {
+    memset(a, 0, sizeof(bitarray_arena_t));
+    const char *user_path = get_my_user_directory();
+    if (user_path == NULL) {
+        return false;
+    }
+
+    char path[FILE_PATH_SIZE];
+    int n = snprintf(path, sizeof(path), "%s%shardnested_XXXXXX", user_path, PM3_USER_DIRECTORY);
+    if (n <= 0 || (size_t)n >= sizeof(path)) {
+        return false;
+    }
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return false;
+    }
+    unlink(path);
+
+    size_t len = count * BITFLIP_TABLE_SIZE;
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, len) == 0) {
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    a->base = map;
+    a->count = count;
+    return true;
+}
+
+static void bitarray_arena_destroy(bitarray_arena_t *a) {
+    if (a->base) {
+        munmap(a->base, a->count * BITFLIP_TABLE_SIZE);
+    }
+    memset(a, 0, sizeof(bitarray_arena_t));
+}
+#else
+// no mmap, low memory mode only shares the untouched bitarrays
+static bool bitarray_arena_create(bitarray_arena_t *a, size_t count) {
+    (void)count;
+    memset(a, 0, sizeof(bitarray_arena_t));
+    return false;
+}
+
+static void bitarray_arena_destroy(bitarray_arena_t *a) {
+    memset(a, 0, sizeof(bitarray_arena_t));
+}
+#endif
+
+// bitarray idx of the arena, or one from the heap when there is no arena
+static uint32_t *arena_bitarray(const bitarray_arena_t *a, size_t idx) {
+    if (a->base) {
+        return (uint32_t *)(a->base + (idx * BITFLIP_TABLE_SIZE));
+    }
+    return (uint32_t *)malloc_bitarray(BITFLIP_TABLE_SIZE);
+}
+
+static void free_arena_bitarray(const bitarray_arena_t *a, uint32_t *bitarray) {
+    if (a->base && (uint8_t *)bitarray >= a->base && (uint8_t *)bitarray < a->base + (a->count * BITFLIP_TABLE_SIZE)) {
+        return;
+    }
+    free_bitarray(bitarray);
+}
+
+static bitarray_arena_t part_sum_arena;
+static bitarray_arena_t nonce_arena;
+
+// a table is effective once loaded. In low memory mode it is appended to the cache being built instead
+static void add_effective_bitflip(odd_even_t odd_even, uint16_t bitflip, uint32_t *bitset, uint32_t count, FILE *spill) {
+    effective_bitflip[odd_even][num_effective_bitflips[odd_even]++] = bitflip;
+    count_bitflip_bitarrays[odd_even][bitflip] = count;
+    if (spill) {
+        fwrite(bitset, 1, BITFLIP_TABLE_SIZE, spill);
+        free_bitarray(bitset);
+        return;
+    }
+    bitflip_bitarrays[odd_even][bitflip] = bitset;
+}
+
+// decompresses the tables found in the resources directory
+static void load_bitflip_bitarrays(uint64_t init_bitflip_bitarrays_starttime, FILE *spill) {
 #if defined (DEBUG_REDUCTION)
     uint8_t line = 0;
 #endif
-    uint64_t init_bitflip_bitarrays_starttime = msclock();
-
     char state_file_name[MAX(sizeof(STATE_FILE_TEMPLATE_RAW), MAX(sizeof(STATE_FILE_TEMPLATE_LZ4), sizeof(STATE_FILE_TEMPLATE_BZ2)))];
-    char state_files_path[strlen(get_my_executable_directory()) + strlen(STATE_FILES_DIRECTORY) + sizeof(state_file_name)];
     uint16_t nraw = 0, nlz4 = 0, nbz2 = 0;
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
         num_effective_bitflips[odd_even] = 0;
         for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
-            bool open_uncompressed = false;
-            bool open_lz4compressed = false;
-            bool open_bz2compressed = false;
 
             bitflip_bitarrays[odd_even][bitflip] = NULL;
             count_bitflip_bitarrays[odd_even][bitflip] = 1 << 24;
 
             char *path;
-            snprintf(state_file_name, sizeof(state_file_name), STATE_FILE_TEMPLATE_RAW, odd_even, bitflip);
-            strncpy(state_files_path, STATE_FILES_DIRECTORY, sizeof(state_files_path) - 1);
-            strncat(state_files_path, state_file_name, sizeof(state_files_path) - (strlen(STATE_FILES_DIRECTORY) + 1));
-            if (searchFile(&path, RESOURCES_SUBDIR, state_files_path, "", true) == PM3_SUCCESS) {
-                open_uncompressed = true;
-            } else {
-                snprintf(state_file_name, sizeof(state_file_name), STATE_FILE_TEMPLATE_LZ4, odd_even, bitflip);
-                strncpy(state_files_path, STATE_FILES_DIRECTORY, sizeof(state_files_path) - 1);
-                strncat(state_files_path, state_file_name, sizeof(state_files_path) - (strlen(STATE_FILES_DIRECTORY) + 1));
-                if (searchFile(&path, RESOURCES_SUBDIR, state_files_path, "", true) == PM3_SUCCESS) {
-                    open_lz4compressed = true;
-                } else {
-                    snprintf(state_file_name, sizeof(state_file_name), STATE_FILE_TEMPLATE_BZ2, odd_even, bitflip);
-                    strncpy(state_files_path, STATE_FILES_DIRECTORY, sizeof(state_files_path) - 1);
-                    strncat(state_files_path, state_file_name, sizeof(state_files_path) - (strlen(STATE_FILES_DIRECTORY) + 1));
-                    if (searchFile(&path, RESOURCES_SUBDIR, state_files_path, "", true) == PM3_SUCCESS) {
-                        open_bz2compressed = true;
-                    } else {
-                        continue;
-                    }
-                }
+            bitflip_file_t fmt = locate_bitflip_file(odd_even, bitflip, &path, state_file_name, sizeof(state_file_name));
+            if (fmt == BITFLIP_FILE_NONE) {
+                continue;
             }
+            bool open_uncompressed = (fmt == BITFLIP_FILE_RAW);
+            bool open_lz4compressed = (fmt == BITFLIP_FILE_LZ4);
+            bool open_bz2compressed = (fmt == BITFLIP_FILE_BZ2);
 
             FILE *statesfile = fopen(path, "rb");
             free(path);
@@ -358,9 +706,7 @@ static void init_bitflip_bitarrays(void) {
                         exit(5);
                     }
 
-                    effective_bitflip[odd_even][num_effective_bitflips[odd_even]++] = bitflip;
-                    bitflip_bitarrays[odd_even][bitflip] = bitset;
-                    count_bitflip_bitarrays[odd_even][bitflip] = count;
+                    add_effective_bitflip(odd_even, bitflip, bitset, count, spill);
 #if defined (DEBUG_REDUCTION)
                     PrintAndLogEx(INFO, "(%03" PRIx16 " %s:%5.1f%%) ", bitflip, odd_even ? "odd " : "even", (float)count / (1 << 24) * 100.0);
                     line++;
@@ -437,9 +783,7 @@ static void init_bitflip_bitarrays(void) {
                         exit(4);
                     }
                     memcpy(bitset, uncompressed_data + sizeof(uint32_t), sizeof(uint32_t) * (1 << 19));
-                    effective_bitflip[odd_even][num_effective_bitflips[odd_even]++] = bitflip;
-                    bitflip_bitarrays[odd_even][bitflip] = bitset;
-                    count_bitflip_bitarrays[odd_even][bitflip] = count;
+                    add_effective_bitflip(odd_even, bitflip, bitset, count, spill);
 #if defined (DEBUG_REDUCTION)
                     PrintAndLogEx(INFO, "(%03" PRIx16 " %s:%5.1f%%) ", bitflip, odd_even ? "odd " : "even", (float)count / (1 << 24) * 100.0);
                     line++;
@@ -487,9 +831,7 @@ static void init_bitflip_bitarrays(void) {
                         BZ2_bzDecompressEnd(&compressed_stream);
                         exit(4);
                     }
-                    effective_bitflip[odd_even][num_effective_bitflips[odd_even]++] = bitflip;
-                    bitflip_bitarrays[odd_even][bitflip] = bitset;
-                    count_bitflip_bitarrays[odd_even][bitflip] = count;
+                    add_effective_bitflip(odd_even, bitflip, bitset, count, spill);
 #if defined (DEBUG_REDUCTION)
                     PrintAndLogEx(INFO, "(%03" PRIx16 " %s:%5.1f%%) ", bitflip, odd_even ? "odd " : "even", (float)count / (1 << 24) * 100.0);
                     line++;
@@ -516,6 +858,34 @@ static void init_bitflip_bitarrays(void) {
                 );
         hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
     }
+}
+
+static void init_bitflip_bitarrays(void) {
+    uint64_t init_bitflip_bitarrays_starttime = msclock();
+
+    // already decompressed by an earlier run?
+    uint32_t source_sig = bitflip_sources_signature();
+    if (bitflip_cache_load(source_sig)) {
+        char progress_text[100];
+        snprintf(progress_text, sizeof(progress_text), "Mapped " _YELLOW_("%u") " tables from cache in %4"PRIu64" ms"
+                 , num_effective_bitflips[EVEN_STATE] + num_effective_bitflips[ODD_STATE]
+                 , msclock() - init_bitflip_bitarrays_starttime
+                );
+        hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
+    } else if (lowmem) {
+        // straight into the cache and mapped, never all tables on the heap
+        char tmp[FILE_PATH_SIZE + 16];
+        FILE *spill = bitflip_cache_create(tmp, sizeof(tmp));
+        load_bitflip_bitarrays(init_bitflip_bitarrays_starttime, spill);
+        if (spill && (bitflip_cache_finish(spill, tmp, source_sig, ferror(spill) == 0) == false || bitflip_cache_load(source_sig) == false)) {
+            PrintAndLogEx(WARNING, "Could not write the bitflip cache, tables are kept in memory");
+            load_bitflip_bitarrays(init_bitflip_bitarrays_starttime, NULL);
+        }
+    } else {
+        load_bitflip_bitarrays(init_bitflip_bitarrays_starttime, NULL);
+        bitflip_cache_save(source_sig);
+    }
+
     uint16_t i = 0;
     uint16_t j = 0;
     num_all_effective_bitflips = 0;
@@ -558,6 +928,10 @@ static void init_bitflip_bitarrays(void) {
 }
 
 static void free_bitflip_bitarrays(void) {
+    if (bitflip_cache_unmap()) {
+        memset(bitflip_bitarrays, 0, sizeof(bitflip_bitarrays));
+        return;
+    }
     for (int16_t bitflip = 0x3ff; bitflip > 0x000; bitflip--) {
         free_bitarray(bitflip_bitarrays[ODD_STATE][bitflip]);
     }
@@ -597,9 +971,12 @@ static uint16_t PartialSumProperty(uint32_t state, odd_even_t odd_even) {
 }
 
 static void init_part_sum_bitarrays(void) {
+    if (lowmem && bitarray_arena_create(&part_sum_arena, 4 * NUM_PART_SUMS) == false) {
+        PrintAndLogEx(WARNING, "Could not create a scratch file in the user directory, bitarrays are kept in memory");
+    }
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
         for (uint16_t part_sum_a0 = 0; part_sum_a0 < NUM_PART_SUMS; part_sum_a0++) {
-            part_sum_a0_bitarrays[odd_even][part_sum_a0] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+            part_sum_a0_bitarrays[odd_even][part_sum_a0] = arena_bitarray(&part_sum_arena, (odd_even * NUM_PART_SUMS) + part_sum_a0);
             if (part_sum_a0_bitarrays[odd_even][part_sum_a0] == NULL) {
                 PrintAndLogEx(ERR, "Out of memory error in init_part_suma0_statelists(). Aborting...\n");
                 exit(4);
@@ -619,7 +996,7 @@ static void init_part_sum_bitarrays(void) {
 
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
         for (uint16_t part_sum_a8 = 0; part_sum_a8 < NUM_PART_SUMS; part_sum_a8++) {
-            part_sum_a8_bitarrays[odd_even][part_sum_a8] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+            part_sum_a8_bitarrays[odd_even][part_sum_a8] = arena_bitarray(&part_sum_arena, ((2 + odd_even) * NUM_PART_SUMS) + part_sum_a8);
             if (part_sum_a8_bitarrays[odd_even][part_sum_a8] == NULL) {
                 PrintAndLogEx(ERR, "Out of memory error in init_part_suma8_statelists(). Aborting...\n");
                 exit(4);
@@ -640,46 +1017,58 @@ static void init_part_sum_bitarrays(void) {
 
 static void free_part_sum_bitarrays(void) {
     for (int16_t part_sum_a8 = (NUM_PART_SUMS - 1); part_sum_a8 >= 0; part_sum_a8--) {
-        free_bitarray(part_sum_a8_bitarrays[ODD_STATE][part_sum_a8]);
+        free_arena_bitarray(&part_sum_arena, part_sum_a8_bitarrays[ODD_STATE][part_sum_a8]);
     }
     for (int16_t part_sum_a8 = (NUM_PART_SUMS - 1); part_sum_a8 >= 0; part_sum_a8--) {
-        free_bitarray(part_sum_a8_bitarrays[EVEN_STATE][part_sum_a8]);
+        free_arena_bitarray(&part_sum_arena, part_sum_a8_bitarrays[EVEN_STATE][part_sum_a8]);
     }
     for (int16_t part_sum_a0 = (NUM_PART_SUMS - 1); part_sum_a0 >= 0; part_sum_a0--) {
-        free_bitarray(part_sum_a0_bitarrays[ODD_STATE][part_sum_a0]);
+        free_arena_bitarray(&part_sum_arena, part_sum_a0_bitarrays[ODD_STATE][part_sum_a0]);
     }
     for (int16_t part_sum_a0 = (NUM_PART_SUMS - 1); part_sum_a0 >= 0; part_sum_a0--) {
-        free_bitarray(part_sum_a0_bitarrays[EVEN_STATE][part_sum_a0]);
+        free_arena_bitarray(&part_sum_arena, part_sum_a0_bitarrays[EVEN_STATE][part_sum_a0]);
     }
+    bitarray_arena_destroy(&part_sum_arena);
 }
 
-static void init_sum_bitarrays(void) {
-    for (uint16_t sum_a0 = 0; sum_a0 < NUM_SUMS; sum_a0++) {
-        for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-            sum_a0_bitarrays[odd_even][sum_a0] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
-            if (sum_a0_bitarrays[odd_even][sum_a0] == NULL) {
-                PrintAndLogEx(ERR, "Out of memory error in init_sum_bitarrays(). Aborting...\n");
-                exit(4);
-            }
-            clear_bitarray24(sum_a0_bitarrays[odd_even][sum_a0]);
+// the part sum bitarrays may already be reduced by all_bitflips_bitarray, which
+// apply_sum_a0() ANDs the result with anyway
+static void add_sum_bitarrays(uint16_t sum_a0_idx) {
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        sum_a0_bitarrays[odd_even][sum_a0_idx] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+        if (sum_a0_bitarrays[odd_even][sum_a0_idx] == NULL) {
+            PrintAndLogEx(ERR, "Out of memory error in init_sum_bitarrays(). Aborting...\n");
+            exit(4);
         }
+        clear_bitarray24(sum_a0_bitarrays[odd_even][sum_a0_idx]);
     }
     for (uint8_t p = 0; p < NUM_PART_SUMS; p++) {
         for (uint8_t q = 0; q < NUM_PART_SUMS; q++) {
             uint16_t sum_a0 = 2 * p * (16 - 2 * q) + (16 - 2 * p) * 2 * q;
-            uint16_t sum_a0_idx = 0;
-            while (sums[sum_a0_idx] != sum_a0) sum_a0_idx++;
-            bitarray_OR(sum_a0_bitarrays[EVEN_STATE][sum_a0_idx], part_sum_a0_bitarrays[EVEN_STATE][q]);
-            bitarray_OR(sum_a0_bitarrays[ODD_STATE][sum_a0_idx], part_sum_a0_bitarrays[ODD_STATE][p]);
+            if (sums[sum_a0_idx] == sum_a0) {
+                bitarray_OR(sum_a0_bitarrays[EVEN_STATE][sum_a0_idx], part_sum_a0_bitarrays[EVEN_STATE][q]);
+                bitarray_OR(sum_a0_bitarrays[ODD_STATE][sum_a0_idx], part_sum_a0_bitarrays[ODD_STATE][p]);
+            }
         }
     }
+}
 
+static void init_sum_bitarrays(void) {
+    // low memory mode only builds the ones of the Sum(a0) found, in apply_sum_a0()
+    if (lowmem) {
+        return;
+    }
+    for (uint16_t sum_a0_idx = 0; sum_a0_idx < NUM_SUMS; sum_a0_idx++) {
+        add_sum_bitarrays(sum_a0_idx);
+    }
 }
 
 static void free_sum_bitarrays(void) {
     for (int8_t sum_a0 = NUM_SUMS - 1; sum_a0 >= 0; sum_a0--) {
         free_bitarray(sum_a0_bitarrays[ODD_STATE][sum_a0]);
         free_bitarray(sum_a0_bitarrays[EVEN_STATE][sum_a0]);
+        sum_a0_bitarrays[ODD_STATE][sum_a0] = NULL;
+        sum_a0_bitarrays[EVEN_STATE][sum_a0] = NULL;
     }
 }
 
@@ -713,6 +1102,27 @@ static uint64_t sample_period = 0;
 static uint64_t num_keys_tested = 0;
 static statelist_t *candidates = NULL;
 
+// pipelined mode: brute force the best candidate set while nonces are still acquired
+#define SPECULATION_MIN_PROB            0.9           // start once the best Sum(a8) guess is this likely
+#define SPECULATION_MAX_TIME            1800.0        // and the expected brute force is shorter than this (seconds)
+#define SPECULATION_MIN_ODD             64            // odd states per work unit, amortizes bitslicing the even states
+static bool pipelined = false;
+static struct {
+    bool active;
+    bool key_found;
+    uint8_t first_byte;
+    uint16_t sum_a8_idx;
+    statelist_t *lists;         // own copies of the candidate lists, pruned after every batch of nonces
+    uint32_t count;
+    uint32_t bucket;            // resume position, the odd states before it are done
+    uint32_t odd;
+    uint32_t pruned_nonces;
+    uint64_t done_states;
+    uint64_t key;
+} spec;
+
+static bool speculation_step(void);
+
 static int add_nonce(uint32_t nonce_enc, uint8_t par_enc) {
     uint8_t first_byte = nonce_enc >> 24;
     noncelistentry_t *p1 = nonces[first_byte].first;
@@ -778,6 +1188,16 @@ static void init_nonce_memory(void) {
         for (uint16_t bitflip = 0x000; bitflip < 0x400; bitflip++) {
             nonces[i].BitFlips[bitflip] = 0;
         }
+        nonces[i].all_bitflips_dirty[EVEN_STATE] = false;
+        nonces[i].all_bitflips_dirty[ODD_STATE] = false;
+        if (lowmem) {
+            // shares all_bitflips_bitarray until own bitflip properties are found, see nonce_states_own()
+            nonces[i].states_bitarray[EVEN_STATE] = all_bitflips_bitarray[EVEN_STATE];
+            nonces[i].states_bitarray[ODD_STATE] = all_bitflips_bitarray[ODD_STATE];
+            nonces[i].num_states_bitarray[EVEN_STATE] = 1 << 24;
+            nonces[i].num_states_bitarray[ODD_STATE] = 1 << 24;
+            continue;
+        }
         nonces[i].states_bitarray[EVEN_STATE] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
         if (nonces[i].states_bitarray[EVEN_STATE] == NULL) {
             PrintAndLogEx(ERR, "Out of memory error in init_nonce_memory(). Aborting...\n");
@@ -792,13 +1212,31 @@ static void init_nonce_memory(void) {
         }
         set_bitarray24(nonces[i].states_bitarray[ODD_STATE]);
         nonces[i].num_states_bitarray[ODD_STATE] = 1 << 24;
-        nonces[i].all_bitflips_dirty[EVEN_STATE] = false;
-        nonces[i].all_bitflips_dirty[ODD_STATE] = false;
+    }
+    if (lowmem) {
+        bitarray_arena_create(&nonce_arena, 2 * 256);
     }
     first_byte_num = 0;
     first_byte_Sum = 0;
 }
 
+// the states of a first byte to restrict. In low memory mode a byte without own bitflip
+// properties shares all_bitflips_bitarray, it gets its own copy in the arena here
+static uint32_t *nonce_states_own(uint16_t i, odd_even_t odd_even) {
+    uint32_t *states = nonces[i].states_bitarray[odd_even];
+    if (states != all_bitflips_bitarray[odd_even]) {
+        return states;
+    }
+    uint32_t *own = arena_bitarray(&nonce_arena, (i * 2) + odd_even);
+    if (own == NULL) {
+        PrintAndLogEx(ERR, "Out of memory error in nonce_states_own(). Aborting...\n");
+        exit(4);
+    }
+    memcpy(own, states, sizeof(uint32_t) * (1 << 19));
+    nonces[i].states_bitarray[odd_even] = own;
+    return own;
+}
+
 static void free_nonce_list(noncelistentry_t *p) {
     if (p == NULL) {
         return;
@@ -813,9 +1251,13 @@ static void free_nonces_memory(void) {
         free_nonce_list(nonces[i].first);
     }
     for (int i = 255; i >= 0; i--) {
-        free_bitarray(nonces[i].states_bitarray[ODD_STATE]);
-        free_bitarray(nonces[i].states_bitarray[EVEN_STATE]);
+        for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+            if (nonces[i].states_bitarray[odd_even] != all_bitflips_bitarray[odd_even]) {
+                free_arena_bitarray(&nonce_arena, nonces[i].states_bitarray[odd_even]);
+            }
+        }
     }
+    bitarray_arena_destroy(&nonce_arena);
 }
 
 static double p_hypergeometric(uint16_t i_K, uint16_t n, uint16_t k) {
@@ -1003,6 +1445,11 @@ static void update_sum_bitarrays(odd_even_t odd_even) {
             bitarray_AND(part_sum_a8_bitarrays[odd_even][part_sum], all_bitflips_bitarray[odd_even]);
         }
         for (uint16_t i = 0; i < 256; i++) {
+            // shared in low memory mode
+            if (nonces[i].states_bitarray[odd_even] == all_bitflips_bitarray[odd_even]) {
+                nonces[i].num_states_bitarray[odd_even] = num_all_bitflips_bitarray[odd_even];
+                continue;
+            }
             nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonces[i].states_bitarray[odd_even], all_bitflips_bitarray[odd_even]);
         }
         for (uint8_t part_sum_a0 = 0; part_sum_a0 < NUM_PART_SUMS; part_sum_a0++) {
@@ -1311,136 +1758,100 @@ static bool timeout(void) {
 }
 
 
-static void
-#ifdef __has_attribute
-#if __has_attribute(force_align_arg_pointer)
-__attribute__((force_align_arg_pointer))
-#endif
-#endif
-*check_for_BitFlipProperties_thread(void *args) {
-    uint8_t first_byte = ((uint8_t *)args)[0];
-    uint8_t last_byte = ((uint8_t *)args)[1];
-    uint8_t time_budget = ((uint8_t *)args)[2];
+typedef struct {
+    bool time_budget;
+    bool stage1_incomplete;     // set by any worker running out of time in stage 1
+} bitflip_check_t;
+
+static void update_bitflip_states(uint16_t i, uint16_t bitflip) {
+    nonces[i].BitFlips[bitflip] = 1;
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        if (bitflip_bitarrays[odd_even][bitflip] != NULL) {
+            uint32_t old_count = nonces[i].num_states_bitarray[odd_even];
+            nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonce_states_own(i, odd_even), bitflip_bitarrays[odd_even][bitflip]);
+            if (nonces[i].num_states_bitarray[odd_even] != old_count) {
+                nonces[i].all_bitflips_dirty[odd_even] = true;
+            }
+            // PrintAndLogEx(INFO, "bitflip: %d old: %d, new: %d ", bitflip, old_count, nonces[i].num_states_bitarray[odd_even]);
+        }
+    }
+}
+
+// one first byte per pool item, a byte only ever updates its own nonces[] entry
+static void check_for_BitFlipProperties_byte(uint32_t item, uint32_t worker, void *ctx) {
+    (void)worker;
+    bitflip_check_t *job = (bitflip_check_t *)ctx;
+    uint16_t i = item;
 
     if (hardnested_stage & CHECK_1ST_BYTES) {
         // for (uint16_t bitflip = 0x001; bitflip < 0x200; bitflip++) {
         for (uint16_t bitflip_idx = 0; bitflip_idx < num_1st_byte_effective_bitflips; bitflip_idx++) {
             uint16_t bitflip = all_effective_bitflip[bitflip_idx];
-            if (time_budget && timeout()) {
+            if (job->time_budget && timeout()) {
 #if defined (DEBUG_REDUCTION)
                 PrintAndLogEx(INFO, "break at bitflip_idx " _YELLOW_("%d") " ...", bitflip_idx);
 #endif
-                return NULL;
+                __atomic_store_n(&job->stage1_incomplete, true, __ATOMIC_RELAXED);
+                return;
             }
-            for (uint16_t i = first_byte; i <= last_byte; i++) {
-
-                if (nonces[i].BitFlips[bitflip] == 0 && nonces[i].BitFlips[bitflip ^ 0x100] == 0
-                        && nonces[i].first != NULL && nonces[i ^ (bitflip & 0xff)].first != NULL) {
-
-                    uint8_t parity1 = (nonces[i].first->par_enc) >> 3;                  // parity of first byte
-                    uint8_t parity2 = (nonces[i ^ (bitflip & 0xff)].first->par_enc) >> 3; // parity of nonce with bits flipped
-
-                    if ((parity1 == parity2 && !(bitflip & 0x100))          // bitflip
-                            || (parity1 != parity2 && (bitflip & 0x100))) {     // not bitflip
 
-                        nonces[i].BitFlips[bitflip] = 1;
+            if (nonces[i].BitFlips[bitflip] == 0 && nonces[i].BitFlips[bitflip ^ 0x100] == 0
+                    && nonces[i].first != NULL && nonces[i ^ (bitflip & 0xff)].first != NULL) {
 
-                        for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+                uint8_t parity1 = (nonces[i].first->par_enc) >> 3;                  // parity of first byte
+                uint8_t parity2 = (nonces[i ^ (bitflip & 0xff)].first->par_enc) >> 3; // parity of nonce with bits flipped
 
-                            if (bitflip_bitarrays[odd_even][bitflip] != NULL) {
-                                uint32_t old_count = nonces[i].num_states_bitarray[odd_even];
-                                nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip]);
-                                if (nonces[i].num_states_bitarray[odd_even] != old_count) {
-                                    nonces[i].all_bitflips_dirty[odd_even] = true;
-                                }
-                                // PrintAndLogEx(INFO, "bitflip: %d old: %d, new: %d ", bitflip, old_count, nonces[i].num_states_bitarray[odd_even]);
-                            }
-                        }
-                    }
+                if ((parity1 == parity2 && !(bitflip & 0x100))          // bitflip
+                        || (parity1 != parity2 && (bitflip & 0x100))) {     // not bitflip
+                    update_bitflip_states(i, bitflip);
                 }
             }
-            ((uint8_t *)args)[1] = num_1st_byte_effective_bitflips - bitflip_idx - 1;  // bitflips still to go in stage 1
         }
     }
 
-    ((uint8_t *)args)[1] = 0;  // stage 1 definitely completed
-
     if (hardnested_stage & CHECK_2ND_BYTES) {
         for (uint16_t bitflip_idx = num_1st_byte_effective_bitflips; bitflip_idx < num_all_effective_bitflips; bitflip_idx++) {
             uint16_t bitflip = all_effective_bitflip[bitflip_idx];
-            if (time_budget && timeout()) {
+            if (job->time_budget && timeout()) {
 #if defined (DEBUG_REDUCTION)
                 PrintAndLogEx(INFO, "break at bitflip_idx " _YELLOW_("%d") " ...", bitflip_idx);
 #endif
-                return NULL;
+                return;
             }
-            for (uint16_t i = first_byte; i <= last_byte; i++) {
-                // Check for Bit Flip Property of 2nd bytes
-                if (nonces[i].BitFlips[bitflip] == 0) {
-                    for (uint16_t j = 0; j < 256; j++) { // for each 2nd Byte
-                        noncelistentry_t *byte1 = SearchFor2ndByte(i, j);
-                        noncelistentry_t *byte2 = SearchFor2ndByte(i, j ^ (bitflip & 0xff));
-                        if (byte1 != NULL && byte2 != NULL) {
-                            uint8_t parity1 = byte1->par_enc >> 2 & 0x01; // parity of 2nd byte
-                            uint8_t parity2 = byte2->par_enc >> 2 & 0x01; // parity of 2nd byte with bits flipped
-                            if ((parity1 == parity2 && !(bitflip & 0x100)) // bitflip
-                                    || (parity1 != parity2 && (bitflip & 0x100))) { // not bitflip
-                                nonces[i].BitFlips[bitflip] = 1;
-                                for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-                                    if (bitflip_bitarrays[odd_even][bitflip] != NULL) {
-                                        uint32_t old_count = nonces[i].num_states_bitarray[odd_even];
-                                        nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip]);
-                                        if (nonces[i].num_states_bitarray[odd_even] != old_count) {
-                                            nonces[i].all_bitflips_dirty[odd_even] = true;
-                                        }
-                                    }
-                                }
-                                break;
-                            }
+            // Check for Bit Flip Property of 2nd bytes
+            if (nonces[i].BitFlips[bitflip] == 0) {
+                for (uint16_t j = 0; j < 256; j++) { // for each 2nd Byte
+                    noncelistentry_t *byte1 = SearchFor2ndByte(i, j);
+                    noncelistentry_t *byte2 = SearchFor2ndByte(i, j ^ (bitflip & 0xff));
+                    if (byte1 != NULL && byte2 != NULL) {
+                        uint8_t parity1 = byte1->par_enc >> 2 & 0x01; // parity of 2nd byte
+                        uint8_t parity2 = byte2->par_enc >> 2 & 0x01; // parity of 2nd byte with bits flipped
+                        if ((parity1 == parity2 && !(bitflip & 0x100)) // bitflip
+                                || (parity1 != parity2 && (bitflip & 0x100))) { // not bitflip
+                            update_bitflip_states(i, bitflip);
+                            break;
                         }
                     }
                 }
-                // PrintAndLogEx(INFO, "states_bitarray[0][%" PRIu16 "] contains %d ones.\n", i, count_states(nonces[i].states_bitarray[EVEN_STATE]));
-                // PrintAndLogEx(INFO, "states_bitarray[1][%" PRIu16 "] contains %d ones.\n", i, count_states(nonces[i].states_bitarray[ODD_STATE]));
             }
         }
+        // PrintAndLogEx(INFO, "states_bitarray[0][%" PRIu16 "] contains %d ones.\n", i, count_states(nonces[i].states_bitarray[EVEN_STATE]));
+        // PrintAndLogEx(INFO, "states_bitarray[1][%" PRIu16 "] contains %d ones.\n", i, count_states(nonces[i].states_bitarray[ODD_STATE]));
     }
-
-    return NULL;
 }
 
 static void check_for_BitFlipProperties(bool time_budget) {
-    // create and run worker threads
-    const size_t num_check_bitflip_threads = NUM_CHECK_BITFLIPS_THREADS;
-    pthread_t thread_id[num_check_bitflip_threads];
-
-    uint8_t args[num_check_bitflip_threads][3];
-    uint16_t bytes_per_thread = (256 + (num_check_bitflip_threads / 2)) / num_check_bitflip_threads;
-    for (uint32_t i = 0; i < num_check_bitflip_threads; i++) {
-        args[i][0] = i * bytes_per_thread;
-        args[i][1] = MIN(args[i][0] + bytes_per_thread - 1, 255);
-        args[i][2] = time_budget;
-    }
-    // args[][] is uint8_t so max 255, no need to check it
-    // args[num_check_bitflip_threads - 1][1] = MAX(args[num_check_bitflip_threads - 1][1], 255);
-
-    // start threads
-    for (uint32_t i = 0; i < num_check_bitflip_threads; i++) {
-        pthread_create(&thread_id[i], NULL, check_for_BitFlipProperties_thread, args[i]);
-    }
+    bitflip_check_t job = {
+        .time_budget = time_budget,
+        .stage1_incomplete = false,
+    };
 
-    // wait for threads to terminate:
-    for (uint32_t i = 0; i < num_check_bitflip_threads; i++) {
-        pthread_join(thread_id[i], NULL);
-    }
+    hn_pool_run(256, check_for_BitFlipProperties_byte, &job);
 
     if (hardnested_stage & CHECK_2ND_BYTES) {
         hardnested_stage &= ~CHECK_1ST_BYTES; // we are done with 1st stage, except...
-        for (uint32_t i = 0; i < num_check_bitflip_threads; i++) {
-            if (args[i][1] != 0) {
-                hardnested_stage |= CHECK_1ST_BYTES;  // ... when any of the threads didn't complete in time
-                break;
-            }
+        if (job.stage1_incomplete) {
+            hardnested_stage |= CHECK_1ST_BYTES;  // ... when any of the bytes didn't complete in time
         }
     }
 #if defined (DEBUG_REDUCTION)
@@ -1458,6 +1869,9 @@ static void update_nonce_data(bool time_budget) {
 }
 
 static void apply_sum_a0(void) {
+    if (lowmem) {
+        add_sum_bitarrays(first_byte_Sum);
+    }
     uint32_t old_count = num_all_bitflips_bitarray[EVEN_STATE];
     num_all_bitflips_bitarray[EVEN_STATE] = count_bitarray_AND(all_bitflips_bitarray[EVEN_STATE], sum_a0_bitarrays[EVEN_STATE][first_byte_Sum]);
     if (num_all_bitflips_bitarray[EVEN_STATE] != old_count) {
@@ -1468,6 +1882,10 @@ static void apply_sum_a0(void) {
     if (num_all_bitflips_bitarray[ODD_STATE] != old_count) {
         all_bitflips_bitarray_dirty[ODD_STATE] = true;
     }
+    // not needed anymore
+    if (lowmem) {
+        free_sum_bitarrays();
+    }
 }
 
 static void simulate_MFplus_RNG(uint32_t test_cuid, uint64_t test_key, uint32_t *nt_enc, uint8_t *par_enc) {
@@ -1569,6 +1987,10 @@ static int simulate_acquire_nonces(void) {
             acquisition_completed = shrink_key_space(&brute_force_depth);
             hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
         }
+
+        if (pipelined && acquisition_completed == false && speculation_step()) {
+            acquisition_completed = true;
+        }
     } while (!acquisition_completed);
 
     time_t end_time = time(NULL);
@@ -1582,6 +2004,122 @@ static int simulate_acquire_nonces(void) {
     return PM3_SUCCESS;
 }
 
+int mfnestedhard_acquire_multi(uint8_t blockNo, uint8_t keyType, const uint8_t *key, const uint8_t *targets, uint8_t targets_cnt,
+                               uint32_t nonces_per_target, bool slow, char **filenames) {
+
+    if (targets_cnt == 0 || targets_cnt > HARDNESTED_MULTI_MAX_TARGETS) {
+        return PM3_EINVARG;
+    }
+
+    FILE **fnonces = calloc(targets_cnt, sizeof(FILE *));
+    uint32_t *counts = calloc(targets_cnt, sizeof(uint32_t));
+    uint8_t *active = calloc(targets_cnt, sizeof(uint8_t));
+    if (fnonces == NULL || counts == NULL || active == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(fnonces);
+        free(counts);
+        free(active);
+        return PM3_EMALLOC;
+    }
+
+    uint8_t data[7 + (HARDNESTED_MULTI_MAX_TARGETS * 2)];
+    memcpy(data, key, 6);
+
+    PacketResponseNG resp;
+    bool initialize = true;
+    int res = PM3_SUCCESS;
+    uint64_t t1 = msclock();
+
+    for (;;) {
+
+        // targets still short of nonces. The device tags every record with the
+        // index into the list it was sent, not into targets
+        uint8_t n = 0;
+        uint32_t total = 0;
+        for (uint8_t i = 0; i < targets_cnt; i++) {
+            total += counts[i];
+            if (counts[i] < nonces_per_target) {
+                active[n] = i;
+                data[7 + (n * 2)] = targets[i * 2];
+                data[8 + (n * 2)] = targets[(i * 2) + 1];
+                n++;
+            }
+        }
+
+        PrintAndLogEx(INPLACE, "%3u of %u targets done, %u nonces, %.0f s", targets_cnt - n, targets_cnt, total, (float)(msclock() - t1) / 1000.0);
+
+        if (n == 0) {
+            break;
+        }
+
+        if (kbd_enter_pressed()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        data[6] = n;
+        uint32_t flags = 0x0008;
+        flags |= initialize ? 0x0001 : 0;
+        flags |= slow ? 0x0002 : 0;
+        clearCommandBuffer();
+        SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, blockNo + keyType * 0x100, 0, flags, data, 7 + (n * 2));
+
+        if (WaitForResponseTimeout(CMD_ACK, &resp, 3000) == false) {
+            res = PM3_ETIMEOUT;
+            break;
+        }
+
+        // error during nested_hard
+        if (resp.oldarg[0]) {
+            res = (int16_t)resp.oldarg[0];
+            break;
+        }
+
+        if (initialize) {
+            // same layout as `hf mf hardnested -w`
+            uint8_t hdr[6];
+            num_to_bytes(resp.oldarg[1], 4, hdr);
+            for (uint8_t i = 0; i < targets_cnt && res == PM3_SUCCESS; i++) {
+                if ((fnonces[i] = fopen(filenames[i], "wb")) == NULL) {
+                    PrintAndLogEx(WARNING, "Could not create file " _YELLOW_("%s"), filenames[i]);
+                    res = PM3_EFILE;
+                    break;
+                }
+                hdr[4] = targets[i * 2];
+                hdr[5] = targets[(i * 2) + 1];
+                fwrite(hdr, 1, sizeof(hdr), fnonces[i]);
+            }
+            if (res != PM3_SUCCESS) {
+                break;
+            }
+            initialize = false;
+        }
+
+        uint16_t num_sampled_nonces = resp.oldarg[2];
+        const uint8_t *bufp = resp.data.asBytes;
+        for (uint16_t i = 0; i + 1 < num_sampled_nonces; i += 2, bufp += 10) {
+            if (bufp[0] >= n) {
+                continue;
+            }
+            uint8_t t = active[bufp[0]];
+            fwrite(bufp + 1, 1, 9, fnonces[t]);
+            counts[t] += 2;
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+    DropField();
+
+    for (uint8_t i = 0; i < targets_cnt; i++) {
+        if (fnonces[i]) {
+            fclose(fnonces[i]);
+        }
+    }
+    free(fnonces);
+    free(counts);
+    free(active);
+    return res;
+}
+
 static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename) {
 
     last_sample_clock = msclock();
@@ -1618,6 +2156,8 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
         flags |= initialize ? 0x0001 : 0;
         flags |= slow ? 0x0002 : 0;
         flags |= field_off ? 0x0004 : 0;
+        // only nonces with a new 1st/2nd byte pair, add_nonce() would drop the others anyway
+        flags |= 0x0010;
         clearCommandBuffer();
         SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, blockNo + keyType * 0x100, trgBlockNo + trgKeyType * 0x100, flags, key, 6);
 
@@ -1713,6 +2253,11 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
                 acquisition_completed = shrink_key_space(&brute_force_depth);
                 hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
             }
+
+            // the device is collecting the next batch meanwhile
+            if (pipelined && acquisition_completed == false && speculation_step()) {
+                acquisition_completed = true;
+            }
         }
 
         if (acquisition_completed) {
@@ -2092,17 +2637,13 @@ static void init_book_of_work(void) {
     }
 }
 
-static void
-#ifdef __has_attribute
-#if __has_attribute(force_align_arg_pointer)
-__attribute__((force_align_arg_pointer))
-#endif
-#endif
-*generate_candidates_worker_thread(void *args) {
+// every pool worker runs this once, the book of work hands out the (p, q, r, s) combinations
+static void generate_candidates_worker(uint32_t item, uint32_t worker, void *args) {
+    (void)item;
+    (void)worker;
     uint16_t *sum_args = (uint16_t *)args;
     uint16_t sum_a0 = sums[sum_args[0]];
     uint16_t sum_a8 = sums[sum_args[1]];
-    // uint16_t my_thread_number = sums[2];
 
     bool there_might_be_more_work = true;
     do {
@@ -2234,8 +2775,6 @@ __attribute__((force_align_arg_pointer))
             }
         }
     } while (there_might_be_more_work);
-
-    return NULL;
 }
 
 
@@ -2248,22 +2787,8 @@ static void generate_candidates(uint8_t sum_a0_idx, uint8_t sum_a8_idx) {
     init_statelist_cache();
     init_book_of_work();
 
-    // create and run worker threads
-    const size_t num_reduction_working_threads = NUM_REDUCTION_WORKING_THREADS;
-    pthread_t thread_id[num_reduction_working_threads];
-
-    uint16_t sums1[num_reduction_working_threads][3];
-    for (uint32_t i = 0; i < num_reduction_working_threads; i++) {
-        sums1[i][0] = sum_a0_idx;
-        sums1[i][1] = sum_a8_idx;
-        sums1[i][2] = i + 1;
-        pthread_create(thread_id + i, NULL, generate_candidates_worker_thread, sums1[i]);
-    }
-
-    // wait for threads to terminate:
-    for (uint32_t i = 0; i < num_reduction_working_threads; i++) {
-        pthread_join(thread_id[i], NULL);
-    }
+    uint16_t sum_args[2] = {sum_a0_idx, sum_a8_idx};
+    hn_pool_run(hn_pool_workers(), generate_candidates_worker, sum_args);
 
     maximum_states = 0;
     for (statelist_t *sl = candidates; sl != NULL; sl = sl->next) {
@@ -2315,6 +2840,245 @@ static bool brute_force(uint64_t *found_key) {
     return brute_force_bs(NULL, candidates, cuid, num_acquired_nonces, maximum_states, nonces, best_first_bytes, found_key);
 }
 
+void hardnested_set_pipelined(bool enable) {
+    pipelined = enable;
+}
+
+void hardnested_set_lowmem(bool enable) {
+    lowmem = enable;
+}
+
+static void speculation_free(void) {
+    for (uint32_t i = 0; i < spec.count; i++) {
+        free(spec.lists[i].states[ODD_STATE]);
+        free(spec.lists[i].states[EVEN_STATE]);
+    }
+    free(spec.lists);
+    memset(&spec, 0, sizeof(spec));
+}
+
+static uint64_t speculation_states_left(void) {
+    uint64_t left = 0;
+    for (uint32_t i = spec.bucket; i < spec.count; i++) {
+        uint32_t odd = spec.lists[i].len[ODD_STATE] - ((i == spec.bucket) ? spec.odd : 0);
+        left += (uint64_t)odd * spec.lists[i].len[EVEN_STATE];
+    }
+    return left;
+}
+
+// generate the candidates of the best first byte and Sum(a8) guess, and keep a copy
+static void speculation_start(void) {
+    spec.first_byte = best_first_bytes[0];
+    spec.sum_a8_idx = nonces[spec.first_byte].sum_a8_guess[0].sum_a8_idx;
+
+    generate_candidates(first_byte_Sum, spec.sum_a8_idx);
+
+    uint32_t n = 0;
+    for (statelist_t *sl = candidates; sl != NULL; sl = sl->next) {
+        n++;
+    }
+
+    spec.lists = calloc(n ? n : 1, sizeof(statelist_t));
+    if (spec.lists != NULL) {
+        for (statelist_t *sl = candidates; sl != NULL; sl = sl->next) {
+            if (sl->len[ODD_STATE] == 0 || sl->len[EVEN_STATE] == 0) {
+                continue;
+            }
+            statelist_t *l = &spec.lists[spec.count];
+            l->states[ODD_STATE] = malloc(sl->len[ODD_STATE] * sizeof(uint32_t));
+            l->states[EVEN_STATE] = malloc(sl->len[EVEN_STATE] * sizeof(uint32_t));
+            if (l->states[ODD_STATE] == NULL || l->states[EVEN_STATE] == NULL) {
+                free(l->states[ODD_STATE]);
+                free(l->states[EVEN_STATE]);
+                l->states[ODD_STATE] = NULL;
+                l->states[EVEN_STATE] = NULL;
+                break;
+            }
+            memcpy(l->states[ODD_STATE], sl->states[ODD_STATE], sl->len[ODD_STATE] * sizeof(uint32_t));
+            memcpy(l->states[EVEN_STATE], sl->states[EVEN_STATE], sl->len[EVEN_STATE] * sizeof(uint32_t));
+            l->len[ODD_STATE] = sl->len[ODD_STATE];
+            l->len[EVEN_STATE] = sl->len[EVEN_STATE];
+            spec.count++;
+        }
+    }
+
+    free_statelist_cache();
+    free_candidates_memory(candidates);
+    candidates = NULL;
+
+    spec.active = true;
+    spec.pruned_nonces = num_acquired_nonces;
+
+    char progress_text[80];
+    snprintf(progress_text, sizeof(progress_text), "Speculative brute force, Sum(a8) = %" PRIu16, sums[spec.sum_a8_idx]);
+    hardnested_print_progress(num_acquired_nonces, progress_text, speculation_states_left() / 2.0, 0);
+}
+
+// drop the states the new nonces ruled out, the work already done stays done.
+// After a batch only the bitarrays are checked, the (much slower) check against
+// all other first bytes is left for the final pass
+static void speculation_prune_list(uint32_t item, uint32_t worker, void *ctx) {
+    (void)worker;
+    bool final = *(bool *)ctx;
+    statelist_t *l = &spec.lists[spec.bucket + item];
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        uint32_t first = (item == 0 && odd_even == ODD_STATE) ? spec.odd : 0;
+        uint32_t *bitset = nonces[spec.first_byte].states_bitarray[odd_even];
+        uint32_t *p = l->states[odd_even] + first;
+        for (uint32_t i = first; i < l->len[odd_even]; i++) {
+            uint32_t state = l->states[odd_even][i];
+            if (test_bit24(bitset, state)
+                    && test_bit24(all_bitflips_bitarray[odd_even], state)
+                    && (final == false || all_bitflips_match(spec.first_byte, state, odd_even))) {
+                *p++ = state;
+            }
+        }
+        l->len[odd_even] = p - l->states[odd_even];
+    }
+}
+
+static void speculation_prune(bool final) {
+    if ((final == false && spec.pruned_nonces == num_acquired_nonces) || spec.bucket >= spec.count) {
+        return;
+    }
+    hn_pool_run(spec.count - spec.bucket, speculation_prune_list, &final);
+    spec.pruned_nonces = num_acquired_nonces;
+}
+
+// crack the next work units for about budget_ms. The nonces are XORed with the cuid for the
+// brute force only, the acquisition and its bitflip checks need them as they came in
+static bool speculation_slice(uint64_t budget_ms) {
+    uint32_t workers = hn_pool_workers();
+    uint64_t budget = (uint64_t)(brute_force_per_second * (float)budget_ms / 1000.0);
+    statelist_t units[4 * workers];
+    uint32_t num_units = 0;
+    uint64_t unit_states = 0;
+
+    while (spec.bucket < spec.count && num_units < ARRAYLEN(units) && unit_states < budget) {
+        statelist_t *l = &spec.lists[spec.bucket];
+        if (spec.odd >= l->len[ODD_STATE] || l->len[EVEN_STATE] == 0) {
+            spec.bucket++;
+            spec.odd = 0;
+            continue;
+        }
+        uint64_t odd = (budget - unit_states) / workers / l->len[EVEN_STATE];
+        odd = MAX(odd, SPECULATION_MIN_ODD);
+        odd = MIN(odd, l->len[ODD_STATE] - spec.odd);
+
+        units[num_units].states[ODD_STATE] = l->states[ODD_STATE] + spec.odd;
+        units[num_units].len[ODD_STATE] = odd;
+        units[num_units].states[EVEN_STATE] = l->states[EVEN_STATE];
+        units[num_units].len[EVEN_STATE] = l->len[EVEN_STATE];
+        units[num_units].next = NULL;
+        num_units++;
+        unit_states += odd * l->len[EVEN_STATE];
+        spec.odd += odd;
+    }
+
+    if (num_units == 0) {
+        return false;
+    }
+
+    uint8_t first_bytes[256];
+    first_bytes[0] = spec.first_byte;
+    for (uint16_t i = 0, j = 1; i < 256; i++) {
+        if (best_first_bytes[i] != spec.first_byte) {
+            first_bytes[j++] = best_first_bytes[i];
+        }
+    }
+
+    pre_XOR_nonces();
+    prepare_bf_test_nonces(nonces, spec.first_byte);
+    spec.key_found = brute_force_units(units, num_units, cuid, num_acquired_nonces, nonces, first_bytes, &spec.key);
+    pre_XOR_nonces();
+
+    spec.done_states += unit_states;
+    return spec.key_found;
+}
+
+// called after every batch of nonces in pipelined mode. True if the key was found
+static bool speculation_step(void) {
+    if ((hardnested_stage & CHECK_2ND_BYTES) == 0) {
+        return false;
+    }
+
+    if (spec.active && nonces[spec.first_byte].sum_a8_guess[0].sum_a8_idx != spec.sum_a8_idx) {
+        hardnested_print_progress(num_acquired_nonces, "Sum(a8) guess changed, speculative brute force dropped", nonces[best_first_bytes[0]].expected_num_brute_force, 0);
+        speculation_free();
+    }
+
+    if (spec.active == false) {
+        guess_sum_a8_t *guess = &nonces[best_first_bytes[0]].sum_a8_guess[0];
+        if (guess->prob < SPECULATION_MIN_PROB
+                || nonces[best_first_bytes[0]].expected_num_brute_force > brute_force_per_second * SPECULATION_MAX_TIME) {
+            return false;
+        }
+        speculation_start();
+    }
+
+    speculation_prune(false);
+    return speculation_slice(sample_period);
+}
+
+// the main brute force found the speculated guess, finish what is left of it instead of starting over
+static bool speculation_covers(uint16_t sum_a8_idx) {
+    return spec.active && spec.first_byte == best_first_bytes[0] && spec.sum_a8_idx == sum_a8_idx;
+}
+
+static bool speculation_finish(uint64_t *found_key) {
+    speculation_prune(true);
+
+    char progress_text[80];
+    snprintf(progress_text, sizeof(progress_text), "(Speculative brute force: %1.1f%% done during acquisition)",
+             100.0 * spec.done_states / (float)(spec.done_states + speculation_states_left()));
+    hardnested_print_progress(num_acquired_nonces, progress_text, speculation_states_left() / 2.0, 0);
+
+    // brute_force_bs() wants a list of whole buckets
+    statelist_t *first = NULL;
+    statelist_t **link = &first;
+    uint64_t left = 0;
+    for (uint32_t i = spec.bucket; i < spec.count; i++) {
+        statelist_t *l = &spec.lists[i];
+        if (i == spec.bucket && spec.odd) {
+            l->len[ODD_STATE] = (spec.odd < l->len[ODD_STATE]) ? l->len[ODD_STATE] - spec.odd : 0;
+            memmove(l->states[ODD_STATE], l->states[ODD_STATE] + spec.odd, l->len[ODD_STATE] * sizeof(uint32_t));
+            spec.odd = 0;
+        }
+        if (l->len[ODD_STATE] == 0 || l->len[EVEN_STATE] == 0) {
+            continue;
+        }
+        l->next = NULL;
+        *link = l;
+        link = (statelist_t **)&l->next;
+        left += (uint64_t)l->len[ODD_STATE] * l->len[EVEN_STATE];
+    }
+
+    bool key_found = false;
+    if (first != NULL) {
+        key_found = brute_force_bs(NULL, first, cuid, num_acquired_nonces, left, nonces, best_first_bytes, found_key);
+    }
+
+    // keep the statistics in line with a regular guess
+    for (uint8_t i = 0; i < NUM_SUMS; i++) {
+        if (nonces[best_first_bytes[0]].sum_a8_guess[i].sum_a8_idx == spec.sum_a8_idx) {
+            nonces[best_first_bytes[0]].sum_a8_guess[i].num_states = spec.done_states + left;
+            break;
+        }
+    }
+    speculation_free();
+    return key_found;
+}
+
+// the key came up during acquisition already
+static bool speculation_key(uint64_t *found_key) {
+    if (spec.key_found == false) {
+        return false;
+    }
+    *found_key = spec.key;
+    speculation_free();
+    return true;
+}
+
 static uint16_t SumProperty(struct Crypto1State *s) {
     uint16_t sum_odd = PartialSumProperty(s->odd, ODD_STATE);
     uint16_t sum_even = PartialSumProperty(s->even, EVEN_STATE);
@@ -2464,6 +3228,7 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
 
             int res = simulate_acquire_nonces();
             if (res != PM3_SUCCESS) {
+                speculation_free();
                 return res;
             }
 
@@ -2487,7 +3252,10 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
             float expected_brute_force2 = nonces[best_first_bytes[0]].expected_num_brute_force;
             fprintf(fstats, "%1.1f;%1.1f;", log(expected_brute_force1) / log(2.0), log(expected_brute_force2) / log(2.0));
 
-            if (expected_brute_force1 < expected_brute_force2) {
+            if (speculation_key(foundkey)) {
+                key_found = true;
+            } else if (expected_brute_force1 < expected_brute_force2) {
+                speculation_free();
                 hardnested_print_progress(num_acquired_nonces, "(Ignoring Sum(a8) properties)", expected_brute_force1, 0);
                 set_test_state(best_first_byte_smallest_bitarray);
                 add_bitflip_candidates(best_first_byte_smallest_bitarray);
@@ -2519,12 +3287,16 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
                         snprintf(progress_text, sizeof(progress_text), "(Estimated Sum(a8) is WRONG! Correct Sum(a8) = %" PRIu16 ")", real_sum_a8);
                         hardnested_print_progress(num_acquired_nonces, progress_text, expected_brute_force, 0);
                     }
-                    generate_candidates(first_byte_Sum, nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
+                    if (speculation_covers(nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx)) {
+                        key_found = speculation_finish(foundkey);
+                    } else {
+                        generate_candidates(first_byte_Sum, nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
 
-                    key_found = brute_force(foundkey);
-                    free_statelist_cache();
-                    free_candidates_memory(candidates);
-                    candidates = NULL;
+                        key_found = brute_force(foundkey);
+                        free_statelist_cache();
+                        free_candidates_memory(candidates);
+                        candidates = NULL;
+                    }
                     if (key_found == false) {
                         // update the statistics
                         nonces[best_first_bytes[0]].sum_a8_guess[j].prob = 0;
@@ -2549,6 +3321,7 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
                    );
 #endif
 
+            speculation_free();
             free_nonces_memory();
             free_bitarray(all_bitflips_bitarray[ODD_STATE]);
             free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
@@ -2596,6 +3369,7 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
 
             if (res != PM3_SUCCESS) {
                 free_bitflip_bitarrays();
+                speculation_free();
                 free_nonces_memory();
                 free_bitarray(all_bitflips_bitarray[ODD_STATE]);
                 free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
@@ -2622,7 +3396,10 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
         float expected_brute_force1 = (float)num_odd * num_even / 2.0;
         float expected_brute_force2 = nonces[best_first_bytes[0]].expected_num_brute_force;
 
-        if (expected_brute_force1 < expected_brute_force2) {
+        if (speculation_key(foundkey)) {
+            key_found = true;
+        } else if (expected_brute_force1 < expected_brute_force2) {
+            speculation_free();
             hardnested_print_progress(num_acquired_nonces, "(Ignoring Sum(a8) properties)", expected_brute_force1, 0);
             set_test_state(best_first_byte_smallest_bitarray);
             add_bitflip_candidates(best_first_byte_smallest_bitarray);
@@ -2657,11 +3434,15 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
                     hardnested_print_progress(num_acquired_nonces, progress_text, expected_brute_force, 0);
                 }
 
-                generate_candidates(first_byte_Sum, nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
-                key_found = brute_force(foundkey);
-                free_statelist_cache();
-                free_candidates_memory(candidates);
-                candidates = NULL;
+                if (speculation_covers(nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx)) {
+                    key_found = speculation_finish(foundkey);
+                } else {
+                    generate_candidates(first_byte_Sum, nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
+                    key_found = brute_force(foundkey);
+                    free_statelist_cache();
+                    free_candidates_memory(candidates);
+                    candidates = NULL;
+                }
                 if (key_found == false) {
                     // update the statistics
                     nonces[best_first_bytes[0]].sum_a8_guess[j].prob = 0;
@@ -2672,6 +3453,7 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
             }
         }
 
+        speculation_free();
         free_nonces_memory();
         free_bitarray(all_bitflips_bitarray[ODD_STATE]);
         free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
@@ -22,6 +22,17 @@
 #include "common.h"
 
 int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename);
+// most targets one multi target acquisition can take turns between, all keys of a 4k EV1 card
+#define HARDNESTED_MULTI_MAX_TARGETS    84
+// collect nonces for targets (targets_cnt * {block, keytype}) in one field session, written to
+// one file per target in the format of nonce_file_write
+int mfnestedhard_acquire_multi(uint8_t blockNo, uint8_t keyType, const uint8_t *key, const uint8_t *targets, uint8_t targets_cnt,
+                               uint32_t nonces_per_target, bool slow, char **filenames);
+// brute force speculatively while nonces are still acquired (or simulated with tests)
+void hardnested_set_pipelined(bool enable);
+// bound memory use for small hosts: bitflip tables mapped from the cache, the large bitarrays
+// in a file backed scratch mapping, first bytes share their states until restricted
+void hardnested_set_lowmem(bool enable);
 void hardnested_print_progress(uint32_t nonces, const char *activity, float brute_force, uint64_t min_diff_print_time);
 
 #endif
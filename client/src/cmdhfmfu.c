@@ -17,6 +17,7 @@
 //-----------------------------------------------------------------------------
 #include "cmdhfmfu.h"
 #include <ctype.h>
+#include <pthread.h>
 #include "cmdparser.h"
 #include "commonutil.h"
 #include "crypto/libpcrypto.h"
@@ -36,6 +37,7 @@
 #include "cmdtrace.h"       // trace list
 #include "preferences.h"    // setDeviceDebugLevel
 #include "crypto/originality.h"
+#include "util_posix.h"     // msclock
 
 #define MAX_UL_BLOCKS       0x0F
 #define MAX_ULC_BLOCKS      0x2F
@@ -535,6 +537,123 @@ static int ulc_authentication(const uint8_t *key, bool switch_off_field) {
     return PM3_ESOFT;
 }
 
+// Tries count keys on the device, in batches of what fits a packet.
+// found is the index of the matching key, or -1
+static int mfu_chk_keys(uint8_t keytype, uint8_t keyno, const uint8_t *keys, uint32_t count, int32_t *found, uint8_t *pack) {
+
+    *found = -1;
+    uint8_t keylen = (keytype == MFU_CHK_PWD) ? 4 : 16;
+    uint32_t batch = MIN((PM3_CMD_DATA_SIZE - sizeof(mfu_chk_keys_t)) / keylen, 0xFF);
+
+    uint8_t payload[PM3_CMD_DATA_SIZE] = {0};
+    mfu_chk_keys_t *p = (mfu_chk_keys_t *)payload;
+    p->keytype = keytype;
+    p->keyno = keyno;
+
+    for (uint32_t i = 0; i < count; i += batch) {
+
+        p->count = MIN(count - i, batch);
+        memcpy(p->keys, keys + (i * keylen), p->count * keylen);
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_MIFAREU_CHKKEYS, payload, sizeof(mfu_chk_keys_t) + (p->count * keylen));
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_MIFAREU_CHKKEYS, &resp, 2000 + (p->count * 100)) == false) {
+            return PM3_ETIMEOUT;
+        }
+
+        if (resp.status == PM3_SUCCESS) {
+            const mfu_chk_keys_resp_t *r = (const mfu_chk_keys_resp_t *)resp.data.asBytes;
+            *found = i + r->index;
+            if (pack) {
+                memcpy(pack, r->pack, sizeof(r->pack));
+            }
+            return PM3_SUCCESS;
+        }
+
+        if (resp.status != PM3_ESOFT) {
+            return resp.status;
+        }
+    }
+    return PM3_ESOFT;
+}
+
+// Known EV1/NTAG password generators, see 'hf mfu pwdgen'
+typedef struct {
+    const char *desc;
+    uint32_t (*Pwd)(const uint8_t *uid);
+    uint16_t (*Pack)(const uint8_t *uid);
+} mfu_pwdgen_t;
+
+static const mfu_pwdgen_t mfu_pwdgens[] = {
+    {"Transport EV1",   ul_ev1_pwdgenA, ul_ev1_packgenA},
+    {"Amiibo",          ul_ev1_pwdgenB, ul_ev1_packgenB},
+    {"Lego Dimension",  ul_ev1_pwdgenC, ul_ev1_packgenC},
+    {"XYZ 3D printer",  ul_ev1_pwdgenD, ul_ev1_packgenD},
+    {"Xiaomi purifier", ul_ev1_pwdgenE, ul_ev1_packgenE},
+    {"NTAG tools",      ul_ev1_pwdgenF, ul_ev1_packgen_def},
+};
+
+// Philips toothbrush generator input, pages 0x21-0x23 of a selected tag
+static bool mfu_read_philips_mfg(uint8_t *mfg) {
+    uint8_t data[16] = {0x00};
+    int status = ul_read(0x21, data, sizeof(data));
+    if (status != 16) {
+        PrintAndLogEx(DEBUG, "Error: tag didn't answer to READ");
+        return false;
+    }
+    memcpy(mfg, data + 2, 10);
+    return true;
+}
+
+// All generator passwords for the UID, then the built-in passwords and the dictionary,
+// duplicates removed so each one costs a single PWD_AUTH. philips_mfg may be NULL.
+static uint32_t mfu_pwd_candidates(const uint8_t *uid, const uint8_t *philips_mfg, const uint8_t *dict, uint32_t dictcnt, uint8_t **pwds) {
+
+    uint32_t count = ARRAYLEN(mfu_pwdgens) + 1 + ARRAYLEN(default_pwd_pack) + dictcnt;
+    uint8_t *p = calloc(count, 4);
+    if (p == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        *pwds = NULL;
+        return 0;
+    }
+
+    uint32_t n = 0;
+    for (uint8_t i = 0; i < ARRAYLEN(mfu_pwdgens); i++) {
+        num_to_bytes(mfu_pwdgens[i].Pwd(uid), 4, p + (n++ * 4));
+    }
+    if (philips_mfg) {
+        num_to_bytes(ul_ev1_pwdgenG(uid, philips_mfg), 4, p + (n++ * 4));
+    }
+    memcpy(p + (n * 4), default_pwd_pack, sizeof(default_pwd_pack));
+    n += ARRAYLEN(default_pwd_pack);
+    if (dictcnt) {
+        memcpy(p + (n * 4), dict, dictcnt * 4);
+        n += dictcnt;
+    }
+
+    *pwds = p;
+    return dictionary_dedup(p, n, 4, NULL);
+}
+
+// Names the generator a found password comes from, and compares the PACK with the generated one
+static void mfu_pwdgen_print_match(const uint8_t *uid, const uint8_t *philips_mfg, const uint8_t *pwd, const uint8_t *pack) {
+    uint32_t key = bytes_to_num(pwd, 4);
+    uint16_t pk = (pack[0] << 8) | pack[1];
+
+    for (uint8_t i = 0; i < ARRAYLEN(mfu_pwdgens); i++) {
+        if (mfu_pwdgens[i].Pwd(uid) == key) {
+            bool ok = (mfu_pwdgens[i].Pack(uid) == pk);
+            PrintAndLogEx(SUCCESS, "Generator.. " _YELLOW_("%s") ", pack %s", mfu_pwdgens[i].desc, ok ? _GREEN_("matches") : _RED_("differs"));
+            return;
+        }
+    }
+    if (philips_mfg && ul_ev1_pwdgenG(uid, philips_mfg) == key) {
+        bool ok = (ul_ev1_packgenG(uid, philips_mfg) == pk);
+        PrintAndLogEx(SUCCESS, "Generator.. " _YELLOW_("Philips Toothbrush") ", pack %s", ok ? _GREEN_("matches") : _RED_("differs"));
+    }
+}
+
 static int trace_mfuc_try_key(uint8_t *key, int state, uint8_t (*authdata)[16]) {
     uint8_t iv[8] = {0};
     uint8_t RndB[8] = {0};
@@ -574,17 +693,100 @@ static int trace_mfuc_try_key(uint8_t *key, int state, uint8_t (*authdata)[16])
     return PM3_ESOFT;
 }
 
+typedef struct {
+    uint8_t *keys;
+    uint32_t count;
+    uint8_t (*authdata)[16];
+    uint32_t next;
+    int32_t found;
+} mfuc_trace_search_t;
+
+static void *mfuc_trace_search_worker(void *arg) {
+    mfuc_trace_search_t *s = (mfuc_trace_search_t *)arg;
+    for (;;) {
+        if (__atomic_load_n(&s->found, __ATOMIC_RELAXED) >= 0) {
+            break;
+        }
+        uint32_t i = __atomic_fetch_add(&s->next, 1, __ATOMIC_RELAXED);
+        if (i >= s->count) {
+            break;
+        }
+        if (trace_mfuc_try_key(s->keys + (i * 16), 2, s->authdata) == PM3_SUCCESS) {
+            __atomic_store_n(&s->found, (int32_t)i, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    return NULL;
+}
+
+// below this many keys, starting threads costs more than the search
+#define MFUC_TRACE_THREADED_MIN 64
+
+// built-in keys followed by mfulc_default_keys.dic, loaded once
+static uint8_t *mfuc_trace_keys(uint32_t *count) {
+    static uint8_t *keys = NULL;
+    static uint32_t keycnt = 0;
+    static bool loaded = false;
+
+    if (loaded == false) {
+        loaded = true;
+
+        uint8_t *dict = NULL;
+        uint32_t dictcnt = 0;
+        if (loadFileDICTIONARY_safe_ex("mfulc_default_keys", ".dic", (void **)&dict, 16, &dictcnt, false) != PM3_SUCCESS) {
+            dictcnt = 0;
+        }
+
+        keys = calloc(ARRAYLEN(default_3des_keys) + dictcnt, 16);
+        if (keys != NULL) {
+            memcpy(keys, default_3des_keys, sizeof(default_3des_keys));
+            if (dictcnt) {
+                memcpy(keys + sizeof(default_3des_keys), dict, dictcnt * 16);
+            }
+            keycnt = ARRAYLEN(default_3des_keys) + dictcnt;
+        }
+        free(dict);
+    }
+
+    if (keys == NULL) {
+        *count = ARRAYLEN(default_3des_keys);
+        return (uint8_t *)default_3des_keys;
+    }
+    *count = keycnt;
+    return keys;
+}
+
 int trace_mfuc_try_default_3des_keys(uint8_t **correct_key, int state, uint8_t (*authdata)[16]) {
     switch (state) {
-        case 2:
-            for (uint8_t i = 0; i < ARRAYLEN(default_3des_keys); ++i) {
-                uint8_t *key = default_3des_keys[i];
-                if (trace_mfuc_try_key(key, state, authdata) == PM3_SUCCESS) {
-                    *correct_key = key;
-                    return PM3_SUCCESS;
+        case 2: {
+            mfuc_trace_search_t s = {
+                .authdata = authdata,
+                .found = -1,
+            };
+            s.keys = mfuc_trace_keys(&s.count);
+
+            int n = (s.count < MFUC_TRACE_THREADED_MIN) ? 0 : MIN(num_CPUs(), (int)s.count);
+            pthread_t *tids = calloc(n ? n : 1, sizeof(pthread_t));
+            int started = 0;
+            for (; tids && started < n; started++) {
+                if (pthread_create(&tids[started], NULL, mfuc_trace_search_worker, &s) != 0) {
+                    break;
                 }
             }
+            if (started == 0) {
+                mfuc_trace_search_worker(&s);
+            }
+            for (int i = 0; i < started; i++) {
+                pthread_join(tids[i], NULL);
+            }
+            free(tids);
+
+            if (s.found >= 0) {
+                *correct_key = s.keys + (s.found * 16);
+                return PM3_SUCCESS;
+            }
             break;
+        }
         case 3:
             return trace_mfuc_try_key(*correct_key, state, authdata);
             break;
@@ -613,13 +815,10 @@ static int try_default_3des_keys(bool override, uint8_t **correct_key) {
     PrintAndLogEx(INFO, "");
     PrintAndLogEx(SUCCESS, "--- " _CYAN_("Known UL-C 3DES keys"));
 
-    for (uint8_t i = 0; i < ARRAYLEN(default_3des_keys); ++i) {
-        uint8_t *key = default_3des_keys[i];
-        if (ulc_authentication(key, true) == PM3_SUCCESS) {
-            *correct_key = key;
-            res = PM3_SUCCESS;
-            break;
-        }
+    int32_t found = -1;
+    if (mfu_chk_keys(MFU_CHK_ULC, 0, (uint8_t *)default_3des_keys, ARRAYLEN(default_3des_keys), &found, NULL) == PM3_SUCCESS) {
+        *correct_key = default_3des_keys[found];
+        res = PM3_SUCCESS;
     }
 
     if (override) {
@@ -647,36 +846,21 @@ static int try_default_aes_keys(bool override) {
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(SUCCESS, "--- " _CYAN_("Known UL-AES keys"));
 
-    for (uint8_t i = 0; i < ARRAYLEN(default_aes_keys); ++i) {
-        uint8_t *key = default_aes_keys[i];
-
-        for (uint8_t keyno = 0; keyno < 3; keyno++) {
-
-            if (ulaes_requestAuthentication(key, keyno, true) == PM3_SUCCESS) {
-
-                char keystr[20] = {0};
-                switch (keyno) {
-                    case 0:
-                        sprintf(keystr, "Data key");
-                        break;
-                    case 1:
-                        sprintf(keystr, "UID key");
-                        break;
-                    case 2:
-                        sprintf(keystr, "Authenticity key");
-                        break;
-                    default:
-                        break;
-                }
-                PrintAndLogEx(SUCCESS, "%02X " _YELLOW_("%s") " - %s ( "_GREEN_("ok") " )"
-                              , keyno
-                              , keystr
-                              , sprint_hex_inrow(key, 16)
-                             );
+    for (uint8_t keyno = 0; keyno < 3; keyno++) {
 
-                res = PM3_SUCCESS;
-            }
+        int32_t found = -1;
+        if (mfu_chk_keys(MFU_CHK_ULAES, keyno, (uint8_t *)default_aes_keys, ARRAYLEN(default_aes_keys), &found, NULL) != PM3_SUCCESS) {
+            continue;
         }
+
+        const char *keystr[] = { "Data key", "UID key", "Authenticity key" };
+        PrintAndLogEx(SUCCESS, "%02X " _YELLOW_("%s") " - %s ( "_GREEN_("ok") " )"
+                      , keyno
+                      , keystr[keyno]
+                      , sprint_hex_inrow(default_aes_keys[found], 16)
+                     );
+
+        res = PM3_SUCCESS;
     }
 
     if (override) {
@@ -2561,81 +2745,27 @@ static int CmdHF14AMfUInfo(const char *Cmd) {
             PrintAndLogEx(NORMAL, "");
             PrintAndLogEx(SUCCESS, "--- " _CYAN_("Known EV1/NTAG passwords"));
 
-            // test pwd gen A
-            num_to_bytes(ul_ev1_pwdgenA(card.uid), 4, key);
-            len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-            if (len > -1) {
-                has_auth_key = true;
-                ak_len = 4;
-                memcpy(authenticationkey, key, 4);
-                PrintAndLogEx(SUCCESS, "Password... " _GREEN_("%s") "  pack... " _GREEN_("%02X%02X"), sprint_hex_inrow(key, 4), pack[0], pack[1]);
-                goto out;
-            }
-
-            if (ul_auth_select(&card, tagtype, has_auth_key, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) {
-                return PM3_ESOFT;
-            }
+            // all pwd gen algos, then the known passwords, in one batch on the device
+            uint8_t philips_mfg[10] = {0};
+            bool has_mfg = mfu_read_philips_mfg(philips_mfg);
+            uint8_t *pwds = NULL;
+            uint32_t pwdcnt = mfu_pwd_candidates(card.uid, has_mfg ? philips_mfg : NULL, NULL, 0, &pwds);
 
-            // test pwd gen B
-            num_to_bytes(ul_ev1_pwdgenB(card.uid), 4, key);
-            len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-            if (len > -1) {
-                has_auth_key = true;
-                ak_len = 4;
-                memcpy(authenticationkey, key, 4);
-                PrintAndLogEx(SUCCESS, "Password... " _GREEN_("%s") "  pack... " _GREEN_("%02X%02X"), sprint_hex_inrow(key, 4), pack[0], pack[1]);
-                goto out;
-            }
-
-            if (ul_auth_select(&card, tagtype, has_auth_key, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) {
-                return PM3_ESOFT;
-            }
-
-            // test pwd gen C
-            num_to_bytes(ul_ev1_pwdgenC(card.uid), 4, key);
-            len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-            if (len > -1) {
-                has_auth_key = true;
-                ak_len = 4;
-                memcpy(authenticationkey, key, 4);
-                PrintAndLogEx(SUCCESS, "Password... " _GREEN_("%s") "  pack... " _GREEN_("%02X%02X"), sprint_hex_inrow(key, 4), pack[0], pack[1]);
-                goto out;
-            }
-
-            if (ul_auth_select(&card, tagtype, has_auth_key, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) {
-                return PM3_ESOFT;
-            }
+            DropField();
 
-            // test pwd gen D
-            num_to_bytes(ul_ev1_pwdgenD(card.uid), 4, key);
-            len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-            if (len > -1) {
+            int32_t found = -1;
+            len = -1;
+            if (pwdcnt && mfu_chk_keys(MFU_CHK_PWD, 0, pwds, pwdcnt, &found, pack) == PM3_SUCCESS) {
+                memcpy(authenticationkey, pwds + (found * 4), 4);
+                free(pwds);
+                key = authenticationkey;
                 has_auth_key = true;
                 ak_len = 4;
-                memcpy(authenticationkey, key, 4);
                 PrintAndLogEx(SUCCESS, "Password... " _GREEN_("%s") "  pack... " _GREEN_("%02X%02X"), sprint_hex_inrow(key, 4), pack[0], pack[1]);
+                mfu_pwdgen_print_match(card.uid, has_mfg ? philips_mfg : NULL, key, pack);
                 goto out;
             }
-
-            if (ul_auth_select(&card, tagtype, has_auth_key, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) {
-                return PM3_ESOFT;
-            }
-
-            for (uint8_t i = 0; i < ARRAYLEN(default_pwd_pack); ++i) {
-                key = default_pwd_pack[i];
-                len = ulev1_requestAuthentication(key, pack, sizeof(pack));
-                if (len > -1) {
-                    has_auth_key = true;
-                    ak_len = 4;
-                    memcpy(authenticationkey, key, 4);
-                    PrintAndLogEx(SUCCESS, "Password... " _GREEN_("%s") "  pack... " _GREEN_("%02X%02X"), sprint_hex_inrow(key, 4), pack[0], pack[1]);
-                    break;
-                } else {
-                    if (ul_auth_select(&card, tagtype, has_auth_key, authkeyptr, pack, sizeof(pack)) == PM3_ESOFT) {
-                        return PM3_ESOFT;
-                    }
-                }
-            }
+            free(pwds);
             if (len < 1) {
                 PrintAndLogEx(WARNING, _YELLOW_("password not known"));
                 PrintAndLogEx(HINT, "Hint: Try " _YELLOW_("`hf mfu pwdgen -r`") " to get see known pwd gen algo suggestions");
@@ -3115,6 +3245,19 @@ void mfu_print_dump(mfu_dump_t *card, uint16_t pages, uint8_t startpage, bool de
 //
 //  Mifare Ultralight / Ultralight-C / Ultralight-EV1
 //  Read and Dump Card Contents,  using auto detection of tag size.
+// cards answering FAST_READ (0x3A)
+static bool mfu_has_fastread(uint64_t tagtype) {
+    if (tagtype == MFU_TT_UL_ERROR) {
+        return false;
+    }
+    const uint64_t fast = MFU_TT_UL_EV1_48 | MFU_TT_UL_EV1_128 | MFU_TT_UL_EV1 | MFU_TT_UL_NANO_40 |
+                          MFU_TT_NTAG_210 | MFU_TT_NTAG_212 | MFU_TT_NTAG_213 | MFU_TT_NTAG_215 | MFU_TT_NTAG_216 |
+                          MFU_TT_NTAG_213_F | MFU_TT_NTAG_216_F | MFU_TT_NTAG_213_TT | MFU_TT_NTAG_213_C | MFU_TT_NTAG_210u |
+                          MFU_TT_NTAG_I2C_1K | MFU_TT_NTAG_I2C_2K | MFU_TT_NTAG_I2C_1K_PLUS | MFU_TT_NTAG_I2C_2K_PLUS |
+                          MFU_TT_UL_AES;
+    return (tagtype & fast) != 0;
+}
+
 static int CmdHF14AMfUDump(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -3218,6 +3361,11 @@ static int CmdHF14AMfUDump(const char *Cmd) {
             keytype = 2; // UL_EV1/NTAG auth
     }
 
+    // the device falls back to READ if the card refuses part of a range
+    if (mfu_has_fastread(tagtype)) {
+        keytype |= MFU_READCARD_FASTREAD;
+    }
+
     uint8_t dbg_curr = DBG_NONE;
     if (getDeviceDebugLevel(&dbg_curr) != PM3_SUCCESS) {
         return PM3_ESOFT;
@@ -3579,7 +3727,8 @@ int CmdHF14MfUTamper(const char *Cmd) {
 static int CmdHF14AMfURestore(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mfu restore",
-                  "Restore MIFARE Ultralight/NTAG dump file (bin/eml/json) to tag.\n",
+                  "Restore MIFARE Ultralight/NTAG dump file (bin/eml/json) to tag.\n"
+                  "Data pages already holding the dump content are skipped, written pages are read back to verify.\n",
                   "hf mfu restore -f myfile -s                 -> special write\n"
                   "hf mfu restore -f myfile -k AABBCCDD -s     -> special write, use key\n"
                   "hf mfu restore -f myfile -k AABBCCDD -ser   -> special write, use key, write dump pwd, ..."
@@ -3745,21 +3894,61 @@ static int CmdHF14AMfURestore(const char *Cmd) {
     }
 
     PrintAndLogEx(INFO, "Restoring data blocks.");
-    PrintAndLogEx(INFO, "." NOLF);
+
+    uint8_t flags = MFU_WRITE_COMPARE | MFU_WRITE_VERIFY;
+    if (mfu_has_fastread(GetHF14AMfU_Type())) {
+        flags |= MFU_WRITE_FASTREAD;
+    }
+
     // write all other data
     // Skip block 0,1,2,3 (only magic tags can write to them)
     // Skip last 5 blocks usually is configuration
-    for (uint8_t b = 4; b < pages - 5; b++) {
+    // The device compares before writing and verifies after, a batch of pages per field session
+    uint16_t written = 0, skipped = 0;
+    for (uint8_t b = 4; b < pages - 5;) {
+
+        uint8_t n = MIN(pages - 5 - b, 120);
+
+        uint8_t payload[sizeof(mfu_write_pages_t) + (120 * 4)] = {0};
+        mfu_write_pages_t *wp = (mfu_write_pages_t *)payload;
+        wp->flags = flags;
+        wp->keytype = keytype;
+        if (keytype) {
+            memcpy(wp->key, data + 4, (keytype == 1) ? 16 : 4);
+        }
+        wp->start = b;
+        wp->count = n;
+        memcpy(wp->data, mem->data + (b * 4), n * 4);
 
-        //Send write Block
-        memcpy(data, mem->data + (b * 4), 4);
         clearCommandBuffer();
-        SendCommandMIX(CMD_HF_MIFAREU_WRITEBL, b, keytype, 0, data, sizeof(data));
-        wait4response(b);
-        PrintAndLogEx(NORMAL, "." NOLF);
-        fflush(stdout);
+        SendCommandNG(CMD_HF_MIFAREU_WRITE_PAGES, payload, sizeof(mfu_write_pages_t) + (n * 4));
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_MIFAREU_WRITE_PAGES, &resp, 1500 + (n * 50)) == false) {
+            PrintAndLogEx(WARNING, "command execution time out");
+            DropField();
+            free(dump);
+            return PM3_ETIMEOUT;
+        }
+
+        const mfu_write_pages_resp_t *r = (const mfu_write_pages_resp_t *)resp.data.asBytes;
+        written += r->written;
+        skipped += r->skipped;
+
+        if (resp.status == PM3_ESOFT) {
+            PrintAndLogEx(WARNING, "verify failed at block " _YELLOW_("%u"), r->page);
+        } else if (resp.status != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "failed to write block " _YELLOW_("%u"), r->page);
+        }
+
+        if (resp.status != PM3_SUCCESS) {
+            PrintAndLogEx(INFO, "Written " _YELLOW_("%u") " blocks, " _YELLOW_("%u") " already matched", written, skipped);
+            DropField();
+            free(dump);
+            return PM3_ESOFT;
+        }
+        b += n;
     }
-    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, "Written " _YELLOW_("%u") " blocks, " _YELLOW_("%u") " already matched", written, skipped);
 
     // write special data last
     if (write_special) {
@@ -3982,6 +4171,146 @@ static int CmdHF14AMfUAESAuth(const char *Cmd) {
     return result;
 }
 
+static int CmdHF14AMfUChk(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mfu chk",
+                  "Check UL-C 3DES keys, UL-AES keys or EV1/NTAG passwords, depending on the tag.\n"
+                  "Built-in keys and all known password generators are tried first, then the dictionary,\n"
+                  "duplicates removed.\n"
+                  "Keys are tried on the device in batches.\n"
+                  "Tags with AUTHLIM set count every wrong password towards locking themselves!",
+                  "hf mfu chk\n"
+                  "hf mfu chk -f mfulc_default_keys     -> UL-C / UL-AES, add dictionary\n"
+                  "hf mfu chk -f mypwds                 -> EV1/NTAG, 4 byte passwords"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("f", "file", "<fn>", "Specify a filename for dictionary"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    CLIParserFree(ctx);
+
+    iso14a_card_select_t card;
+    if (ul_select(&card) == false) {
+        return PM3_ECARDEXCHANGE;
+    }
+    uint8_t philips_mfg[10] = {0};
+    bool has_mfg = mfu_read_philips_mfg(philips_mfg);
+    DropField();
+
+    uint64_t tagtype = GetHF14AMfU_Type();
+    if (tagtype == MFU_TT_UL_ERROR) {
+        return PM3_ESOFT;
+    }
+
+    uint8_t keytype = MFU_CHK_PWD;
+    uint8_t keylen = 4;
+    if ((tagtype & MFU_TT_UL_C) == MFU_TT_UL_C) {
+        keytype = MFU_CHK_ULC;
+        keylen = 16;
+    } else if ((tagtype & MFU_TT_UL_AES) == MFU_TT_UL_AES) {
+        keytype = MFU_CHK_ULAES;
+        keylen = 16;
+    } else if (tagtype == MFU_TT_UL || tagtype == MFU_TT_NTAG_203) {
+        PrintAndLogEx(INFO, "Tag has no authentication");
+        return PM3_SUCCESS;
+    }
+
+    uint8_t *dict = NULL;
+    uint32_t dictcnt = 0;
+    if (fnlen) {
+        int res = loadFileDICTIONARY_safe(filename, (void **)&dict, keylen, &dictcnt);
+        if (res != PM3_SUCCESS || dictcnt == 0) {
+            free(dict);
+            return PM3_EFILE;
+        }
+    }
+
+    // built-in keys first, for passwords all the generators before
+    uint32_t count = 0;
+    uint8_t *keys = NULL;
+    if (keytype == MFU_CHK_PWD) {
+        count = mfu_pwd_candidates(card.uid, has_mfg ? philips_mfg : NULL, dict, dictcnt, &keys);
+    } else {
+        const uint8_t *builtin = (keytype == MFU_CHK_ULC) ? (const uint8_t *)default_3des_keys : (const uint8_t *)default_aes_keys;
+        uint32_t builtin_cnt = (keytype == MFU_CHK_ULC) ? ARRAYLEN(default_3des_keys) : ARRAYLEN(default_aes_keys);
+        count = builtin_cnt + dictcnt;
+        keys = calloc(count, keylen);
+        if (keys) {
+            memcpy(keys, builtin, builtin_cnt * keylen);
+            if (dictcnt) {
+                memcpy(keys + (builtin_cnt * keylen), dict, dictcnt * keylen);
+            }
+        }
+    }
+    free(dict);
+
+    if (keys == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    PrintAndLogEx(INFO, "Checking " _YELLOW_("%u") " %s", count, (keytype == MFU_CHK_PWD) ? "passwords" : "keys");
+
+    uint8_t dbg_curr = DBG_NONE;
+    if (getDeviceDebugLevel(&dbg_curr) != PM3_SUCCESS) {
+        free(keys);
+        return PM3_ESOFT;
+    }
+
+    if (setDeviceDebugLevel(DBG_NONE, false) != PM3_SUCCESS) {
+        free(keys);
+        return PM3_ESOFT;
+    }
+
+    uint64_t t1 = msclock();
+    int res = PM3_ESOFT;
+    bool found_any = false;
+    uint8_t keynos = (keytype == MFU_CHK_ULAES) ? 3 : 1;
+    for (uint8_t keyno = 0; keyno < keynos; keyno++) {
+
+        int32_t found = -1;
+        uint8_t pack[2] = {0};
+        res = mfu_chk_keys(keytype, keyno, keys, count, &found, pack);
+        if (res == PM3_EOPABORTED) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!");
+            break;
+        }
+
+        if (res != PM3_SUCCESS) {
+            continue;
+        }
+
+        found_any = true;
+        const uint8_t *k = keys + (found * keylen);
+        if (keytype == MFU_CHK_PWD) {
+            PrintAndLogEx(SUCCESS, "Password... " _GREEN_("%s") "  pack... " _GREEN_("%02X%02X"), sprint_hex_inrow(k, 4), pack[0], pack[1]);
+            mfu_pwdgen_print_match(card.uid, has_mfg ? philips_mfg : NULL, k, pack);
+        } else if (keytype == MFU_CHK_ULAES) {
+            PrintAndLogEx(SUCCESS, "%02X " _YELLOW_("%s") " - %s ( "_GREEN_("ok") " )", keyno, key_type[keyno], sprint_hex_inrow(k, 16));
+        } else {
+            PrintAndLogEx(SUCCESS, "3DES key... " _GREEN_("%s"), sprint_hex_inrow(k, 16));
+        }
+    }
+
+    setDeviceDebugLevel(dbg_curr, false);
+    free(keys);
+
+    PrintAndLogEx(SUCCESS, "time in check " _YELLOW_("%.1f") " seconds", (float)(msclock() - t1) / 1000.0);
+
+    if (found_any == false) {
+        PrintAndLogEx(WARNING, "No valid %s found", (keytype == MFU_CHK_PWD) ? "password" : "key");
+        return (res == PM3_EOPABORTED) ? res : PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
 /**
 A test function to validate that the polarssl-function works the same
 was as the openssl-implementation.
@@ -4426,13 +4755,7 @@ static int CmdHF14AMfUPwdGen(const char *Cmd) {
             iso14a_card_select_t card;
             if (ul_select(&card)) {
                 // Philips toothbrush needs page 0x21-0x23
-                uint8_t data[16] = {0x00};
-                int status = ul_read(0x21, data, sizeof(data));
-                if (status <= 0) {
-                    PrintAndLogEx(DEBUG, "Error: tag didn't answer to READ");
-                } else if (status == 16) {
-                    memcpy(philips_mfg, data + 2, sizeof(philips_mfg));
-                }
+                mfu_read_philips_mfg(philips_mfg);
                 DropField();
             }
         }
@@ -5514,13 +5837,201 @@ static int CmdHF14AMfuList(const char *Cmd) {
     return CmdTraceListAlias(Cmd, "hf 14a", "14a -c");
 }
 
+// NTAG215 pages of an Amiibo, the last five are dynamic lock, CFG0, CFG1, PWD and PACK
+#define AMIIBO_PAGES        (MAX_NTAG_215 + 1)
+#define AMIIBO_DUMP_SIZE    (MFU_DUMP_PREFIX_LENGTH + (AMIIBO_PAGES * MFU_BLOCK_SIZE))
+
+// Checks the signatures of an Amiibo dump and signs it again, for `uid` when not NULL.
+// PWD and PACK are set to the ones of the UID, so the dump is ready for `hf mfu restore` and `hf mfu sim -t 7`
+static int amiibo_resign(const nfc3d_amiibo_keys_t *keys, mfu_dump_t *d, const uint8_t *uid) {
+
+    uint8_t plain[NFC3D_AMIIBO_SIZE] = {0};
+    if (nfc3d_amiibo_unpack(keys, d->data, plain) == false) {
+        return PM3_ESOFT;
+    }
+
+    if (uid) {
+        nfc3d_amiibo_set_uid(plain, uid);
+    }
+    nfc3d_amiibo_pack(keys, plain, d->data);
+
+    uint8_t taguid[7];
+    memcpy(taguid, d->data, 3);
+    memcpy(taguid + 3, d->data + 4, 4);
+
+    // dynamic lock, CFG0 with AUTH0 = 4, CFG1
+    memcpy(d->data + (0x82 * MFU_BLOCK_SIZE), "\x01\x00\x0F\xBD", MFU_BLOCK_SIZE);
+    memcpy(d->data + (0x83 * MFU_BLOCK_SIZE), "\x00\x00\x00\x04", MFU_BLOCK_SIZE);
+    memcpy(d->data + (0x84 * MFU_BLOCK_SIZE), "\x5F\x00\x00\x00", MFU_BLOCK_SIZE);
+    num_to_bytes(ul_ev1_pwdgenB(taguid), 4, d->data + (0x85 * MFU_BLOCK_SIZE));
+    memcpy(d->data + (0x86 * MFU_BLOCK_SIZE), "\x80\x80\x00\x00", MFU_BLOCK_SIZE);
+
+    if (memcmp(d->version, "\x00\x00\x00\x00\x00\x00\x00\x00", 8) == 0) {
+        memcpy(d->version, "\x00\x04\x04\x02\x01\x00\x11\x03", 8);
+    }
+    d->pages = MAX_NTAG_215;
+    return PM3_SUCCESS;
+}
+
+// Amiibo dump of a file, in the new Ultralight / NTAG layout
+static int amiibo_load(const char *fn, mfu_dump_t *d, bool verbose) {
+
+    uint8_t *dump = NULL;
+    size_t dumplen = 0;
+    int res = pm3_load_dump(fn, (void **)&dump, &dumplen, sizeof(mfu_dump_t));
+    if (res != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
+
+    if (dumplen < MFU_DUMP_PREFIX_LENGTH) {
+        PrintAndLogEx(ERR, "Error, dump file `%s` is too small", fn);
+        free(dump);
+        return PM3_ESOFT;
+    }
+
+    res = convert_mfu_dump_format(&dump, &dumplen, verbose);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Failed convert on load to new Ultralight/NTAG format");
+        free(dump);
+        return res;
+    }
+
+    if (dumplen < MFU_DUMP_PREFIX_LENGTH + NFC3D_AMIIBO_SIZE) {
+        PrintAndLogEx(ERR, "Error, `%s` is too small for an Amiibo", fn);
+        free(dump);
+        return PM3_ESOFT;
+    }
+
+    memset(d, 0, sizeof(mfu_dump_t));
+    memcpy(d, dump, MIN(dumplen, sizeof(mfu_dump_t)));
+    free(dump);
+    return PM3_SUCCESS;
+}
+
+typedef struct {
+    const char *fn;
+    char out[FILE_PATH_SIZE];
+    int res;
+} amiibo_job_t;
+
+typedef struct {
+    nfc3d_amiibo_keys_t keys;
+    const uint8_t *uid;
+    amiibo_job_t *jobs;
+    size_t count;
+    size_t next;
+} amiibo_batch_t;
+
+static void *amiibo_batch_worker(void *arg) {
+    amiibo_batch_t *b = (amiibo_batch_t *)arg;
+    mfu_dump_t d;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->count) {
+            break;
+        }
+        amiibo_job_t *job = &b->jobs[i];
+        if (job->res != PM3_SUCCESS) {
+            continue;
+        }
+        job->res = amiibo_load(job->fn, &d, false);
+        if (job->res == PM3_SUCCESS) {
+            job->res = amiibo_resign(&b->keys, &d, b->uid);
+        }
+        if (job->res == PM3_SUCCESS) {
+            job->res = saveFileJSONex(job->out, jsfMfuMemory, (uint8_t *)&d, AMIIBO_DUMP_SIZE, true, NULL, spItemCount);
+        }
+    }
+    return NULL;
+}
+
+// re-signs every dump of a directory, in parallel
+static int amiibo_resign_dir(const char *dir, const char *outdir, const uint8_t *uid) {
+
+    amiibo_batch_t b = { .uid = uid };
+    if (nfc3d_amiibo_load_keys(&b.keys) == false) {
+        PrintAndLogEx(INFO, "loading key file ( " _RED_("fail") " )");
+        return PM3_EFILE;
+    }
+
+    char **files = NULL;
+    int res = listDumpFiles(dir, &files, &b.count);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    b.jobs = calloc(b.count ? b.count : 1, sizeof(amiibo_job_t));
+    if (b.jobs == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        for (size_t i = 0; i < b.count; i++) {
+            free(files[i]);
+        }
+        free(files);
+        return PM3_EMALLOC;
+    }
+
+    for (size_t i = 0; i < b.count; i++) {
+        amiibo_job_t *job = &b.jobs[i];
+        job->fn = files[i];
+        char base[FILE_PATH_SIZE - 16] = {0};
+        if (dump_outname(job->fn, outdir, base, sizeof(base)) == false) {
+            PrintAndLogEx(WARNING, "Output name for `%s` is too long", job->fn);
+            job->res = PM3_EOVFLOW;
+            continue;
+        }
+        snprintf(job->out, sizeof(job->out), "%s-resigned", base);
+    }
+
+    if (b.count == 0) {
+        PrintAndLogEx(INFO, "No dump files found in `" _YELLOW_("%s") "`", dir);
+    }
+
+    uint64_t t1 = msclock();
+    int n = MIN(num_CPUs(), (int)b.count);
+    pthread_t *tids = calloc(n ? n : 1, sizeof(pthread_t));
+    int started = 0;
+    for (; tids && started < n; started++) {
+        if (pthread_create(&tids[started], NULL, amiibo_batch_worker, &b) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        amiibo_batch_worker(&b);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+    t1 = msclock() - t1;
+
+    size_t failed = 0;
+    for (size_t i = 0; i < b.count; i++) {
+        if (b.jobs[i].res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "`" _YELLOW_("%s") "` failed, %s", b.jobs[i].fn, (b.jobs[i].res == PM3_ESOFT) ? "not a valid Amiibo" : "error");
+            failed++;
+        }
+    }
+    PrintAndLogEx(SUCCESS, "%zu files, " _GREEN_("%zu") " re-signed, %zu failed ( %.1f s )", b.count, b.count - failed, failed, (float)t1 / 1000.0);
+
+    free(b.jobs);
+    for (size_t i = 0; i < b.count; i++) {
+        free(files[i]);
+    }
+    free(files);
+    return (failed) ? PM3_ESOFT : PM3_SUCCESS;
+}
+
 static int CmdHF14AAmiibo(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mfu amiibo",
-                  "Tries to read all memory from amiibo tag and decrypt it",
+                  "Tries to read all memory from amiibo tag and decrypt it\n"
+                  "With `--uid` the dump is signed again for another NTAG215, with PWD and PACK of that UID.\n"
+                  "With `--dir` every dump of a directory is checked and signed again, in parallel",
                   "hf mfu amiiboo --dec -f hf-mfu-04579DB27C4880-dump.bin  --> decrypt file\n"
-                  "hf mfu amiiboo -v --dec                                 --> decrypt tag"
+                  "hf mfu amiiboo -v --dec                                 --> decrypt tag\n"
+                  "hf mfu amiibo -i amiibo.bin --uid 04112233445566 --eload  --> re-sign for a UID, load into emulator\n"
+                  "hf mfu amiibo --dir amiibos -o resigned --uid 04112233445566 --> re-sign a directory of dumps"
                  );
 
     void *argtable[] = {
@@ -5528,8 +6039,11 @@ static int CmdHF14AAmiibo(const char *Cmd) {
         arg_lit0(NULL, "dec", "Decrypt memory"),
         arg_lit0(NULL, "enc", "Encrypt memory"),
         arg_str0("i", "in", "<fn>", "Specify a filename for input dump file"),
-        arg_str0("o", "out", "<fn>", "Specify a filename for output dump file"),
+        arg_str0("o", "out", "<fn>", "Specify a filename for output dump file, the output directory with --dir"),
         arg_lit0("v", "verbose", "Verbose output"),
+        arg_str0("u", "uid", "<hex>", "re-sign the dump for this 7 byte UID"),
+        arg_str0(NULL, "dir", "<dir>", "re-sign every dump of this directory"),
+        arg_lit0(NULL, "eload", "load the re-signed dump into emulator memory"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -5546,6 +6060,16 @@ static int CmdHF14AAmiibo(const char *Cmd) {
     CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)outfilename, FILE_PATH_SIZE, &outfnlen);
 
     bool verbose = arg_get_lit(ctx, 5);
+
+    int uidlen = 0;
+    uint8_t uid[7] = {0};
+    CLIGetHexWithReturn(ctx, 6, uid, &uidlen);
+
+    int dirlen = 0;
+    char dir[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 7), (uint8_t *)dir, FILE_PATH_SIZE, &dirlen);
+
+    bool eload = arg_get_lit(ctx, 8);
     CLIParserFree(ctx);
 
     // sanity checks
@@ -5554,6 +6078,19 @@ static int CmdHF14AAmiibo(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if (uidlen && uidlen != 7) {
+        PrintAndLogEx(WARNING, "UID must be 7 hex bytes");
+        return PM3_EINVARG;
+    }
+
+    if (dirlen) {
+        if (eload) {
+            PrintAndLogEx(WARNING, "Only one dump fits the emulator memory, don't use `--eload` with `--dir`");
+            return PM3_EINVARG;
+        }
+        return amiibo_resign_dir(dir, outfilename, (uidlen) ? uid : NULL);
+    }
+
     // load keys
     nfc3d_amiibo_keys_t amiibo_keys;
     if (nfc3d_amiibo_load_keys(&amiibo_keys) == false) {
@@ -5563,34 +6100,19 @@ static int CmdHF14AAmiibo(const char *Cmd) {
 
     int res = PM3_ESOFT;
 
-    uint8_t original[NFC3D_AMIIBO_SIZE] = {0};
+    mfu_dump_t *d = calloc(1, sizeof(mfu_dump_t));
+    if (d == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
 
     // load dump file if available
     if (infnlen > 0) {
-        uint8_t *dump = NULL;
-        size_t dumplen = 0;
-        res = loadFile_safe(infilename, "", (void **)&dump, &dumplen);
-        if (res != PM3_SUCCESS) {
-            free(dump);
-            return PM3_EFILE;
-        }
-
-        if (dumplen < MFU_DUMP_PREFIX_LENGTH) {
-            PrintAndLogEx(ERR, "Error, dump file is too small");
-            free(dump);
-            return PM3_ESOFT;
-        }
-
-        res = convert_mfu_dump_format(&dump, &dumplen, verbose);
+        res = amiibo_load(infilename, d, verbose);
         if (res != PM3_SUCCESS) {
-            PrintAndLogEx(FAILED, "Failed convert on load to new Ultralight/NTAG format");
-            free(dump);
+            free(d);
             return res;
         }
-
-        const mfu_dump_t *d = (mfu_dump_t *)dump;
-        memcpy(original, d->data, sizeof(original));
-        free(dump);
     } else {
         uint16_t dlen = 0;
         uint8_t *dump = NULL;
@@ -5598,17 +6120,21 @@ static int CmdHF14AAmiibo(const char *Cmd) {
         if (res != PM3_SUCCESS) {
             PrintAndLogEx(FAILED, "Failed to dump memory from tag");
             free(dump);
+            free(d);
             return res;
         }
-        memcpy(original, dump, sizeof(original));
+        memcpy(d->data, dump, MIN(dlen, sizeof(d->data)));
+        d->pages = MAX_NTAG_215;
         free(dump);
     }
 
+    const uint8_t *original = d->data;
 
     uint8_t decrypted[NFC3D_AMIIBO_SIZE] = {0};
     if (shall_decrypt) {
         if (nfc3d_amiibo_unpack(&amiibo_keys, original, decrypted) == false) {
             PrintAndLogEx(INFO, "Tag signature ( " _RED_("fail") " )");
+            free(d);
             return PM3_ESOFT;
         }
         // print
@@ -5630,12 +6156,38 @@ static int CmdHF14AAmiibo(const char *Cmd) {
         }
     }
 
+    if (uidlen || eload) {
+        if (amiibo_resign(&amiibo_keys, d, (uidlen) ? uid : NULL) != PM3_SUCCESS) {
+            PrintAndLogEx(INFO, "Tag signature ( " _RED_("fail") " )");
+            free(d);
+            return PM3_ESOFT;
+        }
+        uint8_t taguid[7];
+        memcpy(taguid, d->data, 3);
+        memcpy(taguid + 3, d->data + 4, 4);
+        PrintAndLogEx(SUCCESS, "Re-signed for UID " _GREEN_("%s"), sprint_hex_inrow(taguid, sizeof(taguid)));
+    }
+
     if (outfnlen) {
         // save dump. Last block contains PACK + RFU
-//        uint16_t datalen = MFU_BLOCK_SIZE + MFU_DUMP_PREFIX_LENGTH;
-//        res = pm3_save_dump(outfilename, (uint8_t *)dump, datalen, jsfMfuMemory);
+        res = pm3_save_dump(outfilename, (uint8_t *)d, AMIIBO_DUMP_SIZE, jsfMfuMemory);
+        if (res != PM3_SUCCESS) {
+            free(d);
+            return res;
+        }
+    }
+
+    if (eload) {
+        res = mf_eml_upload((uint8_t *)d, AMIIBO_DUMP_SIZE / MFU_BLOCK_SIZE, MFU_BLOCK_SIZE);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "Load to emulator memory ( " _RED_("fail") " )");
+            free(d);
+            return res;
+        }
+        PrintAndLogEx(HINT, "Hint: Try " _YELLOW_("`hf mfu sim -t 7`") " to simulate the Amiibo.");
     }
 
+    free(d);
     return PM3_SUCCESS;
 }
 
@@ -6006,6 +6558,7 @@ static command_t CommandTable[] = {
 //    {"tear_cnt", CmdHF14AMfuEv1CounterTearoff,     IfPm3Iso14443a,  "Tear-off test on Ev1/NTAG Counter bits"},
     {"-----------", CmdHelp,                IfPm3Iso14443a,  "----------------------- " _CYAN_("operations") " -----------------------"},
     {"cauth",    CmdHF14AMfUCAuth,          IfPm3Iso14443a,  "Ultralight-C - Authentication"},
+    {"chk",      CmdHF14AMfUChk,            IfPm3Iso14443a,  "Check keys / passwords against a dictionary"},
     {"setpwd",   CmdHF14AMfUCSetPwd,        IfPm3Iso14443a,  "Ultralight-C - Set 3DES key"},
     {"aesauth",  CmdHF14AMfUAESAuth,        IfPm3Iso14443a,  "Ultralight-AES - Authentication"},
     {"dump",     CmdHF14AMfUDump,           IfPm3Iso14443a,  "Dump MIFARE Ultralight family tag to binary file"},
@@ -6026,7 +6579,7 @@ static command_t CommandTable[] = {
     {"-----------", CmdHelp,                IfPm3Iso14443a,  "----------------------- " _CYAN_("magic") " ----------------------------"},
     {"setuid",   CmdHF14AMfUCSetUid,        IfPm3Iso14443a,  "Set UID - MAGIC tags only"},
     {"-----------", CmdHelp,                IfPm3Iso14443a,  "----------------------- " _CYAN_("amiibo") " ----------------------------"},
-    {"amiibo",   CmdHF14AAmiibo,            IfPm3Iso14443a,  "Amiibo tag operations"},
+    {"amiibo",   CmdHF14AAmiibo,            AlwaysAvailable, "Amiibo tag operations"},
     {NULL, NULL, NULL, NULL}
 };
 
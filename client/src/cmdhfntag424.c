@@ -33,6 +33,8 @@
 #include "util.h"
 #include "crc32.h"
 #include "cmdhfmfdes.h"
+#include "mifare/sdmcrypto.h"
+#include "util_posix.h"         // msclock
 
 #define NTAG424_MAX_BYTES           412
 #define NTAG424_RESPONSE_LENGTH     2
@@ -1500,6 +1502,311 @@ static int CmdHF_ntag424_changekey(const char *Cmd) {
     return res;
 }
 
+// value of a `name=` URL parameter, a pointer into the url and its length
+static const char *ntag424_url_param(const char *url, const char *name, size_t *len) {
+    size_t nlen = strlen(name);
+    for (const char *p = strstr(url, name); p != NULL; p = strstr(p + 1, name)) {
+        if ((p == url || p[-1] == '?' || p[-1] == '&') && p[nlen] == '=') {
+            const char *v = p + nlen + 1;
+            *len = strcspn(v, "&# \t\r\n");
+            return v;
+        }
+    }
+    return NULL;
+}
+
+static bool ntag424_hex_exact(const char *hex, size_t hexlen, uint8_t *out, size_t outlen) {
+    char tmp[(SDM_PICC_DATA_SIZE * 2) + 1];
+    if (hexlen != outlen * 2 || hexlen >= sizeof(tmp)) {
+        return false;
+    }
+    memcpy(tmp, hex, hexlen);
+    tmp[hexlen] = 0;
+    return hex_to_bytes(tmp, out, outlen) == (int)outlen;
+}
+
+// One SUN message, either an URL or `<picc data hex> <cmac hex> [mac input]`.
+// In an URL the MAC input is empty, or the text from the value of `macparam` up to the
+// cmac value when `macparam` is given.
+static int ntag424_sdm_parse(char *line, const char *pname, const char *cname, const char *macparam,
+                             uint8_t *piccdata, uint8_t *mac, const char **macin, size_t *macinlen) {
+    size_t plen = 0, clen = 0;
+    const char *p = ntag424_url_param(line, pname, &plen);
+    const char *c = ntag424_url_param(line, cname, &clen);
+
+    *macin = NULL;
+    *macinlen = 0;
+
+    if (p == NULL || c == NULL) {
+        // plain fields
+        char *save = NULL;
+        p = strtok_r(line, " \t,;", &save);
+        c = strtok_r(NULL, " \t,;\r\n", &save);
+        if (p == NULL || c == NULL) {
+            return PM3_EINVARG;
+        }
+        plen = strlen(p);
+        clen = strlen(c);
+
+        char *m = strtok_r(NULL, "\r\n", &save);
+        if (m) {
+            *macin = m;
+            *macinlen = strlen(m);
+        }
+    } else if (macparam && macparam[0]) {
+        size_t mlen = 0;
+        const char *m = ntag424_url_param(line, macparam, &mlen);
+        if (m == NULL || m > c) {
+            return PM3_EINVARG;
+        }
+        *macin = m;
+        *macinlen = c - m;
+    }
+
+    if (ntag424_hex_exact(p, plen, piccdata, SDM_PICC_DATA_SIZE) == false ||
+            ntag424_hex_exact(c, clen, mac, SDM_MAC_SIZE) == false) {
+        return PM3_EINVARG;
+    }
+    return PM3_SUCCESS;
+}
+
+static void ntag424_sdm_print(int level, const char *prefix, const SDMPICCData_t *picc, int res) {
+    char uid[32] = "n/a";
+    if (picc->uidlen) {
+        snprintf(uid, sizeof(uid), "%s", sprint_hex_inrow(picc->uid, picc->uidlen));
+    }
+
+    char ctr[16] = "n/a";
+    if (picc->has_readctr) {
+        snprintf(ctr, sizeof(ctr), "%u", picc->readctr);
+    }
+
+    const char *result = _GREEN_("ok");
+    if (res == PM3_EINVARG) {
+        result = _RED_("bad picc data");
+    } else if (res != PM3_SUCCESS) {
+        result = _RED_("bad cmac");
+    }
+    PrintAndLogEx(level, "%s uid " _YELLOW_("%-14s") " ctr " _YELLOW_("%-8s") " ( %s )", prefix, uid, ctr, result);
+}
+
+static int ntag424_sdm_selftest(void) {
+    // AN12196 sample, all keys zero, and the same with a changed MAC input and a changed CMAC
+    struct {
+        const char *url;
+        int res;
+    } tests[] = {
+        {"https://www.my424dna.com/?picc_data=FD91EC264309878BE6345CBE53BADF40&enc=CEE9A53E3E463EF1F459635736738962&cmac=ECC1E7F6C6C73BF6", PM3_SUCCESS},
+        {"https://www.my424dna.com/?picc_data=FD91EC264309878BE6345CBE53BADF40&enc=CEE9A53E3E463EF1F459635736738963&cmac=ECC1E7F6C6C73BF6", PM3_EFAILED},
+        {"https://www.my424dna.com/?picc_data=FD91EC264309878BE6345CBE53BADF40&enc=CEE9A53E3E463EF1F459635736738962&cmac=ECC1E7F6C6C73BF7", PM3_EFAILED},
+    };
+
+    uint8_t key[CRYPTO_AES128_KEY_SIZE] = {0};
+    SDMContext_t sdm;
+    SDMContextInit(&sdm, key, key);
+
+    int fails = 0;
+    for (size_t i = 0; i < ARRAYLEN(tests); i++) {
+        char line[256];
+        snprintf(line, sizeof(line), "%s", tests[i].url);
+
+        uint8_t piccdata[SDM_PICC_DATA_SIZE], mac[SDM_MAC_SIZE];
+        const char *macin = NULL;
+        size_t macinlen = 0;
+        SDMPICCData_t picc = {0};
+
+        int res = ntag424_sdm_parse(line, "picc_data", "cmac", "enc", piccdata, mac, &macin, &macinlen);
+        if (res == PM3_SUCCESS) {
+            res = SDMVerify(&sdm, piccdata, (const uint8_t *)macin, macinlen, mac, &picc);
+        }
+
+        bool ok = (res == tests[i].res) && picc.has_readctr && (picc.readctr == 8) &&
+                  (picc.uidlen == 7) && (memcmp(picc.uid, "\x04\x95\x8c\xaa\x5c\x5e\x80", 7) == 0);
+        if (ok == false) {
+            fails++;
+        }
+        PrintAndLogEx(ok ? SUCCESS : FAILED, "SUN message %zu ( %s )", i + 1, ok ? _GREEN_("ok") : _RED_("fail"));
+    }
+
+    SDMContextFree(&sdm);
+    PrintAndLogEx((fails) ? FAILED : SUCCESS, "Tests ( %s )", (fails) ? _RED_("fail") : _GREEN_("ok"));
+    return (fails) ? PM3_ESOFT : PM3_SUCCESS;
+}
+
+static int CmdHF_ntag424_sdm(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf ntag424 sdm",
+                  "Verify SUN messages (Secure Dynamic Messaging, AES mode) offline.\n"
+                  "A message is an URL with the encrypted PICC data and the CMAC, or `<picc data> <cmac> [mac input]`.\n"
+                  "With -f the file is read line by line, one message per line, `#` starts a comment.\n"
+                  "In URLs the MAC input is empty, or with --macparam the text from that parameter value up to the cmac value.",
+                  "hf ntag424 sdm -u \"https://x.com/?picc_data=FD91EC264309878BE6345CBE53BADF40&enc=CEE9A53E3E463EF1F459635736738962&cmac=ECC1E7F6C6C73BF6\" --macparam enc\n"
+                  "hf ntag424 sdm --picc FD91EC264309878BE6345CBE53BADF40 --cmac ECC1E7F6C6C73BF6 --macin \"CEE9A53E3E463EF1F459635736738962&cmac=\"\n"
+                  "hf ntag424 sdm -f sun.txt --metakey 00000000000000000000000000000000 --filekey 00000000000000000000000000000000\n"
+                  "hf ntag424 sdm -f sun.txt --macparam enc\n"
+                  "hf ntag424 sdm --test"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0(NULL, "metakey",  "<hex>", "K_SDMMetaRead, decrypts the PICC data (def all zeros)"),
+        arg_str0(NULL, "filekey",  "<hex>", "K_SDMFileRead, the CMAC key (def all zeros)"),
+        arg_str0("u",  "url",      "<str>", "SUN URL"),
+        arg_str0(NULL, "picc",     "<hex>", "encrypted PICC data, 16 bytes"),
+        arg_str0(NULL, "cmac",     "<hex>", "CMAC, 8 bytes"),
+        arg_str0(NULL, "macin",    "<str>", "MAC input text for --picc / --cmac"),
+        arg_str0("f",  "file",     "<fn>",  "file with one SUN message per line"),
+        arg_str0(NULL, "pname",    "<str>", "URL parameter of the PICC data (def picc_data)"),
+        arg_str0(NULL, "cname",    "<str>", "URL parameter of the CMAC (def cmac)"),
+        arg_str0(NULL, "macparam", "<str>", "URL parameter the MAC input starts at"),
+        arg_lit0("v",  "verbose",  "print every message, not only the failed ones"),
+        arg_lit0(NULL, "test",     "perform self tests"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    if (arg_get_lit(ctx, 12)) {
+        CLIParserFree(ctx);
+        return ntag424_sdm_selftest();
+    }
+
+    uint8_t metakey[CRYPTO_AES128_KEY_SIZE] = {0};
+    uint8_t filekey[CRYPTO_AES128_KEY_SIZE] = {0};
+    int metakeylen = 0, filekeylen = 0;
+    CLIGetHexWithReturn(ctx, 1, metakey, &metakeylen);
+    CLIGetHexWithReturn(ctx, 2, filekey, &filekeylen);
+
+    char line[1024] = {0};
+    int linelen = 0;
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)line, sizeof(line) - 1, &linelen);
+
+    uint8_t piccdata[SDM_PICC_DATA_SIZE] = {0};
+    uint8_t mac[SDM_MAC_SIZE] = {0};
+    int piccdatalen = 0, maclen = 0;
+    CLIGetHexWithReturn(ctx, 4, piccdata, &piccdatalen);
+    CLIGetHexWithReturn(ctx, 5, mac, &maclen);
+
+    char macinput[512] = {0};
+    int macinputlen = 0;
+    CLIParamStrToBuf(arg_get_str(ctx, 6), (uint8_t *)macinput, sizeof(macinput) - 1, &macinputlen);
+
+    char filename[FILE_PATH_SIZE] = {0};
+    int fnlen = 0;
+    CLIParamStrToBuf(arg_get_str(ctx, 7), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    char pname[32] = "picc_data", cname[32] = "cmac", macparam[32] = {0};
+    int slen = 0;
+    if (arg_get_str_len(ctx, 8)) {
+        CLIParamStrToBuf(arg_get_str(ctx, 8), (uint8_t *)pname, sizeof(pname) - 1, &slen);
+    }
+    if (arg_get_str_len(ctx, 9)) {
+        CLIParamStrToBuf(arg_get_str(ctx, 9), (uint8_t *)cname, sizeof(cname) - 1, &slen);
+    }
+    CLIParamStrToBuf(arg_get_str(ctx, 10), (uint8_t *)macparam, sizeof(macparam) - 1, &slen);
+
+    bool verbose = arg_get_lit(ctx, 11);
+    CLIParserFree(ctx);
+
+    if ((metakeylen && metakeylen != CRYPTO_AES128_KEY_SIZE) || (filekeylen && filekeylen != CRYPTO_AES128_KEY_SIZE)) {
+        PrintAndLogEx(ERR, "Keys must be 16 bytes");
+        return PM3_EINVARG;
+    }
+
+    bool single = (piccdatalen || maclen);
+    if (single && (piccdatalen != SDM_PICC_DATA_SIZE || maclen != SDM_MAC_SIZE)) {
+        PrintAndLogEx(ERR, "PICC data must be 16 bytes and CMAC 8 bytes");
+        return PM3_EINVARG;
+    }
+
+    if ((single || linelen) == false && fnlen == 0) {
+        PrintAndLogEx(ERR, "Nothing to verify, use -u, --picc / --cmac or -f");
+        return PM3_EINVARG;
+    }
+
+    SDMContext_t sdm;
+    SDMContextInit(&sdm, metakey, filekey);
+
+    SDMPICCData_t picc = {0};
+    int res = PM3_SUCCESS;
+
+    if (single) {
+        res = SDMVerify(&sdm, piccdata, (uint8_t *)macinput, macinputlen, mac, &picc);
+        ntag424_sdm_print((res == PM3_SUCCESS) ? SUCCESS : FAILED, "", &picc, res);
+    }
+
+    if (linelen) {
+        const char *macin = NULL;
+        size_t macinlen = 0;
+        res = ntag424_sdm_parse(line, pname, cname, macparam, piccdata, mac, &macin, &macinlen);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(ERR, "No `%s` and `%s` parameters in the URL", pname, cname);
+        } else {
+            res = SDMVerify(&sdm, piccdata, (const uint8_t *)macin, macinlen, mac, &picc);
+            ntag424_sdm_print((res == PM3_SUCCESS) ? SUCCESS : FAILED, "", &picc, res);
+        }
+    }
+
+    if (fnlen) {
+        char *path = NULL;
+        FILE *f = NULL;
+        if (searchFile(&path, RESOURCES_SUBDIR, filename, "", false) == PM3_SUCCESS) {
+            f = fopen(path, "r");
+            free(path);
+        }
+        if (f == NULL) {
+            PrintAndLogEx(ERR, "Can't open `" _YELLOW_("%s") "`", filename);
+            SDMContextFree(&sdm);
+            return PM3_EFILE;
+        }
+
+        uint32_t lineno = 0, total = 0, failed = 0, invalid = 0;
+        uint64_t t1 = msclock();
+
+        while (fgets(line, sizeof(line), f)) {
+            lineno++;
+
+            char *s = line;
+            while (isspace(*s)) {
+                s++;
+            }
+            if (*s == 0 || *s == '#') {
+                continue;
+            }
+            s[strcspn(s, "\r\n")] = 0;
+            total++;
+
+            char prefix[24];
+            snprintf(prefix, sizeof(prefix), "%5u:", lineno);
+
+            const char *macin = NULL;
+            size_t macinlen = 0;
+            if (ntag424_sdm_parse(s, pname, cname, macparam, piccdata, mac, &macin, &macinlen) != PM3_SUCCESS) {
+                invalid++;
+                PrintAndLogEx(WARNING, "%s can't parse the line", prefix);
+                continue;
+            }
+
+            int vres = SDMVerify(&sdm, piccdata, (const uint8_t *)macin, macinlen, mac, &picc);
+            if (vres != PM3_SUCCESS) {
+                failed++;
+                ntag424_sdm_print(FAILED, prefix, &picc, vres);
+            } else if (verbose) {
+                ntag424_sdm_print(SUCCESS, prefix, &picc, vres);
+            }
+        }
+        fclose(f);
+
+        t1 = msclock() - t1;
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx((failed || invalid) ? WARNING : SUCCESS, "Messages " _YELLOW_("%u") ", ok " _GREEN_("%u") ", failed " _RED_("%u") ", unparsable %u ( %" PRIu64 " ms )",
+                      total, total - failed - invalid, failed, invalid, t1);
+        res = (failed || invalid) ? PM3_ESOFT : res;
+    }
+
+    SDMContextFree(&sdm);
+    return res;
+}
+
 static command_t CommandTable[] = {
     {"help",         CmdHelp,                          AlwaysAvailable,  "This help"},
     {"-----------",  CmdHelp,                          IfPm3Iso14443a,   "----------------------- " _CYAN_("operations") " -----------------------"},
@@ -1511,6 +1818,7 @@ static command_t CommandTable[] = {
     {"getfs",        CmdHF_ntag424_getfilesettings,    IfPm3Iso14443a,   "Get file settings"},
     {"changefs",     CmdHF_ntag424_changefilesettings, IfPm3Iso14443a,   "Change file settings"},
     {"changekey",    CmdHF_ntag424_changekey,          IfPm3Iso14443a,   "Change key"},
+    {"sdm",          CmdHF_ntag424_sdm,                AlwaysAvailable,  "Verify SUN / SDM messages"},
     {NULL, NULL, NULL, NULL}
 };
 
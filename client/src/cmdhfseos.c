@@ -39,6 +39,7 @@
 #include "commonutil.h"         // get_sw
 #include "protocols.h"          // ISO7816 APDU return codes
 #include "hidsio.h"
+#include "util_posix.h"     // msclock
 
 static uint8_t zeros[16] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
@@ -1637,6 +1638,100 @@ static int CmdHfSeosList(const char *Cmd) {
     return CmdTraceListAlias(Cmd, "hf seos", "seos -c");
 }
 
+// Prints the PACS of a SAM answer
+static int seos_sam_print(const uint8_t *d, uint16_t len, bool verbose, bool decodeTLV) {
+    // check for standard SamCommandGetContentElement response
+    // bd 09
+    //    8a 07
+    //       03 05 <- tag + length
+    //          06 85 80 6d c0 <- decoded PACS data
+    if (d[0] == 0xBD && d[2] == 0x8A && d[4] == 0x03) {
+        uint8_t pacs_length = d[5];
+        const uint8_t *pacs_data = d + 6;
+        int res = HIDDumpPACSBits(pacs_data, pacs_length, verbose);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        // check for standard samCommandGetContentElement2:
+        // bd 1e
+        //    b3 1c
+        //       a0 1a
+        //          80 05
+        //             06 85 80 6d c0
+        //          81 0e
+        //             2b 06 01 04 01 81 e4 38 01 01 02 04 3c ff
+        //          82 01
+        //             07
+    } else if (d[0] == 0xbd && d[2] == 0xb3 && d[4] == 0xa0) {
+        const uint8_t *pacs = d + 6;
+        const uint8_t pacs_length = pacs[1];
+        const uint8_t *pacs_data = pacs + 2;
+        int res = HIDDumpPACSBits(pacs_data, pacs_length, verbose);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+
+        const uint8_t *oid = pacs + 2 + pacs_length;
+        const uint8_t oid_length = oid[1];
+        const uint8_t *oid_data = oid + 2;
+        PrintAndLogEx(SUCCESS, "SIO OID.......: " _GREEN_("%s"), sprint_hex_inrow(oid_data, oid_length));
+
+        const uint8_t *mediaType = oid + 2 + oid_length;
+        const uint8_t mediaType_data = mediaType[2];
+        PrintAndLogEx(SUCCESS, "SIO Media Type: " _GREEN_("%s"), getSioMediaTypeInfo(mediaType_data));
+
+    } else {
+        print_hex(d, len);
+    }
+    if (decodeTLV) {
+        asn1_print((uint8_t *)d, d[1] + 2, " ");
+    }
+    return PM3_SUCCESS;
+}
+
+// Continuous reader mode, the device streams one reply per card until aborted
+static int seos_sam_loop(uint8_t *data, uint16_t datalen, bool verbose, bool decodeTLV) {
+    PrintAndLogEx(INFO, "Present cards to the reader, press " _GREEN_("<Enter>") " to exit");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_SAM_SEOS, data, datalen);
+
+    uint32_t cards = 0;
+    bool aborted = false;
+    uint64_t t1 = msclock();
+    for (;;) {
+        if (aborted == false && kbd_enter_pressed()) {
+            aborted = true;
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+        }
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_SAM_SEOS, &resp, aborted ? 2000 : 500) == false) {
+            if (aborted) {
+                PrintAndLogEx(WARNING, "timeout while waiting for reply");
+                break;
+            }
+            continue;
+        }
+
+        if (resp.status == PM3_EOPABORTED) {
+            break;
+        }
+
+        cards++;
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "--- " _CYAN_("Card %u") " ---------- %.1f s", cards, (float)(msclock() - t1) / 1000.0);
+        if (resp.status == PM3_SUCCESS) {
+            seos_sam_print(resp.data.asBytes, resp.length, verbose, decodeTLV);
+        } else {
+            PrintAndLogEx(SUCCESS, "No PACS data found. Card empty?");
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "Done, " _YELLOW_("%u") " cards read", cards);
+    return PM3_SUCCESS;
+}
+
 static int CmdHfSeosSAM(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf seos sam",
@@ -1644,6 +1739,7 @@ static int CmdHfSeosSAM(const char *Cmd) {
                   "Make sure you got a SAM inserted in your sim module",
                   "hf seos sam\n"
                   "hf seos sam -d a005a103800104 -> get PACS data\n"
+                  "hf seos sam --loop            -> read every card presented until <Enter>\n"
                  );
 
     void *argtable[] = {
@@ -1653,6 +1749,7 @@ static int CmdHfSeosSAM(const char *Cmd) {
         arg_lit0("n", "nodetect", "skip selecting the card and sending card details to SAM"),
         arg_lit0("t",  "tlv",      "decode TLV"),
         arg_strx0("d", "data",     "<hex>", "DER encoded command to send to SAM"),
+        arg_lit0(NULL, "loop",     "continuous reader mode, stream the PACS of each card presented"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1661,6 +1758,7 @@ static int CmdHfSeosSAM(const char *Cmd) {
     bool disconnectAfter = !arg_get_lit(ctx, 2);
     bool skipDetect = arg_get_lit(ctx, 3);
     bool decodeTLV = arg_get_lit(ctx, 4);
+    bool loop = arg_get_lit(ctx, 6);
 
     uint8_t flags = 0;
     if (disconnectAfter) {
@@ -1671,6 +1769,10 @@ static int CmdHfSeosSAM(const char *Cmd) {
         flags |= BITMASK(1);
     }
 
+    if (loop) {
+        flags |= BITMASK(2);
+    }
+
     uint8_t data[PM3_CMD_DATA_SIZE] = {0};
     data[0] = flags;
 
@@ -1686,6 +1788,10 @@ static int CmdHfSeosSAM(const char *Cmd) {
         return PM3_ESOFT;
     }
 
+    if (loop) {
+        return seos_sam_loop(data, cmdlen + 1, verbose, decodeTLV);
+    }
+
     // iceman:  this command should use a struct for its data being transfered.
 
     clearCommandBuffer();
@@ -1710,55 +1816,7 @@ static int CmdHfSeosSAM(const char *Cmd) {
         }
     }
 
-    uint8_t *d = resp.data.asBytes;
-    // check for standard SamCommandGetContentElement response
-    // bd 09
-    //    8a 07
-    //       03 05 <- tag + length
-    //          06 85 80 6d c0 <- decoded PACS data
-    if (d[0] == 0xBD && d[2] == 0x8A && d[4] == 0x03) {
-        uint8_t pacs_length = d[5];
-        uint8_t *pacs_data = d + 6;
-        int res = HIDDumpPACSBits(pacs_data, pacs_length, verbose);
-        if (res != PM3_SUCCESS) {
-            return res;
-        }
-        // check for standard samCommandGetContentElement2:
-        // bd 1e
-        //    b3 1c
-        //       a0 1a
-        //          80 05
-        //             06 85 80 6d c0
-        //          81 0e
-        //             2b 06 01 04 01 81 e4 38 01 01 02 04 3c ff
-        //          82 01
-        //             07
-    } else if (d[0] == 0xbd && d[2] == 0xb3 && d[4] == 0xa0) {
-        const uint8_t *pacs = d + 6;
-        const uint8_t pacs_length = pacs[1];
-        const uint8_t *pacs_data = pacs + 2;
-        int res = HIDDumpPACSBits(pacs_data, pacs_length, verbose);
-        if (res != PM3_SUCCESS) {
-            return res;
-        }
-
-        const uint8_t *oid = pacs + 2 + pacs_length;
-        const uint8_t oid_length = oid[1];
-        const uint8_t *oid_data = oid + 2;
-        PrintAndLogEx(SUCCESS, "SIO OID.......: " _GREEN_("%s"), sprint_hex_inrow(oid_data, oid_length));
-
-        const uint8_t *mediaType = oid + 2 + oid_length;
-        const uint8_t mediaType_data = mediaType[2];
-        PrintAndLogEx(SUCCESS, "SIO Media Type: " _GREEN_("%s"), getSioMediaTypeInfo(mediaType_data));
-
-    } else {
-        print_hex(d, resp.length);
-    }
-    if (decodeTLV) {
-        asn1_print(d, d[1] + 2, " ");
-    }
-
-    return PM3_SUCCESS;
+    return seos_sam_print(resp.data.asBytes, resp.length, verbose, decodeTLV);
 }
 
 static command_t CommandTable[] = {
@@ -27,6 +27,7 @@
 #include "crc16.h"
 #include "ui.h"
 #include "cmdhf14a.h" // manufacture
+#include "mifare.h"   // hf_tagstream_t
 
 static int CmdHelp(const char *Cmd);
 
@@ -205,6 +206,87 @@ int CmdHfThinFilmSim(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// The device keeps the field on and sends every barcode once, until button, <Enter> or timeout
+static int thinfilm_stream(uint16_t holdoff, uint32_t duration, bool verbose) {
+
+    hf_tagstream_t payload = {
+        .holdoff = holdoff,
+        .duration = duration,
+    };
+
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to exit");
+    PrintAndLogEx(INFO, "");
+    PrintAndLogEx(INFO, "     time | barcode");
+    PrintAndLogEx(INFO, "----------+-------------------------------------------------");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_THINFILM_READER, (uint8_t *)&payload, sizeof(payload));
+
+    uint32_t count = 0;
+    bool aborted = false;
+    PacketResponseNG resp;
+    for (;;) {
+
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_THINFILM_READER, &resp, 1000) == false) {
+            continue;
+        }
+
+        // the last reply carries no tag
+        if (resp.length != sizeof(hf_tagstream_entry_t)) {
+            break;
+        }
+
+        const hf_tagstream_entry_t *e = (const hf_tagstream_entry_t *)resp.data.asBytes;
+        count++;
+        PrintAndLogEx(SUCCESS, "%7u.%01u | " _GREEN_("%s"), e->ms / 1000, (e->ms % 1000) / 100, sprint_hex_inrow(e->data, e->len));
+        if (verbose) {
+            print_barcode((uint8_t *)e->data, e->len, false);
+        }
+    }
+
+    PrintAndLogEx(INFO, "----------+-------------------------------------------------");
+    PrintAndLogEx(SUCCESS, "Read " _YELLOW_("%u") " tags", count);
+    return (resp.status == PM3_EOPABORTED) ? PM3_SUCCESS : resp.status;
+}
+
+static int CmdHfThinFilmReader(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf thinfilm reader",
+                  "Read Thinfilm tags. In continuous mode the device keeps the field on\n"
+                  "and reports every new tag once, with the time it was first seen.",
+                  "hf thinfilm reader\n"
+                  "hf thinfilm reader -@                 -> continuous mode\n"
+                  "hf thinfilm reader -@ --holdoff 200   -> report a tag again after 200 ms out of the field\n"
+                  "hf thinfilm reader -@ --time 60       -> stop after one minute"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("@", NULL, "continuous reader mode"),
+        arg_u64_0(NULL, "holdoff", "<ms>", "ms out of the field before a tag is reported again (def 1000)"),
+        arg_u64_0(NULL, "time", "<s>", "stop after this many seconds (def 0, until aborted)"),
+        arg_lit0("v", "verbose", "verbose output"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool cm = arg_get_lit(ctx, 1);
+    uint32_t holdoff = arg_get_u32_def(ctx, 2, 1000);
+    uint32_t duration = arg_get_u32_def(ctx, 3, 0);
+    bool verbose = arg_get_lit(ctx, 4);
+    CLIParserFree(ctx);
+
+    if (cm == false) {
+        return infoThinFilm(verbose);
+    }
+
+    return thinfilm_stream(MIN(holdoff, 0xFFFF), duration * 1000, verbose);
+}
+
 static int CmdHfThinFilmList(const char *Cmd) {
     return CmdTraceListAlias(Cmd, "hf thinfilm", "thinfilm");
 }
@@ -213,6 +295,7 @@ static command_t CommandTable[] = {
     {"help",    CmdHelp,            AlwaysAvailable, "This help"},
     {"info",    CmdHfThinFilmInfo,  IfPm3NfcBarcode, "Tag information"},
     {"list",    CmdHfThinFilmList,  AlwaysAvailable, "List NFC Barcode / Thinfilm history - not correct"},
+    {"reader",  CmdHfThinFilmReader, IfPm3NfcBarcode, "Act like a Thinfilm reader"},
     {"sim",     CmdHfThinFilmSim,   IfPm3NfcBarcode, "Fake Thinfilm tag"},
     {NULL, NULL, NULL, NULL}
 };
@@ -32,6 +32,7 @@
 #include "protocols.h"
 #include "nfc/ndef.h"
 #include "fileutils.h"     // saveFile
+#include "mifare.h"        // hf_tagstream_t
 
 
 #ifndef AddCrc14B
@@ -690,31 +691,87 @@ static void printTopazDumpContents(topaz_tag_t *dump) {
     PrintAndLogEx(NORMAL, "");
 }
 
+// The device keeps the field on and sends every tag once, until button, <Enter> or timeout
+static int topaz_stream(uint16_t holdoff, uint32_t duration) {
+
+    hf_tagstream_t payload = {
+        .holdoff = holdoff,
+        .duration = duration,
+    };
+
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to exit");
+    PrintAndLogEx(INFO, "");
+    PrintAndLogEx(INFO, "     time | UID                  | HR01");
+    PrintAndLogEx(INFO, "----------+----------------------+------");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_TOPAZ_READER, (uint8_t *)&payload, sizeof(payload));
+
+    uint32_t count = 0;
+    bool aborted = false;
+    PacketResponseNG resp;
+    for (;;) {
+
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_HF_TOPAZ_READER, &resp, 1000) == false) {
+            continue;
+        }
+
+        // the last reply carries no tag
+        if (resp.length != sizeof(hf_tagstream_entry_t)) {
+            break;
+        }
+
+        const hf_tagstream_entry_t *e = (const hf_tagstream_entry_t *)resp.data.asBytes;
+        const uint8_t *uid = e->data + 2;
+        count++;
+        PrintAndLogEx(SUCCESS, "%7u.%01u | " _GREEN_("%02X %02X %02X %02X %02X %02X %02X") " | %02X %02X"
+                      , e->ms / 1000, (e->ms % 1000) / 100
+                      , uid[6], uid[5], uid[4], uid[3], uid[2], uid[1], uid[0]
+                      , e->data[0], e->data[1]
+                     );
+    }
+
+    PrintAndLogEx(INFO, "----------+----------------------+------");
+    PrintAndLogEx(SUCCESS, "Read " _YELLOW_("%u") " tags", count);
+    return (resp.status == PM3_EOPABORTED) ? PM3_SUCCESS : resp.status;
+}
+
 static int CmdHFTopazReader(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf topaz reader",
-                  "Read UID from Topaz tags",
+                  "Read UID from Topaz tags. In continuous mode the device keeps the field on\n"
+                  "and reports every new tag once, with the time it was first seen.",
                   "hf topaz reader\n"
-                  "hf topaz reader -@     -> Continuous mode\n"
+                  "hf topaz reader -@                 -> Continuous mode\n"
+                  "hf topaz reader -@ --holdoff 200   -> report a tag again after 200 ms out of the field\n"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0("@", NULL, "optional - continuous reader mode"),
+        arg_u64_0(NULL, "holdoff", "<ms>", "ms out of the field before a tag is reported again (def 1000)"),
+        arg_u64_0(NULL, "time", "<s>", "stop continuous mode after this many seconds (def 0, until aborted)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
     bool verbose = arg_get_lit(ctx, 1);
     bool cm = arg_get_lit(ctx, 2);
+    uint32_t holdoff = arg_get_u32_def(ctx, 3, 1000);
+    uint32_t duration = arg_get_u32_def(ctx, 4, 0);
     CLIParserFree(ctx);
 
     if (cm) {
-        PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
+        return topaz_stream(MIN(holdoff, 0xFFFF), duration * 1000);
     }
 
-    int res = readTopazUid(cm, verbose);
+    int res = readTopazUid(false, verbose);
 
     topaz_switch_off_field();
     return res;
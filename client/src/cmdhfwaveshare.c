@@ -29,6 +29,7 @@
 #include "util_posix.h"     // msleep
 #include "cliparser.h"
 #include "imgutils.h"
+#include "proxmark3.h"     // get_my_user_directory
 
 #define EPD_1IN54B     0
 #define EPD_1IN54C     1
@@ -90,43 +91,28 @@ static uint8_t *map8to1(gdImagePtr img, int color) {
         return NULL;
     }
 
-    uint8_t data = 0;
-    uint8_t count = 0;
-    for (uint16_t Y = 0; Y < gdImageSY(img); Y++) {
-        for (uint16_t X = 0; X < gdImageSX(img); X++) {
-            if (gdImageGetPixel(img, X, Y) == color) {
-                data |= 1;
-            }
-            count += 1;
-            if ((count >= 8) || (X == gdImageSX(img) - 1)) {
-                colormap8[X / 8 + Y * width8] = (~data) & 0xFF;
-                count = 0;
-                data = 0;
+    // the pixels of a last partial byte are in its low bits
+    int full = gdImageSX(img) & ~7;
+    int tail = gdImageSX(img) - full;
+
+    // img_palettize gives a palette image, its rows are read directly
+    for (int Y = 0; Y < gdImageSY(img); Y++) {
+        const unsigned char *row = gdImageTrueColor(img) ? NULL : img->pixels[Y];
+        uint8_t *out = colormap8 + Y * width8;
+        for (int X = 0; X < gdImageSX(img); X++) {
+            int c = row ? row[X] : gdImageGetPixel(img, X, Y);
+            if (c == color) {
+                out[X / 8] |= 1 << ((X < full) ? (7 - (X % 8)) : (tail - 1 - (X % 8)));
             }
-            data = (data << 1) & 0xFF;
+        }
+        for (uint16_t i = 0; i < width8; i++) {
+            out[i] = ~out[i];
         }
     }
 
     return colormap8;
 }
 
-static void read_black(uint32_t i, uint8_t *l, uint8_t model_nr, const uint8_t *black) {
-    for (uint8_t j = 0; j < models[model_nr].len; j++) {
-        l[3 + j] = black[i * models[model_nr].len + j];
-    }
-}
-static void read_red(uint32_t i, uint8_t *l, uint8_t model_nr, const uint8_t *red) {
-    // spurious warning with GCC10 (-Wstringop-overflow) when j is uint8_t, even if all len are < 128
-    for (uint16_t j = 0; j < models[model_nr].len; j++) {
-        if (model_nr == M1in54B) {
-            //1.54B needs to flip the red picture data, other screens do not need to flip data
-            l[3 + j] = ~red[i * models[model_nr].len + j];
-        } else {
-            l[3 + j] = red[i * models[model_nr].len + j];
-        }
-    }
-}
-
 static int transceive_blocking(uint8_t *txBuf, uint16_t txBufLen, uint8_t *rxBuf, uint16_t rxBufLen, uint16_t *actLen, bool retransmit) {
     uint8_t fail_num = 0;
     if (rxBufLen < 2) {
@@ -163,30 +149,72 @@ static int transceive_blocking(uint8_t *txBuf, uint16_t txBufLen, uint8_t *rxBuf
     return PM3_SUCCESS;
 }
 
+// Streams an image plane to the tag, prefix followed by chunk bytes in each frame. The device
+// sends the frames of a USB packet back to back and retries them itself.
+static int send_frames(const uint8_t *prefix, uint8_t prefix_len, const uint8_t *data, uint32_t datalen, uint8_t chunk,
+                       bool retransmit, uint8_t delay_ms, uint8_t progress_from, uint8_t progress_to) {
+
+    uint8_t buf[PM3_CMD_DATA_SIZE];
+    iso14a_raw_frames_t hdr = {
+        .prefix_len = prefix_len,
+        .chunk = chunk,
+        .retries = retransmit ? 10 : 0,
+        .expect = {0x00, 0x00},
+        .delay_ms = delay_ms,
+    };
+    memcpy(hdr.prefix, prefix, prefix_len);
+    memcpy(buf, &hdr, sizeof(hdr));
+
+    uint32_t per_packet = (ISO14A_RAW_FRAMES_DATA_MAX / chunk) * chunk;
+
+    for (uint32_t pos = 0; pos < datalen; pos += per_packet) {
+        uint32_t n = MIN(per_packet, datalen - pos);
+        memcpy(buf + sizeof(hdr), data + pos, n);
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_ISO14443A_RAW_FRAMES, buf, sizeof(hdr) + n);
+
+        PacketResponseNG resp;
+        uint32_t frames = (n + chunk - 1) / chunk;
+        if (WaitForResponseTimeout(CMD_HF_ISO14443A_RAW_FRAMES, &resp, 2000 + frames * (delay_ms + 50)) == false) {
+            PROMPT_CLEARLINE;
+            PrintAndLogEx(WARNING, "command execution time out");
+            DropField();
+            return PM3_ETIMEOUT;
+        }
+        if (resp.status != PM3_SUCCESS) {
+            PROMPT_CLEARLINE;
+            PrintAndLogEx(WARNING, "Transmission failed, please try again.");
+            DropField();
+            return PM3_ESOFT;
+        }
+
+        iso14a_raw_frames_resp_t *r = (iso14a_raw_frames_resp_t *)resp.data.asBytes;
+        if (r->retried) {
+            PrintAndLogEx(DEBUG, "%u frames, %u sent again", r->sent, r->retried);
+        }
+
+        uint8_t progress = progress_from + ((pos + n) * (progress_to - progress_from)) / datalen;
+        PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
+    }
+    return PM3_SUCCESS;
+}
+
 // 1.54B Keychain
 // 1.54B does not share the common base and requires specific handling
 static int start_drawing_1in54B(uint8_t model_nr, uint8_t *black, uint8_t *red) {
     int ret;
-    uint8_t step_5[128] = {0xcd, 0x05, 100};
+    uint8_t step_5[3] = {0xcd, 0x05, 100};
     uint8_t step_4[2] = {0xcd, 0x04};
     uint8_t step_6[2] = {0xcd, 0x06};
     uint8_t rx[20] = {0};
-    uint16_t actrxlen[20], i, progress;
+    uint16_t actrxlen[20];
+    uint32_t planelen = 50 * step_5[2];
 
-    if (model_nr == M1in54B) {
-        step_5[2] = 100;
-    }
     PrintAndLogEx(DEBUG, "1.54_Step9: e-paper config2 (black)");
-    if (model_nr == M1in54B) {      //1.54inch B Keychain
-        for (i = 0; i < 50; i++) {
-            read_black(i, step_5, model_nr, black);
-            ret = transceive_blocking(step_5, 103, rx, 20, actrxlen, true); // cd 05
-            if (ret != PM3_SUCCESS) {
-                return ret;
-            }
-            progress = i * 100 / 100;
-            PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-        }
+    ret = send_frames(step_5, sizeof(step_5), black, planelen, step_5[2], true, 0, 0, 50); // cd 05
+    if (ret != PM3_SUCCESS) {
+        return ret;
     }
     PROMPT_CLEARLINE;
     PrintAndLogEx(DEBUG, "1.54_Step6: e-paper power on");
@@ -196,16 +224,20 @@ static int start_drawing_1in54B(uint8_t model_nr, uint8_t *black, uint8_t *red)
     }
 
     PrintAndLogEx(DEBUG, "1.54_Step7: e-paper config2 (red)");
-    if (model_nr == M1in54B) {       //1.54inch B Keychain
-        for (i = 0; i < 50; i++) {
-            read_red(i, step_5, model_nr, red);
-            ret = transceive_blocking(step_5, 103, rx, 20, actrxlen, true); // cd 05
-            if (ret != PM3_SUCCESS) {
-                return ret;
-            }
-            progress = i * 100 / 100 + 50;
-            PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-        }
+    //1.54B needs to flip the red picture data, other screens do not need to flip data
+    uint8_t *red_inv = calloc(planelen, sizeof(uint8_t));
+    if (red_inv == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        DropField();
+        return PM3_EMALLOC;
+    }
+    for (uint32_t i = 0; i < planelen; i++) {
+        red_inv[i] = ~red[i];
+    }
+    ret = send_frames(step_5, sizeof(step_5), red_inv, planelen, step_5[2], true, 0, 50, 100); // cd 05
+    free(red_inv);
+    if (ret != PM3_SUCCESS) {
+        return ret;
     }
     PROMPT_CLEARLINE;
     // Send update instructions
@@ -233,7 +265,7 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
     uint8_t step6[2] = {0xcd, 0x06};      // EDP load to main
     uint8_t step7[3] = {0xcd, 0x07, 0};   // Data preparation
 
-    uint8_t step8[123] = {0xcd, 0x08, 0x64};  // Data start command
+    uint8_t step8[3] = {0xcd, 0x08, 0x64};  // Data start command
     // 2.13inch(0x10:Send 16 data at a time)
     // 2.9inch(0x10:Send 16 data at a time)
     // 4.2inch(0x64:Send 100 data at a time)
@@ -242,11 +274,12 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
     uint8_t step10[2] = {0xcd, 0x09};     // Refresh e-paper
     uint8_t step11[2] = {0xcd, 0x0a};     // wait for ready
     uint8_t step12[2] = {0xcd, 0x04};     // e-paper power off command
-    uint8_t step13[124] = {0xcd, 0x19, 121};
+    uint8_t step13[3] = {0xcd, 0x19, 121};
 // uint8_t step13[2]={0xcd,0x0b};     // Judge whether the power supply is turned off successfully
 // uint8_t step14[2]={0xcd,0x0c};     // The end of the transmission
     uint8_t rx[20];
     uint16_t actrxlen[20];
+    uint16_t frames = 0;  // nr of step8 frames
 
     clearCommandBuffer();
     SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT | ISO14A_NO_DISCONNECT, 0, 0, NULL, 0);
@@ -303,32 +336,39 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
     if (model_nr == M2in13) {        // 2.13inch
         step1[2] = EPD_2IN13V2;
         step8[2] = 16;
+        frames = 250;
         step13[2] = 0;
     } else if (model_nr == M2in9) {  // 2.9inch
         step1[2] = EPD_2IN9;
         step8[2] = 16;
+        frames = 296;
         step13[2] = 0;
     } else if (model_nr == M4in2) {  // 4.2inch
         step1[2] = EPD_4IN2;
         step8[2] = 100;
+        frames = 150;
         step13[2] = 0;
     } else if (model_nr == M7in5) {  // 7.5inch
         step1[2] = EPD_7IN5V2;
         step8[2] = 120;
+        frames = 400;
         step13[2] = 0;
     } else if (model_nr == M2in7) {  // 2.7inch
         step1[2] = EPD_2IN7;
         step8[2] = 121;
+        frames = 48;
         // Send blank data for the first time, and send other data to 0xff without processing the bottom layer
         step13[2] = 121;
         // Sending the second data is the real image data. If the previous 0xff is not sent, the last output image is abnormally black
     } else if (model_nr == M2in13B) {  // 2.13inch B
         step1[2] = EPD_2IN13BC;
         step8[2] = 106;
+        frames = 26;
         step13[2] = 106;
     } else if (model_nr == M7in5HD) {
         step1[2] = EPD_7IN5HD;
         step8[2] = 120;
+        frames = 484;
         step13[2] = 0;
     }
 
@@ -371,7 +411,6 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
         }
         // 1.54B Data transfer is complete and wait for refresh
     } else {
-        uint8_t progress;
         PrintAndLogEx(DEBUG, "Step5: e-paper config2");
         ret = transceive_blocking(step5, 2, rx, 20, actrxlen, true); // cd 05
         if (ret != PM3_SUCCESS) {
@@ -390,85 +429,32 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
             return ret;
         }
         PrintAndLogEx(DEBUG, "Step8: Start data transfer");
-        if (model_nr == M2in13) {      // 2.13inch
-            for (uint16_t i = 0; i < 250; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 19, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 250;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
-        } else if (model_nr == M2in9) {
-            for (uint16_t i = 0; i < 296; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 19, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 296;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
-        } else if (model_nr == M4in2) {    //4.2inch
-            for (uint16_t i = 0; i < 150; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 103, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 150;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
-        } else if (model_nr == M7in5) {  //7.5inch
-            for (uint16_t i = 0; i < 400; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 123, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 400;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-                msleep(6);
-            }
-        } else if (model_nr == M2in13B) {  //2.13inch B
-            for (uint16_t i = 0; i < 26; i++) {
-                read_black(i, step8, model_nr, black);
-                ret = transceive_blocking(step8, 109, rx, 20, actrxlen, false); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 50 / 26;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
-        } else if (model_nr == M7in5HD) {  //7.5HD
-
-            for (uint16_t i = 0; i < 484; i++) {
-                read_black(i, step8, model_nr, black);
-                //memset(&step8[3], 0xf0, 120);
-                ret = transceive_blocking(step8, 123, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 100 / 484;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
+        if (model_nr == M2in7) {   //2.7inch
+            // blank data first, the image itself goes with step13
+            uint8_t *blank = calloc(frames * step8[2], sizeof(uint8_t));
+            if (blank == NULL) {
+                PrintAndLogEx(WARNING, "Failed to allocate memory");
+                DropField();
+                return PM3_EMALLOC;
             }
-            memset(&step8[3], 0xff, 120);
-            ret = transceive_blocking(step8, 110 + 3, rx, 20, actrxlen, true); // cd 08
+            memset(blank, 0xFF, frames * step8[2]);
+            ret = send_frames(step8, sizeof(step8), blank, frames * step8[2], step8[2], true, 0, 0, 50); // cd 08
+            free(blank);
+        } else {
+            // 2.13inch B frames are not acknowledged, and the 7.5inch needs a pause between frames
+            ret = send_frames(step8, sizeof(step8), black, frames * step8[2], step8[2], (model_nr != M2in13B),
+                              (model_nr == M7in5) ? 6 : 0, 0, (model_nr == M2in13B) ? 50 : 100); // cd 08
+        }
+        if (ret != PM3_SUCCESS) {
+            return ret;
+        }
+        if (model_nr == M7in5HD) {  //7.5HD
+            uint8_t pad[110];
+            memset(pad, 0xFF, sizeof(pad));
+            ret = send_frames(step8, sizeof(step8), pad, sizeof(pad), step8[2], true, 0, 100, 100); // cd 08
             if (ret != PM3_SUCCESS) {
                 return ret;
             }
-        } else if (model_nr == M2in7) {   //2.7inch
-            for (uint16_t i = 0; i < 48; i++) {
-                //read_black(i,step8, model_nr, black);
-                memset(&step8[3], 0xFF, sizeof(step8) - 3);
-                ret = transceive_blocking(step8, 124, rx, 20, actrxlen, true); // cd 08
-                if (ret != PM3_SUCCESS) {
-                    return ret;
-                }
-                progress = i * 50 / 48;
-                PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-            }
         }
         PROMPT_CLEARLINE;
         PrintAndLogEx(DEBUG, "Step9: e-paper power on");
@@ -485,26 +471,12 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
             }
             PrintAndLogEx(DEBUG, "Step9b");
             if (model_nr == M2in7) {
-                for (uint16_t i = 0; i < 48; i++) {
-                    read_black(i, step13, model_nr, black);
-                    ret = transceive_blocking(step13, 124, rx, 20, actrxlen, true); //CD 19
-                    if (ret != PM3_SUCCESS) {
-                        return ret;
-                    }
-                    progress = i * 50 / 48 + 50;
-                    PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-                }
+                ret = send_frames(step13, sizeof(step13), black, frames * step13[2], step13[2], true, 0, 50, 100); //CD 19
             } else if (model_nr == M2in13B) {
-                for (uint16_t i = 0; i < 26; i++) {
-                    read_red(i, step13, model_nr, red);
-                    //memset(&step13[3], 0xfE, 106);
-                    ret = transceive_blocking(step13, 109, rx, 20, actrxlen, false);
-                    if (ret != PM3_SUCCESS) {
-                        return ret;
-                    }
-                    progress = i * 50 / 26 + 50;
-                    PrintAndLogEx(INPLACE, "Progress: %d %%", progress);
-                }
+                ret = send_frames(step13, sizeof(step13), red, frames * step13[2], step13[2], false, 0, 50, 100);
+            }
+            if (ret != PM3_SUCCESS) {
+                return ret;
             }
             PROMPT_CLEARLINE;
         }
@@ -563,6 +535,99 @@ static int start_drawing(uint8_t model_nr, uint8_t *black, uint8_t *red) {
     return PM3_SUCCESS;
 }
 
+#define WS_CACHE_TEMPLATE   "waveshare_%016" PRIx64 "_%u.cache"
+#define WS_CACHE_MAGIC      "PM3W"
+#define WS_CACHE_VERSION    1
+
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t model;
+    uint32_t black_len;
+    uint32_t red_len;
+} PACKED ws_cache_hdr_t;
+
+// The bit planes of an image are cached under the hash of the image file, so loading the same
+// picture again skips scaling and dithering. No cache in incognito mode.
+static char *ws_cache_path(const char *infile, uint8_t model_nr) {
+    if (get_my_user_directory() == NULL || g_session.incognito) {
+        return NULL;
+    }
+
+    uint8_t *data = NULL;
+    size_t datalen = 0;
+    if (loadFile_safeEx(infile, "", (void **)&data, &datalen, false) != PM3_SUCCESS) {
+        return NULL;
+    }
+
+    // FNV-1a of the image file
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < datalen; i++) {
+        h = (h ^ data[i]) * 0x100000001B3ULL;
+    }
+    free(data);
+
+    char fn[48];
+    snprintf(fn, sizeof(fn), WS_CACHE_TEMPLATE, h, model_nr);
+
+    char *cachepath = NULL;
+    if (searchHomeFilePath(&cachepath, NULL, fn, true) != PM3_SUCCESS) {
+        return NULL;
+    }
+    return cachepath;
+}
+
+static int ws_cache_load(const char *cachepath, uint8_t model_nr, uint8_t **black, uint8_t **red) {
+    FILE *f = fopen(cachepath, "rb");
+    if (f == NULL) {
+        return PM3_EFILE;
+    }
+
+    ws_cache_hdr_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, WS_CACHE_MAGIC, sizeof(hdr.magic)) ||
+            hdr.version != WS_CACHE_VERSION || hdr.model != model_nr || hdr.black_len == 0) {
+        fclose(f);
+        return PM3_EFILE;
+    }
+
+    uint8_t *b = calloc(hdr.black_len, sizeof(uint8_t));
+    uint8_t *r = hdr.red_len ? calloc(hdr.red_len, sizeof(uint8_t)) : NULL;
+    if (b == NULL || (hdr.red_len && r == NULL) ||
+            fread(b, hdr.black_len, 1, f) != 1 || (r && fread(r, hdr.red_len, 1, f) != 1)) {
+        free(b);
+        free(r);
+        fclose(f);
+        return PM3_EFILE;
+    }
+    fclose(f);
+
+    *black = b;
+    *red = r;
+    return PM3_SUCCESS;
+}
+
+static void ws_cache_save(const char *cachepath, uint8_t model_nr, const uint8_t *black, uint32_t black_len, const uint8_t *red, uint32_t red_len) {
+    ws_cache_hdr_t hdr = {
+        .version = WS_CACHE_VERSION,
+        .model = model_nr,
+        .black_len = black_len,
+        .red_len = red ? red_len : 0,
+    };
+    memcpy(hdr.magic, WS_CACHE_MAGIC, sizeof(hdr.magic));
+
+    FILE *f = fopen(cachepath, "wb");
+    if (f == NULL) {
+        return;
+    }
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1) &&
+              (fwrite(black, black_len, 1, f) == 1) &&
+              (hdr.red_len == 0 || fwrite(red, red_len, 1, f) == 1);
+    ok = (fclose(f) == 0) && ok;
+    if (ok == false) {
+        remove(cachepath);
+    }
+}
+
 static int CmdHF14AWSLoad(const char *Cmd) {
 
     char desc[800] = {0};
@@ -624,10 +689,26 @@ static int CmdHF14AWSLoad(const char *Cmd) {
     }
 
     bool model_has_red = model_nr == M1in54B || model_nr == M2in13B;
+    uint32_t plane_len = ((models[model_nr].width + 7) / 8) * models[model_nr].height;
+
+    char *cachepath = (outfilelen == 0) ? ws_cache_path(infile, model_nr) : NULL;
+    if (cachepath) {
+        uint8_t *black_plane = NULL;
+        uint8_t *red_plane = NULL;
+        if (ws_cache_load(cachepath, model_nr, &black_plane, &red_plane) == PM3_SUCCESS) {
+            free(cachepath);
+            PrintAndLogEx(INFO, "Using cached conversion of " _YELLOW_("%s"), infile);
+            int res = start_drawing(model_nr, black_plane, red_plane);
+            free(black_plane);
+            free(red_plane);
+            return res;
+        }
+    }
 
     gdImagePtr rgb_img = gdImageCreateFromFile(infile);
     if (!rgb_img) {
         PrintAndLogEx(WARNING, "Could not load image from " _YELLOW_("%s"), infile);
+        free(cachepath);
         return PM3_EFILE;
     }
 
@@ -635,6 +716,7 @@ static int CmdHF14AWSLoad(const char *Cmd) {
     if (scaled_img == NULL) {
         PrintAndLogEx(WARNING, "Failed to scale input image");
         gdImageDestroy(rgb_img);
+        free(cachepath);
         return PM3_EFILE;
     }
     gdImageDestroy(rgb_img);
@@ -653,6 +735,7 @@ static int CmdHF14AWSLoad(const char *Cmd) {
 
     if (!pal_img) {
         PrintAndLogEx(WARNING, "Could not convert image");
+        free(cachepath);
         return PM3_EMALLOC;
     }
 
@@ -672,6 +755,7 @@ static int CmdHF14AWSLoad(const char *Cmd) {
     if (!black_plane) {
         PrintAndLogEx(WARNING, "Could not convert image to bit plane");
         gdImageDestroy(pal_img);
+        free(cachepath);
         return PM3_EMALLOC;
     }
 
@@ -682,11 +766,17 @@ static int CmdHF14AWSLoad(const char *Cmd) {
             PrintAndLogEx(WARNING, "Could not convert image to bit plane");
             free(black_plane);
             gdImageDestroy(pal_img);
+            free(cachepath);
             return PM3_EMALLOC;
         }
     }
     gdImageDestroy(pal_img);
 
+    if (cachepath) {
+        ws_cache_save(cachepath, model_nr, black_plane, plane_len, red_plane, plane_len);
+        free(cachepath);
+    }
+
     int res = start_drawing(model_nr, black_plane, red_plane);
     free(black_plane);
     free(red_plane);
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <inttypes.h>
 
 #ifdef HAVE_PYTHON
 #include <Python.h>
@@ -1124,21 +1125,355 @@ static int CmdVersion(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdProfile(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw profile",
+                  "Show the counters and timers of the device runtime profiler.\n"
+                  "Standalone modes and other device code record them with prof_count() / prof_start() / prof_stop()",
+                  "hw profile\n"
+                  "hw profile -r  -> show the counters, then reset them\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("r", "reset", "reset the counters after reading them"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    uint8_t reset = arg_get_lit(ctx, 1);
+    CLIParserFree(ctx);
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_PROFILE, &reset, sizeof(reset));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_PROFILE, &resp, 2000) == false) {
+        PrintAndLogEx(WARNING, "command execution time out");
+        return PM3_ETIMEOUT;
+    }
+    if (resp.status != PM3_SUCCESS || resp.length != sizeof(prof_stats_t)) {
+        PrintAndLogEx(WARNING, "Wrong response, device firmware and client don't match");
+        return PM3_ESOFT;
+    }
+
+    const prof_stats_t *stats = (const prof_stats_t *)resp.data.asBytes;
+    uint8_t slots = MIN(stats->slots, PROF_MAX_SLOTS);
+
+    PrintAndLogEx(INFO, "Recorded for... " _YELLOW_("%u.%03u") " s", stats->uptime_ms / 1000, stats->uptime_ms % 1000);
+    if (slots == 0) {
+        PrintAndLogEx(INFO, "No counters recorded");
+        return PM3_SUCCESS;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, " name         |    count |    calls |  total ms |   avg us |   min us |   max us");
+    PrintAndLogEx(INFO, "--------------+----------+----------+-----------+----------+----------+---------");
+    for (uint8_t i = 0; i < slots; i++) {
+        const prof_slot_t *p = &stats->slot[i];
+        if (p->calls) {
+            PrintAndLogEx(INFO, " %-12.*s | %8u | %8u | %9" PRIu64 " | %8" PRIu64 " | %8u | %8u",
+                          PROF_NAME_LEN, p->name, p->count, p->calls, p->total_us / 1000,
+                          p->total_us / p->calls, p->min_us, p->max_us);
+        } else {
+            PrintAndLogEx(INFO, " %-12.*s | %8u | %8u |         - |        - |        - |        -",
+                          PROF_NAME_LEN, p->name, p->count, p->calls);
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+    if (reset) {
+        PrintAndLogEx(INFO, "Counters reset");
+    }
+    return PM3_SUCCESS;
+}
+
+static int cmd_stats_cmp(const void *a, const void *b) {
+    const cmd_stats_t *sa = a, *sb = b;
+    if (sa->wall_us == sb->wall_us) {
+        return 0;
+    }
+    return (sa->wall_us < sb->wall_us) ? 1 : -1;
+}
+
+static int CmdStats(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw stats",
+                  "Show where the time of the client commands went: wall time, time blocked waiting\n"
+                  "for the device (USB transfer and device run time), host time (the rest),\n"
+                  "round trips and bytes sent and received.\n"
+                  "Per command totals are collected while `prefs set client.stats --on` is set.\n"
+                  "Commands run by other commands, e.g. from a script, are included in their caller too.",
+                  "hw stats\n"
+                  "hw stats -r  -> show the totals, then reset them\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("r", "reset", "reset the per command totals after showing them"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool reset = arg_get_lit(ctx, 1);
+    CLIParserFree(ctx);
+
+    comm_stats_t c;
+    GetCommunicationStats(&c);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Session traffic") " ------------------------");
+    PrintAndLogEx(INFO, "Sent.......... " _YELLOW_("%u") " frames, %" PRIu64 " bytes", c.frames_sent, c.bytes_sent);
+    PrintAndLogEx(INFO, "Received...... " _YELLOW_("%u") " frames, %" PRIu64 " bytes", c.frames_recv, c.bytes_recv);
+    PrintAndLogEx(INFO, "Round trips... " _YELLOW_("%u"), c.round_trips);
+    PrintAndLogEx(INFO, "Waiting....... " _YELLOW_("%" PRIu64) " ms", c.wait_us / 1000);
+
+    const cmd_stats_t *stats;
+    size_t n = GetCommandStats(&stats);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Per command") " ----------------------------");
+    if (n == 0) {
+        if (g_session.client_stats) {
+            PrintAndLogEx(INFO, "No commands recorded yet");
+        } else {
+            PrintAndLogEx(INFO, "Not collected, enable with `" _YELLOW_("prefs set client.stats --on") "`");
+        }
+        PrintAndLogEx(NORMAL, "");
+        return PM3_SUCCESS;
+    }
+
+    cmd_stats_t *sorted = calloc(n, sizeof(cmd_stats_t));
+    if (sorted == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    memcpy(sorted, stats, n * sizeof(cmd_stats_t));
+    qsort(sorted, n, sizeof(cmd_stats_t), cmd_stats_cmp);
+
+    PrintAndLogEx(INFO, " command                  | calls |   wall ms |   host ms |   wait ms | round trips |   tx bytes |   rx bytes");
+    PrintAndLogEx(INFO, "--------------------------+-------+-----------+-----------+-----------+-------------+------------+-----------");
+    for (size_t i = 0; i < n; i++) {
+        const cmd_stats_t *s = &sorted[i];
+        uint64_t host_us = s->wall_us - MIN(s->comm.wait_us, s->wall_us);
+        PrintAndLogEx(INFO, " %-24.24s | %5u | %9" PRIu64 " | %9" PRIu64 " | %9" PRIu64 " | %11u | %10" PRIu64 " | %10" PRIu64,
+                      s->name, s->calls, s->wall_us / 1000, host_us / 1000, s->comm.wait_us / 1000,
+                      s->comm.round_trips, s->comm.bytes_sent, s->comm.bytes_recv);
+    }
+    free(sorted);
+    PrintAndLogEx(NORMAL, "");
+
+    if (reset) {
+        ResetCommandStats();
+        PrintAndLogEx(INFO, "Per command totals reset");
+    }
+    return PM3_SUCCESS;
+}
+
+static const char *poll_protocol_str(uint8_t protocol) {
+    switch (protocol) {
+        case POLL_14A:
+            return "14a";
+        case POLL_14B:
+            return "14b";
+        case POLL_15:
+            return "15";
+        case POLL_ICLASS:
+            return "iclass";
+        case POLL_EM410X:
+            return "em410x";
+        case POLL_HID:
+            return "hid";
+        default:
+            return "?";
+    }
+}
+
+static int CmdPoll(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw poll",
+                  "Continuously poll for tags on the device, cycling through the selected protocols.\n"
+                  "Only changes are reported: a new tag (+) and a tag gone for longer than --gone (-).\n"
+                  "Without protocol flags all of them are polled. Press <Enter> or the button to stop.",
+                  "hw poll\n"
+                  "hw poll --14a --em      --> only ISO14443-A and EM410x\n"
+                  "hw poll --15 --gone 2000"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "14a", "poll ISO14443-A"),
+        arg_lit0(NULL, "14b", "poll ISO14443-B"),
+        arg_lit0(NULL, "15", "poll ISO15693"),
+        arg_lit0(NULL, "iclass", "poll iCLASS / Picopass"),
+        arg_lit0(NULL, "em", "poll EM410x"),
+        arg_lit0(NULL, "hid", "poll HID Prox"),
+        arg_u64_0(NULL, "gone", "<ms>", "report a tag as gone after not seeing it for this long (def 500)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    uint32_t gone = arg_get_u32_def(ctx, 7, 500);
+    poll_params_t params = {
+        .protocols = (arg_get_lit(ctx, 1) ? POLL_14A : 0)
+        | (arg_get_lit(ctx, 2) ? POLL_14B : 0)
+        | (arg_get_lit(ctx, 3) ? POLL_15 : 0)
+        | (arg_get_lit(ctx, 4) ? POLL_ICLASS : 0)
+        | (arg_get_lit(ctx, 5) ? POLL_EM410X : 0)
+        | (arg_get_lit(ctx, 6) ? POLL_HID : 0),
+        .gone_ms = gone,
+    };
+    CLIParserFree(ctx);
+
+    if (gone > UINT16_MAX) {
+        PrintAndLogEx(WARNING, "--gone must be at most %u ms", UINT16_MAX);
+        return PM3_EINVARG;
+    }
+
+    if (params.protocols == 0) {
+        params.protocols = POLL_ALL;
+    }
+
+    PrintAndLogEx(INFO, "Polling... press " _GREEN_("<Enter>") " or the pm3 button to stop");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_POLL, (uint8_t *)&params, sizeof(params));
+
+    bool aborted = false;
+    PacketResponseNG resp;
+    for (;;) {
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_POLL, &resp, 100) == false) {
+            continue;
+        }
+
+        // the last reply has no payload
+        if (resp.length < sizeof(poll_event_t)) {
+            break;
+        }
+
+        const poll_event_t *e = (const poll_event_t *)resp.data.asBytes;
+        uint8_t idlen = MIN(e->idlen, sizeof(e->id));
+        const char *id = sprint_hex_inrow(e->id, idlen);
+        if (e->event == POLL_EVENT_NEW) {
+            PrintAndLogEx(SUCCESS, "%8u ms  " _GREEN_("+") " %-6s " _GREEN_("%s"), e->time_ms, poll_protocol_str(e->protocol), id);
+            result_add_str(poll_protocol_str(e->protocol), id);
+        } else {
+            PrintAndLogEx(INFO, "%8u ms  " _RED_("-") " %-6s %s", e->time_ms, poll_protocol_str(e->protocol), id);
+        }
+    }
+
+    PrintAndLogEx(INFO, "Done");
+    return PM3_SUCCESS;
+}
+
+// lower bound in us of a RF timing histogram bucket, see RFT_BUCKETS
+static uint32_t rft_bucket_us(uint8_t i) {
+    if (i == 0) {
+        return 0;
+    }
+    uint32_t us = 16 << (i / 2);
+    return (i & 1) ? us + us / 2 : us;
+}
+
+// smallest bucket bound holding pct percent of the tag answers
+static uint32_t rft_latency_percentile_us(const rft_stats_t *s, uint8_t pct) {
+    uint64_t need = ((uint64_t)s->answers * pct + 99) / 100;
+    uint64_t sum = 0;
+    for (uint8_t i = 0; i < RFT_BUCKETS - 1; i++) {
+        sum += s->latency[i];
+        if (sum >= need) {
+            return rft_bucket_us(i + 1);
+        }
+    }
+    return UINT32_MAX;
+}
+
+static void rft_print(const rft_reply_t *r) {
+    const rft_stats_t *s = &r->stats;
+    const char *name = (r->protocol == RFT_14A) ? "ISO14443-A" : "ISO15693 / iCLASS";
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("RF timing %s") " ----------------------", name);
+    PrintAndLogEx(INFO, "Frames sent..... " _YELLOW_("%u") ", answers %u, timeouts " _YELLOW_("%u"), s->frames, s->answers, s->timeouts);
+    if (s->answers == 0 && s->turnarounds == 0) {
+        return;
+    }
+
+    if (s->answers) {
+        PrintAndLogEx(INFO, "Tag latency..... avg " _YELLOW_("%" PRIu64) " us, min %u us, max %u us",
+                      s->latency_total_us / s->answers, s->latency_min_us, s->latency_max_us);
+        uint32_t p99 = rft_latency_percentile_us(s, 99);
+        if (p99 != UINT32_MAX) {
+            PrintAndLogEx(INFO, "                 99%% of the answers within " _GREEN_("%u") " us", p99);
+        }
+    }
+    if (s->turnarounds) {
+        PrintAndLogEx(INFO, "Turnaround...... avg " _YELLOW_("%" PRIu64) " us after a tag answer", s->turnaround_total_us / s->turnarounds);
+    }
+
+    PrintAndLogEx(INFO, "  from us |    latency | turnaround");
+    PrintAndLogEx(INFO, "----------+------------+-----------");
+    for (uint8_t i = 0; i < RFT_BUCKETS; i++) {
+        if (s->latency[i] || s->turnaround[i]) {
+            PrintAndLogEx(INFO, " %8u | %10u | %10u", rft_bucket_us(i), s->latency[i], s->turnaround[i]);
+        }
+    }
+}
+
+static void rft_show(bool reset) {
+    for (uint8_t p = 0; p < RFT_PROTOCOLS; p++) {
+        rft_request_t req = {
+            .protocol = p,
+            .reset = (reset && p == RFT_PROTOCOLS - 1),
+        };
+        clearCommandBuffer();
+        SendCommandNG(CMD_RF_TIMING, (uint8_t *)&req, sizeof(req));
+        PacketResponseNG resp;
+        // older firmwares don't answer, the section is just left out
+        if (WaitForResponseTimeout(CMD_RF_TIMING, &resp, 500) == false) {
+            PrintAndLogEx(DEBUG, "RF timing not supported by the firmware");
+            return;
+        }
+        if (resp.status != PM3_SUCCESS || resp.length != sizeof(rft_reply_t)) {
+            PrintAndLogEx(DEBUG, "RF timing, wrong response");
+            return;
+        }
+
+        const rft_reply_t *r = (const rft_reply_t *)resp.data.asBytes;
+        if (p == 0) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(INFO, "RF timing recorded for " _YELLOW_("%u.%03u") " s", r->uptime_ms / 1000, r->uptime_ms % 1000);
+        }
+        if (r->stats.frames) {
+            rft_print(r);
+        }
+    }
+    if (reset) {
+        PrintAndLogEx(INFO, "RF timing counters reset");
+    }
+    PrintAndLogEx(NORMAL, "");
+}
+
 static int CmdStatus(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hw status",
-                  "Show runtime status information about the connected Proxmark3",
+                  "Show runtime status information about the connected Proxmark3.\n"
+                  "Ends with the RF timing the device recorded as reader: tag answer latency,\n"
+                  "our turnaround after an answer and timeouts, per protocol",
                   "hw status\n"
                   "hw status --ms 1000 -> Test connection speed with 1000ms timeout\n"
+                  "hw status -r        -> reset the RF timing counters after showing them\n"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_int0("m", "ms", "<ms>", "speed test timeout in micro seconds"),
+        arg_lit0("r", "reset", "reset the RF timing counters"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     int32_t speedTestTimeout = arg_get_int_def(ctx, 1, -1);
+    bool rft_reset = arg_get_lit(ctx, 2);
     CLIParserFree(ctx);
 
     clearCommandBuffer();
@@ -1154,6 +1489,8 @@ static int CmdStatus(const char *Cmd) {
         PrintAndLogEx(WARNING, "Status command timeout. Communication speed test timed out");
         return PM3_ETIMEOUT;
     }
+
+    rft_show(rft_reset);
     return PM3_SUCCESS;
 }
 
@@ -1345,6 +1682,239 @@ static int CmdPing(const char *Cmd) {
         }
     } else
         PrintAndLogEx(WARNING, "Ping response " _RED_("timeout"));
+
+    comm_latency_t lat;
+    GetCommunicationLatency(&lat);
+    if (lat.count) {
+        PrintAndLogEx(INFO, "Link round trip... last " _YELLOW_("%u") " us, min %u / avg %u / max %u us over %u commands",
+                      lat.last_us, lat.min_us, (uint32_t)(lat.total_us / lat.count), lat.max_us, lat.count);
+    }
+    return PM3_SUCCESS;
+}
+
+static int bench_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static const char *bench_link_name(void) {
+    if (g_conn.send_via_ip != PM3_NONE) {
+        return g_conn.send_via_fpc_usart ? "FPC USART over IP" : "USB-CDC over IP";
+    }
+    return g_conn.send_via_fpc_usart ? "FPC USART / BT" : "USB-CDC";
+}
+
+static void bench_fill(uint8_t *data, uint32_t len, uint32_t seq) {
+    for (uint32_t i = 0; i < len; i++) {
+        data[i] = (seq + i) & 0xFF;
+    }
+}
+
+// sequential pings, client side round trip of each (send to matching reply)
+static int bench_latency(uint32_t count, uint32_t len, uint32_t *lost) {
+
+    uint32_t *rtt = calloc(count, sizeof(uint32_t));
+    if (rtt == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    uint8_t data[PM3_CMD_DATA_SIZE];
+    uint32_t n = 0;
+    *lost = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!");
+            free(rtt);
+            return PM3_EOPABORTED;
+        }
+
+        bench_fill(data, len, i);
+        PacketResponseNG resp;
+        clearCommandBuffer();
+        uint64_t t = usclock();
+        SendCommandNG(CMD_PING, data, len);
+        if (WaitForResponseTimeout(CMD_PING, &resp, 1000) == false || resp.length != len || memcmp(data, resp.data.asBytes, len) != 0) {
+            (*lost)++;
+            continue;
+        }
+        rtt[n++] = (uint32_t)(usclock() - t);
+    }
+
+    if (n == 0) {
+        PrintAndLogEx(FAILED, "Latency........ " _RED_("no reply"));
+        free(rtt);
+        return PM3_ETIMEOUT;
+    }
+
+    qsort(rtt, n, sizeof(uint32_t), bench_cmp_u32);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        total += rtt[i];
+    }
+
+    PrintAndLogEx(SUCCESS, "Latency........ %u round trips of " _YELLOW_("%u") " bytes", n, len);
+    PrintAndLogEx(SUCCESS, "   min / avg... " _YELLOW_("%u") " / " _YELLOW_("%" PRIu64) " us", rtt[0], total / n);
+    PrintAndLogEx(SUCCESS, "   p50 / p90... " _YELLOW_("%u") " / " _YELLOW_("%u") " us", rtt[n / 2], rtt[(n * 90) / 100]);
+    PrintAndLogEx(SUCCESS, "   p99 / max... " _YELLOW_("%u") " / " _YELLOW_("%u") " us", rtt[(n * 99) / 100], rtt[n - 1]);
+    free(rtt);
+    return PM3_SUCCESS;
+}
+
+// full size pings kept in flight, the device echoes them so the same amount flows back
+static int bench_upload(uint32_t bytes, uint32_t *lost) {
+
+    const uint32_t window = 8;
+    uint32_t frames = (bytes + PM3_CMD_DATA_SIZE - 1) / PM3_CMD_DATA_SIZE;
+    uint32_t sent = 0, done = 0;
+    uint8_t data[PM3_CMD_DATA_SIZE];
+    *lost = 0;
+
+    clearCommandBuffer();
+    uint64_t t = usclock();
+
+    while (done < frames) {
+        while ((sent < frames) && (sent - done < window)) {
+            bench_fill(data, sizeof(data), sent);
+            SendCommandNG(CMD_PING, data, sizeof(data));
+            sent++;
+        }
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_PING, &resp, 1000) == false) {
+            // whatever is still in flight is gone
+            *lost += sent - done;
+            done = sent;
+            continue;
+        }
+
+        bench_fill(data, sizeof(data), done);
+        if (resp.length != sizeof(data) || memcmp(data, resp.data.asBytes, sizeof(data)) != 0) {
+            (*lost)++;
+        }
+        done++;
+    }
+
+    uint64_t us = MAX(usclock() - t, 1);
+    uint64_t moved = (uint64_t)(frames - *lost) * PM3_CMD_DATA_SIZE;
+    PrintAndLogEx(SUCCESS, "Upload......... " _YELLOW_("%.3f") " MB/s ( %" PRIu64 " bytes in %" PRIu64 " ms, echoed back )", (double)moved / us, moved, us / 1000);
+    return PM3_SUCCESS;
+}
+
+// BigBuf download, repeated until the requested amount went through
+static int bench_download(uint32_t bytes) {
+
+    uint32_t chunk = MIN(bytes, g_pm3_capabilities.bigbuf_size);
+    if (chunk == 0) {
+        PrintAndLogEx(WARNING, "Download....... no BigBuf size known, skipping");
+        return PM3_ESOFT;
+    }
+
+    uint8_t *buf = calloc(chunk, sizeof(uint8_t));
+    if (buf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    uint64_t moved = 0, skipped = 0;
+    uint32_t failed = 0;
+    uint64_t t = usclock();
+
+    while (moved + skipped < bytes) {
+        uint32_t n = MIN(chunk, bytes - moved - skipped);
+        if (GetFromDevice(BIG_BUF, buf, n, 0, NULL, 0, NULL, 2500, false)) {
+            moved += n;
+        } else {
+            skipped += n;
+            failed++;
+        }
+    }
+
+    uint64_t us = MAX(usclock() - t, 1);
+    free(buf);
+    PrintAndLogEx(SUCCESS, "Download....... " _YELLOW_("%.3f") " MB/s ( %" PRIu64 " bytes in %" PRIu64 " ms%s )", (double)moved / us, moved, us / 1000,
+                  g_conn.send_via_fpc_usart ? ", LZ4" : "");
+    if (failed) {
+        PrintAndLogEx(FAILED, "Download....... " _RED_("%u") " transfer(s) failed", failed);
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdBench(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw bench",
+                  "Measure the link to the Proxmark3: round trip latency percentiles,\n"
+                  "upload and download throughput and lost frames.\n"
+                  "Without --lat / --up / --down all three tests are run",
+                  "hw bench\n"
+                  "hw bench --lat -n 1000 -l 16\n"
+                  "hw bench --down -s 1048576"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "lat", "round trip latency"),
+        arg_lit0(NULL, "up", "upload throughput"),
+        arg_lit0(NULL, "down", "download throughput"),
+        arg_u64_0("n", "count", "<dec>", "number of round trips (def 200)"),
+        arg_u64_0("l", "len", "<dec>", "payload of the latency pings (def 32)"),
+        arg_u64_0("s", "size", "<dec>", "bytes to move in the throughput tests (def 262144)"),
+        arg_param_end
+    };
+
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool lat = arg_get_lit(ctx, 1);
+    bool up = arg_get_lit(ctx, 2);
+    bool down = arg_get_lit(ctx, 3);
+    uint32_t count = arg_get_u32_def(ctx, 4, 200);
+    uint32_t len = arg_get_u32_def(ctx, 5, 32);
+    uint32_t size = arg_get_u32_def(ctx, 6, 262144);
+    CLIParserFree(ctx);
+
+    if ((lat || up || down) == false) {
+        lat = up = down = true;
+    }
+
+    if (count == 0 || size == 0) {
+        PrintAndLogEx(WARNING, "Count and size must be above zero");
+        return PM3_EINVARG;
+    }
+
+    if (len > PM3_CMD_DATA_SIZE) {
+        len = PM3_CMD_DATA_SIZE;
+    }
+
+    PrintAndLogEx(INFO, "Link........... " _YELLOW_("%s"), bench_link_name());
+    if (g_conn.send_via_fpc_usart) {
+        PrintAndLogEx(INFO, "Baudrate....... " _YELLOW_("%u"), g_conn.uart_speed);
+    }
+
+    uint32_t lost_lat = 0, lost_up = 0;
+    uint32_t pings = 0;
+
+    if (lat) {
+        int res = bench_latency(count, len, &lost_lat);
+        if (res == PM3_EOPABORTED) {
+            return res;
+        }
+        pings += count;
+    }
+
+    if (up) {
+        bench_upload(size, &lost_up);
+        pings += (size + PM3_CMD_DATA_SIZE - 1) / PM3_CMD_DATA_SIZE;
+    }
+
+    if (down) {
+        bench_download(size);
+    }
+
+    if (pings) {
+        uint32_t lost = lost_lat + lost_up;
+        PrintAndLogEx((lost) ? WARNING : SUCCESS, "Frame loss..... " _YELLOW_("%u") " / %u pings ( %.2f %% )", lost, pings, (100.0 * lost) / pings);
+    }
     return PM3_SUCCESS;
 }
 
@@ -1461,11 +2031,15 @@ static command_t CommandTable[] = {
     {"help",          CmdHelp,         AlwaysAvailable,  "This help"},
     {"-------------", CmdHelp,         AlwaysAvailable,  "----------------------- " _CYAN_("Operation") " -----------------------"},
     {"detectreader",  CmdDetectReader, IfPm3Present,     "Detect external reader field"},
+    {"poll",          CmdPoll,         IfPm3Present,     "Continuously poll for tags across protocols and report changes"},
+    {"profile",       CmdProfile,      IfPm3Present,     "Show the device runtime profiler counters"},
+    {"stats",         CmdStats,        AlwaysAvailable,  "Show per command timing and traffic of the client"},
     {"status",        CmdStatus,       IfPm3Present,     "Show runtime status information about the connected Proxmark3"},
     {"tearoff",       CmdTearoff,      IfPm3Present,     "Program a tearoff hook for the next command supporting tearoff"},
     {"timeout",       CmdTimeout,      AlwaysAvailable,  "Set the communication timeout on the client side"},
     {"version",       CmdVersion,      AlwaysAvailable,  "Show version information about the client and Proxmark3"},
     {"-------------", CmdHelp,         AlwaysAvailable,  "----------------------- " _CYAN_("Hardware") " -----------------------"},
+    {"bench",         CmdBench,        IfPm3Present,     "Measure link latency, throughput and frame loss"},
     {"break",         CmdBreak,        IfPm3Present,     "Send break loop usb command"},
     {"bootloader",    CmdBootloader,   IfPm3Present,     "Reboot into bootloader mode"},
     {"connect",       CmdConnect,      AlwaysAvailable,  "Connect to the device via serial port"},
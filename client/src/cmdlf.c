@@ -70,6 +70,7 @@
 #include "crc.h"
 #include "pm3_cmd.h"        // for LF_CMDREAD_MAX_EXTRA_SYMBOLS
 #include "fpga.h"           // for set_fpga_mode
+#include "wiegand_formats.h"  // for `lf watch`
 
 static int CmdHelp(const char *Cmd);
 
@@ -99,6 +100,76 @@ int lfsim_wait_check(uint32_t cmd) {
     return PM3_SUCCESS;
 }
 
+// The device pushes a measurement every LF_TUNE_STREAM_INTERVAL_US, shown as the
+// average of the last LF_TUNE_WINDOW of them, once per packet.
+#define LF_TUNE_WINDOW  64
+static void lf_tune_stream(uint32_t iter, barMode_t style, bool verbose) {
+
+    uint8_t params[] = {4, 25};  // 50 ms of measurements per packet
+    clearCommandBuffer();
+    SendCommandNG(CMD_MEASURE_ANTENNA_TUNING_LF, params, sizeof(params));
+
+    uint32_t window[LF_TUNE_WINDOW] = {0};
+    uint64_t w_sum = 0, v_sum = 0, v_count = 0;
+    uint32_t w_len = 0, w_pos = 0, v_max = 0, v_min = UINT32_MAX, lost = 0, expected = 0;
+    bool stopped = false;
+
+    for (uint32_t i = 0; ; ) {
+
+        if (stopped == false && (kbd_enter_pressed() || (iter && i >= iter))) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopped = true;
+        }
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_MEASURE_ANTENNA_TUNING_LF, &resp, 1000) == false) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(WARNING, "timeout while waiting for Proxmark LF measure, aborting");
+            break;
+        }
+
+        // the last packet, after the button or our break
+        if (resp.status != PM3_SUCCESS || resp.length < sizeof(lf_tune_stream_t) - sizeof(((lf_tune_stream_t *)0)->mv)) {
+            break;
+        }
+
+        const lf_tune_stream_t *pkt = (const lf_tune_stream_t *)resp.data.asBytes;
+        lost += pkt->seq - expected;
+        expected = pkt->seq + 1;
+
+        uint8_t count = MIN(pkt->count, LF_TUNE_STREAM_MAX);
+        for (uint8_t j = 0; j < count; j++) {
+            uint32_t volt = pkt->mv[j];
+            if (w_len == LF_TUNE_WINDOW) {
+                w_sum -= window[w_pos];
+            } else {
+                w_len++;
+            }
+            window[w_pos] = volt;
+            w_sum += volt;
+            w_pos = (w_pos + 1) % LF_TUNE_WINDOW;
+
+            v_max = MAX(v_max, volt);
+            v_min = MIN(v_min, volt);
+            v_sum += volt;
+            v_count++;
+        }
+
+        if (stopped == false) {
+            print_progress(w_sum / w_len, v_max, style);
+            i++;
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "\x1b%c[2K\r", 30);
+    if (verbose && v_count) {
+        PrintAndLogEx(INFO, "Measurements... %" PRIu64 " @ %u us, %u packets lost", v_count, LF_TUNE_STREAM_INTERVAL_US, lost);
+        PrintAndLogEx(INFO, "Min....... %u mV", v_min);
+        PrintAndLogEx(INFO, "Max....... %u mV", v_max);
+        PrintAndLogEx(INFO, "Average... %.3lf mV", v_sum / (double)v_count);
+    }
+}
+
 static int CmdLFTune(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -106,7 +177,8 @@ static int CmdLFTune(const char *Cmd) {
                   "Continuously measure LF antenna tuning.\n"
                   "Press button or <Enter> to interrupt.",
                   "lf tune\n"
-                  "lf tune --mix"
+                  "lf tune --mix\n"
+                  "lf tune --stream      -> device pushes measurements, moving average shown"
                  );
 
     char q_str[60];
@@ -120,6 +192,7 @@ static int CmdLFTune(const char *Cmd) {
         arg_lit0(NULL, "mix", "mixed style"),
         arg_lit0(NULL, "value", "values style"),
         arg_lit0("v", "verbose", "verbose output"),
+        arg_lit0(NULL, "stream", "stream measurements from the device, show a moving average"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -131,6 +204,7 @@ static int CmdLFTune(const char *Cmd) {
     bool is_mix = arg_get_lit(ctx, 5);
     bool is_value = arg_get_lit(ctx, 6);
     bool verbose = arg_get_lit(ctx, 7);
+    bool stream = arg_get_lit(ctx, 8);
     CLIParserFree(ctx);
 
     if (divisor < 19) {
@@ -193,8 +267,12 @@ static int CmdLFTune(const char *Cmd) {
 
     print_progress(0, v_max, style);
 
+    if (stream) {
+        lf_tune_stream(iter, style, verbose);
+    }
+
     // loop forever (till button pressed) if iter = 0 (default)
-    for (uint32_t i = 0; iter == 0 || i < iter; i++) {
+    for (uint32_t i = 0; stream == false && (iter == 0 || i < iter); i++) {
         if (kbd_enter_pressed()) {
             break;
         }
@@ -233,8 +311,10 @@ static int CmdLFTune(const char *Cmd) {
         return PM3_ETIMEOUT;
     }
 
-    PrintAndLogEx(NORMAL, "\x1b%c[2K\r", 30);
-    if (verbose) {
+    if (stream == false) {
+        PrintAndLogEx(NORMAL, "\x1b%c[2K\r", 30);
+    }
+    if (verbose && stream == false) {
         PrintAndLogEx(INFO, "Min....... %u mV", v_min);
         PrintAndLogEx(INFO, "Max....... %u mV", v_max);
         PrintAndLogEx(INFO, "Average... %.3lf mV", v_sum / (double)v_count);
@@ -628,6 +708,9 @@ int CmdLFConfig(const char *Cmd) {
                   "lf config -b 8 --125         --> samples at 125 kHz, 8 bps\n"
                   "lf config -b 4 --134 --dec 3 --> samples at 134 kHz, averages three samples into one, stored with a resolution of 4 bits per sample\n"
                   "lf config --trig 20 -s 10000 --> trigger sampling when above 20, skip 10 000 first samples after triggered\n"
+                  "lf config --trig 20 --post 8000 --> ring mode, keep 8000 samples after the trigger and the rest before it\n"
+                  "lf config --trig 60 --gap 30 --post 8000 --> ring mode, trigger on a field-off gap of 30 samples\n"
+                  "lf config --post 0 --> back to normal sampling\n"
                   "lf config --reset            --> reset back to default values\n"
                  );
 
@@ -646,6 +729,8 @@ int CmdLFConfig(const char *Cmd) {
         arg_lit0("r", "reset", "reset values to defaults"),
         arg_int0("s", "skip", "<dec>", "sets a number of samples to skip before capture (default 0)"),
         arg_int0("t", "trig", "<0-128>", "sets trigger threshold. 0 means no threshold"),
+        arg_int0(NULL, "post", "<dec>", "ring mode, samples kept after the trigger. 0 means off (default 0, 8 bps only)"),
+        arg_int0(NULL, "gap", "<dec>", "ring mode, trigger on a field-off gap of this many samples below -trig. 0 means on the threshold edge"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -659,6 +744,8 @@ int CmdLFConfig(const char *Cmd) {
     bool reset = arg_get_lit(ctx, 8);
     int32_t skip = arg_get_int_def(ctx, 9, -1);
     int16_t trigg = arg_get_int_def(ctx, 10, -1);
+    int32_t post = arg_get_int_def(ctx, 11, -1);
+    int16_t gap = arg_get_int_def(ctx, 12, -1);
     CLIParserFree(ctx);
 
     if (g_session.pm3_present == false)
@@ -681,7 +768,9 @@ int CmdLFConfig(const char *Cmd) {
         .divisor = -1,
         .trigger_threshold = -1,
         .samples_to_skip = -1,
-        .verbose = true
+        .verbose = true,
+        .post_trigger = -1,
+        .trigger_gap = -1
     };
 
     if (use_125)
@@ -729,6 +818,8 @@ int CmdLFConfig(const char *Cmd) {
     }
 
     config.samples_to_skip = skip;
+    config.post_trigger = post;
+    config.trigger_gap = gap;
 
     if (reset) {
         config.decimation = 1;
@@ -737,11 +828,73 @@ int CmdLFConfig(const char *Cmd) {
         config.divisor = LF_DIVISOR_125;
         config.samples_to_skip = 0;
         config.trigger_threshold = 0;
+        config.post_trigger = 0;
+        config.trigger_gap = 0;
     }
 
     return lf_setconfig(&config);
 }
 
+// Real-time sampling, raw data is streamed through a small ring of buffers
+// and unpacked into GraphBuffer on the fly
+#define LF_REALTIME_BUF_COUNT 4
+#define LF_REALTIME_BUF_SIZE  (16 * 1024)
+
+static void lf_stream_samples(const int *samples, size_t n, void *ctx) {
+    lf_stream_push((lf_stream_demod_t *)ctx, samples, n);
+}
+
+static int lf_read_realtime(uint16_t cmd, lf_sample_payload_t *payload, uint8_t bits_per_sample, bool is_trigger_threshold_set, uint64_t samples, bool verbose, lf_stream_demod_t *demod) {
+
+    uint8_t *mem = calloc(LF_REALTIME_BUF_COUNT, LF_REALTIME_BUF_SIZE);
+    if (mem == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    uint8_t *bufs[LF_REALTIME_BUF_COUNT];
+    for (uint8_t i = 0; i < LF_REALTIME_BUF_COUNT; i++) {
+        bufs[i] = mem + (i * LF_REALTIME_BUF_SIZE);
+    }
+
+    size_t sample_bytes = samples * bits_per_sample;
+    sample_bytes = (sample_bytes / 8) + (sample_bytes % 8 != 0);
+
+    // In real-time mode, the LF bitstream should be loaded before receiving raw data.
+    // Otherwise, the first batch of raw data might contain the response of CMD_WTX.
+    int result = set_fpga_mode(FPGA_BITSTREAM_LF);
+    if (result != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "failed to load LF bitstream to FPGA");
+        free(mem);
+        return result;
+    }
+
+    samples_stream_t stream;
+    getSamplesStreamInit(&stream, bits_per_sample);
+    // the demodulator sees every sample, GraphBuffer keeps the first ones
+    if (demod != NULL) {
+        getSamplesStreamSetCallback(&stream, lf_stream_samples, demod);
+    }
+
+    // armed before sending, the samples follow the command right away
+    if (StartRawDataStream(bufs, LF_REALTIME_BUF_COUNT, LF_REALTIME_BUF_SIZE, sample_bytes) == false) {
+        free(mem);
+        return PM3_EFAILED;
+    }
+    SendCommandNG(cmd, (uint8_t *)payload, sizeof(lf_sample_payload_t));
+
+    // with a trigger, wait until the first data arrives
+    sample_bytes = WaitForRawDataStream(1000, is_trigger_threshold_set, true, getSamplesStreamPush, &stream);
+    free(mem);
+
+    samples = sample_bytes * 8 / bits_per_sample;
+    PrintAndLogEx(INFO, "Done: %" PRIu64 " samples (%zu bytes)", samples, sample_bytes);
+    if (samples != 0) {
+        getSamplesStreamDone(&stream, verbose);
+    }
+    return PM3_SUCCESS;
+}
+
 static int lf_read_internal(bool realtime, bool verbose, uint64_t samples) {
     if (!g_session.pm3_present) return PM3_ENOTTY;
 
@@ -760,41 +913,7 @@ static int lf_read_internal(bool realtime, bool verbose, uint64_t samples) {
     const bool is_trigger_threshold_set = (current_config.trigger_threshold > 0);
 
     if (realtime) {
-        uint8_t *realtimeBuf = calloc(samples, sizeof(uint8_t));
-        if (realtimeBuf == NULL) {
-            PrintAndLogEx(WARNING, "Failed to allocate memory");
-            return PM3_EMALLOC;
-        }
-
-        size_t sample_bytes = samples * bits_per_sample;
-        sample_bytes = (sample_bytes / 8) + (sample_bytes % 8 != 0);
-
-        // In real-time mode, the LF bitstream should be loaded before receiving raw data.
-        // Otherwise, the first batch of raw data might contain the response of CMD_WTX.
-        int result = set_fpga_mode(FPGA_BITSTREAM_LF);
-        if (result != PM3_SUCCESS) {
-            PrintAndLogEx(FAILED, "failed to load LF bitstream to FPGA");
-            free(realtimeBuf);
-            return result;
-        }
-
-        SendCommandNG(CMD_LF_ACQ_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
-        if (is_trigger_threshold_set) {
-            size_t first_receive_len = 32;
-            // Wait until a bunch of data arrives
-            first_receive_len = WaitForRawDataTimeout(realtimeBuf, first_receive_len, -1, false);
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf + first_receive_len, sample_bytes - first_receive_len, 1000, true);
-            sample_bytes += first_receive_len;
-        } else {
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf, sample_bytes, 1000, true);
-        }
-        samples = sample_bytes * 8 / bits_per_sample;
-        PrintAndLogEx(INFO, "Done: %" PRIu64 " samples (%zu bytes)", samples, sample_bytes);
-        if (samples != 0) {
-            getSamplesFromBufEx(realtimeBuf, samples, bits_per_sample, verbose);
-        }
-
-        free(realtimeBuf);
+        return lf_read_realtime(CMD_LF_ACQ_RAW_ADC, &payload, bits_per_sample, is_trigger_threshold_set, samples, verbose, NULL);
     } else {
         payload.samples = (samples > MAX_LF_SAMPLES) ? MAX_LF_SAMPLES : samples;
         SendCommandNG(CMD_LF_ACQ_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
@@ -871,7 +990,7 @@ int CmdLFRead(const char *Cmd) {
     return ret;
 }
 
-int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
+int lf_sniff_ex(bool realtime, bool verbose, uint64_t samples, lf_stream_demod_t *demod) {
     if (!g_session.pm3_present) return PM3_ENOTTY;
 
     lf_sample_payload_t payload = {0};
@@ -889,41 +1008,7 @@ int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
     const bool is_trigger_threshold_set = (current_config.trigger_threshold > 0);
 
     if (realtime) {
-        uint8_t *realtimeBuf = calloc(samples, sizeof(uint8_t));
-        if (realtimeBuf == NULL) {
-            PrintAndLogEx(WARNING, "Failed to allocate memory");
-            return PM3_EMALLOC;
-        }
-
-        size_t sample_bytes = samples * bits_per_sample;
-        sample_bytes = (sample_bytes / 8) + (sample_bytes % 8 != 0);
-
-        // In real-time mode, the LF bitstream should be loaded before receiving raw data.
-        // Otherwise, the first batch of raw data might contain the response of CMD_WTX.
-        int result = set_fpga_mode(FPGA_BITSTREAM_LF);
-        if (result != PM3_SUCCESS) {
-            PrintAndLogEx(FAILED, "failed to load LF bitstream to FPGA");
-            free(realtimeBuf);
-            return result;
-        }
-
-        SendCommandNG(CMD_LF_SNIFF_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
-        if (is_trigger_threshold_set) {
-            size_t first_receive_len = 32;
-            // Wait until a bunch of data arrives
-            first_receive_len = WaitForRawDataTimeout(realtimeBuf, first_receive_len, -1, false);
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf + first_receive_len, sample_bytes - first_receive_len, 1000, true);
-            sample_bytes += first_receive_len;
-        } else {
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf, sample_bytes, 1000, true);
-        }
-        samples = sample_bytes * 8 / bits_per_sample;
-        PrintAndLogEx(INFO, "Done: %" PRIu64 " samples (%zu bytes)", samples, sample_bytes);
-        if (samples != 0) {
-            getSamplesFromBufEx(realtimeBuf, samples, bits_per_sample, verbose);
-        }
-
-        free(realtimeBuf);
+        return lf_read_realtime(CMD_LF_SNIFF_RAW_ADC, &payload, bits_per_sample, is_trigger_threshold_set, samples, verbose, demod);
     } else {
         payload.samples = (samples > MAX_LF_SAMPLES) ? MAX_LF_SAMPLES : samples;
         SendCommandNG(CMD_LF_SNIFF_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
@@ -939,11 +1024,29 @@ int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
         // response is number of bits read
         uint32_t size = (resp.data.asDwords[0] / bits_per_sample);
         getSamples(size, verbose);
+
+        // same chunks as in real-time mode
+        for (size_t i = 0; demod != NULL && i < g_GraphTraceLen; i += SAMPLES_STREAM_CHUNK) {
+            lf_stream_push(demod, g_GraphBuffer + i, MIN(SAMPLES_STREAM_CHUNK, g_GraphTraceLen - i));
+        }
     }
 
     return PM3_SUCCESS;
 }
 
+int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
+    return lf_sniff_ex(realtime, verbose, samples, NULL);
+}
+
+static void lf_sniff_print_frame(const lf_stream_frame_t *frame, void *ctx) {
+    (void) ctx;
+    if (frame->long_width) {
+        PrintAndLogEx(SUCCESS, "%10" PRIu64 " | %3u | %3u | %3u | %s", frame->start, frame->count, frame->short_width, frame->long_width, frame->bits);
+    } else {
+        PrintAndLogEx(SUCCESS, "%10" PRIu64 " | %3u | %3u |     |", frame->start, frame->count, frame->short_width);
+    }
+}
+
 int CmdLFSniff(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf sniff",
@@ -957,6 +1060,7 @@ int CmdLFSniff(const char *Cmd) {
                   _CYAN_("it will try to use the real-time sampling mode."),
                   "lf sniff -v\n"
                   "lf sniff -s 3000 -@    --> oscilloscope style \n"
+                  "lf sniff -s 2000000 -d --> print reader frames while sniffing\n"
                  );
 
     void *argtable[] = {
@@ -964,12 +1068,14 @@ int CmdLFSniff(const char *Cmd) {
         arg_u64_0("s", "samples", "<dec>", "number of samples to collect"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0("@", NULL, "continuous sniffing mode"),
+        arg_lit0("d", "demod", "demodulate reader frames (field gaps) as samples arrive"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     uint64_t samples = arg_get_u64_def(ctx, 1, 0);
     bool verbose = arg_get_lit(ctx, 2);
     bool cm = arg_get_lit(ctx, 3);
+    bool demod = arg_get_lit(ctx, 4);
     CLIParserFree(ctx);
 
     // the 40000 there should be the result of BigBuf_max_traceLen(),
@@ -982,10 +1088,29 @@ int CmdLFSniff(const char *Cmd) {
     if (cm || realtime) {
         PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
     }
+    lf_stream_demod_t *d = NULL;
+    if (demod) {
+        d = calloc(1, sizeof(lf_stream_demod_t));
+        if (d == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return PM3_EMALLOC;
+        }
+        PrintAndLogEx(INFO, "    sample | cnt |  0  |  1  | bits");
+        PrintAndLogEx(INFO, "-----------+-----+-----+-----+----------------------------------------------------------------------");
+    }
+
     int ret = PM3_SUCCESS;
     do {
-        ret = lf_sniff(realtime, verbose, samples);
+        if (d != NULL) {
+            lf_stream_init(d, 0, lf_sniff_print_frame, NULL);
+        }
+        ret = lf_sniff_ex(realtime, verbose, samples, d);
+        if (d != NULL) {
+            lf_stream_flush(d);
+            PrintAndLogEx(INFO, "Found " _YELLOW_("%u") " frames in %" PRIu64 " samples", d->frames, d->pos);
+        }
     } while (cm && (kbd_enter_pressed() == false));
+    free(d);
     return ret;
 }
 
@@ -1001,15 +1126,34 @@ static void lf_chk_bitstream(void) {
 }
 
 // Uploads g_GraphBuffer to device, in order to be used for LF SIM.
+// The GraphBuffer goes up packed, one bit per sample msb first, and the device plays it as is.
+// Callers flag CMD_LF_SIMULATE as packed.
 int lfsim_upload_gb(void) {
-    PrintAndLogEx(DEBUG, "DEBUG: Uploading %zu bytes", g_GraphTraceLen);
+
+    size_t bytes = (g_GraphTraceLen + 7) / 8;
+    PrintAndLogEx(DEBUG, "DEBUG: Uploading %zu samples in %zu bytes", g_GraphTraceLen, bytes);
+
+    uint8_t *packed = calloc(bytes, sizeof(uint8_t));
+    if (packed == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    for (size_t i = 0; i < g_GraphTraceLen; i++) {
+        if ((uint8_t)g_GraphBuffer[i]) {
+            packed[i >> 3] |= (0x80 >> (i & 7));
+        }
+    }
 
     struct pupload {
         uint8_t flag;
         uint16_t offset;
-        uint8_t data[PM3_CMD_DATA_SIZE - 3];
+        uint8_t data[PM3_CMD_DATA_SIZE_JUMBO - 3];
     } PACKED payload_up;
 
+    // jumbo frames over USB-CDC, when the device supports them
+    size_t chunk = GetJumboPayloadSize() - 3;
+
     // flag =
     //    b0  0
     //        1 clear bigbuff
@@ -1019,22 +1163,21 @@ int lfsim_upload_gb(void) {
     g_conn.block_after_ACK = true;
 
     PacketResponseNG resp;
+    int res = PM3_SUCCESS;
 
-    //can send only 512 bits at a time (1 byte sent per bit...)
     PrintAndLogEx(INFO, "." NOLF);
-    for (size_t i = 0; i < g_GraphTraceLen; i += PM3_CMD_DATA_SIZE - 3) {
+    for (size_t i = 0; i < bytes; i += chunk) {
 
-        size_t len = MIN((g_GraphTraceLen - i), PM3_CMD_DATA_SIZE - 3);
+        size_t len = MIN((bytes - i), chunk);
         clearCommandBuffer();
         payload_up.offset = i;
+        memcpy(payload_up.data, packed + i, len);
 
-        for (size_t j = 0; j < len; j++)
-            payload_up.data[j] = g_GraphBuffer[i + j];
-
-        SendCommandNG(CMD_LF_UPLOAD_SIM_SAMPLES, (uint8_t *)&payload_up, sizeof(struct pupload));
+        SendCommandNG(CMD_LF_UPLOAD_SIM_SAMPLES, (uint8_t *)&payload_up, 3 + len);
         WaitForResponse(CMD_LF_UPLOAD_SIM_SAMPLES, &resp);
         if (resp.status != PM3_SUCCESS) {
             PrintAndLogEx(INFO, "Bigbuf is full");
+            res = PM3_EOVFLOW;
             break;
         }
         PrintAndLogEx(NORMAL, "." NOLF);
@@ -1045,7 +1188,8 @@ int lfsim_upload_gb(void) {
 
     // Disable fast mode before last command
     g_conn.block_after_ACK = false;
-    return PM3_SUCCESS;
+    free(packed);
+    return res;
 }
 
 //Attempt to simulate any wave in buffer (one bit per output sample)
@@ -1082,13 +1226,18 @@ int CmdLFSim(const char *Cmd) {
     // convert to bitstream if necessary
     lf_chk_bitstream();
 
-    lfsim_upload_gb();
+    int res = lfsim_upload_gb();
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
 
     struct p {
-        uint16_t len;
+        uint32_t len;
         uint16_t gap;
+        bool packed;
     } PACKED payload;
     payload.len = g_GraphTraceLen;
+    payload.packed = true;
     payload.gap = gap;
 
     clearCommandBuffer();
@@ -1687,6 +1836,347 @@ static int check_autocorrelate(const char *prefix, int clock) {
     return PM3_EFAILED;
 }
 
+// lf search -u, signal fingerprint.
+// One pass over the graphbuffer collecting the zero crossing period histogram
+// (carrier / FSK field clocks), the run length histogram (ASK / NRZ bit widths)
+// and the number of crossings off the carrier (PSK phase shifts).
+// It is used to pick the demodulator to try first on an unknown tag.
+typedef enum {
+    LF_FP_UNKNOWN = 0,
+    LF_FP_FSK,
+    LF_FP_ASK,
+    LF_FP_NRZ,
+    LF_FP_PSK,
+} lf_fp_mod_t;
+
+typedef struct {
+    lf_fp_mod_t mod;
+    uint16_t period1;   // dominant zero crossing period
+    uint16_t period2;   // second field clock (FSK)
+    uint16_t clock;     // bit clock guess, 0 if unknown
+    uint32_t edges;     // rising zero crossings
+    uint32_t shifts;    // crossings off the carrier period
+} lf_fingerprint_t;
+
+#define LF_FP_MAX_PERIOD    64
+#define LF_FP_MAX_RUN       512
+#define LF_FP_MIN_RUN       4
+#define LF_FP_MIN_EDGES     16
+
+static const char *lf_fp_mod_name(lf_fp_mod_t mod) {
+    switch (mod) {
+        case LF_FP_FSK:
+            return "FSK";
+        case LF_FP_ASK:
+            return "ASK";
+        case LF_FP_NRZ:
+            return "NRZ";
+        case LF_FP_PSK:
+            return "PSK";
+        case LF_FP_UNKNOWN:
+        default:
+            return "unknown";
+    }
+}
+
+// sum of histogram bins within +-width of idx
+static uint32_t lf_fp_cluster(const uint32_t *hist, int len, int idx, int width) {
+    uint32_t sum = 0;
+    for (int i = MAX(idx - width, 0); i <= MIN(idx + width, len - 1); i++) {
+        sum += hist[i];
+    }
+    return sum;
+}
+
+static int lf_fp_argmax(const uint32_t *hist, int from, int to, int skip, int skip_width) {
+    int best = 0;
+    for (int i = from; i < to; i++) {
+        if (skip && abs(i - skip) <= skip_width) {
+            continue;
+        }
+        if (hist[i] > hist[best]) {
+            best = i;
+        }
+    }
+    return (hist[best]) ? best : 0;
+}
+
+static void lf_fingerprint(const int *in, size_t len, lf_fingerprint_t *fp) {
+
+    memset(fp, 0, sizeof(lf_fingerprint_t));
+    if (len < 2) {
+        return;
+    }
+
+    int lo = in[0], hi = in[0];
+    int64_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += in[i];
+        lo = MIN(lo, in[i]);
+        hi = MAX(hi, in[i]);
+    }
+
+    int mean = (int)(sum / (int64_t)len);
+    // a little hysteresis so noise around the mean isn't counted as crossings
+    int hyst = (hi - lo) / 16;
+
+    uint32_t periods[LF_FP_MAX_PERIOD] = {0};
+    uint32_t runs[LF_FP_MAX_RUN] = {0};
+
+    bool high = (in[0] > mean);
+    size_t last_rise = 0, last_edge = 0;
+    bool have_rise = false;
+
+    for (size_t i = 1; i < len; i++) {
+
+        bool flip = (high) ? (in[i] < mean - hyst) : (in[i] > mean + hyst);
+        if (flip == false) {
+            continue;
+        }
+
+        high = !high;
+        runs[MIN(i - last_edge, LF_FP_MAX_RUN - 1)]++;
+        last_edge = i;
+
+        if (high) {
+            if (have_rise) {
+                periods[MIN(i - last_rise, LF_FP_MAX_PERIOD - 1)]++;
+                fp->edges++;
+            }
+            last_rise = i;
+            have_rise = true;
+        }
+    }
+
+    if (fp->edges < LF_FP_MIN_EDGES) {
+        return;
+    }
+
+    // carrier present?  Most of the trace covered by one short period
+    int p1 = lf_fp_argmax(periods, 2, LF_FP_MAX_PERIOD - 1, 0, 0);
+    uint32_t c1 = lf_fp_cluster(periods, LF_FP_MAX_PERIOD, p1, 1);
+
+    if (p1 && p1 <= 12 && (c1 * p1) >= (len / 2)) {
+
+        fp->period1 = p1;
+
+        // FSK, a second strong field clock
+        int p2 = lf_fp_argmax(periods, 2, LF_FP_MAX_PERIOD - 1, p1, 1);
+        uint32_t c2 = (p2) ? lf_fp_cluster(periods, LF_FP_MAX_PERIOD, p2, 1) : 0;
+        int pmin = MIN(p1, p2), pmax = MAX(p1, p2);
+        if (p2 && (c2 * 10 >= c1) && (pmax * 100 >= pmin * 115) && (pmax * 100 <= pmin * 220)) {
+            fp->period2 = p2;
+            fp->mod = LF_FP_FSK;
+            return;
+        }
+
+        // PSK, a steady carrier broken by phase shifts
+        fp->shifts = fp->edges - c1;
+        if (fp->shifts >= 4) {
+            fp->mod = LF_FP_PSK;
+        }
+        return;
+    }
+
+    // no carrier, look at the run lengths
+    int r1 = lf_fp_argmax(runs, LF_FP_MIN_RUN, LF_FP_MAX_RUN - 1, 0, 0);
+    if (r1 == 0) {
+        return;
+    }
+
+    // shortest cluster with a tenth of the dominant one is the base run length
+    uint32_t cr1 = lf_fp_cluster(runs, LF_FP_MAX_RUN, r1, r1 / 8);
+    int base = r1;
+    for (int i = LF_FP_MIN_RUN; i < r1 - r1 / 8; i++) {
+        if (lf_fp_cluster(runs, LF_FP_MAX_RUN, i, i / 8) * 10 >= cr1) {
+            base = lf_fp_argmax(runs, i, MIN(i + i / 4 + 1, r1), 0, 0);
+            break;
+        }
+    }
+
+    // Manchester / Biphase never holds a level for more than a full bit
+    uint32_t total = 0, longer = 0;
+    for (int i = LF_FP_MIN_RUN; i < LF_FP_MAX_RUN; i++) {
+        total += runs[i];
+        if (i * 2 > base * 5) {
+            longer += runs[i];
+        }
+    }
+
+    int clock = base;
+    if (longer * 20 < total) {
+        fp->mod = LF_FP_ASK;
+        clock *= 2;
+    } else {
+        fp->mod = LF_FP_NRZ;
+    }
+
+    // edges are seen a little late, snap to the nearest T55x7 bit rate
+    const uint8_t clocks[] = {8, 16, 32, 40, 50, 64, 100, 128};
+    fp->clock = clock;
+    for (size_t i = 0; i < ARRAYLEN(clocks); i++) {
+        if (abs(clock - clocks[i]) * 10 <= clocks[i]) {
+            fp->clock = clocks[i];
+            break;
+        }
+    }
+}
+
+static bool lf_search_unknown_fsk(void) {
+    PrintAndLogEx(INFO, "FSK clock.......... " NOLF);
+    int clock = GetFskClock("", false);
+    if (clock == 0) {
+        PrintAndLogEx(NORMAL, _RED_("no"));
+        return false;
+    }
+
+    PrintAndLogEx(NORMAL, _GREEN_("detected"));
+    if (FSKrawDemod(0, 0, 0, 0, true) != PM3_SUCCESS) {
+        PrintAndLogEx(INFO, "FSK demodulation... " _RED_("failed"));
+        return false;
+    }
+
+    check_autocorrelate("FSK", clock);
+    return true;
+}
+
+static bool lf_search_unknown_ask(void) {
+    PrintAndLogEx(INFO, "ASK clock.......... " NOLF);
+    int clock = GetAskClock("", false);
+    if (clock <= 8) {
+        PrintAndLogEx(NORMAL, _RED_("no"));
+        return false;
+    }
+
+    PrintAndLogEx(NORMAL, _GREEN_("detected"));
+    bool st = true;
+    if (ASKDemod_ext(0, 0, 0, 0, false, true, false, 1, &st) != PM3_SUCCESS) {
+        PrintAndLogEx(INFO, "ASK demodulation... " _RED_("failed"));
+        return false;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, _GREEN_("ASK") " modulation / Manchester encoding detected!");
+    PrintAndLogEx(INFO, "   could also be ASK/Biphase - try " _YELLOW_("'data rawdemod --ab'"));
+    check_autocorrelate("ASK", clock);
+    return true;
+}
+
+static bool lf_search_unknown_nrz(void) {
+    PrintAndLogEx(INFO, "NRZ clock.......... " NOLF);
+    int clock = GetNrzClock("", false);
+    if (clock <= 8) {
+        PrintAndLogEx(NORMAL, _RED_("no"));
+        return false;
+    }
+
+    PrintAndLogEx(NORMAL, _GREEN_("detected"));
+    if (NRZrawDemod(0, 0, 0, true) != PM3_SUCCESS) {
+        PrintAndLogEx(INFO, "NRZ demodulation... " _RED_("failed"));
+        return false;
+    }
+
+    // if demodulated binary is only 1,  skip autocorrect
+    bool all_ones = true;
+    for (size_t i = 0; i < MIN(g_DemodBufferLen, 96); i++) {
+        if (g_DemodBuffer[i] != 1) {
+            all_ones = false;
+            break;
+        }
+    }
+
+    if (all_ones) {
+        PrintAndLogEx(INFO, "NRZ ............... " _RED_("false positive"));
+        PrintAndLogEx(NORMAL, "");
+        return false;
+    }
+
+    check_autocorrelate("NRZ", clock);
+    return true;
+}
+
+static bool lf_search_unknown_psk(void) {
+    PrintAndLogEx(INFO, "PSK clock.......... " NOLF);
+    int clock = GetPskClock("", false);
+    if (clock == 0) {
+        PrintAndLogEx(NORMAL, _RED_("no"));
+        return false;
+    }
+
+    PrintAndLogEx(NORMAL, _GREEN_("detected"));
+    if (CmdPSK1rawDemod("") != PM3_SUCCESS) {
+        PrintAndLogEx(INFO, "PSK demodulation... " _RED_("failed"));
+        return false;
+    }
+
+    PrintAndLogEx(INFO, "Possible " _GREEN_("PSK1") " modulation detected!");
+    PrintAndLogEx(INFO, "    Could also be PSK2 - try " _YELLOW_("'data rawdemod --p2'"));
+    PrintAndLogEx(INFO, "    Could also be PSK3 - [currently not supported]");
+    PrintAndLogEx(INFO, "    Could also be  NRZ - try " _YELLOW_("'data rawdemod --nr"));
+    check_autocorrelate("PSK", clock);
+    return true;
+}
+
+typedef struct {
+    lf_fp_mod_t mod;
+    bool (*search)(void);
+} lf_search_unknown_t;
+
+// raw demods tried on an unknown tag, in this order
+static const lf_search_unknown_t lf_search_unknowns[] = {
+    {LF_FP_FSK, lf_search_unknown_fsk},
+    {LF_FP_ASK, lf_search_unknown_ask},
+    {LF_FP_NRZ, lf_search_unknown_nrz},
+    {LF_FP_PSK, lf_search_unknown_psk},
+};
+
+static int demod_paradox(bool verbose) {
+    return demodParadox(verbose, false);
+}
+
+static int demod_idteck(bool verbose) {
+    return demodIdteck(NULL, verbose);
+}
+
+typedef struct {
+    const char *name;
+    int (*demod)(bool verbose);
+} lf_search_demod_t;
+
+// known tags tried on the graphbuffer by lf search, in this order.
+// grouped by modulation, FDX-A Destron has to go before HID
+static const lf_search_demod_t lf_search_demods[] = {
+    // ask / man
+    {"EM410x ID",               demodEM410x},
+    {"FDX-A FECAVA Destron ID", demodDestron},
+    {"GALLAGHER ID",            demodGallagher},
+    {"Noralsy ID",              demodNoralsy},
+    {"Presco ID",               demodPresco},
+    {"Securakey ID",            demodSecurakey},
+    {"Viking ID",               demodViking},
+    {"Visa2000 ID",             demodVisa2k},
+    // ask / bi
+    {"FDX-B ID",                demodFDXB},
+    {"Jablotron ID",            demodJablotron},
+    {"Guardall G-Prox II ID",   demodGuard},
+    {"NEDAP ID",                demodNedap},
+    // nrz
+    {"PAC/Stanley ID",          demodPac},
+    // fsk
+    {"HID Prox ID",             demodHID},
+    {"AWID ID",                 demodAWID},
+    {"IO Prox ID",              demodIOProx},
+    {"Pyramid ID",              demodPyramid},
+    {"Paradox ID",              demod_paradox},
+    // psk
+    {"Idteck ID",               demod_idteck},
+    {"KERI ID",                 demodKeri},
+    {"NexWatch ID",             demodNexWatch},
+    {"Indala ID",               demodIndala},
+    // {"Texas Instrument ID",  demodTI},
+    // {"Fermax ID",            demodFermax},
+};
+
 int CmdLFfind(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1795,209 +2285,17 @@ int CmdLFfind(const char *Cmd) {
         }
     }
 
-    // ask / man
-    if (demodEM410x(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("EM410x ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodDestron(true) == PM3_SUCCESS) { // to do before HID
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("FDX-A FECAVA Destron ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodGallagher(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("GALLAGHER ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodNoralsy(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Noralsy ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodPresco(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Presco ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodSecurakey(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Securakey ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodViking(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Viking ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodVisa2k(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Visa2000 ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-
-    // ask / bi
-    if (demodFDXB(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("FDX-B ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodJablotron(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Jablotron ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodGuard(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Guardall G-Prox II ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodNedap(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NEDAP ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-
-    // nrz
-    if (demodPac(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("PAC/Stanley ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-
-    // fsk
-    if (demodHID(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("HID Prox ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodAWID(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("AWID ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodIOProx(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("IO Prox ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodPyramid(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Pyramid ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodParadox(true, false) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Paradox ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
+    for (size_t i = 0; i < ARRAYLEN(lf_search_demods); i++) {
+        if (lf_search_demods[i].demod(true) == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("%s") " found!", lf_search_demods[i].name);
+            if (search_cont) {
+                found++;
+            } else {
+                goto out;
+            }
         }
     }
 
-    // psk
-    if (demodIdteck(NULL, true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Idteck ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodKeri(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("KERI ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodNexWatch(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NexWatch ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodIndala(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Indala ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    /*
-    if (demodTI() == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Texas Instrument ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodFermax() == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Fermax ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    */
     if (found == 0) {
         PrintAndLogEx(FAILED, _RED_("No known 125/134 kHz tags found!"));
     }
@@ -2007,91 +2305,44 @@ int CmdLFfind(const char *Cmd) {
         // test unknown tag formats (raw mode)
         PrintAndLogEx(INFO, _CYAN_("Checking for unknown tags...") "\n");
 
-        uint8_t ones[] = {
-            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        };
-
-        // FSK
-        PrintAndLogEx(INFO, "FSK clock.......... " NOLF);
-        int clock = GetFskClock("", false);
-        if (clock) {
-            PrintAndLogEx(NORMAL, _GREEN_("detected"));
-            if (FSKrawDemod(0, 0, 0, 0, true) == PM3_SUCCESS) {
-                check_autocorrelate("FSK", clock);
-                found++;
-            } else {
-                PrintAndLogEx(INFO, "FSK demodulation... " _RED_("failed"));
-            }
-        } else {
-            PrintAndLogEx(NORMAL, _RED_("no"));
+        lf_fingerprint_t fp;
+        lf_fingerprint(g_GraphBuffer, g_GraphTraceLen, &fp);
+        switch (fp.mod) {
+            case LF_FP_FSK:
+                PrintAndLogEx(INFO, "Fingerprint........ " _GREEN_("FSK") " fc/%u fc/%u", MIN(fp.period1, fp.period2), MAX(fp.period1, fp.period2));
+                break;
+            case LF_FP_PSK:
+                PrintAndLogEx(INFO, "Fingerprint........ " _GREEN_("PSK") " fc/%u, %u phase shifts", fp.period1, fp.shifts);
+                break;
+            case LF_FP_ASK:
+            case LF_FP_NRZ:
+                PrintAndLogEx(INFO, "Fingerprint........ " _GREEN_("%s") " clock ~%u", lf_fp_mod_name(fp.mod), fp.clock);
+                break;
+            case LF_FP_UNKNOWN:
+            default:
+                PrintAndLogEx(INFO, "Fingerprint........ " _YELLOW_("unknown"));
+                break;
         }
 
-        // ASK
-        PrintAndLogEx(INFO, "ASK clock.......... " NOLF);
-        clock = GetAskClock("", false);
-        if (clock && clock > 8) {
-            PrintAndLogEx(NORMAL, _GREEN_("detected"));
-            bool st = true;
-            if (ASKDemod_ext(0, 0, 0, 0, false, true, false, 1, &st) == PM3_SUCCESS) {
-                PrintAndLogEx(NORMAL, "");
-                PrintAndLogEx(INFO, _GREEN_("ASK") " modulation / Manchester encoding detected!");
-                PrintAndLogEx(INFO, "   could also be ASK/Biphase - try " _YELLOW_("'data rawdemod --ab'"));
-                check_autocorrelate("ASK", clock);
-                found++;
-            } else {
-                PrintAndLogEx(INFO, "ASK demodulation... " _RED_("failed"));
+        // only the fingerprinted modulation is demodulated, unless it fails
+        // or we were asked to continue searching
+        int unk_found = 0;
+        for (size_t i = 0; i < ARRAYLEN(lf_search_unknowns); i++) {
+            if (lf_search_unknowns[i].mod == fp.mod && lf_search_unknowns[i].search()) {
+                unk_found++;
             }
-        } else {
-            PrintAndLogEx(NORMAL, _RED_("no"));
         }
 
-        // NZR
-        PrintAndLogEx(INFO, "NRZ clock.......... " NOLF);
-        clock = GetNrzClock("", false);
-        if (clock && clock > 8) {
-            PrintAndLogEx(NORMAL, _GREEN_("detected"));
-            if (NRZrawDemod(0, 0, 0, true) == PM3_SUCCESS) {
-
-                int min = MIN(g_DemodBufferLen, sizeof(ones));
-                // if demodulated binary is only 1,  skip autocorrect
-                if (memcmp(g_DemodBuffer, ones, min) != 0) {
-                    check_autocorrelate("NRZ", clock);
-                    found++;
-                } else {
-                    PrintAndLogEx(INFO, "NRZ ............... " _RED_("false positive"));
-                    PrintAndLogEx(NORMAL, "");
+        if (unk_found == 0 || search_cont) {
+            for (size_t i = 0; i < ARRAYLEN(lf_search_unknowns); i++) {
+                if (lf_search_unknowns[i].mod != fp.mod && lf_search_unknowns[i].search()) {
+                    unk_found++;
                 }
-            } else {
-                PrintAndLogEx(INFO, "NRZ demodulation... " _RED_("failed"));
             }
-        } else {
-            PrintAndLogEx(NORMAL, _RED_("no"));
-        }
-
-        // PSK
-        PrintAndLogEx(INFO, "PSK clock.......... " NOLF);
-        clock = GetPskClock("", false);
-        if (clock) {
-            PrintAndLogEx(NORMAL, _GREEN_("detected"));
-            if (CmdPSK1rawDemod("") == PM3_SUCCESS) {
-                PrintAndLogEx(INFO, "Possible " _GREEN_("PSK1") " modulation detected!");
-                PrintAndLogEx(INFO, "    Could also be PSK2 - try " _YELLOW_("'data rawdemod --p2'"));
-                PrintAndLogEx(INFO, "    Could also be PSK3 - [currently not supported]");
-                PrintAndLogEx(INFO, "    Could also be  NRZ - try " _YELLOW_("'data rawdemod --nr"));
-                check_autocorrelate("PSK", clock);
-                found++;
-            } else {
-                PrintAndLogEx(INFO, "PSK demodulation... " _RED_("failed"));
-            }
-        } else {
-            PrintAndLogEx(NORMAL, _RED_("no"));
         }
 
+        found += unk_found;
+
         if (found == 0) {
             PrintAndLogEx(FAILED, _RED_("Failed to demodulated signal"));
         }
@@ -2109,6 +2360,126 @@ out:
     return retval;
 }
 
+static void lf_watch_print(const lf_watch_entry_t *e) {
+
+    char ts[16];
+    snprintf(ts, sizeof(ts), "%7u.%01u", e->ms / 1000, (e->ms % 1000) / 100);
+
+    switch (e->protocol) {
+        case LF_WATCH_HID: {
+            wiegand_message_t packed = initialize_message_object(e->raw[0], e->raw[1], e->raw[2], 0);
+            wiegand_match_t matches[8];
+            int n = HIDTryUnpackEx(&packed, matches, ARRAYLEN(matches));
+            for (int i = 0; i < n; i++) {
+                if (HIDMatchValid(&matches[i])) {
+                    cardformat_t fmt = HIDGetCardFormat(matches[i].idx);
+                    PrintAndLogEx(SUCCESS, "%s | HID    | " _GREEN_("%X%08X%08X") " [%s] FC: " _GREEN_("%u") " CN: " _GREEN_("%" PRIu64)
+                                  , ts, e->raw[0], e->raw[1], e->raw[2], fmt.Name, matches[i].card.FacilityCode, matches[i].card.CardNumber);
+                    return;
+                }
+            }
+            PrintAndLogEx(SUCCESS, "%s | HID    | " _GREEN_("%X%08X%08X") " %u bit FC: %u CN: %u", ts, e->raw[0], e->raw[1], e->raw[2], e->type, e->fc, e->cn);
+            break;
+        }
+        case LF_WATCH_AWID: {
+            PrintAndLogEx(SUCCESS, "%s | AWID   | " _GREEN_("%08X%08X%08X") " %u bit FC: " _GREEN_("%u") " CN: " _GREEN_("%u"), ts, e->raw[0], e->raw[1], e->raw[2], e->type, e->fc, e->cn);
+            break;
+        }
+        case LF_WATCH_EM410X: {
+            uint64_t lo = ((uint64_t)e->raw[1] << 32) | e->raw[2];
+            if (e->type & 0x4) {
+                // 128b frame, back to the short ID
+                lo = ((uint64_t)e->raw[0] << 16) | (lo >> 48);
+            }
+            PrintAndLogEx(SUCCESS, "%s | EM410x | " _GREEN_("%010" PRIX64) " ( %05u_%03u_%08u )"
+                          , ts
+                          , lo
+                          , (uint32_t)(lo & 0xFFFF)
+                          , (uint32_t)((lo >> 16) & 0xFF)
+                          , (uint32_t)(lo & 0xFFFFFF)
+                         );
+            break;
+        }
+        case LF_WATCH_IO: {
+            PrintAndLogEx(SUCCESS, "%s | IO     | " _GREEN_("%08X%08X") " XSF(%02u)%02x:%05u", ts, e->raw[1], e->raw[2], e->type, e->fc, e->cn);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static int CmdLFWatch(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "lf watch",
+                  "Watch for HID, AWID, EM410x and IO Prox tags at the same time.\n"
+                  "The device samples once per cycle, runs every selected demodulator over the samples\n"
+                  "and reports each ID once, with the time it was first seen.",
+                  "lf watch                 -> all protocols\n"
+                  "lf watch --hid --em      -> HID and EM410x only\n"
+                  "lf watch --holdoff 5000  -> report an ID again after 5 s without it"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "hid", "HID Prox"),
+        arg_lit0(NULL, "awid", "AWID"),
+        arg_lit0(NULL, "em", "EM410x"),
+        arg_lit0(NULL, "io", "IO Prox"),
+        arg_u64_0(NULL, "holdoff", "<ms>", "ms without an ID before it is reported again (def 1000)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    lf_watch_t payload = {
+        .protocols = (arg_get_lit(ctx, 1) ? LF_WATCH_HID : 0) |
+        (arg_get_lit(ctx, 2) ? LF_WATCH_AWID : 0) |
+        (arg_get_lit(ctx, 3) ? LF_WATCH_EM410X : 0) |
+        (arg_get_lit(ctx, 4) ? LF_WATCH_IO : 0),
+        .holdoff = MIN(arg_get_u32_def(ctx, 5, 1000), 0xFFFF),
+    };
+    CLIParserFree(ctx);
+
+    if (payload.protocols == 0) {
+        payload.protocols = LF_WATCH_ALL;
+    }
+
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to exit");
+    PrintAndLogEx(INFO, "");
+    PrintAndLogEx(INFO, "     time | type   | id");
+    PrintAndLogEx(INFO, "----------+--------+----------------------------------------------");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_WATCH, (uint8_t *)&payload, sizeof(payload));
+
+    uint32_t count = 0;
+    bool aborted = false;
+    PacketResponseNG resp;
+    for (;;) {
+
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_LF_WATCH, &resp, 1000) == false) {
+            continue;
+        }
+
+        // the last reply carries no tag
+        if (resp.length != sizeof(lf_watch_entry_t)) {
+            break;
+        }
+
+        count++;
+        lf_watch_print((const lf_watch_entry_t *)resp.data.asBytes);
+    }
+
+    PrintAndLogEx(INFO, "----------+--------+----------------------------------------------");
+    PrintAndLogEx(SUCCESS, "Read " _YELLOW_("%u") " tags", count);
+    return (resp.status == PM3_EOPABORTED) ? PM3_SUCCESS : resp.status;
+}
+
 static command_t CommandTable[] = {
     {"help",        CmdHelp,            AlwaysAvailable, "This help"},
     {"-----------", CmdHelp,            AlwaysAvailable, "-------------- " _CYAN_("Low Frequency") " --------------"},
@@ -2154,6 +2525,7 @@ static command_t CommandTable[] = {
     {"simbidir",    CmdLFSimBidir,      IfPm3Lf,         "Simulate LF tag (with bidirectional data transmission between reader and tag)"},
     {"sniff",       CmdLFSniff,         IfPm3Lf,         "Sniff LF traffic between reader and tag"},
     {"tune",        CmdLFTune,          IfPm3Lf,         "Continuously measure LF antenna tuning"},
+    {"watch",       CmdLFWatch,         IfPm3Lf,         "Watch for HID, AWID, EM410x and IO Prox tags at once"},
 //    {"vchdemod",    CmdVchDemod,        AlwaysAvailable, "Demodulate samples for VeriChip"},
 //    {"flexdemod",   CmdFlexdemod,       AlwaysAvailable, "Demodulate samples for Motorola FlexPass"},
     {NULL, NULL, NULL, NULL}
@@ -21,6 +21,7 @@
 
 #include "common.h"
 #include "pm3_cmd.h" // sample_config_t
+#include "lfstream.h" // lf_stream_demod_t
 
 #define T55XX_WRITE_TIMEOUT 1500
 
@@ -42,6 +43,7 @@ int CmdLFfind(const char *Cmd);
 
 int lf_read(bool verbose, uint64_t samples);
 int lf_sniff(bool realtime, bool verbose, uint64_t samples);
+int lf_sniff_ex(bool realtime, bool verbose, uint64_t samples, lf_stream_demod_t *demod);
 int lf_setconfig(sample_config *config);
 int lf_getconfig(sample_config *config);
 int lf_resetconfig(sample_config *config);
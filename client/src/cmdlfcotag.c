@@ -121,13 +121,14 @@ static int CmdCOTAGReader(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf cotag reader",
                   "read a COTAG tag,  the current support for COTAG is limited. ",
-                  "lf cotag reader -2"
+                  "lf cotag reader\n"
+                  "lf cotag reader -3      -> raw signal, to plot"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("1", NULL, "HIGH/LOW signal; maxlength bigbuff"),
-        arg_lit0("2", NULL, "translation of HIGH/LOW into bytes with manchester 0,1"),
+        arg_lit0("2", NULL, "translation of HIGH/LOW into bytes with manchester 0,1 (default)"),
         arg_lit0("3", NULL, "raw signal; maxlength bigbuff"),
         arg_param_end
     };
@@ -142,7 +143,8 @@ static int CmdCOTAGReader(const char *Cmd) {
         PrintAndLogEx(ERR, "You can only use one option at a time");
         return PM3_EINVARG;
     }
-    uint8_t mode = 0xFF;
+    // the device decodes the manchester half bits by default, only those are transferred
+    uint8_t mode = 1;
     if (mode0)
         mode = 0;
     if (mode1)
@@ -40,6 +40,7 @@
 #include "cliparser.h"
 #include "cmdhw.h"
 #include "hitag.h"
+#include "cmdlft55xx.h"   // clone_t55xx_tag
 
 static uint64_t gs_em410xid = 0;
 
@@ -110,6 +111,16 @@ void printEM410x(uint32_t hi, uint64_t id, bool verbose, int type) {
 
     if (!id && !hi) return;
 
+    char id_str[24] = {0};
+    if (type & 0x2) {
+        snprintf(id_str, sizeof(id_str), "%06X%016" PRIX64, hi, id);
+    } else if (type & 0x4) {
+        snprintf(id_str, sizeof(id_str), "%010" PRIX64, ((uint64_t)hi << 16) | (id >> 48));
+    } else {
+        snprintf(id_str, sizeof(id_str), "%010" PRIX64, id);
+    }
+    result_add_str("em410x", id_str);
+
     if (verbose == false) {
         if (type & 0x1) { // Short ID
             PrintAndLogEx(SUCCESS, "EM 410x ID "_GREEN_("%010" PRIX64), id);
@@ -577,10 +588,12 @@ static int CmdEM410xBrute(const char *Cmd) {
         lfsim_upload_gb();
 
         struct p {
-            uint16_t len;
+            uint32_t len;
             uint16_t gap;
+            bool packed;
         } PACKED payload;
         payload.len = g_GraphTraceLen;
+        payload.packed = true;
         payload.gap = 0;
 
         clearCommandBuffer();
@@ -701,6 +714,20 @@ static int CmdEM410xClone(const char *Cmd) {
 
     PrintAndLogEx(INFO, "Encoded to %s", sprint_hex(data, sizeof(data)));
 
+    // in a clone queue, the T55x7 blocks copy_em410x_to_t55xx() writes
+    if (t55xx_clone_capturing() && (q5 || em || hts || htu) == false) {
+        uint32_t clockbits = (clk == 16) ? T55x7_BITRATE_RF_16 : (clk == 32) ? T55x7_BITRATE_RF_32 : (clk == 40) ? T55x7_BITRATE_RF_40 : T55x7_BITRATE_RF_64;
+        uint8_t n = (add_electra) ? 4 : 2;
+        uint32_t blocks[5] = {
+            clockbits | T55x7_MODULATION_MANCHESTER | (n << T55x7_MAXBLOCK_SHIFT),
+            bytes_to_num(data, 4),
+            bytes_to_num(data + 4, 4),
+            0x7E1EAAAA,
+            0xAAAAAAAA
+        };
+        return clone_t55xx_tag(blocks, n + 1);
+    }
+
     clearCommandBuffer();
     PacketResponseNG resp;
 
@@ -42,6 +42,7 @@
 #include "cliparser.h"
 #include "cmdhw.h"
 #include "util.h"
+#include "bruteforce.h"
 
 //////////////// 4205 / 4305 commands
 
@@ -1796,21 +1797,82 @@ int CmdEM4x05Chk(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Runs one CMD_LF_EM4X_BF and prints the candidates it streams. 'reply' ends up
+// holding where the search stands, 'tried' and 'candidates' are from earlier runs.
+static int em4x05_brute_run(const em4x05_brute_t *payload, em4x05_brute_reply_t *reply, uint32_t tried, uint32_t candidates) {
+
+    memset(reply, 0, sizeof(em4x05_brute_reply_t));
+    reply->password = payload->start;
+    reply->word = payload->word;
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_EM4X_BF, (uint8_t *)payload, sizeof(em4x05_brute_t));
+
+    PacketResponseNG resp;
+    uint8_t timeout = 0;
+    for (;;) {
+        if (kbd_enter_pressed()) {
+            // the device stops and answers with where it was
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+        }
+
+        if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 1000) == false) {
+            if (++timeout > 10) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(WARNING, "No response from Proxmark3. Aborting...");
+                return PM3_ETIMEOUT;
+            }
+            continue;
+        }
+
+        if (resp.cmd != CMD_LF_EM4X_BF_PROGRESS && resp.cmd != CMD_LF_EM4X_BF) {
+            continue;
+        }
+
+        timeout = 0;
+        memcpy(reply, resp.data.asBytes, sizeof(em4x05_brute_reply_t));
+
+        if (resp.cmd == CMD_LF_EM4X_BF) {
+            PrintAndLogEx(NORMAL, "");
+            return resp.status;
+        }
+
+        if (reply->found) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(SUCCESS, "Password candidate [ " _GREEN_("%08X") " ]", reply->password);
+            continue;
+        }
+
+        PrintAndLogEx(INPLACE, "Trying password " _YELLOW_("%08X") " ( %u tried, %u candidates )"
+                      , reply->password
+                      , tried + reply->tried
+                      , candidates + reply->candidates
+                     );
+    }
+}
+
 int CmdEM4x05Brute(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf em 4x05 brute",
                   "This command tries to bruteforce the password of a EM4205/4305/4469/4569\n"
-                  "The loop is running on device side,  press Proxmark3 button to abort\n",
-                  "Note: if you get many false positives, change position on the antenna"
+                  "The loop is running on device side, press Proxmark3 button or <Enter> to abort.\n"
+                  "With a dictionary, every word is tried with all combinations of the mask bits.\n",
+                  "Note: if you get many false positives, change position on the antenna\n"
                   "lf em 4x05 brute\n"
-                  "lf em 4x05 brute -n 1            -> stop after first candidate found\n"
-                  "lf em 4x05 brute -s 000022AA     -> start at 000022AA"
+                  "lf em 4x05 brute -n 1                        -> stop after first candidate found\n"
+                  "lf em 4x05 brute -s 000022AA                 -> start at 000022AA\n"
+                  "lf em 4x05 brute -s 00002200 -e 000022FF     -> only try this range\n"
+                  "lf em 4x05 brute -f t55xx_default_pwds --mask 000000FF  -> dictionary words, any last byte"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_str0("s", "start", "<hex>", "Start bruteforce enumeration from this password value"),
         arg_u64_0("n", NULL, "<dec>", "Stop after having found n candidates. Default: 0 (infinite)"),
+        arg_str0("e", "end", "<hex>", "End bruteforce enumeration at this password value. Default: FFFFFFFF"),
+        arg_str0("f", "file", "<fn>", "Dictionary file with the passwords to start from"),
+        arg_str0(NULL, "mask", "<hex>", "Password bits to vary for every dictionary word"),
+        arg_u64_0(NULL, "skip", "<dec>", "Skip this many dictionary words, to resume"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1823,27 +1885,135 @@ int CmdEM4x05Brute(const char *Cmd) {
     }
 
     uint32_t n = arg_get_u32_def(ctx, 2, 0);
+
+    uint32_t end_pwd = 0;
+    res = arg_get_u32_hexstr_def(ctx, 3, 0xFFFFFFFF, &end_pwd);
+    if (res != 1) {
+        CLIParserFree(ctx);
+        PrintAndLogEx(WARNING, "check `end` parameter");
+        return PM3_EINVARG;
+    }
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    uint32_t mask = 0;
+    res = arg_get_u32_hexstr_def(ctx, 5, 0, &mask);
+    if (res != 1) {
+        CLIParserFree(ctx);
+        PrintAndLogEx(WARNING, "check `mask` parameter");
+        return PM3_EINVARG;
+    }
+
+    uint32_t skip = arg_get_u32_def(ctx, 6, 0);
     CLIParserFree(ctx);
 
+    if (start_pwd > end_pwd) {
+        PrintAndLogEx(WARNING, "start password must not be above the end password");
+        return PM3_EINVARG;
+    }
+
+    em4x05_brute_t payload = {
+        .mode = BF_MODE_RANGE,
+        .start = start_pwd,
+        .end = end_pwd,
+        .mask = mask,
+    };
+
+    uint8_t *keyblock = NULL;
+    uint32_t keycount = 0;
+    if (fnlen) {
+        res = loadFileDICTIONARY_safe(filename, (void **) &keyblock, 4, &keycount);
+        if (res != PM3_SUCCESS || keycount == 0 || keyblock == NULL) {
+            PrintAndLogEx(WARNING, "no keys found in file");
+            free(keyblock);
+            return PM3_ESOFT;
+        }
+        if (skip >= keycount) {
+            PrintAndLogEx(WARNING, "nothing left after skipping %u of %u words", skip, keycount);
+            free(keyblock);
+            return PM3_EINVARG;
+        }
+        payload.mode = BF_MODE_MASK;
+        PrintAndLogEx(INFO, "Trying " _YELLOW_("%u") " words with " _YELLOW_("%u") " variations each"
+                      , keycount - skip
+                      , 1U << __builtin_popcount(mask)
+                     );
+    }
+
     PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "Bruteforce is running on device side, press button or " _GREEN_("<Enter>") " to interrupt");
 
-    struct {
-        uint32_t start_pwd;
-        uint32_t n;
-    } PACKED payload;
+    uint64_t t1 = msclock();
+    uint32_t tried = 0;
+    uint32_t candidates = 0;
+    em4x05_brute_reply_t reply;
 
-    payload.start_pwd = start_pwd;
-    payload.n = n;
+    // the dictionary goes in chunks, the device keeps the tuned guard time between them
+    for (uint32_t base = skip; ; base += EM4X05_BRUTE_MAX_WORDS) {
 
-    clearCommandBuffer();
-    SendCommandNG(CMD_LF_EM4X_BF, (uint8_t *)&payload, sizeof(payload));
-    PacketResponseNG resp;
-    if (WaitForResponseTimeout(CMD_LF_EM4X_BF, &resp, 1000) == false) {
-        PrintAndLogEx(WARNING, "(EM4x05 Bruteforce) timeout while waiting for reply");
-        return PM3_ETIMEOUT;
+        if (payload.mode == BF_MODE_MASK) {
+            if (base >= keycount) {
+                break;
+            }
+            payload.word = 0;
+            payload.count = MIN(EM4X05_BRUTE_MAX_WORDS, keycount - base);
+            for (uint8_t i = 0; i < payload.count; i++) {
+                payload.words[i] = bytes_to_num(keyblock + (4 * (base + i)), 4);
+            }
+        }
+
+        if (n) {
+            payload.n = n - candidates;
+        }
+
+        res = em4x05_brute_run(&payload, &reply, tried, candidates);
+        tried += reply.tried;
+        candidates += reply.candidates;
+        payload.guard_us = reply.guard_us;
+
+        if (res != PM3_SUCCESS) {
+            if (res == PM3_EOPABORTED) {
+                PrintAndLogEx(INFO, "Aborted");
+            } else if (res != PM3_ETIMEOUT) {
+                PrintAndLogEx(WARNING, "Bruteforce failed ( %d )", res);
+            }
+
+            if (payload.mode == BF_MODE_MASK) {
+                PrintAndLogEx(INFO, "Resume with " _YELLOW_("--skip %u"), base + reply.word);
+            } else {
+                PrintAndLogEx(INFO, "Resume with " _YELLOW_("-s %08X"), reply.password);
+            }
+            break;
+        }
+
+        // stopped at the n:th candidate
+        if (reply.found) {
+            PrintAndLogEx(SUCCESS, "Password candidate [ " _GREEN_("%08X") " ]", reply.password);
+            if (payload.mode == BF_MODE_MASK) {
+                PrintAndLogEx(INFO, "Continue with " _YELLOW_("--skip %u"), base + reply.word);
+            } else if (reply.password != end_pwd) {
+                PrintAndLogEx(INFO, "Continue with " _YELLOW_("-s %08X"), reply.password + 1);
+            }
+            break;
+        }
+
+        if (payload.mode != BF_MODE_MASK) {
+            break;
+        }
     }
-    PrintAndLogEx(INFO, "Bruteforce is running on device side, press button to interrupt");
-    return PM3_SUCCESS;
+
+    free(keyblock);
+
+    t1 = msclock() - t1;
+    PrintAndLogEx(SUCCESS, "Tried " _YELLOW_("%u") " passwords, " _YELLOW_("%u") " candidates, %u us guard, in " _YELLOW_("%.0f") " seconds"
+                  , tried
+                  , candidates
+                  , reply.guard_us
+                  , (float)t1 / 1000.0
+                 );
+    return res;
 }
 
 static int unlock_write_protect(bool use_pwd, uint32_t pwd, uint32_t data, bool verbose) {
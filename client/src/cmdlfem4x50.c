@@ -445,36 +445,37 @@ static int CmdEM4x50Brute(const char *Cmd) {
 
     // 27 passwords/second (empirical value)
     const int speed = 27;
-    int no_iter = 0;
+
+    // same generator setup as the device, see brute() in armsrc/em4x50.c
+    generator_context_t gen;
+    bf_generator_init(&gen, etd.bruteforce_mode, BF_KEY_SIZE_32);
+    if (etd.bruteforce_mode == BF_MODE_CHARSET) {
+        bf_generator_set_charset(&gen, etd.bruteforce_charset);
+    } else if (etd.bruteforce_mode == BF_MODE_RANGE) {
+        gen.range_low = etd.password1;
+        gen.range_high = etd.password2;
+    }
+    uint64_t no_iter = bf_generator_count(&gen);
 
     if (etd.bruteforce_mode == BF_MODE_RANGE) {
-        no_iter = etd.password2 - etd.password1 + 1;
-        PrintAndLogEx(INFO, "Trying " _YELLOW_("%i") " passwords in range [0x%08x, 0x%08x]"
+        PrintAndLogEx(INFO, "Trying " _YELLOW_("%" PRIu64) " passwords in range [0x%08x, 0x%08x]"
                       , no_iter
                       , etd.password1
                       , etd.password2
                      );
-    } else if (etd.bruteforce_mode == BF_MODE_CHARSET) {
-        unsigned int digits = 0;
-
-        if (etd.bruteforce_charset & BF_CHARSET_DIGITS)
-            digits += BF_CHARSET_DIGITS_SIZE;
-
-        if (etd.bruteforce_charset & BF_CHARSET_UPPERCASE)
-            digits += BF_CHARSET_UPPERCASE_SIZE;
-
-        no_iter = pow(digits, 4);
+    } else {
+        PrintAndLogEx(INFO, "Trying " _YELLOW_("%" PRIu64) " passwords", no_iter);
     }
 
     // print some information
-    int dur_s = no_iter / speed;
-    int dur_h = dur_s / 3600;
-    int dur_m = (dur_s - dur_h * 3600) / 60;
+    uint64_t dur_s = no_iter / speed;
+    uint64_t dur_h = dur_s / 3600;
+    uint64_t dur_m = (dur_s - dur_h * 3600) / 60;
 
     dur_s -= dur_h * 3600 + dur_m * 60;
 
     if (no_iter > 0)
-        PrintAndLogEx(INFO, "Estimated duration: %ih %im %is", dur_h, dur_m, dur_s);
+        PrintAndLogEx(INFO, "Estimated duration: %" PRIu64 "h %" PRIu64 "m %" PRIu64 "s", dur_h, dur_m, dur_s);
     else
         PrintAndLogEx(INFO, "Estimated duration: unknown");
 
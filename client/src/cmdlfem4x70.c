@@ -18,6 +18,7 @@
 
 #include "cmdlfem4x70.h"
 #include <ctype.h>
+#include <pthread.h>
 #include "cmdparser.h"    // command_t
 #include "cliparser.h"
 #include "fileutils.h"
@@ -26,6 +27,7 @@
 #include "id48.h"
 #include "time.h"
 #include "util_posix.h" // msleep()
+#include "hardnested_pool.h" // hn_pool_run()
 
 #define LOCKBIT_0 BITMASK(6)
 #define LOCKBIT_1 BITMASK(7)
@@ -112,6 +114,11 @@ typedef struct _em4x70_cmd_output_brute_t {
     ///     partial_key[14] == Key₅₅..Key₄₈ == Block  7 LSB
     /// </summary>
     uint8_t partial_key[2];
+    /// <summary>
+    /// When the search did not complete: all keys below this one were tried,
+    /// resume from it with `--start`.  Big endian, like partial_key.
+    /// </summary>
+    uint8_t next_key[2];
 } em4x70_cmd_output_brute_t;
 
 typedef struct _em4x70_cmd_input_unlock_t {
@@ -314,6 +321,9 @@ static int brute_em4x70(const em4x70_cmd_input_brute_t *opts, em4x70_cmd_output_
     uint16_t start_key_be = (opts->partial_key_start[0] << 8) | opts->partial_key_start[1];
     etd.start_key = start_key_be;
 
+    // until the device reports progress, resume from where we started
+    memcpy(data_out->next_key, opts->partial_key_start, sizeof(data_out->next_key));
+
     clearCommandBuffer();
     PacketResponseNG resp;
     SendCommandNG(CMD_LF_EM4X70_BRUTE, (uint8_t *)&etd, sizeof(etd));
@@ -326,9 +336,27 @@ static int brute_em4x70(const em4x70_cmd_input_brute_t *opts, em4x70_cmd_output_
             return PM3_EOPABORTED;
         }
 
-        if (WaitForResponseTimeout(CMD_LF_EM4X70_BRUTE, &resp, TIMEOUT)) {
+        if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, TIMEOUT)) {
+
+            if (resp.cmd == CMD_LF_EM4X70_BRUTE_PROGRESS) {
+                const em4x70_brute_progress_t *progress = (const em4x70_brute_progress_t *)resp.data.asBytes;
+                memcpy(data_out->next_key, progress->next_key, sizeof(data_out->next_key));
+                PrintAndLogEx(INPLACE, "Block %u, trying key " _YELLOW_("%02X%02X"), progress->block, progress->next_key[0], progress->next_key[1]);
+                // the device is alive, restart the timeout
+                timeout = 0;
+                continue;
+            }
+
+            if (resp.cmd != CMD_LF_EM4X70_BRUTE) {
+                continue;
+            }
+
+            PrintAndLogEx(NORMAL, "");
             if (resp.status == PM3_SUCCESS) {
-                memcpy(data_out, resp.data.asBytes, sizeof(em4x70_cmd_output_brute_t));
+                memcpy(data_out->partial_key, resp.data.asBytes, sizeof(data_out->partial_key));
+            } else if (resp.status == PM3_EOPABORTED && resp.length >= sizeof(em4x70_brute_progress_t)) {
+                const em4x70_brute_progress_t *progress = (const em4x70_brute_progress_t *)resp.data.asBytes;
+                memcpy(data_out->next_key, progress->next_key, sizeof(data_out->next_key));
             }
             return resp.status;
         }
@@ -384,29 +412,73 @@ static int setpin_em4x70(const em4x70_cmd_input_setpin_t *opts, em4x70_tag_info_
     return resp.status;
 }
 
-static int recover_em4x70(const em4x70_cmd_input_recover_t *opts, em4x70_cmd_output_recover_t *data_out) {
-    memset(data_out, 0, sizeof(em4x70_cmd_output_recover_t));
+// Key bits K47..K00 are searched as 256 partitions (K47..K40) per authentication,
+// all of them on the worker pool at once, so a batch of authentications keeps every core busy.
+typedef struct _em4x70_recover_job_t {
+    const em4x70_cmd_input_recover_t *opts;
+    em4x70_cmd_output_recover_t *data_out;
+    int *results;
+    pthread_mutex_t lock;
+} em4x70_recover_job_t;
+
+static void recover_em4x70_partition(uint32_t item, uint32_t worker, void *ctx) {
+    (void)worker;
+    em4x70_recover_job_t *job = (em4x70_recover_job_t *)ctx;
+    uint32_t n = item >> 8;
+    const em4x70_cmd_input_recover_t *opts = &job->opts[n];
+
+    ID48LIB_KEY keys[MAXIMUM_ID48_RECOVERED_KEY_COUNT];
+    size_t found = id48lib_key_recovery_partition(&opts->key, &opts->nonce, &opts->frn, &opts->grn, (uint8_t)(item & 0xFF), keys, ARRAYLEN(keys));
+    if (found == 0) {
+        return;
+    }
 
-    // The library is stateful.  First must initialize its internal context.
-    id48lib_key_recovery_init(&opts->key, &opts->nonce, &opts->frn, &opts->grn);
+    pthread_mutex_lock(&job->lock);
+    em4x70_cmd_output_recover_t *data_out = &job->data_out[n];
+    for (size_t i = 0; i < found; ++i) {
+        if ((i >= ARRAYLEN(keys)) || (data_out->potential_key_count >= MAXIMUM_ID48_RECOVERED_KEY_COUNT)) {
+            job->results[n] = PM3_EOVFLOW;
+            break;
+        }
+        data_out->potential_keys[data_out->potential_key_count++] = keys[i];
+    }
+    pthread_mutex_unlock(&job->lock);
+}
 
-    // repeatedly call id48lib_key_recovery_next() to get the next potential key
-    ID48LIB_KEY q;
-    int result = PM3_SUCCESS;
+static int recover_em4x70_key_cmp(const void *a, const void *b) {
+    return memcmp(a, b, sizeof(ID48LIB_KEY));
+}
 
-    while ((PM3_SUCCESS == result) && id48lib_key_recovery_next(&q)) {
+// recovers the potential keys of 'count' authentications, results[i] as recover_em4x70() returns it
+static void recover_em4x70_batch(const em4x70_cmd_input_recover_t *opts, em4x70_cmd_output_recover_t *data_out, int *results, size_t count) {
+    em4x70_recover_job_t job = {
+        .opts = opts,
+        .data_out = data_out,
+        .results = results,
+    };
 
-        if (data_out->potential_key_count >= MAXIMUM_ID48_RECOVERED_KEY_COUNT) {
-            result = PM3_EOVFLOW;
-        } else {
-            data_out->potential_keys[data_out->potential_key_count] = q;
-            ++data_out->potential_key_count;
-        }
+    memset(data_out, 0, count * sizeof(em4x70_cmd_output_recover_t));
+    for (size_t i = 0; i < count; ++i) {
+        results[i] = PM3_SUCCESS;
     }
 
-    if ((PM3_SUCCESS == result) && (data_out->potential_key_count == 0)) {
-        result = PM3_EFAILED;
+    pthread_mutex_init(&job.lock, NULL);
+    hn_pool_run(count * 256, recover_em4x70_partition, &job);
+    pthread_mutex_destroy(&job.lock);
+
+    for (size_t i = 0; i < count; ++i) {
+        // partitions finish in any order, keep the keys in the order a single search finds them
+        qsort(data_out[i].potential_keys, data_out[i].potential_key_count, sizeof(ID48LIB_KEY), recover_em4x70_key_cmp);
+
+        if ((PM3_SUCCESS == results[i]) && (data_out[i].potential_key_count == 0)) {
+            results[i] = PM3_EFAILED;
+        }
     }
+}
+
+static int recover_em4x70(const em4x70_cmd_input_recover_t *opts, em4x70_cmd_output_recover_t *data_out) {
+    int result = PM3_SUCCESS;
+    recover_em4x70_batch(opts, data_out, &result, 1);
     return result;
 }
 
@@ -523,7 +595,8 @@ static int CmdEM4x70Brute(const char *Cmd) {
                   "Optimized partial key-update attack of 16-bit key block 7, 8 or 9 of an EM4x70\n"
                   "This attack does NOT write anything to the tag.\n"
                   "Before starting this attack, 0000 must be written to the 16-bit key block: 'lf em 4x70 write -b 9 -d 0000'.\n"
-                  "After success, the 16-bit key block have to be restored with the key found: 'lf em 4x70 write -b 9 -d c0de'\n",
+                  "After success, the 16-bit key block have to be restored with the key found: 'lf em 4x70 write -b 9 -d c0de'\n"
+                  "An interrupted search shows the key to resume it from with '--start'.\n",
                   "lf em 4x70 brute -b 9 --rnd 45F54ADA252AAC --frn 4866BB70    --> bruteforcing key bits k95...k80 (pm3 test key)\n"
                   "lf em 4x70 brute -b 8 --rnd 3FFE1FB6CC513F --frn F355F1A0    --> bruteforcing key bits k79...k64 (research paper key)\n"
                   "lf em 4x70 brute -b 7 --rnd 7D5167003571F8 --frn 982DBCC0    --> bruteforcing key bits k63...k48 (autorecovery test key)\n"
@@ -595,6 +668,15 @@ static int CmdEM4x70Brute(const char *Cmd) {
     } else {
         PrintAndLogEx(FAILED, "Bruteforce of partial key ( "  _RED_("fail") " )");
     }
+
+    // an interrupted search continues where it stopped
+    if (result == PM3_EOPABORTED || result == PM3_ETIMEOUT) {
+        PrintAndLogEx(HINT, "Hint: resume with " _YELLOW_("lf em 4x70 brute -b %u --rnd %02X%02X%02X%02X%02X%02X%02X --frn %02X%02X%02X%02X -s %02X%02X"),
+                      opts.block,
+                      opts.rn.rn[0], opts.rn.rn[1], opts.rn.rn[2], opts.rn.rn[3], opts.rn.rn[4], opts.rn.rn[5], opts.rn.rn[6],
+                      opts.frn.frn[0], opts.frn.frn[1], opts.frn.frn[2], opts.frn.frn[3],
+                      data.next_key[0], data.next_key[1]);
+    }
     return result;
 }
 
@@ -840,9 +922,10 @@ typedef struct _em4x70_recovery_data_t {
     bool          potential_keys_validated[MAXIMUM_ID48_RECOVERED_KEY_COUNT];
 } em4x70_recovery_data_t;
 
-static int CmdEM4x70Recover_ParseArgs(const char *Cmd, em4x70_cmd_input_recover_t *out_results) {
+static int CmdEM4x70Recover_ParseArgs(const char *Cmd, em4x70_cmd_input_recover_t *out_results, char *filename) {
 
     memset(out_results, 0, sizeof(em4x70_cmd_input_recover_t));
+    filename[0] = '\0';
 
     int result = PM3_SUCCESS;
 
@@ -857,6 +940,9 @@ static int CmdEM4x70Recover_ParseArgs(const char *Cmd, em4x70_cmd_input_recover_
         "'lf em 4x70 auth' command that will authenticate, if that potential key is correct.\n"
         "The user can copy/paste these commands when the tag is present to manually check\n"
         "which of the potential keys is correct.\n"
+        "\n"
+        "With --file, every line of the file is one authentication to recover the key of:\n"
+        "<key> <rnd> <frn> <grn> in hex, '#' starts a comment.  All of them are searched at once.\n"
         //   "\n"
         //   "If the `--verify` option is provided, the tag must be present.  The rnd/frn parameters will\n"
         //   "be used to authenticate against the tag, and then any potential keys will be automatically\n"
@@ -865,14 +951,16 @@ static int CmdEM4x70Recover_ParseArgs(const char *Cmd, em4x70_cmd_input_recover_
         "lf em 4x70 recover --key F32AA98CF5BE --rnd 45F54ADA252AAC --frn 4866BB70 --grn 9BD180   (pm3 test key)\n"
         "lf em 4x70 recover --key A090A0A02080 --rnd 3FFE1FB6CC513F --frn F355F1A0 --grn 609D60   (research paper key)\n"
         "lf em 4x70 recover --key 022A028C02BE --rnd 7D5167003571F8 --frn 982DBCC0 --grn 36C0E0   (autorecovery test key)\n"
+        "lf em 4x70 recover -f batch.txt                                                          (one authentication per line)\n"
     );
 
     void *argtable[] = {
         arg_param_begin,
-        arg_str1("k",  "key",    "<hex>", "Key as 6 hex bytes"),
-        arg_str1(NULL, "rnd",    "<hex>", "Random 56-bit"),
-        arg_str1(NULL, "frn",    "<hex>", "F(RN) 28-bit as 4 hex bytes"),
-        arg_str1(NULL, "grn",    "<hex>", "G(RN) 20-bit as 3 hex bytes"),
+        arg_str0("k",  "key",    "<hex>", "Key as 6 hex bytes"),
+        arg_str0(NULL, "rnd",    "<hex>", "Random 56-bit"),
+        arg_str0(NULL, "frn",    "<hex>", "F(RN) 28-bit as 4 hex bytes"),
+        arg_str0(NULL, "grn",    "<hex>", "G(RN) 20-bit as 3 hex bytes"),
+        arg_str0("f",  "file",   "<fn>",  "Batch file, one authentication per line"),
         //arg_lit0(NULL, "verify", "automatically use tag for validation"),
         arg_param_end
     };
@@ -902,9 +990,23 @@ static int CmdEM4x70Recover_ParseArgs(const char *Cmd, em4x70_cmd_input_recover_
         if (CLIParamHexToBuf(arg_get_str(ctx, 4), &(out_results->grn.grn[0]), 3, &grn_len)) {
             result = PM3_ESOFT;
         }
+        int fnlen = 0;
+        if (CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen)) {
+            result = PM3_ESOFT;
+        }
         //out_results->verify = arg_get_lit(ctx, 6);
     }
 
+    // the batch file brings its own authentications
+    if ((PM3_SUCCESS == result) && filename[0]) {
+        if (key_len || rnd_len || frn_len || grn_len) {
+            PrintAndLogEx(FAILED, "Use either --file or --key/--rnd/--frn/--grn");
+            result = PM3_EINVARG;
+        }
+        CLIParserFree(ctx);
+        return result;
+    }
+
     // if all OK so far, do additional parameter validation
     if (PM3_SUCCESS == result) {
         // Validate number of bytes read for hex data
@@ -934,41 +1036,22 @@ static int CmdEM4x70Recover_ParseArgs(const char *Cmd, em4x70_cmd_input_recover_
     return result;
 }
 
-static int CmdEM4x70Recover(const char *Cmd) {
-    // From paper "Dismantling Megamos Crypto", Roel Verdult, Flavio D. Garcia and Barıs¸ Ege.
-    // Partial Key-Update Attack -- final 48 bits (after optimized version gets k95..k48)
-    em4x70_recovery_data_t recover_ctx = {0};
-    int result = PM3_SUCCESS;
-
-    result = CmdEM4x70Recover_ParseArgs(Cmd, &recover_ctx.opts);
-    // recover the potential keys -- no more than a few seconds
-    if (PM3_SUCCESS == result) {
-
-        result = recover_em4x70(&recover_ctx.opts, &recover_ctx.data);
-        if (PM3_EOVFLOW == result) {
-            PrintAndLogEx(ERR, "Found more than %d potential keys. This is unexpected and likely a code failure.", MAXIMUM_ID48_RECOVERED_KEY_COUNT);
-            return result;
-        } else if (PM3_SUCCESS != result) {
-            PrintAndLogEx(ERR, "No potential keys recovered.  This is unexpected and likely a code failure.");
-            return result;
-        }
-    }
+// shows the potential keys, with an authentication to tell them apart on the tag
+static void recover_em4x70_print(const em4x70_cmd_output_recover_t *data) {
+    ID48LIB_NONCE alt_nonce;
+    ID48LIB_FRN   alt_frn;
+    ID48LIB_GRN   alt_grn;
 
     // generate alternate authentication for each potential key -- no error paths, sub-second execution
-    fill_buffer_prng_bytes(&recover_ctx.alt_nonce, sizeof(ID48LIB_NONCE));
-    for (uint8_t i = 0; i < recover_ctx.data.potential_key_count; ++i) {
-        // generate the alternate frn/grn for the alternate nonce
-        id48lib_generator(&recover_ctx.data.potential_keys[i], &recover_ctx.alt_nonce, &recover_ctx.alt_frn[i], &recover_ctx.alt_grn[i]);
-    }
+    fill_buffer_prng_bytes(&alt_nonce, sizeof(ID48LIB_NONCE));
 
     // display alternate authentication for each potential key -- no error paths
-    PrintAndLogEx(INFO, "Recovered %d potential keys:", recover_ctx.data.potential_key_count);
-    for (uint8_t i = 0; i < recover_ctx.data.potential_key_count; ++i) {
+    PrintAndLogEx(INFO, "Recovered %d potential keys:", data->potential_key_count);
+    for (uint8_t i = 0; i < data->potential_key_count; ++i) {
         // generate an alternative authentication based on the potential key
         // and the alternate nonce.
-        ID48LIB_KEY q = recover_ctx.data.potential_keys[i];
-        ID48LIB_FRN alt_frn = recover_ctx.alt_frn[i];
-        ID48LIB_GRN alt_grn = recover_ctx.alt_grn[i];
+        ID48LIB_KEY q = data->potential_keys[i];
+        id48lib_generator(&q, &alt_nonce, &alt_frn, &alt_grn);
 
         // dump the results to screen, to enable the user to manually check validity
         PrintAndLogEx(INFO,
@@ -978,13 +1061,13 @@ static int CmdEM4x70Recover(const char *Cmd) {
                       i,
                       q.k[ 0], q.k[ 1], q.k[ 2], q.k[ 3], q.k[ 4], q.k[ 5],
                       q.k[ 6], q.k[ 7], q.k[ 8], q.k[ 9], q.k[10], q.k[11],
-                      recover_ctx.alt_nonce.rn[0],
-                      recover_ctx.alt_nonce.rn[1],
-                      recover_ctx.alt_nonce.rn[2],
-                      recover_ctx.alt_nonce.rn[3],
-                      recover_ctx.alt_nonce.rn[4],
-                      recover_ctx.alt_nonce.rn[5],
-                      recover_ctx.alt_nonce.rn[6],
+                      alt_nonce.rn[0],
+                      alt_nonce.rn[1],
+                      alt_nonce.rn[2],
+                      alt_nonce.rn[3],
+                      alt_nonce.rn[4],
+                      alt_nonce.rn[5],
+                      alt_nonce.rn[6],
                       alt_frn.frn[0],
                       alt_frn.frn[1],
                       alt_frn.frn[2],
@@ -995,6 +1078,151 @@ static int CmdEM4x70Recover(const char *Cmd) {
                      );
     }
     printf("\n");
+}
+
+// one authentication per line: <key> <rnd> <frn> <grn>
+static int recover_em4x70_load(const char *filename, em4x70_cmd_input_recover_t **opts, size_t *count) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        PrintAndLogEx(ERR, "Could not open file " _YELLOW_("%s"), filename);
+        return PM3_EFILE;
+    }
+
+    *opts = NULL;
+    *count = 0;
+    size_t allocated = 0;
+    int result = PM3_SUCCESS;
+    char line[256];
+    int lineno = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+
+        // drop comments and the line end, params are split on spaces and tabs only
+        line[strcspn(line, "#\r\n")] = '\0';
+        if (param_getlength(line, 0) == 0) {
+            continue;
+        }
+
+        if (*count == allocated) {
+            allocated = (allocated) ? allocated * 2 : 16;
+            em4x70_cmd_input_recover_t *tmp = realloc(*opts, allocated * sizeof(em4x70_cmd_input_recover_t));
+            if (tmp == NULL) {
+                PrintAndLogEx(WARNING, "Failed to allocate memory");
+                result = PM3_EMALLOC;
+                break;
+            }
+            *opts = tmp;
+        }
+
+        em4x70_cmd_input_recover_t *o = &(*opts)[*count];
+        memset(o, 0, sizeof(em4x70_cmd_input_recover_t));
+        int len = 0;
+        if ((param_getlength(line, 0) != 12) || param_gethex_ex(line, 0, o->key.k, &len) ||
+                (param_getlength(line, 1) != 14) || param_gethex_ex(line, 1, o->nonce.rn, &len) ||
+                (param_getlength(line, 2) != 8) || param_gethex_ex(line, 2, o->frn.frn, &len) ||
+                (param_getlength(line, 3) != 6) || param_gethex_ex(line, 3, o->grn.grn, &len)) {
+            PrintAndLogEx(FAILED, "%s line %d: expected <key 6 bytes> <rnd 7 bytes> <frn 4 bytes> <grn 3 bytes>", filename, lineno);
+            result = PM3_EINVARG;
+            break;
+        }
+        (*count)++;
+    }
+    fclose(f);
+
+    if ((PM3_SUCCESS == result) && (*count == 0)) {
+        PrintAndLogEx(FAILED, "No authentications in " _YELLOW_("%s"), filename);
+        result = PM3_EINVARG;
+    }
+    if (PM3_SUCCESS != result) {
+        free(*opts);
+        *opts = NULL;
+        *count = 0;
+    }
+    return result;
+}
+
+static int CmdEM4x70RecoverBatch(const char *filename) {
+    em4x70_cmd_input_recover_t *opts = NULL;
+    size_t count = 0;
+
+    int result = recover_em4x70_load(filename, &opts, &count);
+    if (PM3_SUCCESS != result) {
+        return result;
+    }
+
+    em4x70_cmd_output_recover_t *data = calloc(count, sizeof(em4x70_cmd_output_recover_t));
+    int *results = calloc(count, sizeof(int));
+    if (data == NULL || results == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(opts);
+        free(data);
+        free(results);
+        return PM3_EMALLOC;
+    }
+
+    PrintAndLogEx(INFO, "Recovering the keys of " _YELLOW_("%zu") " authentications on " _YELLOW_("%u") " threads...", count, hn_pool_workers());
+    uint64_t t1 = msclock();
+    recover_em4x70_batch(opts, data, results, count);
+    t1 = msclock() - t1;
+
+    size_t failed = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const em4x70_cmd_input_recover_t *o = &opts[i];
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "#%zu --key %02X%02X%02X%02X%02X%02X --rnd %02X%02X%02X%02X%02X%02X%02X --frn %02X%02X%02X%02X --grn %02X%02X%02X",
+                      i + 1,
+                      o->key.k[0], o->key.k[1], o->key.k[2], o->key.k[3], o->key.k[4], o->key.k[5],
+                      o->nonce.rn[0], o->nonce.rn[1], o->nonce.rn[2], o->nonce.rn[3], o->nonce.rn[4], o->nonce.rn[5], o->nonce.rn[6],
+                      o->frn.frn[0], o->frn.frn[1], o->frn.frn[2], o->frn.frn[3],
+                      o->grn.grn[0], o->grn.grn[1], o->grn.grn[2]
+                     );
+
+        if (PM3_EOVFLOW == results[i]) {
+            PrintAndLogEx(ERR, "Found more than %d potential keys. This is unexpected and likely a code failure.", MAXIMUM_ID48_RECOVERED_KEY_COUNT);
+            failed++;
+        } else if (PM3_SUCCESS != results[i]) {
+            PrintAndLogEx(ERR, "No potential keys recovered.  Check the values of this authentication.");
+            failed++;
+        } else {
+            recover_em4x70_print(&data[i]);
+        }
+    }
+
+    PrintAndLogEx(SUCCESS, "Recovered %zu of %zu in " _YELLOW_("%.1f") " seconds", count - failed, count, (float)t1 / 1000.0);
+
+    free(opts);
+    free(data);
+    free(results);
+    return (failed) ? PM3_ESOFT : PM3_SUCCESS;
+}
+
+static int CmdEM4x70Recover(const char *Cmd) {
+    // From paper "Dismantling Megamos Crypto", Roel Verdult, Flavio D. Garcia and Barıs¸ Ege.
+    // Partial Key-Update Attack -- final 48 bits (after optimized version gets k95..k48)
+    em4x70_recovery_data_t recover_ctx = {0};
+    char filename[FILE_PATH_SIZE] = {0};
+    int result = PM3_SUCCESS;
+
+    result = CmdEM4x70Recover_ParseArgs(Cmd, &recover_ctx.opts, filename);
+    if (PM3_SUCCESS != result) {
+        return result;
+    }
+    if (filename[0]) {
+        return CmdEM4x70RecoverBatch(filename);
+    }
+
+    // recover the potential keys -- no more than a few seconds
+    result = recover_em4x70(&recover_ctx.opts, &recover_ctx.data);
+    if (PM3_EOVFLOW == result) {
+        PrintAndLogEx(ERR, "Found more than %d potential keys. This is unexpected and likely a code failure.", MAXIMUM_ID48_RECOVERED_KEY_COUNT);
+        return result;
+    } else if (PM3_SUCCESS != result) {
+        PrintAndLogEx(ERR, "No potential keys recovered.  This is unexpected and likely a code failure.");
+        return result;
+    }
+
+    recover_em4x70_print(&recover_ctx.data);
 
     // which of those keys actually validates?
     if (recover_ctx.opts.verify) {
@@ -1217,6 +1445,11 @@ static int CmdEM4x70AutoRecover(const char *Cmd) {
 
         result = brute_em4x70(&opts_brute, &brute);
 
+        if (PM3_ETIMEOUT == result || PM3_EOPABORTED == result) {
+            PrintAndLogEx(HINT, "Hint: The search of block %d can be resumed with " _YELLOW_("lf em 4x70 brute -b %d --rnd %s --frn %s -s %02X%02X")
+                          , block, block, rnd_string, frn_string, brute.next_key[0], brute.next_key[1]);
+        }
+
         if (PM3_ETIMEOUT == result) {
             PrintAndLogEx(FAILED, "timeout while waiting for reply");
             PrintAndLogEx(HINT, "Hint: Block %d data was overwritten. Manually restart at step %d", block, step);
@@ -44,6 +44,8 @@
 #include "wiegand_formats.h"
 #include "wiegand_formatutils.h"
 #include "cmdlfem4x05.h"  // EM defines
+#include "cmdlft55xx.h"   // clone_t55xx_tag
+#include "protocols.h"    // T55x7 defines
 #include "loclass/cipherutils.h"  // bitstreamout
 
 #ifndef BITS
@@ -461,6 +463,27 @@ static int CmdHIDClone(const char *Cmd) {
         PrintAndLogEx(INFO, "Preparing to clone HID tag using raw " _YELLOW_("%s"),  raw);
     }
 
+    // in a clone queue, the T55x7 blocks CopyHIDtoT55x7() writes
+    if (t55xx_clone_capturing() && q5 == false && em == false) {
+        uint32_t blocks[7] = {0};
+        uint8_t last_block = 3;
+        if (packed.Mid > 0xFFF) {
+            last_block = 6;
+            blocks[1] = 0x1D000000 | (manchesterEncode2Bytes((packed.Top >> 16) & 0xFFFF) & 0xFFFFFF);
+            blocks[2] = manchesterEncode2Bytes(packed.Top & 0xFFFF);
+            blocks[3] = manchesterEncode2Bytes(packed.Mid >> 16);
+            blocks[4] = manchesterEncode2Bytes(packed.Mid & 0xFFFF);
+            blocks[5] = manchesterEncode2Bytes(packed.Bot >> 16);
+            blocks[6] = manchesterEncode2Bytes(packed.Bot & 0xFFFF);
+        } else {
+            blocks[1] = 0x1D000000 | (manchesterEncode2Bytes(packed.Mid & 0xFFF) & 0xFFFFFF);
+            blocks[2] = manchesterEncode2Bytes(packed.Bot >> 16);
+            blocks[3] = manchesterEncode2Bytes(packed.Bot & 0xFFFF);
+        }
+        blocks[0] = T55x7_BITRATE_RF_50 | T55x7_MODULATION_FSK2a | last_block << T55x7_MAXBLOCK_SHIFT;
+        return clone_t55xx_tag(blocks, last_block + 1);
+    }
+
     lf_hidsim_t payload;
     payload.hi2 = packed.Top;
     payload.hi = packed.Mid;
@@ -501,16 +524,205 @@ static int CmdHIDClone(const char *Cmd) {
     PrintAndLogEx(NORMAL, "----+-----+-----+-------+-----------+--------------------");
 */
 
+static void hid_brute_flip(uint32_t *out, uint8_t pos) {
+    // out is hi2, hi, lo
+    out[2 - (pos / 32)] ^= (1u << (pos % 32));
+}
+
+// same packing as the device does
+static void hid_brute_pack(const lf_hid_brute_t *d, uint32_t fc, uint32_t cn, uint32_t *out) {
+    memcpy(out, d->base, sizeof(d->base));
+
+    for (uint8_t i = 0; i < d->fc_bits + d->cn_bits; i++) {
+        uint32_t v = (i < d->fc_bits) ? (fc >> i) : (cn >> (i - d->fc_bits));
+        if ((v & 1) == 0) {
+            continue;
+        }
+
+        const lf_hid_brute_col_t *c = &d->cols[i];
+        if (c->pos != 0xFF) {
+            hid_brute_flip(out, c->pos);
+        }
+        for (uint8_t j = 0; j < d->npar; j++) {
+            if (c->par & (1 << j)) {
+                hid_brute_flip(out, d->par[j]);
+            }
+        }
+    }
+}
+
+// Describes a Wiegand format for the device engine. Wiegand packing is field placement plus XOR
+// parity, so a card is the FC = CN = 0 card with one column flipped in per set FC / CN bit.
+// The columns are measured by packing single bit values, and the model is checked against
+// HIDPack before it is used. Formats it doesn't fit stay on the client loop.
+static bool hid_brute_describe(int format_idx, const wiegand_card_t *card, lf_hid_brute_t *d) {
+
+    cardformatdescriptor_t fields = HIDGetCardFormat(format_idx).Fields;
+
+    wiegand_card_t c = *card;
+    c.FacilityCode = 0;
+    c.CardNumber = 0;
+
+    wiegand_message_t m0 = {0};
+    if (HIDPack(format_idx, &c, &m0, true) == false) {
+        return false;
+    }
+
+    d->base[0] = m0.Top;
+    d->base[1] = m0.Mid;
+    d->base[2] = m0.Bot;
+    d->longFMT = (m0.Mid > 0xFFF);
+
+    uint32_t diff[LF_HID_BRUTE_MAX_COLS][3] = {{0}};
+    uint8_t n = 0;
+
+    for (uint8_t f = 0; f < 2; f++) {
+        uint64_t max = (f == 0) ? (fields.hasFacilityCode ? fields.MaxFC : 0) : (fields.hasCardNumber ? MIN(fields.MaxCN, 0xFFFFFFFF) : 0);
+        uint8_t bits = 0;
+        for (; bits < 32 && ((1ULL << bits) <= max); bits++) {
+            c.FacilityCode = (f == 0) ? (1u << bits) : 0;
+            c.CardNumber = (f == 1) ? (1ULL << bits) : 0;
+
+            wiegand_message_t m = {0};
+            if (HIDPack(format_idx, &c, &m, true) == false) {
+                return false;
+            }
+            diff[n][0] = m.Top ^ m0.Top;
+            diff[n][1] = m.Mid ^ m0.Mid;
+            diff[n][2] = m.Bot ^ m0.Bot;
+            n++;
+        }
+
+        if (f == 0) {
+            d->fc_bits = bits;
+        } else {
+            d->cn_bits = bits;
+        }
+    }
+
+    // bits flipped by more than one column are parity
+    uint8_t count[96] = {0};
+    for (uint8_t i = 0; i < n; i++) {
+        for (uint8_t b = 0; b < 96; b++) {
+            if (diff[i][2 - (b / 32)] & (1u << (b % 32))) {
+                count[b]++;
+            }
+        }
+    }
+
+    d->npar = 0;
+    for (uint8_t b = 0; b < 96; b++) {
+        if (count[b] > 1) {
+            if (d->npar == LF_HID_BRUTE_MAX_PAR) {
+                return false;
+            }
+            d->par[d->npar++] = b;
+        }
+    }
+
+    for (uint8_t i = 0; i < n; i++) {
+        lf_hid_brute_col_t *col = &d->cols[i];
+        col->pos = 0xFF;
+        col->par = 0;
+        for (uint8_t b = 0; b < 96; b++) {
+            if ((diff[i][2 - (b / 32)] & (1u << (b % 32))) == 0) {
+                continue;
+            }
+
+            if (count[b] == 1) {
+                // one data bit per column
+                if (col->pos != 0xFF) {
+                    return false;
+                }
+                col->pos = b;
+            } else {
+                for (uint8_t j = 0; j < d->npar; j++) {
+                    if (d->par[j] == b) {
+                        col->par |= (1 << j);
+                    }
+                }
+            }
+        }
+    }
+
+    // check the model against the real packer
+    for (uint16_t t = 0; t < 256; t++) {
+        c.FacilityCode = (d->fc_bits) ? ((uint32_t)rand() & ((1ULL << d->fc_bits) - 1)) : 0;
+        c.CardNumber = (d->cn_bits) ? ((uint32_t)rand() & ((1ULL << d->cn_bits) - 1)) : 0;
+        c.FacilityCode = MIN(c.FacilityCode, fields.MaxFC);
+        c.CardNumber = MIN(c.CardNumber, fields.MaxCN);
+
+        wiegand_message_t m = {0};
+        if (HIDPack(format_idx, &c, &m, true) == false) {
+            continue;
+        }
+
+        uint32_t out[3];
+        hid_brute_pack(d, c.FacilityCode, (uint32_t)c.CardNumber, out);
+        if (out[0] != m.Top || out[1] != m.Mid || out[2] != m.Bot) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int hid_brute_device(lf_hid_brute_t *d, bool verbose) {
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_HID_BRUTE, (uint8_t *)d, sizeof(lf_hid_brute_t));
+
+    const char *name = (d->field == 0) ? "FC" : "CN";
+    lf_hid_brute_resp_t last = {
+        .up = d->start,
+        .down = d->start,
+    };
+
+    bool aborted = false;
+    PacketResponseNG resp;
+    for (;;) {
+
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_LF_HID_BRUTE_PROGRESS, &resp, 100)) {
+            memcpy(&last, resp.data.asBytes, sizeof(last));
+            if (verbose) {
+                PrintAndLogEx(INFO, "Tried %s up " _YELLOW_("%u") " down " _YELLOW_("%u") " ( %u )", name, last.up, last.down, last.tried);
+            } else {
+                PrintAndLogEx(INPLACE, "Tried %s up " _YELLOW_("%u") " down " _YELLOW_("%u") " ( %u )", name, last.up, last.down, last.tried);
+            }
+            continue;
+        }
+
+        if (WaitForResponseTimeout(CMD_LF_HID_BRUTE, &resp, 0)) {
+            memcpy(&last, resp.data.asBytes, sizeof(last));
+            break;
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "Tried " _YELLOW_("%u") " candidates", last.tried);
+    if (resp.status == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "aborted, last %s tried up " _YELLOW_("%u") " down " _YELLOW_("%u"), name, last.up, last.down);
+        PrintAndLogEx(HINT, "Hint: use " _YELLOW_("`--%s`") " with these values and " _YELLOW_("`--up`") " / " _YELLOW_("`--down`") " to resume", (d->field == 0) ? "fc" : "cn");
+    }
+    return resp.status;
+}
+
 static int CmdHIDBrute(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf hid brute",
                   "Enables bruteforce of HID readers with specified facility code or card number. This is an attack against the reader.\n"
                   "If the field being bruteforced is provided, it starts with it and goes up / down one step while maintaining other supplied values.\n"
-                  "If the field being bruteforced is not provided, it will iterate through the full range while maintaining other supplied values.",
+                  "If the field being bruteforced is not provided, it will iterate through the full range while maintaining other supplied values.\n"
+                  "The device packs and simulates every candidate on its own, the client only follows progress.",
                   "lf hid brute -w H10301 --field fc --fc 224 --cn 6278\n"
                   "lf hid brute -w H10301 --field cn --fc 21 -d 2000\n"
                   "lf hid brute -v -w H10301 --field cn --fc 21 --cn 200 -d 2000\n"
                   "lf hid brute -v -w H10301 --field fc --fc 21 --cn 200 -d 2000 --up\n"
+                  "lf hid brute -w H10301 --field cn --fc 21 --cn 1000 --min 1000 --max 2000 --up -d 250\n"
                  );
 
     void *argtable[] = {
@@ -525,6 +737,8 @@ static int CmdHIDBrute(const char *Cmd) {
         arg_u64_0("d", "delay",   "<dec>",   "delay betweens attempts in ms. (def is 1000)"),
         arg_lit0(NULL, "up",                 "direction to increment field value. (def is both directions)"),
         arg_lit0(NULL, "down",               "direction to decrement field value. (def is both directions)"),
+        arg_u64_0(NULL, "min",    "<dec>",   "lowest value of the field being bruteforced (def 0)"),
+        arg_u64_0(NULL, "max",    "<dec>",   "highest value of the field being bruteforced (def format max)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -566,6 +780,9 @@ static int CmdHIDBrute(const char *Cmd) {
         direction = 2;
     }
 
+    uint32_t range_min = arg_get_u32_def(ctx, 11, 0);
+    uint32_t range_max = arg_get_u32_def(ctx, 12, 0xFFFFFFFF);
+
     CLIParserFree(ctx);
 
     if (verbose) {
@@ -601,6 +818,31 @@ static int CmdHIDBrute(const char *Cmd) {
     PrintAndLogEx(INFO, "Started bruteforcing HID Prox reader");
     PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to abort simulation");
     PrintAndLogEx(NORMAL, "");
+
+    bool is_fc = (strcmp(field, "fc") == 0);
+    if (is_fc == false && strcmp(field, "cn") != 0) {
+        PrintAndLogEx(WARNING, "Unknown field: " _YELLOW_("%s"), field);
+        return PM3_EINVARG;
+    }
+
+    uint64_t field_max = (is_fc) ? card_descriptor.MaxFC : card_descriptor.MaxCN;
+    field_max = MIN(field_max, range_max);
+
+    // the device steps through the candidates on its own
+    lf_hid_brute_t d = {0};
+    if (field_max <= 0xFFFFFFFF && card_hi.CardNumber <= 0xFFFFFFFF && hid_brute_describe(format_idx, &card_hi, &d)) {
+        d.field = (is_fc) ? 0 : 1;
+        d.direction = direction;
+        d.fixed = (is_fc) ? (uint32_t)card_hi.CardNumber : card_hi.FacilityCode;
+        d.start = (is_fc) ? card_hi.FacilityCode : (uint32_t)card_hi.CardNumber;
+        d.min = range_min;
+        d.max = field_max;
+        d.dwell = MIN(delay, 0xFFFF);
+        return hid_brute_device(&d, verbose);
+    }
+
+    PrintAndLogEx(INFO, "Format can't be packed on the device, bruteforcing from the client");
+
     // copy values to low.
     card_low = card_hi;
 
@@ -626,13 +868,13 @@ static int CmdHIDBrute(const char *Cmd) {
                 return PM3_ESOFT;
             }
             if (strcmp(field, "fc") == 0) {
-                if (card_hi.FacilityCode < card_descriptor.MaxFC) {
+                if (card_hi.FacilityCode < field_max) {
                     card_hi.FacilityCode++;
                 } else {
                     fin_hi = true;
                 }
             } else if (strcmp(field, "cn") == 0) {
-                if (card_hi.CardNumber < card_descriptor.MaxCN) {
+                if (card_hi.CardNumber < field_max) {
                     card_hi.CardNumber++;
                 } else {
                     fin_hi = true;
@@ -646,13 +888,13 @@ static int CmdHIDBrute(const char *Cmd) {
                 return PM3_ESOFT;
             }
             if (strcmp(field, "fc") == 0) {
-                if (card_low.FacilityCode > 0) {
+                if (card_low.FacilityCode > range_min) {
                     card_low.FacilityCode--;
                 } else {
                     fin_low = true;
                 }
             } else if (strcmp(field, "cn") == 0) {
-                if (card_low.CardNumber > 0) {
+                if (card_low.CardNumber > range_min) {
                     card_low.CardNumber--;
                 } else {
                     fin_low = true;
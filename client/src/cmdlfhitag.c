@@ -19,6 +19,7 @@
 #include "cmdlfhitaghts.h"
 #include "cmdlfhitagu.h"
 #include <ctype.h>
+#include <pthread.h>
 #include "cmdparser.h"  // command_t
 #include "comms.h"
 #include "cmdtrace.h"
@@ -33,6 +34,8 @@
 #include "pm3_cmd.h"    // return codes
 #include "hitag2/hitag2_crypto.h"
 #include "util_posix.h"             // msclock
+#include "hardnested_bf_core.h"     // SetSIMDInstr
+#include "ht2crack5.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -1975,6 +1978,141 @@ static int CmdLFHitag2Chk(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdLFHitag2Crack5(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "lf hitag crack5",
+                  "Recover the Hitag 2 key from the UID and two sniffed authentications ( nR aR ),\n"
+                  "or from one authentication and the keystream `lf hitag crack2` recovered with it.\n"
+                  "Offline, the bitsliced search of ht2crack5 running on all CPU cores with the\n"
+                  "best instruction set found at runtime, unless one is forced.",
+                  "lf hitag crack5 --uid 12345678 --nrar 71DA20AA7EFDF3FA --nrar2 2A4265F959653B07\n"
+                  "lf hitag crack5 --uid 12345678 --nrar 71DA20AA7EFDF3FA --ks DF275701            --> with crack2 keystream\n"
+                  "lf hitag crack5 --uid 12345678 --nrar 71DA20AA7EFDF3FA --nrar2 2A4265F959653B07 --in  --> force no SIMD"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("u", "uid", "<hex>", "UID, 4 hex bytes"),
+        arg_str1(NULL, "nrar", "<hex>", "first nonce / answer, 8 hex bytes"),
+        arg_str0(NULL, "nrar2", "<hex>", "second nonce / answer, 8 hex bytes"),
+        arg_str0(NULL, "ks", "<hex>", "keystream recovered with the first nonce / answer, first 4 hex bytes"),
+        arg_lit0(NULL, "in", "None (use CPU regular instruction set)"),
+#if defined(COMPILER_HAS_SIMD_X86)
+        arg_lit0(NULL, "im", "MMX"),
+        arg_lit0(NULL, "is", "SSE2"),
+        arg_lit0(NULL, "ia", "AVX"),
+        arg_lit0(NULL, "i2", "AVX2"),
+#endif
+#if defined(COMPILER_HAS_SIMD_AVX512)
+        arg_lit0(NULL, "i5", "AVX512"),
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+        arg_lit0(NULL, "ie", "NEON"),
+#endif
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int ulen = 0;
+    uint8_t uid[4] = {0};
+    CLIGetHexWithReturn(ctx, 1, uid, &ulen);
+
+    int nalen = 0;
+    uint8_t nrar[8] = {0};
+    CLIGetHexWithReturn(ctx, 2, nrar, &nalen);
+
+    int na2len = 0;
+    uint8_t nrar2[8] = {0};
+    CLIGetHexWithReturn(ctx, 3, nrar2, &na2len);
+
+    // only the first 32 bits are used
+    int kslen = 0;
+    uint8_t ks[256] = {0};
+    CLIGetHexWithReturn(ctx, 4, ks, &kslen);
+
+    bool in = arg_get_lit(ctx, 5);
+#if defined(COMPILER_HAS_SIMD_X86)
+    bool im = arg_get_lit(ctx, 6);
+    bool is = arg_get_lit(ctx, 7);
+    bool ia = arg_get_lit(ctx, 8);
+    bool i2 = arg_get_lit(ctx, 9);
+#endif
+#if defined(COMPILER_HAS_SIMD_AVX512)
+    bool i5 = arg_get_lit(ctx, 10);
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+    bool ie = arg_get_lit(ctx, 6);
+#endif
+    CLIParserFree(ctx);
+
+    // sanity checks
+    if (ulen != 4) {
+        PrintAndLogEx(WARNING, "UID wrong length. expected 4, got %i", ulen);
+        return PM3_EINVARG;
+    }
+
+    if ((na2len == 0) == (kslen == 0)) {
+        PrintAndLogEx(WARNING, "Use either --nrar2 or --ks");
+        return PM3_EINVARG;
+    }
+
+    if (nalen != 8 || (na2len && na2len != 8)) {
+        PrintAndLogEx(WARNING, "NrAr wrong length. expected 8, got %i", (nalen != 8) ? nalen : na2len);
+        return PM3_EINVARG;
+    }
+
+    if (kslen && kslen < 4) {
+        PrintAndLogEx(WARNING, "Keystream too short. expected at least 4, got %i", kslen);
+        return PM3_EINVARG;
+    }
+
+    // set SIM instructions
+    SetSIMDInstr(SIMD_AUTO);
+
+#if defined(COMPILER_HAS_SIMD_AVX512)
+    if (i5)
+        SetSIMDInstr(SIMD_AVX512);
+#endif
+
+#if defined(COMPILER_HAS_SIMD_X86)
+    if (i2)
+        SetSIMDInstr(SIMD_AVX2);
+    if (ia)
+        SetSIMDInstr(SIMD_AVX);
+    if (is)
+        SetSIMDInstr(SIMD_SSE2);
+    if (im)
+        SetSIMDInstr(SIMD_MMX);
+#endif
+
+#if defined(COMPILER_HAS_SIMD_NEON)
+    if (ie)
+        SetSIMDInstr(SIMD_NEON);
+#endif
+
+    if (in) {
+        SetSIMDInstr(SIMD_NONE);
+    }
+
+    uint8_t key[6] = {0};
+    int res;
+    if (kslen) {
+        PrintAndLogEx(INFO, _YELLOW_("Hitag 2") " - Key recovery from an authentication and its keystream ( Crack5 )");
+        res = ht2crack5_keystream(uid, nrar, ks, key);
+    } else {
+        PrintAndLogEx(INFO, _YELLOW_("Hitag 2") " - Key recovery from two authentications ( Crack5 )");
+        res = ht2crack5(uid, nrar, nrar2, key);
+    }
+    if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Key: " _GREEN_("%s"), sprint_hex_inrow(key, sizeof(key)));
+    } else if (res == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "aborted via keyboard!");
+    } else {
+        PrintAndLogEx(FAILED, "Key not found");
+    }
+    return res;
+}
+
 static int CmdLFHitag2Lookup(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -2190,16 +2328,79 @@ static int CmdLFHitag2Lookup(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// crack5 on the keystream crack2 streams, see `lf hitag crack2 --live`.
+// The reply loop hands over the first keystream, the solver thread runs while crack2 extends it.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t uid[4];
+    uint8_t nrar[8];
+    uint8_t ks[4];
+    bool have_ks;
+    bool capture_done;
+    int res;                // PM3_EPARTIAL until crack5 is done
+    uint8_t key[6];
+} ht2_live_crack5_t;
+
+static void *ht2_live_crack5(void *thread_arg) {
+    ht2_live_crack5_t *live = (ht2_live_crack5_t *)thread_arg;
+
+    pthread_mutex_lock(&live->lock);
+    while (live->have_ks == false && live->capture_done == false) {
+        pthread_cond_wait(&live->cond, &live->lock);
+    }
+    bool have_ks = live->have_ks;
+    pthread_mutex_unlock(&live->lock);
+
+    // crack2 failed before it had any keystream
+    if (have_ks == false) {
+        return NULL;
+    }
+
+    uint8_t key[6] = {0};
+    int res = ht2crack5_keystream(live->uid, live->nrar, live->ks, key);
+
+    pthread_mutex_lock(&live->lock);
+    memcpy(live->key, key, sizeof(live->key));
+    live->res = res;
+    pthread_mutex_unlock(&live->lock);
+    return NULL;
+}
+
+static int ht2_live_crack5_result(ht2_live_crack5_t *live) {
+    pthread_mutex_lock(&live->lock);
+    int res = live->res;
+    pthread_mutex_unlock(&live->lock);
+    return res;
+}
+
+// no more keystream, waits for crack5 if it is running
+static int ht2_live_crack5_finish(ht2_live_crack5_t *live, pthread_t thread) {
+    pthread_mutex_lock(&live->lock);
+    live->capture_done = true;
+    pthread_cond_signal(&live->cond);
+    pthread_mutex_unlock(&live->lock);
+
+    pthread_join(thread, NULL);
+    pthread_cond_destroy(&live->cond);
+    pthread_mutex_destroy(&live->lock);
+    return live->res;
+}
+
 static int CmdLFHitag2Crack2(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf hitag crack2",
-                  "This command tries to recover 2048 bits of Hitag 2 crypto stream data.\n",
-                  "lf hitag crack2 --nrar 73AA5A62EAB8529C"
+                  "This command tries to recover 2048 bits of Hitag 2 crypto stream data.\n"
+                  "With --live the key is searched with crack5 on the host as soon as the first\n"
+                  "32 bits of keystream are in, while the device keeps collecting.",
+                  "lf hitag crack2 --nrar 73AA5A62EAB8529C\n"
+                  "lf hitag crack2 --nrar 73AA5A62EAB8529C --live   --> recover the key during collection"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_str0(NULL, "nrar", "<hex>", "specify nonce / answer as 8 hex bytes"),
+        arg_lit0(NULL, "live", "run crack5 on the keystream while it is collected"),
         arg_param_end
     };
 
@@ -2207,6 +2408,7 @@ static int CmdLFHitag2Crack2(const char *Cmd) {
     int nalen = 0;
     uint8_t nrar[8] = {0};
     CLIGetHexWithReturn(ctx, 1, nrar, &nalen);
+    bool live = arg_get_lit(ctx, 2);
     CLIParserFree(ctx);
 
     // sanity checks
@@ -2215,30 +2417,80 @@ static int CmdLFHitag2Crack2(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if (live && nalen == 0) {
+        PrintAndLogEx(WARNING, "--live needs the nonce / answer, use --nrar");
+        return PM3_EINVARG;
+    }
+
     lf_hitag_data_t packet;
     memset(&packet, 0, sizeof(packet));
     memcpy(packet.NrAr, nrar, sizeof(packet.NrAr));
 
     PrintAndLogEx(INFO, _YELLOW_("Hitag 2") " - Nonce replay and length extension attack ( Crack2 )");
 
+    ht2_live_crack5_t live_state;
+    pthread_t live_thread;
+    if (live) {
+        memset(&live_state, 0, sizeof(live_state));
+        live_state.res = PM3_EPARTIAL;
+        memcpy(live_state.nrar, nrar, sizeof(live_state.nrar));
+        pthread_mutex_init(&live_state.lock, NULL);
+        pthread_cond_init(&live_state.cond, NULL);
+        if (pthread_create(&live_thread, NULL, ht2_live_crack5, (void *)&live_state)) {
+            PrintAndLogEx(WARNING, "Failed to create pthread, use `lf hitag crack5 --ks` afterwards");
+            pthread_cond_destroy(&live_state.cond);
+            pthread_mutex_destroy(&live_state.lock);
+            live = false;
+        }
+    }
+
     uint64_t t1 = msclock();
 
     PacketResponseNG resp;
     clearCommandBuffer();
     SendCommandNG(CMD_LF_HITAG2_CRACK_2, (uint8_t *) &packet, sizeof(packet));
 
-    // loop
+    // loop, the keystream comes in as it grows and the final reply carries all of it
+    bool stop_sent = false;
     uint8_t attempt = 50;
     do {
 
-//        PrintAndLogEx(INPLACE, "Attack 2 running...");
-//        fflush(stdout);
+        if (live && stop_sent == false && ht2_live_crack5_result(&live_state) == PM3_SUCCESS) {
+            // key is known, the rest of the keystream is not needed
+            PrintAndLogEx(INFO, "Key recovered, stopping crack2");
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stop_sent = true;
+        }
 
-        if (WaitForResponseTimeout(CMD_LF_HITAG2_CRACK_2, &resp, 1000) == false) {
+        if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 1000) == false) {
             attempt--;
             continue;
         }
 
+        if (resp.cmd == CMD_LF_HITAG2_CRACK_KEYSTREAM) {
+            const lf_hitag_crack_keystream_t *ks = (const lf_hitag_crack_keystream_t *)resp.data.asBytes;
+            attempt = 50;
+
+            PrintAndLogEx(INPLACE, "Recovered " _YELLOW_("%4u") " bits of keystream", ks->bits);
+
+            if (live && ks->bits >= 32) {
+                pthread_mutex_lock(&live_state.lock);
+                if (live_state.have_ks == false) {
+                    memcpy(live_state.uid, ks->uid, sizeof(live_state.uid));
+                    memcpy(live_state.ks, ks->data, sizeof(live_state.ks));
+                    live_state.have_ks = true;
+                    pthread_cond_signal(&live_state.cond);
+                }
+                pthread_mutex_unlock(&live_state.lock);
+            }
+            continue;
+        }
+
+        if (resp.cmd != CMD_LF_HITAG2_CRACK_2) {
+            continue;
+        }
+
+        PrintAndLogEx(NORMAL, "");
         if (resp.status == PM3_SUCCESS) {
 
             PrintAndLogEx(SUCCESS, "--------------------- " _CYAN_("Recovered Keystream") " ----------------------");
@@ -2249,25 +2501,44 @@ static int CmdLFHitag2Crack2(const char *Cmd) {
             }
             PrintAndLogEx(NORMAL, "");
             PrintAndLogEx(SUCCESS, "Nonce replay and length extension attack ( %s )", _GREEN_("ok"));
-            PrintAndLogEx(HINT, "Hint: Try `" _YELLOW_("tools/hitag2crack/crack2/ht2crack2search <FILE_with_above_bytes>") "`");
+            if (live == false) {
+                PrintAndLogEx(HINT, "Hint: Try `" _YELLOW_("tools/hitag2crack/crack2/ht2crack2search <FILE_with_above_bytes>") "`");
+                PrintAndLogEx(HINT, "Hint: Try `" _YELLOW_("lf hitag crack5 --uid <uid> --nrar %s --ks %s") "`", sprint_hex_inrow(nrar, sizeof(nrar)), sprint_hex_inrow(payload->data, 4));
+            }
             break;
         } else {
-            PrintAndLogEx(NORMAL, "");
             PrintAndLogEx(FAILED, "Nonce replay and length extension attack ( %s )", _RED_("fail"));
             break;
         }
 
     } while (attempt);
 
+    int res = PM3_SUCCESS;
     if (attempt == 0) {
         PrintAndLogEx(NORMAL, "");
         PrintAndLogEx(WARNING, "timeout while waiting for reply");
-        return PM3_ESOFT;
+        res = PM3_ESOFT;
+    }
+
+    if (live) {
+        if (ht2_live_crack5_result(&live_state) == PM3_EPARTIAL) {
+            PrintAndLogEx(INFO, "waiting for crack5 to finish");
+        }
+
+        int live_res = ht2_live_crack5_finish(&live_state, live_thread);
+        if (live_res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Key: " _GREEN_("%s"), sprint_hex_inrow(live_state.key, sizeof(live_state.key)));
+            res = PM3_SUCCESS;
+        } else if (live_res == PM3_EOPABORTED) {
+            PrintAndLogEx(WARNING, "crack5 aborted via keyboard!");
+        } else if (live_res != PM3_EPARTIAL) {
+            PrintAndLogEx(FAILED, "crack5, key not found");
+        }
     }
 
     t1 = msclock() - t1;
     PrintAndLogEx(SUCCESS, "\ntime " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
-    return PM3_SUCCESS;
+    return res;
 }
 
 /* Test code
@@ -2486,6 +2757,7 @@ static command_t CommandTable[] = {
     {"-----------", CmdHelp,                    IfPm3Hitag,      "----------------------- " _CYAN_("Recovery") " -----------------------"},
     {"cc",          CmdLFHitagSCheckChallenges, IfPm3Hitag,      "Hitag S: test all provided challenges"},
     {"crack2",      CmdLFHitag2Crack2,          IfPm3Hitag,      "Recover 2048bits of crypto stream"},
+    {"crack5",      CmdLFHitag2Crack5,          AlwaysAvailable, "Recover key from two sniffed authentications"},
     {"chk",         CmdLFHitag2Chk,             IfPm3Hitag,      "Check keys"},
     {"lookup",      CmdLFHitag2Lookup,          AlwaysAvailable, "Uses authentication trace to check for key in dictionary file"},
     {"ta",          CmdLFHitag2CheckChallenges, IfPm3Hitag,      "Hitag 2: test all recorded authentications"},
@@ -42,6 +42,7 @@
 #define INDALA_ARR_LEN 64
 
 static int CmdHelp(const char *Cmd);
+static int decodeIndala(bool verbose);
 
 //large 224 bit indala formats (different preamble too...)
 static uint8_t preamble224[] = {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
@@ -197,12 +198,17 @@ static int sendTry(uint8_t fc, uint16_t cn, uint32_t delay, bool fmt4041x, bool
 // by marshmellow, martinbeier
 // optional arguments - same as PSKDemod (clock & invert & maxerr)
 int demodIndalaEx(int clk, int invert, int maxErr, bool verbose) {
-    (void) verbose; // unused so far
     int ans = PSKDemod(clk, invert, maxErr, true);
     if (ans != PM3_SUCCESS) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - Indala can't demod signal: %d", ans);
         return PM3_ESOFT;
     }
+    return decodeIndala(verbose);
+}
+
+// the PSK1 bits in DemodBuffer, from PSKDemod() or from the device
+static int decodeIndala(bool verbose) {
+    (void) verbose; // unused so far
 
     uint8_t inv = 0;
     size_t size = g_DemodBufferLen;
@@ -602,7 +608,45 @@ static int CmdIndalaDemodAlt(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-// this read is the "normal" read,  which download lf signal and tries to demod here.
+// Samples and PSK1 demodulates on the device, only the bits come back for the preamble search.
+// PM3_ENOTIMPL when the device doesn't answer, to fall back to downloading the samples.
+static int readIndalaDevice(int clk, int invert, int max_err) {
+
+    lf_indala_read_t payload = {
+        .samples = 30000,
+        .clock = clk,
+        .invert = invert,
+        .max_err = max_err,
+    };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_INDALA_READ, (uint8_t *)&payload, sizeof(payload));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_LF_INDALA_READ, &resp, 2500) == false) {
+        PrintAndLogEx(DEBUG, "DEBUG: Indala device read timeout");
+        return PM3_ENOTIMPL;
+    }
+
+    if (resp.status != PM3_SUCCESS) {
+        PrintAndLogEx(DEBUG, "DEBUG: Error - Indala can't demod signal: %d", resp.status);
+        return PM3_ESOFT;
+    }
+
+    const lf_indala_read_reply_t *r = (const lf_indala_read_reply_t *)resp.data.asBytes;
+    uint16_t bitlen = MIN(r->bitlen, LF_INDALA_READ_MAX_BITS);
+
+    uint8_t bits[LF_INDALA_READ_MAX_BITS] = {0};
+    for (uint16_t i = 0; i < bitlen; i++) {
+        bits[i] = (r->bits[i >> 3] >> (7 - (i & 7))) & 1;
+    }
+
+    PrintAndLogEx(DEBUG, "DEBUG: (PSKdemod) Using Clock:%d, Bits Found:%u, errors: %d", r->clock, bitlen, r->errors);
+    setDemodBuff(bits, bitlen, 0);
+    setClockGrid(r->clock, r->start_idx);
+    return decodeIndala(true);
+}
+
+// this read is the "normal" read, the device demodulates and the bits are decoded here.
 static int CmdIndalaReader(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf indala reader",
@@ -630,8 +674,10 @@ static int CmdIndalaReader(const char *Cmd) {
     }
 
     do {
-        lf_read(false, 30000);
-        demodIndalaEx(clk, invert, max_err, !cm);
+        if (readIndalaDevice(clk, invert, max_err) == PM3_ENOTIMPL) {
+            lf_read(false, 30000);
+            demodIndalaEx(clk, invert, max_err, !cm);
+        }
     } while (cm & (kbd_enter_pressed() == false));
     return PM3_SUCCESS;
 }
@@ -38,6 +38,7 @@
 #include "cmdlf.h"        // for lf sniff
 #include "generator.h"
 #include "cliparser.h"    // cliparsing
+#include "cmdmain.h"      // CommandReceived
 
 // Some defines for readability
 #define T55XX_DLMODE_FIXED         0 // Default Mode
@@ -335,6 +336,7 @@ void Set_t55xx_Config(t55xx_conf_block_t conf) {
 }
 
 static int CmdHelp(const char *Cmd);
+static bool t55xx_try_detect_hint(uint8_t downlink_mode, bool print_config, uint32_t wanted_conf, uint64_t pwd, const t55xx_probe_hint_t *hint);
 
 static void arg_add_t55xx_downloadlink(void *at[], uint8_t *idx, uint8_t show, uint8_t dl_mode_def) {
     const size_t r_count = 56;
@@ -438,6 +440,93 @@ static void T55x7_ClearAllBlockData(void) {
     }
 }
 
+static void t55xx_print_clone_failures(uint8_t failed_blocks) {
+    for (uint8_t i = 0; i < 8; i++) {
+        if (failed_blocks & (1 << i)) {
+            PrintAndLogEx(WARNING, "Block %u ( " _RED_("verify fail") " )", i);
+        }
+    }
+}
+
+// Writes and verifies all blocks with one CMD_LF_T55XX_CLONE, the device reads
+// every block back and checks it against the data written.
+static int t55xx_clone_verify(const uint32_t *blockdata, uint8_t numblocks, bool usepwd, uint32_t password, bool loop) {
+
+    t55xx_clone_t payload = {
+        .numblocks = numblocks,
+        .pwd = password,
+        .flags = (usepwd) ? 0x01 : 0x00,
+        .loop = loop,
+    };
+    memcpy(payload.blocks, blockdata, numblocks * sizeof(uint32_t));
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_T55XX_CLONE, (uint8_t *)&payload, sizeof(payload));
+
+    PacketResponseNG resp;
+    uint8_t timeout = 0;
+    for (;;) {
+
+        if (loop && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            loop = false;
+        }
+
+        if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 1000) == false) {
+            // looping, the device waits for tags as long as it takes
+            if (loop == false && ++timeout > 2 + (2 * numblocks)) {
+                PrintAndLogEx(ERR, "Error occurred, device did not respond during write operation.");
+                return PM3_ETIMEOUT;
+            }
+            continue;
+        }
+
+        if (resp.cmd == CMD_LF_T55XX_CLONE_PROGRESS) {
+            const t55xx_clone_reply_t *tag = (const t55xx_clone_reply_t *)resp.data.asBytes;
+            if (resp.status == PM3_SUCCESS) {
+                PrintAndLogEx(SUCCESS, "Tag %u written and verified", tag->cloned + tag->failed);
+            } else {
+                PrintAndLogEx(WARNING, "Tag %u ( " _RED_("fail") " )", tag->cloned + tag->failed);
+                t55xx_print_clone_failures(tag->failed_blocks);
+            }
+            continue;
+        }
+
+        if (resp.cmd == CMD_LF_T55XX_CLONE) {
+            break;
+        }
+    }
+
+    if (resp.status == PM3_EINVARG) {
+        return resp.status;
+    }
+
+    const t55xx_clone_reply_t *reply = (const t55xx_clone_reply_t *)resp.data.asBytes;
+    if (payload.loop) {
+        PrintAndLogEx(INFO, "Cloned " _GREEN_("%u") " tags, " _RED_("%u") " failed", reply->cloned, reply->failed);
+        return PM3_SUCCESS;
+    }
+
+    if (resp.status == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Data written and verified");
+    } else {
+        t55xx_print_clone_failures(reply->failed_blocks);
+    }
+    return resp.status;
+}
+
+// While 'lf t55xx clonequeue' reads its file, clone_t55xx_tag() keeps the blocks
+// of the clone commands in it, instead of writing them
+static struct {
+    bool active;
+    uint8_t numblocks;
+    uint32_t blocks[8];
+} clone_capture;
+
+bool t55xx_clone_capturing(void) {
+    return clone_capture.active;
+}
+
 int clone_t55xx_tag(uint32_t *blockdata, uint8_t numblocks) {
 
     if (blockdata == NULL)
@@ -445,50 +534,312 @@ int clone_t55xx_tag(uint32_t *blockdata, uint8_t numblocks) {
     if (numblocks < 1 || numblocks > 8)
         return PM3_EINVARG;
 
-    PacketResponseNG resp;
+    if (clone_capture.active) {
+        memcpy(clone_capture.blocks, blockdata, numblocks * sizeof(uint32_t));
+        clone_capture.numblocks = numblocks;
+        return PM3_SUCCESS;
+    }
+
+    int res = t55xx_clone_verify(blockdata, numblocks, false, 0, false);
+    if (res == PM3_ETIMEOUT) {
+        return res;
+    }
+
+    // the client config follows the new block 0, like a detect would
+    SetConfigWithBlock0(blockdata[0]);
+    return PM3_SUCCESS;
+}
+
+static int CmdT55xxClone(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "lf t55xx clone",
+                  "Write page 0 blocks, starting at block 0, and verify them on the device in one go.\n"
+                  "With '--loop' every new tag placed on the antenna is cloned and verified,\n"
+                  "until the button or <Enter> is pressed.",
+                  "lf t55xx clone -d 00148040AAAAAAAA55555555                -> block 0, 1, 2\n"
+                  "lf t55xx clone -d 00148040AAAAAAAA55555555 --loop         -> clone every tag placed on the antenna\n"
+                  "lf t55xx clone -d 00148040AAAAAAAA55555555 -p 11223344    -> tags with password"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("d", "data", "<hex>", "block data, 4 hex bytes per block, up to 8 blocks"),
+        arg_str0("p", "pwd", "<hex>", "current password of the tags (4 hex bytes)"),
+        arg_lit0(NULL, "loop", "clone every new tag placed on the antenna"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    uint8_t data[8 * 4] = {0};
+    int dlen = 0;
+    int res = CLIParamHexToBuf(arg_get_str(ctx, 1), data, sizeof(data), &dlen);
+    if (res) {
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    bool usepwd = false;
+    uint32_t password = 0;
+    res = arg_get_u32_hexstr_def(ctx, 2, 0, &password);
+    if (res == 2) {
+        CLIParserFree(ctx);
+        PrintAndLogEx(FAILED, "password should be 4 bytes");
+        return PM3_EINVARG;
+    }
+    usepwd = (res == 1);
+
+    bool loop = arg_get_lit(ctx, 3);
+    CLIParserFree(ctx);
+
+    if (dlen == 0 || (dlen % 4)) {
+        PrintAndLogEx(FAILED, "data must be 4 hex bytes per block, got %d bytes", dlen);
+        return PM3_EINVARG;
+    }
+
+    uint32_t blocks[8] = {0};
+    uint8_t numblocks = dlen / 4;
+    for (uint8_t i = 0; i < numblocks; i++) {
+        blocks[i] = bytes_to_num(data + (i * 4), 4);
+    }
+
+    print_blocks(blocks, numblocks);
+
+    if (loop) {
+        PrintAndLogEx(INFO, "Place tags on the antenna, press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to exit");
+    }
+
+    uint64_t t1 = msclock();
+    res = t55xx_clone_verify(blocks, numblocks, usepwd, password, loop);
+    if (loop == false) {
+        PrintAndLogEx(DEBUG, "time " _YELLOW_("%" PRIu64) " ms", msclock() - t1);
+        SetConfigWithBlock0(blocks[0]);
+    }
+    return res;
+}
+
+typedef struct {
+    size_t line;
+    uint8_t numblocks;
+    uint32_t blocks[8];
+} t55xx_credential_t;
+
+// one line of a clone queue file, either block data in hex or a clone command of some lf tech
+static bool t55xx_clone_queue_line(char *line, t55xx_credential_t *cred) {
 
-    // fast push mode
-    g_conn.block_after_ACK = true;
+    if (strncmp(line, "lf ", 3) == 0) {
+        memset(&clone_capture, 0, sizeof(clone_capture));
+        clone_capture.active = true;
 
-    for (int8_t i = 0; i < numblocks; i++) {
+        uint8_t old_printAndLog = g_printAndLog;
+        g_printAndLog &= ~PRINTANDLOG_PRINT;
+        CommandReceived(line);
+        g_printAndLog = old_printAndLog;
 
-        // Disable fast mode on last packet
-        if (i == numblocks - 1) {
-            g_conn.block_after_ACK = false;
+        clone_capture.active = false;
+        if (clone_capture.numblocks == 0) {
+            return false;
         }
+        cred->numblocks = clone_capture.numblocks;
+        memcpy(cred->blocks, clone_capture.blocks, sizeof(cred->blocks));
+        return true;
+    }
 
-        clearCommandBuffer();
+    uint8_t data[8 * 4] = {0};
+    int dlen = hex_to_bytes(line, data, sizeof(data));
+    if (dlen <= 0 || (dlen % 4)) {
+        return false;
+    }
+
+    cred->numblocks = dlen / 4;
+    for (uint8_t i = 0; i < cred->numblocks; i++) {
+        cred->blocks[i] = bytes_to_num(data + (i * 4), 4);
+    }
+    return true;
+}
 
-        t55xx_write_block_t ng;
-        ng.data = blockdata[i];
-        ng.pwd = 0;
-        ng.blockno = i;
-        ng.flags = 0;
+// Sends 'count' credentials of the same size with one CMD_LF_T55XX_CLONE_QUEUE and follows
+// the tags until they are all cloned.  'done' gets how many were.
+static int t55xx_clone_queue_send(const t55xx_credential_t *creds, uint8_t count, bool usepwd, uint32_t password, uint8_t *done) {
 
-        SendCommandNG(CMD_LF_T55XX_WRITEBL, (uint8_t *)&ng, sizeof(ng));
-        if (WaitForResponseTimeout(CMD_LF_T55XX_WRITEBL, &resp, T55XX_WRITE_TIMEOUT) == false) {
-            PrintAndLogEx(ERR, "Error occurred, device did not respond during write operation.");
-            return PM3_ETIMEOUT;
+    t55xx_clone_queue_t payload = {
+        .pwd = password,
+        .flags = (usepwd) ? 0x01 : 0x00,
+        .numblocks = creds[0].numblocks,
+        .count = count,
+    };
+    for (uint8_t i = 0; i < count; i++) {
+        memcpy(&payload.blocks[i * payload.numblocks], creds[i].blocks, payload.numblocks * sizeof(uint32_t));
+    }
+
+    *done = 0;
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_T55XX_CLONE_QUEUE, (uint8_t *)&payload, sizeof(payload) - sizeof(payload.blocks) + (count * payload.numblocks * sizeof(uint32_t)));
+
+    PacketResponseNG resp;
+    bool stopped = false;
+    uint8_t timeout = 0;
+    for (;;) {
+
+        if (stopped == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopped = true;
+        }
+
+        // the device waits for tags as long as it takes
+        if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 1000) == false) {
+            if (stopped && ++timeout > 2) {
+                PrintAndLogEx(WARNING, "timeout while waiting for reply");
+                return PM3_ETIMEOUT;
+            }
+            continue;
+        }
+
+        if (resp.cmd == CMD_LF_T55XX_CLONE_PROGRESS) {
+            const t55xx_clone_reply_t *tag = (const t55xx_clone_reply_t *)resp.data.asBytes;
+            if (resp.status == PM3_SUCCESS) {
+                const t55xx_credential_t *c = &creds[tag->cloned - 1];
+                char s[8 * 9 + 1] = {0};
+                for (uint8_t i = 0; i < c->numblocks; i++) {
+                    snprintf(s + strlen(s), sizeof(s) - strlen(s), "%08X ", c->blocks[i]);
+                }
+                PrintAndLogEx(SUCCESS, "line %3zu  %s( " _GREEN_("ok") " )", c->line, s);
+            } else {
+                PrintAndLogEx(WARNING, "line %3zu  ( " _RED_("fail") " ) place the next tag for it", creds[tag->cloned].line);
+                t55xx_print_clone_failures(tag->failed_blocks);
+            }
+            continue;
+        }
+
+        if (resp.cmd == CMD_LF_T55XX_CLONE_QUEUE) {
+            break;
         }
     }
 
-    uint8_t res = 0;
-    for (int8_t i = 0; i < numblocks; i++) {
+    if (resp.length == sizeof(t55xx_clone_reply_t)) {
+        *done = ((const t55xx_clone_reply_t *)resp.data.asBytes)->cloned;
+    }
+    return resp.status;
+}
+
+static int CmdT55xxCloneQueue(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "lf t55xx clonequeue",
+                  "Clone a list of credentials, one per tag placed on the antenna.\n"
+                  "Each line of the file holds block data in hex, block 0 first, or the clone command\n"
+                  "of a lf tech (its blocks are used, nothing is written while reading the file).\n"
+                  "The device writes and verifies each tag and moves on to the next credential,\n"
+                  "a tag that fails keeps its credential for the next tag.\n"
+                  "Lines starting with # are comments.",
+                  "lf t55xx clonequeue -f enrol.txt\n"
+                  "lf t55xx clonequeue -f enrol.txt -p 11223344    -> tags with password\n"
+                  "\n"
+                  "enrol.txt:\n"
+                  "  00107060 1D555555 A6A6A6A6 A5A5A5A5\n"
+                  "  lf hid clone -w H10301 --fc 31 --cn 337\n"
+                  "  lf em 410x clone --id 0F0368568B"
+                 );
 
-        if (i == 0) {
-            SetConfigWithBlock0(blockdata[0]);
-            if (t55xxAcquireAndCompareBlock0(false, 0, blockdata[0], false))
-                continue;
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("f", "file", "<fn>", "credentials file"),
+        arg_str0("p", "pwd", "<hex>", "current password of the tags (4 hex bytes)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    uint32_t password = 0;
+    int res = arg_get_u32_hexstr_def(ctx, 2, 0, &password);
+    if (res == 2) {
+        CLIParserFree(ctx);
+        PrintAndLogEx(FAILED, "password should be 4 bytes");
+        return PM3_EINVARG;
+    }
+    bool usepwd = (res == 1);
+    CLIParserFree(ctx);
+
+    char *path = NULL;
+    if (searchFile(&path, RESOURCES_SUBDIR, filename, "", false) != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "couldn't open `" _YELLOW_("%s") "`", path);
+        free(path);
+        return PM3_EFILE;
+    }
+    free(path);
+
+    t55xx_credential_t *creds = NULL;
+    size_t count = 0, cap = 0, lines = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        lines++;
+        str_trim(line);
+        if (line[0] == 0 || line[0] == '#') {
+            continue;
+        }
+
+        if (count == cap) {
+            cap = (cap) ? cap * 2 : 64;
+            t55xx_credential_t *tmp = realloc(creds, cap * sizeof(t55xx_credential_t));
+            if (tmp == NULL) {
+                PrintAndLogEx(WARNING, "Failed to allocate memory");
+                free(creds);
+                fclose(f);
+                return PM3_EMALLOC;
+            }
+            creds = tmp;
         }
 
-        if (t55xxVerifyWrite(i, 0, false, false, 0, 0xFF, blockdata[i]) == false)
-            res++;
+        t55xx_credential_t *c = &creds[count];
+        memset(c, 0, sizeof(t55xx_credential_t));
+        c->line = lines;
+        if (t55xx_clone_queue_line(line, c) == false) {
+            PrintAndLogEx(FAILED, "line %zu, `" _YELLOW_("%s") "` gives no t55xx blocks", lines, line);
+            free(creds);
+            fclose(f);
+            return PM3_EINVARG;
+        }
+        count++;
     }
+    fclose(f);
 
-    if (res == 0)
-        PrintAndLogEx(SUCCESS, "Data written and verified");
+    if (count == 0) {
+        PrintAndLogEx(FAILED, "no credentials in file");
+        free(creds);
+        return PM3_EINVARG;
+    }
 
-    return PM3_SUCCESS;
+    PrintAndLogEx(INFO, "Loaded " _YELLOW_("%zu") " credentials", count);
+    PrintAndLogEx(INFO, "Place tags on the antenna, press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to exit");
+
+    // consecutive credentials of the same size go in one queue, as many as fit
+    size_t next = 0;
+    res = PM3_SUCCESS;
+    while (next < count && res == PM3_SUCCESS) {
+        uint8_t numblocks = creds[next].numblocks;
+        size_t n = 1;
+        while (next + n < count && n < 255 && creds[next + n].numblocks == numblocks && (n + 1) * numblocks <= T55XX_CLONE_QUEUE_WORDS) {
+            n++;
+        }
+
+        uint8_t done = 0;
+        res = t55xx_clone_queue_send(&creds[next], n, usepwd, password, &done);
+        next += done;
+    }
+
+    PrintAndLogEx(INFO, "Cloned " _GREEN_("%zu") " of %zu credentials", next, count);
+    if (next < count) {
+        PrintAndLogEx(INFO, "Next credential on line %zu", creds[next].line);
+    }
+    free(creds);
+    return (res == PM3_EOPABORTED) ? PM3_SUCCESS : res;
 }
 
 static bool t55xxProtect(bool lock, bool usepwd, uint8_t override, uint32_t password, uint8_t downlink_mode, uint32_t new_password) {
@@ -904,27 +1255,38 @@ int T55xxReadBlock(uint8_t block, bool page1, bool usepwd, uint8_t override, uin
     return T55xxReadBlockEx(block, page1, usepwd, override, password, downlink_mode, true);
 }
 
+// try reading the config block and verify that PWD bit is set before reading with a password!
+// override = 1 (override and display)
+// override = 2 (override and no display)
+// clears 'usepwd' when the tag answers without one
+static int t55xx_pwd_safety_check(uint8_t override, uint32_t password, uint8_t downlink_mode, bool *usepwd) {
+    if (override == 0) {
+        if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, false, 0, downlink_mode) == false)
+            return PM3_ERFTRANS;
+
+        if (t55xxTryDetectModulationEx(downlink_mode, false, 0, password) == false) {
+            PrintAndLogEx(WARNING, "Safety check: Could not detect if PWD bit is set in config block. Exits.");
+            PrintAndLogEx(HINT, "Hint: Consider using the override parameter to force read.");
+            return PM3_EWRONGANSWER;
+        } else {
+            PrintAndLogEx(WARNING, "Safety check: PWD bit is NOT set in config block. Reading without password...");
+            *usepwd = false;
+        }
+    } else if (override == 1) {
+        PrintAndLogEx(INFO, "Safety check overridden - proceeding despite risk");
+    }
+    return PM3_SUCCESS;
+}
+
 int T55xxReadBlockEx(uint8_t block, bool page1, bool usepwd, uint8_t override, uint32_t password, uint8_t downlink_mode, bool verbose) {
     //Password mode
     if (usepwd) {
-        // try reading the config block and verify that PWD bit is set before doing this!
-        // override = 1 (override and display)
-        // override = 2 (override and no display)
-        if (override == 0) {
-            if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, false, 0, downlink_mode) == false)
-                return PM3_ERFTRANS;
-
-            if (t55xxTryDetectModulationEx(downlink_mode, false, 0, password) == false) {
-                PrintAndLogEx(WARNING, "Safety check: Could not detect if PWD bit is set in config block. Exits.");
-                PrintAndLogEx(HINT, "Hint: Consider using the override parameter to force read.");
-                return PM3_EWRONGANSWER;
-            } else {
-                PrintAndLogEx(WARNING, "Safety check: PWD bit is NOT set in config block. Reading without password...");
-                usepwd = false;
-                page1 = false; // ??
-            }
-        } else if (override == 1) {
-            PrintAndLogEx(INFO, "Safety check overridden - proceeding despite risk");
+        int res = t55xx_pwd_safety_check(override, password, downlink_mode, &usepwd);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        if (usepwd == false) {
+            page1 = false; // ??
         }
     }
 
@@ -1162,6 +1524,43 @@ static int CmdT55xxWakeUp(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// reads block 0 in all d/l modes on the device, which classifies the samples
+static bool t55xx_probe(bool usepwd, uint32_t password, t55xx_probe_hint_t *hints) {
+
+    t55xx_probe_t payload = {
+        .pwd = password,
+        .flags = (usepwd) ? 1 : 0,
+        .downlink_modes = 0x0F,
+    };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_T55XX_PROBE, (uint8_t *)&payload, sizeof(payload));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_LF_T55XX_PROBE, &resp, 5000) == false) {
+        PrintAndLogEx(DEBUG, "probe timeout, falling back to reading each d/l mode");
+        return false;
+    }
+
+    if (resp.status != PM3_SUCCESS || resp.length != sizeof(t55xx_probe_reply_t)) {
+        return false;
+    }
+
+    memcpy(hints, ((t55xx_probe_reply_t *)resp.data.asBytes)->hints, sizeof(((t55xx_probe_reply_t *)0)->hints));
+    for (uint8_t m = 0; m < 4; m++) {
+        PrintAndLogEx(DEBUG, "d/l mode %u: noise %u  fc %u/%u rf/%u  ask %d  nrz %d  psk %d"
+                      , m
+                      , hints[m].noise
+                      , hints[m].fc_high
+                      , hints[m].fc_low
+                      , hints[m].fsk_clock
+                      , hints[m].ask_clock
+                      , hints[m].nrz_clock
+                      , hints[m].psk_clock
+                     );
+    }
+    return true;
+}
+
 static int CmdT55xxDetect(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf t55xx detect",
@@ -1248,8 +1647,21 @@ static int CmdT55xxDetect(const char *Cmd) {
             // do ... while to check without password then loop back if password supplied
             do {
                 if (try_all_dl_modes) {
+
+                    // without a wake up the device checks all d/l modes in one go,
+                    // and only the ones that answered are downloaded
+                    t55xx_probe_hint_t hints[4];
+                    bool probed = false;
+                    if (usewake == false) {
+                        probed = t55xx_probe((try_with_pwd && usepwd), password, hints);
+                    }
+
                     // Loop from 1st d/l mode refFixedBit to the last d/l mode ref1of4
                     for (uint8_t m = refFixedBit; m <= ref1of4; m++) {
+                        if (probed && hints[m].noise) {
+                            continue;
+                        }
+
                         if (usewake) {
                             // call wake
                             if (try_with_pwd)
@@ -1263,7 +1675,7 @@ static int CmdT55xxDetect(const char *Cmd) {
                         if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, (try_with_pwd && usepwd), password, m) == false)
                             continue;
 
-                        if (t55xxTryDetectModulationEx(m, T55XX_PrintConfig, 0, (try_with_pwd && usepwd) ? password : -1) == false)
+                        if (t55xx_try_detect_hint(m, T55XX_PrintConfig, 0, (try_with_pwd && usepwd) ? password : -1, (probed) ? &hints[m] : NULL) == false)
                             continue;
 
                         found = true;
@@ -1316,12 +1728,22 @@ bool t55xxTryDetectModulation(uint8_t downlink_mode, bool print_config) {
 }
 
 bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32_t wanted_conf, uint64_t pwd) {
+    return t55xx_try_detect_hint(downlink_mode, print_config, wanted_conf, pwd, NULL);
+}
+
+// with a device probe hint, demodulations whose clock the device didn't find are skipped
+static bool t55xx_try_detect_hint(uint8_t downlink_mode, bool print_config, uint32_t wanted_conf, uint64_t pwd, const t55xx_probe_hint_t *hint) {
 
     t55xx_conf_block_t tests[15];
     int bitRate = 0, clk = 0, firstClockEdge = 0;
     uint8_t hits = 0, fc1 = 0, fc2 = 0, ans = 0;
+    bool skipped = false;
 
-    ans = fskClocks(&fc1, &fc2, (uint8_t *)&clk, &firstClockEdge);
+    if (hint && hint->fsk_clock == 0) {
+        skipped = true;
+    } else {
+        ans = fskClocks(&fc1, &fc2, (uint8_t *)&clk, &firstClockEdge);
+    }
 
     if (ans && ((fc1 == 10 && fc2 == 8) || (fc1 == 8 && fc2 == 5))) {
         if ((FSKrawDemod(0, 0, 0, 0, false) == PM3_SUCCESS) && test(DEMOD_FSK, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
@@ -1351,7 +1773,12 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
             ++hits;
         }
     } else {
-        clk = GetAskClock("", false);
+        clk = 0;
+        if (hint && hint->ask_clock <= 0) {
+            skipped = true;
+        } else {
+            clk = GetAskClock("", false);
+        }
         if (clk > 0) {
             tests[hits].ST = true;
             // "0 0 1 " == clock auto, invert false, maxError 1.
@@ -1400,7 +1827,12 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
                 ++hits;
             }
         }
-        clk = GetNrzClock("", false);
+        clk = 0;
+        if (hint && hint->nrz_clock <= 8) {
+            skipped = true;
+        } else {
+            clk = GetNrzClock("", false);
+        }
         if (clk > 8) { //clock of rf/8 is likely a false positive, so don't use it.
             if ((NRZrawDemod(0, 0, 1, false) == PM3_SUCCESS) && test(DEMOD_NRZ, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
                 tests[hits].modulation = DEMOD_NRZ;
@@ -1423,7 +1855,12 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
             }
         }
 
-        clk = GetPskClock("", false);
+        clk = 0;
+        if (hint && hint->psk_clock <= 0) {
+            skipped = true;
+        } else {
+            clk = GetPskClock("", false);
+        }
         if (clk > 0) {
             // allow undo
             buffer_savestate_t saveState = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
@@ -1482,6 +1919,12 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
             // t55xx_search_config_psk(g_GraphBuffer, 2);
         }
     }
+
+    // the device and the client may disagree on a borderline signal, try everything before giving up
+    if (hits == 0 && skipped) {
+        return t55xx_try_detect_hint(downlink_mode, print_config, wanted_conf, pwd, NULL);
+    }
+
     if (hits == 1) {
         config.modulation = tests[0].modulation;
         config.bitrate = tests[0].bitrate;
@@ -2526,6 +2969,98 @@ static int CmdT55xxInfo(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Reads the blocks in 'blocks' (bit 0-7 page 0, bit 8-11 page 1) with CMD_LF_T55XX_DUMP,
+// as many per round trip as the device BigBuf holds, and demodulates them with the current config.
+// 'ok' gets the blocks that decoded.  Returns false when the device doesn't answer.
+static bool t55xx_dump_batch(bool usepwd, uint32_t password, uint8_t downlink_mode, uint16_t blocks, uint16_t *ok) {
+
+    uint8_t bitRate[8] = {8, 16, 32, 40, 50, 64, 100, 128};
+    int clk = bitRate[config.bitrate & 7];
+
+    // enough for the block behind the detected offset, twice over
+    t55xx_dump_t payload = {
+        .pwd = password,
+        .flags = (usepwd) ? 1 : 0,
+        .downlink_mode = downlink_mode,
+        .samples = MIN(12000, (config.offset + 80) * clk),
+        .blocks = blocks,
+    };
+
+    uint8_t *got = calloc(g_pm3_capabilities.bigbuf_size, sizeof(uint8_t));
+    if (got == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return false;
+    }
+
+    *ok = 0;
+    config.usepwd = usepwd;
+
+    while (payload.blocks) {
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_LF_T55XX_DUMP, (uint8_t *)&payload, sizeof(payload));
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_LF_T55XX_DUMP, &resp, 5000) == false) {
+            PrintAndLogEx(DEBUG, "dump timeout, falling back to reading block by block");
+            free(got);
+            return false;
+        }
+
+        if (resp.status != PM3_SUCCESS || resp.length != sizeof(t55xx_dump_reply_t)) {
+            free(got);
+            return false;
+        }
+
+        const t55xx_dump_reply_t *r = (t55xx_dump_reply_t *)resp.data.asBytes;
+        uint16_t captured = r->blocks & payload.blocks;
+        if (captured == 0) {
+            break;
+        }
+
+        uint32_t samples = r->samples;
+        uint32_t n = 0;
+        for (uint8_t b = 0; b < 12; b++) {
+            if (captured & (1 << b)) {
+                n++;
+            }
+        }
+
+        // all captures of the round trip in one download
+        if (r->offset + (n * samples) > g_pm3_capabilities.bigbuf_size ||
+                GetFromDevice(BIG_BUF, got, n * samples, r->offset, NULL, 0, NULL, 10000, false) == false) {
+            PrintAndLogEx(WARNING, "timeout while waiting for reply");
+            free(got);
+            return false;
+        }
+
+        uint32_t slot = 0;
+        for (uint8_t b = 0; b < 12; b++) {
+            if ((captured & (1 << b)) == 0) {
+                continue;
+            }
+
+            if (b == 0 || b == 8) {
+                printT5xxHeader(b >= 8);
+            }
+
+            getSamplesFromBufEx(got + (slot * samples), samples, 8, false);
+            slot++;
+
+            if (getSignalProperties()->isnoise || DecodeT55xxBlock() == false) {
+                continue;
+            }
+
+            printT55xxBlock(b & 7, (b >= 8));
+            *ok |= (1 << b);
+        }
+
+        payload.blocks &= ~captured;
+    }
+
+    free(got);
+    return true;
+}
+
 static int CmdT55xxDump(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -2595,23 +3130,38 @@ static int CmdT55xxDump(const char *Cmd) {
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(INFO, "------------------------- " _CYAN_("T55xx tag memory") " -----------------------------");
 
+    // the safety check once for the whole dump, instead of before every block
+    if (usepwd) {
+        res = t55xx_pwd_safety_check(override, password, downlink_mode, &usepwd);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        override = 2;
+    }
+
     // Due to the few different T55xx cards and number of blocks supported
     // will save the dump file if ALL page 0 is OK
-    printT5xxHeader(0);
-    for (uint8_t i = 0; i < 8; ++i) {
-        if (T55xxReadBlock(i, 0, usepwd, override, password, downlink_mode) != PM3_SUCCESS) {
-            success = false;
+    uint16_t ok = 0;
+    if (t55xx_dump_batch(usepwd, password, downlink_mode, 0x0FFF, &ok)) {
+        // the blocks printed as they decoded
+        success = ((ok & 0xFF) == 0xFF);
+        for (uint8_t i = 0; i < 4; i++) {
+            if ((ok & (1 << (8 + i))) == 0) {
+                T55x7_SaveBlockData(8 + i, 0x00);
+            }
         }
-
-        // only show override warning on the first block read
-        if (override == 1) {
-            override++;
+    } else {
+        printT5xxHeader(0);
+        for (uint8_t i = 0; i < 8; ++i) {
+            if (T55xxReadBlock(i, 0, usepwd, override, password, downlink_mode) != PM3_SUCCESS) {
+                success = false;
+            }
         }
-    }
-    printT5xxHeader(1);
-    for (uint8_t i = 0; i < 4; i++) {
-        if (T55xxReadBlock(i, 1, usepwd, override, password, downlink_mode) != PM3_SUCCESS) {
-            T55x7_SaveBlockData(8 + i, 0x00);
+        printT5xxHeader(1);
+        for (uint8_t i = 0; i < 4; i++) {
+            if (T55xxReadBlock(i, 1, usepwd, override, password, downlink_mode) != PM3_SUCCESS) {
+                T55x7_SaveBlockData(8 + i, 0x00);
+            }
         }
     }
 
@@ -3553,23 +4103,124 @@ out:
     return PM3_SUCCESS;
 }
 
+// Runs CMD_LF_T55XX_BRUTE over the range and validates the candidates it stops at,
+// resuming after each false one with the timings the device tuned.
+// PM3_SUCCESS with the password, PM3_ENODATA when the range holds none.
+static int t55xx_brute_device(uint32_t start, uint32_t end, uint8_t downlink_mode, uint32_t *password) {
+
+    t55xx_brute_t params = {
+        .start = start,
+        .end = end,
+        .flags = downlink_mode << 3,
+    };
+
+    uint32_t tried = 0;
+    uint32_t candidates = 0;
+
+    for (;;) {
+        clearCommandBuffer();
+        SendCommandNG(CMD_LF_T55XX_BRUTE, (uint8_t *)&params, sizeof(params));
+
+        PacketResponseNG resp;
+        uint8_t timeout = 0;
+        for (;;) {
+            if (kbd_enter_pressed()) {
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(INFO, "Aborted, resume with " _YELLOW_("-s %08X"), params.start);
+                return PM3_EOPABORTED;
+            }
+
+            if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 1000) == false) {
+                // tuning takes a few seconds before the first progress
+                if (++timeout > 30) {
+                    PrintAndLogEx(WARNING, "\nNo response from Proxmark3. Aborting...");
+                    PrintAndLogEx(INFO, "Resume with " _YELLOW_("-s %08X"), params.start);
+                    return PM3_ETIMEOUT;
+                }
+                continue;
+            }
+
+            if (resp.cmd == CMD_LF_T55XX_BRUTE_PROGRESS) {
+                const t55xx_brute_reply_t *progress = (const t55xx_brute_reply_t *)resp.data.asBytes;
+                params.start = progress->password;
+                PrintAndLogEx(INPLACE, "Trying password " _YELLOW_("%08X") " ( %u tried, %u candidates )"
+                              , progress->password
+                              , tried + progress->tried
+                              , candidates
+                             );
+                timeout = 0;
+                continue;
+            }
+
+            if (resp.cmd == CMD_LF_T55XX_BRUTE) {
+                break;
+            }
+        }
+
+        const t55xx_brute_reply_t *reply = (const t55xx_brute_reply_t *)resp.data.asBytes;
+        if (resp.status == PM3_EOPABORTED) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(INFO, "Aborted, resume with " _YELLOW_("-s %08X"), reply->password);
+            return PM3_EOPABORTED;
+        }
+        if (resp.status != PM3_SUCCESS) {
+            return resp.status;
+        }
+
+        tried += reply->tried;
+        if (tried == reply->tried) {
+            PrintAndLogEx(DEBUG, "Device tuned read gap " _YELLOW_("%u") " us, " _YELLOW_("%u") " samples"
+                          , reply->params.read_gap
+                          , reply->params.samples
+                         );
+        }
+
+        if (reply->found == false) {
+            PrintAndLogEx(NORMAL, "");
+            return PM3_ENODATA;
+        }
+
+        // the signal check is cheap, the demodulation decides
+        candidates++;
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "Candidate [ " _YELLOW_("%08X") " ]", reply->password);
+        if (t55xx_try_one_password(reply->password, downlink_mode, false)) {
+            *password = reply->password;
+            return PM3_SUCCESS;
+        }
+
+        if (reply->password == end) {
+            return PM3_ENODATA;
+        }
+
+        // resume after it, with the tuned timings
+        params = reply->params;
+        params.start = reply->password + 1;
+    }
+}
+
 // Bruteforce - incremental password range search
 static int CmdT55xxBruteForce(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf t55xx bruteforce",
                   "This command uses bruteforce to scan a number range.\n"
-                  "Try reading Page 0, block 7 before.\n\n"
+                  "Try reading Page 0, block 7 before.\n"
+                  "With '--dev' the device tunes its read timing, tries the range on its own\n"
+                  "and only stops for candidates, which the client validates.\n\n"
                   _RED_("WARNING") _CYAN_(" this may brick non-password protected chips!"),
                   "lf t55xx bruteforce --r2 -s aaaaaa77 -e aaaaaa99\n"
+                  "lf t55xx bruteforce --dev -s aaaa0000 -e aaaaffff    -> search on the device"
                  );
 
-    // 1 (help) + 2 (two user specified params) + (6 T55XX_DLMODE_ALL)
-    void *argtable[3 + 6] = {
+    // 1 (help) + 3 (three user specified params) + (6 T55XX_DLMODE_ALL)
+    void *argtable[4 + 6] = {
         arg_param_begin,
         arg_str1("s", "start", "<hex>", "search start password (4 hex bytes)"),
         arg_str1("e", "end", "<hex>", "search end password (4 hex bytes)"),
+        arg_lit0(NULL, "dev", "search on the device, only candidates are validated by the client"),
     };
-    uint8_t idx = 3;
+    uint8_t idx = 4;
     arg_add_t55xx_downloadlink(argtable, &idx, T55XX_DLMODE_ALL, T55XX_DLMODE_ALL);
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
@@ -3589,11 +4240,12 @@ static int CmdT55xxBruteForce(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    bool r0 = arg_get_lit(ctx, 3);
-    bool r1 = arg_get_lit(ctx, 4);
-    bool r2 = arg_get_lit(ctx, 5);
-    bool r3 = arg_get_lit(ctx, 6);
-    bool ra = arg_get_lit(ctx, 7);
+    bool on_device = arg_get_lit(ctx, 3);
+    bool r0 = arg_get_lit(ctx, 4);
+    bool r1 = arg_get_lit(ctx, 5);
+    bool r2 = arg_get_lit(ctx, 6);
+    bool r3 = arg_get_lit(ctx, 7);
+    bool ra = arg_get_lit(ctx, 8);
     CLIParserFree(ctx);
 
     if ((r0 + r1 + r2 + r3 + ra) > 1) {
@@ -3625,6 +4277,33 @@ static int CmdT55xxBruteForce(const char *Cmd) {
     PrintAndLogEx(INFO, "Search password range [%08X -> %08X]", start_password, end_password);
 
     uint64_t t1 = msclock();
+
+    if (on_device) {
+        // each downlink mode searches the whole range, when trying them all
+        for (uint8_t dl_mode = downlink_mode; dl_mode < 4 && found == 0; dl_mode++) {
+            res = t55xx_brute_device(start_password, end_password, dl_mode, &curr);
+            if (res == PM3_SUCCESS) {
+                found = 1 + (dl_mode << 1);
+            } else if (res != PM3_ENODATA) {
+                return res;
+            }
+            if (ra == false) {
+                break;
+            }
+        }
+
+        if (found) {
+            PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", curr);
+            T55xx_Print_DownlinkMode((found >> 1) & 3);
+        } else {
+            PrintAndLogEx(WARNING, "Bruteforce failed");
+        }
+
+        t1 = msclock() - t1;
+        PrintAndLogEx(SUCCESS, "\ntime in bruteforce " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
+        return PM3_SUCCESS;
+    }
+
     curr = start_password;
 
     while (found == 0) {
@@ -4701,6 +5380,8 @@ static command_t CommandTable[] = {
     {"",             CmdHelp,                 AlwaysAvailable, ""},
     {"help",         CmdHelp,                 AlwaysAvailable, "This help"},
     {"-----------",  CmdHelp,                 AlwaysAvailable, "--------------------- " _CYAN_("operations") " ---------------------"},
+    {"clone",        CmdT55xxClone,           IfPm3Lf,         "Write and verify page 0 blocks, optionally on every tag placed"},
+    {"clonequeue",   CmdT55xxCloneQueue,      IfPm3Lf,         "Clone a list of credentials, one per tag placed"},
     {"clonehelp",    CmdT55xxCloneHelp,       IfPm3Lf,         "Shows the available clone commands"},
     {"config",       CmdT55xxSetConfig,       AlwaysAvailable, "Set/Get T55XX configuration (modulation, inverted, offset, rate)"},
     {"dangerraw",    CmdT55xxDangerousRaw,    IfPm3Lf,         "Sends raw bitstream. Dangerous, do not use!!"},
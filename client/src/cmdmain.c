@@ -369,8 +369,31 @@ static int CmdHelp(const char *Cmd) {
 // Entry point into our code: called whenever the user types a command and
 // then presses Enter, which the full command line that they typed.
 //-----------------------------------------------------------------------------
+static int cmd_depth = 0;
+
 int CommandReceived(const char *Cmd) {
-    return CmdsParse(CommandTable, Cmd);
+    // with the MQTT sink running, the results of every command are collected and published,
+    // nested commands (scripts) publish their own results
+    bool sink = mqtt_sink_active();
+    uint8_t prev_printAndLog = g_printAndLog;
+    if (sink && cmd_depth == 0) {
+        g_printAndLog |= PRINTANDLOG_RESULT;
+        result_clear();
+    }
+
+    cmd_depth++;
+    int res = CmdsParse(CommandTable, Cmd);
+    cmd_depth--;
+
+    if (sink) {
+        mqtt_sink_push(Cmd, res);
+        if (cmd_depth) {
+            result_clear();
+        } else if ((prev_printAndLog & PRINTANDLOG_RESULT) == 0) {
+            g_printAndLog &= ~PRINTANDLOG_RESULT;
+        }
+    }
+    return res;
 }
 
 command_t *getTopLevelCommandTable(void) {
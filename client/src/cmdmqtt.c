@@ -29,6 +29,10 @@
 #endif
 #include "util_posix.h"  // time
 #include "fileutils.h"
+#include "ui.h"           // result_get
+#include "jansson.h"
+#include <inttypes.h>
+#include <time.h>
 
 #define MQTT_BUFFER_SIZE    ( 1 << 16 )
 
@@ -111,6 +115,416 @@ static void mqtt_reconnect_client(struct mqtt_client* client, void **reconnect_s
 }
 */
 
+// Session MQTT sink.
+// While started, the structured results of every command are queued as records and a worker
+// thread publishes them in batches, one JSON message per batch. The worker owns the MQTT client
+// and reconnects on its own, the command path only appends to the queue and never waits on
+// the broker. When the queue is full new records are dropped and counted.
+#define MQTT_SINK_QUEUE_SIZE     4096
+#define MQTT_SINK_RECONNECT_MS   2000
+
+typedef struct {
+    char addr[256];
+    char port[10 + 1];
+    char topic[128];
+    char cid[20];
+    uint8_t qos;
+    uint32_t batch;
+    uint32_t interval;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    char *queue[MQTT_SINK_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+
+    uint64_t records;
+    uint64_t messages;
+    uint64_t dropped;
+    uint32_t reconnects;
+    uint64_t last_attempt;
+
+    struct mqtt_client client;
+    uint8_t *sendbuf;
+    uint8_t *recvbuf;
+} mqtt_sink_t;
+
+static mqtt_sink_t *g_sink = NULL;
+static volatile bool g_sink_running = false;
+
+static void mqtt_sink_reconnect(struct mqtt_client *client, void **state) {
+    mqtt_sink_t *sink = *((mqtt_sink_t **) state);
+
+    // the client stays in its error state until a connection works, mqtt_sync() calls back
+    uint64_t now = msclock();
+    if (client->error != MQTT_ERROR_INITIAL_RECONNECT && now - sink->last_attempt < MQTT_SINK_RECONNECT_MS) {
+        return;
+    }
+    sink->last_attempt = now;
+
+    if (client->socketfd != (mqtt_pal_socket_handle) - 1) {
+        close_nb_socket(client->socketfd);
+        client->socketfd = (mqtt_pal_socket_handle) - 1;
+    }
+
+    if (client->error != MQTT_ERROR_INITIAL_RECONNECT) {
+        sink->reconnects++;
+        PrintAndLogEx(DEBUG, "mqtt sink: reconnecting after `%s`", mqtt_error_str(client->error));
+    }
+
+    mqtt_pal_socket_handle sockfd = open_nb_socket(sink->addr, sink->port);
+    if (sockfd == (mqtt_pal_socket_handle) - 1) {
+        return;
+    }
+
+    mqtt_reinit(client, sockfd, sink->sendbuf, MQTT_BUFFER_SIZE, sink->recvbuf, MQTT_BUFFER_SIZE);
+    mqtt_connect(client, sink->cid, NULL, NULL, 0, NULL, NULL, MQTT_CONNECT_CLEAN_SESSION, 400);
+}
+
+// publish up to one batch, records leave the queue once the client took the message
+static void mqtt_sink_flush(mqtt_sink_t *sink) {
+    pthread_mutex_lock(&sink->lock);
+    size_t n = MIN(sink->count, sink->batch);
+    size_t head = sink->head;
+    pthread_mutex_unlock(&sink->lock);
+
+    if (n == 0 || sink->client.error != MQTT_OK) {
+        return;
+    }
+
+    // queued records are not touched by producers, no need to hold the lock while packing
+    size_t maxlen = MQTT_BUFFER_SIZE / 2;
+    size_t len = snprintf(NULL, 0, "{\"client\":\"%s\",\"records\":[]}", sink->cid);
+    size_t used = 0;
+    for (; used < n; used++) {
+        size_t rlen = strlen(sink->queue[(head + used) % MQTT_SINK_QUEUE_SIZE]) + 1;
+        if (used && len + rlen > maxlen) {
+            break;
+        }
+        len += rlen;
+    }
+
+    char *msg = calloc(len + 1, sizeof(char));
+    if (msg == NULL) {
+        return;
+    }
+
+    size_t off = sprintf(msg, "{\"client\":\"%s\",\"records\":[", sink->cid);
+    for (size_t i = 0; i < used; i++) {
+        off += sprintf(msg + off, "%s%s", (i) ? "," : "", sink->queue[(head + i) % MQTT_SINK_QUEUE_SIZE]);
+    }
+    off += sprintf(msg + off, "]}");
+
+    // a slow broker keeps the send buffer busy, try again on the next round
+    mqtt_mq_clean(&sink->client.mq);
+    if (mqtt_mq_currsz(&sink->client.mq) < off + 256) {
+        free(msg);
+        return;
+    }
+
+    static const uint8_t qos_flags[] = { MQTT_PUBLISH_QOS_0, MQTT_PUBLISH_QOS_1, MQTT_PUBLISH_QOS_2 };
+    enum MQTTErrors res = mqtt_publish(&sink->client, sink->topic, msg, off, qos_flags[sink->qos]);
+    free(msg);
+    if (res != MQTT_OK) {
+        return;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    for (size_t i = 0; i < used; i++) {
+        free(sink->queue[sink->head]);
+        sink->queue[sink->head] = NULL;
+        sink->head = (sink->head + 1) % MQTT_SINK_QUEUE_SIZE;
+    }
+    sink->count -= used;
+    sink->records += used;
+    sink->messages++;
+    pthread_mutex_unlock(&sink->lock);
+}
+
+static void *mqtt_sink_worker(void *arg) {
+    mqtt_sink_t *sink = arg;
+    uint64_t last_flush = msclock();
+
+    while (g_sink_running) {
+        mqtt_sync(&sink->client);
+
+        pthread_mutex_lock(&sink->lock);
+        size_t count = sink->count;
+        pthread_mutex_unlock(&sink->lock);
+
+        uint64_t now = msclock();
+        if (count >= sink->batch || (count && now - last_flush >= sink->interval)) {
+            mqtt_sink_flush(sink);
+            last_flush = now;
+        }
+        msleep(20);
+    }
+
+    // last chance for what is still queued
+    for (int i = 0; i < 50 && sink->count && sink->client.error == MQTT_OK; i++) {
+        mqtt_sink_flush(sink);
+        mqtt_sync(&sink->client);
+        msleep(20);
+    }
+    mqtt_sync(&sink->client);
+    return NULL;
+}
+
+static void mqtt_sink_free(mqtt_sink_t *sink) {
+    if (sink->client.socketfd != (mqtt_pal_socket_handle) - 1) {
+        close_nb_socket(sink->client.socketfd);
+    }
+    for (size_t i = 0; i < MQTT_SINK_QUEUE_SIZE; i++) {
+        free(sink->queue[i]);
+    }
+    pthread_mutex_destroy(&sink->lock);
+    free(sink->sendbuf);
+    free(sink->recvbuf);
+    free(sink);
+}
+
+static void mqtt_sink_stop(void) {
+    if (g_sink == NULL) {
+        return;
+    }
+
+    g_sink_running = false;
+    pthread_join(g_sink->thread, NULL);
+
+    if (g_sink->count) {
+        PrintAndLogEx(WARNING, "mqtt sink: " _YELLOW_("%zu") " records not published", g_sink->count);
+    }
+    mqtt_sink_free(g_sink);
+    g_sink = NULL;
+}
+
+static int mqtt_sink_start(const char *addr, const char *port, const char *topic, uint8_t qos, uint32_t batch, uint32_t interval) {
+    mqtt_sink_t *sink = calloc(1, sizeof(mqtt_sink_t));
+    if (sink == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    sink->sendbuf = calloc(MQTT_BUFFER_SIZE, sizeof(uint8_t));
+    sink->recvbuf = calloc(MQTT_BUFFER_SIZE, sizeof(uint8_t));
+    if (sink->sendbuf == NULL || sink->recvbuf == NULL) {
+        free(sink->sendbuf);
+        free(sink->recvbuf);
+        free(sink);
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    snprintf(sink->addr, sizeof(sink->addr), "%s", addr);
+    snprintf(sink->port, sizeof(sink->port), "%s", port);
+    snprintf(sink->topic, sizeof(sink->topic), "%s", topic);
+    snprintf(sink->cid, sizeof(sink->cid), "pm3_%02x%02x%02x%02x"
+             , rand() % 0xFF
+             , rand() % 0xFF
+             , rand() % 0xFF
+             , rand() % 0xFF
+            );
+    sink->qos = qos;
+    sink->batch = batch;
+    sink->interval = interval;
+    pthread_mutex_init(&sink->lock, NULL);
+
+    // the worker makes the first connection, a broker that is down does not stall the client
+    mqtt_init_reconnect(&sink->client, mqtt_sink_reconnect, sink, mqtt_publish_callback);
+
+    g_sink_running = true;
+    if (pthread_create(&sink->thread, NULL, mqtt_sink_worker, sink)) {
+        g_sink_running = false;
+        mqtt_sink_free(sink);
+        PrintAndLogEx(FAILED, "Failed to start client daemon");
+        return PM3_ESOFT;
+    }
+
+    static bool registered = false;
+    if (registered == false) {
+        atexit(mqtt_sink_stop);
+        registered = true;
+    }
+
+    g_sink = sink;
+    return PM3_SUCCESS;
+}
+
+bool mqtt_sink_active(void) {
+    return g_sink_running;
+}
+
+void mqtt_sink_push(const char *cmd, int status) {
+    mqtt_sink_t *sink = g_sink;
+    if (sink == NULL || g_sink_running == false) {
+        return;
+    }
+
+    const char *result = result_get();
+    if (strcmp(result, "{}") == 0) {
+        return;
+    }
+
+    json_t *jcmd = json_string(cmd);
+    char *cmd_str = json_dumps(jcmd, JSON_ENCODE_ANY);
+    json_decref(jcmd);
+    if (cmd_str == NULL) {
+        return;
+    }
+
+    size_t len = strlen(cmd_str) + strlen(result) + 80;
+    char *rec = calloc(len, sizeof(char));
+    if (rec) {
+        snprintf(rec, len, "{\"ts\":%" PRIu64 ",\"cmd\":%s,\"status\":%d,\"result\":%s}", (uint64_t)time(NULL), cmd_str, status, result);
+    }
+    free(cmd_str);
+    if (rec == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    if (sink->count < MQTT_SINK_QUEUE_SIZE) {
+        sink->queue[(sink->head + sink->count) % MQTT_SINK_QUEUE_SIZE] = rec;
+        sink->count++;
+        rec = NULL;
+    } else {
+        sink->dropped++;
+    }
+    pthread_mutex_unlock(&sink->lock);
+    free(rec);
+}
+
+static int CmdMqttSink(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "mqtt sink",
+                  "Publish the results of every command (UIDs, IDs, keys...) to a MQTT topic while the sink runs.\n"
+                  "Records are batched into one JSON message and published in the background,\n"
+                  "the connection is kept open and reestablished when it drops.\n"
+                  "Without options it shows the sink status.\n"
+                  "Default server:  proxdump.com:1883  topic: proxdump\n",
+                  "mqtt sink --start                                   --> publish to default server/port/topic\n"
+                  "mqtt sink --start --addr 10.0.0.5 --topic fleet/r1 --qos 1 --batch 64 --interval 500\n"
+                  "mqtt sink                                           --> show status\n"
+                  "mqtt sink --stop\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "start", "start the sink"),
+        arg_lit0(NULL, "stop", "stop the sink, publishing what is still queued"),
+        arg_str0(NULL, "addr", "<str>", "MQTT server address"),
+        arg_str0("p", "port", "<str>", "MQTT server port"),
+        arg_str0(NULL, "topic", "<str>", "MQTT topic"),
+        arg_int0(NULL, "qos", "<0-2>", "MQTT QoS level (def 0)"),
+        arg_u64_0(NULL, "batch", "<dec>", "records per message (def 32)"),
+        arg_u64_0(NULL, "interval", "<ms>", "publish a partial batch after this time (def 1000 ms)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    bool start = arg_get_lit(ctx, 1);
+    bool stop = arg_get_lit(ctx, 2);
+
+    int alen = 0;
+    char addr[256] = {0x00};
+    int res = CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)addr, sizeof(addr), &alen);
+
+    int plen = 0;
+    char port[10 + 1] = {0x00};
+    res |= CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)port, sizeof(port), &plen);
+
+    int tlen = 0;
+    char topic[128] = {0x00};
+    res |= CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)topic, sizeof(topic), &tlen);
+
+    int qos = arg_get_int_def(ctx, 6, 0);
+    uint32_t batch = arg_get_u32_def(ctx, 7, 32);
+    uint32_t interval = arg_get_u32_def(ctx, 8, 1000);
+    CLIParserFree(ctx);
+
+    if (res) {
+        PrintAndLogEx(FAILED, "Error parsing input strings");
+        return PM3_EINVARG;
+    }
+
+    if (start && stop) {
+        PrintAndLogEx(FAILED, "Can't use both --start and --stop");
+        return PM3_EINVARG;
+    }
+
+    if (qos < 0 || qos > 2) {
+        PrintAndLogEx(FAILED, "QoS must be 0, 1 or 2");
+        return PM3_EINVARG;
+    }
+
+    if (batch == 0 || batch > MQTT_SINK_QUEUE_SIZE) {
+        PrintAndLogEx(FAILED, "batch must be 1 - %u", MQTT_SINK_QUEUE_SIZE);
+        return PM3_EINVARG;
+    }
+
+    if (stop) {
+        if (g_sink == NULL) {
+            PrintAndLogEx(INFO, "mqtt sink is not running");
+            return PM3_SUCCESS;
+        }
+        mqtt_sink_stop();
+        PrintAndLogEx(INFO, "mqtt sink stopped");
+        return PM3_SUCCESS;
+    }
+
+    if (start) {
+        if (g_sink) {
+            PrintAndLogEx(WARNING, "mqtt sink already running, stop it first");
+            return PM3_EINVARG;
+        }
+
+        if (alen == 0) {
+            if (strlen(g_session.mqtt_server)) {
+                strcpy(addr, g_session.mqtt_server);
+            } else {
+                strcpy(addr, "proxdump.com");
+            }
+        }
+
+        if (plen == 0) {
+            if (strlen(g_session.mqtt_port)) {
+                strcpy(port, g_session.mqtt_port);
+            } else {
+                strcpy(port, "1883");
+            }
+        }
+
+        if (tlen == 0) {
+            if (strlen(g_session.mqtt_topic)) {
+                strcpy(topic, g_session.mqtt_topic);
+            } else {
+                strcpy(topic, "proxdump");
+            }
+        }
+
+        res = mqtt_sink_start(addr, port, topic, qos, batch, interval);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        PrintAndLogEx(INFO, _CYAN_("%s") " publishing results to " _CYAN_("%s:%s/%s"), g_sink->cid, addr, port, topic);
+        return PM3_SUCCESS;
+    }
+
+    if (g_sink == NULL) {
+        PrintAndLogEx(INFO, "mqtt sink is not running");
+        return PM3_SUCCESS;
+    }
+
+    pthread_mutex_lock(&g_sink->lock);
+    PrintAndLogEx(INFO, "Client...... " _CYAN_("%s") " -> " _CYAN_("%s:%s/%s") " QoS %u", g_sink->cid, g_sink->addr, g_sink->port, g_sink->topic, g_sink->qos);
+    PrintAndLogEx(INFO, "Connection.. %s ( reconnects %u )", (g_sink->client.error == MQTT_OK) ? _GREEN_("up") : _RED_("down"), g_sink->reconnects);
+    PrintAndLogEx(INFO, "Published... %" PRIu64 " records in %" PRIu64 " messages", g_sink->records, g_sink->messages);
+    PrintAndLogEx(INFO, "Queued...... %zu", g_sink->count);
+    PrintAndLogEx(INFO, "Dropped..... %" PRIu64, g_sink->dropped);
+    pthread_mutex_unlock(&g_sink->lock);
+    return PM3_SUCCESS;
+}
+
 static int mqtt_receive(const char *addr, const char *port, const char *topic, const char *fn) {
     // open the non-blocking TCP socket (connecting to the broker)
     mqtt_pal_socket_handle sockfd = open_nb_socket(addr, port);
@@ -407,6 +821,7 @@ static command_t CommandTable[] = {
     {"help",     CmdHelp,          AlwaysAvailable, "This help"},
     {"send",     CmdMqttSend,      AlwaysAvailable, "Send messages or json file over MQTT"},
     {"receive",  CmdMqttReceive,   AlwaysAvailable, "Receive message or json file over MQTT"},
+    {"sink",     CmdMqttSink,      AlwaysAvailable, "Publish the results of all commands over MQTT"},
     {NULL, NULL, NULL, NULL}
 };
 
@@ -23,4 +23,8 @@
 
 int CmdMqtt(const char *Cmd);
 
+// session sink started by `mqtt sink`, publishes the structured results of commands
+bool mqtt_sink_active(void);
+void mqtt_sink_push(const char *cmd, int status);
+
 #endif
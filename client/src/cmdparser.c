@@ -22,15 +22,24 @@
 #include <string.h>
 #include <pthread.h>      // spinlock
 #include <stdlib.h>       // system
+#include <inttypes.h>     // PRIu64
 #include "ui.h"
 #include "comms.h"
-#include "util_posix.h" // msleep
+#include "util_posix.h" // msleep, usclock
 
 #if defined(__MACH__) && defined(__APPLE__)
 # include "pthread_spin_lock_shim.h"  // spinlock shim for OSX ..
 #endif
 
 #define MAX_PM3_INPUT_ARGS_LENGTH    4096
+#define CMD_STATS_MAX                128
+
+static cmd_stats_t cmd_stats[CMD_STATS_MAX];
+static size_t cmd_stats_count = 0;
+static uint32_t cmd_stats_depth = 0;
+
+// full name of the command being parsed, built while descending the command tables
+static char cmd_path[sizeof(cmd_stats[0].name)] = {0};
 
 bool AlwaysAvailable(void) {
     return true;
@@ -247,31 +256,227 @@ static int execute_system_command(const char *command) {
 }
 
 
-int CmdsParse(const command_t Commands[], const char *Cmd) {
+// Sorted index of a command table, built the first time the table is parsed. Exact and
+// prefix lookups become binary searches, duplicated names keep the table order.
+#define CMD_INDEX_SLOTS  512
 
-    if (g_session.client_exe_delay != 0) {
-        msleep(g_session.client_exe_delay);
+typedef struct {
+    const command_t *table;
+    uint16_t *order;
+    uint16_t count;
+} cmd_index_t;
+
+static cmd_index_t cmd_index[CMD_INDEX_SLOTS];
+static const command_t *cmd_index_sort_table;
+
+static int cmd_index_cmp(const void *a, const void *b) {
+    uint16_t x = *(const uint16_t *)a;
+    uint16_t y = *(const uint16_t *)b;
+    int res = strcmp(cmd_index_sort_table[x].Name, cmd_index_sort_table[y].Name);
+    if (res) {
+        return res;
     }
+    return (x < y) ? -1 : (x > y);
+}
 
-    // Help dump children
-    if (strcmp(Cmd, "XX_internal_command_dump_XX") == 0) {
-        dumpCommandsRecursive(Commands, 0, false);
-        return PM3_SUCCESS;
+// NULL when the index is full or out of memory, callers walk the table then
+static const cmd_index_t *cmd_index_get(const command_t *table) {
+    size_t slot = (((uintptr_t)table >> 4) * 2654435761u) % CMD_INDEX_SLOTS;
+    for (size_t n = 0; n < CMD_INDEX_SLOTS; n++, slot = (slot + 1) % CMD_INDEX_SLOTS) {
+        cmd_index_t *ix = &cmd_index[slot];
+        if (ix->table == table) {
+            return ix;
+        }
+        if (ix->table != NULL) {
+            continue;
+        }
+
+        uint16_t count = 0;
+        while (table[count].Name) {
+            count++;
+        }
+        uint16_t *order = calloc((count) ? count : 1, sizeof(uint16_t));
+        if (order == NULL) {
+            return NULL;
+        }
+        for (uint16_t i = 0; i < count; i++) {
+            order[i] = i;
+        }
+        cmd_index_sort_table = table;
+        qsort(order, count, sizeof(uint16_t), cmd_index_cmp);
+
+        ix->order = order;
+        ix->count = count;
+        ix->table = table;
+        return ix;
     }
-    // Help dump children with help
-    if (strcmp(Cmd, "XX_internal_command_dump_full_XX") == 0) {
-        dumpCommandsRecursive(Commands, 0, true);
-        return PM3_SUCCESS;
+    return NULL;
+}
+
+// first position whose name sorts at or after name
+static uint16_t cmd_index_lower_bound(const cmd_index_t *ix, const char *name) {
+    uint16_t lo = 0, hi = ix->count;
+    while (lo < hi) {
+        uint16_t mid = lo + ((hi - lo) / 2);
+        if (strcmp(ix->table[ix->order[mid]].Name, name) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    // Markdown help dump children
-    if (strcmp(Cmd, "XX_internal_command_dump_markdown_XX") == 0) {
-        dumpCommandsRecursive(Commands, 1, false);
-        return PM3_SUCCESS;
+    return lo;
+}
+
+// index of the command named name, or of the only available command it is a prefix of.
+// -1 if there is none
+static int cmd_lookup(const command_t Commands[], const char *name, int *exact) {
+    size_t len = strlen(name);
+    const cmd_index_t *ix = cmd_index_get(Commands);
+
+    *exact = -1;
+    if (ix) {
+        uint16_t pos = cmd_index_lower_bound(ix, name);
+        if (pos < ix->count && strcmp(Commands[ix->order[pos]].Name, name) == 0) {
+            *exact = ix->order[pos];
+            return *exact;
+        }
+
+        int last_match = -1, matches = 0;
+        for (; pos < ix->count && strncmp(Commands[ix->order[pos]].Name, name, len) == 0; pos++) {
+            if (Commands[ix->order[pos]].IsAvailable()) {
+                last_match = ix->order[pos];
+                matches++;
+            }
+        }
+        return (matches == 1) ? last_match : -1;
     }
-    // Markdown help dump children with help
-    if (strcmp(Cmd, "XX_internal_command_dump_markdown_help_XX") == 0) {
-        dumpCommandsRecursive(Commands, 1, true);
-        return PM3_SUCCESS;
+
+    for (int i = 0; Commands[i].Name; i++) {
+        if (strcmp(Commands[i].Name, name) == 0) {
+            *exact = i;
+            return i;
+        }
+    }
+
+    int last_match = -1, matches = 0;
+    for (int i = 0; Commands[i].Name; i++) {
+        if (strncmp(Commands[i].Name, name, len) == 0 && Commands[i].IsAvailable()) {
+            last_match = i;
+            matches++;
+        }
+    }
+    return (matches == 1) ? last_match : -1;
+}
+
+static cmd_stats_t *cmd_stats_get(const char *name) {
+    for (size_t i = 0; i < cmd_stats_count; i++) {
+        if (strcmp(cmd_stats[i].name, name) == 0) {
+            return &cmd_stats[i];
+        }
+    }
+    if (cmd_stats_count == CMD_STATS_MAX) {
+        return NULL;
+    }
+    cmd_stats_t *s = &cmd_stats[cmd_stats_count++];
+    memset(s, 0, sizeof(cmd_stats_t));
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    return s;
+}
+
+static void cmd_stats_print(const char *name, uint64_t wall_us, const comm_stats_t *c) {
+    PrintAndLogEx(INFO, "%s: " _YELLOW_("%.1f") " ms, host %.1f ms, waiting %.1f ms, %u round trips, tx %" PRIu64 " / rx %" PRIu64 " bytes"
+                  , name
+                  , wall_us / 1000.0
+                  , (wall_us - MIN(c->wait_us, wall_us)) / 1000.0
+                  , c->wait_us / 1000.0
+                  , c->round_trips
+                  , c->bytes_sent
+                  , c->bytes_recv
+                 );
+}
+
+// runs a command, adding its wall time and traffic to the stats of the current command path
+static int cmd_run_timed(const command_t *cmd, const char *args) {
+
+    char name[sizeof(cmd_path)];
+    memcpy(name, cmd_path, sizeof(name));
+
+    comm_stats_t before, after;
+    GetCommunicationStats(&before);
+    uint64_t t = usclock();
+
+    cmd_stats_depth++;
+    int res = cmd->Parse(args);
+    cmd_stats_depth--;
+
+    t = usclock() - t;
+    GetCommunicationStats(&after);
+
+    comm_stats_t d = {
+        .frames_sent = after.frames_sent - before.frames_sent,
+        .frames_recv = after.frames_recv - before.frames_recv,
+        .bytes_sent = after.bytes_sent - before.bytes_sent,
+        .bytes_recv = after.bytes_recv - before.bytes_recv,
+        .round_trips = after.round_trips - before.round_trips,
+        .wait_us = after.wait_us - before.wait_us,
+    };
+
+    cmd_stats_t *s = cmd_stats_get(name);
+    if (s) {
+        s->calls++;
+        s->wall_us += t;
+        s->comm.frames_sent += d.frames_sent;
+        s->comm.frames_recv += d.frames_recv;
+        s->comm.bytes_sent += d.bytes_sent;
+        s->comm.bytes_recv += d.bytes_recv;
+        s->comm.round_trips += d.round_trips;
+        s->comm.wait_us += d.wait_us;
+    }
+
+    // only a line for what the user typed, not for every command a script runs
+    if (cmd_stats_depth == 0) {
+        cmd_stats_print(name, t, &d);
+    }
+    return res;
+}
+
+size_t GetCommandStats(const cmd_stats_t **stats) {
+    *stats = cmd_stats;
+    return cmd_stats_count;
+}
+
+void ResetCommandStats(void) {
+    cmd_stats_count = 0;
+}
+
+int CmdsParse(const command_t Commands[], const char *Cmd) {
+
+    if (g_session.client_exe_delay != 0) {
+        msleep(g_session.client_exe_delay);
+    }
+
+    // the internal dump commands all start with XX_, skip the compares for everything else
+    if (Cmd[0] == 'X') {
+        // Help dump children
+        if (strcmp(Cmd, "XX_internal_command_dump_XX") == 0) {
+            dumpCommandsRecursive(Commands, 0, false);
+            return PM3_SUCCESS;
+        }
+        // Help dump children with help
+        if (strcmp(Cmd, "XX_internal_command_dump_full_XX") == 0) {
+            dumpCommandsRecursive(Commands, 0, true);
+            return PM3_SUCCESS;
+        }
+        // Markdown help dump children
+        if (strcmp(Cmd, "XX_internal_command_dump_markdown_XX") == 0) {
+            dumpCommandsRecursive(Commands, 1, false);
+            return PM3_SUCCESS;
+        }
+        // Markdown help dump children with help
+        if (strcmp(Cmd, "XX_internal_command_dump_markdown_help_XX") == 0) {
+            dumpCommandsRecursive(Commands, 1, true);
+            return PM3_SUCCESS;
+        }
     }
 
     if (strcmp(Cmd, "coffee") == 0) {
@@ -330,42 +535,33 @@ int CmdsParse(const command_t Commands[], const char *Cmd) {
 
     bool request_help = (strcmp(Cmd + tmplen, "-h") == 0) || (strcmp(Cmd + tmplen, "--help") == 0);
 
-    int i = 0;
-    while (Commands[i].Name) {
-        if (0 == strcmp(Commands[i].Name, cmd_name)) {
-            if ((Commands[i].Help[0] == '{') ||  // always allow parsing categories
-                    request_help ||              // always allow requesting help
-                    Commands[i].IsAvailable()) {
-                break;
-            } else {
-                PrintAndLogEx(WARNING, "This command is " _YELLOW_("not available") " in this mode");
-                return PM3_ENOTIMPL;
-            }
-        }
-        ++i;
-    }
-
-    /* try to find exactly one prefix-match */
-    if (!Commands[i].Name) {
-        int last_match = 0;
-        int matches = 0;
+    int exact;
+    int i = cmd_lookup(Commands, cmd_name, &exact);
 
-        for (i = 0; Commands[i].Name; i++) {
-            if (!strncmp(Commands[i].Name, cmd_name, strlen(cmd_name)) && Commands[i].IsAvailable()) {
-                last_match = i;
-                matches++;
-            }
-        }
-        if (matches == 1) {
-            i = last_match;
-        }
+    if (exact >= 0 &&
+            (Commands[i].Help[0] != '{') &&     // always allow parsing categories
+            request_help == false &&            // always allow requesting help
+            Commands[i].IsAvailable() == false) {
+        PrintAndLogEx(WARNING, "This command is " _YELLOW_("not available") " in this mode");
+        return PM3_ENOTIMPL;
     }
 
-    if (Commands[i].Name) {
+    if (i >= 0) {
         while (Cmd[len] == ' ') {
             ++len;
         }
-        return Commands[i].Parse(Cmd + len);
+
+        size_t plen = strlen(cmd_path);
+        snprintf(cmd_path + plen, sizeof(cmd_path) - plen, "%s%s", (plen) ? " " : "", Commands[i].Name);
+
+        int res;
+        if (g_session.client_stats && request_help == false && Commands[i].Help[0] != '{') {
+            res = cmd_run_timed(&Commands[i], Cmd + len);
+        } else {
+            res = Commands[i].Parse(Cmd + len);
+        }
+        cmd_path[plen] = '\0';
+        return res;
     } else {
         // show help for selected hierarchy or if command not recognised
         CmdsHelp(Commands);
@@ -20,6 +20,7 @@
 #define CMDPARSER_H__
 
 #include "common.h"
+#include "comms.h"      // comm_stats_t
 
 typedef struct command_s {
     const char *Name;
@@ -29,6 +30,15 @@ typedef struct command_s {
 } command_t;
 // command_t array are expected to be NULL terminated
 
+// per command totals, collected while the client.stats preference is on.
+// Commands called by other commands (scripts, prefs set ...) are included in their caller too
+typedef struct {
+    char name[64];
+    uint32_t calls;
+    uint64_t wall_us;
+    comm_stats_t comm;
+} cmd_stats_t;
+
 // helpers for command_t IsAvailable
 bool AlwaysAvailable(void);
 bool IfClientDebugEnabled(void);
@@ -66,4 +76,7 @@ void CmdsLS(const command_t Commands[]);
 int CmdsParse(const command_t Commands[], const char *Cmd);
 void dumpCommandsRecursive(const command_t cmds[], int markdown, bool full_help);
 
+size_t GetCommandStats(const cmd_stats_t **stats);
+void ResetCommandStats(void);
+
 #endif
@@ -18,6 +18,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_PYTHON
 //#define PY_SSIZE_T_CLEAN
@@ -39,6 +40,7 @@
 #include "ui.h"
 #include "fileutils.h"
 #include "cliparser.h"    // cliparsing
+#include "commonutil.h"  // ARRAYLEN
 
 #ifdef HAVE_LUA_SWIG
 extern int luaopen_pm3(lua_State *L);
@@ -49,48 +51,90 @@ extern int luaopen_pm3(lua_State *L);
 extern PyObject *PyInit__pm3(void);
 #endif // HAVE_PYTHON_SWIG
 
+// the interpreter outlives the script, push out what it printed
+static void Pm3PyFlushStd(void) {
+    PyObject *ty = 0, *er = 0, *tr = 0;
+    PyErr_Fetch(&ty, &er, &tr);
+
+    PyObject *streams[] = { PySys_GetObject("stdout"), PySys_GetObject("stderr") };
+    for (size_t i = 0; i < ARRAYLEN(streams); i++) {
+        if (streams[i] && streams[i] != Py_None) {
+            PyObject *r = PyObject_CallMethod(streams[i], "flush", NULL);
+            if (r == NULL) {
+                PyErr_Clear();
+            }
+            Py_XDECREF(r);
+        }
+    }
+
+    PyErr_Restore(ty, er, tr);
+}
+
 // Partly ripped from PyRun_SimpleFileExFlags
 // but does not terminate client on sys.exit
 // and print exit code only if != 0
-static int Pm3PyRun_SimpleFileNoExit(FILE *fp, const char *filename) {
+// Every run gets a fresh __main__ module with its own globals and sys.argv,
+// modules imported by earlier runs stay loaded in the shared interpreter.
+static int Pm3PyRun_SimpleFileNoExit(FILE *fp, const char *filename, int argc, char **argv) {
     PyObject *m, *d, *v;
-    int set_file_name = 0, ret = -1;
+    int ret = -1;
+
+    PyObject *modules = PyImport_GetModuleDict();
+    PyObject *prev_main = PyDict_GetItemString(modules, "__main__");
+    Py_XINCREF(prev_main);
 
-    m = PyImport_AddModule("__main__");
+    m = PyModule_New("__main__");
     if (m == NULL) {
-        return -1;
+        goto done;
+    }
+
+    if (PyDict_SetItemString(modules, "__main__", m) < 0) {
+        goto done;
     }
 
-    Py_INCREF(m);
     d = PyModule_GetDict(m);
+    if (PyDict_SetItemString(d, "__builtins__", PyEval_GetBuiltins()) < 0) {
+        goto done;
+    }
 
-    if (PyDict_GetItemString(d, "__file__") == NULL) {
+    PyObject *f;
+    f = PyUnicode_DecodeFSDefault(filename);
+    if (f == NULL) {
+        goto done;
+    }
 
-        PyObject *f;
-        f = PyUnicode_DecodeFSDefault(filename);
-        if (f == NULL) {
-            goto done;
-        }
+    if (PyDict_SetItemString(d, "__file__", f) < 0) {
+        Py_DECREF(f);
+        goto done;
+    }
+    Py_DECREF(f);
 
-        if (PyDict_SetItemString(d, "__file__", f) < 0) {
-            Py_DECREF(f);
-            goto done;
-        }
+    if (PyDict_SetItemString(d, "__cached__", Py_None) < 0) {
+        goto done;
+    }
 
-        if (PyDict_SetItemString(d, "__cached__", Py_None) < 0) {
-            Py_DECREF(f);
+    PyObject *pyargv = PyList_New(argc);
+    if (pyargv == NULL) {
+        goto done;
+    }
+    for (int i = 0; i < argc; i++) {
+        PyObject *arg = PyUnicode_DecodeFSDefault(argv[i]);
+        if (arg == NULL) {
+            Py_DECREF(pyargv);
             goto done;
         }
-
-        set_file_name = 1;
-        Py_DECREF(f);
+        PyList_SET_ITEM(pyargv, i, arg);
+    }
+    int res = PySys_SetObject("argv", pyargv);
+    Py_DECREF(pyargv);
+    if (res < 0) {
+        goto done;
     }
 
     v = PyRun_FileExFlags(fp, filename, Py_file_input, d, d, 1, NULL);
+    Pm3PyFlushStd();
     if (v == NULL) {
 
-        Py_CLEAR(m);
-
         if (PyErr_ExceptionMatches(PyExc_SystemExit)) {
             // PyErr_Print() exists if SystemExit so we've to handle it ourselves
             PyObject *ty = 0, *er = 0, *tr = 0;
@@ -103,9 +147,9 @@ static int Pm3PyRun_SimpleFileNoExit(FILE *fp, const char *filename) {
                 ret = 0;
             }
 
-            Py_DECREF(ty);
-            Py_DECREF(er);
-            Py_DECREF(er);
+            Py_XDECREF(ty);
+            Py_XDECREF(er);
+            Py_XDECREF(tr);
             PyErr_Clear();
             goto done;
 
@@ -119,12 +163,30 @@ static int Pm3PyRun_SimpleFileNoExit(FILE *fp, const char *filename) {
     ret = 0;
 
 done:
-    if (set_file_name && PyDict_DelItemString(d, "__file__")) {
+    if (PyErr_Occurred()) {
+        PyErr_Print();
+    }
+
+    if (prev_main) {
+        PyDict_SetItemString(modules, "__main__", prev_main);
+        Py_DECREF(prev_main);
+    } else if (PyDict_DelItemString(modules, "__main__")) {
         PyErr_Clear();
     }
     Py_XDECREF(m);
     return ret;
 }
+
+// The interpreter is started by the first Python script and kept for the client session,
+// later runs only pay for their own work.
+static bool py_ready = false;
+
+static void py_free(void) {
+    if (py_ready) {
+        Py_Finalize();
+        py_ready = false;
+    }
+}
 #endif // HAVE_PYTHON
 
 typedef enum {
@@ -267,6 +329,134 @@ static int CmdScriptList(const char *Cmd) {
 #endif
 }
 
+// Lua chunk cache, scripts and lualibs modules are compiled once and kept as bytecode.
+// An entry is dropped when its file changes on disk.
+#define LUA_CHUNK_CACHE_SIZE 64
+
+typedef struct {
+    char *path;
+    time_t mtime;
+    off_t size;
+    char *buf;
+    size_t len;
+} lua_chunk_t;
+
+static lua_chunk_t lua_chunks[LUA_CHUNK_CACHE_SIZE];
+static size_t lua_chunks_next = 0;
+
+// persistent state used by `script run` when enabled with `script vm --keep`
+static lua_State *lua_vm = NULL;
+static bool lua_vm_keep = false;
+
+static int lua_chunk_writer(lua_State *L, const void *p, size_t sz, void *ud) {
+    (void) L;
+    lua_chunk_t *c = ud;
+    char *tmp = realloc(c->buf, c->len + sz);
+    if (tmp == NULL) {
+        return 1;
+    }
+    c->buf = tmp;
+    memcpy(c->buf + c->len, p, sz);
+    c->len += sz;
+    return 0;
+}
+
+static void lua_chunk_free(lua_chunk_t *c) {
+    free(c->path);
+    free(c->buf);
+    memset(c, 0, sizeof(lua_chunk_t));
+}
+
+// same as luaL_loadfile, but serves unchanged files from the chunk cache
+static int lua_loadfile_cached(lua_State *L, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return luaL_loadfile(L, path);
+    }
+
+    for (size_t i = 0; i < LUA_CHUNK_CACHE_SIZE; i++) {
+        lua_chunk_t *c = &lua_chunks[i];
+        if (c->path == NULL || strcmp(c->path, path) != 0) {
+            continue;
+        }
+        if (c->mtime == st.st_mtime && c->size == st.st_size) {
+            return luaL_loadbufferx(L, c->buf, c->len, path, "b");
+        }
+        lua_chunk_free(c);
+    }
+
+    int res = luaL_loadfile(L, path);
+    if (res != LUA_OK) {
+        return res;
+    }
+
+    lua_chunk_t *c = &lua_chunks[lua_chunks_next];
+    lua_chunks_next = (lua_chunks_next + 1) % LUA_CHUNK_CACHE_SIZE;
+    lua_chunk_free(c);
+    if (lua_dump(L, lua_chunk_writer, c, 0) != 0) {
+        lua_chunk_free(c);
+        return LUA_OK;
+    }
+    c->path = str_dup(path);
+    c->mtime = st.st_mtime;
+    c->size = st.st_size;
+    return LUA_OK;
+}
+
+// package.searchers entry loading lualibs modules through the chunk cache
+static int lua_searcher_cached(lua_State *L) {
+    const char *name = luaL_checkstring(L, 1);
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "searchpath");
+    lua_pushstring(L, name);
+    lua_getfield(L, -3, "path");
+    lua_call(L, 2, 2);
+    if (lua_isnil(L, -2)) {
+        // not found, hand the message to require
+        return 1;
+    }
+    lua_pop(L, 1);
+
+    const char *path = lua_tostring(L, -1);
+    if (lua_loadfile_cached(L, path) != LUA_OK) {
+        return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s", name, path, lua_tostring(L, -1));
+    }
+    lua_pushstring(L, path);
+    return 2;
+}
+
+static lua_State *lua_state_new(void) {
+    lua_State *lua_state = luaL_newstate();
+
+    // load Lua libraries
+    luaL_openlibs(lua_state);
+
+    //Sets the pm3 core libraries, that go a bit 'under the hood'
+    set_pm3_libraries(lua_state);
+
+    //Add the 'bin' library
+    set_bin_library(lua_state);
+
+    //Add the 'bit' library
+    set_bit_library(lua_state);
+#ifdef HAVE_LUA_SWIG
+    luaL_requiref(lua_state, "pm3", luaopen_pm3, 1);
+    lua_pop(lua_state, 1);
+#endif
+
+    // the cached searcher goes in front of the Lua file searcher
+    lua_getglobal(lua_state, "package");
+    lua_getfield(lua_state, -1, "searchers");
+    for (lua_Integer i = (lua_Integer)luaL_len(lua_state, -1); i >= 2; i--) {
+        lua_rawgeti(lua_state, -1, i);
+        lua_rawseti(lua_state, -2, i + 1);
+    }
+    lua_pushcfunction(lua_state, lua_searcher_cached);
+    lua_rawseti(lua_state, -2, 2);
+    lua_pop(lua_state, 2);
+    return lua_state;
+}
+
 /**
  * @brief CmdScriptRun - executes a script file.
  * @param argc
@@ -343,29 +533,35 @@ static int CmdScriptRun(const char *Cmd) {
 
         luascriptfile_idx++;
 
-        // create new Lua state
+        // a kept state serves the outermost script only, nested scripts get their own
+        bool reuse = (lua_vm_keep && luascriptfile_idx == 1);
         lua_State *lua_state;
-        lua_state = luaL_newstate();
-
-        // load Lua libraries
-        luaL_openlibs(lua_state);
-
-        //Sets the pm3 core libraries, that go a bit 'under the hood'
-        set_pm3_libraries(lua_state);
-
-        //Add the 'bin' library
-        set_bin_library(lua_state);
+        if (reuse) {
+            if (lua_vm == NULL) {
+                lua_vm = lua_state_new();
+            }
+            lua_state = lua_vm;
+        } else {
+            lua_state = lua_state_new();
+        }
 
-        //Add the 'bit' library
-        set_bit_library(lua_state);
-#ifdef HAVE_LUA_SWIG
-        luaL_requiref(lua_state, "pm3", luaopen_pm3, 1);
-#endif
-        error = luaL_loadfile(lua_state, script_path);
+        error = lua_loadfile_cached(lua_state, script_path);
         free(script_path);
         if (!error) {
-            lua_pushstring(lua_state, arguments);
-            lua_setglobal(lua_state, "args");
+            if (reuse) {
+                // globals of a run go to its own environment, libraries and loaded modules stay shared
+                lua_newtable(lua_state);
+                lua_newtable(lua_state);
+                lua_pushglobaltable(lua_state);
+                lua_setfield(lua_state, -2, "__index");
+                lua_setmetatable(lua_state, -2);
+                lua_pushstring(lua_state, arguments);
+                lua_setfield(lua_state, -2, "args");
+                lua_setupvalue(lua_state, -2, 1);
+            } else {
+                lua_pushstring(lua_state, arguments);
+                lua_setglobal(lua_state, "args");
+            }
 
             //Call it with 0 arguments
             error = lua_pcall(lua_state, 0, LUA_MULTRET, 0); // once again, returns non-0 on error,
@@ -381,9 +577,12 @@ static int CmdScriptRun(const char *Cmd) {
             PrintAndLogEx(FAILED, _RED_("error") " - %s", str);
         }
 
-        //luaL_dofile(lua_state, buf);
-        // close the Lua state
-        lua_close(lua_state);
+        if (reuse) {
+            lua_settop(lua_state, 0);
+        } else {
+            // close the Lua state
+            lua_close(lua_state);
+        }
         luascriptfile_idx--;
         PrintAndLogEx(SUCCESS, "\nfinished " _YELLOW_("%s"), filename);
         return PM3_SUCCESS;
@@ -432,97 +631,84 @@ static int CmdScriptRun(const char *Cmd) {
         PrintAndLogEx(SUCCESS, "executing python " _YELLOW_("%s"), script_path);
         PrintAndLogEx(SUCCESS, "args " _YELLOW_("'%s'"), arguments);
 
-#ifdef HAVE_PYTHON_SWIG
-        // hook Proxmark3 API
-        PyImport_AppendInittab("_pm3", PyInit__pm3);
-#endif
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION < 10
-        Py_Initialize();
-#else
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION >= 10
         PyConfig py_conf;
         PyStatus status;
-        // We need to use Python mode instead of isolated to avoid breaking stuff.
-        PyConfig_InitPythonConfig(&py_conf);
-        // Let's still make things bit safer by being as close as possible to isolated mode.
-        py_conf.configure_c_stdio = -1;
-        py_conf.faulthandler = 0;
-        py_conf.use_hash_seed = 0;
-        py_conf.install_signal_handlers = 0;
-        py_conf.parse_argv = 0;
-        py_conf.user_site_directory = 1;
-        py_conf.use_environment = 0;
 #endif
-
-        //int argc, char ** argv
-        char *argv[FILE_PATH_SIZE];
-        argv[0] = script_path;
-        int argc = split(arguments, &argv[1]);
+        if (py_ready == false) {
+#ifdef HAVE_PYTHON_SWIG
+            // hook Proxmark3 API
+            PyImport_AppendInittab("_pm3", PyInit__pm3);
+#endif
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION < 10
-        wchar_t *py_args[argc + 1];
-        for (int i = 0; i <= argc; i++) {
-            py_args[i] = Py_DecodeLocale(argv[i], NULL);
-        }
-
-        PySys_SetArgv(argc + 1, py_args);
+            Py_Initialize();
 #else
-        // The following line will implicitly pre-initialize Python
-        status = PyConfig_SetBytesArgv(&py_conf, argc + 1, argv);
-        if (PyStatus_Exception(status)) {
-            goto pyexception;
-        }
-        // We disallowed in py_conf environment variables interfering with python interpreter's behavior.
-        // Let's manually enable the ones we truly need.
-        const char *virtual_env = getenv("VIRTUAL_ENV");
-        if (virtual_env != NULL) {
-            size_t length = strlen(virtual_env) + strlen("/bin/python3") + 1;
-            char python_executable_path[length];
-            snprintf(python_executable_path, length, "%s/bin/python3", virtual_env);
-            status = PyConfig_SetBytesString(&py_conf, &py_conf.executable, python_executable_path);
+            // We need to use Python mode instead of isolated to avoid breaking stuff.
+            PyConfig_InitPythonConfig(&py_conf);
+            // Let's still make things bit safer by being as close as possible to isolated mode.
+            py_conf.configure_c_stdio = -1;
+            py_conf.faulthandler = 0;
+            py_conf.use_hash_seed = 0;
+            py_conf.install_signal_handlers = 0;
+            py_conf.parse_argv = 0;
+            py_conf.user_site_directory = 1;
+            py_conf.use_environment = 0;
+
+            // We disallowed in py_conf environment variables interfering with python interpreter's behavior.
+            // Let's manually enable the ones we truly need.
+            const char *virtual_env = getenv("VIRTUAL_ENV");
+            if (virtual_env != NULL) {
+                size_t length = strlen(virtual_env) + strlen("/bin/python3") + 1;
+                char python_executable_path[length];
+                snprintf(python_executable_path, length, "%s/bin/python3", virtual_env);
+                status = PyConfig_SetBytesString(&py_conf, &py_conf.executable, python_executable_path);
+                if (PyStatus_Exception(status)) {
+                    goto pyexception;
+                }
+            } else {
+                // This is required by Proxspace to work with an isolated Python configuration
+                status = PyConfig_SetBytesString(&py_conf, &py_conf.home, getenv("PYTHONHOME"));
+                if (PyStatus_Exception(status)) {
+                    goto pyexception;
+                }
+            }
+            // This is required for allowing `import pm3` in python scripts
+            status = PyConfig_SetBytesString(&py_conf, &py_conf.pythonpath_env, getenv("PYTHONPATH"));
             if (PyStatus_Exception(status)) {
                 goto pyexception;
             }
-        } else {
-            // This is required by Proxspace to work with an isolated Python configuration
-            status = PyConfig_SetBytesString(&py_conf, &py_conf.home, getenv("PYTHONHOME"));
+
+            status = Py_InitializeFromConfig(&py_conf);
             if (PyStatus_Exception(status)) {
                 goto pyexception;
             }
-        }
-        // This is required for allowing `import pm3` in python scripts
-        status = PyConfig_SetBytesString(&py_conf, &py_conf.pythonpath_env, getenv("PYTHONPATH"));
-        if (PyStatus_Exception(status)) {
-            goto pyexception;
-        }
-
-        status = Py_InitializeFromConfig(&py_conf);
-        if (PyStatus_Exception(status)) {
-            goto pyexception;
-        }
 
-        // clean up
-        PyConfig_Clear(&py_conf);
+            // clean up
+            PyConfig_Clear(&py_conf);
 #endif
-        for (int i = 0; i < argc; ++i) {
-            free(argv[i + 1]);
+            // setup search paths.
+            set_python_paths();
+            py_ready = true;
+            atexit(py_free);
         }
 
-        // setup search paths.
-        set_python_paths();
-
         FILE *f = fopen(script_path, "r");
         if (f == NULL) {
             PrintAndLogEx(ERR, "Could open file " _YELLOW_("%s"), script_path);
             free(script_path);
             return PM3_ESOFT;
         }
-        int ret = Pm3PyRun_SimpleFileNoExit(f, filename);
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION < 10
-        // Py_DecodeLocale() allocates memory that needs to be free'd
-        for (int i = 0; i < argc + 1; i++) {
-            PyMem_RawFree(py_args[i]);
+
+        //int argc, char ** argv
+        char *argv[FILE_PATH_SIZE];
+        argv[0] = script_path;
+        int argc = split(arguments, &argv[1]);
+
+        int ret = Pm3PyRun_SimpleFileNoExit(f, filename, argc + 1, argv);
+
+        for (int i = 0; i < argc; ++i) {
+            free(argv[i + 1]);
         }
-#endif
-        Py_Finalize();
         free(script_path);
         if (ret) {
             PrintAndLogEx(WARNING, "\nfinished " _YELLOW_("%s") " with exception", filename);
@@ -565,10 +751,75 @@ pyexception:
     return ret;
 }
 
+static int CmdScriptVM(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "script vm",
+                  "Control the Lua state used by `script run`.\n"
+                  "By default every script runs in a new state. A kept state is created once and reused,\n"
+                  "each run gets its own globals while libraries and `require`d lualibs modules stay loaded.\n"
+                  "Scripts and modules are always compiled once and reloaded when their file changes.",
+                  "script vm            -> show current mode\n"
+                  "script vm --keep     -> reuse one Lua state for all runs\n"
+                  "script vm --reset    -> drop the kept state, the next run starts from scratch\n"
+                  "script vm --fresh    -> new Lua state for every run (default)"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("k", "keep", "reuse one Lua state for all runs"),
+        arg_lit0("f", "fresh", "new Lua state for every run"),
+        arg_lit0("r", "reset", "drop the kept Lua state and the chunk cache"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool keep = arg_get_lit(ctx, 1);
+    bool fresh = arg_get_lit(ctx, 2);
+    bool reset = arg_get_lit(ctx, 3);
+    CLIParserFree(ctx);
+
+    if (keep && fresh) {
+        PrintAndLogEx(FAILED, "Can't use both --keep and --fresh");
+        return PM3_EINVARG;
+    }
+
+    if (reset || fresh) {
+        if (lua_vm) {
+            lua_close(lua_vm);
+            lua_vm = NULL;
+        }
+    }
+
+    if (reset) {
+        for (size_t i = 0; i < LUA_CHUNK_CACHE_SIZE; i++) {
+            lua_chunk_free(&lua_chunks[i]);
+        }
+        lua_chunks_next = 0;
+    }
+
+    if (keep) {
+        lua_vm_keep = true;
+    }
+    if (fresh) {
+        lua_vm_keep = false;
+    }
+
+    size_t cached = 0;
+    for (size_t i = 0; i < LUA_CHUNK_CACHE_SIZE; i++) {
+        if (lua_chunks[i].path) {
+            cached++;
+        }
+    }
+
+    PrintAndLogEx(INFO, "Lua state..... %s", (lua_vm_keep) ? _GREEN_("kept") : "new per run");
+    PrintAndLogEx(INFO, "Cached chunks. %zu", cached);
+    return PM3_SUCCESS;
+}
+
 static command_t CommandTable[] = {
     {"help",  CmdHelp,          AlwaysAvailable, "This help"},
     {"list",  CmdScriptList,    AlwaysAvailable, "List available scripts"},
     {"run",   CmdScriptRun,     AlwaysAvailable, "<name> - execute a script"},
+    {"vm",    CmdScriptVM,      AlwaysAvailable, "Keep or reset the Lua state of script run"},
     {NULL, NULL, NULL, NULL}
 };
 
@@ -48,36 +48,25 @@ static int CmdHelp(const char *Cmd);
 
 static int smart_loadjson(const char *preferredName, json_t **root) {
 
-    json_error_t error;
-
     if (preferredName == NULL) {
         return 1;
     }
 
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, ".json", false);
+    const char *path;
+    int res = loadResourceJSON(preferredName, false, root, &path);
     if (res != PM3_SUCCESS) {
-        return PM3_EFILE;
-    }
-
-    int retval = PM3_SUCCESS;
-    *root = json_load_file(path, 0, &error);
-    if (!*root) {
-        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
-        retval = PM3_ESOFT;
-        goto out;
+        return res;
     }
 
     if (!json_is_array(*root)) {
         PrintAndLogEx(ERR, "Invalid json (%s) format. root must be an array.", path);
-        retval = PM3_ESOFT;
-        goto out;
+        json_decref(*root);
+        *root = NULL;
+        return PM3_ESOFT;
     }
 
     PrintAndLogEx(SUCCESS, "Loaded file (%s) OK.", path);
-out:
-    free(path);
-    return retval;
+    return PM3_SUCCESS;
 }
 
 static uint8_t GetATRTA1(const uint8_t *atr, size_t atrlen) {
@@ -948,6 +937,72 @@ static void smart_brute_prim(void) {
     free(buf);
 }
 
+// one READ RECORD, one host round trip. Handles 6Cxx (wrong Le) and 61xx (GET RESPONSE)
+static bool smart_read_record(uint8_t sfi, uint8_t rec, uint8_t *buf, int *len) {
+
+    uint8_t READ_RECORD[] = {0x00, 0xB2, rec, (sfi << 3) | 4, 0x00};
+
+    smart_card_raw_t *payload = calloc(1, sizeof(smart_card_raw_t) +  sizeof(READ_RECORD));
+    if (payload == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return false;
+    }
+    payload->flags = SC_RAW_T0;
+    payload->len = sizeof(READ_RECORD);
+    payload->wait_delay = 0;
+    memcpy(payload->data, READ_RECORD, sizeof(READ_RECORD));
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_SMART_RAW, (uint8_t *)payload, sizeof(smart_card_raw_t) +  sizeof(READ_RECORD));
+
+    *len = smart_responseEx(buf, PM3_CMD_DATA_SIZE, false);
+
+    if (buf[0] == 0x6C) {
+        READ_RECORD[4] = buf[1];
+
+        memcpy(payload->data, READ_RECORD, sizeof(READ_RECORD));
+        clearCommandBuffer();
+        SendCommandNG(CMD_SMART_RAW, (uint8_t *)payload, sizeof(smart_card_raw_t) +  sizeof(READ_RECORD));
+        *len = smart_responseEx(buf, PM3_CMD_DATA_SIZE, false);
+    }
+
+    free(payload);
+    return true;
+}
+
+// READ RECORDs sent per CMD_BATCH round trip
+#define SMART_BRUTE_BATCH 32
+
+// Queues READ RECORD rec_start.. for one SFI in a single CMD_BATCH.
+// replies[i].cmd stays CMD_UNKNOWN for records the batch did not answer.
+static int smart_read_records_batched(uint8_t sfi, uint16_t rec_start, uint8_t count, PacketResponseNG *replies) {
+
+    uint8_t raw[sizeof(smart_card_raw_t) + 5];
+    smart_card_raw_t *payload = (smart_card_raw_t *)raw;
+    memset(raw, 0, sizeof(raw));
+    payload->flags = SC_RAW_T0;
+    payload->len = 5;
+    payload->wait_delay = 0;
+
+    cmd_batch_t batch;
+    BatchInit(&batch, 0);
+    uint8_t n = 0;
+    for (; n < count; n++) {
+        uint8_t READ_RECORD[] = {0x00, 0xB2, rec_start + n, (sfi << 3) | 4, 0x00};
+        memcpy(payload->data, READ_RECORD, sizeof(READ_RECORD));
+        if (BatchAdd(&batch, CMD_SMART_RAW, raw, sizeof(raw)) != PM3_SUCCESS) {
+            break;
+        }
+    }
+
+    uint8_t executed = 0;
+    int res = BatchRun(&batch, replies, n, &executed, 2500);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    return n;
+}
+
 static int smart_brute_sfi(bool decodeTLV) {
 
     uint8_t *buf = calloc(PM3_CMD_DATA_SIZE, sizeof(uint8_t));
@@ -956,70 +1011,82 @@ static int smart_brute_sfi(bool decodeTLV) {
         return 1;
     }
 
-    int len;
-    // READ RECORD
-    uint8_t READ_RECORD[] = {0x00, 0xB2, 0x00, 0x00, 0x00};
+    PacketResponseNG *replies = calloc(SMART_BRUTE_BATCH, sizeof(PacketResponseNG));
+    if (replies == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(buf);
+        return 1;
+    }
+
+    // firmware without CMD_BATCH, one round trip per record
+    bool use_batch = true;
+
     PrintAndLogEx(INFO, "Start SFI brute forcing");
 
     for (uint8_t sfi = 1; sfi <= 31; sfi++) {
 
         PrintAndLogEx(NORMAL, "." NOLF);
 
-        for (uint16_t rec = 1; rec <= 255; rec++) {
+        for (uint16_t rec = 1; rec <= 255;) {
 
             if (kbd_enter_pressed()) {
                 PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+                free(replies);
                 free(buf);
                 return 1;
             }
 
-            READ_RECORD[2] = rec;
-            READ_RECORD[3] = (sfi << 3) | 4;
-
-            smart_card_raw_t *payload = calloc(1, sizeof(smart_card_raw_t) +  sizeof(READ_RECORD));
-            if (payload == NULL) {
-                PrintAndLogEx(WARNING, "Failed to allocate memory");
-                free(buf);
-                return 1;
-            }
-            payload->flags = SC_RAW_T0;
-            payload->len = sizeof(READ_RECORD);
-            payload->wait_delay = 0;
-            memcpy(payload->data, READ_RECORD, sizeof(READ_RECORD));
-
-            clearCommandBuffer();
-            SendCommandNG(CMD_SMART_RAW, (uint8_t *)payload, sizeof(smart_card_raw_t) +  sizeof(READ_RECORD));
-
-            len = smart_responseEx(buf, PM3_CMD_DATA_SIZE, false);
-
-            if (buf[0] == 0x6C) {
-                READ_RECORD[4] = buf[1];
-
-                memcpy(payload->data, READ_RECORD, sizeof(READ_RECORD));
-                clearCommandBuffer();
-                SendCommandNG(CMD_SMART_RAW, (uint8_t *)payload, sizeof(smart_card_raw_t) +  sizeof(READ_RECORD));
-                len = smart_responseEx(buf, PM3_CMD_DATA_SIZE, false);
-
-                READ_RECORD[4] = 0;
+            uint8_t count = 1;
+            if (use_batch) {
+                int n = smart_read_records_batched(sfi, rec, MIN(SMART_BRUTE_BATCH, 256 - rec), replies);
+                if (n > 0) {
+                    count = n;
+                } else {
+                    if (n == PM3_ENOTIMPL) {
+                        use_batch = false;
+                    }
+                    replies[0].cmd = CMD_UNKNOWN;
+                }
+            } else {
+                replies[0].cmd = CMD_UNKNOWN;
             }
 
-            free(payload);
+            for (uint8_t i = 0; i < count; i++, rec++) {
+
+                const PacketResponseNG *r = &replies[i];
+                int len;
+
+                // plain answers are taken as is, wrong Le / more data / oversized replies go the long way
+                if ((r->cmd == CMD_SMART_RAW) && (r->status == PM3_SUCCESS) && (r->length >= 2) &&
+                        (r->data.asBytes[0] != 0x6C) &&
+                        (r->data.asBytes[r->length - 2] != 0x61) && (r->data.asBytes[r->length - 2] != 0x9F)) {
+                    memcpy(buf, r->data.asBytes, r->length);
+                    len = r->length;
+                } else {
+                    if (smart_read_record(sfi, rec, buf, &len) == false) {
+                        free(replies);
+                        free(buf);
+                        return 1;
+                    }
+                }
 
-            if (len > 4) {
+                if (len > 4) {
 
-                PrintAndLogEx(SUCCESS, "\n\t file %02d, record %02d found", sfi, rec);
+                    PrintAndLogEx(SUCCESS, "\n\t file %02d, record %02d found", sfi, rec);
 
-                uint8_t modifier = (buf[0] == 0xC0) ? 1 : 0;
+                    uint8_t modifier = (buf[0] == 0xC0) ? 1 : 0;
 
-                if (decodeTLV) {
-                    if (!TLVPrintFromBuffer(buf + modifier, len - 2 - modifier)) {
-                        PrintAndLogEx(SUCCESS, "\tHEX: %s", sprint_hex(buf, len));
+                    if (decodeTLV) {
+                        if (!TLVPrintFromBuffer(buf + modifier, len - 2 - modifier)) {
+                            PrintAndLogEx(SUCCESS, "\tHEX: %s", sprint_hex(buf, len));
+                        }
                     }
                 }
+                memset(buf, 0x00, PM3_CMD_DATA_SIZE);
             }
-            memset(buf, 0x00, PM3_CMD_DATA_SIZE);
         }
     }
+    free(replies);
     free(buf);
     return 0;
 }
@@ -18,6 +18,7 @@
 #include "cmdtrace.h"
 
 #include <ctype.h>
+#include <pthread.h>
 
 #include "cmdparser.h"    // command_t
 #include "protocols.h"
@@ -31,24 +32,31 @@
 #include "cmdlfhitaghts.h"      // annotate hitags
 #include "cmdlfhitagu.h"        // annotate hitagu
 #include "pm3_cmd.h"            // tracelog_hdr_t
+#include "crc16.h"              // check_crc
 #include "cliparser.h"          // args..
+#include "util_posix.h"         // msclock
+#include "crapto1/crapto1.h"     // prng_successor
+#include "lz4.h"                // standalone flash logs
 
 static int CmdHelp(const char *Cmd);
 
 // trace pointer
 static uint8_t *gs_trace;
-static uint16_t gs_traceLen = 0;
+static uint32_t gs_traceLen = 0;
+// offset of every complete record in gs_trace, built once when the trace changes
+static uint32_t *gs_traceIndex;
+static uint32_t gs_traceRecords = 0;
 
-static bool is_last_record(uint16_t tracepos, uint16_t traceLen) {
+static bool is_last_record(uint32_t tracepos, uint32_t traceLen) {
     return ((tracepos + TRACELOG_HDR_LEN) >= traceLen);
 }
 
-static bool next_record_is_response(uint16_t tracepos, uint8_t *trace) {
+static bool next_record_is_response(uint32_t tracepos, uint8_t *trace) {
     const tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
     return (hdr->isResponse);
 }
 
-static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint16_t *tracepos, uint16_t traceLen,
+static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint32_t *tracepos, uint32_t traceLen,
                                       uint8_t *trace, const uint8_t *frame, uint8_t *topaz_reader_command, uint16_t *data_len) {
 
 #define MAX_TOPAZ_READER_CMD_LEN 16
@@ -81,6 +89,16 @@ static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, ui
 
     return true;
 }
+// one hex column cell, same as snprintf("%02X%c ") without the format parsing
+static void trace_hex_cell(char *dst, uint8_t b, char mark) {
+    static const char hexdigits[] = "0123456789ABCDEF";
+    dst[0] = hexdigits[b >> 4];
+    dst[1] = hexdigits[b & 0x0F];
+    dst[2] = mark;
+    dst[3] = ' ';
+    dst[4] = '\0';
+}
+
 static uint8_t calc_pos(const uint8_t *d) {
     // PCB [CID] [NAD] [INF] CRC CRC
     uint8_t pos = 1;
@@ -93,9 +111,454 @@ static uint8_t calc_pos(const uint8_t *d) {
     return pos;
 }
 
+// marker records have no data, see TRACELOG_STREAM_MAGIC and TRACELOG_COMPACT_MAGIC
+static bool trace_stream_marker(const uint8_t *p, uint32_t magic) {
+    const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)p;
+    return (hdr->data_len == 0 && hdr->isResponse == false && hdr->duration == 0 && (magic == 0 || hdr->timestamp == magic));
+}
+
+static bool trace_get_varint(const uint8_t *p, uint32_t len, uint32_t *pos, uint32_t *v) {
+    *v = 0;
+    for (uint8_t shift = 0; shift < 35 && *pos < len; shift += 7) {
+        uint8_t b = p[(*pos)++];
+        *v |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool trace_out_reserve(uint8_t **out, uint32_t *cap, uint32_t used, uint32_t len) {
+    if (used + len <= *cap) {
+        return true;
+    }
+    uint32_t newcap = (*cap) ? *cap : 4096;
+    while (newcap < used + len) {
+        newcap *= 2;
+    }
+    uint8_t *tmp = realloc(*out, newcap);
+    if (tmp == NULL) {
+        return false;
+    }
+    *out = tmp;
+    *cap = newcap;
+    return true;
+}
+
+// Compact records (see TRACELOG_COMPACT_MAGIC) back to standard ones, so the rest of the client
+// only ever sees the standard format. A trace without a compact marker is left untouched
+static int trace_expand_compact(uint8_t **trace, uint32_t *trace_len) {
+    const uint8_t *in = *trace;
+    const uint32_t len = *trace_len;
+
+    // standard records up to the first marker
+    uint32_t pos = 0;
+    while (pos + TRACELOG_HDR_LEN <= len) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(in + pos);
+        if (trace_stream_marker(in + pos, TRACELOG_COMPACT_MAGIC)) {
+            break;
+        }
+        pos += TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+    }
+    if (pos + TRACELOG_HDR_LEN > len) {
+        return PM3_SUCCESS;
+    }
+
+    uint8_t *out = NULL;
+    uint32_t cap = 0;
+    uint32_t used = pos;
+    if (trace_out_reserve(&out, &cap, 0, len * 2) == false) {
+        return PM3_EMALLOC;
+    }
+    memcpy(out, in, pos);
+
+    uint32_t prev_ts = 0, records = 0;
+    while (pos < len) {
+        if (pos + TRACELOG_HDR_LEN <= len && trace_stream_marker(in + pos, TRACELOG_COMPACT_MAGIC)) {
+            // a new session, timestamps start over
+            prev_ts = 0;
+            pos += TRACELOG_HDR_LEN;
+            continue;
+        }
+
+        uint32_t start = pos, info, delta, duration;
+        bool ok = trace_get_varint(in, len, &pos, &info)
+                  && trace_get_varint(in, len, &pos, &delta)
+                  && trace_get_varint(in, len, &pos, &duration);
+
+        uint16_t data_len = (info >> 3) & 0x7FFF;
+        uint8_t par = (info >> 1) & 0x3;
+        uint16_t num_paritybytes = (data_len - 1) / 8 + 1;
+        uint16_t stored = (par == TRACELOG_COMPACT_PAR_KEEP) ? num_paritybytes : 0;
+        ok = ok && data_len && (info >> 18) == 0 && par <= TRACELOG_COMPACT_PAR_KEEP && duration <= 0xFFFF
+             && pos + data_len + stored <= len;
+        if (ok == false) {
+            PrintAndLogEx(WARNING, "Compact trace broken at offset %u, ignoring the last " _YELLOW_("%u") " bytes", start, len - start);
+            break;
+        }
+
+        uint32_t entry_len = TRACELOG_HDR_LEN + data_len + num_paritybytes;
+        if (trace_out_reserve(&out, &cap, used, entry_len) == false) {
+            free(out);
+            return PM3_EMALLOC;
+        }
+
+        prev_ts += delta;
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(out + used);
+        hdr->timestamp = prev_ts;
+        hdr->duration = duration;
+        hdr->data_len = data_len;
+        hdr->isResponse = (info & 1);
+        memcpy(hdr->frame, in + pos, data_len);
+
+        uint8_t *parity = hdr->frame + data_len;
+        if (par == TRACELOG_COMPACT_PAR_KEEP) {
+            memcpy(parity, in + pos + data_len, num_paritybytes);
+        } else {
+            memset(parity, 0, num_paritybytes);
+            if (par == TRACELOG_COMPACT_PAR_ODD) {
+                for (uint16_t i = 0; i < data_len; i++) {
+                    parity[i >> 3] |= oddparity8(hdr->frame[i]) << (7 - (i & 7));
+                }
+            }
+        }
+
+        pos += data_len + stored;
+        used += entry_len;
+        records++;
+    }
+
+    PrintAndLogEx(DEBUG, "expanded %u compact records, %u -> %u bytes", records, len, used);
+    free(*trace);
+    *trace = out;
+    *trace_len = used;
+    return PM3_SUCCESS;
+}
+
+// Flash trace log (see TRACELOG_LZ4_MAGIC) back to the plain records
+static int trace_unlz4(uint8_t **trace, uint32_t *trace_len) {
+    const uint8_t *in = *trace;
+    const uint32_t len = *trace_len;
+    if (len < sizeof(tracelog_lz4_chunk_t) || ((const tracelog_lz4_chunk_t *)in)->magic != TRACELOG_LZ4_MAGIC) {
+        return PM3_SUCCESS;
+    }
+
+    uint8_t *out = NULL;
+    uint32_t cap = 0;
+    uint32_t used = 0;
+    uint32_t pos = 0, chunks = 0;
+    while (pos + sizeof(tracelog_lz4_chunk_t) <= len) {
+        tracelog_lz4_chunk_t chunk;
+        memcpy(&chunk, in + pos, sizeof(chunk));
+        if (chunk.magic != TRACELOG_LZ4_MAGIC || chunk.clen > len - pos - sizeof(chunk)) {
+            break;
+        }
+        if (trace_out_reserve(&out, &cap, used, chunk.rawlen) == false) {
+            free(out);
+            return PM3_EMALLOC;
+        }
+        int res = LZ4_decompress_safe((const char *)in + pos + sizeof(chunk), (char *)out + used, chunk.clen, chunk.rawlen);
+        if (res != chunk.rawlen) {
+            break;
+        }
+        pos += sizeof(chunk) + chunk.clen;
+        used += chunk.rawlen;
+        chunks++;
+    }
+
+    if (chunks == 0) {
+        PrintAndLogEx(WARNING, "LZ4 trace log is broken, ignoring the trace");
+        free(out);
+        *trace_len = 0;
+        return PM3_ESOFT;
+    }
+    if (pos != len) {
+        PrintAndLogEx(WARNING, "LZ4 trace log broken at offset %u, ignoring the last " _YELLOW_("%u") " bytes", pos, len - pos);
+    }
+    PrintAndLogEx(DEBUG, "decompressed %u LZ4 chunks, %u -> %u bytes", chunks, len, used);
+    free(*trace);
+    *trace = out;
+    *trace_len = used;
+    return PM3_SUCCESS;
+}
+
+// A ring trace (see tracelog_ring_hdr_t) in the order the records were logged
+static int trace_unring(uint8_t **trace, uint32_t *trace_len) {
+    const uint32_t hdr_len = sizeof(tracelog_ring_hdr_t);
+    if (*trace_len < hdr_len) {
+        return PM3_SUCCESS;
+    }
+
+    tracelog_ring_hdr_t ring;
+    memcpy(&ring, *trace, hdr_len);
+    if (ring.magic != TRACELOG_RING_MAGIC || ring.zero != 0) {
+        return PM3_SUCCESS;
+    }
+
+    uint32_t first_end = (ring.wrap) ? ring.wrap : ring.end;
+    if (ring.first < hdr_len || ring.end < hdr_len || ring.first > first_end || first_end > *trace_len || ring.end > *trace_len
+            || (ring.wrap && ring.end > ring.first)) {
+        PrintAndLogEx(WARNING, "Ring trace header is broken, ignoring the trace");
+        *trace_len = 0;
+        return PM3_ESOFT;
+    }
+
+    uint32_t len = first_end - ring.first;
+    if (ring.wrap) {
+        len += ring.end - hdr_len;
+    }
+
+    uint8_t *out = calloc(len, sizeof(uint8_t));
+    if (out == NULL) {
+        return PM3_EMALLOC;
+    }
+    memcpy(out, *trace + ring.first, first_end - ring.first);
+    if (ring.wrap) {
+        memcpy(out + first_end - ring.first, *trace + hdr_len, ring.end - hdr_len);
+    }
+
+    if (ring.overwritten) {
+        PrintAndLogEx(INFO, "Ring trace, " _YELLOW_("%u") " older frames were overwritten", ring.overwritten);
+    }
+    free(*trace);
+    *trace = out;
+    *trace_len = len;
+    return PM3_SUCCESS;
+}
+
+static bool trace_cols_column(const trace_cols_hdr_t *hdr, uint64_t offset, size_t width, uint32_t trace_len) {
+    return (offset >= hdr->hdr_len) && (offset <= trace_len) && (hdr->records <= (trace_len - offset) / width);
+}
+
+// Columnar file (see trace_cols_hdr_t) back to standard records
+static int trace_from_cols(uint8_t **trace, uint32_t *trace_len) {
+    const uint32_t len = *trace_len;
+    if (len < sizeof(trace_cols_hdr_t) || memcmp(*trace, TRACE_COLS_MAGIC, 8) != 0) {
+        return PM3_SUCCESS;
+    }
+
+    trace_cols_hdr_t hdr;
+    memcpy(&hdr, *trace, sizeof(hdr));
+    if (hdr.version != TRACE_COLS_VERSION || hdr.hdr_len < sizeof(hdr) ||
+            trace_cols_column(&hdr, hdr.timestamp_offset, sizeof(uint32_t), len) == false ||
+            trace_cols_column(&hdr, hdr.duration_offset, sizeof(uint16_t), len) == false ||
+            trace_cols_column(&hdr, hdr.direction_offset, sizeof(uint8_t), len) == false ||
+            trace_cols_column(&hdr, hdr.protocol_offset, sizeof(uint8_t), len) == false ||
+            trace_cols_column(&hdr, hdr.length_offset, sizeof(uint16_t), len) == false ||
+            trace_cols_column(&hdr, hdr.payload_offset, sizeof(uint64_t), len) == false ||
+            hdr.blob_offset > len || hdr.blob_len > len - hdr.blob_offset) {
+        PrintAndLogEx(WARNING, "Columnar trace header is broken, ignoring the trace");
+        *trace_len = 0;
+        return PM3_ESOFT;
+    }
+
+    const uint8_t *in = *trace;
+    uint64_t out_len = 0;
+    for (uint64_t i = 0; i < hdr.records; i++) {
+        uint16_t n = MemLeToUint2byte(in + hdr.length_offset + (i * 2));
+        out_len += TRACELOG_HDR_LEN + n + ((n - 1) / 8 + 1);
+    }
+    if (out_len > UINT32_MAX) {
+        PrintAndLogEx(WARNING, "Columnar trace is too large");
+        *trace_len = 0;
+        return PM3_ESOFT;
+    }
+
+    uint8_t *out = calloc(out_len ? out_len : 1, sizeof(uint8_t));
+    if (out == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    uint32_t pos = 0;
+    for (uint64_t i = 0; i < hdr.records; i++) {
+        uint16_t n = MemLeToUint2byte(in + hdr.length_offset + (i * 2));
+        uint32_t payload_len = n + ((n - 1) / 8 + 1);
+        uint64_t payload = MemLeToUint8byte(in + hdr.payload_offset + (i * 8));
+        if (n > 0x7FFF || payload > hdr.blob_len || payload_len > hdr.blob_len - payload) {
+            PrintAndLogEx(WARNING, "Columnar trace record %" PRIu64 " is broken, ignoring the trace", i);
+            free(out);
+            *trace_len = 0;
+            return PM3_ESOFT;
+        }
+
+        tracelog_hdr_t *rec = (tracelog_hdr_t *)(out + pos);
+        rec->timestamp = MemLeToUint4byte(in + hdr.timestamp_offset + (i * 4));
+        rec->duration = MemLeToUint2byte(in + hdr.duration_offset + (i * 2));
+        rec->data_len = n;
+        rec->isResponse = in[hdr.direction_offset + i] ? 1 : 0;
+        memcpy(rec->frame, in + hdr.blob_offset + payload, payload_len);
+        pos += TRACELOG_HDR_LEN + payload_len;
+    }
+
+    free(*trace);
+    *trace = out;
+    *trace_len = pos;
+    return PM3_SUCCESS;
+}
+
+static bool trace_cols_write(FILE *f, const void *data, size_t len, uint64_t *pos) {
+    *pos += len;
+    return fwrite(data, 1, len, f) == len;
+}
+
+// pad the file to the 8 byte aligned start of the next column
+static bool trace_cols_align(FILE *f, uint64_t *pos) {
+    static const uint8_t zeros[8] = {0};
+    return trace_cols_write(f, zeros, (8 - (*pos % 8)) % 8, pos);
+}
+
+// Write the trace buffer as a columnar file, see trace_cols_hdr_t
+static int trace_save_cols(const char *fn, uint8_t protocol) {
+    trace_cols_hdr_t hdr = {
+        .version = TRACE_COLS_VERSION,
+        .hdr_len = sizeof(trace_cols_hdr_t),
+        .records = gs_traceRecords,
+    };
+    memcpy(hdr.magic, TRACE_COLS_MAGIC, sizeof(hdr.magic));
+
+    uint64_t pos = ((uint64_t)sizeof(hdr) + 7) & ~7ULL;
+    const size_t widths[] = {sizeof(uint32_t), sizeof(uint16_t), sizeof(uint8_t), sizeof(uint8_t), sizeof(uint16_t), sizeof(uint64_t)};
+    uint64_t offsets[ARRAYLEN(widths)];
+    for (size_t c = 0; c < ARRAYLEN(widths); c++) {
+        offsets[c] = pos;
+        pos = (pos + (widths[c] * hdr.records) + 7) & ~7ULL;
+    }
+    hdr.timestamp_offset = offsets[0];
+    hdr.duration_offset = offsets[1];
+    hdr.direction_offset = offsets[2];
+    hdr.protocol_offset = offsets[3];
+    hdr.length_offset = offsets[4];
+    hdr.payload_offset = offsets[5];
+    hdr.blob_offset = pos;
+    for (uint32_t i = 0; i < gs_traceRecords; i++) {
+        const tracelog_hdr_t *rec = (const tracelog_hdr_t *)(gs_trace + gs_traceIndex[i]);
+        hdr.blob_len += rec->data_len + TRACELOG_PARITY_LEN(rec);
+    }
+
+    FILE *f = fopen(fn, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "Failed to create file `" _YELLOW_("%s") "`", fn);
+        return PM3_EFILE;
+    }
+
+    // column by column, the trace index gives every record directly
+    pos = 0;
+    bool ok = trace_cols_write(f, &hdr, sizeof(hdr), &pos) && trace_cols_align(f, &pos);
+    for (size_t c = 0; ok && c < ARRAYLEN(widths); c++) {
+        for (uint32_t i = 0; ok && i < gs_traceRecords; i++) {
+            const tracelog_hdr_t *rec = (const tracelog_hdr_t *)(gs_trace + gs_traceIndex[i]);
+            uint8_t v[8] = {0};
+            switch (c) {
+                case 0:
+                    Uint4byteToMemLe(v, rec->timestamp);
+                    break;
+                case 1:
+                    Uint2byteToMemLe(v, rec->duration);
+                    break;
+                case 2:
+                    v[0] = rec->isResponse;
+                    break;
+                case 3:
+                    v[0] = protocol;
+                    break;
+                case 4:
+                    Uint2byteToMemLe(v, rec->data_len);
+                    break;
+                case 5:
+                    Uint8byteToMemLe(v, gs_traceIndex[i] - (TRACELOG_HDR_LEN * i));
+                    break;
+            }
+            ok = trace_cols_write(f, v, widths[c], &pos);
+        }
+        ok = ok && trace_cols_align(f, &pos);
+    }
+    for (uint32_t i = 0; ok && i < gs_traceRecords; i++) {
+        const tracelog_hdr_t *rec = (const tracelog_hdr_t *)(gs_trace + gs_traceIndex[i]);
+        ok = trace_cols_write(f, rec->frame, rec->data_len + TRACELOG_PARITY_LEN(rec), &pos);
+    }
+
+    if (fclose(f) != 0 || ok == false) {
+        PrintAndLogEx(WARNING, "Failed to write file `" _YELLOW_("%s") "`", fn);
+        return PM3_EFILE;
+    }
+    PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%u") " records, " _YELLOW_("%" PRIu64) " bytes to columnar file `" _YELLOW_("%s") "`", gs_traceRecords, pos, fn);
+    return PM3_SUCCESS;
+}
+
+// Record index of the trace, so a range of records is found without walking the trace.
+// A truncated record at the end is left out.
+static int trace_index(const uint8_t *trace, uint32_t trace_len) {
+    free(gs_traceIndex);
+    gs_traceIndex = NULL;
+    gs_traceRecords = 0;
+
+    uint32_t records = 0;
+    uint32_t pos = 0;
+    while (pos + TRACELOG_HDR_LEN <= trace_len) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(trace + pos);
+        uint32_t len = TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (pos + len > trace_len) {
+            break;
+        }
+        pos += len;
+        records++;
+    }
+
+    if (records == 0) {
+        return PM3_SUCCESS;
+    }
+
+    gs_traceIndex = calloc(records, sizeof(uint32_t));
+    if (gs_traceIndex == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    pos = 0;
+    for (uint32_t i = 0; i < records; i++) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(trace + pos);
+        gs_traceIndex[i] = pos;
+        pos += TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+    }
+    gs_traceRecords = records;
+    return PM3_SUCCESS;
+}
+
+// Flash log, columnar, ring and compact traces as standard records
+static int trace_normalize(uint8_t **trace, uint32_t *trace_len) {
+    int res = trace_unlz4(trace, trace_len);
+    if (res == PM3_SUCCESS) {
+        res = trace_from_cols(trace, trace_len);
+    }
+    if (res == PM3_SUCCESS) {
+        res = trace_unring(trace, trace_len);
+    }
+    if (res == PM3_SUCCESS) {
+        res = trace_expand_compact(trace, trace_len);
+    }
+    if (res != PM3_SUCCESS) {
+        trace_index(*trace, 0);
+        return res;
+    }
+    return trace_index(*trace, *trace_len);
+}
+
+// first and end offset of the records [start, start + count), false when start is past the last record
+static bool trace_range(uint32_t start, uint32_t count, uint32_t *first, uint32_t *end) {
+    if (start >= gs_traceRecords) {
+        return false;
+    }
+    *first = gs_traceIndex[start];
+    *end = gs_traceLen;
+    if (count && (count < gs_traceRecords - start)) {
+        *end = gs_traceIndex[start + count];
+    }
+    return true;
+}
+
 // Copy an existing buffer into client trace buffer
 // I think this is cleaner than further globalizing gs_trace, and may lend itself to more modularity later?
-bool ImportTraceBuffer(const uint8_t *trace_src, uint16_t trace_len) {
+bool ImportTraceBuffer(const uint8_t *trace_src, uint32_t trace_len) {
     if (trace_len == 0 || trace_src == NULL) return (false);
     if (gs_trace) {
         free(gs_trace);
@@ -107,7 +570,539 @@ bool ImportTraceBuffer(const uint8_t *trace_src, uint16_t trace_len) {
     }
     memcpy(gs_trace, trace_src, trace_len);
     gs_traceLen = trace_len;
-    return (true);
+    return (trace_normalize(&gs_trace, &gs_traceLen) == PM3_SUCCESS);
+}
+
+// Live MIFARE Classic key recovery while a trace is streamed. The records go through the same
+// window as extract_mf_auths(), the keys are recovered on worker threads so the stream keeps up
+#define MF_LIVE_MAX_THREADS  4
+#define MF_LIVE_MAX_KEYS     256
+
+typedef struct {
+    bool isResponse;
+    uint16_t data_len;
+    uint8_t frame[32 + 4];      // frames up to 32 bytes and their parity
+} mf_live_rec_t;
+
+typedef struct mf_live_job {
+    struct mf_live_job *next;
+    bool first_auth;
+    uint8_t auth_cmd;           // first authentication only
+    uint8_t block;
+    uint32_t nt;                // plain nonce, for a nested one the nonce of the previous first authentication
+    mf_trace_auth_t auth;
+} mf_live_job_t;
+
+typedef struct {
+    uint32_t uid;
+    uint64_t key;
+} mf_live_key_t;
+
+typedef struct {
+    mf_live_rec_t w[5];
+    uint8_t w_count;
+    uint32_t uid;
+    uint32_t last_nt;
+    bool last_nt_valid;
+
+    const uint64_t *dicKeys;
+    uint32_t dicKeysCount;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    mf_live_job_t *head;
+    mf_live_job_t *tail;
+    bool stop;
+    pthread_t threads[MF_LIVE_MAX_THREADS];
+    int nthreads;
+
+    mf_live_key_t keys[MF_LIVE_MAX_KEYS];
+    uint32_t keys_count;
+    uint32_t auths;
+    uint32_t nested;
+    uint32_t nested_found;
+} mf_live_t;
+
+// false if the key was known for this card already
+static bool mf_live_add_key(mf_live_t *m, uint32_t uid, uint64_t key) {
+    bool added = false;
+    pthread_mutex_lock(&m->lock);
+    uint32_t i = 0;
+    for (; i < m->keys_count; i++) {
+        if (m->keys[i].uid == uid && m->keys[i].key == key) {
+            break;
+        }
+    }
+    if (i == m->keys_count && m->keys_count < MF_LIVE_MAX_KEYS) {
+        m->keys[m->keys_count].uid = uid;
+        m->keys[m->keys_count].key = key;
+        m->keys_count++;
+        added = true;
+    }
+    pthread_mutex_unlock(&m->lock);
+    return added;
+}
+
+static void mf_live_solve(mf_live_t *m, mf_live_job_t *job) {
+    mf_trace_auth_t *a = &job->auth;
+
+    if (job->first_auth) {
+        AuthData_t *ad = calloc(1, sizeof(AuthData_t));
+        if (ad == NULL) {
+            return;
+        }
+        ad->uid = a->uid;
+        ad->nt = job->nt;
+        ad->nr_enc = a->nr_enc;
+        ad->ks2 = a->ar_enc ^ prng_successor(job->nt, 64);
+        ad->ks3 = a->at_enc ^ prng_successor(job->nt, 96);
+        uint64_t key = GetCrypto1ProbableKey(ad);
+        free(ad);
+
+        if (mf_live_add_key(m, a->uid, key)) {
+            PrintAndLogEx(SUCCESS, "uid " _YELLOW_("%08X") " block " _YELLOW_("%3u") " key " _YELLOW_("%c") " ... " _GREEN_("%012" PRIX64),
+                          a->uid, job->block, (job->auth_cmd & 0x01) ? 'B' : 'A', key);
+        }
+        return;
+    }
+
+    __atomic_fetch_add(&m->nested, 1, __ATOMIC_RELAXED);
+
+    // keys already recovered in this sniff first, they are the most likely ones
+    pthread_mutex_lock(&m->lock);
+    uint32_t n = m->keys_count;
+    uint64_t known[MF_LIVE_MAX_KEYS];
+    for (uint32_t i = 0; i < n; i++) {
+        known[i] = m->keys[i].key;
+    }
+    pthread_mutex_unlock(&m->lock);
+
+    MifareTraceFindKeys(a, 1, known, n);
+    if (a->found == false) {
+        MifareTraceFindKeys(a, 1, m->dicKeys, m->dicKeysCount);
+    }
+
+    if (a->found == false && job->nt && validate_prng_nonce(job->nt)) {
+        AuthData_t *ad = calloc(1, sizeof(AuthData_t));
+        if (ad != NULL) {
+            ad->uid = a->uid;
+            ad->nt = job->nt;
+            ad->nt_enc = a->nt_enc;
+            ad->nt_enc_par = a->nt_enc_par;
+            ad->nr_enc = a->nr_enc;
+            ad->ar_enc = a->ar_enc;
+            ad->ar_enc_par = a->ar_enc_par;
+            ad->at_enc = a->at_enc;
+            ad->at_enc_par = a->at_enc_par;
+            a->found = MifareTraceNestedKey(ad, a->cmd, a->cmdsize, a->parity, &a->key);
+            free(ad);
+        }
+    }
+
+    if (a->found == false) {
+        return;
+    }
+
+    __atomic_fetch_add(&m->nested_found, 1, __ATOMIC_RELAXED);
+    if (mf_live_add_key(m, a->uid, a->key)) {
+        PrintAndLogEx(SUCCESS, "uid " _YELLOW_("%08X") " nested auth ......... " _GREEN_("%012" PRIX64), a->uid, a->key);
+    }
+}
+
+static void *mf_live_worker(void *arg) {
+    mf_live_t *m = (mf_live_t *)arg;
+    for (;;) {
+        pthread_mutex_lock(&m->lock);
+        while (m->head == NULL && m->stop == false) {
+            pthread_cond_wait(&m->cond, &m->lock);
+        }
+        mf_live_job_t *job = m->head;
+        if (job) {
+            m->head = job->next;
+            if (m->head == NULL) {
+                m->tail = NULL;
+            }
+        }
+        pthread_mutex_unlock(&m->lock);
+
+        // the queue is drained before the workers stop
+        if (job == NULL) {
+            break;
+        }
+        mf_live_solve(m, job);
+        free(job);
+    }
+    return NULL;
+}
+
+static void mf_live_queue(mf_live_t *m, mf_live_job_t *job) {
+    m->auths++;
+    if (m->nthreads == 0) {
+        mf_live_solve(m, job);
+        free(job);
+        return;
+    }
+    pthread_mutex_lock(&m->lock);
+    if (m->tail) {
+        m->tail->next = job;
+    } else {
+        m->head = job;
+    }
+    m->tail = job;
+    pthread_cond_signal(&m->cond);
+    pthread_mutex_unlock(&m->lock);
+}
+
+static void mf_live_feed(mf_live_t *m, const tracelog_hdr_t *hdr) {
+
+    // UID the same way extract_mf_auths() picks it
+    if (hdr->isResponse && hdr->data_len == 5) {
+        m->uid = bytes_to_num(hdr->frame, 4);
+        m->last_nt_valid = false;
+    }
+    if (hdr->isResponse == false && hdr->data_len == 9 && hdr->frame[1] == 0x70 &&
+            (hdr->frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT || hdr->frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 ||
+             hdr->frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_3)) {
+        m->uid = bytes_to_num(hdr->frame + 2, 4);
+        m->last_nt_valid = false;
+    }
+
+    memmove(m->w, m->w + 1, sizeof(m->w) - sizeof(m->w[0]));
+    mf_live_rec_t *r = &m->w[4];
+    r->isResponse = hdr->isResponse;
+    r->data_len = hdr->data_len;
+    if (hdr->data_len <= 32) {
+        memcpy(r->frame, hdr->frame, hdr->data_len + TRACELOG_PARITY_LEN(hdr));
+    }
+    if (m->w_count < ARRAYLEN(m->w)) {
+        m->w_count++;
+    }
+
+    // a first authentication is complete with the tag answer, w[1..4]
+    const mf_live_rec_t *w = &m->w[1];
+    if (m->w_count >= 4 &&
+            w[0].isResponse == false && w[0].data_len == 4 &&
+            (w[0].frame[0] & 0xF0) == 0x60 && check_crc(CRC_14443_A, (uint8_t *)w[0].frame, w[0].data_len) &&
+            w[1].isResponse && w[1].data_len == 4 &&
+            w[2].isResponse == false && w[2].data_len == 8 &&
+            w[3].isResponse && w[3].data_len == 4) {
+
+        mf_live_job_t *job = calloc(1, sizeof(mf_live_job_t));
+        if (job == NULL) {
+            return;
+        }
+        job->first_auth = true;
+        job->auth_cmd = w[0].frame[0];
+        job->block = w[0].frame[1];
+        job->nt = bytes_to_num(w[1].frame, 4);
+        job->auth.uid = m->uid;
+        job->auth.nr_enc = bytes_to_num(w[2].frame, 4);
+        job->auth.ar_enc = bytes_to_num(w[2].frame + 4, 4);
+        job->auth.at_enc = bytes_to_num(w[3].frame, 4);
+
+        m->last_nt = job->nt;
+        m->last_nt_valid = true;
+        mf_live_queue(m, job);
+        return;
+    }
+
+    // a nested one needs the first encrypted frame after it as well
+    w = &m->w[0];
+    if (m->w_count < 5 ||
+            w[0].isResponse || w[0].data_len != 4 ||
+            w[1].isResponse == false || w[1].data_len != 4 ||
+            w[2].isResponse || w[2].data_len != 8 ||
+            w[3].isResponse == false || w[3].data_len != 4 ||
+            w[4].isResponse || w[4].data_len > 32) {
+        return;
+    }
+    if ((w[0].frame[0] & 0xF0) == 0x60 && check_crc(CRC_14443_A, (uint8_t *)w[0].frame, w[0].data_len)) {
+        return;
+    }
+
+    mf_live_job_t *job = calloc(1, sizeof(mf_live_job_t));
+    if (job == NULL) {
+        return;
+    }
+    job->nt = (m->last_nt_valid) ? m->last_nt : 0;
+    mf_trace_auth_t *a = &job->auth;
+    a->uid = m->uid;
+    a->nt_enc = bytes_to_num(w[1].frame, 4);
+    a->nt_enc_par = w[1].frame[4] & 0xF0;
+    a->nr_enc = bytes_to_num(w[2].frame, 4);
+    a->ar_enc = bytes_to_num(w[2].frame + 4, 4);
+    a->ar_enc_par = w[2].frame[8] << 4;
+    a->at_enc = bytes_to_num(w[3].frame, 4);
+    a->at_enc_par = w[3].frame[4] & 0xF0;
+    a->cmdsize = w[4].data_len;
+    memcpy(a->cmd, w[4].frame, w[4].data_len);
+    memcpy(a->parity, w[4].frame + w[4].data_len, (w[4].data_len + 7) / 8);
+    mf_live_queue(m, job);
+}
+
+static void mf_live_start(mf_live_t *m, const uint64_t *dicKeys, uint32_t dicKeysCount) {
+    memset(m, 0, sizeof(mf_live_t));
+    m->dicKeys = dicKeys;
+    m->dicKeysCount = dicKeysCount;
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->cond, NULL);
+
+    int n = MIN(num_CPUs(), MF_LIVE_MAX_THREADS);
+    for (; m->nthreads < n; m->nthreads++) {
+        if (pthread_create(&m->threads[m->nthreads], NULL, mf_live_worker, m) != 0) {
+            break;
+        }
+    }
+}
+
+static void mf_live_stop(mf_live_t *m) {
+    pthread_mutex_lock(&m->lock);
+    m->stop = true;
+    pthread_cond_broadcast(&m->cond);
+    pthread_mutex_unlock(&m->lock);
+
+    if (m->head) {
+        PrintAndLogEx(INFO, "Finishing the queued authentications...");
+    }
+    for (int i = 0; i < m->nthreads; i++) {
+        pthread_join(m->threads[i], NULL);
+    }
+    pthread_cond_destroy(&m->cond);
+    pthread_mutex_destroy(&m->lock);
+
+    PrintAndLogEx(SUCCESS, "Authentications " _YELLOW_("%u") ", nested " _YELLOW_("%u") " of which " _YELLOW_("%u") " cracked",
+                  m->auths, m->nested, m->nested_found);
+    if (m->keys_count == 0) {
+        return;
+    }
+    PrintAndLogEx(INFO, "-----+----------+--------------");
+    PrintAndLogEx(INFO, "  #  |   uid    | key");
+    PrintAndLogEx(INFO, "-----+----------+--------------");
+    for (uint32_t i = 0; i < m->keys_count; i++) {
+        PrintAndLogEx(INFO, " %3u | %08X | " _GREEN_("%012" PRIX64), i, m->keys[i].uid, m->keys[i].key);
+    }
+    PrintAndLogEx(INFO, "-----+----------+--------------");
+    PrintAndLogEx(HINT, "Hint: Try `" _YELLOW_("hf mf fchk") "` with these keys");
+}
+
+// Streamed trace, see TRACELOG_STREAM_MAGIC. Small buffers so records show up soon
+#define TRACE_STREAM_BUF_COUNT  16
+#define TRACE_STREAM_BUF_SIZE   1024
+
+typedef struct {
+    uint8_t *pend;          // received bytes, not a complete record yet
+    size_t pend_len;
+    size_t pend_cap;
+    uint32_t trace_cap;
+    bool started;
+    bool ended;
+    uint32_t records;
+    uint32_t dropped;
+    FILE *f;
+    uint64_t last_print;
+    mf_live_t *mf;          // live MIFARE Classic key recovery, optional
+} trace_stream_ctx_t;
+
+static bool trace_stream_append(trace_stream_ctx_t *c, const uint8_t *rec, uint32_t len) {
+    if (gs_traceLen + len > c->trace_cap) {
+        uint32_t cap = (c->trace_cap) ? c->trace_cap : 0x10000;
+        while (cap < gs_traceLen + len) {
+            cap *= 2;
+        }
+        uint8_t *tmp = realloc(gs_trace, cap);
+        if (tmp == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return false;
+        }
+        gs_trace = tmp;
+        c->trace_cap = cap;
+    }
+    memcpy(gs_trace + gs_traceLen, rec, len);
+    gs_traceLen += len;
+    if (c->f) {
+        fwrite(rec, 1, len, c->f);
+    }
+    if (c->mf) {
+        mf_live_feed(c->mf, (const tracelog_hdr_t *)rec);
+    }
+    c->records++;
+    return true;
+}
+
+static bool trace_stream_cb(const uint8_t *data, size_t len, void *ctx) {
+    trace_stream_ctx_t *c = (trace_stream_ctx_t *)ctx;
+
+    if (c->pend_len + len > c->pend_cap) {
+        size_t cap = c->pend_len + len;
+        uint8_t *tmp = realloc(c->pend, cap);
+        if (tmp == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return false;
+        }
+        c->pend = tmp;
+        c->pend_cap = cap;
+    }
+    memcpy(c->pend + c->pend_len, data, len);
+    c->pend_len += len;
+
+    size_t pos = 0;
+
+    // anything the device sent before the stream started is skipped
+    while (c->started == false && pos + TRACELOG_HDR_LEN <= c->pend_len) {
+        if (trace_stream_marker(c->pend + pos, TRACELOG_STREAM_MAGIC)) {
+            c->started = true;
+            pos += TRACELOG_HDR_LEN;
+        } else {
+            pos++;
+        }
+    }
+
+    while (c->started && pos + TRACELOG_HDR_LEN <= c->pend_len) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(c->pend + pos);
+        if (trace_stream_marker(c->pend + pos, 0)) {
+            c->dropped = hdr->timestamp;
+            c->ended = true;
+            break;
+        }
+        uint32_t rec_len = TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (pos + rec_len > c->pend_len) {
+            break;
+        }
+        if (trace_stream_append(c, c->pend + pos, rec_len) == false) {
+            return false;
+        }
+        pos += rec_len;
+    }
+
+    memmove(c->pend, c->pend + pos, c->pend_len - pos);
+    c->pend_len -= pos;
+
+    if (msclock() - c->last_print > 1000) {
+        c->last_print = msclock();
+        PrintAndLogEx(INPLACE, "%u frames, %u bytes", c->records, gs_traceLen);
+    }
+    return (c->ended == false);
+}
+
+static int trace_stream_sniff_ex(uint16_t cmd, const uint8_t *payload, uint16_t payload_len, const char *filename, mf_live_t *mf) {
+
+    trace_stream_ctx_t c;
+    memset(&c, 0, sizeof(c));
+    c.mf = mf;
+
+    char *fn = NULL;
+    if (filename && filename[0]) {
+        fn = newfilenamemcopy(filename, ".trace");
+        if (fn == NULL) {
+            return PM3_EMALLOC;
+        }
+        c.f = fopen(fn, "wb");
+        if (c.f == NULL) {
+            PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fn);
+            free(fn);
+            return PM3_EFILE;
+        }
+    }
+
+    uint8_t *mem = calloc(TRACE_STREAM_BUF_COUNT, TRACE_STREAM_BUF_SIZE);
+    if (mem == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        if (c.f) {
+            fclose(c.f);
+        }
+        free(fn);
+        return PM3_EMALLOC;
+    }
+    uint8_t *bufs[TRACE_STREAM_BUF_COUNT];
+    for (uint8_t i = 0; i < TRACE_STREAM_BUF_COUNT; i++) {
+        bufs[i] = mem + (i * TRACE_STREAM_BUF_SIZE);
+    }
+
+    // the streamed records replace the trace buffer
+    free(gs_trace);
+    gs_trace = NULL;
+    gs_traceLen = 0;
+
+    int res = PM3_SUCCESS;
+    clearCommandBuffer();
+    if (StartRawDataStream(bufs, TRACE_STREAM_BUF_COUNT, TRACE_STREAM_BUF_SIZE, (size_t) -1) == false) {
+        res = PM3_EFAILED;
+    } else {
+        SendCommandNG(cmd, (uint8_t *)payload, payload_len);
+        PrintAndLogEx(INFO, "Streaming trace, press " _GREEN_("<Enter>") " or " _GREEN_("pm3 button") " to stop");
+        c.last_print = msclock();
+        WaitForRawDataStream((size_t) -1, false, false, trace_stream_cb, &c);
+        PrintAndLogEx(NORMAL, "");
+    }
+    free(mem);
+    free(c.pend);
+    trace_index(gs_trace, gs_traceLen);
+
+    if (c.started == false && res == PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "no trace stream received, the device needs to be connected over USB");
+        res = PM3_ESOFT;
+    } else if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Received " _YELLOW_("%u") " frames, " _YELLOW_("%u") " bytes", c.records, gs_traceLen);
+        if (c.ended == false) {
+            PrintAndLogEx(WARNING, "stream ended without end marker, the last frames may be missing");
+        }
+        if (c.dropped) {
+            PrintAndLogEx(WARNING, "device dropped " _RED_("%u") " frames, the host was too slow", c.dropped);
+        }
+    }
+
+    if (c.f) {
+        fclose(c.f);
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%u") " bytes to binary file `" _YELLOW_("%s") "`", gs_traceLen, fn);
+    }
+    free(fn);
+    return res;
+}
+
+int trace_stream_sniff(uint16_t cmd, const uint8_t *payload, uint16_t payload_len, const char *filename) {
+    return trace_stream_sniff_ex(cmd, payload, payload_len, filename, NULL);
+}
+
+int trace_stream_sniff_mf(uint16_t cmd, const uint8_t *payload, uint16_t payload_len, const char *filename, const char *dictionary) {
+
+    const uint64_t *dicKeys = g_mifare_default_keys;
+    uint32_t dicKeysCount = ARRAYLEN(g_mifare_default_keys);
+    uint64_t *loaded = NULL;
+
+    if (dictionary && dictionary[0]) {
+        uint8_t *keyBlock = NULL;
+        uint32_t count = 0;
+        int res = loadFileDICTIONARY_safe(dictionary, (void **) &keyBlock, 6, &count);
+        if (res != PM3_SUCCESS || count == 0 || keyBlock == NULL) {
+            PrintAndLogEx(FAILED, "An error occurred while loading the dictionary! (we will use the default keys now)");
+        } else {
+            loaded = calloc(count, sizeof(uint64_t));
+            if (loaded) {
+                for (uint32_t i = 0; i < count; i++) {
+                    loaded[i] = bytes_to_num(keyBlock + i * 6, 6);
+                }
+                dicKeys = loaded;
+                dicKeysCount = count;
+            }
+        }
+        free(keyBlock);
+    }
+
+    mf_live_t *m = calloc(1, sizeof(mf_live_t));
+    if (m == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(loaded);
+        return PM3_EMALLOC;
+    }
+    mf_live_start(m, dicKeys, dicKeysCount);
+    PrintAndLogEx(INFO, "Recovering MIFARE Classic keys while sniffing, " _YELLOW_("%u") " dictionary keys for nested authentications", dicKeysCount);
+
+    int res = trace_stream_sniff_ex(cmd, payload, payload_len, filename, m);
+
+    mf_live_stop(m);
+    free(m);
+    free(loaded);
+    return res;
 }
 
 static uint8_t extract_uid[10] = {0};
@@ -116,7 +1111,7 @@ static uint8_t extract_epurse[8] = {0};
 
 #define SKIP_TO_NEXT(a)  (TRACELOG_HDR_LEN + (a)->data_len + TRACELOG_PARITY_LEN((a)))
 
-static uint16_t extractChall_ev2(uint16_t tracepos, uint8_t *trace, uint8_t cmdpos, uint8_t long_jmp) {
+static uint32_t extractChall_ev2(uint32_t tracepos, uint8_t *trace, uint8_t cmdpos, uint8_t long_jmp) {
     tracelog_hdr_t *next_hdr = (tracelog_hdr_t *)(trace + tracepos);
     if (next_hdr->data_len != 21) {
         return 0;
@@ -137,7 +1132,7 @@ static uint16_t extractChall_ev2(uint16_t tracepos, uint8_t *trace, uint8_t cmdp
     return tracepos;
 }
 
-static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t *trace) {
+static uint32_t extractChallenges(uint32_t tracepos, uint32_t traceLen, uint8_t *trace) {
 
     // sanity check
     if (is_last_record(tracepos, traceLen)) {
@@ -411,7 +1406,7 @@ static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t
             }
             case MFDES_AUTHENTICATE_EV2F: {
                 PrintAndLogEx(INFO, "Found a MFDES Auth EV2 First");
-                uint16_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
+                uint32_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
                 if (tmp == 0)
                     break;
                 else
@@ -420,7 +1415,7 @@ static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t
             }
             case MFDES_AUTHENTICATE_EV2NF: {
                 PrintAndLogEx(INFO, "Found a MFDES Auth EV2 Non First");
-                uint16_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
+                uint32_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
                 if (tmp == 0)
                     break;
                 else
@@ -432,7 +1427,77 @@ static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t
     return tracepos;
 }
 
-static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol) {
+// Nested MIFARE Classic authentications in [tracepos, end), by frame sizes: an encrypted
+// auth command, nt, nr ar, at and the first encrypted reader frame. The listing only knows
+// an authentication is nested after decrypting the frames before it, this has to guess.
+static size_t extract_mf_auths(uint32_t tracepos, uint32_t end, mf_trace_auth_t **auths) {
+    const tracelog_hdr_t *w[5] = {NULL};
+    size_t count = 0, cap = 0;
+    uint32_t uid = 0;
+
+    *auths = NULL;
+
+    while (tracepos < end && is_last_record(tracepos, gs_traceLen) == false) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(gs_trace + tracepos);
+        tracepos += SKIP_TO_NEXT(hdr);
+        if (tracepos > gs_traceLen) {
+            break;
+        }
+
+        // UID the same way annotateMifare() picks it
+        if (hdr->isResponse && hdr->data_len == 5) {
+            uid = bytes_to_num(hdr->frame, 4);
+        }
+        if (hdr->isResponse == false && hdr->data_len == 9 && hdr->frame[1] == 0x70 &&
+                (hdr->frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT || hdr->frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 ||
+                 hdr->frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_3)) {
+            uid = bytes_to_num(hdr->frame + 2, 4);
+        }
+
+        memmove(w, w + 1, sizeof(w) - sizeof(w[0]));
+        w[4] = hdr;
+
+        if (w[0] == NULL ||
+                w[0]->isResponse || w[0]->data_len != 4 ||
+                w[1]->isResponse == false || w[1]->data_len != 4 ||
+                w[2]->isResponse || w[2]->data_len != 8 ||
+                w[3]->isResponse == false || w[3]->data_len != 4 ||
+                w[4]->isResponse || w[4]->data_len > 32) {
+            continue;
+        }
+
+        // a plain auth command is the first authentication, mfkey64 finds that key
+        if ((w[0]->frame[0] & 0xF0) == 0x60 && check_crc(CRC_14443_A, w[0]->frame, w[0]->data_len)) {
+            continue;
+        }
+
+        if (count == cap) {
+            cap = (cap) ? cap * 2 : 64;
+            mf_trace_auth_t *tmp = realloc(*auths, cap * sizeof(mf_trace_auth_t));
+            if (tmp == NULL) {
+                break;
+            }
+            *auths = tmp;
+        }
+
+        mf_trace_auth_t *a = &(*auths)[count++];
+        memset(a, 0, sizeof(mf_trace_auth_t));
+        a->uid = uid;
+        a->nt_enc = bytes_to_num(w[1]->frame, 4);
+        a->nt_enc_par = w[1]->frame[4] & 0xF0;
+        a->nr_enc = bytes_to_num(w[2]->frame, 4);
+        a->ar_enc = bytes_to_num(w[2]->frame + 4, 4);
+        a->ar_enc_par = w[2]->frame[8] << 4;
+        a->at_enc = bytes_to_num(w[3]->frame, 4);
+        a->at_enc_par = w[3]->frame[4] & 0xF0;
+        a->cmdsize = w[4]->data_len;
+        memcpy(a->cmd, w[4]->frame, w[4]->data_len);
+        memcpy(a->parity, w[4]->frame + w[4]->data_len, TRACELOG_PARITY_LEN(w[4]));
+    }
+    return count;
+}
+
+static uint32_t printHexLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol) {
     // sanity check
     if (is_last_record(tracepos, traceLen)) return traceLen;
 
@@ -450,7 +1515,7 @@ static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trac
         return tracepos;
     }
 
-    uint16_t ret;
+    uint32_t ret;
 
     switch (protocol) {
         case ISO_14443A: {
@@ -498,7 +1563,7 @@ static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trac
     return ret;
 }
 
-static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us,
+static uint32_t printTraceLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us,
                                const uint64_t *mfDicKeys, uint32_t mfDicKeysCount) {
     // sanity check
     if (is_last_record(tracepos, traceLen)) {
@@ -606,7 +1671,9 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
     // number of hex bytes to be printed per row  (16 data + 2 crc)
 #define TRACE_MAX_HEX_BYTES  18
 
-    char line[TRACE_MAX_LINES][160] = {{0}};
+    // only clear the rows this frame can touch, the full table is 5.7kB per record
+    char line[TRACE_MAX_LINES][160];
+    memset(line, 0, MIN(data_len / TRACE_MAX_HEX_BYTES + 2, TRACE_MAX_LINES) * sizeof(line[0]));
 
     if (data_len == 0) {
         if (protocol == ICLASS && duration == 2048) {
@@ -638,7 +1705,7 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
                 && (hdr->isResponse || protocol == ISO_14443A || protocol == PROTO_MIFARE || protocol == PROTO_MFPLUS || protocol == SEOS)
                 && (oddparity8(frame[j]) != ((parityBits >> (7 - (j & 0x0007))) & 0x01))) {
 
-            snprintf(line[j / 18] + ((j % 18) * 4), 120, "%02X! ", frame[j]);
+            trace_hex_cell(line[j / 18] + ((j % 18) * 4), frame[j], '!');
 
         } else if (protocol == ICLASS  && hdr->isResponse == false) {
 
@@ -647,11 +1714,7 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
                 parity ^= ((frame[0] >> i) & 1);
             }
 
-            if (parity == ((frame[0] >> 7) & 1)) {
-                snprintf(line[j / 18] + ((j % 18) * 4), 120, "%02X  ", frame[j]);
-            } else {
-                snprintf(line[j / 18] + ((j % 18) * 4), 120, "%02X! ", frame[j]);
-            }
+            trace_hex_cell(line[j / 18] + ((j % 18) * 4), frame[j], (parity == ((frame[0] >> 7) & 1)) ? ' ' : '!');
 
         } else if (((protocol == PROTO_HITAG1) || (protocol == PROTO_HITAG2) || (protocol == PROTO_HITAGS) || (protocol == PROTO_HITAGU))) {
 
@@ -676,11 +1739,11 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
                 offset = 4;
 
             } else {
-                snprintf(line[j / 18] + ((j % 18) * 4) + offset, 120, "%02X  ", frame[j]);
+                trace_hex_cell(line[j / 18] + ((j % 18) * 4) + offset, frame[j], ' ');
             }
 
         } else {
-            snprintf(line[j / 18] + ((j % 18) * 4), 120, "%02X  ", frame[j]);
+            trace_hex_cell(line[j / 18] + ((j % 18) * 4), frame[j], ' ');
         }
 
     }
@@ -1029,7 +2092,7 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
                     offset = 4;
 
                 } else {
-                    snprintf(line[j / 18] + ((j % 18) * 4) + offset, 120, "%02X  ", ht2plain[j]);
+                    trace_hex_cell(line[j / 18] + ((j % 18) * 4) + offset, ht2plain[j], ' ');
                 }
             }
 
@@ -1087,6 +2150,175 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
     return tracepos;
 }
 
+// `trace list --plain` prints one row per record: times, source and the raw frame bytes.
+// Without colors, CRC checks and annotations no protocol state is carried from one record
+// to the next, so rows are formatted on all cores chunk by chunk and printed in record order.
+#define TRACE_PLAIN_CHUNK   1024    // records per job
+#define TRACE_PLAIN_BYTES   256     // frame bytes per row, longer frames wrap
+#define TRACE_PLAIN_ROW     48      // times and source columns of a row, with margin
+
+typedef struct {
+    char *text;
+    size_t len;
+} trace_plain_chunk_t;
+
+typedef struct {
+    uint32_t first;         // first record to show
+    uint32_t last;          // one past the last record to show
+    uint8_t protocol;
+    bool relative;
+    bool use_us;
+    trace_plain_chunk_t *chunks;
+    size_t nchunks;
+    size_t next;
+} trace_plain_t;
+
+static uint32_t trace_plain_duration(const tracelog_hdr_t *hdr, uint8_t protocol) {
+    if (protocol == ICLASS || protocol == ISO_15693) {
+        return hdr->duration * 32;
+    }
+    return hdr->duration;
+}
+
+static void trace_plain_format(const trace_plain_t *p, trace_plain_chunk_t *c, uint32_t from, uint32_t to) {
+    static const char hexdigits[] = "0123456789ABCDEF";
+    const tracelog_hdr_t *first_hdr = (const tracelog_hdr_t *)gs_trace;
+
+    size_t size = 1;
+    for (uint32_t i = from; i < to; i++) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(gs_trace + gs_traceIndex[i]);
+        size += (hdr->data_len / TRACE_PLAIN_BYTES + 1) * TRACE_PLAIN_ROW + hdr->data_len * 3;
+    }
+
+    c->text = malloc(size);
+    if (c->text == NULL) {
+        return;
+    }
+
+    char *out = c->text;
+    for (uint32_t i = from; i < to; i++) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(gs_trace + gs_traceIndex[i]);
+        uint32_t duration = trace_plain_duration(hdr, p->protocol);
+
+        uint32_t time1 = hdr->timestamp - first_hdr->timestamp;
+        uint32_t time2 = hdr->timestamp + duration - first_hdr->timestamp;
+        if (p->relative) {
+            uint32_t prev_eot = hdr->timestamp;
+            if (i) {
+                const tracelog_hdr_t *prev = (const tracelog_hdr_t *)(gs_trace + gs_traceIndex[i - 1]);
+                prev_eot = prev->timestamp + trace_plain_duration(prev, p->protocol);
+            }
+            time1 = hdr->timestamp - prev_eot;
+            time2 = duration;
+        }
+
+        if (p->use_us) {
+            out += snprintf(out, TRACE_PLAIN_ROW, " %10.1f | %10.1f | %s |", (float)time1 / 13.56, (float)time2 / 13.56, hdr->isResponse ? "Tag" : "Rdr");
+        } else {
+            out += snprintf(out, TRACE_PLAIN_ROW, " %10u | %10u | %s |", time1, time2, hdr->isResponse ? "Tag" : "Rdr");
+        }
+
+        for (uint16_t j = 0; j < hdr->data_len; j++) {
+            if (j && (j % TRACE_PLAIN_BYTES) == 0) {
+                out += snprintf(out, TRACE_PLAIN_ROW, "\n            |            |     |");
+            }
+            *out++ = ' ';
+            *out++ = hexdigits[hdr->frame[j] >> 4];
+            *out++ = hexdigits[hdr->frame[j] & 0x0F];
+        }
+        *out++ = '\n';
+    }
+    *out = '\0';
+    c->len = out - c->text;
+}
+
+static void *trace_plain_worker(void *arg) {
+    trace_plain_t *p = arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED);
+        if (i >= p->nchunks) {
+            break;
+        }
+        uint32_t from = p->first + (i * TRACE_PLAIN_CHUNK);
+        trace_plain_format(p, &p->chunks[i], from, MIN(from + TRACE_PLAIN_CHUNK, p->last));
+    }
+    return NULL;
+}
+
+// hand PrintAndLogEx whole rows, as many as fit in its buffer
+static void trace_plain_print(const char *text, size_t len) {
+    while (len) {
+        size_t n = len;
+        if (n > MAX_PRINT_BUFFER - 1) {
+            n = MAX_PRINT_BUFFER - 1;
+            while (n && text[n - 1] != '\n') {
+                n--;
+            }
+        }
+        // rows end with a newline, PrintAndLogEx adds its own
+        PrintAndLogEx(NORMAL, "%.*s", (int)(n - 1), text);
+        text += n;
+        len -= n;
+    }
+}
+
+static int trace_list_plain(uint32_t first, uint32_t last, uint8_t protocol, bool relative, bool use_us) {
+    trace_plain_t p = {
+        .first = first,
+        .last = last,
+        .protocol = protocol,
+        .relative = relative,
+        .use_us = use_us,
+        .nchunks = ((last - first) + TRACE_PLAIN_CHUNK - 1) / TRACE_PLAIN_CHUNK,
+    };
+    p.chunks = calloc(p.nchunks, sizeof(trace_plain_chunk_t));
+    if (p.chunks == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    int n = MIN(num_CPUs(), (int)p.nchunks);
+    pthread_t *tids = calloc(n, sizeof(pthread_t));
+    int started = 0;
+    for (; tids && started < n; started++) {
+        if (pthread_create(&tids[started], NULL, trace_plain_worker, &p) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        trace_plain_worker(&p);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    if (relative) {
+        PrintAndLogEx(NORMAL, "        Gap |   Duration | Src | Data");
+    } else {
+        PrintAndLogEx(NORMAL, "      Start |        End | Src | Data");
+    }
+    PrintAndLogEx(NORMAL, "------------+------------+-----+-----");
+
+    int res = PM3_SUCCESS;
+    for (size_t i = 0; i < p.nchunks; i++) {
+        if (res == PM3_SUCCESS) {
+            if (p.chunks[i].text == NULL) {
+                PrintAndLogEx(WARNING, "Failed to allocate memory");
+                res = PM3_EMALLOC;
+            } else if (kbd_enter_pressed()) {
+                PrintAndLogEx(INFO, "User interrupted detected. Aborting");
+                res = PM3_EOPABORTED;
+            } else {
+                trace_plain_print(p.chunks[i].text, p.chunks[i].len);
+            }
+        }
+        free(p.chunks[i].text);
+    }
+    free(p.chunks);
+    return res;
+}
+
 static int download_trace(void) {
 
     if (IfPm3Present() == false) {
@@ -1137,7 +2369,79 @@ static int download_trace(void) {
             return PM3_ETIMEOUT;
         }
     }
-    return PM3_SUCCESS;
+    return trace_normalize(&gs_trace, &gs_traceLen);
+}
+
+size_t trace_mf_first_auths(mf_trace_auth_t **auths) {
+    *auths = NULL;
+
+    if (gs_traceLen == 0 && download_trace() != PM3_SUCCESS) {
+        return 0;
+    }
+
+    const tracelog_hdr_t *w[4] = {NULL};
+    size_t count = 0, cap = 0;
+    uint32_t uid = 0;
+    uint32_t tracepos = 0;
+
+    // one more round after the last record, an authentication without at can end the trace
+    for (bool more = true; more;) {
+        const tracelog_hdr_t *hdr = NULL;
+        if (is_last_record(tracepos, gs_traceLen) == false) {
+            hdr = (const tracelog_hdr_t *)(gs_trace + tracepos);
+            tracepos += SKIP_TO_NEXT(hdr);
+            if (tracepos > gs_traceLen) {
+                hdr = NULL;
+            }
+        }
+        more = (hdr != NULL);
+
+        // UID the same way annotateMifare() picks it
+        if (hdr && hdr->isResponse && hdr->data_len == 5) {
+            uid = bytes_to_num(hdr->frame, 4);
+        }
+        if (hdr && hdr->isResponse == false && hdr->data_len == 9 && hdr->frame[1] == 0x70 &&
+                (hdr->frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT || hdr->frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 ||
+                 hdr->frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_3)) {
+            uid = bytes_to_num(hdr->frame + 2, 4);
+        }
+
+        memmove(w, w + 1, sizeof(w) - sizeof(w[0]));
+        w[3] = hdr;
+
+        if (w[0] == NULL || w[1] == NULL || w[2] == NULL ||
+                w[0]->isResponse || w[0]->data_len != 4 ||
+                (w[0]->frame[0] & 0xFE) != MIFARE_AUTH_KEYA ||
+                check_crc(CRC_14443_A, w[0]->frame, w[0]->data_len) == false ||
+                w[1]->isResponse == false || w[1]->data_len != 4 ||
+                w[2]->isResponse || w[2]->data_len != 8) {
+            continue;
+        }
+
+        if (count == cap) {
+            cap = (cap) ? cap * 2 : 64;
+            mf_trace_auth_t *tmp = realloc(*auths, cap * sizeof(mf_trace_auth_t));
+            if (tmp == NULL) {
+                break;
+            }
+            *auths = tmp;
+        }
+
+        mf_trace_auth_t *a = &(*auths)[count++];
+        memset(a, 0, sizeof(mf_trace_auth_t));
+        a->first = true;
+        a->uid = uid;
+        a->block = w[0]->frame[1];
+        a->keytype = w[0]->frame[0] & 0x01;
+        a->nt_enc = bytes_to_num(w[1]->frame, 4);
+        a->nr_enc = bytes_to_num(w[2]->frame, 4);
+        a->ar_enc = bytes_to_num(w[2]->frame + 4, 4);
+        if (w[3] && w[3]->isResponse && w[3]->data_len == 4) {
+            a->has_at = true;
+            a->at_enc = bytes_to_num(w[3]->frame, 4);
+        }
+    }
+    return count;
 }
 
 // sanity check. Don't use proxmark if it is offline and you didn't specify useTraceBuffer
@@ -1151,21 +2455,57 @@ static int SanityOfflineCheck( bool useTraceBuffer ){
 }
 */
 
+// `trace list -t` protocol names, empty is raw
+static bool trace_get_protocol(const char *type, uint8_t *protocol) {
+    // no crc, no annotations
+    *protocol = -1;
+
+    if (strcmp(type, "14a") == 0)      *protocol = ISO_14443A;
+    else if (strcmp(type, "14b") == 0)      *protocol = ISO_14443B;
+    else if (strcmp(type, "15") == 0)       *protocol = ISO_15693;
+    else if (strcmp(type, "7816") == 0)     *protocol = ISO_7816_4;
+    else if (strcmp(type, "cryptorf") == 0) *protocol = PROTO_CRYPTORF;
+    else if (strcmp(type, "des") == 0)      *protocol = MFDES;
+    else if (strcmp(type, "felica") == 0)   *protocol = FELICA;
+    else if (strcmp(type, "ht1") == 0)   *protocol = PROTO_HITAG1;
+    else if (strcmp(type, "ht2") == 0)   *protocol = PROTO_HITAG2;
+    else if (strcmp(type, "hts") == 0)   *protocol = PROTO_HITAGS;
+    else if (strcmp(type, "htu") == 0)   *protocol = PROTO_HITAGU;
+    else if (strcmp(type, "iclass") == 0)   *protocol = ICLASS;
+    else if (strcmp(type, "legic") == 0)    *protocol = LEGIC;
+    else if (strcmp(type, "lto") == 0)      *protocol = LTO;
+    else if (strcmp(type, "mf") == 0)       *protocol = PROTO_MIFARE;
+    else if (strcmp(type, "raw") == 0)      *protocol = -1;
+    else if (strcmp(type, "seos") == 0)     *protocol = SEOS;
+    else if (strcmp(type, "thinfilm") == 0) *protocol = THINFILM;
+    else if (strcmp(type, "topaz") == 0)    *protocol = TOPAZ;
+    else if (strcmp(type, "mfp") == 0)      *protocol = PROTO_MFPLUS;
+    else if (strcmp(type, "fmcos20") == 0)  *protocol = PROTO_FMCOS20;
+    else if (strcmp(type, "") == 0)         *protocol = -1;
+    else return false;
+    return true;
+}
+
 static int CmdTraceExtract(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "trace extract",
                   "Extracts protocol authentication challenges from trace buffer\n",
                   "trace extract\n"
                   "trace extract -1\n"
+                  "trace extract -1 --start 1000 --count 500\n"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("1", "buffer", "use data from trace buffer"),
+        arg_u64_0(NULL, "start", "<dec>", "first record (def 0)"),
+        arg_u64_0(NULL, "count", "<dec>", "number of records (def all)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     bool use_buffer = arg_get_lit(ctx, 1);
+    uint32_t start = arg_get_u32_def(ctx, 2, 0);
+    uint32_t count = arg_get_u32_def(ctx, 3, 0);
     CLIParserFree(ctx);
 
     clearCommandBuffer();
@@ -1178,14 +2518,19 @@ static int CmdTraceExtract(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    PrintAndLogEx(SUCCESS, "Recorded activity ( " _YELLOW_("%u") " bytes )", gs_traceLen);
+    PrintAndLogEx(SUCCESS, "Recorded activity ( " _YELLOW_("%u") " bytes, " _YELLOW_("%u") " records )", gs_traceLen, gs_traceRecords);
     if (gs_traceLen == 0) {
         return PM3_SUCCESS;
     }
 
-    uint16_t tracepos = 0;
+    uint32_t tracepos = 0, end = 0;
+    if (trace_range(start, count, &tracepos, &end) == false) {
+        PrintAndLogEx(WARNING, "No records from " _YELLOW_("%u"), start);
+        return PM3_EINVARG;
+    }
 
-    while (tracepos < gs_traceLen) {
+    // challenges spanning the end record are still extracted, only the start is limited
+    while (tracepos < end) {
         tracepos = extractChallenges(tracepos, gs_traceLen, gs_trace);
 
         if (kbd_enter_pressed()) {
@@ -1200,7 +2545,7 @@ static int CmdTraceLoad(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "trace load",
                   "Load protocol data from binary file to trace buffer\n"
-                  "File extension is <.trace>",
+                  "File extension is <.trace>, columnar files from `trace save --cols` are <.trcol>",
                   "trace load -f mytracefile    -> w/o file extension"
                  );
 
@@ -1223,14 +2568,22 @@ static int CmdTraceLoad(const char *Cmd) {
     }
 
     size_t len = 0;
-    if (loadFile_safe(filename, ".trace", (void **)&gs_trace, &len) != PM3_SUCCESS) {
+    const char *suffix = str_endswith(filename, ".trcol") ? ".trcol" : ".trace";
+    if (loadFile_safe(filename, suffix, (void **)&gs_trace, &len) != PM3_SUCCESS) {
         PrintAndLogEx(FAILED, "Could not open file " _YELLOW_("%s"), filename);
         return PM3_EIO;
     }
 
     gs_traceLen = (long)len;
+    int res = trace_normalize(&gs_trace, &gs_traceLen);
+    if (res == PM3_EMALLOC) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+    }
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
 
-    PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%u") " bytes)", gs_traceLen);
+    PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%u") " bytes, " _YELLOW_("%u") " records)", gs_traceLen, gs_traceRecords);
     PrintAndLogEx(HINT, "Hint: Try `" _YELLOW_("trace list -1 -t ...") "` to view trace.  Remember the " _YELLOW_("`-1`") " param");
     return PM3_SUCCESS;
 }
@@ -1240,13 +2593,18 @@ static int CmdTraceSave(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "trace save",
                   "Save protocol data from trace buffer to binary file\n"
-                  "File extension is <.trace>",
-                  "trace save -f mytracefile    -> w/o file extension"
+                  "File extension is <.trace>\n"
+                  "With --cols the file has fixed width columns and a payload blob for external tools,\n"
+                  "the layout is described in client/src/cmdtrace.h. `trace load` reads both, extension <.trcol>",
+                  "trace save -f mytracefile                -> w/o file extension\n"
+                  "trace save -f mytracefile --cols -t 14a  -> columnar file, records tagged as ISO14443-A"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_str1("f", "file", "<fn>", "Specify trace file to save"),
+        arg_lit0(NULL, "cols", "save as columnar file"),
+        arg_str0("t", "type", "<str>", "protocol of the records in the columnar file, see `trace list -h` (def raw)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -1254,8 +2612,20 @@ static int CmdTraceSave(const char *Cmd) {
     int fnlen = 0;
     char filename[FILE_PATH_SIZE] = {0};
     CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    bool cols = arg_get_lit(ctx, 2);
+
+    int tlen = 0;
+    char type[10] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)type, sizeof(type), &tlen);
+    str_lower(type);
     CLIParserFree(ctx);
 
+    uint8_t protocol = -1;
+    if (trace_get_protocol(type, &protocol) == false) {
+        PrintAndLogEx(FAILED, "Unknown protocol \"%s\"", type);
+        return PM3_EINVARG;
+    }
+
     if (gs_traceLen == 0) {
         download_trace();
         if (gs_traceLen == 0) {
@@ -1264,6 +2634,16 @@ static int CmdTraceSave(const char *Cmd) {
         }
     }
 
+    if (cols) {
+        char *fn = newfilenamemcopy(filename, ".trcol");
+        if (fn == NULL) {
+            return PM3_EMALLOC;
+        }
+        int res = trace_save_cols(fn, protocol);
+        free(fn);
+        return res;
+    }
+
     saveFile(filename, ".trace", gs_trace, gs_traceLen);
     return PM3_SUCCESS;
 }
@@ -1336,7 +2716,9 @@ int CmdTraceList(const char *Cmd) {
                   "\n"
                   "trace list -t mf -f mfc_default_keys.dic     -> use default dictionary file\n"
                   "trace list -t 14a --frame                    -> show frame delay times\n"
-                  "trace list -t 14a -1                         -> use trace buffer "
+                  "trace list -t 14a -1                         -> use trace buffer\n"
+                  "trace list -t 14a -1 --start 1000 --count 50 -> records 1000 to 1049\n"
+                  "trace list -t 14a -1 --plain                 -> plain rows for piping into other tools"
                  );
 
     void *argtable[] = {
@@ -1350,6 +2732,9 @@ int CmdTraceList(const char *Cmd) {
                  "                                   or to import into Wireshark using encapsulation type \"ISO 14443\""),
         arg_str0("t", "type", "<str>", "protocol to annotate the trace"),
         arg_str0("f", "file", "<fn>", "filename of dictionary"),
+        arg_u64_0(NULL, "start", "<dec>", "first record to show (def 0)"),
+        arg_u64_0(NULL, "count", "<dec>", "number of records to show (def all)"),
+        arg_lit0(NULL, "plain", "fast plain output without colors, CRC and annotations"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1373,37 +2758,16 @@ int CmdTraceList(const char *Cmd) {
         diclen = 0;
     }
 
+    uint32_t start = arg_get_u32_def(ctx, 9, 0);
+    uint32_t count = arg_get_u32_def(ctx, 10, 0);
+    bool plain = arg_get_lit(ctx, 11);
     CLIParserFree(ctx);
 
     clearCommandBuffer();
 
     // no crc, no annotations
     uint8_t protocol = -1;
-
-    // validate type of output
-    if (strcmp(type, "14a") == 0)      protocol = ISO_14443A;
-    else if (strcmp(type, "14b") == 0)      protocol = ISO_14443B;
-    else if (strcmp(type, "15") == 0)       protocol = ISO_15693;
-    else if (strcmp(type, "7816") == 0)     protocol = ISO_7816_4;
-    else if (strcmp(type, "cryptorf") == 0) protocol = PROTO_CRYPTORF;
-    else if (strcmp(type, "des") == 0)      protocol = MFDES;
-    else if (strcmp(type, "felica") == 0)   protocol = FELICA;
-    else if (strcmp(type, "ht1") == 0)   protocol = PROTO_HITAG1;
-    else if (strcmp(type, "ht2") == 0)   protocol = PROTO_HITAG2;
-    else if (strcmp(type, "hts") == 0)   protocol = PROTO_HITAGS;
-    else if (strcmp(type, "htu") == 0)   protocol = PROTO_HITAGU;
-    else if (strcmp(type, "iclass") == 0)   protocol = ICLASS;
-    else if (strcmp(type, "legic") == 0)    protocol = LEGIC;
-    else if (strcmp(type, "lto") == 0)      protocol = LTO;
-    else if (strcmp(type, "mf") == 0)       protocol = PROTO_MIFARE;
-    else if (strcmp(type, "raw") == 0)      protocol = -1;
-    else if (strcmp(type, "seos") == 0)     protocol = SEOS;
-    else if (strcmp(type, "thinfilm") == 0) protocol = THINFILM;
-    else if (strcmp(type, "topaz") == 0)    protocol = TOPAZ;
-    else if (strcmp(type, "mfp") == 0)      protocol = PROTO_MFPLUS;
-    else if (strcmp(type, "fmcos20") == 0)  protocol = PROTO_FMCOS20;
-    else if (strcmp(type, "") == 0)         protocol = -1;
-    else {
+    if (trace_get_protocol(type, &protocol) == false) {
         PrintAndLogEx(FAILED, "Unknown protocol \"%s\"", type);
         return PM3_EINVARG;
     }
@@ -1422,12 +2786,16 @@ int CmdTraceList(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    PrintAndLogEx(SUCCESS,  "Recorded activity ( " _YELLOW_("%u") " bytes )", gs_traceLen);
+    PrintAndLogEx(SUCCESS,  "Recorded activity ( " _YELLOW_("%u") " bytes, " _YELLOW_("%u") " records )", gs_traceLen, gs_traceRecords);
     if (gs_traceLen == 0) {
         return PM3_SUCCESS;
     }
 
-    uint16_t tracepos = 0;
+    uint32_t tracepos = 0, end = 0;
+    if (trace_range(start, count, &tracepos, &end) == false) {
+        PrintAndLogEx(WARNING, "No records from " _YELLOW_("%u"), start);
+        return PM3_EINVARG;
+    }
 
     /*
     if (protocol == FELICA) {
@@ -1435,9 +2803,15 @@ int CmdTraceList(const char *Cmd) {
     } */
 
     if (show_hex) {
-        while (tracepos < gs_traceLen) {
+        while (tracepos < end) {
             tracepos = printHexLine(tracepos, gs_traceLen, gs_trace, protocol);
         }
+    } else if (plain) {
+        uint32_t last = gs_traceRecords;
+        if (count && (count < gs_traceRecords - start)) {
+            last = start + count;
+        }
+        return trace_list_plain(start, last, protocol, use_relative, use_us);
     } else {
 
         if (use_relative) {
@@ -1549,6 +2923,19 @@ int CmdTraceList(const char *Cmd) {
             }
         }
 
+        // the dictionary is checked against all nested authentications up front, on all cores
+        mf_trace_auth_t *mfAuths = NULL;
+        if ((protocol == PROTO_MIFARE || protocol == PROTO_MFPLUS) && dicKeysCount) {
+            uint64_t t1 = msclock();
+            size_t nauths = extract_mf_auths(tracepos, end, &mfAuths);
+            if (nauths) {
+                size_t found = MifareTraceFindKeys(mfAuths, nauths, dicKeys, dicKeysCount);
+                MifareTraceSetKeys(mfAuths, nauths);
+                PrintAndLogEx(INFO, "Checked " _YELLOW_("%zu") " nested authentications against " _YELLOW_("%u") " keys, found " _GREEN_("%zu") " ( %" PRIu64 " ms )",
+                              nauths, dicKeysCount, found, msclock() - t1);
+            }
+        }
+
         PrintAndLogEx(NORMAL, "");
         if (use_relative) {
             PrintAndLogEx(NORMAL, "        Gap |   Duration | Src | Data (! denotes parity error, ' denotes short bytes)                    | CRC | Annotation");
@@ -1571,9 +2958,14 @@ int CmdTraceList(const char *Cmd) {
         uint32_t *prev_EOT = NULL;
         if (use_relative) {
             prev_EOT = &previous_EOT;
+            // gap to the record before the first one shown
+            if (start) {
+                const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(gs_trace + gs_traceIndex[start - 1]);
+                previous_EOT = hdr->timestamp + hdr->duration;
+            }
         }
 
-        while (tracepos < gs_traceLen) {
+        while (tracepos < end) {
             tracepos = printTraceLine(tracepos, gs_traceLen, gs_trace, protocol, show_wait_cycles, mark_crc, prev_EOT, use_us, dicKeys, dicKeysCount);
 
             if (kbd_enter_pressed()) {
@@ -1582,6 +2974,9 @@ int CmdTraceList(const char *Cmd) {
             }
         }
 
+        MifareTraceSetKeys(NULL, 0);
+        free(mfAuths);
+
         if (dictionaryLoad)  {
             free((void *) dicKeys);
         }
@@ -20,10 +20,49 @@
 #define CMDTRACE_H__
 
 #include "common.h"
+#include "cmdhflist.h"    // mf_trace_auth_t
+
+// Columnar trace file (`trace save --cols`), little endian, for tools that mmap it.
+//   header      trace_cols_hdr_t
+//   columns     one value per record, each column starts 8 byte aligned at its offset
+//     timestamp   uint32_t
+//     duration    uint16_t
+//     direction   uint8_t, 0 reader, 1 tag
+//     protocol    uint8_t, `trace list -t` protocol the trace was saved with, 0xFF raw
+//     length      uint16_t, payload bytes
+//     payload     uint64_t, offset of the payload in the blob
+//   blob        payload of every record, followed by its parity bytes
+//               ( (length - 1) / 8 + 1 of them, see TRACELOG_PARITY_LEN )
+#define TRACE_COLS_MAGIC    "PM3TRCOL"
+#define TRACE_COLS_VERSION  1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t hdr_len;
+    uint64_t records;
+    uint64_t timestamp_offset;
+    uint64_t duration_offset;
+    uint64_t direction_offset;
+    uint64_t protocol_offset;
+    uint64_t length_offset;
+    uint64_t payload_offset;
+    uint64_t blob_offset;
+    uint64_t blob_len;
+} PACKED trace_cols_hdr_t;
 
 int CmdTrace(const char *Cmd);
 int CmdTraceList(const char *Cmd);
 int CmdTraceListAlias(const char *Cmd, const char *alias, const char *protocol);
-bool ImportTraceBuffer(const uint8_t *trace_src, uint16_t trace_len);
+bool ImportTraceBuffer(const uint8_t *trace_src, uint32_t trace_len);
+// MIFARE Classic first authentications in the trace buffer, auth command, nt, nr ar and at if the
+// tag answered. An empty buffer is downloaded from the device first. Returns the count, free *auths
+size_t trace_mf_first_auths(mf_trace_auth_t **auths);
+// Sends cmd starting a sniff with trace streaming and collects the records into the trace buffer
+// until the device ends the stream, optionally writing them to a .trace file as they arrive
+int trace_stream_sniff(uint16_t cmd, const uint8_t *payload, uint16_t payload_len, const char *filename);
+// Same, and recovers MIFARE Classic keys from the authentications while the sniff runs.
+// Nested authentications are checked against the dictionary, the default keys if it is empty
+int trace_stream_sniff_mf(uint16_t cmd, const uint8_t *payload, uint16_t payload_len, const char *filename, const char *dictionary);
 
 #endif
@@ -20,6 +20,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include "cmdparser.h"          // command_t
 #include "cliparser.h"
 #include "comms.h"
@@ -30,6 +31,8 @@
 #include "wiegand_formats.h"
 #include "wiegand_formatutils.h"
 #include "util.h"
+#include "commonutil.h"         // ARRAYLEN
+#include "fileutils.h"          // searchFile
 
 static int CmdHelp(const char *Cmd);
 
@@ -73,6 +76,189 @@ static int wiegand_new_pacs(uint8_t *padded_pacs, uint8_t plen) {
     free(binstr);
     return PM3_SUCCESS;
 }
+// one line of a batch decode
+typedef struct {
+    size_t line;
+    uint32_t top, mid, bot;
+    uint8_t len;
+    int count;
+    bool valid;
+    wiegand_match_t matches[8];
+} wiegand_job_t;
+
+typedef struct {
+    wiegand_job_t *jobs;
+    size_t count;
+    size_t next;
+} wiegand_batch_t;
+
+static void wiegand_decode_one(wiegand_job_t *job) {
+    wiegand_message_t packed = initialize_message_object(job->top, job->mid, job->bot, 0);
+
+    // same as decode_wiegand, fall back to a preamble bit when nothing valid shows up
+    for (uint8_t i = 0; i < 2; i++, packed.Length++) {
+        job->len = packed.Length;
+        job->count = HIDTryUnpackEx(&packed, job->matches, ARRAYLEN(job->matches));
+        for (int j = 0; j < job->count; j++) {
+            job->valid |= HIDMatchValid(&job->matches[j]);
+        }
+        if (job->valid) {
+            break;
+        }
+    }
+}
+
+static void *wiegand_batch_worker(void *arg) {
+    wiegand_batch_t *b = (wiegand_batch_t *)arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->count) {
+            break;
+        }
+        wiegand_decode_one(&b->jobs[i]);
+    }
+    return NULL;
+}
+
+// first column of a text / csv line, quotes stripped
+static bool wiegand_line_hex(char *line, char **hex) {
+    char *p = line;
+    while (*p == ' ' || *p == '\t' || *p == '"') {
+        p++;
+    }
+    if (*p == '#' || *p == '\0') {
+        return false;
+    }
+
+    char *e = p;
+    while (isxdigit((unsigned char)*e)) {
+        e++;
+    }
+    if (e == p || (*e != '\0' && strchr(",; \t\"\r\n", *e) == NULL)) {
+        return false;
+    }
+    *e = '\0';
+    *hex = p;
+    return true;
+}
+
+static void wiegand_print_job(const wiegand_job_t *job) {
+
+    char raw[32] = {0};
+    if (job->top) {
+        snprintf(raw, sizeof(raw), "%X%08X%08X", job->top, job->mid, job->bot);
+    } else {
+        snprintf(raw, sizeof(raw), "%X%08X", job->mid, job->bot);
+    }
+
+    if (job->valid == false) {
+        PrintAndLogEx(FAILED, "%6zu  %-24s " _RED_("no valid format"), job->line, raw);
+        return;
+    }
+
+    for (int i = 0; i < job->count; i++) {
+        const wiegand_match_t *m = &job->matches[i];
+        if (HIDMatchValid(m) == false) {
+            continue;
+        }
+        cardformat_t fmt = HIDGetCardFormat(m->idx);
+        char s[80] = {0};
+        if (fmt.Fields.hasFacilityCode) {
+            snprintf(s, sizeof(s), "FC: " _GREEN_("%u") "  ", m->card.FacilityCode);
+        }
+        if (fmt.Fields.hasCardNumber) {
+            snprintf(s + strlen(s), sizeof(s) - strlen(s), "CN: " _GREEN_("%" PRIu64), m->card.CardNumber);
+        }
+        PrintAndLogEx(SUCCESS, "%6zu  %-24s [%-8s] %s", job->line, raw, fmt.Name, s);
+    }
+}
+
+static int wiegand_decode_file(const char *filename) {
+
+    char *path = NULL;
+    if (searchFile(&path, RESOURCES_SUBDIR, filename, "", false) != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "couldn't open `" _YELLOW_("%s") "`", path);
+        free(path);
+        return PM3_EFILE;
+    }
+    free(path);
+
+    wiegand_batch_t b = {0};
+    size_t cap = 0, lines = 0, skipped = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        lines++;
+
+        char *hex = NULL;
+        uint32_t top = 0, mid = 0, bot = 0;
+        if (wiegand_line_hex(line, &hex) == false || strlen(hex) > 24 || hexstring_to_u96(&top, &mid, &bot, hex) != (int)strlen(hex)) {
+            skipped++;
+            continue;
+        }
+
+        if (b.count == cap) {
+            cap = (cap) ? cap * 2 : 256;
+            wiegand_job_t *tmp = realloc(b.jobs, cap * sizeof(wiegand_job_t));
+            if (tmp == NULL) {
+                PrintAndLogEx(WARNING, "Failed to allocate memory");
+                free(b.jobs);
+                fclose(f);
+                return PM3_EMALLOC;
+            }
+            b.jobs = tmp;
+        }
+
+        wiegand_job_t *job = &b.jobs[b.count++];
+        memset(job, 0, sizeof(wiegand_job_t));
+        job->line = lines;
+        job->top = top;
+        job->mid = mid;
+        job->bot = bot;
+    }
+    fclose(f);
+
+    int n = MIN(num_CPUs(), (int)b.count);
+    pthread_t *tids = calloc(n ? n : 1, sizeof(pthread_t));
+    int started = 0;
+    for (; tids && started < n; started++) {
+        if (pthread_create(&tids[started], NULL, wiegand_batch_worker, &b) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        wiegand_batch_worker(&b);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "  line  raw                      format     fields");
+    PrintAndLogEx(INFO, "------  ------------------------ ---------- ------------------------");
+
+    size_t decoded = 0;
+    for (size_t i = 0; i < b.count; i++) {
+        wiegand_print_job(&b.jobs[i]);
+        decoded += (b.jobs[i].valid) ? 1 : 0;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, "%zu lines, " _GREEN_("%zu") " decoded, %zu without a valid format, %zu skipped"
+                  , lines
+                  , decoded
+                  , b.count - decoded
+                  , skipped
+                 );
+    free(b.jobs);
+    return PM3_SUCCESS;
+}
+
 int CmdWiegandList(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -157,7 +343,8 @@ int CmdWiegandDecode(const char *Cmd) {
     CLIParserInit(&ctx, "wiegand decode",
                   "Decode raw hex or binary to wiegand format",
                   "wiegand decode --raw 2006F623AE\n"
-                  "wiegand decode --new 06BD88EB80   -> 4..8 bytes, new padded format "
+                  "wiegand decode --new 06BD88EB80   -> 4..8 bytes, new padded format\n"
+                  "wiegand decode -f badges.csv      -> raw hex in the first column of each line"
                  );
 
     void *argtable[] = {
@@ -165,6 +352,7 @@ int CmdWiegandDecode(const char *Cmd) {
         arg_str0("r", "raw", "<hex>", "raw hex to be decoded"),
         arg_str0("b", "bin", "<bin>", "binary string to be decoded"),
         arg_str0("n", "new", "<hex>", "new padded pacs as raw hex to be decoded"),
+        arg_str0("f", "file", "<fn>", "text / csv file with raw hex to be decoded, one per line"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -180,8 +368,16 @@ int CmdWiegandDecode(const char *Cmd) {
     uint8_t phex[8] = {0};
     res = CLIParamHexToBuf(arg_get_str(ctx, 3), phex, sizeof(phex), &plen);
 
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
     CLIParserFree(ctx);
 
+    if (fnlen) {
+        return wiegand_decode_file(filename);
+    }
+
     if (res) {
         PrintAndLogEx(FAILED, "Error parsing binary string");
         return PM3_EINVARG;
@@ -22,6 +22,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <ctype.h>
 
 #include "uart/uart.h"
 #include "ui.h"
@@ -30,55 +32,154 @@
 #include "util_posix.h" // msclock
 #include "util_darwin.h" // en/dis-ableNapp();
 #include "usart_defs.h"
+#include "lz4.h"
 
 // #define COMMS_DEBUG
 // #define COMMS_DEBUG_RAW
 
-// Serial port that we are communicating with the PM3 on.
-static serial_port sp = NULL;
-
-communication_arg_t g_conn;
+communication_arg_t *g_conn_active;
 capabilities_t g_pm3_capabilities;
 
-static pthread_t communication_thread;
 static pthread_t reconnect_thread;
 
 static bool reconnect_ok = false;
 
-static bool comm_thread_dead = false;
-static bool comm_raw_mode = false;
-static uint8_t *comm_raw_data = NULL;
-static size_t comm_raw_len = 0;
-static size_t comm_raw_pos = 0;
-
-// Transmit buffer.
-static PacketCommandOLD txBuffer;
-static PacketCommandNGRaw txBufferNG;
-static size_t txBufferNGLen;
-static bool txBuffer_pending = false;
-static pthread_mutex_t txBufferMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t txBufferSig = PTHREAD_COND_INITIALIZER;
+// How long the communication thread waits for the main thread to make room
+// in a full ring, before dropping the packet.
+#define CMD_BUFFER_FULL_TIMEOUT_MS 2000
+
+// Asynchronous commands. Tickets live in the consumer thread only, replies are
+// matched on reply command number, oldest ticket first, as the device answers in order.
+typedef struct {
+    uint32_t id;
+    uint16_t reply_cmd;
+    bool in_use;
+    bool done;
+    async_callback_t cb;
+    void *ctx;
+    PacketResponseNG resp;
+} async_ticket_t;
+
+// Communication state of one Proxmark3.
+// Every opened device has its own serial port, communication thread and reply ring.
+// The main thread works on the selected device only, see SelectProxmark()
+struct comm_ctx {
+    // Serial port that we are communicating with the PM3 on.
+    serial_port sp;
+    communication_arg_t conn;
+    capabilities_t capabilities;
+    bool present;
+
+    pthread_t communication_thread;
+
+    bool comm_thread_dead;
+    bool comm_raw_mode;
+    uint8_t *comm_raw_data;
+    size_t comm_raw_len;
+    size_t comm_raw_pos;
+
+    // streaming raw receive, ring of caller provided buffers (WaitForRawDataStream)
+    uint8_t **raw_stream_bufs;
+    uint8_t raw_stream_count;
+    size_t raw_stream_size;
+    uint32_t raw_stream_w;     // filled buffers, only written by the comm thread
+    uint32_t raw_stream_r;     // consumed buffers, only written by the main thread
+    size_t raw_stream_fill;    // bytes in the buffer being filled
+
+    // Transmit buffer.
+    PacketCommandOLD txBuffer;
+    // big enough for jumbo frames
+    struct {
+        PacketCommandNGPreamble pre;
+        uint8_t data[PM3_CMD_DATA_SIZE_JUMBO];
+        PacketCommandNGPostamble foopost;
+    } PACKED txBufferNG;
+    size_t txBufferNGLen;
+    bool txBuffer_pending;
+    pthread_mutex_t txBufferMutex;
+    pthread_cond_t txBufferSig;
+
+    // Used by PacketResponseReceived as a ring buffer for messages that are yet to be
+    // processed by a command handler (WaitForResponse{,Timeout})
+    //
+    // Single producer (uart_communication thread) / single consumer (main thread) ring.
+    // Indexes are free running and only ever written by their owner, so no lock is needed
+    // to move packets.  CMD_BUFFER_SIZE must be a power of two.
+    PacketResponseNG rxBuffer[CMD_BUFFER_SIZE];
+
+    // Points to the next empty position to write to, only written by the producer
+    uint32_t cmd_head;
+
+    // Points to the position of the last unread command, only written by the consumer
+    uint32_t cmd_tail;
+
+    // Only used to park threads when the ring is empty (consumer) or full (producer),
+    // never taken on the fast path.
+    pthread_mutex_t rxBufferMutex;
+    pthread_cond_t rxBufferSig;
+    bool rx_consumer_waiting;
+    bool rx_producer_waiting;
+
+    async_ticket_t async_tickets[ASYNC_MAX_TICKETS];
+    uint32_t async_next_id;
+    uint32_t async_pending;
+
+    // Start time for WaitForResponseTimeout & dl_it, so we can reset timeout when we get packets
+    // as sending lot of these packets can slow down things wuite a lot on slow links (e.g. hw status or lf read at 9600)
+    uint64_t timeout_start_time;
+
+    uint64_t last_packet_time;
+
+    // protected by txBufferMutex
+    uint64_t rtt_start_us;
+    comm_latency_t latency;
+
+    // set once CMD_BATCH went unanswered, older firmwares just ignore it
+    bool batch_unsupported;
+};
+
+#define COMM_CTX_INITIALIZER { \
+        .txBufferMutex = PTHREAD_MUTEX_INITIALIZER, \
+        .txBufferSig = PTHREAD_COND_INITIALIZER, \
+        .rxBufferMutex = PTHREAD_MUTEX_INITIALIZER, \
+        .rxBufferSig = PTHREAD_COND_INITIALIZER, \
+        .async_next_id = 1, \
+    }
 
-// Used by PacketResponseReceived as a ring buffer for messages that are yet to be
-// processed by a command handler (WaitForResponse{,Timeout})
-static PacketResponseNG rxBuffer[CMD_BUFFER_SIZE];
+// used while no device is selected (offline mode)
+static comm_ctx_t comm_offline = COMM_CTX_INITIALIZER;
 
-// Points to the next empty position to write to
-static int cmd_head = 0;
+// selected device, only changed by the main thread
+static comm_ctx_t *g_comm = &comm_offline;
+communication_arg_t *g_conn_active = &comm_offline.conn;
 
-// Points to the position of the last unread command
-static int cmd_tail = 0;
+// traffic counters, shared by all devices. Bytes and frames received are added by the comm threads
+static comm_stats_t comm_stats;
+// nesting of the wait functions, only the outermost one is timed. Main thread only
+static uint32_t comm_wait_depth = 0;
 
-// to lock rxBuffer operations from different threads
-static pthread_mutex_t rxBufferMutex = PTHREAD_MUTEX_INITIALIZER;
+static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd, uint8_t *seen, uint32_t base_chunk);
+static int getReply(PacketResponseNG *packet);
+static bool dispatchAsyncReply(const PacketResponseNG *packet);
 
-// Global start time for WaitForResponseTimeout & dl_it, so we can reset timeout when we get packets
-// as sending lot of these packets can slow down things wuite a lot on slow links (e.g. hw status or lf read at 9600)
-static uint64_t timeout_start_time;
+static uint64_t comm_wait_begin(void) {
+    return (comm_wait_depth++ == 0) ? usclock() : 0;
+}
 
-static uint64_t last_packet_time;
+static void comm_wait_end(uint64_t start, bool replied) {
+    if (--comm_wait_depth) {
+        return;
+    }
+    comm_stats.wait_us += usclock() - start;
+    if (replied) {
+        comm_stats.round_trips++;
+    }
+}
 
-static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd);
+static void comm_count_sent(size_t bytes) {
+    __atomic_fetch_add(&comm_stats.frames_sent, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&comm_stats.bytes_sent, bytes, __ATOMIC_RELAXED);
+}
 
 // Simple alias to track usages linked to the Bootloader, these commands must not be migrated.
 // - commands sent to enter bootloader mode as we might have to talk to old firmwares
@@ -120,23 +221,27 @@ void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, c
         return;
     }
 
-    pthread_mutex_lock(&txBufferMutex);
+    pthread_mutex_lock(&g_comm->txBufferMutex);
     /**
     This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
     but comm thread just spins here. Not good.../holiman
     **/
-    while (txBuffer_pending) {
+    while (g_comm->txBuffer_pending) {
         // wait for communication thread to complete sending a previous command
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
+        pthread_cond_wait(&g_comm->txBufferSig, &g_comm->txBufferMutex);
     }
 
-    txBuffer = c;
-    txBuffer_pending = true;
+    g_comm->txBuffer = c;
+    g_comm->txBuffer_pending = true;
+    comm_count_sent(sizeof(PacketCommandOLD));
 
     // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
+    pthread_cond_signal(&g_comm->txBufferSig);
+    if (g_comm->sp) {
+        uart_wakeup(g_comm->sp);
+    }
 
-    pthread_mutex_unlock(&txBufferMutex);
+    pthread_mutex_unlock(&g_comm->txBufferMutex);
 
 //__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
 }
@@ -150,61 +255,74 @@ static void SendCommandNG_internal(uint16_t cmd, uint8_t *data, size_t len, bool
         PrintAndLogEx(INFO, "Sending bytes to proxmark failed - offline");
         return;
     }
-    if (len > PM3_CMD_DATA_SIZE) {
+    if (len > PM3_CMD_DATA_SIZE && (ng == false || len > GetJumboPayloadSize())) {
         PrintAndLogEx(WARNING, "Sending " _RED_("%zu") " bytes of payload is too much, abort", len);
         return;
     }
 
-    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)((uint8_t *)&txBufferNG + sizeof(PacketCommandNGPreamble) + len);
+    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)((uint8_t *)&g_comm->txBufferNG + sizeof(PacketCommandNGPreamble) + len);
 
-    pthread_mutex_lock(&txBufferMutex);
+    pthread_mutex_lock(&g_comm->txBufferMutex);
     /**
     This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
     but comm thread just spins here. Not good.../holiman
     **/
-    while (txBuffer_pending) {
+    while (g_comm->txBuffer_pending) {
         // wait for communication thread to complete sending a previous command
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
+        pthread_cond_wait(&g_comm->txBufferSig, &g_comm->txBufferMutex);
     }
 
-    txBufferNG.pre.magic = COMMANDNG_PREAMBLE_MAGIC;
-    txBufferNG.pre.ng = ng;
-    txBufferNG.pre.length = len;
-    txBufferNG.pre.cmd = cmd;
+    g_comm->txBufferNG.pre.magic = COMMANDNG_PREAMBLE_MAGIC;
+    g_comm->txBufferNG.pre.ng = ng;
+    g_comm->txBufferNG.pre.length = len;
+    g_comm->txBufferNG.pre.cmd = cmd;
     if (len > 0 && data) {
-        memcpy(&txBufferNG.data, data, len);
+        memcpy(&g_comm->txBufferNG.data, data, len);
     }
 
     if ((g_conn.send_via_fpc_usart && g_conn.send_with_crc_on_fpc) || ((!g_conn.send_via_fpc_usart) && g_conn.send_with_crc_on_usb)) {
         uint8_t first = 0, second = 0;
-        compute_crc(CRC_14443_A, (uint8_t *)&txBufferNG, sizeof(PacketCommandNGPreamble) + len, &first, &second);
+        compute_crc(CRC_14443_A, (uint8_t *)&g_comm->txBufferNG, sizeof(PacketCommandNGPreamble) + len, &first, &second);
         tx_post->crc = (first << 8) + second;
     } else {
         tx_post->crc = COMMANDNG_POSTAMBLE_MAGIC;
     }
 
-    txBufferNGLen = sizeof(PacketCommandNGPreamble) + len + sizeof(PacketCommandNGPostamble);
+    g_comm->txBufferNGLen = sizeof(PacketCommandNGPreamble) + len + sizeof(PacketCommandNGPostamble);
+    comm_count_sent(g_comm->txBufferNGLen);
 
 #ifdef COMMS_DEBUG_RAW
-    print_hex_break((uint8_t *)&txBufferNG.pre, sizeof(PacketCommandNGPreamble), 32);
+    print_hex_break((uint8_t *)&g_comm->txBufferNG.pre, sizeof(PacketCommandNGPreamble), 32);
     if (ng) {
-        print_hex_break((uint8_t *)&txBufferNG.data, len, 32);
+        print_hex_break((uint8_t *)&g_comm->txBufferNG.data, len, 32);
     } else {
-        print_hex_break((uint8_t *)&txBufferNG.data, 3 * sizeof(uint64_t), 32);
-        print_hex_break((uint8_t *)&txBufferNG.data + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
+        print_hex_break((uint8_t *)&g_comm->txBufferNG.data, 3 * sizeof(uint64_t), 32);
+        print_hex_break((uint8_t *)&g_comm->txBufferNG.data + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
     }
     print_hex_break((uint8_t *)tx_post, sizeof(PacketCommandNGPostamble), 32);
 #endif
-    txBuffer_pending = true;
+    g_comm->txBuffer_pending = true;
 
     // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
+    pthread_cond_signal(&g_comm->txBufferSig);
+    if (g_comm->sp) {
+        uart_wakeup(g_comm->sp);
+    }
 
-    pthread_mutex_unlock(&txBufferMutex);
+    pthread_mutex_unlock(&g_comm->txBufferMutex);
 
 //__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
 }
 
+// Max payload for the bulk upload commands accepting jumbo frames.
+// Negotiated with CMD_CAPABILITIES, only used over USB-CDC. FPC USART, BT and bootloader stay at PM3_CMD_DATA_SIZE
+size_t GetJumboPayloadSize(void) {
+    if (g_session.pm3_present == false || g_conn.send_via_fpc_usart || g_pm3_capabilities.jumbo_size <= PM3_CMD_DATA_SIZE) {
+        return PM3_CMD_DATA_SIZE;
+    }
+    return MIN(g_pm3_capabilities.jumbo_size, PM3_CMD_DATA_SIZE_JUMBO);
+}
+
 void SendCommandNG(uint16_t cmd, uint8_t *data, size_t len) {
     SendCommandNG_internal(cmd, data, len, true);
 }
@@ -230,30 +348,81 @@ void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, c
  *  operation. Right now we'll just have to live with this.
  */
 void clearCommandBuffer(void) {
-    //This is a very simple operation
-    pthread_mutex_lock(&rxBufferMutex);
-    cmd_tail = cmd_head;
-    pthread_mutex_unlock(&rxBufferMutex);
+
+    // replies for in-flight async commands must survive
+    if (g_comm->async_pending) {
+        PacketResponseNG tmp;
+        while (getReply(&tmp)) {
+            dispatchAsyncReply(&tmp);
+        }
+        return;
+    }
+
+    // only the consumer moves the tail, so this is safe without a lock
+    __atomic_store_n(&g_comm->cmd_tail, __atomic_load_n(&g_comm->cmd_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    if (__atomic_load_n(&g_comm->rx_producer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&g_comm->rxBufferMutex);
+        pthread_cond_broadcast(&g_comm->rxBufferSig);
+        pthread_mutex_unlock(&g_comm->rxBufferMutex);
+    }
+}
+
+static void abstime_from_now(struct timespec *ts, uint32_t ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
 }
+
 /**
  * @brief storeCommand stores a USB command in a circular buffer
+ *  When the buffer is full, the producer waits for the main thread to catch up
+ *  instead of overwriting unread replies.
  * @param UC
  */
-static void storeReply(const PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
-    if ((cmd_head + 1) % CMD_BUFFER_SIZE == cmd_tail) {
-        //If these two are equal, we're about to overwrite in the
-        // circular buffer.
-        PrintAndLogEx(FAILED, "WARNING: Command buffer about to overwrite command! This needs to be fixed!");
-        fflush(stdout);
+static void storeReply(comm_ctx_t *comm, const PacketResponseNG *packet) {
+
+    uint32_t head = __atomic_load_n(&comm->cmd_head, __ATOMIC_RELAXED);
+
+    if (head - __atomic_load_n(&comm->cmd_tail, __ATOMIC_ACQUIRE) >= CMD_BUFFER_SIZE) {
+
+        // back-pressure, wait for the consumer to free a slot
+        uint64_t start = msclock();
+        pthread_mutex_lock(&comm->rxBufferMutex);
+        __atomic_store_n(&comm->rx_producer_waiting, true, __ATOMIC_SEQ_CST);
+        while (head - __atomic_load_n(&comm->cmd_tail, __ATOMIC_SEQ_CST) >= CMD_BUFFER_SIZE) {
+            if (msclock() - start > CMD_BUFFER_FULL_TIMEOUT_MS) {
+                break;
+            }
+            struct timespec ts;
+            abstime_from_now(&ts, 10);
+            pthread_cond_timedwait(&comm->rxBufferSig, &comm->rxBufferMutex, &ts);
+        }
+        __atomic_store_n(&comm->rx_producer_waiting, false, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&comm->rxBufferMutex);
+
+        if (head - __atomic_load_n(&comm->cmd_tail, __ATOMIC_ACQUIRE) >= CMD_BUFFER_SIZE) {
+            PrintAndLogEx(FAILED, "WARNING: Command buffer full, dropping reply 0x%04x", packet->cmd);
+            fflush(stdout);
+            return;
+        }
     }
+
     //Store the command at the 'head' location
-    PacketResponseNG *destination = &rxBuffer[cmd_head];
-    memcpy(destination, packet, sizeof(PacketResponseNG));
+    memcpy(&comm->rxBuffer[head & (CMD_BUFFER_SIZE - 1)], packet, sizeof(PacketResponseNG));
 
-    //increment head and wrap
-    cmd_head = (cmd_head + 1) % CMD_BUFFER_SIZE;
-    pthread_mutex_unlock(&rxBufferMutex);
+    // publish it
+    __atomic_store_n(&comm->cmd_head, head + 1, __ATOMIC_SEQ_CST);
+
+    // only pay for the wakeup when the consumer is parked
+    if (__atomic_load_n(&comm->rx_consumer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&comm->rxBufferMutex);
+        pthread_cond_broadcast(&comm->rxBufferSig);
+        pthread_mutex_unlock(&comm->rxBufferMutex);
+    }
 }
 /**
  * @brief getCommand gets a command from an internal circular buffer.
@@ -261,35 +430,356 @@ static void storeReply(const PacketResponseNG *packet) {
  * @return 1 if response was returned, 0 if nothing has been received
  */
 static int getReply(PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
+
+    uint32_t tail = __atomic_load_n(&g_comm->cmd_tail, __ATOMIC_RELAXED);
+
     //If head == tail, there's nothing to read, or if we just got initialized
-    if (cmd_head == cmd_tail)  {
-        pthread_mutex_unlock(&rxBufferMutex);
+    if (__atomic_load_n(&g_comm->cmd_head, __ATOMIC_ACQUIRE) == tail) {
         return 0;
     }
 
     //Pick out the next unread command
-    memcpy(packet, &rxBuffer[cmd_tail], sizeof(PacketResponseNG));
+    memcpy(packet, &g_comm->rxBuffer[tail & (CMD_BUFFER_SIZE - 1)], sizeof(PacketResponseNG));
 
-    //Increment tail - this is a circular buffer, so modulo buffer size
-    cmd_tail = (cmd_tail + 1) % CMD_BUFFER_SIZE;
+    // release the slot
+    __atomic_store_n(&g_comm->cmd_tail, tail + 1, __ATOMIC_SEQ_CST);
 
-    pthread_mutex_unlock(&rxBufferMutex);
+    if (__atomic_load_n(&g_comm->rx_producer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&g_comm->rxBufferMutex);
+        pthread_cond_broadcast(&g_comm->rxBufferSig);
+        pthread_mutex_unlock(&g_comm->rxBufferMutex);
+    }
     return 1;
 }
 
+/**
+ * @brief waitReply parks the consumer until a reply is stored or ms milliseconds have elapsed.
+ *  Replaces polling with msleep, the communication thread wakes us up as soon as a packet is stored.
+ */
+static void waitReply(uint32_t ms) {
+    pthread_mutex_lock(&g_comm->rxBufferMutex);
+    __atomic_store_n(&g_comm->rx_consumer_waiting, true, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&g_comm->cmd_head, __ATOMIC_SEQ_CST) == __atomic_load_n(&g_comm->cmd_tail, __ATOMIC_SEQ_CST)) {
+        struct timespec ts;
+        abstime_from_now(&ts, ms);
+        pthread_cond_timedwait(&g_comm->rxBufferSig, &g_comm->rxBufferMutex, &ts);
+    }
+    __atomic_store_n(&g_comm->rx_consumer_waiting, false, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&g_comm->rxBufferMutex);
+}
+
+static async_ticket_t *findAsyncTicket(uint32_t ticket) {
+    for (uint8_t i = 0; i < ASYNC_MAX_TICKETS; i++) {
+        if (g_comm->async_tickets[i].in_use && g_comm->async_tickets[i].id == ticket) {
+            return &g_comm->async_tickets[i];
+        }
+    }
+    return NULL;
+}
+
+static void releaseAsyncTicket(async_ticket_t *t) {
+    if (t->done == false) {
+        g_comm->async_pending--;
+    }
+    memset(t, 0, sizeof(async_ticket_t));
+}
+
+/**
+ * @brief dispatchAsyncReply hands a reply to the oldest pending async ticket waiting for it.
+ * @return true if the reply was consumed by a ticket
+ */
+static bool dispatchAsyncReply(const PacketResponseNG *packet) {
+
+    if (g_comm->async_pending == 0) {
+        return false;
+    }
+
+    async_ticket_t *t = NULL;
+    for (uint8_t i = 0; i < ASYNC_MAX_TICKETS; i++) {
+        async_ticket_t *c = &g_comm->async_tickets[i];
+        if (c->in_use && (c->done == false) && (c->reply_cmd == packet->cmd)) {
+            if (t == NULL || c->id < t->id) {
+                t = c;
+            }
+        }
+    }
+
+    if (t == NULL) {
+        return false;
+    }
+
+    memcpy(&t->resp, packet, sizeof(PacketResponseNG));
+    t->done = true;
+    g_comm->async_pending--;
+
+    // callback mode, ticket is gone once fired
+    if (t->cb) {
+        async_callback_t cb = t->cb;
+        void *ctx = t->ctx;
+        cb(&t->resp, ctx);
+        memset(t, 0, sizeof(async_ticket_t));
+    }
+    return true;
+}
+
+/**
+ * @brief SendCommandNGAsync sends a NG command without waiting for its reply.
+ *  The reply with command number reply_cmd is delivered to the callback, or kept
+ *  until fetched with PollAsyncReply / WaitForAsyncReply when cb is NULL.
+ *  Callbacks run in the thread waiting for replies, i.e. the main thread.
+ * @return ticket number, 0 if no ticket is available
+ */
+uint32_t SendCommandNGAsync(uint16_t cmd, uint8_t *data, size_t len, uint16_t reply_cmd, async_callback_t cb, void *ctx) {
+
+    async_ticket_t *t = NULL;
+    for (uint8_t i = 0; i < ASYNC_MAX_TICKETS; i++) {
+        if (g_comm->async_tickets[i].in_use == false) {
+            t = &g_comm->async_tickets[i];
+            break;
+        }
+    }
+
+    if (t == NULL) {
+        PrintAndLogEx(WARNING, "Too many async commands in flight");
+        return 0;
+    }
+
+    memset(t, 0, sizeof(async_ticket_t));
+    t->id = g_comm->async_next_id++;
+    if (g_comm->async_next_id == 0) {
+        g_comm->async_next_id = 1;
+    }
+    t->reply_cmd = reply_cmd;
+    t->cb = cb;
+    t->ctx = ctx;
+    t->in_use = true;
+    g_comm->async_pending++;
+
+    SendCommandNG(cmd, data, len);
+    return t->id;
+}
+
+/**
+ * @brief ProcessAsyncReplies delivers queued replies to their tickets.
+ *  Stops at the first reply not claimed by a ticket, so it stays available for WaitForResponse.
+ */
+void ProcessAsyncReplies(void) {
+    while (g_comm->async_pending) {
+        uint32_t tail = __atomic_load_n(&g_comm->cmd_tail, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&g_comm->cmd_head, __ATOMIC_ACQUIRE) == tail) {
+            return;
+        }
+
+        if (dispatchAsyncReply(&g_comm->rxBuffer[tail & (CMD_BUFFER_SIZE - 1)]) == false) {
+            return;
+        }
+
+        PacketResponseNG tmp;
+        getReply(&tmp);
+    }
+}
+
+/**
+ * @brief PollAsyncReply checks a ticket without blocking. A completed ticket is released.
+ * @return PM3_SUCCESS if the reply was copied to response, PM3_ENODATA if still pending, PM3_EINVARG on unknown ticket
+ */
+int PollAsyncReply(uint32_t ticket, PacketResponseNG *response) {
+
+    ProcessAsyncReplies();
+
+    async_ticket_t *t = findAsyncTicket(ticket);
+    if (t == NULL) {
+        return PM3_EINVARG;
+    }
+
+    if (t->done == false) {
+        return PM3_ENODATA;
+    }
+
+    if (response) {
+        memcpy(response, &t->resp, sizeof(PacketResponseNG));
+    }
+    releaseAsyncTicket(t);
+    return PM3_SUCCESS;
+}
+
+static int async_wait(uint32_t ticket, PacketResponseNG *response, size_t ms_timeout) {
+
+    uint64_t start = msclock();
+    while (true) {
+        int res = PollAsyncReply(ticket, response);
+        if (res != PM3_ENODATA) {
+            return res;
+        }
+
+        // nobody else is waiting while we block here, unclaimed replies are stale
+        PacketResponseNG tmp;
+        if (getReply(&tmp)) {
+            if (dispatchAsyncReply(&tmp) == false) {
+                PrintAndLogEx(DEBUG, "Dropping unclaimed reply 0x%04x", tmp.cmd);
+            }
+            continue;
+        }
+
+        if (IsCommunicationThreadDead()) {
+            return PM3_EIO;
+        }
+
+        if ((ms_timeout != (size_t) - 1) && (msclock() - start > ms_timeout)) {
+            return PM3_ETIMEOUT;
+        }
+        waitReply(10);
+    }
+}
+
+int WaitForAsyncReply(uint32_t ticket, PacketResponseNG *response, size_t ms_timeout) {
+    uint64_t wait = comm_wait_begin();
+    int res = async_wait(ticket, response, ms_timeout);
+    comm_wait_end(wait, (res == PM3_SUCCESS));
+    return res;
+}
+
+void CancelAsyncReply(uint32_t ticket) {
+    async_ticket_t *t = findAsyncTicket(ticket);
+    if (t) {
+        releaseAsyncTicket(t);
+    }
+}
+
+void BatchInit(cmd_batch_t *batch, uint8_t flags) {
+    batch_hdr_t hdr = { .flags = flags };
+    memcpy(batch->data, &hdr, sizeof(hdr));
+    batch->len = sizeof(hdr);
+    batch->count = 0;
+}
+
+int BatchAdd(cmd_batch_t *batch, uint16_t cmd, const void *data, uint16_t len) {
+    if (batch->len + sizeof(batch_cmd_t) + len > sizeof(batch->data) || batch->count == UINT8_MAX) {
+        return PM3_EOVFLOW;
+    }
+    batch_cmd_t entry = { .cmd = cmd, .len = len };
+    memcpy(batch->data + batch->len, &entry, sizeof(entry));
+    batch->len += sizeof(entry);
+    if (data && len) {
+        memcpy(batch->data + batch->len, data, len);
+        batch->len += len;
+    }
+    batch->count++;
+    return PM3_SUCCESS;
+}
+
+// Sends all commands of the batch in one frame and collects their replies.
+// replies[i] holds the reply of command i, commands without reply (not executed, or OLD reply) keep cmd = CMD_UNKNOWN.
+// ms_timeout is per command.  Returns PM3_ENOTIMPL if the firmware doesn't know CMD_BATCH, callers then
+// fall back to sending the commands one by one.
+int BatchRun(cmd_batch_t *batch, PacketResponseNG *replies, uint8_t max_replies, uint8_t *executed, size_t ms_timeout) {
+
+    *executed = 0;
+    for (uint8_t i = 0; i < max_replies; i++) {
+        memset(&replies[i], 0, sizeof(PacketResponseNG));
+        replies[i].cmd = CMD_UNKNOWN;
+    }
+
+    if (g_comm->batch_unsupported) {
+        return PM3_ENOTIMPL;
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_BATCH, batch->data, batch->len);
+
+    bool final = false;
+    bool first = true;
+    while (final == false) {
+        PacketResponseNG resp;
+        // the device acknowledges the batch with an empty frame before running it
+        if (WaitForResponseTimeout(CMD_BATCH, &resp, first ? ms_timeout : ms_timeout * MAX(batch->count, 1)) == false) {
+            if (first) {
+                PrintAndLogEx(DEBUG, "CMD_BATCH not supported by the device");
+                g_comm->batch_unsupported = true;
+                return PM3_ENOTIMPL;
+            }
+            return PM3_ETIMEOUT;
+        }
+        first = false;
+
+        if (resp.length < sizeof(batch_reply_hdr_t)) {
+            return (resp.status != PM3_SUCCESS) ? resp.status : PM3_ESOFT;
+        }
+
+        batch_reply_hdr_t hdr;
+        memcpy(&hdr, resp.data.asBytes, sizeof(hdr));
+        final = hdr.final;
+        if (final) {
+            *executed = hdr.executed;
+        }
+
+        uint16_t pos = sizeof(batch_reply_hdr_t);
+        while (pos + sizeof(batch_reply_t) <= resp.length) {
+            batch_reply_t entry;
+            memcpy(&entry, resp.data.asBytes + pos, sizeof(entry));
+            pos += sizeof(entry);
+            if (entry.len > resp.length - pos) {
+                return PM3_ESOFT;
+            }
+
+            // a command answering more than once, keep its last reply
+            if (entry.index < max_replies) {
+                PacketResponseNG *r = &replies[entry.index];
+                r->cmd = entry.cmd;
+                r->status = entry.status;
+                r->ng = entry.ng;
+                if (entry.ng) {
+                    memcpy(r->data.asBytes, resp.data.asBytes + pos, entry.len);
+                    r->length = entry.len;
+                } else if (entry.len >= sizeof(r->oldarg)) {
+                    memcpy(r->oldarg, resp.data.asBytes + pos, sizeof(r->oldarg));
+                    memcpy(r->data.asBytes, resp.data.asBytes + pos + sizeof(r->oldarg), entry.len - sizeof(r->oldarg));
+                    r->length = entry.len - sizeof(r->oldarg);
+                }
+            }
+            pos += entry.len;
+        }
+
+        if (final && resp.status != PM3_SUCCESS) {
+            return resp.status;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 // Entry point into our code: called whenever we received a packet over USB
 // that we weren't necessarily expecting, for example a debug print.
 //-----------------------------------------------------------------------------
-static void PacketResponseReceived(PacketResponseNG *packet) {
+static void PacketResponseReceived(comm_ctx_t *comm, PacketResponseNG *packet) {
 
     // we got a packet, reset WaitForResponseTimeout timeout
-    uint64_t prev_clk = __atomic_load_n(&last_packet_time, __ATOMIC_SEQ_CST);
+    uint64_t prev_clk = __atomic_load_n(&comm->last_packet_time, __ATOMIC_SEQ_CST);
     uint64_t clk = msclock();
-    __atomic_store_n(&timeout_start_time,  clk, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&last_packet_time, clk, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comm->timeout_start_time,  clk, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comm->last_packet_time, clk, __ATOMIC_SEQ_CST);
     (void) prev_clk;
+
+    size_t frame_len = (packet->ng) ? sizeof(PacketResponseNGPreamble) + packet->length + sizeof(PacketResponseNGPostamble) : sizeof(PacketResponseOLD);
+    __atomic_fetch_add(&comm_stats.frames_recv, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&comm_stats.bytes_recv, frame_len, __ATOMIC_RELAXED);
+
+    if (packet->cmd == comm->conn.last_command || packet->cmd == CMD_ACK) {
+        pthread_mutex_lock(&comm->txBufferMutex);
+        if (comm->rtt_start_us) {
+            uint32_t rtt = (uint32_t)(usclock() - comm->rtt_start_us);
+            comm->rtt_start_us = 0;
+            comm_latency_t *l = &comm->latency;
+            l->last_us = rtt;
+            if (l->count == 0 || rtt < l->min_us) {
+                l->min_us = rtt;
+            }
+            l->max_us = MAX(l->max_us, rtt);
+            l->total_us += rtt;
+            l->count++;
+        }
+        pthread_mutex_unlock(&comm->txBufferMutex);
+    }
 //    PrintAndLogEx(NORMAL, "[%07"PRIu64"] RECV %s magic %08x length %04x status %04x crc %04x cmd %04x",
 //                clk - prev_clk, packet->ng ? "NG" : "OLD", packet->magic, packet->length, packet->status, packet->crc, packet->cmd);
 
@@ -351,7 +841,7 @@ static void PacketResponseReceived(PacketResponseNG *packet) {
         // CMD_DOWNLOAD_BIGBUF packages which is not dealt with. I wonder if simply ignoring them will
         // work. lets try it.
         default: {
-            storeReply(packet);
+            storeReply(comm, packet);
             break;
         }
     }
@@ -416,7 +906,8 @@ __attribute__((force_align_arg_pointer))
 #endif
 #endif
 *uart_communication(void *targ) {
-    const communication_arg_t *connection = (communication_arg_t *)targ;
+    comm_ctx_t *comm = (comm_ctx_t *)targ;
+    const communication_arg_t *connection = &comm->conn;
     uint32_t rxlen;
     bool commfailed = false;
     PacketResponseNG rx;
@@ -438,30 +929,70 @@ __attribute__((force_align_arg_pointer))
         // Signal to main thread that communications seems off.
         // main thread will kill and restart this thread.
         if (commfailed) {
-            if (g_conn.last_command != CMD_HARDWARE_RESET &&
-                    g_conn.last_command != CMD_START_FLASH) {
+            if (comm->conn.last_command != CMD_HARDWARE_RESET &&
+                    comm->conn.last_command != CMD_START_FLASH) {
                 PrintAndLogEx(WARNING, "\nCommunicating with Proxmark3 device " _RED_("failed"));
             }
-            __atomic_test_and_set(&comm_thread_dead, __ATOMIC_SEQ_CST);
+            __atomic_test_and_set(&comm->comm_thread_dead, __ATOMIC_SEQ_CST);
             break;
         }
 
-        bool is_receiving_raw = __atomic_load_n(&comm_raw_mode, __ATOMIC_SEQ_CST);
+        bool is_receiving_raw = __atomic_load_n(&comm->comm_raw_mode, __ATOMIC_SEQ_CST);
 
-        if (is_receiving_raw) {
-            uint8_t *bufferData = __atomic_load_n(&comm_raw_data, __ATOMIC_SEQ_CST); // read only
-            size_t bufferLen = __atomic_load_n(&comm_raw_len, __ATOMIC_SEQ_CST); // read only
-            size_t bufferPos = __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST); // read and write
+        uint8_t **stream_bufs = __atomic_load_n(&comm->raw_stream_bufs, __ATOMIC_SEQ_CST);
+
+        if (is_receiving_raw && stream_bufs) {
+            size_t bufferLen = __atomic_load_n(&comm->comm_raw_len, __ATOMIC_SEQ_CST); // read only
+            size_t bufferPos = __atomic_load_n(&comm->comm_raw_pos, __ATOMIC_SEQ_CST); // read and write
+            uint32_t w = __atomic_load_n(&comm->raw_stream_w, __ATOMIC_SEQ_CST);
+
+            if (bufferPos >= bufferLen) {
+                uint8_t dummyData[64];
+                uint32_t dummyLen;
+                uart_receive(comm->sp, dummyData, sizeof(dummyData), &dummyLen);
+            } else if (w - __atomic_load_n(&comm->raw_stream_r, __ATOMIC_SEQ_CST) < comm->raw_stream_count) {
+                uint8_t *buf = stream_bufs[w % comm->raw_stream_count];
+                size_t fill = comm->raw_stream_fill;
+                size_t rxMaxLen = MIN(comm->raw_stream_size - fill, bufferLen - bufferPos);
+
+                // straight into the caller buffer
+                res = uart_receive(comm->sp, buf + fill, rxMaxLen, &rxlen);
+                if (res == PM3_SUCCESS) {
+                    __atomic_store_n(&comm->timeout_start_time, msclock(), __ATOMIC_SEQ_CST);
+                    fill += rxlen;
+                    if (fill == comm->raw_stream_size) {
+                        fill = 0;
+                        __atomic_store_n(&comm->raw_stream_w, w + 1, __ATOMIC_SEQ_CST);
+                    }
+                    __atomic_store_n(&comm->raw_stream_fill, fill, __ATOMIC_SEQ_CST);
+                    __atomic_store_n(&comm->comm_raw_pos, bufferPos + rxlen, __ATOMIC_SEQ_CST);
+                    __atomic_fetch_add(&comm_stats.bytes_recv, rxlen, __ATOMIC_RELAXED);
+                } else if (res != PM3_ENODATA) {
+                    PrintAndLogEx(WARNING, "Error when reading raw data: %zu/%zu, %d", bufferPos, bufferLen, res);
+                    error = true;
+                    if (res == PM3_ENOTTY) {
+                        commfailed = true;
+                    }
+                }
+            } else {
+                // all buffers wait for the consumer, the data stays in the OS / USB buffers meanwhile
+                msleep(1);
+            }
+        } else if (is_receiving_raw) {
+            uint8_t *bufferData = __atomic_load_n(&comm->comm_raw_data, __ATOMIC_SEQ_CST); // read only
+            size_t bufferLen = __atomic_load_n(&comm->comm_raw_len, __ATOMIC_SEQ_CST); // read only
+            size_t bufferPos = __atomic_load_n(&comm->comm_raw_pos, __ATOMIC_SEQ_CST); // read and write
             if (bufferPos < bufferLen) {
                 size_t rxMaxLen = bufferLen - bufferPos;
 
                 rxMaxLen = MIN(COMM_RAW_RECEIVE_LEN, rxMaxLen);
 
-                res = uart_receive(sp, bufferData + bufferPos, rxMaxLen, &rxlen);
+                res = uart_receive(comm->sp, bufferData + bufferPos, rxMaxLen, &rxlen);
                 if (res == PM3_SUCCESS) {
                     uint64_t clk = msclock();
-                    __atomic_store_n(&timeout_start_time,  clk, __ATOMIC_SEQ_CST);
-                    __atomic_store_n(&comm_raw_pos, bufferPos + rxlen, __ATOMIC_SEQ_CST);
+                    __atomic_store_n(&comm->timeout_start_time,  clk, __ATOMIC_SEQ_CST);
+                    __atomic_store_n(&comm->comm_raw_pos, bufferPos + rxlen, __ATOMIC_SEQ_CST);
+                    __atomic_fetch_add(&comm_stats.bytes_recv, rxlen, __ATOMIC_RELAXED);
                 } else if (res != PM3_ENODATA) {
                     PrintAndLogEx(WARNING, "Error when reading raw data: %zu/%zu, %d", bufferPos, bufferLen, res);
                     error = true;
@@ -473,7 +1004,7 @@ __attribute__((force_align_arg_pointer))
                 // Ignore data when bufferPos >= bufferLen and is_receiving_raw has not been set to false
                 uint8_t dummyData[64];
                 uint32_t dummyLen;
-                uart_receive(sp, dummyData, sizeof(dummyData), &dummyLen);
+                uart_receive(comm->sp, dummyData, sizeof(dummyData), &dummyLen);
             }
         } else {
             if (is_receiving_raw_last) {
@@ -481,9 +1012,13 @@ __attribute__((force_align_arg_pointer))
 
                 // Set the buffer as undefined
                 // comm_raw_data == NULL is used in SetCommunicationReceiveMode()
-                __atomic_store_n(&comm_raw_data, NULL, __ATOMIC_SEQ_CST);
+                __atomic_store_n(&comm->comm_raw_data, NULL, __ATOMIC_SEQ_CST);
+            }
+            // sleep until bytes arrive or a command is queued for sending
+            res = uart_wait_rx(comm->sp);
+            if (res == PM3_SUCCESS) {
+                res = uart_receive(comm->sp, (uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), &rxlen);
             }
-            res = uart_receive(sp, (uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), &rxlen);
 
             if ((res == PM3_SUCCESS) && (rxlen == sizeof(PacketResponseNGPreamble))) {
 
@@ -503,7 +1038,7 @@ __attribute__((force_align_arg_pointer))
 
                     if ((!error) && (length > 0)) { // Get the variable length payload
 
-                        res = uart_receive(sp, (uint8_t *)&rx_raw.data, length, &rxlen);
+                        res = uart_receive(comm->sp, (uint8_t *)&rx_raw.data, length, &rxlen);
 
                         if ((res != PM3_SUCCESS) || (rxlen != length)) {
 
@@ -516,7 +1051,7 @@ __attribute__((force_align_arg_pointer))
 
                                 memcpy(&rx.data, &rx_raw.data, length);
                                 rx.length = length;
-                                if ((rx.cmd == g_conn.last_command) && (rx.status == PM3_SUCCESS)) {
+                                if ((rx.cmd == comm->conn.last_command) && (rx.status == PM3_SUCCESS)) {
                                     ACK_received = true;
                                 }
 
@@ -554,7 +1089,7 @@ __attribute__((force_align_arg_pointer))
                     }
 
                     if (!error) {                        // Get the postamble
-                        res = uart_receive(sp, (uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), &rxlen);
+                        res = uart_receive(comm->sp, (uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), &rxlen);
                         if ((res != PM3_SUCCESS) || (rxlen != sizeof(PacketResponseNGPostamble))) {
                             PrintAndLogEx(WARNING, "Received packet frame without postamble");
                             error = true;
@@ -584,13 +1119,13 @@ __attribute__((force_align_arg_pointer))
                         print_hex_break((uint8_t *)&rx_raw.data, rx_raw.pre.length, 32);
                         print_hex_break((uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), 32);
 #endif
-                        PacketResponseReceived(&rx);
+                        PacketResponseReceived(comm, &rx);
                     }
                 } else {                               // Old style reply
                     PacketResponseOLD rx_old;
                     memcpy(&rx_old, &rx_raw.pre, sizeof(PacketResponseNGPreamble));
 
-                    res = uart_receive(sp, ((uint8_t *)&rx_old) + sizeof(PacketResponseNGPreamble), sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble), &rxlen);
+                    res = uart_receive(comm->sp, ((uint8_t *)&rx_old) + sizeof(PacketResponseNGPreamble), sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble), &rxlen);
                     if ((res != PM3_SUCCESS) || (rxlen != sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble))) {
                         PrintAndLogEx(WARNING, "Received packet OLD frame with payload too short? %d/%zu", rxlen, sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble));
                         error = true;
@@ -614,7 +1149,7 @@ __attribute__((force_align_arg_pointer))
                         rx.oldarg[2] = rx_old.arg[2];
                         rx.length = PM3_CMD_DATA_SIZE;
                         memcpy(&rx.data, &rx_old.d, rx.length);
-                        PacketResponseReceived(&rx);
+                        PacketResponseReceived(comm, &rx);
                         if (rx.cmd == CMD_ACK) {
                             ACK_received = true;
                         }
@@ -634,7 +1169,7 @@ __attribute__((force_align_arg_pointer))
         is_receiving_raw_last = is_receiving_raw;
         // TODO if error, shall we resync ?
 
-        pthread_mutex_lock(&txBufferMutex);
+        pthread_mutex_lock(&comm->txBufferMutex);
 
         if (connection->block_after_ACK) {
             // if we just received an ACK, wait here until a new command is to be transmitted
@@ -643,43 +1178,44 @@ __attribute__((force_align_arg_pointer))
 #ifdef COMMS_DEBUG
                 PrintAndLogEx(NORMAL, "Received ACK, fast TX mode: ignoring other RX till TX");
 #endif
-                while (!txBuffer_pending) {
-                    pthread_cond_wait(&txBufferSig, &txBufferMutex);
+                while (!comm->txBuffer_pending) {
+                    pthread_cond_wait(&comm->txBufferSig, &comm->txBufferMutex);
                 }
             }
         }
 
-        if (txBuffer_pending) {
+        if (comm->txBuffer_pending) {
 
-            if (txBufferNGLen) { // NG packet
-                res = uart_send(sp, (uint8_t *) &txBufferNG, txBufferNGLen);
+            if (comm->txBufferNGLen) { // NG packet
+                res = uart_send(comm->sp, (uint8_t *) &comm->txBufferNG, comm->txBufferNGLen);
                 if (res == PM3_EIO) {
                     commfailed = true;
                 }
-                g_conn.last_command = txBufferNG.pre.cmd;
-                txBufferNGLen = 0;
+                comm->conn.last_command = comm->txBufferNG.pre.cmd;
+                comm->txBufferNGLen = 0;
             } else {
-                res = uart_send(sp, (uint8_t *) &txBuffer, sizeof(PacketCommandOLD));
+                res = uart_send(comm->sp, (uint8_t *) &comm->txBuffer, sizeof(PacketCommandOLD));
                 if (res == PM3_EIO) {
                     commfailed = true;
                 }
-                g_conn.last_command = txBuffer.cmd;
+                comm->conn.last_command = comm->txBuffer.cmd;
             }
 
-            txBuffer_pending = false;
+            comm->txBuffer_pending = false;
+            comm->rtt_start_us = usclock();
 
             // main thread doesn't know send failed...
 
             // tell main thread that txBuffer is empty
-            pthread_cond_signal(&txBufferSig);
+            pthread_cond_signal(&comm->txBufferSig);
         }
 
-        pthread_mutex_unlock(&txBufferMutex);
+        pthread_mutex_unlock(&comm->txBufferMutex);
     }
 
     // when thread dies, we close the serial port.
-    uart_close(sp);
-    sp = NULL;
+    uart_close(comm->sp);
+    comm->sp = NULL;
 
 #if defined(__MACH__) && defined(__APPLE__)
     enableAppNap();
@@ -690,7 +1226,7 @@ __attribute__((force_align_arg_pointer))
 }
 
 bool IsCommunicationThreadDead(void) {
-    bool ret = __atomic_load_n(&comm_thread_dead, __ATOMIC_SEQ_CST);
+    bool ret = __atomic_load_n(&g_comm->comm_thread_dead, __ATOMIC_SEQ_CST);
     return ret;
 }
 
@@ -715,36 +1251,103 @@ bool IsCommunicationThreadDead(void) {
 
 bool SetCommunicationReceiveMode(bool isRawMode) {
     if (isRawMode) {
-        const uint8_t *buffer = __atomic_load_n(&comm_raw_data, __ATOMIC_SEQ_CST);
+        const uint8_t *buffer = __atomic_load_n(&g_comm->comm_raw_data, __ATOMIC_SEQ_CST);
         if (buffer == NULL) {
             PrintAndLogEx(ERR, "Buffer for raw data is not set");
             return false;
         }
     }
-    __atomic_store_n(&comm_raw_mode, isRawMode, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->comm_raw_mode, isRawMode, __ATOMIC_SEQ_CST);
     return true;
 }
 
 void SetCommunicationRawReceiveBuffer(uint8_t *buffer, size_t len) {
-    __atomic_store_n(&comm_raw_data,  buffer, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&comm_raw_len,  len, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&comm_raw_pos,  0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->comm_raw_data,  buffer, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->comm_raw_len,  len, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->comm_raw_pos,  0, __ATOMIC_SEQ_CST);
 }
 
 size_t GetCommunicationRawReceiveNum(void) {
-    return __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&g_comm->comm_raw_pos, __ATOMIC_SEQ_CST);
+}
+
+void GetCommunicationLatency(comm_latency_t *latency) {
+    pthread_mutex_lock(&g_comm->txBufferMutex);
+    memcpy(latency, &g_comm->latency, sizeof(comm_latency_t));
+    pthread_mutex_unlock(&g_comm->txBufferMutex);
+}
+
+void GetCommunicationStats(comm_stats_t *stats) {
+    stats->frames_sent = __atomic_load_n(&comm_stats.frames_sent, __ATOMIC_RELAXED);
+    stats->frames_recv = __atomic_load_n(&comm_stats.frames_recv, __ATOMIC_RELAXED);
+    stats->bytes_sent = __atomic_load_n(&comm_stats.bytes_sent, __ATOMIC_RELAXED);
+    stats->bytes_recv = __atomic_load_n(&comm_stats.bytes_recv, __ATOMIC_RELAXED);
+    stats->round_trips = comm_stats.round_trips;
+    stats->wait_us = comm_stats.wait_us;
+}
+
+void ResetCommunicationLatency(void) {
+    pthread_mutex_lock(&g_comm->txBufferMutex);
+    memset(&g_comm->latency, 0, sizeof(comm_latency_t));
+    g_comm->rtt_start_us = 0;
+    pthread_mutex_unlock(&g_comm->txBufferMutex);
+}
+
+// Allocates *dev and its communication context if needed, and selects it.
+// returns true if *dev was allocated here
+static bool prepareDevice(pm3_device_t **dev) {
+    if (*dev) {
+        SelectProxmark(*dev);
+        return false;
+    }
+
+    pm3_device_t *d = calloc(1, sizeof(pm3_device_t));
+    comm_ctx_t *c = calloc(1, sizeof(comm_ctx_t));
+    if (d == NULL || c == NULL) {
+        PrintAndLogEx(ERR, "Failed to allocate memory for pm3_device_t");
+        free(d);
+        free(c);
+        return false;
+    }
+
+    pthread_mutex_init(&c->txBufferMutex, NULL);
+    pthread_cond_init(&c->txBufferSig, NULL);
+    pthread_mutex_init(&c->rxBufferMutex, NULL);
+    pthread_cond_init(&c->rxBufferSig, NULL);
+    c->async_next_id = 1;
+
+    d->ctx = c;
+    d->conn = &c->conn;
+    *dev = d;
+    SelectProxmark(d);
+    return true;
+}
+
+// Undoes prepareDevice() after a failed open
+static void discardDevice(pm3_device_t **dev, bool allocated, pm3_device_t *prev) {
+    if (allocated == false) {
+        return;
+    }
+    pm3_device_t *d = *dev;
+    *dev = NULL;
+    SelectProxmark((prev == d) ? NULL : prev);
+    FreeProxmark(d);
 }
 
 bool OpenProxmarkSilent(pm3_device_t **dev, const char *port, uint32_t speed) {
 
-    sp = uart_open(port, speed, true);
+    pm3_device_t *prev = g_session.current_device;
+    bool allocated = prepareDevice(dev);
+    if (*dev == NULL) {
+        return false;
+    }
+
+    g_comm->sp = uart_open(port, speed, true);
 
     // check result of uart opening
-    if (sp == INVALID_SERIAL_PORT) {
-        sp = NULL;
-        return false;
-    } else if (sp == CLAIMED_SERIAL_PORT) {
-        sp = NULL;
+    if (g_comm->sp == INVALID_SERIAL_PORT || g_comm->sp == CLAIMED_SERIAL_PORT) {
+        g_comm->sp = NULL;
+        discardDevice(dev, allocated, prev);
         return false;
     } else {
         // start the communication thread
@@ -761,56 +1364,55 @@ bool OpenProxmarkSilent(pm3_device_t **dev, const char *port, uint32_t speed) {
         // "Session" flag, to tell via which interface next msgs should be sent: USB or FPC USART
         g_conn.send_via_fpc_usart = false;
 
-        pthread_create(&communication_thread, NULL, &uart_communication, &g_conn);
-        __atomic_clear(&comm_thread_dead, __ATOMIC_SEQ_CST);
+        pthread_create(&g_comm->communication_thread, NULL, &uart_communication, g_comm);
+        __atomic_clear(&g_comm->comm_thread_dead, __ATOMIC_SEQ_CST);
         __atomic_clear(&reconnect_ok, __ATOMIC_SEQ_CST);
 
-        g_session.pm3_present = true; // TODO support for multiple devices
+        g_comm->present = true;
+        g_session.pm3_present = true;
 
         fflush(stdout);
-        if (*dev == NULL) {
-            *dev = calloc(sizeof(pm3_device_t), sizeof(uint8_t));
-            if (*dev == NULL) {
-                PrintAndLogEx(ERR, "Failed to allocate memory for pm3_device_t");
-                uart_close(sp);
-                sp = NULL;
-                return false;
-            }
-        }
-        (*dev)->g_conn = &g_conn; // TODO g_conn shouldn't be global
         return true;
     }
 }
 
 bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int timeout, bool flash_mode, uint32_t speed) {
 
+    pm3_device_t *prev = g_session.current_device;
+    bool allocated = prepareDevice(dev);
+    if (*dev == NULL) {
+        return false;
+    }
+
     if (wait_for_port == false) {
         PrintAndLogEx(SUCCESS, "Using UART port " _GREEN_("%s"), port);
-        sp = uart_open(port, speed, false);
+        g_comm->sp = uart_open(port, speed, false);
     } else {
         PrintAndLogEx(SUCCESS, "Waiting for Proxmark3 to appear on " _YELLOW_("%s"), port);
         fflush(stdout);
         int openCount = 0;
         PrintAndLogEx(INPLACE, "% 3i", timeout);
         do {
-            sp = uart_open(port, speed, false);
+            g_comm->sp = uart_open(port, speed, false);
             msleep(500);
             PrintAndLogEx(INPLACE, "% 3i", timeout - openCount - 1);
 
-        } while (++openCount < timeout && (sp == INVALID_SERIAL_PORT || sp == CLAIMED_SERIAL_PORT));
+        } while (++openCount < timeout && (g_comm->sp == INVALID_SERIAL_PORT || g_comm->sp == CLAIMED_SERIAL_PORT));
     }
 
     // check result of uart opening
-    if (sp == INVALID_SERIAL_PORT) {
+    if (g_comm->sp == INVALID_SERIAL_PORT) {
         PrintAndLogEx(WARNING, "\n" _RED_("ERROR:") " invalid serial port " _YELLOW_("%s"), port);
         PrintAndLogEx(HINT, "Hint: Try the shell script `" _YELLOW_("`./pm3 --list") "` to get a list of possible serial ports");
-        sp = NULL;
+        g_comm->sp = NULL;
+        discardDevice(dev, allocated, prev);
         return false;
-    } else if (sp == CLAIMED_SERIAL_PORT) {
+    } else if (g_comm->sp == CLAIMED_SERIAL_PORT) {
         PrintAndLogEx(WARNING, "\n" _RED_("ERROR:") " serial port " _YELLOW_("%s") " is claimed by another process", port);
         PrintAndLogEx(HINT, "Hint: Try the shell script `" _YELLOW_("./pm3 --list") "` to get a list of possible serial ports");
 
-        sp = NULL;
+        g_comm->sp = NULL;
+        discardDevice(dev, allocated, prev);
         return false;
     } else {
         // start the communication thread
@@ -827,26 +1429,62 @@ bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int
         // "Session" flag, to tell via which interface next msgs should be sent: USB or FPC USART
         g_conn.send_via_fpc_usart = false;
 
-        pthread_create(&communication_thread, NULL, &uart_communication, &g_conn);
-        __atomic_clear(&comm_thread_dead, __ATOMIC_SEQ_CST);
-        g_session.pm3_present = true; // TODO support for multiple devices
+        pthread_create(&g_comm->communication_thread, NULL, &uart_communication, g_comm);
+        __atomic_clear(&g_comm->comm_thread_dead, __ATOMIC_SEQ_CST);
+        g_comm->present = true;
+        g_session.pm3_present = true;
 
         fflush(stdout);
-        if (*dev == NULL) {
-            *dev = calloc(1, sizeof(pm3_device_t));
-            if (*dev == NULL) {
-                PrintAndLogEx(ERR, "Failed to allocate memory for pm3_device_t");
-                uart_close(sp);
-                sp = NULL;
-                return false;
-            }
-        }
-        (*dev)->g_conn = &g_conn; // TODO g_conn shouldn't be global
         return true;
     }
 }
 
 // check if we can communicate with Pm3
+// Capabilities of the device last seen on a port, saved in the home directory with --cached-caps
+static char *caps_cache_path(void) {
+    char fn[FILE_PATH_SIZE] = "caps_";
+    size_t n = strlen(fn);
+    for (const char *p = g_conn.serial_port_name; p && *p && n < sizeof(fn) - 5; p++) {
+        fn[n++] = (isalnum((unsigned char)*p)) ? *p : '_';
+    }
+    snprintf(fn + n, sizeof(fn) - n, ".bin");
+
+    char *path = NULL;
+    if (searchHomeFilePath(&path, NULL, fn, true) != PM3_SUCCESS) {
+        return NULL;
+    }
+    return path;
+}
+
+static bool caps_cache_load(capabilities_t *caps) {
+    char *path = caps_cache_path();
+    if (path == NULL) {
+        return false;
+    }
+    FILE *f = fopen(path, "rb");
+    free(path);
+    if (f == NULL) {
+        return false;
+    }
+    bool ok = (fread(caps, 1, sizeof(capabilities_t), f) == sizeof(capabilities_t)) && (caps->version == CAPABILITIES_VERSION);
+    fclose(f);
+    return ok;
+}
+
+static void caps_cache_save(const capabilities_t *caps) {
+    char *path = caps_cache_path();
+    if (path == NULL) {
+        return;
+    }
+    FILE *f = fopen(path, "wb");
+    free(path);
+    if (f == NULL) {
+        return;
+    }
+    fwrite(caps, 1, sizeof(capabilities_t), f);
+    fclose(f);
+}
+
 int TestProxmark(pm3_device_t *dev) {
 
     uint16_t len = 32;
@@ -855,7 +1493,7 @@ int TestProxmark(pm3_device_t *dev) {
         data[i] = i & 0xFF;
     }
 
-    __atomic_store_n(&last_packet_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->last_packet_time,  msclock(), __ATOMIC_SEQ_CST);
     clearCommandBuffer();
     SendCommandNG(CMD_PING, data, len);
 
@@ -880,18 +1518,26 @@ int TestProxmark(pm3_device_t *dev) {
         return PM3_EIO;
     }
 
-    SendCommandNG(CMD_CAPABILITIES, NULL, 0);
-    if (WaitForResponseTimeoutW(CMD_CAPABILITIES, &resp, 1000, false) == false) {
-        return PM3_ETIMEOUT;
-    }
+    bool cached = g_session.cached_caps && (g_session.incognito == false) && caps_cache_load(&g_pm3_capabilities);
+    if (cached) {
+        PrintAndLogEx(DEBUG, "Using cached capabilities");
+    } else {
+        SendCommandNG(CMD_CAPABILITIES, NULL, 0);
+        if (WaitForResponseTimeoutW(CMD_CAPABILITIES, &resp, 1000, false) == false) {
+            return PM3_ETIMEOUT;
+        }
 
-    if ((resp.length != sizeof(g_pm3_capabilities)) || (resp.data.asBytes[0] != CAPABILITIES_VERSION)) {
-        PrintAndLogEx(ERR, _RED_("Capabilities structure version sent by Proxmark3 is not the same as the one used by the client!"));
-        PrintAndLogEx(ERR, _RED_("Please flash the Proxmark3 with the same version as the client."));
-        return PM3_EDEVNOTSUPP;
-    }
+        if ((resp.length != sizeof(g_pm3_capabilities)) || (resp.data.asBytes[0] != CAPABILITIES_VERSION)) {
+            PrintAndLogEx(ERR, _RED_("Capabilities structure version sent by Proxmark3 is not the same as the one used by the client!"));
+            PrintAndLogEx(ERR, _RED_("Please flash the Proxmark3 with the same version as the client."));
+            return PM3_EDEVNOTSUPP;
+        }
 
-    memcpy(&g_pm3_capabilities, resp.data.asBytes, sizeof(capabilities_t));
+        memcpy(&g_pm3_capabilities, resp.data.asBytes, sizeof(capabilities_t));
+        if (g_session.cached_caps && (g_session.incognito == false)) {
+            caps_cache_save(&g_pm3_capabilities);
+        }
+    }
     g_conn.send_via_fpc_usart = g_pm3_capabilities.via_fpc;
     g_conn.uart_speed = g_pm3_capabilities.baudrate;
 
@@ -925,33 +1571,77 @@ int TestProxmark(pm3_device_t *dev) {
 }
 
 void CloseProxmark(pm3_device_t *dev) {
-    dev->g_conn->run = false;
+    comm_ctx_t *c = dev->ctx;
+    c->conn.run = false;
 
 #ifdef __BIONIC__
-    if (communication_thread != 0) {
-        pthread_join(communication_thread, NULL);
+    if (c->communication_thread != 0) {
+        pthread_join(c->communication_thread, NULL);
     }
 #else
-    pthread_join(communication_thread, NULL);
+    pthread_join(c->communication_thread, NULL);
 #endif
 
-    if (sp) {
-        uart_close(sp);
+    if (c->sp) {
+        uart_close(c->sp);
     }
 
     // Clean up our state
-    sp = NULL;
+    c->sp = NULL;
 #ifdef __BIONIC__
-    if (communication_thread != 0) {
-        memset(&communication_thread, 0, sizeof(pthread_t));
+    if (c->communication_thread != 0) {
+        memset(&c->communication_thread, 0, sizeof(pthread_t));
     }
 #else
-    memset(&communication_thread, 0, sizeof(pthread_t));
+    memset(&c->communication_thread, 0, sizeof(pthread_t));
 #endif
 
-    g_session.pm3_present = false;
+    c->present = false;
+    if (c == g_comm) {
+        g_session.pm3_present = false;
+    }
 }
 
+// Releases a closed device. The selected device falls back to offline mode.
+void FreeProxmark(pm3_device_t *dev) {
+    if (dev == NULL) {
+        return;
+    }
+
+    if (g_session.current_device == dev) {
+        SelectProxmark(NULL);
+    }
+
+    comm_ctx_t *c = dev->ctx;
+    if (c) {
+        pthread_mutex_destroy(&c->txBufferMutex);
+        pthread_cond_destroy(&c->txBufferSig);
+        pthread_mutex_destroy(&c->rxBufferMutex);
+        pthread_cond_destroy(&c->rxBufferSig);
+        free(c);
+    }
+    free(dev);
+}
+
+// Makes dev the device all commands are sent to and received from.
+// Replies of the other devices keep queueing in their own ring meanwhile.
+// NULL selects offline mode.
+void SelectProxmark(pm3_device_t *dev) {
+    comm_ctx_t *c = (dev && dev->ctx) ? dev->ctx : &comm_offline;
+
+    if (g_comm != c) {
+        // capabilities are only ever written by TestProxmark, on the selected device
+        memcpy(&g_comm->capabilities, &g_pm3_capabilities, sizeof(capabilities_t));
+        memcpy(&g_pm3_capabilities, &c->capabilities, sizeof(capabilities_t));
+        g_comm = c;
+        g_conn_active = &c->conn;
+    }
+    g_session.current_device = dev;
+    g_session.pm3_present = c->present;
+}
+
+
+
 // Gives a rough estimate of the communication delay based on channel & baudrate
 // Max communication delay is when sending largest frame and receiving largest frame
 // Empirical measures on FTDI with physical cable:
@@ -987,10 +1677,11 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
     if (ms_timeout != (size_t) - 1) {
         ms_timeout += communication_delay();
     }
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
     SetCommunicationRawReceiveBuffer(buffer, len);
     SetCommunicationReceiveMode(true);
+    uint64_t wait = comm_wait_begin();
 
     size_t pos = 0;
     while (pos < len) {
@@ -1007,11 +1698,11 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
             }
         }
 
-        pos = __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST);
+        pos = __atomic_load_n(&g_comm->comm_raw_pos, __ATOMIC_SEQ_CST);
 
         // Check the timeout if pos is not updated
         if (last_pos == pos) {
-            uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+            uint64_t tmp_clk = __atomic_load_n(&g_comm->timeout_start_time, __ATOMIC_SEQ_CST);
             // If ms_timeout == -1, the loop can only be breaked by pressing Enter or receiving enough data
             if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout)) {
                 break;
@@ -1037,7 +1728,151 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
         msleep(ms_timeout);
     }
     SetCommunicationReceiveMode(false);
-    pos = __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST);
+    pos = __atomic_load_n(&g_comm->comm_raw_pos, __ATOMIC_SEQ_CST);
+    comm_wait_end(wait, pos > 0);
+    return pos;
+}
+
+/**
+ * @brief Streaming raw receive. Data is read straight into a ring of caller provided buffers
+ *  and every filled buffer is handed to the consumer, then reused. When the consumer lags behind,
+ *  the comm thread stops reading and the data waits in the OS / USB buffers, nothing is dropped
+ *  or reallocated.
+ *
+ *  Arm the stream before sending the command starting the transfer, so the first bytes can't be
+ *  mistaken for a frame, then call WaitForRawDataStream()
+ *
+ * @param buffers ring of count buffers of buf_size bytes each, must stay valid until WaitForRawDataStream returns
+ * @param len total bytes to receive, (size_t) -1 for no limit
+ */
+bool StartRawDataStream(uint8_t **buffers, uint8_t count, size_t buf_size, size_t len) {
+
+    if (buffers == NULL || count == 0 || buf_size == 0) {
+        return false;
+    }
+
+    g_comm->raw_stream_count = count;
+    g_comm->raw_stream_size = buf_size;
+    __atomic_store_n(&g_comm->raw_stream_w, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->raw_stream_r, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->raw_stream_fill, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->raw_stream_bufs, buffers, __ATOMIC_SEQ_CST);
+
+    SetCommunicationRawReceiveBuffer(buffers[0], len);
+    return SetCommunicationReceiveMode(true);
+}
+
+/**
+ * @brief Consumes a stream armed with StartRawDataStream(). The last, partially filled
+ *  buffer is handed over at the end.
+ *
+ * @param ms_timeout the maximum timeout without data, (size_t) -1 to wait until enter is pressed,
+ *  the data the device sends while stopping is still received
+ * @param wait_first no timeout before the first bytes, e.g. waiting for a trigger
+ * @param show_process print how many bytes are received
+ * @param cb consumer, called from this thread. Return false to stop the transfer
+ * @return the number of received bytes
+ */
+size_t WaitForRawDataStream(size_t ms_timeout, bool wait_first, bool show_process, raw_stream_cb_t cb, void *ctx) {
+
+    uint8_t **buffers = __atomic_load_n(&g_comm->raw_stream_bufs, __ATOMIC_SEQ_CST);
+    if (buffers == NULL || cb == NULL) {
+        return 0;
+    }
+    const uint8_t count = g_comm->raw_stream_count;
+    const size_t buf_size = g_comm->raw_stream_size;
+    const size_t len = __atomic_load_n(&g_comm->comm_raw_len, __ATOMIC_SEQ_CST);
+
+    // Add delay depending on the communication channel & speed
+    if (ms_timeout != (size_t) - 1) {
+        ms_timeout += communication_delay();
+    }
+    __atomic_store_n(&g_comm->timeout_start_time, msclock(), __ATOMIC_SEQ_CST);
+    uint64_t wait = comm_wait_begin();
+
+    uint32_t r = 0;
+    bool stop = false;
+    uint8_t print_counter = 0;
+    size_t last_pos = 0;
+    size_t pos = 0;
+    while (pos < len) {
+
+        if (kbd_enter_pressed()) {
+            // Send anything to stop the transfer
+            PrintAndLogEx(INFO, "Stopping");
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            if (wait_first && pos == 0) {
+                break;
+            }
+            // without a timeout, keep what the device still sends while it stops
+            if (ms_timeout == (size_t) - 1) {
+                ms_timeout = 1000 + communication_delay();
+                __atomic_store_n(&g_comm->timeout_start_time, msclock(), __ATOMIC_SEQ_CST);
+            }
+        }
+
+        while (stop == false && r != __atomic_load_n(&g_comm->raw_stream_w, __ATOMIC_SEQ_CST)) {
+            stop = (cb(buffers[r % count], buf_size, ctx) == false);
+            r++;
+            __atomic_store_n(&g_comm->raw_stream_r, r, __ATOMIC_SEQ_CST);
+        }
+
+        if (stop || IsCommunicationThreadDead()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            break;
+        }
+
+        pos = __atomic_load_n(&g_comm->comm_raw_pos, __ATOMIC_SEQ_CST);
+
+        // Check the timeout if pos is not updated
+        if (last_pos == pos) {
+            uint64_t tmp_clk = __atomic_load_n(&g_comm->timeout_start_time, __ATOMIC_SEQ_CST);
+            bool waiting = (wait_first && pos == 0);
+            if ((ms_timeout != (size_t) - 1) && (waiting == false) && (msclock() - tmp_clk > ms_timeout)) {
+                break;
+            }
+        } else {
+            // Print process when (print_counter % 64) == 0
+            if (show_process && (print_counter & 0x3F) == 0) {
+                PrintAndLogEx(INFO, "[%zu/%zu]", pos, len);
+            }
+            print_counter++;
+        }
+
+        last_pos = pos;
+        msleep(1);
+    }
+
+    if (pos >= len && (ms_timeout != (size_t) - 1)) {
+        // desired data received, tell the arm side to stop the current process
+        SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+        msleep(ms_timeout);
+    }
+
+    SetCommunicationReceiveMode(false);
+
+    // wait for the comm thread to leave raw mode before touching the last buffer
+    uint64_t start = msclock();
+    while (__atomic_load_n(&g_comm->comm_raw_data, __ATOMIC_SEQ_CST) != NULL) {
+        if (IsCommunicationThreadDead() || msclock() - start > 2000) {
+            break;
+        }
+        msleep(1);
+    }
+    __atomic_store_n(&g_comm->raw_stream_bufs, NULL, __ATOMIC_SEQ_CST);
+
+    uint32_t w = __atomic_load_n(&g_comm->raw_stream_w, __ATOMIC_SEQ_CST);
+    while (stop == false && r != w) {
+        stop = (cb(buffers[r % count], buf_size, ctx) == false);
+        r++;
+    }
+    size_t fill = __atomic_load_n(&g_comm->raw_stream_fill, __ATOMIC_SEQ_CST);
+    if (stop == false && fill) {
+        cb(buffers[r % count], fill, ctx);
+    }
+
+    pos = __atomic_load_n(&g_comm->comm_raw_pos, __ATOMIC_SEQ_CST);
+    comm_wait_end(wait, pos > 0);
     return pos;
 }
 
@@ -1066,7 +1901,8 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
         ms_timeout += communication_delay();
     }
 
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    uint64_t wait = comm_wait_begin();
 
     // Wait until the command is received
     while (true) {
@@ -1078,7 +1914,12 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
 
         while (getReply(response)) {
 
+            if (dispatchAsyncReply(response)) {
+                continue;
+            }
+
             if (cmd == CMD_UNKNOWN || response->cmd == cmd) {
+                comm_wait_end(wait, true);
                 return true;
             }
 
@@ -1091,7 +1932,7 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
             }
         }
 
-        uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+        uint64_t tmp_clk = __atomic_load_n(&g_comm->timeout_start_time, __ATOMIC_SEQ_CST);
         if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout)) {
             break;
         }
@@ -1101,9 +1942,10 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
             PrintAndLogEx(INFO, "You can cancel this operation by pressing the pm3 button");
             show_warning = false;
         }
-        // just to avoid CPU busy loop:
-        msleep(1);
+        // sleep until the communication thread stores a reply
+        waitReply(10);
     }
+    comm_wait_end(wait, false);
     return false;
 }
 
@@ -1115,6 +1957,134 @@ bool WaitForResponse(uint32_t cmd, PacketResponseNG *response) {
     return WaitForResponseTimeoutW(cmd, response, -1, true);
 }
 
+// Each downloaded chunk carries its offset in the transfer, which we use as sequence number.
+// A chunk lost on the way (bad CRC, dropped frame on the FPC/BT link) leaves a hole in the seen bitmap
+// and only the missing runs are requested again instead of restarting the whole download.
+#define DOWNLOAD_MAX_RETRANSMIT 3
+
+static void dl_request(DeviceMemType_t memtype, uint32_t start_index, uint32_t bytes) {
+
+    // on slow links, let the device LZ4 compress BigBuf / EML data.
+    // Older firmwares ignore the flag and answer with raw frames.
+    uint32_t flags = (g_conn.send_via_fpc_usart) ? DOWNLOAD_FLAG_LZ4 : 0;
+
+    switch (memtype) {
+        case BIG_BUF:
+            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, flags, NULL, 0);
+            break;
+        case BIG_BUF_EML:
+            SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, flags, NULL, 0);
+            break;
+        case FLASH_MEM:
+            SendCommandMIX(CMD_FLASHMEM_DOWNLOAD, start_index, bytes, 0, NULL, 0);
+            break;
+        case SPIFFS:
+        case SIM_MEM:
+        case FPGA_MEM:
+        case MCU_FLASH:
+        case MCU_MEM:
+        default:
+            break;
+    }
+}
+
+static uint32_t dl_rec_cmd(DeviceMemType_t memtype) {
+    switch (memtype) {
+        case BIG_BUF:
+            return CMD_DOWNLOADED_BIGBUF;
+        case BIG_BUF_EML:
+            return CMD_DOWNLOADED_EML_BIGBUF;
+        case FLASH_MEM:
+            return CMD_FLASHMEM_DOWNLOADED;
+        case SPIFFS:
+        case SIM_MEM:
+        case FPGA_MEM:
+        case MCU_FLASH:
+        case MCU_MEM:
+        default:
+            return CMD_UNKNOWN;
+    }
+}
+
+static bool dl_windowed(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+
+    uint32_t chunks = (bytes + PM3_CMD_DATA_SIZE - 1) / PM3_CMD_DATA_SIZE;
+    uint8_t *seen = calloc((chunks + 7) / 8, sizeof(uint8_t));
+    if (seen == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return false;
+    }
+
+    uint32_t rec_cmd = dl_rec_cmd(memtype);
+
+    // first pass, whole range
+    dl_request(memtype, start_index, bytes);
+    dl_it(dest, bytes, response, ms_timeout, show_warning, rec_cmd, seen, 0);
+
+    // keep answer of the first complete pass, callers read e.g. tracelen from it
+    PacketResponseNG first = *response;
+
+    // nothing at all arrived, the device isn't answering. Don't hammer it with retransmits
+    bool got_any = false;
+    for (uint32_t i = 0; i < (chunks + 7) / 8; i++) {
+        if (seen[i]) {
+            got_any = true;
+            break;
+        }
+    }
+
+    for (uint8_t pass = 0; got_any && (pass < DOWNLOAD_MAX_RETRANSMIT); pass++) {
+
+        uint32_t missing = 0;
+
+        // request each missing run of chunks in one go
+        uint32_t i = 0;
+        while (i < chunks) {
+            if (seen[i >> 3] & (1 << (i & 7))) {
+                i++;
+                continue;
+            }
+
+            uint32_t run = i;
+            while (i < chunks && ((seen[i >> 3] & (1 << (i & 7))) == 0)) {
+                i++;
+            }
+
+            uint32_t off = run * PM3_CMD_DATA_SIZE;
+            uint32_t len = MIN(bytes - off, (i - run) * PM3_CMD_DATA_SIZE);
+            missing += (i - run);
+
+            PrintAndLogEx(DEBUG, "Retransmit request, offset %u len %u", off, len);
+            clearCommandBuffer();
+            dl_request(memtype, start_index + off, len);
+            dl_it(dest + off, len, response, ms_timeout, false, rec_cmd, seen, run);
+        }
+
+        if (missing == 0) {
+            break;
+        }
+
+        PrintAndLogEx(DEBUG, "Download pass %u, requested %u missing chunk(s)", pass + 1, missing);
+    }
+
+    // final verdict, all chunks must be present
+    bool res = true;
+    for (uint32_t i = 0; i < chunks; i++) {
+        if ((seen[i >> 3] & (1 << (i & 7))) == 0) {
+            PrintAndLogEx(FAILED, "Download incomplete, chunk %u missing after %u retransmits", i, DOWNLOAD_MAX_RETRANSMIT);
+            res = false;
+            break;
+        }
+    }
+
+    if (first.cmd == CMD_ACK) {
+        *response = first;
+    }
+
+    free(seen);
+    return res;
+}
+
 /**
 * Data transfer from Proxmark to client. This method times out after
 * ms_timeout milliseconds.
@@ -1151,45 +2121,48 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
     clearCommandBuffer();
 
     switch (memtype) {
-        case BIG_BUF: {
-            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF);
-        }
-        case BIG_BUF_EML: {
-            SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_EML_BIGBUF);
+        case BIG_BUF:
+        case BIG_BUF_EML:
+        case FLASH_MEM: {
+            return dl_windowed(memtype, dest, bytes, start_index, response, ms_timeout, show_warning);
         }
         case SPIFFS: {
             SendCommandMIX(CMD_SPIFFS_DOWNLOAD, start_index, bytes, 0, data, datalen);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_SPIFFS_DOWNLOADED);
-        }
-        case FLASH_MEM: {
-            SendCommandMIX(CMD_FLASHMEM_DOWNLOAD, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FLASHMEM_DOWNLOADED);
+            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_SPIFFS_DOWNLOADED, NULL, 0);
         }
         case SIM_MEM: {
             //SendCommandMIX(CMD_DOWNLOAD_SIM_MEM, start_index, bytes, 0, NULL, 0);
-            //return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_SIMMEM);
+            //return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_SIMMEM, NULL, 0);
             return false;
         }
         case FPGA_MEM: {
             SendCommandNG(CMD_FPGAMEM_DOWNLOAD, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FPGAMEM_DOWNLOADED);
+            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FPGAMEM_DOWNLOADED, NULL, 0);
         }
         case MCU_FLASH:
         case MCU_MEM: {
             uint32_t flags = (memtype == MCU_MEM) ? READ_MEM_DOWNLOAD_FLAG_RAW : 0;
             SendCommandBL(CMD_READ_MEM_DOWNLOAD, start_index, bytes, flags, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_READ_MEM_DOWNLOADED);
+            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_READ_MEM_DOWNLOADED, NULL, 0);
         }
     }
     return false;
 }
 
-static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd) {
+static bool dl_receive(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd, uint8_t *seen, uint32_t base_chunk);
+
+// seen, optional bitmap of received chunks, chunk numbers are offset by base_chunk
+static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd, uint8_t *seen, uint32_t base_chunk) {
+    uint64_t wait = comm_wait_begin();
+    bool res = dl_receive(dest, bytes, response, ms_timeout, show_warning, rec_cmd, seen, base_chunk);
+    comm_wait_end(wait, res);
+    return res;
+}
+
+static bool dl_receive(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd, uint8_t *seen, uint32_t base_chunk) {
 
     uint32_t bytes_completed = 0;
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_comm->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
     // Add delay depending on the communication channel & speed
     if (ms_timeout != (size_t) - 1)
@@ -1197,11 +2170,13 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
 
     while (true) {
 
-        if (getReply(response)) {
+        if (getReply(response) == 0) {
+            waitReply(10);
+        } else if (dispatchAsyncReply(response) == false) {
 
             if (response->cmd == CMD_ACK)
                 return true;
-            if (response->cmd == CMD_SPIFFS_DOWNLOAD && response->status == PM3_EMALLOC)
+            if (response->cmd == CMD_SPIFFS_DOWNLOAD && response->status != PM3_SUCCESS)
                 return false;
             // Spiffs // fpgamem-plot download is converted to NG,
             if (response->cmd == CMD_SPIFFS_DOWNLOAD || response->cmd == CMD_FPGAMEM_DOWNLOAD)
@@ -1229,6 +2204,40 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
 
                 memcpy(dest + offset, response->data.asBytes, copy_bytes);
                 bytes_completed += copy_bytes;
+
+                if (seen) {
+                    uint32_t chunk = base_chunk + (offset / PM3_CMD_DATA_SIZE);
+                    seen[chunk >> 3] |= (1 << (chunk & 7));
+                }
+            } else if (response->cmd == CMD_DOWNLOADED_LZ4) {
+
+                // arg0 = offset in transfer
+                // arg1 = compressed length
+                // arg2 = uncompressed length
+                uint32_t offset = response->oldarg[0];
+                uint32_t clen = response->oldarg[1];
+                uint32_t dlen = response->oldarg[2];
+
+                if ((clen > PM3_CMD_DATA_SIZE) || (offset + dlen > bytes)) {
+                    PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | total len %u > buf_size %u", offset, dlen,  offset + dlen,  bytes);
+                    break;
+                }
+
+                int res = LZ4_decompress_safe((const char *)response->data.asBytes, (char *)dest + offset, clen, dlen);
+                if (res < 0 || (uint32_t)res != dlen) {
+                    // leave the chunks unmarked, they will be requested again
+                    PrintAndLogEx(DEBUG, "LZ4 block at offset %u failed to decompress ( %d )", offset, res);
+                    continue;
+                }
+
+                bytes_completed += dlen;
+
+                if (seen) {
+                    for (uint32_t chunk = offset / PM3_CMD_DATA_SIZE; chunk < (offset + dlen + PM3_CMD_DATA_SIZE - 1) / PM3_CMD_DATA_SIZE; chunk++) {
+                        uint32_t c = base_chunk + chunk;
+                        seen[c >> 3] |= (1 << (c & 7));
+                    }
+                }
             } else if (response->cmd == CMD_WTX && response->length == sizeof(uint16_t)) {
                 uint16_t wtx = response->data.asDwords[0] & 0xFFFF;
                 PrintAndLogEx(DEBUG, "Got Waiting Time eXtension request %i ms", wtx);
@@ -1237,7 +2246,7 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
             }
         }
 
-        uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+        uint64_t tmp_clk = __atomic_load_n(&g_comm->timeout_start_time, __ATOMIC_SEQ_CST);
         if (msclock() - tmp_clk > ms_timeout) {
             PrintAndLogEx(FAILED, "Timed out while trying to download data from device");
             break;
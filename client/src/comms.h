@@ -40,13 +40,16 @@ extern "C" {
     }
 #endif
 
-//For storing command that are received from the device
+//For storing command that are received from the device, must be a power of two
 #ifndef CMD_BUFFER_SIZE
-#define CMD_BUFFER_SIZE 100
+#define CMD_BUFFER_SIZE 128
 #endif
 
 #define COMM_RAW_RECEIVE_LEN (1024)
 
+// max number of async commands in flight
+#define ASYNC_MAX_TICKETS 32
+
 typedef enum {
     BIG_BUF,
     BIG_BUF_EML,
@@ -84,20 +87,58 @@ typedef struct {
     char serial_port_name[FILE_PATH_SIZE];
 } communication_arg_t;
 
-extern communication_arg_t g_conn;
+// Connection of the selected device, see SelectProxmark()
+extern communication_arg_t *g_conn_active;
+#define g_conn (*g_conn_active)
+
+typedef struct comm_ctx comm_ctx_t;
+
+// Round trip of commands, from the end of the send to the matching reply (NG same cmd, or ACK)
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} comm_latency_t;
+
+// Client side traffic counters, cumulative since start. Waiting is the time a command spent
+// blocked on the device, from the outermost WaitForResponse*, GetFromDevice, raw data or async wait.
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t frames_recv;
+    uint64_t bytes_sent;
+    uint64_t bytes_recv;
+    uint32_t round_trips;   // waits that got their reply
+    uint64_t wait_us;
+} comm_stats_t;
 
 typedef struct pm3_device {
-    communication_arg_t *g_conn;
+    communication_arg_t *conn;
     int script_embedded;
+    comm_ctx_t *ctx;
 } pm3_device_t;
 
 
+typedef void (*async_callback_t)(const PacketResponseNG *response, void *ctx);
+
+// consumer of WaitForRawDataStream, return false to stop the transfer
+typedef bool (*raw_stream_cb_t)(const uint8_t *data, size_t len, void *ctx);
+
+// several NG commands sent in one CMD_BATCH frame, see BatchInit / BatchAdd / BatchRun
+typedef struct {
+    uint8_t data[PM3_CMD_DATA_SIZE];
+    uint16_t len;
+    uint8_t count;
+} cmd_batch_t;
+
 void *uart_reconnect(void *targ);
 
 void *uart_receiver(void *targ);
 void SendCommandBL(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, void *data, size_t len);
 void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len);
 void SendCommandNG(uint16_t cmd, uint8_t *data, size_t len);
+size_t GetJumboPayloadSize(void);
 void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len);
 void clearCommandBuffer(void);
 
@@ -108,18 +149,35 @@ bool IsCommunicationThreadDead(void);
 bool SetCommunicationReceiveMode(bool isRawMode);
 void SetCommunicationRawReceiveBuffer(uint8_t *buffer, size_t len);
 size_t GetCommunicationRawReceiveNum(void);
+void GetCommunicationLatency(comm_latency_t *latency);
+void ResetCommunicationLatency(void);
+void GetCommunicationStats(comm_stats_t *stats);
 
 bool OpenProxmarkSilent(pm3_device_t **dev, const char *port, uint32_t speed);
 bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int timeout, bool flash_mode, uint32_t speed);
 int TestProxmark(pm3_device_t *dev);
 void CloseProxmark(pm3_device_t *dev);
+void FreeProxmark(pm3_device_t *dev);
+void SelectProxmark(pm3_device_t *dev);
 void StartReconnectProxmark(void);
 
 size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, bool show_process);
+bool StartRawDataStream(uint8_t **buffers, uint8_t count, size_t buf_size, size_t len);
+size_t WaitForRawDataStream(size_t ms_timeout, bool wait_first, bool show_process, raw_stream_cb_t cb, void *ctx);
 bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool WaitForResponseTimeout(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout);
 bool WaitForResponse(uint32_t cmd, PacketResponseNG *response);
 
+uint32_t SendCommandNGAsync(uint16_t cmd, uint8_t *data, size_t len, uint16_t reply_cmd, async_callback_t cb, void *ctx);
+void ProcessAsyncReplies(void);
+int PollAsyncReply(uint32_t ticket, PacketResponseNG *response);
+int WaitForAsyncReply(uint32_t ticket, PacketResponseNG *response, size_t ms_timeout);
+void CancelAsyncReply(uint32_t ticket);
+
+void BatchInit(cmd_batch_t *batch, uint8_t flags);
+int BatchAdd(cmd_batch_t *batch, uint16_t cmd, const void *data, uint16_t len);
+int BatchRun(cmd_batch_t *batch, PacketResponseNG *replies, uint8_t max_replies, uint8_t *executed, size_t ms_timeout);
+
 //bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 
@@ -286,20 +286,15 @@ cleanup:
 }
 
 static char *asn1_oid_description(const char *oid, bool with_group_desc) {
-    json_error_t error;
     json_t *root = NULL;
     static char res[300];
     memset(res, 0x00, sizeof(res));
 
-    char *path;
-    if (searchFile(&path, RESOURCES_SUBDIR, "oids", ".json", false) != PM3_SUCCESS) {
+    // `oids.json`, parsed once and cached
+    if (loadResourceJSON("oids", false, &root, NULL) != PM3_SUCCESS) {
         return NULL;
     }
 
-    // load `oids.json`
-    root = json_load_file(path, 0, &error);
-    free(path);
-
     if (!root || !json_is_object(root)) {
         goto error;
     }
@@ -18,6 +18,7 @@
 
 #include "cmdemv.h"
 #include <string.h>
+#include <ctype.h>
 #include "comms.h"          // DropField
 #include "cmdsmartcard.h"   // smart_select
 #include "cmdtrace.h"
@@ -38,6 +39,9 @@
 #include <mbedtls/des.h>    // DES
 #include "crypto/libpcrypto.h"
 #include "iso4217.h"        // currency lookup
+#include "util_posix.h"     // msleep
+#include "x509_crt.h"
+#include "pk.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -2067,74 +2071,9 @@ static int CmdEMVExec(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-static int CmdEMVScan(const char *Cmd) {
-    CLIParserContext *ctx;
-    CLIParserInit(&ctx, "emv scan",
-                  "Scan EMV card and save it contents to a file.\n"
-                  "It executes EMV contactless transaction and saves result to a file which can be used for emulation\n",
-                  "emv scan -at -> scan MSD transaction mode and show APDU and TLV\n"
-                  "emv scan -c -> scan CDA transaction mode\n"
-                 );
-
-    void *argtable[] = {
-        arg_param_begin,
-        arg_lit0("a",  "apdu",     "Show APDU requests and responses"),
-        arg_lit0("t",  "tlv",      "TLV decode results"),
-        arg_lit0("e",  "extract",  "Extract TLV elements and fill Application Data"),
-        arg_lit0("j",  "jload",    "Load transaction parameters from `emv_defparams.json` file"),
-        arg_rem("By default:",     "Transaction type - MSD"),
-        arg_lit0(NULL,  "qvsdc",   "Transaction type - qVSDC or M/Chip"),
-        arg_lit0("c",  "qvsdccda", "Transaction type - qVSDC or M/Chip plus CDA (SDAD generation)"),
-        arg_lit0("x",  "vsdc",     "Transaction type - VSDC. For test only. Not a standard behavior"),
-        arg_lit0("g",  "acgpo",    "VISA. generate AC from GPO"),
-        arg_lit0("m",  "merge",    "Merge output file with card's data. (warning: the file may be corrupted!)"),
-        arg_lit0("w",  "wired",    "Send data via contact (iso7816) interface. (def: Contactless interface)"),
-        arg_str1(NULL,  NULL,      "<fn>", "JSON output file name"),
-        arg_param_end
-    };
-    CLIExecWithReturn(ctx, Cmd, argtable, true);
-
-    bool show_apdu = arg_get_lit(ctx, 1);
-    bool decodeTLV = arg_get_lit(ctx, 2);
-    bool extractTLVElements = arg_get_lit(ctx, 3);
-    bool paramLoadJSON = arg_get_lit(ctx, 4);
-
-    enum TransactionType TrType = TT_MSD;
-    if (arg_get_lit(ctx, 6)) {
-        TrType = TT_QVSDCMCHIP;
-    }
-    if (arg_get_lit(ctx, 7)) {
-        TrType = TT_CDA;
-    }
-    if (arg_get_lit(ctx, 8)) {
-        TrType = TT_VSDC;
-    }
-
-    bool GenACGPO = arg_get_lit(ctx, 9);
-    bool MergeJSON = arg_get_lit(ctx, 10);
-
-    Iso7816CommandChannel channel = CC_CONTACTLESS;
-    if (arg_get_lit(ctx, 11)) {
-        channel = CC_CONTACT;
-    }
-
-    PrintChannel(channel);
-
+static int EMVScanCard(Iso7816CommandChannel channel, bool show_apdu, bool decodeTLV, bool extractTLVElements,
+                       bool paramLoadJSON, enum TransactionType TrType, bool GenACGPO, json_t *root) {
     uint8_t psenum = (channel == CC_CONTACT) ? 1 : 2;
-
-    uint8_t filename[FILE_PATH_SIZE] = {0};
-    int filenamelen = sizeof(filename) - 1; // CLIGetStrWithReturn does not guarantee string to be null-terminated
-    CLIGetStrWithReturn(ctx, 12, filename, &filenamelen);
-
-    CLIParserFree(ctx);
-
-    if (IfPm3Smartcard() == false) {
-        if (channel == CC_CONTACT) {
-            PrintAndLogEx(WARNING, "PM3 does not have SMARTCARD support, exiting");
-            return PM3_EDEVNOTSUPP;
-        }
-    }
-
     uint8_t AID[APDU_AID_LEN] = {0};
     size_t AIDlen = 0;
     uint8_t buf[APDU_RES_LEN] = {0};
@@ -2144,26 +2083,6 @@ static int CmdEMVScan(const char *Cmd) {
     uint16_t sw = 0;
     int res;
 
-    json_t *root;
-    json_error_t error;
-
-    // current path + file name
-    if (MergeJSON) {
-
-        root = json_load_file((char *)filename, 0, &error);
-        if (!root) {
-            PrintAndLogEx(ERR, "Json error on line %d: %s", error.line, error.text);
-            return PM3_EFILE;
-        }
-
-        if (!json_is_object(root)) {
-            PrintAndLogEx(ERR, "Invalid json format. root must be an object");
-            return PM3_EFILE;
-        }
-    } else {
-        root = json_object();
-    }
-
     SetAPDULogging(show_apdu);
 
     // drop field at start
@@ -2177,6 +2096,7 @@ static int CmdEMVScan(const char *Cmd) {
 
         iso14a_card_select_t card;
         if (Hf14443_4aGetCardData(&card) != PM3_SUCCESS) {
+            DropFieldEx(channel);
             return PM3_ERFTRANS;
         }
 
@@ -2446,28 +2366,184 @@ static int CmdEMVScan(const char *Cmd) {
 
     DropFieldEx(channel);
     SetAPDULogging(false);
+    return PM3_SUCCESS;
+}
+
+static int EMVScanSave(json_t *root, const char *filename, bool MergeJSON) {
+    char *fname = (char *)filename;
 
     if (MergeJSON == false) {
         // create unique new name
-        char *fname = newfilenamemcopy((char *)filename, ".json");
+        fname = newfilenamemcopy(filename, ".json");
         if (fname == NULL) {
             return PM3_EMALLOC;
         }
-        strcpy((char *)filename, fname);
-        free(fname);
     }
 
-    res = json_dump_file(root, (char *)filename, JSON_INDENT(2));
+    int res = json_dump_file(root, fname, JSON_INDENT(2));
     if (res) {
-        PrintAndLogEx(ERR, "Can't save the file: %s", filename);
-        return PM3_EFILE;
+        PrintAndLogEx(ERR, "Can't save the file: %s", fname);
+        res = PM3_EFILE;
+    } else {
+        PrintAndLogEx(SUCCESS, "File " _YELLOW_("`%s`") " saved.", fname);
+        res = PM3_SUCCESS;
     }
 
-    PrintAndLogEx(SUCCESS, "File " _YELLOW_("`%s`") " saved.", filename);
+    if (fname != filename) {
+        free(fname);
+    }
+    return res;
+}
 
-    // free json object
-    json_decref(root);
-    return PM3_SUCCESS;
+static int CmdEMVScan(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "emv scan",
+                  "Scan EMV card and save it contents to a file.\n"
+                  "It executes EMV contactless transaction and saves result to a file which can be used for emulation\n",
+                  "emv scan -at -> scan MSD transaction mode and show APDU and TLV\n"
+                  "emv scan -c -> scan CDA transaction mode\n"
+                  "emv scan -c -@ card -> scan CDA transaction mode of every card presented, saved to card.json, card-1.json, ...\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("a",  "apdu",     "Show APDU requests and responses"),
+        arg_lit0("t",  "tlv",      "TLV decode results"),
+        arg_lit0("e",  "extract",  "Extract TLV elements and fill Application Data"),
+        arg_lit0("j",  "jload",    "Load transaction parameters from `emv_defparams.json` file"),
+        arg_rem("By default:",     "Transaction type - MSD"),
+        arg_lit0(NULL,  "qvsdc",   "Transaction type - qVSDC or M/Chip"),
+        arg_lit0("c",  "qvsdccda", "Transaction type - qVSDC or M/Chip plus CDA (SDAD generation)"),
+        arg_lit0("x",  "vsdc",     "Transaction type - VSDC. For test only. Not a standard behavior"),
+        arg_lit0("g",  "acgpo",    "VISA. generate AC from GPO"),
+        arg_lit0("m",  "merge",    "Merge output file with card's data. (warning: the file may be corrupted!)"),
+        arg_lit0("w",  "wired",    "Send data via contact (iso7816) interface. (def: Contactless interface)"),
+        arg_lit0("@",  NULL,       "continuous mode. Scan every card put on the reader, one JSON file each"),
+        arg_str1(NULL,  NULL,      "<fn>", "JSON output file name"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    bool show_apdu = arg_get_lit(ctx, 1);
+    bool decodeTLV = arg_get_lit(ctx, 2);
+    bool extractTLVElements = arg_get_lit(ctx, 3);
+    bool paramLoadJSON = arg_get_lit(ctx, 4);
+
+    enum TransactionType TrType = TT_MSD;
+    if (arg_get_lit(ctx, 6)) {
+        TrType = TT_QVSDCMCHIP;
+    }
+    if (arg_get_lit(ctx, 7)) {
+        TrType = TT_CDA;
+    }
+    if (arg_get_lit(ctx, 8)) {
+        TrType = TT_VSDC;
+    }
+
+    bool GenACGPO = arg_get_lit(ctx, 9);
+    bool MergeJSON = arg_get_lit(ctx, 10);
+
+    Iso7816CommandChannel channel = CC_CONTACTLESS;
+    if (arg_get_lit(ctx, 11)) {
+        channel = CC_CONTACT;
+    }
+
+    bool continuous = arg_get_lit(ctx, 12);
+
+    PrintChannel(channel);
+
+    uint8_t filename[FILE_PATH_SIZE] = {0};
+    int filenamelen = sizeof(filename) - 1; // CLIGetStrWithReturn does not guarantee string to be null-terminated
+    CLIGetStrWithReturn(ctx, 13, filename, &filenamelen);
+
+    CLIParserFree(ctx);
+
+    if (IfPm3Smartcard() == false) {
+        if (channel == CC_CONTACT) {
+            PrintAndLogEx(WARNING, "PM3 does not have SMARTCARD support, exiting");
+            return PM3_EDEVNOTSUPP;
+        }
+    }
+
+    if (continuous) {
+        if (channel == CC_CONTACT) {
+            PrintAndLogEx(ERR, "Continuous mode is for the contactless interface only");
+            return PM3_EINVARG;
+        }
+        if (MergeJSON) {
+            PrintAndLogEx(ERR, "Continuous mode can't merge into one file");
+            return PM3_EINVARG;
+        }
+        PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
+    }
+
+    int res = PM3_SUCCESS;
+    uint32_t cards = 0;
+
+    do {
+        if (continuous) {
+            // wait for the next card, quietly
+            iso14a_card_select_t card;
+            if (SelectCard14443A_4(true, false, &card) != PM3_SUCCESS) {
+                msleep(100);
+                continue;
+            }
+        }
+
+        json_t *root;
+        json_error_t error;
+
+        // current path + file name
+        if (MergeJSON) {
+
+            root = json_load_file((char *)filename, 0, &error);
+            if (!root) {
+                PrintAndLogEx(ERR, "Json error on line %d: %s", error.line, error.text);
+                return PM3_EFILE;
+            }
+
+            if (!json_is_object(root)) {
+                PrintAndLogEx(ERR, "Invalid json format. root must be an object");
+                json_decref(root);
+                return PM3_EFILE;
+            }
+        } else {
+            root = json_object();
+        }
+
+        res = EMVScanCard(channel, show_apdu, decodeTLV, extractTLVElements, paramLoadJSON, TrType, GenACGPO, root);
+        if (res == PM3_SUCCESS) {
+            res = EMVScanSave(root, (char *)filename, MergeJSON);
+        }
+
+        // free json object
+        json_decref(root);
+
+        if (continuous == false) {
+            break;
+        }
+
+        if (res == PM3_SUCCESS) {
+            cards++;
+            PrintAndLogEx(SUCCESS, "Cards scanned: " _GREEN_("%u") ", remove the card", cards);
+        } else {
+            PrintAndLogEx(WARNING, "Card scan failed (%d), remove the card", res);
+        }
+
+        // one scan per presented card
+        iso14a_card_select_t card;
+        while (SelectCard14443A_4(true, false, &card) == PM3_SUCCESS) {
+            if (kbd_enter_pressed()) {
+                continuous = false;
+                break;
+            }
+            msleep(100);
+        }
+        DropField();
+
+    } while (continuous && kbd_enter_pressed() == false);
+
+    return res;
 }
 
 static int CmdEMVList(const char *Cmd) {
@@ -2497,12 +2573,269 @@ static int CmdEMVTest(const char *Cmd) {
     return ExecuteCryptoTests(true, ignoreTimeTest, runSlowTests);
 }
 
+// RSA moduli read from files for the offline ROCA check
+typedef struct {
+    roca_key_t *keys;
+    char (*names)[128];
+    size_t count;
+    size_t size;
+} roca_keylist_t;
+
+static int RocaAddKey(roca_keylist_t *list, const uint8_t *modulus, size_t len, const char *name) {
+    if (len == 0) {
+        return PM3_SUCCESS;
+    }
+
+    if (list->count == list->size) {
+        size_t size = (list->size) ? list->size * 2 : 64;
+        roca_key_t *keys = realloc(list->keys, size * sizeof(roca_key_t));
+        if (keys == NULL) {
+            return PM3_EMALLOC;
+        }
+        list->keys = keys;
+
+        char (*names)[128] = realloc(list->names, size * sizeof(*names));
+        if (names == NULL) {
+            return PM3_EMALLOC;
+        }
+        list->names = names;
+        list->size = size;
+    }
+
+    uint8_t *m = malloc(len);
+    if (m == NULL) {
+        return PM3_EMALLOC;
+    }
+    memcpy(m, modulus, len);
+
+    list->keys[list->count].modulus = m;
+    list->keys[list->count].len = len;
+    list->keys[list->count].vulnerable = false;
+    snprintf(list->names[list->count], sizeof(list->names[0]), "%s", name);
+    list->count++;
+    return PM3_SUCCESS;
+}
+
+static void RocaFreeKeys(roca_keylist_t *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free((void *)list->keys[i].modulus);
+    }
+    free(list->keys);
+    free(list->names);
+    memset(list, 0, sizeof(*list));
+}
+
+static int RocaAddPk(roca_keylist_t *list, mbedtls_pk_context *pk, const char *name) {
+    if (mbedtls_pk_get_type(pk) != MBEDTLS_PK_RSA) {
+        return PM3_SUCCESS;
+    }
+
+    const mbedtls_rsa_context *rsa = mbedtls_pk_rsa(*pk);
+    uint8_t modulus[1024];
+    size_t len = mbedtls_mpi_size(&rsa->N);
+    if (len > sizeof(modulus) || mbedtls_mpi_write_binary(&rsa->N, modulus, len)) {
+        PrintAndLogEx(WARNING, "%s: RSA modulus too long, skipped", name);
+        return PM3_SUCCESS;
+    }
+    return RocaAddKey(list, modulus, len, name);
+}
+
+// every string value under a key with `Modulus` in its name, i.e. the `emv scan` dumps
+static int RocaLoadJson(roca_keylist_t *list, json_t *elm, const char *fn) {
+    int res = PM3_SUCCESS;
+
+    if (json_is_array(elm)) {
+        size_t i;
+        json_t *value;
+        json_array_foreach(elm, i, value) {
+            res = RocaLoadJson(list, value, fn);
+            if (res != PM3_SUCCESS) {
+                break;
+            }
+        }
+        return res;
+    }
+
+    if (json_is_object(elm) == false) {
+        return PM3_SUCCESS;
+    }
+
+    const char *key;
+    json_t *value;
+    json_object_foreach(elm, key, value) {
+        if (json_is_string(value) && strstr(key, "Modulus")) {
+            uint8_t modulus[1024];
+            int len = hex_to_bytes(json_string_value(value), modulus, sizeof(modulus));
+            if (len <= 0) {
+                PrintAndLogEx(WARNING, "%s: can't decode `%s`, skipped", fn, key);
+                continue;
+            }
+
+            char name[128];
+            snprintf(name, sizeof(name), "%s %s", fn, key);
+            res = RocaAddKey(list, modulus, len, name);
+        } else {
+            res = RocaLoadJson(list, value, fn);
+        }
+
+        if (res != PM3_SUCCESS) {
+            break;
+        }
+    }
+    return res;
+}
+
+// PEM or DER certificates (a PEM file may hold several) or public keys, a JSON dump,
+// or a text file with one hex modulus per line
+static int RocaLoadFile(roca_keylist_t *list, const char *fn) {
+    uint8_t *data = NULL;
+    size_t datalen = 0;
+    int res = loadFile_safeEx(fn, "", (void **)&data, &datalen, false);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Can't read `" _YELLOW_("%s") "`", fn);
+        return res;
+    }
+
+    // PEM parsers want the zero terminator counted in the length
+    uint8_t *buf = realloc(data, datalen + 1);
+    if (buf == NULL) {
+        free(data);
+        return PM3_EMALLOC;
+    }
+    buf[datalen] = 0;
+
+    size_t before = list->count;
+    bool is_pem = (strstr((char *)buf, "-----BEGIN") != NULL);
+    size_t buflen = (is_pem) ? datalen + 1 : datalen;
+
+    size_t skip = 0;
+    while (skip < datalen && isspace(buf[skip])) {
+        skip++;
+    }
+
+    if (skip < datalen && (buf[skip] == '{' || buf[skip] == '[')) {
+        json_error_t error;
+        json_t *root = json_loadb((char *)buf, datalen, 0, &error);
+        if (root == NULL) {
+            PrintAndLogEx(WARNING, "%s: json error on line %d: %s", fn, error.line, error.text);
+            free(buf);
+            return PM3_EFILE;
+        }
+        res = RocaLoadJson(list, root, fn);
+        json_decref(root);
+
+    } else if (is_pem || buf[0] == 0x30) {
+        mbedtls_x509_crt crt;
+        mbedtls_x509_crt_init(&crt);
+
+        if (mbedtls_x509_crt_parse(&crt, buf, buflen) >= 0) {
+            for (mbedtls_x509_crt *c = &crt; c != NULL && c->raw.len; c = c->next) {
+                char subject[96] = {0};
+                mbedtls_x509_dn_gets(subject, sizeof(subject), &c->subject);
+
+                char name[128];
+                snprintf(name, sizeof(name), "%s %s", fn, subject);
+                res = RocaAddPk(list, &c->pk, name);
+                if (res != PM3_SUCCESS) {
+                    break;
+                }
+            }
+        } else {
+            mbedtls_pk_context pk;
+            mbedtls_pk_init(&pk);
+            if (mbedtls_pk_parse_public_key(&pk, buf, buflen) == 0) {
+                res = RocaAddPk(list, &pk, fn);
+            } else {
+                PrintAndLogEx(WARNING, "%s: not a certificate or public key", fn);
+            }
+            mbedtls_pk_free(&pk);
+        }
+        mbedtls_x509_crt_free(&crt);
+
+    } else {
+        int lineno = 0;
+        for (char *line = strtok((char *)buf, "\r\n"); line != NULL; line = strtok(NULL, "\r\n")) {
+            lineno++;
+
+            while (isspace(*line)) {
+                line++;
+            }
+            if (*line == 0 || *line == '#') {
+                continue;
+            }
+
+            uint8_t modulus[1024];
+            int len = hex_to_bytes(line, modulus, sizeof(modulus));
+            if (len <= 0) {
+                PrintAndLogEx(WARNING, "%s:%d: not a hex modulus, skipped", fn, lineno);
+                continue;
+            }
+
+            char name[128];
+            snprintf(name, sizeof(name), "%s:%d", fn, lineno);
+            res = RocaAddKey(list, modulus, len, name);
+            if (res != PM3_SUCCESS) {
+                break;
+            }
+        }
+    }
+
+    free(buf);
+
+    if (res == PM3_SUCCESS && list->count == before) {
+        PrintAndLogEx(WARNING, "%s: no RSA keys found", fn);
+    }
+    return res;
+}
+
+static int RocaCheckFiles(struct arg_str *files) {
+    roca_keylist_t list = {0};
+    int res = PM3_SUCCESS;
+
+    for (int i = 0; i < files->count; i++) {
+        res = RocaLoadFile(&list, files->sval[i]);
+        if (res == PM3_EMALLOC) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            RocaFreeKeys(&list);
+            return res;
+        }
+    }
+
+    if (list.count == 0) {
+        PrintAndLogEx(WARNING, "No keys to check");
+        return PM3_EFILE;
+    }
+
+    uint64_t t1 = msclock();
+    size_t found = emv_rocacheck_keys(list.keys, list.count);
+    t1 = msclock() - t1;
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "Result | Bits | Key");
+    PrintAndLogEx(INFO, "-------+------+-------------------------");
+    for (size_t i = 0; i < list.count; i++) {
+        PrintAndLogEx(list.keys[i].vulnerable ? WARNING : INFO, "%s | %4zu | %s",
+                      list.keys[i].vulnerable ? _RED_(" weak ") : _GREEN_("  ok  "),
+                      list.keys[i].len * 8,
+                      list.names[i]
+                     );
+    }
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx((found) ? WARNING : SUCCESS, "Keys checked " _YELLOW_("%zu") ", with ROCA fingerprint " _YELLOW_("%zu") " ( %" PRIu64 " ms )", list.count, found, t1);
+
+    RocaFreeKeys(&list);
+    return PM3_SUCCESS;
+}
+
 static int CmdEMVRoca(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "emv roca",
-                  "Tries to extract public keys and run the ROCA test against them.\n",
+                  "Tries to extract public keys and run the ROCA test against them.\n"
+                  "Offline it checks the RSA keys in PEM/DER certificates or public keys, `emv scan` JSON dumps\n"
+                  "or text files with one hex modulus per line.\n",
                   "emv roca -w  -> select --CONTACT-- card and run test\n"
                   "emv roca     -> select --CONTACTLESS-- card and run test\n"
+                  "emv roca -f certs.pem -f emv-scan.json -f moduli.txt -> check all keys of the files\n"
                  );
 
     void *argtable[] = {
@@ -2510,6 +2843,7 @@ static int CmdEMVRoca(const char *Cmd) {
         arg_lit0(NULL, "test",   "Perform self tests"),
         arg_lit0("a",  "apdu",     "Show APDU requests and responses"),
         arg_lit0("w",  "wired",    "Send data via contact (iso7816) interface. (def: Contactless interface)"),
+        arg_strn("f",  "file",   "<fn>", 0, 256, "Check the keys in the file instead of a card"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -2519,6 +2853,19 @@ static int CmdEMVRoca(const char *Cmd) {
         return roca_self_test();
     }
 
+    struct arg_str *files = arg_get_str(ctx, 4);
+    if (files->count) {
+        int res = RocaCheckFiles(files);
+        CLIParserFree(ctx);
+        return res;
+    }
+
+    if (IfPm3Iso14443() == false) {
+        PrintAndLogEx(WARNING, "Only offline mode is available");
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
     bool show_apdu = arg_get_lit(ctx, 2);
 
     Iso7816CommandChannel channel = CC_CONTACTLESS;
@@ -2991,7 +3338,7 @@ static command_t CommandTable[] =  {
     {"pse",         CmdEMVPPSE,                     IfPm3Iso14443,   "Execute PPSE. It selects 2PAY.SYS.DDF01 or 1PAY.SYS.DDF01 directory"},
     {"reader",      CmdEMVReader,                   IfPm3Iso14443a,  "Act like an EMV reader"},
     {"readrec",     CmdEMVReadRecord,               IfPm3Iso14443,   "Read files from card"},
-    {"roca",        CmdEMVRoca,                     IfPm3Iso14443,   "Extract public keys and run ROCA test"},
+    {"roca",        CmdEMVRoca,                     AlwaysAvailable, "Extract public keys and run ROCA test"},
     {"scan",        CmdEMVScan,                     IfPm3Iso14443,   "Scan EMV card and save it contents to json file for emulator"},
     {"search",      CmdEMVSearch,                   IfPm3Iso14443,   "Try to select all applets from applets list and print installed applets"},
     {"select",      CmdEMVSelect,                   IfPm3Iso14443,   "Select applet"},
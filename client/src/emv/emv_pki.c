@@ -30,6 +30,7 @@
 
 #include "crypto.h"
 #include "util.h"
+#include "commonutil.h"  // ARRAYLEN
 #include "ui.h"
 
 static bool strictExecution = true;
@@ -37,6 +38,21 @@ void PKISetStrictExecution(bool se) {
     strictExecution = se;
 }
 
+// hash check result of the last emv_pki_decode_message, it lets a non strict run return the data anyway
+static bool lastMessageVerified = false;
+
+// Issuer public keys recovered before. All cards of an issuer carry the same issuer
+// certificate, a hit saves the RSA operation and the hash of the recovery.
+#define EMV_PKI_ISSUER_CACHE_SIZE 16
+
+typedef struct {
+    unsigned char id[20];   // SHA1 of the CA key, issuer certificate, remainder and exponent
+    struct emv_pk *pk;
+} emv_pki_issuer_cache_t;
+
+static emv_pki_issuer_cache_t issuerCache[EMV_PKI_ISSUER_CACHE_SIZE];
+static size_t issuerCacheNext = 0;
+
 static const unsigned char empty_tlv_value[] = {0};
 static const struct tlv empty_tlv = {.tag = 0x0, .len = 0, .value = empty_tlv_value};
 
@@ -54,6 +70,8 @@ static unsigned char *emv_pki_decode_message(const struct emv_pk *enc_pk,
     size_t data_len;
     va_list vl;
 
+    lastMessageVerified = false;
+
     if (!enc_pk)
         return NULL;
 
@@ -117,7 +135,8 @@ static unsigned char *emv_pki_decode_message(const struct emv_pk *enc_pk,
     uint8_t hash[hash_len];
     memset(hash, 0, hash_len);
     memcpy(hash, crypto_hash_read(ch), hash_len);
-    if (memcmp(data + data_len - 1 - hash_len, hash, hash_len)) {
+    lastMessageVerified = (memcmp(data + data_len - 1 - hash_len, hash, hash_len) == 0);
+    if (lastMessageVerified == false) {
         PrintAndLogEx(WARNING, "ERROR: Calculated wrong hash");
         PrintAndLogEx(WARNING, "decoded:    " _YELLOW_("%s"), sprint_hex(data + data_len - 1 - hash_len, hash_len));
         PrintAndLogEx(WARNING, "calculated: " _YELLOW_("%s"), sprint_hex(hash, hash_len));
@@ -159,6 +178,28 @@ static unsigned char emv_cn_get(const struct tlv *tlv, unsigned pos) {
         return c >> 4;
 }
 
+// the PAN in the certificate must be a prefix (issuer certificate) or all (ICC certificate) of the card's one
+static bool emv_pki_check_pan(unsigned char msgtype, const struct tlv *pan_tlv, const struct tlv *pan2_tlv) {
+    unsigned pan_len = emv_cn_length(pan_tlv);
+    unsigned pan2_len = emv_cn_length(pan2_tlv);
+
+    if (((msgtype == 2) && (pan2_len < 4 || pan2_len > pan_len)) ||
+            ((msgtype == 4) && (pan2_len != pan_len))) {
+        PrintAndLogEx(WARNING, "ERROR: Invalid PAN lengths");
+        return false;
+    }
+
+    for (unsigned i = 0; i < pan2_len; i++) {
+        if (emv_cn_get(pan_tlv, i) != emv_cn_get(pan2_tlv, i)) {
+            PrintAndLogEx(WARNING, "ERROR: PAN data mismatch");
+            PrintAndLogEx(WARNING, "tlv  pan " _YELLOW_("%s"), sprint_hex(pan_tlv->value, pan_tlv->len));
+            PrintAndLogEx(WARNING, "cert pan " _YELLOW_("%s"), sprint_hex(pan2_tlv->value, pan2_tlv->len));
+            return false;
+        }
+    }
+    return true;
+}
+
 static struct emv_pk *emv_pki_decode_key_ex(const struct emv_pk *enc_pk,
                                             unsigned char msgtype,
                                             const struct tlv *pan_tlv,
@@ -214,28 +255,11 @@ static struct emv_pk *emv_pki_decode_key_ex(const struct emv_pk *enc_pk,
         .len = pan_length,
         .value = &data[2],
     };
-    unsigned pan_len = emv_cn_length(pan_tlv);
-    unsigned pan2_len = emv_cn_length(&pan2_tlv);
-
-    if (((msgtype == 2) && (pan2_len < 4 || pan2_len > pan_len)) ||
-            ((msgtype == 4) && (pan2_len != pan_len))) {
-        PrintAndLogEx(WARNING, "ERROR: Invalid PAN lengths");
+    if (emv_pki_check_pan(msgtype, pan_tlv, &pan2_tlv) == false) {
         free(data);
-
         return NULL;
     }
 
-    unsigned i;
-    for (i = 0; i < pan2_len; i++)
-        if (emv_cn_get(pan_tlv, i) != emv_cn_get(&pan2_tlv, i)) {
-            PrintAndLogEx(WARNING, "ERROR: PAN data mismatch");
-            PrintAndLogEx(WARNING, "tlv  pan " _YELLOW_("%s"), sprint_hex(pan_tlv->value, pan_tlv->len));
-            PrintAndLogEx(WARNING, "cert pan " _YELLOW_("%s"), sprint_hex(pan2_tlv.value, pan2_tlv.len));
-            free(data);
-
-            return NULL;
-        }
-
     pk_len = data[9 + pan_length];
     if (pk_len > data_len - 11 - pan_length + rem_tlv->len) {
         PrintAndLogEx(WARNING, "ERROR: Invalid pk length");
@@ -283,14 +307,80 @@ static struct emv_pk *emv_pki_decode_key(const struct emv_pk *enc_pk,
     return emv_pki_decode_key_ex(enc_pk, msgtype, pan_tlv, cert_tlv, exp_tlv, rem_tlv, add_tlv, sdatl_tlv, false);
 }
 
+static struct emv_pk *emv_pki_copy_pk(const struct emv_pk *src) {
+    struct emv_pk *pk = emv_pk_new(src->mlen, src->elen);
+    if (!pk)
+        return NULL;
+
+    unsigned char *modulus = pk->modulus;
+    *pk = *src;
+    pk->modulus = modulus;
+    memcpy(pk->modulus, src->modulus, src->mlen);
+    return pk;
+}
+
+static bool emv_pki_issuer_cache_id(const struct emv_pk *enc_pk, const struct tlv *cert_tlv,
+                                    const struct tlv *exp_tlv, const struct tlv *rem_tlv, unsigned char *id) {
+    if (!enc_pk || !cert_tlv || !exp_tlv)
+        return false;
+
+    struct crypto_hash *ch = crypto_hash_open(HASH_SHA_1);
+    if (!ch)
+        return false;
+
+    crypto_hash_write(ch, enc_pk->rid, sizeof(enc_pk->rid));
+    crypto_hash_write(ch, &enc_pk->index, 1);
+    crypto_hash_write(ch, enc_pk->modulus, enc_pk->mlen);
+    crypto_hash_write(ch, enc_pk->exp, enc_pk->elen);
+    crypto_hash_write(ch, cert_tlv->value, cert_tlv->len);
+    if (rem_tlv)
+        crypto_hash_write(ch, rem_tlv->value, rem_tlv->len);
+    crypto_hash_write(ch, exp_tlv->value, exp_tlv->len);
+
+    memcpy(id, crypto_hash_read(ch), 20);
+    crypto_hash_close(ch);
+    return true;
+}
+
 struct emv_pk *emv_pki_recover_issuer_cert(const struct emv_pk *pk, struct tlvdb *db) {
-    return emv_pki_decode_key(pk, 2,
-                              tlvdb_get(db, 0x5a, NULL),
-                              tlvdb_get(db, 0x90, NULL),
-                              tlvdb_get(db, 0x9f32, NULL),
-                              tlvdb_get(db, 0x92, NULL),
-                              NULL,
-                              NULL);
+    const struct tlv *pan_tlv = tlvdb_get(db, 0x5a, NULL);
+    const struct tlv *cert_tlv = tlvdb_get(db, 0x90, NULL);
+    const struct tlv *exp_tlv = tlvdb_get(db, 0x9f32, NULL);
+    const struct tlv *rem_tlv = tlvdb_get(db, 0x92, NULL);
+
+    unsigned char id[20];
+    bool cacheable = pan_tlv && emv_pki_issuer_cache_id(pk, cert_tlv, exp_tlv, rem_tlv, id);
+
+    if (cacheable) {
+        for (size_t i = 0; i < ARRAYLEN(issuerCache); i++) {
+            if (issuerCache[i].pk == NULL || memcmp(issuerCache[i].id, id, sizeof(id)))
+                continue;
+
+            // the certificate is verified already, only the PAN of this card is left to check
+            struct tlv pan2_tlv = {
+                .tag = 0x5a,
+                .len = 4,
+                .value = issuerCache[i].pk->pan,
+            };
+            if (emv_pki_check_pan(2, pan_tlv, &pan2_tlv) == false)
+                return NULL;
+
+            return emv_pki_copy_pk(issuerCache[i].pk);
+        }
+    }
+
+    struct emv_pk *issuer_pk = emv_pki_decode_key(pk, 2, pan_tlv, cert_tlv, exp_tlv, rem_tlv, NULL, NULL);
+
+    if (issuer_pk && cacheable && lastMessageVerified) {
+        emv_pki_issuer_cache_t *entry = &issuerCache[issuerCacheNext];
+        issuerCacheNext = (issuerCacheNext + 1) % ARRAYLEN(issuerCache);
+
+        emv_pk_free(entry->pk);
+        entry->pk = emv_pki_copy_pk(issuer_pk);
+        memcpy(entry->id, id, sizeof(id));
+    }
+
+    return issuer_pk;
 }
 
 struct emv_pk *emv_pki_recover_icc_cert(const struct emv_pk *pk, struct tlvdb *db, const struct tlv *sda_tlv) {
@@ -53,25 +53,46 @@ static void rocacheck_cleanup(mbedtls_mpi *prints) {
         mbedtls_mpi_free(&prints[i]);
 }
 
-static int bitand_is_zero(mbedtls_mpi *a, mbedtls_mpi *b) {
+// Prints as bitsets, bit r of roca_prints[i] is set when r is in print i. The modulus has the
+// fingerprint when (modulus mod prime i) is in print i for every prime, so a check is
+// a few byte wise modulo operations instead of bignum arithmetic.
+static const uint8_t roca_primes[ROCA_PRINTS_LENGTH] = {
+    11, 13, 17, 19, 37, 53, 61, 71, 73, 79, 97, 103, 107, 109, 127, 151, 157
+};
+static uint8_t roca_prints[ROCA_PRINTS_LENGTH][(157 + 7) / 8];
+static bool roca_prints_ready = false;
+
+static void rocacheck_tables(void) {
+    if (roca_prints_ready)
+        return;
 
-    for (int i = 0; i < mbedtls_mpi_bitlen(a); i++) {
+    mbedtls_mpi prints[ROCA_PRINTS_LENGTH];
+    rocacheck_init(prints);
 
-        if (mbedtls_mpi_get_bit(a, i) && mbedtls_mpi_get_bit(b, i))
-            return 0;
+    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
+        for (int r = 0; r < roca_primes[i]; r++) {
+            if (mbedtls_mpi_get_bit(&prints[i], r))
+                roca_prints[i][r / 8] |= 1 << (r % 8);
+        }
     }
-    return 1;
+
+    rocacheck_cleanup(prints);
+    roca_prints_ready = true;
 }
 
+static bool roca_fingerprint(const unsigned char *buf, size_t buflen) {
 
-static mbedtls_mpi_uint mpi_get_uint(const mbedtls_mpi *X) {
+    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
 
-    if (X->n == 1 && X->s > 0) {
-        return X->p[0];
-    }
+        // modulus mod prime, big endian
+        uint32_t r = 0;
+        for (size_t j = 0; j < buflen; j++)
+            r = ((r << 8) | buf[j]) % roca_primes[i];
 
-    PrintAndLogEx(WARNING, "ZERRRRO!!!\n");
-    return 0;
+        if ((roca_prints[i][r / 8] & (1 << (r % 8))) == 0)
+            return false;
+    }
+    return true;
 }
 
 /*
@@ -86,59 +107,29 @@ static void print_mpi(const char *msg, int radix, const mbedtls_mpi *X) {
 */
 bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose) {
 
-    mbedtls_mpi t_modulus;
-    mbedtls_mpi_init(&t_modulus);
-
-    bool ret = false;
-    mbedtls_mpi prints[ROCA_PRINTS_LENGTH];
-    uint8_t primes[ROCA_PRINTS_LENGTH] = {
-        11, 13, 17, 19, 37, 53, 61, 71, 73, 79, 97, 103, 107, 109, 127, 151, 157
-    };
+    rocacheck_tables();
 
-    rocacheck_init(prints);
-
-    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&t_modulus, buf, buflen));
-
-    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
-
-        mbedtls_mpi t_temp;
-        mbedtls_mpi t_prime;
-        mbedtls_mpi g_one;
-
-        mbedtls_mpi_init(&t_temp);
-        mbedtls_mpi_init(&t_prime);
-        mbedtls_mpi_init(&g_one);
-
-        MBEDTLS_MPI_CHK(mbedtls_mpi_read_string(&g_one, 10, "1"));
-
-        MBEDTLS_MPI_CHK(mbedtls_mpi_add_int(&t_prime, &t_prime, primes[i]));
-
-        MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t_temp, &t_modulus, &t_prime));
-
-        MBEDTLS_MPI_CHK(mbedtls_mpi_shift_l(&g_one, mpi_get_uint(&t_temp)));
-
-        mbedtls_mpi_free(&t_temp);
-        mbedtls_mpi_free(&t_prime);
-
-        if (bitand_is_zero(&g_one, &prints[i])) {
-            if (verbose) {
-                PrintAndLogEx(FAILED, "No fingerprint found.\n");
-            }
-            mbedtls_mpi_free(&g_one);
-            goto cleanup;
-        }
-        mbedtls_mpi_free(&g_one);
+    bool ret = roca_fingerprint(buf, buflen);
+    if (verbose) {
+        if (ret)
+            PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+        else
+            PrintAndLogEx(FAILED, "No fingerprint found.\n");
     }
+    return ret;
+}
 
-    ret = true;
-    if (verbose)
-        PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+size_t emv_rocacheck_keys(roca_key_t *keys, size_t count) {
 
-cleanup:
-    mbedtls_mpi_free(&t_modulus);
+    rocacheck_tables();
 
-    rocacheck_cleanup(prints);
-    return ret;
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) {
+        keys[i].vulnerable = roca_fingerprint(keys[i].modulus, keys[i].len);
+        if (keys[i].vulnerable)
+            found++;
+    }
+    return found;
 }
 
 int roca_self_test(void) {
@@ -26,7 +26,15 @@
 
 #define ROCA_PRINTS_LENGTH 17
 
+typedef struct {
+    const unsigned char *modulus;
+    size_t len;
+    bool vulnerable;
+} roca_key_t;
+
 bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose);
+// checks every key, returns how many of them have the fingerprint
+size_t emv_rocacheck_keys(roca_key_t *keys, size_t count);
 int roca_self_test(void);
 
 #endif
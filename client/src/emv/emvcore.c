@@ -1015,5 +1015,9 @@ int RecoveryCertificates(struct tlvdb *tlvRoot, json_t *root) {
     JsonSaveStr(root, "$.ApplicationData.ICCPublicKeyDec", icc_pk_c);
     JsonSaveBufAsHex(root, "$.ApplicationData.ICCPublicKeyModulus", icc_pk->modulus, icc_pk->mlen);
     free(icc_pk_c);
+
+    emv_pk_free(pk);
+    emv_pk_free(issuer_pk);
+    emv_pk_free(icc_pk);
     return 0;
 }
@@ -39,6 +39,15 @@
 #define TLV_LEN_MASK        0x7F
 #define TLV_LEN_INVALID     (~0)
 
+// tlvdb_parse / tlvdb_parse_multi put all nodes below a top level element in one block
+// with that element, instead of a calloc per node
+#define TLV_ARENA_ALIGN(x)  (((x) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+struct tlvdb_arena {
+    struct tlvdb *nodes;
+    size_t left;
+};
+
 // http://radek.io/2012/11/10/magical-container_of-macro/
 //#define container_of(ptr, type, member) ({
 //  const typeof( ((type *)0)->member ) *__mptr = (ptr);
@@ -110,12 +119,58 @@ bool tlv_parse_tl(const unsigned char **buf, size_t *len, struct tlv *tlv) {
     return true;
 }
 
-static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent);
+// number of elements in buf, nested ones included
+static size_t tlv_count_nodes(const unsigned char *buf, size_t len) {
+    size_t n = 0;
+
+    while (len) {
+        struct tlv tlv;
+        // the parser will fail on it too
+        if (tlv_parse_tl(&buf, &len, &tlv) == false || tlv.len > len)
+            break;
+
+        n++;
+        if (tlv_is_constructed(&tlv) && (tlv.len != 0))
+            n += tlv_count_nodes(buf, tlv.len);
+
+        buf += tlv.len;
+        len -= tlv.len;
+    }
+
+    return n;
+}
+
+// number of nodes below the first element of buf
+static size_t tlv_count_children(const unsigned char *buf, size_t len) {
+    struct tlv tlv;
+
+    if (tlv_parse_tl(&buf, &len, &tlv) == false || tlv.len > len)
+        return 0;
+
+    if (tlv_is_constructed(&tlv) == false)
+        return 0;
+
+    return tlv_count_nodes(buf, tlv.len);
+}
+
+static struct tlvdb *tlvdb_node_alloc(struct tlvdb_arena *arena) {
+    if (arena && arena->left) {
+        struct tlvdb *tlvdb = arena->nodes++;
+        arena->left--;
+        tlvdb->arena = true;
+        return tlvdb;
+    }
+
+    return calloc(1, sizeof(struct tlvdb));
+}
+
+static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent, struct tlvdb_arena *arena);
 
 static bool tlvdb_parse_one(struct tlvdb *tlvdb,
                             struct tlvdb *parent,
                             const unsigned char **tmp,
-                            size_t *left) {
+                            size_t *left,
+                            struct tlvdb_arena *arena) {
     if (tlvdb == NULL) {
         return false;
     }
@@ -139,7 +194,7 @@ static bool tlvdb_parse_one(struct tlvdb *tlvdb,
     *left -= tlvdb->tag.len;
 
     if (tlv_is_constructed(&tlvdb->tag) && (tlvdb->tag.len != 0)) {
-        tlvdb->children = tlvdb_parse_children(tlvdb);
+        tlvdb->children = tlvdb_parse_children(tlvdb, arena);
         if (!tlvdb->children)
             goto err;
     } else {
@@ -152,7 +207,7 @@ err:
     return false;
 }
 
-static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent) {
+static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent, struct tlvdb_arena *arena) {
     if (parent == NULL) {
         return NULL;
     }
@@ -161,7 +216,7 @@ static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent) {
     struct tlvdb *tlvdb, *first = NULL, *prev = NULL;
 
     while (left != 0) {
-        tlvdb = calloc(1, sizeof(*tlvdb));
+        tlvdb = tlvdb_node_alloc(arena);
         if (tlvdb == NULL) {
             goto err;
         }
@@ -171,7 +226,7 @@ static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent) {
             first = tlvdb;
         prev = tlvdb;
 
-        if (!tlvdb_parse_one(tlvdb, parent, &tmp, &left))
+        if (!tlvdb_parse_one(tlvdb, parent, &tmp, &left, arena))
             goto err;
 
         tlvdb->parent = parent;
@@ -193,17 +248,21 @@ struct tlvdb *tlvdb_parse(const unsigned char *buf, size_t len) {
     if (!len || !buf)
         return NULL;
 
-    root = calloc(1, sizeof(*root) + len);
+    size_t nodes_offset = TLV_ARENA_ALIGN(offsetof(struct tlvdb_root, buf) + len);
+    struct tlvdb_arena arena = { .left = tlv_count_children(buf, len) };
+
+    root = calloc(1, nodes_offset + (arena.left * sizeof(struct tlvdb)));
     if (root == NULL) {
         return NULL;
     }
     root->len = len;
     memcpy(root->buf, buf, len);
+    arena.nodes = (struct tlvdb *)((uint8_t *)root + nodes_offset);
 
     tmp = root->buf;
     left = len;
 
-    if (!tlvdb_parse_one(&root->db, NULL, &tmp, &left))
+    if (!tlvdb_parse_one(&root->db, NULL, &tmp, &left, &arena))
         goto err;
 
     if (left)
@@ -225,28 +284,37 @@ struct tlvdb *tlvdb_parse_multi(const unsigned char *buf, size_t len) {
         return NULL;
     }
 
-    root = calloc(1, sizeof(*root) + len);
+    size_t nodes_offset = TLV_ARENA_ALIGN(offsetof(struct tlvdb_root, buf) + len);
+    struct tlvdb_arena arena = { .left = tlv_count_children(buf, len) };
+
+    root = calloc(1, nodes_offset + (arena.left * sizeof(struct tlvdb)));
     if (root == NULL) {
         return NULL;
     }
 
     root->len = len;
     memcpy(root->buf, buf, len);
+    arena.nodes = (struct tlvdb *)((uint8_t *)root + nodes_offset);
 
     tmp = root->buf;
     left = len;
 
-    if (tlvdb_parse_one(&root->db, NULL, &tmp, &left) == false) {
+    if (tlvdb_parse_one(&root->db, NULL, &tmp, &left, &arena) == false) {
         goto err;
     }
 
     while (left != 0) {
-        struct tlvdb *db = calloc(1, sizeof(*db));
+        // every further top level element owns the nodes below it, so it can be replaced on its own
+        arena.left = tlv_count_children(tmp, left);
+
+        struct tlvdb *db = calloc(1, sizeof(*db) * (1 + arena.left));
         if (db == NULL) {
             goto err;
         }
+        arena.nodes = db + 1;
 
-        if (tlvdb_parse_one(db, NULL, &tmp, &left) == false) {
+        if (tlvdb_parse_one(db, NULL, &tmp, &left, &arena) == false) {
+            tlvdb_free(db->children);
             free(db);
             goto err;
         }
@@ -271,7 +339,7 @@ bool tlvdb_parse_root(struct tlvdb_root *root) {
 
     tmp = root->buf;
     left = root->len;
-    if (tlvdb_parse_one(&root->db, NULL, &tmp, &left) == true) {
+    if (tlvdb_parse_one(&root->db, NULL, &tmp, &left, NULL) == true) {
         if (left == 0) {
             return true;
         }
@@ -289,13 +357,13 @@ bool tlvdb_parse_root_multi(struct tlvdb_root *root) {
 
     tmp = root->buf;
     left = root->len;
-    if (tlvdb_parse_one(&root->db, NULL, &tmp, &left) == true) {
+    if (tlvdb_parse_one(&root->db, NULL, &tmp, &left, NULL) == true) {
         while (left > 0) {
             struct tlvdb *db = calloc(1, sizeof(*db));
             if (db == NULL) {
                 return false;
             }
-            if (tlvdb_parse_one(db, NULL, &tmp, &left) == true) {
+            if (tlvdb_parse_one(db, NULL, &tmp, &left, NULL) == true) {
                 tlvdb_add(&root->db, db);
             } else {
                 free(db);
@@ -350,7 +418,9 @@ void tlvdb_free(struct tlvdb *tlvdb) {
     for (; tlvdb; tlvdb = next) {
         next = tlvdb->next;
         tlvdb_free(tlvdb->children);
-        free(tlvdb);
+        if (tlvdb->arena == false) {
+            free(tlvdb);
+        }
     }
 }
 
@@ -37,6 +37,7 @@ struct tlvdb {
     struct tlvdb *next;
     struct tlvdb *parent;
     struct tlvdb *children;
+    bool arena;     // allocated in one block with its top level element, freed with it
 };
 
 struct tlvdb_root {
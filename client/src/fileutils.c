@@ -33,6 +33,9 @@
 #ifdef _WIN32
 #include "scandir.h"
 #include <direct.h>
+#include <io.h>
+#else
+#include <unistd.h>
 #endif
 
 #define PATH_MAX_LENGTH 200
@@ -320,6 +323,43 @@ int saveFileTXT(const char *preferredName, const char *suffix, const void *data,
     return PM3_SUCCESS;
 }
 
+int saveFileEML(const char *preferredName, const uint8_t *data, size_t datalen, size_t blocksize, savePaths_t e_save_path) {
+    if (data == NULL || datalen == 0 || blocksize == 0) {
+        return PM3_EINVARG;
+    }
+
+    char *fileName = newfilenamemcopyEx(preferredName, ".eml", e_save_path);
+    if (fileName == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    FILE *f = fopen(fileName, "w");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fileName);
+        free(fileName);
+        return PM3_EFILE;
+    }
+
+    // one block per line, lowercase hex, a short last block is written as is
+    for (size_t i = 0; i < datalen; i++) {
+        fprintf(f, "%02x", data[i]);
+        if ((i + 1) % blocksize == 0 || i + 1 == datalen) {
+            fputc('\n', f);
+        }
+    }
+
+    bool ok = (ferror(f) == 0);
+    ok = (fclose(f) == 0) && ok;
+    if (ok == false) {
+        PrintAndLogEx(FAILED, "error, can't save the file `" _YELLOW_("%s") "`", fileName);
+        free(fileName);
+        return PM3_EFILE;
+    }
+    PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " bytes to text file `" _YELLOW_("%s") "`", datalen, fileName);
+    free(fileName);
+    return PM3_SUCCESS;
+}
+
 int prepareJSON(json_t *root, JSONFileType ftype, uint8_t *data, size_t datalen, bool verbose, void (*callback)(json_t *)) {
     if (ftype != jsfCustom) {
         if (data == NULL || datalen == 0) {
@@ -799,6 +839,284 @@ int prepareJSON(json_t *root, JSONFileType ftype, uint8_t *data, size_t datalen,
     return PM3_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+// Streaming JSON writer for the block dump formats.
+// Emits the same document prepareJSON() + json_dump_file(JSON_INDENT(2)) would,
+// key by key, without building the jansson tree first.
+//-----------------------------------------------------------------------------
+typedef struct {
+    FILE *f;
+    int depth;
+    bool first;
+} json_writer_t;
+
+static void jw_string(json_writer_t *w, const char *s) {
+    fputc('"', w->f);
+    for (; *s; s++) {
+        switch (*s) {
+            case '"':
+                fputs("\\\"", w->f);
+                break;
+            case '\\':
+                fputs("\\\\", w->f);
+                break;
+            case '\b':
+                fputs("\\b", w->f);
+                break;
+            case '\f':
+                fputs("\\f", w->f);
+                break;
+            case '\n':
+                fputs("\\n", w->f);
+                break;
+            case '\r':
+                fputs("\\r", w->f);
+                break;
+            case '\t':
+                fputs("\\t", w->f);
+                break;
+            default:
+                if ((uint8_t)*s < 0x20) {
+                    fprintf(w->f, "\\u%04X", (uint8_t)*s);
+                } else {
+                    fputc(*s, w->f);
+                }
+                break;
+        }
+    }
+    fputc('"', w->f);
+}
+
+static void jw_key(json_writer_t *w, const char *key) {
+    fprintf(w->f, "%s%*s", (w->first) ? "\n" : ",\n", w->depth * 2, "");
+    w->first = false;
+    jw_string(w, key);
+    fputs(": ", w->f);
+}
+
+static void jw_open(json_writer_t *w, const char *key) {
+    if (key != NULL) {
+        jw_key(w, key);
+    }
+    fputc('{', w->f);
+    w->depth++;
+    w->first = true;
+}
+
+static void jw_close(json_writer_t *w) {
+    w->depth--;
+    if (w->first == false) {
+        fprintf(w->f, "\n%*s", w->depth * 2, "");
+    }
+    fputc('}', w->f);
+    w->first = false;
+}
+
+static void jw_str(json_writer_t *w, const char *key, const char *s) {
+    jw_key(w, key);
+    jw_string(w, s);
+}
+
+static void jw_hex(json_writer_t *w, const char *key, const uint8_t *data, size_t len) {
+    jw_key(w, key);
+    fputc('"', w->f);
+    for (size_t i = 0; i < len; i++) {
+        fprintf(w->f, "%02X", data[i]);
+    }
+    fputc('"', w->f);
+}
+
+static void jw_blocks(json_writer_t *w, const uint8_t *data, size_t blocks, size_t blocksize) {
+    if (blocks == 0) {
+        return;
+    }
+    char key[24];
+    jw_open(w, "blocks");
+    for (size_t i = 0; i < blocks; i++) {
+        snprintf(key, sizeof(key), "%zu", i);
+        jw_hex(w, key, data + (i * blocksize), blocksize);
+    }
+    jw_close(w);
+}
+
+static void jw_mfc_sectorkeys(json_writer_t *w, const uint8_t *dump, size_t blocks) {
+    char key[32];
+    bool open = false;
+    for (size_t i = 0; i < blocks; i++) {
+        if (mfIsSectorTrailer(i) == false) {
+            continue;
+        }
+        if (open == false) {
+            jw_open(w, "SectorKeys");
+            open = true;
+        }
+
+        const uint8_t *trailer = dump + (i * MFBLOCK_SIZE);
+        const uint8_t *adata = trailer + 6;
+
+        snprintf(key, sizeof(key), "%d", mfSectorNum(i));
+        jw_open(w, key);
+        jw_hex(w, "KeyA", trailer, 6);
+        jw_hex(w, "KeyB", trailer + 10, 6);
+        jw_hex(w, "AccessConditions", adata, 4);
+        jw_open(w, "AccessConditionsText");
+        for (int j = 0; j < 4; j++) {
+            snprintf(key, sizeof(key), "block%zu", i - 3 + j);
+            jw_str(w, key, mfGetAccessConditionsDesc(j, adata));
+        }
+        jw_hex(w, "UserData", &adata[3], 1);
+        jw_close(w);
+        jw_close(w);
+    }
+    if (open) {
+        jw_close(w);
+    }
+}
+
+// PM3_ENOTIMPL for the file types left to prepareJSON()
+static int saveFileJSONstream(const char *preferredName, JSONFileType ftype, uint8_t *data, size_t datalen, bool verbose, savePaths_t e_save_path) {
+
+    if (ftype != jsfRaw && ftype != jsfMfc_v2 && ftype != jsfMfc_v3 && ftype != jsfFudan && ftype != jsfHitag &&
+            ftype != jsfIclass && ftype != jsfT55x7 && ftype != jsf14b_v2 && ftype != jsfMfuMemory) {
+        return PM3_ENOTIMPL;
+    }
+
+    if (data == NULL || datalen == 0) {
+        return PM3_EINVARG;
+    }
+
+    char *filename = newfilenamemcopyEx(preferredName, ".json", e_save_path);
+    if (filename == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    json_writer_t w = { .f = fopen(filename, "w") };
+    if (w.f == NULL) {
+        PrintAndLogEx(FAILED, "error, can't save the file `" _YELLOW_("%s") "`", filename);
+        free(filename);
+        return PM3_EFILE;
+    }
+
+    jw_open(&w, NULL);
+    jw_str(&w, "Created", "proxmark3");
+
+    if (ftype == jsfRaw) {
+        jw_str(&w, "FileType", "raw");
+        jw_hex(&w, "raw", data, datalen);
+    } else if (ftype == jsfMfc_v2 || ftype == jsfFudan) {
+        iso14a_mf_extdump_t xdump;
+        memcpy(&xdump, data, sizeof(iso14a_mf_extdump_t));
+
+        jw_str(&w, "FileType", (ftype == jsfFudan) ? "fudan" : "mfc v2");
+        jw_open(&w, "Card");
+        jw_hex(&w, "UID", xdump.card_info.uid, xdump.card_info.uidlen);
+        jw_hex(&w, "ATQA", xdump.card_info.atqa, 2);
+        jw_hex(&w, "SAK", &xdump.card_info.sak, 1);
+        jw_close(&w);
+        if (ftype == jsfFudan) {
+            jw_blocks(&w, xdump.dump, xdump.dumplen / 4, 4);
+        } else {
+            jw_blocks(&w, xdump.dump, xdump.dumplen / MFBLOCK_SIZE, MFBLOCK_SIZE);
+            jw_mfc_sectorkeys(&w, xdump.dump, xdump.dumplen / MFBLOCK_SIZE);
+        }
+    } else if (ftype == jsfMfc_v3) {
+        iso14a_mf_dump_ev1_t xdump;
+        memcpy(&xdump, data, sizeof(iso14a_mf_dump_ev1_t));
+
+        jw_str(&w, "FileType", "mfc v3");
+        jw_open(&w, "Card");
+        jw_hex(&w, "UID", xdump.card.ev1.uid, xdump.card.ev1.uidlen);
+        jw_hex(&w, "ATQA", xdump.card.ev1.atqa, 2);
+        jw_hex(&w, "SAK", &xdump.card.ev1.sak, 1);
+        jw_hex(&w, "ATS", xdump.card.ev1.ats, sizeof(xdump.card.ev1.ats_len));
+        jw_hex(&w, "SIGNATURE", xdump.card.ev1.signature, sizeof(xdump.card.ev1.signature));
+        jw_close(&w);
+        jw_blocks(&w, xdump.dump, xdump.dumplen / MFBLOCK_SIZE, MFBLOCK_SIZE);
+        jw_mfc_sectorkeys(&w, xdump.dump, xdump.dumplen / MFBLOCK_SIZE);
+    } else if (ftype == jsfHitag) {
+        uint8_t uid[4] = {0};
+        memcpy(uid, data, MIN(datalen, sizeof(uid)));
+        jw_str(&w, "FileType", "hitag");
+        jw_open(&w, "Card");
+        jw_hex(&w, "UID", uid, sizeof(uid));
+        jw_close(&w);
+        jw_blocks(&w, data, datalen / 4, 4);
+    } else if (ftype == jsfIclass) {
+        picopass_hdr_t hdr;
+        memcpy(&hdr, data, sizeof(picopass_hdr_t));
+
+        jw_str(&w, "FileType", "iclass");
+        jw_open(&w, "Card");
+        jw_hex(&w, "CSN", hdr.csn, sizeof(hdr.csn));
+        jw_hex(&w, "Configuration", (uint8_t *)&hdr.conf, sizeof(hdr.conf));
+        if (get_pagemap(&hdr) == PICOPASS_NON_SECURE_PAGEMODE) {
+            picopass_ns_hdr_t ns_hdr;
+            memcpy(&ns_hdr, data, sizeof(picopass_ns_hdr_t));
+            jw_hex(&w, "AIA", ns_hdr.app_issuer_area, sizeof(ns_hdr.app_issuer_area));
+        } else {
+            jw_hex(&w, "Epurse", hdr.epurse, sizeof(hdr.epurse));
+            jw_hex(&w, "Kd", hdr.key_d, sizeof(hdr.key_d));
+            jw_hex(&w, "Kc", hdr.key_c, sizeof(hdr.key_c));
+            jw_hex(&w, "AIA", hdr.app_issuer_area, sizeof(hdr.app_issuer_area));
+        }
+        jw_close(&w);
+        jw_blocks(&w, data, datalen / PICOPASS_BLOCK_SIZE, PICOPASS_BLOCK_SIZE);
+    } else if (ftype == jsfT55x7) {
+        uint8_t conf[4] = {0};
+        memcpy(conf, data, MIN(datalen, sizeof(conf)));
+        jw_str(&w, "FileType", "t55x7");
+        jw_open(&w, "Card");
+        jw_hex(&w, "ConfigBlock", conf, sizeof(conf));
+        jw_close(&w);
+        jw_blocks(&w, data, datalen / 4, 4);
+    } else if (ftype == jsf14b_v2) {
+        jw_str(&w, "FileType", "14b v2");
+        jw_blocks(&w, data, datalen / 4, 4);
+    } else if (ftype == jsfMfuMemory) {
+        mfu_dump_t tmp = {0};
+        datalen = MIN(datalen, sizeof(mfu_dump_t));
+        memcpy(&tmp, data, datalen);
+
+        uint8_t uid[7] = {0};
+        memcpy(uid, tmp.data, 3);
+        memcpy(uid + 3, tmp.data + 4, 4);
+
+        char key[16];
+        jw_str(&w, "FileType", "mfu");
+        jw_open(&w, "Card");
+        jw_hex(&w, "UID", uid, sizeof(uid));
+        jw_hex(&w, "Version", tmp.version, sizeof(tmp.version));
+        jw_hex(&w, "TBO_0", tmp.tbo, sizeof(tmp.tbo));
+        jw_hex(&w, "TBO_1", tmp.tbo1, sizeof(tmp.tbo1));
+        jw_hex(&w, "Signature", tmp.signature, sizeof(tmp.signature));
+        for (uint8_t i = 0; i < 3; i ++) {
+            snprintf(key, sizeof(key), "Counter%d", i);
+            jw_hex(&w, key, tmp.counter_tearing[i], 3);
+            snprintf(key, sizeof(key), "Tearing%d", i);
+            jw_hex(&w, key, tmp.counter_tearing[i] + 3, 1);
+        }
+        jw_close(&w);
+        if (datalen > MFU_DUMP_PREFIX_LENGTH) {
+            jw_blocks(&w, tmp.data, (datalen - MFU_DUMP_PREFIX_LENGTH) / MFU_BLOCK_SIZE, MFU_BLOCK_SIZE);
+        }
+    }
+    jw_close(&w);
+
+    bool ok = (ferror(w.f) == 0);
+    ok = (fclose(w.f) == 0) && ok;
+    if (ok == false) {
+        PrintAndLogEx(FAILED, "error, can't save the file `" _YELLOW_("%s") "`", filename);
+        free(filename);
+        return PM3_EFILE;
+    }
+
+    if (verbose) {
+        PrintAndLogEx(SUCCESS, "Saved to json file " _YELLOW_("%s"), filename);
+    }
+    free(filename);
+    return PM3_SUCCESS;
+}
+
 // dump file (normally,  we also got preference file, etc)
 int saveFileJSON(const char *preferredName, JSONFileType ftype, uint8_t *data, size_t datalen, void (*callback)(json_t *)) {
     return saveFileJSONex(preferredName, ftype, data, datalen, true, callback, spDump);
@@ -808,6 +1126,14 @@ int saveFileJSONex(const char *preferredName, JSONFileType ftype, uint8_t *data,
 
     int retval = PM3_SUCCESS;
 
+    // the block dumps are written as they go, no jansson tree needed
+    if (callback == NULL) {
+        retval = saveFileJSONstream(preferredName, ftype, data, datalen, verbose, e_save_path);
+        if (retval != PM3_ENOTIMPL) {
+            return retval;
+        }
+    }
+
     json_t *root = json_object();
     retval = prepareJSON(root, ftype, data, datalen, verbose, callback);
     if (retval != PM3_SUCCESS) {
@@ -992,6 +1318,106 @@ int createMfcKeyDump(const char *preferredName, uint8_t sectorsCnt, const sector
     return PM3_SUCCESS;
 }
 
+int mfcKeyJournalName(const char *preferredName, char *fileName, size_t fileNameLen) {
+    if (preferredName == NULL || fileName == NULL) {
+        return PM3_EINVARG;
+    }
+
+    // same name on every run, unlike newfilenamemcopyEx, so the next run finds it again
+    size_t save_path_len = path_size(spDump);
+    int res;
+    if (save_path_len && (preferredName[0] != '/') && (preferredName[0] != '\\')) {
+        res = snprintf(fileName, fileNameLen, "%s%s%s.journal", g_session.defaultPaths[spDump], PATHSEP, preferredName);
+    } else {
+        res = snprintf(fileName, fileNameLen, "%s.journal", preferredName);
+    }
+
+    if (res < 0 || (size_t)res >= fileNameLen) {
+        fileName[0] = '\0';
+        return PM3_EOVFLOW;
+    }
+    return PM3_SUCCESS;
+}
+
+int appendMfcKeyJournal(const char *fileName, uint8_t sector, uint8_t keytype, uint64_t key, char source) {
+    if (fileName == NULL) {
+        return PM3_EINVARG;
+    }
+
+    FILE *f = fopen(fileName, "a+");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "could not append to key journal `" _YELLOW_("%s") "`", fileName);
+        return PM3_EFILE;
+    }
+
+    // one complete line per write. If the last run died in the middle of a line,
+    // end that one first so it doesn't swallow this entry
+    bool torn = false;
+    if (fseek(f, -1, SEEK_END) == 0) {
+        torn = (fgetc(f) != '\n');
+        fseek(f, 0, SEEK_END);
+    }
+
+    char line[40];
+    int len = snprintf(line, sizeof(line), "%s%u %c %012" PRIX64 " %c\n", torn ? "\n" : "", sector, (keytype == MF_KEY_B) ? 'B' : 'A', key, source);
+    bool ok = (fwrite(line, 1, len, f) == (size_t)len) && (fflush(f) == 0);
+
+    // make it survive a crash or power loss, not just a client exit
+#ifdef _WIN32
+    ok = ok && (_commit(_fileno(f)) == 0);
+#else
+    ok = ok && (fsync(fileno(f)) == 0);
+#endif
+    fclose(f);
+
+    if (ok == false) {
+        PrintAndLogEx(WARNING, "could not write key journal `" _YELLOW_("%s") "`", fileName);
+        return PM3_EFILE;
+    }
+    return PM3_SUCCESS;
+}
+
+int loadMfcKeyJournal(const char *fileName, uint8_t sectorsCnt, sector_t *e_sector, size_t *count) {
+    *count = 0;
+    if (fileName == NULL || e_sector == NULL) {
+        return PM3_EINVARG;
+    }
+
+    FILE *f = fopen(fileName, "r");
+    if (f == NULL) {
+        return PM3_EFILE;
+    }
+
+    char line[64];
+    while (fgets(line, sizeof(line), f)) {
+
+        // interrupted write or garbage, skip the rest of the line
+        if (strchr(line, '\n') == NULL) {
+            int c;
+            while ((c = fgetc(f)) != EOF && c != '\n') {};
+            continue;
+        }
+
+        unsigned int sector = 0;
+        char type = 0, source = 0;
+        char hex[13] = {0};
+        if (sscanf(line, "%u %c %12[0-9A-Fa-f] %c", &sector, &type, hex, &source) != 4 || strlen(hex) != 12) {
+            continue;
+        }
+
+        if (sector >= sectorsCnt || (type != 'A' && type != 'B')) {
+            continue;
+        }
+
+        uint8_t keytype = (type == 'B') ? MF_KEY_B : MF_KEY_A;
+        e_sector[sector].Key[keytype] = strtoull(hex, NULL, 16);
+        e_sector[sector].foundKey[keytype] = source;
+        (*count)++;
+    }
+    fclose(f);
+    return PM3_SUCCESS;
+}
+
 // --------- LOAD FILES
 int loadFile_safe(const char *preferredName, const char *suffix, void **pdata, size_t *datalen) {
     return loadFile_safeEx(preferredName, suffix, pdata, datalen, true);
@@ -1523,6 +1949,367 @@ static int load_file_sanity(char *s, uint32_t datalen, int i, size_t len) {
     return true;
 }
 
+//-----------------------------------------------------------------------------
+// Pull parser for the block dump formats.
+// One pass over the file remembers where FileType and each "blocks" value are,
+// the blocks are then decoded straight into the caller's buffer, the same way
+// the jansson based loader below does. Anything it does not handle is left to it.
+//-----------------------------------------------------------------------------
+typedef struct {
+    const char *p;
+    const char *end;
+} json_pull_t;
+
+typedef struct {
+    const char *ctype;
+    uint8_t blocksize;
+    bool pad;           // a short block still takes a full block in the dump
+    bool fudan;         // block loop bound is the data length, not the block count
+} json_pull_fmt_t;
+
+static const json_pull_fmt_t json_pull_formats[] = {
+    { "mfcard",        MFBLOCK_SIZE,        true,  false },
+    { "mfc v2",        MFBLOCK_SIZE,        true,  false },
+    { "fudan",         4,                   false, true  },
+    { "hitag",         4,                   false, false },
+    { "iclass",        PICOPASS_BLOCK_SIZE, false, false },
+    { "t55x7",         4,                   false, false },
+    { "EM4205/EM4305", 4,                   false, false },
+    { "EM4469/EM4569", 4,                   false, false },
+    { "EM4X50",        4,                   false, false },
+};
+
+static void jp_ws(json_pull_t *jp) {
+    while (jp->p < jp->end && (*jp->p == ' ' || *jp->p == '\t' || *jp->p == '\r' || *jp->p == '\n')) {
+        jp->p++;
+    }
+}
+
+static bool jp_char(json_pull_t *jp, char c) {
+    jp_ws(jp);
+    if (jp->p < jp->end && *jp->p == c) {
+        jp->p++;
+        return true;
+    }
+    return false;
+}
+
+// decodes a string into out (may be NULL to skip it), returns false on a syntax error
+static bool jp_string(json_pull_t *jp, char *out, size_t outlen) {
+    if (jp_char(jp, '"') == false) {
+        return false;
+    }
+
+    size_t n = 0;
+    while (jp->p < jp->end && *jp->p != '"') {
+        char c = *jp->p++;
+        if ((uint8_t)c < 0x20) {
+            return false;
+        }
+        if (c == '\\') {
+            if (jp->p >= jp->end) {
+                return false;
+            }
+            c = *jp->p++;
+            switch (c) {
+                case 'b':
+                    c = '\b';
+                    break;
+                case 'f':
+                    c = '\f';
+                    break;
+                case 'n':
+                    c = '\n';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                case 't':
+                    c = '\t';
+                    break;
+                case 'u': {
+                    if (jp->end - jp->p < 4) {
+                        return false;
+                    }
+                    uint32_t cp = 0;
+                    for (int i = 0; i < 4; i++) {
+                        char h = *jp->p++;
+                        if (isxdigit((uint8_t)h) == false) {
+                            return false;
+                        }
+                        cp = (cp << 4) | (isdigit((uint8_t)h) ? h - '0' : (tolower((uint8_t)h) - 'a' + 10));
+                    }
+                    // only ever compared against ascii
+                    c = (cp < 0x80) ? (char)cp : '?';
+                    break;
+                }
+                case '"':
+                case '\\':
+                case '/':
+                    break;
+                default:
+                    return false;
+            }
+        }
+        if (out != NULL && n + 1 < outlen) {
+            out[n++] = c;
+        }
+    }
+    if (out != NULL && outlen) {
+        out[n] = 0;
+    }
+    return jp_char(jp, '"');
+}
+
+static bool jp_value(json_pull_t *jp, int depth) {
+    jp_ws(jp);
+    if (jp->p >= jp->end || depth > 64) {
+        return false;
+    }
+
+    switch (*jp->p) {
+        case '"':
+            return jp_string(jp, NULL, 0);
+        case '{':
+        case '[': {
+            bool obj = (*jp->p++ == '{');
+            if (jp_char(jp, obj ? '}' : ']')) {
+                return true;
+            }
+            do {
+                if (obj && (jp_string(jp, NULL, 0) == false || jp_char(jp, ':') == false)) {
+                    return false;
+                }
+                if (jp_value(jp, depth + 1) == false) {
+                    return false;
+                }
+            } while (jp_char(jp, ','));
+            return jp_char(jp, obj ? '}' : ']');
+        }
+        default: {
+            // number, true, false, null
+            const char *start = jp->p;
+            while (jp->p < jp->end && (isalnum((uint8_t)*jp->p) || *jp->p == '-' || *jp->p == '+' || *jp->p == '.')) {
+                jp->p++;
+            }
+            return (jp->p > start);
+        }
+    }
+}
+
+static char *jp_readfile(const char *path, size_t *buflen) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *buf = calloc(fsize > 0 ? fsize : 1, sizeof(char));
+    *buflen = (buf && fsize > 0) ? fread(buf, 1, fsize, f) : 0;
+    fclose(f);
+    if (buf == NULL || fsize <= 0 || *buflen != (size_t)fsize) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+// walks the top level object, remembering FileType and where the "blocks" value starts
+static bool jp_scan(json_pull_t *jp, char *ctype, size_t ctypelen, const char **blocks) {
+    bool has_ctype = false;
+
+    if (jp_char(jp, '{') == false) {
+        return false;
+    }
+
+    if (jp_char(jp, '}') == false) {
+        do {
+            char key[32] = {0};
+            if (jp_string(jp, key, sizeof(key)) == false || jp_char(jp, ':') == false) {
+                return false;
+            }
+            jp_ws(jp);
+
+            if (strcmp(key, "FileType") == 0) {
+                // duplicated keys are left to jansson
+                if (has_ctype || jp_string(jp, ctype, ctypelen) == false) {
+                    return false;
+                }
+                has_ctype = true;
+                continue;
+            }
+
+            if (strcmp(key, "blocks") == 0) {
+                if (*blocks) {
+                    return false;
+                }
+                *blocks = jp->p;
+            }
+
+            if (jp_value(jp, 0) == false) {
+                return false;
+            }
+        } while (jp_char(jp, ','));
+
+        if (jp_char(jp, '}') == false) {
+            return false;
+        }
+    }
+
+    jp_ws(jp);
+    return (jp->p == jp->end);
+}
+
+int loadFileJSONtype(const char *preferredName, char *ctype, size_t ctypelen) {
+    if (ctype == NULL || ctypelen == 0) {
+        return PM3_EINVARG;
+    }
+    ctype[0] = 0;
+
+    char *path;
+    if (searchFile(&path, RESOURCES_SUBDIR, preferredName, ".json", true) != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
+
+    size_t buflen = 0;
+    char *buf = jp_readfile(path, &buflen);
+    free(path);
+    if (buf == NULL) {
+        return PM3_EFILE;
+    }
+
+    json_pull_t jp = { .p = buf, .end = buf + buflen };
+    const char *blocks = NULL;
+    int res = jp_scan(&jp, ctype, ctypelen, &blocks) ? PM3_SUCCESS : PM3_ESOFT;
+    free(buf);
+    return res;
+}
+
+// PM3_ENOTIMPL when the file is left to the jansson loader
+static int loadFileJSONpull(const char *path, uint8_t *data, size_t maxdatalen, size_t *datalen, bool verbose) {
+
+    size_t buflen = 0;
+    char *buf = jp_readfile(path, &buflen);
+    if (buf == NULL) {
+        return PM3_ENOTIMPL;
+    }
+
+    json_pull_t jp = { .p = buf, .end = buf + buflen };
+    const char *blocks = NULL;
+    char ctype[100] = {0};
+    int res = PM3_ENOTIMPL;
+
+    if (jp_scan(&jp, ctype, sizeof(ctype), &blocks) == false) {
+        goto out;
+    }
+
+    const json_pull_fmt_t *fmt = NULL;
+    for (size_t i = 0; i < ARRAYLEN(json_pull_formats); i++) {
+        if (strcmp(ctype, json_pull_formats[i].ctype) == 0) {
+            fmt = &json_pull_formats[i];
+        }
+    }
+    if (fmt == NULL) {
+        goto out;
+    }
+
+    if (verbose) {
+        PrintAndLogEx(SUCCESS, "loaded `" _YELLOW_("%s") "`", path);
+    }
+
+    // where the value of each block is, the loop below never gets past maxblocks
+    size_t maxblocks = (maxdatalen / fmt->blocksize) + 2;
+    const char **vals = calloc(maxblocks, sizeof(char *));
+    if (vals == NULL) {
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    jp.p = blocks;
+    if (blocks && jp_char(&jp, '{') && jp_char(&jp, '}') == false) {
+        do {
+            char key[16] = {0};
+            if (jp_string(&jp, key, sizeof(key)) == false || jp_char(&jp, ':') == false) {
+                break;
+            }
+            jp_ws(&jp);
+            const char *val = jp.p;
+            if (jp_value(&jp, 0) == false) {
+                break;
+            }
+
+            // jansson is asked for "$.blocks.%d", only these key spellings match
+            char *endp = NULL;
+            unsigned long i = strtoul(key, &endp, 10);
+            char canonical[16];
+            snprintf(canonical, sizeof(canonical), "%lu", i);
+            if (*endp == 0 && strcmp(canonical, key) == 0 && i < maxblocks) {
+                vals[i] = (*val == '"') ? val : NULL;
+            }
+        } while (jp_char(&jp, ','));
+    }
+
+    uint8_t block[MFBLOCK_SIZE];
+    char hex[1024];
+    size_t sptr = 0;
+    size_t loopmax = (fmt->fudan) ? maxdatalen : (fmt->pad) ? SIZE_MAX : (maxdatalen / fmt->blocksize);
+
+    res = PM3_SUCCESS;
+    for (size_t i = 0; i < loopmax && (fmt->pad == false || sptr < maxdatalen); i++) {
+        if (sptr + fmt->blocksize > maxdatalen) {
+            PrintAndLogEx(ERR, "loadFileJSONex: maxdatalen=%zu (%04zx)   block (i)=%4zu (%04zx)   sptr=%zu (%04zx) -- exceeded maxdatalen", maxdatalen, maxdatalen, i, i, sptr, sptr);
+            res = PM3_EMALLOC;
+            break;
+        }
+
+        // padded blocks go through a zeroed block, the others straight into the dump
+        memset(block, 0, sizeof(block));
+        uint8_t *dst = (fmt->pad) ? block : &data[sptr];
+        int len = 0;
+        if (i < maxblocks && vals[i] != NULL) {
+            jp.p = vals[i];
+            jp_string(&jp, hex, sizeof(hex));
+            // longer than the buffer is too large for any block anyway
+            int pres = (strlen(hex) == sizeof(hex) - 1) ? 2 : param_gethex_to_eol(hex, 0, dst, fmt->blocksize, &len);
+            switch (pres) {
+                case 1:
+                    PrintAndLogEx(ERR, "ERROR load Invalid HEX value.");
+                    len = 0;
+                    break;
+                case 2:
+                    PrintAndLogEx(ERR, "ERROR load Hex value too large.");
+                    len = 0;
+                    break;
+                case 3:
+                    PrintAndLogEx(ERR, "ERROR load Hex value must have even number of digits.");
+                    len = 0;
+                    break;
+            }
+        }
+
+        if (load_file_sanity(ctype, fmt->blocksize, i, len) == false) {
+            break;
+        }
+
+        if (fmt->pad) {
+            memcpy(&data[sptr], block, fmt->blocksize);
+            sptr += fmt->blocksize;
+        } else {
+            sptr += len;
+        }
+    }
+    free(vals);
+    if (res == PM3_SUCCESS) {
+        *datalen = sptr;
+    }
+
+out:
+    free(buf);
+    return res;
+}
+
 int loadFileJSON(const char *preferredName, void *data, size_t maxdatalen, size_t *datalen, void (*callback)(json_t *)) {
     return loadFileJSONex(preferredName, data, maxdatalen, datalen, true, callback);
 }
@@ -1541,6 +2328,15 @@ int loadFileJSONex(const char *preferredName, void *data, size_t maxdatalen, siz
         return PM3_EFILE;
     }
 
+    // the block dumps are decoded straight from the file, no jansson tree needed
+    if (callback == NULL) {
+        res = loadFileJSONpull(path, data, maxdatalen, datalen, verbose);
+        if (res != PM3_ENOTIMPL) {
+            free(path);
+            return res;
+        }
+    }
+
     json_error_t error;
     json_t *root = json_load_file(path, 0, &error);
     if (verbose) {
@@ -2290,6 +3086,61 @@ int loadFileJSONroot(const char *preferredName, void **proot, bool verbose) {
     return retval;
 }
 
+// Parsed resource files, loaded on first use and kept until the client exits
+#define RESOURCE_CACHE_MAX  16
+
+static struct {
+    char *name;
+    char *path;
+    json_t *root;
+} resource_cache[RESOURCE_CACHE_MAX];
+static size_t resource_cache_count = 0;
+
+int loadResourceJSON(const char *name, bool silent, json_t **root, const char **path) {
+    for (size_t i = 0; i < resource_cache_count; i++) {
+        if (strcmp(resource_cache[i].name, name) == 0) {
+            *root = json_incref(resource_cache[i].root);
+            if (path) {
+                *path = resource_cache[i].path;
+            }
+            return PM3_SUCCESS;
+        }
+    }
+
+    char *fn;
+    if (searchFile(&fn, RESOURCES_SUBDIR, name, ".json", silent) != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
+
+    json_error_t error;
+    *root = json_load_file(fn, 0, &error);
+    if (*root == NULL) {
+        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", fn, error.line, error.text);
+        free(fn);
+        return PM3_ESOFT;
+    }
+
+    char *dup = str_dup(name);
+    if (resource_cache_count == RESOURCE_CACHE_MAX || dup == NULL) {
+        // not cached, loaded again next time
+        free(dup);
+        free(fn);
+        if (path) {
+            *path = name;
+        }
+        return PM3_SUCCESS;
+    }
+
+    resource_cache[resource_cache_count].name = dup;
+    resource_cache[resource_cache_count].path = fn;
+    resource_cache[resource_cache_count].root = json_incref(*root);
+    resource_cache_count++;
+    if (path) {
+        *path = fn;
+    }
+    return PM3_SUCCESS;
+}
+
 // iceman:  todo - move all unsafe functions like this from client source.
 int loadFileDICTIONARY(const char *preferredName, void *data, size_t *datalen, uint8_t keylen, uint32_t *keycnt) {
     // t5577 == 4 bytes
@@ -2418,6 +3269,203 @@ int loadFileDICTIONARY_safe(const char *preferredName, void **pdata, uint8_t key
     return loadFileDICTIONARY_safe_ex(preferredName, ".dic", pdata, keylen, keycnt, true);
 }
 
+// Parsed dictionaries are cached in the user directory, one file per source path and key length
+//   header   dict_cache_hdr_t
+//   path     source file path, path_len bytes
+//   keys     keycnt * keylen bytes, in file order without duplicates
+// A cache file is only used while the source file has the same size and mtime.
+#define DICT_CACHE_TEMPLATE "dictionary_%016" PRIx64 "_%u.cache"
+#define DICT_CACHE_MAGIC    "PM3D"
+#define DICT_CACHE_VERSION  1
+
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t keylen;
+    uint16_t path_len;
+    uint32_t keycnt;
+    int64_t mtime;
+    uint64_t size;
+} PACKED dict_cache_hdr_t;
+
+static bool dict_cache_stat(const char *path, int64_t *mtime, uint64_t *size) {
+#ifdef _WIN32
+    struct _stat st;
+    if (_stat(path, &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+#endif
+    *mtime = st.st_mtime;
+    *size = st.st_size;
+    return true;
+}
+
+// no cache in incognito mode
+static char *dict_cache_path(const char *path, uint8_t keylen) {
+    const char *user_path = get_my_user_directory();
+    if (user_path == NULL || g_session.incognito) {
+        return NULL;
+    }
+
+    // FNV-1a of the source path
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (const char *p = path; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 0x100000001B3ULL;
+    }
+
+    char fn[48];
+    snprintf(fn, sizeof(fn), DICT_CACHE_TEMPLATE, h, keylen);
+
+    char *cachepath = NULL;
+    if (searchHomeFilePath(&cachepath, NULL, fn, true) != PM3_SUCCESS) {
+        return NULL;
+    }
+    return cachepath;
+}
+
+static int dict_cache_load(const char *path, uint8_t keylen, void **pdata, uint32_t *keycnt) {
+    int64_t mtime;
+    uint64_t size;
+    if (dict_cache_stat(path, &mtime, &size) == false) {
+        return PM3_EFILE;
+    }
+
+    char *cachepath = dict_cache_path(path, keylen);
+    if (cachepath == NULL) {
+        return PM3_EFILE;
+    }
+    FILE *f = fopen(cachepath, "rb");
+    free(cachepath);
+    if (f == NULL) {
+        return PM3_EFILE;
+    }
+
+    dict_cache_hdr_t hdr;
+    char cached[PATH_MAX_LENGTH * 4];
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, DICT_CACHE_MAGIC, sizeof(hdr.magic)) ||
+            hdr.version != DICT_CACHE_VERSION || hdr.keylen != keylen || hdr.mtime != mtime || hdr.size != size ||
+            hdr.path_len != strlen(path) || hdr.path_len >= sizeof(cached) ||
+            fread(cached, hdr.path_len, 1, f) != 1 || memcmp(cached, path, hdr.path_len)) {
+        fclose(f);
+        return PM3_EFILE;
+    }
+
+    // callers free the keys, so they are read rather than mapped
+    uint8_t *keys = calloc(hdr.keycnt ? hdr.keycnt : 1, keylen);
+    if (keys == NULL) {
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+    if (hdr.keycnt && fread(keys, keylen, hdr.keycnt, f) != hdr.keycnt) {
+        free(keys);
+        fclose(f);
+        return PM3_EFILE;
+    }
+    fclose(f);
+
+    *pdata = keys;
+    *keycnt = hdr.keycnt;
+    return PM3_SUCCESS;
+}
+
+static void dict_cache_save(const char *path, uint8_t keylen, const uint8_t *keys, uint32_t keycnt) {
+    dict_cache_hdr_t hdr = {
+        .version = DICT_CACHE_VERSION,
+        .keylen = keylen,
+        .path_len = strlen(path),
+        .keycnt = keycnt,
+    };
+    memcpy(hdr.magic, DICT_CACHE_MAGIC, sizeof(hdr.magic));
+
+    int64_t mtime;
+    uint64_t size;
+    if (dict_cache_stat(path, &mtime, &size) == false || strlen(path) > UINT16_MAX) {
+        return;
+    }
+    hdr.mtime = mtime;
+    hdr.size = size;
+
+    char *cachepath = dict_cache_path(path, keylen);
+    if (cachepath == NULL) {
+        return;
+    }
+
+    // written next to it and renamed, a reader never sees half a file
+    char tmppath[strlen(cachepath) + 5];
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", cachepath);
+
+    FILE *f = fopen(tmppath, "wb");
+    if (f == NULL) {
+        free(cachepath);
+        return;
+    }
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1) &&
+              (fwrite(path, hdr.path_len, 1, f) == 1) &&
+              (keycnt == 0 || fwrite(keys, keylen, keycnt, f) == keycnt);
+    ok = (fclose(f) == 0) && ok;
+
+    remove(cachepath);
+    if (ok == false || rename(tmppath, cachepath) != 0) {
+        remove(tmppath);
+    }
+    free(cachepath);
+}
+
+uint32_t dictionary_dedup(uint8_t *keys, uint32_t keycnt, uint8_t keylen, uint32_t *hits) {
+    uint32_t size = 16;
+    while (size < keycnt * 2) {
+        size <<= 1;
+    }
+
+    // open addressing set of key numbers + 1
+    uint32_t *set = calloc(size, sizeof(uint32_t));
+    if (set == NULL) {
+        for (uint32_t i = 0; hits && i < keycnt; i++) {
+            hits[i] = 1;
+        }
+        return keycnt;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < keycnt; i++) {
+        const uint8_t *key = keys + ((size_t)i * keylen);
+
+        uint32_t h = 2166136261U;
+        for (uint8_t j = 0; j < keylen; j++) {
+            h = (h ^ key[j]) * 16777619U;
+        }
+
+        bool dup = false;
+        uint32_t slot = h & (size - 1);
+        for (; set[slot]; slot = (slot + 1) & (size - 1)) {
+            if (memcmp(keys + ((size_t)(set[slot] - 1) * keylen), key, keylen) == 0) {
+                dup = true;
+                break;
+            }
+        }
+        if (dup) {
+            if (hits) {
+                hits[set[slot] - 1]++;
+            }
+            continue;
+        }
+
+        if (n != i) {
+            memcpy(keys + ((size_t)n * keylen), key, keylen);
+        }
+        if (hits) {
+            hits[n] = 1;
+        }
+        n++;
+        set[slot] = n;
+    }
+    free(set);
+    return n;
+}
+
 int loadFileDICTIONARY_safe_ex(const char *preferredName, const char *suffix, void **pdata, uint8_t keylen, uint32_t *keycnt, bool verbose) {
 
     int retval = PM3_SUCCESS;
@@ -2437,6 +3485,14 @@ int loadFileDICTIONARY_safe_ex(const char *preferredName, const char *suffix, vo
         keylen = 6;
     }
 
+    if (dict_cache_load(path, keylen, pdata, keycnt) == PM3_SUCCESS) {
+        if (verbose) {
+            PrintAndLogEx(SUCCESS, "Loaded " _GREEN_("%d") " keys from dictionary file `" _YELLOW_("%s") "`", *keycnt, path);
+        }
+        free(path);
+        return PM3_SUCCESS;
+    }
+
     size_t block_size = 1000 * keylen;
 
     // double up since its chars
@@ -2524,6 +3580,9 @@ int loadFileDICTIONARY_safe_ex(const char *preferredName, const char *suffix, vo
     }
     fclose(f);
 
+    *keycnt = dictionary_dedup((uint8_t *)*pdata, *keycnt, keylen >> 1, NULL);
+    dict_cache_save(path, keylen >> 1, (uint8_t *)*pdata, *keycnt);
+
     if (verbose) {
         PrintAndLogEx(SUCCESS, "Loaded " _GREEN_("%d") " keys from dictionary file `" _YELLOW_("%s") "`", *keycnt, path);
     }
@@ -2761,6 +3820,10 @@ int detect_nfc_dump_format(const char *preferredName, nfc_df_e *dump_type, bool
 
 static int convert_plain_mfu_dump(uint8_t **dump, size_t *dumplen, bool verbose) {
 
+    if (*dumplen > sizeof(((mfu_dump_t *)0)->data)) {
+        return PM3_EINVARG;
+    }
+
     mfu_dump_t *mfu = (mfu_dump_t *) calloc(sizeof(mfu_dump_t), sizeof(uint8_t));
     if (mfu == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
@@ -2775,6 +3838,7 @@ static int convert_plain_mfu_dump(uint8_t **dump, size_t *dumplen, bool verbose)
         PrintAndLogEx(SUCCESS, "Plain mfu dump format was converted to " _GREEN_("%d") " blocks", mfu->pages + 1);
     }
 
+    free(*dump);
     *dump = (uint8_t *)mfu;
     *dumplen += MFU_DUMP_PREFIX_LENGTH ;
     return PM3_SUCCESS;
@@ -2909,6 +3973,92 @@ static int filelist(const char *path, const char *ext, uint8_t last, bool tentat
     return PM3_SUCCESS;
 }
 
+bool dump_outname(const char *fn, const char *outdir, char *out, size_t outlen) {
+
+    const char *base = fn;
+    for (const char *p = fn; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            base = p + 1;
+        }
+    }
+
+    const char *dot = strrchr(base, '.');
+    int baselen = (dot && dot != base) ? (int)(dot - base) : (int)strlen(base);
+
+    if (outdir && strlen(outdir)) {
+        size_t dlen = strlen(outdir);
+        bool sep = (outdir[dlen - 1] != '/' && outdir[dlen - 1] != '\\');
+        return (snprintf(out, outlen, "%s%s%.*s", outdir, (sep) ? PATHSEP : "", baselen, base) < (int)outlen);
+    }
+    return (snprintf(out, outlen, "%.*s", (int)(base - fn) + baselen, fn) < (int)outlen);
+}
+
+int listDumpFiles(const char *path, char ***pfiles, size_t *count) {
+    static const char *exts[] = { ".bin", ".eml", ".json", ".mct", ".nfc", ".picopass" };
+
+    *pfiles = NULL;
+    *count = 0;
+
+    struct dirent **namelist;
+    int n = scandir(path, &namelist, NULL, alphasort);
+    if (n == -1) {
+        PrintAndLogEx(WARNING, "can't read directory `" _YELLOW_("%s") "`", path);
+        return PM3_EFILE;
+    }
+
+    char **files = calloc(n ? n : 1, sizeof(char *));
+    size_t plen = strlen(path);
+    bool sep = (plen && path[plen - 1] != '/' && path[plen - 1] != '\\');
+    int res = (files) ? PM3_SUCCESS : PM3_EMALLOC;
+
+    for (int i = 0; i < n; i++) {
+        const char *dname = namelist[i]->d_name;
+        char *lower = (res == PM3_SUCCESS) ? str_dup(dname) : NULL;
+        if (lower == NULL) {
+            res = PM3_EMALLOC;
+            free(namelist[i]);
+            continue;
+        }
+        str_lower(lower);
+
+        bool match = false;
+        for (size_t j = 0; j < ARRAYLEN(exts); j++) {
+            match |= str_endswith(lower, exts[j]);
+        }
+        free(lower);
+
+        if (match) {
+            size_t flen = plen + strlen(dname) + 2;
+            char *fn = calloc(flen, sizeof(char));
+            if (fn == NULL) {
+                res = PM3_EMALLOC;
+            } else {
+                snprintf(fn, flen, "%s%s%s", path, (sep) ? PATHSEP : "", dname);
+                if (is_directory(fn)) {
+                    free(fn);
+                } else {
+                    files[(*count)++] = fn;
+                }
+            }
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        for (size_t i = 0; i < *count; i++) {
+            free(files[i]);
+        }
+        free(files);
+        *count = 0;
+        return res;
+    }
+
+    *pfiles = files;
+    return PM3_SUCCESS;
+}
+
 int searchAndList(const char *pm3dir, const char *ext) {
     // display in same order as searched by searchFile
     // try pm3 dirs in current workdir (dev mode)
@@ -3347,6 +4497,32 @@ int pm3_save_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft) {
     return PM3_SUCCESS;
 }
 
+bool pm3_mf_dump_card_info(const uint8_t *d, size_t n, iso14a_card_select_t *card) {
+
+    memset(card, 0, sizeof(iso14a_card_select_t));
+    if (d == NULL || n < MFBLOCK_SIZE) {
+        return false;
+    }
+
+    // Check for 4 bytes uid: bcc corrected and single size uid bits in ATQA
+    if ((d[0] ^ d[1] ^ d[2] ^ d[3]) == d[4] && (d[6] & 0xC0) == 0) {
+        card->uidlen = 4;
+        memcpy(card->uid, d, card->uidlen);
+        card->sak = d[5];
+        memcpy(card->atqa, &d[6], sizeof(card->atqa));
+        return true;
+    }
+    // Check for 7 bytes UID: double size uid bits in ATQA
+    if ((d[8] & 0xC0) == 0x40) {
+        card->uidlen = 7;
+        memcpy(card->uid, d, card->uidlen);
+        card->sak = d[7];
+        memcpy(card->atqa, &d[8], sizeof(card->atqa));
+        return true;
+    }
+    return false;
+}
+
 int pm3_save_mf_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft) {
 
     if (fn == NULL || d == NULL || n == 0) {
@@ -3356,22 +4532,7 @@ int pm3_save_mf_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft) {
     saveFileEx(fn, ".bin", d, n, spDump);
 
     iso14a_mf_extdump_t jd = {0};
-    jd.card_info.ats_len = 0;
-
-    // Check for 4 bytes uid: bcc corrected and single size uid bits in ATQA
-    if ((d[0] ^ d[1] ^ d[2] ^ d[3]) == d[4] && (d[6] & 0xC0) == 0) {
-        jd.card_info.uidlen = 4;
-        memcpy(jd.card_info.uid, d, jd.card_info.uidlen);
-        jd.card_info.sak = d[5];
-        memcpy(jd.card_info.atqa, &d[6], sizeof(jd.card_info.atqa));
-    }
-    // Check for 7 bytes UID: double size uid bits in ATQA
-    else if ((d[8] & 0xC0) == 0x40) {
-        jd.card_info.uidlen = 7;
-        memcpy(jd.card_info.uid, d, jd.card_info.uidlen);
-        jd.card_info.sak = d[7];
-        memcpy(jd.card_info.atqa, &d[8], sizeof(jd.card_info.atqa));
-    } else {
+    if (pm3_mf_dump_card_info(d, n, &jd.card_info) == false) {
         PrintAndLogEx(WARNING, "Invalid dump. UID/SAK/ATQA not found");
     }
     jd.dump = d;
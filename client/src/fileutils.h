@@ -148,6 +148,19 @@ int saveFileEx(const char *preferredName, const char *suffix, const void *data,
  */
 int saveFileTXT(const char *preferredName, const char *suffix, const void *data, size_t datalen, savePaths_t e_save_path);
 
+/**
+ * @brief Utility function to save data to a emulator file, one block of hex per line.
+ * This method takes a preferred name, but if that file already exists, it tries with another name until it finds something suitable.
+ * E.g. dumpdata-15.eml
+ *
+ * @param preferredName
+ * @param data The binary data to write to the file
+ * @param datalen the length of the data
+ * @param blocksize bytes per line
+ * @return PM3_SUCCESS for ok
+ */
+int saveFileEML(const char *preferredName, const uint8_t *data, size_t datalen, size_t blocksize, savePaths_t e_save_path);
+
 /** STUB
  * @brief Utility function to save JSON data to a file. This method takes a preferred name, but if that
  * file already exists, it tries with another name until it finds something suitable.
@@ -199,6 +212,42 @@ int saveFilePM3(const char *preferredName, int *data, size_t datalen);
  */
 int createMfcKeyDump(const char *preferredName, uint8_t sectorsCnt, const sector_t *e_sector);
 
+/**
+ * @brief Utility function to get the path of the key recovery journal, `<name>.journal` in the dump path.
+ * Unlike the other file names it stays the same between runs.
+ *
+ * @param preferredName
+ * @param fileName buffer for the journal file name
+ * @param fileNameLen size of fileName
+ * @return PM3_SUCCESS if ok
+ */
+int mfcKeyJournalName(const char *preferredName, char *fileName, size_t fileNameLen);
+
+/**
+ * @brief Utility function to append one recovered key to the key recovery journal.
+ * The line is flushed to disk before returning, so it survives a crash.
+ *
+ * @param fileName journal file, see mfcKeyJournalName
+ * @param sector
+ * @param keytype MF_KEY_A or MF_KEY_B
+ * @param key
+ * @param source how the key was found, as in printKeyTable
+ * @return PM3_SUCCESS if ok
+ */
+int appendMfcKeyJournal(const char *fileName, uint8_t sector, uint8_t keytype, uint64_t key, char source);
+
+/**
+ * @brief Utility function to load the keys of a key recovery journal into a sector table.
+ * Later entries overwrite earlier ones, a partially written last line is ignored.
+ *
+ * @param fileName journal file, see mfcKeyJournalName
+ * @param sectorsCnt the used sectors
+ * @param e_sector the sector table to fill
+ * @param count number of keys loaded
+ * @return PM3_SUCCESS if ok, PM3_EFILE if there is no journal
+ */
+int loadMfcKeyJournal(const char *fileName, uint8_t sectorsCnt, sector_t *e_sector, size_t *count);
+
 /**
  * @brief Utility function to load data from a binary file. This method takes a preferred name.
  * E.g. dumpdata-15.bin,  tries to search for it,  and allocated memory.
@@ -273,6 +322,28 @@ int loadFileJSON(const char *preferredName, void *data, size_t maxdatalen, size_
 int loadFileJSONex(const char *preferredName, void *data, size_t maxdatalen, size_t *datalen, bool verbose, void (*callback)(json_t *));
 int loadFileJSONroot(const char *preferredName, void **proot, bool verbose);
 
+/**
+ * @brief  Utility function to get a parsed JSON file from the resources directory.
+ * The file is loaded on first use and kept in memory, later calls only take a reference.
+ *
+ * @param name resource name without the .json suffix, e.g. aidlist
+ * @param silent no message when the file is not found
+ * @param root the parsed JSON, the caller json_decref()s it when done
+ * @param path optional, the file it was loaded from
+ * @return PM3_SUCCESS for ok, PM3_EFILE when it can't be found, PM3_ESOFT when it isn't valid JSON
+*/
+int loadResourceJSON(const char *name, bool silent, json_t **root, const char **path);
+
+/**
+ * @brief  Utility function to read the FileType of a JSON dump without loading it.
+ *
+ * @param preferredName
+ * @param ctype buffer for the FileType string, empty when the file has none
+ * @param ctypelen size of the buffer
+ * @return PM3_SUCCESS for ok, PM3_EFILE when it can't be read, PM3_ESOFT when it isn't valid JSON
+*/
+int loadFileJSONtype(const char *preferredName, char *ctype, size_t ctypelen);
+
 /**
  * @brief  Utility function to load data from a DICTIONARY textfile. This method takes a preferred name.
  * E.g. mfc_default_keys.dic
@@ -329,6 +400,18 @@ int loadFileDICTIONARY_safe(const char *preferredName, void **pdata, uint8_t key
 */
 int loadFileDICTIONARY_safe_ex(const char *preferredName, const char *suffix, void **pdata, uint8_t keylen, uint32_t *keycnt, bool verbose);
 
+/**
+ * @brief  Utility function to drop repeated keys from a key list, in place.
+ * The first occurrence of a key stays where it is, dictionaries are ordered by likelihood.
+ *
+ * @param keys the key list
+ * @param keycnt number of keys in the list
+ * @param keylen the number of bytes of a key
+ * @param hits  may be NULL, else keycnt counters. hits[i] is set to how many times the i:th remaining key was listed
+ * @return the number of keys left
+*/
+uint32_t dictionary_dedup(uint8_t *keys, uint32_t keycnt, uint8_t keylen, uint32_t *hits);
+
 /**
  * @brief  Utility function to load data from a XML textfile. This method takes a preferred name.
  * E.g. dumpdata-15.xml
@@ -356,6 +439,25 @@ mfu_df_e detect_mfu_dump_format(uint8_t **dump, bool verbose);
 int detect_nfc_dump_format(const char *preferredName, nfc_df_e *dump_type, bool verbose);
 
 int searchAndList(const char *pm3dir, const char *ext);
+
+/**
+ * @brief lists the dump files (bin, eml, json, mct, nfc, picopass) in a directory, not recursing into subdirectories
+ * @param path the directory
+ * @param pfiles allocated array of allocated full file names, sorted by name. Caller frees both
+ * @param count the number of files found
+ * @return PM3_SUCCESS if OK
+ */
+int listDumpFiles(const char *path, char ***pfiles, size_t *count);
+
+/**
+ * @brief output name for a converted or changed dump: the input name without its extension, in outdir if one is given
+ * @param fn the input file name
+ * @param outdir output directory, may be NULL or empty
+ * @param out buffer for the output name
+ * @param outlen size of out
+ * @return false when the name doesn't fit
+ */
+bool dump_outname(const char *fn, const char *outdir, char *out, size_t outlen);
 int searchFile(char **foundpath, const char *pm3dir, const char *searchname, const char *suffix, bool silent);
 
 
@@ -409,6 +511,17 @@ int pm3_save_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft);
  */
 int pm3_save_mf_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft);
 
+/**
+ * @brief Utility function to fill in UID / SAK / ATQA of a MIFARE CLASSIC dump from its manufacturer block.
+ * Checks for a 4 byte UID with corrected BCC first, then for a 7 byte UID.
+ *
+ * @param d The dump data
+ * @param n the length of the data
+ * @param card card info to fill in, zeroed when nothing is found
+ * @return true if a UID was found
+ */
+bool pm3_mf_dump_card_info(const uint8_t *d, size_t n, iso14a_card_select_t *card);
+
 /** STUB
  * @brief Utility function to save FM11RF08S recovery data.
  *
@@ -31,6 +31,7 @@
 #include "comms.h"
 #include "commonutil.h"
 #include "fileutils.h"
+#include "crc32.h"
 
 #define FLASH_START            0x100000
 
@@ -41,6 +42,12 @@
 
 #define FLASHER_VERSION        BL_VERSION_1_0_0
 
+// block writes in flight before waiting for the oldest ACK, with bootloaders that take pipelined writes
+#define FLASH_PIPELINE_DEPTH   4
+
+// device state from flash_start_flashing(), tells what the bootloader understands
+static uint32_t gs_bl_state = 0;
+
 static const uint8_t elf_ident[] = {
     0x7f, 'E', 'L', 'F',
     ELFCLASS32,
@@ -527,6 +534,7 @@ int flash_start_flashing(int enable_bl_writes, char *serial_port_name, uint32_t
     if (ret != PM3_SUCCESS) {
         return ret;
     }
+    gs_bl_state = state;
 
     uint32_t chipinfo = 0;
 
@@ -623,16 +631,19 @@ int flash_reboot_bootloader(char *serial_port_name, bool wait_appear) {
     return enter_bootloader(serial_port_name, wait_appear);
 }
 
-static int write_block(uint32_t address, uint8_t *data, uint32_t length) {
+static void send_block(uint32_t address, uint8_t *data, uint32_t length) {
     uint8_t block_buf[BLOCK_SIZE];
     memset(block_buf, 0xFF, BLOCK_SIZE);
     memcpy(block_buf, data, length);
-    PacketResponseNG resp;
 #if defined ICOPYX
     SendCommandBL(CMD_FINISH_WRITE, address, 0xff, 0x1fd, block_buf, length);
 #else
     SendCommandBL(CMD_FINISH_WRITE, address, 0, 0, block_buf, length);
 #endif
+}
+
+static int wait_block_ack(void) {
+    PacketResponseNG resp;
     int ret = wait_for_ack(&resp);
     if (ret && resp.oldarg[0]) {
         uint32_t lock_bits = resp.oldarg[0] >> 16;
@@ -647,6 +658,155 @@ static int write_block(uint32_t address, uint8_t *data, uint32_t length) {
     return ret;
 }
 
+// CRC32 of a block the way it ends up in flash, padded with 0xFF
+static uint32_t block_crc(const uint8_t *data, uint32_t length) {
+    uint8_t block_buf[BLOCK_SIZE];
+    memset(block_buf, 0xFF, BLOCK_SIZE);
+    memcpy(block_buf, data, length);
+    uint32_t crc = 0;
+    crc32_ex(block_buf, BLOCK_SIZE, (uint8_t *)&crc);
+    return crc;
+}
+
+// Ask the bootloader for the CRC32 of each block in flash
+static int get_flash_crcs(uint32_t address, uint32_t blocks, uint32_t *crcs) {
+    SendCommandBL(CMD_FLASH_CRC, address, blocks, 0, NULL, 0);
+
+    uint32_t received = 0;
+    for (;;) {
+        PacketResponseNG resp;
+        WaitForResponse(CMD_UNKNOWN, &resp);
+
+        if (resp.cmd == CMD_ACK) {
+            break;
+        }
+
+        if (resp.cmd != CMD_FLASH_CRC) {
+            PrintAndLogEx(ERR, "Error: Unexpected reply 0x%04x %s (expected FLASH_CRC)",
+                          resp.cmd,
+                          (resp.cmd == CMD_NACK) ? "NACK" : ""
+                         );
+            return PM3_ESOFT;
+        }
+
+        uint32_t first = resp.oldarg[0];
+        uint32_t count = resp.oldarg[1];
+        if (first + count > blocks || count * sizeof(uint32_t) > sizeof(resp.data.asBytes)) {
+            return PM3_ESOFT;
+        }
+        memcpy(crcs + first, resp.data.asBytes, count * sizeof(uint32_t));
+        received += count;
+    }
+    return (received == blocks) ? PM3_SUCCESS : PM3_ESOFT;
+}
+
+// Ask the bootloader for a single CRC32 over a whole flash region
+static int get_flash_region_crc(uint32_t address, uint32_t length, uint32_t *crc) {
+    SendCommandBL(CMD_FLASH_CRC, address, length, FLASH_CRC_FLAG_REGION, NULL, 0);
+
+    PacketResponseNG resp;
+    WaitForResponse(CMD_UNKNOWN, &resp);
+    if (resp.cmd != CMD_FLASH_CRC || resp.oldarg[1] != 1) {
+        PrintAndLogEx(ERR, "Error: Unexpected reply 0x%04x %s (expected FLASH_CRC)",
+                      resp.cmd,
+                      (resp.cmd == CMD_NACK) ? "NACK" : ""
+                     );
+        return PM3_ESOFT;
+    }
+    memcpy(crc, resp.data.asBytes, sizeof(uint32_t));
+
+    WaitForResponse(CMD_UNKNOWN, &resp);
+    return (resp.cmd == CMD_ACK) ? PM3_SUCCESS : PM3_ESOFT;
+}
+
+// Check a segment against flash without reading it back.
+// A region capable bootloader answers with one CRC, the per block CRCs are only fetched
+// when that one differs, to tell which blocks are off.
+static int verify_segment(const flash_seg_t *seg) {
+
+    uint32_t blocks = (seg->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint64_t t1 = msclock();
+
+    if ((gs_bl_state & DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC_REGION) == DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC_REGION) {
+        uint32_t crc = 0, dev_crc = 0;
+        crc32_ex(seg->data, seg->length, (uint8_t *)&crc);
+        if (get_flash_region_crc(seg->start, seg->length, &dev_crc) != PM3_SUCCESS) {
+            return PM3_ESOFT;
+        }
+        if (crc == dev_crc) {
+            t1 = msclock() - t1;
+            PrintAndLogEx(SUCCESS, "   verified " _YELLOW_("%u") " kB in %" PRIu64 " ms ( crc32 " _GREEN_("%08x") " )",
+                          (seg->length + ONE_KB - 1) / ONE_KB, t1, crc);
+            return PM3_SUCCESS;
+        }
+    }
+
+    uint32_t *crcs = calloc(blocks, sizeof(uint32_t));
+    uint32_t *dev_crcs = calloc(blocks, sizeof(uint32_t));
+    if (crcs == NULL || dev_crcs == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(crcs);
+        free(dev_crcs);
+        return PM3_EMALLOC;
+    }
+
+    for (uint32_t b = 0; b < blocks; b++) {
+        crcs[b] = block_crc((uint8_t *)seg->data + b * BLOCK_SIZE, MIN(seg->length - b * BLOCK_SIZE, BLOCK_SIZE));
+    }
+
+    int res = get_flash_crcs(seg->start, blocks, dev_crcs);
+    t1 = msclock() - t1;
+
+    uint32_t bad = 0;
+    for (uint32_t b = 0; res == PM3_SUCCESS && b < blocks; b++) {
+        if (crcs[b] != dev_crcs[b]) {
+            if (bad < 8) {
+                PrintAndLogEx(ERR, "   block " _YELLOW_("%u") " at 0x%08x differs", b, seg->start + b * BLOCK_SIZE);
+            }
+            bad++;
+        }
+    }
+    free(crcs);
+    free(dev_crcs);
+
+    if (res != PM3_SUCCESS || bad) {
+        if (bad) {
+            PrintAndLogEx(ERR, "   " _RED_("%u") " of %u blocks differ", bad, blocks);
+        }
+        PrintAndLogEx(ERR, "   verify " _RED_("failed"));
+        return PM3_EFATAL;
+    }
+
+    PrintAndLogEx(SUCCESS, "   verified " _YELLOW_("%u") " kB in %" PRIu64 " ms ( " _YELLOW_("%.0f") " kB/s )",
+                  (seg->length + ONE_KB - 1) / ONE_KB,
+                  t1,
+                  (t1) ? (double)seg->length / (double)t1 * 1000.0 / ONE_KB : 0.0
+                 );
+    return PM3_SUCCESS;
+}
+
+// Verify a file's segments against flash, using the bootloader CRCs only
+int flash_verify(flash_file_t *ctx) {
+
+    if ((gs_bl_state & DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC) != DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC) {
+        PrintAndLogEx(ERR, "Bootloader can't checksum flash, update it or read flash back with " _YELLOW_("--dumpmem"));
+        return PM3_ENOTIMPL;
+    }
+
+    PrintAndLogEx(SUCCESS, "Verifying segments for file: %s", ctx->filename);
+
+    int ret = PM3_SUCCESS;
+    for (int i = 0; i < ctx->num_segs; i++) {
+        flash_seg_t *seg = &ctx->segments[i];
+        PrintAndLogEx(SUCCESS, " 0x%08x..0x%08x [0x%x / %u blocks]", seg->start, seg->start + seg->length - 1, seg->length, (seg->length + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        int res = verify_segment(seg);
+        if (res != PM3_SUCCESS) {
+            ret = res;
+        }
+    }
+    return ret;
+}
+
 static const char ice[] =
     "...................................................................\n        @@@  @@@@@@@ @@@@@@@@ @@@@@@@@@@   @@@@@@  @@@  @@@\n"
     "        @@! !@@      @@!      @@! @@! @@! @@!  @@@ @@!@!@@@\n        !!@ !@!      @!!!:!   @!! !!@ @!@ @!@!@!@! @!@@!!@!\n"
@@ -687,6 +847,10 @@ int flash_write(flash_file_t *ctx) {
 
     PrintAndLogEx(SUCCESS, "Writing segments for file: %s", ctx->filename);
 
+    // bootloaders that can checksum flash take pipelined writes, and only get the changed blocks
+    bool use_crc = ((gs_bl_state & DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC) == DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC);
+    int depth = (use_crc) ? FLASH_PIPELINE_DEPTH : 1;
+
     int len = 0;
 
     for (int i = 0; i < ctx->num_segs; i++) {
@@ -696,6 +860,22 @@ int flash_write(flash_file_t *ctx) {
         uint32_t blocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
         uint32_t end = seg->start + length;
 
+        // CRC32 of every block as it should end up in flash
+        uint32_t *crcs = calloc(blocks, sizeof(uint32_t));
+        uint32_t *dev_crcs = calloc(blocks, sizeof(uint32_t));
+        if (crcs == NULL || dev_crcs == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            free(crcs);
+            free(dev_crcs);
+            return PM3_EMALLOC;
+        }
+
+        for (uint32_t b = 0; b < blocks; b++) {
+            crcs[b] = block_crc((uint8_t *)seg->data + b * BLOCK_SIZE, MIN(length - b * BLOCK_SIZE, BLOCK_SIZE));
+        }
+
+        bool have_dev_crcs = (use_crc && get_flash_crcs(seg->start, blocks, dev_crcs) == PM3_SUCCESS);
+
         PrintAndLogEx(SUCCESS, " 0x%08x..0x%08x [0x%x / %u blocks]", seg->start, end - 1, length, blocks);
         if (is_loaded) {
             if (blocks < 50) {
@@ -706,7 +886,10 @@ int flash_write(flash_file_t *ctx) {
         }
 
         fflush(stdout);
-        int block = 0;
+        uint32_t block = 0;
+        uint32_t written = 0;
+        int inflight = 0;
+        uint32_t pending[FLASH_PIPELINE_DEPTH] = {0};
         uint8_t *data = seg->data;
         uint32_t baddr = seg->start;
 
@@ -716,9 +899,23 @@ int flash_write(flash_file_t *ctx) {
                 block_size = BLOCK_SIZE;
             }
 
-            if (write_block(baddr, data, block_size) < 0) {
-                PrintAndLogEx(ERR, "Error writing block %d of %u", block, blocks);
-                return PM3_EFATAL;
+            if (have_dev_crcs == false || dev_crcs[block] != crcs[block]) {
+
+                send_block(baddr, data, block_size);
+                pending[written % FLASH_PIPELINE_DEPTH] = block;
+                inflight++;
+                written++;
+
+                // keep the next blocks on the wire while the bootloader programs this one
+                if (inflight >= depth) {
+                    if (wait_block_ack() < 0) {
+                        PrintAndLogEx(ERR, "Error writing block %u of %u", pending[(written - inflight) % FLASH_PIPELINE_DEPTH], blocks);
+                        free(crcs);
+                        free(dev_crcs);
+                        return PM3_EFATAL;
+                    }
+                    inflight--;
+                }
             }
 
             data += block_size;
@@ -768,7 +965,32 @@ int flash_write(flash_file_t *ctx) {
             }
             fflush(stdout);
         }
+
+        // collect the ACKs still in flight
+        while (inflight) {
+            if (wait_block_ack() < 0) {
+                PrintAndLogEx(ERR, "Error writing block %u of %u", pending[(written - inflight) % FLASH_PIPELINE_DEPTH], blocks);
+                free(crcs);
+                free(dev_crcs);
+                return PM3_EFATAL;
+            }
+            inflight--;
+        }
         PrintAndLogEx(NORMAL, " " _GREEN_("ok"));
+
+        if (have_dev_crcs) {
+            PrintAndLogEx(SUCCESS, "   wrote " _YELLOW_("%u") " blocks, " _YELLOW_("%u") " unchanged", written, blocks - written);
+        }
+
+        // read back the checksums of what landed in flash
+        if (use_crc && verify_segment(seg) != PM3_SUCCESS) {
+            free(crcs);
+            free(dev_crcs);
+            return PM3_EFATAL;
+        }
+
+        free(crcs);
+        free(dev_crcs);
         fflush(stdout);
     }
     return PM3_SUCCESS;
@@ -36,6 +36,102 @@ marker_t g_MarkerA, g_MarkerB, g_MarkerC, g_MarkerD;
 marker_t *g_TempMarkers;
 uint8_t g_TempMarkerSize = 0;
 
+// Clock and carrier detection results for the current graph.
+// The graph is written directly from all over the client, so instead of a
+// generation counter bumped by every writer the key is the trace length, a
+// hash of the (trimmed) samples and the lfdemod signal properties the
+// detectors read. Hashing is one pass, the detectors are many.
+#define GA_ASK      0x01
+#define GA_PSK      0x02
+#define GA_NRZ      0x04
+#define GA_FC       0x08
+#define GA_FSK      0x10
+
+typedef struct {
+    size_t len;
+    uint64_t hash;
+    signal_t sp;
+    uint8_t *bits;          // getFromGraphBuffer() copy
+    uint8_t *scratch;       // for detectors that may modify their input
+    size_t size;
+    uint8_t have;           // GA_* results below are valid
+    int ask_clock;
+    int ask_idx;
+    int psk_clock;
+    size_t psk_idx;
+    int nrz_clock;
+    size_t nrz_idx;
+    uint16_t psk_fc;        // countFC(..., false)
+    uint16_t fsk_fc;        // countFC(..., true)
+    uint8_t fsk_rf;
+    int fsk_edge;
+} graph_analysis_t;
+
+static graph_analysis_t g_analysis;
+
+static void graph_analysis_free(void) {
+    free(g_analysis.bits);
+    free(g_analysis.scratch);
+    memset(&g_analysis, 0, sizeof(g_analysis));
+}
+
+// trims the graph like getFromGraphBuffer() does and hashes it
+static uint64_t graph_hash(void) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < g_GraphTraceLen; i++) {
+        if (g_GraphBuffer[i] > 127) {
+            g_GraphBuffer[i] = 127;
+        }
+        if (g_GraphBuffer[i] < -127) {
+            g_GraphBuffer[i] = -127;
+        }
+        h = (h ^ (uint8_t)(g_GraphBuffer[i] + 128)) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// cached analysis of the current graph, NULL if there is nothing to analyse
+static graph_analysis_t *graph_analysis(void) {
+    if (g_GraphTraceLen == 0) {
+        return NULL;
+    }
+
+    uint64_t h = graph_hash();
+    const signal_t *sp = getSignalProperties();
+    bool same = (g_analysis.bits != NULL) && (g_analysis.len == g_GraphTraceLen) && (g_analysis.hash == h) &&
+                (g_analysis.sp.low == sp->low) && (g_analysis.sp.high == sp->high) &&
+                (g_analysis.sp.mean == sp->mean) && (g_analysis.sp.amplitude == sp->amplitude) &&
+                (g_analysis.sp.isnoise == sp->isnoise);
+    if (same) {
+        // detectors print their own debug output, let them run again
+        if (g_debugMode) {
+            g_analysis.have = 0;
+        }
+        return &g_analysis;
+    }
+
+    graph_analysis_free();
+    g_analysis.bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
+    g_analysis.scratch = calloc(g_GraphTraceLen, sizeof(uint8_t));
+    if (g_analysis.bits == NULL || g_analysis.scratch == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        graph_analysis_free();
+        return NULL;
+    }
+
+    g_analysis.size = getFromGraphBuffer(g_analysis.bits);
+    g_analysis.len = g_GraphTraceLen;
+    g_analysis.hash = h;
+    g_analysis.sp = *sp;
+    return &g_analysis;
+}
+
+// copy of the graph samples the caller may modify
+static uint8_t *graph_analysis_scratch(graph_analysis_t *ga) {
+    memcpy(ga->scratch, ga->bits, ga->size);
+    return ga->scratch;
+}
+
 /* write a manchester bit to the graph
 */
 void AppendGraph(bool redraw, uint16_t clock, int bit) {
@@ -87,6 +183,7 @@ size_t ClearGraph(bool redraw) {
     g_useOverlays = false;
 
     remove_temporary_markers();
+    graph_analysis_free();
     g_MarkerA.pos = 0;
     g_MarkerB.pos = 0;
     g_MarkerC.pos = 0;
@@ -250,36 +347,35 @@ int GetAskClock(const char *str, bool verbose) {
     }
 
     // Auto-detect clock
-
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
-    if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        return -1;
-    }
-
-    size_t size = getFromGraphBuffer(bits);
-    if (size == 0) {
+    graph_analysis_t *ga = graph_analysis();
+    if (ga == NULL) {
         PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
         return -1;
     }
 
-    size_t ststart = 0, stend = 0;
-    bool st = DetectST(bits, &size, &clock1, &ststart, &stend);
-    int idx = stend;
-    if (st == false) {
-        idx = DetectASKClock(bits, size, &clock1, 20);
+    if ((ga->have & GA_ASK) == 0) {
+        // DetectST may cut the ST sequence out of its buffer
+        uint8_t *bits = graph_analysis_scratch(ga);
+        size_t size = ga->size;
+        size_t ststart = 0, stend = 0;
+        bool st = DetectST(bits, &size, &clock1, &ststart, &stend);
+        int idx = stend;
+        if (st == false) {
+            idx = DetectASKClock(bits, size, &clock1, 20);
+        }
+        ga->ask_clock = clock1;
+        ga->ask_idx = idx;
+        ga->have |= GA_ASK;
     }
 
+    clock1 = ga->ask_clock;
     if (clock1 > 0) {
-        setClockGrid(clock1, idx);
+        setClockGrid(clock1, ga->ask_idx);
     }
     // Only print this message if we're not looping something
     if (verbose || g_debugMode) {
-        PrintAndLogEx(SUCCESS, "Auto-detected clock rate: %d, Best Starting Position: %d", clock1, idx);
+        PrintAndLogEx(SUCCESS, "Auto-detected clock rate: %d, Best Starting Position: %d", clock1, ga->ask_idx);
     }
-
-    free(bits);
     return clock1;
 }
 
@@ -288,22 +384,18 @@ int GetPskCarrier(bool verbose) {
         return -1;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
-    if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        return -1;
-    }
-
-    size_t size = getFromGraphBuffer(bits);
-    if (size == 0) {
+    graph_analysis_t *ga = graph_analysis();
+    if (ga == NULL) {
         PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
         return -1;
     }
 
-    uint16_t fc = countFC(bits, size, false);
-    free(bits);
+    if ((ga->have & GA_FC) == 0) {
+        ga->psk_fc = countFC(ga->bits, ga->size, false);
+        ga->have |= GA_FC;
+    }
 
+    uint16_t fc = ga->psk_fc;
     uint8_t carrier = fc & 0xFF;
     if (carrier != 2 && carrier != 4 && carrier != 8) {
         return 0;
@@ -332,33 +424,28 @@ int GetPskClock(const char *str, bool verbose) {
     }
 
     // Auto-detect clock
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
-    if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        return -1;
-    }
-
-    size_t size = getFromGraphBuffer(bits);
-    if (size == 0) {
+    graph_analysis_t *ga = graph_analysis();
+    if (ga == NULL) {
         PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
         return -1;
     }
 
-    size_t firstPhaseShiftLoc = 0;
-    uint8_t curPhase = 0, fc = 0;
-    clock1 = DetectPSKClock(bits, size, 0, &firstPhaseShiftLoc, &curPhase, &fc);
+    if ((ga->have & GA_PSK) == 0) {
+        uint8_t curPhase = 0, fc = 0;
+        ga->psk_idx = 0;
+        ga->psk_clock = DetectPSKClock(graph_analysis_scratch(ga), ga->size, 0, &ga->psk_idx, &curPhase, &fc);
+        ga->have |= GA_PSK;
+    }
 
+    clock1 = ga->psk_clock;
     if (clock1 >= 0) {
-        setClockGrid(clock1, firstPhaseShiftLoc);
+        setClockGrid(clock1, ga->psk_idx);
     }
 
     // Only print this message if we're not looping something
     if (verbose) {
         PrintAndLogEx(SUCCESS, "Auto-detected clock rate: %d", clock1);
     }
-
-    free(bits);
     return clock1;
 }
 
@@ -374,28 +461,24 @@ int GetNrzClock(const char *str, bool verbose) {
     }
 
     // Auto-detect clock
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
-    if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
+    graph_analysis_t *ga = graph_analysis();
+    if (ga == NULL) {
+        PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
         return -1;
     }
 
-    size_t size = getFromGraphBuffer(bits);
-    if (size == 0) {
-        PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
-        return -1;
+    if ((ga->have & GA_NRZ) == 0) {
+        ga->nrz_idx = 0;
+        ga->nrz_clock = DetectNRZClock(graph_analysis_scratch(ga), ga->size, 0, &ga->nrz_idx);
+        ga->have |= GA_NRZ;
     }
 
-    size_t clkStartIdx = 0;
-    clock1 = DetectNRZClock(bits, size, 0, &clkStartIdx);
-    setClockGrid(clock1, clkStartIdx);
+    clock1 = ga->nrz_clock;
+    setClockGrid(clock1, ga->nrz_idx);
     // Only print this message if we're not looping something
     if (verbose) {
         PrintAndLogEx(SUCCESS, "Auto-detected clock rate: %d", clock1);
     }
-
-    free(bits);
     return clock1;
 }
 
@@ -435,31 +518,31 @@ bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge) {
         return false;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
-    if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
+    graph_analysis_t *ga = graph_analysis();
+    if (ga == NULL) {
+        PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
         return false;
     }
 
-    size_t size = getFromGraphBuffer(bits);
-    if (size == 0) {
-        PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
-        return false;
+    if ((ga->have & GA_FSK) == 0) {
+        ga->fsk_fc = countFC(ga->bits, ga->size, true);
+        ga->fsk_rf = 0;
+        ga->fsk_edge = 0;
+        if (ga->fsk_fc) {
+            ga->fsk_rf = detectFSKClk(ga->bits, ga->size, (ga->fsk_fc >> 8) & 0xFF, ga->fsk_fc & 0xFF, &ga->fsk_edge);
+        }
+        ga->have |= GA_FSK;
     }
 
-    uint16_t ans = countFC(bits, size, true);
-    if (ans == 0) {
+    if (ga->fsk_fc == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: No data found");
-        free(bits);
         return false;
     }
 
-    *fc1 = (ans >> 8) & 0xFF;
-    *fc2 = ans & 0xFF;
-    *rf1 = detectFSKClk(bits, size, *fc1, *fc2, firstClockEdge);
-
-    free(bits);
+    *fc1 = (ga->fsk_fc >> 8) & 0xFF;
+    *fc2 = ga->fsk_fc & 0xFF;
+    *rf1 = ga->fsk_rf;
+    *firstClockEdge = ga->fsk_edge;
 
     if (*rf1 == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: Clock detect error");
@@ -648,3 +731,283 @@ size_t restore_buffer8(buffer_savestate_t saveState, uint8_t *dest) {
 
     return index;
 }
+
+// Named traces
+//
+// Immutable copies of the graph kept for the session. Traces with identical
+// samples share one block, so keeping the same capture under several names,
+// or saving again after looking at it, costs nothing.
+typedef struct {
+    int32_t *samples;
+    size_t len;
+    uint64_t hash;
+    uint32_t refs;
+} graph_block_t;
+
+typedef struct {
+    char name[GRAPH_TRACE_NAME_LEN];
+    graph_block_t *block;
+} graph_trace_t;
+
+static graph_trace_t *g_traces = NULL;
+static size_t g_traces_cnt = 0;
+
+static uint64_t samples_hash(const int32_t *samples, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint32_t)samples[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static graph_trace_t *graph_trace_find(const char *name) {
+    for (size_t i = 0; i < g_traces_cnt; i++) {
+        if (strncmp(g_traces[i].name, name, sizeof(g_traces[i].name)) == 0) {
+            return &g_traces[i];
+        }
+    }
+    return NULL;
+}
+
+static void graph_block_release(graph_block_t *b) {
+    if (b && --b->refs == 0) {
+        free(b->samples);
+        free(b);
+    }
+}
+
+// a block holding the current graph, shared with another trace if one has the same samples
+static graph_block_t *graph_block_get(void) {
+    uint64_t h = samples_hash(g_GraphBuffer, g_GraphTraceLen);
+    for (size_t i = 0; i < g_traces_cnt; i++) {
+        graph_block_t *b = g_traces[i].block;
+        if (b->len == g_GraphTraceLen && b->hash == h && memcmp(b->samples, g_GraphBuffer, b->len * sizeof(int32_t)) == 0) {
+            b->refs++;
+            return b;
+        }
+    }
+
+    graph_block_t *b = calloc(1, sizeof(graph_block_t));
+    if (b == NULL) {
+        return NULL;
+    }
+    b->samples = calloc(g_GraphTraceLen, sizeof(int32_t));
+    if (b->samples == NULL) {
+        free(b);
+        return NULL;
+    }
+    memcpy(b->samples, g_GraphBuffer, g_GraphTraceLen * sizeof(int32_t));
+    b->len = g_GraphTraceLen;
+    b->hash = h;
+    b->refs = 1;
+    return b;
+}
+
+int graph_trace_save(const char *name) {
+    if (name == NULL || name[0] == '\0' || strlen(name) >= GRAPH_TRACE_NAME_LEN) {
+        return PM3_EINVARG;
+    }
+    if (g_GraphTraceLen == 0) {
+        return PM3_ENODATA;
+    }
+
+    graph_block_t *b = graph_block_get();
+    if (b == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    graph_trace_t *t = graph_trace_find(name);
+    if (t == NULL) {
+        graph_trace_t *tmp = realloc(g_traces, (g_traces_cnt + 1) * sizeof(graph_trace_t));
+        if (tmp == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            graph_block_release(b);
+            return PM3_EMALLOC;
+        }
+        g_traces = tmp;
+        t = &g_traces[g_traces_cnt++];
+        memset(t, 0, sizeof(graph_trace_t));
+        strncpy(t->name, name, sizeof(t->name) - 1);
+    } else {
+        graph_block_release(t->block);
+    }
+    t->block = b;
+    return PM3_SUCCESS;
+}
+
+int graph_trace_load(const char *name, bool overlay) {
+    graph_trace_t *t = graph_trace_find(name);
+    if (t == NULL) {
+        return PM3_EINVARG;
+    }
+    const graph_block_t *b = t->block;
+
+    if (overlay) {
+        // drawn against the current graph, so cut or padded to its length
+        size_t n = MIN(b->len, g_GraphTraceLen);
+        memcpy(g_OverlayBuffer, b->samples, n * sizeof(int32_t));
+        memset(g_OverlayBuffer + n, 0, (g_GraphTraceLen - n) * sizeof(int32_t));
+        g_useOverlays = true;
+    } else {
+        ClearGraph(false);
+        memcpy(g_GraphBuffer, b->samples, b->len * sizeof(int32_t));
+        memcpy(g_OperationBuffer, b->samples, b->len * sizeof(int32_t));
+        g_GraphTraceLen = b->len;
+    }
+    RepaintGraphWindow();
+    return PM3_SUCCESS;
+}
+
+int graph_trace_delete(const char *name) {
+    graph_trace_t *t = graph_trace_find(name);
+    if (t == NULL) {
+        return PM3_EINVARG;
+    }
+    graph_block_release(t->block);
+    size_t idx = t - g_traces;
+    memmove(&g_traces[idx], &g_traces[idx + 1], (g_traces_cnt - idx - 1) * sizeof(graph_trace_t));
+    g_traces_cnt--;
+    return PM3_SUCCESS;
+}
+
+void graph_trace_list(void) {
+    if (g_traces_cnt == 0) {
+        PrintAndLogEx(INFO, "No named traces");
+        return;
+    }
+
+    uint64_t h = samples_hash(g_GraphBuffer, g_GraphTraceLen);
+    size_t bytes = 0;
+    PrintAndLogEx(INFO, "  name                             | samples   | shared | graph");
+    PrintAndLogEx(INFO, "-----------------------------------+-----------+--------+-------");
+    for (size_t i = 0; i < g_traces_cnt; i++) {
+        const graph_block_t *b = g_traces[i].block;
+        bool current = (b->len == g_GraphTraceLen && b->hash == h);
+        PrintAndLogEx(INFO, "  %-32s | %9zu | %-6s | %s"
+                      , g_traces[i].name
+                      , b->len
+                      , (b->refs > 1) ? "yes" : ""
+                      , (current) ? _GREEN_("same") : ""
+                     );
+        // count every block once
+        bool first = true;
+        for (size_t j = 0; j < i && first; j++) {
+            first = (g_traces[j].block != b);
+        }
+        if (first) {
+            bytes += b->len * sizeof(int32_t);
+        }
+    }
+    PrintAndLogEx(INFO, "-----------------------------------+-----------+--------+-------");
+    PrintAndLogEx(INFO, "%zu traces, " _YELLOW_("%zu") " bytes", g_traces_cnt, bytes);
+}
+
+void graph_mipmap_free(graph_mipmap_t *m) {
+    free(m->copy);
+    for (uint8_t k = 0; k < GRAPH_MIPMAP_LEVELS; k++) {
+        free(m->level[k]);
+    }
+    memset(m, 0, sizeof(graph_mipmap_t));
+}
+
+static bool graph_mipmap_grow(graph_mipmap_t *m, size_t len) {
+    size_t cap = MAX(len, m->cap * 2);
+    int32_t *copy = realloc(m->copy, cap * sizeof(int32_t));
+    if (copy == NULL) {
+        return false;
+    }
+    m->copy = copy;
+
+    for (uint8_t k = GRAPH_MIPMAP_FIRST; k < GRAPH_MIPMAP_LEVELS && ((size_t)1 << k) <= cap; k++) {
+        graph_range_t *level = realloc(m->level[k], ((cap >> k) + 1) * sizeof(graph_range_t));
+        if (level == NULL) {
+            return false;
+        }
+        m->level[k] = level;
+    }
+    m->cap = cap;
+    return true;
+}
+
+static void graph_range_merge(graph_range_t *r, const graph_range_t *o) {
+    if (o->min < r->min) r->min = o->min;
+    if (o->max > r->max) r->max = o->max;
+    r->sum += o->sum;
+}
+
+bool graph_mipmap_update(graph_mipmap_t *m, const int32_t *samples, size_t len) {
+
+    // first sample that differs from the summarized ones
+    size_t dirty = MIN(m->len, len);
+    for (size_t i = 0; i < dirty; i += 4096) {
+        size_t n = MIN(dirty - i, 4096);
+        if (memcmp(m->copy + i, samples + i, n * sizeof(int32_t)) != 0) {
+            size_t j = 0;
+            while (m->copy[i + j] == samples[i + j]) {
+                j++;
+            }
+            dirty = i + j;
+            break;
+        }
+    }
+
+    if (dirty == len && len == m->len) {
+        return true;
+    }
+
+    if (len > m->cap && graph_mipmap_grow(m, len) == false) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        graph_mipmap_free(m);
+        return false;
+    }
+
+    memcpy(m->copy + dirty, samples + dirty, (len - dirty) * sizeof(int32_t));
+    m->len = len;
+
+    for (uint8_t k = GRAPH_MIPMAP_FIRST; k < GRAPH_MIPMAP_LEVELS && ((size_t)1 << k) <= len; k++) {
+        size_t bs = (size_t)1 << k;
+        size_t blocks = (len + bs - 1) >> k;
+        for (size_t b = dirty >> k; b < blocks; b++) {
+            graph_range_t r = { INT32_MAX, INT32_MIN, 0 };
+            if (k == GRAPH_MIPMAP_FIRST) {
+                for (size_t i = b * bs; i < MIN((b + 1) * bs, len); i++) {
+                    graph_range_t v = { m->copy[i], m->copy[i], m->copy[i] };
+                    graph_range_merge(&r, &v);
+                }
+            } else {
+                // the two halves from the level below, the last block may have one
+                size_t half = bs / 2;
+                graph_range_merge(&r, &m->level[k - 1][2 * b]);
+                if ((2 * b + 1) * half < len) {
+                    graph_range_merge(&r, &m->level[k - 1][2 * b + 1]);
+                }
+            }
+            m->level[k][b] = r;
+        }
+    }
+    return true;
+}
+
+graph_range_t graph_mipmap_range(const graph_mipmap_t *m, size_t start, size_t end) {
+    graph_range_t r = { INT32_MAX, INT32_MIN, 0 };
+    end = MIN(end, m->len);
+
+    // largest aligned blocks first, single samples at ragged ends
+    size_t i = start;
+    while (i < end) {
+        int k = GRAPH_MIPMAP_LEVELS - 1;
+        while (k >= GRAPH_MIPMAP_FIRST && ((i & (((size_t)1 << k) - 1)) || i + ((size_t)1 << k) > end)) {
+            k--;
+        }
+        if (k < GRAPH_MIPMAP_FIRST) {
+            graph_range_t v = { m->copy[i], m->copy[i], m->copy[i] };
+            graph_range_merge(&r, &v);
+            i++;
+            continue;
+        }
+        graph_range_merge(&r, &m->level[k][i >> k]);
+        i += (size_t)1 << k;
+    }
+    return r;
+}
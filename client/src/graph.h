@@ -57,6 +57,38 @@ int GetNrzClock(const char *str, bool verbose);
 int GetFskClock(const char *str, bool verbose);
 bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge);
 
+// named copies of the graph, kept for the session
+#define GRAPH_TRACE_NAME_LEN    33
+int graph_trace_save(const char *name);
+// overlay, draw it over the current graph instead of replacing it
+int graph_trace_load(const char *name, bool overlay);
+int graph_trace_delete(const char *name);
+void graph_trace_list(void);
+
+// min / max / sum summaries of a trace, so a zoomed out plot costs per pixel
+// and not per sample. Updating compares against the samples it was built
+// from and only rebuilds from the first change, appends are cheap
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+} graph_range_t;
+
+#define GRAPH_MIPMAP_FIRST      3   // smallest summarized block, 1 << 3 samples
+#define GRAPH_MIPMAP_LEVELS     24
+
+typedef struct {
+    int32_t *copy;
+    size_t len;
+    size_t cap;
+    graph_range_t *level[GRAPH_MIPMAP_LEVELS];  // blocks of 1 << index samples
+} graph_mipmap_t;
+
+bool graph_mipmap_update(graph_mipmap_t *m, const int32_t *samples, size_t len);
+// samples [start, end), end is clamped to the summarized length
+graph_range_t graph_mipmap_range(const graph_mipmap_t *m, size_t start, size_t end);
+void graph_mipmap_free(graph_mipmap_t *m);
+
 extern void add_temporary_marker(uint32_t position, const char *label);
 extern void remove_temporary_markers(void);
 
@@ -74,14 +74,22 @@ gdImagePtr img_palettize(gdImagePtr rgb, int *palette, int palette_size) {
         gdImageColorAllocate(res, gdTrueColorGetRed(c), gdTrueColorGetGreen(c), gdTrueColorGetBlue(c));
     }
 
-    for (int y = 0; y < gdImageSY(rgb); y++) {
+    // rows are read and written directly, the accessor functions check bounds on every pixel
+    const int sx = gdImageSX(rgb);
+    const int sy = gdImageSY(rgb);
+    const int truecolor = gdImageTrueColor(rgb);
+
+    for (int y = 0; y < sy; y++) {
         // Load current row error and reset its storage
         struct ycbcr_t row_err = forward[1];
         forward[1].y = forward[1].cb = forward[1].cr = 0;
 
-        for (int x = 0; x < gdImageSX(rgb); x++) {
+        const int *src = truecolor ? rgb->tpixels[y] : NULL;
+        unsigned char *dst = res->pixels[y];
+
+        for (int x = 0; x < sx; x++) {
             struct ycbcr_t pix;
-            rgb_to_ycbcr(gdImageGetTrueColorPixel(rgb, x, y), &pix);
+            rgb_to_ycbcr(truecolor ? src[x] : gdImageGetTrueColorPixel(rgb, x, y), &pix);
 
             // Add error for current pixel
             pix.y  += row_err.y  / 16;
@@ -121,7 +129,7 @@ gdImagePtr img_palettize(gdImagePtr rgb, int *palette, int palette_size) {
             }
 
             // Set current pixel
-            gdImageSetPixel(res, x, y, best_idx);
+            dst[x] = best_idx;
 
             // Propagate error within the current row, to the pixel to the right
             row_err.y  = best_err.y  * 7 + forward[x + 2].y;
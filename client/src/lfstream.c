@@ -0,0 +1,148 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Streaming LF downlink demodulation
+//-----------------------------------------------------------------------------
+
+#include "lfstream.h"
+
+#include <string.h>
+
+// DC follows the signal with a time constant of 1 << LF_STREAM_DC_TC samples
+#define LF_STREAM_DC_SHIFT  12
+#define LF_STREAM_DC_TC     12
+// the peak deviation decays with the same time constant
+#define LF_STREAM_AMP_SHIFT 12
+#define LF_STREAM_AMP_TC    12
+// hysteresis is a quarter of the peak deviation, never below this
+#define LF_STREAM_MIN_HYST  4
+// short and long pulses are at least this many samples apart
+#define LF_STREAM_MIN_SPREAD 6
+
+void lf_stream_init(lf_stream_demod_t *d, uint16_t quiet, lf_stream_frame_cb_t cb, void *ctx) {
+    memset(d, 0, sizeof(lf_stream_demod_t));
+    d->quiet = (quiet) ? quiet : LF_STREAM_QUIET_DEF;
+    d->cb = cb;
+    d->ctx = ctx;
+}
+
+static void lf_stream_emit(lf_stream_demod_t *d) {
+    lf_stream_frame_t *f = &d->frame;
+    d->in_frame = false;
+    if (f->count == 0) {
+        return;
+    }
+
+    uint16_t min = f->width[0], max = f->width[0];
+    for (uint16_t i = 1; i < f->count; i++) {
+        if (f->width[i] < min) min = f->width[i];
+        if (f->width[i] > max) max = f->width[i];
+    }
+
+    uint32_t sum[2] = {0}, cnt[2] = {0};
+    if (max - min >= LF_STREAM_MIN_SPREAD) {
+        uint16_t threshold = (min + max) / 2;
+        for (uint16_t i = 0; i < f->count; i++) {
+            uint8_t b = (f->width[i] > threshold);
+            f->bits[i] = '0' + b;
+            sum[b] += f->width[i];
+            cnt[b]++;
+        }
+        f->bits[f->count] = 0;
+    } else {
+        for (uint16_t i = 0; i < f->count; i++) {
+            sum[0] += f->width[i];
+        }
+        cnt[0] = f->count;
+        f->bits[0] = 0;
+    }
+    f->short_width = sum[0] / cnt[0];
+    f->long_width = (cnt[1]) ? sum[1] / cnt[1] : 0;
+
+    d->frames++;
+    if (d->cb) {
+        d->cb(f, d->ctx);
+    }
+}
+
+static void lf_stream_gap(lf_stream_demod_t *d) {
+    lf_stream_frame_t *f = &d->frame;
+
+    // the field-on time before the first gap is idle carrier, not a pulse
+    if (d->in_frame) {
+        f->width[f->count++] = (d->run > UINT16_MAX) ? UINT16_MAX : d->run;
+        f->end = d->pos;
+        if (f->count < LF_STREAM_MAX_PULSES) {
+            return;
+        }
+        // frame is full, hand it over and go on with a new one
+        lf_stream_emit(d);
+    }
+
+    memset(f, 0, sizeof(lf_stream_frame_t));
+    f->start = d->pos;
+    f->end = d->pos;
+    d->in_frame = true;
+}
+
+void lf_stream_push(lf_stream_demod_t *d, const int *samples, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int32_t x = samples[i];
+
+        if (d->primed == false) {
+            d->dc = x * (1 << LF_STREAM_DC_SHIFT);
+            d->high = true;
+            d->primed = true;
+        }
+
+        int32_t dev = x - (d->dc >> LF_STREAM_DC_SHIFT);
+        d->dc += ((x * (1 << LF_STREAM_DC_SHIFT)) - d->dc) >> LF_STREAM_DC_TC;
+
+        int32_t a = ((dev < 0) ? -dev : dev) << LF_STREAM_AMP_SHIFT;
+        if (a > d->amp) {
+            d->amp = a;
+        } else {
+            d->amp -= d->amp >> LF_STREAM_AMP_TC;
+        }
+
+        int32_t hyst = (d->amp >> LF_STREAM_AMP_SHIFT) / 4;
+        if (hyst < LF_STREAM_MIN_HYST) {
+            hyst = LF_STREAM_MIN_HYST;
+        }
+
+        if (d->high && dev < -hyst) {
+            lf_stream_gap(d);
+            d->high = false;
+            d->run = 0;
+        } else if (d->high == false && dev > hyst) {
+            d->high = true;
+            d->run = 0;
+        }
+
+        d->run++;
+        d->pos++;
+
+        // field steady on or off for a while, the frame is over
+        if (d->in_frame && d->run >= d->quiet) {
+            lf_stream_emit(d);
+        }
+    }
+}
+
+void lf_stream_flush(lf_stream_demod_t *d) {
+    if (d->in_frame) {
+        lf_stream_emit(d);
+    }
+}
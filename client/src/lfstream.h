@@ -0,0 +1,77 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Streaming LF downlink demodulation
+//
+// Samples are pushed in chunks of any size as they arrive from the device.
+// Field gaps are found with a hysteresis slicer around a tracked DC level,
+// the field-on pulse widths between gaps are collected into frames and a
+// frame ends on a quiet period (field on or off for a long time). Every
+// frame is passed to the callback as soon as it ends, the state is a fixed
+// size so long sniffs do not need the whole capture in memory.
+//-----------------------------------------------------------------------------
+
+#ifndef LFSTREAM_H__
+#define LFSTREAM_H__
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LF_STREAM_MAX_PULSES    128
+// samples without a gap ending a frame
+#define LF_STREAM_QUIET_DEF     256
+
+typedef struct {
+    uint64_t start;                             // sample index of the first gap
+    uint64_t end;                               // sample index of the last edge
+    uint16_t count;                             // number of pulses
+    uint16_t width[LF_STREAM_MAX_PULSES];       // field-on samples between gaps
+    uint16_t short_width;                       // mean width of the '0' pulses
+    uint16_t long_width;                        // mean width of the '1' pulses, 0 if not two widths
+    char bits[LF_STREAM_MAX_PULSES + 1];        // short = '0', long = '1', empty if not two widths
+} lf_stream_frame_t;
+
+typedef void (*lf_stream_frame_cb_t)(const lf_stream_frame_t *frame, void *ctx);
+
+typedef struct {
+    uint16_t quiet;
+    lf_stream_frame_cb_t cb;
+    void *ctx;
+
+    // slicer
+    int32_t dc;         // fixed point, << LF_STREAM_DC_SHIFT
+    int32_t amp;        // fixed point peak deviation, << LF_STREAM_AMP_SHIFT
+    bool primed;
+    bool high;
+
+    uint64_t pos;       // samples seen
+    uint32_t run;       // samples since the last edge
+    bool in_frame;
+    lf_stream_frame_t frame;
+    uint32_t frames;
+} lf_stream_demod_t;
+
+void lf_stream_init(lf_stream_demod_t *d, uint16_t quiet, lf_stream_frame_cb_t cb, void *ctx);
+void lf_stream_push(lf_stream_demod_t *d, const int *samples, size_t n);
+// ends a pending frame, at the end of the capture
+void lf_stream_flush(lf_stream_demod_t *d);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -282,6 +282,167 @@ void doMAC_N(uint8_t *address_data_p, uint8_t address_data_size, uint8_t *div_ke
 }
 
 #ifndef ON_DEVICE
+/**
+ * Bitsliced MAC, 64 keys at once.
+ *
+ * Every state bit is a 64 bit word, bit i of each word belongs to key i. The cipher
+ * only needs xor / and / or on these words, the key byte selection becomes a tree of
+ * multiplexers and the two additions ripple carry adders. Word [j] of a register is
+ * bit j of the byte oriented State_t value above (lsb = 0).
+ **/
+typedef struct {
+    uint64_t l[8];
+    uint64_t r[8];
+    uint64_t b[8];
+    uint64_t t[16];
+} State64_t;
+
+// a + b + c_in over 8 bit sliced words
+static void add8_bs(const uint64_t *a, const uint64_t *b, uint64_t *sum) {
+    uint64_t c = 0;
+    for (int j = 0; j < 8; j++) {
+        uint64_t x = a[j] ^ b[j];
+        sum[j] = x ^ c;
+        c = (a[j] & b[j]) | (c & x);
+    }
+}
+
+static void add8_const_bs(const uint64_t *a, uint8_t k, uint64_t *sum) {
+    uint64_t kb[8];
+    for (int j = 0; j < 8; j++) {
+        kb[j] = ((k >> j) & 1) ? ~0ULL : 0;
+    }
+    add8_bs(a, kb, sum);
+}
+
+static void init_bs(const uint64_t k[8][8], State64_t *s) {
+    uint64_t k0[8];
+    for (int j = 0; j < 8; j++) {
+        k0[j] = k[0][j] ^ (((0x4c >> j) & 1) ? ~0ULL : 0);
+    }
+    add8_const_bs(k0, 0xEC, s->l);
+    add8_const_bs(k0, 0x21, s->r);
+    for (int j = 0; j < 8; j++) {
+        s->b[j] = ((0x4c >> j) & 1) ? ~0ULL : 0;
+    }
+    for (int j = 0; j < 16; j++) {
+        s->t[j] = ((0xE012 >> j) & 1) ? ~0ULL : 0;
+    }
+}
+
+// successor(), y is 0 or ~0
+static void successor_bs(const uint64_t k[8][8], State64_t *s, uint64_t y) {
+    const uint64_t *r = s->r;
+    uint64_t tt = s->t[15] ^ s->t[14] ^ s->t[10] ^ s->t[8] ^ s->t[5] ^ s->t[4] ^ s->t[1] ^ s->t[0];
+    uint64_t bb = s->b[6] ^ s->b[5] ^ s->b[4] ^ s->b[0];
+
+    // r0 .. r7 of the paper are r[7] .. r[0]
+    uint64_t z0 = (r[7] & r[5]) ^ (r[6] & ~r[4]) ^ (r[5] | r[3]);
+    uint64_t z1 = (r[7] | r[5]) ^ (r[2] | r[0]) ^ r[6] ^ r[1] ^ tt ^ y;
+    uint64_t z2 = (r[4] & ~r[2]) ^ (r[3] & r[1]) ^ r[0] ^ tt;
+
+    uint64_t nt = tt ^ r[7] ^ r[3];
+    uint64_t nb = bb ^ r[0];
+    memmove(s->t, s->t + 1, 15 * sizeof(uint64_t));
+    s->t[15] = nt;
+    memmove(s->b, s->b + 1, 7 * sizeof(uint64_t));
+    s->b[7] = nb;
+
+    // k[select(T(t), y, r)] ^ b'
+    uint64_t x[8];
+    for (int j = 0; j < 8; j++) {
+        uint64_t m01 = k[0][j] ^ ((k[0][j] ^ k[1][j]) & z2);
+        uint64_t m23 = k[2][j] ^ ((k[2][j] ^ k[3][j]) & z2);
+        uint64_t m45 = k[4][j] ^ ((k[4][j] ^ k[5][j]) & z2);
+        uint64_t m67 = k[6][j] ^ ((k[6][j] ^ k[7][j]) & z2);
+        uint64_t m03 = m01 ^ ((m01 ^ m23) & z1);
+        uint64_t m47 = m45 ^ ((m45 ^ m67) & z1);
+        x[j] = (m03 ^ ((m03 ^ m47) & z0)) ^ s->b[j];
+    }
+
+    // r' = x + l, l' = x + l + r
+    uint64_t nr[8];
+    add8_bs(x, s->l, nr);
+    add8_bs(nr, s->r, s->l);
+    memcpy(s->r, nr, sizeof(nr));
+}
+
+static void keys_to_bs(const uint8_t keys[][8], uint8_t count, uint64_t k[8][8]) {
+    memset(k, 0, 8 * 8 * sizeof(uint64_t));
+    for (uint8_t i = 0; i < count; i++) {
+        for (int n = 0; n < 8; n++) {
+            uint8_t v = keys[i][n];
+            for (int j = 0; v; j++, v >>= 1) {
+                k[n][j] |= (uint64_t)(v & 1) << i;
+            }
+        }
+    }
+}
+
+// runs the 96 input bits, cc_nr as given to doMAC
+static void mac_input_bs(const uint64_t k[8][8], const uint8_t *cc_nr, State64_t *s) {
+    init_bs(k, s);
+    for (int i = 0; i < 12; i++) {
+        for (int j = 0; j < 8; j++) {
+            successor_bs(k, s, ((cc_nr[i] >> j) & 1) ? ~0ULL : 0);
+        }
+    }
+}
+
+void doMAC_bs(const uint8_t *cc_nr, const uint8_t keys[][8], uint8_t count, uint8_t macs[][4]) {
+    if (count > MAC_BS_LANES) {
+        count = MAC_BS_LANES;
+    }
+
+    uint64_t k[8][8];
+    keys_to_bs(keys, count, k);
+
+    State64_t s;
+    mac_input_bs(k, cc_nr, &s);
+
+    uint64_t out[32];
+    for (int p = 0; p < 32; p++) {
+        out[p] = s.r[2];
+        if (p < 31) {
+            successor_bs(k, &s, 0);
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        memset(macs[i], 0, 4);
+        for (int p = 0; p < 32; p++) {
+            macs[i][p >> 3] |= ((out[p] >> i) & 1) << (p & 7);
+        }
+    }
+}
+
+uint64_t doMAC_bs_match(const uint8_t *cc_nr, const uint8_t keys[][8], uint8_t count, const uint8_t mac[4]) {
+    if (count == 0) {
+        return 0;
+    }
+    if (count > MAC_BS_LANES) {
+        count = MAC_BS_LANES;
+    }
+
+    uint64_t k[8][8];
+    keys_to_bs(keys, count, k);
+
+    State64_t s;
+    mac_input_bs(k, cc_nr, &s);
+
+    // lanes still matching, most keys are out after a few output bits
+    uint64_t alive = (count == 64) ? ~0ULL : ((1ULL << count) - 1);
+    for (int p = 0; p < 32; p++) {
+        uint64_t want = ((mac[p >> 3] >> (p & 7)) & 1) ? ~0ULL : 0;
+        alive &= ~(s.r[2] ^ want);
+        if (alive == 0 || p == 31) {
+            break;
+        }
+        successor_bs(k, &s, 0);
+    }
+    return alive;
+}
+
 int testMAC(void) {
     PrintAndLogEx(SUCCESS, "Testing MAC calculation...");
 
@@ -302,6 +463,32 @@ int testMAC(void) {
         printarr("    Correct_MAC   ", correct_MAC, 4);
         return PM3_ESOFT;
     }
+
+    // bitsliced MACs against the reference, over keys around the one of the paper
+    uint8_t keys[MAC_BS_LANES][8];
+    uint8_t macs[MAC_BS_LANES][4];
+    for (int i = 0; i < MAC_BS_LANES; i++) {
+        memcpy(keys[i], div_key, 8);
+        keys[i][(i * 3) & 7] ^= (uint8_t)(i * 37 + 1);
+        keys[i][i & 7] ^= (uint8_t)(i << 3);
+    }
+    memcpy(keys[17], div_key, 8);
+    doMAC_bs(cc_nr, keys, MAC_BS_LANES, macs);
+
+    int bs_errors = 0;
+    for (int i = 0; i < MAC_BS_LANES; i++) {
+        doMAC(cc_nr, keys[i], calculated_mac);
+        if (memcmp(calculated_mac, macs[i], 4) != 0) {
+            bs_errors++;
+        }
+    }
+    uint64_t hits = doMAC_bs_match(cc_nr, keys, MAC_BS_LANES, correct_MAC);
+    if (bs_errors == 0 && (hits & (1ULL << 17))) {
+        PrintAndLogEx(SUCCESS, "    Bitsliced MAC calculation ( %s )", _GREEN_("ok"));
+    } else {
+        PrintAndLogEx(FAILED, "    Bitsliced MAC calculation ( %s ) %d wrong MACs", _RED_("fail"), bs_errors);
+        return PM3_ESOFT;
+    }
     return PM3_SUCCESS;
 }
 #endif
@@ -41,6 +41,12 @@ void doMAC(uint8_t *cc_nr_p, uint8_t *div_key_p, uint8_t mac[4]);
 void doMAC_N(uint8_t *address_data_p, uint8_t address_data_size, uint8_t *div_key_p, uint8_t mac[4]);
 
 #ifndef ON_DEVICE
+// bitsliced doMAC, MAC_BS_LANES keys per call
+#define MAC_BS_LANES 64
+void doMAC_bs(const uint8_t *cc_nr, const uint8_t keys[][8], uint8_t count, uint8_t macs[][4]);
+// bit i is set when keys[i] gives the MAC, stops as soon as no key matches any more
+uint64_t doMAC_bs_match(const uint8_t *cc_nr, const uint8_t keys[][8], uint8_t count, const uint8_t mac[4]);
+
 int testMAC(void);
 #endif
 
@@ -306,6 +306,50 @@ typedef struct {
 static size_t loclass_tc = 1;
 static int loclass_found = 0;
 
+// diversified key of the keytable selection for one CSN
+static void elite_candidate_div_key(uint8_t *csn, const uint16_t *keytable, const uint8_t *key_index, uint8_t *div_key) {
+    uint8_t key_sel[8] = {0};
+
+    // Piece together the key
+    for (uint8_t i = 0; i < 8; i++) {
+        key_sel[i] = keytable[key_index[i]] & 0xFF;
+    }
+
+    // Permute from iclass format to standard format
+    uint8_t key_sel_p[8] = {0};
+    permutekey_rev(key_sel, key_sel_p);
+
+    // Diversify
+    diversifyKey(csn, key_sel_p, div_key);
+}
+
+static void elite_set_brute(uint16_t *keytable, const uint8_t *bytes_to_recover, uint8_t numbytes_to_recover, uint32_t brute) {
+    for (uint8_t i = 0; i < numbytes_to_recover; i++) {
+        keytable[bytes_to_recover[i]] &= 0xFF00;
+        keytable[bytes_to_recover[i]] |= (brute >> (i * 8) & 0xFF);
+    }
+}
+
+#define _CLR_ "\x1b[0K"
+
+// progress line, when the last batch crossed a reporting step
+static void bf_progress(const uint8_t *bytes_to_recover, uint8_t numbytes_to_recover, uint32_t from, uint32_t brute) {
+    if (numbytes_to_recover == 3) {
+        if ((brute & ~0xFFFFU) != (from & ~0xFFFFU)) {
+            PrintAndLogEx(INPLACE, "[ %02x %02x %02x ] %8u / %u", bytes_to_recover[0], bytes_to_recover[1], bytes_to_recover[2], brute, 0xFFFFFF);
+        }
+    } else if (numbytes_to_recover == 2) {
+        if ((brute & ~0x3FFU) != (from & ~0x3FFU)) {
+            PrintAndLogEx(INPLACE, "[ %02x %02x ] %5u / %u" _CLR_, bytes_to_recover[0], bytes_to_recover[1], brute, 0xFFFF);
+        }
+    } else {
+        if ((brute & ~0x1FU) != (from & ~0x1FU)) {
+            PrintAndLogEx(INPLACE, "[ %02x ] %3u / %u" _CLR_, bytes_to_recover[0], brute, 0xFF);
+        }
+    }
+}
+
+// Candidates are diversified one by one, their MACs computed MAC_BS_LANES at a time with the bitsliced cipher
 static void *bf_thread(void *thread_arg) {
 
     loclass_thread_arg_t *targ = (loclass_thread_arg_t *)thread_arg;
@@ -327,6 +371,9 @@ static void *bf_thread(void *thread_arg) {
     memcpy(bytes_to_recover, targ->bytes_to_recover, sizeof(bytes_to_recover));
     memcpy(keytable, targ->keytable, sizeof(keytable));
 
+    uint8_t div_keys[MAC_BS_LANES][8];
+    uint32_t lane_brute[MAC_BS_LANES];
+
     while (!(brute & endmask)) {
 
         int found = __atomic_load_n(&loclass_found, __ATOMIC_SEQ_CST);
@@ -335,39 +382,26 @@ static void *bf_thread(void *thread_arg) {
             return NULL;
         }
 
-        //Update the keytable with the brute-values
-        for (uint8_t i = 0; i < numbytes_to_recover; i++) {
-            keytable[bytes_to_recover[i]] &= 0xFF00;
-            keytable[bytes_to_recover[i]] |= (brute >> (i * 8) & 0xFF);
+        uint32_t from = brute;
+        uint8_t n = 0;
+        for (; n < MAC_BS_LANES && !(brute & endmask); n++) {
+            //Update the keytable with the brute-values
+            elite_set_brute(keytable, bytes_to_recover, numbytes_to_recover, brute);
+            elite_candidate_div_key(csn, keytable, key_index, div_keys[n]);
+            lane_brute[n] = brute;
+            brute += loclass_tc;
         }
 
-        uint8_t key_sel[8] = {0};
-
-        // Piece together the key
-        key_sel[0] = keytable[key_index[0]] & 0xFF;
-        key_sel[1] = keytable[key_index[1]] & 0xFF;
-        key_sel[2] = keytable[key_index[2]] & 0xFF;
-        key_sel[3] = keytable[key_index[3]] & 0xFF;
-        key_sel[4] = keytable[key_index[4]] & 0xFF;
-        key_sel[5] = keytable[key_index[5]] & 0xFF;
-        key_sel[6] = keytable[key_index[6]] & 0xFF;
-        key_sel[7] = keytable[key_index[7]] & 0xFF;
-
-        // Permute from iclass format to standard format
-
-        uint8_t key_sel_p[8] = {0};
-        permutekey_rev(key_sel, key_sel_p);
-
-        // Diversify
-        uint8_t div_key[8] = {0};
-        diversifyKey(csn, key_sel_p, div_key);
-
-        // Calc mac
-        uint8_t calculated_MAC[4] = {0};
-        doMAC(cc_nr, div_key, calculated_MAC);
+        // Calc macs
+        uint64_t hits = doMAC_bs_match(cc_nr, (const uint8_t (*)[8])div_keys, n, mac);
 
         // success
-        if (memcmp(calculated_MAC, mac, 4) == 0) {
+        if (hits) {
+
+            uint8_t lane = 0;
+            while (((hits >> lane) & 1) == 0) {
+                lane++;
+            }
 
             loclass_thread_ret_t *r = (loclass_thread_ret_t *)calloc(sizeof(loclass_thread_ret_t), sizeof(uint8_t));
             if (r == NULL) {
@@ -376,34 +410,13 @@ static void *bf_thread(void *thread_arg) {
             }
 
             for (uint8_t i = 0 ; i < numbytes_to_recover; i++) {
-                r->values[i] = keytable[bytes_to_recover[i]] & 0xFF;
+                r->values[i] = (lane_brute[lane] >> (i * 8)) & 0xFF;
             }
             __atomic_store_n(&loclass_found, targ->thread_idx, __ATOMIC_SEQ_CST);
             pthread_exit((void *)r);
         }
 
-        brute += loclass_tc;
-
-#define _CLR_ "\x1b[0K"
-
-        if (numbytes_to_recover == 3) {
-
-            if ((brute > 0) && ((brute & 0xFFFF) == 0)) {
-                PrintAndLogEx(INPLACE, "[ %02x %02x %02x ] %8u / %u", bytes_to_recover[0], bytes_to_recover[1], bytes_to_recover[2], brute, 0xFFFFFF);
-            }
-
-        } else if (numbytes_to_recover == 2) {
-
-            if ((brute > 0) && ((brute & 0x3F) == 0)) {
-                PrintAndLogEx(INPLACE, "[ %02x %02x ] %5u / %u" _CLR_, bytes_to_recover[0], bytes_to_recover[1], brute, 0xFFFF);
-            }
-
-        } else {
-
-            if ((brute > 0) && ((brute & 0x1F) == 0)) {
-                PrintAndLogEx(INPLACE, "[ %02x ] %3u / %u" _CLR_, bytes_to_recover[0], brute, 0xFF);
-            }
-        }
+        bf_progress(bytes_to_recover, numbytes_to_recover, from, brute);
     }
     pthread_exit(NULL);
 
@@ -799,6 +812,64 @@ int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]) {
     }
     return calculateMasterKey(first16bytes, NULL);
 }
+/**
+ * @brief Incremental version of bruteforceDump, for items handed over one at a time while
+ * a reader attack is still capturing them. Every item only bruteforces the keytable bytes
+ * the earlier ones did not give, and as soon as the first 16 bytes are known the custom key
+ * is calculated, no matter how many items are still to come.
+ * @param item the next captured item, in capture order
+ * @param keytable keytable of the earlier calls, all zeroes for the first item
+ * @param kcus where to put the custom key once it is known
+ * @return PM3_SUCCESS when the key is recovered, PM3_EPARTIAL when more items are needed
+ */
+int bruteforceItemIncremental(loclass_dumpdata_t item, uint16_t keytable[], uint8_t kcus[8]) {
+
+    loclass_tc = num_CPUs();
+
+    uint8_t key_index[8] = {0};
+    hash1(item.csn, key_index);
+
+    // nothing new in this item, it only adds to the keytable bytes already known
+    bool known = true;
+    for (uint8_t i = 0; i < 8; i++) {
+        if ((keytable[key_index[i]] & LOCLASS_CRACKED) == 0) {
+            known = false;
+            break;
+        }
+    }
+
+    if (known == false) {
+        int res = bruteforceItem(item, keytable);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+    }
+
+    uint8_t first16bytes[16] = {0};
+    uint8_t first16_known = 0;
+    for (uint8_t i = 0; i < 16; i++) {
+        first16bytes[i] = keytable[i] & 0xFF;
+        if (keytable[i] & LOCLASS_CRACKED) {
+            first16_known++;
+        }
+    }
+
+    uint8_t total = 0;
+    for (uint8_t i = 0; i < 128; i++) {
+        if (keytable[i] & LOCLASS_CRACKED) {
+            total++;
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "CSN %s... keytable " _YELLOW_("%2u") " / 16 bytes needed, %u known", sprint_hex_inrow(item.csn, 8), first16_known, total);
+
+    if (first16_known < 16) {
+        return PM3_EPARTIAL;
+    }
+    return calculateMasterKey(first16bytes, kcus);
+}
+
 /**
  * Perform a bruteforce against a file which has been saved by pm3
  *
@@ -945,3 +1016,89 @@ int testElite(bool slowtests) {
 
     return res;
 }
+
+// Candidates per second of the keytable search, one thread, scalar doMAC against the
+// batched bitsliced MAC, then a complete two byte bruteforceItem() on all threads.
+int benchElite(void) {
+    PrintAndLogEx(INFO, "Benchmarking iClass Elite keytable search...");
+
+    uint8_t k_cus[8] = {0x5B, 0x7C, 0x62, 0xC4, 0x91, 0xC1, 0x1B, 0x39};
+    uint8_t table[128] = {0};
+    hash2(k_cus, table);
+
+    loclass_dumpdata_t item = {
+        .csn = {0x00, 0x0B, 0x0F, 0xFF, 0xF7, 0xFF, 0x12, 0xE0},
+        .cc_nr = {0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x12, 0x34, 0x56, 0x78},
+    };
+    uint8_t key_index[8] = {0};
+    hash1(item.csn, key_index);
+
+    uint16_t keytable[128] = {0};
+    for (uint8_t i = 0; i < 128; i++) {
+        keytable[i] = table[i] | LOCLASS_CRACKED;
+    }
+
+    uint8_t div_key[8] = {0};
+    elite_candidate_div_key(item.csn, keytable, key_index, div_key);
+    doMAC(item.cc_nr, div_key, item.mac);
+
+    // the two first distinct bytes of the selection are searched
+    uint8_t bytes_to_recover[3] = {key_index[0], 0, 0};
+    for (uint8_t i = 1; i < 8; i++) {
+        if (key_index[i] != key_index[0]) {
+            bytes_to_recover[1] = key_index[i];
+            break;
+        }
+    }
+
+    const uint32_t count = 1 << 14;
+    uint32_t hits_scalar = 0, hits_batched = 0;
+
+    uint64_t t1 = msclock();
+    for (uint32_t brute = 0; brute < count; brute++) {
+        uint8_t m[4] = {0};
+        elite_set_brute(keytable, bytes_to_recover, 2, brute);
+        elite_candidate_div_key(item.csn, keytable, key_index, div_key);
+        doMAC(item.cc_nr, div_key, m);
+        hits_scalar += (memcmp(m, item.mac, 4) == 0);
+    }
+    uint64_t t_scalar = msclock() - t1;
+
+    uint8_t div_keys[MAC_BS_LANES][8];
+    t1 = msclock();
+    for (uint32_t brute = 0; brute < count; brute += MAC_BS_LANES) {
+        for (uint8_t n = 0; n < MAC_BS_LANES; n++) {
+            elite_set_brute(keytable, bytes_to_recover, 2, brute + n);
+            elite_candidate_div_key(item.csn, keytable, key_index, div_keys[n]);
+        }
+        uint64_t hits = doMAC_bs_match(item.cc_nr, (const uint8_t (*)[8])div_keys, MAC_BS_LANES, item.mac);
+        for (; hits; hits &= hits - 1) {
+            hits_batched++;
+        }
+    }
+    uint64_t t_batched = msclock() - t1;
+
+    PrintAndLogEx(SUCCESS, "    scalar.... " _YELLOW_("%8.0f") " keys/s", (double)count * 1000 / (double)MAX(t_scalar, 1));
+    PrintAndLogEx(SUCCESS, "    batched... " _YELLOW_("%8.0f") " keys/s ( %.1fx )", (double)count * 1000 / (double)MAX(t_batched, 1), (double)t_scalar / (double)MAX(t_batched, 1));
+
+    // full search, the keytable values of the searched bytes are forgotten
+    for (uint8_t i = 0; i < 2; i++) {
+        keytable[bytes_to_recover[i]] = 0;
+    }
+
+    loclass_tc = num_CPUs();
+    t1 = msclock();
+    int res = bruteforceItem(item, keytable);
+    t1 = msclock() - t1;
+    PrintAndLogEx(NORMAL, "");
+
+    if (res == PM3_SUCCESS && hits_scalar == hits_batched
+            && (keytable[bytes_to_recover[0]] & 0xFF) == table[bytes_to_recover[0]]
+            && (keytable[bytes_to_recover[1]] & 0xFF) == table[bytes_to_recover[1]]) {
+        PrintAndLogEx(SUCCESS, "    bruteforceItem, 2 bytes, %zu threads... " _YELLOW_("%.3f") " seconds ( %s )", loclass_tc, (float)t1 / 1000.0, _GREEN_("ok"));
+        return PM3_SUCCESS;
+    }
+
+    PrintAndLogEx(ERR, "    bruteforceItem, 2 bytes ( %s )", _RED_("fail"));
+    return PM3_ESOFT;
+}
@@ -97,6 +97,17 @@ int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]);
  * @return
  */
 int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]);
+/**
+ * @brief Incremental attack, for items handed over one at a time as they are captured.
+ * Bruteforces what the item adds to the keytable and calculates the custom key as soon
+ * as the first 16 keytable bytes are known.
+ *
+ * @param item The next dumpdata item, in capture order.
+ * @param keytable keytable of the earlier calls, all zeroes for the first item.
+ * @param kcus where to put the custom key once it is known.
+ * @return PM3_SUCCESS when the key is recovered, PM3_EPARTIAL when more items are needed
+ */
+int bruteforceItemIncremental(loclass_dumpdata_t item, uint16_t keytable[], uint8_t kcus[8]);
 /**
  * Hash1 takes CSN as input, and determines what bytes in the keytable will be used
  * when constructing the K_sel.
@@ -124,6 +135,7 @@ int calculateMasterKey(uint8_t first16bytes[], uint8_t kcus[]);
  * @return
  */
 int testElite(bool slowtests);
+int benchElite(void);
 
 /**
       Here are some pretty optimal values that can be used to recover necessary data in only
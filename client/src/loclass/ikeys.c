@@ -415,7 +415,10 @@ static int find_p_in_pi(uint8_t p) {
 }
 
 //Reverse hash0
-void invert_hash0(uint8_t k[8]) {
+// Stores up to max verified pre-images, returns how many there are. Thread safe, only prints in debug mode
+int invert_hash0_ex(const uint8_t k[8], uint64_t *preimages, int max) {
+
+    int found = 0;
 
     uint8_t y = 0;
     uint64_t zTilde = 0;
@@ -552,7 +555,7 @@ void invert_hash0(uint8_t k[8]) {
         uint64_t *hydra_heads = (uint64_t *)calloc(sizeof(uint64_t), 1); // Start with one uint64_t
         if (hydra_heads == NULL) {
             PrintAndLogEx(WARNING, "Failed to allocate memory");
-            return;
+            return found;
         }
         hydra_heads[0] = 0;  // Initialize first value to 0
         int heads_count = 1;  // Track number of forks
@@ -572,7 +575,7 @@ void invert_hash0(uint8_t k[8]) {
                 if (ptmp == NULL) {
                     PrintAndLogEx(WARNING, "Failed to allocate memory");
                     free(hydra_heads);
-                    return;
+                    return found;
                 }
                 hydra_heads = ptmp;
 
@@ -653,14 +656,16 @@ void invert_hash0(uint8_t k[8]) {
 
             }
 
-            uint8_t des_pre_image[8] = {0};
-            x_num_to_bytes(original_z, sizeof(original_z), des_pre_image);
-
             if (image_match) {
-                PrintAndLogEx(INFO, "Pre-image......... " _YELLOW_("%s") " ( "_GREEN_("ok") " )", sprint_hex_inrow(des_pre_image, sizeof(des_pre_image)));
+                if (found < max) {
+                    preimages[found] = original_z;
+                }
+                found++;
             } else {
 
                 if (g_debugMode > 0) {
+                    uint8_t des_pre_image[8] = {0};
+                    x_num_to_bytes(original_z, sizeof(original_z), des_pre_image);
                     PrintAndLogEx(INFO, "Pre-image......... " _YELLOW_("%s") " ( "_RED_("invalid") " )", sprint_hex_inrow(des_pre_image, sizeof(des_pre_image)));
                 }
             }
@@ -668,6 +673,33 @@ void invert_hash0(uint8_t k[8]) {
         // Free allocated memory
         free(hydra_heads);
     }
+    return found;
+}
+
+void invert_hash0(uint8_t k[8]) {
+    uint64_t stack_preimages[HASH0_MAX_PREIMAGES];
+    uint64_t *preimages = stack_preimages;
+    int n = invert_hash0_ex(k, preimages, HASH0_MAX_PREIMAGES);
+
+    // unusually many, run again with room for all
+    if (n > HASH0_MAX_PREIMAGES) {
+        preimages = calloc(n, sizeof(uint64_t));
+        if (preimages == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return;
+        }
+        n = invert_hash0_ex(k, preimages, n);
+    }
+
+    for (int i = 0; i < n; i++) {
+        uint8_t des_pre_image[8] = {0};
+        x_num_to_bytes(preimages[i], sizeof(preimages[i]), des_pre_image);
+        PrintAndLogEx(INFO, "Pre-image......... " _YELLOW_("%s") " ( "_GREEN_("ok") " )", sprint_hex_inrow(des_pre_image, sizeof(des_pre_image)));
+    }
+
+    if (preimages != stack_preimages) {
+        free(preimages);
+    }
 }
 
 /**
@@ -50,6 +50,9 @@
  */
 void hash0(uint64_t c, uint8_t k[8]);
 void invert_hash0(uint8_t k[8]);
+// typical count, a key can have more (up to 8 x values times 2^8 hydra heads)
+#define HASH0_MAX_PREIMAGES 64
+int invert_hash0_ex(const uint8_t k[8], uint64_t *preimages, int max);
 int doKeyTests(void);
 /**
  * @brief Performs Elite-class key diversification
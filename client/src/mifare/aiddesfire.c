@@ -221,26 +221,17 @@ static json_t *df_known_aids = NULL;
 
 static int open_aiddf_file(json_t **root, bool verbose) {
 
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, "aid_desfire", ".json", true);
+    const char *path;
+    int res = loadResourceJSON("aid_desfire", true, root, &path);
     if (res != PM3_SUCCESS) {
-        return PM3_EFILE;
-    }
-
-    int retval = PM3_SUCCESS;
-    json_error_t error;
-
-    *root = json_load_file(path, 0, &error);
-    if (!*root) {
-        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
-        retval = PM3_ESOFT;
-        goto out;
+        return res;
     }
 
     if (!json_is_array(*root)) {
         PrintAndLogEx(ERR, "Invalid json (%s) format. root must be an array.", path);
-        retval = PM3_ESOFT;
-        goto out;
+        json_decref(*root);
+        *root = NULL;
+        return PM3_ESOFT;
     }
 
     if (verbose) {
@@ -249,10 +240,7 @@ static int open_aiddf_file(json_t **root, bool verbose) {
                       , json_array_size(*root)
                      );
     }
-
-out:
-    free(path);
-    return retval;
+    return PM3_SUCCESS;
 }
 
 static int close_aiddf_file(json_t *root) {
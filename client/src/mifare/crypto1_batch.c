@@ -0,0 +1,174 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Crypto1, up to 64 candidate keys / states per call.
+//
+// bits[top - k] is the LFSR bit clocked in k steps ago. In crapto1 terms the
+// odd half holds bits[top - 2j] and the even half bits[top - 1 - 2j].
+//-----------------------------------------------------------------------------
+#include "crypto1_batch.h"
+
+#include <string.h>
+
+#include "commonutil.h"  // ARRAYLEN
+
+// taps of LF_POLY_ODD / LF_POLY_EVEN as distance from top
+static const uint8_t feedback_taps[] = {
+    // LF_POLY_ODD 0x29CE5C
+    4, 6, 8, 12, 18, 20, 22, 28, 30, 32, 38, 42,
+    // LF_POLY_EVEN 0x870804
+    5, 23, 33, 35, 37, 47
+};
+
+static inline uint64_t mux(uint64_t s, uint64_t x0, uint64_t x1) {
+    return x0 ^ ((x0 ^ x1) & s);
+}
+
+static inline uint64_t lane_mask(uint32_t lanes) {
+    return (lanes >= 64) ? UINT64_C(-1) : ((UINT64_C(1) << lanes) - 1);
+}
+
+// constant truth tables, the compiler folds the tree down to a few gates
+static inline uint64_t lut4(uint32_t t, uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+    uint64_t l[8];
+    for (int i = 0; i < 8; i++) {
+        l[i] = mux(a, -(uint64_t)((t >> (2 * i)) & 1), -(uint64_t)((t >> (2 * i + 1)) & 1));
+    }
+    for (int i = 0; i < 4; i++) {
+        l[i] = mux(b, l[2 * i], l[2 * i + 1]);
+    }
+    for (int i = 0; i < 2; i++) {
+        l[i] = mux(c, l[2 * i], l[2 * i + 1]);
+    }
+    return mux(d, l[0], l[1]);
+}
+
+static inline uint64_t lut5(uint32_t t, uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e) {
+    return mux(e, lut4(t & 0xffff, a, b, c, d), lut4(t >> 16, a, b, c, d));
+}
+
+// filter() of the odd half at position top
+static inline uint64_t bs_filter(const uint64_t *s) {
+#define X(j) s[-2 * (j)]
+    uint64_t f4 = lut4(0xf22c, X(0), X(1), X(2), X(3));
+    uint64_t f3 = lut4(0xd938, X(4), X(5), X(6), X(7));
+    uint64_t f2 = lut4(0xf22c, X(8), X(9), X(10), X(11));
+    uint64_t f1 = lut4(0xf22c, X(12), X(13), X(14), X(15));
+    uint64_t f0 = lut4(0xd938, X(16), X(17), X(18), X(19));
+#undef X
+    return lut5(0xEC57E80A, f0, f1, f2, f3, f4);
+}
+
+// keep some room on both sides of the state
+static void recenter(crypto1_batch_t *b) {
+    uint32_t new_top = 64 + 47;
+    if (b->top != new_top) {
+        memmove(&b->bits[64], &b->bits[b->top - 47], 48 * sizeof(uint64_t));
+        b->top = new_top;
+    }
+}
+
+void crypto1_batch_load_keys(crypto1_batch_t *b, const uint64_t *keys, uint32_t n) {
+    memset(b, 0, sizeof(*b));
+    b->lanes = MIN(n, CRYPTO1_BATCH_SIZE);
+    b->top = 64 + 47;
+    // same as crypto1_create(): bits[top - k] = key bit (k ^ 7)
+    for (uint32_t lane = 0; lane < b->lanes; lane++) {
+        for (uint32_t k = 0; k < 48; k++) {
+            b->bits[b->top - k] |= ((keys[lane] >> (k ^ 7)) & 1) << lane;
+        }
+    }
+}
+
+void crypto1_batch_load_states(crypto1_batch_t *b, const struct Crypto1State *s, uint32_t n) {
+    memset(b, 0, sizeof(*b));
+    b->lanes = MIN(n, CRYPTO1_BATCH_SIZE);
+    b->top = 64 + 47;
+    for (uint32_t lane = 0; lane < b->lanes; lane++) {
+        for (uint32_t j = 0; j < 24; j++) {
+            b->bits[b->top - 2 * j] |= (uint64_t)((s[lane].odd >> j) & 1) << lane;
+            b->bits[b->top - 1 - 2 * j] |= (uint64_t)((s[lane].even >> j) & 1) << lane;
+        }
+    }
+}
+
+void crypto1_batch_get_state(const crypto1_batch_t *b, uint32_t lane, struct Crypto1State *s) {
+    s->odd = 0;
+    s->even = 0;
+    for (uint32_t j = 0; j < 24; j++) {
+        s->odd |= (uint32_t)((b->bits[b->top - 2 * j] >> lane) & 1) << j;
+        s->even |= (uint32_t)((b->bits[b->top - 1 - 2 * j] >> lane) & 1) << j;
+    }
+}
+
+// clocks 32 bits, returns the keystream bits in step order
+static void batch_word(crypto1_batch_t *b, uint32_t in, bool is_encrypted, uint64_t *ret) {
+    if (b->top + 32 >= CRYPTO1_BATCH_BUF) {
+        recenter(b);
+    }
+    uint64_t enc = is_encrypted ? UINT64_C(-1) : 0;
+    for (int i = 0; i < 32; i++) {
+        const uint64_t *s = &b->bits[b->top];
+        uint64_t r = bs_filter(s);
+        uint64_t feedin = (r & enc) ^ -(uint64_t)BEBIT(in, i);
+        for (size_t k = 0; k < ARRAYLEN(feedback_taps); k++) {
+            feedin ^= s[-(int)feedback_taps[k]];
+        }
+        b->bits[++b->top] = feedin;
+        ret[i] = r;
+    }
+}
+
+void crypto1_batch_word(crypto1_batch_t *b, uint32_t in, bool is_encrypted, uint32_t *ks) {
+    uint64_t ret[32];
+    batch_word(b, in, is_encrypted, ret);
+    if (ks == NULL) {
+        return;
+    }
+    for (uint32_t lane = 0; lane < b->lanes; lane++) {
+        uint32_t w = 0;
+        for (int i = 0; i < 32; i++) {
+            w |= (uint32_t)((ret[i] >> lane) & 1) << (i ^ 24);
+        }
+        ks[lane] = w;
+    }
+}
+
+uint64_t crypto1_batch_word_match(crypto1_batch_t *b, uint32_t in, bool is_encrypted, uint32_t ks) {
+    uint64_t ret[32];
+    batch_word(b, in, is_encrypted, ret);
+    uint64_t diff = 0;
+    for (int i = 0; i < 32; i++) {
+        diff |= ret[i] ^ -(uint64_t)BEBIT(ks, i);
+    }
+    return ~diff & lane_mask(b->lanes);
+}
+
+void crypto1_batch_rollback_word(crypto1_batch_t *b, uint32_t in, bool fb) {
+    if (b->top < 47 + 32) {
+        recenter(b);
+    }
+    uint64_t fbm = fb ? UINT64_C(-1) : 0;
+    for (int i = 31; i >= 0; i--) {
+        // undo the step that clocked in bits[top], it also used bits[top - 48]
+        const uint64_t *s = &b->bits[b->top - 1];
+        uint64_t out = b->bits[b->top] ^ -(uint64_t)BEBIT(in, i) ^ (bs_filter(s) & fbm);
+        for (size_t k = 0; k < ARRAYLEN(feedback_taps) - 1; k++) {
+            out ^= s[-(int)feedback_taps[k]];
+        }
+        b->bits[b->top - 48] = out;
+        b->top--;
+    }
+}
@@ -0,0 +1,50 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Crypto1, up to 64 candidate keys / states per call.
+//
+// Bit i of every word belongs to lane i. The cipher input is the same for
+// all lanes, which is what key checking needs: one authentication against
+// many candidates. Same bit order as crypto1_word() / lfsr_rollback_word().
+//-----------------------------------------------------------------------------
+
+#ifndef CRYPTO1_BATCH_H__
+#define CRYPTO1_BATCH_H__
+
+#include "common.h"
+#include "crapto1/crapto1.h"
+
+#define CRYPTO1_BATCH_SIZE  64
+#define CRYPTO1_BATCH_BUF   (48 + 2 * 64)
+
+typedef struct {
+    uint64_t bits[CRYPTO1_BATCH_BUF];   // LFSR bits in clocking order, the state is [top - 47, top]
+    uint32_t top;
+    uint32_t lanes;
+} crypto1_batch_t;
+
+// lanes = n, n <= CRYPTO1_BATCH_SIZE
+void crypto1_batch_load_keys(crypto1_batch_t *b, const uint64_t *keys, uint32_t n);
+void crypto1_batch_load_states(crypto1_batch_t *b, const struct Crypto1State *s, uint32_t n);
+void crypto1_batch_get_state(const crypto1_batch_t *b, uint32_t lane, struct Crypto1State *s);
+
+// crypto1_word(), keystream of every lane in ks (may be NULL)
+void crypto1_batch_word(crypto1_batch_t *b, uint32_t in, bool is_encrypted, uint32_t *ks);
+// crypto1_word(), returns the mask of lanes whose keystream equals ks
+uint64_t crypto1_batch_word_match(crypto1_batch_t *b, uint32_t in, bool is_encrypted, uint32_t ks);
+// lfsr_rollback_word()
+void crypto1_batch_rollback_word(crypto1_batch_t *b, uint32_t in, bool fb);
+
+#endif
@@ -153,7 +153,7 @@ size_t DesfireSearchCRCPos(uint8_t *data, size_t datalen, uint8_t respcode, uint
         return 0;
     }
 
-    uint8_t crcdata[DESFIRE_BUFFER_SIZE] = {0};
+    uint8_t crcdata[DESFIRE_BUFFER_SIZE];
     size_t crcposfound = 0;
     // crc may be 00..00 and at the end of file may be padding 0x80. so we search from last zero to crclen + 2 (one for crc=0 and one for padding 0x80)
     for (int i = 0; i < crclen + 2; i++) {
@@ -197,7 +197,50 @@ uint8_t *DesfireGetKey(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_type) {
 }
 
 
-static void DesfireCryptoEncDecSingleBlock(uint8_t *key, DesfireCryptoAlgorithm keyType, uint8_t *data, uint8_t *dstdata, uint8_t *ivect, bool dir_to_send, bool encode) {
+// key schedules are only built again when the key changes, a secure channel session
+// encrypts and MACs every frame with the same session keys
+static void *DesfireCipherGet(DesfireContext_t *ctx, uint8_t *key, DesfireCryptoAlgorithm keyType, bool encode) {
+    DesfireCipherCache_t *cache = &ctx->cipherCache[encode ? 1 : 0];
+    size_t keylen = desfire_get_key_length(keyType);
+
+    if (cache->owner == cache && cache->keyType == keyType && memcmp(cache->key, key, keylen) == 0)
+        return &cache->cipher;
+
+    switch (keyType) {
+        case T_DES:
+            if (encode)
+                mbedtls_des_setkey_enc(&cache->cipher.des, key);
+            else
+                mbedtls_des_setkey_dec(&cache->cipher.des, key);
+            break;
+        case T_3DES:
+            if (encode)
+                mbedtls_des3_set2key_enc(&cache->cipher.des3, key);
+            else
+                mbedtls_des3_set2key_dec(&cache->cipher.des3, key);
+            break;
+        case T_3K3DES:
+            if (encode)
+                mbedtls_des3_set3key_enc(&cache->cipher.des3, key);
+            else
+                mbedtls_des3_set3key_dec(&cache->cipher.des3, key);
+            break;
+        case T_AES:
+            mbedtls_aes_init(&cache->cipher.aes);
+            if (encode)
+                mbedtls_aes_setkey_enc(&cache->cipher.aes, key, 128);
+            else
+                mbedtls_aes_setkey_dec(&cache->cipher.aes, key, 128);
+            break;
+    }
+
+    cache->owner = cache;
+    cache->keyType = keyType;
+    memcpy(cache->key, key, keylen);
+    return &cache->cipher;
+}
+
+static void DesfireCryptoEncDecSingleBlock(void *cipher, DesfireCryptoAlgorithm keyType, const uint8_t *data, uint8_t *dstdata, uint8_t *ivect, bool dir_to_send, bool encode) {
     size_t block_size = desfire_get_key_block_length(keyType);
     uint8_t sdata[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
     memcpy(sdata, data, block_size);
@@ -209,55 +252,23 @@ static void DesfireCryptoEncDecSingleBlock(uint8_t *key, DesfireCryptoAlgorithm
 
     switch (keyType) {
         case T_DES:
-            if (encode)
-                des_encrypt(edata, sdata, key);
-            else
-                des_decrypt(edata, sdata, key);
+            mbedtls_des_crypt_ecb(cipher, sdata, edata);
             break;
         case T_3DES:
-            if (encode) {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set2key_enc(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            } else {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set2key_dec(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            }
-            break;
         case T_3K3DES:
-            if (encode) {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set3key_enc(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            } else {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set3key_dec(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            }
+            mbedtls_des3_crypt_ecb(cipher, sdata, edata);
             break;
         case T_AES:
-            if (encode) {
-                mbedtls_aes_context actx;
-                mbedtls_aes_init(&actx);
-                mbedtls_aes_setkey_enc(&actx, key, 128);
-                mbedtls_aes_crypt_ecb(&actx, MBEDTLS_AES_ENCRYPT, sdata, edata);
-                mbedtls_aes_free(&actx);
-            } else {
-                mbedtls_aes_context actx;
-                mbedtls_aes_init(&actx);
-                mbedtls_aes_setkey_dec(&actx, key, 128);
-                mbedtls_aes_crypt_ecb(&actx, MBEDTLS_AES_DECRYPT, sdata, edata);
-                mbedtls_aes_free(&actx);
-            }
+            mbedtls_aes_crypt_ecb(cipher, encode ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT, sdata, edata);
             break;
     }
 
+    // data may be dstdata, so the ciphertext for the next iv goes from sdata
     if (dir_to_send) {
         memcpy(ivect, edata, block_size);
     } else {
         bin_xor(edata, ivect, block_size);
-        memcpy(ivect, data, block_size);
+        memcpy(ivect, sdata, block_size);
     }
 
     memcpy(dstdata, edata, block_size);
@@ -265,7 +276,6 @@ static void DesfireCryptoEncDecSingleBlock(uint8_t *key, DesfireCryptoAlgorithm
 
 void DesfireCryptoEncDecEx(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_type, uint8_t *srcdata, size_t srcdatalen, uint8_t *dstdata, bool dir_to_send, bool encode, uint8_t *iv) {
 
-    uint8_t data[DESFIRE_BUFFER_SIZE] = {0};
     uint8_t xiv[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
 
     if (ctx->secureChannel == DACd40) {
@@ -284,12 +294,32 @@ void DesfireCryptoEncDecEx(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_typ
         return;
 
     if (ctx->secureChannel == DACLRP) {
+        // LRPEncode pads, so it needs room behind the data
+        uint8_t data[DESFIRE_BUFFER_SIZE];
         size_t dstlen = 0;
         LRPEncDec(key, xiv, encode, srcdata, srcdatalen, data, &dstlen);
+        if (dstdata) {
+            memcpy(dstdata, data, srcdatalen);
+        }
     } else {
+        // block by block straight into the destination, in place works too
+        void *cipher = DesfireCipherGet(ctx, key, ctx->keyType, encode);
+        uint8_t block[DESFIRE_MAX_CRYPTO_BLOCK_SIZE];
         size_t offset = 0;
         while (offset < srcdatalen) {
-            DesfireCryptoEncDecSingleBlock(key, ctx->keyType, srcdata + offset, data + offset, xiv, dir_to_send, encode);
+            size_t len = MIN(block_size, srcdatalen - offset);
+            if (len < block_size) {
+                // last block is short, the rest of it is zeroes
+                memset(block, 0, sizeof(block));
+                memcpy(block, srcdata + offset, len);
+                DesfireCryptoEncDecSingleBlock(cipher, ctx->keyType, block, block, xiv, dir_to_send, encode);
+            } else {
+                DesfireCryptoEncDecSingleBlock(cipher, ctx->keyType, srcdata + offset, (dstdata) ? dstdata + offset : block, xiv, dir_to_send, encode);
+            }
+
+            if (dstdata && len < block_size) {
+                memcpy(dstdata + offset, block, len);
+            }
 
             offset += block_size;
         }
@@ -299,10 +329,6 @@ void DesfireCryptoEncDecEx(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_typ
         memcpy(ctx->IV, xiv, block_size);
     else
         memcpy(iv, xiv, block_size);
-
-    if (dstdata) {
-        memcpy(dstdata, data, srcdatalen);
-    }
 }
 
 void DesfireCryptoEncDec(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_type, uint8_t *srcdata, size_t srcdatalen, uint8_t *dstdata, bool encode) {
@@ -669,7 +695,7 @@ void DesfireEV2FillIV(DesfireContext_t *ctx, bool ivforcommand, uint8_t *iv) {
 }
 
 int DesfireEV2CalcCMAC(DesfireContext_t *ctx, uint8_t cmd, uint8_t *data, size_t datalen, uint8_t *mac) {
-    uint8_t mdata[DESFIRE_BUFFER_SIZE] = {0};
+    uint8_t mdata[DESFIRE_BUFFER_SIZE];
     size_t mdatalen = 0;
 
     mdata[0] = cmd;
@@ -744,7 +770,7 @@ void DesfireDecodePrevReaderID(DesfireContext_t *ctx, uint8_t *key, uint32_t trC
 }
 
 int DesfireLRPCalcCMAC(DesfireContext_t *ctx, uint8_t cmd, uint8_t *data, size_t datalen, uint8_t *mac) {
-    uint8_t mdata[DESFIRE_BUFFER_SIZE] = {0};
+    uint8_t mdata[DESFIRE_BUFFER_SIZE];
     size_t mdatalen = 0;
 
     mdata[0] = cmd;
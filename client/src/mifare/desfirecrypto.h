@@ -23,6 +23,8 @@
 #include "desfire.h"
 #include "crypto/libpcrypto.h"
 #include "mifare/lrpcrypto.h"
+#include <mbedtls/des.h>
+#include <mbedtls/aes.h>
 
 #define DESFIRE_GET_ISO_STATUS(x) ( ((uint16_t)(0x91<<8)) + (uint16_t)x )
 
@@ -56,6 +58,18 @@ typedef enum {
     DCOSessionKeyEnc
 } DesfireCryptoOpKeyType;
 
+// expanded key schedule of the last key used in one direction
+typedef struct {
+    const void *owner;                // context it was built in, mbedtls aes keeps a pointer into itself
+    DesfireCryptoAlgorithm keyType;
+    uint8_t key[DESFIRE_MAX_KEY_SIZE];
+    union {
+        mbedtls_des_context des;
+        mbedtls_des3_context des3;
+        mbedtls_aes_context aes;
+    } cipher;
+} DesfireCipherCache_t;
+
 typedef struct {
     uint8_t keyNum;
     DesfireCryptoAlgorithm keyType;   // des/2tdea/3tdea/aes
@@ -86,6 +100,8 @@ typedef struct {
     bool lastRequestZeroLen;
     uint16_t cmdCntr;   // for AES
     uint8_t TI[4];      // for AES
+
+    DesfireCipherCache_t cipherCache[2];   // [encode]
 } DesfireContext_t;
 
 void DesfireClearContext(DesfireContext_t *ctx);
@@ -151,6 +151,38 @@ int mfG4GetFactoryTest(uint8_t *pwd, uint8_t *data, size_t *datalen, bool verbos
     return PM3_SUCCESS;
 }
 
+int mfG4SetBlocks(uint8_t *pwd, uint8_t start, uint8_t count, uint8_t *data, uint8_t workFlags, bool verify, uint8_t *failed) {
+    if (count > MFG4_WRITE_MAX_BLOCKS) {
+        return PM3_EINVARG;
+    }
+
+    uint8_t buf[sizeof(mfg4_write_blocks_t) + (MFG4_WRITE_MAX_BLOCKS * MFBLOCK_SIZE)];
+    mfg4_write_blocks_t *payload = (mfg4_write_blocks_t *)buf;
+    memcpy(payload->pwd, pwd, sizeof(payload->pwd));
+    payload->workFlags = workFlags;
+    payload->flags = (verify) ? MFG4_WRITE_VERIFY : 0;
+    payload->start = start;
+    payload->count = count;
+    memcpy(payload->data, data, count * MFBLOCK_SIZE);
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_G4_WRITE_BLOCKS, buf, sizeof(mfg4_write_blocks_t) + (count * MFBLOCK_SIZE));
+    PacketResponseNG resp;
+    // a few ms per block over RF, twice with verify
+    if (WaitForResponseTimeout(CMD_HF_MIFARE_G4_WRITE_BLOCKS, &resp, 1500 + (count * 100)) == false) {
+        PrintAndLogEx(WARNING, "command execution time out");
+        return PM3_ETIMEOUT;
+    }
+
+    if (resp.status != PM3_SUCCESS) {
+        if (failed && resp.length >= sizeof(mfg4_write_blocks_resp_t)) {
+            *failed = ((mfg4_write_blocks_resp_t *)resp.data.asBytes)->block;
+        }
+        return PM3_EUNDEF;
+    }
+    return PM3_SUCCESS;
+}
+
 int mfG4ChangePassword(uint8_t *pwd, uint8_t *newpwd, bool verbose) {
     uint8_t resp[40] = {0};
     size_t resplen = 0;
@@ -41,6 +41,9 @@ int mfG4GetFactoryTest(uint8_t *pwd, uint8_t *data, size_t *datalen, bool verbos
 
 int mfG4GetBlock(uint8_t *pwd, uint8_t blockno, uint8_t *data, uint8_t workFlags);
 int mfG4SetBlock(uint8_t *pwd, uint8_t blockno, uint8_t *data, uint8_t workFlags);
+// Writes count blocks, at most MFG4_WRITE_MAX_BLOCKS, in one command, optionally reading them back.
+// The session spans the commands from MAGIC_INIT to MAGIC_OFF. On failure, failed is the block number
+int mfG4SetBlocks(uint8_t *pwd, uint8_t start, uint8_t count, uint8_t *data, uint8_t workFlags, bool verify, uint8_t *failed);
 
 int mfG4ChangePassword(uint8_t *pwd, uint8_t *newpwd, bool verbose);
 
@@ -40,13 +40,49 @@ void LRPClearContext(LRPContext_t *ctx) {
     ctx->useUpdatedKeyNum = 0;
 }
 
+// plaintexts and updated keys of the last keys set. Most callers only get the raw
+// session key, so the tables are kept here instead of in their contexts.
+#define LRP_TABLE_CACHE_SIZE 4
+
+typedef struct {
+    bool valid;
+    uint8_t key[CRYPTO_AES128_KEY_SIZE];
+    uint8_t plaintexts[LRP_MAX_PLAINTEXTS_SIZE][CRYPTO_AES128_KEY_SIZE];
+    uint8_t updatedKeys[LRP_MAX_UPDATED_KEYS_SIZE][CRYPTO_AES128_KEY_SIZE];
+} LRPTableCache_t;
+
+static LRPTableCache_t lrpTableCache[LRP_TABLE_CACHE_SIZE];
+static size_t lrpTableCacheNext = 0;
+
 void LRPSetKey(LRPContext_t *ctx, uint8_t *key, size_t updatedKeyNum, bool useBitPadding) {
     LRPClearContext(ctx);
 
     memcpy(ctx->key, key, CRYPTO_AES128_KEY_SIZE);
 
-    LRPGeneratePlaintexts(ctx, 16);
-    LRPGenerateUpdatedKeys(ctx, 4);
+    LRPTableCache_t *cached = NULL;
+    for (int i = 0; i < LRP_TABLE_CACHE_SIZE; i++) {
+        if (lrpTableCache[i].valid && memcmp(lrpTableCache[i].key, key, CRYPTO_AES128_KEY_SIZE) == 0) {
+            cached = &lrpTableCache[i];
+            break;
+        }
+    }
+
+    if (cached) {
+        memcpy(ctx->plaintexts, cached->plaintexts, sizeof(ctx->plaintexts));
+        ctx->plaintextsCount = LRP_MAX_PLAINTEXTS_SIZE;
+        memcpy(ctx->updatedKeys, cached->updatedKeys, sizeof(ctx->updatedKeys));
+        ctx->updatedKeysCount = LRP_MAX_UPDATED_KEYS_SIZE;
+    } else {
+        LRPGeneratePlaintexts(ctx, LRP_MAX_PLAINTEXTS_SIZE);
+        LRPGenerateUpdatedKeys(ctx, LRP_MAX_UPDATED_KEYS_SIZE);
+
+        cached = &lrpTableCache[lrpTableCacheNext];
+        lrpTableCacheNext = (lrpTableCacheNext + 1) % LRP_TABLE_CACHE_SIZE;
+        memcpy(cached->key, key, CRYPTO_AES128_KEY_SIZE);
+        memcpy(cached->plaintexts, ctx->plaintexts, sizeof(cached->plaintexts));
+        memcpy(cached->updatedKeys, ctx->updatedKeys, sizeof(cached->updatedKeys));
+        cached->valid = true;
+    }
 
     ctx->useUpdatedKeyNum = updatedKeyNum;
     ctx->useBitPadding = useBitPadding;
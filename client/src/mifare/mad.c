@@ -47,26 +47,17 @@ static const char *aid_admin[] = {
 
 static int open_mad_file(json_t **root, bool verbose) {
 
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, "mad", ".json", true);
+    const char *path;
+    int res = loadResourceJSON("mad", true, root, &path);
     if (res != PM3_SUCCESS) {
-        return PM3_EFILE;
-    }
-
-    int retval = PM3_SUCCESS;
-    json_error_t error;
-
-    *root = json_load_file(path, 0, &error);
-    if (!*root) {
-        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
-        retval = PM3_ESOFT;
-        goto out;
+        return res;
     }
 
     if (!json_is_array(*root)) {
         PrintAndLogEx(ERR, "Invalid json (%s) format. root must be an array.", path);
-        retval = PM3_ESOFT;
-        goto out;
+        json_decref(*root);
+        *root = NULL;
+        return PM3_ESOFT;
     }
 
     if (verbose) {
@@ -75,10 +66,7 @@ static int open_mad_file(json_t **root, bool verbose) {
                       , json_array_size(*root)
                      );
     }
-
-out:
-    free(path);
-    return retval;
+    return PM3_SUCCESS;
 }
 
 static int close_mad_file(json_t *root) {
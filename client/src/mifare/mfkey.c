@@ -18,7 +18,13 @@
 //-----------------------------------------------------------------------------
 #include "mfkey.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
 #include "crapto1/crapto1.h"
+#include "crypto1_batch.h"
+#include "hardnested_pool.h"
 
 // MIFARE
 int inline compare_uint64(const void *a, const void *b) {
@@ -49,6 +55,148 @@ uint32_t intersection(uint64_t *listA, uint64_t *listB) {
     return p3 - listA;
 }
 
+// LSD radix sort in uint64_t order, the order intersection() expects.
+// Only the 48 state bits vary, bytes all keys share are skipped. Result ends up in keys
+static void radix_sort_uint64(uint64_t *keys, uint64_t *tmp, uint32_t n) {
+    uint64_t *src = keys, *dst = tmp;
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        uint32_t count[0x100] = {0};
+        for (uint32_t i = 0; i < n; i++) {
+            count[(src[i] >> shift) & 0xff]++;
+        }
+        if (n == 0 || count[(src[0] >> shift) & 0xff] == n) {
+            continue;
+        }
+
+        uint32_t pos = 0;
+        for (uint32_t b = 0; b <= 0xff; b++) {
+            uint32_t c = count[b];
+            count[b] = pos;
+            pos += c;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            dst[count[(src[i] >> shift) & 0xff]++] = src[i];
+        }
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != keys) {
+        memcpy(keys, src, n * sizeof(uint64_t));
+    }
+}
+
+// arenas and output buffers per pool worker, kept for the life of the client
+static struct {
+    pthread_mutex_t lock;
+    lfsr_arena_t *top;
+    lfsr_arena_t **arenas;
+    struct Crypto1State **out;
+    uint32_t *fill;
+    uint32_t workers;
+} recovery = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static bool recovery_init(void) {
+    if (recovery.top != NULL) {
+        return true;
+    }
+
+    uint32_t n = hn_pool_workers();
+    recovery.arenas = calloc(n, sizeof(lfsr_arena_t *));
+    recovery.out = calloc(n, sizeof(struct Crypto1State *));
+    recovery.fill = calloc(n, sizeof(uint32_t));
+    if (recovery.arenas == NULL || recovery.out == NULL || recovery.fill == NULL) {
+        goto fail;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        recovery.arenas[i] = lfsr_arena_create();
+        recovery.out[i] = malloc(sizeof(struct Crypto1State) * LFSR_RECOVERY32_MAX_STATES);
+        if (recovery.arenas[i] == NULL || recovery.out[i] == NULL) {
+            goto fail;
+        }
+    }
+
+    recovery.top = lfsr_arena_create();
+    if (recovery.top == NULL) {
+        goto fail;
+    }
+    recovery.workers = n;
+    return true;
+
+fail:
+    for (uint32_t i = 0; i < n && recovery.arenas && recovery.out; i++) {
+        lfsr_arena_destroy(recovery.arenas[i]);
+        free(recovery.out[i]);
+    }
+    free(recovery.arenas);
+    free(recovery.out);
+    free(recovery.fill);
+    recovery.arenas = NULL;
+    recovery.out = NULL;
+    recovery.fill = NULL;
+    return false;
+}
+
+// every worker appends its subtrees to its own buffer
+static void recovery_subtree(uint32_t item, uint32_t worker, void *ctx) {
+    uint32_t in = *(uint32_t *)ctx;
+    struct Crypto1State *sl = recovery.out[worker] + recovery.fill[worker];
+    uint32_t n = lfsr_recovery32_subtree(recovery.top, item, recovery.arenas[worker], sl);
+    for (uint32_t i = 0; i < n; i++) {
+        lfsr_rollback_word(sl + i, in, 0);
+    }
+    recovery.fill[worker] += n;
+}
+
+// lfsr_recovery32() split over the hardnested worker pool. The states are rolled back over in,
+// i.e. they are the states right after the key was loaded, and sorted for intersection().
+// Returns the number of states, *states is terminated by -1 and freed by the caller
+uint32_t nested_recovery32(uint32_t ks1, uint32_t in, struct Crypto1State **states) {
+    *states = NULL;
+
+    pthread_mutex_lock(&recovery.lock);
+    if (recovery_init() == false) {
+        pthread_mutex_unlock(&recovery.lock);
+        return 0;
+    }
+
+    memset(recovery.fill, 0, recovery.workers * sizeof(uint32_t));
+    uint32_t subtrees = lfsr_recovery32_split(ks1, in, recovery.top);
+    hn_pool_run(subtrees, recovery_subtree, &in);
+
+    uint32_t len = 0;
+    for (uint32_t i = 0; i < recovery.workers; i++) {
+        len += recovery.fill[i];
+    }
+
+    struct Crypto1State *sl = malloc(sizeof(struct Crypto1State) * (len + 1));
+    uint64_t *tmp = malloc(sizeof(uint64_t) * (len + 1));
+    if (sl == NULL || tmp == NULL) {
+        pthread_mutex_unlock(&recovery.lock);
+        free(sl);
+        free(tmp);
+        return 0;
+    }
+
+    struct Crypto1State *p = sl;
+    for (uint32_t i = 0; i < recovery.workers; i++) {
+        memcpy(p, recovery.out[i], recovery.fill[i] * sizeof(struct Crypto1State));
+        p += recovery.fill[i];
+    }
+    pthread_mutex_unlock(&recovery.lock);
+
+    radix_sort_uint64((uint64_t *)sl, tmp, len);
+    free(tmp);
+
+    sl[len].odd = -1;
+    sl[len].even = -1;
+    *states = sl;
+    return len;
+}
+
 // Darkside attack (hf mf mifare)
 // if successful it will return a list of keys, not just one.
 uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t par_info, uint64_t ks_info, uint64_t **keys) {
@@ -96,33 +244,56 @@ uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t
     return i;
 }
 
+// Checks the states of lfsr_recovery32() against a 2nd reader response, 64 at a time.
+// Rolls back nr and uid ^ nt to the key, clocks in uid_nt2 and nr2 and compares
+// the keystream with ks2. Stops after max_hits matches like the scalar loop did,
+// key holds the last match
+static int mfkey32_check_states(struct Crypto1State *s, uint32_t nr, uint32_t uid_nt, uint32_t uid_nt2, uint32_t nr2, uint32_t ks2, int max_hits, uint64_t *key) {
+    int hits = 0;
+    crypto1_batch_t b, k;
+
+    struct Crypto1State *t = s;
+    while (t->odd | t->even) {
+        uint32_t n = 0;
+        while (n < CRYPTO1_BATCH_SIZE && (t[n].odd | t[n].even)) {
+            n++;
+        }
+
+        crypto1_batch_load_states(&b, t, n);
+        crypto1_batch_rollback_word(&b, 0, 0);
+        crypto1_batch_rollback_word(&b, nr, 1);
+        crypto1_batch_rollback_word(&b, uid_nt, 0);
+        k = b;
+        crypto1_batch_word(&b, uid_nt2, 0, NULL);
+        crypto1_batch_word(&b, nr2, 1, NULL);
+        uint64_t match = crypto1_batch_word_match(&b, 0, 0, ks2);
+
+        for (uint32_t lane = 0; match; lane++, match >>= 1) {
+            if (match & 1) {
+                struct Crypto1State st;
+                crypto1_batch_get_state(&k, lane, &st);
+                crypto1_get_lfsr(&st, key);
+                if (++hits == max_hits) {
+                    return hits;
+                }
+            }
+        }
+        t += n;
+    }
+    return hits;
+}
+
 // recover key from 2 different reader responses on same tag challenge
 bool mfkey32(nonces_t *data, uint64_t *outputkey) {
-    struct Crypto1State *s, *t;
-    uint64_t outkey = 0;
     uint64_t key = 0;     // recovered key
-    bool isSuccess = false;
-    uint8_t counter = 0;
 
     uint32_t p640 = prng_successor(data->nonce, 64);
 
-    s = lfsr_recovery32(data->ar ^ p640, 0);
-
-    for (t = s; t->odd | t->even; ++t) {
-        lfsr_rollback_word(t, 0, 0);
-        lfsr_rollback_word(t, data->nr, 1);
-        lfsr_rollback_word(t, data->cuid ^ data->nonce, 0);
-        crypto1_get_lfsr(t, &key);
-        crypto1_word(t, data->cuid ^ data->nonce, 0);
-        crypto1_word(t, data->nr2, 1);
-        if (data->ar2 == (crypto1_word(t, 0, 0) ^ p640)) {
-            outkey = key;
-            counter++;
-            if (counter == 20) break;
-        }
-    }
-    isSuccess = (counter == 1);
-    *outputkey = (isSuccess) ? outkey : 0;
+    struct Crypto1State *s = lfsr_recovery32(data->ar ^ p640, 0);
+
+    int counter = mfkey32_check_states(s, data->nr, data->cuid ^ data->nonce, data->cuid ^ data->nonce, data->nr2, data->ar2 ^ p640, 20, &key);
+    bool isSuccess = (counter == 1);
+    *outputkey = (isSuccess) ? key : 0;
     crypto1_destroy(s);
     return isSuccess;
 }
@@ -130,32 +301,15 @@ bool mfkey32(nonces_t *data, uint64_t *outputkey) {
 // recover key from 2 reader responses on 2 different tag challenges
 // skip "several found keys".  Only return true if ONE key is found
 bool mfkey32_moebius(nonces_t *data, uint64_t *outputkey) {
-    struct Crypto1State *s, *t;
-    uint64_t outkey  = 0;
     uint64_t key     = 0; // recovered key
-    bool isSuccess = false;
-    int counter = 0;
     uint32_t p640 = prng_successor(data->nonce, 64);
     uint32_t p641 = prng_successor(data->nonce2, 64);
 
-    s = lfsr_recovery32(data->ar ^ p640, 0);
-
-    for (t = s; t->odd | t->even; ++t) {
-        lfsr_rollback_word(t, 0, 0);
-        lfsr_rollback_word(t, data->nr, 1);
-        lfsr_rollback_word(t, data->cuid ^ data->nonce, 0);
-        crypto1_get_lfsr(t, &key);
+    struct Crypto1State *s = lfsr_recovery32(data->ar ^ p640, 0);
 
-        crypto1_word(t, data->cuid ^ data->nonce2, 0);
-        crypto1_word(t, data->nr2, 1);
-        if (data->ar2 == (crypto1_word(t, 0, 0) ^ p641)) {
-            outkey = key;
-            ++counter;
-            if (counter == 2) break;
-        }
-    }
-    isSuccess  = (counter == 1);
-    *outputkey = (isSuccess) ? outkey : 0;
+    int counter = mfkey32_check_states(s, data->nr, data->cuid ^ data->nonce, data->cuid ^ data->nonce2, data->nr2, data->ar2 ^ p641, 2, &key);
+    bool isSuccess  = (counter == 1);
+    *outputkey = (isSuccess) ? key : 0;
     crypto1_destroy(s);
     return isSuccess;
 }
@@ -176,16 +330,31 @@ bool mfkey32_nested(nonces_t *data, uint64_t *outputkey) {
     uint32_t ks0 = nt_enc ^ nt;
     uint32_t ks2 = ar_enc ^ ar;
     s = lfsr_recovery32(ks0, uid ^ nt);
-    for (t = s; t->odd | t->even; ++t) {
-        crypto1_word(t, nr_enc, 1);
-        if (ks2 == crypto1_word(t, 0, 0)) {
-            lfsr_rollback_word(t, 0, 0);
-            lfsr_rollback_word(t, nr_enc, 1);
-            lfsr_rollback_word(t, uid ^ nt, 0);
-            crypto1_get_lfsr(t, &key);
+    for (t = s; (t->odd | t->even) && isSuccess == false;) {
+        uint32_t n = 0;
+        while (n < CRYPTO1_BATCH_SIZE && (t[n].odd | t[n].even)) {
+            n++;
+        }
+
+        crypto1_batch_t b;
+        crypto1_batch_load_states(&b, t, n);
+        crypto1_batch_word(&b, nr_enc, 1, NULL);
+        uint64_t match = crypto1_batch_word_match(&b, 0, 0, ks2);
+        if (match) {
+            uint32_t lane = 0;
+            while ((match & 1) == 0) {
+                match >>= 1;
+                lane++;
+            }
+            struct Crypto1State st;
+            crypto1_batch_get_state(&b, lane, &st);
+            lfsr_rollback_word(&st, 0, 0);
+            lfsr_rollback_word(&st, nr_enc, 1);
+            lfsr_rollback_word(&st, uid ^ nt, 0);
+            crypto1_get_lfsr(&st, &key);
             isSuccess = true;
-            break;
         }
+        t += n;
     }
     *outputkey = (isSuccess) ? key : 0;
     crypto1_destroy(s);
@@ -32,4 +32,7 @@ int mfkey64(nonces_t *data, uint64_t *outputkey);
 int compare_uint64(const void *a, const void *b);
 uint32_t intersection(uint64_t *listA, uint64_t *listB);
 
+struct Crypto1State;
+uint32_t nested_recovery32(uint32_t ks1, uint32_t in, struct Crypto1State **states);
+
 #endif
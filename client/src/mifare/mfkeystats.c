@@ -0,0 +1,334 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic key hit statistics
+//-----------------------------------------------------------------------------
+
+#include "mfkeystats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "ui.h"
+#include "commonutil.h"  // ARRAYLEN, bytes_to_num
+#include "fileutils.h"
+#include "jansson.h"
+#include "mifaredefault.h"  // MIFARE_KEY_SIZE
+
+typedef enum {
+    SCOPE_ALL,
+    SCOPE_LAYOUT,
+    SCOPE_MFR,
+    SCOPE_UID,
+    SCOPE_COUNT
+} keystats_scope_t;
+
+// a hit on a card alike counts more than a hit anywhere
+static const uint32_t scope_weight[SCOPE_COUNT] = { 1, 4, 16, 64 };
+
+typedef struct {
+    uint64_t key;
+    uint32_t score;
+    uint32_t idx;
+} scored_key_t;
+
+// empty name when the scope does not apply to this card
+static void scope_names(const mfc_keystats_ctx_t *c, char names[SCOPE_COUNT][16]) {
+    memset(names, 0, SCOPE_COUNT * sizeof(names[0]));
+    snprintf(names[SCOPE_ALL], sizeof(names[0]), "all");
+    if (c->sectors) {
+        snprintf(names[SCOPE_LAYOUT], sizeof(names[0]), "layout:%u", c->sectors);
+    }
+    // 4 byte UIDs are random or NUIDs, only double and triple size ones start with the manufacturer
+    if (c->uidlen > 4) {
+        snprintf(names[SCOPE_MFR], sizeof(names[0]), "mfr:%02X", c->uid[0]);
+    }
+    if (c->uidlen >= 2) {
+        snprintf(names[SCOPE_UID], sizeof(names[0]), "uid:%02X%02X", c->uid[0], c->uid[1]);
+    }
+}
+
+static char *stats_filename(bool create_home) {
+    char *path = NULL;
+    if (searchHomeFilePath(&path, NULL, MFC_KEYSTATS_FILENAME, create_home) != PM3_SUCCESS) {
+        return NULL;
+    }
+    return path;
+}
+
+static json_t *stats_load(const char *fn) {
+    if (fn == NULL || fileExists(fn) == false) {
+        return NULL;
+    }
+
+    json_error_t error;
+    json_t *root = json_load_file(fn, 0, &error);
+    if (root == NULL) {
+        PrintAndLogEx(WARNING, "Ignoring key statistics, json error on line %d: %s", error.line, error.text);
+        return NULL;
+    }
+    if (json_is_object(json_object_get(root, "scopes")) == false) {
+        PrintAndLogEx(WARNING, "Ignoring key statistics, no scopes in " _YELLOW_("%s"), fn);
+        json_decref(root);
+        return NULL;
+    }
+    return root;
+}
+
+static int scored_key_cmp(const void *a, const void *b) {
+    const scored_key_t *x = (const scored_key_t *)a;
+    const scored_key_t *y = (const scored_key_t *)b;
+    if (x->key != y->key) {
+        return (x->key > y->key) ? 1 : -1;
+    }
+    return 0;
+}
+
+// highest score first, dictionary order between equals
+static int scored_rank_cmp(const void *a, const void *b) {
+    const scored_key_t *x = (const scored_key_t *)a;
+    const scored_key_t *y = (const scored_key_t *)b;
+    if (x->score != y->score) {
+        return (x->score < y->score) ? 1 : -1;
+    }
+    return (x->idx > y->idx) - (x->idx < y->idx);
+}
+
+uint32_t mfc_keystats_order(const mfc_keystats_ctx_t *c, uint8_t *keys, uint32_t keycnt) {
+    if (keys == NULL || keycnt < 2) {
+        return 0;
+    }
+
+    char *fn = stats_filename(false);
+    json_t *root = stats_load(fn);
+    free(fn);
+    if (root == NULL) {
+        return 0;
+    }
+
+    char names[SCOPE_COUNT][16];
+    scope_names(c, names);
+
+    // weighted hits of every key with history, sorted by key
+    scored_key_t *hist = calloc(SCOPE_COUNT * MFC_KEYSTATS_MAX_KEYS, sizeof(scored_key_t));
+    if (hist == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        json_decref(root);
+        return 0;
+    }
+    size_t nhist = 0;
+    json_t *scopes = json_object_get(root, "scopes");
+    for (int s = 0; s < SCOPE_COUNT; s++) {
+        json_t *scope = (names[s][0]) ? json_object_get(scopes, names[s]) : NULL;
+        if (json_is_object(scope) == false) {
+            continue;
+        }
+        const char *k;
+        json_t *v;
+        json_object_foreach(scope, k, v) {
+            if (nhist == SCOPE_COUNT * MFC_KEYSTATS_MAX_KEYS) {
+                break;
+            }
+            uint64_t key = 0;
+            if (sscanf(k, "%012" SCNx64, &key) != 1 || json_is_integer(v) == false || json_integer_value(v) <= 0) {
+                continue;
+            }
+            hist[nhist].key = key;
+            hist[nhist].score = (uint32_t)json_integer_value(v) * scope_weight[s];
+            nhist++;
+        }
+    }
+    json_decref(root);
+
+    qsort(hist, nhist, sizeof(scored_key_t), scored_key_cmp);
+    size_t n = 0;
+    for (size_t i = 0; i < nhist; i++) {
+        if (n && hist[n - 1].key == hist[i].key) {
+            hist[n - 1].score += hist[i].score;
+        } else {
+            hist[n++] = hist[i];
+        }
+    }
+    nhist = n;
+
+    scored_key_t *ranked = calloc(keycnt, sizeof(scored_key_t));
+    uint8_t *tmp = calloc(keycnt, MIFARE_KEY_SIZE);
+    bool *moved = calloc(keycnt, sizeof(bool));
+    if (ranked == NULL || tmp == NULL || moved == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(hist);
+        free(ranked);
+        free(tmp);
+        free(moved);
+        return 0;
+    }
+
+    uint32_t nranked = 0;
+    for (uint32_t i = 0; i < keycnt && nhist; i++) {
+        scored_key_t probe = { .key = bytes_to_num(keys + (i * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE) };
+        scored_key_t *h = bsearch(&probe, hist, nhist, sizeof(scored_key_t), scored_key_cmp);
+        if (h != NULL) {
+            ranked[nranked].key = probe.key;
+            ranked[nranked].score = h->score;
+            ranked[nranked].idx = i;
+            nranked++;
+        }
+    }
+    free(hist);
+
+    if (nranked) {
+        qsort(ranked, nranked, sizeof(scored_key_t), scored_rank_cmp);
+
+        memcpy(tmp, keys, keycnt * MIFARE_KEY_SIZE);
+        uint32_t pos = 0;
+        for (uint32_t i = 0; i < nranked; i++) {
+            memcpy(keys + (pos++ * MIFARE_KEY_SIZE), tmp + (ranked[i].idx * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+            moved[ranked[i].idx] = true;
+        }
+
+        // the rest keeps its dictionary order
+        for (uint32_t i = 0; i < keycnt; i++) {
+            if (moved[i] == false) {
+                memcpy(keys + (pos++ * MIFARE_KEY_SIZE), tmp + (i * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+            }
+        }
+    }
+
+    free(ranked);
+    free(tmp);
+    free(moved);
+    return nranked;
+}
+
+typedef struct {
+    const char *key;
+    json_int_t count;
+    size_t age;
+} stat_entry_t;
+
+// most hit first, the newest first between equals so new keys are not locked out of a full scope
+static int stat_entry_cmp(const void *a, const void *b) {
+    const stat_entry_t *x = (const stat_entry_t *)a;
+    const stat_entry_t *y = (const stat_entry_t *)b;
+    if (x->count != y->count) {
+        return (x->count < y->count) ? 1 : -1;
+    }
+    return (x->age > y->age) - (x->age < y->age);
+}
+
+// keeps the MFC_KEYSTATS_MAX_KEYS most hit keys of a scope
+static void scope_prune(json_t *scope) {
+    size_t n = json_object_size(scope);
+    if (n <= MFC_KEYSTATS_MAX_KEYS) {
+        return;
+    }
+
+    stat_entry_t *entries = calloc(n, sizeof(stat_entry_t));
+    if (entries == NULL) {
+        return;
+    }
+    size_t i = 0;
+    const char *k;
+    json_t *v;
+    // objects keep the insertion order, the last key is the newest
+    json_object_foreach(scope, k, v) {
+        entries[i].key = k;
+        entries[i].count = json_integer_value(v);
+        entries[i].age = n - i;
+        i++;
+    }
+    qsort(entries, n, sizeof(stat_entry_t), stat_entry_cmp);
+
+    // the names belong to the object, copy them before deleting
+    for (i = MFC_KEYSTATS_MAX_KEYS; i < n; i++) {
+        char name[16] = {0};
+        strncpy(name, entries[i].key, sizeof(name) - 1);
+        json_object_del(scope, name);
+    }
+    free(entries);
+}
+
+int mfc_keystats_record(const mfc_keystats_ctx_t *c, const sector_t *e_sector, uint8_t sectors) {
+    if (g_session.incognito) {
+        return PM3_SUCCESS;
+    }
+
+    // distinct keys found on this card
+    uint64_t found[2 * MIFARE_4K_MAXSECTOR];
+    size_t nfound = 0;
+    for (uint8_t i = 0; i < sectors; i++) {
+        for (uint8_t j = 0; j < 2; j++) {
+            if (e_sector[i].foundKey[j] == false) {
+                continue;
+            }
+            bool seen = false;
+            for (size_t f = 0; f < nfound && seen == false; f++) {
+                seen = (found[f] == e_sector[i].Key[j]);
+            }
+            if (seen == false && nfound < ARRAYLEN(found)) {
+                found[nfound++] = e_sector[i].Key[j];
+            }
+        }
+    }
+    if (nfound == 0) {
+        return PM3_SUCCESS;
+    }
+
+    char *fn = stats_filename(true);
+    if (fn == NULL) {
+        return PM3_EFILE;
+    }
+
+    json_t *root = stats_load(fn);
+    if (root == NULL) {
+        root = json_object();
+        json_object_set_new(root, "Created", json_string("proxmark3"));
+        json_object_set_new(root, "FileType", json_string("mfc key stats"));
+        json_object_set_new(root, "scopes", json_object());
+    }
+    json_t *scopes = json_object_get(root, "scopes");
+
+    char names[SCOPE_COUNT][16];
+    scope_names(c, names);
+    for (int s = 0; s < SCOPE_COUNT; s++) {
+        if (names[s][0] == 0) {
+            continue;
+        }
+        json_t *scope = json_object_get(scopes, names[s]);
+        if (json_is_object(scope) == false) {
+            scope = json_object();
+            json_object_set_new(scopes, names[s], scope);
+        }
+
+        for (size_t f = 0; f < nfound; f++) {
+            char k[13];
+            snprintf(k, sizeof(k), "%012" PRIX64, found[f]);
+            json_int_t count = json_integer_value(json_object_get(scope, k));
+            json_object_set_new(scope, k, json_integer(count + 1));
+        }
+        scope_prune(scope);
+    }
+
+    int res = PM3_SUCCESS;
+    if (json_dump_file(root, fn, JSON_INDENT(2)) != 0) {
+        PrintAndLogEx(WARNING, "Failed to save key statistics to " _YELLOW_("%s"), fn);
+        res = PM3_EFILE;
+    } else {
+        PrintAndLogEx(DEBUG, "Saved key statistics to " _YELLOW_("%s"), fn);
+    }
+    json_decref(root);
+    free(fn);
+    return res;
+}
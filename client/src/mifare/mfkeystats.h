@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic key hit statistics
+//
+// Keys found by hf mf chk / fchk are counted per card in
+// ~/.proxmark3/mfc_key_stats.json, in a few scopes: all cards, card layout
+// (number of sectors), manufacturer (first byte of a 7/10 byte UID) and UID
+// prefix (first two bytes). Before a dictionary run the keys are ordered by
+// their weighted hits, so keys seen on similar cards go to the device first.
+//-----------------------------------------------------------------------------
+
+#ifndef MFKEYSTATS_H__
+#define MFKEYSTATS_H__
+
+#include "common.h"
+#include "mifarehost.h"
+
+#define MFC_KEYSTATS_FILENAME       "mfc_key_stats.json"
+// keys kept per scope, the least hit ones are dropped
+#define MFC_KEYSTATS_MAX_KEYS       256
+
+typedef struct {
+    uint8_t uid[10];
+    uint8_t uidlen;     // 0 if the card could not be read
+    uint8_t sectors;
+} mfc_keystats_ctx_t;
+
+// Stable reorder of keycnt keys (MIFARE_KEY_SIZE bytes each) by hit history.
+// Returns the number of keys with history, now at the front
+uint32_t mfc_keystats_order(const mfc_keystats_ctx_t *c, uint8_t *keys, uint32_t keycnt);
+
+// Counts every distinct key found in e_sector once for this card
+int mfc_keystats_record(const mfc_keystats_ctx_t *c, const sector_t *e_sector, uint8_t sectors);
+
+#endif
@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>             // offsetof
 
 #include "comms.h"
 #include "commonutil.h"
@@ -30,12 +31,14 @@
 #include "ui.h"                 // PrintAndLog...
 #include "crapto1/crapto1.h"
 #include "crc16.h"
+#include "crc32.h"              // crc32_ex, emulator memory shadow
 #include "protocols.h"
 #include "mfkey.h"
 #include "util_posix.h"         // msclock
 #include "cmdparser.h"          // detection of flash capabilities
 #include "cmdflashmemspiffs.h"  // upload to flash mem
 #include "mifaredefault.h"      // default keys
+#include "bruteforce.h"         // key brute candidates
 #include "protocol_vigik.h"     // VIGIK struct
 #include "crypto/libpcrypto.h"
 #include "util.h" // xor
@@ -46,124 +49,218 @@
 #include "pmflash.h"
 #include "preferences.h"        // setDeviceDebugLevel
 
-int mf_dark_side(uint8_t blockno, uint8_t key_type, uint64_t *key) {
-    uint32_t uid = 0;
-    uint32_t nt = 0, nr = 0, ar = 0;
-    uint64_t par_list = 0, ks_list = 0;
-    uint64_t *keylist = NULL, *last_keylist = NULL;
-    bool first_run = true;
+// one darkside run of the device and the candidate keys nonce2key made of it
+typedef struct {
+    uint32_t uid;
+    uint32_t nt;
+    uint32_t nr;
+    uint32_t ar;
+    uint64_t par_list;
+    uint64_t ks_list;
+    uint64_t *keylist;
+    uint32_t keycount;
+    bool solved;
+    bool dummy_key;     // the card accepted the dummy key the reader nonce was sent with
+} mf_darkside_run_t;
+
+static void *mf_dark_side_solve(void *arg) {
+    mf_darkside_run_t *run = (mf_darkside_run_t *)arg;
+    run->keycount = nonce2key(run->uid, run->nt, run->nr, run->ar, run->par_list, run->ks_list, &run->keylist);
+    __atomic_store_n(&run->solved, true, __ATOMIC_RELEASE);
+    return NULL;
+}
 
-    // message
-    PrintAndLogEx(INFO, "Expected execution time is about " _YELLOW_("25") " seconds on average");
-    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " to abort");
+// Let the device do one darkside run. pending is the previous run, solved meanwhile on a
+// thread. When it comes up with candidates the device is stopped, checking them needs it.
+// Returns PM3_ENODATA for such a stopped run
+static int mf_dark_side_collect(uint8_t blockno, uint8_t key_type, bool first_run, mf_darkside_run_t *run, mf_darkside_run_t *pending) {
+
+    struct {
+        uint8_t first_run;
+        uint8_t blockno;
+        uint8_t key_type;
+    } PACKED payload;
+    payload.first_run = first_run;
+    payload.blockno = blockno;
+    payload.key_type = key_type;
 
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_READER, (uint8_t *)&payload, sizeof(payload));
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "Running darkside " NOLF);
+
+    bool stopped = false;
+    uint64_t t1 = 0;
+
+    // wait cycle
     while (true) {
-        clearCommandBuffer();
+
+        if (msclock() - t1 >= 2000) {
+            PrintAndLogEx(NORMAL, "." NOLF);
+            t1 = msclock();
+        }
+
+        if (IsCommunicationThreadDead()) return PM3_EIO;
 
         //TODO: Not really stopping the command in time.
-        //flush queue
-        while (kbd_enter_pressed()) {
+        if (kbd_enter_pressed()) {
             SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
-            PrintAndLogEx(WARNING, "aborted via keyboard");
+            PrintAndLogEx(WARNING, "\naborted via keyboard");
             return PM3_EOPABORTED;
         }
 
-        struct {
-            uint8_t first_run;
-            uint8_t blockno;
-            uint8_t key_type;
-        } PACKED payload;
-        payload.first_run = first_run;
-        payload.blockno = blockno;
-        payload.key_type = key_type;
-        SendCommandNG(CMD_HF_MIFARE_READER, (uint8_t *)&payload, sizeof(payload));
+        if (pending && stopped == false && __atomic_load_n(&pending->solved, __ATOMIC_ACQUIRE) && pending->keycount) {
+            // the device looks for pending commands between auth requests
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopped = true;
+        }
 
-        PrintAndLogEx(NORMAL, "");
-        PrintAndLogEx(INFO, "Running darkside " NOLF);
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_MIFARE_READER, &resp, (pending) ? 50 : 2000)) {
 
-        // wait cycle
-        while (true) {
-            PrintAndLogEx(NORMAL, "." NOLF);
+            struct p {
+                int32_t isOK;
+                uint8_t cuid[4];
+                uint8_t nt[4];
+                uint8_t par_list[8];
+                uint8_t ks_list[8];
+                uint8_t nr[4];
+                uint8_t ar[4];
+            } PACKED;
 
-            if (IsCommunicationThreadDead()) return PM3_EIO;
+            struct p *package = (struct p *)resp.data.asBytes;
+            memset(run, 0, sizeof(mf_darkside_run_t));
 
-            //TODO: Not really stopping the command in time.
-            if (kbd_enter_pressed()) {
-                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
-                PrintAndLogEx(WARNING, "\naborted via keyboard");
-                return PM3_EOPABORTED;
+            if (stopped && package->isOK == 5) {
+                PrintAndLogEx(NORMAL, "");
+                return PM3_ENODATA;
             }
 
-            PacketResponseNG resp;
-            if (WaitForResponseTimeout(CMD_HF_MIFARE_READER, &resp, 2000)) {
-
-                struct p {
-                    int32_t isOK;
-                    uint8_t cuid[4];
-                    uint8_t nt[4];
-                    uint8_t par_list[8];
-                    uint8_t ks_list[8];
-                    uint8_t nr[4];
-                    uint8_t ar[4];
-                } PACKED;
-
-                struct p *package = (struct p *)resp.data.asBytes;
-
-                if (resp.status != PM3_SUCCESS) {
-                    PrintAndLogEx(NORMAL, "");
-
-                    switch (package->isOK) {
-                        case 2:
-                            PrintAndLogEx(FAILED, "Card is not vulnerable to Darkside attack (doesn't send NACK on authentication requests).");
-                            break;
-                        case 3:
-                            PrintAndLogEx(FAILED, "Card is not vulnerable to Darkside attack (its random number generator is not predictable).");
-                            break;
-                        case 4:
-                            PrintAndLogEx(FAILED, "Card is not vulnerable to Darkside attack (its random number generator seems to be based on the wellknown");
-                            PrintAndLogEx(FAILED, "generating polynomial with 16 effective bits only, but shows unexpected behaviour.");
-                            break;
-                        case 5:
-                            PrintAndLogEx(WARNING, "Button pressed. aborted");
-                            break;
-                        case 6:
-                            *key = 0101;
-                            return PM3_SUCCESS;
-                        default:
-                            PrintAndLogEx(FAILED, "Unknown error. Darkside attack failed.");
-                            break;
-                    }
+            if (resp.status != PM3_SUCCESS) {
+                PrintAndLogEx(NORMAL, "");
 
-                    return resp.status;
+                switch (package->isOK) {
+                    case 2:
+                        PrintAndLogEx(FAILED, "Card is not vulnerable to Darkside attack (doesn't send NACK on authentication requests).");
+                        break;
+                    case 3:
+                        PrintAndLogEx(FAILED, "Card is not vulnerable to Darkside attack (its random number generator is not predictable).");
+                        break;
+                    case 4:
+                        PrintAndLogEx(FAILED, "Card is not vulnerable to Darkside attack (its random number generator seems to be based on the wellknown");
+                        PrintAndLogEx(FAILED, "generating polynomial with 16 effective bits only, but shows unexpected behaviour.");
+                        break;
+                    case 5:
+                        PrintAndLogEx(WARNING, "Button pressed. aborted");
+                        break;
+                    case 6:
+                        run->dummy_key = true;
+                        return PM3_SUCCESS;
+                    default:
+                        PrintAndLogEx(FAILED, "Unknown error. Darkside attack failed.");
+                        break;
                 }
 
-                uid = (uint32_t)bytes_to_num(package->cuid, sizeof(package->cuid));
-                nt = (uint32_t)bytes_to_num(package->nt, sizeof(package->nr));
-                par_list = bytes_to_num(package->par_list, sizeof(package->par_list));
-                ks_list = bytes_to_num(package->ks_list, sizeof(package->ks_list));
-                nr = (uint32_t)bytes_to_num(package->nr, 4);
-                ar = (uint32_t)bytes_to_num(package->ar, 4);
-                break;
+                return resp.status;
             }
+
+            run->uid = (uint32_t)bytes_to_num(package->cuid, sizeof(package->cuid));
+            run->nt = (uint32_t)bytes_to_num(package->nt, sizeof(package->nr));
+            run->par_list = bytes_to_num(package->par_list, sizeof(package->par_list));
+            run->ks_list = bytes_to_num(package->ks_list, sizeof(package->ks_list));
+            run->nr = (uint32_t)bytes_to_num(package->nr, 4);
+            run->ar = (uint32_t)bytes_to_num(package->ar, 4);
+            break;
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+    return PM3_SUCCESS;
+}
+
+// Darkside attack. While the candidates of one run are computed on a thread the device is
+// already doing the next run, a run that brings nothing new therefore costs no solving time
+int mf_dark_side(uint8_t blockno, uint8_t key_type, uint64_t *key) {
+    mf_darkside_run_t runs[2];
+    mf_darkside_run_t *cur = &runs[0], *next = &runs[1];
+    uint64_t *last_keylist = NULL;
+    bool first_run = true;
+    bool have_next = false;
+    bool reported_par = false;
+    int res = PM3_SUCCESS;
+
+    // message
+    PrintAndLogEx(INFO, "Expected execution time is about " _YELLOW_("25") " seconds on average");
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " to abort");
+
+    *key = UINT64_C(-1);
+
+    while (true) {
+
+        //TODO: Not really stopping the command in time.
+        //flush queue
+        while (kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(WARNING, "aborted via keyboard");
+            res = PM3_EOPABORTED;
+            goto out;
         }
-        PrintAndLogEx(NORMAL, "");
 
-        if (par_list == 0 && first_run == true) {
+        if (have_next) {
+            mf_darkside_run_t *tmp = cur;
+            cur = next;
+            next = tmp;
+            have_next = false;
+        } else {
+            res = mf_dark_side_collect(blockno, key_type, first_run, cur, NULL);
+            if (res != PM3_SUCCESS) {
+                goto out;
+            }
+        }
+
+        if (cur->dummy_key) {
+            *key = 0101;
+            goto out;
+        }
+
+        if (cur->par_list == 0 && reported_par == false) {
             PrintAndLogEx(SUCCESS, "Parity is all zero. Most likely this card sends NACK on every authentication.");
+            reported_par = true;
         }
         first_run = false;
 
-        uint32_t keycount = nonce2key(uid, nt, nr, ar, par_list, ks_list, &keylist);
+        // solve on a thread, the device is busy with the next run meanwhile
+        pthread_t thread;
+        bool threaded = (pthread_create(&thread, NULL, mf_dark_side_solve, cur) == 0);
+        if (threaded == false) {
+            mf_dark_side_solve(cur);
+        }
+
+        res = mf_dark_side_collect(blockno, key_type, false, next, cur);
+
+        if (threaded) {
+            pthread_join(thread, NULL);
+        }
+
+        if (res == PM3_SUCCESS) {
+            have_next = true;
+        } else if (res != PM3_ENODATA) {
+            free(cur->keylist);
+            goto out;
+        }
+
+        uint64_t *keylist = cur->keylist;
+        uint32_t keycount = cur->keycount;
 
         if (keycount == 0) {
-            PrintAndLogEx(FAILED, "Key not found (lfsr_common_prefix list is null). Nt = %08x", nt);
+            PrintAndLogEx(FAILED, "Key not found (lfsr_common_prefix list is null). Nt = %08x", cur->nt);
             PrintAndLogEx(FAILED, "This is expected to happen in 25%% of all cases.");
             PrintAndLogEx(FAILED, "Trying again with a different reader nonce...");
             continue;
         }
 
         // only parity zero attack
-        if (par_list == 0) {
+        if (cur->par_list == 0) {
             qsort(keylist, keycount, sizeof(*keylist), compare_uint64);
             keycount = intersection(last_keylist, keylist);
             if (keycount == 0) {
@@ -176,19 +273,14 @@ int mf_dark_side(uint8_t blockno, uint8_t key_type, uint64_t *key) {
 
         PrintAndLogEx(SUCCESS, "found " _YELLOW_("%u") " candidate key%s", keycount, (keycount > 1) ? "s" : "");
 
-        *key = UINT64_C(-1);
         uint8_t keyBlock[PM3_CMD_DATA_SIZE];
         uint32_t max_keys = KEYS_IN_BLOCK;
+        const uint64_t *candidates = (cur->par_list == 0) ? last_keylist : keylist;
         for (uint32_t i = 0; i < keycount; i += max_keys) {
 
             uint8_t size = keycount - i > max_keys ? max_keys : keycount - i;
-            register uint8_t j;
-            for (j = 0; j < size; j++) {
-                if (par_list == 0) {
-                    num_to_bytes(last_keylist[i * max_keys + j], MIFARE_KEY_SIZE, keyBlock + (j * MIFARE_KEY_SIZE));
-                } else {
-                    num_to_bytes(keylist[i * max_keys + j], MIFARE_KEY_SIZE, keyBlock + (j * MIFARE_KEY_SIZE));
-                }
+            for (uint8_t j = 0; j < size; j++) {
+                num_to_bytes(candidates[i + j], MIFARE_KEY_SIZE, keyBlock + (j * MIFARE_KEY_SIZE));
             }
 
             if (mf_check_keys(blockno, key_type - 0x60, false, size, keyBlock, key) == PM3_SUCCESS) {
@@ -197,17 +289,135 @@ int mf_dark_side(uint8_t blockno, uint8_t key_type, uint64_t *key) {
         }
 
         if (*key != UINT64_C(-1)) {
+            free(keylist);
+            res = PM3_SUCCESS;
             break;
         } else {
             PrintAndLogEx(FAILED, "All key candidates failed. Restarting darkside");
             free(last_keylist);
             last_keylist = keylist;
+            // the run collected meanwhile came from the same sync, start over
+            have_next = false;
             first_run = true;
         }
     }
+
+out:
     free(last_keylist);
-    free(keylist);
-    return PM3_SUCCESS;
+    return res;
+}
+
+// FM11RF08S backdoor (staticnested_1nt). nt is the clear static nested nonce read through the
+// backdoor. Every key that encrypts it to nt_enc is a candidate, as long as it also gets the
+// parity of the last byte right. par_err holds the parity errors, bit 3 for the first byte.
+// Returns the number of candidates, *keys is freed by the caller
+uint32_t mf_static_enc_candidates(uint32_t uid, uint32_t nt, uint32_t nt_enc, uint8_t par_err, uint64_t **keys) {
+    *keys = NULL;
+
+    struct Crypto1State *states = NULL;
+    uint32_t len = nested_recovery32(nt ^ nt_enc, nt ^ uid, &states);
+    if (len == 0) {
+        free(states);
+        return 0;
+    }
+
+    uint64_t *out = malloc(len * sizeof(uint64_t));
+    if (out == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(states);
+        return 0;
+    }
+
+    uint8_t par_enc = (par_err & 1) ^ oddparity8(nt_enc & 0xFF);
+    uint8_t par = oddparity8(nt & 0xFF);
+    uint32_t cnt = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        uint64_t key;
+        crypto1_get_lfsr(&states[i], &key);
+
+        // the parity bit of the last byte is encrypted with the next keystream bit
+        struct Crypto1State s;
+        crypto1_init(&s, key);
+        crypto1_word(&s, nt ^ uid, 0);
+        uint32_t ks2 = crypto1_word(&s, 0, 0);
+        if ((par_enc ^ ((ks2 >> 24) & 1)) == par) {
+            out[cnt++] = key;
+        }
+    }
+    free(states);
+
+    *keys = out;
+    return cnt;
+}
+
+// one step back of the 16 bit nonce PRNG, nonces are stored byte swapped
+static uint16_t prev_lfsr16(uint16_t nonce) {
+    // the table based original maps 0 to the predecessor of 1
+    if (nonce == 0) {
+        return 0x0200;
+    }
+    uint16_t x = (nonce & 0xff) << 8 | nonce >> 8;
+    x = (x << 1) | ((x >> 15 ^ x >> 1 ^ x >> 2 ^ x >> 4) & 1);
+    return (x & 0xff) << 8 | x >> 8;
+}
+
+// The FM11RF08S derives the static nonce of a key from a 16 bit seed shared by key A and
+// key B of a sector, this walks nt back to that seed (staticnested_2x1nt_rf08s)
+uint16_t mf_fm11rf08s_seednt16(uint32_t nt, uint64_t key) {
+    static const uint8_t a[] = {0, 8, 9, 4, 6, 11, 1, 15, 12, 5, 2, 13, 10, 14, 3, 7};
+    static const uint8_t b[] = {0, 13, 1, 14, 4, 10, 15, 7, 5, 3, 8, 6, 9, 2, 12, 11};
+
+    uint16_t seed = nt >> 16;
+    for (uint8_t i = 0; i < 14; i++) {
+        seed = prev_lfsr16(seed);
+    }
+
+    bool odd = true;
+    for (uint8_t i = 0; i < 6 * 8; i += 8) {
+        if (odd) {
+            seed ^= (a[(key >> i) & 0xF]);
+            seed ^= (b[(key >> i >> 4) & 0xF]) << 4;
+        } else {
+            seed ^= (b[(key >> i) & 0xF]);
+            seed ^= (a[(key >> i >> 4) & 0xF]) << 4;
+        }
+        odd = !odd;
+        for (uint8_t j = 0; j < 8; j++) {
+            seed = prev_lfsr16(seed);
+        }
+    }
+    return seed;
+}
+
+// Keeps the keys of both lists that have a partner with the same seed in the other list.
+// Both lists are compacted in place, order is kept
+void mf_fm11rf08s_filter(uint32_t nt1, uint64_t *keys1, uint32_t *cnt1, uint32_t nt2, uint64_t *keys2, uint32_t *cnt2) {
+    uint8_t seen1[0x10000 / 8] = {0};
+    uint8_t seen2[0x10000 / 8] = {0};
+
+    for (uint32_t i = 0; i < *cnt1; i++) {
+        uint16_t seed = mf_fm11rf08s_seednt16(nt1, keys1[i]);
+        seen1[seed >> 3] |= (1 << (seed & 7));
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < *cnt2; i++) {
+        uint16_t seed = mf_fm11rf08s_seednt16(nt2, keys2[i]);
+        if (seen1[seed >> 3] & (1 << (seed & 7))) {
+            seen2[seed >> 3] |= (1 << (seed & 7));
+            keys2[n++] = keys2[i];
+        }
+    }
+    *cnt2 = n;
+
+    n = 0;
+    for (uint32_t i = 0; i < *cnt1; i++) {
+        uint16_t seed = mf_fm11rf08s_seednt16(nt1, keys1[i]);
+        if (seen2[seed >> 3] & (1 << (seed & 7))) {
+            keys1[n++] = keys1[i];
+        }
+    }
+    *cnt1 = n;
 }
 
 int mf_check_keys(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t keycnt, uint8_t *keyBlock, uint64_t *key) {
@@ -255,9 +465,10 @@ int mf_check_keys(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t ke
 // 0 == ok all keys found
 // 1 ==
 // 2 == Time-out, aborting
-int mf_check_keys_fast_ex(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk, uint8_t strategy,
-                          uint32_t size, uint8_t *keyBlock, sector_t *e_sector, bool use_flashmemory,
-                          bool verbose, bool quiet, uint16_t singleSectorParams) {
+// mode goes to the device as is, strategy | flashmem << 8 | check session flags
+static int mf_check_keys_fast_cmd(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk, uint32_t mode,
+                                  uint32_t size, uint8_t *keyBlock, sector_t *e_sector,
+                                  bool verbose, bool quiet, uint16_t singleSectorParams) {
 
     uint64_t t2 = msclock();
 
@@ -265,7 +476,7 @@ int mf_check_keys_fast_ex(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastCh
     clearCommandBuffer();
     SendCommandOLD(CMD_HF_MIFARE_CHKKEYS_FAST
                    , (sectorsCnt | (firstChunk << 8) | (lastChunk << 12) | (singleSectorParams << 16))
-                   , ((use_flashmemory << 8) | strategy)
+                   , mode
                    , size
                    , keyBlock
                    , (MIFARE_KEY_SIZE * size)
@@ -317,8 +528,17 @@ int mf_check_keys_fast_ex(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastCh
                           sprint_hex_inrow(resp.data.asBytes, MIFARE_KEY_SIZE)
                          );
 
+            uint8_t sec = mfSectorNum(singleSectorParams & 0xFF);
+            if (e_sector && sec < sectorsCnt) {
+                e_sector[sec].Key[(singleSectorParams >> 8) & 1] = bytes_to_num(resp.data.asBytes, MIFARE_KEY_SIZE);
+                e_sector[sec].foundKey[(singleSectorParams >> 8) & 1] = 1;
+            }
+
             return PM3_SUCCESS;
         }
+
+        // no sector table in the reply
+        return PM3_ESOFT;
     }
 
     if (verbose) {
@@ -383,6 +603,72 @@ int mf_check_keys_fast_ex(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastCh
     return PM3_ESOFT;
 }
 
+int mf_check_keys_fast_ex(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk, uint8_t strategy,
+                          uint32_t size, uint8_t *keyBlock, sector_t *e_sector, bool use_flashmemory,
+                          bool verbose, bool quiet, uint16_t singleSectorParams) {
+    return mf_check_keys_fast_cmd(sectorsCnt, firstChunk, lastChunk, ((use_flashmemory << 8) | strategy), size, keyBlock, e_sector, verbose, quiet, singleSectorParams);
+}
+
+// Check session. The keys are stored on the device, as many as fit in its BigBuf, and tested in one
+// run with both strategies. The found keys stay on the device from one run to the next,
+// a dictionary that doesn't fit takes a few runs.
+int mf_check_keys_session(uint8_t sectorsCnt, uint32_t size, uint8_t *keyBlock, sector_t *e_sector,
+                          bool verbose, bool quiet, uint16_t singleSectorParams) {
+
+    uint32_t chunksize = PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE;
+    int res = PM3_ESOFT;
+
+    for (uint32_t pos = 0; pos < size;) {
+
+        if (kbd_enter_pressed()) {
+            clearCommandBuffer();
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            SendCommandNG(CMD_FPGA_MAJOR_MODE_OFF, NULL, 0);   // field is still ON if not on last run
+            PrintAndLogEx(WARNING, "\naborted via keyboard!");
+            return PM3_EOPABORTED;
+        }
+
+        // upload keys until the device is full
+        uint32_t stored = 0;
+        while (pos + stored < size) {
+            uint32_t n = MIN(chunksize, size - pos - stored);
+
+            clearCommandBuffer();
+            SendCommandOLD(CMD_HF_MIFARE_CHKKEYS_FAST, (sectorsCnt | ((stored == 0) << 8)), (1 << 16), n, keyBlock + ((pos + stored) * MIFARE_KEY_SIZE), n * MIFARE_KEY_SIZE);
+            PacketResponseNG resp;
+            if (WaitForResponseTimeout(CMD_ACK, &resp, 2000) == false) {
+                PrintAndLogEx(WARNING, "command execution time out");
+                return PM3_ETIMEOUT;
+            }
+
+            uint32_t cnt = resp.oldarg[0];
+            if (cnt < stored + n) {
+                stored = cnt;
+                break;
+            }
+            stored = cnt;
+        }
+
+        if (stored == 0) {
+            PrintAndLogEx(WARNING, "No room for keys on the device");
+            return PM3_EMALLOC;
+        }
+
+        bool first = (pos == 0);
+        pos += stored;
+
+        res = mf_check_keys_fast_cmd(sectorsCnt, first, (pos == size), (1 << 17), 0, NULL, e_sector, verbose, quiet, singleSectorParams);
+        if (res == PM3_SUCCESS || res == PM3_EOPABORTED || res == PM3_ETIMEOUT) {
+            break;
+        }
+
+        if (quiet == false && pos < size) {
+            PrintAndLogEx(INPLACE, "Testing %5u/%5u ( " _YELLOW_("%02.1f %%") " )", pos, size, (float)pos * 100 / size);
+        }
+    }
+    return res;
+}
+
 int mf_check_keys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk, uint8_t strategy
                        , uint32_t size, uint8_t *keyBlock, sector_t *e_sector, bool use_flashmemory
                        , bool verbose) {
@@ -445,85 +731,125 @@ int mf_check_keys_file(uint8_t *destfn, uint64_t *key) {
     return PM3_SUCCESS;
 }
 
+static int mf_key_brute_reply(uint32_t ticket, uint64_t *resultkey) {
+
+    PacketResponseNG resp;
+    int res = WaitForAsyncReply(ticket, &resp, 2500);
+    if (res != PM3_SUCCESS) {
+        CancelAsyncReply(ticket);
+        return res;
+    }
+
+    if (resp.status != PM3_SUCCESS) {
+        return resp.status;
+    }
+
+    struct kr {
+        uint8_t key[MIFARE_KEY_SIZE];
+        bool found;
+    } PACKED;
+    struct kr *keyresult = (struct kr *)&resp.data.asBytes;
+    if (keyresult->found == false) {
+        return PM3_ESOFT;
+    }
+
+    *resultkey = bytes_to_num(keyresult->key, sizeof(keyresult->key));
+    return PM3_SUCCESS;
+}
+
 // PM3 imp of J-Run mf_key_brute (part 2)
 // ref: https://github.com/J-Run/mf_key_brute
+// The two unknown MSB are walked by a range generator. While the device checks one
+// block of candidates, the next block is built and already queued behind it, so the
+// reader never sits idle waiting for a USB round trip.
 int mf_key_brute(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint64_t *resultkey) {
 
-    uint64_t key64;
-    uint8_t found = false;
-    uint8_t candidates[CANDIDATE_SIZE] = {0x00};
-    uint8_t keyBlock[KEYBLOCK_SIZE] = {0x00};
+    generator_context_t ctx;
+    bf_generator_init(&ctx, BF_MODE_RANGE, BF_KEY_SIZE_48);
+    ctx.range_low = 0;
+    ctx.range_high = 0xFFFF;
 
-    memset(candidates, 0, sizeof(candidates));
-    memset(keyBlock, 0, sizeof(keyBlock));
+    uint64_t known = bytes_to_num(key + 2, 4);
+    uint64_t total = bf_generator_count(&ctx);
+    uint64_t tested = 0;
 
-    // Generate all possible keys for the first two unknown bytes.
-    for (uint16_t i = 0; i < 0xFFFF; ++i) {
-        uint32_t j = i * MIFARE_KEY_SIZE;
-        candidates[0 + j] = i >> 8;
-        candidates[1 + j] = i;
-        candidates[2 + j] = key[2];
-        candidates[3 + j] = key[3];
-        candidates[4 + j] = key[4];
-        candidates[5 + j] = key[5];
-    }
-    uint32_t counter, i;
-    for (i = 0, counter = 1; i < CANDIDATE_SIZE; i += KEYBLOCK_SIZE, ++counter) {
+    uint8_t data[2][PM3_CMD_DATA_SIZE];
+    uint8_t cur = 0;
+    uint32_t inflight = 0;
+    uint8_t inflight_cnt = 0;
+    uint32_t counter = 0;
+    bool clear_trace = true;
+    int res = PM3_ESOFT;
 
-        key64 = 0;
+    clearCommandBuffer();
 
-        // copy candidatekeys to test key block
-        memcpy(keyBlock, candidates + i, KEYBLOCK_SIZE);
+    while (true) {
 
-        // check a block of generated key candidates.
-        if (mf_check_keys(blockNo, keyType, true, KEYS_IN_BLOCK, keyBlock, &key64) == PM3_SUCCESS) {
-            *resultkey = key64;
-            found = true;
-            break;
+        // build the next block while the previous one is being checked
+        uint8_t *d = data[cur];
+        uint8_t cnt = 0;
+        while (cnt < KEYS_IN_BLOCK && bf_generate(&ctx) == BF_GENERATOR_NEXT) {
+            num_to_bytes((ctx.current_key << 32) | known, MIFARE_KEY_SIZE, d + 5 + (cnt * MIFARE_KEY_SIZE));
+            cnt++;
         }
 
-        // progress
-        if (counter % 20 == 0) {
-            PrintAndLogEx(SUCCESS, "tried %s.. \t %u keys", sprint_hex(candidates + i, 6),  counter * KEYS_IN_BLOCK);
+        uint32_t ticket = 0;
+        if (cnt) {
+            d[0] = keyType;
+            d[1] = blockNo;
+            d[2] = clear_trace;
+            d[3] = 0;
+            d[4] = cnt;
+            clear_trace = false;
+
+            ticket = SendCommandNGAsync(CMD_HF_MIFARE_CHKKEYS, d, 5 + (cnt * MIFARE_KEY_SIZE), CMD_HF_MIFARE_CHKKEYS, NULL, NULL);
+            if (ticket == 0) {
+                res = PM3_EMALLOC;
+                break;
+            }
         }
-    }
-    return found;
-}
 
-// Compare 16 Bits out of cryptostate
-inline static int Compare16Bits(const void *a, const void *b) {
-    if ((*(uint64_t *)b & 0x00ff000000ff0000) == (*(uint64_t *)a & 0x00ff000000ff0000)) return 0;
-    if ((*(uint64_t *)b & 0x00ff000000ff0000) > (*(uint64_t *)a & 0x00ff000000ff0000)) return 1;
-    return -1;
-}
+        if (inflight) {
+            res = mf_key_brute_reply(inflight, resultkey);
+            tested += inflight_cnt;
+            inflight = 0;
 
-// wrapper function for multi-threaded lfsr_recovery32
-static void
-#ifdef __has_attribute
-#if __has_attribute(force_align_arg_pointer)
-__attribute__((force_align_arg_pointer))
-#endif
-#endif
-*nested_worker_thread(void *arg) {
-    struct Crypto1State *p1;
-    StateList_t *statelist = arg;
-    statelist->head.slhead = lfsr_recovery32(statelist->ks1, statelist->nt_enc ^ statelist->uid);
+            if (res != PM3_ESOFT || kbd_enter_pressed()) {
+                if (res == PM3_ESOFT) {
+                    PrintAndLogEx(WARNING, "\naborted via keyboard!");
+                    res = PM3_EOPABORTED;
+                }
+                // drain the block queued behind it, the device still answers it
+                if (ticket) {
+                    uint64_t dummy = 0;
+                    if (mf_key_brute_reply(ticket, &dummy) == PM3_SUCCESS && res != PM3_SUCCESS) {
+                        *resultkey = dummy;
+                        res = PM3_SUCCESS;
+                    }
+                }
+                break;
+            }
 
-    for (p1 = statelist->head.slhead; p1->odd | p1->even; p1++) {};
+            // progress
+            if (++counter % 20 == 0) {
+                PrintAndLogEx(INPLACE, "tried %" PRIu64 " of %" PRIu64 " keys", tested, total);
+            }
+        }
 
-    statelist->len = p1 - statelist->head.slhead;
-    statelist->tail.sltail = --p1;
+        if (ticket == 0) {
+            break;
+        }
 
-    qsort(statelist->head.slhead, statelist->len, sizeof(uint64_t), Compare16Bits);
+        inflight = ticket;
+        inflight_cnt = cnt;
+        cur ^= 1;
+    }
 
-    return statelist->head.slhead;
+    PrintAndLogEx(NORMAL, "");
+    return res;
 }
 
-int mf_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate) {
-
-    uint32_t uid = 0;
-    StateList_t statelists[2];
-    struct Crypto1State *p1, *p2, *p3, *p4;
+int mf_nested_acquire(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool calibrate, mf_nested_nonces_t *nonces) {
 
     struct {
         uint8_t block;
@@ -566,82 +892,47 @@ int mf_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo
         return package->isOK;
     }
 
-    memcpy(&uid, package->cuid, sizeof(package->cuid));
-
-    for (uint8_t i = 0; i < 2; i++) {
-        statelists[i].blockNo = package->block;
-        statelists[i].keyType = package->keytype;
-        statelists[i].uid = uid;
-    }
-
-    memcpy(&statelists[0].nt_enc,  package->nt_a, sizeof(package->nt_a));
-    memcpy(&statelists[0].ks1, package->ks_a, sizeof(package->ks_a));
-
-    memcpy(&statelists[1].nt_enc,  package->nt_b, sizeof(package->nt_b));
-    memcpy(&statelists[1].ks1, package->ks_b, sizeof(package->ks_b));
+    nonces->block = package->block;
+    nonces->keytype = package->keytype;
+    memcpy(&nonces->uid, package->cuid, sizeof(package->cuid));
+    memcpy(&nonces->nt_enc[0], package->nt_a, sizeof(package->nt_a));
+    memcpy(&nonces->ks1[0], package->ks_a, sizeof(package->ks_a));
+    memcpy(&nonces->nt_enc[1], package->nt_b, sizeof(package->nt_b));
+    memcpy(&nonces->ks1[1], package->ks_b, sizeof(package->ks_b));
+    return PM3_SUCCESS;
+}
 
-    // calc keys
-    pthread_t thread_id[2];
+int mf_nested_solve(const mf_nested_nonces_t *nonces, StateList_t *statelists) {
 
-    // create and run worker threads
     for (uint8_t i = 0; i < 2; i++) {
-        pthread_create(thread_id + i, NULL, nested_worker_thread, &statelists[i]);
+        statelists[i].blockNo = nonces->block;
+        statelists[i].keyType = nonces->keytype;
+        statelists[i].uid = nonces->uid;
+        statelists[i].nt_enc = nonces->nt_enc[i];
+        statelists[i].ks1 = nonces->ks1[i];
     }
 
-    // wait for threads to terminate:
+    // calc keys. The lists come back rolled back to the key and sorted, the key we
+    // are searching for must be in the intersection of both lists
     for (uint8_t i = 0; i < 2; i++) {
-        pthread_join(thread_id[i], (void *)&statelists[i].head.slhead);
+        statelists[i].len = nested_recovery32(statelists[i].ks1, statelists[i].nt_enc ^ statelists[i].uid, &statelists[i].head.slhead);
     }
 
-    // the first 16 Bits of the cryptostate already contain part of our key.
-    // Create the intersection of the two lists based on these 16 Bits and
-    // roll back the cryptostate
-    p1 = p3 = statelists[0].head.slhead;
-    p2 = p4 = statelists[1].head.slhead;
-
-    while (p1 <= statelists[0].tail.sltail && p2 <= statelists[1].tail.sltail) {
-
-        if (Compare16Bits(p1, p2) == 0) {
-
-            struct Crypto1State savestate;
-
-            savestate = *p1;
-            while (Compare16Bits(p1, &savestate) == 0 && p1 <= statelists[0].tail.sltail) {
-                *p3 = *p1;
-                lfsr_rollback_word(p3, statelists[0].nt_enc ^ statelists[0].uid, 0);
-                p3++;
-                p1++;
-            }
-
-            savestate = *p2;
-            while (Compare16Bits(p2, &savestate) == 0 && p2 <= statelists[1].tail.sltail) {
-                *p4 = *p2;
-                lfsr_rollback_word(p4, statelists[1].nt_enc ^ statelists[1].uid, 0);
-                p4++;
-                p2++;
-            }
-
-        } else {
-            while (Compare16Bits(p1, p2) == -1) p1++;
-            while (Compare16Bits(p1, p2) == 1) p2++;
-        }
+    if (statelists[0].head.slhead == NULL || statelists[1].head.slhead == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(statelists[0].head.slhead);
+        free(statelists[1].head.slhead);
+        statelists[0].head.slhead = NULL;
+        statelists[1].head.slhead = NULL;
+        return PM3_EMALLOC;
     }
 
-    p3->odd = -1;
-    p3->even = -1;
-    p4->odd = -1;
-    p4->even = -1;
-    statelists[0].len = p3 - statelists[0].head.slhead;
-    statelists[1].len = p4 - statelists[1].head.slhead;
-    statelists[0].tail.sltail = --p3;
-    statelists[1].tail.sltail = --p4;
-
-    // the statelists now contain possible keys. The key we are searching for must be in the
-    // intersection of both lists
-    qsort(statelists[0].head.keyhead, statelists[0].len, sizeof(uint64_t), compare_uint64);
-    qsort(statelists[1].head.keyhead, statelists[1].len, sizeof(uint64_t), compare_uint64);
     // Create the intersection
     statelists[0].len = intersection(statelists[0].head.keyhead, statelists[1].head.keyhead);
+    return PM3_SUCCESS;
+}
+
+int mf_nested_verify(const mf_nested_nonces_t *nonces, StateList_t *statelists, uint8_t *resultKey) {
 
     bool looped = false;
 
@@ -668,7 +959,7 @@ int mf_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo
 
         register uint8_t j;
         for (j = 0; j < size; j++) {
-            crypto1_get_lfsr(statelists[0].head.slhead + i, &key64);
+            crypto1_get_lfsr(statelists[0].head.slhead + i + j, &key64);
             num_to_bytes(key64, MIFARE_KEY_SIZE, keyBlock + j * MIFARE_KEY_SIZE);
         }
 
@@ -682,16 +973,16 @@ int mf_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo
             free(statelists[1].head.slhead);
             num_to_bytes(key64, MIFARE_KEY_SIZE, resultKey);
 
-            if (package->keytype < 2) {
+            if (nonces->keytype < 2) {
                 PrintAndLogEx(SUCCESS, "Target block " _GREEN_("%4u") " key type " _GREEN_("%c") " -- found valid key [ " _GREEN_("%s") " ]",
-                              package->block,
-                              package->keytype ? 'B' : 'A',
+                              nonces->block,
+                              nonces->keytype ? 'B' : 'A',
                               sprint_hex_inrow(resultKey, MIFARE_KEY_SIZE)
                              );
             } else {
                 PrintAndLogEx(SUCCESS, "Target block " _GREEN_("%4u") " key type " _GREEN_("%02x") " -- found valid key [ " _GREEN_("%s") " ]",
-                              package->block,
-                              MIFARE_AUTH_KEYA + package->keytype,
+                              nonces->block,
+                              MIFARE_AUTH_KEYA + nonces->keytype,
                               sprint_hex_inrow(resultKey, MIFARE_KEY_SIZE)
                              );
             }
@@ -709,15 +1000,15 @@ out:
         PrintAndLogEx(NORMAL, "");
     }
 
-    if (package->keytype < 2) {
+    if (nonces->keytype < 2) {
         PrintAndLogEx(SUCCESS, "Target block " _YELLOW_("%4u") " key type " _YELLOW_("%c"),
-                      package->block,
-                      package->keytype ? 'B' : 'A'
+                      nonces->block,
+                      nonces->keytype ? 'B' : 'A'
                      );
     } else {
         PrintAndLogEx(SUCCESS, "Target block " _YELLOW_("%4u") " key type " _YELLOW_("%02x"),
-                      package->block,
-                      MIFARE_AUTH_KEYA + package->keytype
+                      nonces->block,
+                      MIFARE_AUTH_KEYA + nonces->keytype
                      );
     }
     free(statelists[0].head.slhead);
@@ -725,11 +1016,59 @@ out:
     return PM3_ESOFT;
 }
 
+int mf_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate) {
+
+    mf_nested_nonces_t nonces;
+    int res = mf_nested_acquire(blockNo, keyType, key, trgBlockNo, trgKeyType, calibrate, &nonces);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    StateList_t statelists[2];
+    res = mf_nested_solve(&nonces, statelists);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    return mf_nested_verify(&nonces, statelists, resultKey);
+}
+
+static void *mf_nested_job_thread(void *arg) {
+    mf_nested_job_t *job = arg;
+    job->res = mf_nested_solve(&job->nonces, job->statelists);
+    return NULL;
+}
+
+void mf_nested_job_start(mf_nested_job_t *job) {
+    job->active = true;
+    job->threaded = (pthread_create(&job->thread, NULL, mf_nested_job_thread, job) == 0);
+    if (job->threaded == false) {
+        mf_nested_job_thread(job);
+    }
+}
+
+int mf_nested_job_wait(mf_nested_job_t *job) {
+    if (job->threaded) {
+        pthread_join(job->thread, NULL);
+        job->threaded = false;
+    }
+    job->active = false;
+    return job->res;
+}
+
+void mf_nested_job_discard(mf_nested_job_t *job) {
+    if (job->active == false) {
+        return;
+    }
+    if (mf_nested_job_wait(job) == PM3_SUCCESS) {
+        free(job->statelists[0].head.slhead);
+        free(job->statelists[1].head.slhead);
+    }
+}
+
 int mf_static_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey) {
 
     uint32_t uid = 0;
     StateList_t statelists[2];
-    struct Crypto1State *p1, *p2, *p3, *p4;
 
     struct {
         uint8_t block;
@@ -779,60 +1118,19 @@ int mf_static_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trg
     memcpy(&statelists[1].nt_enc, package->nt_b, sizeof(package->nt_b));
     memcpy(&statelists[1].ks1, package->ks_b, sizeof(package->ks_b));
 
-    // calc keys
-    pthread_t thread_id[2];
-
-    // create and run worker threads
-    for (uint8_t i = 0; i < 2; i++)
-        pthread_create(thread_id + i, NULL, nested_worker_thread, &statelists[i]);
-
-    // wait for threads to terminate:
-    for (uint8_t i = 0; i < 2; i++)
-        pthread_join(thread_id[i], (void *)&statelists[i].head.slhead);
-
-    // the first 16 Bits of the cryptostate already contain part of our key.
-    // Create the intersection of the two lists based on these 16 Bits and
-    // roll back the cryptostate
-    p1 = p3 = statelists[0].head.slhead;
-    p2 = p4 = statelists[1].head.slhead;
-
-    while (p1 <= statelists[0].tail.sltail && p2 <= statelists[1].tail.sltail) {
-        if (Compare16Bits(p1, p2) == 0) {
-
-            struct Crypto1State savestate;
-            savestate = *p1;
-            while (Compare16Bits(p1, &savestate) == 0 && p1 <= statelists[0].tail.sltail) {
-                *p3 = *p1;
-                lfsr_rollback_word(p3, statelists[0].nt_enc ^ statelists[0].uid, 0);
-                p3++;
-                p1++;
-            }
-            savestate = *p2;
-            while (Compare16Bits(p2, &savestate) == 0 && p2 <= statelists[1].tail.sltail) {
-                *p4 = *p2;
-                lfsr_rollback_word(p4, statelists[1].nt_enc ^ statelists[1].uid, 0);
-                p4++;
-                p2++;
-            }
-        } else {
-            while (Compare16Bits(p1, p2) == -1) p1++;
-            while (Compare16Bits(p1, p2) == 1) p2++;
-        }
+    // calc keys. The lists come back rolled back to the key and sorted, the key we
+    // are searching for must be in the intersection of both lists
+    for (uint8_t i = 0; i < 2; i++) {
+        statelists[i].len = nested_recovery32(statelists[i].ks1, statelists[i].nt_enc ^ statelists[i].uid, &statelists[i].head.slhead);
     }
 
-    p3->odd = -1;
-    p3->even = -1;
-    p4->odd = -1;
-    p4->even = -1;
-    statelists[0].len = p3 - statelists[0].head.slhead;
-    statelists[1].len = p4 - statelists[1].head.slhead;
-    statelists[0].tail.sltail = --p3;
-    statelists[1].tail.sltail = --p4;
+    if (statelists[0].head.slhead == NULL || statelists[1].head.slhead == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(statelists[0].head.slhead);
+        free(statelists[1].head.slhead);
+        return PM3_EMALLOC;
+    }
 
-    // the statelists now contain possible keys. The key we are searching for must be in the
-    // intersection of both lists
-    qsort(statelists[0].head.keyhead, statelists[0].len, sizeof(uint64_t), compare_uint64);
-    qsort(statelists[1].head.keyhead, statelists[1].len, sizeof(uint64_t), compare_uint64);
     // Create the intersection
     statelists[0].len = intersection(statelists[0].head.keyhead, statelists[1].head.keyhead);
 
@@ -1011,6 +1309,58 @@ int mf_read_block(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint8_t
     return PM3_SUCCESS;
 }
 
+// Whole card in one device command, the device authenticates nested between sectors.
+// carddata gets 16 bytes per block, readmask one bit per block of every sector
+int mf_dump_card(const sector_t *e_sector, uint8_t sectorcnt, uint8_t *carddata, uint16_t *readmask) {
+    if (sectorcnt == 0 || sectorcnt > MF_DUMP_MAX_SECTORS) {
+        return PM3_EINVARG;
+    }
+
+    mf_dump_req_t payload;
+    memset(&payload, 0, sizeof(payload));
+    payload.sectorcnt = sectorcnt;
+    for (uint8_t s = 0; s < sectorcnt; s++) {
+        for (uint8_t kt = MF_KEY_A; kt <= MF_KEY_B; kt++) {
+            if (e_sector[s].foundKey[kt]) {
+                uint8_t bit = (2 * s) + kt;
+                payload.keymask[bit / 8] |= (1 << (bit % 8));
+                num_to_bytes(e_sector[s].Key[kt], MIFARE_KEY_SIZE, payload.keys[s][kt]);
+            }
+        }
+        readmask[s] = 0;
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_DUMP, (uint8_t *)&payload, sizeof(payload));
+
+    PacketResponseNG resp;
+    for (;;) {
+        // one reply per sector, the device is still busy until the last one
+        if (WaitForResponseTimeout(CMD_HF_MIFARE_DUMP, &resp, 2500) == false) {
+            PrintAndLogEx(DEBUG, "command execution time out");
+            return PM3_ETIMEOUT;
+        }
+
+        const mf_dump_sector_t *sec = (const mf_dump_sector_t *)resp.data.asBytes;
+        if (resp.length < offsetof(mf_dump_sector_t, data) || sec->sector == MF_DUMP_DONE) {
+            return resp.status;
+        }
+        if (sec->sector >= sectorcnt || sec->blocks != mfNumBlocksPerSector(sec->sector) ||
+                resp.length < offsetof(mf_dump_sector_t, data) + (sec->blocks * MFBLOCK_SIZE)) {
+            PrintAndLogEx(DEBUG, "unexpected dump reply, sector %u", sec->sector);
+            continue;
+        }
+
+        readmask[sec->sector] = sec->readmask;
+        for (uint8_t b = 0; b < sec->blocks; b++) {
+            if (sec->readmask & (1 << b)) {
+                memcpy(carddata + ((mfFirstBlockOfSector(sec->sector) + b) * MFBLOCK_SIZE), sec->data + (b * MFBLOCK_SIZE), MFBLOCK_SIZE);
+            }
+        }
+        PrintAndLogEx(INPLACE, "Sector... " _YELLOW_("%2d") " ( %u / %u blocks )", sec->sector, bitcount32(sec->readmask), sec->blocks);
+    }
+}
+
 int mf_write_block(uint8_t blockno, uint8_t keyType, const uint8_t *key, const uint8_t *block) {
 
     uint8_t data[26];
@@ -1043,6 +1393,66 @@ int mf_write_sector(uint8_t sectorNo, uint8_t keyType, const uint8_t *key, uint8
 }
 
 // EMULATOR
+
+// Client copy of the emulator memory as last uploaded, from offset 0 up to len bytes.
+// mf_eml_upload only sends the blocks that differ from it, once a CRC32 of the device
+// memory confirmed the copy still holds. A sim writes blocks, ecfill / cload fill the
+// memory on the device, and a restart wipes it.
+#define MF_EMUL_SHADOW_SIZE 4096 // device emulator memory, CARD_MEMORY_SIZE
+static struct {
+    bool valid;
+    uint16_t len;
+    uint8_t data[MF_EMUL_SHADOW_SIZE];
+} mf_emul_shadow;
+
+static bool mf_emul_shadow_check(void) {
+
+    if (mf_emul_shadow.valid == false || mf_emul_shadow.len == 0) {
+        return false;
+    }
+
+    struct {
+        uint16_t offset;
+        uint16_t len;
+    } PACKED payload = { 0, mf_emul_shadow.len };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_EML_CRC, (uint8_t *)&payload, sizeof(payload));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_HF_MIFARE_EML_CRC, &resp, 1500) == false || resp.status != PM3_SUCCESS || resp.length != 4) {
+        // older firmware, or no reply
+        mf_emul_shadow.valid = false;
+        return false;
+    }
+
+    uint8_t crc[4] = {0};
+    crc32_ex(mf_emul_shadow.data, mf_emul_shadow.len, crc);
+    if (memcmp(crc, resp.data.asBytes, sizeof(crc)) != 0) {
+        PrintAndLogEx(DEBUG, "emulator memory changed on device, full upload");
+        mf_emul_shadow.valid = false;
+        return false;
+    }
+    return true;
+}
+
+static void mf_emul_shadow_update(const uint8_t *d, size_t n, size_t offset) {
+
+    if (offset + n > MF_EMUL_SHADOW_SIZE) {
+        mf_emul_shadow.valid = false;
+        return;
+    }
+
+    // a gap in front of the new data is memory the shadow does not know
+    size_t known = mf_emul_shadow.valid ? mf_emul_shadow.len : 0;
+    if (offset > known) {
+        return;
+    }
+
+    memcpy(mf_emul_shadow.data + offset, d, n);
+    mf_emul_shadow.len = MAX(known, offset + n);
+    mf_emul_shadow.valid = true;
+}
+
 int mf_eml_get_mem(uint8_t *data, int blockNum, int blocksCount) {
     return mf_eml_get_mem_xt(data, blockNum, blocksCount, MFBLOCK_SIZE);
 }
@@ -1094,7 +1504,7 @@ int mf_eml_set_mem_xt(uint8_t *data, int blockNum, int blocksCount, int blockBtW
     } PACKED;
 
     size_t size = ((size_t) blocksCount) * blockBtWidth;
-    if (size > (PM3_CMD_DATA_SIZE - sizeof(struct p))) {
+    if ((blocksCount > 0xFF) || (size > (GetJumboPayloadSize() - sizeof(struct p)))) {
         return PM3_EINVARG;
     }
 
@@ -1113,9 +1523,90 @@ int mf_eml_set_mem_xt(uint8_t *data, int blockNum, int blocksCount, int blockBtW
     clearCommandBuffer();
     SendCommandNG(CMD_HF_MIFARE_EML_MEMSET, (uint8_t *)payload, paylen);
     free(payload);
+
+    mf_emul_shadow_update(data, size, ((size_t) blockNum) * blockBtWidth);
     return PM3_SUCCESS;
 }
 
+// Uploads a whole dump to emulator memory from block 0. Only the blocks that changed since the
+// last upload are sent when the device memory still matches, jumbo frames in fast push mode
+int mf_eml_upload(uint8_t *data, uint16_t blocksCount, uint8_t blockBtWidth) {
+
+    if (blockBtWidth == 0) {
+        return PM3_EINVARG;
+    }
+
+    size_t n = ((size_t) blocksCount) * blockBtWidth;
+
+    // blocks inside what the shadow knows are compared against it, the rest goes as is
+    size_t known = 0;
+    if (mf_emul_shadow.valid && mf_emul_shadow_check()) {
+        known = MIN(n, mf_emul_shadow.len);
+    }
+
+    // runs of changed blocks, from start to end. Ultralight pages of 4 bytes at the smallest
+    uint16_t runs[MF_EMUL_SHADOW_SIZE / 4][2];
+    uint16_t nruns = 0;
+    uint16_t changed = 0;
+
+    for (uint16_t b = 0; b < blocksCount; b++) {
+        size_t pos = ((size_t) b) * blockBtWidth;
+
+        if (pos + blockBtWidth <= known && memcmp(data + pos, mf_emul_shadow.data + pos, blockBtWidth) == 0) {
+            continue;
+        }
+
+        changed++;
+        if (nruns && (runs[nruns - 1][1] == b || nruns == ARRAYLEN(runs))) {
+            runs[nruns - 1][1] = b + 1;
+        } else {
+            runs[nruns][0] = b;
+            runs[nruns][1] = b + 1;
+            nruns++;
+        }
+    }
+
+    if (known) {
+        PrintAndLogEx(INFO, "Uploading to emulator memory, " _YELLOW_("%u") " of %u blocks changed", changed, blocksCount);
+    } else {
+        PrintAndLogEx(INFO, "Uploading to emulator memory");
+    }
+
+    if (nruns == 0) {
+        return PM3_SUCCESS;
+    }
+
+    // 12 is the size of the struct the fct mf_eml_set_mem_xt uses to transfer to device
+    // jumbo frames when available, at most 255 blocks per transfer
+    uint16_t max_blocks = MIN((GetJumboPayloadSize() - 12) / blockBtWidth, 0xFF);
+
+    // fast push mode
+    g_conn.block_after_ACK = true;
+
+    PrintAndLogEx(INFO, "." NOLF);
+    int res = PM3_SUCCESS;
+    for (uint16_t i = 0; i < nruns && res == PM3_SUCCESS; i++) {
+        for (uint16_t b = runs[i][0]; b < runs[i][1]; b += max_blocks) {
+            uint16_t cnt = MIN(max_blocks, runs[i][1] - b);
+            if (i == nruns - 1 && b + cnt == runs[i][1]) {
+                // Disable fast mode on last packet
+                g_conn.block_after_ACK = false;
+            }
+
+            res = mf_eml_set_mem_xt(data + (((size_t) b) * blockBtWidth), b, cnt, blockBtWidth);
+            if (res != PM3_SUCCESS) {
+                PrintAndLogEx(FAILED, "Can't set emulator mem at block: %3u", b);
+                break;
+            }
+            PrintAndLogEx(NORMAL, "." NOLF);
+            fflush(stdout);
+        }
+    }
+    g_conn.block_after_ACK = false;
+    PrintAndLogEx(NORMAL, "");
+    return res;
+}
+
 // "MAGIC" CARD
 int mf_chinese_set_uid(uint8_t *uid, uint8_t uidlen, const uint8_t *atqa, const uint8_t *sak, uint8_t *old_uid, uint8_t *verifed_uid, uint8_t wipecard, uint8_t gdm) {
 
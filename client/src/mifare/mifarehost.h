@@ -22,6 +22,7 @@
 
 #include "common.h"
 
+#include <pthread.h>
 #include "util.h"       // FILE_PATH_SIZE
 #include "mifaredefault.h"      // consts
 #include "protocol_vigik.h"
@@ -66,13 +67,44 @@ typedef struct {
     //uint8_t foundKey[2];
 } icesector_t;
 
+// nonces of one nested attack, as collected by the device
+typedef struct {
+    uint32_t uid;
+    uint8_t block;
+    uint8_t keytype;
+    uint32_t nt_enc[2];
+    uint32_t ks1[2];
+} mf_nested_nonces_t;
+
+// a nested attack whose nonces are solved in a background thread,
+// the device is free for other work until mf_nested_job_wait()
+typedef struct {
+    mf_nested_nonces_t nonces;
+    StateList_t statelists[2];
+    pthread_t thread;
+    bool threaded;
+    bool active;
+    int res;
+} mf_nested_job_t;
+
 #define KEYS_IN_BLOCK   ((PM3_CMD_DATA_SIZE - 5) / MIFARE_KEY_SIZE)
 #define KEYBLOCK_SIZE   (KEYS_IN_BLOCK * MIFARE_KEY_SIZE)
-#define CANDIDATE_SIZE  (0xFFFF * MIFARE_KEY_SIZE)
 
 int mf_dark_side(uint8_t blockno, uint8_t key_type, uint64_t *key);
 int mf_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate);
+// mf_nested() in its three steps: collect nonces on the device, solve them on the host
+// (no device access, safe to run in a thread), test the candidates on the device
+int mf_nested_acquire(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool calibrate, mf_nested_nonces_t *nonces);
+int mf_nested_solve(const mf_nested_nonces_t *nonces, StateList_t *statelists);
+int mf_nested_verify(const mf_nested_nonces_t *nonces, StateList_t *statelists, uint8_t *resultKey);
+void mf_nested_job_start(mf_nested_job_t *job);
+int mf_nested_job_wait(mf_nested_job_t *job);
+void mf_nested_job_discard(mf_nested_job_t *job);
 int mf_static_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey);
+// FM11RF08S backdoor, static encrypted nonces
+uint32_t mf_static_enc_candidates(uint32_t uid, uint32_t nt, uint32_t nt_enc, uint8_t par_err, uint64_t **keys);
+uint16_t mf_fm11rf08s_seednt16(uint32_t nt, uint64_t key);
+void mf_fm11rf08s_filter(uint32_t nt1, uint64_t *keys1, uint32_t *cnt1, uint32_t nt2, uint64_t *keys2, uint32_t *cnt2);
 int mf_check_keys(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t keycnt, uint8_t *keyBlock, uint64_t *key);
 int mf_check_keys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk,
                        uint8_t strategy, uint32_t size, uint8_t *keyBlock, sector_t *e_sector,
@@ -80,6 +112,8 @@ int mf_check_keys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk
 int mf_check_keys_fast_ex(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk, uint8_t strategy,
                           uint32_t size, uint8_t *keyBlock, sector_t *e_sector, bool use_flashmemory,
                           bool verbose, bool quiet, uint16_t singleSectorParams);
+int mf_check_keys_session(uint8_t sectorsCnt, uint32_t size, uint8_t *keyBlock, sector_t *e_sector,
+                          bool verbose, bool quiet, uint16_t singleSectorParams);
 
 int mf_check_keys_file(uint8_t *destfn, uint64_t *key);
 
@@ -87,6 +121,7 @@ int mf_key_brute(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint64_t
 
 int mf_read_sector(uint8_t sectorNo, uint8_t keyType, const uint8_t *key, uint8_t *data);
 int mf_read_block(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint8_t *data);
+int mf_dump_card(const sector_t *e_sector, uint8_t sectorcnt, uint8_t *carddata, uint16_t *readmask);
 
 int mf_write_block(uint8_t blockno, uint8_t keyType, const uint8_t *key, const uint8_t *block);
 int mf_write_sector(uint8_t sectorNo, uint8_t keyType, const uint8_t *key, uint8_t *sector);
@@ -95,6 +130,7 @@ int mf_eml_get_mem(uint8_t *data, int blockNum, int blocksCount);
 int mf_eml_get_mem_xt(uint8_t *data, int blockNum, int blocksCount, int blockBtWidth);
 int mf_elm_set_mem(uint8_t *data, int blockNum, int blocksCount);
 int mf_eml_set_mem_xt(uint8_t *data, int blockNum, int blocksCount, int blockBtWidth);
+int mf_eml_upload(uint8_t *data, uint16_t blocksCount, uint8_t blockBtWidth);
 
 int mf_chinese_set_uid(uint8_t *uid, uint8_t uidlen, const uint8_t *atqa, const uint8_t *sak, uint8_t *old_uid, uint8_t *verifed_uid, uint8_t wipecard, uint8_t gdm);
 int mf_chinese_wipe(uint8_t *uid, const uint8_t *atqa, const uint8_t *sak, uint8_t gdm);
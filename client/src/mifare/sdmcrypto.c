@@ -0,0 +1,174 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// NTAG 424 DNA Secure Dynamic Messaging (SUN message) verification, AES mode
+// description here: https://www.nxp.com/docs/en/application-note/AN12196.pdf
+//-----------------------------------------------------------------------------
+
+#include "sdmcrypto.h"
+#include <string.h>
+#include "commonutil.h"
+#include "pm3_cmd.h"
+
+static void SDMCMACSubkeys(const mbedtls_aes_context *aes, uint8_t *k1, uint8_t *k2) {
+    uint8_t l[CRYPTO_AES_BLOCK_SIZE] = {0};
+    mbedtls_aes_crypt_ecb((mbedtls_aes_context *)aes, MBEDTLS_AES_ENCRYPT, l, l);
+
+    bool msb = l[0] & 0x80;
+    for (int i = 0; i < CRYPTO_AES_BLOCK_SIZE; i++) {
+        k1[i] = (l[i] << 1) | ((i < CRYPTO_AES_BLOCK_SIZE - 1) ? (l[i + 1] >> 7) : 0);
+    }
+    if (msb) {
+        k1[CRYPTO_AES_BLOCK_SIZE - 1] ^= 0x87;
+    }
+
+    msb = k1[0] & 0x80;
+    for (int i = 0; i < CRYPTO_AES_BLOCK_SIZE; i++) {
+        k2[i] = (k1[i] << 1) | ((i < CRYPTO_AES_BLOCK_SIZE - 1) ? (k1[i + 1] >> 7) : 0);
+    }
+    if (msb) {
+        k2[CRYPTO_AES_BLOCK_SIZE - 1] ^= 0x87;
+    }
+}
+
+// AES CMAC (NIST SP 800-38B) with a ready key schedule
+static void SDMCMAC(const mbedtls_aes_context *aes, const uint8_t *k1, const uint8_t *k2, const uint8_t *data, size_t datalen, uint8_t *cmac) {
+    uint8_t x[CRYPTO_AES_BLOCK_SIZE] = {0};
+    size_t blocks = (datalen) ? (datalen + CRYPTO_AES_BLOCK_SIZE - 1) / CRYPTO_AES_BLOCK_SIZE : 1;
+
+    for (size_t i = 0; i < blocks - 1; i++) {
+        for (int j = 0; j < CRYPTO_AES_BLOCK_SIZE; j++) {
+            x[j] ^= data[(i * CRYPTO_AES_BLOCK_SIZE) + j];
+        }
+        mbedtls_aes_crypt_ecb((mbedtls_aes_context *)aes, MBEDTLS_AES_ENCRYPT, x, x);
+    }
+
+    // the last block is padded with 80 00.. and takes K2 when it is not a complete one
+    uint8_t last[CRYPTO_AES_BLOCK_SIZE] = {0};
+    size_t rest = datalen - ((blocks - 1) * CRYPTO_AES_BLOCK_SIZE);
+    if (rest) {
+        memcpy(last, &data[(blocks - 1) * CRYPTO_AES_BLOCK_SIZE], rest);
+    }
+
+    const uint8_t *k = k1;
+    if (rest < CRYPTO_AES_BLOCK_SIZE) {
+        last[rest] = 0x80;
+        k = k2;
+    }
+
+    for (int j = 0; j < CRYPTO_AES_BLOCK_SIZE; j++) {
+        x[j] ^= last[j] ^ k[j];
+    }
+    mbedtls_aes_crypt_ecb((mbedtls_aes_context *)aes, MBEDTLS_AES_ENCRYPT, x, cmac);
+}
+
+void SDMContextInit(SDMContext_t *ctx, const uint8_t *metareadkey, const uint8_t *filereadkey) {
+    mbedtls_aes_init(&ctx->metaread);
+    mbedtls_aes_setkey_dec(&ctx->metaread, metareadkey, CRYPTO_AES128_KEY_SIZE * 8);
+
+    mbedtls_aes_init(&ctx->fileread);
+    mbedtls_aes_setkey_enc(&ctx->fileread, filereadkey, CRYPTO_AES128_KEY_SIZE * 8);
+    SDMCMACSubkeys(&ctx->fileread, ctx->fileread_k1, ctx->fileread_k2);
+}
+
+void SDMContextFree(SDMContext_t *ctx) {
+    mbedtls_aes_free(&ctx->metaread);
+    mbedtls_aes_free(&ctx->fileread);
+    memset(ctx, 0, sizeof(SDMContext_t));
+}
+
+int SDMDecodePICCData(const SDMContext_t *ctx, const uint8_t *piccdata, SDMPICCData_t *picc) {
+    // one block, CBC with a zero IV is ECB here
+    uint8_t plain[SDM_PICC_DATA_SIZE];
+    mbedtls_aes_crypt_ecb((mbedtls_aes_context *)&ctx->metaread, MBEDTLS_AES_DECRYPT, piccdata, plain);
+
+    memset(picc, 0, sizeof(SDMPICCData_t));
+    picc->tag = plain[0];
+
+    size_t pos = 1;
+    if (picc->tag & SDM_PICC_TAG_UID) {
+        // only 7 byte UIDs are mirrored
+        if (SDM_PICC_TAG_UIDLEN(picc->tag) != 7) {
+            return PM3_EINVARG;
+        }
+        picc->uidlen = 7;
+        memcpy(picc->uid, &plain[pos], picc->uidlen);
+        pos += picc->uidlen;
+    }
+
+    if (picc->tag & SDM_PICC_TAG_READCTR) {
+        picc->has_readctr = true;
+        picc->readctr = MemLeToUint3byte(&plain[pos]);
+    }
+
+    // reserved bits must be zero, a wrong key gives random ones
+    if ((picc->tag & 0x30) || ((picc->tag & (SDM_PICC_TAG_UID | SDM_PICC_TAG_READCTR)) == 0)) {
+        return PM3_EINVARG;
+    }
+    return PM3_SUCCESS;
+}
+
+void SDMSessionMACKey(const SDMContext_t *ctx, const SDMPICCData_t *picc, uint8_t *sessionkey) {
+    // SV2 = 3C C3 00 01 00 80 [ || UID] [ || SDMReadCtr] [ || zero padding]
+    uint8_t sv2[CRYPTO_AES_BLOCK_SIZE * 2] = {0x3C, 0xC3, 0x00, 0x01, 0x00, 0x80};
+    size_t len = 6;
+
+    memcpy(&sv2[len], picc->uid, picc->uidlen);
+    len += picc->uidlen;
+
+    if (picc->has_readctr) {
+        Uint3byteToMemLe(&sv2[len], picc->readctr);
+        len += 3;
+    }
+
+    len = ((len + CRYPTO_AES_BLOCK_SIZE - 1) / CRYPTO_AES_BLOCK_SIZE) * CRYPTO_AES_BLOCK_SIZE;
+    SDMCMAC(&ctx->fileread, ctx->fileread_k1, ctx->fileread_k2, sv2, len, sessionkey);
+}
+
+void SDMCalcMAC(const uint8_t *sessionkey, const uint8_t *macinput, size_t macinputlen, uint8_t *mac) {
+    // the session key is new for every read counter, no point in keeping its schedule
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, sessionkey, CRYPTO_AES128_KEY_SIZE * 8);
+
+    uint8_t k1[CRYPTO_AES_BLOCK_SIZE], k2[CRYPTO_AES_BLOCK_SIZE];
+    SDMCMACSubkeys(&aes, k1, k2);
+
+    uint8_t cmac[CRYPTO_AES_BLOCK_SIZE];
+    SDMCMAC(&aes, k1, k2, macinput, macinputlen, cmac);
+    mbedtls_aes_free(&aes);
+
+    // MACt, the odd bytes
+    for (int i = 0; i < SDM_MAC_SIZE; i++) {
+        mac[i] = cmac[(i * 2) + 1];
+    }
+}
+
+int SDMVerify(const SDMContext_t *ctx, const uint8_t *piccdata, const uint8_t *macinput, size_t macinputlen,
+              const uint8_t *mac, SDMPICCData_t *picc) {
+
+    int res = SDMDecodePICCData(ctx, piccdata, picc);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    uint8_t sessionkey[CRYPTO_AES128_KEY_SIZE];
+    SDMSessionMACKey(ctx, picc, sessionkey);
+
+    uint8_t calc[SDM_MAC_SIZE];
+    SDMCalcMAC(sessionkey, macinput, macinputlen, calc);
+
+    return (memcmp(calc, mac, SDM_MAC_SIZE) == 0) ? PM3_SUCCESS : PM3_EFAILED;
+}
@@ -0,0 +1,65 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// NTAG 424 DNA Secure Dynamic Messaging (SUN message) verification, AES mode
+// description here: https://www.nxp.com/docs/en/application-note/AN12196.pdf
+//-----------------------------------------------------------------------------
+
+#ifndef __SDMCRYPTO_H
+#define __SDMCRYPTO_H
+
+#include "common.h"
+#include "crypto/libpcrypto.h"
+#include <mbedtls/aes.h>
+
+#define SDM_PICC_DATA_SIZE  CRYPTO_AES_BLOCK_SIZE
+#define SDM_MAC_SIZE        8
+
+// PICCDataTag
+#define SDM_PICC_TAG_UID        (1 << 7)
+#define SDM_PICC_TAG_READCTR    (1 << 6)
+#define SDM_PICC_TAG_UIDLEN(t)  ((t) & 0x0F)
+
+// Key schedules of one key pair, set up once. Verifying only reads the context,
+// so one context can be used by several threads at the same time.
+typedef struct {
+    mbedtls_aes_context metaread;   // K_SDMMetaRead, decrypts PICCData
+    mbedtls_aes_context fileread;   // K_SDMFileRead, session MAC key derivation
+    uint8_t fileread_k1[CRYPTO_AES_BLOCK_SIZE];
+    uint8_t fileread_k2[CRYPTO_AES_BLOCK_SIZE];
+} SDMContext_t;
+
+typedef struct {
+    uint8_t tag;
+    uint8_t uid[7];
+    size_t uidlen;      // 0 when the UID is not mirrored
+    bool has_readctr;
+    uint32_t readctr;
+} SDMPICCData_t;
+
+void SDMContextInit(SDMContext_t *ctx, const uint8_t *metareadkey, const uint8_t *filereadkey);
+void SDMContextFree(SDMContext_t *ctx);
+
+// PM3_EINVARG if the decrypted PICCDataTag is not a valid one (wrong K_SDMMetaRead)
+int SDMDecodePICCData(const SDMContext_t *ctx, const uint8_t *piccdata, SDMPICCData_t *picc);
+void SDMSessionMACKey(const SDMContext_t *ctx, const SDMPICCData_t *picc, uint8_t *sessionkey);
+void SDMCalcMAC(const uint8_t *sessionkey, const uint8_t *macinput, size_t macinputlen, uint8_t *mac);
+
+// decodes the encrypted PICCData and checks the SDMMAC over macinput
+// PM3_SUCCESS, PM3_EINVARG on bad PICCData, PM3_EFAILED on a MAC mismatch
+int SDMVerify(const SDMContext_t *ctx, const uint8_t *piccdata, const uint8_t *macinput, size_t macinputlen,
+              const uint8_t *mac, SDMPICCData_t *picc);
+
+#endif // __SDMCRYPTO_H
@@ -19,6 +19,7 @@
 #include "pm3.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "proxmark3.h"
 #include "cmdmain.h"
@@ -27,14 +28,24 @@
 #include "util_posix.h"
 #include "comms.h"
 #include "preferences.h"
+#include "mifare/mifarehost.h"
 
+static bool pm3_initialized = false;
+
+// Each call opens a new device, several Proxmark3 can be driven from one process.
+// The last opened device is selected, pm3_console selects the device it runs on.
 pm3_device_t *pm3_open(const char *port) {
-    pm3_init();
-    preferences_load();
-    OpenProxmark(&g_session.current_device, port, false, 20, false, USART_BAUD_RATE);
-    if (g_session.pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
+    if (pm3_initialized == false) {
+        pm3_init();
+        preferences_load();
+        pm3_initialized = true;
+    }
+
+    pm3_device_t *dev = NULL;
+    OpenProxmark(&dev, port, false, 20, false, USART_BAUD_RATE);
+    if (g_session.pm3_present && (TestProxmark(dev) != PM3_SUCCESS)) {
         PrintAndLogEx(ERR, _RED_("ERROR:") " cannot communicate with the Proxmark3\n");
-        CloseProxmark(g_session.current_device);
+        CloseProxmark(dev);
     }
 
     if ((port != NULL) && (!g_session.pm3_present))
@@ -43,11 +54,13 @@ pm3_device_t *pm3_open(const char *port) {
     if (!g_session.pm3_present) {
         PrintAndLogEx(INFO, _RED_("OFFLINE") " mode");
     }
-    // For now, there is no real device context:
-    return g_session.current_device;
+    return dev;
 }
 
 void pm3_close(pm3_device_t *dev) {
+    pm3_device_t *prev = g_session.current_device;
+    SelectProxmark(dev);
+
     // Clean up the port
     if (g_session.pm3_present) {
         clearCommandBuffer();
@@ -55,12 +68,17 @@ void pm3_close(pm3_device_t *dev) {
         msleep(100); // Make sure command is sent before killing client
         CloseProxmark(dev);
     }
-    free_grabber();
+    FreeProxmark(dev);
+
+    if (prev != dev) {
+        SelectProxmark(prev);
+    } else {
+        free_grabber();
+    }
 }
 
 int pm3_console(pm3_device_t *dev, const char *cmd, bool capture, bool quiet) {
-    // For now, there is no real device context:
-    (void) dev;
+    SelectProxmark(dev);
     uint8_t prev_printAndLog = g_printAndLog;
     if (capture) {
         g_printAndLog |= PRINTANDLOG_GRAB;
@@ -68,13 +86,16 @@ int pm3_console(pm3_device_t *dev, const char *cmd, bool capture, bool quiet) {
     if (quiet) {
         g_printAndLog &= ~PRINTANDLOG_PRINT;
     }
+    // commands add their structured results, fetched with pm3_result_get
+    g_printAndLog |= PRINTANDLOG_RESULT;
+    result_clear();
     int ret = CommandReceived(cmd);
     g_printAndLog = prev_printAndLog;
     return ret;
 }
 
 const char *pm3_name_get(pm3_device_t *dev) {
-    return dev->g_conn->serial_port_name;
+    return dev->conn->serial_port_name;
 }
 
 const char *pm3_grabbed_output_get(pm3_device_t *dev) {
@@ -89,6 +110,172 @@ const char *pm3_grabbed_output_get(pm3_device_t *dev) {
     }
 }
 
+// JSON object with the results of the last pm3_console call
+const char *pm3_result_get(pm3_device_t *dev) {
+    (void) dev;
+    return result_get();
+}
+
 pm3_device_t *pm3_get_current_dev(void) {
     return g_session.current_device;
 }
+
+// Last completed async reply, as fetched by pm3_async_poll / pm3_async_wait
+static PacketResponseNG async_last_resp;
+static char async_last_hex[(PM3_CMD_DATA_SIZE * 2) + 1];
+
+// returns ticket number (> 0), or negative on error
+int pm3_async_send(pm3_device_t *dev, uint16_t cmd, const char *data, size_t len, uint16_t reply_cmd) {
+    SelectProxmark(dev);
+    if (g_session.pm3_present == false) {
+        return PM3_ENOTTY;
+    }
+    if (len > PM3_CMD_DATA_SIZE) {
+        return PM3_EINVARG;
+    }
+
+    uint8_t buf[PM3_CMD_DATA_SIZE] = {0};
+    if (data && len) {
+        memcpy(buf, data, len);
+    }
+
+    uint32_t ticket = SendCommandNGAsync(cmd, buf, len, reply_cmd, NULL, NULL);
+    if (ticket == 0) {
+        return PM3_EOVFLOW;
+    }
+    return (int)(ticket & 0x7FFFFFFF);
+}
+
+// returns 1 if the reply arrived, 0 if still pending, negative on error
+int pm3_async_poll(pm3_device_t *dev, int ticket) {
+    SelectProxmark(dev);
+    int res = PollAsyncReply(ticket, &async_last_resp);
+    if (res == PM3_ENODATA) {
+        return 0;
+    }
+    return (res == PM3_SUCCESS) ? 1 : res;
+}
+
+// returns 1 if the reply arrived, negative on timeout / error
+int pm3_async_wait(pm3_device_t *dev, int ticket, int timeout) {
+    SelectProxmark(dev);
+    int res = WaitForAsyncReply(ticket, &async_last_resp, (timeout < 0) ? (size_t) - 1 : (size_t)timeout);
+    return (res == PM3_SUCCESS) ? 1 : res;
+}
+
+// device status of the last fetched reply
+int pm3_async_status(pm3_device_t *dev) {
+    (void) dev;
+    return async_last_resp.status;
+}
+
+// payload of the last fetched reply, as hex string
+const char *pm3_async_data_get(pm3_device_t *dev) {
+    (void) dev;
+    size_t len = MIN(async_last_resp.length, PM3_CMD_DATA_SIZE);
+    for (size_t i = 0; i < len; i++) {
+        snprintf(async_last_hex + (i * 2), 3, "%02X", async_last_resp.data.asBytes[i]);
+    }
+    async_last_hex[len * 2] = 0;
+    return async_last_hex;
+}
+
+void pm3_async_cancel(pm3_device_t *dev, int ticket) {
+    SelectProxmark(dev);
+    CancelAsyncReply(ticket);
+}
+
+// Sends a command without waiting for a reply
+int pm3_send(pm3_device_t *dev, uint16_t cmd, const char *data, size_t len) {
+    SelectProxmark(dev);
+    if (g_session.pm3_present == false) {
+        return PM3_ENOTTY;
+    }
+    if (len > PM3_CMD_DATA_SIZE) {
+        return PM3_EINVARG;
+    }
+    clearCommandBuffer();
+    SendCommandNG(cmd, (uint8_t *)data, len);
+    return PM3_SUCCESS;
+}
+
+// Sends a command and waits for the reply with the same command number.
+// Returns the device status, the reply is fetched like an async one with pm3_reply_get
+int pm3_exchange(pm3_device_t *dev, uint16_t cmd, const char *data, size_t len, int timeout) {
+    int res = pm3_send(dev, cmd, data, len);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    if (WaitForResponseTimeout(cmd, &async_last_resp, (timeout < 0) ? (size_t) - 1 : (size_t)timeout) == false) {
+        return PM3_ETIMEOUT;
+    }
+    return async_last_resp.status;
+}
+
+// payload of the last fetched reply as binary, returns its length
+int pm3_reply_get(pm3_device_t *dev, char *buf, size_t size) {
+    (void) dev;
+    size_t len = MIN(async_last_resp.length, PM3_CMD_DATA_SIZE);
+    memcpy(buf, async_last_resp.data.asBytes, MIN(len, size));
+    return (int)len;
+}
+
+static bool pm3_memtype(int mem, DeviceMemType_t *memtype) {
+    switch (mem) {
+        case PM3_MEM_BIGBUF:
+            *memtype = BIG_BUF;
+            return true;
+        case PM3_MEM_EML:
+            *memtype = BIG_BUF_EML;
+            return true;
+        case PM3_MEM_FLASH:
+            *memtype = FLASH_MEM;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Bulk download of device memory into buf, in one windowed transfer
+int pm3_mem_read(pm3_device_t *dev, int mem, uint32_t offset, char *buf, size_t size) {
+    SelectProxmark(dev);
+    if (g_session.pm3_present == false) {
+        return PM3_ENOTTY;
+    }
+    DeviceMemType_t memtype;
+    if (pm3_memtype(mem, &memtype) == false || size > UINT32_MAX) {
+        return PM3_EINVARG;
+    }
+    if (GetFromDevice(memtype, (uint8_t *)buf, size, offset, NULL, 0, NULL, 2500, false) == false) {
+        return PM3_ETIMEOUT;
+    }
+    return PM3_SUCCESS;
+}
+
+// Bulk upload of MIFARE Classic blocks to emulator memory. A whole image from block 0 only
+// sends the blocks that changed since the last upload, see mf_eml_upload
+int pm3_mf_eml_write(pm3_device_t *dev, int block, const char *data, size_t len) {
+    SelectProxmark(dev);
+    if (g_session.pm3_present == false) {
+        return PM3_ENOTTY;
+    }
+    if (block < 0 || (len % MFBLOCK_SIZE) || (block + (len / MFBLOCK_SIZE)) > MIFARE_4K_MAXBLOCK) {
+        return PM3_EINVARG;
+    }
+
+    uint16_t count = len / MFBLOCK_SIZE;
+    if (block == 0) {
+        return mf_eml_upload((uint8_t *)data, count, MFBLOCK_SIZE);
+    }
+
+    // the jumbo payload limit applies per command
+    uint16_t chunk = MIN((GetJumboPayloadSize() - 4) / MFBLOCK_SIZE, 0xFF);
+    for (uint16_t i = 0; i < count; i += chunk) {
+        uint16_t n = MIN(chunk, count - i);
+        int res = mf_eml_set_mem_xt((uint8_t *)data + (i * MFBLOCK_SIZE), block + i, n, MFBLOCK_SIZE);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+    }
+    return PM3_SUCCESS;
+}
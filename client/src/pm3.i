@@ -9,6 +9,33 @@
 %rename("%(strip:[pm3_])s") "";
 %feature("immutable","1") pm3_current_dev;
 
+/* async_send takes a binary string: bytes in Python, string in Lua */
+%apply (char *STRING, size_t LENGTH) { (const char *data, size_t len) };
+
+/* reply_get and mem_read fill a caller buffer: any writable buffer (bytearray, memoryview, numpy)
+   in Python, no copy through a str. Lua takes the size and gets a string back */
+#ifdef SWIGPYTHON
+%include <pybuffer.i>
+%pybuffer_mutable_binary(char *buf, size_t size);
+#endif
+#ifdef SWIGLUA
+%typemap(in, numinputs=1) (char *buf, size_t size) {
+    $2 = (size_t)luaL_checkinteger(L, $input);
+    $1 = calloc(($2) ? $2 : 1, sizeof(char));
+}
+%typemap(argout) (char *buf, size_t size) {
+    lua_pushlstring(L, $1, $2);
+    SWIG_arg++;
+}
+%typemap(freearg) (char *buf, size_t size) {
+    free($1);
+}
+#endif
+
+%constant int MEM_BIGBUF = PM3_MEM_BIGBUF;
+%constant int MEM_EML = PM3_MEM_EML;
+%constant int MEM_FLASH = PM3_MEM_FLASH;
+
 #ifdef PYWRAP
     #include <Python.h>
     %typemap(default) bool capture {
@@ -41,8 +68,20 @@ typedef struct {
             }
         }
         int console(char *cmd, bool capture = true, bool quiet = true);
+        int async_send(uint16_t cmd, const char *data, size_t len, uint16_t reply_cmd);
+        int async_poll(int ticket);
+        int async_wait(int ticket, int timeout = -1);
+        int async_status(void);
+        void async_cancel(int ticket);
+        int send(uint16_t cmd, const char *data, size_t len);
+        int exchange(uint16_t cmd, const char *data, size_t len, int timeout = 2500);
+        int reply_get(char *buf, size_t size);
+        int mem_read(int mem, uint32_t offset, char *buf, size_t size);
+        int mf_eml_write(int block, const char *data, size_t len);
         char const * const name;
         char const * const grabbed_output;
+        char const * const result;
+        char const * const async_data;
     }
 } pm3;
 //%nodefaultctor device;
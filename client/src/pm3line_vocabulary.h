@@ -45,6 +45,7 @@ const static vocabulary_t vocabulary[] = {
     { 1, "prefs get client.debug" },
     { 1, "prefs get client.delay" },
     { 1, "prefs get client.timeout" },
+    { 1, "prefs get client.stats" },
     { 1, "prefs get color" },
     { 1, "prefs get savepaths" },
     { 1, "prefs get emoji" },
@@ -57,6 +58,7 @@ const static vocabulary_t vocabulary[] = {
     { 1, "prefs set client.debug" },
     { 1, "prefs set client.delay" },
     { 1, "prefs set client.timeout" },
+    { 1, "prefs set client.stats" },
     { 1, "prefs set color" },
     { 1, "prefs set emoji" },
     { 1, "prefs set hints" },
@@ -76,6 +78,7 @@ const static vocabulary_t vocabulary[] = {
     { 1, "analyse freq" },
     { 1, "analyse foo" },
     { 1, "analyse units" },
+    { 1, "analyse bench" },
     { 1, "data help" },
     { 1, "data clear" },
     { 1, "data hide" },
@@ -548,6 +551,7 @@ const static vocabulary_t vocabulary[] = {
     { 0, "hf xerox rdbl" },
     { 1, "hw help" },
     { 0, "hw detectreader" },
+    { 1, "hw stats" },
     { 0, "hw status" },
     { 0, "hw tearoff" },
     { 1, "hw timeout" },
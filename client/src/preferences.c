@@ -115,6 +115,7 @@ int preferences_load(void) {
     g_session.overlay_sliders = true;
     g_session.show_hints = true;
     g_session.dense_output = false;
+    g_session.client_stats = false;
 
     g_session.bar_mode = STYLE_VALUE;
     setDefaultPath(spDefault, "");
@@ -329,6 +330,7 @@ void preferences_save_callback(json_t *root) {
     */
     JsonSaveInt(root, "client.exe.delay", g_session.client_exe_delay);
     JsonSaveInt(root, "client.timeout", g_session.timeout);
+    JsonSaveBoolean(root, "client.stats", g_session.client_stats);
 
     // MQTT
     JsonSaveStr(root, "mqtt.server", g_session.mqtt_server);
@@ -436,6 +438,10 @@ void preferences_load_callback(json_t *root) {
     if (json_unpack_ex(root, &up_error, 0, "{s:i}", "client.exe.delay", &i1) == 0)
         g_session.client_exe_delay = i1;
 
+    // client per command stats
+    if (json_unpack_ex(root, &up_error, 0, "{s:b}", "client.stats", &b1) == 0)
+        g_session.client_stats = (bool)b1;
+
     // client command timeout
     if (json_unpack_ex(root, &up_error, 0, "{s:i}", "client.timeout", &i1) == 0)
         g_session.timeout = i1;
@@ -632,6 +638,13 @@ static void showHintsState(prefShowOpt_t opt) {
                  );
 }
 
+static void showClientStatsState(prefShowOpt_t opt) {
+    PrintAndLogEx(INFO, "   %s command stats........... %s"
+                  , pref_show_status_msg(opt)
+                  , (g_session.client_stats) ? pref_show_value(opt, "on") : pref_show_value(opt, "off")
+                 );
+}
+
 static void showPlotSliderState(prefShowOpt_t opt) {
     PrintAndLogEx(INFO, "   %s show plot sliders....... %s"
                   , pref_show_status_msg(opt)
@@ -1111,6 +1124,51 @@ static int setCmdHint(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int setCmdClientStats(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "prefs set client.stats",
+                  "Set persistent preference of collecting per command timing and traffic.\n"
+                  "When on, every command prints its wall time, time spent waiting for the device,\n"
+                  "round trips and bytes, and the totals are listed by `hw stats`",
+                  "prefs set client.stats --on"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "off", "don't collect command stats"),
+        arg_lit0(NULL, "on", "collect command stats"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool use_off = arg_get_lit(ctx, 1);
+    bool use_on = arg_get_lit(ctx, 2);
+    CLIParserFree(ctx);
+
+    if ((use_off + use_on) > 1) {
+        PrintAndLogEx(FAILED, "Can only set one option");
+        return PM3_EINVARG;
+    }
+
+    bool new_value = g_session.client_stats;
+    if (use_off) {
+        new_value = false;
+    }
+    if (use_on) {
+        new_value = true;
+    }
+
+    if (g_session.client_stats != new_value) {
+        showClientStatsState(prefShowOLD);
+        g_session.client_stats = new_value;
+        showClientStatsState(prefShowNEW);
+        preferences_save();
+    } else {
+        showClientStatsState(prefShowNone);
+    }
+
+    return PM3_SUCCESS;
+}
+
 static int setCmdPlotSliders(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "prefs set plotsliders",
@@ -1387,6 +1445,22 @@ static int getCmdHint(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int getCmdClientStats(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "prefs get client.stats",
+                  "Get preference of collecting per command timing and traffic",
+                  "prefs get client.stats"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    CLIParserFree(ctx);
+    showClientStatsState(prefShowNone);
+    return PM3_SUCCESS;
+}
+
 static int getCmdColor(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "prefs get color",
@@ -1540,6 +1614,7 @@ static command_t CommandTableGet[] = {
     {"client.debug",     getCmdDebug,         AlwaysAvailable, "Get client debug level preference"},
     {"client.delay",     getCmdExeDelay,      AlwaysAvailable, "Get client execution delay preference"},
     {"client.timeout",   getCmdClientTimeout, AlwaysAvailable, "Get client execution delay preference"},
+    {"client.stats",     getCmdClientStats,   AlwaysAvailable, "Get client command stats preference"},
     {"color",            getCmdColor,         AlwaysAvailable, "Get color support preference"},
     {"savepaths",        getCmdSavePaths,     AlwaysAvailable, "Get file folder  "},
     //  {"devicedebug",      getCmdDeviceDebug,   AlwaysAvailable, "Get device debug level"},
@@ -1557,6 +1632,7 @@ static command_t CommandTableSet[] = {
     {"client.debug",     setCmdDebug,         AlwaysAvailable, "Set client debug level"},
     {"client.delay",     setCmdExeDelay,      AlwaysAvailable, "Set client execution delay"},
     {"client.timeout",   setCmdClientTimeout, AlwaysAvailable, "Set client communication timeout"},
+    {"client.stats",     setCmdClientStats,   AlwaysAvailable, "Set client command stats collection"},
 
     {"color",            setCmdColor,         AlwaysAvailable, "Set color support"},
     {"emoji",            setCmdEmoji,         AlwaysAvailable, "Set emoji display"},
@@ -1630,6 +1706,7 @@ static int CmdPrefShow(const char *Cmd) {
     showClientExeDelayState();
     showOutputState(prefShowNone);
     showClientTimeoutState();
+    showClientStatsState(prefShowNone);
     showMqttServer(prefShowNone);
     showMqttPort(prefShowNone);
     showMqttTopic(prefShowNone);
@@ -20,6 +20,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <iostream>
+#include <atomic>
 //#include <QtCore>
 #include <QPainterPath>
 #include <QBrush>
@@ -50,12 +51,24 @@ static uint32_t startMax; // Maximum offset in the graph (right side of graph)
 static uint32_t startMaxOld;
 static uint32_t PageWidth; // How many samples are currently visible on this 'page' / graph
 static int unlockStart = 0;
+// a repaint is queued and not yet handled, later requests are folded into it
+static std::atomic<bool> gs_repaintPending(false);
+// min / max summaries of the graph and the overlay, for zoomed out plots
+static graph_mipmap_t gs_mipmap[2];
+
+static const graph_mipmap_t *plotMipmap(const int *buffer, size_t len) {
+    const graph_mipmap_t *m = &gs_mipmap[(buffer == g_OverlayBuffer) ? 1 : 0];
+    return (m->copy != NULL && m->len == len) ? m : NULL;
+}
 
 void ProxGuiQT::ShowGraphWindow(void) {
     emit ShowGraphWindowSignal();
 }
 
 void ProxGuiQT::RepaintGraphWindow(void) {
+    if (gs_repaintPending.exchange(true)) {
+        return;
+    }
     emit RepaintGraphWindowSignal();
 }
 
@@ -101,6 +114,7 @@ void ProxGuiQT::_ShowGraphWindow(void) {
 }
 
 void ProxGuiQT::_RepaintGraphWindow(void) {
+    gs_repaintPending = false;
     if (!plotapp || !plotwidget)
         return;
 
@@ -514,6 +528,20 @@ int Plot::xCoordOf(int i, QRect r) {
     return r.left() + (int)((i - g_GraphStart) * g_GraphPixelsPerPoint);
 }
 
+// first sample right of the plot, or len
+uint32_t Plot::visibleEnd(size_t len, QRect r) {
+    uint32_t lo = g_GraphStart, hi = len;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (xCoordOf(mid, r) < r.right()) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
 int Plot::yCoordOf(int v, QRect r, int maxVal) {
     int z = (r.bottom() - r.top()) / 2;
     if (maxVal == 0) {
@@ -577,12 +605,19 @@ void Plot::setMaxAndStart(int *buffer, size_t len, QRect plotRect) {
     }
 
     int vMin = INT_MAX, vMax = INT_MIN;
-    uint32_t sample_index = g_GraphStart ;
-    for (; sample_index < len && xCoordOf(sample_index, plotRect) < plotRect.right() ; sample_index++) {
+    const graph_mipmap_t *m = plotMipmap(buffer, len);
+    if (m != NULL) {
+        graph_range_t r = graph_mipmap_range(m, g_GraphStart, visibleEnd(len, plotRect));
+        vMin = r.min;
+        vMax = r.max;
+    } else {
+        uint32_t sample_index = g_GraphStart ;
+        for (; sample_index < len && xCoordOf(sample_index, plotRect) < plotRect.right() ; sample_index++) {
 
-        int v = buffer[sample_index];
-        if (v < vMin) vMin = v;
-        if (v > vMax) vMax = v;
+            int v = buffer[sample_index];
+            if (v < vMin) vMin = v;
+            if (v > vMax) vMax = v;
+        }
     }
 
     gs_absVMax = 0;
@@ -692,22 +727,52 @@ void Plot::PlotGraph(int *buffer, size_t len, QRect plotRect, QRect annotationRe
     int x = xCoordOf(g_GraphStart, plotRect);
     int y = yCoordOf(buffer[g_GraphStart], plotRect, gs_absVMax);
     penPath.moveTo(x, y);
-    for (i = g_GraphStart; i < len && xCoordOf(i, plotRect) < plotRect.right(); i++) {
 
-        x = xCoordOf(i, plotRect);
-        v = buffer[i];
-        y = yCoordOf(v, plotRect, gs_absVMax);
+    // several samples per pixel, draw each pixel column from its max to its min
+    const graph_mipmap_t *m = (g_GraphPixelsPerPoint < 1) ? plotMipmap(buffer, len) : NULL;
+    if (m != NULL) {
+        uint32_t stop = visibleEnd(len, plotRect);
+        for (i = g_GraphStart; i < stop;) {
+            x = xCoordOf(i, plotRect);
+            uint32_t next = g_GraphStart + (uint32_t)((x - plotRect.left() + 1) / g_GraphPixelsPerPoint);
+            if (next <= i) {
+                next = i + 1;
+            }
+            while (next < stop && xCoordOf(next, plotRect) == x) {
+                next++;
+            }
+            while (next > i + 1 && xCoordOf(next - 1, plotRect) > x) {
+                next--;
+            }
+            next = MIN(next, stop);
+
+            graph_range_t r = graph_mipmap_range(m, i, next);
+            penPath.lineTo(x, yCoordOf(r.max, plotRect, gs_absVMax));
+            penPath.lineTo(x, yCoordOf(r.min, plotRect, gs_absVMax));
+            i = next;
+        }
+        graph_range_t r = graph_mipmap_range(m, g_GraphStart, stop);
+        vMin = r.min;
+        vMax = r.max;
+        vMean = r.sum;
+    } else {
+        for (i = g_GraphStart; i < len && xCoordOf(i, plotRect) < plotRect.right(); i++) {
 
-        penPath.lineTo(x, y);
+            x = xCoordOf(i, plotRect);
+            v = buffer[i];
+            y = yCoordOf(v, plotRect, gs_absVMax);
 
-        if (g_GraphPixelsPerPoint > 10) {
-            QRect f(QPoint(x - 3, y - 3), QPoint(x + 3, y + 3));
-            painter->fillRect(f, GREEN);
+            penPath.lineTo(x, y);
+
+            if (g_GraphPixelsPerPoint > 10) {
+                QRect f(QPoint(x - 3, y - 3), QPoint(x + 3, y + 3));
+                painter->fillRect(f, GREEN);
+            }
+            // catch stats
+            if (v < vMin) vMin = v;
+            if (v > vMax) vMax = v;
+            vMean += v;
         }
-        // catch stats
-        if (v < vMin) vMin = v;
-        if (v > vMax) vMax = v;
-        vMean += v;
     }
 
     g_GraphStop = i;
@@ -1016,6 +1081,12 @@ void Plot::paintEvent(QPaintEvent *event) {
     //Black foreground
     painter.fillRect(plotRect, BLACK);
 
+    // catch up with whatever changed in the buffers since the last paint
+    graph_mipmap_update(&gs_mipmap[0], g_GraphBuffer, g_GraphTraceLen);
+    if (g_useOverlays) {
+        graph_mipmap_update(&gs_mipmap[1], g_OverlayBuffer, g_GraphTraceLen);
+    }
+
     //init graph variables
     setMaxAndStart(g_GraphBuffer, g_GraphTraceLen, plotRect);
     //appendMax(g_OperationBuffer, g_GraphTraceLen, plotRect);
@@ -52,6 +52,7 @@ class Plot: public QWidget {
     void drawAnnotations(QRect annotationRect, QPainter *painter);
     void draw_marker(marker_t marker, QRect plotRect, QColor color, QPainter *painter);
     int xCoordOf(int i, QRect r);
+    uint32_t visibleEnd(size_t len, QRect r);
     int yCoordOf(int v, QRect r, int maxVal);
     int valueOf_yCoord(int y, QRect r, int maxVal);
     void setMaxAndStart(int *buffer, size_t len, QRect plotRect);
@@ -36,9 +36,17 @@
 #include "flash.h"
 #include "preferences.h"
 #include "commonutil.h"
+#include "uart/uart.h"     // uart_record_start
 
 #ifndef _WIN32
 #include <locale.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "jansson.h"
 #endif
 
 static int mainret = PM3_SUCCESS;
@@ -604,6 +612,242 @@ check_script:
 }
 
 #ifndef LIBPM3
+#if !defined(_WIN32)
+// Daemon mode: the client keeps the device open and runs the commands it gets on a local
+// socket, one command per line. Every command is answered with one JSON line
+//   {"status":0,"output":"...","result":{...}}
+// with the captured output and the structured results. Commands of all connected clients
+// are run one at a time, in the order their lines arrive.
+#define DAEMON_MAX_CLIENTS  16
+#define DAEMON_MAX_LINE     4096
+
+typedef struct {
+    int fd;
+    size_t len;
+    char buf[DAEMON_MAX_LINE];
+} daemon_client_t;
+
+static volatile sig_atomic_t daemon_stop = 0;
+
+static void daemon_signal(int sig) {
+    (void) sig;
+    daemon_stop = 1;
+}
+
+// "tcp:<port>" or "tcp:<ip>:<port>", local only unless an address is given. Anything else is a UNIX socket path
+static int daemon_listen(const char *addr) {
+    int fd;
+    if (strncmp(addr, "tcp:", 4) == 0) {
+        const char *host = "127.0.0.1";
+        char hostbuf[64] = {0};
+        const char *port = addr + 4;
+        const char *colon = strrchr(port, ':');
+        if (colon) {
+            snprintf(hostbuf, sizeof(hostbuf), "%.*s", (int)(colon - port), port);
+            host = hostbuf;
+            port = colon + 1;
+        }
+
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((uint16_t)strtoul(port, NULL, 10));
+        if (inet_pton(AF_INET, host, &sa.sin_addr) != 1) {
+            PrintAndLogEx(ERR, "invalid address " _YELLOW_("%s"), host);
+            return -1;
+        }
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        struct sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        if (strlen(addr) >= sizeof(sa.sun_path)) {
+            PrintAndLogEx(ERR, "socket path too long");
+            return -1;
+        }
+        strcpy(sa.sun_path, addr);
+        unlink(addr);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (listen(fd, DAEMON_MAX_CLIENTS) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool daemon_send(int fd, const char *data, size_t len) {
+    while (len) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// runs one command with its output captured, false when the client is to be dropped
+static bool daemon_command(int fd, char *cmd) {
+    str_cleanrn(cmd, strlen(cmd) + 1);
+    if (cmd[0] == '\0') {
+        return true;
+    }
+
+    uint8_t prev_printAndLog = g_printAndLog;
+    g_printAndLog = PRINTANDLOG_GRAB | PRINTANDLOG_RESULT;
+    result_clear();
+    g_pendingPrompt = false;
+    int ret = CommandReceived(cmd);
+    g_printAndLog = prev_printAndLog;
+
+    // quit / exit only end this connection
+    if (ret == PM3_SQUIT || ret == PM3_EFATAL) {
+        return false;
+    }
+
+    const char *output = "";
+    if (g_grabbed_output.ptr) {
+        g_grabbed_output.ptr[g_grabbed_output.idx] = '\0';
+        output = g_grabbed_output.ptr;
+    }
+
+    json_t *out = json_string(output);
+    char *out_str = json_dumps(out, JSON_ENCODE_ANY);
+    json_decref(out);
+    g_grabbed_output.idx = 0;
+
+    bool ok = false;
+    const char *res = result_get();
+    size_t len = strlen(res) + ((out_str) ? strlen(out_str) : 2) + 48;
+    char *line = calloc(len, sizeof(char));
+    if (line) {
+        int n = snprintf(line, len, "{\"status\":%d,\"output\":%s,\"result\":%s}\n", ret, (out_str) ? out_str : "\"\"", res);
+        ok = daemon_send(fd, line, n);
+        free(line);
+    }
+    free(out_str);
+    return ok;
+}
+
+static int daemon_loop(const char *addr) {
+    int lfd = daemon_listen(addr);
+    if (lfd < 0) {
+        PrintAndLogEx(ERR, "cannot listen on " _YELLOW_("%s"), addr);
+        return PM3_EFILE;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, daemon_signal);
+    signal(SIGTERM, daemon_signal);
+
+    PrintAndLogEx(SUCCESS, "Daemon listening on " _YELLOW_("%s") ", stop it with Ctrl-C", addr);
+
+    daemon_client_t *clients = calloc(DAEMON_MAX_CLIENTS, sizeof(daemon_client_t));
+    if (clients == NULL) {
+        close(lfd);
+        return PM3_EMALLOC;
+    }
+    for (int i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+
+    struct pollfd pfd[DAEMON_MAX_CLIENTS + 1];
+    while (daemon_stop == 0) {
+        nfds_t n = 0;
+        pfd[n].fd = lfd;
+        pfd[n++].events = POLLIN;
+        for (int i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+            pfd[n].fd = clients[i].fd;
+            pfd[n++].events = POLLIN;
+        }
+
+        if (poll(pfd, n, 500) <= 0) {
+            continue;
+        }
+
+        // new connections wait in the listen backlog while all slots are busy
+        if (pfd[0].revents & POLLIN) {
+            for (int i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+                if (clients[i].fd < 0) {
+                    clients[i].fd = accept(lfd, NULL, NULL);
+                    clients[i].len = 0;
+                    break;
+                }
+            }
+        }
+
+        for (int i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+            daemon_client_t *c = &clients[i];
+            if (c->fd < 0 || (pfd[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+                continue;
+            }
+
+            ssize_t got = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+            bool keep = (got > 0);
+            if (keep) {
+                c->len += got;
+                c->buf[c->len] = '\0';
+            }
+
+            // one command per complete line
+            char *nl;
+            while (keep && (nl = strchr(c->buf, '\n')) != NULL) {
+                *nl = '\0';
+                keep = daemon_command(c->fd, c->buf);
+                size_t used = (nl - c->buf) + 1;
+                memmove(c->buf, nl + 1, c->len - used + 1);
+                c->len -= used;
+            }
+
+            // a line longer than any command
+            if (c->len == sizeof(c->buf) - 1) {
+                keep = false;
+            }
+
+            if (keep == false) {
+                close(c->fd);
+                c->fd = -1;
+            }
+        }
+    }
+
+    for (int i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            close(clients[i].fd);
+        }
+    }
+    free(clients);
+    close(lfd);
+    if (strncmp(addr, "tcp:", 4) != 0) {
+        unlink(addr);
+    }
+
+    PrintAndLogEx(INFO, "Daemon stopped");
+    return PM3_SUCCESS;
+}
+#endif
+
 static void dumpAllHelp(int markdown, bool full_help) {
     g_session.help_dump_mode = true;
     PrintAndLogEx(NORMAL, "\n%sProxmark3 command dump%s\n\n", markdown ? "# " : "", markdown ? "" : "\n======================");
@@ -710,7 +954,7 @@ static void show_help(bool showFullHelp, char *exec_name) {
 #else // HAVE_PYTHON
     PrintAndLogEx(NORMAL, "        %s [[-p] <port>] [-b] [-w] [-f] [-c <command>]|[-l <lua_script_file>]|[-s <cmd_script_file>] [-i] [-d <0|1|2>]", exec_name);
 #endif // HAVE_PYTHON
-    PrintAndLogEx(NORMAL, "        %s [-p] <port> --flash [--unlock-bootloader] [--image <imagefile>]+ [-w] [-f] [-d <0|1|2>]", exec_name);
+    PrintAndLogEx(NORMAL, "        %s [-p] <port> --flash [--unlock-bootloader] [--verify] [--image <imagefile>]+ [-w] [-f] [-d <0|1|2>]", exec_name);
 
     if (showFullHelp) {
 
@@ -735,13 +979,19 @@ static void show_help(bool showFullHelp, char *exec_name) {
         PrintAndLogEx(NORMAL, "      -s/--script-file <cmd_script_file>  script file with one Proxmark3 command per line");
         PrintAndLogEx(NORMAL, "      -i/--interactive                    enter interactive mode after executing the script or the command");
         PrintAndLogEx(NORMAL, "      --incognito                         do not use history, prefs file nor log files");
+        PrintAndLogEx(NORMAL, "      --cached-caps                       reuse the device capabilities saved by a previous run on the same port");
         PrintAndLogEx(NORMAL, "      --ncpu <num_cores>                  override number of CPU cores");
+        PrintAndLogEx(NORMAL, "      --record <file>                     record the device traffic, replay it with -p replay:<file>");
+#if !defined(_WIN32)
+        PrintAndLogEx(NORMAL, "      --daemon <socket>|tcp:[ip:]<port>   keep the device open and run commands sent over a local socket");
+#endif
         PrintAndLogEx(NORMAL, "\nOptions in flasher mode:");
         PrintAndLogEx(NORMAL, "      --flash                             flash Proxmark3, requires at least one --image");
         PrintAndLogEx(NORMAL, "      --reboot-to-bootloader              reboot Proxmark3 into bootloader mode");
         PrintAndLogEx(NORMAL, "      --unlock-bootloader                 Enable flashing of bootloader area *DANGEROUS* (need --flash)");
         PrintAndLogEx(NORMAL, "      --force                             Enable flashing even if firmware seems to not match client version");
         PrintAndLogEx(NORMAL, "      --image <imagefile>                 image to flash. Can be specified several times.");
+        PrintAndLogEx(NORMAL, "      --verify                            only compare flash with the images, using bootloader CRCs (need --flash)");
         PrintAndLogEx(NORMAL, "\nOptions in memory dump mode:");
         PrintAndLogEx(NORMAL, "      --dumpmem <dumpfile>                dumps Proxmark3 flash memory to file");
         PrintAndLogEx(NORMAL, "      --dumpaddr <address>                starting address for dump, default 0");
@@ -759,6 +1009,8 @@ static void show_help(bool showFullHelp, char *exec_name) {
         PrintAndLogEx(NORMAL, "      %s "SERIAL_PORT_EXAMPLE_H" -s mycmds.txt         -- execute each pm3 cmd in file and quit client", exec_name);
         PrintAndLogEx(NORMAL, "\n  to flash fullimage and bootloader:\n");
         PrintAndLogEx(NORMAL, "      %s "SERIAL_PORT_EXAMPLE_H" --flash --unlock-bootloader --image bootrom.elf --image fullimage.elf", exec_name);
+        PrintAndLogEx(NORMAL, "\n  to check a flashed device without writing it:\n");
+        PrintAndLogEx(NORMAL, "      %s "SERIAL_PORT_EXAMPLE_H" --flash --verify --image bootrom.elf --image fullimage.elf", exec_name);
 #ifdef __linux__
         PrintAndLogEx(NORMAL, "\nNote (Linux):\nif the flasher gets stuck in 'Waiting for Proxmark3 to reappear on <DEVICE>',");
         PrintAndLogEx(NORMAL, "you need to blacklist Proxmark3 for modem-manager - see documentation for more details:");
@@ -848,7 +1100,7 @@ static int dumpmem_pm3(char *serial_port_name, const char *filename, uint32_t ad
 finish2:
     clearCommandBuffer();
     if (in_bootloader) {
-        g_session.current_device->g_conn->run = false;
+        g_session.current_device->conn->run = false;
         SendCommandOLD(CMD_PING, 0, 0, 0, NULL, 0);
     } else {
         SendCommandNG(CMD_QUIT_SESSION, NULL, 0);
@@ -867,7 +1119,7 @@ finish:
     return ret;
 }
 
-static int flash_pm3(char *serial_port_name, uint8_t num_files, const char *filenames[FLASH_MAX_FILES], bool can_write_bl, bool force) {
+static int flash_pm3(char *serial_port_name, uint8_t num_files, const char *filenames[FLASH_MAX_FILES], bool can_write_bl, bool force, bool verify_only) {
 
     int ret = PM3_EUNDEF;
     flash_file_t files[FLASH_MAX_FILES];
@@ -927,17 +1179,18 @@ static int flash_pm3(char *serial_port_name, uint8_t num_files, const char *file
     }
 
     for (int i = 0 ; i < num_files; ++i) {
-        ret = flash_prepare(&files[i], can_write_bl, max_allowed * ONE_KB);
+        // verifying a bootloader image doesn't write it, no need to unlock
+        ret = flash_prepare(&files[i], can_write_bl || verify_only, max_allowed * ONE_KB);
         if (ret != PM3_SUCCESS) {
             goto finish;
         }
         PrintAndLogEx(NORMAL, "");
     }
 
-    PrintAndLogEx(SUCCESS, _CYAN_("Flashing..."));
+    PrintAndLogEx(SUCCESS, _CYAN_("%s"), (verify_only) ? "Verifying..." : "Flashing...");
 
     for (int i = 0; i < num_files; i++) {
-        ret = flash_write(&files[i]);
+        ret = (verify_only) ? flash_verify(&files[i]) : flash_write(&files[i]);
         if (ret != PM3_SUCCESS) {
             goto finish;
         }
@@ -946,10 +1199,18 @@ static int flash_pm3(char *serial_port_name, uint8_t num_files, const char *file
 
 finish:
     if (ret != PM3_SUCCESS) {
-        PrintAndLogEx(WARNING, "The flashing procedure failed, follow the suggested steps!");
+        if (verify_only) {
+            PrintAndLogEx(WARNING, "Flash content doesn't match the image%s", (num_files > 1) ? "s" : "");
+        } else {
+            PrintAndLogEx(WARNING, "The flashing procedure failed, follow the suggested steps!");
+        }
     }
 
-    ret = flash_stop_flashing();
+    // keep the first error, a station scripting on the exit code needs it
+    int res = flash_stop_flashing();
+    if (ret == PM3_SUCCESS) {
+        ret = res;
+    }
     CloseProxmark(g_session.current_device);
 
 finish2:
@@ -992,6 +1253,7 @@ void pm3_init(void) {
     g_session.pm3_present = false;
     g_session.help_dump_mode = false;
     g_session.incognito = false;
+    g_session.cached_caps = false;
     g_session.supports_colors = false;
     g_session.emoji_mode = EMO_ALTTEXT;
     g_session.stdinOnTTY = false;
@@ -1004,6 +1266,7 @@ void pm3_init(void) {
 
 #ifndef LIBPM3
 int main(int argc, char *argv[]) {
+    uint64_t t_start = msclock();
     pm3_init();
     bool waitCOMPort = false;
     bool addScriptExec = false;
@@ -1011,6 +1274,7 @@ int main(int argc, char *argv[]) {
     char *script_cmds_file = NULL;
     char *script_cmd = NULL;
     char *port = NULL;
+    const char *daemon_addr = NULL;
     uint32_t speed = 0;
 
     pm3line_init();
@@ -1022,6 +1286,7 @@ int main(int argc, char *argv[]) {
     bool reboot_bootloader_mode = false;
     bool flash_can_write_bl = false;
     bool flash_force = false;
+    bool flash_verify_only = false;
     bool debug_mode_forced = false;
     int flash_num_files = 0;
     const char *flash_filenames[FLASH_MAX_FILES];
@@ -1030,6 +1295,7 @@ int main(int argc, char *argv[]) {
     uint32_t dumpmem_addr = 0;
     uint32_t dumpmem_len = 512 * 1024;
     bool dumpmem_raw = false;
+    const char *record_filename = NULL;
 
     // color management:
     // 1. default = no color
@@ -1232,6 +1498,23 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        // skip the capabilities probe, for scripts running the client many times
+        if (strcmp(argv[i], "--cached-caps") == 0) {
+            g_session.cached_caps = true;
+            continue;
+        }
+
+        // record the traffic with the device, for replaying it without device
+        if (strcmp(argv[i], "--record") == 0) {
+            if (i + 1 == argc) {
+                PrintAndLogEx(ERR, _RED_("ERROR:") " missing file specification after --record\n");
+                show_help(false, exec_name);
+                return 1;
+            }
+            record_filename = argv[++i];
+            continue;
+        }
+
         // go to dump mode
         if (strcmp(argv[i], "--dumpmem") == 0) {
             dumpmem_mode = true;
@@ -1294,6 +1577,12 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        // compare flash with the images, don't write
+        if (strcmp(argv[i], "--verify") == 0) {
+            flash_verify_only = true;
+            continue;
+        }
+
         // flash file
         if (strcmp(argv[i], "--image") == 0) {
             if (flash_num_files == FLASH_MAX_FILES) {
@@ -1309,6 +1598,22 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        // serve commands over a socket
+        if (strcmp(argv[i], "--daemon") == 0) {
+            if (i + 1 == argc) {
+                PrintAndLogEx(ERR, _RED_("ERROR:") " missing socket specification after --daemon\n");
+                show_help(false, exec_name);
+                return 1;
+            }
+#if defined(_WIN32)
+            PrintAndLogEx(ERR, _RED_("ERROR:") " --daemon is not supported on this platform\n");
+            return 1;
+#else
+            daemon_addr = argv[++i];
+            continue;
+#endif
+        }
+
         if (strcmp(argv[i], "--ncpu") == 0) {
             if (i + 1 == argc) {
                 PrintAndLogEx(ERR, _RED_("ERROR:") " missing CPU number specification after --ncpu\n");
@@ -1334,7 +1639,9 @@ int main(int argc, char *argv[]) {
 
     // Load Settings and assign
     // This will allow the command line to override the settings.json values
+    uint64_t t_prefs = msclock();
     preferences_load();
+    t_prefs = msclock() - t_prefs;
     // quick patch for debug level
     if (debug_mode_forced == false) {
         g_debugMode = g_session.client_debug_level;
@@ -1359,8 +1666,8 @@ int main(int argc, char *argv[]) {
     }
 
     if (flash_mode) {
-        flash_pm3(port, flash_num_files, flash_filenames, flash_can_write_bl, flash_force);
-        exit(EXIT_SUCCESS);
+        int res = flash_pm3(port, flash_num_files, flash_filenames, flash_can_write_bl, flash_force, flash_verify_only);
+        exit((res == PM3_SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE);
     }
 
     if (reboot_bootloader_mode) {
@@ -1395,14 +1702,21 @@ int main(int argc, char *argv[]) {
     }
 
     // try to open USB connection to Proxmark
+    uint64_t t_open = msclock();
+    if (port != NULL && record_filename != NULL) {
+        uart_record_start(record_filename);
+    }
     if (port != NULL) {
         OpenProxmark(&g_session.current_device, port, waitCOMPort, 20, false, speed);
     }
+    t_open = msclock() - t_open;
 
+    uint64_t t_probe = msclock();
     if (g_session.pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
         PrintAndLogEx(ERR, _RED_("ERROR:") " cannot communicate with the Proxmark3\n");
         CloseProxmark(g_session.current_device);
     }
+    t_probe = msclock() - t_probe;
 
     if ((port != NULL) && (g_session.pm3_present == false)) {
         exit(EXIT_FAILURE);
@@ -1412,6 +1726,10 @@ int main(int argc, char *argv[]) {
         PrintAndLogEx(INFO, _YELLOW_("OFFLINE") " mode. Check " _YELLOW_("\"%s -h\"") " if it's not what you want.\n", exec_name);
     }
 
+    // startup profile, shown with -d 1
+    PrintAndLogEx(DEBUG, "Startup: preferences %" PRIu64 " ms, open %" PRIu64 " ms, probe %" PRIu64 " ms, total %" PRIu64 " ms",
+                  t_prefs, t_open, t_probe, msclock() - t_start);
+
     // ascii art only in interactive client
     if (!script_cmds_file && !script_cmd && g_session.stdinOnTTY && g_session.stdoutOnTTY && (dumpmem_mode == false) && (flash_mode == false) && (reboot_bootloader_mode == false)) {
         showBanner();
@@ -1438,6 +1756,18 @@ int main(int argc, char *argv[]) {
     }
     */
 
+#if !defined(_WIN32)
+    if (daemon_addr) {
+        mainret = daemon_loop(daemon_addr);
+        if (g_session.pm3_present) {
+            clearCommandBuffer();
+            SendCommandNG(CMD_QUIT_SESSION, NULL, 0);
+            msleep(100); // Make sure command is sent before killing client
+        }
+        goto cleanup;
+    }
+#endif
+
 #ifdef HAVE_GUI
 
 #  if defined(_WIN32) || (defined(__MACH__) && defined(__APPLE__))
@@ -1458,6 +1788,9 @@ int main(int argc, char *argv[]) {
     main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
 #endif
 
+#if !defined(_WIN32)
+cleanup:
+#endif
     // Clean up the port
     if (g_session.pm3_present) {
         CloseProxmark(g_session.current_device);
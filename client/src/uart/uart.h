@@ -62,6 +62,17 @@ void uart_close(const serial_port sp);
  */
 int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen);
 
+/* Waits until data is available on the port, for up to the configured rx timeout.
+ * Returns early when uart_wakeup() is called from another thread.
+ *
+ * Returns PM3_SUCCESS if data can be read, PM3_ENODATA on timeout or wakeup.
+ */
+int uart_wait_rx(const serial_port sp);
+
+/* Interrupts a pending uart_wait_rx(), e.g. when a command is ready to be sent.
+ */
+void uart_wakeup(const serial_port sp);
+
 /* Sends a buffer to a given serial port.
  *   pbtTx: A pointer to a buffer containing the data to send.
  *   len: The amount of data to be sent.
@@ -93,4 +104,22 @@ bool uart_bind(void *socket, const char *bindAddrStr, const char *bindPortStr, b
  */
 int uart_parse_address_port(char *addrPortStr, const char **addrStr, const char **portStr, bool *isIPv6);
 
+/* Recording of the traffic of the next connections, see uart_replay.c
+ */
+int uart_record_start(const char *filename);
+void uart_record_stop(void);
+void uart_record(bool sent, const uint8_t *data, uint32_t len);
+
+/* Fake port replaying a recording, selected with a "replay:<file>" port name.
+ * The platform drivers hand over to these when uart_replay_owns() the port.
+ */
+bool uart_replay_port(const char *pcPortName);
+bool uart_replay_owns(const serial_port sp);
+serial_port uart_replay_open(const char *pcPortName, uint32_t speed, bool slient);
+void uart_replay_close(const serial_port sp);
+int uart_replay_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen);
+int uart_replay_wait_rx(const serial_port sp);
+void uart_replay_wakeup(const serial_port sp);
+int uart_replay_send(const serial_port sp, const uint8_t *pbtTx, const uint32_t len);
+
 #endif // _UART_H_
@@ -60,6 +60,7 @@ typedef struct {
     term_info tiOld;  // Terminal info before using the port
     term_info tiNew;  // Terminal info during the transaction
     RingBuffer *udpBuffer;
+    int wake_fd[2];   // self-pipe, lets uart_wakeup() interrupt uart_wait_rx()
 } serial_port_unix_t_t;
 
 // see pm3_cmd.h
@@ -82,7 +83,23 @@ uint32_t uart_get_timeouts(void) {
     return newtimeout_value;
 }
 
+// Without a wake pipe, uart_wait_rx() falls back to plain timed polling
+static serial_port uart_wake_setup(serial_port_unix_t_t *sp) {
+    if (pipe(sp->wake_fd) == -1) {
+        sp->wake_fd[0] = -1;
+        sp->wake_fd[1] = -1;
+        return sp;
+    }
+    fcntl(sp->wake_fd[0], F_SETFL, O_NONBLOCK);
+    fcntl(sp->wake_fd[1], F_SETFL, O_NONBLOCK);
+    return sp;
+}
+
 serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
+    if (uart_replay_port(pcPortName)) {
+        return uart_replay_open(pcPortName, speed, slient);
+    }
+
     serial_port_unix_t_t *sp = calloc(sizeof(serial_port_unix_t_t), sizeof(uint8_t));
 
     if (sp == 0) {
@@ -91,6 +108,8 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
     }
 
     sp->udpBuffer = NULL;
+    sp->wake_fd[0] = -1;
+    sp->wake_fd[1] = -1;
     rx_empty_counter = 0;
     // init timeouts
     timeout.tv_usec = UART_FPC_CLIENT_RX_TIMEOUT_MS * 1000;
@@ -255,7 +274,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
             sp->udpBuffer = RingBuf_create(MAX(sizeof(PacketResponseNGRaw), sizeof(PacketResponseOLD)) * 30);
         }
 
-        return sp;
+        return uart_wake_setup(sp);
     }
 
     if (isBluetooth) {
@@ -306,7 +325,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
         sp->fd = sfd;
 
         g_conn.send_via_ip = PM3_NONE;
-        return sp;
+        return uart_wake_setup(sp);
 #else // HAVE_BLUEZ
         PrintAndLogEx(ERR, "Sorry, this client doesn't support native Bluetooth addresses");
         free(sp);
@@ -354,7 +373,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
         sp->fd = localsocket;
 
         g_conn.send_via_ip = PM3_NONE;
-        return sp;
+        return uart_wake_setup(sp);
     }
 
     free(prefix);
@@ -446,10 +465,15 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
     }
     g_conn.uart_speed = uart_get_speed(sp);
     g_conn.send_via_ip = PM3_NONE;
-    return sp;
+    return uart_wake_setup(sp);
 }
 
 void uart_close(const serial_port sp) {
+    if (uart_replay_owns(sp)) {
+        uart_replay_close(sp);
+        return;
+    }
+
     serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
     msleep(100);
     tcflush(spu->fd, TCIOFLUSH);
@@ -469,10 +493,14 @@ void uart_close(const serial_port sp) {
     }
     RingBuf_destroy(spu->udpBuffer);
     close(spu->fd);
+    if (spu->wake_fd[0] != -1) {
+        close(spu->wake_fd[0]);
+        close(spu->wake_fd[1]);
+    }
     free(sp);
 }
 
-int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
+static int uart_receive_port(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
     uint32_t byteCount;  // FIONREAD returns size on 32b
     fd_set rfds;
     struct timeval tv;
@@ -591,7 +619,75 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
     return PM3_SUCCESS;
 }
 
-int uart_send(const serial_port sp, const uint8_t *pbtTx, const uint32_t len) {
+int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
+    if (uart_replay_owns(sp)) {
+        return uart_replay_receive(sp, pbtRx, pszMaxRxLen, pszRxLen);
+    }
+    int res = uart_receive_port(sp, pbtRx, pszMaxRxLen, pszRxLen);
+    uart_record(false, pbtRx, *pszRxLen);
+    return res;
+}
+
+int uart_wait_rx(const serial_port sp) {
+    if (uart_replay_owns(sp)) {
+        return uart_replay_wait_rx(sp);
+    }
+
+    const serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
+
+    if (newtimeout_pending) {
+        timeout.tv_usec = ((suseconds_t)newtimeout_value) * 1000;
+        newtimeout_pending = false;
+    }
+
+    // UDP datagrams already buffered
+    if (spu->udpBuffer != NULL && RingBuf_getAvailableSize(spu->udpBuffer) > 0) {
+        return PM3_SUCCESS;
+    }
+
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(spu->fd, &rfds);
+    int maxfd = spu->fd;
+    if (spu->wake_fd[0] != -1) {
+        FD_SET(spu->wake_fd[0], &rfds);
+        maxfd = MAX(maxfd, spu->wake_fd[0]);
+    }
+
+    struct timeval tv = timeout;
+    int res = select(maxfd + 1, &rfds, NULL, NULL, &tv);
+    if (res < 0) {
+        return (errno == EINTR) ? PM3_ENODATA : PM3_EIO;
+    }
+
+    if (spu->wake_fd[0] != -1 && FD_ISSET(spu->wake_fd[0], &rfds)) {
+        uint8_t dummy[16];
+        while (read(spu->wake_fd[0], dummy, sizeof(dummy)) > 0) {
+        }
+    }
+
+    if (res > 0 && FD_ISSET(spu->fd, &rfds)) {
+        return PM3_SUCCESS;
+    }
+    return PM3_ENODATA;
+}
+
+void uart_wakeup(const serial_port sp) {
+    if (uart_replay_owns(sp)) {
+        uart_replay_wakeup(sp);
+        return;
+    }
+
+    const serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
+    if (spu->wake_fd[1] != -1) {
+        uint8_t b = 0;
+        // pipe full means a wakeup is already pending, nothing to do
+        ssize_t res = write(spu->wake_fd[1], &b, 1);
+        (void) res;
+    }
+}
+
+static int uart_send_port(const serial_port sp, const uint8_t *pbtTx, const uint32_t len) {
     uint32_t pos = 0;
     fd_set rfds;
     struct timeval tv;
@@ -628,7 +724,23 @@ int uart_send(const serial_port sp, const uint8_t *pbtTx, const uint32_t len) {
     return PM3_SUCCESS;
 }
 
+int uart_send(const serial_port sp, const uint8_t *pbtTx, const uint32_t len) {
+    if (uart_replay_owns(sp)) {
+        return uart_replay_send(sp, pbtTx, len);
+    }
+    int res = uart_send_port(sp, pbtTx, len);
+    if (res == PM3_SUCCESS) {
+        uart_record(true, pbtTx, len);
+    }
+    return res;
+}
+
 bool uart_set_speed(serial_port sp, const uint32_t uiPortSpeed) {
+    if (uart_replay_owns(sp)) {
+        g_conn.uart_speed = uiPortSpeed;
+        return true;
+    }
+
     const serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
     speed_t stPortSpeed;
     switch (uiPortSpeed) {
@@ -733,6 +845,10 @@ bool uart_set_speed(serial_port sp, const uint32_t uiPortSpeed) {
 }
 
 uint32_t uart_get_speed(const serial_port sp) {
+    if (uart_replay_owns(sp)) {
+        return g_conn.uart_speed;
+    }
+
     struct termios ti;
     uint32_t uiPortSpeed;
     const serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
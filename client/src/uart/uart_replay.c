@@ -0,0 +1,326 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Recording of the byte stream to and from a device, and a fake port replaying it
+//
+// `pm3 -p /dev/ttyACM0 --record autopwn.pm3rec -c "hf mf autopwn"` records every
+// chunk sent and received. `pm3 -p replay:autopwn.pm3rec -c "hf mf autopwn"` runs the
+// same command against the recording, without device and without RF timing, so the
+// host side of the client can be benchmarked reproducibly.
+//
+// File format, little endian:
+//   "PM3REC01"
+//   records of  direction (1 byte, '>' sent, '<' received) | length (4 bytes) | data
+//
+// On replay, received data is handed out once all the bytes sent before it in the
+// recording have been sent again. Sent bytes are compared with the recording and
+// differences are reported, but they do not stop the replay.
+//-----------------------------------------------------------------------------
+
+#include "uart.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "comms.h"
+#include "ui.h"
+#include "util_posix.h" // msleep
+#include "fileutils.h"
+
+#define REPLAY_MAGIC        "PM3REC01"
+#define REPLAY_MAGIC_LEN    8
+#define REPLAY_PREFIX       "replay:"
+
+typedef struct {
+    uint32_t rx_end;        // end of this chunk in the received stream
+    uint32_t tx_needed;     // bytes of the sent stream preceding it
+} replay_gate_t;
+
+typedef struct {
+    uint8_t *rx;
+    uint32_t rx_len;
+    uint32_t rx_pos;
+    uint8_t *tx;
+    uint32_t tx_len;
+    uint32_t tx_pos;
+    replay_gate_t *gates;
+    uint32_t gate_count;
+    uint32_t gate_pos;
+    uint32_t tx_mismatch;   // sent bytes differing from, or beyond, the recording
+    bool woken;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} replay_port_t;
+
+static replay_port_t *s_replay = NULL;
+static FILE *s_record = NULL;
+
+//-----------------------------------------------------------------------------
+// recording
+//-----------------------------------------------------------------------------
+int uart_record_start(const char *filename) {
+    uart_record_stop();
+    s_record = fopen(filename, "wb");
+    if (s_record == NULL) {
+        PrintAndLogEx(ERR, "error, could not create recording " _YELLOW_("%s"), filename);
+        return PM3_EFILE;
+    }
+    fwrite(REPLAY_MAGIC, 1, REPLAY_MAGIC_LEN, s_record);
+    PrintAndLogEx(INFO, "recording device traffic to " _YELLOW_("%s"), filename);
+    return PM3_SUCCESS;
+}
+
+void uart_record_stop(void) {
+    if (s_record) {
+        fclose(s_record);
+        s_record = NULL;
+    }
+}
+
+// called by the port drivers from the communication thread only
+void uart_record(bool sent, const uint8_t *data, uint32_t len) {
+    if (s_record == NULL || len == 0) {
+        return;
+    }
+    uint8_t hdr[5] = { sent ? '>' : '<', len & 0xFF, (len >> 8) & 0xFF, (len >> 16) & 0xFF, (len >> 24) & 0xFF };
+    fwrite(hdr, 1, sizeof(hdr), s_record);
+    fwrite(data, 1, len, s_record);
+    // keep the recording usable when the client is killed
+    fflush(s_record);
+}
+
+//-----------------------------------------------------------------------------
+// replay
+//-----------------------------------------------------------------------------
+bool uart_replay_port(const char *pcPortName) {
+    return (strncmp(pcPortName, REPLAY_PREFIX, strlen(REPLAY_PREFIX)) == 0);
+}
+
+bool uart_replay_owns(const serial_port sp) {
+    return (s_replay != NULL && sp == (serial_port)s_replay);
+}
+
+static void replay_free(replay_port_t *rp) {
+    if (rp == NULL) {
+        return;
+    }
+    free(rp->rx);
+    free(rp->tx);
+    free(rp->gates);
+    free(rp);
+}
+
+static bool replay_append(uint8_t **buf, uint32_t *len, const uint8_t *data, uint32_t n) {
+    uint8_t *tmp = realloc(*buf, *len + n);
+    if (tmp == NULL) {
+        return false;
+    }
+    memcpy(tmp + *len, data, n);
+    *buf = tmp;
+    *len += n;
+    return true;
+}
+
+static replay_port_t *replay_load(const char *filename, bool slient) {
+    uint8_t *data = NULL;
+    size_t datalen = 0;
+    if (loadFile_safeEx(filename, "", (void **)&data, &datalen, false) != PM3_SUCCESS) {
+        if (slient == false) {
+            PrintAndLogEx(ERR, "error, could not load recording " _YELLOW_("%s"), filename);
+        }
+        return NULL;
+    }
+
+    if (datalen < REPLAY_MAGIC_LEN || memcmp(data, REPLAY_MAGIC, REPLAY_MAGIC_LEN) != 0) {
+        if (slient == false) {
+            PrintAndLogEx(ERR, "error, " _YELLOW_("%s") " is not a device recording", filename);
+        }
+        free(data);
+        return NULL;
+    }
+
+    replay_port_t *rp = calloc(1, sizeof(replay_port_t));
+    if (rp == NULL) {
+        free(data);
+        return NULL;
+    }
+
+    size_t pos = REPLAY_MAGIC_LEN;
+    while (pos + 5 <= datalen) {
+        uint8_t dir = data[pos];
+        uint32_t n = data[pos + 1] | (data[pos + 2] << 8) | (data[pos + 3] << 16) | ((uint32_t)data[pos + 4] << 24);
+        pos += 5;
+        if ((dir != '>' && dir != '<') || n > datalen - pos) {
+            PrintAndLogEx(WARNING, "recording " _YELLOW_("%s") " is truncated at offset %zu", filename, pos - 5);
+            break;
+        }
+
+        bool ok;
+        if (dir == '>') {
+            ok = replay_append(&rp->tx, &rp->tx_len, data + pos, n);
+        } else {
+            ok = replay_append(&rp->rx, &rp->rx_len, data + pos, n);
+            if (ok) {
+                // merge with the previous chunk when nothing was sent in between
+                if (rp->gate_count && rp->gates[rp->gate_count - 1].tx_needed == rp->tx_len) {
+                    rp->gates[rp->gate_count - 1].rx_end = rp->rx_len;
+                } else {
+                    replay_gate_t *tmp = realloc(rp->gates, (rp->gate_count + 1) * sizeof(replay_gate_t));
+                    ok = (tmp != NULL);
+                    if (ok) {
+                        rp->gates = tmp;
+                        rp->gates[rp->gate_count].rx_end = rp->rx_len;
+                        rp->gates[rp->gate_count].tx_needed = rp->tx_len;
+                        rp->gate_count++;
+                    }
+                }
+            }
+        }
+        if (ok == false) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            free(data);
+            replay_free(rp);
+            return NULL;
+        }
+        pos += n;
+    }
+    free(data);
+    return rp;
+}
+
+serial_port uart_replay_open(const char *pcPortName, uint32_t speed, bool slient) {
+    const char *filename = pcPortName + strlen(REPLAY_PREFIX);
+
+    if (s_replay != NULL) {
+        if (slient == false) {
+            PrintAndLogEx(ERR, "error, a recording is already being replayed");
+        }
+        return CLAIMED_SERIAL_PORT;
+    }
+
+    replay_port_t *rp = replay_load(filename, slient);
+    if (rp == NULL) {
+        return INVALID_SERIAL_PORT;
+    }
+
+    pthread_mutex_init(&rp->lock, NULL);
+    pthread_cond_init(&rp->wake, NULL);
+    s_replay = rp;
+
+    g_conn.send_via_local_ip = false;
+    g_conn.send_via_ip = PM3_NONE;
+    g_conn.uart_speed = speed;
+
+    PrintAndLogEx(INFO, "replaying " _YELLOW_("%s") ", %u bytes sent / %u bytes received", filename, rp->tx_len, rp->rx_len);
+    return (serial_port)rp;
+}
+
+void uart_replay_close(const serial_port sp) {
+    replay_port_t *rp = (replay_port_t *)sp;
+
+    if (rp->tx_mismatch) {
+        PrintAndLogEx(WARNING, "replay, %u sent bytes differed from the recording", rp->tx_mismatch);
+    }
+    if (rp->rx_pos < rp->rx_len) {
+        PrintAndLogEx(INFO, "replay, %u recorded bytes were not received", rp->rx_len - rp->rx_pos);
+    }
+
+    pthread_cond_destroy(&rp->wake);
+    pthread_mutex_destroy(&rp->lock);
+    s_replay = NULL;
+    replay_free(rp);
+}
+
+// bytes which may be received now, given what was sent so far
+static uint32_t replay_rx_available(replay_port_t *rp) {
+    while (rp->gate_pos < rp->gate_count && rp->rx_pos >= rp->gates[rp->gate_pos].rx_end) {
+        rp->gate_pos++;
+    }
+    if (rp->gate_pos == rp->gate_count || rp->gates[rp->gate_pos].tx_needed > rp->tx_pos) {
+        return 0;
+    }
+    return rp->gates[rp->gate_pos].rx_end - rp->rx_pos;
+}
+
+int uart_replay_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
+    replay_port_t *rp = (replay_port_t *)sp;
+
+    pthread_mutex_lock(&rp->lock);
+    uint32_t n = MIN(replay_rx_available(rp), pszMaxRxLen);
+    memcpy(pbtRx, rp->rx + rp->rx_pos, n);
+    rp->rx_pos += n;
+    pthread_mutex_unlock(&rp->lock);
+
+    *pszRxLen = n;
+    if (n == 0) {
+        // the device is idle, don't let the raw receive loops spin
+        msleep(1);
+        return PM3_ENODATA;
+    }
+    return PM3_SUCCESS;
+}
+
+int uart_replay_wait_rx(const serial_port sp) {
+    replay_port_t *rp = (replay_port_t *)sp;
+
+    pthread_mutex_lock(&rp->lock);
+    if (replay_rx_available(rp) == 0 && rp->woken == false) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        uint64_t ns = ((uint64_t)now.tv_usec * 1000) + ((uint64_t)UART_USB_CLIENT_RX_TIMEOUT_MS * 1000000);
+        struct timespec until = {
+            .tv_sec = now.tv_sec + (ns / 1000000000),
+            .tv_nsec = ns % 1000000000
+        };
+        // woken up by uart_replay_wakeup() when a command is queued
+        pthread_cond_timedwait(&rp->wake, &rp->lock, &until);
+    }
+    rp->woken = false;
+    uint32_t n = replay_rx_available(rp);
+    pthread_mutex_unlock(&rp->lock);
+    return (n) ? PM3_SUCCESS : PM3_ENODATA;
+}
+
+void uart_replay_wakeup(const serial_port sp) {
+    replay_port_t *rp = (replay_port_t *)sp;
+    pthread_mutex_lock(&rp->lock);
+    rp->woken = true;
+    pthread_cond_signal(&rp->wake);
+    pthread_mutex_unlock(&rp->lock);
+}
+
+int uart_replay_send(const serial_port sp, const uint8_t *pbtTx, const uint32_t len) {
+    replay_port_t *rp = (replay_port_t *)sp;
+
+    pthread_mutex_lock(&rp->lock);
+    uint32_t n = MIN(len, rp->tx_len - rp->tx_pos);
+    uint32_t diff = len - n;
+    for (uint32_t i = 0; i < n; i++) {
+        if (pbtTx[i] != rp->tx[rp->tx_pos + i]) {
+            diff++;
+        }
+    }
+    if (diff && rp->tx_mismatch == 0) {
+        PrintAndLogEx(WARNING, "replay, sent data differs from the recording at offset %u", rp->tx_pos);
+    }
+    rp->tx_mismatch += diff;
+    rp->tx_pos += n;
+    pthread_mutex_unlock(&rp->lock);
+    return PM3_SUCCESS;
+}
@@ -84,6 +84,9 @@ static int uart_reconfigure_timeouts_polling(serial_port sp) {
 }
 
 serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
+    if (uart_replay_port(pcPortName)) {
+        return uart_replay_open(pcPortName, speed, slient);
+    }
 
     serial_port_windows_t *sp = calloc(sizeof(serial_port_windows_t), sizeof(uint8_t));
     if (sp == NULL) {
@@ -317,6 +320,11 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
 }
 
 void uart_close(const serial_port sp) {
+    if (uart_replay_owns(sp)) {
+        uart_replay_close(sp);
+        return;
+    }
+
     serial_port_windows_t *spw = (serial_port_windows_t *)sp;
     if (spw->hSocket != INVALID_SOCKET) {
         shutdown(spw->hSocket, SD_BOTH);
@@ -330,6 +338,11 @@ void uart_close(const serial_port sp) {
 }
 
 bool uart_set_speed(serial_port sp, const uint32_t uiPortSpeed) {
+    if (uart_replay_owns(sp)) {
+        g_conn.uart_speed = uiPortSpeed;
+        return true;
+    }
+
     serial_port_windows_t *spw = (serial_port_windows_t *)sp;
 
     // Set port speed (Input and Output)
@@ -358,6 +371,10 @@ bool uart_set_speed(serial_port sp, const uint32_t uiPortSpeed) {
 }
 
 uint32_t uart_get_speed(const serial_port sp) {
+    if (uart_replay_owns(sp)) {
+        return g_conn.uart_speed;
+    }
+
     const serial_port_windows_t *spw = (serial_port_windows_t *)sp;
     if (!GetCommState(spw->hPort, (serial_port) & spw->dcb))
         return spw->dcb.BaudRate;
@@ -365,7 +382,7 @@ uint32_t uart_get_speed(const serial_port sp) {
     return 0;
 }
 
-int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
+static int uart_receive_port(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
     const serial_port_windows_t *spw = (serial_port_windows_t *)sp;
     if (spw->hSocket == INVALID_SOCKET) {
         // serial port
@@ -503,7 +520,30 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
     }
 }
 
-int uart_send(const serial_port sp, const uint8_t *p_tx, const uint32_t len) {
+int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
+    if (uart_replay_owns(sp)) {
+        return uart_replay_receive(sp, pbtRx, pszMaxRxLen, pszRxLen);
+    }
+    int res = uart_receive_port(sp, pbtRx, pszMaxRxLen, pszRxLen);
+    uart_record(false, pbtRx, *pszRxLen);
+    return res;
+}
+
+// Serial port reads are bounded by COMMTIMEOUTS, the receive loop keeps polling on Windows
+int uart_wait_rx(const serial_port sp) {
+    if (uart_replay_owns(sp)) {
+        return uart_replay_wait_rx(sp);
+    }
+    return PM3_SUCCESS;
+}
+
+void uart_wakeup(const serial_port sp) {
+    if (uart_replay_owns(sp)) {
+        uart_replay_wakeup(sp);
+    }
+}
+
+static int uart_send_port(const serial_port sp, const uint8_t *p_tx, const uint32_t len) {
     const serial_port_windows_t *spw = (serial_port_windows_t *)sp;
     if (spw->hSocket == INVALID_SOCKET) { // serial port
         DWORD txlen = 0;
@@ -555,4 +595,15 @@ int uart_send(const serial_port sp, const uint8_t *p_tx, const uint32_t len) {
     }
 }
 
+int uart_send(const serial_port sp, const uint8_t *p_tx, const uint32_t len) {
+    if (uart_replay_owns(sp)) {
+        return uart_replay_send(sp, p_tx, len);
+    }
+    int res = uart_send_port(sp, p_tx, len);
+    if (res == PM3_SUCCESS) {
+        uart_record(true, p_tx, len);
+    }
+    return res;
+}
+
 #endif
@@ -45,6 +45,7 @@
 #include <time.h>
 #include "emojis.h"
 #include "emojis_alt.h"
+#include "jansson.h"
 session_arg_t g_session;
 
 double g_CursorScaleFactor = 1;
@@ -62,6 +63,7 @@ bool g_GridLocked = false;
 pthread_mutex_t g_print_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void fPrintAndLog(FILE *stream, const char *fmt, ...);
+static const char *print_filter(char *dst, char *tmp, const char *src, bool ansi, emojiMode_t mode);
 
 #ifdef _WIN32
 #define MKDIR_CHK _mkdir(path)
@@ -199,6 +201,92 @@ static void fill_grabber(const char *string) {
     g_grabbed_output.idx += len;
 }
 
+// Structured results of the console command run by the pm3 library. Every key holds one value,
+// a key added again turns into an array so per sector / per block records stay in order.
+static json_t *g_result = NULL;
+static char *g_result_str = NULL;
+static pthread_mutex_t g_result_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void result_clear(void) {
+    pthread_mutex_lock(&g_result_lock);
+    json_decref(g_result);
+    g_result = NULL;
+    pthread_mutex_unlock(&g_result_lock);
+}
+
+static void result_add(const char *key, json_t *value) {
+    if (value == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_result_lock);
+    if (g_result == NULL) {
+        g_result = json_object();
+    }
+
+    json_t *old = json_object_get(g_result, key);
+    if (old == NULL) {
+        json_object_set_new(g_result, key, value);
+    } else if (json_is_array(old)) {
+        json_array_append_new(old, value);
+    } else {
+        json_t *arr = json_array();
+        json_array_append(arr, old);
+        json_array_append_new(arr, value);
+        json_object_set_new(g_result, key, arr);
+    }
+    pthread_mutex_unlock(&g_result_lock);
+}
+
+void result_add_str(const char *key, const char *value) {
+    if ((g_printAndLog & PRINTANDLOG_RESULT) == 0) {
+        return;
+    }
+    result_add(key, (value) ? json_string(value) : json_null());
+}
+
+void result_add_int(const char *key, int64_t value) {
+    if ((g_printAndLog & PRINTANDLOG_RESULT) == 0) {
+        return;
+    }
+    result_add(key, json_integer(value));
+}
+
+void result_add_bool(const char *key, bool value) {
+    if ((g_printAndLog & PRINTANDLOG_RESULT) == 0) {
+        return;
+    }
+    result_add(key, json_boolean(value));
+}
+
+void result_add_hex(const char *key, const uint8_t *data, size_t len) {
+    if ((g_printAndLog & PRINTANDLOG_RESULT) == 0) {
+        return;
+    }
+    if (data == NULL) {
+        result_add(key, json_null());
+        return;
+    }
+
+    char *hex = calloc((len * 2) + 1, sizeof(char));
+    if (hex == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        snprintf(hex + (i * 2), 3, "%02X", data[i]);
+    }
+    result_add(key, json_string(hex));
+    free(hex);
+}
+
+const char *result_get(void) {
+    pthread_mutex_lock(&g_result_lock);
+    free(g_result_str);
+    g_result_str = (g_result) ? json_dumps(g_result, JSON_COMPACT) : NULL;
+    pthread_mutex_unlock(&g_result_lock);
+    return (g_result_str) ? g_result_str : "{}";
+}
+
 void PrintAndLogOptions(const char *str[][2], size_t size, size_t space) {
 
     char buff[2000] = "Options:\n";
@@ -247,8 +335,9 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     }
 
     char prefix[40] = {0};
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER + sizeof(prefix)] = {0};
+    char buffer[MAX_PRINT_BUFFER];
+    char buffer2[MAX_PRINT_BUFFER + sizeof(prefix)];
+    buffer2[0] = 0;
     char *token = NULL;
     char *tmp_ptr = NULL;
     FILE *stream = stdout;
@@ -355,11 +444,9 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
         if (level == INPLACE) {
             // ignore INPLACE if rest of output is grabbed
             if (!(g_printAndLog & PRINTANDLOG_GRAB)) {
-                char buffer3[sizeof(buffer2)] = {0};
-                char buffer4[sizeof(buffer2)] = {0};
-                memcpy_filter_ansi(buffer3, buffer2, sizeof(buffer2), !g_session.supports_colors);
-                memcpy_filter_emoji(buffer4, buffer3, sizeof(buffer3), g_session.emoji_mode);
-                fprintf(stream, "\r%s", buffer4);
+                char buffer3[sizeof(buffer2)];
+                char buffer4[sizeof(buffer2)];
+                fprintf(stream, "\r%s", print_filter(buffer4, buffer3, buffer2, !g_session.supports_colors, g_session.emoji_mode));
                 fflush(stream);
             }
         } else {
@@ -368,13 +455,186 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     }
 }
 
+// Copies src to dst with the ANSI sequences dropped and / or the emojis rewritten,
+// but only runs the filters when the text has something for them to do.
+// Returns the filtered text, which is src itself when nothing had to change.
+static const char *print_filter(char *dst, char *tmp, const char *src, bool ansi, emojiMode_t mode) {
+    size_t n = strlen(src) + 1;
+    if (ansi && memchr(src, '\x1b', n)) {
+        memcpy_filter_ansi(tmp, src, n, true);
+        src = tmp;
+        n = strlen(tmp) + 1;
+    }
+    if (mode != EMO_ALIAS && memchr(src, ':', n)) {
+        memcpy_filter_emoji(dst, src, n, mode);
+        return dst;
+    }
+    return src;
+}
+
+//-----------------------------------------------------------------------------
+// Session log writer
+// fPrintAndLog() only queues the unfiltered line, a background thread strips the
+// colors, turns emojis into alt text and writes it to the log file, flushing
+// whenever the queue runs empty. Producers are serialized by g_print_lock, so the
+// ring has exactly one writer and one reader and needs no lock, the mutex and
+// condition are only used to sleep while it is empty, full or being drained.
+//-----------------------------------------------------------------------------
+#define LOG_QUEUE_SLOTS  256
+
+typedef struct {
+    bool linefeed;
+    char text[MAX_PRINT_BUFFER];
+} log_slot_t;
+
+typedef struct {
+    FILE *f;
+    log_slot_t *slots;
+    size_t head;            // next slot to fill, only advanced by fPrintAndLog
+    size_t tail;            // next slot to write, only advanced by the writer
+    bool started;
+    bool stop;
+    bool writer_sleeps;
+    bool producer_sleeps;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} log_queue_t;
+
+static log_queue_t logq = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void log_write(FILE *f, const char *text, bool linefeed) {
+    char buf[MAX_PRINT_BUFFER];
+    char tmp[MAX_PRINT_BUFFER];
+    fputs(print_filter(buf, tmp, text, true, EMO_ALTTEXT), f);
+    if (linefeed) {
+        fputc('\n', f);
+    }
+}
+
+// wakes the other side if it went to sleep, the seq_cst pairs with the one in log_sleep()
+static void log_wake(bool *sleeps) {
+    if (__atomic_load_n(sleeps, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&logq.lock);
+        pthread_cond_broadcast(&logq.cond);
+        pthread_mutex_unlock(&logq.lock);
+    }
+}
+
+// sleeps until 'done' is true, it is checked again after announcing the sleep so no wake up is lost
+static void log_sleep(bool *sleeps, bool (*done)(void)) {
+    pthread_mutex_lock(&logq.lock);
+    __atomic_store_n(sleeps, true, __ATOMIC_SEQ_CST);
+    while (done() == false) {
+        pthread_cond_wait(&logq.cond, &logq.lock);
+    }
+    __atomic_store_n(sleeps, false, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&logq.lock);
+}
+
+static bool log_has_work(void) {
+    return (__atomic_load_n(&logq.head, __ATOMIC_SEQ_CST) != logq.tail) || __atomic_load_n(&logq.stop, __ATOMIC_SEQ_CST);
+}
+
+static bool log_has_room(void) {
+    return (logq.head - __atomic_load_n(&logq.tail, __ATOMIC_SEQ_CST)) < LOG_QUEUE_SLOTS;
+}
+
+static bool log_is_drained(void) {
+    return (__atomic_load_n(&logq.tail, __ATOMIC_SEQ_CST) == logq.head);
+}
+
+static void *log_writer(void *arg) {
+    (void)arg;
+    for (;;) {
+        size_t head = __atomic_load_n(&logq.head, __ATOMIC_ACQUIRE);
+        if (logq.tail == head) {
+            if (__atomic_load_n(&logq.stop, __ATOMIC_SEQ_CST)) {
+                break;
+            }
+            log_sleep(&logq.writer_sleeps, log_has_work);
+            continue;
+        }
+
+        const log_slot_t *slot = &logq.slots[logq.tail % LOG_QUEUE_SLOTS];
+        log_write(logq.f, slot->text, slot->linefeed);
+
+        // the file is flushed before the last slot is handed back, a drained queue is on disk
+        if (logq.tail + 1 == __atomic_load_n(&logq.head, __ATOMIC_ACQUIRE)) {
+            fflush(logq.f);
+        }
+        __atomic_store_n(&logq.tail, logq.tail + 1, __ATOMIC_SEQ_CST);
+        log_wake(&logq.producer_sleeps);
+    }
+    fflush(logq.f);
+    return NULL;
+}
+
+// writes out what is queued and stops the writer, the log is written directly afterwards
+static void log_queue_stop(void) {
+    pthread_mutex_lock(&g_print_lock);
+    if (logq.started) {
+        __atomic_store_n(&logq.stop, true, __ATOMIC_SEQ_CST);
+        log_wake(&logq.writer_sleeps);
+        pthread_join(logq.thread, NULL);
+        logq.started = false;
+        free(logq.slots);
+        logq.slots = NULL;
+    }
+    pthread_mutex_unlock(&g_print_lock);
+}
+
+static void log_queue_start(FILE *f) {
+    logq.f = f;
+    logq.slots = calloc(LOG_QUEUE_SLOTS, sizeof(log_slot_t));
+    if (logq.slots == NULL) {
+        return;
+    }
+    if (pthread_create(&logq.thread, NULL, log_writer, NULL) != 0) {
+        free(logq.slots);
+        logq.slots = NULL;
+        return;
+    }
+    logq.started = true;
+    atexit(log_queue_stop);
+}
+
+// called with g_print_lock held
+static void log_queue_push(FILE *f, const char *text, bool linefeed) {
+    if (logq.started == false) {
+        log_write(f, text, linefeed);
+        fflush(f);
+        return;
+    }
+
+    if (log_has_room() == false) {
+        log_sleep(&logq.producer_sleeps, log_has_room);
+    }
+
+    log_slot_t *slot = &logq.slots[logq.head % LOG_QUEUE_SLOTS];
+    slot->linefeed = linefeed;
+    strncpy(slot->text, text, sizeof(slot->text) - 1);
+    slot->text[sizeof(slot->text) - 1] = 0;
+
+    __atomic_store_n(&logq.head, logq.head + 1, __ATOMIC_SEQ_CST);
+    log_wake(&logq.writer_sleeps);
+
+    // flush after write means on disk too
+    if (flushAfterWrite) {
+        log_sleep(&logq.producer_sleeps, log_is_drained);
+    }
+}
+
 static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     va_list argptr;
     static FILE *logfile = NULL;
     static int logging = 1;
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER] = {0};
-    char buffer3[MAX_PRINT_BUFFER] = {0};
+    char buffer[MAX_PRINT_BUFFER];
+    char buffer2[MAX_PRINT_BUFFER];
+    char buffer3[MAX_PRINT_BUFFER];
 
     bool linefeed = true;
 
@@ -410,6 +670,7 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
                     printf("[=] Session log %s\n", my_logfile_path);
                 }
 
+                log_queue_start(logfile);
             }
             free(my_logfile_path);
         }
@@ -434,19 +695,16 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     va_start(argptr, fmt);
     vsnprintf(buffer, sizeof(buffer), fmt, argptr);
     va_end(argptr);
-    if (strlen(buffer) > 0 && buffer[strlen(buffer) - 1] == NOLF[0]) {
+    size_t len = strlen(buffer);
+    if (len > 0 && buffer[len - 1] == NOLF[0]) {
         linefeed = false;
-        buffer[strlen(buffer) - 1] = 0;
+        buffer[len - 1] = 0;
     }
 
-    bool filter_ansi = !g_session.supports_colors;
-    memcpy_filter_ansi(buffer2, buffer, sizeof(buffer), filter_ansi);
-
     if ((g_printAndLog & PRINTANDLOG_PRINT) == PRINTANDLOG_PRINT) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), g_session.emoji_mode);
-        fprintf(stream, "%s", buffer3);
+        fputs(print_filter(buffer2, buffer3, buffer, !g_session.supports_colors, g_session.emoji_mode), stream);
         if (linefeed) {
-            fprintf(stream, "\n");
+            fputc('\n', stream);
         }
         fflush(stream);
     }
@@ -460,37 +718,13 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     }
 #endif
 
-    if (((g_printAndLog & PRINTANDLOG_LOG) && logging && logfile) ||
-            (g_printAndLog & PRINTANDLOG_GRAB)) {
-
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), EMO_ALTTEXT);
-
-        if (filter_ansi == false) {
-            memcpy_filter_ansi(buffer, buffer3, sizeof(buffer3), true);
-        }
-    }
-
     if ((g_printAndLog & PRINTANDLOG_LOG) && logging && logfile) {
-
-        if (filter_ansi) {
-            fprintf(logfile, "%s", buffer3);
-        } else {
-            fprintf(logfile, "%s", buffer);
-        }
-
-        if (linefeed) {
-            fprintf(logfile, "\n");
-        }
-        fflush(logfile);
+        log_queue_push(logfile, buffer, linefeed);
     }
 
     if (g_printAndLog & PRINTANDLOG_GRAB) {
 
-        if (filter_ansi) {
-            fill_grabber(buffer3);
-        } else {
-            fill_grabber(buffer);
-        }
+        fill_grabber(print_filter(buffer2, buffer3, buffer, true, EMO_ALTTEXT));
 
         if (linefeed) {
             fill_grabber("\n");
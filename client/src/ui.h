@@ -55,6 +55,8 @@ typedef struct {
     qtWindow_t overlay;
     bool overlay_sliders;
     bool incognito;
+    bool cached_caps;   // reuse the capabilities saved by a previous run on the same port
+    bool client_stats;  // collect per command timing and traffic, see hw stats
     char *defaultPaths[spItemCount]; // Array should allow loop searching for files
     clientdebugLevel_t client_debug_level;
     barMode_t bar_mode;
@@ -85,6 +87,16 @@ void memcpy_filter_rlmarkers(void *dest, const void *src, size_t n);
 void memcpy_filter_emoji(void *dest, const void *src, size_t n, emojiMode_t mode);
 void free_grabber(void);
 
+// Structured results for the pm3 library, only collected while PRINTANDLOG_RESULT is set.
+// A NULL value / data adds a JSON null, so records with a missing field keep their position
+void result_clear(void);
+void result_add_str(const char *key, const char *value);
+void result_add_int(const char *key, int64_t value);
+void result_add_bool(const char *key, bool value);
+void result_add_hex(const char *key, const uint8_t *data, size_t len);
+// JSON object of the records added since result_clear(), valid until the next call
+const char *result_get(void);
+
 int searchHomeFilePath(char **foundpath, const char *subdir, const char *filename, bool create_home);
 
 extern pthread_mutex_t g_print_lock;
@@ -44,6 +44,7 @@ extern grabbed_output g_grabbed_output;
 #define PRINTANDLOG_PRINT 1
 #define PRINTANDLOG_LOG   2
 #define PRINTANDLOG_GRAB  4
+#define PRINTANDLOG_RESULT 8   // collect the result_add_*() records, see pm3_result_get()
 
 // Return error
 #define PM3_RET_ERR(err, ...)  { \
@@ -17,6 +17,7 @@
 //-----------------------------------------------------------------------------
 #include "wiegand_formats.h"
 #include <stdlib.h>
+#include <pthread.h>
 #include "commonutil.h"
 
 static bool step_parity_check(wiegand_message_t *packed, int start, int length, bool even_parity) {
@@ -1591,31 +1592,64 @@ void HIDPackTryAll(wiegand_card_t *card, bool preamble) {
     PrintAndLogEx(NORMAL, "");
 }
 
+// FormatTable indices grouped by bit length, so unpacking only tries formats of the message length
+#define WIEGAND_FMT_PER_LEN  8
+static uint8_t fmt_by_len[WIEGAND_MAX_BITS + 1][WIEGAND_FMT_PER_LEN];
+static uint8_t fmt_by_len_cnt[WIEGAND_MAX_BITS + 1];
+static pthread_once_t fmt_by_len_once = PTHREAD_ONCE_INIT;
+
+static void hid_build_len_index(void) {
+    for (int i = 0; FormatTable[i].Name; i++) {
+        uint32_t bits = FormatTable[i].Bits;
+        if (bits <= WIEGAND_MAX_BITS && fmt_by_len_cnt[bits] < WIEGAND_FMT_PER_LEN) {
+            fmt_by_len[bits][fmt_by_len_cnt[bits]++] = i;
+        }
+    }
+}
+
+int HIDTryUnpackEx(wiegand_message_t *packed, wiegand_match_t *matches, int max) {
+
+    pthread_once(&fmt_by_len_once, hid_build_len_index);
+
+    if (packed->Length > WIEGAND_MAX_BITS) {
+        return 0;
+    }
+
+    int found = 0;
+    for (uint8_t i = 0; i < fmt_by_len_cnt[packed->Length] && found < max; i++) {
+        int idx = fmt_by_len[packed->Length][i];
+        memset(&matches[found].card, 0, sizeof(wiegand_card_t));
+        if (FormatTable[idx].Unpack(packed, &matches[found].card)) {
+            matches[found].idx = idx;
+            found++;
+        }
+    }
+    return found;
+}
+
+bool HIDMatchValid(const wiegand_match_t *match) {
+    // if fields has parity, card parity must be ok
+    return (FormatTable[match->idx].Fields.hasParity == false) || match->card.ParityValid;
+}
+
 bool HIDTryUnpack(wiegand_message_t *packed) {
     if (FormatTable[0].Name == NULL) {
         return false;
     }
 
-    wiegand_card_t card;
-    memset(&card, 0, sizeof(wiegand_card_t));
-    uint8_t found_cnt = 0, found_invalid_par = 0;
+    wiegand_match_t matches[WIEGAND_FMT_PER_LEN];
+    int found_cnt = HIDTryUnpackEx(packed, matches, ARRAYLEN(matches));
+    uint8_t found_invalid_par = 0;
 
-    int i = 0;
-    while (FormatTable[i].Name) {
-        if (FormatTable[i].Unpack(packed, &card)) {
-
-            found_cnt++;
-            hid_print_card(&card, FormatTable[i]);
-            // if fields has parity AND card parity is false
-            if (FormatTable[i].Fields.hasParity && (card.ParityValid == false)) {
-                found_invalid_par++;
-            }
+    for (int i = 0; i < found_cnt; i++) {
+        hid_print_card(&matches[i].card, FormatTable[matches[i].idx]);
+        if (HIDMatchValid(&matches[i]) == false) {
+            found_invalid_par++;
         }
-        ++i;
     }
 
     if (found_cnt) {
-        PrintAndLogEx(INFO, "found " _YELLOW_("%u") " matching " _YELLOW_("%d-bit") " format%s"
+        PrintAndLogEx(INFO, "found " _YELLOW_("%d") " matching " _YELLOW_("%d-bit") " format%s"
                       , found_cnt
                       , packed->Length
                       , (found_cnt > 1) ? "s" : ""
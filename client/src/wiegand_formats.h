@@ -52,12 +52,22 @@ typedef struct {
     cardformatdescriptor_t Fields;
 } cardformat_t;
 
+#define WIEGAND_MAX_BITS     96
+
+// one format matching a message
+typedef struct {
+    int idx;                // FormatTable index
+    wiegand_card_t card;
+} wiegand_match_t;
+
 bool validate_card_limit(int format_idx, wiegand_card_t *card);
 void HIDListFormats(void);
 int HIDFindCardFormat(const char *format);
 cardformat_t HIDGetCardFormat(int idx);
 bool HIDPack(int format_idx, wiegand_card_t *card, wiegand_message_t *packed, bool preamble);
 bool HIDTryUnpack(wiegand_message_t *packed);
+int HIDTryUnpackEx(wiegand_message_t *packed, wiegand_match_t *matches, int max);
+bool HIDMatchValid(const wiegand_match_t *match);
 void HIDPackTryAll(wiegand_card_t *card, bool preamble);
 void HIDUnpack(int idx, wiegand_message_t *packed);
 bool decode_wiegand(uint32_t top, uint32_t mid, uint32_t bot, int n);
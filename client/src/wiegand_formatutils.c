@@ -78,14 +78,34 @@ static void message_datacopy(wiegand_message_t *src, wiegand_message_t *dest) {
     dest->Top = src->Top;
     dest->Length = src->Length;
 }
+// 64 bits of Top:Mid:Bot, starting at ordinal bit s
+static uint64_t message_shr(const wiegand_message_t *data, uint8_t s) {
+    uint64_t lo = ((uint64_t)data->Mid << 32) | data->Bot;
+    uint64_t hi = data->Top;
+    if (s >= 64) {
+        return hi >> (s - 64);
+    }
+    if (s == 0) {
+        return lo;
+    }
+    return (lo >> s) | (hi << (64 - s));
+}
+
 /**
- *
- * Yes, this is horribly inefficient for linear data.
- * The current code is a temporary measure to have a working function in place
- * until all the bugs shaken from the block/chunk version of the code.
- *
+ * Fields inside the message are cut out with one shift and mask, so the parity checks
+ * of the unpackers are a mask and a popcount. Fields running past the message length
+ * keep the bit by bit path, which reads those bits as zero.
  */
 uint64_t get_linear_field(wiegand_message_t *data, uint8_t firstBit, uint8_t length) {
+
+    if (length <= 64 && data->Length <= 96 && (firstBit + length) <= data->Length) {
+        if (length == 0) {
+            return 0;
+        }
+        uint64_t v = message_shr(data, data->Length - firstBit - length);
+        return (length == 64) ? v : (v & ((1ULL << length) - 1));
+    }
+
     uint64_t result = 0;
     for (uint8_t i = 0; i < length; i++) {
         result = (result << 1) | get_bit_by_position(data, firstBit + i);
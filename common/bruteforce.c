@@ -60,7 +60,7 @@ int bf_generator_set_charset(generator_context_t *ctx, uint8_t charsets) {
     return 0;
 }
 
-int bf_generate(generator_context_t *ctx) {
+static int bf_generate_mode(generator_context_t *ctx) {
 
     switch (ctx->mode) {
         case BF_MODE_RANGE: {
@@ -72,11 +72,154 @@ int bf_generate(generator_context_t *ctx) {
         case BF_MODE_SMART: {
             return _bf_generate_mode_smart(ctx);
         }
+        case BF_MODE_MASK: {
+            return _bf_generate_mode_mask(ctx);
+        }
     }
 
     return BF_GENERATOR_ERROR;
 }
 
+int bf_generate(generator_context_t *ctx) {
+
+    if (ctx->limited && ctx->left == 0) {
+        return BF_GENERATOR_END;
+    }
+
+    int ret = bf_generate_mode(ctx);
+    if (ctx->limited && ret == BF_GENERATOR_NEXT) {
+        ctx->left--;
+    }
+    return ret;
+}
+
+// back to the state right after configuration, keeps mode, charset, range and mask
+static void bf_generator_rewind(generator_context_t *ctx) {
+    memset(ctx->pos, 0, sizeof(ctx->pos));
+    ctx->current_key = 0;
+    ctx->smart_mode_stage = 0;
+    ctx->limited = false;
+    ctx->left = 0;
+    bf_generator_clear(ctx);
+}
+
+uint64_t bf_generator_count(const generator_context_t *ctx) {
+
+    switch (ctx->mode) {
+        case BF_MODE_RANGE: {
+            // <range_low, range_high>, see _bf_generate_mode_range()
+            if (ctx->range_high == 0) {
+                return 0;
+            }
+            if (ctx->range_low >= ctx->range_high) {
+                return 1;
+            }
+            return (uint64_t)ctx->range_high - ctx->range_low + 1;
+        }
+        case BF_MODE_CHARSET: {
+            if (ctx->charset_length == 0) {
+                return 0;
+            }
+            uint64_t n = 1;
+            for (uint8_t i = 0; i < ctx->key_length; i++) {
+                n *= ctx->charset_length;
+            }
+            return n;
+        }
+        case BF_MODE_MASK: {
+            uint64_t n = 1;
+            for (uint32_t m = ctx->mask; m; m &= m - 1) {
+                n <<= 1;
+            }
+            return n;
+        }
+        case BF_MODE_SMART: {
+            // a few hundred keys, just walk them
+            generator_context_t tmp = *ctx;
+            bf_generator_rewind(&tmp);
+            uint64_t n = 0;
+            while (bf_generate(&tmp) == BF_GENERATOR_NEXT) {
+                n++;
+            }
+            return n;
+        }
+    }
+    return 0;
+}
+
+int bf_generator_seek(generator_context_t *ctx, uint64_t index) {
+
+    bf_generator_rewind(ctx);
+
+    if (index == 0) {
+        return BF_GENERATOR_NEXT;
+    }
+
+    if (index >= bf_generator_count(ctx)) {
+        return BF_GENERATOR_END;
+    }
+
+    switch (ctx->mode) {
+        case BF_MODE_RANGE: {
+            // range_low was emitted, the next call increments
+            ctx->current_key = ctx->range_low + index - 1;
+            ctx->flag1 = true;
+            return BF_GENERATOR_NEXT;
+        }
+        case BF_MODE_CHARSET: {
+            for (uint8_t i = ctx->key_length; i > 0; i--) {
+                ctx->pos[i - 1] = index % ctx->charset_length;
+                index /= ctx->charset_length;
+            }
+            return BF_GENERATOR_NEXT;
+        }
+        case BF_MODE_MASK: {
+            // counter1 holds subset index - 1, spread over the mask bits
+            uint64_t v = index - 1;
+            ctx->counter1 = 0;
+            for (uint32_t m = ctx->mask; m && v; m &= m - 1, v >>= 1) {
+                if (v & 1) {
+                    ctx->counter1 |= m & -m;
+                }
+            }
+            ctx->flag1 = true;
+            return BF_GENERATOR_NEXT;
+        }
+        case BF_MODE_SMART: {
+            while (index--) {
+                if (bf_generate(ctx) != BF_GENERATOR_NEXT) {
+                    return BF_GENERATOR_ERROR;
+                }
+            }
+            return BF_GENERATOR_NEXT;
+        }
+    }
+    return BF_GENERATOR_ERROR;
+}
+
+int bf_generator_shard(generator_context_t *ctx, uint32_t shard, uint32_t shards) {
+
+    if (shards == 0 || shard >= shards) {
+        return BF_GENERATOR_ERROR;
+    }
+
+    uint64_t count = bf_generator_count(ctx);
+    uint64_t base = count / shards;
+    uint64_t extra = count % shards;
+
+    // the first 'extra' shards get one key more
+    uint64_t start = base * shard + MIN(shard, extra);
+    uint64_t len = base + ((shard < extra) ? 1 : 0);
+
+    int ret = bf_generator_seek(ctx, start);
+    if (ret == BF_GENERATOR_ERROR) {
+        return ret;
+    }
+    ctx->limited = true;
+    ctx->left = (ret == BF_GENERATOR_END) ? 0 : len;
+    return BF_GENERATOR_NEXT;
+}
+
 
 // increments values in array with carryover using modulo limit for each byte
 // this is used to iterate each byte in key over charset table
@@ -153,6 +296,28 @@ int _bf_generate_mode_range(generator_context_t *ctx) {
     return BF_GENERATOR_NEXT;
 }
 
+int _bf_generate_mode_mask(generator_context_t *ctx) {
+
+    if (ctx->key_length != BF_KEY_SIZE_32) {
+        return BF_GENERATOR_ERROR;
+    }
+
+    // counter1 walks all subsets of the mask bits in increasing order,
+    // flag1 tells if the first one (no bits set) was emitted already
+    if (ctx->flag1 == false) {
+        ctx->flag1 = true;
+        ctx->counter1 = 0;
+    } else {
+        ctx->counter1 = ((ctx->counter1 | ~ctx->mask) + 1) & ctx->mask;
+        if (ctx->counter1 == 0) {
+            return BF_GENERATOR_END;
+        }
+    }
+
+    ctx->current_key = (ctx->range_low & ~ctx->mask) | ctx->counter1;
+    return BF_GENERATOR_NEXT;
+}
+
 int _bf_generate_mode_charset(generator_context_t *ctx) {
 
     if (ctx->key_length != BF_KEY_SIZE_32 && ctx->key_length != BF_KEY_SIZE_48) {
@@ -34,6 +34,10 @@
 // "smart" mode - try some predictable patterns
 #define BF_MODE_SMART 3
 
+// every combination of the 'mask' bits on top of range_low, 32 bit keys
+// a dictionary word with a mask tries all its variations in those bits
+#define BF_MODE_MASK 4
+
 
 // bit flags - can be used together using logical OR
 #define BF_CHARSET_DIGITS 1
@@ -70,12 +74,17 @@ typedef struct {
 
     uint32_t range_low;
     uint32_t range_high;
+    uint32_t mask;
     uint16_t smart_mode_stage;
     // flags to use internally by generators as they wish
     bool flag1, flag2, flag3;
     // counters to use internally by generators as they wish
     uint32_t counter1, counter2;
 
+    // set by bf_generator_shard(), the generator ends after 'left' more keys
+    bool limited;
+    uint64_t left;
+
 } generator_context_t;
 
 
@@ -86,10 +95,19 @@ int bf_generate(generator_context_t *ctx);
 int _bf_generate_mode_range(generator_context_t *ctx);
 int _bf_generate_mode_charset(generator_context_t *ctx);
 int _bf_generate_mode_smart(generator_context_t *ctx);
+int _bf_generate_mode_mask(generator_context_t *ctx);
 int bf_array_increment(uint8_t *data, uint8_t data_len, uint8_t modulo);
 uint32_t bf_get_key32(const generator_context_t *ctx);
 uint64_t bf_get_key48(const generator_context_t *ctx);
 
+// partitioning, a configured (not yet started) context can be cut into disjoint shards
+// number of keys the context generates from its start, 0 on error
+uint64_t bf_generator_count(const generator_context_t *ctx);
+// restart the context so the next bf_generate() returns key number 'index' (0 based)
+int bf_generator_seek(generator_context_t *ctx, uint64_t index);
+// restrict the context to shard 'shard' of 'shards' near equal slices of its key space
+int bf_generator_shard(generator_context_t *ctx, uint32_t shard, uint32_t shards);
+
 // smart mode
 typedef int (smart_generator_t)(generator_context_t *ctx);
 
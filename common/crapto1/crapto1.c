@@ -19,6 +19,7 @@
 #include "bucketsort.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include "parity.h"
 
 
@@ -155,45 +156,65 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
 
 
 #if !defined(__arm__) || defined(__linux__) || defined(_WIN32) || defined(__APPLE__) // bare metal ARM Proxmark lacks malloc()/free()
-/** lfsr_recovery
- * recover the state of the lfsr given 32 bits of the keystream
- * additionally you can use the in parameter to specify the value
- * that was fed into the lfsr at the time the keystream was generated
- */
-struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
-    struct Crypto1State *statelist;
-    uint32_t *odd_head = 0, *odd_tail = 0, oks = 0;
-    uint32_t *even_head = 0, *even_tail = 0, eks = 0;
-    register int i;
-
-    // split the keystream into an odd and even part
-    for (i = 31; i >= 0; i -= 2)
-        oks = oks << 1 | BEBIT(ks2, i);
-    for (i = 30; i >= 0; i -= 2)
-        eks = eks << 1 | BEBIT(ks2, i);
+struct lfsr_arena {
+    uint32_t *odd;                  // 1 << 21 entries
+    uint32_t *even;                 // 1 << 21 entries
+    uint32_t *bucket_mem;           // 2 * 0x100 buckets of 1 << 14 entries
+    bucket_array_t bucket;
+    // top of the recovery tree, set by lfsr_recovery32_split()
+    bucket_info_t top;
+    uint32_t oks, eks, in;
+    int rem;
+};
 
-    odd_head = odd_tail = calloc(1, sizeof(uint32_t) << 21);
-    even_head = even_tail = calloc(1, sizeof(uint32_t) << 21);
-    statelist =  calloc(1, sizeof(struct Crypto1State) << 18);
-    if (!odd_tail-- || !even_tail-- || !statelist) {
-        free(statelist);
-        statelist = 0;
-        goto out;
+lfsr_arena_t *lfsr_arena_create(void) {
+    lfsr_arena_t *arena = calloc(1, sizeof(lfsr_arena_t));
+    if (arena == NULL) {
+        return NULL;
     }
 
-    statelist->odd = statelist->even = 0;
-
-    // allocate memory for out of place bucket_sort
-    bucket_array_t bucket;
+    arena->odd = calloc(1, sizeof(uint32_t) << 21);
+    arena->even = calloc(1, sizeof(uint32_t) << 21);
+    arena->bucket_mem = calloc(2 * 0x100, sizeof(uint32_t) << 14);
+    if (arena->odd == NULL || arena->even == NULL || arena->bucket_mem == NULL) {
+        lfsr_arena_destroy(arena);
+        return NULL;
+    }
 
-    for (i = 0; i < 2; i++) {
+    for (uint32_t i = 0; i < 2; i++) {
         for (uint32_t j = 0; j <= 0xff; j++) {
-            bucket[i][j].head = calloc(1, sizeof(uint32_t) << 14);
-            if (!bucket[i][j].head) {
-                goto out;
-            }
+            arena->bucket[i][j].head = arena->bucket_mem + ((i << 8 | j) << 14);
         }
     }
+    return arena;
+}
+
+void lfsr_arena_destroy(lfsr_arena_t *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    free(arena->odd);
+    free(arena->even);
+    free(arena->bucket_mem);
+    free(arena);
+}
+
+/** lfsr_recovery32_split
+ * first 14 bits of the recovery, up to the first bucket sort. Every intersecting
+ * bucket is an independent subtree, see lfsr_recovery32_subtree()
+ */
+uint32_t lfsr_recovery32_split(uint32_t ks2, uint32_t in, lfsr_arena_t *arena) {
+    uint32_t *odd_head = arena->odd, *odd_tail = odd_head - 1, oks = 0;
+    uint32_t *even_head = arena->even, *even_tail = even_head - 1, eks = 0;
+    int i;
+
+    arena->top.numbuckets = 0;
+
+    // split the keystream into an odd and even part
+    for (i = 31; i >= 0; i -= 2)
+        oks = oks << 1 | BEBIT(ks2, i);
+    for (i = 30; i >= 0; i -= 2)
+        eks = eks << 1 | BEBIT(ks2, i);
 
     // initialize statelists: add all possible states which would result into the rightmost 2 bits of the keystream
     uint8_t oks_b1 = oks & 1;
@@ -217,14 +238,94 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
     // 22 bits to go to recover 32 bits in total. From now on, we need to take the "in"
     // parameter into account.
     in = (in >> 16 & 0xff) | (in << 16) | (in & 0xff00); // Byte swapping
-    recover(odd_head, odd_tail, oks, even_head, even_tail, eks, 11, statelist, in << 1, bucket);
+    in <<= 1;
 
-out:
-    for (i = 0; i < 2; i++)
-        for (uint32_t j = 0; j <= 0xff; j++)
-            free(bucket[i][j].head);
-    free(odd_head);
-    free(even_head);
+    // first level of recover()
+    int rem = 11;
+    for (i = 0; i < 4 && rem--; i++) {
+        oks >>= 1;
+        eks >>= 1;
+        in >>= 2;
+        extend_table(odd_head, &odd_tail, oks & 1, LF_POLY_EVEN << 1 | 1, LF_POLY_ODD << 1, 0);
+        if (odd_head > odd_tail)
+            return 0;
+
+        extend_table(even_head, &even_tail, eks & 1, LF_POLY_ODD, LF_POLY_EVEN << 1 | 1, in & 3);
+        if (even_head > even_tail)
+            return 0;
+    }
+
+    arena->oks = oks;
+    arena->eks = eks;
+    arena->in = in;
+    arena->rem = rem;
+    bucket_sort_intersect(even_head, even_tail, odd_head, odd_tail, &arena->top, arena->bucket);
+    return arena->top.numbuckets;
+}
+
+/** lfsr_recovery32_subtree
+ * recover subtree i of a split. Reads top only, so several threads can work on
+ * one split with an arena each. Concatenating the subtrees 0, 1, .. gives the
+ * lfsr_recovery32() order. Returns the number of states, sl is zero terminated
+ */
+uint32_t lfsr_recovery32_subtree(const lfsr_arena_t *top, uint32_t i, lfsr_arena_t *arena, struct Crypto1State *sl) {
+    sl->odd = sl->even = 0;
+    if (i >= top->top.numbuckets) {
+        return 0;
+    }
+
+    // buckets are recovered last to first
+    uint32_t b = top->top.numbuckets - 1 - i;
+
+    // recover() grows the tables in place, work on a copy
+    uint32_t odd_len = top->top.bucket_info[1][b].tail - top->top.bucket_info[1][b].head + 1;
+    uint32_t even_len = top->top.bucket_info[0][b].tail - top->top.bucket_info[0][b].head + 1;
+    memcpy(arena->odd, top->top.bucket_info[1][b].head, odd_len * sizeof(uint32_t));
+    memcpy(arena->even, top->top.bucket_info[0][b].head, even_len * sizeof(uint32_t));
+
+    struct Crypto1State *end = recover(arena->odd, arena->odd + odd_len - 1, top->oks,
+                                       arena->even, arena->even + even_len - 1, top->eks,
+                                       top->rem, sl, top->in, arena->bucket);
+    end->odd = end->even = 0;
+    return end - sl;
+}
+
+/** lfsr_recovery32_ex
+ * lfsr_recovery32() without allocations, all tables live in the arena.
+ * sl needs room for LFSR_RECOVERY32_MAX_STATES, returns the number of states
+ */
+uint32_t lfsr_recovery32_ex(uint32_t ks2, uint32_t in, lfsr_arena_t *arena, struct Crypto1State *sl) {
+    struct Crypto1State *end = sl;
+    end->odd = end->even = 0;
+
+    uint32_t n = lfsr_recovery32_split(ks2, in, arena);
+    for (int i = n - 1; i >= 0; i--) {
+        end = recover(arena->top.bucket_info[1][i].head, arena->top.bucket_info[1][i].tail, arena->oks,
+                      arena->top.bucket_info[0][i].head, arena->top.bucket_info[0][i].tail, arena->eks,
+                      arena->rem, end, arena->in, arena->bucket);
+    }
+    end->odd = end->even = 0;
+    return end - sl;
+}
+
+/** lfsr_recovery
+ * recover the state of the lfsr given 32 bits of the keystream
+ * additionally you can use the in parameter to specify the value
+ * that was fed into the lfsr at the time the keystream was generated
+ */
+struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
+    struct Crypto1State *statelist = calloc(1, sizeof(struct Crypto1State) * LFSR_RECOVERY32_MAX_STATES);
+    if (statelist == NULL) {
+        return NULL;
+    }
+
+    lfsr_arena_t *arena = lfsr_arena_create();
+    if (arena == NULL) {
+        return statelist;
+    }
+
+    lfsr_recovery32_ex(ks2, in, arena, statelist);
+    lfsr_arena_destroy(arena);
     return statelist;
 }
 
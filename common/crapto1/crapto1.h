@@ -21,6 +21,14 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+// the firmware runs the cipher from RAM, see crypto1.c
+#if defined(__arm__) && !defined(__linux__) && !defined(_WIN32) && !defined(__APPLE__)
+#include "common.h"
+#define CRYPTO1_FUNC RAMFUNC
+#else
+#define CRYPTO1_FUNC
+#endif
+
 struct Crypto1State {uint32_t odd, even;};
 void crypto1_init(struct Crypto1State *state, uint64_t key);
 void crypto1_deinit(struct Crypto1State *);
@@ -29,13 +37,25 @@ struct Crypto1State *crypto1_create(uint64_t key);
 void crypto1_destroy(struct Crypto1State *);
 #endif
 void crypto1_get_lfsr(struct Crypto1State *, uint64_t *);
-uint8_t crypto1_bit(struct Crypto1State *, uint8_t, int);
-uint8_t crypto1_byte(struct Crypto1State *, uint8_t, int);
-uint32_t crypto1_word(struct Crypto1State *, uint32_t, int);
+CRYPTO1_FUNC uint8_t crypto1_bit(struct Crypto1State *, uint8_t, int);
+CRYPTO1_FUNC uint8_t crypto1_byte(struct Crypto1State *, uint8_t, int);
+CRYPTO1_FUNC uint32_t crypto1_word(struct Crypto1State *, uint32_t, int);
 uint32_t prng_successor(uint32_t x, uint32_t n);
 
 #if !defined(__arm__) || defined(__linux__) || defined(_WIN32) || defined(__APPLE__) // bare metal ARM Proxmark lacks malloc()/free()
 struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in);
+
+// reentrant lfsr_recovery32(). The arena holds the ~48 MB of tables and is
+// reused across calls, use one per thread
+#define LFSR_RECOVERY32_MAX_STATES  (1 << 18)
+typedef struct lfsr_arena lfsr_arena_t;
+lfsr_arena_t *lfsr_arena_create(void);
+void lfsr_arena_destroy(lfsr_arena_t *arena);
+uint32_t lfsr_recovery32_ex(uint32_t ks2, uint32_t in, lfsr_arena_t *arena, struct Crypto1State *sl);
+// same, split in independent subtrees for several threads
+uint32_t lfsr_recovery32_split(uint32_t ks2, uint32_t in, lfsr_arena_t *arena);
+uint32_t lfsr_recovery32_subtree(const lfsr_arena_t *top, uint32_t i, lfsr_arena_t *arena, struct Crypto1State *sl);
+
 struct Crypto1State *lfsr_recovery64(uint32_t ks2, uint32_t ks3);
 struct Crypto1State *
 lfsr_common_prefix(uint32_t pfx, uint32_t rr, uint8_t ks[8], uint8_t par[8][8], uint32_t no_par);
@@ -34,6 +34,52 @@ int filter(uint32_t const x) {
 #define SWAPENDIAN(x)\
     (x = (x >> 8 & 0xff00ff) | (x & 0xff00ff) << 8, x = x >> 16 | x << 16)
 
+// The firmware is built for size, so filter() and __builtin_parity are calls into flash and libgcc,
+// once per bit. There the cipher runs from RAM (CRYPTO1_FUNC) with both folded into a single step
+// instead, the 16 bit constant does the parity lookup of the last nibble.
+#if defined(__arm__) && !defined(__linux__) && !defined(_WIN32) && !defined(__APPLE__)
+#define CRYPTO1_STEP static inline __attribute__((always_inline))
+
+CRYPTO1_STEP uint32_t crypto1_filter(uint32_t const x) {
+    uint32_t f;
+
+    f  = 0xf22c0 >> (x       & 0xf) & 16;
+    f |= 0x6c9c0 >> (x >>  4 & 0xf) &  8;
+    f |= 0x3c8b0 >> (x >>  8 & 0xf) &  4;
+    f |= 0x1e458 >> (x >> 12 & 0xf) &  2;
+    f |= 0x0d938 >> (x >> 16 & 0xf) &  1;
+    return BIT(0xEC57E80A, f);
+}
+
+CRYPTO1_STEP uint32_t crypto1_parity(uint32_t x) {
+    x ^= x >> 16;
+    x ^= x >> 8;
+    x ^= x >> 4;
+    return BIT(0x6996, x & 0xf);
+}
+#else
+#define CRYPTO1_STEP static inline
+#define crypto1_filter filter
+#define crypto1_parity evenparity32
+#endif
+
+CRYPTO1_STEP uint8_t crypto1_step(struct Crypto1State *s, uint32_t in, uint32_t is_encrypted) {
+    uint32_t feedin, t;
+    uint8_t ret = crypto1_filter(s->odd);
+
+    feedin  = ret & is_encrypted;
+    feedin ^= in;
+    feedin ^= LF_POLY_ODD & s->odd;
+    feedin ^= LF_POLY_EVEN & s->even;
+    s->even = s->even << 1 | crypto1_parity(feedin);
+
+    t = s->odd;
+    s->odd = s->even;
+    s->even = t;
+
+    return ret;
+}
+
 void crypto1_init(struct Crypto1State *state, uint64_t key) {
     if (state == NULL) {
         return;
@@ -73,73 +119,25 @@ void crypto1_get_lfsr(struct Crypto1State *state, uint64_t *lfsr) {
         *lfsr = *lfsr << 1 | BIT(state->even, i ^ 3);
     }
 }
-uint8_t crypto1_bit(struct Crypto1State *s, uint8_t in, int is_encrypted) {
-    uint32_t feedin, t;
-    uint8_t ret = filter(s->odd);
-
-    feedin  = ret & (!!is_encrypted);
-    feedin ^= !!in;
-    feedin ^= LF_POLY_ODD & s->odd;
-    feedin ^= LF_POLY_EVEN & s->even;
-    s->even = s->even << 1 | (evenparity32(feedin));
-
-    t = s->odd;
-    s->odd = s->even;
-    s->even = t;
-
-    return ret;
+CRYPTO1_FUNC uint8_t crypto1_bit(struct Crypto1State *s, uint8_t in, int is_encrypted) {
+    return crypto1_step(s, !!in, !!is_encrypted);
 }
-uint8_t crypto1_byte(struct Crypto1State *s, uint8_t in, int is_encrypted) {
+CRYPTO1_FUNC uint8_t crypto1_byte(struct Crypto1State *s, uint8_t in, int is_encrypted) {
+    uint32_t enc = !!is_encrypted;
     uint8_t ret = 0;
-    ret |= crypto1_bit(s, BIT(in, 0), is_encrypted) << 0;
-    ret |= crypto1_bit(s, BIT(in, 1), is_encrypted) << 1;
-    ret |= crypto1_bit(s, BIT(in, 2), is_encrypted) << 2;
-    ret |= crypto1_bit(s, BIT(in, 3), is_encrypted) << 3;
-    ret |= crypto1_bit(s, BIT(in, 4), is_encrypted) << 4;
-    ret |= crypto1_bit(s, BIT(in, 5), is_encrypted) << 5;
-    ret |= crypto1_bit(s, BIT(in, 6), is_encrypted) << 6;
-    ret |= crypto1_bit(s, BIT(in, 7), is_encrypted) << 7;
+    for (int i = 0; i < 8; i++) {
+        ret |= crypto1_step(s, BIT(in, i), enc) << i;
+    }
     return ret;
 }
-uint32_t crypto1_word(struct Crypto1State *s, uint32_t in, int is_encrypted) {
+CRYPTO1_FUNC uint32_t crypto1_word(struct Crypto1State *s, uint32_t in, int is_encrypted) {
+    uint32_t enc = !!is_encrypted;
     uint32_t ret = 0;
     // note: xor args have been swapped because some compilers emit a warning
     // for 10^x and 2^x as possible misuses for exponentiation. No comment.
-    ret |= crypto1_bit(s, BEBIT(in, 0), is_encrypted) << (24 ^ 0);
-    ret |= crypto1_bit(s, BEBIT(in, 1), is_encrypted) << (24 ^ 1);
-    ret |= crypto1_bit(s, BEBIT(in, 2), is_encrypted) << (24 ^ 2);
-    ret |= crypto1_bit(s, BEBIT(in, 3), is_encrypted) << (24 ^ 3);
-    ret |= crypto1_bit(s, BEBIT(in, 4), is_encrypted) << (24 ^ 4);
-    ret |= crypto1_bit(s, BEBIT(in, 5), is_encrypted) << (24 ^ 5);
-    ret |= crypto1_bit(s, BEBIT(in, 6), is_encrypted) << (24 ^ 6);
-    ret |= crypto1_bit(s, BEBIT(in, 7), is_encrypted) << (24 ^ 7);
-
-    ret |= crypto1_bit(s, BEBIT(in, 8), is_encrypted) << (24 ^ 8);
-    ret |= crypto1_bit(s, BEBIT(in, 9), is_encrypted) << (24 ^ 9);
-    ret |= crypto1_bit(s, BEBIT(in, 10), is_encrypted) << (24 ^ 10);
-    ret |= crypto1_bit(s, BEBIT(in, 11), is_encrypted) << (24 ^ 11);
-    ret |= crypto1_bit(s, BEBIT(in, 12), is_encrypted) << (24 ^ 12);
-    ret |= crypto1_bit(s, BEBIT(in, 13), is_encrypted) << (24 ^ 13);
-    ret |= crypto1_bit(s, BEBIT(in, 14), is_encrypted) << (24 ^ 14);
-    ret |= crypto1_bit(s, BEBIT(in, 15), is_encrypted) << (24 ^ 15);
-
-    ret |= crypto1_bit(s, BEBIT(in, 16), is_encrypted) << (24 ^ 16);
-    ret |= crypto1_bit(s, BEBIT(in, 17), is_encrypted) << (24 ^ 17);
-    ret |= crypto1_bit(s, BEBIT(in, 18), is_encrypted) << (24 ^ 18);
-    ret |= crypto1_bit(s, BEBIT(in, 19), is_encrypted) << (24 ^ 19);
-    ret |= crypto1_bit(s, BEBIT(in, 20), is_encrypted) << (24 ^ 20);
-    ret |= crypto1_bit(s, BEBIT(in, 21), is_encrypted) << (24 ^ 21);
-    ret |= crypto1_bit(s, BEBIT(in, 22), is_encrypted) << (24 ^ 22);
-    ret |= crypto1_bit(s, BEBIT(in, 23), is_encrypted) << (24 ^ 23);
-
-    ret |= crypto1_bit(s, BEBIT(in, 24), is_encrypted) << (24 ^ 24);
-    ret |= crypto1_bit(s, BEBIT(in, 25), is_encrypted) << (24 ^ 25);
-    ret |= crypto1_bit(s, BEBIT(in, 26), is_encrypted) << (24 ^ 26);
-    ret |= crypto1_bit(s, BEBIT(in, 27), is_encrypted) << (24 ^ 27);
-    ret |= crypto1_bit(s, BEBIT(in, 28), is_encrypted) << (24 ^ 28);
-    ret |= crypto1_bit(s, BEBIT(in, 29), is_encrypted) << (24 ^ 29);
-    ret |= crypto1_bit(s, BEBIT(in, 30), is_encrypted) << (24 ^ 30);
-    ret |= crypto1_bit(s, BEBIT(in, 31), is_encrypted) << (24 ^ 31);
+    for (int i = 0; i < 32; i++) {
+        ret |= (uint32_t)crypto1_step(s, BEBIT(in, i), enc) << (24 ^ i);
+    }
     return ret;
 }
 
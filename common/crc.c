@@ -21,6 +21,68 @@
 
 #include "commonutil.h"
 
+// byte wide updates go through a lookup table, a nibble one in the firmware to keep it small
+#ifdef ON_DEVICE
+#define CRC_TABLE_BITS 4
+#else
+#define CRC_TABLE_BITS 8
+#endif
+#define CRC_TABLE_SIZE (1 << CRC_TABLE_BITS)
+
+typedef struct {
+    uint32_t table[CRC_TABLE_SIZE];
+    int order;
+    uint32_t polynom;
+    bool init;
+} crc_table_cache_t;
+
+// one table each for crc_update2 (msb first) and crc_update (lsb first), rebuilt when the polynom changes
+static crc_table_cache_t msb_cache;
+static crc_table_cache_t lsb_cache;
+
+static const uint32_t *crc_msb_table(const crc_t *crc) {
+    crc_table_cache_t *c = &msb_cache;
+    if (c->init && c->order == crc->order && c->polynom == crc->polynom) {
+        return c->table;
+    }
+
+    for (uint32_t i = 0; i < CRC_TABLE_SIZE; i++) {
+        uint32_t state = i << (crc->order - CRC_TABLE_BITS);
+        for (uint8_t bit = CRC_TABLE_BITS; bit > 0; --bit) {
+            if (state & crc->topbit)
+                state = (state << 1) ^ crc->polynom;
+            else
+                state = (state << 1);
+        }
+        c->table[i] = state & crc->mask;
+    }
+    c->order = crc->order;
+    c->polynom = crc->polynom;
+    c->init = true;
+    return c->table;
+}
+
+static const uint32_t *crc_lsb_table(const crc_t *crc) {
+    crc_table_cache_t *c = &lsb_cache;
+    if (c->init && c->polynom == crc->polynom) {
+        return c->table;
+    }
+
+    for (uint32_t i = 0; i < CRC_TABLE_SIZE; i++) {
+        uint32_t state = i;
+        for (uint8_t bit = CRC_TABLE_BITS; bit > 0; --bit) {
+            if (state & 1)
+                state = (state >> 1) ^ crc->polynom;
+            else
+                state = (state >> 1);
+        }
+        c->table[i] = state;
+    }
+    c->polynom = crc->polynom;
+    c->init = true;
+    return c->table;
+}
+
 void crc_init_ref(crc_t *crc, int order, uint32_t polynom, uint32_t initial_value, uint32_t final_xor, bool refin, bool refout) {
     crc_init(crc, order, polynom, initial_value, final_xor);
     crc->refin = refin;
@@ -50,11 +112,22 @@ void crc_clear(crc_t *crc) {
 void crc_update2(crc_t *crc, uint32_t data, int data_width) {
 
     if (crc->refin)
-        data = reflect(data, data_width);
+        data = (data_width == 8) ? reflect8(data) : reflect(data, data_width);
 
     // Bring the next byte into the remainder.
     crc->state ^= data << (crc->order - data_width);
 
+    if (data_width == 8 && crc->order >= 8) {
+        // bits above the order never feed back, crc_finish() masks them anyway
+        const uint32_t *table = crc_msb_table(crc);
+        int shift = crc->order - CRC_TABLE_BITS;
+        for (uint8_t n = 8 / CRC_TABLE_BITS; n > 0; --n) {
+            uint32_t idx = (crc->state >> shift) & (CRC_TABLE_SIZE - 1);
+            crc->state = ((crc->state << CRC_TABLE_BITS) ^ table[idx]) & crc->mask;
+        }
+        return;
+    }
+
     for (uint8_t bit = data_width; bit > 0; --bit) {
 
         if (crc->state & crc->topbit)
@@ -66,7 +139,16 @@ void crc_update2(crc_t *crc, uint32_t data, int data_width) {
 
 void crc_update(crc_t *crc, uint32_t data, int data_width) {
     if (crc->refin)
-        data = reflect(data, data_width);
+        data = (data_width == 8) ? reflect8(data) : reflect(data, data_width);
+
+    if (data_width == 8) {
+        const uint32_t *table = crc_lsb_table(crc);
+        for (uint8_t n = 8 / CRC_TABLE_BITS; n > 0; --n) {
+            crc->state = (crc->state >> CRC_TABLE_BITS) ^ table[(crc->state ^ data) & (CRC_TABLE_SIZE - 1)];
+            data >>= CRC_TABLE_BITS;
+        }
+        return;
+    }
 
     int i;
     for (i = 0; i < data_width; i++) {
@@ -23,6 +23,15 @@
 static uint16_t crc_table[256];
 static bool crc_table_init = false;
 static CrcType_t current_crc_type = CRC_NONE;
+// polynomial / reflection the table was built for, types sharing them skip the rebuild
+static uint16_t current_poly = 0;
+static bool current_refin = false;
+
+#ifndef ON_DEVICE
+// slice-by-8 tables for the client, crc_slice[k][i] is the CRC of byte i followed by k zero bytes.
+// crc_slice[0] is crc_table.
+static uint16_t crc_slice[8][256];
+#endif
 
 void init_table(CrcType_t crctype) {
 
@@ -31,12 +40,8 @@ void init_table(CrcType_t crctype) {
         return;
     }
 
-    // not the same crc algo. reset table.
-    if (crctype != current_crc_type) {
-        reset_table();
-    }
-
-    current_crc_type = crctype;
+    uint16_t poly;
+    bool refin;
 
     switch (crctype) {
         case CRC_14443_A:
@@ -45,26 +50,37 @@ void init_table(CrcType_t crctype) {
         case CRC_ICLASS:
         case CRC_CRYPTORF:
         case CRC_KERMIT:
-            generate_table(CRC16_POLY_CCITT, true);
+            poly = CRC16_POLY_CCITT;
+            refin = true;
             break;
         case CRC_FELICA:
         case CRC_XMODEM:
         case CRC_CCITT:
         case CRC_11784:
         case CRC_PHILIPS:
-            generate_table(CRC16_POLY_CCITT, false);
+            poly = CRC16_POLY_CCITT;
+            refin = false;
             break;
         case CRC_LEGIC:
-            generate_table(CRC16_POLY_LEGIC, true);
+            poly = CRC16_POLY_LEGIC;
+            refin = true;
             break;
         case CRC_LEGIC_16:
-            generate_table(CRC16_POLY_LEGIC_16, true);
+            poly = CRC16_POLY_LEGIC_16;
+            refin = true;
             break;
         case CRC_NONE:
+        default:
             crc_table_init = false;
             current_crc_type = CRC_NONE;
-            break;
+            return;
+    }
+
+    // e.g. 14443-A framing followed by 15693 uses the very same table
+    if ((crc_table_init == false) || (poly != current_poly) || (refin != current_refin)) {
+        generate_table(poly, refin);
     }
+    current_crc_type = crctype;
 }
 
 void generate_table(uint16_t polynomial, bool refin) {
@@ -96,6 +112,23 @@ void generate_table(uint16_t polynomial, bool refin) {
 
         crc_table[i] = crc;
     }
+
+#ifndef ON_DEVICE
+    memcpy(crc_slice[0], crc_table, sizeof(crc_table));
+    for (uint8_t k = 1; k < 8; k++) {
+        for (uint16_t i = 0; i < 256; i++) {
+            uint16_t prev = crc_slice[k - 1][i];
+            if (refin) {
+                crc_slice[k][i] = (prev >> 8) ^ crc_table[prev & 0xFF];
+            } else {
+                crc_slice[k][i] = (prev << 8) ^ crc_table[prev >> 8];
+            }
+        }
+    }
+#endif
+
+    current_poly = polynomial;
+    current_refin = refin;
     crc_table_init = true;
 }
 
@@ -106,7 +139,7 @@ void reset_table(void) {
 }
 
 // table lookup LUT solution
-uint16_t crc16_fast(uint8_t const *d, size_t n, uint16_t initval, bool refin, bool refout) {
+CRC16_FUNC uint16_t crc16_fast(uint8_t const *d, size_t n, uint16_t initval, bool refin, bool refout) {
 
     // fast lookup table algorithm without augmented zero bytes, e.g. used in pkzip.
     // only usable with polynom orders of 8, 16, 24 or 32.
@@ -120,6 +153,23 @@ uint16_t crc16_fast(uint8_t const *d, size_t n, uint16_t initval, bool refin, bo
         crc = reflect16(crc);
     }
 
+#ifndef ON_DEVICE
+    // slice-by-8, eight bytes per round
+    if (refin == false) {
+        for (; n >= 8; n -= 8, d += 8) {
+            crc = crc_slice[7][d[0] ^ (crc >> 8)] ^ crc_slice[6][d[1] ^ (crc & 0xFF)] ^
+                  crc_slice[5][d[2]] ^ crc_slice[4][d[3]] ^ crc_slice[3][d[4]] ^
+                  crc_slice[2][d[5]] ^ crc_slice[1][d[6]] ^ crc_slice[0][d[7]];
+        }
+    } else {
+        for (; n >= 8; n -= 8, d += 8) {
+            crc = crc_slice[7][d[0] ^ (crc & 0xFF)] ^ crc_slice[6][d[1] ^ (crc >> 8)] ^
+                  crc_slice[5][d[2]] ^ crc_slice[4][d[3]] ^ crc_slice[3][d[4]] ^
+                  crc_slice[2][d[5]] ^ crc_slice[1][d[6]] ^ crc_slice[0][d[7]];
+        }
+    }
+#endif
+
     if (refin == false) {
         while (n--) crc = (crc << 8) ^ crc_table[((crc >> 8) ^ *d++) & 0xFF ];
     } else {
@@ -153,12 +203,37 @@ uint16_t update_crc16(uint16_t crc, uint8_t c) {
     return update_crc16_ex(crc, c, CRC16_POLY_CCITT);
 }
 
+// msb first remainder of a nibble, for Crc16() which takes any polynomial
+static uint16_t nibble_table[16];
+static uint16_t nibble_poly = 0;
+static bool nibble_table_init = false;
+
+static void generate_nibble_table(uint16_t polynomial) {
+    for (uint16_t i = 0; i < 16; i++) {
+        uint16_t crc = i << 12;
+        for (uint8_t j = 4; j; --j) {
+            if (crc & 0x8000) {
+                crc = (crc << 1) ^ polynomial;
+            } else {
+                crc <<= 1;
+            }
+        }
+        nibble_table[i] = crc;
+    }
+    nibble_poly = polynomial;
+    nibble_table_init = true;
+}
+
 // two ways.  msb or lsb loop.
 uint16_t Crc16(uint8_t const *d, size_t bitlength, uint16_t remainder, uint16_t polynomial, bool refin, bool refout) {
     if (bitlength == 0) {
         return (~remainder);
     }
 
+    if ((nibble_table_init == false) || (polynomial != nibble_poly)) {
+        generate_nibble_table(polynomial);
+    }
+
     uint8_t offset = 8 - (bitlength % 8);
     // front padding with 0s won't change the CRC result
     uint8_t prebits = 0;
@@ -170,17 +245,10 @@ uint16_t Crc16(uint8_t const *d, size_t bitlength, uint16_t remainder, uint16_t
             c = reflect8(c);
         }
 
-        // xor in at msb
+        // xor in at msb, two nibble lookups instead of the 8 iteration loop
         remainder ^= (c << 8);
-
-        // 8 iteration loop
-        for (uint8_t j = 8; j; --j) {
-            if (remainder & 0x8000) {
-                remainder = (remainder << 1) ^ polynomial;
-            } else {
-                remainder <<=  1;
-            }
-        }
+        remainder = (remainder << 4) ^ nibble_table[remainder >> 12];
+        remainder = (remainder << 4) ^ nibble_table[remainder >> 12];
     }
 
     if (refout) {
@@ -27,6 +27,13 @@
 #define CRC16_POLY_LEGIC_16  0x002d
 #define CRC16_POLY_DNP       0x3d65
 
+// the firmware runs the table lookup loop from RAM
+#ifdef ON_DEVICE
+#define CRC16_FUNC RAMFUNC
+#else
+#define CRC16_FUNC
+#endif
+
 #define X25_CRC_CHECK     ((uint16_t)(~0xF0B8 & 0xFFFF)) // use this for checking of a correct crc
 
 typedef enum {
@@ -87,6 +94,6 @@ uint16_t crc16_philips(uint8_t const *d, size_t n);
 void init_table(CrcType_t crctype);
 void reset_table(void);
 void generate_table(uint16_t polynomial, bool refin);
-uint16_t crc16_fast(uint8_t const *d, size_t n, uint16_t initval, bool refin, bool refout);
+CRC16_FUNC uint16_t crc16_fast(uint8_t const *d, size_t n, uint16_t initval, bool refin, bool refout);
 
 #endif
@@ -576,6 +576,37 @@ int mfc_algo_bambu_all(uint8_t *uid, uint8_t *keys) {
     return PM3_SUCCESS;
 }
 
+// all keys of the MIFARE Classic algorithms above which apply to a uid of this length,
+// keys must have MFC_ALGO_UID_KEYS_MAX * 6 bytes space. Returns the number of keys, duplicates included
+int mfc_algo_uid_keys(uint8_t *uid, uint8_t uidlen, uint8_t *keys) {
+    if (uid == NULL) return 0;
+    if (keys == NULL) return 0;
+
+    int n = 0;
+    if (uidlen == 4) {
+        mfc_algo_mizip_all(uid, keys + (n * 6));
+        n += 5 * 2;
+
+        mfc_algo_saflok_all(uid, keys + (n * 6));
+        n += 16 * 2;
+
+        mfc_algo_sky_all(uid, keys + (n * 6));
+        n += 16 * 2;
+
+        mfc_algo_bambu_all(uid, keys + (n * 6));
+        n += 16 * 2;
+
+        uint64_t key = 0;
+        mfc_algo_touch_one(uid, 0, 0, &key);
+        num_to_bytes(key, 6, keys + (n * 6));
+        n++;
+    } else if (uidlen == 7) {
+        mfc_algo_di_all(uid, keys + (n * 6));
+        n += 5 * 2;
+    }
+    return n;
+}
+
 // LF T55x7 White gun cloner algo
 uint32_t lf_t55xx_white_pwdgen(uint32_t id) {
     uint32_t r1 = rotl(id & 0x000000ec, 8);
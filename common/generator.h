@@ -64,6 +64,11 @@ int mfc_algo_touch_one(uint8_t *uid, uint8_t sector, uint8_t keytype, uint64_t *
 
 int mfc_algo_bambu_one(uint8_t *uid, uint8_t sector, uint8_t keytype, uint64_t *key);
 int mfc_algo_bambu_all(uint8_t *uid, uint8_t *keys);
+
+// mizip + saflok + sky + bambu + touch
+#define MFC_ALGO_UID_KEYS_MAX   ((5 * 2) + (16 * 2) + (16 * 2) + (16 * 2) + 1)
+int mfc_algo_uid_keys(uint8_t *uid, uint8_t uidlen, uint8_t *keys);
+
 uint32_t lf_t55xx_white_pwdgen(uint32_t id);
 
 int mfdes_kdf_input_gallagher(uint8_t *uid, uint8_t uidLen, uint8_t keyNo, uint32_t aid, uint8_t *kdfInputOut, uint8_t *kdfInputLen);
@@ -93,11 +93,24 @@ static void printSignal(void) {
 }
 
 #ifndef ON_DEVICE
-static int cmp_uint8(const void *a, const void *b) {
-    if (*(const uint8_t *)a < * (const uint8_t *)b)
-        return -1;
-    else
-        return *(const uint8_t *)a > *(const uint8_t *)b;
+// sample value histogram, percentiles without sorting a copy of the samples
+static void sample_histogram(const uint8_t *samples, uint32_t size, uint32_t hist[256]) {
+    memset(hist, 0, 256 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < size; i++) {
+        hist[samples[i]]++;
+    }
+}
+
+// value at index idx of the samples once sorted
+static uint8_t histogram_at(const uint32_t hist[256], uint32_t idx) {
+    uint32_t cnt = 0;
+    for (uint32_t v = 0; v < 256; v++) {
+        cnt += hist[v];
+        if (cnt > idx) {
+            return v;
+        }
+    }
+    return 255;
 }
 #endif
 
@@ -110,23 +123,25 @@ void computeSignalProperties(const uint8_t *samples, uint32_t size) {
     uint32_t offset_size = size - SIGNAL_IGNORE_FIRST_SAMPLES;
 
 #ifndef ON_DEVICE
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
+    uint32_t hist[256];
+    sample_histogram(samples + SIGNAL_IGNORE_FIRST_SAMPLES, offset_size, hist);
 
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.1)] + tmp[(int)((offset_size - 1) * 0.1)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.9)] + tmp[(int)((offset_size - 1) * 0.9)]);
+    uint8_t low10 = 0.5 * (histogram_at(hist, (int)(offset_size * 0.1)) + histogram_at(hist, (int)((offset_size - 1) * 0.1)));
+    uint8_t hi90 =  0.5 * (histogram_at(hist, (int)(offset_size * 0.9)) + histogram_at(hist, (int)((offset_size - 1) * 0.9)));
     uint32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
+    for (uint32_t v = 0; v < 256; v++) {
+        if (hist[v] == 0) {
+            continue;
+        }
 
-        if (samples[i] < signalprop.low) signalprop.low = samples[i];
-        if (samples[i] > signalprop.high) signalprop.high = samples[i];
+        if ((int)v < signalprop.low) signalprop.low = v;
+        if ((int)v > signalprop.high) signalprop.high = v;
 
-        if (samples[i] < low10 || samples[i] > hi90)
+        if (v < low10 || v > hi90)
             continue;
 
-        sum += samples[i];
-        cnt++;
+        sum += v * hist[v];
+        cnt += hist[v];
     }
     if (cnt > 0)
         signalprop.mean = sum / cnt;
@@ -161,20 +176,15 @@ void removeSignalOffset(uint8_t *samples, uint32_t size) {
 
 #ifndef ON_DEVICE
 
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
+    uint32_t hist[256];
+    sample_histogram(samples + SIGNAL_IGNORE_FIRST_SAMPLES, offset_size, hist);
 
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.05)] + tmp[(int)((offset_size - 1) * 0.05)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.95)] + tmp[(int)((offset_size - 1) * 0.95)]);
+    uint8_t low10 = 0.5 * (histogram_at(hist, (int)(offset_size * 0.05)) + histogram_at(hist, (int)((offset_size - 1) * 0.05)));
+    uint8_t hi90 =  0.5 * (histogram_at(hist, (int)(offset_size * 0.95)) + histogram_at(hist, (int)((offset_size - 1) * 0.95)));
     int32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
-
-        if (samples[i] < low10 || samples[i] > hi90)
-            continue;
-
-        acc_off += samples[i] - 128;
-        cnt++;
+    for (int32_t v = low10; v <= hi90; v++) {
+        acc_off += (v - 128) * (int32_t)hist[v];
+        cnt += hist[v];
     }
     if (cnt > 0)
         acc_off /= cnt;
@@ -188,11 +198,12 @@ void removeSignalOffset(uint8_t *samples, uint32_t size) {
 #endif
 
     // shift and saturate samples to center the mean
-    for (uint32_t i = 0; i < size; i++) {
-        if (acc_off > 0) {
+    if (acc_off > 0) {
+        for (uint32_t i = 0; i < size; i++) {
             samples[i] = (samples[i] >= acc_off) ? samples[i] - acc_off : 0;
         }
-        if (acc_off < 0) {
+    } else if (acc_off < 0) {
+        for (uint32_t i = 0; i < size; i++) {
             samples[i] = (255 - samples[i] >=  -acc_off) ? samples[i] - acc_off : 255;
         }
     }
@@ -226,6 +237,54 @@ bool parityTest(uint32_t bits, uint8_t bitLen, uint8_t pType) {
     return oddparity32(bits) ^ pType;
 }
 
+// Packed bits hold 64 bits per word, MSB first: bit i is bit (63 - i % 64) of word i / 64.
+// Converts numbits bytebits, any non zero byte is a 1. Returns the number of words written
+size_t bytebits_to_packed(const uint8_t *src, size_t numbits, uint64_t *dest) {
+    size_t words = PACKED_BITS_WORDS(numbits);
+    for (size_t w = 0; w < words; w++) {
+        uint64_t word = 0;
+        size_t n = MIN(numbits - (w * 64), 64);
+        for (size_t i = 0; i < n; i++) {
+            word = (word << 1) | (src[i] != 0);
+        }
+        dest[w] = word << (64 - n);
+        src += n;
+    }
+    return words;
+}
+
+void packed_to_bytebits(const uint64_t *src, size_t numbits, uint8_t *dest) {
+    for (size_t i = 0; i < numbits; i++) {
+        dest[i] = (src[i >> 6] >> (63 - (i & 63))) & 1;
+    }
+}
+
+// numbits (max 64) starting at bit idx, first bit in the most significant position like bytebits_to_byte
+uint64_t packedbits_get(const uint64_t *bits, size_t idx, uint8_t numbits) {
+    if (numbits == 0) {
+        return 0;
+    }
+    size_t w = idx >> 6;
+    uint8_t off = idx & 63;
+    uint64_t v = bits[w] << off;
+    if (off + numbits > 64) {
+        v |= bits[w + 1] >> (64 - off);
+    }
+    return v >> (64 - numbits);
+}
+
+static void packedbits_set(uint64_t *bits, size_t idx, uint64_t value, uint8_t numbits) {
+    for (uint8_t i = 0; i < numbits; i++) {
+        size_t pos = idx + i;
+        uint64_t mask = 1ULL << (63 - (pos & 63));
+        if ((value >> (numbits - 1 - i)) & 1) {
+            bits[pos >> 6] |= mask;
+        } else {
+            bits[pos >> 6] &= ~mask;
+        }
+    }
+}
+
 // takes a array of binary values, start position, length of bits per parity (includes parity bit - MAX 32),
 //   Parity Type (1 for odd; 0 for even; 2 for Always 1's; 3 for Always 0's), and binary Length (length to run)
 size_t removeParity(uint8_t *bits, size_t startIdx, uint8_t pLen, uint8_t pType, size_t bLen) {
@@ -263,6 +322,40 @@ size_t removeParity(uint8_t *bits, size_t startIdx, uint8_t pLen, uint8_t pType,
     return bitCnt;
 }
 
+// same as removeParity on packed bits, in place. pLen max 32
+size_t removeParityPacked(uint64_t *bits, size_t startIdx, uint8_t pLen, uint8_t pType, size_t bLen) {
+    size_t bitCnt = 0;
+    for (size_t word = 0; word < bLen; word += pLen) {
+        // a short last word is copied without a parity check
+        if (word + pLen > bLen) {
+            uint8_t n = bLen - word;
+            packedbits_set(bits, bitCnt, packedbits_get(bits, startIdx + word, n), n);
+            bitCnt += n;
+            break;
+        }
+
+        uint32_t parityWd = packedbits_get(bits, startIdx + word, pLen);
+        switch (pType) {
+            case 3:
+                if (parityWd & 1) {
+                    return 0;
+                }
+                break; // should be 0 spacer bit
+            case 2:
+                if ((parityWd & 1) == 0) {
+                    return 0;
+                }
+                break; // should be 1 spacer bit
+            default:
+                if (parityTest(parityWd, pLen, pType) == 0) { return 0; }
+                break; // test parity
+        }
+        packedbits_set(bits, bitCnt, parityWd >> 1, pLen - 1);
+        bitCnt += pLen - 1;
+    }
+    return bitCnt;
+}
+
 static size_t removeEm410xParity(uint8_t *bits, size_t startIdx, size_t *size, bool *validShort, bool *validShortExtended, bool *validLong) {
     uint32_t parityWd = 0;
     size_t bitCnt = 0;
@@ -397,6 +490,84 @@ uint32_t bytebits_to_byteLSBF(uint8_t *src, size_t numbits) {
     return num;
 }
 
+// 64 bytebits to a packed word, bytes other than 0 / 1 (error marks) are flagged in *bad.
+// Past avail the bits are 0
+static uint64_t bytebits_word(const uint8_t *src, size_t avail, uint64_t *bad) {
+    uint64_t w = 0, e = 0;
+    if (avail < 64) {
+        for (size_t i = 0; i < 64; i++) {
+            uint8_t b = (i < avail) ? src[i] : 0;
+            w = (w << 1) | (b & 1);
+            e = (e << 1) | (b > 1);
+        }
+        *bad = e;
+        return w;
+    }
+
+    for (uint8_t i = 0; i < 64; i += 8) {
+        // eight bytes, first one in the low byte
+        const uint8_t *p = src + i;
+        uint64_t x = (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+                     ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+        uint64_t t = x & 0xFEFEFEFEFEFEFEFEULL;
+        t |= t >> 4;
+        t |= t >> 2;
+        t |= t >> 1;
+        // gathers bit 0 of every byte, first byte to the top
+        w = (w << 8) | (((x & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56);
+        e = (e << 8) | (((t & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56);
+    }
+    *bad = e;
+    return w;
+}
+
+// Word parallel preamble match, all 64 start positions of a block at once.
+// w0 / w1 hold the bits of the block and the next one, bit 63 of the result is
+// a match at the first position of the block. pLen max 64
+static uint64_t preamble_match_block(uint64_t w0, uint64_t w1, uint64_t preamble, uint8_t pLen) {
+    uint64_t match = ~0ULL;
+    for (uint8_t j = 0; j < pLen && match; j++) {
+        uint64_t window = (j) ? (w0 << j) | (w1 >> (64 - j)) : w0;
+        match &= ((preamble >> (pLen - 1 - j)) & 1) ? window : ~window;
+    }
+    return match;
+}
+
+// start positions [idx, end) as a mask of a block, bit 63 = idx
+static uint64_t preamble_block_limit(size_t idx, size_t end) {
+    return (end - idx >= 64) ? ~0ULL : ~(~0ULL >> (end - idx));
+}
+
+// same as preambleSearchEx on packed bits, size in bits. pLen max 64
+bool preambleSearchPacked(const uint64_t *bits, uint64_t preamble, uint8_t pLen, size_t *size, size_t *startIdx, bool findone) {
+    if (*size <= pLen || pLen == 0 || pLen > 64)
+        return false;
+
+    size_t end = *size - pLen;
+    size_t words = PACKED_BITS_WORDS(*size);
+    uint8_t foundCnt = 0;
+    for (size_t idx = 0; idx < end; idx += 64) {
+        size_t w = idx >> 6;
+        uint64_t w1 = (w + 1 < words) ? bits[w + 1] : 0;
+        uint64_t match = preamble_match_block(bits[w], w1, preamble, pLen) & preamble_block_limit(idx, end);
+        while (match) {
+            size_t pos = idx + __builtin_clzll(match);
+            match &= ~(1ULL << (63 - (pos - idx)));
+            foundCnt++;
+            if (foundCnt == 1) {
+                *startIdx = pos;
+                if (findone)
+                    return true;
+            }
+            if (foundCnt == 2) {
+                *size = pos - *startIdx;
+                return true;
+            }
+        }
+    }
+    return (foundCnt > 0);
+}
+
 // search for given preamble in given BitStream and return success = TRUE or fail = FALSE and startIndex and length
 bool preambleSearch(uint8_t *bits, uint8_t *preamble, size_t pLen, size_t *size, size_t *startIdx) {
     return preambleSearchEx(bits, preamble, pLen, size, startIdx, false);
@@ -404,25 +575,71 @@ bool preambleSearch(uint8_t *bits, uint8_t *preamble, size_t pLen, size_t *size,
 // search for given preamble in given BitStream and return success=1 or fail=0 and startIndex (where it was found) and length if not fineone
 // fineone does not look for a repeating preamble for em4x05/4x69 sends preamble once, so look for it once in the first pLen bits
 // (iceman) FINDONE,  only finds start index. NOT SIZE!.  I see Em410xDecode (lfdemod.c) uses SIZE to determine success
+//
+// The bytebits are packed 64 at a time on the fly and the first 64 preamble bits are
+// matched for a whole block of start positions at once, longer preambles are
+// confirmed with memcmp. Bytes other than 0 / 1 (error marks) never match.
 bool preambleSearchEx(uint8_t *bits, uint8_t *preamble, size_t pLen, size_t *size, size_t *startIdx, bool findone) {
     // Sanity check.  If preamble length is bigger than bits length.
     if (*size <= pLen)
         return false;
 
+    uint8_t head = MIN(pLen, 64);
+    uint64_t pre = 0;
+    for (uint8_t j = 0; j < head; j++) {
+        // a preamble bit other than 0 / 1 can only match the same byte, leave it to memcmp
+        if (preamble[j] > 1) {
+            head = j;
+            break;
+        }
+        pre = (pre << 1) | preamble[j];
+    }
+
+    size_t end = *size - pLen;
     uint8_t foundCnt = 0;
-    for (size_t idx = 0; idx < *size - pLen; idx++) {
-        if (memcmp(bits + idx, preamble, pLen) == 0) {
+    uint64_t w0 = 0, bad0 = 0, w1 = 0, bad1 = 0;
+    for (size_t idx = 0; idx < end; idx += 64) {
+        // the block and the next one, as bits and as error mark flags
+        if (idx == 0) {
+            w0 = bytebits_word(bits, *size, &bad0);
+        } else {
+            w0 = w1;
+            bad0 = bad1;
+        }
+        w1 = (idx + 64 < *size) ? bytebits_word(bits + idx + 64, *size - idx - 64, &bad1) : 0;
+        if (idx + 64 >= *size) {
+            bad1 = 0;
+        }
+
+        uint64_t match = preamble_block_limit(idx, end);
+        if (head) {
+            match &= preamble_match_block(w0, w1, pre, head);
+            if (bad0 | bad1) {
+                // no error mark anywhere under the preamble head
+                for (uint8_t j = 0; j < head; j++) {
+                    match &= ~((j) ? (bad0 << j) | (bad1 >> (64 - j)) : bad0);
+                }
+            }
+        }
+
+        while (match) {
+            size_t pos = idx + __builtin_clzll(match);
+            match &= ~(1ULL << (63 - (pos - idx)));
+            if (head < pLen && memcmp(bits + pos + head, preamble + head, pLen - head) != 0) {
+                continue;
+            }
+
             //first index found
             foundCnt++;
             if (foundCnt == 1) {
-                if (g_debugMode >= 1) prnt("DEBUG: (preambleSearchEx) preamble found at %zu", idx);
-                *startIdx = idx;
+                if (g_debugMode >= 1) prnt("DEBUG: (preambleSearchEx) preamble found at %zu", pos);
+                *startIdx = pos;
                 if (findone)
                     return true;
             }
             if (foundCnt == 2) {
-                if (g_debugMode >= 1) prnt("DEBUG: (preambleSearchEx) preamble 2 found at %zu", idx);
-                *size = idx - *startIdx;
+                if (g_debugMode >= 1) prnt("DEBUG: (preambleSearchEx) preamble 2 found at %zu", pos);
+                *size = pos - *startIdx;
                 return true;
             }
         }
@@ -33,6 +33,9 @@
 // Max number of bits when demodulating a signal
 #define MAX_DEMODULATION_BITS   4096
 
+// words needed for n packed bits, see bytebits_to_packed
+#define PACKED_BITS_WORDS(n)    (((n) + 63) / 64)
+
 // generic
 typedef struct {
     int low;
@@ -58,6 +61,9 @@ int BiphaseRawDecode(uint8_t *bits, size_t *size, int *offset, int invert);
 int bits_to_array(const uint8_t *bits, size_t size, uint8_t *dest);
 uint32_t bytebits_to_byte(uint8_t *src, size_t numbits);
 uint32_t bytebits_to_byteLSBF(uint8_t *src, size_t numbits);
+size_t bytebits_to_packed(const uint8_t *src, size_t numbits, uint64_t *dest);
+void packed_to_bytebits(const uint64_t *src, size_t numbits, uint8_t *dest);
+uint64_t packedbits_get(const uint64_t *bits, size_t idx, uint8_t numbits);
 uint16_t countFC(const uint8_t *bits, size_t size, bool fskAdj);
 int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr);
 bool DetectCleanAskWave(const uint8_t *dest, size_t size, uint8_t high, uint8_t low);
@@ -78,11 +84,13 @@ int nrzRawDemod(uint8_t *dest, size_t *size, int *clk, const int *invert, int *s
 bool parityTest(uint32_t bits, uint8_t bitLen, uint8_t pType);
 bool preambleSearch(uint8_t *bits, uint8_t *preamble, size_t pLen, size_t *size, size_t *startIdx);
 bool preambleSearchEx(uint8_t *bits, uint8_t *preamble, size_t pLen, size_t *size, size_t *startIdx, bool findone);
+bool preambleSearchPacked(const uint64_t *bits, uint64_t preamble, uint8_t pLen, size_t *size, size_t *startIdx, bool findone);
 int pskRawDemod(uint8_t *dest, size_t *size, int *clock, int *invert);
 int pskRawDemod_ext(uint8_t *dest, size_t *size, int *clock, const int *invert, int *startIdx);
 void psk2TOpsk1(uint8_t *bits, size_t size);
 void psk1TOpsk2(uint8_t *bits, size_t size);
 size_t removeParity(uint8_t *bits, size_t startIdx, uint8_t pLen, uint8_t pType, size_t bLen);
+size_t removeParityPacked(uint64_t *bits, size_t startIdx, uint8_t pLen, uint8_t pType, size_t bLen);
 
 // tag specific
 int detectAWID(uint8_t *dest, size_t *size, int *waveStartIdx);
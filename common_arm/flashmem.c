@@ -79,27 +79,71 @@ bool Flash_ReadID(flash_device_type_t *result, bool read_jedec) {
     return true;
 }
 
-uint16_t Flash_ReadData(uint32_t address, uint8_t *out, uint16_t len) {
-
-    if (!FlashInit()) return 0;
+// Bulk data phases go through the SPI PDC (DMA) instead of the byte loop. The last byte is
+// still sent by FlashSendLastByte() so the chip select is released the same way as before.
+// Below FLASH_PDC_MIN_LEN bytes setting up the PDC costs more than it saves.
+#define FLASH_PDC_MIN_LEN   16
 
-    // length should never be zero
-    if (!len || Flash_CheckBusy(BUSY_TIMEOUT)) return 0;
+static uint8_t *flash_pdc_out = NULL;
+static uint16_t flash_pdc_len = 0;
 
-    uint8_t cmd = (FASTFLASH) ? FASTREAD : READDATA;
+static void Flash_PDCStart(uint8_t *rx, const uint8_t *tx, uint16_t len) {
+    AT91C_BASE_SPI->SPI_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
 
-    FlashSendByte(cmd);
-    Flash_TransferAdresse(address);
+    // drop whatever is left in the receive register
+    if (AT91C_BASE_SPI->SPI_RDR == 0) {};
+    if (AT91C_BASE_SPI->SPI_SR == 0) {};
 
-    if (FASTFLASH) {
-        FlashSendByte(DUMMYBYTE);
+    AT91C_BASE_SPI->SPI_RNCR = 0;
+    AT91C_BASE_SPI->SPI_TNCR = 0;
+    if (rx) {
+        AT91C_BASE_SPI->SPI_RPR = (uint32_t)rx;
+        AT91C_BASE_SPI->SPI_RCR = len;
     }
+    AT91C_BASE_SPI->SPI_TPR = (uint32_t)tx;
+    AT91C_BASE_SPI->SPI_TCR = len;
+
+    AT91C_BASE_SPI->SPI_PTCR = ((rx) ? AT91C_PDC_RXTEN : 0) | AT91C_PDC_TXTEN;
+}
+
+static void Flash_PDCWaitRx(void) {
+    while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_ENDRX) == 0) {};
+    AT91C_BASE_SPI->SPI_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+}
 
+static void Flash_PDCWaitTx(void) {
+    while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_ENDTX) == 0) {};
+    while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_TXEMPTY) == 0) {};
+    AT91C_BASE_SPI->SPI_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+
+    // nothing read the incoming bytes, clear RDRF and the overrun flag
+    if (AT91C_BASE_SPI->SPI_RDR == 0) {};
+    if (AT91C_BASE_SPI->SPI_SR == 0) {};
+}
+
+// send a data phase, releases the chip select after the last byte
+static void Flash_SendData(const uint8_t *in, uint16_t len) {
     uint16_t i = 0;
+    if (len > FLASH_PDC_MIN_LEN) {
+        Flash_PDCStart(NULL, in, len - 1);
+        Flash_PDCWaitTx();
+        i = len - 1;
+    }
+
     for (; i < (len - 1); i++) {
-        out[i] = (FlashSendByte(0xFF) & 0xFF);
+        FlashSendByte(in[i]);
     }
-    out[i] = (FlashSendLastByte(0xFF) & 0xFF);
+    FlashSendLastByte(in[i]);
+}
+
+uint16_t Flash_ReadData(uint32_t address, uint8_t *out, uint16_t len) {
+
+    if (!FlashInit()) return 0;
+
+    // length should never be zero
+    if (!len || Flash_CheckBusy(BUSY_TIMEOUT)) return 0;
+
+    Flash_ReadDataCont(address, out, len);
     FlashStop();
     return len;
 }
@@ -110,11 +154,12 @@ void Flash_TransferAdresse(uint32_t address) {
     FlashSendByte((address >> 0) & 0xFF);
 }
 
-/* This ensures we can ReadData without having to cycle through initialization every time */
-uint16_t Flash_ReadDataCont(uint32_t address, uint8_t *out, uint16_t len) {
+// Start a read in the background, the PDC fills out while the CPU does other work.
+// Nothing else may use the SPI until Flash_ReadDataWait() returns.
+bool Flash_ReadDataStart(uint32_t address, uint8_t *out, uint16_t len) {
 
     // length should never be zero
-    if (!len) return 0;
+    if (!len) return false;
 
     uint8_t cmd = (FASTFLASH) ? FASTREAD : READDATA;
 
@@ -125,14 +170,45 @@ uint16_t Flash_ReadDataCont(uint32_t address, uint8_t *out, uint16_t len) {
         FlashSendByte(DUMMYBYTE);
     }
 
+    flash_pdc_out = out;
+    flash_pdc_len = len;
+
+    // the flash ignores its data input while reading, so out doubles as the transmit buffer.
+    // The PDC always reads a byte to send before the byte received at that position is written.
+    if (len > FLASH_PDC_MIN_LEN) {
+        Flash_PDCStart(out, out, len - 1);
+    }
+    return true;
+}
+
+uint16_t Flash_ReadDataWait(void) {
+
+    if (flash_pdc_len == 0) return 0;
+
     uint16_t i = 0;
-    for (; i < (len - 1); i++) {
-        out[i] = (FlashSendByte(0xFF) & 0xFF);
+    if (flash_pdc_len > FLASH_PDC_MIN_LEN) {
+        Flash_PDCWaitRx();
+        i = flash_pdc_len - 1;
     }
-    out[i] = (FlashSendLastByte(0xFF) & 0xFF);
+
+    for (; i < (flash_pdc_len - 1); i++) {
+        flash_pdc_out[i] = (FlashSendByte(0xFF) & 0xFF);
+    }
+    flash_pdc_out[i] = (FlashSendLastByte(0xFF) & 0xFF);
+
+    uint16_t len = flash_pdc_len;
+    flash_pdc_len = 0;
     return len;
 }
 
+/* This ensures we can ReadData without having to cycle through initialization every time */
+uint16_t Flash_ReadDataCont(uint32_t address, uint8_t *out, uint16_t len) {
+
+    if (Flash_ReadDataStart(address, out, len) == false) return 0;
+
+    return Flash_ReadDataWait();
+}
+
 ////////////////////////////////////////
 // Write data can only program one page. A page has 256 bytes.
 // if len > 256, it might wrap around and overwrite pos 0.
@@ -169,11 +245,7 @@ uint16_t Flash_WriteData(uint32_t address, uint8_t *in, uint16_t len) {
     FlashSendByte((address >> 8) & 0xFF);
     FlashSendByte((address >> 0) & 0xFF);
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        FlashSendByte(in[i]);
-
-    FlashSendLastByte(in[i]);
+    Flash_SendData(in, len);
 
     FlashStop();
     return len;
@@ -202,11 +274,7 @@ uint16_t Flash_WriteDataCont(uint32_t address, uint8_t *in, uint16_t len) {
     FlashSendByte((address >> 8) & 0xFF);
     FlashSendByte((address >> 0) & 0xFF);
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        FlashSendByte(in[i]);
-
-    FlashSendLastByte(in[i]);
+    Flash_SendData(in, len);
     return len;
 }
 
@@ -130,6 +130,8 @@ bool Flash_ReadID(flash_device_type_t *result, bool read_jedec);
 
 uint16_t Flash_ReadData(uint32_t address, uint8_t *out, uint16_t len);
 uint16_t Flash_ReadDataCont(uint32_t address, uint8_t *out, uint16_t len);
+bool Flash_ReadDataStart(uint32_t address, uint8_t *out, uint16_t len);
+uint16_t Flash_ReadDataWait(void);
 uint16_t Flash_Write(uint32_t address, uint8_t *in, uint16_t len);
 uint16_t Flash_WriteData(uint32_t address, uint8_t *in, uint16_t len);
 uint16_t Flash_WriteDataCont(uint32_t address, uint8_t *in, uint16_t len);
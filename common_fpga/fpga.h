@@ -50,6 +50,9 @@ typedef enum {
 typedef struct {
     const char *const versionString;
     const FPGA_config target_config;
+    // position and length of the 'e' section body in the .bit file, found by fpga_compress at build time
+    const uint32_t bitstream_offset;
+    const uint32_t bitstream_length;
 } FPGA_VERSION_INFORMATION;
 
 static const uint8_t bitparse_fixed_header[] = {0x00, 0x09, 0x0f, 0xf0, 0x0f, 0xf0, 0x0f, 0xf0, 0x0f, 0xf0, 0x00, 0x00, 0x01};
@@ -30,4 +30,22 @@ typedef enum {
     T_AES = 0x03
 } DesfireCryptoAlgorithm;
 
+// For CMD_HF_DESFIRE_CHK
+// EV1 authentication of every key number in 'keynos' of the application with
+// each of the 'count' keys of 'algo', packed back to back.
+#define DESFIRE_CHK_KEYS_SIZE 480
+typedef struct {
+    uint8_t aid[3];         // card byte order, LSB first
+    uint8_t algo;           // DesfireCryptoAlgorithm
+    uint16_t keynos;        // bit n for key number n
+    uint8_t count;
+    uint8_t keys[DESFIRE_CHK_KEYS_SIZE];
+} PACKED desfire_chk_t;
+
+// Reply of CMD_HF_DESFIRE_CHK, only the hits
+typedef struct {
+    uint16_t found;         // bit n when a key was found for key number n
+    uint8_t keyidx[14];     // its index in desfire_chk_t.keys
+} PACKED desfire_chk_reply_t;
+
 #endif
@@ -73,6 +73,22 @@ typedef struct {
 } em4x70_data_t;
 //_Static_assert(sizeof(em4x70_data_t) == 36);
 
+// How often `lf em 4x70 brute` reports its position, in keys tried.
+// About 0.7 seconds, at ~11 seconds per 0x100 authentications.
+#define EM4X70_BRUTE_PROGRESS_INTERVAL 0x10
+
+/// @brief Progress of `lf em 4x70 brute`, sent as CMD_LF_EM4X70_BRUTE_PROGRESS
+///        while the search runs and as the data of an aborted CMD_LF_EM4X70_BRUTE.
+/// @details
+///     All keys below next_key have been tried, so a search that was
+///     interrupted (tag moved, USB dropped) can be resumed from next_key
+///     by passing it as em4x70_data_t.start_key.
+typedef struct {
+    uint8_t block;
+    // big endian, same as the partial key in the CMD_LF_EM4X70_BRUTE reply
+    uint8_t next_key[2];
+} em4x70_brute_progress_t;
+
 // ISSUE: `bool` type does not have a standard-defined size.
 //        therefore, compatibility between architectures /
 //        compilers is not guaranteed.
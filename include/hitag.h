@@ -257,6 +257,14 @@ typedef struct {
     uint8_t data[256];
 } PACKED lf_hitag_crack_response_t;
 
+// sent by crack2 each time its keystream grows, ahead of the final lf_hitag_crack_response_t.
+// The keystream follows aR and the tag's encrypted page 3 of the nR aR it was given.
+typedef struct {
+    uint8_t uid[4];
+    uint16_t bits;          // recovered so far
+    uint8_t data[256];      // keystream, msb first, only (bits + 7) / 8 bytes are sent
+} PACKED lf_hitag_crack_keystream_t;
+
 typedef union {
     uint8_t asBytes[HITAGS_PAGE_SIZE];
     hitags_config_t s;
@@ -75,6 +75,13 @@ typedef struct {
     uint8_t data[8];
 } PACKED iclass_readblock_resp_t;
 
+// CMD_HF_ICLASS_SIMULATE reader attack (sim type 2), sent for every MAC as it is
+// collected, ahead of the CMD_ACK with all of them
+typedef struct {
+    uint8_t csn_index;
+    uint8_t epurse_nr_mac[16];  // 8b e-purse, 4b NR, 4b MAC
+} PACKED iclass_sim_mac_t;
+
 // iCLASS dump data structure
 typedef struct {
     iclass_auth_req_t req;
@@ -82,6 +89,20 @@ typedef struct {
     uint8_t end_block;
 } PACKED iclass_dump_req_t;
 
+// CMD_HF_ICLASS_DUMP streams the blocks as they are read, one reply per
+// ICLASS_DUMP_CHUNK_BLOCKS blocks, then a last one with done set and no block data.
+// Bit n of readmask is set when block start_block + n was read. The status of the
+// last reply is PM3_EPARTIAL when blocks are missing (card lost, read errors)
+#define ICLASS_DUMP_CHUNK_BLOCKS 16
+typedef struct {
+    bool done;
+    uint8_t start_block;
+    uint8_t count;
+    uint16_t readmask;
+    uint8_t div_key[8];     // last reply, the diversified key used to authenticate
+    uint8_t data[ICLASS_DUMP_CHUNK_BLOCKS * 8];
+} PACKED iclass_dump_chunk_t;
+
 // iCLASS write block request data structure
 typedef struct {
     iclass_auth_req_t req;
@@ -137,6 +158,8 @@ typedef struct iclass_premac {
 typedef struct {
     bool use_credit_key;
     bool shallow_mod;
+    bool resume;        // card is still selected from the previous chunk
+    bool keep_field;    // more chunks follow, leave the card selected
     uint8_t count;
     iclass_premac_t items[];
 } PACKED iclass_chk_t;
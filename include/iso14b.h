@@ -71,6 +71,27 @@ typedef struct {
     uint8_t data[];
 } PACKED iso14b_raw_apdu_response_t;
 
+// bulk read of a SRx / ST25TB or ASK CTS tag
+#define ISO14B_DUMP_MAX_BLOCKS   128
+#define ISO14B_DUMP_SYSBLOCK     0x01    // SRx: also read the system block 0xFF, stored after the last block
+
+typedef struct {
+    uint8_t type;                                 // ISO14B_SR or ISO14B_CT
+    uint8_t flags;                                // ISO14B_DUMP_*
+    uint8_t count;                                // blocks 0 .. count - 1
+    uint8_t bitmap[ISO14B_DUMP_MAX_BLOCKS / 8];   // blocks to read, block n is bit (n & 7) of byte n / 8. All zero reads every block
+} PACKED iso14b_dump_t;
+
+typedef struct {
+    iso14b_card_select_t card;                    // ISO14B_SR
+    iso14b_cts_card_select_t cts;                 // ISO14B_CT
+    uint8_t block_size;
+    uint8_t flags;                                // ISO14B_DUMP_SYSBLOCK when the system block was read
+    uint8_t bitmap[ISO14B_DUMP_MAX_BLOCKS / 8];   // blocks read
+    uint32_t offset;                              // dump location in BigBuf, block n at n * block_size
+    uint16_t len;
+} PACKED iso14b_dump_resp_t;
+
 #define US_TO_SSP(x)   ( (int32_t) ((x) * 3.39) )
 #define SSP_TO_US(x)   ( (int32_t)((x) / 3.39) )
 
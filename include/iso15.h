@@ -48,6 +48,72 @@ typedef struct {
     uint8_t raw[];      // First byte in raw,  raw[0] is ISO15693 protocol flag byte
 } PACKED iso15_raw_cmd_t;
 
+// hf 15 inventory
+#define ISO15_INVENTORY_AFI     0x01    // only tags with the given AFI answer
+#define ISO15_INVENTORY_READ    0x02    // read the memory of every tag found
+#define ISO15_INVENTORY_SLOW    0x04    // use '1 out of 256' coding
+
+typedef struct {
+    uint8_t flags;              // see ISO15_INVENTORY_*
+    uint8_t afi;
+    uint8_t blocks_per_read;    // blocks per READ MULTIPLE BLOCKS, 1 = single block reads only
+} PACKED iso15_inventory_t;
+
+// One reply per tag and then one per chunk of its memory, all carrying the UID.
+// The final reply has no data.
+typedef struct {
+    uint8_t uid[ISO15693_UID_LENGTH];   // MSB first
+    uint8_t dsfid;
+    uint8_t afi;
+    uint8_t ic;
+    uint8_t block_size;         // 0 when unknown
+    uint16_t block_count;       // 0 when unknown
+    uint16_t first_block;       // block number of data[0]
+    uint16_t len;
+    uint8_t data[];
+} PACKED iso15_inventory_tag_t;
+
+// hf 15 dump / restore, the block loop runs on the device
+typedef struct {
+    uint8_t flags;              // PM3 Flags - ISO15_CONNECT, ISO15_HIGH_SPEED
+    uint8_t req_flags;          // ISO15693 request flags, uid is used with ISO15_REQ_ADDRESS
+    uint8_t uid[ISO15693_UID_LENGTH];   // LSB first, as sent on air
+    uint8_t first_block;
+    uint16_t count;
+    uint8_t block_size;
+    uint8_t blocks_per_cmd;     // READ / WRITE MULTIPLE BLOCKS size, 0 = probe, 1 = single block commands
+    uint8_t retries;
+    uint8_t data[];             // write only, count * block_size
+} PACKED iso15_blocks_t;
+
+// Read streams chunks with count > 0, data is lock status + block for each block.
+// The final reply of a read and the only reply of a write have no data, count is the number of blocks written.
+typedef struct {
+    uint16_t first_block;
+    uint16_t count;
+    uint8_t block_size;
+    uint8_t blocks_per_cmd;     // what the tag accepted
+    uint8_t error;              // last ISO15693 error code of the tag, 0 = none
+    uint8_t data[];
+} PACKED iso15_blocks_resp_t;
+
+// hf 15 slixbrute
+typedef struct {
+    uint8_t pass_id;            // 0x01 read, 0x02 write, 0x04 privacy, 0x08 destroy, 0x10 EAS/AFI
+    uint8_t reset_ms;           // field off time after a wrong password, 0 = keep the field up
+    uint32_t start;             // range mode when count is 0, start to end inclusive
+    uint32_t end;
+    uint16_t count;             // dictionary mode, passwords in data
+    uint8_t data[];             // count * 4 bytes
+} PACKED iso15_slix_brute_t;
+
+// progress replies have done = 0, the final one done = 1 and status PM3_SUCCESS when found
+typedef struct {
+    uint8_t done;
+    uint32_t tried;
+    uint8_t current[4];         // last password tried, or the one found
+} PACKED iso15_slix_brute_resp_t;
+
 #define ISO15693_TAG_MAX_PAGES 160 // in pages  (0xA0)
 #define ISO15693_TAG_MAX_SIZE 2048 // in byte (64 pages of 256 bits)
 
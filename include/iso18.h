@@ -60,6 +60,37 @@ typedef struct {
     uint8_t servicecode[2];
 } PACKED felica_card_select_t;
 
+// Read Without Encryption over several services, batched on the device
+#define FELICA_BLOCK_SIZE               16
+#define FELICA_RDBLK_MAX_SERVICES       16      // services per frame
+#define FELICA_RDBLK_MAX_BLOCKS         15      // block list elements per frame, the reply length byte limits it
+#define FELICA_READ_MAX_SERVICES        32      // services per device call
+#define FELICA_READ_UNKNOWN_BLOCKS      256     // a service of unknown size is read until the card refuses a block
+
+typedef struct {
+    uint16_t code;          // service code
+    uint16_t count;         // blocks to read, 0 = unknown, read until the card refuses a block
+} PACKED felica_service_read_t;
+
+typedef struct {
+    uint8_t max_blocks;     // block list elements per frame, halved when the card refuses a frame
+    uint8_t count;
+    felica_service_read_t services[];
+} PACKED felica_read_services_t;
+
+typedef struct {
+    uint16_t code;
+    uint16_t block;
+    uint8_t data[FELICA_BLOCK_SIZE];
+} PACKED felica_block_t;
+
+// final reply. The block counts found, and the number of blocks per frame the card accepted
+typedef struct {
+    uint8_t max_blocks;
+    uint8_t count;
+    uint16_t blocks[FELICA_READ_MAX_SERVICES];
+} PACKED felica_read_services_resp_t;
+
 typedef struct {
     uint8_t sync[2];
     uint8_t length[1];
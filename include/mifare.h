@@ -46,6 +46,65 @@ typedef struct {
     uint8_t data[1024];
 } PACKED mfu_dump_t;
 
+// Ultralight/NTAG device side bulk operations
+#define MFU_READCARD_FASTREAD   0x10    // ORed into the key type of CMD_HF_MIFAREU_READCARD when the card takes FAST_READ
+#define MFU_FASTREAD_MAX_PAGES  60      // pages per FAST_READ, the answer has to fit a frame
+
+#define MFU_WRITE_VERIFY        0x01    // read the pages back after writing
+#define MFU_WRITE_COMPARE       0x02    // skip pages already holding the data
+#define MFU_WRITE_FASTREAD      0x04    // the card takes FAST_READ for compare / verify
+
+typedef struct {
+    uint8_t flags;                  // MFU_WRITE_*
+    uint8_t keytype;                // 0 = none, 1 = UL-C key, 2 = EV1/NTAG pwd
+    uint8_t key[16];
+    uint8_t start;                  // first page
+    uint8_t count;                  // pages
+    uint8_t data[];                 // count * 4 bytes
+} PACKED mfu_write_pages_t;
+
+typedef struct {
+    uint8_t written;
+    uint8_t skipped;
+    uint8_t page;                   // page that failed to write or verify
+} PACKED mfu_write_pages_resp_t;
+
+#define MFU_CHK_ULC             1       // 16 byte 3DES keys
+#define MFU_CHK_PWD             2       // 4 byte EV1/NTAG passwords
+#define MFU_CHK_ULAES           3       // 16 byte AES keys, against keyno
+
+typedef struct {
+    uint8_t keytype;                // MFU_CHK_*
+    uint8_t keyno;                  // UL-AES key slot
+    uint8_t count;
+    uint8_t keys[];                 // count * 4 or 16 bytes
+} PACKED mfu_chk_keys_t;
+
+typedef struct {
+    uint8_t found;
+    uint8_t index;                  // of the matching key in the batch
+    uint8_t tested;
+    uint8_t pack[2];                // EV1/NTAG only
+} PACKED mfu_chk_keys_resp_t;
+
+// Gen4 GTU device side bulk write
+#define MFG4_WRITE_VERIFY       0x01    // read the blocks back after writing
+#define MFG4_WRITE_MAX_BLOCKS   30      // blocks per command, the data has to fit a frame
+
+typedef struct {
+    uint8_t pwd[4];
+    uint8_t workFlags;              // MAGIC_INIT on the first command of the session, MAGIC_OFF on the last
+    uint8_t flags;                  // MFG4_WRITE_*
+    uint8_t start;                  // first block
+    uint8_t count;                  // blocks
+    uint8_t data[];                 // count * 16 bytes
+} PACKED mfg4_write_blocks_t;
+
+typedef struct {
+    uint8_t written;
+    uint8_t block;                  // block that failed to write or verify
+} PACKED mfg4_write_blocks_resp_t;
+
 //-----------------------------------------------------------------------------
 // ISO 14443A
 //-----------------------------------------------------------------------------
@@ -74,6 +133,18 @@ typedef struct {
     uint8_t *dump;
 } iso14a_mf_extdump_t;
 
+// Thinfilm / Topaz continuous reader
+typedef struct {
+    uint16_t holdoff;               // ms out of the field before a tag is reported again
+    uint32_t duration;              // ms, 0 = until button or client abort
+} PACKED hf_tagstream_t;
+
+typedef struct {
+    uint32_t ms;                    // since the reader started
+    uint8_t len;
+    uint8_t data[32];               // Thinfilm: barcode with crc, Topaz: HR0 HR1 UID
+} PACKED hf_tagstream_entry_t;
+
 typedef struct {
     union {
         iso14a_card_select_t mfc;
@@ -28,6 +28,10 @@
 #define PM3_CMD_DATA_SIZE 512
 #define PM3_CMD_DATA_SIZE_MIX ( PM3_CMD_DATA_SIZE - 3 * sizeof(uint64_t) )
 
+// Jumbo NG command frames, only over USB-CDC and only for bulk upload commands.
+// Advertised in capabilities_t.jumbo_size, the bootloader and FPC USART stay at PM3_CMD_DATA_SIZE
+#define PM3_CMD_DATA_SIZE_JUMBO 2048
+
 typedef struct {
     uint64_t cmd;
     uint64_t arg[3];
@@ -63,6 +67,7 @@ typedef struct {
         uint32_t asDwords[PM3_CMD_DATA_SIZE / 4];
     } data;
     bool ng;             // does it store NG data or OLD data?
+    uint8_t *jumbo;      // points to the full payload when length > PM3_CMD_DATA_SIZE, otherwise NULL
 } PacketCommandNG;
 
 // For reception and CRC check
@@ -129,6 +134,10 @@ typedef struct {
     int16_t trigger_threshold;
     int32_t samples_to_skip;
     bool verbose;
+    // ring mode, sample continuously and keep post_trigger samples after the trigger. 0 = off
+    int32_t post_trigger;
+    // ring mode trigger on a field-off gap of this many samples below -trigger_threshold. 0 = on the threshold edge
+    int16_t trigger_gap;
 } PACKED sample_config;
 
 
@@ -160,6 +169,7 @@ typedef struct {
     int8_t forcecl3;     // 0:auto 1:force executing CL3 2:force skipping CL3
     int8_t forcerats;    // 0:auto 1:force executing RATS 2:force skipping RATS
     int8_t magsafe;      // 0:disabled 1:enabled
+    int8_t adaptive;     // 0:disabled 1:learn tag answer times, shorten chk timeouts
     iso14a_polling_frame_t polling_loop_annotation; // Polling loop annotation
 } PACKED hf14a_config_t;
 
@@ -177,6 +187,60 @@ typedef struct {
 #define TRACELOG_HDR_LEN        sizeof(tracelog_hdr_t)
 #define TRACELOG_PARITY_LEN(x)  (((x)->data_len - 1) / 8 + 1)
 
+// A streamed trace (sniff --stream) starts with a header with data_len 0 and this timestamp,
+// the records follow. It ends with a header with data_len 0, its timestamp is the number of
+// records dropped while the host was behind.
+#define TRACELOG_STREAM_MAGIC   0x4D525453  // "STRM"
+
+// A trace log in flash (standalone sniffers) is a sequence of LZ4 compressed chunks, each a
+// tracelog_lz4_chunk_t and clen bytes of an LZ4 block that decompresses to rawlen bytes of
+// standard records. Sessions just append more chunks, a record never straddles two chunks.
+#define TRACELOG_LZ4_MAGIC      0x345A4C54  // "TLZ4"
+typedef struct {
+    uint32_t magic;
+    uint16_t clen;
+    uint16_t rawlen;
+} PACKED tracelog_lz4_chunk_t;
+
+// hf sniff --stream sends the samples in packets of HF_STREAM_PACKET_LEN bytes, one USB packet each
+//   byte 0     HF_STREAM_MAGIC_DATA
+//   bytes 1-3  samples dropped right before this packet while the USB was busy, saturating
+//   then       HF_STREAM_PACKET_LEN - HF_STREAM_HDR_LEN samples, the last packet is padded with zeros
+// The stream ends with HF_STREAM_MAGIC_END, 3 zero bytes, the number of samples sent and the
+// number of samples dropped, both uint32.
+#define HF_STREAM_PACKET_LEN    64
+#define HF_STREAM_HDR_LEN       4
+#define HF_STREAM_END_LEN       12
+#define HF_STREAM_MAGIC_DATA    0xA5
+#define HF_STREAM_MAGIC_END     0x5A
+
+// A compact trace (set_tracing_compact) starts with a header with data_len 0 and this timestamp,
+// every record after it is
+//   varint  (data_len << 3) | (parity << 1) | isResponse
+//   varint  timestamp minus the timestamp of the record before, 0 before the first one
+//   varint  duration
+//   data_len bytes of data, the parity bytes only with TRACELOG_COMPACT_PAR_KEEP
+// Varints hold 7 bits per byte, least significant first, bit 7 set when more bytes follow.
+// Markers may repeat, e.g. in appended sessions, a record never starts with a 0x00 byte.
+#define TRACELOG_COMPACT_MAGIC      0x544D4300  // "\0CMT"
+#define TRACELOG_COMPACT_PAR_ZERO   0           // all parity bytes zero
+#define TRACELOG_COMPACT_PAR_ODD    1           // odd parity of every byte, as in ISO14443A
+#define TRACELOG_COMPACT_PAR_KEEP   2           // parity bytes stored after the data
+
+// A ring trace (FLAG_TRACE_RING) keeps the newest records and overwrites the oldest ones. It
+// starts with this header, the records run from first to wrap and then on from the end of the
+// header to end. wrap is 0 until the buffer wrapped around the first time, the records then
+// simply run from the end of the header to end.
+#define TRACELOG_RING_MAGIC         0x474E4952  // "RING"
+typedef struct {
+    uint32_t magic;         // TRACELOG_RING_MAGIC, where a record has its timestamp
+    uint32_t zero;          // duration and data_len of an empty record
+    uint32_t first;         // offset of the oldest record
+    uint32_t wrap;          // end of the records from first, 0 if not wrapped
+    uint32_t end;           // end of the newest record
+    uint32_t overwritten;   // records lost to newer ones
+} PACKED tracelog_ring_hdr_t;
+
 // T55XX - Extended to support 1 of 4 timing
 typedef struct  {
     uint16_t start_gap;
@@ -200,6 +264,7 @@ typedef struct {
     uint8_t version;
     uint32_t baudrate;
     uint32_t bigbuf_size;
+    uint16_t jumbo_size;               // max payload of jumbo USB frames, 0 if not supported
     bool via_fpc                       : 1;
     bool via_usb                       : 1;
     // rdv4
@@ -232,7 +297,7 @@ typedef struct {
     bool hw_available_smartcard        : 1;
     bool is_rdv4                       : 1;
 } PACKED capabilities_t;
-#define CAPABILITIES_VERSION 6
+#define CAPABILITIES_VERSION 7
 extern capabilities_t g_pm3_capabilities;
 
 // For CMD_LF_T55XX_WRITEBL
@@ -249,6 +314,127 @@ typedef struct {
     uint32_t time;
 } PACKED t55xx_test_block_t;
 
+// For CMD_LF_T55XX_BRUTE
+// Zero read_gap / samples make the device tune them, and the baseline and
+// threshold of the signal check, before the search.  A resumed search passes
+// back the values from the previous reply and starts right away.
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint8_t flags;          // downlink mode << 3, like CMD_LF_T55XX_CHK_PWDS
+    uint16_t read_gap;      // us between the downlink and sampling the response
+    uint16_t samples;
+    uint64_t baseline;      // response energy of a wrong password
+    uint64_t threshold;     // distance from the baseline that makes a candidate
+} PACKED t55xx_brute_t;
+
+// For CMD_LF_T55XX_CLONE
+// Writes page 0 blocks 0..numblocks-1 and verifies them on the device.
+// With 'loop' every tag placed on the antenna afterwards is cloned too, until
+// the button or the client stops it.
+typedef struct {
+    uint32_t blocks[8];
+    uint8_t numblocks;
+    uint32_t pwd;           // current password of the tags
+    uint8_t flags;          // pwd mode in bit 0, downlink mode << 3, like t55xx_write_block_t
+    bool loop;
+} PACKED t55xx_clone_t;
+
+// Reply of CMD_LF_T55XX_CLONE, and of every tag in its CMD_LF_T55XX_CLONE_PROGRESS packets
+typedef struct {
+    uint32_t cloned;        // tags written and verified
+    uint32_t failed;
+    uint8_t failed_blocks;  // bit n set when block n did not verify, of the last tag
+} PACKED t55xx_clone_reply_t;
+
+// For CMD_LF_T55XX_CLONE_QUEUE
+// Clones the next credential, 'numblocks' page 0 blocks each, to every tag placed on the antenna.
+// A tag that doesn't verify is reported with CMD_LF_T55XX_CLONE_PROGRESS and the next tag gets the same credential.
+#define T55XX_CLONE_QUEUE_WORDS  120
+typedef struct {
+    uint32_t pwd;           // current password of the tags
+    uint8_t flags;          // pwd mode in bit 0, downlink mode << 3, like t55xx_write_block_t
+    uint8_t numblocks;
+    uint8_t count;          // credentials in 'blocks'
+    uint32_t blocks[T55XX_CLONE_QUEUE_WORDS];
+} PACKED t55xx_clone_queue_t;
+
+// For CMD_LF_T55XX_PROBE
+// Reads block 0 in every downlink mode set in 'downlink_modes' (bit n for mode n)
+// and classifies the samples on the device.
+typedef struct {
+    uint32_t pwd;
+    uint8_t flags;          // pwd mode in bit 0
+    uint8_t downlink_modes;
+} PACKED t55xx_probe_t;
+
+// Per downlink mode result of CMD_LF_T55XX_PROBE, the clocks as the client detectors would find them
+typedef struct {
+    bool noise;             // nothing answered, there is no need to download the samples
+    uint8_t fc_high;        // FSK field clocks, zero when it isn't FSK
+    uint8_t fc_low;
+    uint8_t fsk_clock;
+    int16_t ask_clock;      // <= 0 when not found
+    int16_t nrz_clock;
+    int16_t psk_clock;
+} PACKED t55xx_probe_hint_t;
+
+typedef struct {
+    t55xx_probe_hint_t hints[4];
+} PACKED t55xx_probe_reply_t;
+
+// For CMD_LF_T55XX_DUMP
+// Reads the blocks set in 'blocks' (bit 0-7 page 0, bit 8-11 page 1 block 0-3) in one field session,
+// as many as BigBuf holds, each capture in its own slot of 'samples' bytes.
+typedef struct {
+    uint32_t pwd;
+    uint8_t flags;          // pwd mode in bit 0
+    uint8_t downlink_mode;
+    uint16_t samples;       // per block
+    uint16_t blocks;
+} PACKED t55xx_dump_t;
+
+typedef struct {
+    uint32_t offset;        // of the first slot in BigBuf
+    uint16_t samples;       // slot size
+    uint16_t blocks;        // the blocks captured, their slots follow in bit order
+} PACKED t55xx_dump_reply_t;
+
+// For CMD_LF_EM4X_BF
+// Range mode (BF_MODE_RANGE) tries start..end.  Dictionary mode (BF_MODE_MASK)
+// tries the words from index 'word' on, each one with every combination of the
+// 'mask' bits.  A zero guard_us makes the device tune the pause between logins.
+#define EM4X05_BRUTE_MAX_WORDS  100
+typedef struct {
+    uint8_t mode;
+    uint32_t start;
+    uint32_t end;
+    uint32_t mask;
+    uint32_t n;             // stop after n candidates, 0 for all of them
+    uint16_t guard_us;
+    uint8_t word;
+    uint8_t count;
+    uint32_t words[EM4X05_BRUTE_MAX_WORDS];
+} PACKED em4x05_brute_t;
+
+// Reply of CMD_LF_EM4X_BF and its CMD_LF_EM4X_BF_PROGRESS packets
+typedef struct {
+    bool found;             // 'password' is a candidate, else the next one to try
+    uint32_t password;
+    uint8_t word;           // dictionary word of 'password'
+    uint32_t tried;
+    uint32_t candidates;
+    uint16_t guard_us;      // as tuned, to resume with
+} PACKED em4x05_brute_reply_t;
+
+// Reply of CMD_LF_T55XX_BRUTE and its CMD_LF_T55XX_BRUTE_PROGRESS packets
+typedef struct {
+    bool found;             // 'password' is a candidate, else the next one to try
+    uint32_t password;
+    uint32_t tried;
+    t55xx_brute_t params;   // as tuned, to resume with
+} PACKED t55xx_brute_reply_t;
+
 // For CMD_LF_HID_SIMULATE (FSK)
 typedef struct {
     uint32_t hi2;
@@ -259,6 +445,90 @@ typedef struct {
     bool EM;
 } PACKED lf_hidsim_t;
 
+// Streamed by CMD_MEASURE_ANTENNA_TUNING_LF mode 4, until the button or the client stops it.
+// One measurement every LF_TUNE_STREAM_INTERVAL_US, 'count' of them per packet.
+#define LF_TUNE_STREAM_MAX          32
+#define LF_TUNE_STREAM_INTERVAL_US  2000
+typedef struct {
+    uint32_t seq;           // of the packet, a gap means packets were lost
+    uint8_t count;
+    uint32_t mv[LF_TUNE_STREAM_MAX];
+} PACKED lf_tune_stream_t;
+
+// For CMD_LF_INDALA_READ
+// Samples and PSK1 demodulates on the device, the reply only carries the bits
+typedef struct {
+    uint32_t samples;
+    int16_t clock;          // 0 to autodetect
+    uint8_t invert;
+    uint16_t max_err;
+} PACKED lf_indala_read_t;
+
+#define LF_INDALA_READ_MAX_BITS  2048
+typedef struct {
+    int16_t clock;
+    int16_t errors;
+    uint32_t start_idx;     // sample of the first bit
+    uint16_t bitlen;
+    uint8_t bits[LF_INDALA_READ_MAX_BITS / 8];  // msb first
+} PACKED lf_indala_read_reply_t;
+
+// For CMD_LF_HID_BRUTE
+// A Wiegand format packs as base ^ one column per set FC / CN bit. A column flips its data bit
+// (0xFF for none) and the parity bits in its mask. Bit positions are raw, 0 = lsb of lo, 95 = msb of hi2.
+#define LF_HID_BRUTE_MAX_PAR    8
+#define LF_HID_BRUTE_MAX_COLS   64
+
+typedef struct {
+    uint8_t pos;
+    uint8_t par;
+} PACKED lf_hid_brute_col_t;
+
+typedef struct {
+    uint32_t base[3];               // hi2, hi, lo with FC = CN = 0, issue level / OEM included
+    uint8_t longFMT;
+    uint8_t npar;
+    uint8_t par[LF_HID_BRUTE_MAX_PAR];
+    uint8_t fc_bits;
+    uint8_t cn_bits;
+    lf_hid_brute_col_t cols[LF_HID_BRUTE_MAX_COLS]; // FC bits lsb first, then CN bits
+    uint8_t field;                  // 0 = FC, 1 = CN
+    uint8_t direction;              // 0 = both, 1 = up, 2 = down
+    uint32_t fixed;                 // value of the other field
+    uint32_t start;
+    uint32_t min;
+    uint32_t max;
+    uint16_t dwell;                 // ms each candidate is simulated
+} PACKED lf_hid_brute_t;
+
+typedef struct {
+    uint32_t up;                    // last value tried going up
+    uint32_t down;                  // last value tried going down
+    uint32_t tried;
+} PACKED lf_hid_brute_resp_t;
+
+// For CMD_LF_WATCH
+#define LF_WATCH_HID                    0x01
+#define LF_WATCH_AWID                   0x02
+#define LF_WATCH_EM410X                 0x04
+#define LF_WATCH_IO                     0x08
+#define LF_WATCH_ALL                    0x0F
+
+typedef struct {
+    uint8_t protocols;              // LF_WATCH_* mask
+    uint16_t holdoff;               // ms before the same ID is reported again
+} PACKED lf_watch_t;
+
+typedef struct {
+    uint32_t ms;                    // since the watch started
+    uint8_t protocol;               // LF_WATCH_*
+    uint8_t type;                   // HID / AWID format length, EM410x decode type, IO version
+    uint32_t fc;
+    uint32_t cn;
+    uint32_t raw[3];                // most significant word first
+    uint32_t wiegand[2];            // AWID only
+} PACKED lf_watch_entry_t;
+
 // For CMD_LF_FSK_SIMULATE (FSK)
 typedef struct {
     uint8_t fchigh;
@@ -349,6 +619,26 @@ typedef struct {
     uint8_t key[6];
 } PACKED mfc_eload_t;
 
+// CMD_HF_MIFARE_DUMP, whole card in one field session.
+// Bit (2 * sector + keytype) of keymask is set when that key is known
+#define MF_DUMP_MAX_SECTORS 40
+typedef struct {
+    uint8_t sectorcnt;
+    uint8_t keymask[(2 * MF_DUMP_MAX_SECTORS) / 8];
+    uint8_t keys[MF_DUMP_MAX_SECTORS][2][6];
+} PACKED mf_dump_req_t;
+
+// one reply per sector, in order, then a last one with sector MF_DUMP_DONE and no data.
+// Bit b of readmask is set when block b of the sector was read, the trailer keys are
+// sent as read from the card (zeros / unreadable)
+#define MF_DUMP_DONE 0xFF
+typedef struct {
+    uint8_t sector;
+    uint8_t blocks;
+    uint16_t readmask;
+    uint8_t data[16 * 16];
+} PACKED mf_dump_sector_t;
+
 typedef struct {
     bool use_flashmem;
     uint16_t keycount;
@@ -375,6 +665,85 @@ typedef struct {
     bool off;
 } PACKED tearoff_params_t;
 
+// Runtime profiler, see armsrc/profiler.h
+#define PROF_MAX_SLOTS          12
+#define PROF_NAME_LEN           12
+
+typedef struct {
+    char name[PROF_NAME_LEN];
+    uint32_t count;         // prof_count() events
+    uint32_t calls;         // finished prof_start() / prof_stop() pairs
+    uint64_t total_us;      // time spent between start and stop
+    uint32_t min_us;
+    uint32_t max_us;
+} PACKED prof_slot_t;
+
+typedef struct {
+    uint32_t uptime_ms;     // since the last reset of the counters
+    uint8_t slots;
+    prof_slot_t slot[PROF_MAX_SLOTS];
+} PACKED prof_stats_t;
+
+// RF exchange timing as reader, see armsrc/rftiming.h
+#define RFT_14A                 0
+#define RFT_15                  1       // ISO15693 and iCLASS
+#define RFT_PROTOCOLS           2
+
+// Histogram buckets are half octaves of microseconds. Bucket 0 is below 24 us,
+// bucket i > 0 starts at 16 us * 2^(i/2), times 1.5 for odd i. The last one is open ended
+#define RFT_BUCKETS             32
+
+typedef struct {
+    uint32_t frames;                    // reader frames sent
+    uint32_t answers;
+    uint32_t timeouts;                  // frames we waited on in vain
+    // tag answer latency, end of our frame to start of the answer
+    uint32_t latency_min_us;
+    uint32_t latency_max_us;
+    uint64_t latency_total_us;
+    uint32_t latency[RFT_BUCKETS];
+    // turnaround, end of a tag answer to start of our next frame
+    uint32_t turnarounds;
+    uint64_t turnaround_total_us;
+    uint32_t turnaround[RFT_BUCKETS];
+} PACKED rft_stats_t;
+
+typedef struct {
+    uint8_t protocol;
+    uint8_t reset;                      // reset the counters of all protocols after sending
+} PACKED rft_request_t;
+
+typedef struct {
+    uint32_t uptime_ms;                 // since the last reset of the counters
+    uint8_t protocol;
+    rft_stats_t stats;
+} PACKED rft_reply_t;
+
+// Presence polling, see armsrc/presence.h
+#define POLL_14A                0x01
+#define POLL_14B                0x02
+#define POLL_15                 0x04
+#define POLL_ICLASS             0x08
+#define POLL_EM410X             0x10
+#define POLL_HID                0x20
+#define POLL_ALL                0x3F
+
+#define POLL_EVENT_NEW          1   // a tag showed up, or another one replaced it
+#define POLL_EVENT_GONE         2   // the tag was not seen for gone_ms
+
+typedef struct {
+    uint8_t protocols;      // POLL_* flags
+    uint16_t gone_ms;
+} PACKED poll_params_t;
+
+typedef struct {
+    uint8_t event;          // POLL_EVENT_*
+    uint8_t protocol;       // one POLL_* flag
+    uint8_t idlen;
+    uint8_t id[12];         // UID, CSN or LF ID, MSB first
+    uint32_t time_ms;       // since the start of the poll
+} PACKED poll_event_t;
+
 // when writing to SPIFFS
 typedef struct {
     bool append : 1;
@@ -427,6 +796,7 @@ typedef struct {
 #define CMD_START_FLASH                                                   0x0005
 #define CMD_CHIP_INFO                                                     0x0006
 #define CMD_BL_VERSION                                                    0x0007
+#define CMD_FLASH_CRC                                                     0x0008
 #define CMD_NACK                                                          0x00fe
 #define CMD_ACK                                                           0x00ff
 
@@ -440,6 +810,8 @@ typedef struct {
 #define CMD_READ_MEM                                                      0x0106 // legacy
 #define CMD_READ_MEM_DOWNLOAD                                             0x010A
 #define CMD_READ_MEM_DOWNLOADED                                           0x010B
+#define CMD_DOWNLOADED_LZ4                                                0x010C
+#define CMD_BATCH                                                         0x010D
 #define CMD_VERSION                                                       0x0107
 #define CMD_STATUS                                                        0x0108
 #define CMD_PING                                                          0x0109
@@ -453,6 +825,9 @@ typedef struct {
 #define CMD_TIA                                                           0x0117
 #define CMD_BREAK_LOOP                                                    0x0118
 #define CMD_SET_TEAROFF                                                   0x0119
+#define CMD_PROFILE                                                       0x011A
+#define CMD_POLL                                                          0x011B
+#define CMD_RF_TIMING                                                     0x011C
 #define CMD_GET_DBGMODE                                                   0x0120
 
 // RDV40, Flash memory operations
@@ -533,6 +908,8 @@ typedef struct {
 #define CMD_LF_SIMULATE_BIDIR                                             0x020E
 #define CMD_SET_ADC_MUX                                                   0x020F
 #define CMD_LF_HID_CLONE                                                  0x0210
+#define CMD_LF_HID_BRUTE                                                  0x0212
+#define CMD_LF_HID_BRUTE_PROGRESS                                         0x0213
 #define CMD_LF_EM410X_CLONE                                               0x0211
 #define CMD_LF_T55XX_READBL                                               0x0214
 #define CMD_LF_T55XX_WRITEBL                                              0x0215
@@ -544,6 +921,7 @@ typedef struct {
 #define CMD_LF_EM4X_WRITEWORD                                             0x0219
 #define CMD_LF_EM4X_PROTECTWORD                                           0x021B
 #define CMD_LF_EM4X_BF                                                    0x022A
+#define CMD_LF_EM4X_BF_PROGRESS                                           0x022B
 #define CMD_LF_IO_WATCH                                                   0x021A
 #define CMD_LF_EM410X_WATCH                                               0x021C
 #define CMD_LF_EM4X50_INFO                                                0x0240
@@ -563,6 +941,7 @@ typedef struct {
 #define CMD_LF_EM4X70_SETPIN                                              0x0264
 #define CMD_LF_EM4X70_SETKEY                                              0x0265
 #define CMD_LF_EM4X70_BRUTE                                               0x0266
+#define CMD_LF_EM4X70_BRUTE_PROGRESS                                      0x0267
 // Sampling configuration for LF reader/sniffer
 #define CMD_LF_SAMPLING_SET_CONFIG                                        0x021D
 #define CMD_LF_FSK_SIMULATE                                               0x021E
@@ -570,15 +949,24 @@ typedef struct {
 #define CMD_LF_PSK_SIMULATE                                               0x0220
 #define CMD_LF_NRZ_SIMULATE                                               0x0232
 #define CMD_LF_AWID_WATCH                                                 0x0221
+#define CMD_LF_WATCH                                                      0x022C
 #define CMD_LF_VIKING_CLONE                                               0x0222
 #define CMD_LF_T55XX_WAKEUP                                               0x0224
 #define CMD_LF_COTAG_READ                                                 0x0225
+#define CMD_LF_INDALA_READ                                                0x022D
 #define CMD_LF_T55XX_SET_CONFIG                                           0x0226
 #define CMD_LF_SAMPLING_PRINT_CONFIG                                      0x0227
 #define CMD_LF_SAMPLING_GET_CONFIG                                        0x0228
 
 #define CMD_LF_T55XX_CHK_PWDS                                             0x0230
 #define CMD_LF_T55XX_DANGERRAW                                            0x0231
+#define CMD_LF_T55XX_BRUTE                                                0x0233
+#define CMD_LF_T55XX_BRUTE_PROGRESS                                       0x0234
+#define CMD_LF_T55XX_CLONE                                                0x0235
+#define CMD_LF_T55XX_CLONE_PROGRESS                                       0x0236
+#define CMD_LF_T55XX_PROBE                                                0x0237
+#define CMD_LF_T55XX_DUMP                                                 0x0238
+#define CMD_LF_T55XX_CLONE_QUEUE                                          0x0239
 
 
 // ZX8211
@@ -592,11 +980,16 @@ typedef struct {
 #define CMD_HF_ACQ_RAW_ADC                                                0x0301
 #define CMD_HF_SRI_READ                                                   0x0303
 #define CMD_HF_ISO14443B_COMMAND                                          0x0305
+#define CMD_HF_ISO14443B_DUMP                                             0x0306
 #define CMD_HF_ISO15693_READER                                            0x0310
 #define CMD_HF_ISO15693_SIMULATE                                          0x0311
 #define CMD_HF_ISO15693_SNIFF                                             0x0312
 #define CMD_HF_ISO15693_COMMAND                                           0x0313
 #define CMD_HF_ISO15693_FINDAFI                                           0x0315
+#define CMD_HF_ISO15693_INVENTORY                                         0x0319
+#define CMD_HF_ISO15693_READ_BLOCKS                                       0x031A
+#define CMD_HF_ISO15693_WRITE_BLOCKS                                      0x031B
+#define CMD_HF_ISO15693_SLIX_BRUTE                                        0x031C
 #define CMD_HF_ISO15693_SLIX_ENABLE_PRIVACY                               0x0867
 #define CMD_HF_ISO15693_SLIX_DISABLE_PRIVACY                              0x0317
 #define CMD_HF_ISO15693_SLIX_DISABLE_EAS                                  0x0318
@@ -623,6 +1016,8 @@ typedef struct {
 #define CMD_LF_HITAG2_WRITE                                               0x0377
 #define CMD_LF_HITAG2_CRACK                                               0x0378
 #define CMD_LF_HITAG2_CRACK_2                                             0x0379
+// device -> client, keystream recovered so far by crack2
+#define CMD_LF_HITAG2_CRACK_KEYSTREAM                                     0x0374
 
 // For Hitag S
 #define CMD_LF_HITAGS_TEST_TRACES                                         0x0367
@@ -649,6 +1044,9 @@ typedef struct {
 
 #define CMD_HF_ISO14443A_READER                                           0x0385
 #define CMD_HF_ISO14443A_EMV_SIMULATE                                     0x0386
+#define CMD_HF_ISO14443A_APDU_BATCH                                       0x038D
+#define CMD_HF_ISO14443A_CUIDS                                            0x038E
+#define CMD_HF_ISO14443A_RAW_FRAMES                                       0x0390
 
 #define CMD_HF_LEGIC_SIMULATE                                             0x0387
 #define CMD_HF_LEGIC_READER                                               0x0388
@@ -660,6 +1058,7 @@ typedef struct {
 
 #define CMD_HF_LEGIC_INFO                                                 0x03BC
 #define CMD_HF_LEGIC_ESET                                                 0x03BD
+#define CMD_HF_LEGIC_WRITER_EML                                           0x03BE
 
 // iCLASS / Picopass
 #define CMD_HF_ICLASS_READCHECK                                           0x038F
@@ -670,6 +1069,7 @@ typedef struct {
 #define CMD_HF_ICLASS_READBL                                              0x0396
 #define CMD_HF_ICLASS_WRITEBL                                             0x0397
 #define CMD_HF_ICLASS_EML_MEMSET                                          0x0398
+#define CMD_HF_ICLASS_EML_CRC                                             0x0399
 #define CMD_HF_ICLASS_CHKKEYS                                             0x039A
 #define CMD_HF_ICLASS_RESTORE                                             0x039B
 #define CMD_HF_ICLASS_CREDIT_EPURSE                                       0x039C
@@ -681,6 +1081,7 @@ typedef struct {
 #define CMD_HF_FELICA_SIMULATE                                            0x03A0
 #define CMD_HF_FELICA_SNIFF                                               0x03A1
 #define CMD_HF_FELICA_COMMAND                                             0x03A2
+#define CMD_HF_FELICA_READ_SERVICES                                       0x03A3
 //temp
 #define CMD_HF_FELICALITE_DUMP                                            0x03AA
 #define CMD_HF_FELICALITE_SIMULATE                                        0x03AB
@@ -707,6 +1108,7 @@ typedef struct {
 #define CMD_HF_MIFARE_EML_MEMSET                                          0x0602
 #define CMD_HF_MIFARE_EML_MEMGET                                          0x0603
 #define CMD_HF_MIFARE_EML_LOAD                                            0x0604
+#define CMD_HF_MIFARE_EML_CRC                                             0x0608
 
 // magic chinese card commands
 #define CMD_HF_MIFARE_CSETBL                                              0x0605
@@ -733,6 +1135,8 @@ typedef struct {
 #define CMD_HF_MIFARE_VALUE                                               0x0627
 #define CMD_HF_MIFAREU_WRITEBL                                            0x0722
 #define CMD_HF_MIFAREU_WRITEBL_COMPAT                                     0x0723
+#define CMD_HF_MIFAREU_WRITE_PAGES                                        0x0742
+#define CMD_HF_MIFAREU_CHKKEYS                                            0x0743
 
 #define CMD_HF_MIFARE_CHKKEYS                                             0x0623
 #define CMD_HF_MIFARE_SETMOD                                              0x0624
@@ -742,6 +1146,7 @@ typedef struct {
 #define CMD_HF_MIFARE_SNIFF                                               0x0630
 #define CMD_HF_MIFARE_MFKEY                                               0x0631
 #define CMD_HF_MIFARE_PERSONALIZE_UID                                     0x0632
+#define CMD_HF_MIFARE_DUMP                                                0x0633
 
 // ultralight-C
 #define CMD_HF_MIFAREUC_AUTH                                              0x0724
@@ -758,6 +1163,7 @@ typedef struct {
 #define CMD_HF_DESFIRE_READER                                             0x072c
 #define CMD_HF_DESFIRE_INFO                                               0x072d
 #define CMD_HF_DESFIRE_COMMAND                                            0x072e
+#define CMD_HF_DESFIRE_CHK                                                0x072f
 
 #define CMD_HF_MIFARE_NACK_DETECT                                         0x0730
 #define CMD_HF_MIFARE_STATIC_NONCE                                        0x0731
@@ -780,6 +1186,10 @@ typedef struct {
 // For ThinFilm Kovio
 #define CMD_HF_THINFILM_READ                                              0x0810
 #define CMD_HF_THINFILM_SIMULATE                                          0x0811
+#define CMD_HF_THINFILM_READER                                            0x0812
+
+// For Topaz / Jewel
+#define CMD_HF_TOPAZ_READER                                               0x0818
 
 //For Atmel CryptoRF
 #define CMD_HF_CRYPTORF_SIM                                               0x0820
@@ -792,6 +1202,7 @@ typedef struct {
 // Gen 4 GTU magic cards
 #define CMD_HF_MIFARE_G4_RDBL                                             0x0860
 #define CMD_HF_MIFARE_G4_WRBL                                             0x0861
+#define CMD_HF_MIFARE_G4_WRITE_BLOCKS                                     0x0862
 
 // Gen 4 GDM magic cards
 #define CMD_HF_MIFARE_G4_GDM_RDBL                                         0x0870
@@ -873,6 +1284,8 @@ typedef struct {
 // support nested authentication attack
 #define FLAG_NESTED_AUTH_ATTACK 0x0800
 #define FLAG_MF_ALLOW_OOB_AUTH  0x1000
+// hf 14a sim / hf mf sim, keep the newest frames in a ring trace
+#define FLAG_TRACE_RING         0x2000
 
 #define MODE_SIM_CSN        0
 #define MODE_EXIT_AFTER_MAC 1
@@ -1027,6 +1440,12 @@ typedef struct {
 /* Set if this device understands the read memory command */
 #define DEVICE_INFO_FLAG_UNDERSTANDS_READ_MEM        (1<<7)
 
+/* Set if this device understands the flash crc command and takes pipelined block writes */
+#define DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC       (1<<8)
+
+/* Set if this device understands FLASH_CRC_FLAG_REGION */
+#define DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC_REGION (1<<9)
+
 #define BL_VERSION_MAJOR(version) ((uint32_t)(version) >> 22)
 #define BL_VERSION_MINOR(version) (((uint32_t)(version) >> 12) & 0x3ff)
 #define BL_VERSION_PATCH(version) ((uint32_t)(version) & 0xfff)
@@ -1041,6 +1460,115 @@ typedef struct {
 /* CMD_READ_MEM_DOWNLOAD flags */
 #define READ_MEM_DOWNLOAD_FLAG_RAW                   (1<<0)
 
+/* CMD_FLASH_CRC
+   arg0 = flash address, arg1 = number of FLASH_CRC_BLOCK_SIZE blocks
+   device answers with CMD_FLASH_CRC frames, arg0 = first block, arg1 = count, data = CRC32 (crc32_ex) per block
+   followed by CMD_ACK, or CMD_NACK if the range is outside the flash
+   with FLASH_CRC_FLAG_REGION in arg2, arg1 is a length in bytes and a single CRC32 over the whole range is returned */
+#define FLASH_CRC_BLOCK_SIZE                         0x200
+#define FLASH_CRC_FLAG_REGION                        (1<<0)
+
+/* CMD_DOWNLOAD_BIGBUF / CMD_DOWNLOAD_EML_BIGBUF flags (arg2)
+   LZ4: device may answer with CMD_DOWNLOADED_LZ4 frames,
+        arg0 = offset, arg1 = compressed len, arg2 = uncompressed len */
+#define DOWNLOAD_FLAG_LZ4                            (1<<0)
+
+/* CMD_BATCH
+   payload: batch_hdr_t, then for each NG sub-command a batch_cmd_t followed by its data.
+   The device answers at once with an empty CMD_BATCH frame, runs them back to back and then sends
+   one or more CMD_BATCH frames, each a batch_reply_hdr_t followed by batch_reply_t entries and their data.
+   Only NG replies are collected, sub-commands with replies above BATCH_REPLY_DATA_MAX get PM3_EOVFLOW */
+#define BATCH_FLAG_STOP_ON_ERROR                     (1<<0)
+
+typedef struct {
+    uint8_t flags;
+} PACKED batch_hdr_t;
+
+typedef struct {
+    uint16_t cmd;
+    uint16_t len;
+} PACKED batch_cmd_t;
+
+typedef struct {
+    uint8_t final;       // last CMD_BATCH frame of this batch
+    uint8_t executed;    // number of sub-commands run, only valid in the final frame
+} PACKED batch_reply_hdr_t;
+
+typedef struct {
+    uint8_t index;       // sub-command which produced this reply
+    uint16_t cmd;
+    int8_t status;
+    uint8_t ng;
+    uint16_t len;
+} PACKED batch_reply_t;
+
+#define BATCH_REPLY_DATA_MAX (PM3_CMD_DATA_SIZE - sizeof(batch_reply_hdr_t) - sizeof(batch_reply_t))
+
+/* CMD_HF_ISO14443A_APDU_BATCH
+   payload: apdu_batch_hdr_t, then for each APDU an apdu_batch_cmd_t followed by the APDU.
+   The card must be selected and the field left on. The device sends the APDUs back to back, in chained
+   I-blocks when they don't fit frame_len, answers WTX and acknowledges chained response blocks itself.
+   Results come in one or more CMD_HF_ISO14443A_APDU_BATCH frames, each a batch_reply_hdr_t followed by
+   apdu_batch_reply_t entries and their responses, status word included. The batch stops at the first
+   failed exchange. */
+#define APDU_BATCH_FLAG_STOP_ON_SW                   (1<<0)  // also stop at the first status word not as expected
+
+typedef struct {
+    uint8_t flags;
+    uint16_t frame_len;  // card frame size (FSC) from the ATS, 0 = no I-block chaining
+} PACKED apdu_batch_hdr_t;
+
+typedef struct {
+    uint16_t len;
+    uint16_t sw;         // expected status word
+    uint16_t sw_mask;    // bits of sw to check, 0 = any
+} PACKED apdu_batch_cmd_t;
+
+typedef struct {
+    uint8_t index;       // APDU of the batch
+    int8_t status;
+    uint16_t len;
+} PACKED apdu_batch_reply_t;
+
+#define APDU_BATCH_REPLY_DATA_MAX (PM3_CMD_DATA_SIZE - sizeof(batch_reply_hdr_t) - sizeof(apdu_batch_reply_t))
+#define APDU_BATCH_APDU_MAX       (PM3_CMD_DATA_SIZE - sizeof(apdu_batch_hdr_t) - sizeof(apdu_batch_cmd_t))
+
+/* CMD_HF_ISO14443A_CUIDS
+   payload: iso14a_cuids_t. The device cycles the field and selects the card back to back, without RATS.
+   UIDs come in CMD_HF_ISO14443A_CUIDS frames, each a iso14a_cuids_resp_t followed by records of
+   UID length (1 byte) and UID. */
+typedef struct {
+    uint32_t count;      // UIDs to collect, 0 = until aborted
+    uint8_t reset_ms;    // field off, then on, time between two selects
+} PACKED iso14a_cuids_t;
+
+typedef struct {
+    uint8_t final;       // last frame
+    uint32_t collected;  // UIDs collected so far
+    uint32_t failed;     // selects without a card
+} PACKED iso14a_cuids_resp_t;
+
+/* CMD_HF_ISO14443A_RAW_FRAMES
+   payload: iso14a_raw_frames_t, then the data. The card must be selected and the field left on.
+   The device cuts the data in chunks, sends each one after the prefix with CRC appended, and sends
+   the frame again until the answer starts with expect. Used by 'hf waveshare' to stream image planes.
+   The reply is iso14a_raw_frames_resp_t. */
+typedef struct {
+    uint8_t prefix_len;
+    uint8_t prefix[4];
+    uint8_t chunk;       // data bytes in one frame
+    uint8_t retries;     // frame sent again while the answer is not expect, 0 = answer not checked
+    uint8_t expect[2];
+    uint8_t delay_ms;    // pause after each frame
+} PACKED iso14a_raw_frames_t;
+
+typedef struct {
+    uint16_t sent;       // frames accepted by the card
+    uint16_t retried;    // frames sent again
+} PACKED iso14a_raw_frames_resp_t;
+
+#define ISO14A_RAW_FRAMES_DATA_MAX (PM3_CMD_DATA_SIZE - sizeof(iso14a_raw_frames_t))
+
 /* CMD_START_FLASH may have three arguments: start of area to flash,
    end of area to flash, optional magic.
    The bootrom will not allow to overwrite itself unless this magic
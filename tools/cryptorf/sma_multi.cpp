@@ -26,7 +26,7 @@
 #include <inttypes.h>
 #include <iostream>
 #include <vector>
-#include <map>
+#include <queue>      // priority_queue
 #include <algorithm>   // sort, max_element, random_shuffle, remove_if, lower_bound
 #include <functional>  // greater, bind2nd
 #include <thread>      // std::thread
@@ -357,21 +357,74 @@ static inline void sm_left_mask(const uint8_t *ks, uint8_t *mask, uint64_t rstat
 
 std::atomic<bool> key_found{0};
 std::atomic<uint64_t> key{0};
-std::atomic<size_t> g_topbits{0};
 std::mutex g_ice_mtx;
 static uint32_t g_num_cpus = std::thread::hardware_concurrency();
 
+// Every thread collects its own candidates, the bin (correct bits) is stored in the
+// top byte so sorting the keys orders them by bin. No locking while searching,
+// the lists are merged once all threads are done.
+#define ICE_BIN_KEY(bits, state)  ((((uint64_t)(bits)) << 56) | (state))
+#define ICE_BIN_STATE(key)        ((key) & 0x00ffffffffffffffull)
+
+typedef struct {
+    size_t bits;
+    uint64_t state;
+    uint8_t mask[16];
+} ice_topbin_t;
+
+typedef struct {
+    uint64_t key;
+    size_t list;
+    size_t pos;
+} ice_bin_head_t;
+
+struct ice_bin_head_cmp {
+    bool operator()(const ice_bin_head_t &a, const ice_bin_head_t &b) const {
+        return a.key < b.key;
+    }
+};
+
+// Merge the per-thread lists, each sorted highest bin first, into one list of keys
+static void ice_merge_bins(const vector<vector<uint64_t>> &lists, vector<uint64_t> *keys) {
+
+    size_t total = 0;
+    priority_queue<ice_bin_head_t, vector<ice_bin_head_t>, ice_bin_head_cmp> heads;
+
+    for (size_t i = 0; i < lists.size(); i++) {
+        total += lists[i].size();
+        if (lists[i].empty() == false) {
+            heads.push({lists[i][0], i, 0});
+        }
+    }
+
+    keys->clear();
+    keys->reserve(total);
+
+    while (heads.empty() == false) {
+        ice_bin_head_t h = heads.top();
+        heads.pop();
+        keys->push_back(h.key);
+        if (++h.pos < lists[h.list].size()) {
+            h.key = lists[h.list][h.pos];
+            heads.push(h);
+        }
+    }
+}
+
 static void ice_sm_right_thread(
     uint8_t offset,
     uint8_t skips,
     const uint8_t *ks,
-    map<uint64_t, uint64_t> *bincstates,
-    uint8_t *mask
+    vector<uint64_t> *bincstates,
+    ice_topbin_t *top
 ) {
 
     uint8_t tmp_mask[16];
     uint8_t bt;
 
+    top->bits = 0;
+    top->state = 0;
+
     for (uint64_t counter = offset; counter < 0x2000000; counter += skips) {
         // Reset the current bitcount of correct bits
         size_t bits = 0;
@@ -406,41 +459,37 @@ static void ice_sm_right_thread(
             if (((bt >> 7) & 0x01) == 0) bits++;
         }
 
-        g_ice_mtx.lock();
-        if (bits > g_topbits.load(std::memory_order_relaxed)) {
+        if (bits > top->bits) {
             // Copy the winning mask
-            g_topbits = bits;
-            memcpy(mask, tmp_mask, 16);
+            top->bits = bits;
+            top->state = counter;
+            memcpy(top->mask, tmp_mask, 16);
         }
-        g_ice_mtx.unlock();
 
         // Ignore states under 90
         if (bits >= 90) {
             //  Make sure the bits are used for ordering
-            g_ice_mtx.lock();
-            if (bincstates->find((((uint64_t)bits) << 56) | counter) != bincstates->end())
-                bincstates->at((((uint64_t)bits) << 56) | counter) = counter;
-            else
-                bincstates->insert(std::pair<uint64_t, uint64_t>((((uint64_t)bits) << 56) | counter, counter));
-            g_ice_mtx.unlock();
+            bincstates->push_back(ICE_BIN_KEY(bits, counter));
         }
 
         if ((counter & 0xfffff) == 0) {
-            g_ice_mtx.lock();
             printf(".");
             fflush(stdout);
-            g_ice_mtx.unlock();
         }
     }
+
+    // Highest bin first
+    sort(bincstates->begin(), bincstates->end(), greater<uint64_t>());
 }
+
 static uint32_t ice_sm_right(const uint8_t *ks, uint8_t *mask, vector<uint64_t> *pcrstates) {
 
-    map<uint64_t, uint64_t> bincstates;
-    g_topbits = 0;
+    vector<vector<uint64_t>> bincstates(g_num_cpus);
+    vector<ice_topbin_t> tops(g_num_cpus);
 
     std::vector<std::thread> threads(g_num_cpus);
     for (uint32_t m = 0; m < g_num_cpus; m++) {
-        threads[m] = std::thread(ice_sm_right_thread, m, g_num_cpus, ks, &bincstates, mask);
+        threads[m] = std::thread(ice_sm_right_thread, m, g_num_cpus, ks, &bincstates[m], &tops[m]);
     }
     for (auto &t : threads) {
         t.join();
@@ -448,26 +497,29 @@ static uint32_t ice_sm_right(const uint8_t *ks, uint8_t *mask, vector<uint64_t>
 
     printf("\n");
 
-    // Clear the candidate state vector
-    pcrstates->clear();
-
-    // Copy the order the states from lowest-bin to highest-bin
-    map<uint64_t, uint64_t>::iterator it;
-    for (it = bincstates.begin(); it != bincstates.end(); ++it) {
-        pcrstates->push_back(it->second);
+    // Keep the mask of the first state with the most correct bits, like the single threaded search
+    const ice_topbin_t *top = &tops[0];
+    for (uint32_t m = 1; m < g_num_cpus; m++) {
+        if ((tops[m].bits > top->bits) || (tops[m].bits == top->bits && tops[m].state < top->state)) {
+            top = &tops[m];
+        }
     }
+    memcpy(mask, top->mask, 16);
 
-    // Reverse the vector order (so the highest bin comes first)
-    reverse(pcrstates->begin(), pcrstates->end());
+    // Order the states from highest-bin to lowest-bin
+    ice_merge_bins(bincstates, pcrstates);
+    for (size_t i = 0; i < pcrstates->size(); i++) {
+        (*pcrstates)[i] = ICE_BIN_STATE((*pcrstates)[i]);
+    }
 
-    return g_topbits;
+    return top->bits;
 }
 
 static void ice_sm_left_thread(
     uint8_t offset,
     uint8_t skips,
     const uint8_t *ks,
-    map<uint64_t, cs_t> *bincstates,
+    vector<uint64_t> *bincstates,
     const uint8_t *mask
 ) {
 
@@ -476,11 +528,6 @@ static void ice_sm_left_thread(
     uint8_t bt;
     const lookup_entry *lookup;
 
-    // Reset and initialize the cryptostate and vector
-    cs_t state;
-    memset(&state, 0x00, sizeof(cs_t));
-    state.invalid = false;
-
     for (uint64_t counter = offset; counter < 0x800000000ull; counter += skips) {
         uint64_t lstate = counter;
 
@@ -525,35 +572,30 @@ static void ice_sm_left_thread(
                 if (((bt >> 7) & 0x01) == 0) bits++;
             }
 
-            state.l = counter;
-
             //  Make sure the bits are used for ordering
-            g_ice_mtx.lock();
+            bincstates->push_back(ICE_BIN_KEY(bits, counter));
             printf(".");
             fflush(stdout);
-            if (bincstates->find((((uint64_t)bits) << 56) | counter) != bincstates->end())
-                bincstates->at((((uint64_t)bits) << 56) | counter) = state;
-            else
-                bincstates->insert(std::pair<uint64_t, cs_t>((((uint64_t)bits) << 56) | counter, state));
-            g_ice_mtx.unlock();
-
         }
 
         if ((counter & 0xffffffffull) == 0) {
-            g_ice_mtx.lock();
             printf("%02.1f%%.", ((float)100 / 8) * (counter >> 32));
             fflush(stdout);
-            g_ice_mtx.unlock();
         }
     }
+
+    // Highest bin first
+    sort(bincstates->begin(), bincstates->end(), greater<uint64_t>());
 }
 
 static void ice_sm_left(const uint8_t *ks, uint8_t *mask, vector<cs_t> *pcstates) {
 
-    map<uint64_t, cs_t> bincstates;
+    vector<vector<uint64_t>> bincstates(g_num_cpus);
+    vector<uint64_t> keys;
+
     std::vector<std::thread> threads(g_num_cpus);
     for (uint32_t m = 0; m < g_num_cpus; m++) {
-        threads[m] = std::thread(ice_sm_left_thread, m, g_num_cpus, ks, &bincstates, mask);
+        threads[m] = std::thread(ice_sm_left_thread, m, g_num_cpus, ks, &bincstates[m], mask);
     }
 
     for (auto &t : threads) {
@@ -562,16 +604,20 @@ static void ice_sm_left(const uint8_t *ks, uint8_t *mask, vector<cs_t> *pcstates
 
     printf("100%%\n");
 
-    // Clear the candidate state vector
-    pcstates->clear();
+    // Order the states from highest-bin to lowest-bin
+    ice_merge_bins(bincstates, &keys);
 
-    // Copy the order the states from lowest-bin to highest-bin
-    map<uint64_t, cs_t>::iterator it;
-    for (it = bincstates.begin(); it != bincstates.end(); ++it) {
-        pcstates->push_back(it->second);
+    // Reset and initialize the cryptostate and vector
+    cs_t state;
+    memset(&state, 0x00, sizeof(cs_t));
+    state.invalid = false;
+
+    pcstates->clear();
+    pcstates->reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        state.l = ICE_BIN_STATE(keys[i]);
+        pcstates->push_back(state);
     }
-    // Reverse the vector order (so the highest bin comes first)
-    reverse(pcstates->begin(), pcstates->end());
 }
 
 static inline void previous_all_input(vector<cs_t> *pcstates, uint32_t gc_byte_index, cipher_state_side css) {
@@ -608,16 +654,30 @@ static inline void previous_all_input(vector<cs_t> *pcstates, uint32_t gc_byte_i
     *pcstates = prev_ncstates;
 }
 
+// The meet-in-the-middle tables are plain (state, counter) pairs sorted by state,
+// matching the candidates is a binary search instead of a tree lookup.
+// When a state shows up more than once, the highest counter is used.
+static inline bool ice_matchbox_find(const vector<pair<uint64_t, uint64_t>> &matchbox, uint64_t state, uint64_t *counter) {
+    vector<pair<uint64_t, uint64_t>>::const_iterator it;
+    it = upper_bound(matchbox.begin(), matchbox.end(), make_pair(state, UINT64_MAX));
+    if (it == matchbox.begin()) return false;
+    --it;
+    if (it->first != state) return false;
+    *counter = it->second;
+    return true;
+}
+
 static inline void search_gc_candidates_right(const uint64_t rstate_before_gc, const uint64_t rstate_after_gc, const uint8_t *Q, vector<cs_t> *pcstates) {
     vector<cs_t>::iterator it;
     vector<cs_t> csl_cand;
-    map<uint64_t, uint64_t> matchbox;
-    map<uint64_t, uint64_t>::iterator itmatch;
+    vector<pair<uint64_t, uint64_t>> matchbox;
+    uint64_t match;
     uint64_t rstate;
     size_t counter;
     cs_t state;
 
     // Generate 2^20 different (5 bits) values for the first 4 Gc bytes (0,1,2,3)
+    matchbox.reserve(0x100000);
     for (counter = 0; counter < 0x100000; counter++) {
         rstate  = rstate_before_gc;
         next_right_fast((counter >> 12) & 0xf8, &rstate);
@@ -626,8 +686,9 @@ static inline void search_gc_candidates_right(const uint64_t rstate_before_gc, c
         next_right_fast((counter >> 2) & 0xf8, &rstate);
         next_right_fast((counter << 3) & 0xf8, &rstate);
         next_right_fast(Q[5], &rstate);
-        matchbox[rstate] = counter;
+        matchbox.push_back(make_pair(rstate, (uint64_t)counter));
     }
+    sort(matchbox.begin(), matchbox.end());
 
     // Reset and initialize the cryptostate and vecctor
     memset(&state, 0x00, sizeof(cs_t));
@@ -648,12 +709,11 @@ static inline void search_gc_candidates_right(const uint64_t rstate_before_gc, c
 
     // Take the intersection of the corresponding states ~2^15 values (40-25 = 15 bits)
     for (it = csl_cand.begin(); it != csl_cand.end(); ++it) {
-        itmatch = matchbox.find(it->r);
-        if (itmatch != matchbox.end()) {
-            it->Gc[0] = (itmatch->second >> 12) & 0xf8;
-            it->Gc[1] = (itmatch->second >>  7) & 0xf8;
-            it->Gc[2] = (itmatch->second >>  2) & 0xf8;
-            it->Gc[3] = (itmatch->second <<  3) & 0xf8;
+        if (ice_matchbox_find(matchbox, it->r, &match)) {
+            it->Gc[0] = (match >> 12) & 0xf8;
+            it->Gc[1] = (match >>  7) & 0xf8;
+            it->Gc[2] = (match >>  2) & 0xf8;
+            it->Gc[3] = (match <<  3) & 0xf8;
 
             pcstates->push_back(*it);
         }
@@ -663,12 +723,13 @@ static inline void search_gc_candidates_right(const uint64_t rstate_before_gc, c
 static inline void search_gc_candidates_left(const uint64_t lstate_before_gc, const uint8_t *Q, vector<cs_t> *pcstates) {
     vector<cs_t> csl_cand, csl_search;
     vector<cs_t>::iterator itsearch, itcand;
-    map<uint64_t, uint64_t> matchbox;
-    map<uint64_t, uint64_t>::iterator itmatch;
+    vector<pair<uint64_t, uint64_t>> matchbox;
+    uint64_t match;
     uint64_t lstate;
     size_t counter;
 
     // Generate 2^20 different (5 bits) values for the first 4 Gc bytes (0,1,2,3)
+    matchbox.reserve(0x100000);
     for (counter = 0; counter < 0x100000; counter++) {
         lstate  = lstate_before_gc;
         next_left_fast((counter >> 15) & 0x1f, &lstate);
@@ -677,8 +738,9 @@ static inline void search_gc_candidates_left(const uint64_t lstate_before_gc, co
         next_left_fast((counter >> 5) & 0x1f, &lstate);
         next_left_fast(counter & 0x1f, &lstate);
         next_left_fast(Q[5], &lstate);
-        matchbox[lstate] = counter;
+        matchbox.push_back(make_pair(lstate, (uint64_t)counter));
     }
+    sort(matchbox.begin(), matchbox.end());
 
     // Copy the input candidate states and clean the output vector
     csl_cand = *pcstates;
@@ -698,12 +760,11 @@ static inline void search_gc_candidates_left(const uint64_t lstate_before_gc, co
 
         // Take the intersection of the corresponding states ~2^15 values (40-25 = 15 bits)
         for (itsearch = csl_search.begin(); itsearch != csl_search.end(); ++itsearch) {
-            itmatch = matchbox.find(itsearch->l);
-            if (itmatch != matchbox.end()) {
-                itsearch->Gc[0] = (itmatch->second >> 15) & 0x1f;
-                itsearch->Gc[1] = (itmatch->second >> 10) & 0x1f;
-                itsearch->Gc[2] = (itmatch->second >>  5) & 0x1f;
-                itsearch->Gc[3] = itmatch->second & 0x1f;
+            if (ice_matchbox_find(matchbox, itsearch->l, &match)) {
+                itsearch->Gc[0] = (match >> 15) & 0x1f;
+                itsearch->Gc[1] = (match >> 10) & 0x1f;
+                itsearch->Gc[2] = (match >>  5) & 0x1f;
+                itsearch->Gc[3] = match & 0x1f;
 
                 pcstates->push_back(*itsearch);
             }
@@ -423,6 +423,27 @@ static void print_version_info_preamble(FILE *outfile, int num_infiles) {
     fprintf(outfile, "const FPGA_VERSION_INFORMATION g_fpga_version_information[%d] = {\n", num_infiles);
 }
 
+// Index the bitstream body, so the firmware can skip the header sections without parsing them.
+// 0/0 if the file has no 'e' section, the firmware then falls back to searching for it.
+static void FpgaIndexBitstream(FILE *infile, uint32_t *offset, uint32_t *length) {
+    unsigned int body_len = 0;
+
+    *offset = 0;
+    *length = 0;
+
+    if (fseek(infile, FPGA_BITSTREAM_FIXED_HEADER_SIZE, SEEK_SET) != 0) {
+        return;
+    }
+
+    if (bitparse_find_section(infile, 'e', &body_len)) {
+        long pos = ftell(infile);
+        if (pos > 0) {
+            *offset = (uint32_t)pos;
+            *length = body_len;
+        }
+    }
+}
+
 static int generate_fpga_version_info(FILE *infile[], char *infile_names[], int num_infiles, FILE *outfile) {
 
     char version_string[80] = "";
@@ -434,15 +455,19 @@ static int generate_fpga_version_info(FILE *infile[], char *infile_names[], int
         fprintf(outfile, "    { \"%s\"", version_string);
 
         if (!memcmp("fpga_pm3_lf.ncd", version_string, sizeof("fpga_pm3_lf.ncd") - 1))
-            fprintf(outfile, ", FPGA_BITSTREAM_LF }");
+            fprintf(outfile, ", FPGA_BITSTREAM_LF");
         else if (!memcmp("fpga_pm3_hf_15.ncd", version_string, sizeof("fpga_pm3_hf_15.ncd") - 1))
-            fprintf(outfile, ", FPGA_BITSTREAM_HF_15 }");
+            fprintf(outfile, ", FPGA_BITSTREAM_HF_15");
         else if (!memcmp("fpga_pm3_hf.ncd", version_string, sizeof("fpga_pm3_hf.ncd") - 1))
-            fprintf(outfile, ", FPGA_BITSTREAM_HF }");
+            fprintf(outfile, ", FPGA_BITSTREAM_HF");
         else if (!memcmp("fpga_pm3_felica.ncd", version_string, sizeof("fpga_pm3_felica.ncd") - 1))
-            fprintf(outfile, ", FPGA_BITSTREAM_HF_FELICA }");
+            fprintf(outfile, ", FPGA_BITSTREAM_HF_FELICA");
         else
-            fprintf(outfile, ", FPGA_BITSTREAM_UNKNOWN }");
+            fprintf(outfile, ", FPGA_BITSTREAM_UNKNOWN");
+
+        uint32_t offset, length;
+        FpgaIndexBitstream(infile[i], &offset, &length);
+        fprintf(outfile, ", %u, %u }", offset, length);
 
         if (i != num_infiles - 1) {
             fprintf(outfile, ",");
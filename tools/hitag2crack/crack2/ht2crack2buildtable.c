@@ -1,35 +1,35 @@
 /*
  * ht2crack2buildtable.c
- * This builds the 1.2TB table and sorts it.
+ * This builds the 1.2TB table, sorts it and writes it as compressed table files.
+ *
+ * The build is done in NUM_ROUNDS rounds, after every round all buckets are flushed and
+ * a checkpoint is written.  When interrupted, running it again in the same directory
+ * resumes after the last checkpoint, the sort resumes with the files not sorted yet.
  */
 
 #include "ht2crackutils.h"
+#include "ht2crack2table.h"
+#include <getopt.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <stdlib.h>
 
-// DATAMAX is the size of each bucket (bytes).  There are 65536 buckets so choose a value such that
-// DATAMAX * 65536 < RAM available.  For ex, if you want to use 12GB of RAM (for a 16GB machine
-// leaving some RAM free for OS and other stuff), DATAMAX = 12GB / 65536 = 196608.  Round this down
-// to a power of 10; DATAMAX = 196600.
-#define DATAMAX 196600 // around 192K rounded down to a power of 10
-
-// NUM_BUILD_THREADS and NUM_SORT_THREADS are the number of threads to run concurrently.  These should
-// ideally be equal to the number of virtual cores you have available.  A quad-core machine will
-// likely have 8 virtual cores, so set them to 8.
-//
-// If sorting fails with a 'bus error' then that is likely because your disk I/O can't keep up with
-// the read/write demands of the multi-threaded sorting.  In this case, reduce the number of sorting
-// threads.  This will most likely only be a problem with network disks; SATA should be okay;
-// USB2/3 should keep up.
-//
-// These MUST be a power of 2 for the maths to work - you have been warned!
-// Also, sort threads MUST be <= build threads or a horrible buffer overflow will happen!
-#define NUM_BUILD_THREADS 8
-#define NUM_SORT_THREADS 8
-
 // DATASIZE is the number of bytes in an entry.  This is 10; 4 bytes of keystream (2 are in the filepath) +
 // 6 bytes of PRNG state.
 #define DATASIZE 10
 
+// The table holds the keystream of 2^TABLE_BITS PRNG states, 2048 states apart.
+// Smaller tables (-n) are only useful to test the tools.
+#define TABLE_BITS 37
+#define TABLE_BITS_MIN 8
+
+// number of checkpoints over the whole build
+#define NUM_ROUNDS 256
+
+#define CHECKPOINT      "table/checkpoint"
+#define CHECKPOINT_TMP  "table/checkpoint.tmp"
+#define CHECKPOINT_MAGIC "HT2C"
+
 int debug = 0;
 
 // table entry for a bucket
@@ -38,19 +38,35 @@ struct table {
     pthread_mutex_t mutex;
     unsigned char *data;
     unsigned char *ptr;
+    uint64_t written;
 };
 
+// checkpoint file, the buckets are truncated to these lengths when resuming
+struct checkpoint {
+    char magic[4];
+    uint32_t bits;
+    uint32_t rounds;
+    uint64_t len[0x10000];
+};
 
 // actual table
 struct table *t;
 
-// jump table 1
-uint64_t d[48];
-int nsteps;
+// size of each bucket (bytes)
+static uint32_t g_datamax;
+static int g_build_threads;
+static int g_sort_threads;
+static uint64_t g_entries;
+static uint64_t g_round;
+static uint64_t g_round_entries;
+static int g_next_bucket;
+static int g_convert;
+
+// jump tables, jt[k] jumps 2048 * 2^k states
+static uint64_t jt[TABLE_BITS][48];
 
-// jump table 2
-uint64_t d2[48];
-int nsteps2;
+// jump table for the stride of the build threads, 2048 * build threads states
+static uint64_t jstride[48];
 
 // create table entry
 static void create_table(struct table *tt, int d_1, int d_2) {
@@ -60,7 +76,7 @@ static void create_table(struct table *tt, int d_1, int d_2) {
     }
 
     // create some space
-    tt->data = (unsigned char *)calloc(1, DATAMAX);
+    tt->data = (unsigned char *)calloc(1, g_datamax);
     if (!(tt->data)) {
         printf("create_table: cannot calloc data\n");
         exit(1);
@@ -76,7 +92,6 @@ static void create_table(struct table *tt, int d_1, int d_2) {
     }
 
     // create the path
-//    snprintf(tt->path, sizeof(tt->path), "/Volumes/2tb/%02X/%02X.bin", d_1 & 0xff, d_2 & 0xff);
     snprintf(tt->path, sizeof(tt->path), "table/%02x/%02x.bin", d_1 & 0xff, d_2 & 0xff);
 }
 
@@ -134,6 +149,7 @@ static void writetable(struct table *t1) {
 
     if (debug) printf("writetable %s written\n", t1->path);
 
+    t1->written += t1->ptr - t1->data;
     close(fd);
 }
 
@@ -171,7 +187,7 @@ static void store(unsigned char *data) {
     t1->ptr += 10;
 
     // check if table is full
-    if ((t1->ptr - t1->data) >= DATAMAX) {
+    if ((t1->ptr - t1->data) >= g_datamax) {
         // write the table to disk
         writetable(t1);
         // reset ptr
@@ -204,106 +220,79 @@ static void write_ks_s(uint32_t ks1, uint32_t ks2, uint64_t shiftreg) {
 }
 
 
-// builds the di table for jumping
-static void builddi(int steps, int table) {
-    uint64_t statemask;
-    int i;
-    Hitag_State mystate;
-    uint64_t *thisd = NULL;
-
-    statemask = 1;
-
-    // select jump table
-    if (table == 1) {
-        nsteps = steps;
-        thisd = d;
-    } else if (table == 2) {
-        nsteps2 = steps;
-        thisd = d2;
-    } else {
-        printf("builddi: invalid table num\n");
-        exit(1);
+// xor all di.si where di is a d state and si is a bit
+// we do this by multiplying di by si:
+// if si is 1, di.si = di; if si is 0, di.si = 0
+static uint64_t jump(const uint64_t *thisd, uint64_t shiftreg) {
+    uint64_t output = 0;
+    uint64_t bitmask = 1;
+
+    for (int i = 0; i < 48; i++) {
+        if (shiftreg & bitmask) {
+            output = output ^ thisd[i];
+        }
+
+        bitmask = bitmask << 1;
+    }
+    return output;
+}
+
+// jump 2048 * n states
+static uint64_t jumpn(uint64_t shiftreg, uint64_t n) {
+    for (int k = 0; n; k++, n >>= 1) {
+        if (n & 1) {
+            shiftreg = jump(jt[k], shiftreg);
+        }
     }
+    return shiftreg;
+}
+
+// builds the di tables for jumping
+static void builddi(void) {
+    Hitag_State mystate;
+    uint64_t statemask = 1;
+    int i, k;
 
-    // build di states
+    // 2048 steps
     for (i = 0; i < 48; i++) {
         mystate.shiftreg = statemask;
         buildlfsr(&mystate);
-        hitag2_nstep(&mystate, steps);
-        thisd[i] = mystate.shiftreg;
+        hitag2_nstep(&mystate, 2048);
+        jt[0][i] = mystate.shiftreg;
 
         statemask = statemask << 1;
     }
-}
 
-// jump function - quickly jumps a load of steps
-static void jumpnsteps(Hitag_State *hstate, int table) {
-    uint64_t output = 0;
-    uint64_t bitmask;
-    int i;
-    uint64_t *thisd = NULL;
-
-
-    // select jump table
-    if (table == 1) {
-        thisd = d;
-    } else if (table == 2) {
-        thisd = d2;
-    } else {
-        printf("jumpnsteps: invalid table num\n");
-        exit(1);
+    // every next one is two of the one before
+    for (k = 1; k < TABLE_BITS; k++) {
+        for (i = 0; i < 48; i++) {
+            jt[k][i] = jump(jt[k - 1], jt[k - 1][i]);
+        }
     }
 
-    // xor all di.si where di is a d state and si is a bit
-    // we do this by multiplying di by si:
-    // if si is 1, di.si = di; if si is 0, di.si = 0
-
-    bitmask = 1;
+    // the build thread stride
     for (i = 0; i < 48; i++) {
-        if (hstate->shiftreg & bitmask) {
-            output = output ^ thisd[i];
-        }
-
-        bitmask = bitmask << 1;
+        jstride[i] = jumpn(1ULL << i, g_build_threads);
     }
-
-    hstate->shiftreg = output;
-    buildlfsr(hstate);
 }
 
 
 // thread to build a part of the table
+// Entry n of the table is the state 2048 * n steps after the random start state, every
+// round covers g_round_entries of them and thread i makes every g_build_threads'th one.
 static void *buildtable(void *dd) {
     Hitag_State hstate;
     Hitag_State hstate2;
-    unsigned long maxentries = 1;
     int index = (int)(long)dd;
-    int tnum = NUM_BUILD_THREADS;
+    uint64_t n = (g_round * g_round_entries) + index;
+    uint64_t end = (g_round + 1) * g_round_entries;
 
-    /* set random state */
-    hstate.shiftreg = 0x123456789abc;
+    /* set random state and jump to our first entry */
+    hstate.shiftreg = jumpn(0x123456789abc, n);
     buildlfsr(&hstate);
 
-    /* jump to offset using jump table 2 (2048) */
-    for (unsigned long i = 0; i < index; i++) {
-        jumpnsteps(&hstate, 2);
-    }
-
-    /* set max entries - this is a fraction of 2^37 depending on how many threads we are running.
-       1 thread  = 2^37
-       2 threads = 2^36
-       4 threads = 2^35
-       8 threads = 2^34
-       etc
-    */
-    maxentries = maxentries << 37;
-    while (!(tnum & 0x1)) {
-        maxentries = maxentries >> 1;
-        tnum = tnum >> 1;
-    }
-
     /* make the entries */
-    for (unsigned long i = 0; i < maxentries; i++) {
+    for (; n < end; n += g_build_threads) {
 
         // copy the current state
         hstate2.shiftreg = hstate.shiftreg;
@@ -316,144 +305,312 @@ static void *buildtable(void *dd) {
 
         write_ks_s(ks1, ks2, hstate.shiftreg);
 
-        // jump hstate forward 2048 * NUM_BUILD_THREADS states using di table
-        // this is because we're running NUM_BUILD_THREADS threads at once, from NUM_BUILD_THREADS
-        // different offsets that are 2048 states apart.
-        jumpnsteps(&hstate, 1);
+        // jump hstate forward 2048 * g_build_threads states
+        hstate.shiftreg = jump(jstride, hstate.shiftreg);
+        buildlfsr(&hstate);
     }
 
     return NULL;
 }
 
 
+static void makedir(const char *path) {
+    if (mkdir(path, 0755) && (errno != EEXIST)) {
+        printf("cannot make dir %s\n", path);
+        exit(1);
+    }
+}
+
 // make 'table/' (unsorted) and 'sorted/' dir structures
 static void makedirs(void) {
     char path[32];
     int i;
 
-    if (mkdir("table", 0755)) {
-        printf("cannot make dir table\n");
+    makedir("table");
+    makedir("sorted");
+
+    for (i = 0; i < 0x100; i++) {
+        snprintf(path, sizeof(path), "table/%02x", i);
+        makedir(path);
+        snprintf(path, sizeof(path), "sorted/%02x", i);
+        makedir(path);
+    }
+}
+
+// write the checkpoint after 'rounds' rounds, the bucket files have to be flushed
+static void write_checkpoint(struct checkpoint *cp, uint32_t bits, uint32_t rounds) {
+    memcpy(cp->magic, CHECKPOINT_MAGIC, sizeof(cp->magic));
+    cp->bits = bits;
+    cp->rounds = rounds;
+    for (int i = 0; i < 0x10000; i++) {
+        cp->len[i] = t[i].written;
+    }
+
+#ifndef __MINGW64__
+    // make sure the bucket data is on disk before the checkpoint says it is
+    sync();
+#endif
+
+    int fd = open(CHECKPOINT_TMP, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("cannot create %s\n", CHECKPOINT_TMP);
+        exit(1);
+    }
+    if (write(fd, cp, sizeof(struct checkpoint)) != sizeof(struct checkpoint)) {
+        printf("cannot write %s\n", CHECKPOINT_TMP);
         exit(1);
     }
-    if (mkdir("sorted", 0755)) {
-        printf("cannot make dir sorted\n");
+    close(fd);
+
+    if (rename(CHECKPOINT_TMP, CHECKPOINT)) {
+        printf("cannot rename %s\n", CHECKPOINT_TMP);
         exit(1);
     }
+}
 
-    for (i = 0; i < 0x100; i++) {
-        snprintf(path, sizeof(path), "table/%02x", i);
-        if (mkdir(path, 0755)) {
-            printf("cannot make dir %s\n", path);
+// load the checkpoint and drop everything written after it, returns the rounds done
+static uint32_t resume_checkpoint(struct checkpoint *cp, uint32_t bits) {
+    memset(cp, 0, sizeof(struct checkpoint));
+
+    int fd = open(CHECKPOINT, O_RDONLY);
+    if (fd >= 0) {
+        if (read(fd, cp, sizeof(struct checkpoint)) != sizeof(struct checkpoint) ||
+                memcmp(cp->magic, CHECKPOINT_MAGIC, sizeof(cp->magic))) {
+            printf("%s is not a valid checkpoint\n", CHECKPOINT);
             exit(1);
         }
-        snprintf(path, sizeof(path), "sorted/%02x", i);
-        if (mkdir(path, 0755)) {
-            printf("cannot make dir %s\n", path);
+        close(fd);
+
+        if (cp->bits != bits) {
+            printf("%s is for a table of 2^%u entries, not 2^%u\n", CHECKPOINT, cp->bits, bits);
+            exit(1);
+        }
+    }
+
+    if (cp->rounds >= NUM_ROUNDS) {
+        return cp->rounds;
+    }
+
+    for (int i = 0; i < 0x10000; i++) {
+        if (truncate(t[i].path, cp->len[i]) && (errno != ENOENT)) {
+            printf("cannot truncate %s\n", t[i].path);
             exit(1);
         }
+        t[i].written = cp->len[i];
+    }
+
+    if (cp->rounds) {
+        printf("resuming after round %u of %u\n", cp->rounds, NUM_ROUNDS);
     }
+    return cp->rounds;
 }
 
-static int datacmp(const void *p1, const void *p2, void *dummy) {
-    unsigned char *d_1 = (unsigned char *)p1;
-    unsigned char *d_2 = (unsigned char *)p2;
+static int datacmp(const void *p1, const void *p2) {
+    return memcmp(p1, p2, DATASIZE);
+}
+
+// read a raw table file, missing files are empty
+static unsigned char *readtable(const char *infile, uint64_t *numentries) {
+    struct stat filestat;
+
+    *numentries = 0;
+
+    int fdin = open(infile, O_RDONLY);
+    if (fdin < 0) {
+        // no entries ended up in this bucket (small test tables)
+        if ((errno == ENOENT) && (g_convert == 0)) {
+            return (unsigned char *)calloc(1, DATASIZE);
+        }
+        printf("cannot open file %s\n", infile);
+        exit(1);
+    }
+
+    if (fstat(fdin, &filestat)) {
+        printf("cannot stat file %s\n", infile);
+        exit(1);
+    }
+
+    unsigned char *table = (unsigned char *)calloc(1, filestat.st_size + DATASIZE);
+    if (!table) {
+        printf("readtable: cannot calloc table\n");
+        exit(1);
+    }
+
+    size_t got = 0;
+    while (got < (size_t)filestat.st_size) {
+        ssize_t res = read(fdin, table + got, filestat.st_size - got);
+        if (res <= 0) {
+            printf("cannot read file %s\n", infile);
+            exit(1);
+        }
+        got += res;
+    }
+    close(fdin);
 
-    return memcmp(d_1, d_2, DATASIZE);
+    *numentries = filestat.st_size / DATASIZE;
+    return table;
 }
 
+// sort every bucket and write it as a compressed table file
+// the buckets are handed out one by one, whichever thread is free takes the next
 static void *sorttable(void *dd) {
-    int i, j;
-    int fdin;
-    int fdout;
     char infile[64];
     char outfile[64];
-    unsigned char *data = NULL;
+    const char *infmt = (const char *)dd;
     struct stat filestat;
-    int index = (int)(long)dd;
-    int space = 0x100 / NUM_SORT_THREADS;
 
-    // create table - 50MB should be enough
-    unsigned char *table = (unsigned char *)calloc(1, 50UL * 1024UL * 1024UL);
-    if (!table) {
-        printf("sorttable: cannot calloc table\n");
-        exit(1);
-    }
+    while (1) {
+        int bucket = __sync_fetch_and_add(&g_next_bucket, 1);
+        if (bucket >= 0x10000) {
+            break;
+        }
 
-    // loop over our first byte values
-    for (i = (index * space); i < ((index + 1) * space); i++) {
-        // loop over all second byte values
-        for (j = 0; j < 0x100; j++) {
+        int i = bucket >> 8;
+        int j = bucket & 0xff;
 
-            printf("sorttable: processing bytes 0x%02x/0x%02x\n", i, j);
+        snprintf(infile, sizeof(infile), infmt, i, j);
+        snprintf(outfile, sizeof(outfile), HT2TABLE_FILE, i, j);
 
-            // open file, stat it and mmap it
-            snprintf(infile, sizeof(infile), "table/%02x/%02x.bin", i, j);
+        // already done by an earlier run, it was interrupted before the input was removed
+        if (stat(outfile, &filestat) == 0) {
+            unlink(infile);
+            continue;
+        }
 
-            fdin = open(infile, O_RDONLY);
-            if (fdin <= 0) {
-                printf("cannot open file %s\n", infile);
-                exit(1);
-            }
+        if (j == 0) {
+            printf("sorttable: processing bytes 0x%02x/0x%02x\n", i, j);
+        }
 
-            if (fstat(fdin, &filestat)) {
-                printf("cannot stat file %s\n", infile);
-                exit(1);
-            }
+        uint64_t numentries;
+        unsigned char *table = readtable(infile, &numentries);
 
-            data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fdin, 0);
-            if (data == MAP_FAILED) {
-                printf("cannot mmap file %s\n", infile);
-                exit(1);
-            }
+        // sort it
+        qsort(table, numentries, DATASIZE, datacmp);
 
-            // copy data into table
-            memcpy(table, data, filestat.st_size);
+        // write to file
+        if (ht2table_write(outfile, table, numentries)) {
+            exit(1);
+        }
+        free(table);
 
-            uint64_t numentries = filestat.st_size / DATASIZE;
+        // remove input file
+        if (unlink(infile) && (errno != ENOENT)) {
+            printf("cannot remove file %s\n", infile);
+            exit(1);
+        }
+    }
 
-            // unmap file and close it
-            if (munmap(data, filestat.st_size)) {
-                printf("cannot munmap %s\n", infile);
-                exit(1);
-            }
+    return NULL;
+}
 
-            close(fdin);
+static void runsort(const char *infmt) {
+    pthread_t threads[g_sort_threads];
+    void *status;
 
-            // sort it
-            void *dummy = NULL; // clang
-            qsort_r(table, numentries, DATASIZE, datacmp, dummy);
+    g_next_bucket = 0;
 
-            // write to file
-            snprintf(outfile, sizeof(outfile), "sorted/%02x/%02x.bin", i, j);
-            fdout = open(outfile, O_WRONLY | O_CREAT, 0644);
-            if (fdout <= 0) {
-                printf("cannot create outfile %s\n", outfile);
-                exit(1);
-            }
-            if (write(fdout, table, numentries * DATASIZE) != (numentries * DATASIZE)) {
-                printf("writetable cannot write all of the data\n");
-                exit(1);
-            }
-            close(fdout);
+    // start the threads
+    for (long i = 0; i < g_sort_threads; i++) {
+        int ret = pthread_create(&(threads[i]), NULL, sorttable, (void *)infmt);
+        if (ret) {
+            printf("cannot start sorttable thread %ld\n", i);
+            exit(1);
+        }
+    }
 
-            // remove input file
-            if (unlink(infile)) {
-                printf("cannot remove file %s\n", infile);
-                exit(1);
-            }
+    if (debug) printf("main, started sorttable threads\n");
+
+    // wait for threads to finish
+    for (long i = 0; i < g_sort_threads; i++) {
+        int ret = pthread_join(threads[i], &status);
+        if (ret) {
+            printf("cannot join sorttable thread %ld\n", i);
+            exit(1);
         }
+        printf("sorttable thread %ld finished\n", i);
     }
+}
 
-    return NULL;
+static int num_CPUs(void) {
+    int count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1)
+        count = 1;
+    return count;
+}
+
+static void usage(char *name) {
+    printf("%s [-t threads] [-s threads] [-m MB] [-n bits] [-c]\n", name);
+    printf("  -t  build threads (default: number of cores)\n");
+    printf("  -s  sort threads (default: number of cores), lower it when the disk can't keep up\n");
+    printf("  -m  MB of RAM for the buckets (default: 12288)\n");
+    printf("  -n  build a table of 2^bits entries, only for testing (default: %d)\n", TABLE_BITS);
+    printf("  -c  compress an existing table of raw sorted/xx/yy.bin files\n");
+    printf("\nRun it again in the same directory to resume an interrupted build.\n");
+    exit(1);
 }
 
 int main(int argc, char *argv[]) {
-    pthread_t threads[NUM_BUILD_THREADS];
-    void *status;
+    uint64_t ram_mb = 12288;
+    uint32_t bits = TABLE_BITS;
+    int c;
+
+    g_build_threads = num_CPUs();
+    g_sort_threads = num_CPUs();
+
+    while ((c = getopt(argc, argv, "t:s:m:n:ch")) != -1) {
+        switch (c) {
+            case 't':
+                g_build_threads = atoi(optarg);
+                break;
+            case 's':
+                g_sort_threads = atoi(optarg);
+                break;
+            case 'm':
+                ram_mb = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                bits = atoi(optarg);
+                break;
+            case 'c':
+                g_convert = 1;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if ((g_build_threads < 1) || (g_sort_threads < 1) || (bits < TABLE_BITS_MIN) || (bits > TABLE_BITS)) {
+        usage(argv[0]);
+    }
+
+    if (g_convert) {
+        printf("compressing the raw table files in " HT2TABLE_DIR "/ using %d threads\n", g_sort_threads);
+        runsort(HT2TABLE_RAWFILE);
+        return 0;
+    }
+
+    // each bucket gets 1/65536 of the RAM, in whole entries
+    g_datamax = ((ram_mb * 1024 * 1024) / 0x10000 / DATASIZE) * DATASIZE;
+    if (g_datamax < DATASIZE) {
+        usage(argv[0]);
+    }
+
+    g_entries = 1ULL << bits;
+    g_round_entries = g_entries / NUM_ROUNDS;
+
+    // a finished table has no checkpoint and a last sorted bucket
+    char lastfile[64];
+    struct stat filestat;
+    snprintf(lastfile, sizeof(lastfile), HT2TABLE_FILE, 0xff, 0xff);
+    if (stat(CHECKPOINT, &filestat) && (stat(lastfile, &filestat) == 0)) {
+        printf("the table in " HT2TABLE_DIR "/ is already built\n");
+        return 0;
+    }
 
     // make the table of tables
     t = (struct table *)calloc(sizeof(struct table) * 65536, sizeof(uint8_t));
-    if (!t) {
+    struct checkpoint *cp = (struct checkpoint *)calloc(1, sizeof(struct checkpoint));
+    if (!t || !cp) {
         printf("calloc failed\n");
         exit(1);
     }
@@ -464,73 +621,64 @@ int main(int argc, char *argv[]) {
     // create the directories
     makedirs();
 
-    // build the jump table for incremental steps
-    builddi(2048 * NUM_BUILD_THREADS, 1);
+    // build the jump tables
+    builddi();
 
-    // build the jump table for setting the offset
-    builddi(2048, 2);
+    printf("building 2^%u entries using %d threads, %u bytes per bucket\n", bits, g_build_threads, g_datamax);
 
-    // start the threads
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
-        int ret = pthread_create(&(threads[i]), NULL, buildtable, (void *)(i));
-        if (ret) {
-            printf("cannot start buildtable thread %ld\n", i);
-            exit(1);
+    for (g_round = resume_checkpoint(cp, bits); g_round < NUM_ROUNDS; g_round++) {
+        pthread_t threads[g_build_threads];
+        void *status;
+
+        // start the threads
+        for (long i = 0; i < g_build_threads; i++) {
+            int ret = pthread_create(&(threads[i]), NULL, buildtable, (void *)(i));
+            if (ret) {
+                printf("cannot start buildtable thread %ld\n", i);
+                exit(1);
+            }
         }
-    }
 
-    if (debug) printf("main, started buildtable threads\n");
+        if (debug) printf("main, started buildtable threads\n");
 
-    // wait for threads to finish
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
-        int ret = pthread_join(threads[i], &status);
-        if (ret) {
-            printf("cannot join buildtable thread %ld\n", i);
-            exit(1);
+        // wait for threads to finish
+        for (long i = 0; i < g_build_threads; i++) {
+            int ret = pthread_join(threads[i], &status);
+            if (ret) {
+                printf("cannot join buildtable thread %ld\n", i);
+                exit(1);
+            }
         }
-        printf("buildtable thread %ld finished\n", i);
-    }
 
-    // write all remaining files
-    for (long i = 0; i < 0x10000; i++) {
-        struct table *t1 = t + i;
-        if (t1->ptr > t1->data) {
-            writetable(t1);
+        // write all remaining data of this round
+        for (long i = 0; i < 0x10000; i++) {
+            struct table *t1 = t + i;
+            if (t1->ptr > t1->data) {
+                writetable(t1);
+                t1->ptr = t1->data;
+            }
         }
+
+        write_checkpoint(cp, bits, g_round + 1);
+        printf("round %" PRIu64 " of %u done\n", g_round + 1, NUM_ROUNDS);
     }
 
     // dump the memory
     free_tables(t);
     free(t);
+    free(cp);
 
     // now for the sorting
+    runsort("table/%02x/%02x.bin");
 
-    // start the threads
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
-        int ret = pthread_create(&(threads[i]), NULL, sorttable, (void *)(i));
-        if (ret) {
-            printf("cannot start sorttable thread %ld\n", i);
-            exit(1);
-        }
-    }
-
-    if (debug) printf("main, started sorttable threads\n");
-
-    // wait for threads to finish
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
-        int ret = pthread_join(threads[i], &status);
-        if (ret) {
-            printf("cannot join sorttable thread %ld\n", i);
-            exit(1);
-        }
-        printf("sorttable thread %ld finished\n", i);
+    // the unsorted table is gone, clean up
+    unlink(CHECKPOINT);
+    for (int i = 0; i < 0x100; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "table/%02x", i);
+        rmdir(path);
     }
-
-    pthread_exit(NULL);
+    rmdir("table");
 
     return 0;
 }
-
-
-
-
@@ -5,22 +5,13 @@
  */
 
 #include "ht2crackutils.h"
-
-#define INPUTFILE "sorted/%02x/%02x.bin"
-#define DATASIZE 10
+#include "ht2crack2table.h"
 
 struct rngdata {
     unsigned char *data;
     int len;
 };
 
-static int datacmp(const void *p1, const void *p2) {
-    unsigned char *d1 = (unsigned char *)p1;
-    unsigned char *d2 = (unsigned char *)p2;
-
-    return memcmp(d1, d2, DATASIZE - 6);
-}
-
 static int loadrngdata(struct rngdata *r, char *file) {
     int fd;
     int i, j;
@@ -124,7 +115,7 @@ static int testcand(const unsigned char *f, unsigned char *rt, int fwd) {
     // build the prng state at the candidate
     hstate.shiftreg = 0;
     for (i = 0; i < 6; i++) {
-        hstate.shiftreg = (hstate.shiftreg << 8) | f[i + 4];
+        hstate.shiftreg = (hstate.shiftreg << 8) | f[i];
     }
     buildlfsr(&hstate);
 
@@ -153,71 +144,28 @@ static int testcand(const unsigned char *f, unsigned char *rt, int fwd) {
 }
 
 static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned char *m, unsigned char *s) {
-    int fd;
-    struct stat filestat;
-    char file[64];
-    unsigned char *data;
-    unsigned char item[10];
-    unsigned char *found = NULL;
-
+    uint8_t states[HT2TABLE_MAX_MATCHES][6];
 
     if (!c || !rt || !m || !s) {
         printf("searchcand: invalid params\n");
         return 0;
     }
 
-    snprintf(file, sizeof(file), INPUTFILE, c[0], c[1]);
-
-    fd = open(file, O_RDONLY);
-    if (fd <= 0) {
-        printf("cannot open table file %s\n", file);
-        exit(1);
-    }
-
-    if (fstat(fd, &filestat)) {
-        printf("cannot stat file %s\n", file);
+    int found = ht2table_lookup(c, states, HT2TABLE_MAX_MATCHES);
+    if (found < 0) {
         exit(1);
     }
 
-    data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (data == MAP_FAILED) {
-        printf("cannot mmap file %s\n", file);
-        exit(1);
-    }
-
-    memcpy(item, c + 2, 4);
-
-    found = (unsigned char *)bsearch(item, data, filestat.st_size / DATASIZE, DATASIZE, datacmp);
-
-    if (found) {
-
-        // our candidate is in the table
-        // go backwards and see if there are other matches
-        while (((found - data) >= DATASIZE) && (!memcmp(found - DATASIZE, item, 4))) {
-            found = found - DATASIZE;
-        }
-
-        // now test all matches
-        while (((found - data) <= (filestat.st_size - DATASIZE)) && (!memcmp(found, item, 4))) {
-            if (testcand(found, rt, fwd)) {
-                memcpy(m, c, 2);
-                memcpy(m + 2, found, 4);
-                memcpy(s, found + 4, 6);
-
-                munmap(data, filestat.st_size);
-                close(fd);
-                return 1;
-            }
-
-            found = found + DATASIZE;
+    // our candidate is in the table, test all matches
+    for (int i = 0; i < found; i++) {
+        if (testcand(states[i], rt, fwd)) {
+            memcpy(m, c, 6);
+            memcpy(s, states[i], 6);
+            return 1;
         }
     }
 
-    munmap(data, filestat.st_size);
-    close(fd);
-
     return 0;
-
 }
 
 static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset) {
@@ -0,0 +1,254 @@
+/*
+ * ht2crack2table.c
+ * writes and searches the compressed ht2crack2 table files, see ht2crack2table.h
+ */
+
+#include "ht2crack2table.h"
+#include <stdio.h>
+
+static uint32_t be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+int ht2table_write(const char *path, const uint8_t *raw, uint64_t entries) {
+    char tmppath[256];
+    uint64_t nblocks = (entries + HT2TABLE_BLOCK_ENTRIES - 1) / HT2TABLE_BLOCK_ENTRIES;
+    size_t hdrlen = sizeof(ht2table_hdr_t) + (nblocks * sizeof(ht2table_idx_t));
+
+    // worst case, a 5 byte varint for every entry
+    uint8_t *buf = (uint8_t *)calloc(1, hdrlen + (entries * (5 + 6)));
+    if (!buf) {
+        printf("ht2table_write: cannot calloc\n");
+        return -1;
+    }
+
+    ht2table_hdr_t *hdr = (ht2table_hdr_t *)buf;
+    ht2table_idx_t *idx = (ht2table_idx_t *)(buf + sizeof(ht2table_hdr_t));
+    uint8_t *blocks = buf + hdrlen;
+    uint8_t *p = blocks;
+    uint32_t prev = 0;
+
+    memcpy(hdr->magic, HT2TABLE_MAGIC, sizeof(hdr->magic));
+    hdr->version = HT2TABLE_VERSION;
+    hdr->block_entries = HT2TABLE_BLOCK_ENTRIES;
+    hdr->nblocks = nblocks;
+    hdr->entries = entries;
+
+    for (uint64_t i = 0; i < entries; i++) {
+        const uint8_t *e = raw + (i * HT2TABLE_ENTRY_SIZE);
+        uint32_t ks = be32(e);
+
+        if ((i % HT2TABLE_BLOCK_ENTRIES) == 0) {
+            idx[i / HT2TABLE_BLOCK_ENTRIES].ks = ks;
+            idx[i / HT2TABLE_BLOCK_ENTRIES].offset = p - blocks;
+            prev = ks;
+        }
+
+        if (ks < prev) {
+            printf("ht2table_write: entries for %s are not sorted\n", path);
+            free(buf);
+            return -1;
+        }
+
+        // keystream delta as LEB128 varint
+        uint32_t delta = ks - prev;
+        do {
+            uint8_t b = delta & 0x7f;
+            delta >>= 7;
+            *p++ = b | (delta ? 0x80 : 0);
+        } while (delta);
+
+        memcpy(p, e + 4, 6);
+        p += 6;
+        prev = ks;
+    }
+
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+
+    int fd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("ht2table_write: cannot create %s\n", tmppath);
+        free(buf);
+        return -1;
+    }
+
+    size_t len = p - buf;
+    if (write(fd, buf, len) != (ssize_t)len) {
+        printf("ht2table_write: cannot write all of the data to %s\n", tmppath);
+        close(fd);
+        free(buf);
+        return -1;
+    }
+    close(fd);
+    free(buf);
+
+    if (rename(tmppath, path)) {
+        printf("ht2table_write: cannot rename %s\n", tmppath);
+        return -1;
+    }
+    return 0;
+}
+
+static uint8_t *map_table(const char *path, size_t *size, int *fd) {
+    struct stat filestat;
+
+    *fd = open(path, O_RDONLY);
+    if (*fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(*fd, &filestat)) {
+        printf("cannot stat file %s\n", path);
+        close(*fd);
+        return NULL;
+    }
+
+    *size = filestat.st_size;
+    if (*size == 0) {
+        // empty raw table, nothing to map
+        return (uint8_t *)"";
+    }
+
+    uint8_t *data = mmap((caddr_t)0, *size, PROT_READ, MAP_PRIVATE, *fd, 0);
+    if (data == MAP_FAILED) {
+        printf("cannot mmap file %s\n", path);
+        close(*fd);
+        return NULL;
+    }
+
+#ifdef MADV_RANDOM
+    // we only read a few pages of it, readahead would be wasted
+    madvise(data, *size, MADV_RANDOM);
+#endif
+    return data;
+}
+
+static void unmap_table(uint8_t *data, size_t size, int fd) {
+    if (size) {
+        munmap(data, size);
+    }
+    close(fd);
+}
+
+static int lookup_raw(const uint8_t *data, size_t size, uint32_t target, uint8_t states[][6], int max) {
+    uint64_t lo = 0;
+    uint64_t hi = size / HT2TABLE_ENTRY_SIZE;
+    int found = 0;
+
+    // first entry not below the target
+    while (lo < hi) {
+        uint64_t mid = lo + ((hi - lo) / 2);
+        if (be32(data + (mid * HT2TABLE_ENTRY_SIZE)) < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (; (lo < (size / HT2TABLE_ENTRY_SIZE)) && (found < max); lo++) {
+        const uint8_t *e = data + (lo * HT2TABLE_ENTRY_SIZE);
+        if (be32(e) != target) {
+            break;
+        }
+        memcpy(states[found++], e + 4, 6);
+    }
+    return found;
+}
+
+static int lookup_compressed(const char *path, const uint8_t *data, size_t size, uint32_t target, uint8_t states[][6], int max) {
+    const ht2table_hdr_t *hdr = (const ht2table_hdr_t *)data;
+
+    if ((size < sizeof(ht2table_hdr_t)) || memcmp(hdr->magic, HT2TABLE_MAGIC, sizeof(hdr->magic)) ||
+            (hdr->version != HT2TABLE_VERSION) || (hdr->block_entries == 0) ||
+            (size < sizeof(ht2table_hdr_t) + ((uint64_t)hdr->nblocks * sizeof(ht2table_idx_t)))) {
+        printf("%s is not a valid table file\n", path);
+        return -1;
+    }
+
+    const ht2table_idx_t *idx = (const ht2table_idx_t *)(data + sizeof(ht2table_hdr_t));
+    const uint8_t *blocks = (const uint8_t *)(idx + hdr->nblocks);
+    const uint8_t *end = data + size;
+    uint32_t lo = 0;
+    uint32_t hi = hdr->nblocks;
+    int found = 0;
+
+    // first block starting at or above the target, matches can begin at the end of the one before
+    while (lo < hi) {
+        uint32_t mid = lo + ((hi - lo) / 2);
+        if (idx[mid].ks < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (uint32_t b = (lo ? lo - 1 : 0); b < hdr->nblocks; b++) {
+        if (idx[b].ks > target) {
+            break;
+        }
+
+        uint64_t n = hdr->block_entries;
+        if (b == hdr->nblocks - 1) {
+            n = hdr->entries - ((uint64_t)b * hdr->block_entries);
+        }
+
+        const uint8_t *p = blocks + idx[b].offset;
+        uint32_t ks = idx[b].ks;
+
+        for (uint64_t i = 0; i < n; i++) {
+            uint32_t delta = 0;
+            int shift = 0;
+            do {
+                if ((p >= end) || (shift > 28)) {
+                    printf("%s is corrupt\n", path);
+                    return -1;
+                }
+                delta |= (uint32_t)(*p & 0x7f) << shift;
+                shift += 7;
+            } while (*p++ & 0x80);
+
+            if (p + 6 > end) {
+                printf("%s is corrupt\n", path);
+                return -1;
+            }
+
+            ks += delta;
+            if (ks > target) {
+                return found;
+            }
+
+            if ((ks == target) && (found < max)) {
+                memcpy(states[found++], p, 6);
+            }
+            p += 6;
+        }
+    }
+    return found;
+}
+
+int ht2table_lookup(const uint8_t *cand, uint8_t states[][6], int max) {
+    char file[64];
+    size_t size = 0;
+    int fd = -1;
+    int res;
+    uint32_t target = be32(cand + 2);
+
+    snprintf(file, sizeof(file), HT2TABLE_FILE, cand[0], cand[1]);
+    uint8_t *data = map_table(file, &size, &fd);
+    if (data) {
+        res = lookup_compressed(file, data, size, target, states, max);
+        unmap_table(data, size, fd);
+        return res;
+    }
+
+    // not converted yet
+    snprintf(file, sizeof(file), HT2TABLE_RAWFILE, cand[0], cand[1]);
+    data = map_table(file, &size, &fd);
+    if (data == NULL) {
+        printf("cannot open table file %s\n", file);
+        return -1;
+    }
+    res = lookup_raw(data, size, target, states, max);
+    unmap_table(data, size, fd);
+    return res;
+}
@@ -0,0 +1,58 @@
+/*
+ * ht2crack2table.h
+ * compressed on-disk format of the sorted ht2crack2 table files
+ */
+
+#ifndef HT2CRACK2TABLE_H
+#define HT2CRACK2TABLE_H
+
+#include "ht2crackutils.h"
+
+// Every table file holds the entries whose first two bytes of keystream are the
+// ones in its path, an entry is the other 4 bytes of keystream + 6 bytes of PRNG state.
+//
+// sorted/xx/yy.bin   raw entries, 10 bytes each, sorted
+// sorted/xx/yy.ht2   compressed:
+//   header   ht2table_hdr_t
+//   index    nblocks x ht2table_idx_t, the first keystream word of each block and
+//            where the block starts (from the end of the index)
+//   blocks   HT2TABLE_BLOCK_ENTRIES entries each (the last one may hold fewer).
+//            An entry is the keystream word as a LEB128 varint delta to the entry
+//            before it (the first one of a block to its index word) and the 6 byte state.
+//
+// Header and index are in host byte order. A lookup binary searches the index and
+// decodes one block, so only a few pages of the mmap'd file are touched.
+#define HT2TABLE_DIR            "sorted"
+#define HT2TABLE_RAWFILE        HT2TABLE_DIR "/%02x/%02x.bin"
+#define HT2TABLE_FILE           HT2TABLE_DIR "/%02x/%02x.ht2"
+#define HT2TABLE_MAGIC          "HT2T"
+#define HT2TABLE_VERSION        1
+#define HT2TABLE_BLOCK_ENTRIES  256
+#define HT2TABLE_ENTRY_SIZE     10
+#define HT2TABLE_MAX_MATCHES    16
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t block_entries;
+    uint32_t nblocks;
+    uint64_t entries;
+} ht2table_hdr_t;
+
+typedef struct {
+    uint32_t ks;
+    uint32_t offset;
+} ht2table_idx_t;
+
+// Compress 'entries' sorted raw entries into a table file at 'path'.
+// Written to path.tmp first and renamed, so the file is either complete or missing.
+// Returns 0 on success, -1 on error.
+int ht2table_write(const char *path, const uint8_t *raw, uint64_t entries);
+
+// Look up the 6 bytes of candidate keystream in the table files under sorted/.
+// Uses the compressed file, or the raw one if there is no compressed file yet.
+// Copies up to 'max' matching PRNG states to 'states' and returns how many it
+// copied, -1 when no table file can be read.
+int ht2table_lookup(const uint8_t *cand, uint8_t states[][6], int max);
+
+#endif /* HT2CRACK2TABLE_H */
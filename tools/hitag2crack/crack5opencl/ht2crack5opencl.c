@@ -143,14 +143,19 @@ static void usage(char *name) {
            "-P     : select the Profile, from 0 to 10. [Default: auto-tuning]\n"
            "-F     : force verify key with OpenCL instead of CPU. [Default: disabled]\n"
            "-Q     : select queue engine. 0: forward, 1: reverse, 2: random. [Default: 0]\n"
+           "-W     : share the slices with other instances through a work file, on one host or a shared filesystem. [Default: disabled]\n"
+           "-L     : seconds before a slice claimed in the work file by an instance gone silent is handed out again. [Default: %u]\n"
            "-s     : show the list of OpenCL platforms/devices, then exit\n"
            "-V     : enable debug messages\n"
            "-v     : show the version\n"
-           "-h     : show this help\n\n", name);
+           "-h     : show this help\n\n", name, WU_FILE_LEASE);
 
     printf("Example, select devices 1, 2 and 3 using platform 1 and 2, with random queue engine:\n\n"
            "%s -D 2 -Q 2 -p 1,2 -d 1,2,3 2ab12bf2 4B71E49D 6A606453 D79BD94B 16A2255B\n\n", name);
 
+    printf("Example, split the search between hosts, run the same command on each of them:\n\n"
+           "%s -W /mnt/shared/2ab12bf2.wu 2ab12bf2 4B71E49D 6A606453 D79BD94B 16A2255B\n\n", name);
+
     exit(8);
 }
 
@@ -209,13 +214,15 @@ int main(int argc, char **argv) {
     unsigned int thread_scheduler_type_selected = THREAD_TYPE_ASYNC;
     unsigned int profile_selected = 2;
     unsigned int queue_type = 0;
+    char *work_file = NULL;
+    unsigned int work_lease = WU_FILE_LEASE;
 
     uint32_t **matches_found = NULL;
     uint64_t **matches = NULL;
 
     int opt;
 
-    while ((opt = getopt(argc, argv, "p:d:D:S:P:F:Q:svVh")) != -1) {
+    while ((opt = getopt(argc, argv, "p:d:D:S:P:F:Q:W:L:svVh")) != -1) {
         switch (opt) {
             case 'p':
                 // 1, 2, 3, etc ..
@@ -255,6 +262,16 @@ int main(int argc, char **argv) {
                     usage(argv[0]);
                 }
                 break;
+            case 'W':
+                work_file = optarg;
+                break;
+            case 'L':
+                work_lease = (unsigned int) strtoul(optarg, NULL, 10);
+                if (work_lease == 0) {
+                    printf("Error: invalid LEASE argument (seconds, greater than 0)\n");
+                    usage(argv[0]);
+                }
+                break;
             case 's':
                 show = true;
                 break;
@@ -912,6 +929,36 @@ int main(int argc, char **argv) {
     // setup, phase 2 (select lower profile)
     unsigned int profile = get_smallest_profile(cd_ctx, ocl_platform_cnt);
 
+    // the work file fixes the profile for every instance sharing it, the slices must match
+    wu_file_ctx_t work_ctx;
+    memset(&work_ctx, 0, sizeof(wu_file_ctx_t));
+    work_ctx.fd = -1;
+
+    if (work_file) {
+        const uint32_t params[5] = { uid, nR1, aR1, nR2, aR2 };
+        int wf_ret = wu_file_open(&work_ctx, work_file, params, profile, profiles[profile][0], work_lease);
+        if (wf_ret == NO_ERROR && work_ctx.profile > 10) wf_ret = ERROR_FILE_INVALID;
+
+        if (wf_ret != NO_ERROR) {
+            if (wf_ret == ERROR_FILE_MISMATCH) {
+                printf("Error: work file '%s' belongs to another search\n", work_file);
+            } else {
+                printf("Error: wu_file_open(%s) failed (%d): %s\n", work_file, wf_ret, wu_queue_strerror(wf_ret));
+            }
+            z = selected_devices_cnt - 1;
+            MEMORY_FREE_OPENCL(ctx, z)
+            MEMORY_FREE_LIST_Z(matches, z)
+            MEMORY_FREE_LIST_Z(matches_found, z)
+            MEMORY_FREE_ALL
+            exit(2);
+        }
+
+        if (work_ctx.profile != profile) {
+            printf("Notice: using profile %u of the work file instead of %u\n", work_ctx.profile, profile);
+            profile = work_ctx.profile;
+        }
+    }
+
     // setup, phase 3 (finis him)
 
     // z is device counter, dolphin buggy counter as well
@@ -1119,8 +1166,13 @@ int main(int argc, char **argv) {
     printf("[queue] Fill queue with pre-calculated offset using profile (%d): ", profile);
 #endif
 
-    for (size_t step = 0; step < max_step; step++) {
-        wu_queue_push(&ctx.queue_ctx, step, step << chunk, max_step);
+    if (work_file) {
+        // claimed on demand from the file, nothing to queue up front
+        wu_queue_attach_file(&ctx.queue_ctx, &work_ctx, chunk);
+    } else {
+        for (size_t step = 0; step < max_step; step++) {
+            wu_queue_push(&ctx.queue_ctx, step, step << chunk, max_step);
+        }
     }
 
 #if DEBUGME > 0
@@ -1209,6 +1261,7 @@ int main(int argc, char **argv) {
     bool found = false;
     bool error = false;
     bool show_overall_time = true;
+    bool work_pending = false;
 
     struct timeval cpu_t_start, cpu_t_end, cpu_t_result;
 
@@ -1243,6 +1296,9 @@ int main(int argc, char **argv) {
 
         if (t_arg[y].r) {
 
+            // stops the other instances
+            if (work_file) wu_file_set_key(&work_ctx, t_arg[y].key);
+
             if (verbose) {
                 printf("\n");
             }
@@ -1275,10 +1331,31 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (found == false && error == false && work_file) {
+        uint64_t key = 0;
+        size_t done = 0, claimed = 0;
+
+        if (wu_file_get_key(&work_ctx, &key)) {
+            found = true;
+
+            printf("\nKey found by another instance [ \x1b[32m");
+            for (int i = 0; i < 6; i++) {
+                printf("%02X", (uint8_t)(key & 0xff));
+                key = key >> 8;
+            }
+            printf(AEND " ]\n");
+            fflush(stdout);
+        } else if (wu_file_count(&work_ctx, &done, &claimed) == NO_ERROR && done < max_step) {
+            // nothing left for us, but not all of the keyspace is searched yet
+            printf("\nNo free slice left, %zu/%u slice(s) done, %zu still claimed by other instances\n", done, max_step, claimed);
+            work_pending = true;
+        }
+    }
+
     if (found == false) {
         if (error) {
             printf("\nSomething went wrong ( " _RED_("fail") " )\n");
-        } else {
+        } else if (work_pending == false) {
             printf("\nExhausted keyspace ( " _RED_("fail") " )\n");
         }
     }
@@ -1326,6 +1403,8 @@ int main(int argc, char **argv) {
 #endif
     }
 
+    if (work_file) wu_file_close(&work_ctx);
+
     z = selected_devices_cnt - 1;
     MEMORY_FREE_OPENCL(ctx, z)
     MEMORY_FREE_LIST_Z(matches, z)
@@ -146,6 +146,14 @@ const char *wu_queue_strerror(int error) {
             return (const char *) "ERROR_MUTEX_INIT";
         case ERROR_ALLOC:
             return (const char *) "ERROR_ALLOC";
+        case ERROR_FILE_IO:
+            return (const char *) "ERROR_FILE_IO";
+        case ERROR_FILE_INVALID:
+            return (const char *) "ERROR_FILE_INVALID";
+        case ERROR_FILE_MISMATCH:
+            return (const char *) "ERROR_FILE_MISMATCH";
+        case ERROR_FILE_UNSUPPORTED:
+            return (const char *) "ERROR_FILE_UNSUPPORTED";
         case ERROR_UNDEFINED:
         default:
             return (const char *) "ERROR_UNDEFINED";
@@ -225,6 +233,8 @@ int wu_queue_done(wu_queue_ctx_t *ctx) {
     if (!ctx) return ERROR_CTX_NULL;
     if (!ctx->init) return ERROR_CTX_IS_NOT_INIT;
 
+    if (ctx->file) return wu_file_pending(ctx->file);
+
     switch (ctx->queue_type) {
         case QUEUE_TYPE_RANDOM:
             return (ctx->queue_head == NULL);
@@ -293,6 +303,17 @@ int wu_queue_pop(wu_queue_ctx_t *ctx, wu_queue_data_t *wu, short remove) {
     int rnd = 0;
     wu_queue_item_t *ptr = 0, *ptrPrev = 0;
 
+    if (ctx->file && !remove) {
+        size_t id = 0, rem = 0;
+        if ((ret = wu_file_claim(ctx->file, (short) ctx->queue_type, &id, &rem)) != NO_ERROR) return ret;
+
+        wu->id = id;
+        wu->off = id << ctx->file_chunk;
+        wu->max = ctx->file->max_step;
+        wu->rem = rem;
+        return NO_ERROR;
+    }
+
     pthread_mutex_lock(&ctx->queue_mutex);
 
     if ((ret = wu_queue_done(ctx)) != 0) {
@@ -362,6 +383,25 @@ int wu_queue_pop(wu_queue_ctx_t *ctx, wu_queue_data_t *wu, short remove) {
     return NO_ERROR;
 }
 
+int wu_queue_attach_file(wu_queue_ctx_t *ctx, wu_file_ctx_t *file, size_t chunk) {
+    if (!ctx) return ERROR_CTX_NULL;
+    if (!ctx->init) return ERROR_CTX_IS_NOT_INIT;
+
+    ctx->file = file;
+    ctx->file_chunk = chunk;
+    return NO_ERROR;
+}
+
+int wu_queue_finish(wu_queue_ctx_t *ctx, size_t id) {
+    if (!ctx) return ERROR_CTX_NULL;
+    if (!ctx->init) return ERROR_CTX_IS_NOT_INIT;
+
+    // a popped local work unit is already gone
+    if (!ctx->file) return NO_ERROR;
+
+    return wu_file_finish(ctx->file, id);
+}
+
 int wu_queue_destroy(wu_queue_ctx_t *ctx) {
 #if TEST_UNIT == 1
     fprintf(stdout, "[%s] enter\n", __func__);
@@ -373,6 +413,9 @@ int wu_queue_destroy(wu_queue_ctx_t *ctx) {
 
     int ret = -1;
 
+    // the work file outlives us, only unload the local queue
+    ctx->file = NULL;
+
     // unload the queue
     while ((ret = wu_queue_pop(ctx, 0, 1)) == 0) {};
 
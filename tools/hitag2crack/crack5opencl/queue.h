@@ -41,6 +41,8 @@ License: GNU General Public License v3 or any later version (see LICENSE.txt)
 #include <string.h>
 #include <pthread.h>
 
+#include "workfile.h"
+
 // enum errors
 typedef enum wu_queue_error {
     QUEUE_EMPTY = 1,
@@ -54,7 +56,11 @@ typedef enum wu_queue_error {
     ERROR_MUTEXATTR_SETTYPE = -7,
     ERROR_MUTEX_INIT = -8,
     ERROR_ALLOC = -9,
-    ERROR_UNDEFINED = -10
+    ERROR_UNDEFINED = -10,
+    ERROR_FILE_IO = -11,
+    ERROR_FILE_INVALID = -12,
+    ERROR_FILE_MISMATCH = -13,
+    ERROR_FILE_UNSUPPORTED = -14
 
 } wu_queue_error_t;
 
@@ -98,6 +104,10 @@ typedef struct wu_queue_ctx {
     unsigned char pad1[4];
     pthread_mutex_t queue_mutex;
 
+    // set, the work units come from a work file shared with other instances
+    wu_file_ctx_t *file;
+    size_t file_chunk;
+
 } wu_queue_ctx_t;
 
 // exports
@@ -106,6 +116,8 @@ int wu_queue_done(wu_queue_ctx_t *ctx);
 int wu_queue_push(wu_queue_ctx_t *ctx, size_t id, size_t off, size_t max);
 int wu_queue_pop(wu_queue_ctx_t *ctx, wu_queue_data_t *wu, short remove);
 int wu_queue_destroy(wu_queue_ctx_t *ctx);
+int wu_queue_attach_file(wu_queue_ctx_t *ctx, wu_file_ctx_t *file, size_t chunk);
+int wu_queue_finish(wu_queue_ctx_t *ctx, size_t id);
 
 const char *wu_queue_strdesc(wu_queue_type_t type);
 const char *wu_queue_strerror(int error);
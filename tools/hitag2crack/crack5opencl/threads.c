@@ -184,8 +184,8 @@ int thread_start_scheduler(thread_ctx_t *ctx, thread_args_t *t_arg, wu_queue_ctx
 
     if (ctx->type == THREAD_TYPE_SEQ) {
         bool error = false;
-        uint32_t slice = 0;
-        for (slice = 0; slice < t_arg[0].max_slices; slice += ctx->thread_count) {
+        // one work unit per device and round, until the queue (or the shared work file) runs dry
+        while (wu_queue_done(queue_ctx) == NO_ERROR) {
             int err = 0;
 
             if ((err = thread_start(ctx, t_arg)) != 0) {
@@ -504,8 +504,15 @@ void *computing_process(void *arg) {
 
     opencl_ctx_t *ctx = a->ocl_ctx;
 
+    a->r = false;
+    a->err = false;
+
     wu_queue_data_t wu;
-    wu_queue_pop(&ctx->queue_ctx, &wu, false);
+    int q_ret = wu_queue_pop(&ctx->queue_ctx, &wu, false);
+    if (q_ret != NO_ERROR) { // drained by the other devices, or by another instance
+        if (q_ret < 0) a->err = true;
+        pthread_exit(NULL);
+    }
     off = wu.off;
     a->slice = wu.id + 1;
 
@@ -528,11 +535,9 @@ void *computing_process(void *arg) {
 
     int ret = runKernel(ctx, (uint32_t) off, matches, matches_found, z);
 
-    a->r = false;
-    a->err = false;
-
     if (ret < 1) { // error or nada
         if (ret == -1) a->err = true;
+        else wu_queue_finish(&ctx->queue_ctx, wu.id);
         pthread_exit(NULL);
     }
 
@@ -546,6 +551,8 @@ void *computing_process(void *arg) {
             a->r = try_state(matches[match], uid, aR2, nR1, nR2, &a->key);
             if (a->r) break;
         }
+
+        if (!a->r) wu_queue_finish(&ctx->queue_ctx, wu.id);
     } else {
         // the OpenCL kernel return only one key if found, else nothing
 
@@ -580,8 +587,6 @@ void *computing_process_async(void *arg) {
     uint32_t nR1 = a->nR1;
     uint32_t nR2 = a->nR2;
 
-    size_t max_slices = a->max_slices;
-
     opencl_ctx_t *ctx = a->ocl_ctx;
 
     pthread_mutex_unlock(&a->thread_ctx->thread_mutexs[z]);
@@ -660,7 +665,20 @@ void *computing_process_async(void *arg) {
 #endif
 
             wu_queue_data_t wu;
-            wu_queue_pop(&ctx->queue_ctx, &wu, false);
+            if (wu_queue_pop(&ctx->queue_ctx, &wu, false) != NO_ERROR) {
+                // another instance sharing the work file took the last one, or found the key
+                pthread_mutex_lock(&a->thread_ctx->thread_mutexs[z]);
+                status = a->status = TH_END;
+                pthread_mutex_unlock(&a->thread_ctx->thread_mutexs[z]);
+
+                if (a->thread_ctx->enable_condusleep) {
+                    pthread_mutex_lock(&a->thread_ctx->thread_mutex_usleep);
+                    pthread_cond_signal(&a->thread_ctx->thread_cond_usleep);  // unlock master/TH_PROCESSING cond
+                    pthread_mutex_unlock(&a->thread_ctx->thread_mutex_usleep);
+                }
+
+                pthread_exit(NULL);
+            }
             uint32_t off = wu.off;
             a->slice = wu.id + 1;
 
@@ -713,12 +731,12 @@ void *computing_process_async(void *arg) {
                 printf("[%s][%zu] master, process is done but no candidates found\n", __func__, z);
                 fflush(stdout);
 #endif
-                pthread_mutex_lock(&a->thread_ctx->thread_mutexs[z]);
+                wu_queue_finish(&ctx->queue_ctx, wu.id);
 
-                if (a->slice >= max_slices) a->status = TH_END;
-                else a->status = TH_WAIT;
+                pthread_mutex_lock(&a->thread_ctx->thread_mutexs[z]);
 
-                status = a->status;
+                // the master ends us once the queue is empty, whatever order the slices came in
+                status = a->status = TH_WAIT;
 
                 pthread_mutex_unlock(&a->thread_ctx->thread_mutexs[z]);
 
@@ -814,6 +832,8 @@ void *computing_process_async(void *arg) {
                     pthread_exit(NULL);
                 }
 
+                wu_queue_finish(&ctx->queue_ctx, wu.id);
+
                 // setting internal status to wait
                 status = TH_WAIT;
                 continue;
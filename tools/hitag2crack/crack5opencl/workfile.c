@@ -0,0 +1,381 @@
+/****************************************************************************
+
+Work units shared between ht2crack5opencl instances, through a file
+
+License: GNU General Public License v3 or any later version (see LICENSE.txt)
+
+*****************************************************************************
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include "queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if !defined(_WIN32)
+
+static int wu_file_lock(wu_file_ctx_t *ctx, short type) {
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+
+    // whole file
+    while (fcntl(ctx->fd, F_SETLKW, &fl) == -1) {
+        if (errno != EINTR) return ERROR_FILE_IO;
+    }
+    return NO_ERROR;
+}
+
+static bool wu_file_rw(int fd, void *buf, size_t len, off_t off, bool wr) {
+    uint8_t *p = (uint8_t *) buf;
+    while (len) {
+        ssize_t n = (wr) ? pwrite(fd, p, len, off) : pread(fd, p, len, off);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        off += n;
+        len -= (size_t) n;
+    }
+    return true;
+}
+
+// takes the process mutex and the file lock, reads header and slices
+static int wu_file_enter(wu_file_ctx_t *ctx, wu_file_hdr_t *hdr, short type) {
+    pthread_mutex_lock(&ctx->mutex);
+
+    if (wu_file_lock(ctx, type) != NO_ERROR) {
+        pthread_mutex_unlock(&ctx->mutex);
+        return ERROR_FILE_IO;
+    }
+
+    if (!wu_file_rw(ctx->fd, hdr, sizeof(wu_file_hdr_t), 0, false) ||
+            !wu_file_rw(ctx->fd, ctx->slices, ctx->max_step * sizeof(wu_file_slice_t), sizeof(wu_file_hdr_t), false)) {
+        wu_file_lock(ctx, F_UNLCK);
+        pthread_mutex_unlock(&ctx->mutex);
+        return ERROR_FILE_IO;
+    }
+
+    return NO_ERROR;
+}
+
+static void wu_file_leave(wu_file_ctx_t *ctx) {
+    wu_file_lock(ctx, F_UNLCK);
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+static bool wu_file_claimable(const wu_file_ctx_t *ctx, size_t id, uint32_t now) {
+    const wu_file_slice_t *s = &ctx->slices[id];
+
+    if (s->state == WU_SLICE_FREE) return true;
+
+    // the instance holding it went quiet
+    return (s->state == WU_SLICE_CLAIMED && (now - s->stamp) >= ctx->lease);
+}
+
+int wu_file_open(wu_file_ctx_t *ctx, const char *path, const uint32_t *params, uint32_t profile, uint32_t max_step, uint32_t lease) {
+    if (!ctx) return ERROR_CTX_NULL;
+
+    memset(ctx, 0, sizeof(wu_file_ctx_t));
+    ctx->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (ctx->fd < 0) return ERROR_FILE_IO;
+
+    ctx->lease = lease;
+
+    if (pthread_mutex_init(&ctx->mutex, NULL) != 0) {
+        close(ctx->fd);
+        return ERROR_MUTEX_INIT;
+    }
+
+    pthread_mutex_lock(&ctx->mutex);
+
+    int ret = wu_file_lock(ctx, F_WRLCK);
+    if (ret != NO_ERROR) goto out;
+
+    struct stat st;
+    if (fstat(ctx->fd, &st) != 0) {
+        ret = ERROR_FILE_IO;
+        goto unlock;
+    }
+
+    wu_file_hdr_t hdr;
+
+    if (st.st_size == 0) {
+        // first instance, lay out the search
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, WU_FILE_MAGIC, sizeof(hdr.magic));
+        hdr.version = WU_FILE_VERSION;
+        memcpy(hdr.params, params, sizeof(hdr.params));
+        hdr.profile = profile;
+        hdr.max_step = max_step;
+
+        ctx->slices = (wu_file_slice_t *) calloc(max_step, sizeof(wu_file_slice_t));
+        if (!ctx->slices) {
+            ret = ERROR_ALLOC;
+            goto unlock;
+        }
+
+        if (!wu_file_rw(ctx->fd, ctx->slices, max_step * sizeof(wu_file_slice_t), sizeof(hdr), true) ||
+                !wu_file_rw(ctx->fd, &hdr, sizeof(hdr), 0, true)) {
+            ret = ERROR_FILE_IO;
+            goto unlock;
+        }
+    } else {
+        if (!wu_file_rw(ctx->fd, &hdr, sizeof(hdr), 0, false) ||
+                memcmp(hdr.magic, WU_FILE_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != WU_FILE_VERSION ||
+                hdr.max_step == 0 || (off_t)(sizeof(hdr) + (hdr.max_step * sizeof(wu_file_slice_t))) != st.st_size) {
+            ret = ERROR_FILE_INVALID;
+            goto unlock;
+        }
+
+        if (memcmp(hdr.params, params, sizeof(hdr.params)) != 0) {
+            ret = ERROR_FILE_MISMATCH;
+            goto unlock;
+        }
+
+        ctx->slices = (wu_file_slice_t *) calloc(hdr.max_step, sizeof(wu_file_slice_t));
+        if (!ctx->slices) {
+            ret = ERROR_ALLOC;
+            goto unlock;
+        }
+    }
+
+    ctx->profile = hdr.profile;
+    ctx->max_step = hdr.max_step;
+    ret = NO_ERROR;
+
+unlock:
+    wu_file_lock(ctx, F_UNLCK);
+out:
+    pthread_mutex_unlock(&ctx->mutex);
+
+    if (ret != NO_ERROR) {
+        free(ctx->slices);
+        pthread_mutex_destroy(&ctx->mutex);
+        close(ctx->fd);
+        memset(ctx, 0, sizeof(wu_file_ctx_t));
+        ctx->fd = -1;
+    }
+    return ret;
+}
+
+int wu_file_close(wu_file_ctx_t *ctx) {
+    if (!ctx) return ERROR_CTX_NULL;
+    if (ctx->fd < 0) return ERROR_CTX_IS_NOT_INIT;
+
+    free(ctx->slices);
+    pthread_mutex_destroy(&ctx->mutex);
+    close(ctx->fd);
+    memset(ctx, 0, sizeof(wu_file_ctx_t));
+    ctx->fd = -1;
+    return NO_ERROR;
+}
+
+int wu_file_pending(wu_file_ctx_t *ctx) {
+    wu_file_hdr_t hdr;
+    int ret = wu_file_enter(ctx, &hdr, F_RDLCK);
+    if (ret != NO_ERROR) return ret;
+
+    ret = QUEUE_EMPTY;
+    if (!hdr.found) {
+        uint32_t now = (uint32_t) time(NULL);
+        for (size_t id = 0; id < ctx->max_step; id++) {
+            if (wu_file_claimable(ctx, id, now)) {
+                ret = NO_ERROR;
+                break;
+            }
+        }
+    }
+
+    wu_file_leave(ctx);
+    return ret;
+}
+
+int wu_file_claim(wu_file_ctx_t *ctx, short queue_type, size_t *id, size_t *rem) {
+    wu_file_hdr_t hdr;
+    int ret = wu_file_enter(ctx, &hdr, F_WRLCK);
+    if (ret != NO_ERROR) return ret;
+
+    if (hdr.found) {
+        wu_file_leave(ctx);
+        return QUEUE_EMPTY;
+    }
+
+    uint32_t now = (uint32_t) time(NULL);
+    size_t free_cnt = 0;
+    size_t expired_cnt = 0;
+    size_t pick = ctx->max_step;
+
+    for (size_t i = 0; i < ctx->max_step; i++) {
+        if (ctx->slices[i].state == WU_SLICE_FREE) free_cnt++;
+        else if (wu_file_claimable(ctx, i, now)) expired_cnt++;
+    }
+
+    // fresh slices in queue order first, expired leases once they ran out
+    size_t cnt = (free_cnt) ? free_cnt : expired_cnt;
+    if (cnt == 0) {
+        wu_file_leave(ctx);
+        return QUEUE_EMPTY;
+    }
+
+    size_t nth = 0;
+    if (queue_type == QUEUE_TYPE_REVERSE) nth = cnt - 1;
+    else if (queue_type == QUEUE_TYPE_RANDOM) nth = (size_t) rand() % cnt;
+
+    for (size_t i = 0; i < ctx->max_step; i++) {
+        bool match = (free_cnt) ? (ctx->slices[i].state == WU_SLICE_FREE) : wu_file_claimable(ctx, i, now);
+        if (match && nth-- == 0) {
+            pick = i;
+            break;
+        }
+    }
+
+    ctx->slices[pick].state = WU_SLICE_CLAIMED;
+    ctx->slices[pick].stamp = now;
+
+    if (!wu_file_rw(ctx->fd, &ctx->slices[pick], sizeof(wu_file_slice_t), sizeof(wu_file_hdr_t) + (pick * sizeof(wu_file_slice_t)), true)) {
+        wu_file_leave(ctx);
+        return ERROR_FILE_IO;
+    }
+
+    wu_file_leave(ctx);
+
+    *id = pick;
+    if (rem) *rem = (free_cnt) ? free_cnt - 1 : 0;
+    return NO_ERROR;
+}
+
+int wu_file_finish(wu_file_ctx_t *ctx, size_t id) {
+    if (id >= ctx->max_step) return ERROR_GENERIC;
+
+    wu_file_hdr_t hdr;
+    int ret = wu_file_enter(ctx, &hdr, F_WRLCK);
+    if (ret != NO_ERROR) return ret;
+
+    ctx->slices[id].state = WU_SLICE_DONE;
+    if (!wu_file_rw(ctx->fd, &ctx->slices[id], sizeof(wu_file_slice_t), sizeof(wu_file_hdr_t) + (id * sizeof(wu_file_slice_t)), true)) {
+        ret = ERROR_FILE_IO;
+    }
+
+    wu_file_leave(ctx);
+    return ret;
+}
+
+int wu_file_set_key(wu_file_ctx_t *ctx, uint64_t key) {
+    wu_file_hdr_t hdr;
+    int ret = wu_file_enter(ctx, &hdr, F_WRLCK);
+    if (ret != NO_ERROR) return ret;
+
+    hdr.found = 1;
+    hdr.key = key;
+    if (!wu_file_rw(ctx->fd, &hdr, sizeof(hdr), 0, true)) {
+        ret = ERROR_FILE_IO;
+    }
+
+    wu_file_leave(ctx);
+    return ret;
+}
+
+bool wu_file_get_key(wu_file_ctx_t *ctx, uint64_t *key) {
+    wu_file_hdr_t hdr;
+    if (wu_file_enter(ctx, &hdr, F_RDLCK) != NO_ERROR) return false;
+    wu_file_leave(ctx);
+
+    if (hdr.found) *key = hdr.key;
+    return (hdr.found != 0);
+}
+
+int wu_file_count(wu_file_ctx_t *ctx, size_t *done, size_t *claimed) {
+    wu_file_hdr_t hdr;
+    int ret = wu_file_enter(ctx, &hdr, F_RDLCK);
+    if (ret != NO_ERROR) return ret;
+
+    *done = 0;
+    *claimed = 0;
+    for (size_t i = 0; i < ctx->max_step; i++) {
+        if (ctx->slices[i].state == WU_SLICE_DONE) (*done)++;
+        else if (ctx->slices[i].state == WU_SLICE_CLAIMED) (*claimed)++;
+    }
+
+    wu_file_leave(ctx);
+    return NO_ERROR;
+}
+
+#else // _WIN32
+
+// no POSIX record locks, the work file is not available on Windows
+
+int wu_file_open(wu_file_ctx_t *ctx, const char *path, const uint32_t *params, uint32_t profile, uint32_t max_step, uint32_t lease) {
+    (void) path;
+    (void) params;
+    (void) profile;
+    (void) max_step;
+    (void) lease;
+    if (ctx) ctx->fd = -1;
+    return ERROR_FILE_UNSUPPORTED;
+}
+
+int wu_file_close(wu_file_ctx_t *ctx) {
+    (void) ctx;
+    return ERROR_FILE_UNSUPPORTED;
+}
+
+int wu_file_pending(wu_file_ctx_t *ctx) {
+    (void) ctx;
+    return QUEUE_EMPTY;
+}
+
+int wu_file_claim(wu_file_ctx_t *ctx, short queue_type, size_t *id, size_t *rem) {
+    (void) ctx;
+    (void) queue_type;
+    (void) id;
+    (void) rem;
+    return QUEUE_EMPTY;
+}
+
+int wu_file_finish(wu_file_ctx_t *ctx, size_t id) {
+    (void) ctx;
+    (void) id;
+    return ERROR_FILE_UNSUPPORTED;
+}
+
+int wu_file_set_key(wu_file_ctx_t *ctx, uint64_t key) {
+    (void) ctx;
+    (void) key;
+    return ERROR_FILE_UNSUPPORTED;
+}
+
+bool wu_file_get_key(wu_file_ctx_t *ctx, uint64_t *key) {
+    (void) ctx;
+    (void) key;
+    return false;
+}
+
+int wu_file_count(wu_file_ctx_t *ctx, size_t *done, size_t *claimed) {
+    (void) ctx;
+    *done = 0;
+    *claimed = 0;
+    return ERROR_FILE_UNSUPPORTED;
+}
+
+#endif // _WIN32
@@ -0,0 +1,98 @@
+/****************************************************************************
+
+Work units shared between ht2crack5opencl instances, through a file
+
+License: GNU General Public License v3 or any later version (see LICENSE.txt)
+
+*****************************************************************************
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef WORKFILE_H
+#define WORKFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Every instance started with the same work file (-W), on one host or on
+// several hosts sharing it over NFS/SMB, claims one slice at a time from it,
+// so a fast device simply claims more slices than a slow one.
+//
+// layout:
+//   wu_file_hdr_t
+//   max_step x wu_file_slice_t
+//
+// All accesses hold a POSIX record lock on the whole file. A slice claimed by
+// an instance that stopped is handed out again once its lease expired, and a
+// key found by any instance stops all of them at their next claim.
+
+#define WU_FILE_MAGIC       "HT2W"
+#define WU_FILE_VERSION     1
+#define WU_FILE_LEASE       600     // seconds, default lease of a claimed slice
+
+typedef enum wu_slice_state {
+    WU_SLICE_FREE = 0,
+    WU_SLICE_CLAIMED,
+    WU_SLICE_DONE
+
+} wu_slice_state_t;
+
+typedef struct wu_file_hdr {
+    char magic[4];
+    uint32_t version;
+    uint32_t params[5];     // uid, nR1, aR1, nR2, aR2, a file only serves one search
+    uint32_t profile;       // the slices are only the same with the same profile
+    uint32_t max_step;
+    uint32_t found;
+    uint64_t key;
+
+} wu_file_hdr_t;
+
+typedef struct wu_file_slice {
+    uint32_t state;
+    uint32_t stamp;         // time(NULL) of the claim
+
+} wu_file_slice_t;
+
+typedef struct wu_file_ctx {
+    int fd;
+    uint32_t profile;
+    uint32_t max_step;
+    uint32_t lease;
+
+    wu_file_slice_t *slices;
+
+    // record locks don't exclude the threads of one process
+    pthread_mutex_t mutex;
+
+} wu_file_ctx_t;
+
+// Opens the work file, or creates it for 'profile' and 'max_step'.
+// An existing file sets ctx->profile and ctx->max_step, the caller must use them.
+int wu_file_open(wu_file_ctx_t *ctx, const char *path, const uint32_t *params, uint32_t profile, uint32_t max_step, uint32_t lease);
+int wu_file_close(wu_file_ctx_t *ctx);
+
+// NO_ERROR while a slice is free or its lease expired and no key was found, else QUEUE_EMPTY
+int wu_file_pending(wu_file_ctx_t *ctx);
+int wu_file_claim(wu_file_ctx_t *ctx, short queue_type, size_t *id, size_t *rem);
+int wu_file_finish(wu_file_ctx_t *ctx, size_t id);
+
+int wu_file_set_key(wu_file_ctx_t *ctx, uint64_t key);
+bool wu_file_get_key(wu_file_ctx_t *ctx, uint64_t *key);
+int wu_file_count(wu_file_ctx_t *ctx, size_t *done, size_t *claimed);
+
+#endif // WORKFILE_H
@@ -0,0 +1,548 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// OpenCL engine for `hf iclass legbrute`
+//
+// Tests the same candidate indexes as the client, so a search can be moved
+// between the client and GPUs with --index. Every selected OpenCL device runs
+// in its own thread and takes the next slice of the index range from a shared
+// counter. Hosts split the keyspace with -i / -n.
+//-----------------------------------------------------------------------------
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#define CL_TARGET_OPENCL_VERSION 120
+#include <CL/cl.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define KERNEL_FILE         "iclass_legbrute_opencl_kernel.cl"
+#define MAX_DEVICES         16
+// candidates per kernel run
+#define SLICE_SIZE          (1ULL << 24)
+// generate_key_block_inverted() uses 5 bits of each of the 8 key bytes
+#define KEYSPACE            (1ULL << 40)
+#define NOT_FOUND           0xFFFFFFFF
+
+typedef struct {
+    cl_platform_id platform;
+    cl_device_id id;
+    char name[128];
+    cl_context context;
+    cl_command_queue queue;
+    cl_kernel kernel;
+    cl_mem checks;
+    cl_mem found;
+    uint64_t tested;
+    int err;
+} device_ctx_t;
+
+// shared by the device threads
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t s_next = 0;
+static uint64_t s_end = 0;
+static volatile bool s_found = false;
+static uint64_t s_found_index = 0;
+
+static uint8_t s_checks[40];
+
+static void usage(const char *name) {
+    printf("%s [options] <epurse> <macs1> <macs2> <pk>\n\n", name);
+    printf("Same arguments as `hf iclass legbrute`\n");
+    printf("    epurse : ePurse as 8 hex bytes\n");
+    printf("    macs1  : NR + MAC captured from the reader, 8 hex bytes\n");
+    printf("    macs2  : second NR + MAC with the same csn and epurse, 8 hex bytes\n");
+    printf("    pk     : partial key from legrec or starting key of the keyblock, 8 hex bytes\n\n");
+    printf("Options:\n");
+    printf("-i <dec> : index to start from, in millions like legbrute --index [Default: 0]\n");
+    printf("-n <dec> : number of indexes to test, in millions [Default: up to the end of the keyspace]\n");
+    printf("-p <dec> : select an OpenCL platform. [Default: all]\n");
+    printf("-d <dec> : select OpenCL device(s), multiple allowed (1,2,3,etc.). [Default: all]\n");
+    printf("-D <dec> : select OpenCL device type. 0: GPU, 1: CPU, 2: all. [Default: GPU]\n");
+    printf("-s       : show the list of OpenCL platforms/devices, then exit\n");
+    printf("-V       : enable debug messages\n");
+    printf("-h       : show this help\n\n");
+    printf("Split the keyspace between hosts with -i / -n, e.g. two hosts:\n");
+    printf("    %s -n 549755 <args>\n", name);
+    printf("    %s -i 549755 <args>\n", name);
+}
+
+static int hex_to_bytes(const char *hex, uint8_t *out, size_t len) {
+    if (strlen(hex) != len * 2) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned int v;
+        if (sscanf(hex + (i * 2), "%2x", &v) != 1) {
+            return -1;
+        }
+        out[i] = v & 0xFF;
+    }
+    return 0;
+}
+
+// host side copy of the kernel, to double check a found key
+typedef struct {
+    uint8_t l, r, b;
+    uint16_t t;
+} state_t;
+
+static void successor(const uint8_t *k, state_t *s, uint8_t y) {
+    uint8_t r = s->r;
+    uint16_t t = s->t;
+    uint8_t b = s->b;
+
+    uint8_t tt = ((t >> 15) ^ (t >> 14) ^ (t >> 10) ^ (t >> 8) ^ (t >> 5) ^ (t >> 4) ^ (t >> 1) ^ t) & 1;
+    uint8_t bb = ((b >> 6) ^ (b >> 5) ^ (b >> 4) ^ b) & 1;
+
+    uint8_t r0 = (r >> 7) & 1, r1 = (r >> 6) & 1, r2 = (r >> 5) & 1, r3 = (r >> 4) & 1;
+    uint8_t r4 = (r >> 3) & 1, r5 = (r >> 2) & 1, r6 = (r >> 1) & 1, r7 = r & 1;
+
+    uint8_t z0 = (r0 & r2) ^ (r1 & (r3 ^ 1)) ^ (r2 | r4);
+    uint8_t z1 = (r0 | r2) ^ (r5 | r7) ^ r1 ^ r6 ^ tt ^ y;
+    uint8_t z2 = (r3 & (r5 ^ 1)) ^ (r4 & r6) ^ r7 ^ tt;
+
+    s->t = (t >> 1) | ((tt ^ r0 ^ r4) << 15);
+    s->b = (b >> 1) | ((bb ^ r7) << 7);
+
+    uint8_t x = k[(z0 << 2) | (z1 << 1) | z2] ^ s->b;
+    s->r = x + s->l;
+    s->l = x + s->l + r;
+}
+
+static void mac(const uint8_t *k, const uint8_t *cc_nr, uint8_t *out) {
+    state_t s = {
+        .l = (k[0] ^ 0x4c) + 0xEC,
+        .r = (k[0] ^ 0x4c) + 0x21,
+        .b = 0x4c,
+        .t = 0xE012
+    };
+
+    for (int i = 0; i < 12; i++) {
+        for (int j = 0; j < 8; j++) {
+            successor(k, &s, (cc_nr[i] >> j) & 1);
+        }
+    }
+
+    memset(out, 0, 4);
+    for (int p = 0; p < 32; p++) {
+        out[p >> 3] |= ((s.r >> 2) & 1) << (p & 7);
+        successor(k, &s, 0);
+    }
+}
+
+static void generate_key_block_inverted(const uint8_t *startingKey, uint64_t index, uint8_t *keyBlock) {
+    uint64_t carry = index;
+    memcpy(keyBlock, startingKey, 8);
+
+    for (int j = 7; j >= 0; j--) {
+        keyBlock[j] = (keyBlock[j] & 0x07) | ((carry & 0x1F) << 3);
+        carry >>= 5;
+        if (carry == 0) {
+            break;
+        }
+    }
+}
+
+static bool selftest(void) {
+    // From the "dismantling.IClass" paper
+    const uint8_t cc_nr[12] = {0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0};
+    const uint8_t div_key[8] = {0xE0, 0x33, 0xCA, 0x41, 0x9A, 0xEE, 0x43, 0xF9};
+    const uint8_t correct_mac[4] = {0x1d, 0x49, 0xC9, 0xDA};
+    uint8_t out[4];
+    mac(div_key, cc_nr, out);
+    return memcmp(out, correct_mac, 4) == 0;
+}
+
+static char *load_kernel(size_t *len) {
+    FILE *f = fopen(KERNEL_FILE, "rb");
+    if (f == NULL) {
+        printf("Error: can't open %s, run from the directory holding it\n", KERNEL_FILE);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    char *src = calloc(size + 1, sizeof(char));
+    if (src == NULL || fread(src, 1, size, f) != (size_t)size) {
+        printf("Error: can't read %s\n", KERNEL_FILE);
+        free(src);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *len = size;
+    return src;
+}
+
+static bool parse_list(const char *s, bool *sel, size_t max) {
+    char *copy = strdup(s);
+    if (copy == NULL) {
+        return false;
+    }
+    for (char *tok = strtok(copy, ","); tok; tok = strtok(NULL, ",")) {
+        int v = atoi(tok);
+        if (v < 1 || (size_t)v > max) {
+            free(copy);
+            return false;
+        }
+        sel[v - 1] = true;
+    }
+    free(copy);
+    return true;
+}
+
+static int setup_device(device_ctx_t *dev, const char *src, size_t src_len, bool verbose) {
+    cl_int err;
+    dev->context = clCreateContext(NULL, 1, &dev->id, NULL, NULL, &err);
+    if (err != CL_SUCCESS) {
+        printf("[%s] Error: clCreateContext failed (%d)\n", dev->name, err);
+        return err;
+    }
+
+    dev->queue = clCreateCommandQueue(dev->context, dev->id, 0, &err);
+    if (err != CL_SUCCESS) {
+        printf("[%s] Error: clCreateCommandQueue failed (%d)\n", dev->name, err);
+        return err;
+    }
+
+    cl_program program = clCreateProgramWithSource(dev->context, 1, &src, &src_len, &err);
+    if (err != CL_SUCCESS) {
+        printf("[%s] Error: clCreateProgramWithSource failed (%d)\n", dev->name, err);
+        return err;
+    }
+
+    err = clBuildProgram(program, 1, &dev->id, NULL, NULL, NULL);
+    if (err != CL_SUCCESS || verbose) {
+        size_t len = 0;
+        clGetProgramBuildInfo(program, dev->id, CL_PROGRAM_BUILD_LOG, 0, NULL, &len);
+        if (len > 1) {
+            char *log = calloc(len + 1, sizeof(char));
+            if (log) {
+                clGetProgramBuildInfo(program, dev->id, CL_PROGRAM_BUILD_LOG, len, log, NULL);
+                printf("[%s] Build log:\n%s\n", dev->name, log);
+                free(log);
+            }
+        }
+        if (err != CL_SUCCESS) {
+            printf("[%s] Error: clBuildProgram failed (%d)\n", dev->name, err);
+            clReleaseProgram(program);
+            return err;
+        }
+    }
+
+    dev->kernel = clCreateKernel(program, "legbrute", &err);
+    clReleaseProgram(program);
+    if (err != CL_SUCCESS) {
+        printf("[%s] Error: clCreateKernel failed (%d)\n", dev->name, err);
+        return err;
+    }
+
+    dev->checks = clCreateBuffer(dev->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(s_checks), s_checks, &err);
+    if (err != CL_SUCCESS) {
+        printf("[%s] Error: clCreateBuffer failed (%d)\n", dev->name, err);
+        return err;
+    }
+
+    dev->found = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &err);
+    if (err != CL_SUCCESS) {
+        printf("[%s] Error: clCreateBuffer failed (%d)\n", dev->name, err);
+        return err;
+    }
+
+    clSetKernelArg(dev->kernel, 1, sizeof(cl_mem), &dev->checks);
+    clSetKernelArg(dev->kernel, 2, sizeof(cl_mem), &dev->found);
+    return CL_SUCCESS;
+}
+
+static void release_device(device_ctx_t *dev) {
+    if (dev->found) clReleaseMemObject(dev->found);
+    if (dev->checks) clReleaseMemObject(dev->checks);
+    if (dev->kernel) clReleaseKernel(dev->kernel);
+    if (dev->queue) clReleaseCommandQueue(dev->queue);
+    if (dev->context) clReleaseContext(dev->context);
+}
+
+static void *device_thread(void *arg) {
+    device_ctx_t *dev = (device_ctx_t *)arg;
+
+    while (s_found == false) {
+        pthread_mutex_lock(&s_lock);
+        uint64_t base = s_next;
+        uint64_t count = (s_end - base < SLICE_SIZE) ? s_end - base : SLICE_SIZE;
+        s_next += count;
+        pthread_mutex_unlock(&s_lock);
+
+        if (count == 0) {
+            break;
+        }
+
+        cl_uint found = NOT_FOUND;
+        cl_ulong cl_base = base;
+        size_t global = count;
+        cl_int err = clEnqueueWriteBuffer(dev->queue, dev->found, CL_FALSE, 0, sizeof(found), &found, 0, NULL, NULL);
+        err |= clSetKernelArg(dev->kernel, 0, sizeof(cl_base), &cl_base);
+        err |= clEnqueueNDRangeKernel(dev->queue, dev->kernel, 1, NULL, &global, NULL, 0, NULL, NULL);
+        err |= clEnqueueReadBuffer(dev->queue, dev->found, CL_TRUE, 0, sizeof(found), &found, 0, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            printf("\n[%s] Error: kernel run failed (%d)\n", dev->name, err);
+            dev->err = err;
+            break;
+        }
+
+        pthread_mutex_lock(&s_lock);
+        dev->tested += count;
+        if (found != NOT_FOUND && (s_found == false || base + found < s_found_index)) {
+            s_found = true;
+            s_found_index = base + found;
+        }
+        pthread_mutex_unlock(&s_lock);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    uint64_t start = 0;
+    uint64_t count = 0;
+    int platform_sel = 0;
+    bool dev_sel[MAX_DEVICES] = {0};
+    bool dev_sel_any = false;
+    int dev_type = 0;
+    bool show = false;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:p:d:D:sVh")) != -1) {
+        switch (opt) {
+            case 'i':
+                start = strtoull(optarg, NULL, 10) * 1000000ULL;
+                break;
+            case 'n':
+                count = strtoull(optarg, NULL, 10) * 1000000ULL;
+                break;
+            case 'p':
+                platform_sel = atoi(optarg);
+                break;
+            case 'd':
+                if (parse_list(optarg, dev_sel, MAX_DEVICES) == false) {
+                    printf("Error: invalid device list '%s'\n", optarg);
+                    return 1;
+                }
+                dev_sel_any = true;
+                break;
+            case 'D':
+                dev_type = atoi(optarg);
+                break;
+            case 's':
+                show = true;
+                break;
+            case 'V':
+                verbose = true;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if (selftest() == false) {
+        printf("Error: MAC selftest failed\n");
+        return 1;
+    }
+
+    if (show == false && argc - optind != 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    uint8_t epurse[8], macs1[8], macs2[8], pk[8];
+    if (show == false) {
+        if (hex_to_bytes(argv[optind], epurse, 8) || hex_to_bytes(argv[optind + 1], macs1, 8) ||
+                hex_to_bytes(argv[optind + 2], macs2, 8) || hex_to_bytes(argv[optind + 3], pk, 8)) {
+            printf("Error: all arguments must be 8 hex bytes\n");
+            return 1;
+        }
+
+        // CCNR = epurse + NR, same layout as CmdHFiClassLegBrute_MT
+        memcpy(s_checks, epurse, 8);
+        memcpy(s_checks + 8, macs1, 4);
+        memcpy(s_checks + 12, macs1 + 4, 4);
+        memcpy(s_checks + 16, epurse, 8);
+        memcpy(s_checks + 24, macs2, 4);
+        memcpy(s_checks + 28, macs2 + 4, 4);
+        memcpy(s_checks + 32, pk, 8);
+    }
+
+    cl_device_type type = (dev_type == 1) ? CL_DEVICE_TYPE_CPU : (dev_type == 2) ? CL_DEVICE_TYPE_ALL : CL_DEVICE_TYPE_GPU;
+
+    cl_platform_id platforms[8];
+    cl_uint nplatforms = 0;
+    if (clGetPlatformIDs(8, platforms, &nplatforms) != CL_SUCCESS || nplatforms == 0) {
+        printf("Error: no OpenCL platform found\n");
+        return 1;
+    }
+
+    device_ctx_t devs[MAX_DEVICES];
+    memset(devs, 0, sizeof(devs));
+    size_t ndevs = 0;
+    unsigned int devnum = 0;
+
+    for (cl_uint p = 0; p < nplatforms; p++) {
+        char pname[128] = {0};
+        clGetPlatformInfo(platforms[p], CL_PLATFORM_NAME, sizeof(pname) - 1, pname, NULL);
+        if (show) {
+            printf("Platform %u: %s\n", p + 1, pname);
+        }
+        if (platform_sel && platform_sel != (int)p + 1) {
+            continue;
+        }
+
+        cl_device_id ids[MAX_DEVICES];
+        cl_uint nids = 0;
+        if (clGetDeviceIDs(platforms[p], type, MAX_DEVICES, ids, &nids) != CL_SUCCESS) {
+            continue;
+        }
+        for (cl_uint d = 0; d < nids; d++) {
+            devnum++;
+            char dname[128] = {0};
+            clGetDeviceInfo(ids[d], CL_DEVICE_NAME, sizeof(dname) - 1, dname, NULL);
+            if (show) {
+                printf("    Device %u: %s\n", devnum, dname);
+                continue;
+            }
+            if ((dev_sel_any && (devnum > MAX_DEVICES || dev_sel[devnum - 1] == false)) || ndevs == MAX_DEVICES) {
+                continue;
+            }
+            devs[ndevs].platform = platforms[p];
+            devs[ndevs].id = ids[d];
+            snprintf(devs[ndevs].name, sizeof(devs[ndevs].name), "%s", dname);
+            ndevs++;
+        }
+    }
+
+    if (show) {
+        return 0;
+    }
+
+    if (ndevs == 0) {
+        printf("Error: no OpenCL device selected\n");
+        return 1;
+    }
+
+    size_t src_len = 0;
+    char *src = load_kernel(&src_len);
+    if (src == NULL) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < ndevs; i++) {
+        if (setup_device(&devs[i], src, src_len, verbose) != CL_SUCCESS) {
+            for (size_t j = 0; j <= i; j++) {
+                release_device(&devs[j]);
+            }
+            free(src);
+            return 1;
+        }
+        printf("Using device %zu: %s\n", i + 1, devs[i].name);
+    }
+    free(src);
+
+    if (start >= KEYSPACE) {
+        printf("Error: start index is past the end of the keyspace\n");
+        return 1;
+    }
+    s_next = start;
+    s_end = (count && count < KEYSPACE - start) ? start + count : KEYSPACE;
+    printf("Bruteforcing index " "%" PRIu64 " to %" PRIu64 " (millions) on %zu device(s)\n\n", start / 1000000, s_end / 1000000, ndevs);
+
+    pthread_t tids[MAX_DEVICES];
+    for (size_t i = 0; i < ndevs; i++) {
+        pthread_create(&tids[i], NULL, device_thread, &devs[i]);
+    }
+
+    // progress, same wording as the client
+    time_t t0 = time(NULL);
+    for (;;) {
+        sleep(1);
+        pthread_mutex_lock(&s_lock);
+        uint64_t tested = 0;
+        for (size_t i = 0; i < ndevs; i++) {
+            tested += devs[i].tested;
+        }
+        bool done = s_found || s_next >= s_end;
+        uint64_t next = s_next;
+        pthread_mutex_unlock(&s_lock);
+
+        time_t dt = time(NULL) - t0;
+        printf("\rTested %" PRIu64 " million keys, curr index: %" PRIu64 ", %" PRIu64 " M keys/s   ",
+               tested / 1000000, next / 1000000, (dt) ? (tested / 1000000) / (uint64_t)dt : 0);
+        fflush(stdout);
+        if (done) {
+            break;
+        }
+    }
+
+    int err = 0;
+    for (size_t i = 0; i < ndevs; i++) {
+        pthread_join(tids[i], NULL);
+        err |= devs[i].err;
+        release_device(&devs[i]);
+    }
+    printf("\n\n");
+
+    if (s_found) {
+        uint8_t key[8], m1[4], m2[4];
+        generate_key_block_inverted(pk, s_found_index, key);
+        mac(key, s_checks, m1);
+        mac(key, s_checks + 16, m2);
+        if (memcmp(m1, s_checks + 12, 4) || memcmp(m2, s_checks + 28, 4)) {
+            printf("Error: device reported index %" PRIu64 " but the host MAC does not match\n", s_found_index);
+            return 1;
+        }
+        printf("Found valid raw key ");
+        for (int i = 0; i < 8; i++) {
+            printf("%02X", key[i]);
+        }
+        printf(" at index %" PRIu64 "\n", s_found_index);
+        printf("Hint: Run `hf iclass unhash -k ");
+        for (int i = 0; i < 8; i++) {
+            printf("%02X", key[i]);
+        }
+        printf("` to find the needed pre-images\n");
+        return 0;
+    }
+
+    if (err) {
+        return 1;
+    }
+    printf("Key not found in the index range\n");
+    return 2;
+}
@@ -0,0 +1,96 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// iClass legacy raw key brute force, one candidate index per work item.
+// Same candidates and cipher as `hf iclass legbrute` (client/src/loclass/cipher.c)
+//-----------------------------------------------------------------------------
+
+typedef struct {
+    uchar l;
+    uchar r;
+    uchar b;
+    ushort t;
+} state_t;
+
+inline void successor(const uchar *k, state_t *s, uint y) {
+    uint r = s->r;
+    uint t = s->t;
+    uint b = s->b;
+
+    uint tt = ((t >> 15) ^ (t >> 14) ^ (t >> 10) ^ (t >> 8) ^ (t >> 5) ^ (t >> 4) ^ (t >> 1) ^ t) & 1;
+    uint bb = ((b >> 6) ^ (b >> 5) ^ (b >> 4) ^ b) & 1;
+
+    uint r0 = (r >> 7) & 1, r1 = (r >> 6) & 1, r2 = (r >> 5) & 1, r3 = (r >> 4) & 1;
+    uint r4 = (r >> 3) & 1, r5 = (r >> 2) & 1, r6 = (r >> 1) & 1, r7 = r & 1;
+
+    uint z0 = (r0 & r2) ^ (r1 & (r3 ^ 1)) ^ (r2 | r4);
+    uint z1 = (r0 | r2) ^ (r5 | r7) ^ r1 ^ r6 ^ tt ^ y;
+    uint z2 = (r3 & (r5 ^ 1)) ^ (r4 & r6) ^ r7 ^ tt;
+
+    s->t = (ushort)((t >> 1) | ((tt ^ r0 ^ r4) << 15));
+    s->b = (uchar)((b >> 1) | ((bb ^ r7) << 7));
+
+    uint x = k[(z0 << 2) | (z1 << 1) | z2] ^ s->b;
+    uint l = s->l;
+    s->r = (uchar)(x + l);
+    s->l = (uchar)(x + l + r);
+}
+
+// true when the MAC of cc_nr (12 bytes) under k is mac
+inline bool mac_match(const uchar *k, __constant const uchar *cc_nr, __constant const uchar *mac) {
+    state_t s;
+    s.l = (uchar)((k[0] ^ 0x4c) + 0xEC);
+    s.r = (uchar)((k[0] ^ 0x4c) + 0x21);
+    s.b = 0x4c;
+    s.t = 0xE012;
+
+    for (int i = 0; i < 12; i++) {
+        uint v = cc_nr[i];
+        for (int j = 0; j < 8; j++) {
+            successor(k, &s, (v >> j) & 1);
+        }
+    }
+
+    for (int p = 0; p < 32; p++) {
+        if (((s.r >> 2) & 1) != ((mac[p >> 3] >> (p & 7)) & 1)) {
+            return false;
+        }
+        successor(k, &s, 0);
+    }
+    return true;
+}
+
+// checks[0..11] CCNR1, [12..15] MAC1, [16..27] CCNR2, [28..31] MAC2, [32..39] starting key
+__kernel void legbrute(ulong base, __constant const uchar *checks, volatile __global uint *found) {
+
+    ulong c = base + get_global_id(0);
+
+    // generate_key_block_inverted()
+    uchar k[8];
+    for (int j = 0; j < 8; j++) {
+        k[j] = checks[32 + j];
+    }
+    for (int j = 7; j >= 0; j--) {
+        k[j] = (uchar)((k[j] & 0x07) | ((c & 0x1F) << 3));
+        c >>= 5;
+        if (c == 0) {
+            break;
+        }
+    }
+
+    if (mac_match(k, checks, checks + 12) && mac_match(k, checks + 16, checks + 28)) {
+        atomic_min(found, (uint)get_global_id(0));
+    }
+}
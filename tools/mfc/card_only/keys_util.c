@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __WIN32
+#include "windows.h"
+#else
+#include "unistd.h"
+#endif
+
+#include "keys_util.h"
+
+// number of records a run reader keeps in memory
+#define RUN_READ_CHUNK          4096
+
+static void sleep_ms(uint32_t ms) {
+#ifdef __WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+uint32_t keys_pool_workers(void) {
+    long n;
+#ifdef __WIN32
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    n = sysinfo.dwNumberOfProcessors;
+#else
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (n > 0) ? (uint32_t)n : 1;
+}
+
+typedef struct {
+    keys_pool_fn_t fn;
+    void *ctx;
+    uint32_t count;
+    uint32_t next;
+    uint32_t done;
+} pool_job_t;
+
+typedef struct {
+    pool_job_t *job;
+    uint32_t worker;
+} pool_arg_t;
+
+static void *pool_worker(void *arg) {
+    pool_arg_t *pa = (pool_arg_t *)arg;
+    pool_job_t *job = pa->job;
+    for (;;) {
+        uint32_t item = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (item >= job->count) {
+            break;
+        }
+        job->fn(item, pa->worker, job->ctx);
+        __atomic_fetch_add(&job->done, 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+void keys_pool_run(uint32_t count, keys_pool_fn_t fn, keys_progress_fn_t progress, void *ctx) {
+    if (count == 0) {
+        return;
+    }
+
+    pool_job_t job = { .fn = fn, .ctx = ctx, .count = count };
+    uint32_t n = keys_pool_workers();
+    if (n > count) {
+        n = count;
+    }
+
+    pthread_t *threads = calloc(n, sizeof(pthread_t));
+    pool_arg_t *args = calloc(n, sizeof(pool_arg_t));
+    uint32_t started = 0;
+    if (threads != NULL && args != NULL) {
+        for (; started < n; started++) {
+            args[started].job = &job;
+            args[started].worker = started;
+            if (pthread_create(&threads[started], NULL, pool_worker, &args[started]) != 0) {
+                break;
+            }
+        }
+    }
+
+    if (started == 0) {
+        // no threads at all, do it ourselves
+        pool_arg_t self = { .job = &job, .worker = 0 };
+        pool_worker(&self);
+    } else if (progress != NULL) {
+        uint32_t done;
+        while ((done = __atomic_load_n(&job.done, __ATOMIC_ACQUIRE)) < count) {
+            progress(done, count, ctx);
+            sleep_ms(500);
+        }
+    }
+
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (progress != NULL) {
+        progress(count, count, ctx);
+    }
+    free(threads);
+    free(args);
+}
+
+// LSD radix sort on the 48 key bits, bytes shared by all keys are skipped
+void keys_radix_sort(uint64_t *keys, uint64_t *tmp, size_t n) {
+    uint64_t *src = keys, *dst = tmp;
+    if (n < 2) {
+        return;
+    }
+
+    for (uint32_t shift = 0; shift < 48; shift += 8) {
+        size_t count[0x100] = {0};
+        for (size_t i = 0; i < n; i++) {
+            count[(src[i] >> shift) & 0xff]++;
+        }
+        if (count[(src[0] >> shift) & 0xff] == n) {
+            continue;
+        }
+
+        size_t pos = 0;
+        for (uint32_t b = 0; b <= 0xff; b++) {
+            size_t c = count[b];
+            count[b] = pos;
+            pos += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[count[(src[i] >> shift) & 0xff]++] = src[i];
+        }
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != keys) {
+        memcpy(keys, src, n * sizeof(uint64_t));
+    }
+}
+
+bool keystore_init(keystore_t *ks, size_t mem_bytes) {
+    memset(ks, 0, sizeof(keystore_t));
+    if (mem_bytes == 0) {
+        mem_bytes = KEYS_STORE_MEM_DEFAULT;
+    }
+
+    // buffer and radix scratch
+    ks->cap = mem_bytes / (2 * sizeof(uint64_t));
+    if (ks->cap < RUN_READ_CHUNK) {
+        ks->cap = RUN_READ_CHUNK;
+    }
+    ks->buf = malloc(ks->cap * sizeof(uint64_t));
+    ks->tmp = malloc(ks->cap * sizeof(uint64_t));
+    if (ks->buf == NULL || ks->tmp == NULL) {
+        free(ks->buf);
+        free(ks->tmp);
+        return false;
+    }
+    pthread_mutex_init(&ks->lock, NULL);
+    return true;
+}
+
+void keystore_free(keystore_t *ks) {
+    for (size_t i = 0; i < ks->nr_runs; i++) {
+        fclose(ks->runs[i]);
+    }
+    free(ks->runs);
+    free(ks->buf);
+    free(ks->tmp);
+    pthread_mutex_destroy(&ks->lock);
+    memset(ks, 0, sizeof(keystore_t));
+}
+
+// sorts the buffer and writes it as one (key, count) run, buffer is empty afterwards
+static bool keystore_spill(keystore_t *ks) {
+    FILE **runs = realloc(ks->runs, (ks->nr_runs + 1) * sizeof(FILE *));
+    if (runs == NULL) {
+        return false;
+    }
+    ks->runs = runs;
+
+    FILE *f = tmpfile();
+    if (f == NULL) {
+        fprintf(stderr, "Failed to create a temporary file for the key candidates\n");
+        return false;
+    }
+
+    keys_radix_sort(ks->buf, ks->tmp, ks->len);
+    for (size_t i = 0; i < ks->len;) {
+        uint64_t key = ks->buf[i];
+        uint32_t count = 0;
+        for (; i < ks->len && ks->buf[i] == key; i++) {
+            count++;
+        }
+        if (fwrite(&key, sizeof(key), 1, f) != 1 || fwrite(&count, sizeof(count), 1, f) != 1) {
+            fprintf(stderr, "Failed to spill key candidates to disk\n");
+            fclose(f);
+            return false;
+        }
+    }
+
+    rewind(f);
+    ks->runs[ks->nr_runs++] = f;
+    ks->len = 0;
+    return true;
+}
+
+bool keystore_add(keystore_t *ks, const uint64_t *keys, size_t n) {
+    bool res = true;
+    pthread_mutex_lock(&ks->lock);
+    ks->total += n;
+    while (n) {
+        size_t chunk = ks->cap - ks->len;
+        if (chunk > n) {
+            chunk = n;
+        }
+        memcpy(ks->buf + ks->len, keys, chunk * sizeof(uint64_t));
+        ks->len += chunk;
+        keys += chunk;
+        n -= chunk;
+        if (ks->len == ks->cap && keystore_spill(ks) == false) {
+            res = false;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ks->lock);
+    return res;
+}
+
+typedef struct {
+    FILE *f;
+    uint64_t key[RUN_READ_CHUNK];
+    uint32_t count[RUN_READ_CHUNK];
+    size_t pos;
+    size_t len;
+} run_reader_t;
+
+// false once the run is exhausted
+static bool run_fill(run_reader_t *r) {
+    if (r->pos < r->len) {
+        return true;
+    }
+    r->pos = 0;
+    r->len = 0;
+    while (r->len < RUN_READ_CHUNK &&
+            fread(&r->key[r->len], sizeof(uint64_t), 1, r->f) == 1 &&
+            fread(&r->count[r->len], sizeof(uint32_t), 1, r->f) == 1) {
+        r->len++;
+    }
+    return r->len > 0;
+}
+
+bool keystore_count(keystore_t *ks, keystore_fn_t fn, void *ctx) {
+    // what is left in memory is merged as a plain sorted list
+    keys_radix_sort(ks->buf, ks->tmp, ks->len);
+
+    run_reader_t *readers = calloc(ks->nr_runs ? ks->nr_runs : 1, sizeof(run_reader_t));
+    if (readers == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < ks->nr_runs; i++) {
+        readers[i].f = ks->runs[i];
+    }
+
+    size_t mem_pos = 0;
+    for (;;) {
+        // smallest head of all runs and the buffer
+        bool have = false;
+        uint64_t key = 0;
+        for (size_t i = 0; i < ks->nr_runs; i++) {
+            if (run_fill(&readers[i]) && (have == false || readers[i].key[readers[i].pos] < key)) {
+                key = readers[i].key[readers[i].pos];
+                have = true;
+            }
+        }
+        if (mem_pos < ks->len && (have == false || ks->buf[mem_pos] < key)) {
+            key = ks->buf[mem_pos];
+            have = true;
+        }
+        if (have == false) {
+            break;
+        }
+
+        uint32_t count = 0;
+        for (size_t i = 0; i < ks->nr_runs; i++) {
+            if (readers[i].pos < readers[i].len && readers[i].key[readers[i].pos] == key) {
+                count += readers[i].count[readers[i].pos++];
+            }
+        }
+        for (; mem_pos < ks->len && ks->buf[mem_pos] == key; mem_pos++) {
+            count++;
+        }
+        fn(key, count, ctx);
+    }
+
+    free(readers);
+    ks->len = 0;
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef KEYS_UTIL_H__
+#define KEYS_UTIL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "pthread.h"
+
+// Key candidate engine shared by the staticnested tools:
+// * a fixed-size thread pool with dynamic item scheduling
+// * radix sort of 48-bit keys
+// * a key store with bounded memory: once the buffer is full it is sorted,
+//   reduced to (key, count) pairs and spilled to a temporary file. Counting
+//   merges all runs, so memory stays at the buffer size whatever the total.
+
+// number of pool threads, one per CPU
+uint32_t keys_pool_workers(void);
+
+// runs fn on items [0, count), returns when all are done.
+// progress, if set, is called about every 500 ms from the calling thread with the number of items done
+typedef void (*keys_pool_fn_t)(uint32_t item, uint32_t worker, void *ctx);
+typedef void (*keys_progress_fn_t)(uint32_t done, uint32_t count, void *ctx);
+void keys_pool_run(uint32_t count, keys_pool_fn_t fn, keys_progress_fn_t progress, void *ctx);
+
+// sorts n keys in place, tmp needs room for n keys
+void keys_radix_sort(uint64_t *keys, uint64_t *tmp, size_t n);
+
+// default in-memory budget of a key store
+#define KEYS_STORE_MEM_DEFAULT  ((size_t)256 << 20)
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t *buf;          // keys not spilled yet, unsorted
+    uint64_t *tmp;          // radix sort scratch
+    size_t len;
+    size_t cap;
+    FILE **runs;            // spilled runs of (key, count), sorted by key
+    size_t nr_runs;
+    uint64_t total;         // keys added
+} keystore_t;
+
+// mem_bytes == 0 uses the default budget
+bool keystore_init(keystore_t *ks, size_t mem_bytes);
+void keystore_free(keystore_t *ks);
+// thread safe
+bool keystore_add(keystore_t *ks, const uint64_t *keys, size_t n);
+// calls fn once per distinct key in ascending order, with the number of times it was added.
+// The store is consumed, only keystore_free() is valid afterwards
+typedef void (*keystore_fn_t)(uint64_t key, uint32_t count, void *ctx);
+bool keystore_count(keystore_t *ks, keystore_fn_t fn, void *ctx);
+
+#endif
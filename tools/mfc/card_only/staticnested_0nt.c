@@ -17,10 +17,7 @@
 #include "common.h"
 #include "crapto1/crapto1.h"
 #include "parity.h"
-
-// max number of concurrent threads
-#define NUM_THREADS 20
-#define CHUNK_DIVISOR 10
+#include "keys_util.h"
 
 // oversized just in case...
 #define KEY_SPACE_SIZE ((1 << 16) * 4)
@@ -46,21 +43,16 @@ typedef struct {
     uint32_t nr_nonces;
 } NtpKs1List;
 
-// Struct for thread data
+// shared by the pool workers
 typedef struct {
     NtpKs1List *pNKL;
-    uint32_t startPos;
-    uint32_t endPos;
-    uint32_t *keyCount[MAX_NR_NONCES];
-    uint64_t *result_keys[MAX_NR_NONCES];
-    uint32_t thread_id;
-    pthread_mutex_t *keyCount_mutex[MAX_NR_NONCES];
-    uint32_t num_nonces;
-} thread_data_t;
-
-static bool thread_status[NUM_THREADS];  // To keep track of active threads
-static pthread_mutex_t status_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t status_cond = PTHREAD_COND_INITIALIZER;
+    uint32_t *keyCount;
+    uint64_t **result_keys;
+    pthread_mutex_t keyCount_mutex;
+    lfsr_arena_t **arenas;
+    struct Crypto1State **states;
+    bool abort;
+} job_data_t;
 
 static uint32_t hex_to_uint32(const char *hex_str) {
     return (uint32_t)strtoul(hex_str, NULL, 16);
@@ -93,12 +85,8 @@ static uint8_t valid_nonce(uint32_t Nt, uint32_t ks1, uint8_t nt_par_enc) {
 
 static bool search_match(const NtData *pND, const NtData *pND0, uint64_t key) {
     bool ret = 0;
-    struct Crypto1State *s;
-    s = crypto1_create(0);
-    if (s == NULL) {
-        fprintf(stderr, "\nCalloc error in search_match!\n");
-        return 0;
-    }
+    struct Crypto1State state;
+    struct Crypto1State *s = &state;
     crypto1_init(s, key);
     uint32_t authuid = pND->authuid;
     uint32_t nt_enc = pND->nt_enc;
@@ -144,166 +132,117 @@ static bool search_match(const NtData *pND, const NtData *pND0, uint64_t key) {
             }
         }
     }
-    crypto1_destroy(s);
     return ret;
 }
 
-static void *generate_and_intersect_keys(void *threadarg) {
-    thread_data_t *data = (thread_data_t *)threadarg;
+static void generate_and_intersect_keys(uint32_t item, uint32_t worker, void *ctx) {
+    job_data_t *data = (job_data_t *)ctx;
     NtpKs1List *pNKL = data->pNKL;
-    uint32_t startPos = data->startPos;
-    uint32_t endPos = data->endPos;
-    uint32_t thread_id = data->thread_id;
-    uint32_t num_nonces = data->num_nonces;
+    uint32_t num_nonces = pNKL->nr_nonces;
+
+    if (__atomic_load_n(&data->abort, __ATOMIC_RELAXED)) {
+        return;
+    }
 
-    struct Crypto1State *revstate, *revstate_start = NULL;
     uint64_t lfsr = 0;
 
     uint32_t authuid = pNKL->NtDataList[0].authuid;
-    for (uint32_t i = startPos; i < endPos; i++) {
-        uint32_t ntp = pNKL->NtDataList[0].pNK[i].ntp;
-        uint32_t ks1 = pNKL->NtDataList[0].pNK[i].ks1;
-        uint32_t nt_probe = ntp ^ authuid;
-
-        revstate = lfsr_recovery32(ks1, nt_probe);
-        if (revstate == NULL) {
-            fprintf(stderr, "\nCalloc error in generate_and_intersect_keys!\n");
-            pthread_exit(NULL);
-        }
-
-        if (revstate_start == NULL) {
-            revstate_start = revstate;
-        }
-
-        uint32_t keyCount0 = 0;
-        while ((revstate->odd != 0x0) || (revstate->even != 0x0)) {
-            lfsr_rollback_word(revstate, nt_probe, 0);
-            crypto1_get_lfsr(revstate, &lfsr);
-            keyCount0++;
-            for (uint32_t nonce_index = 1; nonce_index < num_nonces; nonce_index++) {
-                if (search_match(&pNKL->NtDataList[nonce_index], &pNKL->NtDataList[0], lfsr)) {
-                    pthread_mutex_lock(data->keyCount_mutex[nonce_index]);
-                    data->result_keys[nonce_index][*data->keyCount[nonce_index]] = lfsr;
-                    (*data->keyCount[nonce_index])++;
-                    pthread_mutex_unlock(data->keyCount_mutex[nonce_index]);
-                    if (*data->keyCount[nonce_index] == KEY_SPACE_SIZE_STEP2) {
+    uint32_t ntp = pNKL->NtDataList[0].pNK[item].ntp;
+    uint32_t ks1 = pNKL->NtDataList[0].pNK[item].ks1;
+    uint32_t nt_probe = ntp ^ authuid;
+
+    struct Crypto1State *revstate = data->states[worker];
+    uint32_t keyCount0 = lfsr_recovery32_ex(ks1, nt_probe, data->arenas[worker], revstate);
+
+    for (uint32_t i = 0; i < keyCount0; i++) {
+        lfsr_rollback_word(&revstate[i], nt_probe, 0);
+        crypto1_get_lfsr(&revstate[i], &lfsr);
+        for (uint32_t nonce_index = 1; nonce_index < num_nonces; nonce_index++) {
+            if (search_match(&pNKL->NtDataList[nonce_index], &pNKL->NtDataList[0], lfsr)) {
+                pthread_mutex_lock(&data->keyCount_mutex);
+                if (data->keyCount[nonce_index] == KEY_SPACE_SIZE_STEP2) {
+                    if (data->abort == false) {
                         fprintf(stderr, "No space left on result_keys[%u], abort!\n", nonce_index);
-                        i = endPos;
-                        break;
                     }
+                    data->abort = true;
+                } else {
+                    data->result_keys[nonce_index][data->keyCount[nonce_index]++] = lfsr;
                 }
+                pthread_mutex_unlock(&data->keyCount_mutex);
             }
-            revstate++;
         }
+    }
+
+    pthread_mutex_lock(&data->keyCount_mutex);
+    data->keyCount[0] += keyCount0;
+    pthread_mutex_unlock(&data->keyCount_mutex);
+}
 
-        free(revstate_start);
-        revstate_start = NULL;
+static void print_progress(uint32_t done, uint32_t count, void *ctx) {
+    job_data_t *data = (job_data_t *)ctx;
 
-        pthread_mutex_lock(data->keyCount_mutex[0]);
-        (*data->keyCount[0]) += keyCount0;
-        pthread_mutex_unlock(data->keyCount_mutex[0]);
+    pthread_mutex_lock(&data->keyCount_mutex);
+    printf("\33[2K\rProgress: %02.1f%%", (double)done * 100 / count);
+    printf(" keys[%d]:%9u", 0, data->keyCount[0]);
+    for (uint32_t nonce_index = 1; nonce_index < data->pNKL->nr_nonces; nonce_index++) {
+        printf(" keys[%u]:%5u", nonce_index, data->keyCount[nonce_index]);
     }
-
-    pthread_mutex_lock(&status_mutex);
-    thread_status[thread_id] = false;  // Mark thread as inactive
-    pthread_cond_signal(&status_cond);       // Signal the main thread
-    pthread_mutex_unlock(&status_mutex);
-    pthread_exit(NULL);
-    return NULL; // Make some compilers happy
+    pthread_mutex_unlock(&data->keyCount_mutex);
+    fflush(stdout);
 }
 
 static uint64_t **unpredictable_nested(NtpKs1List *pNKL, uint32_t keyCounts[]) {
-    pthread_t threads[NUM_THREADS];
-    thread_data_t thread_data[NUM_THREADS];
-    pthread_mutex_t keyCount_mutex[MAX_NR_NONCES];
 
     uint64_t **result_keys = (uint64_t **)calloc(MAX_NR_NONCES, sizeof(uint64_t *));
+    if (result_keys == NULL) {
+        fprintf(stderr, "\nCalloc error in unpredictable_nested!\n");
+        return NULL;
+    }
     for (uint32_t i = 0; i < MAX_NR_NONCES; i++) {
         // no result_keys[0] stored, would be too large
         if (i != 0) {
             result_keys[i] = (uint64_t *)calloc(KEY_SPACE_SIZE_STEP2, sizeof(uint64_t));
         }
         keyCounts[i] = 0;
-        pthread_mutex_init(&keyCount_mutex[i], NULL);
     }
 
-    const uint32_t chunk_size = pNKL->NtDataList[0].sizeNK / NUM_THREADS / CHUNK_DIVISOR;
-    uint32_t startPos = 0;
-
-    while (startPos < pNKL->NtDataList[0].sizeNK) {
-        pthread_mutex_lock(&status_mutex);
-        uint32_t activeThreads = 0;
-
-        // Count active threads
-        for (int i = 0; i < NUM_THREADS; i++) {
-            if (thread_status[i]) activeThreads++;
-        }
-
-        // Spawn new threads if there are available slots
-        for (uint32_t t = 0; activeThreads < NUM_THREADS && startPos < pNKL->NtDataList[0].sizeNK && t < NUM_THREADS; t++) {
-
-            if (!thread_status[t]) {
-                uint32_t endPos = startPos + chunk_size;
-                if (endPos > pNKL->NtDataList[0].sizeNK) {
-                    endPos = pNKL->NtDataList[0].sizeNK;
-                }
-
-                thread_data[t].pNKL = pNKL;
-                thread_data[t].startPos = startPos;
-                thread_data[t].endPos = endPos;
-                thread_data[t].thread_id = t;
-                thread_data[t].num_nonces = pNKL->nr_nonces;
-
-                for (uint32_t i = 0; i < MAX_NR_NONCES; i++) {
-                    thread_data[t].result_keys[i] = result_keys[i];
-                    thread_data[t].keyCount[i] = &keyCounts[i];
-                    thread_data[t].keyCount_mutex[i] = &keyCount_mutex[i];
-                }
-
-                thread_status[t] = true;  // Mark thread as active
-                pthread_create(&threads[t], NULL, generate_and_intersect_keys, (void *)&thread_data[t]);
-                activeThreads++;
-                startPos = endPos;
-            }
-        }
-
-        // Wait for any thread to complete
-        while (activeThreads >= NUM_THREADS) {
-            pthread_cond_wait(&status_cond, &status_mutex);
-            activeThreads = 0;
-            for (int i = 0; i < NUM_THREADS; i++) {
-                if (thread_status[i]) {
-                    activeThreads++;
-                }
-            }
-        }
-
-        pthread_mutex_unlock(&status_mutex);
-        printf("\33[2K\rProgress: %02.1f%%", (double)(startPos + 1) * 100 / pNKL->NtDataList[0].sizeNK);
-        printf(" keys[%d]:%9u", 0, keyCounts[0]);
-        for (uint32_t nonce_index = 1; nonce_index < pNKL->nr_nonces; nonce_index++) {
-            printf(" keys[%u]:%5u", nonce_index, keyCounts[nonce_index]);
-        }
-        fflush(stdout);
+    uint32_t workers = keys_pool_workers();
+    job_data_t data = {
+        .pNKL = pNKL,
+        .keyCount = keyCounts,
+        .result_keys = result_keys,
+        .arenas = calloc(workers, sizeof(lfsr_arena_t *)),
+        .states = calloc(workers, sizeof(struct Crypto1State *)),
+    };
+    pthread_mutex_init(&data.keyCount_mutex, NULL);
+
+    bool ok = (data.arenas != NULL && data.states != NULL);
+    for (uint32_t i = 0; ok && i < workers; i++) {
+        data.arenas[i] = lfsr_arena_create();
+        data.states[i] = malloc(sizeof(struct Crypto1State) * LFSR_RECOVERY32_MAX_STATES);
+        ok = (data.arenas[i] != NULL && data.states[i] != NULL);
+    }
+    for (uint32_t i = 1; ok && i < pNKL->nr_nonces; i++) {
+        ok = (result_keys[i] != NULL);
     }
 
-    pthread_mutex_lock(&status_mutex);
-    uint32_t activeThreads = 0;
-
-    // Count active threads
-    for (int i = 0; i < NUM_THREADS; i++) {
-        if (thread_status[i]) activeThreads++;
+    if (ok) {
+        keys_pool_run(pNKL->NtDataList[0].sizeNK, generate_and_intersect_keys, print_progress, &data);
+    } else {
+        fprintf(stderr, "\nCalloc error in unpredictable_nested!\n");
     }
 
-    while (activeThreads) {
-        pthread_cond_wait(&status_cond, &status_mutex);
-        activeThreads = 0;
-        for (int i = 0; i < NUM_THREADS; i++) {
-            if (thread_status[i]) activeThreads++;
+    for (uint32_t i = 0; i < workers; i++) {
+        if (data.arenas != NULL) {
+            lfsr_arena_destroy(data.arenas[i]);
+        }
+        if (data.states != NULL) {
+            free(data.states[i]);
         }
     }
-
-    pthread_mutex_unlock(&status_mutex);
+    free(data.arenas);
+    free(data.states);
+    pthread_mutex_destroy(&data.keyCount_mutex);
 
     for (uint32_t i = 1; i < MAX_NR_NONCES; i++) {
         if (keyCounts[i] == 0) {
@@ -314,13 +253,37 @@ static uint64_t **unpredictable_nested(NtpKs1List *pNKL, uint32_t keyCounts[]) {
 
     return result_keys;
 }
+
+typedef struct {
+    uint64_t **keys;
+    uint32_t *keyCounts;
+    uint32_t nr_nonces;
+} analyze_data_t;
+
+static void print_shared_key(uint64_t key, uint32_t count, void *ctx) {
+    analyze_data_t *ad = (analyze_data_t *)ctx;
+    if (count < 2) {
+        return;
+    }
+
+    printf("Key %012" PRIx64 " found in %d arrays: 0", key, count + 1);
+    for (uint32_t ii = 1; ii < ad->nr_nonces; ii++) {
+        for (uint32_t j = 0; j < ad->keyCounts[ii]; j++) {
+            if (key == ad->keys[ii][j]) {
+                printf(", %2u", ii);
+            }
+        }
+    }
+    printf("\n");
+}
+
 // Function to compare keys and keep track of their occurrences
 static void analyze_keys(uint64_t **keys, uint32_t keyCounts[MAX_NR_NONCES], uint32_t nr_nonces) {
-    // Assuming the maximum possible keys
-#define MAX_KEYS (MAX_NR_NONCES * KEY_SPACE_SIZE_STEP2)
-    uint64_t combined_keys[MAX_KEYS] = {0};
-    uint32_t combined_counts[MAX_KEYS] = {0};
-    uint32_t combined_length = 0;
+    keystore_t store;
+    if (keystore_init(&store, 0) == false) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
 
     printf("Analyzing keys...\n");
     for (uint32_t i = 0; i < nr_nonces; i++) {
@@ -330,42 +293,16 @@ static void analyze_keys(uint64_t **keys, uint32_t keyCounts[MAX_NR_NONCES], uin
         } else {
             printf("nT(%u): %u key candidates matching nT(0)\n", i, keyCounts[i]);
         }
-        for (uint32_t j = 0; j < keyCounts[i]; j++) {
-            uint64_t key = keys[i][j];
-            // Check if key is already in combined_keys
-            bool found = false;
-            for (uint32_t k = 0; k < combined_length; k++) {
-                if (combined_keys[k] == key) {
-                    combined_counts[k]++;
-                    found = true;
-                    break;
-                }
-            }
-            // If key not found, add it to combined_keys
-            if (!found) {
-                combined_keys[combined_length] = key;
-                combined_counts[combined_length] = 1;
-                combined_length++;
-            }
-        }
+        keystore_add(&store, keys[i], keyCounts[i]);
     }
 
-    for (uint32_t i = 0; i < combined_length; i++) {
-
-        if (combined_counts[i] > 1) {
-            printf("Key %012" PRIx64 " found in %d arrays: 0", combined_keys[i], combined_counts[i] + 1);
-
-            for (uint32_t ii = 1; ii < nr_nonces; ii++) {
-                for (uint32_t j = 0; j < keyCounts[ii]; j++) {
-
-                    if (combined_keys[i] == keys[ii][j]) {
-                        printf(", %2u", ii);
-                    }
-                }
-            }
-            printf("\n");
-        }
-    }
+    analyze_data_t ad = {
+        .keys = keys,
+        .keyCounts = keyCounts,
+        .nr_nonces = nr_nonces,
+    };
+    keystore_count(&store, print_shared_key, &ad);
+    keystore_free(&store);
 }
 
 int main(int argc, char *const argv[]) {
@@ -463,6 +400,9 @@ int main(int argc, char *const argv[]) {
 
     printf("Finding key candidates...\n");
     keys = unpredictable_nested(&NKL, keyCounts);
+    if (keys == NULL) {
+        return 1;
+    }
 
     printf("\n\nFinding phase complete.\n");
 
@@ -78,6 +78,37 @@ static uint16_t compute_seednt16_nt32(uint32_t nt32, uint64_t key) {
     return nt;
 }
 
+// Streams the keys of filename. A key is kept when match is NULL or its seed is set in match.
+// Kept keys set their seed in seen and are written to out, when given.
+static bool filter_pass(const char *filename, uint32_t nt, const uint8_t *match, uint8_t *seen, FILE *out,
+                        uint32_t *keycount, uint32_t *keptcount) {
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL) {
+        fprintf(stderr, "Warning: Cannot open %s\n", filename);
+        return false;
+    }
+
+    *keycount = 0;
+    *keptcount = 0;
+    uint64_t key;
+    while (fscanf(fptr, "%012" PRIx64, &key) == 1) {
+        (*keycount)++;
+        uint16_t seednt = compute_seednt16_nt32(nt, key);
+        if ((match != NULL) && (match[seednt] == 0)) {
+            continue;
+        }
+        if (seen != NULL) {
+            seen[seednt] = 1;
+        }
+        if (out != NULL) {
+            (*keptcount)++;
+            fprintf(out, "%012" PRIx64 "\n", key);
+        }
+    }
+    fclose(fptr);
+    return true;
+}
+
 int main(int argc, char *const argv[]) {
 
     if (argc != 3) {
@@ -119,161 +150,52 @@ int main(int argc, char *const argv[]) {
 
     init_lfsr16_table();
 
-    uint32_t keycount1 = 0;
-    uint64_t *keys1 = NULL;
-    uint8_t *filter_keys1 = NULL;
-    uint16_t *seednt1 = NULL;
-    uint32_t keycount2 = 0;
-    uint64_t *keys2 = NULL;
-    uint8_t *filter_keys2 = NULL;
-    FILE *fptr;
-
-    fptr = fopen(filename1, "r");
-    if (fptr != NULL) {
+    // A key of one list survives if a key of the other list gives the same 16-bit seed,
+    // so matching goes through a bitmap of the seeds instead of comparing every couple.
+    // Keys are streamed from the files, memory does not depend on the list sizes.
+    static uint8_t seen1[1 << 16];
+    static uint8_t seen2[1 << 16];
+    uint32_t keycount1 = 0, keycount2 = 0, kept;
 
-        uint64_t buffer;
-        while (fscanf(fptr, "%012" PRIx64, &buffer) == 1) {
-            keycount1++;
-        }
-
-        keys1 = (uint64_t *)calloc(1, keycount1 * sizeof(uint64_t));
-        filter_keys1 = (uint8_t *)calloc(keycount1, sizeof(uint8_t));
-        if ((keys1 == NULL) || (filter_keys1 == NULL)) {
-            perror("Failed to allocate memory");
-            fclose(fptr);
-            goto end;
-        }
+    if (filter_pass(filename1, nt1, NULL, seen1, NULL, &keycount1, &kept) == false) {
+        return 0;
+    }
+    printf("%s: %u keys loaded\n", filename1, keycount1);
 
-        rewind(fptr);
+    char filter_filename2[40];
+    uint32_t filter_keycount2 = 0;
+    snprintf(filter_filename2, sizeof(filter_filename2), "keys_%08x_%02u_%08x_filtered.dic", uid2, sector2, nt2);
 
-        for (uint32_t i = 0; i < keycount1; i++) {
-            if (fscanf(fptr, "%012" PRIx64, &keys1[i]) != 1) {
-                perror("Failed to read key");
-                fclose(fptr);
-                goto end;
-            }
-        }
-        fclose(fptr);
-    } else {
-        fprintf(stderr, "Warning: Cannot open %s\n", filename1);
-        goto end;
+    FILE *fptr = fopen(filter_filename2, "w");
+    if (fptr == NULL) {
+        fprintf(stderr, "Warning: Cannot save keys in %s\n", filter_filename2);
     }
-
-    fptr = fopen(filename2, "r");
+    bool ok = filter_pass(filename2, nt2, seen1, seen2, fptr, &keycount2, &filter_keycount2);
     if (fptr != NULL) {
-
-        uint64_t buffer;
-        while (fscanf(fptr, "%012" PRIx64, &buffer) == 1) {
-            keycount2++;
-        }
-
-        keys2 = (uint64_t *)calloc(1, keycount2 * sizeof(uint64_t));
-        filter_keys2 = (uint8_t *)calloc(keycount2, sizeof(uint8_t));
-        if ((keys2 == NULL) || (filter_keys2 == NULL)) {
-            perror("Failed to allocate memory");
-            fclose(fptr);
-            goto end;
-        }
-
-        rewind(fptr);
-
-        for (uint32_t i = 0; i < keycount2; i++) {
-            if (fscanf(fptr, "%012" PRIx64, &keys2[i]) != 1) {
-                perror("Failed to read key");
-                fclose(fptr);
-                goto end;
-            }
-        }
         fclose(fptr);
-    } else {
-        fprintf(stderr, "Warning: Cannot open %s\n", filename2);
-        goto end;
-    }
-
-    printf("%s: %u keys loaded\n", filename1, keycount1);
-    printf("%s: %u keys loaded\n", filename2, keycount2);
-
-    seednt1 = (uint16_t *)calloc(1, keycount1 * sizeof(uint16_t));
-    if (seednt1 == NULL) {
-        perror("Failed to allocate memory");
-        goto end;
     }
-
-    for (uint32_t i = 0; i < keycount1; i++) {
-        seednt1[i] = compute_seednt16_nt32(nt1, keys1[i]);
-    }
-
-    for (uint32_t j = 0; j < keycount2; j++) {
-        uint16_t seednt2 = compute_seednt16_nt32(nt2, keys2[j]);
-        for (uint32_t i = 0; i < keycount1; i++) {
-            if (seednt2 == seednt1[i]) {
-//                printf("MATCH: key1=%012" PRIx64 " key2=%012" PRIx64 "\n", keys1[i], keys2[j]);
-                filter_keys1[i] = 1;
-                filter_keys2[j] = 1;
-            }
-        }
+    if (ok == false) {
+        return 0;
     }
+    printf("%s: %u keys loaded\n", filename2, keycount2);
 
     char filter_filename1[40];
     uint32_t filter_keycount1 = 0;
     snprintf(filter_filename1, sizeof(filter_filename1), "keys_%08x_%02u_%08x_filtered.dic", uid1, sector1, nt1);
 
     fptr = fopen(filter_filename1, "w");
-    if (fptr != NULL) {
-
-        for (uint32_t j = 0; j < keycount1; j++) {
-            if (filter_keys1[j]) {
-                filter_keycount1++;
-                fprintf(fptr, "%012" PRIx64 "\n", keys1[j]);
-            }
-        }
-        fclose(fptr);
-
-    } else {
+    if (fptr == NULL) {
         fprintf(stderr, "Warning: Cannot save keys in %s\n", filter_filename1);
     }
-
-    char filter_filename2[40];
-    uint32_t filter_keycount2 = 0;
-    snprintf(filter_filename2, sizeof(filter_filename2), "keys_%08x_%02u_%08x_filtered.dic", uid2, sector2, nt2);
-
-    fptr = fopen(filter_filename2, "w");
+    ok = filter_pass(filename1, nt1, seen2, NULL, fptr, &keycount1, &filter_keycount1);
     if (fptr != NULL) {
-
-        for (uint32_t j = 0; j < keycount2; j++) {
-            if (filter_keys2[j]) {
-                filter_keycount2++;
-                fprintf(fptr, "%012" PRIx64 "\n", keys2[j]);
-            }
-        }
         fclose(fptr);
-
-    } else {
-        fprintf(stderr, "Warning: Cannot save keys in %s\n", filter_filename2);
     }
-    printf("%s: %u keys saved\n", filter_filename1, filter_keycount1);
-    printf("%s: %u keys saved\n", filter_filename2, filter_keycount2);
-
-end:
-    if (keys1 != NULL) {
-        free(keys1);
-    }
-
-    if (keys2 != NULL) {
-        free(keys2);
-    }
-
-    if (filter_keys1 != NULL) {
-        free(filter_keys1);
-    }
-
-    if (filter_keys2 != NULL) {
-        free(filter_keys2);
-    }
-
-    if (seednt1 != NULL) {
-        free(seednt1);
+    if (ok == false) {
+        return 0;
     }
 
+    printf("%s: %u keys saved\n", filter_filename1, filter_keycount1);
+    printf("%s: %u keys saved\n", filter_filename2, filter_keycount2);
     return 0;
 }
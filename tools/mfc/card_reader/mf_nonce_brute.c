@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <signal.h>
+#include <stddef.h>
 #include "crapto1/crapto1.h"
 #include "protocol.h"
 #include "iso14443crc.h"
@@ -46,6 +48,49 @@ typedef struct thread_args {
 } targs;
 
 #define ENC_LEN  (200)
+
+// the 2^16 nonces / upper key bits are handed out in chunks, idle threads take the next one
+#define CHUNK_SIZE            (0x100)
+#define NR_CHUNKS             (0x10000 / CHUNK_SIZE)
+#define CHECKPOINT_INTERVAL   (10000) // ms
+#define CHECKPOINT_MAGIC      (0x3142464d) // "MFB1"
+#define MAX_FOUND_KEYS        (64)
+
+enum {
+    PHASE_OLD_MFC = 0,
+    PHASE_EV1,
+    PHASE_KEY,
+};
+
+// everything needed to pick up an interrupted run, the inputs come first
+typedef struct {
+    uint32_t magic;
+    uint32_t uid;
+    uint32_t nt_enc;
+    uint32_t nt_par_err;
+    uint32_t nr_enc;
+    uint32_t ar_enc;
+    uint32_t ar_par_err;
+    uint32_t at_enc;
+    uint32_t at_par_err;
+    uint16_t enc_len;
+    uint8_t enc[ENC_LEN];
+    uint8_t is_nt_encrypted;
+    // progress
+    uint8_t phase;
+    uint8_t done[NR_CHUNKS / 8];
+    int found;
+    int found_candidate;
+    uint64_t candidate_key;
+    uint32_t nr_keys;
+    uint64_t keys[MAX_FOUND_KEYS];
+} checkpoint_t;
+
+typedef struct thread_stats {
+    uint64_t tested;
+    uint64_t elapsed;   // ms
+} tstats;
+
 typedef struct thread_key_args {
     int thread;
     int idx;
@@ -137,6 +182,57 @@ static int global_found_candidate = 0;
 static uint64_t global_candidate_key = 0;
 static int thread_count = 2;
 
+// chunk scheduling of the running phase
+static uint32_t work_next_chunk = 0;
+static uint8_t work_done[NR_CHUNKS / 8];
+static int work_running = 0;
+static tstats *thread_stats = NULL;
+
+// keys found in phase 3, kept for the checkpoint
+static uint32_t found_keys_count = 0;
+static uint64_t found_keys[MAX_FOUND_KEYS];
+
+static volatile sig_atomic_t interrupted = 0;
+static char checkpoint_filename[64];
+
+static void sigint_handler(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+// hands out the next chunk not done yet, false once all are gone or on ctrl-c
+static bool next_chunk(uint32_t *chunk) {
+    while (interrupted == 0) {
+        uint32_t c = __atomic_fetch_add(&work_next_chunk, 1, __ATOMIC_RELAXED);
+        if (c >= NR_CHUNKS) {
+            return false;
+        }
+        if ((__atomic_load_n(&work_done[c >> 3], __ATOMIC_RELAXED) & (1 << (c & 7))) == 0) {
+            *chunk = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void chunk_done(uint32_t chunk) {
+    __atomic_fetch_or(&work_done[chunk >> 3], (uint8_t)(1 << (chunk & 7)), __ATOMIC_RELAXED);
+}
+
+static uint32_t chunks_done(void) {
+    uint32_t n = 0;
+    for (uint32_t c = 0; c < NR_CHUNKS; c++) {
+        n += (work_done[c >> 3] >> (c & 7)) & 1;
+    }
+    return n;
+}
+
+static void thread_finished(int thread, uint64_t tested, uint64_t start) {
+    thread_stats[thread].tested += tested;
+    thread_stats[thread].elapsed += msclock() - start;
+    __atomic_fetch_sub(&work_running, 1, __ATOMIC_RELEASE);
+}
+
 static int param_getptr(const char *line, int *bg, int *en, int paramnum) {
     int i;
     int len = strlen(line);
@@ -502,93 +598,104 @@ static void *brute_thread(void *arguments) {
     uint32_t nt;      // current tag nonce
 
     uint32_t p64 = 0;
-    // TC == 4  (
-    // threads calls 0 ev1 == false
-    // threads calls 0,1,2  ev1 == true
-    for (uint32_t count = args->idx; count <= 0xFFFF; count += thread_count) {
-
-        if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
-            break;
-        }
+    uint64_t start = msclock();
+    uint64_t tested = 0;
+    bool stop = false;
+    uint32_t chunk;
+    while (stop == false && next_chunk(&chunk)) {
+        for (uint32_t count = chunk * CHUNK_SIZE; count < (chunk + 1) * CHUNK_SIZE; count++) {
+
+            if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1 || interrupted) {
+                stop = true;
+                break;
+            }
+            tested++;
 
-        nt = count << 16 | prng_successor(count, 16);
+            nt = count << 16 | prng_successor(count, 16);
 
-        if (candidate_nonce(args->xored, nt, args->ev1) == false) {
-            continue;
-        }
+            if (candidate_nonce(args->xored, nt, args->ev1) == false) {
+                continue;
+            }
 
-        p64 = prng_successor(nt, 64);
-        ks2 = ar_enc ^ p64;
-        ks3 = at_enc ^ prng_successor(p64, 32);
-        revstate = lfsr_recovery64(ks2, ks3);
-        ks4 = crypto1_word(revstate, 0, 0);
+            p64 = prng_successor(nt, 64);
+            ks2 = ar_enc ^ p64;
+            ks3 = at_enc ^ prng_successor(p64, 32);
+            revstate = lfsr_recovery64(ks2, ks3);
+            ks4 = crypto1_word(revstate, 0, 0);
 
-        if (ks4 == 0) {
-            free(revstate);
-            continue;
-        }
+            if (ks4 == 0) {
+                free(revstate);
+                continue;
+            }
 
-        // lock this section to avoid interlacing prints from different threats
-        pthread_mutex_lock(&print_lock);
-        if (args->ev1) {
-            printf("\n---> " _YELLOW_(" Possible key candidate")"  <---\n");
-        }
+            // lock this section to avoid interlacing prints from different threats
+            pthread_mutex_lock(&print_lock);
+            if (args->ev1) {
+                printf("\n---> " _YELLOW_(" Possible key candidate")"  <---\n");
+            }
 
 #if 0
-        printf("thread #%d idx %d %s\n", args->thread, args->idx, (args->ev1) ? "(Ev1)" : "");
-        printf("current nt(%08x)  ar_enc(%08x)  at_enc(%08x)\n", nt, ar_enc, at_enc);
-        printf("ks2:%08x\n", ks2);
-        printf("ks3:%08x\n", ks3);
-        printf("ks4:%08x\n", ks4);
+            printf("thread #%d idx %d %s\n", args->thread, args->idx, (args->ev1) ? "(Ev1)" : "");
+            printf("current nt(%08x)  ar_enc(%08x)  at_enc(%08x)\n", nt, ar_enc, at_enc);
+            printf("ks2:%08x\n", ks2);
+            printf("ks3:%08x\n", ks3);
+            printf("ks4:%08x\n", ks4);
 #endif
-        if (cmd_enc) {
-            uint32_t decrypted = ks4 ^ cmd_enc;
-            printf("CMD enc( %08x )\n", cmd_enc);
-            printf("    dec( %08x )    ", decrypted);
-
-            // check if cmd exists
-            uint8_t isOK = checkValidCmd(decrypted);
-            if (isOK == false) {
-                printf(_RED_("<-- not a valid cmd\n"));
-                pthread_mutex_unlock(&print_lock);
-                free(revstate);
-                continue;
+            if (cmd_enc) {
+                uint32_t decrypted = ks4 ^ cmd_enc;
+                printf("CMD enc( %08x )\n", cmd_enc);
+                printf("    dec( %08x )    ", decrypted);
+
+                // check if cmd exists
+                uint8_t isOK = checkValidCmd(decrypted);
+                if (isOK == false) {
+                    printf(_RED_("<-- not a valid cmd\n"));
+                    pthread_mutex_unlock(&print_lock);
+                    free(revstate);
+                    continue;
+                }
+
+                // Add a crc-check.
+                isOK = checkCRC(decrypted);
+                if (isOK == false) {
+                    printf(_RED_("<-- not a valid crc\n"));
+                    pthread_mutex_unlock(&print_lock);
+                    free(revstate);
+                    continue;
+                }
+
+                printf("<-- " _GREEN_("valid cmd") "\n");
             }
 
-            // Add a crc-check.
-            isOK = checkCRC(decrypted);
-            if (isOK == false) {
-                printf(_RED_("<-- not a valid crc\n"));
-                pthread_mutex_unlock(&print_lock);
-                free(revstate);
-                continue;
-            }
+            lfsr_rollback_word(revstate, 0, 0);
+            lfsr_rollback_word(revstate, 0, 0);
+            lfsr_rollback_word(revstate, 0, 0);
+            lfsr_rollback_word(revstate, nr_enc, 1);
+            lfsr_rollback_word(revstate, uid ^ nt, 0);
+            crypto1_get_lfsr(revstate, &key);
+            free(revstate);
 
-            printf("<-- " _GREEN_("valid cmd") "\n");
+            if (args->ev1) {
+                // if it was EV1,  we know for sure xxxAAAAAAAA recovery
+                printf("\nKey candidate [ " _YELLOW_("....%08" PRIx64)" ]\n\n", key & 0xFFFFFFFF);
+                __sync_fetch_and_add(&global_found_candidate, 1);
+            } else {
+                printf("\nKey candidate [ " _GREEN_("....%08" PRIx64) " ]", key & 0xFFFFFFFF);
+                printf("\nKey candidate [ " _GREEN_("%12" PRIx64) " ]\n\n", key);
+                __sync_fetch_and_add(&global_found, 1);
+            }
+            // release lock
+            pthread_mutex_unlock(&print_lock);
+            __sync_fetch_and_add(&global_candidate_key, key);
+            stop = true;
+            break;
         }
-
-        lfsr_rollback_word(revstate, 0, 0);
-        lfsr_rollback_word(revstate, 0, 0);
-        lfsr_rollback_word(revstate, 0, 0);
-        lfsr_rollback_word(revstate, nr_enc, 1);
-        lfsr_rollback_word(revstate, uid ^ nt, 0);
-        crypto1_get_lfsr(revstate, &key);
-        free(revstate);
-
-        if (args->ev1) {
-            // if it was EV1,  we know for sure xxxAAAAAAAA recovery
-            printf("\nKey candidate [ " _YELLOW_("....%08" PRIx64)" ]\n\n", key & 0xFFFFFFFF);
-            __sync_fetch_and_add(&global_found_candidate, 1);
-        } else {
-            printf("\nKey candidate [ " _GREEN_("....%08" PRIx64) " ]", key & 0xFFFFFFFF);
-            printf("\nKey candidate [ " _GREEN_("%12" PRIx64) " ]\n\n", key);
-            __sync_fetch_and_add(&global_found, 1);
+        // an interrupted chunk is done again after a resume
+        if (stop == false) {
+            chunk_done(chunk);
         }
-        // release lock
-        pthread_mutex_unlock(&print_lock);
-        __sync_fetch_and_add(&global_candidate_key, key);
-        break;
     }
+    thread_finished(args->thread, tested, start);
     free(args);
     return NULL;
 }
@@ -600,51 +707,183 @@ static void *brute_key_thread(void *arguments) {
     uint8_t local_enc[args->enc_len];
     memcpy(local_enc, args->enc, args->enc_len);
 
-    for (uint64_t count = args->idx; count <= 0xFFFF; count += thread_count) {
+    uint64_t start = msclock();
+    uint64_t tested = 0;
+    bool stop = false;
+    uint32_t chunk;
+    while (stop == false && next_chunk(&chunk)) {
+        for (uint64_t count = chunk * CHUNK_SIZE; count < (chunk + 1) * CHUNK_SIZE; count++) {
 
-        uint64_t key = args->part_key | (count << 32);
+            if (interrupted) {
+                stop = true;
+                break;
+            }
+            tested++;
 
-        // Init cipher with key
-        struct Crypto1State *pcs = crypto1_create(key);
+            uint64_t key = args->part_key | (count << 32);
 
-        // NESTED decrypt nt with help of new key
-        crypto1_word(pcs, args->nt_enc ^ args->uid, args->is_nt_encrypted);
-        crypto1_word(pcs, args->nr_enc, 1);
-        crypto1_word(pcs, 0, 0);
-        crypto1_word(pcs, 0, 0);
+            // Init cipher with key
+            struct Crypto1State *pcs = crypto1_create(key);
 
-        // decrypt 22 bytes
-        uint8_t dec[args->enc_len];
-        for (int i = 0; i < args->enc_len; i++) {
-            dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
-        }
+            // NESTED decrypt nt with help of new key
+            crypto1_word(pcs, args->nt_enc ^ args->uid, args->is_nt_encrypted);
+            crypto1_word(pcs, args->nr_enc, 1);
+            crypto1_word(pcs, 0, 0);
+            crypto1_word(pcs, 0, 0);
 
-        crypto1_destroy(pcs);
+            // decrypt 22 bytes
+            uint8_t dec[args->enc_len];
+            for (int i = 0; i < args->enc_len; i++) {
+                dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
+            }
 
-        // check if cmd exists
-        if (checkValidCmdByte(dec, args->enc_len) == false) {
-            continue;
-        }
+            crypto1_destroy(pcs);
 
-        __sync_fetch_and_add(&global_found_candidate, 1);
+            // check if cmd exists
+            if (checkValidCmdByte(dec, args->enc_len) == false) {
+                continue;
+            }
 
-        // lock this section to avoid interlacing prints from different threats
-        pthread_mutex_lock(&print_lock);
-        printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
-        printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
+            __sync_fetch_and_add(&global_found_candidate, 1);
 
-        if (key == global_candidate_key) {
-            printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ] - " _YELLOW_("matches candidate")  "\n\n", key);
-        } else {
-            printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
-        }
+            // lock this section to avoid interlacing prints from different threats
+            pthread_mutex_lock(&print_lock);
+            printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
+            printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
 
-        pthread_mutex_unlock(&print_lock);
+            if (key == global_candidate_key) {
+                printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ] - " _YELLOW_("matches candidate")  "\n\n", key);
+            } else {
+                printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
+            }
+            if (found_keys_count < MAX_FOUND_KEYS) {
+                found_keys[found_keys_count++] = key;
+            }
+
+            pthread_mutex_unlock(&print_lock);
+        }
+        if (stop == false) {
+            chunk_done(chunk);
+        }
     }
+    thread_finished(args->thread, tested, start);
     free(args);
     return NULL;
 }
 
+static void checkpoint_init(checkpoint_t *cp, const uint8_t *enc, uint16_t enc_len) {
+    memset(cp, 0, sizeof(checkpoint_t));
+    cp->magic = CHECKPOINT_MAGIC;
+    cp->uid = uid;
+    cp->nt_enc = nt_enc;
+    cp->nt_par_err = nt_par_err;
+    cp->nr_enc = nr_enc;
+    cp->ar_enc = ar_enc;
+    cp->ar_par_err = ar_par_err;
+    cp->at_enc = at_enc;
+    cp->at_par_err = at_par_err;
+    cp->enc_len = enc_len;
+    memcpy(cp->enc, enc, enc_len);
+    cp->is_nt_encrypted = is_nt_encrypted;
+}
+
+static void checkpoint_save(uint8_t phase, const uint8_t *enc, uint16_t enc_len) {
+    checkpoint_t cp;
+    checkpoint_init(&cp, enc, enc_len);
+    cp.phase = phase;
+
+    pthread_mutex_lock(&print_lock);
+    for (uint32_t i = 0; i < sizeof(cp.done); i++) {
+        cp.done[i] = __atomic_load_n(&work_done[i], __ATOMIC_RELAXED);
+    }
+    cp.found = global_found;
+    cp.found_candidate = global_found_candidate;
+    cp.candidate_key = global_candidate_key;
+    cp.nr_keys = found_keys_count;
+    memcpy(cp.keys, found_keys, sizeof(found_keys));
+    pthread_mutex_unlock(&print_lock);
+
+    // write aside and rename, a crash while saving leaves the previous checkpoint intact
+    char tmp_filename[sizeof(checkpoint_filename) + 4];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", checkpoint_filename);
+    FILE *f = fopen(tmp_filename, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Warning: Cannot save checkpoint in %s\n", tmp_filename);
+        return;
+    }
+    size_t res = fwrite(&cp, sizeof(cp), 1, f);
+    fclose(f);
+    if (res != 1) {
+        fprintf(stderr, "Warning: Cannot save checkpoint in %s\n", tmp_filename);
+        remove(tmp_filename);
+        return;
+    }
+#if defined(_WIN32)
+    remove(checkpoint_filename);
+#endif
+    rename(tmp_filename, checkpoint_filename);
+}
+
+// true if a checkpoint of the very same inputs exists
+static bool checkpoint_load(checkpoint_t *cp, const uint8_t *enc, uint16_t enc_len) {
+    checkpoint_t want;
+    checkpoint_init(&want, enc, enc_len);
+
+    FILE *f = fopen(checkpoint_filename, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    memset(cp, 0, sizeof(checkpoint_t));
+    size_t res = fread(cp, sizeof(checkpoint_t), 1, f);
+    fclose(f);
+
+    if (res != 1 || memcmp(cp, &want, offsetof(checkpoint_t, phase)) != 0 ||
+            cp->phase > PHASE_KEY || cp->nr_keys > MAX_FOUND_KEYS) {
+        printf("Ignoring checkpoint %s, it belongs to other inputs\n", checkpoint_filename);
+        return false;
+    }
+    return true;
+}
+
+// resets the chunk scheduling, keeps the chunks done when resuming the same phase
+static void phase_start(bool resume) {
+    work_next_chunk = 0;
+    work_running = thread_count;
+    if (resume == false) {
+        memset(work_done, 0, sizeof(work_done));
+    }
+    memset(thread_stats, 0, thread_count * sizeof(tstats));
+}
+
+// waits for the workers of a phase, saving progress meanwhile. False on ctrl-c
+static bool phase_wait(pthread_t *threads, uint8_t phase, const uint8_t *enc, uint16_t enc_len, const char *unit) {
+    uint64_t last = msclock();
+    while (__atomic_load_n(&work_running, __ATOMIC_ACQUIRE) > 0) {
+        msleep(100);
+        if (msclock() - last >= CHECKPOINT_INTERVAL) {
+            checkpoint_save(phase, enc, enc_len);
+            last = msclock();
+        }
+    }
+
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (interrupted) {
+        checkpoint_save(phase, enc, enc_len);
+        printf("\nInterrupted, %u / %u chunks done\n", chunks_done(), NR_CHUNKS);
+        printf("Progress saved in " _YELLOW_("%s") ", run the same command again to resume\n\n", checkpoint_filename);
+        return false;
+    }
+
+    for (int i = 0; i < thread_count; ++i) {
+        double rate = (thread_stats[i].elapsed) ? thread_stats[i].tested * 1000.0 / thread_stats[i].elapsed : 0;
+        printf("thread %2d.... %8" PRIu64 " %s, " _YELLOW_("%.0f") " %s/s\n", i, thread_stats[i].tested, unit, rate, unit);
+    }
+    return true;
+}
+
 static int usage(void) {
     printf("\n");
     printf("syntax:  mf_nonce_brute <uid> <{nt}> <nt_par_err> <{nr}> <{ar}> <ar_par_err> <{at}> <at_par_err> [<{next_command}>]\n\n");
@@ -667,6 +906,8 @@ static int usage(void) {
     printf("enc:  A4F7F398EBDB4E484D1CB2B174B939D18B469F3FA5D9CAABBFA018EC7E0CC5721DE2E590F64BD0A5B4EFCE71\n");
     printf("dec:  30084A24302F8102F44CA5020500A60881010104763930084A24302F8102F44CA5020500A608810101047639\n");
     printf("Valid Key found: [3b7e4fd575ad]\n\n");
+    printf("Progress is saved every %d s and on ctrl-c in mf_nonce_brute_<uid>_<{nt}>.chk,\n", CHECKPOINT_INTERVAL / 1000);
+    printf("running the same command again resumes from there.\n\n");
     return 1;
 }
 
@@ -728,12 +969,31 @@ int main(int argc, const char *argv[]) {
     printf("\nBruteforce using " _YELLOW_("%d") " threads\n\n", thread_count);
 
     pthread_t threads[thread_count];
+    tstats stats[thread_count];
+    thread_stats = stats;
 
     // create a mutex to avoid interlacing print commands from our different threads
     pthread_mutex_init(&print_lock, NULL);
 
+    snprintf(checkpoint_filename, sizeof(checkpoint_filename), "mf_nonce_brute_%08x_%08x.chk", uid, nt_enc);
+    checkpoint_t cp;
+    bool resume = checkpoint_load(&cp, enc, enc_len);
+    uint8_t resume_phase = PHASE_OLD_MFC;
+    if (resume) {
+        resume_phase = cp.phase;
+        memcpy(work_done, cp.done, sizeof(work_done));
+        global_found = cp.found;
+        global_found_candidate = cp.found_candidate;
+        global_candidate_key = cp.candidate_key;
+        found_keys_count = cp.nr_keys;
+        memcpy(found_keys, cp.keys, sizeof(found_keys));
+        printf("Resuming from " _YELLOW_("%s") ", phase %u, %u / %u chunks done\n\n",
+               checkpoint_filename, resume_phase + 2, chunks_done(), NR_CHUNKS);
+    }
+    signal(SIGINT, sigint_handler);
+
     // if we have 4 or more bytes,  look for a default key
-    if (enc_len > 3) {
+    if (enc_len > 3 && resume == false) {
         printf("----------- " _CYAN_("Phase 1 pre-processing") " ------------------------\n");
         printf("Testing default keys using NESTED authentication...\n");
         struct thread_key_args *def = calloc(1, sizeof(struct thread_key_args));
@@ -756,9 +1016,19 @@ int main(int argc, const char *argv[]) {
         }
     }
 
+    if (resume_phase > PHASE_EV1) {
+        goto phase3;
+    }
+
     printf("\n----------- " _CYAN_("Phase 2 examine") " -------------------------------\n");
     printf("Looking for the last bytes of the encrypted tagnonce\n");
+
+    if (resume_phase > PHASE_OLD_MFC) {
+        goto ev1;
+    }
+
     printf("\nTarget old MFC...\n");
+    phase_start(resume);
     // the rest of available threads to EV1 scenario
     for (int i = 0; i < thread_count; ++i) {
         struct thread_args *a = calloc(1, sizeof(struct thread_args));
@@ -773,18 +1043,19 @@ int main(int argc, const char *argv[]) {
         pthread_create(&threads[i], NULL, brute_thread, (void *)a);
     }
 
-    // wait for threads to terminate:
-    for (int i = 0; i < thread_count; ++i) {
-        pthread_join(threads[i], NULL);
+    if (phase_wait(threads, PHASE_OLD_MFC, enc, enc_len, "nonces") == false) {
+        goto out;
     }
 
     t1 = msclock() - t1;
     printf("execution time " _YELLOW_("%.2f") " sec\n", (float)t1 / 1000.0);
 
+ev1:
     if (!global_found && !global_found_candidate) {
         printf("\nTarget MFC Ev1...\n");
 
         t1 = msclock();
+        phase_start(resume_phase == PHASE_EV1);
         // the rest of available threads to EV1 scenario
         for (int i = 0; i < thread_count; ++i) {
             struct thread_args *a = calloc(1, sizeof(struct thread_args));
@@ -799,9 +1070,8 @@ int main(int argc, const char *argv[]) {
             pthread_create(&threads[i], NULL, brute_thread, (void *)a);
         }
 
-        // wait for threads to terminate:
-        for (int i = 0; i < thread_count; ++i) {
-            pthread_join(threads[i], NULL);
+        if (phase_wait(threads, PHASE_EV1, enc, enc_len, "nonces") == false) {
+            goto out;
         }
 
         t1 = msclock() - t1;
@@ -810,17 +1080,20 @@ int main(int argc, const char *argv[]) {
 
         if (!global_found && !global_found_candidate) {
             printf("\nFailed to find a key\n\n");
-            goto out;
+            goto done;
         }
     }
 
     if (enc_len < 4) {
         printf("Too few next cmd bytes, skipping phase 3\n\n");
-        goto out;
+        goto done;
     }
 
     // reset thread signals
     global_found_candidate = 0;
+    found_keys_count = 0;
+
+phase3:
 
     printf("\n----------- " _CYAN_("Phase 3 validating") " ----------------------------\n");
     printf("uid.................. %08x\n", uid);
@@ -832,6 +1105,15 @@ int main(int argc, const char *argv[]) {
     printf("\nLooking for the upper 16 bits of the key\n");
     fflush(stdout);
 
+    phase_start(resume_phase == PHASE_KEY);
+    if (resume_phase == PHASE_KEY) {
+        global_found_candidate = found_keys_count;
+        for (uint32_t i = 0; i < found_keys_count; i++) {
+            printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ] - before resume\n", found_keys[i]);
+        }
+    }
+    t1 = msclock();
+
     // threads
     for (int i = 0; i < thread_count; ++i) {
         struct thread_key_args *b = calloc(1, sizeof(struct thread_key_args));
@@ -851,11 +1133,12 @@ int main(int argc, const char *argv[]) {
         pthread_create(&threads[i], NULL, brute_key_thread, (void *)b);
     }
 
-    // wait for threads to terminate:
-    for (int i = 0; i < thread_count; ++i) {
-        pthread_join(threads[i], NULL);
+    if (phase_wait(threads, PHASE_KEY, enc, enc_len, "keys") == false) {
+        goto out;
     }
 
+    t1 = msclock() - t1;
+    printf("execution time " _YELLOW_("%.2f") " sec\n\n", (float)t1 / 1000.0);
 
     if (global_found_candidate > 1) {
         printf("Key recovery ( " _GREEN_("ok") " )\n");
@@ -867,6 +1150,10 @@ int main(int argc, const char *argv[]) {
         printf("Key recovery ( " _RED_("fail") " )\n\n");
     }
 
+done:
+    // finished, nothing left to resume
+    remove(checkpoint_filename);
+
 out:
     // clean up mutex
     pthread_mutex_destroy(&print_lock);
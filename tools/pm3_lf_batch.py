@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+
+# Batch decode of stored LF captures
+#
+# Runs `data load` + `lf search -1` of the offline client on every .pm3 / .wav
+# capture found in the given files or directories, one client per core, and
+# writes one JSON record per capture.
+#
+# usage:
+#   pm3_lf_batch.py [-j jobs] [-o out.json] [-u] [--client path] <file|dir> ...
+#
+# .wav files are expected as written by `data save --wave` (8 bit unsigned,
+# mono), 16 bit files are scaled down.
+
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import wave
+from concurrent.futures import ThreadPoolExecutor
+
+ANSI = re.compile(r'\x1b\[[0-9;]*m')
+FOUND = re.compile(r'Valid (.+) found!')
+PREFIX = re.compile(r'^\[.\] ?')
+EXTENSIONS = ('.pm3', '.wav')
+
+
+def find_client(path):
+    if path:
+        return path
+    here = os.path.dirname(os.path.abspath(__file__))
+    local = os.path.join(here, '..', 'client', 'proxmark3')
+    if os.access(local, os.X_OK):
+        return os.path.normpath(local)
+    return shutil.which('proxmark3') or shutil.which('pm3')
+
+
+def captures(paths):
+    for p in paths:
+        if os.path.isdir(p):
+            for root, _, files in os.walk(p):
+                for f in sorted(files):
+                    if f.lower().endswith(EXTENSIONS):
+                        yield os.path.join(root, f)
+        elif os.path.isfile(p):
+            yield p
+        else:
+            print(f'skipping {p}, not found', file=sys.stderr)
+
+
+def wav_to_pm3(fn):
+    """Writes the wave samples as a temporary pm3 text file, returns its name"""
+    with wave.open(fn, 'rb') as w:
+        width = w.getsampwidth()
+        channels = w.getnchannels()
+        frames = w.readframes(w.getnframes())
+
+    step = width * channels
+    samples = []
+    for i in range(0, len(frames) - step + 1, step):
+        if width == 1:
+            samples.append(frames[i] - 128)
+        else:
+            # keep the most significant byte of the first channel
+            samples.append(int.from_bytes(frames[i + width - 2:i + width], 'little', signed=True) >> 8)
+
+    tmp = tempfile.NamedTemporaryFile('w', suffix='.pm3', delete=False)
+    with tmp:
+        tmp.write('\n'.join(str(s) for s in samples))
+        tmp.write('\n')
+    return tmp.name
+
+
+def parse(output):
+    """Tags reported by lf search, with the lines their demodulator printed"""
+    tags = []
+    details = []
+    searching = False
+    error = None
+    for line in output.splitlines():
+        line = ANSI.sub('', line).rstrip()
+        if 'Checking for known tags' in line:
+            searching = True
+            continue
+        if 'Data in Graphbuffer was too small' in line:
+            error = 'capture too small'
+        if searching is False:
+            continue
+
+        m = FOUND.search(line)
+        if m:
+            tags.append({'type': m.group(1), 'details': details})
+            details = []
+            continue
+
+        text = PREFIX.sub('', line).strip()
+        if text and not text.startswith('pm3 -->') and not text.startswith('['):
+            details.append(text)
+    return tags, error
+
+
+def decode(client, fn, unknown, timeout):
+    record = {'file': fn}
+    load = fn
+    try:
+        if fn.lower().endswith('.wav'):
+            load = wav_to_pm3(fn)
+
+        cmd = f'data load -f "{load}"; lf search -1'
+        if unknown:
+            cmd += 'u'
+        res = subprocess.run([client, '--incognito', '-c', cmd],
+                             stdin=subprocess.DEVNULL, capture_output=True,
+                             text=True, errors='replace', timeout=timeout)
+        m = re.search(r'loaded ([0-9,]+) samples', ANSI.sub('', res.stdout))
+        if m:
+            record['samples'] = int(m.group(1).replace(',', ''))
+        record['tags'], error = parse(res.stdout)
+        if m is None:
+            error = 'load failed'
+        if error:
+            record['error'] = error
+    except subprocess.TimeoutExpired:
+        record['error'] = 'timeout'
+    except (OSError, wave.Error, EOFError) as e:
+        record['error'] = str(e)
+    finally:
+        if load != fn:
+            os.unlink(load)
+    return record
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode stored LF captures with the offline client, in parallel')
+    parser.add_argument('paths', nargs='+', help='.pm3 / .wav files or directories to scan')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count() or 1, help='parallel clients (def: number of cores)')
+    parser.add_argument('-o', '--output', help='JSON output file (def: stdout)')
+    parser.add_argument('-u', '--unknown', action='store_true', help='also search for unknown tags (lf search -u)')
+    parser.add_argument('-t', '--timeout', type=int, default=120, help='seconds per capture (def: 120)')
+    parser.add_argument('--client', help='proxmark3 client binary (def: ../client/proxmark3, then PATH)')
+    args = parser.parse_args()
+
+    client = find_client(args.client)
+    if client is None:
+        print('proxmark3 client not found, use --client', file=sys.stderr)
+        return 1
+
+    files = list(captures(args.paths))
+    done = 0
+    results = []
+    with ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+        for record in pool.map(lambda f: decode(client, f, args.unknown, args.timeout), files):
+            results.append(record)
+            done += 1
+            print(f'\r{done}/{len(files)}', end='', file=sys.stderr, flush=True)
+    if files:
+        print('', file=sys.stderr)
+
+    report = {
+        'FileType': 'lf batch',
+        'captures': len(results),
+        'decoded': sum(1 for r in results if r.get('tags')),
+        'results': results,
+    }
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(report, f, indent=2)
+            f.write('\n')
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
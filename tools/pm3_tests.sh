@@ -18,6 +18,7 @@ TESTNONCE2KEY=false
 TESTMFNONCEBRUTE=false
 TESTMFDAESBRUTE=false
 TESTHITAG2CRACK=false
+TESTICLASSLEGBRUTE=false
 TESTCRYPTORF=false
 TESTFPGACOMPRESS=false
 TESTBOOTROM=false
@@ -32,7 +33,7 @@ while (( "$#" )); do
   case "$1" in
     -h|--help)
       echo """
-Usage: $0 [--long] [--opencl] [--clientbin /path/to/proxmark3] [mfkey|nonce2key|mf_nonce_brute|staticnested|mfd_aes_brute|cryptorf|fpga_compress|bootrom|armsrc|client|recovery|common]
+Usage: $0 [--long] [--opencl] [--clientbin /path/to/proxmark3] [mfkey|nonce2key|mf_nonce_brute|staticnested|mfd_aes_brute|cryptorf|fpga_compress|iclass_legbrute_opencl|bootrom|armsrc|client|recovery|common]
     --long:          Enable slow tests
     --opencl:        Enable tests requiring OpenCL (preferably a Nvidia GPU)
     --clientbin ...: Specify path to proxmark3 binary to test
@@ -97,6 +98,11 @@ Usage: $0 [--long] [--opencl] [--clientbin /path/to/proxmark3] [mfkey|nonce2key|
       TESTHITAG2CRACK=true
       shift
       ;;
+    iclass_legbrute_opencl)
+      TESTALL=false
+      TESTICLASSLEGBRUTE=true
+      shift
+      ;;
     bootrom)
       TESTALL=false
       TESTBOOTROM=true
@@ -408,6 +414,13 @@ while true; do
       # Order of magnitude to crack it: ~15s -> tagged as "slow"
       if ! CheckExecute slow opencl "ht2crack5opencl test"     "cd $HT2CRACK5OPENCLPATH; ./ht2crack5opencl $HT2CRACK5OPENCLUID $HT2CRACK5OPENCLNRAR" "Key found.*$HT2CRACK5OPENCLKEY"; then break; fi
     fi
+    # iclass_legbrute_opencl not yet part of "all"
+    if $TESTICLASSLEGBRUTE; then
+      echo -e "\n${C_BLUE}Testing iclass_legbrute_opencl:${C_NC} ${ICLASSLEGBRUTEPATH:=./tools/iclass_legbrute_opencl/}"
+      if ! CheckFileExist opencl "iclass_legbrute_opencl exists"     "$ICLASSLEGBRUTEPATH/iclass_legbrute_opencl"; then break; fi
+      # key is at index 12345, first slice
+      if ! CheckExecute opencl "iclass_legbrute_opencl test"      "cd $ICLASSLEGBRUTEPATH; ./iclass_legbrute_opencl -n 1 feffffffffffffff 11223344c0fb66b7 55667788e71bf886 04F12AADC5301225" "Found valid raw key 04F12AADC5600ACD"; then break; fi
+    fi
     if $TESTALL || $TESTCLIENT; then
       echo -e "\n${C_BLUE}Testing client:${C_NC} ${CLIENTBIN:=./client/proxmark3}"
       if ! CheckFileExist "proxmark3 exists"               "$CLIENTBIN"; then break; fi
@@ -438,6 +451,7 @@ while true; do
       if ! CheckExecute "reveng readline test"    "$CLIENTBIN -c 'reveng -h;reveng -D'" "CRC-64/GO-ISO"; then break; fi
       if ! CheckExecute "reveng -g test"          "$CLIENTBIN -c 'reveng -g abda202c'" "CRC-16/ISO-IEC-14443-3-A"; then break; fi
       if ! CheckExecute "reveng -w test"          "$CLIENTBIN -c 'reveng -w 8 -s 01020304e3 010204039d'" "CRC-8/SMBUS"; then break; fi
+      if ! CheckExecute "analyse bench selftest"  "$CLIENTBIN -c 'analyse bench --ms 1'" "kernels, 0 failed"; then break; fi
       if ! CheckExecute "mfu pwdgen test"         "$CLIENTBIN -c 'hf mfu pwdgen --test'" "Selftest ok"; then break; fi
       if ! CheckExecute "mfu keygen test"         "$CLIENTBIN -c 'hf mfu keygen --uid 11223344556677'" "80 B1 C2 71 D8 A0"; then break; fi
       if ! CheckExecute "jooki encode test"       "$CLIENTBIN -c 'hf jooki encode --test'" "04 28 F4 DA F0 4A 81  \( ok \)"; then break; fi
@@ -453,6 +467,8 @@ while true; do
 
       echo -e "\n${C_BLUE}Testing LF:${C_NC}"
       if ! CheckExecute "lf hitag2 test"             "$CLIENTBIN -c 'lf hitag test'" "Tests \( ok"; then break; fi
+      if ! CheckExecute slow "lf hitag crack5 test"  "$CLIENTBIN -c 'lf hitag crack5 --uid 12345678 --nrar 71DA20AA7EFDF3FA --nrar2 2A4265F959653B07'" "Key: AABBCCDDEEFF"; then break; fi
+      if ! CheckExecute slow "lf hitag crack5 keystream test" "$CLIENTBIN -c 'lf hitag crack5 --uid 12345678 --nrar 71DA20AA7EFDF3FA --ks DF275701'" "Key: AABBCCDDEEFF"; then break; fi
       if ! CheckExecute "lf cotag demod test"        "$CLIENTBIN -c 'data load -f traces/lf_cotag_220_8331.pm3; data norm; data cthreshold -u 50 -d -20; data envelope; data raw --ar -c 272; lf cotag demod'" \
                                                                      "COTAG Found: FC 220, CN: 8331 Raw: FFB841170363FFFE00001E7F00000000"; then break; fi
       if ! CheckExecute "lf AWID test"               "$CLIENTBIN -c 'data load -f traces/lf_AWID-15-259.pm3;lf search -1'" "AWID ID found"; then break; fi
@@ -575,9 +591,11 @@ while true; do
       if ! CheckExecute "hf iclass lookup test"            "$CLIENTBIN -c 'hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b -f $DICPATH/iclass_default_keys.dic'" \
                                                                 "valid key AEA684A6DAB23278"; then break; fi
       if ! CheckExecute "hf iclass loclass test"         "$CLIENTBIN -c 'hf iclass loclass --test'" "Key diversification \( ok \)"; then break; fi
+      if ! CheckExecute "hf iclass loclass bench"        "$CLIENTBIN -c 'hf iclass loclass --bench'" "bruteforceItem.*\( ok \)"; then break; fi
       if ! CheckExecute "emv test"                       "$CLIENTBIN -c 'emv test'" "Tests \( ok"; then break; fi
       if ! CheckExecute "hf cipurse test"                "$CLIENTBIN -c 'hf cipurse test'" "Tests \( ok"; then break; fi
       if ! CheckExecute "hf mfdes test"                  "$CLIENTBIN -c 'hf mfdes test'"   "Tests \( ok"; then break; fi
+      if ! CheckExecute "hf ntag424 sdm test"            "$CLIENTBIN -c 'hf ntag424 sdm --test'" "Tests \( ok"; then break; fi
       if ! CheckExecute "hf waveshare load"              "$CLIENTBIN -c 'hf waveshare load -m 6 -f tools/lena.bmp -s dither.bmp' && echo '34ff55fe7257876acf30dae00eb0e439 dither.bmp' | md5sum -c -" "dither.bmp: OK"; then break; fi
     fi
   echo -e "\n------------------------------------------------------------"